@@ -0,0 +1,1065 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks of the DSP kernels and render stages.
+ *
+ * Usage: fluid_bench [-r repeats] [-o file.json] [name-filter]
+ *
+ * Every benchmark processes a fixed amount of deterministic input, is run once to warm
+ * up the caches and then repeated; the fastest repetition is reported, since it is the
+ * one least disturbed by the rest of the system. The results are written as JSON to
+ * stdout or the given file, so that they can be compared across commits:
+ *
+ *   ns_per_sample    time per output sample (per voice for the synth benchmarks)
+ *   ns_per_op        time per operation, for benchmarks that don't produce audio
+ *   voices_per_core  voices a single core could render in realtime at 44.1 kHz
+ *
+ * Build and run with "make bench" (or "cmake --build . --target bench").
+ */
+
+#include "fluidsynth.h"
+#include "fluid_sys.h"
+#include "utils/fluid_perf.h"
+#include "utils/fluid_hash.h"
+#include "rvoice/fluid_rvoice.h"
+#include "rvoice/fluid_rvoice_mixer.h"
+#include "rvoice/fluid_iir_filter.h"
+#include "rvoice/fluid_rev.h"
+#include "rvoice/fluid_chorus.h"
+#include "rvoice/fluid_limiter.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_event.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_SAMPLE_RATE 44100
+#define BENCH_BLOCKS 2048              /* FLUID_BUFSIZE blocks processed by a DSP benchmark */
+#define BENCH_SAMPLE_FRAMES 32768      /* length of the synthetic sample */
+#define BENCH_SYNTH_FRAMES 65536       /* frames rendered by a synth benchmark */
+#define BENCH_SYNTH_NOTES 48           /* notes played by a synth benchmark */
+#define BENCH_SYNTH_DENSE_NOTES 200    /* notes played by the high polyphony synth benchmark */
+#define BENCH_SEQ_EVENTS 50000         /* events inserted into and popped from the sequencer */
+#define BENCH_HASH_KEYS 4096           /* keys inserted into a hash table */
+#define BENCH_HASH_ROUNDS 16           /* times every key is looked up */
+#define BENCH_MIDI_TRACKS 48           /* tracks of the MIDI file loaded by the player */
+#define BENCH_MIDI_EVENTS 20000        /* events of each track */
+#define BENCH_DEFAULT_REPEATS 5
+
+typedef struct
+{
+    const char *filter;
+    int repeats;
+    FILE *out;
+    int count;              /* results written so far */
+
+    fluid_sample_t *sample; /* looped sample for the interpolators */
+    fluid_real_t *in;       /* BENCH_BLOCKS * FLUID_BUFSIZE samples of noise */
+    fluid_real_t *out_l, *out_r;
+} bench_t;
+
+typedef double (*bench_func_t)(bench_t *bench, void *data);
+
+/* A fixed linear congruential generator, so that the input is the same on every platform */
+static unsigned int bench_seed;
+
+static unsigned int
+bench_rand(void)
+{
+    bench_seed = bench_seed * 1664525u + 1013904223u;
+    return bench_seed >> 8;
+}
+
+/* Uniform noise in [-1, 1) */
+static fluid_real_t
+bench_noise(void)
+{
+    return (fluid_real_t)((int)bench_rand() - (1 << 23)) / (fluid_real_t)(1 << 23);
+}
+
+static void
+bench_result(bench_t *bench, const char *name, const char *unit, double value, double voices_per_core)
+{
+    fprintf(bench->out, "%s\n    {\"name\": \"%s\", \"%s\": %.4f", bench->count ? "," : "", name, unit, value);
+
+    if(voices_per_core > 0.0)
+    {
+        fprintf(bench->out, ", \"voices_per_core\": %.1f", voices_per_core);
+    }
+
+    fprintf(bench->out, "}");
+    fflush(bench->out);
+    bench->count++;
+}
+
+/* Returns the fastest of the repetitions in usec, or a negative value if the benchmark failed */
+static double
+bench_run(bench_t *bench, const char *name, bench_func_t func, void *data)
+{
+    double best = -1.0, usec;
+    int i;
+
+    if(bench->filter != NULL && strstr(name, bench->filter) == NULL)
+    {
+        return -1.0;
+    }
+
+    /* warm up */
+    if(func(bench, data) < 0.0)
+    {
+        fprintf(stderr, "%s: skipped\n", name);
+        return -1.0;
+    }
+
+    for(i = 0; i < bench->repeats; i++)
+    {
+        usec = func(bench, data);
+
+        if(best < 0.0 || usec < best)
+        {
+            best = usec;
+        }
+    }
+
+    return best;
+}
+
+static void
+bench_dsp(bench_t *bench, const char *name, bench_func_t func, void *data)
+{
+    double usec = bench_run(bench, name, func, data);
+
+    if(usec >= 0.0)
+    {
+        bench_result(bench, name, "ns_per_sample", usec * 1000.0 / (BENCH_BLOCKS * FLUID_BUFSIZE), 0.0);
+    }
+}
+
+/*
+ * Interpolators
+ */
+
+static double
+bench_interp(bench_t *bench, void *data)
+{
+    fluid_rvoice_t *voice = data;
+    fluid_real_t *buf = bench->out_l;
+    double start;
+    int i;
+
+    fluid_phase_set_int(voice->dsp.phase, voice->dsp.start);
+
+    start = fluid_perf_now();
+
+    for(i = 0; i < BENCH_BLOCKS; i++)
+    {
+        fluid_rvoice_dsp_interpolate(voice, &buf[i * FLUID_BUFSIZE], TRUE);
+    }
+
+    return fluid_perf_now() - start;
+}
+
+static void
+bench_interpolators(bench_t *bench)
+{
+    static const struct
+    {
+        const char *name;
+        enum fluid_interp method;
+        int simd;
+    } kernels[] =
+    {
+        { "interp_none", FLUID_INTERP_NONE, TRUE },
+        { "interp_linear", FLUID_INTERP_LINEAR, TRUE },
+        { "interp_4thorder", FLUID_INTERP_4THORDER, TRUE },
+        { "interp_4thorder_scalar", FLUID_INTERP_4THORDER, FALSE },
+        { "interp_7thorder", FLUID_INTERP_7THORDER, TRUE },
+        { "interp_7thorder_scalar", FLUID_INTERP_7THORDER, FALSE },
+        { "interp_16thorder", FLUID_INTERP_16THORDER, TRUE }
+    };
+    fluid_rvoice_t *voice = FLUID_NEW(fluid_rvoice_t);
+    unsigned int i;
+
+    if(voice == NULL)
+    {
+        return;
+    }
+
+    FLUID_MEMSET(voice, 0, sizeof(*voice));
+    voice->dsp.sample = bench->sample;
+    voice->dsp.samplemode = FLUID_LOOP_DURING_RELEASE;
+    voice->dsp.start = bench->sample->start;
+    voice->dsp.end = bench->sample->end;
+    voice->dsp.loopstart = bench->sample->loopstart;
+    voice->dsp.loopend = bench->sample->loopend;
+    /* a fractional increment above 1, like a note played a bit higher than the root key */
+    voice->dsp.phase_incr = 1.0595f;
+
+    for(i = 0; i < FLUID_N_ELEMENTS(kernels); i++)
+    {
+        voice->dsp.interp_method = kernels[i].method;
+        fluid_rvoice_dsp_set_simd_enabled(kernels[i].simd);
+        bench_dsp(bench, kernels[i].name, bench_interp, voice);
+    }
+
+    fluid_rvoice_dsp_set_simd_enabled(TRUE);
+    FLUID_FREE(voice);
+}
+
+/*
+ * Voice filter
+ */
+
+typedef struct
+{
+    fluid_iir_filter_t filter, custom;
+    fluid_iir_sincos_t *sincos_table;
+    int sweep;
+} bench_filter_t;
+
+static double
+bench_filter(bench_t *bench, void *data)
+{
+    bench_filter_t *f = data;
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+    fluid_real_t *buf = bench->out_l;
+    double start;
+    int i;
+
+    FLUID_MEMCPY(buf, bench->in, BENCH_BLOCKS * FLUID_BUFSIZE * sizeof(fluid_real_t));
+
+    param[0].i = FLUID_IIR_LOWPASS;
+    param[1].i = 0;
+    fluid_iir_filter_init(&f->filter, param);
+    param[0].real = 9000; /* absolute cents, about 1.5 kHz */
+    fluid_iir_filter_set_fres(&f->filter, param);
+    param[0].real = 6; /* dB */
+    fluid_iir_filter_set_q(&f->filter, param);
+    f->filter.amp = 0.5f;
+    f->filter.amp_incr = 0;
+
+    start = fluid_perf_now();
+
+    for(i = 0; i < BENCH_BLOCKS; i++)
+    {
+        /* a sweep modulates the cutoff every block, like a filter envelope or LFO does */
+        fluid_iir_filter_calc(&f->filter, BENCH_SAMPLE_RATE, f->sweep ? 1200.0f * (i % 32) / 32 : 0.0f);
+        fluid_iir_filter_apply(&f->filter, &f->custom, &buf[i * FLUID_BUFSIZE], FLUID_BUFSIZE);
+    }
+
+    return fluid_perf_now() - start;
+}
+
+static void
+bench_filters(bench_t *bench)
+{
+    bench_filter_t *f = FLUID_NEW(bench_filter_t);
+
+    if(f == NULL)
+    {
+        return;
+    }
+
+    FLUID_MEMSET(f, 0, sizeof(*f));
+    f->sincos_table = FLUID_ARRAY(fluid_iir_sincos_t, SINCOS_TAB_SIZE);
+
+    if(f->sincos_table != NULL)
+    {
+        fluid_iir_filter_init_table(f->sincos_table, BENCH_SAMPLE_RATE);
+        f->filter.sincos_table = f->custom.sincos_table = f->sincos_table;
+
+        f->sweep = FALSE;
+        bench_dsp(bench, "iir_filter", bench_filter, f);
+        f->sweep = TRUE;
+        bench_dsp(bench, "iir_filter_sweep", bench_filter, f);
+    }
+
+    FLUID_FREE(f->sincos_table);
+    FLUID_FREE(f);
+}
+
+/*
+ * Mixdown of a voice to the left, right, reverb and chorus buffers
+ */
+
+static double
+bench_mix(bench_t *bench, void *data)
+{
+    fluid_rvoice_buffers_t *buffers = data;
+    fluid_real_t *dest_bufs[FLUID_RVOICE_MAX_BUFS];
+    unsigned char dest_live[FLUID_RVOICE_MAX_BUFS];
+    double start;
+    int i, b;
+
+    for(b = 0; b < FLUID_RVOICE_MAX_BUFS; b++)
+    {
+        /* the mixer buffers hold FLUID_MIXER_MAX_BUFFERS_DEFAULT blocks, wrap around within them */
+        dest_bufs[b] = &bench->out_r[b * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
+    }
+
+    start = fluid_perf_now();
+
+    for(i = 0; i < BENCH_BLOCKS; i += FLUID_MIXER_MAX_BUFFERS_DEFAULT)
+    {
+        fluid_rvoice_buffers_mix(buffers, &bench->in[i * FLUID_BUFSIZE], 0,
+                                 FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE,
+                                 dest_bufs, FLUID_RVOICE_MAX_BUFS, dest_live, NULL);
+    }
+
+    return fluid_perf_now() - start;
+}
+
+static void
+bench_mixdown(bench_t *bench)
+{
+    fluid_rvoice_buffers_t buffers;
+    unsigned int i;
+
+    FLUID_MEMSET(&buffers, 0, sizeof(buffers));
+    buffers.count = FLUID_RVOICE_MAX_BUFS;
+
+    for(i = 0; i < buffers.count; i++)
+    {
+        buffers.bufs[i].current_amp = buffers.bufs[i].target_amp = 0.25f;
+        buffers.bufs[i].mapping = i;
+    }
+
+    bench_dsp(bench, "rvoice_buffers_mix", bench_mix, &buffers);
+}
+
+/*
+ * Effects
+ */
+
+static double
+bench_reverb(bench_t *bench, void *data)
+{
+    double start = fluid_perf_now();
+    int i;
+
+    for(i = 0; i < BENCH_BLOCKS; i++)
+    {
+        fluid_revmodel_processreplace(data, &bench->in[i * FLUID_BUFSIZE],
+                                      &bench->out_l[i * FLUID_BUFSIZE], &bench->out_r[i * FLUID_BUFSIZE]);
+    }
+
+    return fluid_perf_now() - start;
+}
+
+static double
+bench_chorus(bench_t *bench, void *data)
+{
+    double start = fluid_perf_now();
+    int i;
+
+    for(i = 0; i < BENCH_BLOCKS; i++)
+    {
+        fluid_chorus_processreplace(data, &bench->in[i * FLUID_BUFSIZE],
+                                    &bench->out_l[i * FLUID_BUFSIZE], &bench->out_r[i * FLUID_BUFSIZE]);
+    }
+
+    return fluid_perf_now() - start;
+}
+
+static double
+bench_limiter(bench_t *bench, void *data)
+{
+    double start;
+    int i;
+
+    /* the limiter works in place, feed it loud stereo input so that it actually limits */
+    for(i = 0; i < BENCH_BLOCKS * FLUID_BUFSIZE; i++)
+    {
+        bench->out_l[i] = bench->out_r[i] = 4.0f * bench->in[i];
+    }
+
+    start = fluid_perf_now();
+
+    for(i = 0; i < BENCH_BLOCKS; i += FLUID_MIXER_MAX_BUFFERS_DEFAULT)
+    {
+        fluid_limiter_run(data, &bench->out_l[i * FLUID_BUFSIZE], &bench->out_r[i * FLUID_BUFSIZE],
+                          FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE, FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+    }
+
+    return fluid_perf_now() - start;
+}
+
+static void
+bench_effects(bench_t *bench)
+{
+    fluid_revmodel_t *rev;
+    fluid_chorus_t *chorus;
+    fluid_limiter_t *limiter;
+    fluid_limiter_settings_t settings;
+
+    rev = new_fluid_revmodel(BENCH_SAMPLE_RATE, BENCH_SAMPLE_RATE);
+
+    if(rev != NULL)
+    {
+        fluid_revmodel_set(rev, FLUID_REVMODEL_SET_ALL, FLUID_REVERB_DEFAULT_ROOMSIZE,
+                           FLUID_REVERB_DEFAULT_DAMP, FLUID_REVERB_DEFAULT_WIDTH, FLUID_REVERB_DEFAULT_LEVEL);
+        bench_dsp(bench, "reverb", bench_reverb, rev);
+        delete_fluid_revmodel(rev);
+    }
+
+    chorus = new_fluid_chorus(BENCH_SAMPLE_RATE);
+
+    if(chorus != NULL)
+    {
+        fluid_chorus_set(chorus, FLUID_CHORUS_SET_ALL, FLUID_CHORUS_DEFAULT_N, FLUID_CHORUS_DEFAULT_LEVEL,
+                         FLUID_CHORUS_DEFAULT_SPEED, FLUID_CHORUS_DEFAULT_DEPTH, FLUID_CHORUS_DEFAULT_TYPE);
+        bench_dsp(bench, "chorus", bench_chorus, chorus);
+        delete_fluid_chorus(chorus);
+    }
+
+    settings.input_gain = FLUID_LIMITER_DEFAULT_INPUT_GAIN;
+    settings.output_limit = FLUID_LIMITER_DEFAULT_OUTPUT_LIMIT;
+    settings.attack_ms = FLUID_LIMITER_DEFAULT_ATTACK_MS;
+    settings.hold_ms = FLUID_LIMITER_DEFAULT_HOLD_MS;
+    settings.release_ms = FLUID_LIMITER_DEFAULT_RELEASE_MS;
+    settings.smoothing_stages = FLUID_LIMITER_DEFAULT_SMOOTHING_STAGES;
+    settings.link_channels = FLUID_LIMITER_DEFAULT_LINK_CHANNELS;
+    settings.look_ahead = TRUE;
+
+    /* NULL if fluidsynth was built without LIMITER_SUPPORT */
+    limiter = new_fluid_limiter(BENCH_SAMPLE_RATE, &settings, 1);
+
+    if(limiter != NULL)
+    {
+        bench_dsp(bench, "limiter", bench_limiter, limiter);
+        delete_fluid_limiter(limiter);
+    }
+}
+
+/*
+ * Whole synth rendering to 16 bit, the number of voices it sustains per core
+ */
+
+typedef struct
+{
+    fluid_settings_t *settings;
+    int interp;
+    int notes;          /* notes to play */
+    int voices;         /* voices playing during the last run */
+    short *buf;
+} bench_synth_t;
+
+static double
+bench_write_s16(bench_t *bench, void *data)
+{
+    bench_synth_t *s = data;
+    fluid_synth_t *synth = new_fluid_synth(s->settings);
+    double start, usec;
+    int i;
+
+    if(synth == NULL || fluid_synth_sfload(synth, TEST_SOUNDFONT, TRUE) == FLUID_FAILED)
+    {
+        delete_fluid_synth(synth);
+        return -1.0;
+    }
+
+    fluid_synth_set_interp_method(synth, -1, s->interp);
+
+    /* sustained notes spread over the keyboard and the first presets of the font */
+    for(i = 0; i < s->notes; i++)
+    {
+        fluid_synth_program_change(synth, i % 16, i % 8);
+        fluid_synth_noteon(synth, i % 16, 36 + i % 84, 100);
+    }
+
+    start = fluid_perf_now();
+    fluid_synth_write_s16(synth, BENCH_SYNTH_FRAMES, s->buf, 0, 2, s->buf, 1, 2);
+    usec = fluid_perf_now() - start;
+
+    s->voices = fluid_synth_get_active_voice_count(synth);
+    delete_fluid_synth(synth);
+
+    return usec;
+}
+
+static void
+bench_synth(bench_t *bench)
+{
+    static const struct
+    {
+        const char *name;
+        int interp;
+        int effects;
+        int notes;
+    } variants[] =
+    {
+        { "synth_write_s16", FLUID_INTERP_DEFAULT, TRUE, BENCH_SYNTH_NOTES },
+        { "synth_write_s16_dry", FLUID_INTERP_DEFAULT, FALSE, BENCH_SYNTH_NOTES },
+        { "synth_write_s16_7thorder", FLUID_INTERP_7THORDER, TRUE, BENCH_SYNTH_NOTES },
+        /* the voice state no longer fits into L1, how many cache lines a voice touches matters */
+        { "synth_write_s16_dense", FLUID_INTERP_DEFAULT, FALSE, BENCH_SYNTH_DENSE_NOTES }
+    };
+    bench_synth_t s;
+    double usec, ns;
+    unsigned int i;
+
+    s.settings = new_fluid_settings();
+    s.buf = FLUID_ARRAY(short, 2 * BENCH_SYNTH_FRAMES);
+
+    if(s.settings == NULL || s.buf == NULL)
+    {
+        delete_fluid_settings(s.settings);
+        FLUID_FREE(s.buf);
+        return;
+    }
+
+    /* a single core, the voices per core are extrapolated from it */
+    fluid_settings_setint(s.settings, "synth.cpu-cores", 1);
+    fluid_settings_setint(s.settings, "synth.polyphony", 256);
+    fluid_settings_setnum(s.settings, "synth.sample-rate", BENCH_SAMPLE_RATE);
+
+    for(i = 0; i < FLUID_N_ELEMENTS(variants); i++)
+    {
+        fluid_settings_setint(s.settings, "synth.reverb.active", variants[i].effects);
+        fluid_settings_setint(s.settings, "synth.chorus.active", variants[i].effects);
+        s.interp = variants[i].interp;
+        s.notes = variants[i].notes;
+        s.voices = 0;
+
+        usec = bench_run(bench, variants[i].name, bench_write_s16, &s);
+
+        if(usec < 0.0 || s.voices <= 0)
+        {
+            continue;
+        }
+
+        /* time per frame of a single voice, effects and the conversion included */
+        ns = usec * 1000.0 / BENCH_SYNTH_FRAMES / s.voices;
+        bench_result(bench, variants[i].name, "ns_per_sample", ns, 1e9 / (ns * BENCH_SAMPLE_RATE));
+    }
+
+    delete_fluid_settings(s.settings);
+    FLUID_FREE(s.buf);
+}
+
+/*
+ * Sequencer queue
+ */
+
+typedef struct
+{
+    int pop;            /* TRUE to time the dispatching of the events instead of their insertion */
+    int dispatched;
+} bench_seq_t;
+
+static void
+bench_seq_callback(unsigned int time, fluid_event_t *event, fluid_sequencer_t *seq, void *data)
+{
+    ((bench_seq_t *)data)->dispatched++;
+}
+
+static double
+bench_seq(bench_t *bench, void *data)
+{
+    bench_seq_t *s = data;
+    fluid_sequencer_t *seq = new_fluid_sequencer2(FALSE);
+    fluid_event_t *evt = new_fluid_event();
+    fluid_seq_id_t client;
+    double start, insert, pop;
+    int i, dispatched;
+
+    if(seq == NULL || evt == NULL)
+    {
+        delete_fluid_event(evt);
+        delete_fluid_sequencer(seq);
+        return -1.0;
+    }
+
+    client = fluid_sequencer_register_client(seq, "bench", bench_seq_callback, s);
+    fluid_event_set_source(evt, -1);
+    fluid_event_set_dest(evt, client);
+    s->dispatched = 0;
+    bench_seed = 1;
+
+    /* events in random order over 10 seconds, as a MIDI file player or an arpeggiator produces them */
+    start = fluid_perf_now();
+
+    for(i = 0; i < BENCH_SEQ_EVENTS; i++)
+    {
+        fluid_event_noteon(evt, i % 16, i % 128, 100);
+        fluid_sequencer_send_at(seq, evt, 1 + bench_rand() % 10000, TRUE);
+    }
+
+    insert = fluid_perf_now() - start;
+
+    start = fluid_perf_now();
+
+    for(i = 1; i <= 10000; i++)
+    {
+        fluid_sequencer_process(seq, i);
+    }
+
+    pop = fluid_perf_now() - start;
+    dispatched = s->dispatched;
+
+    delete_fluid_sequencer(seq);
+    delete_fluid_event(evt);
+
+    if(dispatched != BENCH_SEQ_EVENTS)
+    {
+        return -1.0;
+    }
+
+    return s->pop ? pop : insert;
+}
+
+static void
+bench_sequencer(bench_t *bench)
+{
+    bench_seq_t s;
+    double usec;
+
+    /* the queue copies the events into its nodes, their size drives its cache footprint */
+    if(bench->filter == NULL || strstr("seq_event_size", bench->filter) != NULL)
+    {
+        bench_result(bench, "seq_event_size", "bytes", (double)sizeof(fluid_event_t), 0.0);
+    }
+
+    s.pop = FALSE;
+    usec = bench_run(bench, "seq_insert", bench_seq, &s);
+
+    if(usec >= 0.0)
+    {
+        bench_result(bench, "seq_insert", "ns_per_op", usec * 1000.0 / BENCH_SEQ_EVENTS, 0.0);
+    }
+
+    s.pop = TRUE;
+    usec = bench_run(bench, "seq_pop", bench_seq, &s);
+
+    if(usec >= 0.0)
+    {
+        bench_result(bench, "seq_pop", "ns_per_op", usec * 1000.0 / BENCH_SEQ_EVENTS, 0.0);
+    }
+}
+
+/*
+ * Hash tables
+ */
+
+typedef struct
+{
+    const char *name;
+    int strings;            /* setting-like string keys, otherwise pointer keys */
+    int lookup;             /* time the lookups instead of the inserts */
+} bench_hash_t;
+
+static char bench_hash_keys[BENCH_HASH_KEYS][32];
+
+static void *
+bench_hash_key(const bench_hash_t *h, int i)
+{
+    /* pointers to aligned objects have their low bits clear */
+    return h->strings ? (void *)bench_hash_keys[i] : FLUID_INT_TO_POINTER((i + 1) * 64);
+}
+
+static double
+bench_hash(bench_t *bench, void *data)
+{
+    bench_hash_t *h = data;
+    fluid_hashtable_t *table;
+    double start, insert, lookup;
+    int i, r, found = 0;
+
+    table = h->strings ? new_fluid_hashtable(fluid_str_hash, fluid_str_equal)
+            : new_fluid_hashtable(NULL, NULL);
+
+    if(table == NULL)
+    {
+        return -1.0;
+    }
+
+    start = fluid_perf_now();
+
+    for(i = 0; i < BENCH_HASH_KEYS; i++)
+    {
+        fluid_hashtable_insert(table, bench_hash_key(h, i), FLUID_INT_TO_POINTER(i + 1));
+    }
+
+    insert = fluid_perf_now() - start;
+
+    start = fluid_perf_now();
+
+    for(r = 0; r < BENCH_HASH_ROUNDS; r++)
+    {
+        for(i = 0; i < BENCH_HASH_KEYS; i++)
+        {
+            /* an odd stride visits every key in an order unrelated to the inserts */
+            int k = (i * 2053) % BENCH_HASH_KEYS;
+            found += (fluid_hashtable_lookup(table, bench_hash_key(h, k)) == FLUID_INT_TO_POINTER(k + 1));
+        }
+    }
+
+    lookup = fluid_perf_now() - start;
+
+    delete_fluid_hashtable(table);
+
+    if(found != BENCH_HASH_ROUNDS * BENCH_HASH_KEYS)
+    {
+        return -1.0;
+    }
+
+    return h->lookup ? lookup : insert;
+}
+
+static void
+bench_hashtables(bench_t *bench)
+{
+    static bench_hash_t variants[] =
+    {
+        { "hash_insert_str", TRUE, FALSE },
+        { "hash_lookup_str", TRUE, TRUE },
+        { "hash_insert_ptr", FALSE, FALSE },
+        { "hash_lookup_ptr", FALSE, TRUE }
+    };
+    double usec;
+    unsigned int i;
+
+    for(i = 0; i < BENCH_HASH_KEYS; i++)
+    {
+        FLUID_SNPRINTF(bench_hash_keys[i], sizeof(bench_hash_keys[i]), "synth.setting-%u", i);
+    }
+
+    for(i = 0; i < FLUID_N_ELEMENTS(variants); i++)
+    {
+        usec = bench_run(bench, variants[i].name, bench_hash, &variants[i]);
+
+        if(usec >= 0.0)
+        {
+            bench_result(bench, variants[i].name, "ns_per_op", usec * 1000.0 /
+                         (variants[i].lookup ? BENCH_HASH_ROUNDS * BENCH_HASH_KEYS : BENCH_HASH_KEYS), 0.0);
+        }
+    }
+}
+
+/*
+ * SoundFont loading
+ */
+
+typedef struct
+{
+    const char *name;
+    const char *file;
+} bench_font_t;
+
+static double
+bench_sfload(bench_t *bench, void *data)
+{
+    bench_font_t *font = data;
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    double start, usec = -1.0;
+
+    if(synth != NULL)
+    {
+        start = fluid_perf_now();
+
+        if(fluid_synth_sfload(synth, font->file, TRUE) != FLUID_FAILED)
+        {
+            usec = fluid_perf_now() - start;
+        }
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return usec;
+}
+
+static void
+bench_soundfonts(bench_t *bench)
+{
+    static bench_font_t fonts[] =
+    {
+        { "sfload_sf2", TEST_SOUNDFONT },
+        /* skipped if fluidsynth was built without SF3 support */
+        { "sfload_sf3", TEST_SOUNDFONT_SF3 }
+    };
+    double usec;
+    unsigned int i;
+
+    for(i = 0; i < FLUID_N_ELEMENTS(fonts); i++)
+    {
+        usec = bench_run(bench, fonts[i].name, bench_sfload, &fonts[i]);
+
+        if(usec >= 0.0)
+        {
+            bench_result(bench, fonts[i].name, "ns_per_op", usec * 1000.0, 0.0);
+        }
+    }
+}
+
+/*
+ * MIDI file loading
+ */
+
+typedef struct
+{
+    unsigned char *file;
+    int size;
+} bench_midi_t;
+
+/* A format 1 file with many tracks of notes and controllers, as a sequencer exports it */
+static int
+bench_new_midi_file(bench_midi_t *m)
+{
+    unsigned char *p;
+    int i, track, len = BENCH_MIDI_EVENTS * 4 + 4;
+
+    m->size = 14 + BENCH_MIDI_TRACKS * (8 + len);
+    m->file = FLUID_MALLOC(m->size);
+
+    if(m->file == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMCPY(m->file, "MThd\0\0\0\6\0\1", 10);
+    m->file[10] = BENCH_MIDI_TRACKS >> 8;
+    m->file[11] = BENCH_MIDI_TRACKS & 0xff;
+    m->file[12] = 0;
+    m->file[13] = 96;
+    p = m->file + 14;
+    bench_seed = 1;
+
+    for(track = 0; track < BENCH_MIDI_TRACKS; track++)
+    {
+        FLUID_MEMCPY(p, "MTrk", 4);
+        p[4] = len >> 24;
+        p[5] = len >> 16;
+        p[6] = len >> 8;
+        p[7] = len;
+        p += 8;
+
+        for(i = 0; i < BENCH_MIDI_EVENTS; i++)
+        {
+            *p++ = bench_rand() % 16;
+            *p++ = ((i % 4 == 3) ? 0xb0 : 0x90) | (track % 16);
+            *p++ = bench_rand() % 128;
+            *p++ = bench_rand() % 128;
+        }
+
+        FLUID_MEMCPY(p, "\0\377\57\0", 4);
+        p += 4;
+    }
+
+    return FLUID_OK;
+}
+
+static double
+bench_midi_load(bench_t *bench, void *data)
+{
+    bench_midi_t *m = data;
+    static float buf[FLUID_BUFSIZE];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    fluid_player_t *player = (synth != NULL) ? new_fluid_player(synth) : NULL;
+    double start, usec = -1.0;
+
+    if(player != NULL && fluid_player_add_mem(player, m->file, m->size) == FLUID_OK)
+    {
+        start = fluid_perf_now();
+
+        /* the player loads the first file of its playlist when it's called by the synth */
+        if(fluid_player_play(player) == FLUID_OK
+                && fluid_synth_write_float(synth, FLUID_BUFSIZE, buf, 0, 1, buf, 0, 1) == FLUID_OK
+                && fluid_player_get_total_ticks(player) > 0)
+        {
+            usec = fluid_perf_now() - start;
+        }
+
+        fluid_player_stop(player);
+    }
+
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return usec;
+}
+
+static void
+bench_midi_files(bench_t *bench)
+{
+    bench_midi_t m;
+    double usec;
+
+    if(bench_new_midi_file(&m) != FLUID_OK)
+    {
+        return;
+    }
+
+    usec = bench_run(bench, "midi_load", bench_midi_load, &m);
+
+    if(usec >= 0.0)
+    {
+        bench_result(bench, "midi_load", "ns_per_op", usec * 1000.0 / (BENCH_MIDI_TRACKS * BENCH_MIDI_EVENTS), 0.0);
+    }
+
+    FLUID_FREE(m.file);
+}
+
+/* A looped sample with harmonics and some noise, so that no kernel sees trivial input */
+static fluid_sample_t *
+bench_new_sample(void)
+{
+    fluid_sample_t *sample = new_fluid_sample();
+    short *data = FLUID_ARRAY(short, BENCH_SAMPLE_FRAMES);
+    int i;
+
+    if(sample == NULL || data == NULL)
+    {
+        delete_fluid_sample(sample);
+        FLUID_FREE(data);
+        return NULL;
+    }
+
+    for(i = 0; i < BENCH_SAMPLE_FRAMES; i++)
+    {
+        double ph = 2.0 * M_PI * i / 128.0;
+        data[i] = (short)(12000.0 * sin(ph) + 6000.0 * sin(3.0 * ph) + 2000.0 * bench_noise());
+    }
+
+    if(fluid_sample_set_sound_data(sample, data, NULL, BENCH_SAMPLE_FRAMES, BENCH_SAMPLE_RATE, TRUE) != FLUID_OK
+            || fluid_sample_set_loop(sample, sample->start + 64, sample->end - 64) != FLUID_OK)
+    {
+        delete_fluid_sample(sample);
+        sample = NULL;
+    }
+
+    FLUID_FREE(data);
+    return sample;
+}
+
+static void
+print_usage(void)
+{
+    fprintf(stderr, "Usage: fluid_bench [-r repeats] [-o file.json] [name-filter]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bench_t bench;
+    const char *out_name = NULL;
+    void *in = NULL, *out_l = NULL, *out_r = NULL;
+    int len = BENCH_BLOCKS * FLUID_BUFSIZE;
+    int i, ret = EXIT_FAILURE;
+
+    FLUID_MEMSET(&bench, 0, sizeof(bench));
+    bench.repeats = BENCH_DEFAULT_REPEATS;
+    bench.out = stdout;
+
+    for(i = 1; i < argc; i++)
+    {
+        if(FLUID_STRCMP(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            bench.repeats = atoi(argv[++i]);
+        }
+        else if(FLUID_STRCMP(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            out_name = argv[++i];
+        }
+        else if(argv[i][0] == '-')
+        {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+        else
+        {
+            bench.filter = argv[i];
+        }
+    }
+
+    if(bench.repeats < 1)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    /* only errors, the synth benchmarks would otherwise log every soundfont load */
+    for(i = FLUID_WARN; i < LAST_LOG_LEVEL; i++)
+    {
+        fluid_set_log_function(i, NULL, NULL);
+    }
+
+    bench_seed = 1;
+    bench.sample = bench_new_sample();
+
+    /* the kernels expect buffers aligned like the mixer's */
+    in = FLUID_MALLOC(len * sizeof(fluid_real_t) + FLUID_DEFAULT_ALIGNMENT);
+    out_l = FLUID_MALLOC(len * sizeof(fluid_real_t) + FLUID_DEFAULT_ALIGNMENT);
+    out_r = FLUID_MALLOC(len * sizeof(fluid_real_t) + FLUID_DEFAULT_ALIGNMENT);
+
+    if(bench.sample == NULL || in == NULL || out_l == NULL || out_r == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        goto cleanup;
+    }
+
+    bench.in = fluid_align_ptr(in, FLUID_DEFAULT_ALIGNMENT);
+    bench.out_l = fluid_align_ptr(out_l, FLUID_DEFAULT_ALIGNMENT);
+    bench.out_r = fluid_align_ptr(out_r, FLUID_DEFAULT_ALIGNMENT);
+
+    for(i = 0; i < len; i++)
+    {
+        bench.in[i] = bench_noise();
+    }
+
+    if(out_name != NULL && (bench.out = FLUID_FOPEN(out_name, "w")) == NULL)
+    {
+        fprintf(stderr, "Failed to open '%s'\n", out_name);
+        bench.out = stdout;
+        goto cleanup;
+    }
+
+    fprintf(bench.out, "{\n  \"version\": \"%s\",\n  \"sample_rate\": %d,\n  \"bufsize\": %d,\n"
+            "  \"repeats\": %d,\n  \"results\": [", fluid_version_str(), BENCH_SAMPLE_RATE,
+            FLUID_BUFSIZE, bench.repeats);
+
+    bench_interpolators(&bench);
+    bench_filters(&bench);
+    bench_mixdown(&bench);
+    bench_effects(&bench);
+    bench_synth(&bench);
+    bench_sequencer(&bench);
+    bench_hashtables(&bench);
+    bench_soundfonts(&bench);
+    bench_midi_files(&bench);
+
+    fprintf(bench.out, "\n  ]\n}\n");
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    if(bench.out != stdout)
+    {
+        fclose(bench.out);
+    }
+
+    delete_fluid_sample(bench.sample);
+    FLUID_FREE(in);
+    FLUID_FREE(out_l);
+    FLUID_FREE(out_r);
+
+    return ret;
+}
@@ -0,0 +1,522 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * End-to-end polyphony benchmark.
+ *
+ * Usage: fluid_polyphony [options] [workload-filter]
+ *
+ *   -c cores      synth.cpu-cores (default 1)
+ *   -i interp     interpolation method: 0, 1, 4 or 7 (default 4)
+ *   -l percent    CPU load the render may take at most to be stable (default 80)
+ *   -p frames     period size (default 64)
+ *   -d seconds    audio rendered by each measurement (default 1)
+ *   -n notes      notes played for the realtime factor (default 128)
+ *   -m voices     upper bound of the polyphony search (default 4096)
+ *   -f file       SoundFont of the SF2 workloads
+ *   -o file.json  write the results to a file instead of stdout
+ *
+ * Canned workloads are rendered period by period, with their MIDI events sent before
+ * each period just like a driver would render them:
+ *
+ *   pads        sustained notes on all channels
+ *   percussive  short notes retriggered in bursts, most voices are in their release
+ *   modulation  sustained notes with pitch bend, pressure and CCs changing every period
+ *   pads_sf3    the sustained notes rendered from the SF3 version of the test font
+ *
+ * For each workload the realtime factor at a fixed number of notes is measured, then the
+ * number of notes is searched for the largest one whose periods are rendered within the
+ * given share of the period duration, except for 1% of them. The active voices of that
+ * measurement are the maximum stable polyphony.
+ *
+ * Build with "make fluid_polyphony", or build and run with "make bench_polyphony".
+ */
+
+#include "fluidsynth.h"
+#include "fluid_sys.h"
+#include "utils/fluid_perf.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define POLY_SAMPLE_RATE 44100
+#define POLY_WARMUP_SEC 0.25    /* rendered before measuring, so that the attacks have passed */
+#define POLY_MIN_NOTES 8
+#define POLY_STRIKE_RATE 4      /* strikes per second of each note of the percussive workload */
+#define POLY_CC_RATE 100        /* controller updates per second of the modulation workload */
+
+typedef struct _poly_t poly_t;
+
+typedef struct
+{
+    const char *name;
+    int sf3;
+    int voices_per_note;    /* voices a note may have at most, including the ones in their release */
+    void (*start)(poly_t *poly, fluid_synth_t *synth, int notes);
+    void (*period)(poly_t *poly, fluid_synth_t *synth, int notes, int idx);
+} poly_workload_t;
+
+struct _poly_t
+{
+    /* options */
+    int cores;
+    int interp;
+    double load;
+    int period_size;
+    double duration;
+    int ref_notes;
+    int max_voices;
+    const char *sf2, *sf3;
+
+    fluid_settings_t *settings;
+    float *left, *right;
+    double *times;          /* render time of each measured period in usec */
+    int periods;            /* periods measured */
+
+    unsigned int seed;
+    int next_note;          /* round robin position of the percussive workload */
+    double strikes;         /* strikes of the percussive workload due but not played yet */
+
+    /* results of the last measurement */
+    double voices;          /* average active voices */
+    double realtime_factor; /* audio duration divided by the render time */
+    double p99;             /* 99th percentile of the period render times in usec */
+};
+
+static const int poly_programs[] = { 0, 16, 19, 48, 50, 52, 88, 89 };
+
+static unsigned int
+poly_rand(poly_t *poly)
+{
+    poly->seed = poly->seed * 1664525u + 1013904223u;
+    return poly->seed >> 8;
+}
+
+/* Channel and key of the i-th note, spread over all channels and most of the keyboard */
+static void
+poly_note(int i, int *chan, int *key)
+{
+    *chan = i % 16;
+    *key = 24 + (i / 16) % 84;
+}
+
+static void
+poly_setup_channels(fluid_synth_t *synth)
+{
+    int chan;
+
+    for(chan = 0; chan < 16; chan++)
+    {
+        fluid_synth_program_change(synth, chan, poly_programs[chan % FLUID_N_ELEMENTS(poly_programs)]);
+        fluid_synth_cc(synth, chan, 10, (chan * 8) % 128); /* pan */
+    }
+}
+
+/*
+ * Workloads
+ */
+
+static void
+poly_pads_start(poly_t *poly, fluid_synth_t *synth, int notes)
+{
+    int i, chan, key;
+
+    for(i = 0; i < notes; i++)
+    {
+        poly_note(i, &chan, &key);
+        fluid_synth_noteon(synth, chan, key, 60 + poly_rand(poly) % 60);
+    }
+}
+
+static void
+poly_pads_period(poly_t *poly, fluid_synth_t *synth, int notes, int idx)
+{
+}
+
+static void
+poly_percussive_start(poly_t *poly, fluid_synth_t *synth, int notes)
+{
+    poly->next_note = 0;
+    poly->strikes = 0.0;
+    poly_pads_start(poly, synth, notes);
+}
+
+/* Releases the oldest notes and strikes them again, so that each note is struck
+ * POLY_STRIKE_RATE times a second. The strikes due within a period are sent as a burst. */
+static void
+poly_percussive_period(poly_t *poly, fluid_synth_t *synth, int notes, int idx)
+{
+    int chan, key;
+
+    poly->strikes += (double)notes * POLY_STRIKE_RATE * poly->period_size / POLY_SAMPLE_RATE;
+
+    for(; poly->strikes >= 1.0; poly->strikes -= 1.0)
+    {
+        poly_note(poly->next_note, &chan, &key);
+        fluid_synth_noteoff(synth, chan, key);
+        fluid_synth_noteon(synth, chan, key, 40 + poly_rand(poly) % 88);
+        poly->next_note = (poly->next_note + 1) % notes;
+    }
+}
+
+/* Moves pitch bend, pressure and several controllers of each channel POLY_CC_RATE times a second */
+static void
+poly_modulation_period(poly_t *poly, fluid_synth_t *synth, int notes, int idx)
+{
+    int interval = POLY_SAMPLE_RATE / POLY_CC_RATE / poly->period_size;
+    int chan, val;
+
+    if(interval > 1)
+    {
+        if(idx % interval != 0)
+        {
+            return;
+        }
+
+        idx /= interval;
+    }
+
+    for(chan = 0; chan < 16; chan++)
+    {
+        /* triangle waves of different speed for each channel */
+        val = (idx * (chan + 1)) % 256;
+        val = (val < 128) ? val : 255 - val;
+
+        fluid_synth_pitch_bend(synth, chan, 8192 + (val - 64) * 32);
+        fluid_synth_channel_pressure(synth, chan, val);
+        fluid_synth_cc(synth, chan, 1, val);        /* modulation wheel */
+        fluid_synth_cc(synth, chan, 7, 64 + val / 2); /* volume */
+        fluid_synth_cc(synth, chan, 11, 127 - val / 2); /* expression */
+        fluid_synth_cc(synth, chan, 10, val);       /* pan */
+    }
+}
+
+static const poly_workload_t poly_workloads[] =
+{
+    { "pads", FALSE, 4, poly_pads_start, poly_pads_period },
+    { "percussive", FALSE, 16, poly_percussive_start, poly_percussive_period },
+    { "modulation", FALSE, 4, poly_pads_start, poly_modulation_period },
+    { "pads_sf3", TRUE, 4, poly_pads_start, poly_pads_period }
+};
+
+/*
+ * Measurement
+ */
+
+static int
+poly_compare_times(const void *a, const void *b)
+{
+    double ta = *(const double *)a, tb = *(const double *)b;
+
+    return (ta > tb) - (ta < tb);
+}
+
+/* Renders a workload with the given number of notes, returns FLUID_FAILED if it couldn't be set up */
+static int
+poly_measure(poly_t *poly, const poly_workload_t *workload, int notes)
+{
+    fluid_synth_t *synth;
+    int warmup = (int)(POLY_WARMUP_SEC * POLY_SAMPLE_RATE / poly->period_size);
+    int polyphony = notes * workload->voices_per_note;
+    double start, total = 0.0, voices = 0.0;
+    int i;
+
+    /* Just enough voices for the workload: every MIDI event visits all of them, an
+     * oversized polyphony would be measured rather than the rendering. */
+    fluid_settings_setint(poly->settings, "synth.polyphony", (polyphony < 65535) ? polyphony : 65535);
+    synth = new_fluid_synth(poly->settings);
+
+    if(synth == NULL || fluid_synth_sfload(synth, workload->sf3 ? poly->sf3 : poly->sf2, TRUE) == FLUID_FAILED)
+    {
+        delete_fluid_synth(synth);
+        return FLUID_FAILED;
+    }
+
+    fluid_synth_set_interp_method(synth, -1, poly->interp);
+    /* keep the mix of many voices from clipping, it doesn't change the work done */
+    fluid_synth_set_gain(synth, 0.05f);
+    poly_setup_channels(synth);
+
+    poly->seed = 1;
+    workload->start(poly, synth, notes);
+
+    for(i = 0; i < warmup + poly->periods; i++)
+    {
+        start = fluid_perf_now();
+
+        workload->period(poly, synth, notes, i);
+        fluid_synth_write_float(synth, poly->period_size, poly->left, 0, 1, poly->right, 0, 1);
+
+        if(i >= warmup)
+        {
+            poly->times[i - warmup] = fluid_perf_now() - start;
+            total += poly->times[i - warmup];
+            voices += fluid_synth_get_active_voice_count(synth);
+        }
+    }
+
+    delete_fluid_synth(synth);
+
+    poly->voices = voices / poly->periods;
+    poly->realtime_factor = (total > 0.0) ? poly->periods * poly->period_size * 1e6 / POLY_SAMPLE_RATE / total : 0.0;
+
+    qsort(poly->times, poly->periods, sizeof(double), poly_compare_times);
+    poly->p99 = poly->times[poly->periods - 1 - poly->periods / 100];
+
+    return FLUID_OK;
+}
+
+/* TRUE if all periods but 1% were rendered within the allowed share of the period duration */
+static int
+poly_is_stable(poly_t *poly)
+{
+    return poly->p99 <= poly->load * poly->period_size * 1e6 / POLY_SAMPLE_RATE;
+}
+
+/* Searches the largest stable number of notes, returns its average active voices */
+static double
+poly_max_stable(poly_t *poly, const poly_workload_t *workload)
+{
+    int lo = 0, hi, notes = POLY_MIN_NOTES;
+    double lo_voices = 0.0;
+
+    /* double the notes until the render can't keep up anymore */
+    while(1)
+    {
+        if(poly_measure(poly, workload, notes) != FLUID_OK)
+        {
+            return -1.0;
+        }
+
+        if(!poly_is_stable(poly))
+        {
+            break;
+        }
+
+        lo = notes;
+        lo_voices = poly->voices;
+
+        if(poly->voices >= poly->max_voices)
+        {
+            return lo_voices;
+        }
+
+        notes *= 2;
+    }
+
+    hi = notes;
+
+    /* then narrow it down to about 3% */
+    while(hi - lo > lo / 32 + 1)
+    {
+        notes = lo + (hi - lo) / 2;
+
+        if(poly_measure(poly, workload, notes) != FLUID_OK)
+        {
+            return -1.0;
+        }
+
+        if(poly_is_stable(poly))
+        {
+            lo = notes;
+            lo_voices = poly->voices;
+        }
+        else
+        {
+            hi = notes;
+        }
+    }
+
+    return lo_voices;
+}
+
+static void
+print_usage(void)
+{
+    fprintf(stderr, "Usage: fluid_polyphony [-c cores] [-i interp] [-l percent] [-p frames] [-d seconds]\n"
+            "                       [-n notes] [-m voices] [-f soundfont] [-o file.json] [workload-filter]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    poly_t poly;
+    const char *filter = NULL, *out_name = NULL;
+    FILE *out = stdout;
+    double rt_factor, rt_voices, max_voices;
+    int i, count = 0, ret = EXIT_FAILURE;
+
+    FLUID_MEMSET(&poly, 0, sizeof(poly));
+    poly.cores = 1;
+    poly.interp = FLUID_INTERP_DEFAULT;
+    poly.load = 0.8;
+    poly.period_size = 64;
+    poly.duration = 1.0;
+    poly.ref_notes = 128;
+    poly.max_voices = 4096;
+    poly.sf2 = TEST_SOUNDFONT;
+    poly.sf3 = TEST_SOUNDFONT_SF3;
+
+    for(i = 1; i < argc; i++)
+    {
+        if(argv[i][0] == '-' && argv[i][1] != '\0' && argv[i][2] == '\0' && i + 1 < argc)
+        {
+            const char *arg = argv[++i];
+
+            switch(argv[i - 1][1])
+            {
+            case 'c':
+                poly.cores = atoi(arg);
+                break;
+
+            case 'i':
+                poly.interp = atoi(arg);
+                break;
+
+            case 'l':
+                poly.load = atof(arg) / 100.0;
+                break;
+
+            case 'p':
+                poly.period_size = atoi(arg);
+                break;
+
+            case 'd':
+                poly.duration = atof(arg);
+                break;
+
+            case 'n':
+                poly.ref_notes = atoi(arg);
+                break;
+
+            case 'm':
+                poly.max_voices = atoi(arg);
+                break;
+
+            case 'f':
+                poly.sf2 = arg;
+                break;
+
+            case 'o':
+                out_name = arg;
+                break;
+
+            default:
+                print_usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if(argv[i][0] == '-')
+        {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+
+    poly.periods = (int)(poly.duration * POLY_SAMPLE_RATE / (poly.period_size > 0 ? poly.period_size : 1));
+
+    if(poly.cores < 1 || poly.load <= 0.0 || poly.period_size < 1 || poly.periods < 1
+            || poly.ref_notes < 1 || poly.max_voices < POLY_MIN_NOTES)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    /* only errors, every measurement loads the soundfont again */
+    for(i = FLUID_WARN; i < LAST_LOG_LEVEL; i++)
+    {
+        fluid_set_log_function(i, NULL, NULL);
+    }
+
+    poly.settings = new_fluid_settings();
+    poly.left = FLUID_ARRAY(float, poly.period_size);
+    poly.right = FLUID_ARRAY(float, poly.period_size);
+    poly.times = FLUID_ARRAY(double, poly.periods);
+
+    if(poly.settings == NULL || poly.left == NULL || poly.right == NULL || poly.times == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        goto cleanup;
+    }
+
+    fluid_settings_setnum(poly.settings, "synth.sample-rate", POLY_SAMPLE_RATE);
+
+    if(fluid_settings_setint(poly.settings, "synth.cpu-cores", poly.cores) != FLUID_OK)
+    {
+        fprintf(stderr, "Invalid number of cores %d\n", poly.cores);
+        goto cleanup;
+    }
+
+    if(out_name != NULL && (out = FLUID_FOPEN(out_name, "w")) == NULL)
+    {
+        fprintf(stderr, "Failed to open '%s'\n", out_name);
+        out = stdout;
+        goto cleanup;
+    }
+
+    fprintf(out, "{\n  \"version\": \"%s\",\n  \"sample_rate\": %d,\n  \"period_size\": %d,\n"
+            "  \"cpu_cores\": %d,\n  \"interpolation\": %d,\n  \"cpu_load\": %.0f,\n  \"duration\": %.2f,\n"
+            "  \"results\": [", fluid_version_str(), POLY_SAMPLE_RATE, poly.period_size,
+            poly.cores, poly.interp, poly.load * 100.0, poly.duration);
+
+    for(i = 0; i < (int)FLUID_N_ELEMENTS(poly_workloads); i++)
+    {
+        const poly_workload_t *workload = &poly_workloads[i];
+
+        if(filter != NULL && strstr(workload->name, filter) == NULL)
+        {
+            continue;
+        }
+
+        if(poly_measure(&poly, workload, poly.ref_notes) != FLUID_OK)
+        {
+            fprintf(stderr, "%s: skipped\n", workload->name);
+            continue;
+        }
+
+        rt_factor = poly.realtime_factor;
+        rt_voices = poly.voices;
+        max_voices = poly_max_stable(&poly, workload);
+
+        fprintf(out, "%s\n    {\"workload\": \"%s\", \"voices\": %.1f, \"realtime_factor\": %.2f, "
+                "\"max_stable_voices\": %.1f, \"voices_per_core\": %.1f}",
+                count ? "," : "", workload->name, rt_voices, rt_factor, max_voices, max_voices / poly.cores);
+        fflush(out);
+        count++;
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    if(out != stdout)
+    {
+        fclose(out);
+    }
+
+    delete_fluid_settings(poly.settings);
+    FLUID_FREE(poly.left);
+    FLUID_FREE(poly.right);
+    FLUID_FREE(poly.times);
+
+    return ret;
+}
@@ -0,0 +1,519 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * SoundFont loading benchmark.
+ *
+ * Usage: fluid_sfload [options] [file ...]
+ *
+ *   -t threads    comma separated thread counts, each sets synth.cpu-cores and the number
+ *                 of OpenMP threads decoding and importing in parallel (default 1)
+ *   -d modes      comma separated values of synth.dynamic-sample-loading (default 0,1)
+ *   -r repeats    loads measured per configuration (default 3)
+ *   -o file.json  write the results to a file instead of stdout
+ *
+ * Without files, the SF2, SF3 and DLS versions of the test SoundFont are loaded. Each
+ * file is loaded with every combination of thread count, dynamic sample loading and
+ * cache mode:
+ *
+ *   cold     the file isn't loaded yet, its samples are read and decoded
+ *   shared   another synth has the file loaded, its samples come from the sample cache
+ *
+ * The files are read once before, so that they are in the page cache of the OS and the
+ * disk isn't measured. Of the repeated loads of a configuration the fastest is reported:
+ *
+ *   wall_ms      time fluid_synth_sfload() took
+ *   cpu_ms       CPU time of all threads of the process meanwhile
+ *   peak_rss_kb  largest resident memory of the process while loading, on Linux since the
+ *                start of the load, elsewhere since the start of the process
+ *   base_rss_kb  resident memory of the process before loading, on Linux only, so that
+ *                the memory taken by the load is the difference
+ *   phases_ms    time spent in the phases of the loaders, summed over the threads:
+ *                  sffile_open             parsing the structure of an SF2 or SF3 file, or
+ *                                          finding out that a file is none
+ *                  defsfont_import         importing its presets and instruments
+ *                  load_sampledata         loading all of its samples
+ *                  sample_decode           decoding its Ogg Vorbis samples (SF3)
+ *                  load_preset_samples     loading the samples of the selected presets
+ *                  dls_load                loading a DLS file, including its samples
+ *                  dls_load_sampledata     loading the waves of a DLS file
+ *                  dls_convert_sampledata  converting them to 16 bit
+ *
+ * Build with "make fluid_sfload", or build and run with "make bench_sfload".
+ */
+
+#include "fluidsynth.h"
+#include "fluid_sys.h"
+#include "utils/fluid_perf.h"
+#include "utils/fluid_trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if HAVE_OPENMP
+#include <omp.h>
+#endif
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define SFLOAD_MAX_VALUES 16        /* thread counts and modes given on the command line */
+#define SFLOAD_TRACE_EVENTS 65536   /* spans recorded per thread, samples are decoded one by one */
+
+static const char *const sfload_phases[] =
+{
+    "sffile_open",
+    "defsfont_import",
+    "load_sampledata",
+    "sample_decode",
+    "load_preset_samples",
+    "dls_load",
+    "dls_load_sampledata",
+    "dls_convert_sampledata"
+};
+
+typedef struct
+{
+    double wall;                /* usec */
+    double cpu;                 /* usec */
+    long peak_rss;              /* kB */
+    long base_rss;              /* kB */
+    double phases[FLUID_N_ELEMENTS(sfload_phases)];
+    int phase_counts[FLUID_N_ELEMENTS(sfload_phases)];
+} sfload_result_t;
+
+/* CPU time of all threads of the process in usec */
+static double
+sfload_cpu_time(void)
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    ULARGE_INTEGER k, u;
+
+    if(!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        return 0.0;
+    }
+
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+
+    /* in units of 100 ns */
+    return (double)(k.QuadPart + u.QuadPart) / 10.0;
+#else
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000.0
+           + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+/* Starts measuring the peak resident memory anew, where the OS allows it */
+static void
+sfload_reset_peak_rss(void)
+{
+#if defined(__linux__)
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+
+    if(file != NULL)
+    {
+        fputs("5", file);
+        fclose(file);
+    }
+#endif
+}
+
+#if defined(__linux__)
+/* Reads a size in kB of /proc/self/status, 0 if unknown */
+static long
+sfload_proc_status(const char *field)
+{
+    char line[128];
+    long kb = 0;
+    size_t len = strlen(field);
+    FILE *file = fopen("/proc/self/status", "r");
+
+    if(file == NULL)
+    {
+        return 0;
+    }
+
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        if(strncmp(line, field, len) == 0)
+        {
+            kb = atol(line + len);
+            break;
+        }
+    }
+
+    fclose(file);
+    return kb;
+}
+#endif
+
+/* Resident memory in kB, 0 if unknown */
+static long
+sfload_rss(void)
+{
+#if defined(__linux__)
+    return sfload_proc_status("VmRSS:");
+#else
+    return 0;
+#endif
+}
+
+/* Peak resident memory in kB, 0 if unknown */
+static long
+sfload_peak_rss(void)
+{
+#if defined(__linux__)
+    return sfload_proc_status("VmHWM:");
+#elif defined(_WIN32)
+    return 0;
+#else
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+/* Reads a file once, so that it is in the page cache when measured. FALSE if it can't be read. */
+static int
+sfload_read_file(const char *filename)
+{
+    char buf[65536];
+    FILE *file = FLUID_FOPEN(filename, "rb");
+
+    if(file == NULL)
+    {
+        return FALSE;
+    }
+
+    while(fread(buf, 1, sizeof(buf), file) == sizeof(buf))
+    {
+    }
+
+    fclose(file);
+    return TRUE;
+}
+
+/* Parses a comma separated list of integers, returns the number of values or -1 if invalid */
+static int
+sfload_parse_list(const char *arg, int *values, int min, int max)
+{
+    char *end;
+    long val;
+    int count = 0;
+
+    while(count < SFLOAD_MAX_VALUES)
+    {
+        val = strtol(arg, &end, 10);
+
+        if(end == arg || val < min || val > max)
+        {
+            return -1;
+        }
+
+        values[count++] = (int)val;
+
+        if(*end == '\0')
+        {
+            return count;
+        }
+
+        if(*end != ',')
+        {
+            return -1;
+        }
+
+        arg = end + 1;
+    }
+
+    return -1;
+}
+
+/* Writes a string as a JSON string */
+static void
+sfload_print_string(FILE *out, const char *str)
+{
+    fputc('"', out);
+
+    for(; *str != '\0'; str++)
+    {
+        if(*str == '"' || *str == '\\')
+        {
+            fputc('\\', out);
+            fputc(*str, out);
+        }
+        else if((unsigned char)*str < 0x20)
+        {
+            fprintf(out, "\\u%04x", (unsigned char)*str);
+        }
+        else
+        {
+            fputc(*str, out);
+        }
+    }
+
+    fputc('"', out);
+}
+
+/* Loads a file once and measures it. In shared mode, another synth loads it before. */
+static int
+sfload_measure(fluid_settings_t *settings, const char *filename, int shared, sfload_result_t *result)
+{
+    fluid_synth_t *holder = NULL, *synth;
+    double wall, cpu;
+    int i, id;
+
+    synth = new_fluid_synth(settings);
+
+    if(synth == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(shared)
+    {
+        holder = new_fluid_synth(settings);
+
+        if(holder == NULL || fluid_synth_sfload(holder, filename, TRUE) == FLUID_FAILED)
+        {
+            delete_fluid_synth(holder);
+            delete_fluid_synth(synth);
+            return FLUID_FAILED;
+        }
+    }
+
+    if(fluid_trace_start(SFLOAD_TRACE_EVENTS) != FLUID_OK)
+    {
+        delete_fluid_synth(holder);
+        delete_fluid_synth(synth);
+        return FLUID_FAILED;
+    }
+
+    sfload_reset_peak_rss();
+    result->base_rss = sfload_rss();
+    cpu = sfload_cpu_time();
+    wall = fluid_perf_now();
+
+    id = fluid_synth_sfload(synth, filename, TRUE);
+
+    result->wall = fluid_perf_now() - wall;
+    result->cpu = sfload_cpu_time() - cpu;
+    result->peak_rss = sfload_peak_rss();
+
+    for(i = 0; i < (int)FLUID_N_ELEMENTS(sfload_phases); i++)
+    {
+        result->phases[i] = fluid_trace_get_total(sfload_phases[i], &result->phase_counts[i]);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_synth(holder);
+
+    return (id == FLUID_FAILED) ? FLUID_FAILED : FLUID_OK;
+}
+
+static void
+print_usage(void)
+{
+    fprintf(stderr, "Usage: fluid_sfload [-t threads] [-d modes] [-r repeats] [-o file.json] [file ...]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const default_files[] = { TEST_SOUNDFONT, TEST_SOUNDFONT_SF3, TEST_DLS };
+    const char *const *files = default_files;
+    int file_count = FLUID_N_ELEMENTS(default_files);
+    int threads[SFLOAD_MAX_VALUES] = { 1 }, thread_count = 1;
+    int modes[SFLOAD_MAX_VALUES] = { 0, 1 }, mode_count = 2;
+    int repeats = 3;
+    const char *out_name = NULL;
+    fluid_settings_t *settings = NULL;
+    FILE *out = stdout;
+    sfload_result_t result, best;
+    int f, t, d, shared, r, i, first, count = 0, ret = EXIT_FAILURE;
+
+    for(i = 1; i < argc; i++)
+    {
+        if(argv[i][0] == '-' && argv[i][1] != '\0' && argv[i][2] == '\0' && i + 1 < argc)
+        {
+            const char *arg = argv[++i];
+
+            switch(argv[i - 1][1])
+            {
+            case 't':
+                thread_count = sfload_parse_list(arg, threads, 1, 256);
+                break;
+
+            case 'd':
+                mode_count = sfload_parse_list(arg, modes, 0, 1);
+                break;
+
+            case 'r':
+                repeats = atoi(arg);
+                break;
+
+            case 'o':
+                out_name = arg;
+                break;
+
+            default:
+                print_usage();
+                return EXIT_FAILURE;
+            }
+        }
+        else if(argv[i][0] == '-')
+        {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+        else
+        {
+            files = (const char *const *)&argv[i];
+            file_count = argc - i;
+            break;
+        }
+    }
+
+    if(thread_count < 1 || mode_count < 1 || repeats < 1)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    /* nothing, every configuration loads the files again and the loaders that don't
+     * recognize a file log errors */
+    for(i = FLUID_ERR; i < LAST_LOG_LEVEL; i++)
+    {
+        fluid_set_log_function(i, NULL, NULL);
+    }
+
+    settings = new_fluid_settings();
+
+    if(settings == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        goto cleanup;
+    }
+
+    if(out_name != NULL && (out = FLUID_FOPEN(out_name, "w")) == NULL)
+    {
+        fprintf(stderr, "Failed to open '%s'\n", out_name);
+        out = stdout;
+        goto cleanup;
+    }
+
+    fprintf(out, "{\n  \"version\": \"%s\",\n  \"repeats\": %d,\n  \"results\": [", fluid_version_str(), repeats);
+
+    for(f = 0; f < file_count; f++)
+    {
+        if(!sfload_read_file(files[f]))
+        {
+            fprintf(stderr, "%s: can't be read, skipped\n", files[f]);
+            continue;
+        }
+
+        for(t = 0; t < thread_count; t++)
+        {
+            if(fluid_settings_setint(settings, "synth.cpu-cores", threads[t]) != FLUID_OK)
+            {
+                fprintf(stderr, "Invalid number of threads %d, skipped\n", threads[t]);
+                continue;
+            }
+
+#if HAVE_OPENMP
+            omp_set_num_threads(threads[t]);
+#endif
+
+            for(d = 0; d < mode_count; d++)
+            {
+                fluid_settings_setint(settings, "synth.dynamic-sample-loading", modes[d]);
+
+                for(shared = FALSE; shared <= TRUE; shared++)
+                {
+                    for(r = 0; r < repeats; r++)
+                    {
+                        if(sfload_measure(settings, files[f], shared, &result) != FLUID_OK)
+                        {
+                            break;
+                        }
+
+                        if(r == 0 || result.wall < best.wall)
+                        {
+                            best = result;
+                        }
+                    }
+
+                    if(r < repeats)
+                    {
+                        fprintf(stderr, "%s: failed to load, skipped\n", files[f]);
+                        break;
+                    }
+
+                    fprintf(out, "%s\n    {\"file\": ", count ? "," : "");
+                    sfload_print_string(out, files[f]);
+                    fprintf(out, ", \"threads\": %d, \"dynamic_sample_loading\": %d, \"cache\": \"%s\", "
+                            "\"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"peak_rss_kb\": %ld, \"base_rss_kb\": %ld, \"phases_ms\": {",
+                            threads[t], modes[d], shared ? "shared" : "cold",
+                            best.wall / 1000.0, best.cpu / 1000.0, best.peak_rss, best.base_rss);
+
+                    for(i = 0, first = TRUE; i < (int)FLUID_N_ELEMENTS(sfload_phases); i++)
+                    {
+                        if(best.phase_counts[i] > 0)
+                        {
+                            fprintf(out, "%s\"%s\": %.3f", first ? "" : ", ", sfload_phases[i], best.phases[i] / 1000.0);
+                            first = FALSE;
+                        }
+                    }
+
+                    fprintf(out, "}}");
+                    fflush(out);
+                    count++;
+                }
+            }
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    if(out != stdout)
+    {
+        fclose(out);
+    }
+
+    delete_fluid_settings(settings);
+
+    return ret;
+}
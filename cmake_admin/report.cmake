@@ -96,6 +96,12 @@ else ( SDL3_SUPPORT )
     set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  SDL3:                  no\n" )
 endif ( SDL3_SUPPORT )
 
+if ( WEBAUDIO_SUPPORT )
+    set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  Web Audio:             yes\n" )
+else ( WEBAUDIO_SUPPORT )
+    set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  Web Audio:             no\n" )
+endif ( WEBAUDIO_SUPPORT )
+
 if ( WASAPI_SUPPORT )
     set ( AUDIO_MIDI_REPORT "${AUDIO_MIDI_REPORT}  WASAPI:                yes\n" )
 else ( WASAPI_SUPPORT )
@@ -118,13 +124,15 @@ endif ( WINMIDI_SUPPORT )
 set ( INPUTS_REPORT "\n" )
 
 set ( INPUTS_REPORT "${INPUTS_REPORT}Support for SF3 files:   " )
-if ( LIBSNDFILE_HASVORBIS )
+if ( VORBISFILE_SUPPORT )
+    set ( INPUTS_REPORT "${INPUTS_REPORT}yes (libvorbisfile)\n" )
+elseif ( LIBSNDFILE_HASVORBIS )
     set ( INPUTS_REPORT "${INPUTS_REPORT}yes\n" )
 elseif ( NOT LIBSNDFILE_SUPPORT )
     set ( INPUTS_REPORT "${INPUTS_REPORT}no (libsndfile not found)\n" )
 elseif ( NOT LIBSNDFILE_HASVORBIS )
     set ( INPUTS_REPORT "${INPUTS_REPORT}no (libsndfile has no ogg vorbis support)\n" )
-endif ( LIBSNDFILE_HASVORBIS )
+endif ()
 
 
 set ( INPUTS_REPORT "${INPUTS_REPORT}Support for DLS files:   " )
@@ -163,12 +171,12 @@ endif ( LIBSNDFILE_SUPPORT )
 set ( MISC_REPORT "\nMiscellaneous support:\n" )
 
 if    ( LIMITER_SUPPORT )
-    set ( MISC_REPORT "${MISC_REPORT}  Limiter:               yes\n" )
+    set ( MISC_REPORT "${MISC_REPORT}  Look-ahead limiter:    yes\n" )
 else  ( LIMITER_SUPPORT )
   if    ( SIGNALSMITH_AUDIO_BASICS STREQUAL SIGNALSMITH_AUDIO_BASICS-NOTFOUND )
-        set ( MISC_REPORT "${MISC_REPORT}  Limiter:               no (signalsmith-audio/basics not found)\n" )
+        set ( MISC_REPORT "${MISC_REPORT}  Look-ahead limiter:    no (signalsmith-audio/basics not found)\n" )
   else  ( SIGNALSMITH_AUDIO_BASICS STREQUAL SIGNALSMITH_AUDIO_BASICS-NOTFOUND )
-        set ( MISC_REPORT "${MISC_REPORT}  Limiter:               no\n" )
+        set ( MISC_REPORT "${MISC_REPORT}  Look-ahead limiter:    no\n" )
   endif ( SIGNALSMITH_AUDIO_BASICS STREQUAL SIGNALSMITH_AUDIO_BASICS-NOTFOUND )
 endif ( LIMITER_SUPPORT )
 
@@ -238,6 +246,23 @@ else ( WITH_FLOAT )
   set ( DEVEL_REPORT "${DEVEL_REPORT}  Samples type:          double\n" )
 endif ( WITH_FLOAT )
 
+if ( WITH_FIXED_POINT )
+  set ( DEVEL_REPORT "${DEVEL_REPORT}  Fixed point interp.:   yes\n" )
+else ( WITH_FIXED_POINT )
+  set ( DEVEL_REPORT "${DEVEL_REPORT}  Fixed point interp.:   no\n" )
+endif ( WITH_FIXED_POINT )
+
+if ( EMSCRIPTEN )
+  if ( WITH_WASM_SIMD )
+    set ( DEVEL_REPORT "${DEVEL_REPORT}  WebAssembly SIMD128:   yes\n" )
+  else ( WITH_WASM_SIMD )
+    set ( DEVEL_REPORT "${DEVEL_REPORT}  WebAssembly SIMD128:   no\n" )
+  endif ( WITH_WASM_SIMD )
+endif ( EMSCRIPTEN )
+
+set ( DEVEL_REPORT "${DEVEL_REPORT}  Render block size:     ${FLUID_BUFSIZE} frames\n" )
+set ( DEVEL_REPORT "${DEVEL_REPORT}  Mixer buffer size:     ${FLUID_MIXER_FRAMES} frames\n" )
+
 if ( ENABLE_MIXER_THREADS )
   set ( DEVEL_REPORT "${DEVEL_REPORT}  Multithread rendering: yes\n" )
 else ( ENABLE_MIXER_THREADS )
@@ -119,6 +119,33 @@ FLUIDSYNTH_API void delete_fluid_audio_driver(fluid_audio_driver_t *driver);
 /** @endlifecycle */
 
 FLUIDSYNTH_API int fluid_audio_driver_register(const char **adrivers);
+
+/**
+ * Number of bins of fluid_audio_driver_stats_t::load_histogram.
+ * @since 2.6.0
+ */
+#define FLUID_AUDIO_DRIVER_LOAD_BINS 11
+
+/**
+ * Health statistics of an audio driver, see fluid_audio_driver_get_stats().
+ *
+ * The driver updates them from its audio thread without locking, so a copy may
+ * combine values from consecutive periods.
+ * @since 2.6.0
+ */
+typedef struct
+{
+    unsigned int periods;       /**< Number of audio periods rendered */
+    unsigned int xruns;         /**< Number of underruns reported by the audio API, 0 if the driver can't tell */
+    double callback_avg;        /**< Time spent rendering a period in microseconds, averaged over the last 16 periods or so */
+    double callback_max;        /**< Longest time spent rendering a period, in microseconds */
+    double margin_min;          /**< Smallest time left between the end of rendering and the end of the period in microseconds, negative if rendering took longer than the period */
+    double latency;             /**< Output latency last reported by the audio API in microseconds, 0 if the driver can't tell */
+    unsigned int load_histogram[FLUID_AUDIO_DRIVER_LOAD_BINS]; /**< Number of periods by rendering time relative to the period duration: bin i counts loads from i*10% to (i+1)*10%, the last bin loads of 100% and more */
+} fluid_audio_driver_stats_t;
+
+FLUIDSYNTH_API int fluid_audio_driver_get_stats(fluid_audio_driver_t *driver, fluid_audio_driver_stats_t *stats);
+FLUIDSYNTH_API void fluid_audio_driver_reset_stats(fluid_audio_driver_t *driver);
 /** @} */
 
 /**
@@ -147,6 +174,80 @@ FLUIDSYNTH_API int fluid_file_renderer_process_block(fluid_file_renderer_t *dev)
 FLUIDSYNTH_API int fluid_file_set_encoding_quality(fluid_file_renderer_t *dev, double q);
 /** @} */
 
+/**
+ * @defgroup offline_renderer Offline Renderer
+ * @ingroup audio_output
+ *
+ * Functions for rendering a MIDI player or a sequencer to audio as fast as possible.
+ *
+ * Unlike the \ref file_renderer, they hand the audio over to a callback in large
+ * blocks and don't render stretches of silence at all: while no voice is playing
+ * and the effects have died away, the synth skips ahead to the next event in one go.
+ *
+ * @{
+ */
+
+/**
+ * Callback function type used with fluid_player_render(), fluid_player_render_parallel()
+ * and fluid_sequencer_render().
+ *
+ * @param data User defined data pointer
+ * @param len Number of audio frames
+ * @param left Left channel of the audio, or NULL if the @p len frames are silent
+ * @param right Right channel of the audio, or NULL if the @p len frames are silent
+ * @param progress How much of the rendering is done, from 0.0 to 1.0
+ * @return #FLUID_OK to continue rendering, #FLUID_FAILED to abort it
+ *
+ * Reverb and chorus are mixed into @p left and @p right. Silent frames are reported
+ * without a buffer, so that they take no time to handle, e.g. by seeking in the output file.
+ * @since 2.6.0
+ */
+typedef int (*fluid_render_func_t)(void *data, int len, const float *left, const float *right,
+                                   double progress);
+
+FLUIDSYNTH_API int fluid_player_render(fluid_player_t *player, int block_size,
+                                       fluid_render_func_t func, void *data);
+FLUIDSYNTH_API int fluid_player_render_parallel(fluid_player_t *player, int threads, int block_size,
+        fluid_render_func_t func, void *data);
+FLUIDSYNTH_API int fluid_sequencer_render(fluid_sequencer_t *seq, fluid_synth_t *synth,
+        unsigned int ticks, int block_size,
+        fluid_render_func_t func, void *data);
+/** @} */
+
+/**
+ * @defgroup render_server Render Server
+ * @ingroup audio_output
+ *
+ * Functions for rendering the synths of a pool for clients in other processes.
+ *
+ * The clients exchange timestamped MIDI messages and rendered audio with the server
+ * through a file mapped into the memory of both, e.g. below @c /dev/shm, so that
+ * several processes share the SoundFonts and the threads of a single synth pool.
+ * See also the @c --render-server option of the @c fluidsynth program.
+ *
+ * @{
+ */
+
+/** @startlifecycle{Render Server} */
+FLUIDSYNTH_API fluid_render_server_t *new_fluid_render_server(fluid_settings_t *settings,
+        fluid_synth_pool_t *pool, const char *path, int clients);
+FLUIDSYNTH_API void delete_fluid_render_server(fluid_render_server_t *server);
+/** @endlifecycle */
+
+/** @startlifecycle{Render Client} */
+FLUIDSYNTH_API fluid_render_client_t *new_fluid_render_client(const char *path);
+FLUIDSYNTH_API void delete_fluid_render_client(fluid_render_client_t *client);
+/** @endlifecycle */
+
+FLUIDSYNTH_API int fluid_render_client_send(fluid_render_client_t *client, unsigned int frame,
+        const unsigned char *msg, int len);
+FLUIDSYNTH_API int fluid_render_client_render(fluid_render_client_t *client,
+        const float **left, const float **right);
+FLUIDSYNTH_API unsigned int fluid_render_client_get_frame(fluid_render_client_t *client);
+FLUIDSYNTH_API int fluid_render_client_get_period_size(fluid_render_client_t *client);
+FLUIDSYNTH_API double fluid_render_client_get_sample_rate(fluid_render_client_t *client);
+/** @} */
+
 #ifdef __cplusplus
 }
 #endif
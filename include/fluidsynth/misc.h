@@ -67,6 +67,10 @@ extern "C" {
 FLUIDSYNTH_API int fluid_is_soundfont(const char *filename);
 FLUIDSYNTH_API int fluid_is_midifile(const char *filename);
 FLUIDSYNTH_API void fluid_free(void* ptr);
+
+FLUIDSYNTH_API int fluid_trace_start(int events);
+FLUIDSYNTH_API void fluid_trace_stop(void);
+FLUIDSYNTH_API int fluid_trace_dump(const char *filename);
 /** @} */
 
 #ifdef __cplusplus
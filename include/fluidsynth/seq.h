@@ -56,6 +56,27 @@ extern "C" {
 typedef void (*fluid_event_callback_t)(unsigned int time, fluid_event_t *event,
                                        fluid_sequencer_t *seq, void *data);
 
+/**
+ * Batch event callback prototype for destination clients.
+ *
+ * @param time Current sequencer tick value (see fluid_sequencer_get_tick()).
+ * @param events The events being received, in the order they are due
+ * @param count Count of \p events, at least 1
+ * @param seq The sequencer instance
+ * @param data User defined data registered with the client
+ *
+ * Receives at once the events due for the client that follow each other in the queue,
+ * see fluid_sequencer_set_client_batch_callback(). The remarks about @p time of
+ * #fluid_event_callback_t apply as well.
+ *
+ * @note The events have already been taken from the queue, calling fluid_sequencer_remove_events()
+ * from the callback doesn't affect them.
+ *
+ * @since 2.6.0
+ */
+typedef void (*fluid_event_batch_callback_t)(unsigned int time, fluid_event_t **events, int count,
+        fluid_sequencer_t *seq, void *data);
+
 
 /** @startlifecycle{MIDI Sequencer} */
 FLUID_DEPRECATED FLUIDSYNTH_API fluid_sequencer_t *new_fluid_sequencer(void);
@@ -68,6 +89,9 @@ FLUIDSYNTH_API
 fluid_seq_id_t fluid_sequencer_register_client(fluid_sequencer_t *seq, const char *name,
         fluid_event_callback_t callback, void *data);
 FLUIDSYNTH_API void fluid_sequencer_unregister_client(fluid_sequencer_t *seq, fluid_seq_id_t id);
+FLUIDSYNTH_API
+int fluid_sequencer_set_client_batch_callback(fluid_sequencer_t *seq, fluid_seq_id_t id,
+        fluid_event_batch_callback_t callback);
 FLUIDSYNTH_API int fluid_sequencer_count_clients(fluid_sequencer_t *seq);
 FLUIDSYNTH_API fluid_seq_id_t fluid_sequencer_get_client_id(fluid_sequencer_t *seq, int index);
 FLUIDSYNTH_API char *fluid_sequencer_get_client_name(fluid_sequencer_t *seq, fluid_seq_id_t id);
@@ -78,6 +102,9 @@ FLUIDSYNTH_API
 int fluid_sequencer_send_at(fluid_sequencer_t *seq, fluid_event_t *evt,
                             unsigned int time, int absolute);
 FLUIDSYNTH_API
+int fluid_sequencer_send_batch(fluid_sequencer_t *seq, fluid_event_t **evts,
+                               const unsigned int *times, int count, int absolute);
+FLUIDSYNTH_API
 void fluid_sequencer_remove_events(fluid_sequencer_t *seq, fluid_seq_id_t source, fluid_seq_id_t dest, int type);
 FLUIDSYNTH_API unsigned int fluid_sequencer_get_tick(fluid_sequencer_t *seq);
 FLUIDSYNTH_API void fluid_sequencer_set_time_scale(fluid_sequencer_t *seq, double scale);
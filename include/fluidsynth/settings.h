@@ -156,6 +156,28 @@ FLUIDSYNTH_API
 int fluid_settings_getint_range(fluid_settings_t *settings, const char *name,
                                 int *min, int *max);
 
+/** @startlifecycle{Setting Handles} */
+FLUIDSYNTH_API
+fluid_settings_handle_t *new_fluid_settings_handle(fluid_settings_t *settings, const char *name);
+FLUIDSYNTH_API
+void delete_fluid_settings_handle(fluid_settings_handle_t *handle);
+/** @endlifecycle */
+
+FLUIDSYNTH_API
+int fluid_settings_handle_get_type(fluid_settings_handle_t *handle);
+
+FLUIDSYNTH_API
+int fluid_settings_handle_setnum(fluid_settings_handle_t *handle, double val);
+
+FLUIDSYNTH_API
+int fluid_settings_handle_getnum(fluid_settings_handle_t *handle, double *val);
+
+FLUIDSYNTH_API
+int fluid_settings_handle_setint(fluid_settings_handle_t *handle, int val);
+
+FLUIDSYNTH_API
+int fluid_settings_handle_getint(fluid_settings_handle_t *handle, int *val);
+
 /**
  * Callback function type used with fluid_settings_foreach_option()
  *
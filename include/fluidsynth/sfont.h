@@ -82,7 +82,9 @@ enum
     FLUID_PRESET_UNSELECTED,              /**< Preset unselected notify */
     FLUID_SAMPLE_DONE,                    /**< Sample no longer needed notify */
     FLUID_PRESET_PIN,                     /**< Request to pin preset samples to cache */
-    FLUID_PRESET_UNPIN                    /**< Request to unpin preset samples from cache */
+    FLUID_PRESET_UNPIN,                   /**< Request to unpin preset samples from cache */
+    FLUID_PRESET_IS_LOADED,               /**< Query if preset samples are loaded, #FLUID_FAILED while they are still being loaded */
+    FLUID_PRESET_WARM                     /**< Request to page in the memory used by the preset, see fluid_synth_warm_preset() */
 };
 
 /**
@@ -257,6 +259,7 @@ FLUIDSYNTH_API const char *fluid_sfont_get_name(fluid_sfont_t *sfont);
 FLUIDSYNTH_API fluid_preset_t *fluid_sfont_get_preset(fluid_sfont_t *sfont, int bank, int prenum);
 FLUIDSYNTH_API void fluid_sfont_iteration_start(fluid_sfont_t *sfont);
 FLUIDSYNTH_API fluid_preset_t *fluid_sfont_iteration_next(fluid_sfont_t *sfont);
+FLUIDSYNTH_API int fluid_sfont_warm(fluid_sfont_t *sfont);
 
 /**
  * Method to get a virtual SoundFont preset name.
@@ -357,6 +360,51 @@ FLUIDSYNTH_API int fluid_sample_set_sound_data(fluid_sample_t *sample,
 FLUIDSYNTH_API int fluid_sample_set_loop(fluid_sample_t *sample, unsigned int loop_start, unsigned int loop_end);
 FLUIDSYNTH_API int fluid_sample_set_pitch(fluid_sample_t *sample, int root_key, int fine_tune);
 
+/**
+ * Memory saved by storing identical sample data only once, see fluid_sample_get_dedup_stats().
+ * @since 2.6.0
+ */
+typedef struct
+{
+    int samples;            /**< Samples using the data of another sample with identical content */
+    size_t bytes_saved;     /**< Size of the data these samples would take on their own in bytes */
+    int unique_samples;     /**< Samples checked for identical content whose data is stored */
+    size_t bytes_stored;    /**< Size of the data of these samples in bytes */
+} fluid_sample_dedup_stats_t;
+
+FLUIDSYNTH_API int fluid_sample_get_dedup_stats(fluid_sample_dedup_stats_t *stats);
+
+/**
+ * Memory taken by the sample data of the SoundFonts loaded in this process, see
+ * fluid_sample_get_cache_memory(). All sizes are in bytes.
+ * @since 2.6.0
+ */
+typedef struct
+{
+    size_t in_memory;       /**< Sample data read, decoded, converted or compressed into memory */
+    size_t mapped;          /**< Sample data mapped from the SoundFont files, see \setting{synth_sample-mmap} */
+    size_t shared;          /**< Part of both used by more than one loaded SoundFont, e.g. the same file loaded by several synths */
+    int entries;            /**< Number of blocks of sample data, a whole SoundFont or a single sample each */
+} fluid_sample_cache_memory_t;
+
+FLUIDSYNTH_API int fluid_sample_get_cache_memory(fluid_sample_cache_memory_t *usage);
+
+/**
+ * How often dynamic sample loading found the samples of a selected preset in memory, see
+ * fluid_sample_get_residency_stats().
+ * @since 2.6.0
+ */
+typedef struct
+{
+    unsigned int hits;      /**< Samples of selected presets whose data was still in memory */
+    unsigned int misses;    /**< Samples of selected presets whose data had to be loaded */
+    unsigned int evictions; /**< Unused samples unloaded to stay within \setting{synth_dynamic-sample-loading-budget} */
+    int unused_samples;     /**< Samples kept in memory although no selected preset uses them */
+    size_t unused_bytes;    /**< Size of the data of these samples in bytes */
+} fluid_sample_residency_stats_t;
+
+FLUIDSYNTH_API int fluid_sample_get_residency_stats(fluid_sample_residency_stats_t *stats);
+
 /** @} */
 
 #ifdef __cplusplus
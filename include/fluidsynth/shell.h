@@ -140,6 +140,8 @@ FLUIDSYNTH_API void delete_fluid_server(fluid_server_t *server);
 FLUIDSYNTH_API int fluid_server_join(fluid_server_t *server);
 /** @endlifecycle */
 
+FLUIDSYNTH_API void fluid_server_set_audio_driver(fluid_server_t *server, fluid_audio_driver_t *driver);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -53,7 +53,30 @@ FLUIDSYNTH_API void delete_fluid_synth(fluid_synth_t *synth);
 /** @endlifecycle */
 
 FLUIDSYNTH_API double fluid_synth_get_cpu_load(fluid_synth_t *synth);
+FLUIDSYNTH_API int fluid_synth_get_stream_underruns(fluid_synth_t *synth);
+FLUIDSYNTH_API int fluid_synth_get_event_queue_peak(fluid_synth_t *synth);
 FLUID_DEPRECATED FLUIDSYNTH_API const char *fluid_synth_error(fluid_synth_t *synth);
+
+/** @startlifecycle{Render Pool} */
+FLUIDSYNTH_API fluid_render_pool_t *new_fluid_render_pool(fluid_settings_t *settings);
+FLUIDSYNTH_API void delete_fluid_render_pool(fluid_render_pool_t *pool);
+/** @endlifecycle */
+
+FLUIDSYNTH_API int fluid_synth_set_render_pool(fluid_synth_t *synth, fluid_render_pool_t *pool);
+FLUIDSYNTH_API int fluid_render_pool_write_float(fluid_render_pool_t *pool, int count, fluid_synth_t **synths,
+        int len, float **left, float **right);
+
+FLUIDSYNTH_API int fluid_synth_snapshot(fluid_synth_t *synth, void *data, int size);
+FLUIDSYNTH_API int fluid_synth_restore(fluid_synth_t *synth, const void *data, int size);
+
+/** @startlifecycle{Synth Pool} */
+FLUIDSYNTH_API fluid_synth_pool_t *new_fluid_synth_pool(fluid_settings_t *settings, int size);
+FLUIDSYNTH_API void delete_fluid_synth_pool(fluid_synth_pool_t *pool);
+/** @endlifecycle */
+
+FLUIDSYNTH_API int fluid_synth_pool_sfload(fluid_synth_pool_t *pool, const char *filename);
+FLUIDSYNTH_API fluid_synth_t *fluid_synth_pool_lease(fluid_synth_pool_t *pool);
+FLUIDSYNTH_API int fluid_synth_pool_release(fluid_synth_pool_t *pool, fluid_synth_t *synth);
 /** @} */
 
 /**
@@ -138,6 +161,7 @@ FLUIDSYNTH_API
 int fluid_synth_sfload(fluid_synth_t *synth, const char *filename, int reset_presets);
 FLUIDSYNTH_API int fluid_synth_sfreload(fluid_synth_t *synth, int id);
 FLUIDSYNTH_API int fluid_synth_sfunload(fluid_synth_t *synth, int id, int reset_presets);
+FLUIDSYNTH_API int fluid_synth_sfswap(fluid_synth_t *synth, int id, const char *filename);
 FLUIDSYNTH_API int fluid_synth_add_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont);
 FLUIDSYNTH_API int fluid_synth_remove_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont);
 FLUIDSYNTH_API int fluid_synth_sfcount(fluid_synth_t *synth);
@@ -182,6 +206,9 @@ FLUIDSYNTH_API int fluid_synth_get_reverb_group_roomsize(fluid_synth_t *synth, i
 FLUIDSYNTH_API int fluid_synth_get_reverb_group_damp(fluid_synth_t *synth, int fx_group, double *damping);
 FLUIDSYNTH_API int fluid_synth_get_reverb_group_width(fluid_synth_t *synth, int fx_group, double *width);
 FLUIDSYNTH_API int fluid_synth_get_reverb_group_level(fluid_synth_t *synth, int fx_group, double *level);
+
+FLUIDSYNTH_API int fluid_synth_set_reverb_ir(fluid_synth_t *synth, int fx_group,
+        const float *left, const float *right, int length);
  /** @} Reverb */
 
 
@@ -255,8 +282,179 @@ FLUIDSYNTH_API float fluid_synth_get_gain(fluid_synth_t *synth);
 FLUIDSYNTH_API int fluid_synth_set_polyphony(fluid_synth_t *synth, int polyphony);
 FLUIDSYNTH_API int fluid_synth_get_polyphony(fluid_synth_t *synth);
 FLUIDSYNTH_API int fluid_synth_get_active_voice_count(fluid_synth_t *synth);
+FLUIDSYNTH_API int fluid_synth_set_channel_polyphony(fluid_synth_t *synth, int chan, int polyphony, double cost_budget);
+FLUIDSYNTH_API int fluid_synth_get_channel_polyphony(fluid_synth_t *synth, int chan, int *polyphony, double *cost_budget);
 FLUIDSYNTH_API int fluid_synth_get_internal_bufsize(fluid_synth_t *synth);
 
+/**
+ * Render stages timed when \setting{synth_perf-stats} is enabled.
+ * @since 2.6.0
+ */
+enum fluid_perf_stage
+{
+    FLUID_PERF_STAGE_RENDER,    /**< One render call of the synth, i.e. up to \setting{audio_period-size} samples, including all other stages */
+    FLUID_PERF_STAGE_VOICES,    /**< Rendering all voices, including waiting for the mixer threads */
+    FLUID_PERF_STAGE_REVERB,    /**< Processing the reverb units */
+    FLUID_PERF_STAGE_CHORUS,    /**< Processing the chorus units */
+    FLUID_PERF_STAGE_LAST       /**< @internal Value defines the count of render stages (#fluid_perf_stage) @warning This symbol is not part of the public API and ABI stability guarantee and may change at any time! */
+};
+
+/**
+ * Timing statistics of a render stage, see fluid_synth_get_perf_stats().
+ * All durations are in microseconds.
+ * @since 2.6.0
+ */
+typedef struct
+{
+    unsigned int count; /**< Number of times the stage has been timed */
+    double min;         /**< Shortest duration */
+    double avg;         /**< Average duration */
+    double max;         /**< Longest duration */
+    double p99;         /**< 99th percentile of the durations, accurate to a quarter octave */
+} fluid_perf_stats_t;
+
+FLUIDSYNTH_API int fluid_synth_get_perf_stats(fluid_synth_t *synth, enum fluid_perf_stage stage, int thread,
+        fluid_perf_stats_t *stats);
+FLUIDSYNTH_API void fluid_synth_reset_perf_stats(fluid_synth_t *synth);
+FLUIDSYNTH_API int fluid_synth_get_thread_wait_stats(fluid_synth_t *synth, int thread,
+        unsigned int *spins, unsigned int *blocks);
+FLUIDSYNTH_API int fluid_synth_get_note_latency_stats(fluid_synth_t *synth, fluid_perf_stats_t *stats);
+FLUIDSYNTH_API int fluid_synth_get_note_latency_histogram(fluid_synth_t *synth, unsigned int *counts,
+        double *limits, int size);
+
+/**
+ * CPU time spent on the voices of a channel or preset, see fluid_synth_get_channel_cpu_stats().
+ * @since 2.6.0
+ */
+typedef struct
+{
+    double usec;        /**< Time spent synthesizing and mixing the voices in microseconds */
+    double load;        /**< Time spent relative to the duration of the audio rendered, 1.0 equals one CPU core */
+    double voices;      /**< Average number of voices rendered */
+} fluid_cpu_stats_t;
+
+FLUIDSYNTH_API int fluid_synth_get_channel_cpu_stats(fluid_synth_t *synth, int chan, fluid_cpu_stats_t *stats);
+FLUIDSYNTH_API int fluid_synth_get_preset_cpu_stats(fluid_synth_t *synth, int index, int *sfont_id, int *bank,
+        int *prog, fluid_cpu_stats_t *stats);
+
+/**
+ * Signals metered by the synth, see fluid_synth_get_meter().
+ * @since 2.6.0
+ */
+enum fluid_meter_type
+{
+    FLUID_METER_CHANNEL,        /**< The dry signal of the voices of a MIDI channel */
+    FLUID_METER_GROUP,          /**< The output of an audio group, see \setting{synth_audio-groups} */
+    FLUID_METER_FX              /**< An effects buffer, i.e. the reverb or chorus of an effects group */
+};
+
+/**
+ * Levels of a metered signal, see fluid_synth_get_meter().
+ * All levels are linear, 1.0 is full scale.
+ * @since 2.6.0
+ */
+typedef struct
+{
+    float peak_left;    /**< Largest absolute sample value of the left side */
+    float peak_right;   /**< Largest absolute sample value of the right side */
+    float rms_left;     /**< RMS level of the left side */
+    float rms_right;    /**< RMS level of the right side */
+} fluid_meter_stats_t;
+
+FLUIDSYNTH_API int fluid_synth_get_meter(fluid_synth_t *synth, enum fluid_meter_type type, int index,
+        fluid_meter_stats_t *stats);
+
+/**
+ * Memory allocated by a synth, see fluid_synth_get_memory_usage().
+ * All sizes are in bytes.
+ * @since 2.6.0
+ */
+typedef struct
+{
+    size_t voices;      /**< Voices created so far, see \setting{synth_low-memory} */
+    size_t mixer;       /**< Audio buffers of the mixer, its threads and the effects pipeline */
+    size_t effects;     /**< Reverb and chorus units including their delay lines */
+    size_t events;      /**< Event queues between the synth and the mixer */
+    size_t voice_cache; /**< Notes recorded by \setting{synth_voice-cache} */
+    size_t other;       /**< The synth itself, its MIDI channels and voice lookup tables */
+    size_t total;       /**< Sum of all of the above */
+} fluid_synth_memory_t;
+
+FLUIDSYNTH_API int fluid_synth_get_memory_usage(fluid_synth_t *synth, fluid_synth_memory_t *usage);
+
+/**
+ * Memory used by a SoundFont, see fluid_synth_get_sfont_memory_usage().
+ * All sizes are in bytes.
+ * @since 2.6.0
+ */
+typedef struct
+{
+    size_t samples;         /**< Sample data in memory: read from the file or decoded from SF3, including converted and compressed copies (see \setting{synth_sample-format}) and mipmaps */
+    size_t samples_mapped;  /**< Sample data mapped from the file instead, paged in as it is played, see \setting{synth_sample-mmap} */
+    size_t samples_shared;  /**< Part of samples and samples_mapped also used by other loaded SoundFonts, see fluid_sample_get_cache_memory() */
+    size_t metadata;        /**< Presets, instruments, zones, modulators and sample headers */
+    size_t total;           /**< Sum of samples, samples_mapped and metadata */
+} fluid_sfont_memory_t;
+
+FLUIDSYNTH_API int fluid_synth_get_sfont_memory_usage(fluid_synth_t *synth, int sfont_id, fluid_sfont_memory_t *usage);
+
+/**
+ * Envelope stage of a voice, see fluid_voice_state_t.
+ * @since 2.6.0
+ */
+enum fluid_voice_stage
+{
+    FLUID_VOICE_STAGE_DELAY,    /**< Volume envelope delay, the voice is silent yet */
+    FLUID_VOICE_STAGE_ATTACK,   /**< Volume envelope attack */
+    FLUID_VOICE_STAGE_HOLD,     /**< Volume envelope hold */
+    FLUID_VOICE_STAGE_DECAY,    /**< Volume envelope decay */
+    FLUID_VOICE_STAGE_SUSTAIN,  /**< Volume envelope sustain */
+    FLUID_VOICE_STAGE_RELEASE   /**< Volume envelope release, the note has been released */
+};
+
+/**
+ * State of an active voice, see fluid_synth_get_voice_states().
+ * @since 2.6.0
+ */
+typedef struct
+{
+    int chan;                   /**< MIDI channel the voice plays on */
+    int key;                    /**< MIDI key of the note */
+    int vel;                    /**< MIDI velocity of the note */
+    enum fluid_voice_stage stage; /**< Stage of the volume envelope */
+    float amp;                  /**< Gain of the voice from its attenuation and volume envelope, 1.0 at most, before pan and \setting{synth_gain} */
+} fluid_voice_state_t;
+
+/**
+ * Activity of a MIDI channel, see fluid_synth_get_voice_states().
+ * @since 2.6.0
+ */
+typedef struct
+{
+    int voices;                 /**< Number of active voices of the channel */
+    float amp;                  /**< Largest fluid_voice_state_t::amp of those voices */
+} fluid_channel_activity_t;
+
+FLUIDSYNTH_API int fluid_synth_get_voice_states(fluid_synth_t *synth, fluid_voice_state_t *states, int size,
+        fluid_channel_activity_t *channels, int channel_count);
+
+/**
+ * Voice counters of a MIDI channel or the synth, see fluid_synth_get_voice_counters().
+ * @since 2.6.0
+ */
+typedef struct
+{
+    unsigned int started;           /**< Voices started */
+    unsigned int stolen;            /**< Voices killed to make room for new ones, when \setting{synth_polyphony}, the limits of a channel (see fluid_synth_set_channel_polyphony()) or the governor (see \setting{synth_governor_active}) were exceeded */
+    unsigned int killed_exclusive;  /**< Voices released by a new voice of the same exclusive class */
+    unsigned int finished;          /**< Voices that ended without being stolen: after their release, at the end of their sample or when turned off */
+    unsigned int dropped;           /**< Voices not started because no voice could be stolen for them */
+    int peak;                       /**< Most voices active at once. For the synth, it includes the voices stolen that are still fading out. */
+} fluid_voice_counters_t;
+
+FLUIDSYNTH_API int fluid_synth_get_voice_counters(fluid_synth_t *synth, int chan, fluid_voice_counters_t *counters);
+FLUIDSYNTH_API void fluid_synth_reset_voice_counters(fluid_synth_t *synth);
+
 FLUIDSYNTH_API
 int fluid_synth_set_interp_method(fluid_synth_t *synth, int chan, int interp_method);
 
@@ -277,6 +475,22 @@ enum fluid_interp
      */
     FLUID_INTERP_7THORDER = 7,
 
+    /**
+     * Choose none, linear, 4th or 7th order interpolation for every voice and block: loud voices
+     * played at or below the pitch of their sample get 7th order, voices transposed up by an
+     * octave or more and quiet voices get cheaper interpolation.
+     * @since 2.6.0
+     */
+    FLUID_INTERP_AUTO = 8,
+
+    /**
+     * Sixteen-point windowed sinc interpolation, for offline and mastering renders: the
+     * highest quality, at about two and a half times the cost of the 7th order interpolation.
+     * Not covered by #FLUID_INTERP_HIGHEST, callers opt in by choosing it explicitly.
+     * @since 2.6.0
+     */
+    FLUID_INTERP_16THORDER = 16,
+
     FLUID_INTERP_DEFAULT = FLUID_INTERP_4THORDER, /**< Default interpolation method */
     FLUID_INTERP_HIGHEST = FLUID_INTERP_7THORDER, /**< Highest interpolation method */
 };
@@ -363,6 +577,22 @@ FLUIDSYNTH_API int fluid_synth_write_s32(fluid_synth_t *synth, int len,
 FLUIDSYNTH_API int fluid_synth_write_float(fluid_synth_t *synth, int len,
         void *lout, int loff, int lincr,
         void *rout, int roff, int rincr);
+
+/**
+ * Sample formats of the buffers passed to fluid_synth_write_channels().
+ * @since 2.6.0
+ */
+enum fluid_sample_format
+{
+    FLUID_SAMPLE_FORMAT_FLOAT,  /**< 32 bit floating point, in the range -1.0 to 1.0 */
+    FLUID_SAMPLE_FORMAT_S16,    /**< Signed 16 bit integers, dithered, see fluid_synth_write_s16() */
+    FLUID_SAMPLE_FORMAT_S24,    /**< Left-aligned signed 24 bit integers in 32 bit words, see fluid_synth_write_s24() */
+    FLUID_SAMPLE_FORMAT_S32     /**< Signed 32 bit integers, see fluid_synth_write_s32() */
+};
+
+FLUIDSYNTH_API int fluid_synth_write_channels(fluid_synth_t *synth, int len,
+        enum fluid_sample_format format, int channels_count,
+        void *channels_out[], int channels_off[], int channels_incr[]);
 FLUID_DEPRECATED FLUIDSYNTH_API int fluid_synth_nwrite_float(fluid_synth_t *synth, int len,
         float **left, float **right,
         float **fx_left, float **fx_right);
@@ -495,6 +725,7 @@ enum fluid_channel_legato_mode
 {
     FLUID_CHANNEL_LEGATO_MODE_RETRIGGER, /**< Mode 0 - Release previous note, start a new note */
     FLUID_CHANNEL_LEGATO_MODE_MULTI_RETRIGGER, /**< Mode 1 - On contiguous notes retrigger in attack section using current value, shape attack using current dynamic and make use of previous voices if any */
+    FLUID_CHANNEL_LEGATO_MODE_SINGLE_TRIGGER, /**< Mode 2 - On contiguous notes only change the pitch of previous voices if any, their envelopes and dynamic continue (since 2.6.0) */
     FLUID_CHANNEL_LEGATO_MODE_LAST /**< @internal Value defines the count of legato modes (#fluid_channel_legato_mode) @warning This symbol is not part of the public API and ABI stability guarantee and may change at any time! */
 };
 
@@ -580,6 +811,11 @@ FLUIDSYNTH_API fluid_preset_t *fluid_synth_get_channel_preset(fluid_synth_t *syn
 /** @ingroup midi_input */
 FLUIDSYNTH_API int fluid_synth_handle_midi_event(void *data, fluid_midi_event_t *event);
 
+/** @ingroup midi_input */
+FLUIDSYNTH_API
+int fluid_synth_queue_midi_events(fluid_synth_t *synth, fluid_midi_event_t **events,
+                                  const unsigned int *offsets, int count);
+
 /** @ingroup soundfonts */
 FLUIDSYNTH_API
 int fluid_synth_pin_preset(fluid_synth_t *synth, int sfont_id, int bank_num, int preset_num);
@@ -588,6 +824,28 @@ int fluid_synth_pin_preset(fluid_synth_t *synth, int sfont_id, int bank_num, int
 FLUIDSYNTH_API
 int fluid_synth_unpin_preset(fluid_synth_t *synth, int sfont_id, int bank_num, int preset_num);
 
+/** @ingroup soundfonts */
+FLUIDSYNTH_API
+int fluid_synth_is_preset_loaded(fluid_synth_t *synth, int sfont_id, int bank_num, int preset_num);
+
+/**
+ * Called when a warm-up started by fluid_synth_warm_preset() has finished.
+ *
+ * @param data User data given to fluid_synth_warm_preset()
+ * @param sfont_id SoundFont ID given to fluid_synth_warm_preset()
+ * @param bank_num MIDI bank number given to fluid_synth_warm_preset()
+ * @param preset_num MIDI program number given to fluid_synth_warm_preset()
+ * @param status #FLUID_OK if all presets have been warmed up, #FLUID_FAILED otherwise
+ *
+ * @since 2.6.0
+ */
+typedef void (*fluid_warm_callback_t)(void *data, int sfont_id, int bank_num, int preset_num, int status);
+
+/** @ingroup soundfonts */
+FLUIDSYNTH_API
+int fluid_synth_warm_preset(fluid_synth_t *synth, int sfont_id, int bank_num, int preset_num,
+                            fluid_warm_callback_t callback, void *data);
+
 /** @ingroup ladspa */
 FLUIDSYNTH_API fluid_ladspa_fx_t *fluid_synth_get_ladspa_fx(fluid_synth_t *synth);
 
@@ -35,6 +35,7 @@ extern "C" {
  */
 
 typedef struct _fluid_hashtable_t fluid_settings_t;             /**< Configuration settings instance */
+typedef struct _fluid_settings_handle_t fluid_settings_handle_t; /**< Resolved name of a numeric or integer setting */
 typedef struct _fluid_synth_t fluid_synth_t;                    /**< Synthesizer instance */
 typedef struct _fluid_voice_t fluid_voice_t;                    /**< Synthesis voice instance */
 typedef struct _fluid_sfloader_t fluid_sfloader_t;              /**< SoundFont loader plugin */
@@ -57,6 +58,10 @@ typedef struct _fluid_sequencer_t fluid_sequencer_t;            /**< Sequencer i
 typedef struct _fluid_cmd_handler_t fluid_cmd_handler_t;        /**< Shell Command Handler */
 typedef struct _fluid_ladspa_fx_t fluid_ladspa_fx_t;            /**< LADSPA effects instance */
 typedef struct _fluid_file_callbacks_t fluid_file_callbacks_t;  /**< Callback struct to perform custom file loading of soundfonts */
+typedef struct _fluid_render_pool_t fluid_render_pool_t;        /**< Worker threads shared by several synthesizers */
+typedef struct _fluid_synth_pool_t fluid_synth_pool_t;          /**< Synthesizers created in advance to be leased out */
+typedef struct _fluid_render_server_t fluid_render_server_t;    /**< Server rendering synthesizers for other processes */
+typedef struct _fluid_render_client_t fluid_render_client_t;    /**< Client of a render server */
 
 typedef int fluid_istream_t;    /**< Input stream descriptor */
 typedef int fluid_ostream_t;    /**< Output stream descriptor */
@@ -24,6 +24,8 @@
 #include "fluid_midi_router.h"
 #include "fluid_sfont.h"
 #include "fluid_chan.h"
+#include "fluid_adriver.h"
+#include "fluid_samplecache.h"
 
 /* FIXME: LADSPA used to need a lot of parameters on a single line. This is not
  * necessary anymore, so the limits below could probably be reduced */
@@ -63,11 +65,24 @@ static void fluid_shell_init(fluid_shell_t *shell,
                              fluid_istream_t in, fluid_ostream_t out);
 static int fluid_handle_voice_count(void *data, int ac, char **av,
                                     fluid_ostream_t out);
+static int fluid_handle_audiostats(void *data, int ac, char **av,
+                                   fluid_ostream_t out);
+static int fluid_handle_cpustats(void *data, int ac, char **av,
+                                 fluid_ostream_t out);
+static int fluid_handle_voicestats(void *data, int ac, char **av,
+                                   fluid_ostream_t out);
+static int fluid_handle_memstats(void *data, int ac, char **av,
+                                 fluid_ostream_t out);
+static int fluid_handle_trace(void *data, int ac, char **av,
+                              fluid_ostream_t out);
 
 void fluid_shell_settings(fluid_settings_t *settings)
 {
     fluid_settings_register_str(settings, "shell.prompt", "", 0);
     fluid_settings_register_int(settings, "shell.port", 9800, 1, 65535, 0);
+    fluid_settings_register_int(settings, "shell.event-port", 0, 0, 65535, 0);
+    fluid_settings_register_int(settings, "shell.metrics-port", 0, 0, 65535, 0);
+    fluid_settings_register_int(settings, "shell.render-clients", 4, 1, 256, 0);
 }
 
 
@@ -198,6 +213,26 @@ static const fluid_cmd_t fluid_commands[] =
         "voice_count", "general", fluid_handle_voice_count,
         "voice_count                Get number of active synthesis voices"
     },
+    {
+        "audiostats", "general", fluid_handle_audiostats,
+        "audiostats [reset]         Print (or reset) underruns, timing and latency of the audio drivers"
+    },
+    {
+        "cpustats", "general", fluid_handle_cpustats,
+        "cpustats [reset]           Print (or reset) the CPU time of the voices per channel and preset"
+    },
+    {
+        "voicestats", "general", fluid_handle_voicestats,
+        "voicestats [reset]         Print (or reset) the voices started, stolen and dropped per channel"
+    },
+    {
+        "memstats", "general", fluid_handle_memstats,
+        "memstats                   Print the memory allocated by the synth, its SoundFonts and the sample cache"
+    },
+    {
+        "trace", "general", fluid_handle_trace,
+        "trace start [n]|stop|dump file  Record trace spans (n per thread), stop or write them as Chrome JSON"
+    },
     /* tuning commands */
     {
         "tuning", "tuning", fluid_handle_tuning,
@@ -748,8 +783,7 @@ fluid_handle_pitch_bend_range(void *data, int ac, char **av, fluid_ostream_t out
 
     channum = atoi(av[0]);
     value = atoi(av[1]);
-    fluid_channel_set_pitch_wheel_sensitivity(handler->synth->channel[channum], value);
-    return FLUID_OK;
+    return fluid_synth_pitch_wheel_sens(handler->synth, channum, value);
 }
 
 int
@@ -1178,6 +1212,269 @@ fluid_handle_voice_count(void *data, int ac, char **av,
     return FLUID_OK;
 }
 
+struct fluid_audiostats_data
+{
+    fluid_ostream_t out;
+    int reset;
+    int count;
+};
+
+static void
+fluid_audiostats_print(void *data, fluid_audio_driver_t *driver)
+{
+    struct fluid_audiostats_data *d = (struct fluid_audiostats_data *)data;
+    fluid_audio_driver_stats_t stats;
+    int i;
+
+    d->count++;
+
+    if(d->reset)
+    {
+        fluid_audio_driver_reset_stats(driver);
+        return;
+    }
+
+    fluid_audio_driver_get_stats(driver, &stats);
+
+    fluid_ostream_printf(d->out, "audio driver %d:\n", d->count);
+    fluid_ostream_printf(d->out, "  periods:      %u\n", stats.periods);
+    fluid_ostream_printf(d->out, "  xruns:        %u\n", stats.xruns);
+    fluid_ostream_printf(d->out, "  callback avg: %.1f us\n", stats.callback_avg);
+    fluid_ostream_printf(d->out, "  callback max: %.1f us\n", stats.callback_max);
+    fluid_ostream_printf(d->out, "  margin min:   %.1f us\n", stats.margin_min);
+    fluid_ostream_printf(d->out, "  latency:      %.1f us\n", stats.latency);
+    fluid_ostream_printf(d->out, "  load:        ");
+
+    for(i = 0; i < FLUID_AUDIO_DRIVER_LOAD_BINS - 1; i++)
+    {
+        fluid_ostream_printf(d->out, " <%d%%:%u", (i + 1) * 10, stats.load_histogram[i]);
+    }
+
+    fluid_ostream_printf(d->out, " >=%d%%:%u\n", i * 10, stats.load_histogram[i]);
+}
+
+/* Response to audiostats command */
+static int
+fluid_handle_audiostats(void *data, int ac, char **av, fluid_ostream_t out)
+{
+    FLUID_ENTRY_COMMAND(data);
+    struct fluid_audiostats_data d;
+
+    d.out = out;
+    d.reset = (ac > 0 && FLUID_STRCMP(av[0], "reset") == 0);
+    d.count = 0;
+
+    if(ac > 0 && !d.reset)
+    {
+        fluid_ostream_printf(out, "audiostats: invalid argument '%s'\n", av[0]);
+        return FLUID_FAILED;
+    }
+
+    fluid_audio_driver_foreach(handler->settings, fluid_audiostats_print, &d);
+
+    if(d.count == 0)
+    {
+        fluid_ostream_printf(out, "audiostats: no audio driver running\n");
+    }
+
+    return FLUID_OK;
+}
+
+static void
+fluid_cpustats_print(fluid_ostream_t out, const char *name, const fluid_cpu_stats_t *stats)
+{
+    fluid_ostream_printf(out, "  %-16s %12.0f us %6.2f%% %7.1f voices\n",
+                         name, stats->usec, stats->load * 100.0, stats->voices);
+}
+
+/* Response to cpustats command */
+static int
+fluid_handle_cpustats(void *data, int ac, char **av, fluid_ostream_t out)
+{
+    FLUID_ENTRY_COMMAND(data);
+    fluid_cpu_stats_t stats;
+    char name[32];
+    int accounting, i, sfont_id, bank, prog;
+
+    if(ac > 0)
+    {
+        if(FLUID_STRCMP(av[0], "reset") != 0)
+        {
+            fluid_ostream_printf(out, "cpustats: invalid argument '%s'\n", av[0]);
+            return FLUID_FAILED;
+        }
+
+        fluid_synth_reset_perf_stats(handler->synth);
+        return FLUID_OK;
+    }
+
+    fluid_settings_getint(handler->settings, "synth.cpu-accounting", &accounting);
+
+    if(!accounting)
+    {
+        fluid_ostream_printf(out, "cpustats: synth.cpu-accounting is disabled\n");
+    }
+
+    fluid_ostream_printf(out, "channels:\n");
+
+    for(i = 0; i < fluid_synth_count_midi_channels(handler->synth); i++)
+    {
+        fluid_synth_get_channel_cpu_stats(handler->synth, i, &stats);
+
+        if(stats.usec > 0.0)
+        {
+            FLUID_SNPRINTF(name, sizeof(name), "%d", i);
+            fluid_cpustats_print(out, name, &stats);
+        }
+    }
+
+    fluid_ostream_printf(out, "presets (sfont:bank:prog):\n");
+
+    for(i = 0; fluid_synth_get_preset_cpu_stats(handler->synth, i, &sfont_id, &bank, &prog, &stats) == FLUID_OK; i++)
+    {
+        if(stats.usec > 0.0)
+        {
+            FLUID_SNPRINTF(name, sizeof(name), "%d:%d:%d", sfont_id, bank, prog);
+            fluid_cpustats_print(out, name, &stats);
+        }
+    }
+
+    return FLUID_OK;
+}
+
+static void
+fluid_voicestats_print(fluid_ostream_t out, const char *name, const fluid_voice_counters_t *counters)
+{
+    fluid_ostream_printf(out, "%-6s %10u %10u %10u %10u %10u %6d\n", name, counters->started,
+                         counters->stolen, counters->killed_exclusive, counters->finished,
+                         counters->dropped, counters->peak);
+}
+
+/* Response to voicestats command */
+static int
+fluid_handle_voicestats(void *data, int ac, char **av, fluid_ostream_t out)
+{
+    FLUID_ENTRY_COMMAND(data);
+    fluid_voice_counters_t counters;
+    char name[16];
+    int i;
+
+    if(ac > 0)
+    {
+        if(FLUID_STRCMP(av[0], "reset") != 0)
+        {
+            fluid_ostream_printf(out, "voicestats: invalid argument '%s'\n", av[0]);
+            return FLUID_FAILED;
+        }
+
+        fluid_synth_reset_voice_counters(handler->synth);
+        return FLUID_OK;
+    }
+
+    fluid_ostream_printf(out, "%-6s %10s %10s %10s %10s %10s %6s\n", "chan", "started", "stolen",
+                         "exclusive", "finished", "dropped", "peak");
+
+    for(i = 0; i < fluid_synth_count_midi_channels(handler->synth); i++)
+    {
+        fluid_synth_get_voice_counters(handler->synth, i, &counters);
+
+        if(counters.started > 0 || counters.dropped > 0)
+        {
+            FLUID_SNPRINTF(name, sizeof(name), "%d", i);
+            fluid_voicestats_print(out, name, &counters);
+        }
+    }
+
+    fluid_synth_get_voice_counters(handler->synth, -1, &counters);
+    fluid_voicestats_print(out, "all", &counters);
+
+    return FLUID_OK;
+}
+
+/* Response to memstats command */
+static int
+fluid_handle_memstats(void *data, int ac, char **av, fluid_ostream_t out)
+{
+    FLUID_ENTRY_COMMAND(data);
+    fluid_synth_memory_t usage;
+    fluid_sfont_memory_t sfont_usage;
+    fluid_sample_cache_memory_t cache;
+    fluid_sfont_t *sfont;
+    int i;
+
+    if(fluid_synth_get_memory_usage(handler->synth, &usage) != FLUID_OK)
+    {
+        fluid_ostream_printf(out, "memstats: failed to get the memory usage\n");
+        return FLUID_FAILED;
+    }
+
+    fluid_ostream_printf(out, "voices:      %10lu bytes\n", (unsigned long)usage.voices);
+    fluid_ostream_printf(out, "mixer:       %10lu bytes\n", (unsigned long)usage.mixer);
+    fluid_ostream_printf(out, "effects:     %10lu bytes\n", (unsigned long)usage.effects);
+    fluid_ostream_printf(out, "events:      %10lu bytes\n", (unsigned long)usage.events);
+    fluid_ostream_printf(out, "voice cache: %10lu bytes\n", (unsigned long)usage.voice_cache);
+    fluid_ostream_printf(out, "other:       %10lu bytes\n", (unsigned long)usage.other);
+    fluid_ostream_printf(out, "total:       %10lu bytes\n", (unsigned long)usage.total);
+
+    for(i = fluid_synth_sfcount(handler->synth) - 1; i >= 0; i--)
+    {
+        sfont = fluid_synth_get_sfont(handler->synth, i);
+
+        if(fluid_synth_get_sfont_memory_usage(handler->synth, fluid_sfont_get_id(sfont), &sfont_usage) == FLUID_OK)
+        {
+            fluid_ostream_printf(out, "soundfont %d: %lu bytes of samples, %lu mapped, %lu shared, %lu bytes of metadata, %s\n",
+                                 fluid_sfont_get_id(sfont), (unsigned long)sfont_usage.samples,
+                                 (unsigned long)sfont_usage.samples_mapped, (unsigned long)sfont_usage.samples_shared,
+                                 (unsigned long)sfont_usage.metadata, fluid_sfont_get_name(sfont));
+        }
+    }
+
+    if(fluid_sample_get_cache_memory(&cache) == FLUID_OK)
+    {
+        fluid_ostream_printf(out, "sample cache: %lu bytes in memory, %lu mapped, %lu shared, in %d blocks\n",
+                             (unsigned long)cache.in_memory, (unsigned long)cache.mapped,
+                             (unsigned long)cache.shared, cache.entries);
+    }
+
+    return FLUID_OK;
+}
+
+/* Response to trace command */
+static int
+fluid_handle_trace(void *data, int ac, char **av, fluid_ostream_t out)
+{
+    if(ac > 0 && FLUID_STRCMP(av[0], "start") == 0)
+    {
+        if(fluid_trace_start(ac > 1 ? atoi(av[1]) : 0) != FLUID_OK)
+        {
+            fluid_ostream_printf(out, "trace: failed to start recording\n");
+            return FLUID_FAILED;
+        }
+
+        return FLUID_OK;
+    }
+
+    if(ac > 0 && FLUID_STRCMP(av[0], "stop") == 0)
+    {
+        fluid_trace_stop();
+        return FLUID_OK;
+    }
+
+    if(ac > 1 && FLUID_STRCMP(av[0], "dump") == 0)
+    {
+        if(fluid_trace_dump(av[1]) != FLUID_OK)
+        {
+            fluid_ostream_printf(out, "trace: failed to write '%s'\n", av[1]);
+            return FLUID_FAILED;
+        }
+
+        return FLUID_OK;
+    }
+
+    fluid_ostream_printf(out, "trace: use 'trace start [n]', 'trace stop' or 'trace dump file'\n");
+    return FLUID_FAILED;
+}
+
 /* Purpose:
  * Response to 'interp' command. */
 int
@@ -1195,7 +1492,8 @@ fluid_handle_interp(void *data, int ac, char **av, fluid_ostream_t out)
 
     interp = atoi(av[0]);
 
-    if((interp < 0) || (interp > FLUID_INTERP_HIGHEST))
+    if((interp < 0) || (interp > FLUID_INTERP_HIGHEST
+            && interp != FLUID_INTERP_AUTO && interp != FLUID_INTERP_16THORDER))
     {
         fluid_ostream_printf(out, "interp: Bad value\n");
         return FLUID_FAILED;
@@ -1230,7 +1528,8 @@ fluid_handle_interpc(void *data, int ac, char **av, fluid_ostream_t out)
         return FLUID_FAILED;
     };
 
-    if((interp < 0) || (interp > FLUID_INTERP_HIGHEST))
+    if((interp < 0) || (interp > FLUID_INTERP_HIGHEST
+            && interp != FLUID_INTERP_AUTO && interp != FLUID_INTERP_16THORDER))
     {
         fluid_ostream_printf(out, "interp: Bad value for interpolation method.\n");
         return FLUID_FAILED;
@@ -2670,7 +2969,7 @@ int fluid_handle_legatomode(void *data, int ac, char **av,
 {
     static const char name_cde[] = "legatomode";
     static const char *const name_legato_mode[FLUID_CHANNEL_LEGATO_MODE_LAST] =
-    {	"(0)retrigger", "(1)multi-retrigger"	};
+    {	"(0)retrigger", "(1)multi-retrigger", "(2)single-trigger"	};
 
     FLUID_ENTRY_COMMAND(data);
     fluid_synth_t *synth = handler->synth;
@@ -4264,6 +4563,25 @@ fluid_cmd_handler_handle(void *data, int ac, char **av, fluid_ostream_t out)
 
 #ifdef NETWORK_SUPPORT
 
+/*
+ * The event port of the server (shell.event-port) takes binary frames of MIDI events,
+ * all numbers in network byte order:
+ *
+ *   frame: uint16 count, followed by count events of 8 bytes each
+ *   event: uint32 offset  in samples, relative to when the frame is received
+ *          uint8  status  MIDI status byte of a channel message, or 0xFF (system reset)
+ *          uint8  data1   first MIDI data byte
+ *          uint8  data2   second MIDI data byte, 0 if the message has only one
+ *          uint8  port    MIDI port, the event goes to channel port * 16 + (status & 0x0F)
+ *
+ * Nothing is sent back, so that clients can send frames without waiting. All clients are
+ * served by one thread, and the events of all frames received at once are queued to the
+ * synth with a single fluid_synth_queue_midi_events() call.
+ */
+#define FLUID_EVENT_FRAME_HEADER_SIZE   2
+#define FLUID_EVENT_SIZE                8
+#define FLUID_EVENT_FRAME_MAX_EVENTS    4096
+
 struct _fluid_server_t
 {
     fluid_server_socket_t *socket;
@@ -4273,6 +4591,18 @@ struct _fluid_server_t
     fluid_player_t *player;
     fluid_list_t *clients;
     fluid_mutex_t mutex;
+
+    /* event port, only used by the thread of event_socket */
+    fluid_poll_server_socket_t *event_socket;
+    fluid_midi_event_t *events;
+    fluid_midi_event_t **event_ptrs;
+    unsigned int *event_offsets;
+
+    /* metrics port, only used by the thread of metrics_socket */
+    fluid_poll_server_socket_t *metrics_socket;
+    fluid_audio_driver_t *adriver;  /* atomic, see fluid_server_set_audio_driver() */
+    char *metrics;
+    int metrics_len;
 };
 
 static void fluid_server_close(fluid_server_t *server)
@@ -4304,6 +4634,359 @@ static void fluid_server_close(fluid_server_t *server)
         delete_fluid_server_socket(server->socket);
         server->socket = NULL;
     }
+
+    if(server->event_socket)
+    {
+        delete_fluid_poll_server_socket(server->event_socket);
+        server->event_socket = NULL;
+    }
+
+    if(server->metrics_socket)
+    {
+        delete_fluid_poll_server_socket(server->metrics_socket);
+        server->metrics_socket = NULL;
+    }
+
+    FLUID_FREE(server->metrics);
+
+    FLUID_FREE(server->events);
+    FLUID_FREE(server->event_ptrs);
+    FLUID_FREE(server->event_offsets);
+}
+
+/*
+ * Decodes an event of the event port into a MIDI event.
+ * Returns FLUID_FAILED for unsupported status bytes.
+ */
+static int
+fluid_server_decode_event(const unsigned char *buf, fluid_midi_event_t *event, unsigned int *offset)
+{
+    *offset = ((unsigned int)buf[0] << 24) | ((unsigned int)buf[1] << 16)
+              | ((unsigned int)buf[2] << 8) | buf[3];
+
+    return fluid_midi_event_unpack(event, &buf[4]);
+}
+
+/*
+ * Receive function of the event port. Consumes all complete frames in buf and queues
+ * their events, in batches of at most FLUID_EVENT_FRAME_MAX_EVENTS events.
+ */
+static int
+fluid_server_handle_events(fluid_server_t *server, fluid_socket_t client_socket,
+                           const unsigned char *buf, int len)
+{
+    int pos = 0, count, i, n = 0;
+
+    while(len - pos >= FLUID_EVENT_FRAME_HEADER_SIZE)
+    {
+        count = (buf[pos] << 8) | buf[pos + 1];
+
+        if(count > FLUID_EVENT_FRAME_MAX_EVENTS)
+        {
+            FLUID_LOG(FLUID_WARN, "Event frame of %d events exceeds the limit of %d, closing the connection",
+                      count, FLUID_EVENT_FRAME_MAX_EVENTS);
+            return -1;
+        }
+
+        if(len - pos < FLUID_EVENT_FRAME_HEADER_SIZE + count * FLUID_EVENT_SIZE)
+        {
+            break;
+        }
+
+        if(n + count > FLUID_EVENT_FRAME_MAX_EVENTS)
+        {
+            fluid_synth_queue_midi_events(server->synth, server->event_ptrs, server->event_offsets, n);
+            n = 0;
+        }
+
+        pos += FLUID_EVENT_FRAME_HEADER_SIZE;
+
+        for(i = 0; i < count; i++, pos += FLUID_EVENT_SIZE)
+        {
+            if(fluid_server_decode_event(&buf[pos], &server->events[n], &server->event_offsets[n]) == FLUID_OK)
+            {
+                server->event_ptrs[n] = &server->events[n];
+                n++;
+            }
+            else
+            {
+                FLUID_LOG(FLUID_WARN, "Ignoring event with unsupported status byte 0x%02X", buf[pos + 4]);
+            }
+        }
+    }
+
+    if(n > 0)
+    {
+        fluid_synth_queue_midi_events(server->synth, server->event_ptrs, server->event_offsets, n);
+    }
+
+    return pos;
+}
+
+/* Opens the event port, if enabled */
+static int
+fluid_server_open_event_port(fluid_server_t *server)
+{
+    int port;
+
+    fluid_settings_getint(server->settings, "shell.event-port", &port);
+
+    if(port == 0 || server->synth == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    server->events = FLUID_ARRAY(fluid_midi_event_t, FLUID_EVENT_FRAME_MAX_EVENTS);
+    server->event_ptrs = FLUID_ARRAY(fluid_midi_event_t *, FLUID_EVENT_FRAME_MAX_EVENTS);
+    server->event_offsets = FLUID_ARRAY(unsigned int, FLUID_EVENT_FRAME_MAX_EVENTS);
+
+    if(server->events == NULL || server->event_ptrs == NULL || server->event_offsets == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    server->event_socket = new_fluid_poll_server_socket(port,
+                           (fluid_server_recv_func_t) fluid_server_handle_events,
+                           server);
+
+    return (server->event_socket != NULL) ? FLUID_OK : FLUID_FAILED;
+}
+
+/*
+ * The metrics port of the server (shell.metrics-port) answers HTTP requests for /metrics
+ * with the performance counters of the synth in the text format of Prometheus. Everything
+ * is read without the API lock of the synth, which the rendering thread needs to apply
+ * queued MIDI events, so that scraping never delays the audio.
+ */
+#define FLUID_METRICS_BUFSIZE   8192
+
+static const char *const fluid_metrics_stages[FLUID_PERF_STAGE_LAST] =
+{
+    "render", "voices", "reverb", "chorus"
+};
+
+/* Appends to the metrics being formatted, what doesn't fit is dropped */
+static void
+fluid_server_metrics_printf(fluid_server_t *server, const char *format, ...)
+{
+    int room = FLUID_METRICS_BUFSIZE - server->metrics_len;
+    va_list args;
+    int n;
+
+    va_start(args, format);
+    n = FLUID_VSNPRINTF(server->metrics + server->metrics_len, room, format, args);
+    va_end(args);
+
+    if(n > 0 && n < room)
+    {
+        server->metrics_len += n;
+    }
+}
+
+/* Appends a metric of a single sample, name without the fluidsynth_ prefix */
+static void
+fluid_server_metrics_value(fluid_server_t *server, const char *name, const char *type,
+                           const char *help, double value)
+{
+    fluid_server_metrics_printf(server, "# HELP fluidsynth_%s %s\n# TYPE fluidsynth_%s %s\nfluidsynth_%s %.15g\n",
+                                name, help, name, type, name, value);
+}
+
+static void
+fluid_server_format_metrics(fluid_server_t *server)
+{
+    fluid_synth_t *synth = server->synth;
+    fluid_audio_driver_t *adriver = fluid_atomic_pointer_get(&server->adriver);
+    fluid_perf_stats_t perf[FLUID_PERF_STAGE_LAST], latency;
+    fluid_audio_driver_stats_t audio;
+    fluid_sample_residency_stats_t residency;
+    fluid_sample_dedup_stats_t dedup;
+    fluid_voice_counters_t voices;
+    size_t sample_bytes;
+    int i;
+
+    server->metrics_len = 0;
+
+    for(i = 0; i < FLUID_PERF_STAGE_LAST; i++)
+    {
+        fluid_synth_get_perf_stats(synth, (enum fluid_perf_stage)i, -1, &perf[i]);
+    }
+
+    fluid_server_metrics_printf(server, "# HELP fluidsynth_render_seconds Time taken by a render stage, while synth.perf-stats is enabled\n"
+                                "# TYPE fluidsynth_render_seconds summary\n");
+
+    for(i = 0; i < FLUID_PERF_STAGE_LAST; i++)
+    {
+        fluid_server_metrics_printf(server, "fluidsynth_render_seconds{stage=\"%s\",quantile=\"0.99\"} %.9g\n"
+                                    "fluidsynth_render_seconds_sum{stage=\"%s\"} %.9g\n"
+                                    "fluidsynth_render_seconds_count{stage=\"%s\"} %u\n",
+                                    fluid_metrics_stages[i], perf[i].p99 / 1000000.0,
+                                    fluid_metrics_stages[i], perf[i].avg * perf[i].count / 1000000.0,
+                                    fluid_metrics_stages[i], perf[i].count);
+    }
+
+    fluid_server_metrics_printf(server, "# HELP fluidsynth_render_max_seconds Longest time taken by a render stage\n"
+                                "# TYPE fluidsynth_render_max_seconds gauge\n");
+
+    for(i = 0; i < FLUID_PERF_STAGE_LAST; i++)
+    {
+        fluid_server_metrics_printf(server, "fluidsynth_render_max_seconds{stage=\"%s\"} %.9g\n",
+                                    fluid_metrics_stages[i], perf[i].max / 1000000.0);
+    }
+
+    fluid_synth_get_note_latency_stats(synth, &latency);
+    fluid_server_metrics_printf(server, "# HELP fluidsynth_note_latency_seconds Time from a note-on received by a MIDI driver to its first sample being heard, while synth.perf-stats is enabled\n"
+                                "# TYPE fluidsynth_note_latency_seconds summary\n"
+                                "fluidsynth_note_latency_seconds{quantile=\"0.99\"} %.9g\n"
+                                "fluidsynth_note_latency_seconds_sum %.9g\n"
+                                "fluidsynth_note_latency_seconds_count %u\n",
+                                latency.p99 / 1000000.0, latency.avg * latency.count / 1000000.0, latency.count);
+    fluid_server_metrics_value(server, "note_latency_max_seconds", "gauge",
+                               "Longest note latency", latency.max / 1000000.0);
+
+    if(adriver != NULL && fluid_audio_driver_get_stats(adriver, &audio) == FLUID_OK)
+    {
+        fluid_server_metrics_value(server, "audio_periods_total", "counter",
+                                   "Audio periods rendered", audio.periods);
+        fluid_server_metrics_value(server, "audio_xruns_total", "counter",
+                                   "Underruns reported by the audio API", audio.xruns);
+        fluid_server_metrics_value(server, "audio_callback_seconds", "gauge",
+                                   "Time spent rendering an audio period, averaged over the last ones", audio.callback_avg / 1000000.0);
+        fluid_server_metrics_value(server, "audio_callback_max_seconds", "gauge",
+                                   "Longest time spent rendering an audio period", audio.callback_max / 1000000.0);
+        fluid_server_metrics_value(server, "audio_margin_min_seconds", "gauge",
+                                   "Smallest time left at the end of an audio period", audio.margin_min / 1000000.0);
+    }
+
+    fluid_server_metrics_value(server, "active_voices", "gauge",
+                               "Voices playing", synth->active_voice_count);
+    fluid_synth_get_voice_counters(synth, -1, &voices);
+    fluid_server_metrics_value(server, "voices_started_total", "counter",
+                               "Voices started", voices.started);
+    fluid_server_metrics_value(server, "voices_stolen_total", "counter",
+                               "Voices killed to make room for new ones", voices.stolen);
+    fluid_server_metrics_value(server, "voices_killed_exclusive_total", "counter",
+                               "Voices released by a new voice of the same exclusive class", voices.killed_exclusive);
+    fluid_server_metrics_value(server, "voices_finished_total", "counter",
+                               "Voices that ended without being stolen", voices.finished);
+    fluid_server_metrics_value(server, "voices_dropped_total", "counter",
+                               "Voices not started because none could be stolen for them", voices.dropped);
+    fluid_server_metrics_value(server, "voices_peak", "gauge",
+                               "Most voices active at once", voices.peak);
+    fluid_server_metrics_value(server, "event_queue_peak", "gauge",
+                               "Most events that have been waiting for the rendering at once", synth->eventhandler->peak);
+    fluid_server_metrics_value(server, "midi_queue_events", "gauge",
+                               "Queued MIDI events waiting to be applied", fluid_atomic_int_get(&synth->midi_queue_count));
+
+    fluid_sample_get_residency_stats(&residency);
+    fluid_server_metrics_value(server, "sample_cache_hits_total", "counter",
+                               "Samples of selected presets found in memory by dynamic sample loading", residency.hits);
+    fluid_server_metrics_value(server, "sample_cache_misses_total", "counter",
+                               "Samples of selected presets dynamic sample loading had to load", residency.misses);
+    fluid_server_metrics_value(server, "sample_cache_evictions_total", "counter",
+                               "Unused samples unloaded to stay within the dynamic sample loading budget", residency.evictions);
+
+    fluid_sample_get_dedup_stats(&dedup);
+    sample_bytes = fluid_samplecache_get_size();
+    fluid_server_metrics_value(server, "sample_memory_bytes", "gauge",
+                               "Sample data of the SoundFonts loaded in this process, in memory or mapped", (double)sample_bytes);
+    fluid_server_metrics_value(server, "sample_dedup_saved_bytes", "gauge",
+                               "Sample data stored only once for identical samples", (double)dedup.bytes_saved);
+}
+
+/* Sends all of buf, returns FLUID_FAILED if the connection broke */
+static int
+fluid_server_send(fluid_socket_t sock, const char *buf, int len)
+{
+    int n;
+
+    while(len > 0)
+    {
+        n = send(sock, buf, len, 0);
+
+        if(n <= 0)
+        {
+            return FLUID_FAILED;
+        }
+
+        buf += n;
+        len -= n;
+    }
+
+    return FLUID_OK;
+}
+
+/*
+ * Receive function of the metrics port. Waits for the complete header of a request,
+ * answers it and closes the connection.
+ */
+static int
+fluid_server_handle_metrics(fluid_server_t *server, fluid_socket_t client_socket,
+                            const unsigned char *buf, int len)
+{
+    static const char not_found[] = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    const char *request = (const char *)buf;
+    char header[160];
+    int i, n;
+
+    for(i = 0; i + 4 <= len && FLUID_STRNCMP(&request[i], "\r\n\r\n", 4) != 0; i++)
+    {
+    }
+
+    if(i + 4 > len)
+    {
+        return 0;
+    }
+
+    if(FLUID_STRNCMP(request, "GET /metrics", 12) == 0
+            && (request[12] == ' ' || request[12] == '?'))
+    {
+        fluid_server_format_metrics(server);
+
+        n = FLUID_SNPRINTF(header, sizeof(header), "HTTP/1.0 200 OK\r\n"
+                           "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                           "Content-Length: %d\r\nConnection: close\r\n\r\n", server->metrics_len);
+
+        if(fluid_server_send(client_socket, header, n) == FLUID_OK)
+        {
+            fluid_server_send(client_socket, server->metrics, server->metrics_len);
+        }
+    }
+    else
+    {
+        fluid_server_send(client_socket, not_found, sizeof(not_found) - 1);
+    }
+
+    return -1;
+}
+
+/* Opens the metrics port, if enabled */
+static int
+fluid_server_open_metrics_port(fluid_server_t *server)
+{
+    int port;
+
+    fluid_settings_getint(server->settings, "shell.metrics-port", &port);
+
+    if(port == 0 || server->synth == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    server->metrics = FLUID_ARRAY(char, FLUID_METRICS_BUFSIZE);
+
+    if(server->metrics == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    server->metrics_socket = new_fluid_poll_server_socket(port,
+                             (fluid_server_recv_func_t) fluid_server_handle_metrics,
+                             server);
+
+    return (server->metrics_socket != NULL) ? FLUID_OK : FLUID_FAILED;
 }
 
 static int
@@ -4444,6 +5127,13 @@ new_fluid_server(fluid_settings_t *settings,
  * @param router If not NULL, the midi_router instance for the command handler to be used by the client
  * @param player If not NULL, the player instance for the command handler to be used by the client
  * @return New shell server instance or NULL on error
+ *
+ * If the setting shell.event-port is not 0 and a synth is given, the server also accepts binary
+ * frames of timestamped MIDI events on that port, see the documentation of that setting.
+ *
+ * If the setting shell.metrics-port is not 0 and a synth is given, the server also answers
+ * HTTP requests for the path /metrics on that port with the performance counters of the synth,
+ * in the text format of Prometheus, see the documentation of that setting.
  */
 fluid_server_t *
 new_fluid_server2(fluid_settings_t *settings,
@@ -4467,6 +5157,13 @@ new_fluid_server2(fluid_settings_t *settings,
     server->synth = synth;
     server->router = router;
     server->player = player;
+    server->event_socket = NULL;
+    server->events = NULL;
+    server->event_ptrs = NULL;
+    server->event_offsets = NULL;
+    server->metrics_socket = NULL;
+    server->adriver = NULL;
+    server->metrics = NULL;
 
     fluid_mutex_init(server->mutex);
 
@@ -4482,6 +5179,13 @@ new_fluid_server2(fluid_settings_t *settings,
         return NULL;
     }
 
+    if(fluid_server_open_event_port(server) != FLUID_OK
+            || fluid_server_open_metrics_port(server) != FLUID_OK)
+    {
+        delete_fluid_server(server);
+        return NULL;
+    }
+
     return server;
 #else
     FLUID_LOG(FLUID_WARN, "Network support disabled on this platform.");
@@ -4520,3 +5224,21 @@ int fluid_server_join(fluid_server_t *server)
     return FLUID_FAILED;
 #endif
 }
+
+/**
+ * Set the audio driver whose statistics the metrics port of a server reports.
+ *
+ * @param server Shell server instance
+ * @param driver The audio driver rendering the synth of the server, NULL for none
+ *
+ * The driver must not be deleted before the server, or before it has been replaced
+ * by another one or NULL. See the setting shell.metrics-port.
+ * @since 2.6.0
+ */
+void fluid_server_set_audio_driver(fluid_server_t *server, fluid_audio_driver_t *driver)
+{
+#ifdef NETWORK_SUPPORT
+    fluid_return_if_fail(server != NULL);
+    fluid_atomic_pointer_set(&server->adriver, driver);
+#endif
+}
@@ -29,20 +29,47 @@
 #include <sndfile.h>
 #endif
 
+/* The minimum number of frames of a buffer handed over to the writer thread */
+#define FLUID_FILE_RENDERER_BUFFER_FRAMES 16384
+
+/* The maximum of audio.file.buffers */
+#define FLUID_FILE_RENDERER_MAX_BUFFERS 64
+
+#if LIBSNDFILE_SUPPORT
+typedef float fluid_file_sample_t;
+#else
+typedef short fluid_file_sample_t;
+#endif
+
 struct _fluid_file_renderer_t
 {
     fluid_synth_t *synth;
 
 #if LIBSNDFILE_SUPPORT
     SNDFILE *sndfile;
-    float *buf;
 #else
     FILE *file;
-    short *buf;
 #endif
 
     int period_size;
-    int buf_size;
+
+    /* Interleaved stereo buffers. Without a writer thread there is only one, written
+     * after each period. Otherwise they form a ring: the synth fills one while the
+     * writer thread writes the ones filled before. */
+    fluid_file_sample_t **bufs;
+    int buf_count;
+    int buf_frames;             /* the size of each buffer in frames, a multiple of period_size */
+    int fill;                   /* the buffer being filled */
+    int filled;                 /* the number of frames in it */
+
+    fluid_thread_t *writer;
+    fluid_cond_mutex_t *mutex;  /* protects the fields below */
+    fluid_cond_t *cond;         /* signalled whenever they change */
+    int write;                  /* the next buffer to write */
+    int queued;                 /* the number of buffers handed over and not written yet */
+    int queued_frames[FLUID_FILE_RENDERER_MAX_BUFFERS];
+    int quit;
+    int failed;                 /* TRUE once writing has failed */
 };
 
 #if LIBSNDFILE_SUPPORT
@@ -118,6 +145,7 @@ fluid_file_renderer_settings(fluid_settings_t *settings)
     fluid_settings_register_str(settings, "audio.file.type", "auto", 0);
     fluid_settings_register_str(settings, "audio.file.format", "s16", 0);
     fluid_settings_register_str(settings, "audio.file.endian", "auto", 0);
+    fluid_settings_register_int(settings, "audio.file.buffers", 4, 1, FLUID_FILE_RENDERER_MAX_BUFFERS, 0);
 
     fluid_settings_add_option(settings, "audio.file.type", "auto");
 
@@ -165,9 +193,136 @@ fluid_file_renderer_settings(fluid_settings_t *settings)
     fluid_settings_add_option(settings, "audio.file.format", "s16");
     fluid_settings_register_str(settings, "audio.file.endian", "cpu", 0);
     fluid_settings_add_option(settings, "audio.file.endian", "cpu");
+    fluid_settings_register_int(settings, "audio.file.buffers", 4, 1, FLUID_FILE_RENDERER_MAX_BUFFERS, 0);
 #endif
 }
 
+static int
+fluid_file_renderer_write(fluid_file_renderer_t *dev, fluid_file_sample_t *buf, int frames)
+{
+#if LIBSNDFILE_SUPPORT
+
+    if(sf_writef_float(dev->sndfile, buf, frames) != frames)
+    {
+        FLUID_LOG(FLUID_ERR, "Audio file write error: %s",
+                  sf_strerror(dev->sndfile));
+        return FLUID_FAILED;
+    }
+
+#else   /* No libsndfile support */
+
+    size_t nmemb = 2 * frames * sizeof(*buf);
+
+    if(fwrite(buf, 1, nmemb, dev->file) < nmemb)
+    {
+        FLUID_LOG(FLUID_ERR, "Audio output file write error: %s",
+                  strerror(errno));
+        return FLUID_FAILED;
+    }
+
+#endif
+
+    return FLUID_OK;
+}
+
+/* The writer thread, writes the buffers in the order they are handed over */
+static fluid_thread_return_t
+fluid_file_renderer_run(void *data)
+{
+    fluid_file_renderer_t *dev = data;
+    int index, frames, result;
+
+    fluid_cond_mutex_lock(dev->mutex);
+
+    for(;;)
+    {
+        while(dev->queued == 0 && !dev->quit)
+        {
+            fluid_cond_wait(dev->cond, dev->mutex);
+        }
+
+        if(dev->queued == 0)
+        {
+            break;
+        }
+
+        index = dev->write;
+        frames = dev->queued_frames[index];
+        result = dev->failed ? FLUID_FAILED : FLUID_OK;
+        fluid_cond_mutex_unlock(dev->mutex);
+
+        /* don't go on writing after an error, there would be a gap */
+        if(result == FLUID_OK)
+        {
+            result = fluid_file_renderer_write(dev, dev->bufs[index], frames);
+        }
+
+        fluid_cond_mutex_lock(dev->mutex);
+        dev->failed |= (result != FLUID_OK);
+        dev->write = (index + 1) % dev->buf_count;
+        dev->queued--;
+        fluid_cond_broadcast(dev->cond);
+    }
+
+    fluid_cond_mutex_unlock(dev->mutex);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/* Hands the buffer being filled over to the writer thread and waits for the next one to be free */
+static int
+fluid_file_renderer_queue(fluid_file_renderer_t *dev)
+{
+    int failed;
+
+    fluid_cond_mutex_lock(dev->mutex);
+    dev->queued_frames[dev->fill] = dev->filled;
+    dev->queued++;
+    fluid_cond_broadcast(dev->cond);
+
+    while(dev->queued == dev->buf_count)
+    {
+        fluid_cond_wait(dev->cond, dev->mutex);
+    }
+
+    failed = dev->failed;
+    fluid_cond_mutex_unlock(dev->mutex);
+
+    dev->fill = (dev->fill + 1) % dev->buf_count;
+    dev->filled = 0;
+
+    return failed ? FLUID_FAILED : FLUID_OK;
+}
+
+/* Waits until everything rendered so far has been written */
+static int
+fluid_file_renderer_flush(fluid_file_renderer_t *dev)
+{
+    int failed;
+
+    if(dev->writer == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    if(dev->filled > 0)
+    {
+        fluid_file_renderer_queue(dev);
+    }
+
+    fluid_cond_mutex_lock(dev->mutex);
+
+    while(dev->queued > 0)
+    {
+        fluid_cond_wait(dev->cond, dev->mutex);
+    }
+
+    failed = dev->failed;
+    fluid_cond_mutex_unlock(dev->mutex);
+
+    return failed ? FLUID_FAILED : FLUID_OK;
+}
+
 /**
  * Create a new file renderer and open the file.
  *
@@ -185,6 +340,7 @@ fluid_file_renderer_settings(fluid_settings_t *settings)
  *   - \ref settings_audio_file_format : Audio format
  *   - \ref settings_audio_file_endian : Endian byte order, "auto" for file type's default byte order
  *   - \ref settings_audio_period-size : Size of audio blocks to process
+ *   - \ref settings_audio_file_buffers : Number of buffers of the writer thread
  *   - \ref settings_synth_sample-rate : Sample rate to use
  *
  * @since 1.1.0
@@ -198,7 +354,7 @@ new_fluid_file_renderer(fluid_synth_t *synth)
     double samplerate;
     int retval;
 #endif
-    int audio_channels;
+    int i, audio_channels;
     char *filename = NULL;
     fluid_file_renderer_t *dev;
 
@@ -217,21 +373,49 @@ new_fluid_file_renderer(fluid_synth_t *synth)
 
     dev->synth = synth;
     fluid_settings_getint(synth->settings, "audio.period-size", &dev->period_size);
+    fluid_settings_getint(synth->settings, "audio.file.buffers", &dev->buf_count);
 
-#if LIBSNDFILE_SUPPORT
-    dev->buf_size = 2 * dev->period_size * sizeof(float);
-    dev->buf = FLUID_ARRAY(float, 2 * dev->period_size);
-#else
-    dev->buf_size = 2 * dev->period_size * sizeof(short);
-    dev->buf = FLUID_ARRAY(short, 2 * dev->period_size);
-#endif
+    if(dev->buf_count > 1)
+    {
+        /* large buffers, so that the writer thread doesn't have to wake up too often */
+        dev->buf_frames = (FLUID_FILE_RENDERER_BUFFER_FRAMES + dev->period_size - 1)
+                          / dev->period_size * dev->period_size;
+        dev->mutex = new_fluid_cond_mutex();
+        dev->cond = new_fluid_cond();
+
+        if(dev->mutex == NULL || dev->cond == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
+    }
+    else
+    {
+        dev->buf_count = 1;
+        dev->buf_frames = dev->period_size;
+    }
 
-    if(dev->buf == NULL)
+    dev->bufs = FLUID_ARRAY(fluid_file_sample_t *, dev->buf_count);
+
+    if(dev->bufs == NULL)
     {
         FLUID_LOG(FLUID_ERR, "Out of memory");
         goto error_recovery;
     }
 
+    FLUID_MEMSET(dev->bufs, 0, dev->buf_count * sizeof(*dev->bufs));
+
+    for(i = 0; i < dev->buf_count; i++)
+    {
+        dev->bufs[i] = FLUID_ARRAY(fluid_file_sample_t, 2 * dev->buf_frames);
+
+        if(dev->bufs[i] == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
+    }
+
     fluid_settings_dupstr(synth->settings, "audio.file.name", &filename);
     fluid_settings_getint(synth->settings, "synth.audio-channels", &audio_channels);
 
@@ -350,6 +534,16 @@ new_fluid_file_renderer(fluid_synth_t *synth)
         FLUID_LOG(FLUID_WARN, "The file-renderer currently only supports a single stereo channel. You have provided %d stereo channels. Audio may sound strange or incomplete.", audio_channels);
     }
 
+    if(dev->buf_count > 1)
+    {
+        dev->writer = new_fluid_thread("file-writer", fluid_file_renderer_run, dev, 0, FALSE);
+
+        if(dev->writer == NULL)
+        {
+            FLUID_LOG(FLUID_WARN, "Failed to create the file writer thread, writing synchronously");
+        }
+    }
+
     FLUID_FREE(filename);
     return dev;
 
@@ -372,6 +566,9 @@ fluid_file_set_encoding_quality(fluid_file_renderer_t *dev, double q)
 {
 #if LIBSNDFILE_SUPPORT
 
+    /* not while the writer thread is encoding */
+    fluid_file_renderer_flush(dev);
+
     if(sf_command(dev->sndfile, SFC_SET_VBR_ENCODING_QUALITY, &q, sizeof(double)) == SF_TRUE)
     {
         return FLUID_OK;
@@ -390,8 +587,23 @@ fluid_file_set_encoding_quality(fluid_file_renderer_t *dev, double q)
  */
 void delete_fluid_file_renderer(fluid_file_renderer_t *dev)
 {
+    int i;
+
     fluid_return_if_fail(dev != NULL);
 
+    if(dev->writer != NULL)
+    {
+        fluid_file_renderer_flush(dev);
+
+        fluid_cond_mutex_lock(dev->mutex);
+        dev->quit = TRUE;
+        fluid_cond_broadcast(dev->cond);
+        fluid_cond_mutex_unlock(dev->mutex);
+
+        fluid_thread_join(dev->writer);
+        delete_fluid_thread(dev->writer);
+    }
+
 #if LIBSNDFILE_SUPPORT
 
     if(dev->sndfile != NULL)
@@ -413,7 +625,23 @@ void delete_fluid_file_renderer(fluid_file_renderer_t *dev)
 
 #endif
 
-    FLUID_FREE(dev->buf);
+    for(i = 0; dev->bufs != NULL && i < dev->buf_count; i++)
+    {
+        FLUID_FREE(dev->bufs[i]);
+    }
+
+    FLUID_FREE(dev->bufs);
+
+    if(dev->cond != NULL)
+    {
+        delete_fluid_cond(dev->cond);
+    }
+
+    if(dev->mutex != NULL)
+    {
+        delete_fluid_cond_mutex(dev->mutex);
+    }
+
     FLUID_FREE(dev);
 }
 
@@ -421,44 +649,37 @@ void delete_fluid_file_renderer(fluid_file_renderer_t *dev)
  * Write period_size samples to file.
  * @param dev File renderer instance
  * @return #FLUID_OK or #FLUID_FAILED if an error occurred
+ *
+ * Unless \setting{audio_file_buffers} is 1, the audio is written by a separate thread in
+ * large chunks, so that encoding and writing overlap with synthesis. Write errors are
+ * then reported by a later call.
  * @since 1.1.0
  */
 int
 fluid_file_renderer_process_block(fluid_file_renderer_t *dev)
 {
-#if LIBSNDFILE_SUPPORT
-    int n;
-
-    fluid_synth_write_float(dev->synth, dev->period_size, dev->buf, 0, 2, dev->buf, 1, 2);
+    fluid_file_sample_t *buf = dev->bufs[dev->fill];
+    int offset = 2 * dev->filled;
 
-    n = sf_writef_float(dev->sndfile, dev->buf, dev->period_size);
+#if LIBSNDFILE_SUPPORT
+    fluid_synth_write_float(dev->synth, dev->period_size, buf, offset, 2, buf, offset + 1, 2);
+#else
+    fluid_synth_write_s16(dev->synth, dev->period_size, buf, offset, 2, buf, offset + 1, 2);
+#endif
 
-    if(n != dev->period_size)
+    if(dev->writer == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Audio file write error: %s",
-                  sf_strerror(dev->sndfile));
-        return FLUID_FAILED;
+        return fluid_file_renderer_write(dev, buf, dev->period_size);
     }
 
-    return FLUID_OK;
-
-#else   /* No libsndfile support */
-
-    size_t res, nmemb = dev->buf_size;
-
-    fluid_synth_write_s16(dev->synth, dev->period_size, dev->buf, 0, 2, dev->buf, 1, 2);
-
-    res = fwrite(dev->buf, 1, nmemb, dev->file);
+    dev->filled += dev->period_size;
 
-    if(res < nmemb)
+    if(dev->filled < dev->buf_frames)
     {
-        FLUID_LOG(FLUID_ERR, "Audio output file write error: %s",
-                  strerror(errno));
-        return FLUID_FAILED;
+        return FLUID_OK;
     }
 
-    return FLUID_OK;
-#endif
+    return fluid_file_renderer_queue(dev);
 }
 
 
@@ -75,6 +75,10 @@ typedef struct _fluid_ladspa_node_t
     int num_inputs;
     int num_outputs;
 
+    /* Number of effect outputs adding to the buffer (run_adding), which need
+     * the buffer to be cleared or filled from the host buffer first */
+    int num_mixing_inputs;
+
 } fluid_ladspa_node_t;
 
 typedef struct _fluid_ladspa_effect_t
@@ -98,6 +102,10 @@ typedef struct _fluid_ladspa_effect_t
     /* Used to keep track of the port connection state */
     fluid_ladspa_node_t **port_nodes;
 
+    /* Index of the chain of effects this one depends on or that depend on it,
+     * see update_chains() */
+    int chain;
+
 } fluid_ladspa_effect_t;
 
 struct _fluid_ladspa_fx_t
@@ -113,6 +121,12 @@ struct _fluid_ladspa_fx_t
 
     fluid_list_t *effects;
 
+    /* Number of independent chains of effects, determined at activation */
+    int num_chains;
+
+    /* Maximum number of threads running chains in parallel */
+    int max_threads;
+
     fluid_rec_mutex_t api_mutex;
 
     fluid_atomic_int_t state;
@@ -158,6 +172,9 @@ static const LADSPA_Descriptor *get_plugin_descriptor(fluid_module_t *lib, const
 static int check_all_ports_connected(fluid_ladspa_effect_t *effect, const char **name);
 static int check_no_inplace_broken(fluid_ladspa_effect_t *effect, const char **name1, const char **name2);
 static int check_host_output_used(fluid_ladspa_fx_t *fx);
+static void update_mixing_inputs(fluid_ladspa_fx_t *fx);
+static int update_chains(fluid_ladspa_fx_t *fx);
+static void run_chain(fluid_ladspa_fx_t *fx, int chain, int num_samples);
 static int check_all_audio_nodes_connected(fluid_ladspa_fx_t *fx, const char **name);
 
 #ifndef WITH_FLOAT
@@ -190,6 +207,7 @@ fluid_ladspa_fx_t *new_fluid_ladspa_fx(fluid_real_t sample_rate, int buffer_size
 
     fluid_atomic_int_set(&fx->state, FLUID_LADSPA_INACTIVE);
     fx->buffer_size = buffer_size;
+    fx->max_threads = 1;
 
     /* add 0.5 to minimize overall casting error */
     fx->sample_rate = (unsigned long)(sample_rate + 0.5);
@@ -405,6 +423,13 @@ int fluid_ladspa_activate(fluid_ladspa_fx_t *fx)
         LADSPA_API_RETURN(fx, FLUID_FAILED);
     }
 
+    update_mixing_inputs(fx);
+
+    if(update_chains(fx) != FLUID_OK)
+    {
+        LADSPA_API_RETURN(fx, FLUID_FAILED);
+    }
+
     for(list = fx->effects; list; list = fluid_list_next(list))
     {
         effect = (fluid_ladspa_effect_t *) fluid_list_get(list);
@@ -511,15 +536,17 @@ int fluid_ladspa_reset(fluid_ladspa_fx_t *fx)
  * FluidSynth calls this function during main output mixing,
  * just before processing the internal reverb and chorus effects.
  *
- * It copies audio data from the supplied buffers, runs all effects and copies the
- * resulting audio back into the same buffers.
+ * If FluidSynth has been compiled WITH_FLOAT, the effects work directly on the
+ * supplied buffers. Otherwise it converts the audio data of the supplied buffers read
+ * by the effects, runs all effects and converts the resulting audio back into the
+ * buffers written by them. Only the buffers of user nodes that effects add to are
+ * cleared before.
  */
 void fluid_ladspa_run(fluid_ladspa_fx_t *fx, int block_count, int block_size)
 {
-    int num_samples;
+    int num_samples, threads, i;
     fluid_list_t *list;
     fluid_ladspa_node_t *node;
-    fluid_ladspa_effect_t *effect;
 
     /* Somebody wants to deactivate the engine, so let's give them a chance to do that.
      * And check that there is at least one effect, to avoid the overhead of the
@@ -545,22 +572,23 @@ void fluid_ladspa_run(fluid_ladspa_fx_t *fx, int block_count, int block_size)
     {
         node = (fluid_ladspa_node_t *) fluid_list_get(list);
 
-        FLUID_MEMSET(node->effect_buffer, 0, fx->buffer_size * sizeof(LADSPA_Data));
+        /* effects writing with run() replace the contents of the buffer anyway */
+        if(node->num_mixing_inputs > 0)
+        {
+            FLUID_MEMSET(node->effect_buffer, 0, num_samples * sizeof(LADSPA_Data));
+        }
     }
 
-    /* Run each effect in the order that they were added */
-    for(list = fx->effects; list; list = fluid_list_next(list))
-    {
-        effect = (fluid_ladspa_effect_t *) fluid_list_get(list);
+    /* Run the independent chains of effects in parallel */
+    threads = (fx->num_chains < fx->max_threads) ? fx->num_chains : fx->max_threads;
+    threads = (threads > 1) ? threads : 1;
 
-        if(effect->mix)
-        {
-            effect->desc->run_adding(effect->handle, num_samples);
-        }
-        else
-        {
-            effect->desc->run(effect->handle, num_samples);
-        }
+#if ENABLE_MIXER_THREADS && !defined(WITH_PROFILING)
+    #pragma omp parallel for schedule(dynamic) num_threads(threads) if(threads > 1)
+#endif
+    for(i = 0; i < fx->num_chains; i++)
+    {
+        run_chain(fx, i, num_samples);
     }
 
 #ifndef WITH_FLOAT
@@ -582,6 +610,25 @@ void fluid_ladspa_run(fluid_ladspa_fx_t *fx, int block_count, int block_size)
     }
 }
 
+/**
+ * Set the number of threads that may run independent chains of effects in parallel.
+ *
+ * @param fx LADSPA fx instance
+ * @param threads maximum number of threads, including the calling one
+ *
+ * Effects linked through a buffer that at least one of them writes to form a chain
+ * and are always run in the order they have been added. Chains that don't share such
+ * buffers, e.g. one per audio group, are run by up to this many threads.
+ */
+void fluid_ladspa_set_max_threads(fluid_ladspa_fx_t *fx, int threads)
+{
+    fluid_return_if_fail(fx != NULL);
+
+    LADSPA_API_ENTER(fx);
+    fx->max_threads = (threads > 1) ? threads : 1;
+    fluid_rec_mutex_unlock(fx->api_mutex);
+}
+
 /**
  * Check if the effect plugin supports the run_adding and set_run_adding_gain
  * interfaces necessary for output mixing
@@ -651,6 +698,7 @@ int fluid_ladspa_effect_set_mix(fluid_ladspa_fx_t *fx, const char *name, int mix
     }
 
     effect->mix = mix;
+    update_mixing_inputs(fx);
 
     LADSPA_API_RETURN(fx, FLUID_OK);
 }
@@ -689,6 +737,7 @@ static void clear_ladspa(fluid_ladspa_fx_t *fx)
 
         node->num_inputs = 0;
         node->num_outputs = 0;
+        node->num_mixing_inputs = 0;
     }
 }
 
@@ -1720,6 +1769,185 @@ static int check_host_output_used(fluid_ladspa_fx_t *fx)
     return FLUID_FAILED;
 }
 
+/**
+ * Run the effects of a chain in the order that they were added.
+ */
+static void run_chain(fluid_ladspa_fx_t *fx, int chain, int num_samples)
+{
+    fluid_list_t *list;
+    fluid_ladspa_effect_t *effect;
+
+    for(list = fx->effects; list; list = fluid_list_next(list))
+    {
+        effect = (fluid_ladspa_effect_t *) fluid_list_get(list);
+
+        if(effect->chain != chain)
+        {
+            continue;
+        }
+
+        if(effect->mix)
+        {
+            effect->desc->run_adding(effect->handle, num_samples);
+        }
+        else
+        {
+            effect->desc->run(effect->handle, num_samples);
+        }
+    }
+}
+
+/**
+ * TRUE if two effects share a node that at least one of them writes to, i.e.
+ * if the result depends on the order they are run in.
+ */
+static int effects_depend(const fluid_ladspa_effect_t *effect1, const fluid_ladspa_effect_t *effect2)
+{
+    unsigned int i, k;
+
+    for(i = 0; i < effect1->desc->PortCount; i++)
+    {
+        for(k = 0; k < effect2->desc->PortCount; k++)
+        {
+            if(effect1->port_nodes[i] == effect2->port_nodes[k]
+                    && (LADSPA_IS_PORT_OUTPUT(effect1->desc->PortDescriptors[i])
+                        || LADSPA_IS_PORT_OUTPUT(effect2->desc->PortDescriptors[k])))
+            {
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Split the effects into chains that don't depend on each other, numbered in
+ * the order of their first effect.
+ *
+ * @param fx LADSPA fx instance
+ * @return FLUID_OK on success, otherwise FLUID_FAILED
+ */
+static int update_chains(fluid_ladspa_fx_t *fx)
+{
+    int count = fluid_list_size(fx->effects);
+    fluid_ladspa_effect_t **effects;
+    fluid_list_t *list;
+    int i, k, root;
+
+    fx->num_chains = 0;
+
+    if(count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    effects = FLUID_ARRAY(fluid_ladspa_effect_t *, count);
+
+    if(effects == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    for(i = 0, list = fx->effects; list; i++, list = fluid_list_next(list))
+    {
+        effects[i] = (fluid_ladspa_effect_t *) fluid_list_get(list);
+    }
+
+    /* A chain is identified by the index of its first effect. An effect joins the
+     * chains of the earlier effects it depends on, merging them if there are several. */
+    for(i = 0; i < count; i++)
+    {
+        root = i;
+
+        for(k = 0; k < i; k++)
+        {
+            if(effects[k]->chain != root && effects_depend(effects[i], effects[k]))
+            {
+                int first = (effects[k]->chain < root) ? effects[k]->chain : root;
+                int merged = (effects[k]->chain < root) ? root : effects[k]->chain;
+                int j;
+
+                for(j = 0; j < i; j++)
+                {
+                    if(effects[j]->chain == merged)
+                    {
+                        effects[j]->chain = first;
+                    }
+                }
+
+                root = first;
+            }
+        }
+
+        effects[i]->chain = root;
+    }
+
+    /* renumber the chains, so that they are 0 to num_chains - 1 */
+    for(i = 0; i < count; i++)
+    {
+        if(effects[i]->chain < i)
+        {
+            /* an earlier effect of this chain has been renumbered already */
+            effects[i]->chain = effects[effects[i]->chain]->chain;
+        }
+        else
+        {
+            effects[i]->chain = fx->num_chains++;
+        }
+    }
+
+    FLUID_FREE(effects);
+    return FLUID_OK;
+}
+
+/**
+ * Count the effect outputs in mix mode connected to each node.
+ *
+ * @param fx LADSPA fx instance
+ */
+static void update_mixing_inputs(fluid_ladspa_fx_t *fx)
+{
+    fluid_list_t *list;
+    fluid_ladspa_node_t *node;
+    fluid_ladspa_effect_t *effect;
+    unsigned int i;
+
+    for(list = fx->host_nodes; list; list = fluid_list_next(list))
+    {
+        node = (fluid_ladspa_node_t *) fluid_list_get(list);
+        node->num_mixing_inputs = 0;
+    }
+
+    for(list = fx->user_nodes; list; list = fluid_list_next(list))
+    {
+        node = (fluid_ladspa_node_t *) fluid_list_get(list);
+        node->num_mixing_inputs = 0;
+    }
+
+    for(list = fx->effects; list; list = fluid_list_next(list))
+    {
+        effect = (fluid_ladspa_effect_t *) fluid_list_get(list);
+
+        if(!effect->mix)
+        {
+            continue;
+        }
+
+        for(i = 0; i < effect->desc->PortCount; i++)
+        {
+            node = effect->port_nodes[i];
+
+            if(node != NULL && LADSPA_IS_PORT_OUTPUT(effect->desc->PortDescriptors[i])
+                    && LADSPA_IS_PORT_AUDIO(effect->desc->PortDescriptors[i]))
+            {
+                node->num_mixing_inputs++;
+            }
+        }
+    }
+}
+
 /**
  * Check that all user audio nodes have an input and an output
  *
@@ -1761,9 +1989,10 @@ static FLUID_INLINE void copy_host_to_effect_buffers(fluid_ladspa_fx_t *fx, int
     {
         node = (fluid_ladspa_node_t *) fluid_list_get(list);
 
-        /* Only copy host nodes that have at least one output or output, i.e.
-         * that are connected to at least one effect port. */
-        if(node->num_inputs > 0 || node->num_outputs > 0)
+        /* Only copy host nodes that are read by at least one effect, or that
+         * an effect adds its output to. The nodes that effects only write to
+         * with run() are overwritten anyway. */
+        if(node->num_outputs > 0 || node->num_mixing_inputs > 0)
         {
             for(i = 0; i < num_samples; i++)
             {
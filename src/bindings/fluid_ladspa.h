@@ -32,6 +32,7 @@ void delete_fluid_ladspa_fx(fluid_ladspa_fx_t *fx);
 int fluid_ladspa_set_sample_rate(fluid_ladspa_fx_t *fx, fluid_real_t sample_rate);
 
 void fluid_ladspa_run(fluid_ladspa_fx_t *fx, int block_count, int block_size);
+void fluid_ladspa_set_max_threads(fluid_ladspa_fx_t *fx, int threads);
 
 int fluid_ladspa_add_host_ports(fluid_ladspa_fx_t *fx, const char *prefix,
                                 int num_buffers, fluid_real_t buffers[], int buf_stride);
@@ -0,0 +1,1135 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Rendering of a player or a sequencer as fast as possible, skipping silence.
+ */
+
+#include "fluid_sys.h"
+#include "fluid_synth.h"
+#include "fluid_midi.h"
+
+/* A block whose samples all stay below this level (about -120 dBFS) is silent */
+#define FLUID_OFFLINE_SILENCE 1e-6f
+
+extern unsigned int fluid_sequencer_get_idle_msec(fluid_sequencer_t *seq);
+
+typedef struct
+{
+    fluid_synth_t *synth;
+    fluid_player_t *player;     /* the source of the events, either a player... */
+    fluid_sequencer_t *seq;     /* ...or a sequencer */
+    double frames;              /* the number of frames to render, for a sequencer */
+    double done;                /* the number of frames rendered so far */
+} fluid_offline_renderer_t;
+
+static int
+fluid_offline_is_running(fluid_offline_renderer_t *renderer)
+{
+    if(renderer->player != NULL)
+    {
+        return fluid_player_get_status(renderer->player) == FLUID_PLAYER_PLAYING;
+    }
+
+    return renderer->done < renderer->frames;
+}
+
+static double
+fluid_offline_get_progress(fluid_offline_renderer_t *renderer)
+{
+    int tick, total;
+
+    if(renderer->player != NULL)
+    {
+        if(!fluid_offline_is_running(renderer))
+        {
+            return 1.0;
+        }
+
+        tick = fluid_player_get_current_tick(renderer->player);
+        total = fluid_player_get_total_ticks(renderer->player);
+
+        if(total <= 0)
+        {
+            return 0.0;
+        }
+
+        return (tick < total) ? (double)tick / total : 1.0;
+    }
+
+    return (renderer->frames > 0) ? renderer->done / renderer->frames : 1.0;
+}
+
+/*
+ * Returns the number of frames that may be skipped from now on, if the latest block was silent.
+ */
+static double
+fluid_offline_get_idle_frames(fluid_offline_renderer_t *renderer)
+{
+    unsigned int msec;
+    double frames;
+
+    if(renderer->player != NULL)
+    {
+        msec = fluid_player_get_idle_msec(renderer->player);
+    }
+    else
+    {
+        msec = fluid_sequencer_get_idle_msec(renderer->seq);
+    }
+
+    /* the idle time counts from the latest timer callback, at the start of the latest block */
+    frames = msec * renderer->synth->sample_rate / 1000.0 - FLUID_BUFSIZE;
+
+    if(renderer->player == NULL && frames > renderer->frames - renderer->done)
+    {
+        frames = renderer->frames - renderer->done;
+    }
+
+    return (frames < INT_MAX - FLUID_BUFSIZE) ? frames : INT_MAX - FLUID_BUFSIZE;
+}
+
+static int
+fluid_offline_render(fluid_offline_renderer_t *renderer, int block_size,
+                     fluid_render_func_t func, void *data)
+{
+    float *left, *right;
+    int i, len, silent = FALSE, result = FLUID_OK;
+    double idle;
+
+    /* whole blocks of the synth, so that nothing is left buffered when skipping */
+    block_size = (block_size + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE * FLUID_BUFSIZE;
+
+    left = FLUID_ARRAY(float, block_size);
+    right = FLUID_ARRAY(float, block_size);
+
+    if(left == NULL || right == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(left);
+        FLUID_FREE(right);
+        return FLUID_FAILED;
+    }
+
+    while(result == FLUID_OK && fluid_offline_is_running(renderer))
+    {
+        if(silent)
+        {
+            idle = fluid_offline_get_idle_frames(renderer);
+            len = (idle >= FLUID_BUFSIZE) ? fluid_synth_skip_silence(renderer->synth, (int)idle) : 0;
+
+            /* the timer callbacks only learn about the skip with the next block rendered */
+            silent = FALSE;
+
+            if(len > 0)
+            {
+                renderer->done += len;
+                result = func(data, len, NULL, NULL, fluid_offline_get_progress(renderer));
+                continue;
+            }
+        }
+
+        len = block_size;
+
+        if(renderer->player == NULL && renderer->frames - renderer->done < len)
+        {
+            len = (int)(renderer->frames - renderer->done);
+        }
+
+        if(fluid_synth_write_float(renderer->synth, len, left, 0, 1, right, 0, 1) != FLUID_OK)
+        {
+            result = FLUID_FAILED;
+            break;
+        }
+
+        silent = (fluid_synth_get_active_voice_count(renderer->synth) == 0);
+
+        for(i = 0; silent && i < len; i++)
+        {
+            silent = (FLUID_FABS(left[i]) < FLUID_OFFLINE_SILENCE && FLUID_FABS(right[i]) < FLUID_OFFLINE_SILENCE);
+        }
+
+        renderer->done += len;
+        result = func(data, len, left, right, fluid_offline_get_progress(renderer));
+    }
+
+    FLUID_FREE(left);
+    FLUID_FREE(right);
+
+    return result;
+}
+
+/**
+ * Render a MIDI player to audio as fast as possible.
+ *
+ * Starts the player if needed and renders the synth of the player until it is done,
+ * handing the audio over to @p func block by block. Stretches of silence, e.g. at the
+ * beginning of a MIDI file or after its last note has died away, aren't rendered but
+ * skipped in one go and reported to @p func without a buffer.
+ *
+ * @param player MIDI player, using the sample timer (\setting{player_timing-source})
+ * @param block_size Number of audio frames per call of @p func, rounded up to a multiple of 64
+ * @param func Callback receiving the audio
+ * @param data User defined data passed to @p func
+ * @return #FLUID_OK on success, #FLUID_FAILED if rendering failed or has been aborted by @p func
+ *
+ * @note Events of other sample timers of the synth, e.g. of a sequencer, may be delayed
+ * while silence is skipped. When looping the player infinitely, @p func has to abort the rendering.
+ * @since 2.6.0
+ */
+int
+fluid_player_render(fluid_player_t *player, int block_size, fluid_render_func_t func, void *data)
+{
+    fluid_offline_renderer_t renderer;
+
+    fluid_return_val_if_fail(player != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(block_size > 0, FLUID_FAILED);
+    fluid_return_val_if_fail(func != NULL, FLUID_FAILED);
+
+    if(player->use_system_timer)
+    {
+        FLUID_LOG(FLUID_ERR, "Offline rendering requires player.timing-source=sample");
+        return FLUID_FAILED;
+    }
+
+    if(fluid_player_play(player) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(&renderer, 0, sizeof(renderer));
+    renderer.synth = player->synth;
+    renderer.player = player;
+
+    return fluid_offline_render(&renderer, block_size, func, data);
+}
+
+/**
+ * Render the events of a sequencer to audio as fast as possible.
+ *
+ * Renders the synth for the duration of the next @p ticks ticks of the sequencer,
+ * handing the audio over to @p func block by block. Stretches of silence without
+ * events aren't rendered but skipped in one go and reported to @p func without a buffer.
+ *
+ * @param seq Sequencer created with new_fluid_sequencer2(FALSE), to which @p synth has been
+ *   registered with fluid_sequencer_register_fluidsynth()
+ * @param synth The synth registered to @p seq
+ * @param ticks Duration to render, in ticks of the sequencer (see fluid_sequencer_set_time_scale())
+ * @param block_size Number of audio frames per call of @p func, rounded up to a multiple of 64
+ * @param func Callback receiving the audio
+ * @param data User defined data passed to @p func
+ * @return #FLUID_OK on success, #FLUID_FAILED if rendering failed or has been aborted by @p func
+ *
+ * @note Events of other sample timers of the synth, e.g. of a MIDI player, may be delayed
+ * while silence is skipped.
+ * @since 2.6.0
+ */
+int
+fluid_sequencer_render(fluid_sequencer_t *seq, fluid_synth_t *synth, unsigned int ticks,
+                       int block_size, fluid_render_func_t func, void *data)
+{
+    fluid_offline_renderer_t renderer;
+
+    fluid_return_val_if_fail(seq != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(block_size > 0, FLUID_FAILED);
+    fluid_return_val_if_fail(func != NULL, FLUID_FAILED);
+
+    if(fluid_sequencer_get_use_system_timer(seq))
+    {
+        FLUID_LOG(FLUID_ERR, "Offline rendering requires a sequencer not using the system timer");
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(&renderer, 0, sizeof(renderer));
+    renderer.synth = synth;
+    renderer.seq = seq;
+    renderer.frames = floor(ticks / fluid_sequencer_get_time_scale(seq) * synth->sample_rate);
+
+    return fluid_offline_render(&renderer, block_size, func, data);
+}
+
+/*
+ * Parallel rendering of a player, see fluid_player_render_parallel().
+ *
+ * The events of the MIDI file are recorded first, by playing the player without handing its
+ * events to its synth. The timeline is then split into chunks at ticks where no key is held
+ * and no pedal is down. Every chunk is rendered by a synth of its own, restored from a snapshot
+ * of the player's synth, after replaying all events before the chunk except the notes. A chunk
+ * plays the notes starting in it, and goes on handling all later events but note-ons until its
+ * voices and effects have died away. As the synthesis and the effects are linear, the overlapping
+ * tails of the chunks add up to the audio of the whole file.
+ */
+
+/* Chunks are at least this long, so that replaying the events before them doesn't dominate... */
+#define FLUID_OFFLINE_CHUNK_MIN_SEC 1
+
+/* ...and are split after this duration if possible, which limits the audio buffered */
+#define FLUID_OFFLINE_CHUNK_MAX_SEC 20
+
+/* Number of frames rendered at once by the synth of a chunk */
+#define FLUID_OFFLINE_CHUNK_BLOCK 4096
+
+typedef struct
+{
+    unsigned int tick;          /* sample time the event takes effect at, relative to the start of the player */
+    int offset;                 /* offset within the block at tick, with synth.sample-accurate-events */
+    fluid_midi_event_t evt;     /* copy of the event, SYSEX data is owned by the copy */
+} fluid_offline_event_t;
+
+typedef struct
+{
+    int first;                  /* index of the first event of the chunk */
+    int last;                   /* index of the first event of the next chunk, later note-ons are dropped */
+    unsigned int start;         /* tick of the first frame */
+    unsigned int end;           /* tick of the first frame of the next chunk */
+    int idle;                   /* of the last chunk, the frame from which on no voice plays, -1 if unknown */
+    int done;                   /* TRUE when rendered */
+    float *left, *right;        /* the audio from start on */
+    int frames;                 /* number of frames in left and right */
+    int size;                   /* number of frames allocated */
+} fluid_offline_chunk_t;
+
+typedef struct
+{
+    fluid_player_t *player;
+    fluid_synth_t *synth;       /* the synth of the player */
+    unsigned int start_tick;    /* ticks of the synth when the player has been started */
+    int end_tick;               /* tick the player reached the end of the file at, -1 until then */
+
+    fluid_offline_event_t *events;
+    int count;
+    int size;
+
+    char *snapshot;             /* the state of the player's synth before playing */
+    int snapshot_size;
+
+    fluid_offline_chunk_t *chunks;
+    int chunk_count;
+
+    fluid_cond_mutex_t *mutex;  /* protects the fields below */
+    fluid_cond_t *cond;         /* signalled whenever they change */
+    int next;                   /* the next chunk to be rendered */
+    int delivered;              /* number of chunks handed over to the callback */
+    int window;                 /* number of chunks rendered ahead of the callback at most */
+    int failed;                 /* TRUE if a chunk failed or the callback aborted */
+} fluid_offline_parallel_t;
+
+typedef struct
+{
+    fluid_offline_parallel_t *par;
+    fluid_synth_t *synth;
+    fluid_thread_t *thread;
+} fluid_offline_worker_t;
+
+/* Playback callback of the player while recording the events */
+static int
+fluid_offline_record(void *data, fluid_midi_event_t *event)
+{
+    fluid_offline_parallel_t *par = data;
+    fluid_offline_event_t *events, *rec;
+    int size;
+
+    /* meta events don't change the synth */
+    if(event->type == MIDI_TEXT || event->type == MIDI_LYRIC || event->type == MIDI_SET_TEMPO)
+    {
+        return FLUID_OK;
+    }
+
+    if(par->failed)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(par->count == par->size)
+    {
+        size = (par->size > 0) ? 2 * par->size : 1024;
+        events = FLUID_REALLOC(par->events, size * sizeof(*events));
+
+        if(events == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            par->failed = TRUE;
+            return FLUID_FAILED;
+        }
+
+        par->events = events;
+        par->size = size;
+    }
+
+    /* events played by a timer callback reach the voices with the next block rendered */
+    rec = &par->events[par->count];
+    rec->tick = fluid_synth_get_ticks(par->synth) - par->start_tick + FLUID_BUFSIZE;
+    rec->offset = par->synth->event_offset;
+    rec->evt = *event;
+    rec->evt.next = NULL;
+    rec->evt.paramptr = NULL;
+
+    if(event->type == MIDI_SYSEX && event->paramptr != NULL && event->param1 > 0)
+    {
+        rec->evt.paramptr = FLUID_MALLOC(event->param1);
+
+        if(rec->evt.paramptr == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            par->failed = TRUE;
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMCPY(rec->evt.paramptr, event->paramptr, event->param1);
+    }
+
+    par->count++;
+
+    return FLUID_OK;
+}
+
+/* Render callback while recording the events, notes when the player reaches the end of the file */
+static int
+fluid_offline_record_end(void *data, int len, const float *left, const float *right, double progress)
+{
+    fluid_offline_parallel_t *par = data;
+
+    /* the end has been scheduled by the timer callback at the start of the block just rendered */
+    if(par->end_tick < 0 && left != NULL && par->player->end_msec >= 0)
+    {
+        par->end_tick = (int)(fluid_synth_get_ticks(par->synth) - par->start_tick) - len + FLUID_BUFSIZE;
+    }
+
+    return par->failed ? FLUID_FAILED : FLUID_OK;
+}
+
+/* Keeps track of the keys held and the pedals down, for finding the ticks to split at */
+static void
+fluid_offline_track(fluid_offline_parallel_t *par, const fluid_midi_event_t *evt,
+                    char *held, int *held_count, char *pedals, int *pedal_count)
+{
+    int chan = evt->channel, i;
+
+    if(evt->type == MIDI_SYSTEM_RESET)
+    {
+        FLUID_MEMSET(held, 0, par->synth->midi_channels * 128);
+        FLUID_MEMSET(pedals, 0, par->synth->midi_channels);
+        *held_count = *pedal_count = 0;
+        return;
+    }
+
+    if(chan >= par->synth->midi_channels)
+    {
+        return;
+    }
+
+    if(evt->type == NOTE_ON && evt->param2 > 0 && evt->param1 < 128)
+    {
+        *held_count += !held[chan * 128 + evt->param1];
+        held[chan * 128 + evt->param1] = TRUE;
+    }
+    else if((evt->type == NOTE_OFF || evt->type == NOTE_ON) && evt->param1 < 128)
+    {
+        *held_count -= held[chan * 128 + evt->param1];
+        held[chan * 128 + evt->param1] = FALSE;
+    }
+    else if(evt->type == CONTROL_CHANGE)
+    {
+        *pedal_count -= (pedals[chan] != 0);
+
+        if(evt->param1 == SUSTAIN_SWITCH)
+        {
+            pedals[chan] = (evt->param2 >= 64) ? (pedals[chan] | 1) : (pedals[chan] & ~1);
+        }
+        else if(evt->param1 == SOSTENUTO_SWITCH)
+        {
+            pedals[chan] = (evt->param2 >= 64) ? (pedals[chan] | 2) : (pedals[chan] & ~2);
+        }
+        else if(evt->param1 == ALL_CTRL_OFF)
+        {
+            pedals[chan] = 0;
+        }
+
+        *pedal_count += (pedals[chan] != 0);
+
+        /* all notes off and the channel mode messages */
+        if(evt->param1 >= ALL_SOUND_OFF && evt->param1 != ALL_CTRL_OFF)
+        {
+            for(i = 0; i < 128; i++)
+            {
+                *held_count -= held[chan * 128 + i];
+                held[chan * 128 + i] = FALSE;
+            }
+        }
+    }
+}
+
+/*
+ * Splits the recorded events into chunks of about the given length, writing them to chunks
+ * unless it is NULL. Returns the number of chunks, or FLUID_FAILED.
+ */
+static int
+fluid_offline_split(fluid_offline_parallel_t *par, unsigned int length, fluid_offline_chunk_t *chunks)
+{
+    fluid_offline_event_t *events = par->events;
+    char *held = FLUID_ARRAY(char, par->synth->midi_channels * 128);
+    char *pedals = FLUID_ARRAY(char, par->synth->midi_channels);
+    int i, count = 0, held_count = 0, pedal_count = 0;
+    unsigned int start = 0;
+
+    if(held == NULL || pedals == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(held);
+        FLUID_FREE(pedals);
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(held, 0, par->synth->midi_channels * 128);
+    FLUID_MEMSET(pedals, 0, par->synth->midi_channels);
+
+    for(i = 0; i <= par->count; i++)
+    {
+        /* the start of a chunk, unless the notes of the previous one are still held */
+        if(i == 0 || i == par->count
+                || (events[i].tick > events[i - 1].tick && held_count == 0 && pedal_count == 0
+                    && events[i].tick - start >= length && events[i].tick < (unsigned int)par->end_tick))
+        {
+            if(chunks != NULL && count > 0)
+            {
+                chunks[count - 1].last = i;
+                chunks[count - 1].end = (i < par->count) ? events[i].tick : (unsigned int)par->end_tick;
+            }
+
+            start = (i > 0 && i < par->count) ? events[i].tick : start;
+
+            if(chunks != NULL && i < par->count)
+            {
+                chunks[count].first = i;
+                chunks[count].start = start;
+                chunks[count].idle = -1;
+            }
+
+            count += (i < par->count || count == 0);
+        }
+
+        if(i < par->count)
+        {
+            fluid_offline_track(par, &events[i].evt, held, &held_count, pedals, &pedal_count);
+        }
+    }
+
+    /* a file without events */
+    if(chunks != NULL && par->count == 0)
+    {
+        chunks[0].end = (unsigned int)par->end_tick;
+        chunks[0].idle = -1;
+    }
+
+    FLUID_FREE(held);
+    FLUID_FREE(pedals);
+
+    return count;
+}
+
+/* Makes room for the given number of frames in the buffers of a chunk */
+static int
+fluid_offline_reserve(fluid_offline_chunk_t *chunk, int frames)
+{
+    float *left, *right;
+    int size = (chunk->size > 0) ? chunk->size : FLUID_OFFLINE_CHUNK_BLOCK;
+
+    if(frames <= chunk->size)
+    {
+        return FLUID_OK;
+    }
+
+    while(size < frames)
+    {
+        size *= 2;
+    }
+
+    left = FLUID_REALLOC(chunk->left, size * sizeof(float));
+
+    if(left != NULL)
+    {
+        chunk->left = left;
+    }
+
+    right = FLUID_REALLOC(chunk->right, size * sizeof(float));
+
+    if(right != NULL)
+    {
+        chunk->right = right;
+    }
+
+    if(left == NULL || right == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    chunk->size = size;
+
+    return FLUID_OK;
+}
+
+/* Extends the audio of a chunk with silence up to the given number of frames */
+static int
+fluid_offline_extend(fluid_offline_chunk_t *chunk, int frames)
+{
+    if(frames <= chunk->frames)
+    {
+        return FLUID_OK;
+    }
+
+    if(fluid_offline_reserve(chunk, frames) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(chunk->left + chunk->frames, 0, (frames - chunk->frames) * sizeof(float));
+    FLUID_MEMSET(chunk->right + chunk->frames, 0, (frames - chunk->frames) * sizeof(float));
+    chunk->frames = frames;
+
+    return FLUID_OK;
+}
+
+/* Renders a chunk until its voices and effects have died away, with a synth of its own */
+static int
+fluid_offline_render_chunk(fluid_offline_parallel_t *par, fluid_synth_t *synth, fluid_offline_chunk_t *chunk)
+{
+    fluid_offline_event_t *events = par->events;
+    int is_last = (chunk == &par->chunks[par->chunk_count - 1]);
+    int i, k, len, ending = FALSE, silent = FALSE;
+    unsigned int pos = chunk->start, next;
+
+    if(fluid_synth_system_reset(synth) != FLUID_OK
+            || fluid_synth_restore(synth, par->snapshot, par->snapshot_size) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* the state of the channels at the start of the chunk, without the notes played before */
+    for(i = 0; i < chunk->first; i++)
+    {
+        if(events[i].evt.type != NOTE_ON && events[i].evt.type != NOTE_OFF)
+        {
+            fluid_synth_handle_midi_event(synth, &events[i].evt);
+        }
+    }
+
+    for(;;)
+    {
+        /* the notes of the following chunks are played by their own synths */
+        for(; i < par->count && events[i].tick <= pos; i++)
+        {
+            if(i < chunk->last || events[i].evt.type != NOTE_ON)
+            {
+                synth->event_offset = events[i].offset;
+                fluid_synth_handle_midi_event(synth, &events[i].evt);
+                synth->event_offset = 0;
+            }
+        }
+
+        if(pos >= chunk->end)
+        {
+            /* like the player does at the end of the file, see fluid_player_callback() */
+            if(is_last && !ending && fluid_synth_get_active_voice_count(synth) > 0)
+            {
+                for(k = 0; k < synth->midi_channels; k++)
+                {
+                    fluid_synth_cc(synth, k, SUSTAIN_SWITCH, 0);
+                    fluid_synth_cc(synth, k, SOSTENUTO_SWITCH, 0);
+                    fluid_synth_cc(synth, k, ALL_NOTES_OFF, 0);
+                }
+            }
+
+            ending = TRUE;
+
+            if(is_last && chunk->idle < 0 && fluid_synth_get_active_voice_count(synth) == 0)
+            {
+                chunk->idle = (int)(pos - chunk->start);
+            }
+
+            if(silent)
+            {
+                break;
+            }
+        }
+
+        next = (i < par->count) ? events[i].tick : UINT_MAX;
+
+        if(pos < chunk->end && next > chunk->end)
+        {
+            next = chunk->end;
+        }
+
+        len = (next - pos < FLUID_OFFLINE_CHUNK_BLOCK) ? (int)(next - pos) : FLUID_OFFLINE_CHUNK_BLOCK;
+
+        if(silent)
+        {
+            /* nothing to hear until the next event */
+            k = fluid_synth_skip_silence(synth, (next - pos < INT_MAX) ? (int)(next - pos) : INT_MAX);
+            silent = FALSE;
+
+            if(k > 0)
+            {
+                if(fluid_offline_extend(chunk, chunk->frames + k) != FLUID_OK)
+                {
+                    return FLUID_FAILED;
+                }
+
+                pos += k;
+                continue;
+            }
+        }
+
+        if(fluid_offline_reserve(chunk, chunk->frames + len) != FLUID_OK
+                || fluid_synth_write_float(synth, len, chunk->left, chunk->frames, 1,
+                                           chunk->right, chunk->frames, 1) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+
+        silent = (fluid_synth_get_active_voice_count(synth) == 0);
+
+        for(k = chunk->frames; silent && k < chunk->frames + len; k++)
+        {
+            silent = (FLUID_FABS(chunk->left[k]) < FLUID_OFFLINE_SILENCE && FLUID_FABS(chunk->right[k]) < FLUID_OFFLINE_SILENCE);
+        }
+
+        chunk->frames += len;
+        pos += len;
+    }
+
+    return FLUID_OK;
+}
+
+/* The worker threads, rendering the chunks in the order they are handed over */
+static fluid_thread_return_t
+fluid_offline_run(void *data)
+{
+    fluid_offline_worker_t *worker = data;
+    fluid_offline_parallel_t *par = worker->par;
+    int index, result;
+
+    fluid_cond_mutex_lock(par->mutex);
+
+    for(;;)
+    {
+        /* don't render too far ahead of the callback, the audio is kept until then */
+        while(!par->failed && par->next < par->chunk_count && par->next >= par->delivered + par->window)
+        {
+            fluid_cond_wait(par->cond, par->mutex);
+        }
+
+        if(par->failed || par->next == par->chunk_count)
+        {
+            break;
+        }
+
+        index = par->next++;
+        fluid_cond_mutex_unlock(par->mutex);
+
+        result = fluid_offline_render_chunk(par, worker->synth, &par->chunks[index]);
+
+        fluid_cond_mutex_lock(par->mutex);
+        par->chunks[index].done = TRUE;
+        par->failed |= (result != FLUID_OK);
+        fluid_cond_broadcast(par->cond);
+    }
+
+    fluid_cond_mutex_unlock(par->mutex);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/*
+ * Adds the tails of the chunks before to a chunk, hands its audio up to the start of the next
+ * chunk over to the callback and keeps the rest as the tail for the next chunk.
+ */
+static int
+fluid_offline_deliver(fluid_offline_parallel_t *par, fluid_offline_chunk_t *chunk, fluid_offline_chunk_t *tail,
+                      int block_size, fluid_render_func_t func, void *data)
+{
+    int is_last = (chunk == &par->chunks[par->chunk_count - 1]);
+    int grace = (int)(FLUID_PLAYER_STOP_GRACE_MS * par->synth->sample_rate / 1000);
+    double total = (double)par->end_tick + grace;
+    int i, pos, len, length, silent, result = FLUID_OK;
+    double progress;
+
+    if(fluid_offline_extend(chunk, tail->frames) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < tail->frames; i++)
+    {
+        chunk->left[i] += tail->left[i];
+        chunk->right[i] += tail->right[i];
+    }
+
+    if(is_last)
+    {
+        /* the player waits a bit once no voice plays anymore */
+        length = ((chunk->idle >= 0) ? chunk->idle : (int)(chunk->end - chunk->start)) + grace;
+        length = (length > chunk->frames) ? length : chunk->frames;
+    }
+    else
+    {
+        length = (int)(chunk->end - chunk->start);
+    }
+
+    if(fluid_offline_extend(chunk, length) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    for(pos = 0; result == FLUID_OK && pos < length; pos += len)
+    {
+        len = (length - pos < block_size) ? length - pos : block_size;
+        silent = TRUE;
+
+        for(i = pos; silent && i < pos + len; i++)
+        {
+            silent = (chunk->left[i] == 0.0f && chunk->right[i] == 0.0f);
+        }
+
+        progress = (chunk->start + pos + len) / total;
+
+        if(progress > 1.0 || (is_last && pos + len == length))
+        {
+            progress = 1.0;
+        }
+
+        result = func(data, len, silent ? NULL : chunk->left + pos, silent ? NULL : chunk->right + pos, progress);
+    }
+
+    /* what rings on into the next chunk */
+    tail->frames = 0;
+
+    if(result == FLUID_OK && chunk->frames > length)
+    {
+        result = fluid_offline_reserve(tail, chunk->frames - length);
+
+        if(result == FLUID_OK)
+        {
+            tail->frames = chunk->frames - length;
+            FLUID_MEMCPY(tail->left, chunk->left + length, tail->frames * sizeof(float));
+            FLUID_MEMCPY(tail->right, chunk->right + length, tail->frames * sizeof(float));
+        }
+    }
+
+    FLUID_FREE(chunk->left);
+    FLUID_FREE(chunk->right);
+    chunk->left = chunk->right = NULL;
+    chunk->frames = chunk->size = 0;
+
+    return result;
+}
+
+/* Creates the synth of a worker, restored to the state of the player's synth */
+static fluid_synth_t *
+fluid_offline_new_synth(fluid_offline_parallel_t *par)
+{
+    fluid_synth_t *synth = new_fluid_synth(par->synth->settings);
+    int dynamic_samples = 0;
+
+    if(synth == NULL)
+    {
+        return NULL;
+    }
+
+    /* the synths import the SoundFonts once, like the synths of a pool */
+    fluid_settings_getint(par->synth->settings, "synth.dynamic-sample-loading", &dynamic_samples);
+    synth->shared_sfonts = !dynamic_samples;
+
+    if(fluid_synth_restore(synth, par->snapshot, par->snapshot_size) != FLUID_OK)
+    {
+        delete_fluid_synth(synth);
+        return NULL;
+    }
+
+    return synth;
+}
+
+/* Plays the player without handing its events to its synth, only recording them */
+static int
+fluid_offline_record_events(fluid_offline_parallel_t *par)
+{
+    fluid_player_t *player = par->player;
+    int result;
+
+    par->snapshot_size = fluid_synth_snapshot(par->synth, NULL, 0);
+
+    if(par->snapshot_size == FLUID_FAILED)
+    {
+        return FLUID_FAILED;
+    }
+
+    par->snapshot = FLUID_ARRAY(char, par->snapshot_size);
+
+    if(par->snapshot == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    if(fluid_synth_snapshot(par->synth, par->snapshot, par->snapshot_size) != par->snapshot_size)
+    {
+        return FLUID_FAILED;
+    }
+
+    par->end_tick = -1;
+    par->start_tick = fluid_synth_get_ticks(par->synth);
+
+    /* the synth stays silent, so that rendering is about skipping from event to event */
+    fluid_player_set_playback_callback(player, fluid_offline_record, par);
+    result = fluid_player_render(player, FLUID_BUFSIZE, fluid_offline_record_end, par);
+    fluid_player_set_playback_callback(player, fluid_synth_handle_midi_event, par->synth);
+
+    if(result != FLUID_OK || par->failed)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(par->count > 0 && (par->end_tick < 0 || (unsigned int)par->end_tick < par->events[par->count - 1].tick))
+    {
+        par->end_tick = (int)par->events[par->count - 1].tick;
+    }
+
+    par->end_tick = (par->end_tick > 0) ? par->end_tick : 0;
+
+    return FLUID_OK;
+}
+
+/* Whether the output of the synth runs through LADSPA effects, which aren't linear in general */
+static int
+fluid_offline_ladspa_active(fluid_synth_t *synth)
+{
+#ifdef LADSPA
+    return synth->ladspa_fx != NULL && fluid_ladspa_is_active(synth->ladspa_fx);
+#else
+    return FALSE;
+#endif
+}
+
+/**
+ * Render a MIDI file with several threads, as fast as possible.
+ *
+ * Renders the same audio as fluid_player_render(), but on several cores: the events of the
+ * file are read first, then the file is split into chunks at points where no note is held.
+ * Every chunk is rendered by a synth of its own, restored to the state of the player's synth
+ * and sharing its SoundFonts. The chunks overlap by the release and effects tails of their notes,
+ * which are added up. The audio is handed over to @p func in order.
+ *
+ * @param player MIDI player, using the sample timer (\setting{player_timing-source}), which
+ *   hasn't been started yet
+ * @param threads Number of threads rendering the chunks, e.g. the number of CPU cores
+ * @param block_size Number of audio frames per call of @p func at most
+ * @param func Callback receiving the audio
+ * @param data User defined data passed to @p func
+ * @return #FLUID_OK on success, #FLUID_FAILED if rendering failed or has been aborted by @p func
+ *
+ * Only a player playing a single file once with fluid_synth_handle_midi_event() as its playback
+ * callback is rendered in parallel. Otherwise, if @p threads is 1, and if the synth runs its
+ * output through the limiter (\setting{synth_limiter_active}) or active LADSPA effects, whose
+ * output of overlapping chunks can't be added up, this is the same as fluid_player_render().
+ *
+ * @note The player's synth doesn't play the events itself. The audio differs from the one of
+ * fluid_player_render() by rounding errors, and where the state of a chunk's synth can't be
+ * restored from MIDI events: the modulation of the reverb and the chorus starts over with every chunk,
+ * portamento doesn't glide from a note of the previous chunk, voices of earlier chunks aren't
+ * stolen or cut by exclusive classes, and the silence at the end may differ in length slightly.
+ * @since 2.6.0
+ */
+int
+fluid_player_render_parallel(fluid_player_t *player, int threads, int block_size,
+                             fluid_render_func_t func, void *data)
+{
+    fluid_offline_parallel_t par;
+    fluid_offline_worker_t *workers = NULL;
+    fluid_offline_chunk_t tail;
+    unsigned int length;
+    int i, limiter = 0, started = 0, result = FLUID_FAILED;
+
+    fluid_return_val_if_fail(player != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(threads > 0, FLUID_FAILED);
+    fluid_return_val_if_fail(block_size > 0, FLUID_FAILED);
+    fluid_return_val_if_fail(func != NULL, FLUID_FAILED);
+
+    fluid_settings_getint(player->synth->settings, "synth.limiter.active", &limiter);
+
+    if(threads == 1 || limiter || fluid_offline_ladspa_active(player->synth)
+            || fluid_player_get_status(player) != FLUID_PLAYER_READY
+            || player->playlist == NULL || fluid_list_next(player->playlist) != NULL
+            || (player->loop != 0 && player->loop != 1) || fluid_atomic_int_get(&player->seek_ticks) >= 0
+            || player->playback_callback != fluid_synth_handle_midi_event
+            || player->playback_userdata != player->synth)
+    {
+        return fluid_player_render(player, block_size, func, data);
+    }
+
+    if(player->use_system_timer)
+    {
+        FLUID_LOG(FLUID_ERR, "Offline rendering requires player.timing-source=sample");
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(&par, 0, sizeof(par));
+    FLUID_MEMSET(&tail, 0, sizeof(tail));
+    par.player = player;
+    par.synth = player->synth;
+    par.window = 2 * threads;
+
+    if(fluid_offline_record_events(&par) != FLUID_OK)
+    {
+        goto exit;
+    }
+
+    /* a few chunks per thread, so that they are kept busy */
+    length = (unsigned int)par.end_tick / (4 * threads);
+    length = (length > FLUID_OFFLINE_CHUNK_MIN_SEC * par.synth->sample_rate) ? length : (unsigned int)(FLUID_OFFLINE_CHUNK_MIN_SEC * par.synth->sample_rate);
+    length = (length < FLUID_OFFLINE_CHUNK_MAX_SEC * par.synth->sample_rate) ? length : (unsigned int)(FLUID_OFFLINE_CHUNK_MAX_SEC * par.synth->sample_rate);
+
+    par.chunk_count = fluid_offline_split(&par, length, NULL);
+
+    if(par.chunk_count == FLUID_FAILED)
+    {
+        goto exit;
+    }
+
+    par.chunks = FLUID_ARRAY(fluid_offline_chunk_t, par.chunk_count);
+    workers = FLUID_ARRAY(fluid_offline_worker_t, threads);
+    par.mutex = new_fluid_cond_mutex();
+    par.cond = new_fluid_cond();
+
+    if(par.chunks == NULL || workers == NULL || par.mutex == NULL || par.cond == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto exit;
+    }
+
+    FLUID_MEMSET(par.chunks, 0, par.chunk_count * sizeof(*par.chunks));
+    FLUID_MEMSET(workers, 0, threads * sizeof(*workers));
+    fluid_offline_split(&par, length, par.chunks);
+
+    threads = (threads < par.chunk_count) ? threads : par.chunk_count;
+
+    /* the synths are created here, loading the SoundFonts one after another */
+    for(i = 0; i < threads; i++)
+    {
+        workers[i].par = &par;
+        workers[i].synth = fluid_offline_new_synth(&par);
+
+        if(workers[i].synth == NULL)
+        {
+            goto exit;
+        }
+    }
+
+    for(started = 0; started < threads; started++)
+    {
+        workers[started].thread = new_fluid_thread("offline-render", fluid_offline_run, &workers[started], 0, FALSE);
+
+        if(workers[started].thread == NULL)
+        {
+            FLUID_LOG(FLUID_WARN, "Failed to create rendering thread %d, rendering with fewer threads", started);
+            break;
+        }
+    }
+
+    for(i = 0, result = FLUID_OK; result == FLUID_OK && i < par.chunk_count; i++)
+    {
+        if(started == 0)
+        {
+            result = fluid_offline_render_chunk(&par, workers[0].synth, &par.chunks[i]);
+        }
+        else
+        {
+            fluid_cond_mutex_lock(par.mutex);
+
+            while(!par.chunks[i].done && !par.failed)
+            {
+                fluid_cond_wait(par.cond, par.mutex);
+            }
+
+            result = par.failed ? FLUID_FAILED : FLUID_OK;
+            fluid_cond_mutex_unlock(par.mutex);
+        }
+
+        if(result == FLUID_OK)
+        {
+            result = fluid_offline_deliver(&par, &par.chunks[i], &tail, block_size, func, data);
+        }
+
+        if(started > 0)
+        {
+            fluid_cond_mutex_lock(par.mutex);
+            par.delivered = i + 1;
+            par.failed |= (result != FLUID_OK);
+            fluid_cond_broadcast(par.cond);
+            fluid_cond_mutex_unlock(par.mutex);
+        }
+    }
+
+exit:
+
+    for(i = 0; i < started; i++)
+    {
+        /* the threads stop on their own after the last chunk or on failure */
+        fluid_thread_join(workers[i].thread);
+        delete_fluid_thread(workers[i].thread);
+    }
+
+    for(i = 0; workers != NULL && i < threads; i++)
+    {
+        if(workers[i].synth != NULL)
+        {
+            delete_fluid_synth(workers[i].synth);
+        }
+    }
+
+    for(i = 0; par.chunks != NULL && i < par.chunk_count; i++)
+    {
+        FLUID_FREE(par.chunks[i].left);
+        FLUID_FREE(par.chunks[i].right);
+    }
+
+    for(i = 0; i < par.count; i++)
+    {
+        FLUID_FREE(par.events[i].evt.paramptr);
+    }
+
+    if(par.cond != NULL)
+    {
+        delete_fluid_cond(par.cond);
+    }
+
+    if(par.mutex != NULL)
+    {
+        delete_fluid_cond_mutex(par.mutex);
+    }
+
+    FLUID_FREE(tail.left);
+    FLUID_FREE(tail.right);
+    FLUID_FREE(par.chunks);
+    FLUID_FREE(par.events);
+    FLUID_FREE(par.snapshot);
+    FLUID_FREE(workers);
+
+    return result;
+}
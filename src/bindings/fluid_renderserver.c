@@ -0,0 +1,855 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Render server: the synths of a pool rendering for clients in other processes,
+ * which exchange MIDI events and audio with the server through a shared memory file.
+ */
+
+#include "fluid_sys.h"
+#include "fluid_synth.h"
+#include "fluid_midi.h"
+
+#if defined(__linux__) && defined(__GNUC__) && defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_SYS_SYSCALL_H) \
+    && defined(HAVE_SYS_MMAN_H) && defined(HAVE_SYS_STAT_H) && defined(HAVE_FCNTL_H) && defined(HAVE_UNISTD_H)
+#define FLUID_HAVE_RENDER_SERVER 1
+#else
+#define FLUID_HAVE_RENDER_SERVER 0
+#endif
+
+#if FLUID_HAVE_RENDER_SERVER
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <limits.h>
+
+#define FLUID_RENDER_SERVER_MAGIC   0x53524c46  /* "FLRS" */
+#define FLUID_RENDER_SERVER_VERSION 1
+#define FLUID_RENDER_SERVER_EVENTS  1024        /* events a client may send ahead, a power of 2 */
+#define FLUID_RENDER_SERVER_BATCH   64          /* events handed over to a synth at once */
+#define FLUID_RENDER_SERVER_ALIGN   64          /* keeps the header and the slots in cache lines of their own */
+#define FLUID_RENDER_SERVER_POLL    100         /* msec between checks for a peer that went away */
+#define FLUID_RENDER_CLIENT_TIMEOUT 2000        /* msec a client waits for the server at most */
+
+#define FLUID_RENDER_ALIGN(size) \
+    (((size) + FLUID_RENDER_SERVER_ALIGN - 1) & ~(size_t)(FLUID_RENDER_SERVER_ALIGN - 1))
+
+/* The counters in shared memory are only accessed atomically, since the peer is another process */
+#define fluid_shm_get(p)    __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define fluid_shm_set(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define fluid_shm_inc(p)    __atomic_add_fetch(p, 1, __ATOMIC_ACQ_REL)
+
+/* A MIDI message sent by a client, due at a frame of its stream */
+typedef struct
+{
+    uint32_t frame;
+    uint8_t msg[3];
+    uint8_t len;
+} fluid_render_event_t;
+
+/* The part of the shared memory used by a client, followed by a period of audio */
+typedef struct
+{
+    uint32_t owner;         /* process ID of the client attached, 0 if the slot is free */
+    uint32_t session;       /* incremented by the client attaching and detaching */
+    uint32_t request;       /* futex: periods requested by the client */
+    uint32_t done;          /* futex: requests handled by the server */
+    int32_t status;         /* FLUID_OK if the server has leased a synth for the client */
+    uint32_t frame;         /* frame of the stream the next period starts at */
+    uint32_t ev_write;      /* events written by the client */
+    uint32_t ev_read;       /* events read by the server */
+    fluid_render_event_t events[FLUID_RENDER_SERVER_EVENTS];
+} fluid_render_slot_t;
+
+/* The start of the shared memory */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t running;       /* FALSE once the server is shutting down */
+    uint32_t clients;       /* number of slots */
+    uint32_t period_size;   /* frames rendered per request */
+    uint32_t slot_size;     /* bytes from one slot to the next */
+    double sample_rate;
+} fluid_render_header_t;
+
+#define FLUID_RENDER_HEADER_SIZE FLUID_RENDER_ALIGN(sizeof(fluid_render_header_t))
+
+/* A slot as seen by the server */
+typedef struct
+{
+    fluid_render_server_t *server;
+    fluid_render_slot_t *shm;
+    float *left;
+    float *right;
+    fluid_synth_t *synth;   /* leased from the pool while a client is attached */
+    fluid_thread_t *thread;
+    uint32_t session;       /* the session the slot has been set up for */
+} fluid_render_server_slot_t;
+
+struct _fluid_render_server_t
+{
+    char *path;
+    fluid_synth_pool_t *pool;
+    fluid_render_header_t *shm;
+    size_t size;
+    int clients;
+    fluid_render_server_slot_t *slot;
+};
+
+struct _fluid_render_client_t
+{
+    fluid_render_header_t *shm;
+    size_t size;
+    fluid_render_slot_t *slot;
+    const float *left;
+    const float *right;
+};
+
+static void
+fluid_render_futex_wait(uint32_t *addr, uint32_t value, int msec)
+{
+    struct timespec timeout;
+
+    timeout.tv_sec = msec / 1000;
+    timeout.tv_nsec = (msec % 1000) * 1000000L;
+
+    /* not FUTEX_PRIVATE_FLAG, the futexes are shared with other processes */
+    syscall(SYS_futex, addr, FUTEX_WAIT, value, &timeout, NULL, 0);
+}
+
+static void
+fluid_render_futex_wake(uint32_t *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static int
+fluid_render_process_alive(uint32_t pid)
+{
+    return pid != 0 && (kill((pid_t)pid, 0) == 0 || errno != ESRCH);
+}
+
+static fluid_render_slot_t *
+fluid_render_get_slot(fluid_render_header_t *shm, int i)
+{
+    return (fluid_render_slot_t *)((char *)shm + FLUID_RENDER_HEADER_SIZE + (size_t)i * shm->slot_size);
+}
+
+static float *
+fluid_render_get_audio(fluid_render_slot_t *slot)
+{
+    return (float *)((char *)slot + FLUID_RENDER_ALIGN(sizeof(fluid_render_slot_t)));
+}
+
+/* Returns the synth of a slot to the pool */
+static void
+fluid_render_server_release(fluid_render_server_slot_t *slot)
+{
+    if(slot->synth != NULL)
+    {
+        fluid_synth_pool_release(slot->server->pool, slot->synth);
+        slot->synth = NULL;
+    }
+}
+
+/* Sets up a slot for the client that has attached or detached */
+static void
+fluid_render_server_attach(fluid_render_server_slot_t *slot)
+{
+    fluid_render_slot_t *shm = slot->shm;
+
+    fluid_render_server_release(slot);
+
+    if(fluid_shm_get(&shm->owner) != 0)
+    {
+        slot->synth = fluid_synth_pool_lease(slot->server->pool);
+
+        if(slot->synth == NULL)
+        {
+            FLUID_LOG(FLUID_WARN, "No synth left in the pool for a client of the render server");
+        }
+    }
+
+    /* events left by a former client */
+    fluid_shm_set(&shm->ev_read, fluid_shm_get(&shm->ev_write));
+    fluid_shm_set(&shm->frame, 0);
+    fluid_shm_set(&shm->status, slot->synth != NULL ? FLUID_OK : FLUID_FAILED);
+}
+
+static int
+fluid_render_server_decode(const fluid_render_event_t *ev, fluid_midi_event_t *event)
+{
+    int status = ev->msg[0];
+    int type = status & 0xf0;
+
+    FLUID_MEMSET(event, 0, sizeof(*event));
+
+    if(status == MIDI_SYSTEM_RESET)
+    {
+        event->type = MIDI_SYSTEM_RESET;
+        return FLUID_OK;
+    }
+
+    /* system messages other than a reset aren't meant for the synth */
+    if(type < NOTE_OFF || type == MIDI_SYSEX)
+    {
+        return FLUID_FAILED;
+    }
+
+    event->type = type;
+    event->channel = status & 0x0f;
+    event->param1 = ev->len > 1 ? ev->msg[1] : 0;
+    event->param2 = ev->len > 2 ? ev->msg[2] : 0;
+
+    if(type == PITCH_BEND)
+    {
+        event->param1 |= event->param2 << 7;
+    }
+
+    return FLUID_OK;
+}
+
+/* Hands the events due within the next period over to the synth and renders it */
+static void
+fluid_render_server_period(fluid_render_server_slot_t *slot)
+{
+    fluid_render_slot_t *shm = slot->shm;
+    fluid_midi_event_t events[FLUID_RENDER_SERVER_BATCH];
+    fluid_midi_event_t *list[FLUID_RENDER_SERVER_BATCH];
+    unsigned int offsets[FLUID_RENDER_SERVER_BATCH];
+    int period = slot->server->shm->period_size;
+    uint32_t frame = shm->frame;
+    uint32_t read = shm->ev_read;
+    uint32_t write = fluid_shm_get(&shm->ev_write);
+    int count = 0;
+
+    while(read != write)
+    {
+        const fluid_render_event_t *ev = &shm->events[read & (FLUID_RENDER_SERVER_EVENTS - 1)];
+        int32_t offset = (int32_t)(ev->frame - frame);
+
+        /* due in a later period */
+        if(offset >= period)
+        {
+            break;
+        }
+
+        if(fluid_render_server_decode(ev, &events[count]) == FLUID_OK)
+        {
+            /* the events that are late are played right away */
+            offsets[count] = offset > 0 ? offset : 0;
+            list[count] = &events[count];
+            count++;
+        }
+
+        read++;
+
+        if(count == FLUID_RENDER_SERVER_BATCH)
+        {
+            fluid_synth_queue_midi_events(slot->synth, list, offsets, count);
+            count = 0;
+        }
+    }
+
+    if(count > 0)
+    {
+        fluid_synth_queue_midi_events(slot->synth, list, offsets, count);
+    }
+
+    fluid_shm_set(&shm->ev_read, read);
+
+    fluid_synth_write_float(slot->synth, period, slot->left, 0, 1, slot->right, 0, 1);
+    fluid_shm_set(&shm->frame, frame + period);
+}
+
+static fluid_thread_return_t
+fluid_render_server_run(void *data)
+{
+    fluid_render_server_slot_t *slot = data;
+    fluid_render_slot_t *shm = slot->shm;
+    uint32_t done = shm->done;
+    uint32_t request;
+
+    while(fluid_shm_get(&slot->server->shm->running))
+    {
+        request = fluid_shm_get(&shm->request);
+
+        if(request == done)
+        {
+            /* a client that died without detaching leaves its synth behind */
+            if(slot->synth != NULL && !fluid_render_process_alive(fluid_shm_get(&shm->owner)))
+            {
+                fluid_render_server_release(slot);
+            }
+
+            fluid_render_futex_wait(&shm->request, request, FLUID_RENDER_SERVER_POLL);
+            continue;
+        }
+
+        if(fluid_shm_get(&shm->session) != slot->session)
+        {
+            slot->session = fluid_shm_get(&shm->session);
+            fluid_render_server_attach(slot);
+        }
+        else if(slot->synth != NULL)
+        {
+            fluid_render_server_period(slot);
+        }
+
+        /* a single wakeup per request */
+        fluid_shm_set(&shm->done, ++done);
+        fluid_render_futex_wake(&shm->done);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/**
+ * Create a render server, which renders the synths of a pool for clients in other processes.
+ *
+ * The server creates a file at @p path, which the clients map into their memory with
+ * new_fluid_render_client(). Each client is given a synth of the pool, sends it timestamped
+ * MIDI messages with fluid_render_client_send() and has it render one period after the other
+ * with fluid_render_client_render(). The events and the audio are exchanged through the
+ * mapped file, without copying, and a thread of the server per client wakes up once per period.
+ *
+ * The path should be on a file system in memory, e.g. below @c /dev/shm. An existing file
+ * is replaced.
+ *
+ * Uses the following settings:
+ * - \setting{audio_period-size}: number of frames rendered per period
+ * - \setting{audio_realtime-prio}: priority of the threads of the server
+ * - \setting{synth_sample-rate}: the sample rate reported to the clients
+ *
+ * @param settings The settings the synths of the pool have been created with
+ * @param pool The synths to render, they must not be leased otherwise while the server runs
+ * @param path File to create for the clients to map
+ * @param clients Number of clients that may attach at the same time
+ * @return New render server or NULL on error
+ *
+ * @note Only available on Linux, elsewhere the function logs an error and fails.
+ * @since 2.6.0
+ */
+fluid_render_server_t *
+new_fluid_render_server(fluid_settings_t *settings, fluid_synth_pool_t *pool, const char *path, int clients)
+{
+    fluid_render_server_t *server;
+    size_t slot_size;
+    double sample_rate;
+    int i, fd, period_size, prio;
+
+    fluid_return_val_if_fail(settings != NULL, NULL);
+    fluid_return_val_if_fail(pool != NULL, NULL);
+    fluid_return_val_if_fail(path != NULL, NULL);
+    fluid_return_val_if_fail(clients > 0, NULL);
+
+    fluid_settings_getint(settings, "audio.period-size", &period_size);
+    fluid_settings_getint(settings, "audio.realtime-prio", &prio);
+    fluid_settings_getnum(settings, "synth.sample-rate", &sample_rate);
+
+    server = FLUID_NEW(fluid_render_server_t);
+
+    if(server == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(server, 0, sizeof(*server));
+    server->pool = pool;
+    server->clients = clients;
+    server->path = FLUID_STRDUP(path);
+    server->slot = FLUID_ARRAY(fluid_render_server_slot_t, clients);
+
+    if(server->path == NULL || server->slot == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    FLUID_MEMSET(server->slot, 0, clients * sizeof(*server->slot));
+
+    slot_size = FLUID_RENDER_ALIGN(FLUID_RENDER_ALIGN(sizeof(fluid_render_slot_t)) + 2 * period_size * sizeof(float));
+    server->size = FLUID_RENDER_HEADER_SIZE + clients * slot_size;
+
+    unlink(path);
+    fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+    if(fd < 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the render server file '%s': %s", path, strerror(errno));
+        goto error_recovery;
+    }
+
+    /* the file is filled with zeros, all slots are free */
+    if(ftruncate(fd, server->size) != 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to resize the render server file '%s': %s", path, strerror(errno));
+        close(fd);
+        goto error_recovery;
+    }
+
+    server->shm = mmap(NULL, server->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(server->shm == MAP_FAILED)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to map the render server file '%s': %s", path, strerror(errno));
+        server->shm = NULL;
+        goto error_recovery;
+    }
+
+    server->shm->version = FLUID_RENDER_SERVER_VERSION;
+    server->shm->clients = clients;
+    server->shm->period_size = period_size;
+    server->shm->slot_size = slot_size;
+    server->shm->sample_rate = sample_rate;
+    server->shm->running = TRUE;
+
+    for(i = 0; i < clients; i++)
+    {
+        fluid_render_server_slot_t *slot = &server->slot[i];
+
+        slot->server = server;
+        slot->shm = fluid_render_get_slot(server->shm, i);
+        slot->left = fluid_render_get_audio(slot->shm);
+        slot->right = slot->left + period_size;
+        slot->thread = new_fluid_thread("render-server", fluid_render_server_run, slot, prio, FALSE);
+
+        if(slot->thread == NULL)
+        {
+            goto error_recovery;
+        }
+    }
+
+    /* the clients may attach from now on */
+    fluid_shm_set(&server->shm->magic, FLUID_RENDER_SERVER_MAGIC);
+
+    return server;
+
+error_recovery:
+    delete_fluid_render_server(server);
+    return NULL;
+}
+
+/**
+ * Stop a render server and delete it.
+ *
+ * The clients still attached fail to render from now on, and the synths they
+ * have been given are returned to the pool.
+ *
+ * @param server Render server to delete
+ * @since 2.6.0
+ */
+void
+delete_fluid_render_server(fluid_render_server_t *server)
+{
+    int i;
+
+    fluid_return_if_fail(server != NULL);
+
+    if(server->shm != NULL)
+    {
+        fluid_shm_set(&server->shm->running, FALSE);
+
+        for(i = 0; i < server->clients; i++)
+        {
+            fluid_render_server_slot_t *slot = &server->slot[i];
+
+            if(slot->thread != NULL)
+            {
+                fluid_render_futex_wake(&slot->shm->request);
+                fluid_thread_join(slot->thread);
+                delete_fluid_thread(slot->thread);
+            }
+
+            /* wakes up the client waiting for the server */
+            fluid_render_futex_wake(&slot->shm->done);
+            fluid_render_server_release(slot);
+        }
+
+        munmap(server->shm, server->size);
+        unlink(server->path);
+    }
+
+    FLUID_FREE(server->slot);
+    FLUID_FREE(server->path);
+    FLUID_FREE(server);
+}
+
+/* Asks the server to handle a request and waits until it has */
+static int
+fluid_render_client_request(fluid_render_client_t *client)
+{
+    fluid_render_slot_t *slot = client->slot;
+    uint32_t request = fluid_shm_inc(&slot->request);
+    uint32_t done;
+    int waited = 0;
+
+    fluid_render_futex_wake(&slot->request);
+
+    while((int32_t)((done = fluid_shm_get(&slot->done)) - request) < 0)
+    {
+        if(!fluid_shm_get(&client->shm->running) || waited >= FLUID_RENDER_CLIENT_TIMEOUT)
+        {
+            FLUID_LOG(FLUID_ERR, "The render server doesn't respond");
+            return FLUID_FAILED;
+        }
+
+        fluid_render_futex_wait(&slot->done, done, FLUID_RENDER_SERVER_POLL);
+        waited += FLUID_RENDER_SERVER_POLL;
+    }
+
+    return FLUID_OK;
+}
+
+static void
+fluid_render_client_detach(fluid_render_client_t *client)
+{
+    fluid_shm_set(&client->slot->owner, 0);
+    fluid_shm_inc(&client->slot->session);
+    fluid_render_client_request(client);
+    client->slot = NULL;
+}
+
+/**
+ * Attach to a render server, possibly running in another process.
+ *
+ * The client is given a synth of the server's pool of its own, which is returned to
+ * the pool in its initial state when the client is deleted or its process exits.
+ *
+ * @param path The file created by new_fluid_render_server()
+ * @return New render client or NULL on error, e.g. if all clients of the server are
+ * attached or no synth is left in its pool
+ *
+ * @note Only available on Linux, elsewhere the function logs an error and fails.
+ * @since 2.6.0
+ */
+fluid_render_client_t *
+new_fluid_render_client(const char *path)
+{
+    fluid_render_client_t *client;
+    struct stat st;
+    uint32_t owner, pid = (uint32_t)getpid();
+    unsigned int i;
+    int fd;
+
+    fluid_return_val_if_fail(path != NULL, NULL);
+
+    fd = open(path, O_RDWR | O_CLOEXEC);
+
+    if(fd < 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to open the render server file '%s': %s", path, strerror(errno));
+        return NULL;
+    }
+
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < FLUID_RENDER_HEADER_SIZE)
+    {
+        FLUID_LOG(FLUID_ERR, "'%s' isn't a render server file", path);
+        close(fd);
+        return NULL;
+    }
+
+    client = FLUID_NEW(fluid_render_client_t);
+
+    if(client == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        close(fd);
+        return NULL;
+    }
+
+    FLUID_MEMSET(client, 0, sizeof(*client));
+    client->size = st.st_size;
+    client->shm = mmap(NULL, client->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(client->shm == MAP_FAILED)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to map the render server file '%s': %s", path, strerror(errno));
+        client->shm = NULL;
+        goto error_recovery;
+    }
+
+    if(fluid_shm_get(&client->shm->magic) != FLUID_RENDER_SERVER_MAGIC
+            || client->shm->version != FLUID_RENDER_SERVER_VERSION
+            || client->size < FLUID_RENDER_HEADER_SIZE + (size_t)client->shm->clients * client->shm->slot_size
+            || !fluid_shm_get(&client->shm->running))
+    {
+        FLUID_LOG(FLUID_ERR, "'%s' isn't the file of a running render server", path);
+        goto error_recovery;
+    }
+
+    /* takes a free slot, or the one of a client that died without detaching */
+    for(i = 0; i < client->shm->clients && client->slot == NULL; i++)
+    {
+        fluid_render_slot_t *slot = fluid_render_get_slot(client->shm, i);
+        owner = fluid_shm_get(&slot->owner);
+
+        if((owner == 0 || !fluid_render_process_alive(owner))
+                && __atomic_compare_exchange_n(&slot->owner, &owner, pid, FALSE,
+                                               __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            client->slot = slot;
+        }
+    }
+
+    if(client->slot == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "All clients of the render server are attached");
+        goto error_recovery;
+    }
+
+    client->left = fluid_render_get_audio(client->slot);
+    client->right = client->left + client->shm->period_size;
+
+    fluid_shm_inc(&client->slot->session);
+
+    if(fluid_render_client_request(client) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    if(fluid_shm_get(&client->slot->status) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_ERR, "The render server has no synth left");
+        goto error_recovery;
+    }
+
+    return client;
+
+error_recovery:
+    delete_fluid_render_client(client);
+    return NULL;
+}
+
+/**
+ * Detach from a render server and delete the client.
+ *
+ * @param client Render client to delete
+ * @since 2.6.0
+ */
+void
+delete_fluid_render_client(fluid_render_client_t *client)
+{
+    fluid_return_if_fail(client != NULL);
+
+    if(client->slot != NULL)
+    {
+        fluid_render_client_detach(client);
+    }
+
+    if(client->shm != NULL)
+    {
+        munmap(client->shm, client->size);
+    }
+
+    FLUID_FREE(client);
+}
+
+/**
+ * Send a MIDI message to the synth of a render client.
+ *
+ * The message is played at @p frame of the client's stream of audio, see
+ * fluid_render_client_get_frame(). Messages must be sent in the order they
+ * are due, those that are late are played at the start of the next period.
+ * System messages other than a reset (0xFF) are ignored.
+ *
+ * @param client Render client
+ * @param frame Frame of the stream the message is due at
+ * @param msg MIDI message, status byte first, without running status
+ * @param len Length of the message, from 1 to 3 bytes
+ * @return #FLUID_OK on success, #FLUID_FAILED if too many messages are waiting to be played
+ * @since 2.6.0
+ */
+int
+fluid_render_client_send(fluid_render_client_t *client, unsigned int frame,
+                         const unsigned char *msg, int len)
+{
+    fluid_render_slot_t *slot;
+    fluid_render_event_t *ev;
+    uint32_t write;
+
+    fluid_return_val_if_fail(client != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(msg != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(len >= 1 && len <= 3, FLUID_FAILED);
+
+    slot = client->slot;
+    write = slot->ev_write;
+
+    if(write - fluid_shm_get(&slot->ev_read) >= FLUID_RENDER_SERVER_EVENTS)
+    {
+        return FLUID_FAILED;
+    }
+
+    ev = &slot->events[write & (FLUID_RENDER_SERVER_EVENTS - 1)];
+    ev->frame = frame;
+    ev->len = len;
+    FLUID_MEMSET(ev->msg, 0, sizeof(ev->msg));
+    FLUID_MEMCPY(ev->msg, msg, len);
+
+    fluid_shm_set(&slot->ev_write, write + 1);
+
+    return FLUID_OK;
+}
+
+/**
+ * Have the server render the next period of a render client.
+ *
+ * Blocks until the server has rendered it.
+ *
+ * @param client Render client
+ * @param left Returns the left channel of the period
+ * @param right Returns the right channel of the period
+ * @return The number of frames rendered, see fluid_render_client_get_period_size(),
+ * or #FLUID_FAILED if the server has stopped or doesn't respond
+ *
+ * @note The audio is read from the memory shared with the server, without copying.
+ * It stays valid until the next call.
+ * @since 2.6.0
+ */
+int
+fluid_render_client_render(fluid_render_client_t *client, const float **left, const float **right)
+{
+    fluid_return_val_if_fail(client != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(left != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(right != NULL, FLUID_FAILED);
+
+    if(fluid_render_client_request(client) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    *left = client->left;
+    *right = client->right;
+
+    return client->shm->period_size;
+}
+
+/**
+ * Get the frame of the stream of a render client the next period starts at.
+ *
+ * @param client Render client
+ * @return The frame, 0 when the client has attached
+ * @since 2.6.0
+ */
+unsigned int
+fluid_render_client_get_frame(fluid_render_client_t *client)
+{
+    fluid_return_val_if_fail(client != NULL, 0);
+
+    return fluid_shm_get(&client->slot->frame);
+}
+
+/**
+ * Get the number of frames a render server renders per period.
+ *
+ * @param client Render client
+ * @return The period size of the server
+ * @since 2.6.0
+ */
+int
+fluid_render_client_get_period_size(fluid_render_client_t *client)
+{
+    fluid_return_val_if_fail(client != NULL, FLUID_FAILED);
+
+    return client->shm->period_size;
+}
+
+/**
+ * Get the sample rate of the audio of a render server.
+ *
+ * @param client Render client
+ * @return The sample rate of the server
+ * @since 2.6.0
+ */
+double
+fluid_render_client_get_sample_rate(fluid_render_client_t *client)
+{
+    fluid_return_val_if_fail(client != NULL, 0.0);
+
+    return client->shm->sample_rate;
+}
+
+#else /* FLUID_HAVE_RENDER_SERVER */
+
+fluid_render_server_t *
+new_fluid_render_server(fluid_settings_t *settings, fluid_synth_pool_t *pool, const char *path, int clients)
+{
+    FLUID_LOG(FLUID_ERR, "The render server isn't supported on this platform");
+    return NULL;
+}
+
+void
+delete_fluid_render_server(fluid_render_server_t *server)
+{
+}
+
+fluid_render_client_t *
+new_fluid_render_client(const char *path)
+{
+    FLUID_LOG(FLUID_ERR, "The render server isn't supported on this platform");
+    return NULL;
+}
+
+void
+delete_fluid_render_client(fluid_render_client_t *client)
+{
+}
+
+int
+fluid_render_client_send(fluid_render_client_t *client, unsigned int frame,
+                         const unsigned char *msg, int len)
+{
+    return FLUID_FAILED;
+}
+
+int
+fluid_render_client_render(fluid_render_client_t *client, const float **left, const float **right)
+{
+    return FLUID_FAILED;
+}
+
+unsigned int
+fluid_render_client_get_frame(fluid_render_client_t *client)
+{
+    return 0;
+}
+
+int
+fluid_render_client_get_period_size(fluid_render_client_t *client)
+{
+    return FLUID_FAILED;
+}
+
+double
+fluid_render_client_get_sample_rate(fluid_render_client_t *client)
+{
+    return 0.0;
+}
+
+#endif /* FLUID_HAVE_RENDER_SERVER */
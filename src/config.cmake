@@ -35,6 +35,9 @@
 /* Define to 1 if you have the <errno.h> header file. */
 #cmakedefine HAVE_ERRNO_H @HAVE_ERRNO_H@
 
+/* Define to 1 if you have the <execinfo.h> header file. */
+#cmakedefine HAVE_EXECINFO_H @HAVE_EXECINFO_H@
+
 /* Define to 1 if you have the <fcntl.h> header file. */
 #cmakedefine HAVE_FCNTL_H @HAVE_FCNTL_H@
 
@@ -56,6 +59,15 @@
 /* Define to 1 if you have the <machine/soundcard.h> header file. */
 #cmakedefine HAVE_MACHINE_SOUNDCARD_H @HAVE_MACHINE_SOUNDCARD_H@
 
+/* Define to 1 if you have the <linux/futex.h> header file. */
+#cmakedefine HAVE_LINUX_FUTEX_H @HAVE_LINUX_FUTEX_H@
+
+/* Define to 1 if you have the <linux/io_uring.h> header file. */
+#cmakedefine HAVE_LINUX_IO_URING_H @HAVE_LINUX_IO_URING_H@
+
+/* Define to 1 if you have the <os/workgroup.h> header file. */
+#cmakedefine HAVE_OS_WORKGROUP_H @HAVE_OS_WORKGROUP_H@
+
 /* Define to 1 if you have the <math.h> header file. */
 #cmakedefine HAVE_MATH_H @HAVE_MATH_H@
 
@@ -71,6 +83,9 @@
 /* Define if compiling with openMP to enable parallel audio rendering */
 #cmakedefine HAVE_OPENMP @HAVE_OPENMP@
 
+/* Define to 1 if you have the <poll.h> header file. */
+#cmakedefine HAVE_POLL_H @HAVE_POLL_H@
+
 /* Define to 1 if you have the <pthread.h> header file. */
 #cmakedefine HAVE_PTHREAD_H @HAVE_PTHREAD_H@
 
@@ -95,9 +110,15 @@
 /* Define to 1 if you have the <string.h> header file. */
 #cmakedefine HAVE_STRING_H @HAVE_STRING_H@
 
+/* Define to 1 if you have the <sys/eventfd.h> header file. */
+#cmakedefine HAVE_SYS_EVENTFD_H @HAVE_SYS_EVENTFD_H@
+
 /* Define to 1 if you have the <sys/mman.h> header file. */
 #cmakedefine HAVE_SYS_MMAN_H @HAVE_SYS_MMAN_H@
 
+/* Define to 1 if you have the <sys/syscall.h> header file. */
+#cmakedefine HAVE_SYS_SYSCALL_H @HAVE_SYS_SYSCALL_H@
+
 /* Define to 1 if you have the <sys/socket.h> header file. */
 #cmakedefine HAVE_SYS_SOCKET_H @HAVE_SYS_SOCKET_H@
 
@@ -122,6 +143,9 @@
 /* Define to 1 if you have the <getopt.h> header file. */
 #cmakedefine HAVE_GETOPT_H @HAVE_GETOPT_H@
 
+/* Define to 1 if you have the clock_nanosleep() function. */
+#cmakedefine HAVE_CLOCK_NANOSLEEP @HAVE_CLOCK_NANOSLEEP@
+
 /* Define to 1 if you have the inet_ntop() function. */
 #cmakedefine HAVE_INETNTOP @HAVE_INETNTOP@
 
@@ -137,7 +161,7 @@
 /* Include the LADSPA Fx unit */
 #cmakedefine LADSPA @LADSPA_SUPPORT@
 
-/* Include the LIMITER */
+/* Include the look-ahead LIMITER */
 #cmakedefine LIMITER_SUPPORT @LIMITER_SUPPORT@
 
 /* Define to enable IPV6 support */
@@ -158,6 +182,9 @@
 /* Define to enable libsndfile support */
 #cmakedefine LIBSNDFILE_SUPPORT @LIBSNDFILE_SUPPORT@
 
+/* Define to decode SF3 samples with libvorbisfile */
+#cmakedefine VORBISFILE_SUPPORT @VORBISFILE_SUPPORT@
+
 /* Define to enable MidiShare driver */
 #cmakedefine MIDISHARE_SUPPORT @MIDISHARE_SUPPORT@
 
@@ -212,6 +239,9 @@
 /* Define to enable SDL3 audio driver */
 #cmakedefine SDL3_SUPPORT @SDL3_SUPPORT@
 
+/* Define to enable the Web Audio driver */
+#cmakedefine WEBAUDIO_SUPPORT @WEBAUDIO_SUPPORT@
+
 /* Define to 1 if you have the ANSI C header files. */
 #cmakedefine STDC_HEADERS @STDC_HEADERS@
 
@@ -239,6 +269,18 @@
 /* Define to do all DSP in single floating point precision */
 #cmakedefine WITH_FLOAT @WITH_FLOAT@
 
+/* Define to interpolate 16 bit samples in fixed point */
+#cmakedefine WITH_FIXED_POINT @WITH_FIXED_POINT@
+
+/* Define to compile the WebAssembly SIMD128 kernels */
+#cmakedefine WITH_WASM_SIMD @WITH_WASM_SIMD@
+
+/* Internal rendering block size in frames */
+#define FLUID_BUFSIZE @FLUID_BUFSIZE@
+
+/* Frames the mixer renders at most in one run */
+#define FLUID_MIXER_FRAMES @FLUID_MIXER_FRAMES@
+
 /* Define to profile the DSP code */
 #cmakedefine WITH_PROFILING @WITH_PROFILING@
 
@@ -18,8 +18,11 @@
  */
 
 #include "fluid_adriver.h"
+#include "fluid_render_ahead.h"
 #include "fluid_sys.h"
 #include "fluid_settings.h"
+#include "fluid_list.h"
+#include "fluid_synth.h"
 
 /*
  * fluid_adriver_definition_t
@@ -199,6 +202,16 @@ static const fluid_audriver_definition_t fluid_audio_drivers[] =
     },
 #endif
 
+#if WEBAUDIO_SUPPORT
+    {
+        "webaudio",
+        new_fluid_webaudio_audio_driver,
+        new_fluid_webaudio_audio_driver2,
+        delete_fluid_webaudio_audio_driver,
+        fluid_webaudio_audio_driver_settings
+    },
+#endif
+
 #if AUFILE_SUPPORT
     {
         "file",
@@ -220,6 +233,16 @@ static const fluid_audriver_definition_t fluid_audio_drivers[] =
 
 static uint8_t fluid_adriver_disable_mask[(FLUID_N_ELEMENTS(fluid_audio_drivers) + 7) / 8] = {0};
 
+/* Audio drivers alive, for fluid_audio_driver_foreach() */
+static fluid_mutex_t fluid_adriver_list_mutex = FLUID_MUTEX_INIT;
+static fluid_list_t *fluid_adriver_list = NULL;
+
+static void fluid_audio_driver_add(fluid_audio_driver_t *driver,
+                                   const fluid_audriver_definition_t *def,
+                                   fluid_settings_t *settings);
+static fluid_audio_driver_t *new_fluid_audio_driver_render_ahead(const fluid_audriver_definition_t *def,
+        fluid_settings_t *settings, fluid_synth_t *synth, int msec, int period_size, double srate);
+
 void fluid_audio_driver_settings(fluid_settings_t *settings)
 {
     unsigned int i;
@@ -232,18 +255,21 @@ void fluid_audio_driver_settings(fluid_settings_t *settings)
     fluid_settings_add_option(settings, "audio.sample-format", "float");
 
 #if defined(_WIN32)
-    fluid_settings_register_int(settings, "audio.period-size", 512, 64, 8192, 0);
+    fluid_settings_register_int(settings, "audio.period-size", 512, 32, 8192, 0);
     fluid_settings_register_int(settings, "audio.periods", 8, 2, 64, 0);
 #elif defined(MACOS9)
-    fluid_settings_register_int(settings, "audio.period-size", 64, 64, 8192, 0);
+    fluid_settings_register_int(settings, "audio.period-size", 64, 32, 8192, 0);
     fluid_settings_register_int(settings, "audio.periods", 8, 2, 64, 0);
 #else
-    fluid_settings_register_int(settings, "audio.period-size", 64, 64, 8192, 0);
+    fluid_settings_register_int(settings, "audio.period-size", 64, 32, 8192, 0);
     fluid_settings_register_int(settings, "audio.periods", 16, 2, 64, 0);
 #endif
 
     fluid_settings_register_int(settings, "audio.realtime-prio",
                                 FLUID_DEFAULT_AUDIO_RT_PRIO, 0, 99, 0);
+    fluid_settings_register_int(settings, "audio.realtime-deadline", 0, 0, 100, 0);
+    fluid_settings_register_str(settings, "audio.cpu-affinity", "", 0);
+    fluid_settings_register_int(settings, "audio.render-ahead", 0, 0, 10000, 0);
 
     fluid_settings_register_str(settings, "audio.driver", "", 0);
 
@@ -279,7 +305,10 @@ find_fluid_audio_driver(fluid_settings_t *settings)
     char *name;
     char *allnames;
 
-    for(i = 0; i < FLUID_N_ELEMENTS(fluid_audio_drivers) - 1; i++)
+    fluid_settings_dupstr(settings, "audio.driver", &name);        /* ++ alloc name */
+
+    /* only the driver selected is touched, the others aren't probed */
+    for(i = 0; name != NULL && i < FLUID_N_ELEMENTS(fluid_audio_drivers) - 1; i++)
     {
         /* If this driver is de-activated, just ignore it */
         if(!IS_AUDIO_DRIVER_ENABLED(fluid_adriver_disable_mask, i))
@@ -287,14 +316,14 @@ find_fluid_audio_driver(fluid_settings_t *settings)
             continue;
         }
 
-        if(fluid_settings_str_equal(settings, "audio.driver", fluid_audio_drivers[i].name))
+        if(FLUID_STRCMP(name, fluid_audio_drivers[i].name) == 0)
         {
             FLUID_LOG(FLUID_DBG, "Using '%s' audio driver", fluid_audio_drivers[i].name);
+            FLUID_FREE(name);
             return &fluid_audio_drivers[i];
         }
     }
 
-    fluid_settings_dupstr(settings, "audio.driver", &name);        /* ++ alloc name */
     FLUID_LOG(FLUID_ERR, "Couldn't find the requested audio driver '%s'.", name ? name : "NULL");
 
     allnames = fluid_settings_option_concat(settings, "audio.driver", NULL);
@@ -346,12 +375,13 @@ new_fluid_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
 
     if(def)
     {
-        fluid_audio_driver_t *driver;
+        fluid_audio_driver_t *driver = NULL;
         double srate, midi_event_latency;
-        int period_size;
+        int period_size, render_ahead;
 
         fluid_settings_getint(settings, "audio.period-size", &period_size);
         fluid_settings_getnum(settings, "synth.sample-rate", &srate);
+        fluid_settings_getint(settings, "audio.render-ahead", &render_ahead);
 
         midi_event_latency = period_size / srate;
         if(midi_event_latency >= 0.05)
@@ -365,11 +395,27 @@ new_fluid_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
                 period_size, srate, midi_event_latency*1000.0);
         }
 
-        driver = (*def->new)(settings, synth);
+        if(render_ahead > 0)
+        {
+            driver = new_fluid_audio_driver_render_ahead(def, settings, synth, render_ahead, period_size, srate);
+        }
+
+        if(driver == NULL)
+        {
+            driver = (*def->new)(settings, synth);
+
+            if(driver)
+            {
+                fluid_audio_driver_add(driver, def, settings);
+            }
+        }
 
         if(driver)
         {
-            driver->define = def;
+            /* the latency may have been reported while the driver was created */
+            fluid_atomic_pointer_set(&driver->synth, synth);
+            fluid_synth_set_output_latency(synth, fluid_atomic_int_get(&driver->telemetry.latency)
+                                           + driver->render_ahead_latency);
         }
 
         return driver;
@@ -378,6 +424,50 @@ new_fluid_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
     return NULL;
 }
 
+/*
+ * Creates the driver of new_fluid_audio_driver() with audio.render-ahead: the driver calls back
+ * fluid_render_ahead_process(), which copies the audio a thread renders msec ahead. Returns NULL
+ * if the driver can't be created that way, to fall back to rendering in the callback.
+ */
+static fluid_audio_driver_t *
+new_fluid_audio_driver_render_ahead(const fluid_audriver_definition_t *def, fluid_settings_t *settings,
+                                    fluid_synth_t *synth, int msec, int period_size, double srate)
+{
+    fluid_render_ahead_t *ahead;
+    fluid_audio_driver_t *driver;
+
+    if(def->new2 == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "Rendering ahead is unsupported on '%s' audio driver", def->name);
+        return NULL;
+    }
+
+    ahead = new_fluid_render_ahead(synth, (int)(msec * srate / 1000.0), period_size, srate);
+
+    if(ahead == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to render ahead, rendering in the audio callback");
+        return NULL;
+    }
+
+    driver = (*def->new2)(settings, fluid_render_ahead_process, ahead);
+
+    if(driver == NULL)
+    {
+        delete_fluid_render_ahead(ahead);
+        return NULL;
+    }
+
+    fluid_audio_driver_add(driver, def, settings);
+    driver->render_ahead = ahead;
+    driver->render_ahead_latency = (int)(ahead->ring->totalcount * 1000000.0 / srate);
+    fluid_render_ahead_set_driver(ahead, driver);
+
+    FLUID_LOG(FLUID_INFO, "Rendering %d ms ahead of the audio driver", driver->render_ahead_latency / 1000);
+
+    return driver;
+}
+
 /**
  * Create a new audio driver.
  *
@@ -421,7 +511,7 @@ new_fluid_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t func, voi
 
             if(driver)
             {
-                driver->define = def;
+                fluid_audio_driver_add(driver, def, settings);
             }
         }
 
@@ -441,8 +531,200 @@ new_fluid_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t func, voi
 void
 delete_fluid_audio_driver(fluid_audio_driver_t *driver)
 {
+    fluid_synth_t *synth;
+    fluid_render_ahead_t *ahead;
     fluid_return_if_fail(driver != NULL);
+
+    fluid_mutex_lock(fluid_adriver_list_mutex);
+    fluid_adriver_list = fluid_list_remove(fluid_adriver_list, driver);
+    fluid_mutex_unlock(fluid_adriver_list_mutex);
+
+    synth = driver->synth;
+    ahead = driver->render_ahead;
     driver->define->free(driver);
+
+    /* after the driver, which doesn't call back anymore */
+    if(ahead != NULL)
+    {
+        delete_fluid_render_ahead(ahead);
+    }
+
+    if(synth != NULL)
+    {
+        fluid_synth_set_output_latency(synth, 0);
+    }
+}
+
+static void
+fluid_audio_driver_add(fluid_audio_driver_t *driver, const fluid_audriver_definition_t *def,
+                       fluid_settings_t *settings)
+{
+    driver->define = def;
+    driver->settings = settings;
+    driver->synth = NULL;
+    driver->render_ahead = NULL;
+    driver->render_ahead_latency = 0;
+
+    fluid_mutex_lock(fluid_adriver_list_mutex);
+    fluid_adriver_list = fluid_list_prepend(fluid_adriver_list, driver);
+    fluid_mutex_unlock(fluid_adriver_list_mutex);
+}
+
+void
+fluid_audio_driver_foreach(fluid_settings_t *settings,
+                           void (*func)(void *data, fluid_audio_driver_t *driver), void *data)
+{
+    fluid_list_t *list;
+    fluid_audio_driver_t *driver;
+
+    fluid_mutex_lock(fluid_adriver_list_mutex);
+
+    for(list = fluid_adriver_list; list != NULL; list = fluid_list_next(list))
+    {
+        driver = (fluid_audio_driver_t *)fluid_list_get(list);
+
+        if(driver->settings == settings)
+        {
+            func(data, driver);
+        }
+    }
+
+    fluid_mutex_unlock(fluid_adriver_list_mutex);
+}
+
+/*
+ * Called by the audio thread of a driver after rendering a period of the given
+ * number of frames, which it started at the time start taken with fluid_utime().
+ */
+void
+fluid_audio_driver_period_done(fluid_audio_driver_t *driver, double start,
+                               int frames, double sample_rate)
+{
+    fluid_audio_driver_telemetry_t *t = &driver->telemetry;
+    int duration, period, margin, avg, bin;
+
+    duration = (int)(fluid_utime() - start);
+    period = (int)(frames * 1000000.0 / sample_rate);
+    margin = period - duration;
+
+    /* exponential moving average with a weight of 1/16, kept in 1/16 microseconds */
+    avg = fluid_atomic_int_get(&t->callback_avg);
+    fluid_atomic_int_set(&t->callback_avg, avg - avg / 16 + duration);
+
+    if(duration > fluid_atomic_int_get(&t->callback_max))
+    {
+        fluid_atomic_int_set(&t->callback_max, duration);
+    }
+
+    if(fluid_atomic_int_get(&t->periods) == 0 || margin < fluid_atomic_int_get(&t->margin_min))
+    {
+        fluid_atomic_int_set(&t->margin_min, margin);
+    }
+
+    bin = (period > 0) ? (int)((long long)duration * (FLUID_AUDIO_DRIVER_LOAD_BINS - 1) / period)
+          : FLUID_AUDIO_DRIVER_LOAD_BINS - 1;
+
+    if(bin >= FLUID_AUDIO_DRIVER_LOAD_BINS)
+    {
+        bin = FLUID_AUDIO_DRIVER_LOAD_BINS - 1;
+    }
+
+    fluid_atomic_int_inc(&t->load_histogram[bin]);
+    fluid_atomic_int_inc(&t->periods);
+}
+
+/* Counts an underrun reported by the audio API, may be called from any thread */
+void
+fluid_audio_driver_xrun(fluid_audio_driver_t *driver)
+{
+    fluid_atomic_int_inc(&driver->telemetry.xruns);
+}
+
+/* Stores the output latency reported by the audio API, in microseconds */
+void
+fluid_audio_driver_set_latency(fluid_audio_driver_t *driver, double latency)
+{
+    fluid_synth_t *synth = fluid_atomic_pointer_get(&driver->synth);
+
+    fluid_atomic_int_set(&driver->telemetry.latency, (int)latency);
+
+    if(synth != NULL)
+    {
+        fluid_synth_set_output_latency(synth, latency + driver->render_ahead_latency);
+    }
+}
+
+/**
+ * Get the health statistics of an audio driver.
+ *
+ * @param driver Audio driver instance
+ * @param stats Structure to store the statistics to
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * The statistics are counted since the driver has been created or since the last
+ * call to fluid_audio_driver_reset_stats(). Reading them doesn't take any lock
+ * and doesn't disturb the audio thread, so they can be polled by monitoring tools.
+ * Drivers that don't know the underruns or the latency of the audio API leave
+ * those fields at 0.
+ *
+ * @since 2.6.0
+ */
+int
+fluid_audio_driver_get_stats(fluid_audio_driver_t *driver, fluid_audio_driver_stats_t *stats)
+{
+    fluid_audio_driver_telemetry_t *t;
+    int i;
+
+    fluid_return_val_if_fail(driver != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(stats != NULL, FLUID_FAILED);
+
+    t = &driver->telemetry;
+
+    stats->periods = (unsigned int)fluid_atomic_int_get(&t->periods);
+    stats->xruns = (unsigned int)fluid_atomic_int_get(&t->xruns);
+    stats->callback_avg = fluid_atomic_int_get(&t->callback_avg) / 16.0;
+    stats->callback_max = fluid_atomic_int_get(&t->callback_max);
+    stats->margin_min = (stats->periods > 0) ? fluid_atomic_int_get(&t->margin_min) : 0.0;
+    stats->latency = fluid_atomic_int_get(&t->latency);
+
+    for(i = 0; i < FLUID_AUDIO_DRIVER_LOAD_BINS; i++)
+    {
+        stats->load_histogram[i] = (unsigned int)fluid_atomic_int_get(&t->load_histogram[i]);
+    }
+
+    return FLUID_OK;
+}
+
+/**
+ * Reset the health statistics of an audio driver.
+ *
+ * @param driver Audio driver instance
+ *
+ * The latency is kept, as it is only updated when the audio API reports it.
+ * A period being rendered while the statistics are reset may still be counted.
+ *
+ * @since 2.6.0
+ */
+void
+fluid_audio_driver_reset_stats(fluid_audio_driver_t *driver)
+{
+    fluid_audio_driver_telemetry_t *t;
+    int i;
+
+    fluid_return_if_fail(driver != NULL);
+
+    t = &driver->telemetry;
+
+    fluid_atomic_int_set(&t->periods, 0);
+    fluid_atomic_int_set(&t->xruns, 0);
+    fluid_atomic_int_set(&t->callback_avg, 0);
+    fluid_atomic_int_set(&t->callback_max, 0);
+    fluid_atomic_int_set(&t->margin_min, 0);
+
+    for(i = 0; i < FLUID_AUDIO_DRIVER_LOAD_BINS; i++)
+    {
+        fluid_atomic_int_set(&t->load_histogram[i], 0);
+    }
 }
 
 
@@ -480,6 +762,7 @@ int fluid_audio_driver_register(const char **adrivers)
     {
         /* Pass NULL to register all available drivers. */
         FLUID_MEMSET(fluid_adriver_disable_mask, 0, sizeof(fluid_adriver_disable_mask));
+        fluid_settings_reset_defaults();
 
         return FLUID_OK;
     }
@@ -510,5 +793,8 @@ int fluid_audio_driver_register(const char **adrivers)
     /* Update list of activated drivers */
     FLUID_MEMCPY(fluid_adriver_disable_mask, disable_mask, sizeof(disable_mask));
 
+    /* the settings of the drivers disabled are registered no more */
+    fluid_settings_reset_defaults();
+
     return FLUID_OK;
 }
@@ -32,13 +32,46 @@ extern "C" {
 
 typedef struct _fluid_audriver_definition_t fluid_audriver_definition_t;
 
+/*
+ * Telemetry the drivers update from their audio thread, see fluid_audio_driver_get_stats().
+ * Only the audio thread writes the fields, except xruns, which some audio APIs
+ * report on a thread of their own.
+ */
+typedef struct
+{
+    fluid_atomic_int_t periods;
+    fluid_atomic_int_t xruns;
+    fluid_atomic_int_t callback_avg;    /* moving average in 1/16 microseconds */
+    fluid_atomic_int_t callback_max;    /* microseconds */
+    fluid_atomic_int_t margin_min;      /* microseconds, valid once periods > 0 */
+    fluid_atomic_int_t latency;         /* microseconds */
+    fluid_atomic_int_t load_histogram[FLUID_AUDIO_DRIVER_LOAD_BINS];
+} fluid_audio_driver_telemetry_t;
+
 struct _fluid_audio_driver_t
 {
     const fluid_audriver_definition_t *define;
+    fluid_settings_t *settings;             /* settings the driver was created with */
+    fluid_audio_driver_telemetry_t telemetry;
+    fluid_synth_t *synth;                   /* Atomic: synth rendered by new_fluid_audio_driver(), told the output latency, NULL otherwise */
+    struct _fluid_render_ahead_t *render_ahead; /* renders the synth ahead of the driver with audio.render-ahead, NULL otherwise */
+    int render_ahead_latency;               /* microseconds the synth is rendered ahead of the driver */
 };
 
 void fluid_audio_driver_settings(fluid_settings_t *settings);
 
+/* Telemetry helpers for the drivers. Take the time with fluid_utime() before rendering
+ * a period, and pass it to fluid_audio_driver_period_done() right after. */
+void fluid_audio_driver_period_done(fluid_audio_driver_t *driver, double start,
+                                    int frames, double sample_rate);
+void fluid_audio_driver_xrun(fluid_audio_driver_t *driver);
+void fluid_audio_driver_set_latency(fluid_audio_driver_t *driver, double latency);
+
+/* Calls func for every audio driver alive that was created with the given settings */
+void fluid_audio_driver_foreach(fluid_settings_t *settings,
+                                void (*func)(void *data, fluid_audio_driver_t *driver),
+                                void *data);
+
 /* Defined in bindings/fluid_filerenderer.c */
 void fluid_file_renderer_settings(fluid_settings_t *settings);
 
@@ -177,6 +210,15 @@ void delete_fluid_sdl3_audio_driver(fluid_audio_driver_t *p);
 void fluid_sdl3_audio_driver_settings(fluid_settings_t *settings);
 #endif
 
+#if WEBAUDIO_SUPPORT
+fluid_audio_driver_t *new_fluid_webaudio_audio_driver(fluid_settings_t *settings,
+        fluid_synth_t *synth);
+fluid_audio_driver_t *new_fluid_webaudio_audio_driver2(fluid_settings_t *settings,
+        fluid_audio_func_t func, void *data);
+void delete_fluid_webaudio_audio_driver(fluid_audio_driver_t *p);
+void fluid_webaudio_audio_driver_settings(fluid_settings_t *settings);
+#endif
+
 #if AUFILE_SUPPORT
 fluid_audio_driver_t *new_fluid_file_audio_driver(fluid_settings_t *settings,
         fluid_synth_t *synth);
@@ -35,6 +35,10 @@
 #define ALSA_PCM_NEW_HW_PARAMS_API
 #include <alsa/asoundlib.h>
 #include <poll.h>
+
+#if HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
 #include <math.h>
 
 #define FLUID_ALSA_DEFAULT_MIDI_DEVICE  "default"
@@ -62,13 +66,19 @@ typedef struct
     fluid_audio_func_t callback;
     void *data;
     int buffer_size;
+    double sample_rate;               /* rate of the device, for the telemetry */
+    int avail_min;                    /* frames to wait for before rendering, see audio.alsa.avail-min */
+    enum fluid_sample_format sample_format; /* format of the mmap areas */
     fluid_thread_t *thread;
     int cont;
+    int cpus[FLUID_MAX_CPU_AFFINITY]; /* CPUs to pin the audio thread to, see audio.cpu-affinity */
+    int cpu_count;
 } fluid_alsa_audio_driver_t;
 
 
 static fluid_thread_return_t fluid_alsa_audio_run_float(void *d);
 static fluid_thread_return_t fluid_alsa_audio_run_s16(void *d);
+static fluid_thread_return_t fluid_alsa_audio_run_mmap(void *d);
 
 
 typedef struct
@@ -77,23 +87,49 @@ typedef struct
     snd_pcm_format_t format;
     snd_pcm_access_t access;
     fluid_thread_func_t run;
+    enum fluid_sample_format sample_format;
 } fluid_alsa_formats_t;
 
+/* The mmap formats are only tried if audio.alsa.mmap is enabled and the synth
+ * is rendered without a user audio callback. */
 static const fluid_alsa_formats_t fluid_alsa_formats[] =
 {
+    {
+        "s16, mmap, interleaved",
+        SND_PCM_FORMAT_S16,
+        SND_PCM_ACCESS_MMAP_INTERLEAVED,
+        fluid_alsa_audio_run_mmap,
+        FLUID_SAMPLE_FORMAT_S16
+    },
+    {
+        "float, mmap, non interleaved",
+        SND_PCM_FORMAT_FLOAT,
+        SND_PCM_ACCESS_MMAP_NONINTERLEAVED,
+        fluid_alsa_audio_run_mmap,
+        FLUID_SAMPLE_FORMAT_FLOAT
+    },
+    {
+        "float, mmap, interleaved",
+        SND_PCM_FORMAT_FLOAT,
+        SND_PCM_ACCESS_MMAP_INTERLEAVED,
+        fluid_alsa_audio_run_mmap,
+        FLUID_SAMPLE_FORMAT_FLOAT
+    },
     {
         "s16, rw, interleaved",
         SND_PCM_FORMAT_S16,
         SND_PCM_ACCESS_RW_INTERLEAVED,
-        fluid_alsa_audio_run_s16
+        fluid_alsa_audio_run_s16,
+        FLUID_SAMPLE_FORMAT_S16
     },
     {
         "float, rw, non interleaved",
         SND_PCM_FORMAT_FLOAT,
         SND_PCM_ACCESS_RW_NONINTERLEAVED,
-        fluid_alsa_audio_run_float
+        fluid_alsa_audio_run_float,
+        FLUID_SAMPLE_FORMAT_FLOAT
     },
-    { NULL, 0, 0, NULL }
+    { NULL, 0, 0, NULL, 0 }
 };
 
 
@@ -108,10 +144,12 @@ typedef struct
     snd_rawmidi_t *rawmidi_in;
     struct pollfd *pfd;
     int npfd;
+    int wakeup_fd;      /* signalled to stop the thread, -1 if polling with a timeout */
     fluid_thread_t *thread;
     fluid_atomic_int_t should_quit;
     unsigned char buffer[BUFFER_LENGTH];
     fluid_midi_parser_t *parser;
+    fluid_midi_event_t events[FLUID_MIDI_DRIVER_BATCH];
 } fluid_alsa_rawmidi_driver_t;
 
 
@@ -128,8 +166,10 @@ typedef struct
     snd_seq_t *seq_handle;
     struct pollfd *pfd;
     int npfd;
+    int wakeup_fd;      /* signalled to stop the thread, -1 if polling with a timeout */
     fluid_thread_t *thread;
     fluid_atomic_int_t should_quit;
+    fluid_midi_event_t events[FLUID_MIDI_DRIVER_BATCH];
     int port_count;
     int autoconn_inputs;
     int dyn_sample_loading_is_active;
@@ -138,6 +178,10 @@ typedef struct
 
 static fluid_thread_return_t fluid_alsa_seq_run(void *d);
 
+static int fluid_alsa_midi_wakeup_open(void);
+static void fluid_alsa_midi_wakeup_add(int fd, struct pollfd *pfd, int *npfd);
+static void fluid_alsa_midi_wakeup_signal(int fd);
+
 /**************************************************************
  *
  *        Alsa audio driver
@@ -147,6 +191,8 @@ static fluid_thread_return_t fluid_alsa_seq_run(void *d);
 void fluid_alsa_audio_driver_settings(fluid_settings_t *settings)
 {
     fluid_settings_register_str(settings, "audio.alsa.device", "default", 0);
+    fluid_settings_register_int(settings, "audio.alsa.mmap", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "audio.alsa.avail-min", 0, 0, 8192, 0);
 }
 
 
@@ -166,6 +212,7 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
     int periods, period_size;
     char *device = NULL;
     int realtime_prio = 0;
+    int use_mmap = 0;
     int i, err, dir = 0;
     snd_pcm_hw_params_t *hwparams;
     snd_pcm_sw_params_t *swparams = NULL;
@@ -187,6 +234,10 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
     fluid_settings_getnum(settings, "synth.sample-rate", &sample_rate);
     fluid_settings_dupstr(settings, "audio.alsa.device", &device);   /* ++ dup device name */
     fluid_settings_getint(settings, "audio.realtime-prio", &realtime_prio);
+    fluid_settings_getint(settings, "audio.alsa.mmap", &use_mmap);
+    fluid_settings_getint(settings, "audio.alsa.avail-min", &dev->avail_min);
+    dev->cpu_count = fluid_settings_get_cpu_list(settings, "audio.cpu-affinity", dev->cpus,
+                     FLUID_N_ELEMENTS(dev->cpus));
 
     dev->data = data;
     dev->callback = func;
@@ -221,6 +272,10 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
 
     for(i = 0; fluid_alsa_formats[i].name != NULL; i++)
     {
+        if(fluid_alsa_formats[i].run == fluid_alsa_audio_run_mmap && (!use_mmap || func != NULL))
+        {
+            continue;
+        }
 
         snd_pcm_hw_params_any(dev->pcm, hwparams);
 
@@ -252,6 +307,8 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
             goto error_recovery;
         }
 
+        dev->sample_rate = tmp;
+
         if(tmp != sample_rate)
         {
             /* There's currently no way to change the sampling rate of the
@@ -305,6 +362,20 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
         goto error_recovery;
     }
 
+    FLUID_LOG(FLUID_DBG, "Using alsa audio format '%s'", fluid_alsa_formats[i].name);
+    dev->sample_format = fluid_alsa_formats[i].sample_format;
+
+    if(use_mmap && func != NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "audio.alsa.mmap is ignored with a user audio callback");
+    }
+
+    /* wake up once a period can be rendered, unless told otherwise */
+    if(dev->avail_min <= 0 || dev->avail_min > period_size)
+    {
+        dev->avail_min = period_size;
+    }
+
     /* Set the software params */
     snd_pcm_sw_params_current(dev->pcm, swparams);
 
@@ -313,7 +384,7 @@ new_fluid_alsa_audio_driver2(fluid_settings_t *settings,
         FLUID_LOG(FLUID_ERR, "Failed to set start threshold.");
     }
 
-    if(snd_pcm_sw_params_set_avail_min(dev->pcm, swparams, period_size) != 0)
+    if(snd_pcm_sw_params_set_avail_min(dev->pcm, swparams, dev->avail_min) != 0)
     {
         FLUID_LOG(FLUID_ERR, "Software setup for minimum available frames failed.");
     }
@@ -378,8 +449,10 @@ void delete_fluid_alsa_audio_driver(fluid_audio_driver_t *p)
 }
 
 /* handle error after an ALSA write call */
-static int fluid_alsa_handle_write_error(snd_pcm_t *pcm, int errval)
+static int fluid_alsa_handle_write_error(fluid_alsa_audio_driver_t *dev, int errval)
 {
+    snd_pcm_t *pcm = dev->pcm;
+
     switch(errval)
     {
     case -EAGAIN:
@@ -406,6 +479,11 @@ static int fluid_alsa_handle_write_error(snd_pcm_t *pcm, int errval)
     /* ... since the stream got resumed, but still has to be prepared */
     case -EPIPE:
     case -EBADFD:
+        if(errval == -EPIPE)
+        {
+            fluid_audio_driver_xrun(&dev->driver);
+        }
+
         if(snd_pcm_prepare(pcm) != 0)
         {
             FLUID_LOG(FLUID_ERR, "Failed to prepare the audio device");
@@ -422,6 +500,17 @@ static int fluid_alsa_handle_write_error(snd_pcm_t *pcm, int errval)
     return FLUID_OK;
 }
 
+/* Updates the latency of the telemetry from the frames queued in the device */
+static void fluid_alsa_update_latency(fluid_alsa_audio_driver_t *dev)
+{
+    snd_pcm_sframes_t delay;
+
+    if(snd_pcm_delay(dev->pcm, &delay) == 0)
+    {
+        fluid_audio_driver_set_latency(&dev->driver, delay * 1000000.0 / dev->sample_rate);
+    }
+}
+
 static fluid_thread_return_t fluid_alsa_audio_run_float(void *d)
 {
     fluid_alsa_audio_driver_t *dev = (fluid_alsa_audio_driver_t *) d;
@@ -429,10 +518,16 @@ static fluid_thread_return_t fluid_alsa_audio_run_float(void *d)
     float *left;
     float *right;
     float *handle[2];
+    double start;
     int n, buffer_size, offset;
 
     buffer_size = dev->buffer_size;
 
+    if(dev->cpu_count > 0)
+    {
+        fluid_thread_self_set_affinity(dev->cpus, dev->cpu_count);
+    }
+
     left = FLUID_ARRAY(float, buffer_size);
     right = FLUID_ARRAY(float, buffer_size);
 
@@ -459,7 +554,9 @@ static fluid_thread_return_t fluid_alsa_audio_run_float(void *d)
             handle[0] = left;
             handle[1] = right;
 
+            start = fluid_utime();
             (*dev->callback)(synth, buffer_size, 0, NULL, 2, handle);
+            fluid_audio_driver_period_done(&dev->driver, start, buffer_size, dev->sample_rate);
 
             offset = 0;
 
@@ -472,7 +569,7 @@ static fluid_thread_return_t fluid_alsa_audio_run_float(void *d)
 
                 if(n < 0)	/* error occurred? */
                 {
-                    if(fluid_alsa_handle_write_error(dev->pcm, n) != FLUID_OK)
+                    if(fluid_alsa_handle_write_error(dev, n) != FLUID_OK)
                     {
                         goto error_recovery;
                     }
@@ -482,13 +579,17 @@ static fluid_thread_return_t fluid_alsa_audio_run_float(void *d)
                     offset += n;    /* no error occurred */
                 }
             }	/* while (offset < buffer_size) */
+
+            fluid_alsa_update_latency(dev);
         }	/* while (dev->cont) */
     }
     else	/* no user audio callback (faster) */
     {
         while(dev->cont)
         {
+            start = fluid_utime();
             fluid_synth_write_float(dev->data, buffer_size, left, 0, 1, right, 0, 1);
+            fluid_audio_driver_period_done(&dev->driver, start, buffer_size, dev->sample_rate);
 
             offset = 0;
 
@@ -501,7 +602,7 @@ static fluid_thread_return_t fluid_alsa_audio_run_float(void *d)
 
                 if(n < 0)	/* error occurred? */
                 {
-                    if(fluid_alsa_handle_write_error(dev->pcm, n) != FLUID_OK)
+                    if(fluid_alsa_handle_write_error(dev, n) != FLUID_OK)
                     {
                         goto error_recovery;
                     }
@@ -511,6 +612,8 @@ static fluid_thread_return_t fluid_alsa_audio_run_float(void *d)
                     offset += n;    /* no error occurred */
                 }
             }	/* while (offset < buffer_size) */
+
+            fluid_alsa_update_latency(dev);
         }	/* while (dev->cont) */
     }
 
@@ -529,10 +632,16 @@ static fluid_thread_return_t fluid_alsa_audio_run_s16(void *d)
     float *right;
     short *buf;
     float *handle[2];
+    double start;
     int n, buffer_size, offset;
 
     buffer_size = dev->buffer_size;
 
+    if(dev->cpu_count > 0)
+    {
+        fluid_thread_self_set_affinity(dev->cpus, dev->cpu_count);
+    }
+
     left = FLUID_ARRAY(float, buffer_size);
     right = FLUID_ARRAY(float, buffer_size);
     buf = FLUID_ARRAY(short, 2 * buffer_size);
@@ -562,11 +671,13 @@ static fluid_thread_return_t fluid_alsa_audio_run_s16(void *d)
             FLUID_MEMSET(left, 0, buffer_size * sizeof(*left));
             FLUID_MEMSET(right, 0, buffer_size * sizeof(*right));
 
+            start = fluid_utime();
             (*dev->callback)(dev->data, buffer_size, 0, NULL, 2, handle);
 
             /* convert floating point data to 16 bit (with dithering) */
             fluid_synth_dither_s16(&dither_index, buffer_size, left, right,
                                    buf, 0, 2, buf, 1, 2);
+            fluid_audio_driver_period_done(&dev->driver, start, buffer_size, dev->sample_rate);
             offset = 0;
 
             while(offset < buffer_size)
@@ -576,7 +687,7 @@ static fluid_thread_return_t fluid_alsa_audio_run_s16(void *d)
 
                 if(n < 0)	/* error occurred? */
                 {
-                    if(fluid_alsa_handle_write_error(dev->pcm, n) != FLUID_OK)
+                    if(fluid_alsa_handle_write_error(dev, n) != FLUID_OK)
                     {
                         goto error_recovery;
                     }
@@ -586,6 +697,8 @@ static fluid_thread_return_t fluid_alsa_audio_run_s16(void *d)
                     offset += n;    /* no error occurred */
                 }
             }	/* while (offset < buffer_size) */
+
+            fluid_alsa_update_latency(dev);
         }	/* while (dev->cont) */
     }
     else	/* no user audio callback, dev->data is the synth instance */
@@ -594,7 +707,9 @@ static fluid_thread_return_t fluid_alsa_audio_run_s16(void *d)
 
         while(dev->cont)
         {
+            start = fluid_utime();
             fluid_synth_write_s16(synth, buffer_size, buf, 0, 2, buf, 1, 2);
+            fluid_audio_driver_period_done(&dev->driver, start, buffer_size, dev->sample_rate);
 
             offset = 0;
 
@@ -605,7 +720,7 @@ static fluid_thread_return_t fluid_alsa_audio_run_s16(void *d)
 
                 if(n < 0)	/* error occurred? */
                 {
-                    if(fluid_alsa_handle_write_error(dev->pcm, n) != FLUID_OK)
+                    if(fluid_alsa_handle_write_error(dev, n) != FLUID_OK)
                     {
                         goto error_recovery;
                     }
@@ -615,6 +730,8 @@ static fluid_thread_return_t fluid_alsa_audio_run_s16(void *d)
                     offset += n;    /* no error occurred */
                 }
             }	/* while (offset < buffer_size) */
+
+            fluid_alsa_update_latency(dev);
         }	/* while (dev->cont) */
     }
 
@@ -627,6 +744,149 @@ error_recovery:
     return FLUID_THREAD_RETURN_VALUE;
 }
 
+/* Points the channels of the synth to the mmap areas of the frames starting at offset */
+static int fluid_alsa_mmap_channels(const snd_pcm_channel_area_t *areas, snd_pcm_uframes_t offset,
+                                    int sample_size, void *channels_out[2], int channels_off[2],
+                                    int channels_incr[2])
+{
+    int ch;
+
+    for(ch = 0; ch < 2; ch++)
+    {
+        unsigned int bits = (unsigned int)sample_size * 8;
+
+        if(areas[ch].first % bits != 0 || areas[ch].step % bits != 0)
+        {
+            FLUID_LOG(FLUID_ERR, "Unsupported alsa mmap area layout");
+            return FLUID_FAILED;
+        }
+
+        channels_out[ch] = areas[ch].addr;
+        channels_incr[ch] = areas[ch].step / bits;
+        channels_off[ch] = areas[ch].first / bits + (int)offset * channels_incr[ch];
+    }
+
+    return FLUID_OK;
+}
+
+/* Renders the synth straight into the ring buffer of the device, no user callback */
+static fluid_thread_return_t fluid_alsa_audio_run_mmap(void *d)
+{
+    fluid_alsa_audio_driver_t *dev = (fluid_alsa_audio_driver_t *) d;
+    fluid_synth_t *synth = (fluid_synth_t *)(dev->data);
+    int sample_size = (dev->sample_format == FLUID_SAMPLE_FORMAT_S16) ? (int)sizeof(short) : (int)sizeof(float);
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset, frames;
+    snd_pcm_sframes_t avail, committed;
+    void *channels_out[2];
+    int channels_off[2], channels_incr[2];
+    int err = 0, size, frames_done;
+    double start;
+
+    if(dev->cpu_count > 0)
+    {
+        fluid_thread_self_set_affinity(dev->cpus, dev->cpu_count);
+    }
+
+    if(snd_pcm_prepare(dev->pcm) != 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to prepare the audio device");
+        goto error_recovery;
+    }
+
+    while(dev->cont)
+    {
+        avail = snd_pcm_avail_update(dev->pcm);
+
+        if(avail < 0)
+        {
+            if(fluid_alsa_handle_write_error(dev, (int)avail) != FLUID_OK)
+            {
+                goto error_recovery;
+            }
+
+            continue;
+        }
+
+        if(avail < dev->avail_min)
+        {
+            /* the ring buffer is filled, start playing it after (re)preparing the device */
+            if(snd_pcm_state(dev->pcm) == SND_PCM_STATE_PREPARED)
+            {
+                err = snd_pcm_start(dev->pcm);
+            }
+            else
+            {
+                err = snd_pcm_wait(dev->pcm, 1000);
+                err = (err < 0) ? err : 0;
+            }
+
+            if(err < 0 && fluid_alsa_handle_write_error(dev, err) != FLUID_OK)
+            {
+                goto error_recovery;
+            }
+
+            continue;
+        }
+
+        /* render at most a period, in up to two parts if the free frames wrap around
+         * the end of the ring buffer */
+        size = (avail < dev->buffer_size) ? (int)avail : dev->buffer_size;
+        start = fluid_utime();
+        frames_done = size;
+
+        while(size > 0)
+        {
+            frames = size;
+            err = snd_pcm_mmap_begin(dev->pcm, &areas, &offset, &frames);
+
+            if(err < 0)
+            {
+                break;
+            }
+
+            if(fluid_alsa_mmap_channels(areas, offset, sample_size, channels_out, channels_off,
+                                        channels_incr) != FLUID_OK)
+            {
+                goto error_recovery;
+            }
+
+            fluid_synth_write_channels(synth, (int)frames, dev->sample_format, 2,
+                                       channels_out, channels_off, channels_incr);
+
+            committed = snd_pcm_mmap_commit(dev->pcm, offset, frames);
+
+            if(committed >= 0 && (snd_pcm_uframes_t)committed != frames)
+            {
+                committed = -EPIPE;
+            }
+
+            if(committed < 0)
+            {
+                err = (int)committed;
+                break;
+            }
+
+            size -= (int)frames;
+        }
+
+        if(size < frames_done)
+        {
+            fluid_audio_driver_period_done(&dev->driver, start, frames_done - size, dev->sample_rate);
+            fluid_alsa_update_latency(dev);
+        }
+
+        if(size > 0 && fluid_alsa_handle_write_error(dev, err) != FLUID_OK)
+        {
+            goto error_recovery;
+        }
+    }
+
+error_recovery:
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
 
 /**************************************************************
  *
@@ -759,6 +1019,8 @@ new_fluid_alsa_rawmidi_driver(fluid_settings_t *settings,
 
     dev->driver.handler = handler;
     dev->driver.data = data;
+    dev->wakeup_fd = -1;
+    fluid_settings_getint(settings, "midi.batch-events", &dev->driver.batch_events);
 
     /* allocate one event to store the input data */
     dev->parser = new_fluid_midi_parser();
@@ -790,7 +1052,7 @@ new_fluid_alsa_rawmidi_driver(fluid_settings_t *settings,
     if(count > 0)  		/* make sure there are some */
     {
         pfd = FLUID_MALLOC(sizeof(struct pollfd) * count);
-        dev->pfd = FLUID_MALLOC(sizeof(struct pollfd) * count);
+        dev->pfd = FLUID_MALLOC(sizeof(struct pollfd) * (count + 1));
         /* grab file descriptor POLL info structures */
         count = snd_rawmidi_poll_descriptors(dev->rawmidi_in, pfd, count);
     }
@@ -809,6 +1071,12 @@ new_fluid_alsa_rawmidi_driver(fluid_settings_t *settings,
 
     FLUID_FREE(pfd);
 
+    if(dev->pfd != NULL)
+    {
+        dev->wakeup_fd = fluid_alsa_midi_wakeup_open();
+        fluid_alsa_midi_wakeup_add(dev->wakeup_fd, dev->pfd, &dev->npfd);
+    }
+
     fluid_atomic_int_set(&dev->should_quit, 0);
 
     /* create the MIDI thread */
@@ -849,6 +1117,7 @@ delete_fluid_alsa_rawmidi_driver(fluid_midi_driver_t *p)
 
     /* cancel the thread and wait for it before cleaning up */
     fluid_atomic_int_set(&dev->should_quit, 1);
+    fluid_alsa_midi_wakeup_signal(dev->wakeup_fd);
 
     if(dev->thread)
     {
@@ -856,6 +1125,11 @@ delete_fluid_alsa_rawmidi_driver(fluid_midi_driver_t *p)
         delete_fluid_thread(dev->thread);
     }
 
+    if(dev->wakeup_fd >= 0)
+    {
+        close(dev->wakeup_fd);
+    }
+
     if(dev->rawmidi_in)
     {
         snd_rawmidi_close(dev->rawmidi_in);
@@ -877,23 +1151,26 @@ fluid_alsa_midi_run(void *d)
 {
     fluid_midi_event_t *evt;
     fluid_alsa_rawmidi_driver_t *dev = (fluid_alsa_rawmidi_driver_t *) d;
-    int n, i;
+    int n, i, count;
 
     /* go into a loop until someone tells us to stop */
     while(!fluid_atomic_int_get(&dev->should_quit))
     {
 
-        /* is there something to read? */
-        n = poll(dev->pfd, dev->npfd, 100); /* use a 100 milliseconds timeout */
+        /* is there something to read? without a wakeup fd, use a 100 milliseconds timeout */
+        n = poll(dev->pfd, dev->npfd, (dev->wakeup_fd >= 0) ? -1 : 100);
 
         if(n < 0)
         {
             perror("poll");
+            continue;
         }
-        else if(n > 0)
-        {
 
-            /* read new data */
+        /* read all the data there is, converting the events in batches */
+        count = 0;
+
+        while(n > 0 && !fluid_atomic_int_get(&dev->should_quit))
+        {
             n = snd_rawmidi_read(dev->rawmidi_in, dev->buffer, BUFFER_LENGTH);
 
             if((n < 0) && (n != -EAGAIN))
@@ -907,12 +1184,23 @@ fluid_alsa_midi_run(void *d)
             {
                 evt = fluid_midi_parser_parse(dev->parser, dev->buffer[i]);
 
-                if(evt != NULL)
+                if(evt == NULL)
+                {
+                    continue;
+                }
+
+                dev->events[count++] = *evt;
+
+                /* the data of a SYSEX event is overwritten by the next one parsed */
+                if(count == FLUID_MIDI_DRIVER_BATCH || evt->type == MIDI_SYSEX)
                 {
-                    (*dev->driver.handler)(dev->driver.data, evt);
+                    fluid_midi_driver_handle_events(&dev->driver, dev->events, count);
+                    count = 0;
                 }
             }
         }
+
+        fluid_midi_driver_handle_events(&dev->driver, dev->events, count);
     }
 
     return FLUID_THREAD_RETURN_VALUE;
@@ -1114,6 +1402,8 @@ new_fluid_alsa_seq_driver(fluid_settings_t *settings,
     FLUID_MEMSET(dev, 0, sizeof(fluid_alsa_seq_driver_t));
     dev->driver.data = data;
     dev->driver.handler = handler;
+    dev->wakeup_fd = -1;
+    fluid_settings_getint(settings, "midi.batch-events", &dev->driver.batch_events);
 
     fluid_settings_getint(settings, "midi.realtime-prio", &realtime_prio);
 
@@ -1167,7 +1457,7 @@ new_fluid_alsa_seq_driver(fluid_settings_t *settings,
     if(count > 0)  		/* make sure there are some */
     {
         pfd = FLUID_MALLOC(sizeof(struct pollfd) * count);
-        dev->pfd = FLUID_MALLOC(sizeof(struct pollfd) * count);
+        dev->pfd = FLUID_MALLOC(sizeof(struct pollfd) * (count + 1));
         /* grab file descriptor POLL info structures */
         count = snd_seq_poll_descriptors(dev->seq_handle, pfd, count, POLLIN);
     }
@@ -1186,6 +1476,12 @@ new_fluid_alsa_seq_driver(fluid_settings_t *settings,
 
     FLUID_FREE(pfd);
 
+    if(dev->pfd != NULL)
+    {
+        dev->wakeup_fd = fluid_alsa_midi_wakeup_open();
+        fluid_alsa_midi_wakeup_add(dev->wakeup_fd, dev->pfd, &dev->npfd);
+    }
+
     /* set the client name */
     if(!portname)
     {
@@ -1304,6 +1600,7 @@ delete_fluid_alsa_seq_driver(fluid_midi_driver_t *p)
 
     /* cancel the thread and wait for it before cleaning up */
     fluid_atomic_int_set(&dev->should_quit, 1);
+    fluid_alsa_midi_wakeup_signal(dev->wakeup_fd);
 
     if(dev->thread)
     {
@@ -1311,6 +1608,11 @@ delete_fluid_alsa_seq_driver(fluid_midi_driver_t *p)
         delete_fluid_thread(dev->thread);
     }
 
+    if(dev->wakeup_fd >= 0)
+    {
+        close(dev->wakeup_fd);
+    }
+
     if(dev->seq_handle)
     {
         snd_seq_close(dev->seq_handle);
@@ -1330,17 +1632,17 @@ delete_fluid_alsa_seq_driver(fluid_midi_driver_t *p)
 fluid_thread_return_t
 fluid_alsa_seq_run(void *d)
 {
-    int n, ev;
+    int n, ev, count;
     snd_seq_event_t *seq_ev;
-    fluid_midi_event_t evt;
+    fluid_midi_event_t *evt;
     fluid_alsa_seq_driver_t *dev = (fluid_alsa_seq_driver_t *) d;
 
     /* go into a loop until someone tells us to stop */
     while(!fluid_atomic_int_get(&dev->should_quit))
     {
 
-        /* is there something to read? */
-        n = poll(dev->pfd, dev->npfd, 100); /* use a 100 milliseconds timeout */
+        /* is there something to read? without a wakeup fd, use a 100 milliseconds timeout */
+        n = poll(dev->pfd, dev->npfd, (dev->wakeup_fd >= 0) ? -1 : 100);
 
         if(n < 0)
         {
@@ -1348,8 +1650,12 @@ fluid_alsa_seq_run(void *d)
         }
         else if(n > 0)           /* check for pending events */
         {
+            /* drain the whole burst, converting the events in batches */
+            count = 0;
+
             do
             {
+                evt = &dev->events[count];
                 ev = snd_seq_event_input(dev->seq_handle, &seq_ev);	/* read the events */
 
                 if(ev == -EAGAIN)
@@ -1380,54 +1686,56 @@ fluid_alsa_seq_run(void *d)
                     break;
                 }
 
+                fluid_midi_event_stamp(evt);
+
                 switch(seq_ev->type)
                 {
                 case SND_SEQ_EVENT_NOTEON:
-                    evt.type = NOTE_ON;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
-                    evt.param1 = seq_ev->data.note.note;
-                    evt.param2 = seq_ev->data.note.velocity;
+                    evt->type = NOTE_ON;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
+                    evt->param1 = seq_ev->data.note.note;
+                    evt->param2 = seq_ev->data.note.velocity;
                     break;
 
                 case SND_SEQ_EVENT_NOTEOFF:
-                    evt.type = NOTE_OFF;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
-                    evt.param1 = seq_ev->data.note.note;
-                    evt.param2 = seq_ev->data.note.velocity;
+                    evt->type = NOTE_OFF;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
+                    evt->param1 = seq_ev->data.note.note;
+                    evt->param2 = seq_ev->data.note.velocity;
                     break;
 
                 case SND_SEQ_EVENT_KEYPRESS:
-                    evt.type = KEY_PRESSURE;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
-                    evt.param1 = seq_ev->data.note.note;
-                    evt.param2 = seq_ev->data.note.velocity;
+                    evt->type = KEY_PRESSURE;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.note.channel;
+                    evt->param1 = seq_ev->data.note.note;
+                    evt->param2 = seq_ev->data.note.velocity;
                     break;
 
                 case SND_SEQ_EVENT_CONTROLLER:
-                    evt.type = CONTROL_CHANGE;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
-                    evt.param1 = seq_ev->data.control.param;
-                    evt.param2 = seq_ev->data.control.value;
+                    evt->type = CONTROL_CHANGE;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
+                    evt->param1 = seq_ev->data.control.param;
+                    evt->param2 = seq_ev->data.control.value;
                     break;
 
                 case SND_SEQ_EVENT_PITCHBEND:
-                    evt.type = PITCH_BEND;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
+                    evt->type = PITCH_BEND;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
 
                     /* ALSA pitch bend is -8192 - 8191, we adjust it here */
-                    evt.param1 = seq_ev->data.control.value + 8192;
+                    evt->param1 = seq_ev->data.control.value + 8192;
                     break;
 
                 case SND_SEQ_EVENT_PGMCHANGE:
-                    evt.type = PROGRAM_CHANGE;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
-                    evt.param1 = seq_ev->data.control.value;
+                    evt->type = PROGRAM_CHANGE;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
+                    evt->param1 = seq_ev->data.control.value;
                     break;
 
                 case SND_SEQ_EVENT_CHANPRESS:
-                    evt.type = CHANNEL_PRESSURE;
-                    evt.channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
-                    evt.param1 = seq_ev->data.control.value;
+                    evt->type = CHANNEL_PRESSURE;
+                    evt->channel = seq_ev->dest.port * 16 + seq_ev->data.control.channel;
+                    evt->param1 = seq_ev->data.control.value;
                     break;
 
                 case SND_SEQ_EVENT_SYSEX:
@@ -1436,7 +1744,7 @@ fluid_alsa_seq_run(void *d)
                         continue;
                     }
 
-                    fluid_midi_event_set_sysex(&evt, (char *)(seq_ev->data.ext.ptr) + 1,
+                    fluid_midi_event_set_sysex(evt, (char *)(seq_ev->data.ext.ptr) + 1,
                                                seq_ev->data.ext.len - 2, FALSE);
                     break;
 
@@ -1447,40 +1755,97 @@ fluid_alsa_seq_run(void *d)
                         fluid_alsa_seq_autoconnect_port(dev, seq_ev->data.addr.client, seq_ev->data.addr.port);
                     }
                 }
-                break;
+                continue;
 
                 case SND_SEQ_EVENT_START:
-                    evt.type = MIDI_START;
+                    evt->type = MIDI_START;
                     break;
 
                 case SND_SEQ_EVENT_CONTINUE:
-                    evt.type = MIDI_CONTINUE;
+                    evt->type = MIDI_CONTINUE;
                     break;
 
                 case SND_SEQ_EVENT_STOP:
-                    evt.type = MIDI_STOP;
+                    evt->type = MIDI_STOP;
                     break;
 
                 case SND_SEQ_EVENT_CLOCK:
-                    evt.type = MIDI_SYNC;
+                    evt->type = MIDI_SYNC;
                     break;
 
                 case SND_SEQ_EVENT_RESET:
-                    evt.type = MIDI_SYSTEM_RESET;
+                    evt->type = MIDI_SYSTEM_RESET;
                     break;
 
                 default:
                     continue;		/* unhandled event, next loop iteration */
                 }
 
-                /* send the events to the next link in the chain */
-                (*dev->driver.handler)(dev->driver.data, &evt);
+                count++;
+
+                /* the data of a SYSEX event is only valid until the next event is read */
+                if(count == FLUID_MIDI_DRIVER_BATCH || evt->type == MIDI_SYSEX)
+                {
+                    /* send the events to the next link in the chain */
+                    fluid_midi_driver_handle_events(&dev->driver, dev->events, count);
+                    count = 0;
+                }
             }
-            while(ev > 0);
+            while(!fluid_atomic_int_get(&dev->should_quit));
+
+            fluid_midi_driver_handle_events(&dev->driver, dev->events, count);
         }	/* if poll() > 0 */
     }	/* while (!dev->should_quit) */
 
     return FLUID_THREAD_RETURN_VALUE;
 }
 
+/*
+ * Creates an eventfd that the destructor of a MIDI driver signals to wake up its
+ * thread, so that it can poll its input without a timeout. Returns -1 if not
+ * available.
+ */
+static int
+fluid_alsa_midi_wakeup_open(void)
+{
+#if HAVE_SYS_EVENTFD_H
+    int fd = eventfd(0, EFD_CLOEXEC);
+
+    if(fd < 0)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to create an eventfd, polling the MIDI input with a timeout");
+    }
+
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+/* Adds the wakeup fd to the poll descriptors, which must have room for it */
+static void
+fluid_alsa_midi_wakeup_add(int fd, struct pollfd *pfd, int *npfd)
+{
+    if(fd >= 0)
+    {
+        pfd[*npfd].fd = fd;
+        pfd[*npfd].events = POLLIN;
+        pfd[*npfd].revents = 0;
+        (*npfd)++;
+    }
+}
+
+static void
+fluid_alsa_midi_wakeup_signal(int fd)
+{
+#if HAVE_SYS_EVENTFD_H
+
+    if(fd >= 0)
+    {
+        eventfd_write(fd, 1);
+    }
+
+#endif
+}
+
 #endif /* #if ALSA_SUPPORT */
@@ -40,6 +40,17 @@
 #include "fluid_sys.h"
 #include <cstdlib> /* rand(), RAND_MAX */
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLUID_CONVERT_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define FLUID_CONVERT_NEON 1
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#define FLUID_CONVERT_WASM 1
+#include <wasm_simd128.h>
+#endif
+
 /* --------------------------------------------------------------------------
  * Shared kernels storage/initialization (single definition)
  * -------------------------------------------------------------------------- */
@@ -71,6 +82,313 @@ extern "C" {
 
 } /* extern "C" */
 
+/* --------------------------------------------------------------------------
+ * Block conversion kernels
+ *
+ * The vector code must give exactly the same results as round_clip_to<T>():
+ * NaN converts to 0, values are rounded half away from zero like std::round(),
+ * and out-of-range values saturate. For int32_t, anything from 2^31 upwards
+ * saturates to INT32_MAX, below that the largest float is 2147483520.
+ * -------------------------------------------------------------------------- */
+
+#if FLUID_CONVERT_SSE2
+static FLUID_INLINE __m128 fluid_convert_sse2_load(const float *in)
+{
+    return _mm_loadu_ps(in);
+}
+
+static FLUID_INLINE __m128 fluid_convert_sse2_load(const double *in)
+{
+    return _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(in)), _mm_cvtpd_ps(_mm_loadu_pd(in + 2)));
+}
+
+/* in * 2147483646.0f in the precision of the input, rounded to float */
+static FLUID_INLINE __m128 fluid_convert_sse2_load_s32(const float *in)
+{
+    return _mm_mul_ps(_mm_loadu_ps(in), _mm_set1_ps(2147483646.0f));
+}
+
+static FLUID_INLINE __m128 fluid_convert_sse2_load_s32(const double *in)
+{
+    const __m128d scale = _mm_set1_pd(2147483646.0f);
+
+    return _mm_movelh_ps(_mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(in), scale)),
+                         _mm_cvtpd_ps(_mm_mul_pd(_mm_loadu_pd(in + 2), scale)));
+}
+
+/* rounds 4 values to integers after clamping them to [lo, hi] */
+static FLUID_INLINE __m128i fluid_convert_sse2_round_clip(__m128 x, float lo, float hi)
+{
+    __m128i t;
+    __m128 d;
+
+    x = _mm_and_ps(x, _mm_cmpord_ps(x, x)); /* NaN to 0 */
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(lo)), _mm_set1_ps(hi));
+    t = _mm_cvttps_epi32(x);
+    d = _mm_sub_ps(x, _mm_cvtepi32_ps(t)); /* exact */
+
+    /* round the truncated value away from zero, the compare masks are -1 where true */
+    t = _mm_sub_epi32(t, _mm_castps_si128(_mm_cmpge_ps(d, _mm_set1_ps(0.5f))));
+    return _mm_add_epi32(t, _mm_castps_si128(_mm_cmple_ps(d, _mm_set1_ps(-0.5f))));
+}
+
+template<typename In>
+static int fluid_convert_s16_simd(const In *in, const float *dither, int16_t *out, int count)
+{
+    const __m128 scale = _mm_set1_ps(32766.0f);
+    int i;
+
+    for(i = 0; i + 8 <= count; i += 8)
+    {
+        __m128 a = _mm_mul_ps(fluid_convert_sse2_load(in + i), scale);
+        __m128 b = _mm_mul_ps(fluid_convert_sse2_load(in + i + 4), scale);
+
+        if(dither != NULL)
+        {
+            a = _mm_add_ps(a, _mm_loadu_ps(dither + i));
+            b = _mm_add_ps(b, _mm_loadu_ps(dither + i + 4));
+        }
+
+        _mm_storeu_si128((__m128i *)(out + i),
+                         _mm_packs_epi32(fluid_convert_sse2_round_clip(a, -32768.0f, 32767.0f),
+                                         fluid_convert_sse2_round_clip(b, -32768.0f, 32767.0f)));
+    }
+
+    return i;
+}
+
+template<typename In>
+static int fluid_convert_s32_simd(const In *in, int32_t *out, int count, int32_t mask)
+{
+    int i;
+
+    for(i = 0; i + 4 <= count; i += 4)
+    {
+        __m128 x = fluid_convert_sse2_load_s32(in + i);
+        __m128i sat = _mm_castps_si128(_mm_cmpge_ps(x, _mm_set1_ps(2147483648.0f)));
+        __m128i r = fluid_convert_sse2_round_clip(x, -2147483648.0f, 2147483520.0f);
+
+        /* 2147483520 is 0x7FFFFF80, setting the low bits saturates it to INT32_MAX */
+        r = _mm_or_si128(r, _mm_and_si128(sat, _mm_set1_epi32(0x7F)));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_and_si128(r, _mm_set1_epi32(mask)));
+    }
+
+    return i;
+}
+
+#elif FLUID_CONVERT_NEON
+static FLUID_INLINE float32x4_t fluid_convert_neon_load(const float *in)
+{
+    return vld1q_f32(in);
+}
+
+static FLUID_INLINE float32x4_t fluid_convert_neon_load(const double *in)
+{
+    return vcvt_high_f32_f64(vcvt_f32_f64(vld1q_f64(in)), vld1q_f64(in + 2));
+}
+
+static FLUID_INLINE float32x4_t fluid_convert_neon_load_s32(const float *in)
+{
+    return vmulq_f32(vld1q_f32(in), vdupq_n_f32(2147483646.0f));
+}
+
+static FLUID_INLINE float32x4_t fluid_convert_neon_load_s32(const double *in)
+{
+    const float64x2_t scale = vdupq_n_f64(2147483646.0f);
+
+    return vcvt_high_f32_f64(vcvt_f32_f64(vmulq_f64(vld1q_f64(in), scale)),
+                             vmulq_f64(vld1q_f64(in + 2), scale));
+}
+
+/* vcvtaq_s32_f32() rounds half away from zero, saturates and converts NaN to 0
+ * just like round_clip_to<int32_t>(), vqmovn_s32() saturates further to int16_t */
+template<typename In>
+static int fluid_convert_s16_simd(const In *in, const float *dither, int16_t *out, int count)
+{
+    const float32x4_t scale = vdupq_n_f32(32766.0f);
+    int i;
+
+    for(i = 0; i + 8 <= count; i += 8)
+    {
+        float32x4_t a = vmulq_f32(fluid_convert_neon_load(in + i), scale);
+        float32x4_t b = vmulq_f32(fluid_convert_neon_load(in + i + 4), scale);
+
+        if(dither != NULL)
+        {
+            a = vaddq_f32(a, vld1q_f32(dither + i));
+            b = vaddq_f32(b, vld1q_f32(dither + i + 4));
+        }
+
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vcvtaq_s32_f32(a)), vqmovn_s32(vcvtaq_s32_f32(b))));
+    }
+
+    return i;
+}
+
+template<typename In>
+static int fluid_convert_s32_simd(const In *in, int32_t *out, int count, int32_t mask)
+{
+    int i;
+
+    for(i = 0; i + 4 <= count; i += 4)
+    {
+        vst1q_s32(out + i, vandq_s32(vcvtaq_s32_f32(fluid_convert_neon_load_s32(in + i)), vdupq_n_s32(mask)));
+    }
+
+    return i;
+}
+
+#elif FLUID_CONVERT_WASM
+static FLUID_INLINE v128_t fluid_convert_wasm_load(const float *in)
+{
+    return wasm_v128_load(in);
+}
+
+static FLUID_INLINE v128_t fluid_convert_wasm_load(const double *in)
+{
+    return wasm_i32x4_shuffle(wasm_f32x4_demote_f64x2_zero(wasm_v128_load(in)),
+                              wasm_f32x4_demote_f64x2_zero(wasm_v128_load(in + 2)), 0, 1, 4, 5);
+}
+
+static FLUID_INLINE v128_t fluid_convert_wasm_load_s32(const float *in)
+{
+    return wasm_f32x4_mul(wasm_v128_load(in), wasm_f32x4_splat(2147483646.0f));
+}
+
+static FLUID_INLINE v128_t fluid_convert_wasm_load_s32(const double *in)
+{
+    const v128_t scale = wasm_f64x2_splat(2147483646.0f);
+
+    return wasm_i32x4_shuffle(wasm_f32x4_demote_f64x2_zero(wasm_f64x2_mul(wasm_v128_load(in), scale)),
+                              wasm_f32x4_demote_f64x2_zero(wasm_f64x2_mul(wasm_v128_load(in + 2), scale)),
+                              0, 1, 4, 5);
+}
+
+/* rounds 4 values to integers after clamping them to [lo, hi], like the SSE2 version.
+ * The truncation converts NaN to 0, which isn't rounded as comparisons with it fail. */
+static FLUID_INLINE v128_t fluid_convert_wasm_round_clip(v128_t x, float lo, float hi)
+{
+    v128_t t, d;
+
+    x = wasm_f32x4_pmin(wasm_f32x4_pmax(x, wasm_f32x4_splat(lo)), wasm_f32x4_splat(hi));
+    t = wasm_i32x4_trunc_sat_f32x4(x);
+    d = wasm_f32x4_sub(x, wasm_f32x4_convert_i32x4(t)); /* exact */
+
+    /* round the truncated value away from zero, the compare masks are -1 where true */
+    t = wasm_i32x4_sub(t, wasm_f32x4_ge(d, wasm_f32x4_splat(0.5f)));
+    return wasm_i32x4_add(t, wasm_f32x4_le(d, wasm_f32x4_splat(-0.5f)));
+}
+
+template<typename In>
+static int fluid_convert_s16_simd(const In *in, const float *dither, int16_t *out, int count)
+{
+    const v128_t scale = wasm_f32x4_splat(32766.0f);
+    int i;
+
+    for(i = 0; i + 8 <= count; i += 8)
+    {
+        v128_t a = wasm_f32x4_mul(fluid_convert_wasm_load(in + i), scale);
+        v128_t b = wasm_f32x4_mul(fluid_convert_wasm_load(in + i + 4), scale);
+
+        if(dither != NULL)
+        {
+            a = wasm_f32x4_add(a, wasm_v128_load(dither + i));
+            b = wasm_f32x4_add(b, wasm_v128_load(dither + i + 4));
+        }
+
+        wasm_v128_store(out + i, wasm_i16x8_narrow_i32x4(fluid_convert_wasm_round_clip(a, -32768.0f, 32767.0f),
+                                                          fluid_convert_wasm_round_clip(b, -32768.0f, 32767.0f)));
+    }
+
+    return i;
+}
+
+template<typename In>
+static int fluid_convert_s32_simd(const In *in, int32_t *out, int count, int32_t mask)
+{
+    int i;
+
+    for(i = 0; i + 4 <= count; i += 4)
+    {
+        v128_t x = fluid_convert_wasm_load_s32(in + i);
+        v128_t sat = wasm_f32x4_ge(x, wasm_f32x4_splat(2147483648.0f));
+        v128_t r = fluid_convert_wasm_round_clip(x, -2147483648.0f, 2147483520.0f);
+
+        /* 2147483520 is 0x7FFFFF80, setting the low bits saturates it to INT32_MAX */
+        r = wasm_v128_or(r, wasm_v128_and(sat, wasm_i32x4_splat(0x7F)));
+        wasm_v128_store(out + i, wasm_v128_and(r, wasm_i32x4_splat(mask)));
+    }
+
+    return i;
+}
+
+#else
+template<typename In>
+static int fluid_convert_s16_simd(const In *, const float *, int16_t *, int)
+{
+    return 0;
+}
+
+template<typename In>
+static int fluid_convert_s32_simd(const In *, int32_t *, int, int32_t)
+{
+    return 0;
+}
+#endif
+
+template<typename In>
+static FLUID_INLINE void fluid_convert_s16(const In *in, const float *dither, int16_t *out, int count)
+{
+    int i = fluid_convert_s16_simd(in, dither, out, count);
+
+    /* keep the arithmetic order: (sample * 32766.0f) + dither, then round and clip */
+    for(; i < count; i++)
+    {
+        out[i] = round_clip_to<int16_t>((dither != NULL) ? (float)in[i] * 32766.0f + dither[i] : (float)in[i] * 32766.0f);
+    }
+}
+
+template<typename In>
+static FLUID_INLINE void fluid_convert_s32(const In *in, int32_t *out, int count, int32_t mask)
+{
+    int i = fluid_convert_s32_simd(in, out, count, mask);
+
+    for(; i < count; i++)
+    {
+        out[i] = (int32_t)(round_clip_to<int32_t>(in[i] * 2147483646.0f) & mask);
+    }
+}
+
+void fluid_audio_convert_s16(const float *in, const float *dither, int16_t *out, int count)
+{
+    fluid_convert_s16(in, dither, out, count);
+}
+
+void fluid_audio_convert_s16(const double *in, const float *dither, int16_t *out, int count)
+{
+    fluid_convert_s16(in, dither, out, count);
+}
+
+void fluid_audio_convert_s32(const float *in, int32_t *out, int count, int32_t mask)
+{
+    fluid_convert_s32(in, out, count, mask);
+}
+
+void fluid_audio_convert_s32(const double *in, int32_t *out, int count, int32_t mask)
+{
+    fluid_convert_s32(in, out, count, mask);
+}
+
+/* Stores count converted samples every stride samples */
+template<typename T>
+static FLUID_INLINE void fluid_convert_scatter(T *dst, int stride, const T *src, int count)
+{
+    for(int i = 0; i < count; i++, dst += stride)
+    {
+        *dst = src[i];
+    }
+}
+
 static int fluid_audio_convert_validate_args(const char *func_name,
         const void *dst_interleaved,
         int dst_stride,
@@ -141,22 +459,26 @@ extern "C" int fluid_audio_planar_float_to_s16(int16_t *dst_interleaved,
         return FLUID_OK;
     }
 
+    int16_t tmp[FLUID_BUFSIZE];
     int di = 0;
 
-    for(int f = 0; f < frames; ++f)
+    /* convert each channel in chunks not crossing the end of the dither table */
+    for(int f = 0, count; f < frames; f += count)
     {
-        /* One interleaved frame: write channel samples then advance by stride. */
+        count = std::min(std::min(frames - f, (int)FLUID_BUFSIZE), DITHER_SIZE - di);
+
         for(int ch = 0; ch < channels; ++ch)
         {
-            dst_interleaved[ch] = round_clip_to<int16_t>(src_planar[ch][f] * 32766.0f + rand_table[ch & 1][di]);
+            fluid_audio_convert_s16(&src_planar[ch][f], &rand_table[ch & 1][di], tmp, count);
+            fluid_convert_scatter(&dst_interleaved[ch], dst_stride, tmp, count);
         }
 
-        if(++di >= DITHER_SIZE)
+        if((di += count) >= DITHER_SIZE)
         {
             di = 0;
         }
 
-        dst_interleaved += dst_stride;
+        dst_interleaved += count * dst_stride;
     }
 
     return FLUID_OK;
@@ -180,15 +502,20 @@ extern "C" int fluid_audio_planar_float_to_s24(int32_t *dst_interleaved,
         return FLUID_OK;
     }
 
-    for(int f = 0; f < frames; ++f)
+    int32_t tmp[FLUID_BUFSIZE];
+
+    for(int f = 0, count; f < frames; f += count)
     {
+        count = std::min(frames - f, (int)FLUID_BUFSIZE);
+
         for(int ch = 0; ch < channels; ++ch)
         {
-            int32_t s = round_clip_to<int32_t>(src_planar[ch][f] * 2147483646.0f);
-            dst_interleaved[ch] = (int32_t)(s & 0xFFFFFF00);
+            /* s24: the low 8 bits of the s32 conversion are cleared */
+            fluid_audio_convert_s32(&src_planar[ch][f], tmp, count, ~(int32_t)0xFF);
+            fluid_convert_scatter(&dst_interleaved[ch], dst_stride, tmp, count);
         }
 
-        dst_interleaved += dst_stride;
+        dst_interleaved += count * dst_stride;
     }
 
     return FLUID_OK;
@@ -212,14 +539,19 @@ extern "C" int fluid_audio_planar_float_to_s32(int32_t *dst_interleaved,
         return FLUID_OK;
     }
 
-    for(int f = 0; f < frames; ++f)
+    int32_t tmp[FLUID_BUFSIZE];
+
+    for(int f = 0, count; f < frames; f += count)
     {
+        count = std::min(frames - f, (int)FLUID_BUFSIZE);
+
         for(int ch = 0; ch < channels; ++ch)
         {
-            dst_interleaved[ch] = round_clip_to<int32_t>(src_planar[ch][f] * 2147483646.0f);
+            fluid_audio_convert_s32(&src_planar[ch][f], tmp, count, -1);
+            fluid_convert_scatter(&dst_interleaved[ch], dst_stride, tmp, count);
         }
 
-        dst_interleaved += dst_stride;
+        dst_interleaved += count * dst_stride;
     }
 
     return FLUID_OK;
@@ -262,7 +594,8 @@ fluid_synth_dither_s16(int *dither_index, int len, const float *lin, const float
                        int16_t *lout, int loff, int lincr,
                        int16_t *rout, int roff, int rincr)
 {
-    int i, j, k;
+    int16_t tmp[FLUID_BUFSIZE];
+    int i, j, k, count;
     int16_t *left_out = lout;
     int16_t *right_out = rout;
     int di = *dither_index;
@@ -276,12 +609,16 @@ fluid_synth_dither_s16(int *dither_index, int len, const float *lin, const float
         dither_initialized = 1;
     }
 
-    for(i = 0, j = loff, k = roff; i < len; i++, j += lincr, k += rincr)
+    for(i = 0, j = loff, k = roff; i < len; i += count, j += count * lincr, k += count * rincr)
     {
-        left_out[j] = round_clip_to<int16_t>(lin[i] * 32766.0f + rand_table[0][di]);
-        right_out[k] = round_clip_to<int16_t>(rin[i] * 32766.0f + rand_table[1][di]);
+        count = std::min(std::min(len - i, (int)FLUID_BUFSIZE), DITHER_SIZE - di);
+
+        fluid_audio_convert_s16(&lin[i], &rand_table[0][di], tmp, count);
+        fluid_convert_scatter(&left_out[j], lincr, tmp, count);
+        fluid_audio_convert_s16(&rin[i], &rand_table[1][di], tmp, count);
+        fluid_convert_scatter(&right_out[k], rincr, tmp, count);
 
-        if(++di >= DITHER_SIZE)
+        if((di += count) >= DITHER_SIZE)
         {
             di = 0;
         }
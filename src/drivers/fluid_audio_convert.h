@@ -75,6 +75,21 @@ T round_clip_to(float x)
     return i;
 }
 
+/*
+ * Block conversion kernels, vectorized where SSE2 or NEON are available and
+ * bit-identical to the scalar expressions given for each of them. The
+ * overloads for double input multiply in double, like the scalar code does
+ * with fluid_real_t samples.
+ */
+
+/* out[i] = round_clip_to<int16_t>((float)in[i] * 32766.0f + dither[i]), dither may be NULL */
+void fluid_audio_convert_s16(const float *in, const float *dither, int16_t *out, int count);
+void fluid_audio_convert_s16(const double *in, const float *dither, int16_t *out, int count);
+
+/* out[i] = round_clip_to<int32_t>(in[i] * 2147483646.0f) & mask, the mask clears the padding of s24 */
+void fluid_audio_convert_s32(const float *in, int32_t *out, int count, int32_t mask);
+void fluid_audio_convert_s32(const double *in, int32_t *out, int count, int32_t mask);
+
 extern "C" {
 #else
 #include <stdint.h>
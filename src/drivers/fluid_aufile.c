@@ -60,7 +60,7 @@ new_fluid_file_audio_driver(fluid_settings_t *settings,
                             fluid_synth_t *synth)
 {
     fluid_file_audio_driver_t *dev;
-    int msec;
+    int usec;
 
     dev = FLUID_NEW(fluid_file_audio_driver_t);
 
@@ -85,8 +85,8 @@ new_fluid_file_audio_driver(fluid_settings_t *settings,
         goto error_recovery;
     }
 
-    msec = (int)(0.5 + dev->period_size / dev->sample_rate * 1000.0);
-    dev->timer = new_fluid_timer(msec, fluid_file_audio_run, (void *) dev, TRUE, FALSE, TRUE);
+    usec = (int)(0.5 + dev->period_size / dev->sample_rate * 1000000.0);
+    dev->timer = new_fluid_timer_us(usec, fluid_file_audio_run, (void *) dev, TRUE, FALSE, TRUE);
 
     if(dev->timer == NULL)
     {
@@ -42,6 +42,12 @@
 #include "fluid_coreaudio_avaudiosession.h"
 #endif
 #include <AudioUnit/AudioUnit.h>
+#if HAVE_OS_WORKGROUP_H
+#include <os/workgroup.h>
+#endif
+
+/* for fluid_synth_set_workgroup(), pulls in <netinet/tcp.h> so it must come last */
+#include "fluid_synth.h"
 
 static const char PERF_MODE[] = "audio.coreaudio.performance-mode";
 
@@ -60,6 +66,7 @@ typedef struct
     unsigned int buffer_count;
     float **buffers;
     double phase;
+    fluid_synth_t *workgroup_synth; /* synth whose mixer threads joined the workgroup of the device, or NULL */
 } fluid_core_audio_driver_t;
 
 
@@ -192,29 +199,18 @@ set_channel_map(AudioUnit outputUnit, int audio_channels, const char *map_string
     FLUID_FREE(channel_map);
 }
 
-void
-fluid_core_audio_driver_settings(fluid_settings_t *settings)
-{
 #if COREAUDIO_SUPPORT_HAL
+/* Adds the output devices to the options of "audio.coreaudio.device" once they are asked for */
+static void
+fluid_core_audio_device_options(fluid_settings_t *settings, const char *setting)
+{
     int i;
     UInt32 size;
     AudioObjectPropertyAddress pa;
     pa.mSelector = kAudioHardwarePropertyDevices;
     pa.mScope = kAudioObjectPropertyScopeWildcard;
     pa.mElement = kAudioObjectPropertyElementMain;
-#endif
 
-    fluid_settings_register_str(settings, "audio.coreaudio.device", "default", 0);
-    fluid_settings_register_str(settings, "audio.coreaudio.channel-map", "", 0);
-    fluid_settings_add_option(settings, "audio.coreaudio.device", "default");
-
-#if !COREAUDIO_SUPPORT_HAL
-    fluid_settings_register_str(settings, PERF_MODE, "None", 0);
-    fluid_settings_add_option(settings, PERF_MODE, "None");
-    fluid_settings_add_option(settings, PERF_MODE, "LowLatency");
-#endif
-
-#if COREAUDIO_SUPPORT_HAL
     if(OK(AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &pa, 0, 0, &size)))
     {
         int num = size / (int) sizeof(AudioDeviceID);
@@ -232,12 +228,63 @@ fluid_core_audio_driver_settings(fluid_settings_t *settings)
                 {
                     if(get_num_outputs(devs[i]) > 0)
                     {
-                        fluid_settings_add_option(settings, "audio.coreaudio.device", name);
+                        fluid_settings_add_option(settings, setting, name);
                     }
                 }
             }
         }
     }
+}
+#endif
+
+void
+fluid_core_audio_driver_settings(fluid_settings_t *settings)
+{
+    fluid_settings_register_str(settings, "audio.coreaudio.device", "default", 0);
+    fluid_settings_register_str(settings, "audio.coreaudio.channel-map", "", 0);
+    fluid_settings_add_option(settings, "audio.coreaudio.device", "default");
+
+#if !COREAUDIO_SUPPORT_HAL
+    fluid_settings_register_str(settings, PERF_MODE, "None", 0);
+    fluid_settings_add_option(settings, PERF_MODE, "None");
+    fluid_settings_add_option(settings, PERF_MODE, "LowLatency");
+#endif
+
+#if COREAUDIO_SUPPORT_HAL
+    fluid_settings_lazy_options(settings, "audio.coreaudio.device", fluid_core_audio_device_options);
+#endif
+}
+
+/*
+ * Hand the workgroup of the device's IO thread over to the synth, so that its extra mixer
+ * threads render with the same deadline. Otherwise the scheduler may put them on efficiency
+ * cores, where they miss the deadline of the IO thread waiting for them.
+ */
+static void
+fluid_core_audio_driver_share_workgroup(fluid_core_audio_driver_t *dev, fluid_synth_t *synth)
+{
+#if HAVE_OS_WORKGROUP_H
+    if(__builtin_available(macOS 11.0, iOS 14.0, tvOS 14.0, *))
+    {
+        os_workgroup_t workgroup = NULL;
+        UInt32 size = sizeof(workgroup);
+
+        /* returns a reference the synth takes ownership of */
+        OSStatus status = AudioUnitGetProperty(dev->outputUnit,
+                                               kAudioOutputUnitProperty_OSWorkgroup,
+                                               kAudioUnitScope_Global,
+                                               0,
+                                               &workgroup, &size);
+
+        if(status != noErr || workgroup == NULL)
+        {
+            FLUID_LOG(FLUID_DBG, "The audio device has no workgroup. Status=%ld\n", (long int)status);
+            return;
+        }
+
+        fluid_synth_set_workgroup(synth, workgroup);
+        dev->workgroup_synth = synth;
+    }
 #endif
 }
 
@@ -495,6 +542,11 @@ new_fluid_core_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t func
         goto error_recovery;
     }
 
+    if(func == NULL)
+    {
+        fluid_core_audio_driver_share_workgroup(dev, data);
+    }
+
     // Start the rendering
     status = AudioOutputUnitStart(dev->outputUnit);
 
@@ -527,6 +579,11 @@ delete_fluid_core_audio_driver(fluid_audio_driver_t *p)
     AudioComponentInstanceDispose(dev->outputUnit);
 #endif
 
+    if(dev->workgroup_synth != NULL)
+    {
+        fluid_synth_set_workgroup(dev->workgroup_synth, NULL);
+    }
+
     if(dev->buffers != NULL)
     {
         FLUID_FREE(dev->buffers);
@@ -159,15 +159,22 @@ fluid_dsound_enum_callback2(LPGUID guid, LPCTSTR description, LPCTSTR module, LP
     return TRUE;
 }
 
+static void
+fluid_dsound_device_options(fluid_settings_t *settings, const char *name)
+{
+    DirectSoundEnumerate((LPDSENUMCALLBACK) fluid_dsound_enum_callback, settings);
+}
+
 /*
    - register setting "audio.dsound.device".
-   - add list of dsound device name as option of "audio.dsound.device" setting.
+   - add list of dsound device name as option of "audio.dsound.device" setting,
+     once the options are asked for.
 */
 void fluid_dsound_audio_driver_settings(fluid_settings_t *settings)
 {
     fluid_settings_register_str(settings, "audio.dsound.device", "default", 0);
     fluid_settings_add_option(settings, "audio.dsound.device", "default");
-    DirectSoundEnumerate((LPDSENUMCALLBACK) fluid_dsound_enum_callback, settings);
+    fluid_settings_lazy_options(settings, "audio.dsound.device", fluid_dsound_device_options);
 }
 
 
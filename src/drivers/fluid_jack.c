@@ -31,6 +31,7 @@
 #include "fluid_adriver.h"
 #include "fluid_mdriver.h"
 #include "fluid_settings.h"
+#include "fluid_ringbuffer.h"
 
 #if JACK_SUPPORT
 
@@ -41,6 +42,36 @@
 typedef struct _fluid_jack_audio_driver_t fluid_jack_audio_driver_t;
 typedef struct _fluid_jack_midi_driver_t fluid_jack_midi_driver_t;
 
+/* Raw MIDI bytes are passed from the process callback to the MIDI thread in chunks
+ * of this size. Larger events (SYSEX) take several chunks, the parser joins them. */
+#define FLUID_JACK_MIDI_CHUNK_SIZE 28
+
+/* Number of chunks the queue between the process callback and the MIDI thread holds */
+#define FLUID_JACK_MIDI_QUEUE_SIZE 4096
+
+/* Time in milliseconds the MIDI thread sleeps when the queue is empty */
+#define FLUID_JACK_MIDI_POLL_MSEC 1
+
+typedef struct
+{
+    int port;           /* index of the MIDI port the bytes were received on */
+    int size;           /* number of valid bytes in data */
+    unsigned int ingress; /* time the bytes were received, see fluid_midi_event_stamp() */
+    unsigned char data[FLUID_JACK_MIDI_CHUNK_SIZE];
+} fluid_jack_midi_chunk_t;
+
+
+/* The audio drivers hosted by a client with audio.jack.shared. The set is replaced as
+ * a whole when a driver joins or leaves, so that the process callback never sees it
+ * changing under its feet. */
+typedef struct
+{
+    int count;
+    fluid_jack_audio_driver_t **drivers;
+    fluid_synth_t **synths;       /* the synths rendered at once in a period, */
+    float **left;                 /* and their port buffers */
+    float **right;
+} fluid_jack_hosts_t;
 
 /* Clients are shared for drivers using the same server. */
 typedef struct
@@ -49,6 +80,12 @@ typedef struct
     char *server;                 /* Jack server name used */
     fluid_jack_audio_driver_t *audio_driver;
     fluid_jack_midi_driver_t *midi_driver;
+
+    /* With audio.jack.shared, any number of audio drivers are hosted instead of audio_driver */
+    int shared;
+    int joined;                   /* number of audio drivers that have joined, to name their ports */
+    fluid_jack_hosts_t *hosts;
+    fluid_render_pool_t *pool;    /* renders the synths of the hosts in parallel, NULL if synth.cpu-cores is 1 */
 } fluid_jack_client_t;
 
 /* Jack audio driver instance */
@@ -56,6 +93,7 @@ struct _fluid_jack_audio_driver_t
 {
     fluid_audio_driver_t driver;
     fluid_jack_client_t *client_ref;
+    char port_prefix[16];         /* tells apart the ports of drivers sharing a client */
 
     jack_port_t **output_ports;
     int num_output_ports;
@@ -79,6 +117,14 @@ struct _fluid_jack_midi_driver_t
     fluid_midi_parser_t *parser;
     int autoconnect_inputs;
     fluid_atomic_int_t autoconnect_is_outdated;
+
+    /* The process callback only copies the received bytes into this lock-free queue.
+     * Parsing and calling the handler, which may take the synth API lock, is left to
+     * the MIDI thread, so that other threads using the synth never stall the graph. */
+    fluid_ringbuffer_t *queue;
+    fluid_atomic_int_t dropped;     /* events lost because the queue was full */
+    fluid_thread_t *thread;
+    fluid_atomic_int_t status;
 };
 
 static fluid_jack_client_t *new_fluid_jack_client(fluid_settings_t *settings,
@@ -91,10 +137,15 @@ void fluid_jack_driver_shutdown(void *arg);
 int fluid_jack_driver_srate(jack_nframes_t nframes, void *arg);
 int fluid_jack_driver_bufsize(jack_nframes_t nframes, void *arg);
 int fluid_jack_driver_process(jack_nframes_t nframes, void *arg);
+int fluid_jack_driver_xrun(void *arg);
+void fluid_jack_driver_latency(jack_latency_callback_mode_t mode, void *arg);
 void fluid_jack_port_registration(jack_port_id_t port, int is_registering, void *arg);
 
+static fluid_thread_return_t fluid_jack_midi_run(void *data);
+
 static fluid_mutex_t last_client_mutex = FLUID_MUTEX_INIT;     /* Probably not necessary, but just in case drivers are created by multiple threads */
 static fluid_jack_client_t *last_client = NULL;       /* Last unpaired client. For audio/MIDI driver pairing. */
+static fluid_list_t *shared_clients = NULL;           /* Clients audio drivers with audio.jack.shared may join, also locked by last_client_mutex */
 
 
 void
@@ -104,6 +155,162 @@ fluid_jack_audio_driver_settings(fluid_settings_t *settings)
     fluid_settings_register_int(settings, "audio.jack.multi", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_int(settings, "audio.jack.autoconnect", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_str(settings, "audio.jack.server", "", 0);
+    fluid_settings_register_int(settings, "audio.jack.shared", 0, 0, 1, FLUID_HINT_TOGGLED);
+}
+
+static void
+delete_fluid_jack_hosts(fluid_jack_hosts_t *hosts)
+{
+    fluid_return_if_fail(hosts != NULL);
+
+    FLUID_FREE(hosts->drivers);
+    FLUID_FREE(hosts->synths);
+    FLUID_FREE(hosts->left);
+    FLUID_FREE(hosts->right);
+    FLUID_FREE(hosts);
+}
+
+static fluid_jack_hosts_t *
+new_fluid_jack_hosts(int count)
+{
+    fluid_jack_hosts_t *hosts = FLUID_NEW(fluid_jack_hosts_t);
+
+    if(hosts == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        return NULL;
+    }
+
+    hosts->count = count;
+    hosts->drivers = FLUID_ARRAY(fluid_jack_audio_driver_t *, count);
+    hosts->synths = FLUID_ARRAY(fluid_synth_t *, count);
+    hosts->left = FLUID_ARRAY(float *, count);
+    hosts->right = FLUID_ARRAY(float *, count);
+
+    if(hosts->drivers == NULL || hosts->synths == NULL || hosts->left == NULL || hosts->right == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        delete_fluid_jack_hosts(hosts);
+        return NULL;
+    }
+
+    return hosts;
+}
+
+/*
+ * Replaces the audio drivers hosted by a shared client, last_client_mutex must be locked.
+ */
+static void
+fluid_jack_client_set_hosts(fluid_jack_client_t *client_ref, fluid_jack_hosts_t *hosts)
+{
+    fluid_jack_hosts_t *old_hosts = client_ref->hosts;
+
+    fluid_atomic_pointer_set(&client_ref->hosts, hosts);
+
+    if(old_hosts != NULL)
+    {
+        fluid_msleep(100);  /* FIXME - Same hack as in fluid_jack_client_close(), the Jack callback may still use the old set */
+        delete_fluid_jack_hosts(old_hosts);
+    }
+}
+
+/*
+ * Makes a client host an audio driver alongside the others using audio.jack.shared.
+ * The ports of the driver must have been registered, last_client_mutex must be locked.
+ */
+static int
+fluid_jack_client_add_host(fluid_jack_client_t *client_ref, fluid_jack_audio_driver_t *dev,
+                           fluid_settings_t *settings)
+{
+    fluid_jack_hosts_t *hosts;
+    int count = (client_ref->hosts != NULL) ? client_ref->hosts->count : 0;
+
+    if(!client_ref->shared)
+    {
+        int cores = 1;
+
+        /* the render pool has to be there before the process callback sees any host */
+        fluid_settings_getint(settings, "synth.cpu-cores", &cores);
+
+        if(cores > 1)
+        {
+            client_ref->pool = new_fluid_render_pool(settings);
+        }
+
+        shared_clients = fluid_list_prepend(shared_clients, client_ref);
+        client_ref->shared = TRUE;
+    }
+
+    hosts = new_fluid_jack_hosts(count + 1);
+
+    if(hosts == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(count > 0)
+    {
+        FLUID_MEMCPY(hosts->drivers, client_ref->hosts->drivers, count * sizeof(*hosts->drivers));
+    }
+
+    hosts->drivers[count] = dev;
+    fluid_jack_client_set_hosts(client_ref, hosts);
+    client_ref->joined++;
+
+    return FLUID_OK;
+}
+
+/*
+ * Stops hosting an audio driver in a shared client and unregisters its ports.
+ */
+static void
+fluid_jack_client_remove_host(fluid_jack_client_t *client_ref, fluid_jack_audio_driver_t *dev)
+{
+    fluid_jack_hosts_t *hosts = NULL;
+    int i, n, count;
+
+    fluid_mutex_lock(last_client_mutex);
+
+    count = (client_ref->hosts != NULL) ? client_ref->hosts->count : 0;
+
+    if(count > 1)
+    {
+        hosts = new_fluid_jack_hosts(count - 1);
+
+        if(hosts == NULL)
+        {
+            /* keep the driver in the set, at least its ports are not rendered anymore */
+            fluid_mutex_unlock(last_client_mutex);
+            return;
+        }
+
+        for(i = n = 0; i < count; i++)
+        {
+            if(client_ref->hosts->drivers[i] != dev)
+            {
+                hosts->drivers[n++] = client_ref->hosts->drivers[i];
+            }
+        }
+    }
+    else
+    {
+        /* no more joining, the client is about to be closed */
+        shared_clients = fluid_list_remove(shared_clients, client_ref);
+    }
+
+    fluid_jack_client_set_hosts(client_ref, hosts);
+
+    fluid_mutex_unlock(last_client_mutex);
+
+    for(i = 0; i < 2 * dev->num_output_ports; i++)
+    {
+        jack_port_unregister(client_ref->client, dev->output_ports[i]);
+    }
+
+    for(i = 0; i < 2 * dev->num_fx_ports; i++)
+    {
+        jack_port_unregister(client_ref->client, dev->fx_ports[i]);
+    }
 }
 
 /*
@@ -146,9 +353,11 @@ static fluid_jack_client_t *
 new_fluid_jack_client(fluid_settings_t *settings, int isaudio, void *driver)
 {
     fluid_jack_client_t *client_ref = NULL;
+    fluid_list_t *p;
     char *server = NULL;
     char *client_name;
     char name[64];
+    int shared = 0;
 
     if(fluid_settings_dupstr(settings, isaudio ? "audio.jack.server"          /* ++ alloc server name */
                              : "midi.jack.server", &server) != FLUID_OK)
@@ -156,22 +365,57 @@ new_fluid_jack_client(fluid_settings_t *settings, int isaudio, void *driver)
         return NULL;
     }
 
+    if(isaudio)
+    {
+        fluid_settings_getint(settings, "audio.jack.shared", &shared);
+    }
+
     fluid_mutex_lock(last_client_mutex);      /* ++ lock last_client */
 
+    /* A shared audio driver joins the shared client of the same server, if any */
+    for(p = shared ? shared_clients : NULL; p != NULL; p = fluid_list_next(p))
+    {
+        client_ref = fluid_list_get(p);
+
+        if(server != NULL && FLUID_STRCMP(client_ref->server, server) == 0)
+        {
+            fluid_jack_audio_driver_t *dev = driver;
+
+            FLUID_SNPRINTF(dev->port_prefix, sizeof(dev->port_prefix), "synth%d_", client_ref->joined + 1);
+
+            if(fluid_jack_client_register_ports(driver, isaudio, client_ref->client, settings) != FLUID_OK
+                    || fluid_jack_client_add_host(client_ref, dev, settings) != FLUID_OK)
+            {
+                // like below, client_ref is being used by the other audio drivers
+                client_ref = NULL;
+            }
+
+            fluid_mutex_unlock(last_client_mutex);        /* -- unlock last_client */
+            FLUID_FREE(server);
+            return client_ref;
+        }
+    }
+
     /* If the last client uses the same server and is not the same type (audio or MIDI),
      * then reuse the client. */
     if(last_client &&
             (last_client->server != NULL && server != NULL && FLUID_STRCMP(last_client->server, server) == 0) &&
-            ((!isaudio && last_client->midi_driver == NULL) || (isaudio && last_client->audio_driver == NULL)))
+            ((!isaudio && last_client->midi_driver == NULL)
+             || (isaudio && last_client->audio_driver == NULL && !last_client->shared)))
     {
         client_ref = last_client;
 
         /* Register ports */
-        if(fluid_jack_client_register_ports(driver, isaudio, client_ref->client, settings) == FLUID_OK)
+        if(fluid_jack_client_register_ports(driver, isaudio, client_ref->client, settings) == FLUID_OK
+                && (!shared || fluid_jack_client_add_host(client_ref, driver, settings) == FLUID_OK))
         {
             last_client = NULL; /* No more pairing for this client */
 
-            if(isaudio)
+            if(shared)
+            {
+                /* hosted above */
+            }
+            else if(isaudio)
             {
                 fluid_atomic_pointer_set(&client_ref->audio_driver, driver);
             }
@@ -247,6 +491,8 @@ new_fluid_jack_client(fluid_settings_t *settings, int isaudio, void *driver)
     jack_set_process_callback(client_ref->client, fluid_jack_driver_process, client_ref);
     jack_set_buffer_size_callback(client_ref->client, fluid_jack_driver_bufsize, client_ref);
     jack_set_sample_rate_callback(client_ref->client, fluid_jack_driver_srate, client_ref);
+    jack_set_xrun_callback(client_ref->client, fluid_jack_driver_xrun, client_ref);
+    jack_set_latency_callback(client_ref->client, fluid_jack_driver_latency, client_ref);
     jack_on_shutdown(client_ref->client, fluid_jack_driver_shutdown, client_ref);
 
     /* Register ports */
@@ -265,9 +511,19 @@ new_fluid_jack_client(fluid_settings_t *settings, int isaudio, void *driver)
     client_ref->server = server;        /* !! takes over allocation */
     server = NULL;      /* Set to NULL so it doesn't get freed below */
 
+    if(shared && fluid_jack_client_add_host(client_ref, driver, settings) != FLUID_OK)
+    {
+        shared_clients = fluid_list_remove(shared_clients, client_ref);
+        goto error_recovery;
+    }
+
     last_client = client_ref;
 
-    if(isaudio)
+    if(shared)
+    {
+        /* hosted above */
+    }
+    else if(isaudio)
     {
         fluid_atomic_pointer_set(&client_ref->audio_driver, driver);
     }
@@ -301,6 +557,8 @@ error_recovery:
             jack_client_close(client_ref->client);
         }
 
+        delete_fluid_render_pool(client_ref->pool);
+        FLUID_FREE(client_ref->server);
         FLUID_FREE(client_ref);
     }
 
@@ -372,11 +630,13 @@ fluid_jack_client_register_ports(void *driver, int isaudio, jack_client_t *clien
         dev->output_bufs = FLUID_ARRAY(float *, 2 * dev->num_output_ports);
         FLUID_MEMSET(dev->output_ports, 0, 2 * dev->num_output_ports * sizeof(jack_port_t *));
 
+        FLUID_SNPRINTF(name, sizeof(name), "%sleft", dev->port_prefix);
         dev->output_ports[0]
-            = jack_port_register(client, "left", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+            = jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
 
+        FLUID_SNPRINTF(name, sizeof(name), "%sright", dev->port_prefix);
         dev->output_ports[1]
-            = jack_port_register(client, "right", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+            = jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
 
         if(dev->output_ports[0] == NULL || dev->output_ports[1] == NULL)
         {
@@ -409,7 +669,7 @@ fluid_jack_client_register_ports(void *driver, int isaudio, jack_client_t *clien
 
         for(i = 0; i < dev->num_output_ports; i++)
         {
-            sprintf(name, "l_%02d", i);
+            FLUID_SNPRINTF(name, sizeof(name), "%sl_%02d", dev->port_prefix, i);
 
             if((dev->output_ports[2 * i]
                     = jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0)) == NULL)
@@ -418,7 +678,7 @@ fluid_jack_client_register_ports(void *driver, int isaudio, jack_client_t *clien
                 goto error_recovery;
             }
 
-            sprintf(name, "r_%02d", i);
+            FLUID_SNPRINTF(name, sizeof(name), "%sr_%02d", dev->port_prefix, i);
 
             if((dev->output_ports[2 * i + 1]
                     = jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0)) == NULL)
@@ -452,7 +712,7 @@ fluid_jack_client_register_ports(void *driver, int isaudio, jack_client_t *clien
 
         for(i = 0; i < dev->num_fx_ports; i++)
         {
-            sprintf(name, "fx_l_%02d", i);
+            FLUID_SNPRINTF(name, sizeof(name), "%sfx_l_%02d", dev->port_prefix, i);
 
             if((dev->fx_ports[2 * i]
                     = jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0)) == NULL)
@@ -461,7 +721,7 @@ fluid_jack_client_register_ports(void *driver, int isaudio, jack_client_t *clien
                 goto error_recovery;
             }
 
-            sprintf(name, "fx_r_%02d", i);
+            FLUID_SNPRINTF(name, sizeof(name), "%sfx_r_%02d", dev->port_prefix, i);
 
             if((dev->fx_ports[2 * i + 1]
                     = jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0)) == NULL)
@@ -521,8 +781,12 @@ fluid_jack_client_close(fluid_jack_client_t *client_ref, void *driver)
     {
         fluid_atomic_pointer_set(&client_ref->midi_driver, NULL);
     }
+    else if(client_ref->shared)
+    {
+        fluid_jack_client_remove_host(client_ref, driver);
+    }
 
-    if(client_ref->audio_driver || client_ref->midi_driver)
+    if(client_ref->audio_driver || client_ref->midi_driver || client_ref->hosts)
     {
         fluid_msleep(100);  /* FIXME - Hack to make sure that resources don't get freed while Jack callback is active */
         return;
@@ -547,6 +811,7 @@ fluid_jack_client_close(fluid_jack_client_t *client_ref, void *driver)
         FLUID_FREE(client_ref->server);
     }
 
+    delete_fluid_render_pool(client_ref->pool);
     FLUID_FREE(client_ref);
 }
 
@@ -674,6 +939,104 @@ delete_fluid_jack_audio_driver(fluid_audio_driver_t *p)
     FLUID_FREE(dev);
 }
 
+/* Renders a period of an audio driver into its ports */
+static int
+fluid_jack_driver_render(fluid_jack_audio_driver_t *audio_driver, jack_nframes_t nframes)
+{
+    float *left, *right;
+    int i, res;
+
+    if(audio_driver->callback == NULL && audio_driver->num_output_ports == 1 && audio_driver->num_fx_ports == 0)  /* i.e. audio.jack.multi=no */
+    {
+        left = (float *) jack_port_get_buffer(audio_driver->output_ports[0], nframes);
+        right = (float *) jack_port_get_buffer(audio_driver->output_ports[1], nframes);
+
+        res = fluid_synth_write_float(audio_driver->data, nframes, left, 0, 1, right, 0, 1);
+    }
+    else
+    {
+        fluid_audio_func_t callback = (audio_driver->callback != NULL) ? audio_driver->callback : (fluid_audio_func_t) fluid_synth_process;
+
+        for(i = 0; i < audio_driver->num_output_ports; i++)
+        {
+            int k = i * 2;
+
+            audio_driver->output_bufs[k] = (float *)jack_port_get_buffer(audio_driver->output_ports[k], nframes);
+            FLUID_MEMSET(audio_driver->output_bufs[k], 0, nframes * sizeof(float));
+
+            k = 2 * i + 1;
+            audio_driver->output_bufs[k] = (float *)jack_port_get_buffer(audio_driver->output_ports[k], nframes);
+            FLUID_MEMSET(audio_driver->output_bufs[k], 0, nframes * sizeof(float));
+        }
+
+        for(i = 0; i < audio_driver->num_fx_ports; i++)
+        {
+            int k = i * 2;
+
+            audio_driver->fx_bufs[k] = (float *) jack_port_get_buffer(audio_driver->fx_ports[k], nframes);
+            FLUID_MEMSET(audio_driver->fx_bufs[k], 0, nframes * sizeof(float));
+
+            k = 2 * i + 1;
+            audio_driver->fx_bufs[k] = (float *) jack_port_get_buffer(audio_driver->fx_ports[k], nframes);
+            FLUID_MEMSET(audio_driver->fx_bufs[k], 0, nframes * sizeof(float));
+        }
+
+        res = callback(audio_driver->data,
+                        nframes,
+                        audio_driver->num_fx_ports * 2,
+                        audio_driver->fx_bufs,
+                        audio_driver->num_output_ports * 2,
+                        audio_driver->output_bufs);
+        if(res != FLUID_OK)
+        {
+            const char *cb_func_name = (audio_driver->callback != NULL) ? "Custom audio callback function" : "fluid_synth_process()";
+            FLUID_LOG(FLUID_PANIC, "%s returned an error. As a consequence, fluidsynth will now be removed from Jack's processing loop.", cb_func_name);
+        }
+    }
+
+    return res;
+}
+
+/* Renders a period of the audio drivers hosted by a shared client. The plain
+ * stereo synths are all rendered at once, in parallel if there is a render pool. */
+static int
+fluid_jack_client_render_hosts(fluid_jack_client_t *client, fluid_jack_hosts_t *hosts,
+                               jack_nframes_t nframes, double start)
+{
+    fluid_jack_audio_driver_t *audio_driver;
+    int i, n = 0, res = FLUID_OK;
+
+    for(i = 0; i < hosts->count; i++)
+    {
+        audio_driver = hosts->drivers[i];
+
+        if(audio_driver->callback == NULL && audio_driver->num_output_ports == 1 && audio_driver->num_fx_ports == 0)
+        {
+            hosts->synths[n] = audio_driver->data;
+            hosts->left[n] = (float *) jack_port_get_buffer(audio_driver->output_ports[0], nframes);
+            hosts->right[n] = (float *) jack_port_get_buffer(audio_driver->output_ports[1], nframes);
+            n++;
+        }
+        else if(fluid_jack_driver_render(audio_driver, nframes) != FLUID_OK)
+        {
+            res = FLUID_FAILED;
+        }
+    }
+
+    if(fluid_render_pool_write_float(client->pool, n, hosts->synths, nframes, hosts->left, hosts->right) != FLUID_OK)
+    {
+        res = FLUID_FAILED;
+    }
+
+    for(i = 0; i < hosts->count; i++)
+    {
+        fluid_audio_driver_period_done(&hosts->drivers[i]->driver, start, nframes,
+                                       jack_get_sample_rate(client->client));
+    }
+
+    return res;
+}
+
 /* Process function for audio and MIDI Jack drivers */
 int
 fluid_jack_driver_process(jack_nframes_t nframes, void *arg)
@@ -681,15 +1044,17 @@ fluid_jack_driver_process(jack_nframes_t nframes, void *arg)
     fluid_jack_client_t *client = (fluid_jack_client_t *)arg;
     fluid_jack_audio_driver_t *audio_driver;
     fluid_jack_midi_driver_t *midi_driver;
-    float *left, *right;
+    fluid_jack_hosts_t *hosts;
     int i;
 
     jack_midi_event_t midi_event;
-    fluid_midi_event_t *evt;
+    fluid_jack_midi_chunk_t *chunk;
     void *midi_buffer;
     jack_nframes_t event_count;
     jack_nframes_t event_index;
-    unsigned int u;
+    size_t u, size;
+    double start = fluid_utime();
+    int res;
 
     /* Process MIDI events first, so that they take effect before audio synthesis */
     midi_driver = fluid_atomic_pointer_get(&client->midi_driver);
@@ -710,22 +1075,41 @@ fluid_jack_driver_process(jack_nframes_t nframes, void *arg)
             {
                 jack_midi_event_get(&midi_event, midi_buffer, event_index);
 
-                /* let the parser convert the data into events */
-                for(u = 0; u < midi_event.size; u++)
+                /* hand the bytes over to the MIDI thread, without blocking */
+                for(u = 0; u < midi_event.size; u += size)
                 {
-                    evt = fluid_midi_parser_parse(midi_driver->parser, midi_event.buffer[u]);
+                    chunk = fluid_ringbuffer_get_inptr(midi_driver->queue, 0);
+
+                    if(chunk == NULL)
+                    {
+                        fluid_atomic_int_inc(&midi_driver->dropped);
+                        break;
+                    }
+
+                    size = midi_event.size - u;
 
-                    /* send the event to the next link in the chain */
-                    if(evt != NULL)
+                    if(size > FLUID_JACK_MIDI_CHUNK_SIZE)
                     {
-                        fluid_midi_event_set_channel(evt, fluid_midi_event_get_channel(evt) + i * 16);
-                        midi_driver->driver.handler(midi_driver->driver.data, evt);
+                        size = FLUID_JACK_MIDI_CHUNK_SIZE;
                     }
+
+                    chunk->port = i;
+                    chunk->size = (int)size;
+                    chunk->ingress = fluid_midi_ingress_now();
+                    FLUID_MEMCPY(chunk->data, midi_event.buffer + u, size);
+                    fluid_ringbuffer_next_inptr(midi_driver->queue, 1);
                 }
             }
         }
     }
 
+    hosts = fluid_atomic_pointer_get(&client->hosts);
+
+    if(hosts != NULL)
+    {
+        return fluid_jack_client_render_hosts(client, hosts, nframes, start);
+    }
+
     audio_driver = fluid_atomic_pointer_get(&client->audio_driver);
 
     if(audio_driver == NULL)
@@ -734,61 +1118,83 @@ fluid_jack_driver_process(jack_nframes_t nframes, void *arg)
         return FLUID_OK;
     }
 
-    if(audio_driver->callback == NULL && audio_driver->num_output_ports == 1 && audio_driver->num_fx_ports == 0)  /* i.e. audio.jack.multi=no */
-    {
-        left = (float *) jack_port_get_buffer(audio_driver->output_ports[0], nframes);
-        right = (float *) jack_port_get_buffer(audio_driver->output_ports[1], nframes);
+    res = fluid_jack_driver_render(audio_driver, nframes);
 
-        return fluid_synth_write_float(audio_driver->data, nframes, left, 0, 1, right, 0, 1);
+    fluid_audio_driver_period_done(&audio_driver->driver, start, nframes,
+                                   jack_get_sample_rate(client->client));
+    return res;
+}
+
+/* Called by JACK on a non realtime thread after an xrun */
+int
+fluid_jack_driver_xrun(void *arg)
+{
+    fluid_jack_client_t *client = (fluid_jack_client_t *)arg;
+    fluid_jack_audio_driver_t *audio_driver = fluid_atomic_pointer_get(&client->audio_driver);
+    fluid_jack_hosts_t *hosts = fluid_atomic_pointer_get(&client->hosts);
+    int i;
+
+    if(audio_driver != NULL)
+    {
+        fluid_audio_driver_xrun(&audio_driver->driver);
     }
-    else
+
+    for(i = 0; hosts != NULL && i < hosts->count; i++)
     {
-        int res;
-        fluid_audio_func_t callback = (audio_driver->callback != NULL) ? audio_driver->callback : (fluid_audio_func_t) fluid_synth_process;
+        fluid_audio_driver_xrun(&hosts->drivers[i]->driver);
+    }
 
-        for(i = 0; i < audio_driver->num_output_ports; i++)
-        {
-            int k = i * 2;
+    return 0;
+}
 
-            audio_driver->output_bufs[k] = (float *)jack_port_get_buffer(audio_driver->output_ports[k], nframes);
-            FLUID_MEMSET(audio_driver->output_bufs[k], 0, nframes * sizeof(float));
+static void
+fluid_jack_driver_update_latency(fluid_jack_client_t *client, fluid_jack_audio_driver_t *audio_driver)
+{
+    jack_latency_range_t range;
 
-            k = 2 * i + 1;
-            audio_driver->output_bufs[k] = (float *)jack_port_get_buffer(audio_driver->output_ports[k], nframes);
-            FLUID_MEMSET(audio_driver->output_bufs[k], 0, nframes * sizeof(float));
-        }
+    if(audio_driver == NULL || audio_driver->num_output_ports == 0)
+    {
+        return;
+    }
 
-        for(i = 0; i < audio_driver->num_fx_ports; i++)
-        {
-            int k = i * 2;
+    jack_port_get_latency_range(audio_driver->output_ports[0], JackPlaybackLatency, &range);
+    fluid_audio_driver_set_latency(&audio_driver->driver,
+                                   range.max * 1000000.0 / jack_get_sample_rate(client->client));
+}
 
-            audio_driver->fx_bufs[k] = (float *) jack_port_get_buffer(audio_driver->fx_ports[k], nframes);
-            FLUID_MEMSET(audio_driver->fx_bufs[k], 0, nframes * sizeof(float));
+/* Called by JACK whenever the latencies of the graph have been recomputed */
+void
+fluid_jack_driver_latency(jack_latency_callback_mode_t mode, void *arg)
+{
+    fluid_jack_client_t *client = (fluid_jack_client_t *)arg;
+    fluid_jack_hosts_t *hosts = fluid_atomic_pointer_get(&client->hosts);
+    int i;
 
-            k = 2 * i + 1;
-            audio_driver->fx_bufs[k] = (float *) jack_port_get_buffer(audio_driver->fx_ports[k], nframes);
-            FLUID_MEMSET(audio_driver->fx_bufs[k], 0, nframes * sizeof(float));
-        }
+    if(mode != JackPlaybackLatency)
+    {
+        return;
+    }
 
-        res = callback(audio_driver->data,
-                        nframes,
-                        audio_driver->num_fx_ports * 2,
-                        audio_driver->fx_bufs,
-                        audio_driver->num_output_ports * 2,
-                        audio_driver->output_bufs);
-        if(res != FLUID_OK)
-        {
-            const char *cb_func_name = (audio_driver->callback != NULL) ? "Custom audio callback function" : "fluid_synth_process()";
-            FLUID_LOG(FLUID_PANIC, "%s returned an error. As a consequence, fluidsynth will now be removed from Jack's processing loop.", cb_func_name);
-        }
-        return res;
+    fluid_jack_driver_update_latency(client, fluid_atomic_pointer_get(&client->audio_driver));
+
+    for(i = 0; hosts != NULL && i < hosts->count; i++)
+    {
+        fluid_jack_driver_update_latency(client, hosts->drivers[i]);
     }
 }
 
 int
 fluid_jack_driver_bufsize(jack_nframes_t nframes, void *arg)
 {
-    /*   printf("the maximum buffer size is now %lu\n", nframes); */
+    /* A period that is not a multiple of the internal block size makes the synth
+       render a varying number of blocks per period, i.e. an uneven CPU load. */
+    if(nframes % FLUID_BUFSIZE != 0)
+    {
+        FLUID_LOG(FLUID_INFO, "Jack period size %lu is not a multiple of the synth block size %d,"
+                  " CPU load per period will vary (see the fluid-bufsize build option)",
+                  (unsigned long)nframes, FLUID_BUFSIZE);
+    }
+
     return 0;
 }
 
@@ -833,6 +1239,7 @@ new_fluid_jack_midi_driver(fluid_settings_t *settings,
                            handle_midi_event_func_t handler, void *data)
 {
     fluid_jack_midi_driver_t *dev;
+    int realtime_prio = 0;
 
     fluid_return_val_if_fail(handler != NULL, NULL);
 
@@ -859,8 +1266,25 @@ new_fluid_jack_midi_driver(fluid_settings_t *settings,
         goto error_recovery;
     }
 
+    dev->queue = new_fluid_ringbuffer(FLUID_JACK_MIDI_QUEUE_SIZE, sizeof(fluid_jack_midi_chunk_t));
+
+    if(dev->queue == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        goto error_recovery;
+    }
+
     fluid_settings_getint(settings, "midi.autoconnect", &dev->autoconnect_inputs);
     fluid_atomic_int_set(&dev->autoconnect_is_outdated, dev->autoconnect_inputs);
+    fluid_settings_getint(settings, "midi.realtime-prio", &realtime_prio);
+
+    fluid_atomic_int_set(&dev->status, FLUID_MIDI_LISTENING);
+    dev->thread = new_fluid_thread("jack-midi", fluid_jack_midi_run, dev, realtime_prio, FALSE);
+
+    if(!dev->thread)
+    {
+        goto error_recovery;
+    }
 
     dev->client_ref = new_fluid_jack_client(settings, FALSE, dev);
 
@@ -882,16 +1306,76 @@ delete_fluid_jack_midi_driver(fluid_midi_driver_t *p)
     fluid_jack_midi_driver_t *dev = (fluid_jack_midi_driver_t *)p;
     fluid_return_if_fail(dev != NULL);
 
+    /* no more process callbacks touch the queue after closing the client */
     if(dev->client_ref != NULL)
     {
         fluid_jack_client_close(dev->client_ref, dev);
     }
 
+    if(dev->thread)
+    {
+        fluid_atomic_int_set(&dev->status, FLUID_MIDI_DONE);
+        fluid_thread_join(dev->thread);
+        delete_fluid_thread(dev->thread);
+    }
+
+    if(dev->queue != NULL)
+    {
+        delete_fluid_ringbuffer(dev->queue);
+    }
+
     delete_fluid_midi_parser(dev->parser);
     FLUID_FREE(dev->midi_port);
     FLUID_FREE(dev);
 }
 
+/*
+ * MIDI thread: parses the bytes queued by the process callback and passes the
+ * resulting events on to the handler.
+ */
+static fluid_thread_return_t
+fluid_jack_midi_run(void *data)
+{
+    fluid_jack_midi_driver_t *dev = (fluid_jack_midi_driver_t *)data;
+    fluid_jack_midi_chunk_t *chunk;
+    fluid_midi_event_t *evt;
+    int u, dropped;
+
+    while(fluid_atomic_int_get(&dev->status) == FLUID_MIDI_LISTENING)
+    {
+        while((chunk = fluid_ringbuffer_get_outptr(dev->queue)) != NULL)
+        {
+            /* let the parser convert the data into events */
+            for(u = 0; u < chunk->size; u++)
+            {
+                evt = fluid_midi_parser_parse(dev->parser, chunk->data[u]);
+
+                /* send the event to the next link in the chain */
+                if(evt != NULL)
+                {
+                    fluid_midi_event_set_channel(evt, fluid_midi_event_get_channel(evt) + chunk->port * 16);
+                    evt->ingress = chunk->ingress;
+                    dev->driver.handler(dev->driver.data, evt);
+                }
+            }
+
+            fluid_ringbuffer_next_outptr(dev->queue);
+        }
+
+        dropped = fluid_atomic_int_get(&dev->dropped);
+
+        if(dropped > 0)
+        {
+            fluid_atomic_int_add(&dev->dropped, -dropped);
+            FLUID_LOG(FLUID_WARN, "Jack MIDI queue overflow, %d events lost", dropped);
+        }
+
+        fluid_msleep(FLUID_JACK_MIDI_POLL_MSEC);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
 int fluid_jack_obtain_synth(fluid_settings_t *settings, fluid_synth_t **synth)
 {
     void *data;
@@ -19,6 +19,8 @@
 
 #include "fluid_mdriver.h"
 #include "fluid_settings.h"
+#include "fluid_midi_router.h"
+#include "fluid_synth.h"
 
 
 /*
@@ -90,6 +92,14 @@ static const fluid_mdriver_definition_t fluid_midi_drivers[] =
         delete_fluid_coremidi_driver,
         fluid_coremidi_driver_settings
     },
+#endif
+#ifdef NETWORK_SUPPORT
+    {
+        "udp",
+        new_fluid_udp_midi_driver,
+        delete_fluid_udp_midi_driver,
+        fluid_udp_midi_driver_settings
+    },
 #endif
     /* NULL terminator to avoid zero size array if no driver available */
     { NULL, NULL, NULL, NULL }
@@ -102,6 +112,7 @@ void fluid_midi_driver_settings(fluid_settings_t *settings)
     const char *def_name = NULL;
 
     fluid_settings_register_int(settings, "midi.autoconnect", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "midi.batch-events", 0, 0, 1, FLUID_HINT_TOGGLED);
 
     fluid_settings_register_int(settings, "midi.realtime-prio",
                                 FLUID_DEFAULT_MIDI_RT_PRIO, 0, 99, 0);
@@ -193,3 +204,140 @@ void delete_fluid_midi_driver(fluid_midi_driver_t *driver)
     fluid_return_if_fail(driver != NULL);
     driver->define->free(driver);
 }
+
+/* The events of a burst, on their way to fluid_synth_queue_midi_events() */
+typedef struct
+{
+    fluid_synth_t *synth;
+    fluid_midi_event_t events[FLUID_MIDI_DRIVER_BATCH];
+    unsigned int offsets[FLUID_MIDI_DRIVER_BATCH];
+    int count;
+    int status;
+    unsigned int offset;    /* of the events being added */
+} fluid_midi_driver_batch_t;
+
+static void fluid_midi_driver_batch_flush(fluid_midi_driver_batch_t *batch)
+{
+    fluid_midi_event_t *events[FLUID_MIDI_DRIVER_BATCH];
+    int i;
+
+    if(batch->count == 0)
+    {
+        return;
+    }
+
+    for(i = 0; i < batch->count; i++)
+    {
+        events[i] = &batch->events[i];
+    }
+
+    if(fluid_synth_queue_midi_events(batch->synth, events, batch->offsets, batch->count) != FLUID_OK)
+    {
+        batch->status = FLUID_FAILED;
+    }
+
+    batch->count = 0;
+}
+
+/* A handle_midi_event_func_t collecting the events of a burst */
+static int fluid_midi_driver_batch_add(void *data, fluid_midi_event_t *event)
+{
+    fluid_midi_driver_batch_t *batch = data;
+
+    switch(event->type)
+    {
+    case NOTE_ON:
+    case NOTE_OFF:
+    case CONTROL_CHANGE:
+    case PROGRAM_CHANGE:
+    case CHANNEL_PRESSURE:
+    case KEY_PRESSURE:
+    case PITCH_BEND:
+    case MIDI_SYSTEM_RESET:
+    case MIDI_SYSEX:
+        if(batch->count == FLUID_MIDI_DRIVER_BATCH)
+        {
+            fluid_midi_driver_batch_flush(batch);
+        }
+
+        batch->events[batch->count] = *event;
+        batch->offsets[batch->count++] = batch->offset;
+        return FLUID_OK;
+
+    default:
+        /* can't be queued, keep the order with the events before */
+        fluid_midi_driver_batch_flush(batch);
+        return fluid_synth_handle_midi_event(batch->synth, event);
+    }
+}
+
+/*
+ * Passes the events a driver has read at once to its handler. With midi.batch-events,
+ * events for a synth, directly or through a MIDI router, are queued by
+ * fluid_synth_queue_midi_events(), which takes the API lock of the synth once for all
+ * of them. They take effect before the next block is rendered, like handled ones.
+ *
+ * The data of SYSEX events only has to stay valid until this returns.
+ */
+int fluid_midi_driver_handle_events(fluid_midi_driver_t *driver, fluid_midi_event_t *events, int count)
+{
+    return fluid_midi_driver_handle_events_at(driver, events, NULL, count);
+}
+
+/*
+ * Like fluid_midi_driver_handle_events(), queueing each event offsets[i] samples after
+ * the start of the next block, see fluid_synth_queue_midi_events(). The offsets are
+ * ignored when the events aren't queued, offsets may be NULL for none.
+ */
+int fluid_midi_driver_handle_events_at(fluid_midi_driver_t *driver, fluid_midi_event_t *events,
+                                       const unsigned int *offsets, int count)
+{
+    fluid_midi_driver_batch_t batch;
+    fluid_midi_router_t *router = NULL;
+    int i, ret, status = FLUID_OK;
+
+    batch.synth = NULL;
+    batch.count = 0;
+    batch.status = FLUID_OK;
+    batch.offset = 0;
+
+    if(driver->batch_events && driver->handler == fluid_synth_handle_midi_event)
+    {
+        batch.synth = driver->data;
+    }
+    else if(driver->batch_events && driver->handler == fluid_midi_router_handle_midi_event)
+    {
+        router = driver->data;
+        batch.synth = fluid_midi_router_get_synth(router);
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        if(offsets != NULL)
+        {
+            batch.offset = offsets[i];
+        }
+
+        if(batch.synth == NULL)
+        {
+            ret = (*driver->handler)(driver->data, &events[i]);
+        }
+        else if(router != NULL)
+        {
+            ret = fluid_midi_router_route_midi_event(router, &events[i], fluid_midi_driver_batch_add, &batch);
+        }
+        else
+        {
+            ret = fluid_midi_driver_batch_add(&batch, &events[i]);
+        }
+
+        if(ret != FLUID_OK)
+        {
+            status = FLUID_FAILED;
+        }
+    }
+
+    fluid_midi_driver_batch_flush(&batch);
+
+    return (status == FLUID_OK) ? batch.status : FLUID_FAILED;
+}
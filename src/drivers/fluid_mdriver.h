@@ -33,10 +33,18 @@ struct _fluid_midi_driver_t
     const fluid_mdriver_definition_t *define;
     handle_midi_event_func_t handler;
     void *data;
+    int batch_events;   /* queue the events read at once in the synth, see midi.batch-events */
 };
 
 void fluid_midi_driver_settings(fluid_settings_t *settings);
 
+/* The most events a driver converts before passing them to fluid_midi_driver_handle_events() */
+#define FLUID_MIDI_DRIVER_BATCH 64
+
+int fluid_midi_driver_handle_events(fluid_midi_driver_t *driver, fluid_midi_event_t *events, int count);
+int fluid_midi_driver_handle_events_at(fluid_midi_driver_t *driver, fluid_midi_event_t *events,
+                                       const unsigned int *offsets, int count);
+
 /* ALSA */
 #if ALSA_SUPPORT
 fluid_midi_driver_t *new_fluid_alsa_rawmidi_driver(fluid_settings_t *settings,
@@ -96,4 +104,13 @@ void delete_fluid_coremidi_driver(fluid_midi_driver_t *p);
 void fluid_coremidi_driver_settings(fluid_settings_t *settings);
 #endif
 
+/* UDP */
+#ifdef NETWORK_SUPPORT
+fluid_midi_driver_t *new_fluid_udp_midi_driver(fluid_settings_t *settings,
+        handle_midi_event_func_t handler,
+        void *event_handler_data);
+void delete_fluid_udp_midi_driver(fluid_midi_driver_t *p);
+void fluid_udp_midi_driver_settings(fluid_settings_t *settings);
+#endif
+
 #endif  /* _FLUID_MDRIVER_H */
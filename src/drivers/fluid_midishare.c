@@ -216,6 +216,7 @@ static void fluid_midishare_keyoff_task(long date, short ref, long a1, long a2,
     fluid_midi_event_t new_event;
     MidiEvPtr e = (MidiEvPtr)a1;
 
+    fluid_midi_event_stamp(&new_event);
     fluid_midi_event_set_type(&new_event, NOTE_OFF);
     fluid_midi_event_set_channel(&new_event, Chan(e));
     fluid_midi_event_set_pitch(&new_event, Pitch(e));
@@ -240,6 +241,8 @@ static void fluid_midishare_midi_driver_receive(short ref)
 
     while((e = MidiGetEv(ref)))
     {
+        fluid_midi_event_stamp(&new_event);
+
         switch(EvType(e))
         {
         case typeNote:
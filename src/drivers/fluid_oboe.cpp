@@ -33,6 +33,14 @@
 #include <sstream>
 #include <stdexcept>
 
+/* The performance hint API lets the CPU governor know about our render deadline.
+ * It's only available since Android 13, so it is compiled in only when targeting it. */
+#if defined(__ANDROID__) && __ANDROID_API__ >= 33
+#include <android/performance_hint.h>
+#include <unistd.h>
+#define FLUID_OBOE_PERFORMANCE_HINT 1
+#endif
+
 using namespace oboe;
 
 constexpr int NUM_CHANNELS = 2;
@@ -55,14 +63,62 @@ struct fluid_oboe_audio_driver_t
     std::shared_ptr<AudioStream> stream;
 
     double sample_rate;
+    int32_t xrun_count = 0;
     int is_sample_format_float;
     int device_id;
     int sharing_mode; // 0: Shared, 1: Exclusive
     int performance_mode; // 0: None, 1: PowerSaving, 2: LowLatency
     oboe::SampleRateConversionQuality srate_conversion_quality;
     int error_recovery_mode; // 0: Reconnect, 1: Stop
+    int buffer_tuning;
+    int performance_hint;
+
+    // grows the buffer by one burst whenever the stream underruns, only used in LowLatency mode
+    std::unique_ptr<LatencyTuner> latency_tuner;
+
+#if FLUID_OBOE_PERFORMANCE_HINT
+    APerformanceHintSession *hint_session = nullptr;
+    pid_t hint_tid = 0;
+    bool hint_failed = false;
+#endif
 };
 
+#if FLUID_OBOE_PERFORMANCE_HINT
+/* (Re)creates the hint session for the calling audio thread. The callback thread
+ * may change after a reconnect, hence the session is bound lazily from within the callback. */
+static void fluid_oboe_update_hint_session(fluid_oboe_audio_driver_t *dev, AudioStream *stream)
+{
+    pid_t tid = gettid();
+    APerformanceHintManager *manager;
+    int64_t target;
+
+    if(dev->hint_session != nullptr && dev->hint_tid == tid)
+    {
+        return;
+    }
+
+    if(dev->hint_session != nullptr)
+    {
+        APerformanceHint_closeSession(dev->hint_session);
+        dev->hint_session = nullptr;
+    }
+
+    manager = APerformanceHint_getManager();
+    // the deadline is one burst, i.e. the time until the device asks for the next callback
+    target = (int64_t)stream->getFramesPerBurst() * 1000000000 / stream->getSampleRate();
+
+    if(manager == nullptr || target <= 0
+            || (dev->hint_session = APerformanceHint_createSession(manager, &tid, 1, target)) == nullptr)
+    {
+        FLUID_LOG(FLUID_WARN, "oboe: performance hint session unavailable");
+        dev->hint_failed = true;
+        return;
+    }
+
+    dev->hint_tid = tid;
+}
+#endif
+
 
 class OboeAudioStreamCallback : public AudioStreamCallback
 {
@@ -76,12 +132,18 @@ public:
     DataCallbackResult onAudioReady(AudioStream *stream, void *audioData, int32_t numFrames)
     {
         fluid_oboe_audio_driver_t *dev = static_cast<fluid_oboe_audio_driver_t *>(this->user_data);
+        double start = fluid_utime();
 
         if(!dev->cont)
         {
             return DataCallbackResult::Stop;
         }
 
+        if(dev->latency_tuner)
+        {
+            dev->latency_tuner->tune();
+        }
+
         if(stream->getFormat() == AudioFormat::Float)
         {
             fluid_synth_write_float(dev->synth, numFrames, static_cast<float *>(audioData), 0, 2, static_cast<float *>(audioData), 1, 2);
@@ -91,6 +153,35 @@ public:
             fluid_synth_write_s16(dev->synth, numFrames, static_cast<short *>(audioData), 0, 2, static_cast<short *>(audioData), 1, 2);
         }
 
+        fluid_audio_driver_period_done(&dev->driver, start, numFrames, stream->getSampleRate());
+
+#if FLUID_OBOE_PERFORMANCE_HINT
+        if(dev->performance_hint && !dev->hint_failed)
+        {
+            fluid_oboe_update_hint_session(dev, stream);
+
+            if(dev->hint_session != nullptr)
+            {
+                APerformanceHint_reportActualWorkDuration(dev->hint_session,
+                        (int64_t)((fluid_utime() - start) * 1000.0));
+            }
+        }
+#endif
+
+        ResultWithValue<int32_t> xruns = stream->getXRunCount();
+
+        for(; xruns && dev->xrun_count < xruns.value(); dev->xrun_count++)
+        {
+            fluid_audio_driver_xrun(&dev->driver);
+        }
+
+        ResultWithValue<double> latency = stream->calculateLatencyMillis();
+
+        if(latency)
+        {
+            fluid_audio_driver_set_latency(&dev->driver, latency.value() * 1000.0);
+        }
+
         return DataCallbackResult::Continue;
     }
 
@@ -113,6 +204,8 @@ constexpr char SHARING_MODE[] = "audio.oboe.sharing-mode";
 constexpr char PERF_MODE[] = "audio.oboe.performance-mode";
 constexpr char SRCQ_SET[] = "audio.oboe.sample-rate-conversion-quality";
 constexpr char RECOVERY_MODE[] = "audio.oboe.error-recovery-mode";
+constexpr char BUFFER_TUNING[] = "audio.oboe.buffer-tuning";
+constexpr char PERF_HINT[] = "audio.oboe.performance-hint";
 
 void fluid_oboe_audio_driver_settings(fluid_settings_t *settings)
 {
@@ -122,7 +215,7 @@ void fluid_oboe_audio_driver_settings(fluid_settings_t *settings)
     fluid_settings_add_option(settings,   SHARING_MODE, "Shared");
     fluid_settings_add_option(settings,   SHARING_MODE, "Exclusive");
 
-    fluid_settings_register_str(settings, PERF_MODE, "None", 0);
+    fluid_settings_register_str(settings, PERF_MODE, "LowLatency", 0);
     fluid_settings_add_option(settings,   PERF_MODE, "None");
     fluid_settings_add_option(settings,   PERF_MODE, "PowerSaving");
     fluid_settings_add_option(settings,   PERF_MODE, "LowLatency");
@@ -138,6 +231,9 @@ void fluid_oboe_audio_driver_settings(fluid_settings_t *settings)
     fluid_settings_register_str(settings, RECOVERY_MODE, "Reconnect", 0);
     fluid_settings_add_option(settings, RECOVERY_MODE, "Reconnect");
     fluid_settings_add_option(settings, RECOVERY_MODE, "Stop");
+
+    fluid_settings_register_int(settings, BUFFER_TUNING, 1, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, PERF_HINT, 1, 0, 1, FLUID_HINT_TOGGLED);
 }
 
 static oboe::SampleRateConversionQuality get_srate_conversion_quality(fluid_settings_t *settings)
@@ -184,6 +280,7 @@ Result
 fluid_oboe_connect_or_reconnect(fluid_oboe_audio_driver_t *dev)
 {
     AudioStreamBuilder builder;
+    Result result;
     builder.setDeviceId(dev->device_id)
     ->setDirection(Direction::Output)
     ->setChannelCount(NUM_CHANNELS)
@@ -199,7 +296,41 @@ fluid_oboe_connect_or_reconnect(fluid_oboe_audio_driver_t *dev)
     ->setErrorCallback(dev->oboe_error_callback.get())
     ->setSampleRateConversionQuality(dev->srate_conversion_quality);
 
-    return builder.openStream(dev->stream);
+    if(dev->performance_mode == 2)
+    {
+        // Render exactly one burst per callback, as long as the application told Oboe
+        // the native burst size (192 is Oboe's built-in guess, not a device value).
+        // Otherwise leave it to the device, which in LowLatency mode calls back once
+        // per burst anyway, without a block adapter in between.
+        if(DefaultStreamValues::FramesPerBurst > 0 && DefaultStreamValues::FramesPerBurst != 192)
+        {
+            builder.setFramesPerCallback(DefaultStreamValues::FramesPerBurst);
+        }
+    }
+
+    dev->latency_tuner.reset();
+
+    result = builder.openStream(dev->stream);
+
+    if(result != Result::OK)
+    {
+        return result;
+    }
+
+    FLUID_LOG(FLUID_DBG, "oboe: %s stream, %s mode, burst %d frames, buffer %d of %d frames",
+              dev->stream->getSharingMode() == SharingMode::Exclusive ? "exclusive" : "shared",
+              dev->stream->getPerformanceMode() == PerformanceMode::LowLatency ? "low latency" : "default",
+              dev->stream->getFramesPerBurst(),
+              dev->stream->getBufferSizeInFrames(),
+              dev->stream->getBufferCapacityInFrames());
+
+    if(dev->buffer_tuning && dev->stream->getPerformanceMode() == PerformanceMode::LowLatency)
+    {
+        // start from the smallest buffer and let the tuner grow it on xruns
+        dev->latency_tuner = std::make_unique<LatencyTuner>(*dev->stream);
+    }
+
+    return result;
 }
 
 /*
@@ -229,6 +360,8 @@ new_fluid_oboe_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
             fluid_settings_str_equal(settings, PERF_MODE, "LowLatency") ? 2 : 0;
         dev->srate_conversion_quality = get_srate_conversion_quality(settings);
         dev->error_recovery_mode = fluid_settings_str_equal(settings, RECOVERY_MODE, "Stop") ? 1 : 0;
+        fluid_settings_getint(settings, BUFFER_TUNING, &dev->buffer_tuning);
+        fluid_settings_getint(settings, PERF_HINT, &dev->performance_hint);
 
         result = fluid_oboe_connect_or_reconnect(dev);
 
@@ -291,6 +424,13 @@ void delete_fluid_oboe_audio_driver(fluid_audio_driver_t *p)
         FLUID_LOG(FLUID_ERR, "Exception caught while stopping and closing Oboe stream.");
     }
 
+#if FLUID_OBOE_PERFORMANCE_HINT
+    if(dev->hint_session != nullptr)
+    {
+        APerformanceHint_closeSession(dev->hint_session);
+    }
+#endif
+
     delete dev;
 }
 
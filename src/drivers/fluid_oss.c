@@ -81,6 +81,8 @@ typedef struct
     fluid_audio_func_t callback;
     void *data;
     float *buffers[2];
+    int cpus[FLUID_MAX_CPU_AFFINITY]; /* CPUs to pin the audio thread to, see audio.cpu-affinity */
+    int cpu_count;
 } fluid_oss_audio_driver_t;
 
 
@@ -139,6 +141,8 @@ new_fluid_oss_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
     fluid_settings_getint(settings, "audio.period-size", &period_size);
     fluid_settings_getnum(settings, "synth.sample-rate", &sample_rate);
     fluid_settings_getint(settings, "audio.realtime-prio", &realtime_prio);
+    dev->cpu_count = fluid_settings_get_cpu_list(settings, "audio.cpu-affinity", dev->cpus,
+                     FLUID_N_ELEMENTS(dev->cpus));
 
     dev->dspfd = -1;
     dev->synth = synth;
@@ -312,6 +316,8 @@ new_fluid_oss_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t func,
     fluid_settings_getint(settings, "audio.period-size", &period_size);
     fluid_settings_getnum(settings, "synth.sample-rate", &sample_rate);
     fluid_settings_getint(settings, "audio.realtime-prio", &realtime_prio);
+    dev->cpu_count = fluid_settings_get_cpu_list(settings, "audio.cpu-affinity", dev->cpus,
+                     FLUID_N_ELEMENTS(dev->cpus));
 
     dev->dspfd = -1;
     dev->synth = NULL;
@@ -535,6 +541,11 @@ fluid_oss_audio_run(void *d)
     void *buffer = dev->buffer;
     int len = dev->buffer_size;
 
+    if(dev->cpu_count > 0)
+    {
+        fluid_thread_self_set_affinity(dev->cpus, dev->cpu_count);
+    }
+
     /* it's as simple as that: */
     while(dev->cont)
     {
@@ -569,6 +580,11 @@ fluid_oss_audio_run2(void *d)
 
     FLUID_LOG(FLUID_DBG, "Audio thread running");
 
+    if(dev->cpu_count > 0)
+    {
+        fluid_thread_self_set_affinity(dev->cpus, dev->cpu_count);
+    }
+
     /* it's as simple as that: */
     while(dev->cont)
     {
@@ -33,9 +33,10 @@
 #include <pipewire/pipewire.h>
 #include <spa/param/audio/format-utils.h>
 
-/* At the moment, only stereo is supported */
+/* At the moment, only stereo is supported. The stream uses planar 32 bit float,
+ * one data plane per channel, so the synth renders straight into the buffers. */
 #define NUM_CHANNELS 2
-static const int stride = sizeof(float) * NUM_CHANNELS;
+static const int stride = sizeof(float);
 
 typedef struct
 {
@@ -43,11 +44,12 @@ typedef struct
     fluid_audio_func_t user_callback;
     void *data;
 
-    /* Used only with the user-provided callback */
-    float *lbuf, *rbuf;
+    /* synth whose sample rate follows the one negotiated, NULL if not known */
+    fluid_synth_t *synth;
+    uint32_t sample_rate;
 
+    /* frames to render if the buffer doesn't tell the current quantum */
     int buffer_period;
-    struct spa_pod_builder *builder;
 
     struct pw_thread_loop *pw_loop;
     struct pw_stream *pw_stream;
@@ -56,13 +58,66 @@ typedef struct
 } fluid_pipewire_audio_driver_t;
 
 
-/* Fast-path rendering routine with no user processing callbacks */
+/*
+ * Number of frames to render into the given buffer: the quantum requested by
+ * the graph, limited to what the data planes can hold.
+ */
+static int fluid_pipewire_get_frames(fluid_pipewire_audio_driver_t *drv, struct pw_buffer *pwb)
+{
+    struct spa_buffer *buf = pwb->buffer;
+    uint32_t frames = drv->buffer_period;
+    uint32_t i, max_frames;
+
+#if PW_CHECK_VERSION(0, 3, 49)
+    if(pwb->requested > 0)
+    {
+        frames = (uint32_t)pwb->requested;
+    }
+#endif
+
+    for(i = 0; i < NUM_CHANNELS; i++)
+    {
+        max_frames = buf->datas[i].maxsize / stride;
+
+        if(frames > max_frames)
+        {
+            frames = max_frames;
+        }
+    }
+
+    return (int)frames;
+}
+
+/* Updates the latency of the telemetry from the delay until the data is played */
+static void fluid_pipewire_update_latency(fluid_pipewire_audio_driver_t *drv)
+{
+    struct pw_time time;
+
+#if PW_CHECK_VERSION(0, 3, 50)
+    if(pw_stream_get_time_n(drv->pw_stream, &time, sizeof(time)) < 0)
+#else
+    if(pw_stream_get_time(drv->pw_stream, &time) < 0)
+#endif
+    {
+        return;
+    }
+
+    if(time.rate.denom > 0)
+    {
+        fluid_audio_driver_set_latency(&drv->driver,
+                                       time.delay * 1000000.0 * time.rate.num / time.rate.denom);
+    }
+}
+
+/* Renders one quantum straight into the data planes of the next buffer */
 static void fluid_pipewire_event_process(void *data)
 {
     fluid_pipewire_audio_driver_t *drv = data;
     struct pw_buffer *pwb;
     struct spa_buffer *buf;
-    float *dest;
+    float *channels[NUM_CHANNELS];
+    double start = fluid_utime();
+    int i, frames;
 
     pwb = pw_stream_dequeue_buffer(drv->pw_stream);
 
@@ -73,64 +128,94 @@ static void fluid_pipewire_event_process(void *data)
     }
 
     buf = pwb->buffer;
-    dest = buf->datas[0].data;
 
-    if(!dest)
+    if(buf->n_datas < NUM_CHANNELS)
     {
+        pw_stream_queue_buffer(drv->pw_stream, pwb);
         return;
     }
 
-    fluid_synth_write_float(drv->data, drv->buffer_period, dest, 0, 2, dest, 1, 2);
-    buf->datas[0].chunk->offset = 0;
-    buf->datas[0].chunk->stride = stride;
-    buf->datas[0].chunk->size = drv->buffer_period * stride;
+    for(i = 0; i < NUM_CHANNELS; i++)
+    {
+        channels[i] = buf->datas[i].data;
+
+        if(!channels[i])
+        {
+            pw_stream_queue_buffer(drv->pw_stream, pwb);
+            return;
+        }
+    }
+
+    frames = fluid_pipewire_get_frames(drv, pwb);
+
+    if(drv->user_callback)
+    {
+        for(i = 0; i < NUM_CHANNELS; i++)
+        {
+            FLUID_MEMSET(channels[i], 0, frames * sizeof(float));
+        }
+
+        (*drv->user_callback)(drv->data, frames, 0, NULL, NUM_CHANNELS, channels);
+    }
+    else
+    {
+        fluid_synth_write_float(drv->data, frames, channels[0], 0, 1, channels[1], 0, 1);
+    }
+
+    for(i = 0; i < NUM_CHANNELS; i++)
+    {
+        buf->datas[i].chunk->offset = 0;
+        buf->datas[i].chunk->stride = stride;
+        buf->datas[i].chunk->size = frames * stride;
+    }
 
     pw_stream_queue_buffer(drv->pw_stream, pwb);
+
+    fluid_audio_driver_period_done(&drv->driver, start, frames, drv->sample_rate);
+    fluid_pipewire_update_latency(drv);
 }
 
-/* Rendering routine with support for user-defined audio manipulation */
-static void fluid_pipewire_event_process2(void *data)
+/*
+ * Called on the loop thread when the format has been negotiated. The stream
+ * doesn't process buffers while its format changes, so the synth can follow the
+ * sample rate of the graph here, without touching the rendering thread.
+ */
+static void fluid_pipewire_event_param_changed(void *data, uint32_t id, const struct spa_pod *param)
 {
     fluid_pipewire_audio_driver_t *drv = data;
-    struct pw_buffer *pwb;
-    struct spa_buffer *buf;
-    float *dest;
-    float *channels[NUM_CHANNELS] = { drv->lbuf, drv->rbuf };
-    int i;
-
-    pwb = pw_stream_dequeue_buffer(drv->pw_stream);
+    struct spa_audio_info_raw info;
 
-    if(!pwb)
+    if(param == NULL || id != SPA_PARAM_Format)
     {
-        FLUID_LOG(FLUID_WARN, "No buffers!");
         return;
     }
 
-    buf = pwb->buffer;
-    dest = buf->datas[0].data;
+    FLUID_MEMSET(&info, 0, sizeof(info));
 
-    if(!dest)
+    if(spa_format_audio_raw_parse(param, &info) < 0 || info.rate == 0 || info.rate == drv->sample_rate)
     {
         return;
     }
 
-    FLUID_MEMSET(drv->lbuf, 0, drv->buffer_period * sizeof(float));
-    FLUID_MEMSET(drv->rbuf, 0, drv->buffer_period * sizeof(float));
+    if(drv->synth != NULL)
+    {
+        FLUID_LOG(FLUID_INFO, "PipeWire sample rate changed from %u to %u, adjusting the synth",
+                  drv->sample_rate, info.rate);
+        fluid_synth_set_sample_rate_immediately(drv->synth, (float)info.rate);
+    }
 
-    (*drv->user_callback)(drv->data, drv->buffer_period, 0, NULL, NUM_CHANNELS, channels);
+    drv->sample_rate = info.rate;
+}
 
-    /* Interleave the floating point data */
-    for(i = 0; i < drv->buffer_period; i++)
+/* The synth rendered by a user callback can be found through the settings, as for JACK */
+static fluid_synth_t *fluid_pipewire_obtain_synth(fluid_settings_t *settings)
+{
+    if(!fluid_settings_is_realtime(settings, "synth.gain"))
     {
-        dest[i * 2] = drv->lbuf[i];
-        dest[i * 2 + 1] = drv->rbuf[i];
+        return NULL;
     }
 
-    buf->datas[0].chunk->offset = 0;
-    buf->datas[0].chunk->stride = stride;
-    buf->datas[0].chunk->size = drv->buffer_period * stride;
-
-    pw_stream_queue_buffer(drv->pw_stream, pwb);
+    return fluid_settings_get_user_data(settings, "synth.gain");
 }
 
 fluid_audio_driver_t *new_fluid_pipewire_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
@@ -143,7 +228,6 @@ new_fluid_pipewire_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t
 {
     fluid_pipewire_audio_driver_t *drv;
     int period_size;
-    int buffer_length;
     int res;
     int pw_flags;
     int realtime_prio = 0;
@@ -151,7 +235,9 @@ new_fluid_pipewire_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t
     char *media_role = NULL;
     char *media_type = NULL;
     char *media_category = NULL;
-    float *buffer = NULL;
+    uint8_t buffer[1024];
+    struct spa_pod_builder builder = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+    struct spa_audio_info_raw info;
     const struct spa_pod *params[1];
     struct pw_properties *props;
 
@@ -174,6 +260,8 @@ new_fluid_pipewire_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t
 
     drv->data = data;
     drv->user_callback = func;
+    drv->synth = func ? fluid_pipewire_obtain_synth(settings) : (fluid_synth_t *)data;
+    drv->sample_rate = (uint32_t)sample_rate;
     drv->buffer_period = period_size;
 
     drv->events = FLUID_NEW(struct pw_stream_events);
@@ -186,7 +274,8 @@ new_fluid_pipewire_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t
 
     FLUID_MEMSET(drv->events, 0, sizeof(*drv->events));
     drv->events->version = PW_VERSION_STREAM_EVENTS;
-    drv->events->process = func ? fluid_pipewire_event_process2 : fluid_pipewire_event_process;
+    drv->events->process = fluid_pipewire_event_process;
+    drv->events->param_changed = fluid_pipewire_event_param_changed;
 
     drv->pw_loop = pw_thread_loop_new("fluid_pipewire", NULL);
 
@@ -199,7 +288,12 @@ new_fluid_pipewire_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t
     props = pw_properties_new(PW_KEY_MEDIA_TYPE, media_type, PW_KEY_MEDIA_CATEGORY, media_category, PW_KEY_MEDIA_ROLE, media_role, NULL);
 
     pw_properties_setf(props, PW_KEY_NODE_LATENCY, "%d/%d", period_size, (int) sample_rate);
-    pw_properties_setf(props, PW_KEY_NODE_RATE, "1/%d", (int) sample_rate);
+
+    /* without a synth to adjust, ask the graph for our rate, or else let it convert */
+    if(drv->synth == NULL)
+    {
+        pw_properties_setf(props, PW_KEY_NODE_RATE, "1/%d", (int) sample_rate);
+    }
 
     drv->pw_stream = pw_stream_new_simple(
                          pw_thread_loop_get_loop(drv->pw_loop),
@@ -214,45 +308,15 @@ new_fluid_pipewire_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t
         goto driver_cleanup;
     }
 
-    buffer = FLUID_ARRAY(float, NUM_CHANNELS * period_size);
+    /* a synth follows the rate of the graph, leave it open so that no resampling is needed */
+    FLUID_MEMSET(&info, 0, sizeof(info));
+    info.format = SPA_AUDIO_FORMAT_F32P;
+    info.channels = NUM_CHANNELS;
+    info.rate = (drv->synth != NULL) ? 0 : (uint32_t)sample_rate;
+    info.position[0] = SPA_AUDIO_CHANNEL_FL;
+    info.position[1] = SPA_AUDIO_CHANNEL_FR;
 
-    if(!buffer)
-    {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        goto driver_cleanup;
-    }
-
-    buffer_length = period_size * sizeof(float) * NUM_CHANNELS;
-
-    drv->builder = FLUID_NEW(struct spa_pod_builder);
-
-    if(!drv->builder)
-    {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        goto driver_cleanup;
-    }
-
-    FLUID_MEMSET(drv->builder, 0, sizeof(*drv->builder));
-    drv->builder->data = buffer;
-    drv->builder->size = buffer_length;
-
-    if(func)
-    {
-        drv->lbuf = FLUID_ARRAY(float, period_size);
-        drv->rbuf = FLUID_ARRAY(float, period_size);
-
-        if(!drv->lbuf || !drv->rbuf)
-        {
-            FLUID_LOG(FLUID_ERR, "Out of memory");
-            goto driver_cleanup;
-        }
-    }
-
-    params[0] = spa_format_audio_raw_build(drv->builder,
-                                           SPA_PARAM_EnumFormat,
-                                           &SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32,
-                                                   .channels = 2,
-                                                   .rate = sample_rate));
+    params[0] = spa_format_audio_raw_build(&builder, SPA_PARAM_EnumFormat, &info);
 
     pw_flags = PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS;
     pw_flags |= realtime_prio ? PW_STREAM_FLAG_RT_PROCESS : 0;
@@ -310,16 +374,6 @@ void delete_fluid_pipewire_audio_driver(fluid_audio_driver_t *p)
         pw_thread_loop_destroy(drv->pw_loop);
     }
 
-    FLUID_FREE(drv->lbuf);
-    FLUID_FREE(drv->rbuf);
-
-    if(drv->builder)
-    {
-        FLUID_FREE(drv->builder->data);
-    }
-
-    FLUID_FREE(drv->builder);
-
     FLUID_FREE(drv->events);
 
     FLUID_FREE(drv);
@@ -120,21 +120,18 @@ static int fluid_portaudio_get_device_name(int device_num, char **name_ptr)
     }
 }
 
-/**
- * Initializes "audio.portaudio.device" setting with an options list of unique device names
- * of available sound card devices.
- * @param settings pointer to settings.
+/*
+ * Adds the unique device names of the available sound card devices to the options of
+ * "audio.portaudio.device", once they are asked for: initializing PortAudio probes all
+ * of its host APIs, e.g. connects to a JACK server.
  */
-void
-fluid_portaudio_driver_settings(fluid_settings_t *settings)
+static void
+fluid_portaudio_device_options(fluid_settings_t *settings, const char *setting)
 {
     int numDevices;
     PaError err;
     int i;
 
-    fluid_settings_register_str(settings, "audio.portaudio.device", PORTAUDIO_DEFAULT_DEVICE, 0);
-    fluid_settings_add_option(settings, "audio.portaudio.device", PORTAUDIO_DEFAULT_DEVICE);
-
     err = Pa_Initialize();
 
     if(err != paNoError)
@@ -162,7 +159,7 @@ fluid_portaudio_driver_settings(fluid_settings_t *settings)
                 if(name)
                 {
                     /* registers this name in the option list */
-                    fluid_settings_add_option(settings, "audio.portaudio.device", name);
+                    fluid_settings_add_option(settings, setting, name);
                     FLUID_FREE(name);
                 }
                 else
@@ -183,6 +180,19 @@ fluid_portaudio_driver_settings(fluid_settings_t *settings)
     }
 }
 
+/**
+ * Initializes "audio.portaudio.device" setting with an options list of unique device names
+ * of available sound card devices.
+ * @param settings pointer to settings.
+ */
+void
+fluid_portaudio_driver_settings(fluid_settings_t *settings)
+{
+    fluid_settings_register_str(settings, "audio.portaudio.device", PORTAUDIO_DEFAULT_DEVICE, 0);
+    fluid_settings_add_option(settings, "audio.portaudio.device", PORTAUDIO_DEFAULT_DEVICE);
+    fluid_settings_lazy_options(settings, "audio.portaudio.device", fluid_portaudio_device_options);
+}
+
 /**
  * Creates the portaudio driver and opens the portaudio device
  * indicated by audio.portaudio.device setting.
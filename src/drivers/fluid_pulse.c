@@ -31,6 +31,9 @@
 
 #include <pulse/simple.h>
 #include <pulse/error.h>
+#include <pulse/thread-mainloop.h>
+#include <pulse/context.h>
+#include <pulse/stream.h>
 
 /** fluid_pulse_audio_driver_t
  *
@@ -44,17 +47,34 @@ typedef struct
     fluid_audio_func_t callback;
     void *data;
     int buffer_size;
+    double sample_rate;
     fluid_thread_t *thread;
     int cont;
 
     float *left;
     float *right;
     float *buf;
+    int cpus[FLUID_MAX_CPU_AFFINITY]; /* CPUs to pin the audio thread to, see audio.cpu-affinity */
+    int cpu_count;
+
+    /* audio.pulseaudio.async: the stream is fed from the write callback */
+    pa_threaded_mainloop *mainloop;
+    pa_context *context;
+    pa_stream *stream;
+    int realtime_prio;
+    int callback_started;   /* TRUE once the mainloop thread has been set up for rendering */
 } fluid_pulse_audio_driver_t;
 
 
 static fluid_thread_return_t fluid_pulse_audio_run(void *d);
 static fluid_thread_return_t fluid_pulse_audio_run2(void *d);
+static int fluid_pulse_audio_connect_async(fluid_pulse_audio_driver_t *dev,
+        const char *server, const char *device,
+        const pa_sample_spec *samplespec, const pa_buffer_attr *bufattr,
+        int adjust_latency);
+
+/* Periods between latency queries, each one is a round trip to the server */
+#define FLUID_PULSE_LATENCY_PERIODS 64
 
 
 void fluid_pulse_audio_driver_settings(fluid_settings_t *settings)
@@ -64,6 +84,10 @@ void fluid_pulse_audio_driver_settings(fluid_settings_t *settings)
     fluid_settings_register_str(settings, "audio.pulseaudio.media-role", "music", 0);
     fluid_settings_register_int(settings, "audio.pulseaudio.adjust-latency", 1, 0, 1,
                                 FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "audio.pulseaudio.async", 0, 0, 1,
+                                FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "audio.pulseaudio.tlength", 0, 0, 65536, 0);
+    fluid_settings_register_int(settings, "audio.pulseaudio.minreq", 0, 0, 65536, 0);
 }
 
 
@@ -83,14 +107,12 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
     pa_buffer_attr bufattr;
     double sample_rate;
     int period_size, period_bytes, adjust_latency, periods;
+    int async, tlength, minreq;
     char *server = NULL;
     char *device = NULL;
     char *media_role = NULL;
     int realtime_prio = 0;
     int err = 0;
-    float *left = NULL,
-           *right = NULL,
-            *buf = NULL;
 
     dev = FLUID_NEW(fluid_pulse_audio_driver_t);
 
@@ -105,11 +127,17 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
     fluid_settings_getint(settings, "audio.periods", &periods);
     fluid_settings_getint(settings, "audio.period-size", &period_size);
     fluid_settings_getnum(settings, "synth.sample-rate", &sample_rate);
+    dev->sample_rate = sample_rate;
     fluid_settings_dupstr(settings, "audio.pulseaudio.server", &server);  /* ++ alloc server string */
     fluid_settings_dupstr(settings, "audio.pulseaudio.device", &device);  /* ++ alloc device string */
     fluid_settings_dupstr(settings, "audio.pulseaudio.media-role", &media_role);  /* ++ alloc media-role string */
     fluid_settings_getint(settings, "audio.realtime-prio", &realtime_prio);
+    dev->cpu_count = fluid_settings_get_cpu_list(settings, "audio.cpu-affinity", dev->cpus,
+                     FLUID_N_ELEMENTS(dev->cpus));
     fluid_settings_getint(settings, "audio.pulseaudio.adjust-latency", &adjust_latency);
+    fluid_settings_getint(settings, "audio.pulseaudio.async", &async);
+    fluid_settings_getint(settings, "audio.pulseaudio.tlength", &tlength);
+    fluid_settings_getint(settings, "audio.pulseaudio.minreq", &minreq);
 
     if(media_role != NULL)
     {
@@ -137,6 +165,7 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
     dev->callback = func;
     dev->cont = 1;
     dev->buffer_size = period_size;
+    dev->realtime_prio = realtime_prio;
 
     samplespec.format = PA_SAMPLE_FLOAT32NE;
     samplespec.channels = 2;
@@ -144,11 +173,45 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
 
     period_bytes = period_size * sizeof(float) * 2;
     bufattr.maxlength = adjust_latency ? -1 : period_bytes * periods;
-    bufattr.tlength = period_bytes;
-    bufattr.minreq = -1;
+    bufattr.tlength = (tlength ? tlength : period_size) * sizeof(float) * 2;
+    bufattr.minreq = minreq ? minreq * sizeof(float) * 2 : (uint32_t) -1;
     bufattr.prebuf = -1;    /* Just initialize to same value as tlength */
     bufattr.fragsize = -1;  /* Not used */
 
+    if(bufattr.maxlength != (uint32_t) -1 && bufattr.maxlength < bufattr.tlength)
+    {
+        bufattr.maxlength = bufattr.tlength;
+    }
+
+    /* Allocated before connecting, the write callback of an async stream may render right away */
+    if(func != NULL)
+    {
+        dev->left = FLUID_ARRAY(float, period_size);
+        dev->right = FLUID_ARRAY(float, period_size);
+
+        if(dev->left == NULL || dev->right == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory.");
+            goto error_recovery;
+        }
+    }
+
+    if(async)
+    {
+        if(fluid_pulse_audio_connect_async(dev, server, device, &samplespec, &bufattr,
+                                           adjust_latency) != FLUID_OK)
+        {
+            goto error_recovery;
+        }
+
+        FLUID_LOG(FLUID_INFO, "Using PulseAudio driver (async)");
+
+        FLUID_FREE(server);    /* -- free server string */
+        FLUID_FREE(device);    /* -- free device string */
+
+        return (fluid_audio_driver_t *) dev;
+    }
+
     dev->pa_handle = pa_simple_new(server, "FluidSynth", PA_STREAM_PLAYBACK,
                                    device, "FluidSynth output", &samplespec,
                                    NULL, /* pa_channel_map */
@@ -163,30 +226,14 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
 
     FLUID_LOG(FLUID_INFO, "Using PulseAudio driver");
 
-    if(func != NULL)
-    {
-        left = FLUID_ARRAY(float, period_size);
-        right = FLUID_ARRAY(float, period_size);
-
-        if(left == NULL || right == NULL)
-        {
-            FLUID_LOG(FLUID_ERR, "Out of memory.");
-            goto error_recovery;
-        }
-    }
-
-    buf = FLUID_ARRAY(float, period_size * 2);
+    dev->buf = FLUID_ARRAY(float, period_size * 2);
 
-    if(buf == NULL)
+    if(dev->buf == NULL)
     {
         FLUID_LOG(FLUID_ERR, "Out of memory.");
         goto error_recovery;
     }
 
-    dev->left = left;
-    dev->right = right;
-    dev->buf = buf;
-
     /* Create the audio thread */
     dev->thread = new_fluid_thread("pulse-audio", func ? fluid_pulse_audio_run2 : fluid_pulse_audio_run,
                                    dev, realtime_prio, FALSE);
@@ -204,9 +251,6 @@ new_fluid_pulse_audio_driver2(fluid_settings_t *settings,
 error_recovery:
     FLUID_FREE(server);    /* -- free server string */
     FLUID_FREE(device);    /* -- free device string */
-    FLUID_FREE(left);
-    FLUID_FREE(right);
-    FLUID_FREE(buf);
 
     delete_fluid_pulse_audio_driver((fluid_audio_driver_t *) dev);
     return NULL;
@@ -230,6 +274,29 @@ void delete_fluid_pulse_audio_driver(fluid_audio_driver_t *p)
         pa_simple_free(dev->pa_handle);
     }
 
+    /* Stopping the mainloop first, no callback may run while the stream goes away */
+    if(dev->mainloop)
+    {
+        pa_threaded_mainloop_stop(dev->mainloop);
+    }
+
+    if(dev->stream)
+    {
+        pa_stream_disconnect(dev->stream);
+        pa_stream_unref(dev->stream);
+    }
+
+    if(dev->context)
+    {
+        pa_context_disconnect(dev->context);
+        pa_context_unref(dev->context);
+    }
+
+    if(dev->mainloop)
+    {
+        pa_threaded_mainloop_free(dev->mainloop);
+    }
+
     FLUID_FREE(dev->left);
     FLUID_FREE(dev->right);
     FLUID_FREE(dev->buf);
@@ -237,6 +304,40 @@ void delete_fluid_pulse_audio_driver(fluid_audio_driver_t *p)
     FLUID_FREE(dev);
 }
 
+/* Updates the latency of the telemetry every FLUID_PULSE_LATENCY_PERIODS periods */
+static void
+fluid_pulse_update_latency(fluid_pulse_audio_driver_t *dev)
+{
+    pa_usec_t pa_latency;
+    int negative;
+    int err = 0;
+
+    if(fluid_atomic_int_get(&dev->driver.telemetry.periods) % FLUID_PULSE_LATENCY_PERIODS != 0)
+    {
+        return;
+    }
+
+    if(dev->stream)
+    {
+        /* interpolated from the timing info, doesn't need a round trip */
+        err = pa_stream_get_latency(dev->stream, &pa_latency, &negative);
+
+        if(negative)
+        {
+            pa_latency = 0;
+        }
+    }
+    else
+    {
+        pa_latency = pa_simple_get_latency(dev->pa_handle, &err);
+    }
+
+    if(err == PA_OK)
+    {
+        fluid_audio_driver_set_latency(&dev->driver, (double)pa_latency);
+    }
+}
+
 /* Thread without audio callback, more efficient */
 static fluid_thread_return_t
 fluid_pulse_audio_run(void *d)
@@ -245,10 +346,18 @@ fluid_pulse_audio_run(void *d)
     float *buf = dev->buf;
     int buffer_size = dev->buffer_size;
     int err = 0;
+    double start;
+
+    if(dev->cpu_count > 0)
+    {
+        fluid_thread_self_set_affinity(dev->cpus, dev->cpu_count);
+    }
 
     while(dev->cont)
     {
+        start = fluid_utime();
         fluid_synth_write_float(dev->data, buffer_size, buf, 0, 2, buf, 1, 2);
+        fluid_audio_driver_period_done(&dev->driver, start, buffer_size, dev->sample_rate);
 
         if(pa_simple_write(dev->pa_handle, buf,
                            buffer_size * sizeof(float) * 2, &err) < 0)
@@ -257,16 +366,7 @@ fluid_pulse_audio_run(void *d)
             break;
         }
 
-#if 0
-        {
-            pa_usec_t pa_latency = pa_simple_get_latency(dev->pa_handle, &err);
-
-            if(err == PA_OK)
-            {
-                FLUID_LOG(FLUID_DBG, "PulseAudio latency: %d ms", (int) pa_latency / 1000);
-            }
-        }
-#endif
+        fluid_pulse_update_latency(dev);
     }	/* while (dev->cont) */
 
     return FLUID_THREAD_RETURN_VALUE;
@@ -284,15 +384,22 @@ fluid_pulse_audio_run2(void *d)
     int buffer_size = dev->buffer_size;
     int err = 0;
     int i;
+    double start;
 
     handle[0] = left;
     handle[1] = right;
 
+    if(dev->cpu_count > 0)
+    {
+        fluid_thread_self_set_affinity(dev->cpus, dev->cpu_count);
+    }
+
     while(dev->cont)
     {
         FLUID_MEMSET(left, 0, buffer_size * sizeof(float));
         FLUID_MEMSET(right, 0, buffer_size * sizeof(float));
 
+        start = fluid_utime();
         (*dev->callback)(synth, buffer_size, 0, NULL, 2, handle);
 
         /* Interleave the floating point data */
@@ -302,6 +409,8 @@ fluid_pulse_audio_run2(void *d)
             buf[i * 2 + 1] = right[i];
         }
 
+        fluid_audio_driver_period_done(&dev->driver, start, buffer_size, dev->sample_rate);
+
         if(pa_simple_write(dev->pa_handle, buf,
                            buffer_size * sizeof(float) * 2, &err) < 0)
         {
@@ -309,19 +418,216 @@ fluid_pulse_audio_run2(void *d)
             break;
         }
 
-#if 0
+        fluid_pulse_update_latency(dev);
+    }	/* while (dev->cont) */
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/* Renders frames into the interleaved buf */
+static void
+fluid_pulse_audio_render(fluid_pulse_audio_driver_t *dev, float *buf, int frames)
+{
+    float *handle[2];
+    int i, n;
+
+    if(dev->callback == NULL)
+    {
+        fluid_synth_write_float(dev->data, frames, buf, 0, 2, buf, 1, 2);
+        return;
+    }
+
+    handle[0] = dev->left;
+    handle[1] = dev->right;
+
+    /* the callback renders at most one period at a time */
+    for(; frames > 0; frames -= n, buf += n * 2)
+    {
+        n = (frames < dev->buffer_size) ? frames : dev->buffer_size;
+
+        FLUID_MEMSET(dev->left, 0, n * sizeof(float));
+        FLUID_MEMSET(dev->right, 0, n * sizeof(float));
+
+        (*dev->callback)(dev->data, n, 0, NULL, 2, handle);
+
+        /* Interleave the floating point data */
+        for(i = 0; i < n; i++)
+        {
+            buf[i * 2] = dev->left[i];
+            buf[i * 2 + 1] = dev->right[i];
+        }
+    }
+}
+
+/* Called by the mainloop thread whenever the server requests nbytes of audio. They are
+ * rendered straight into the memory of the stream, without an intermediate buffer. */
+static void
+fluid_pulse_audio_stream_write(pa_stream *stream, size_t nbytes, void *userdata)
+{
+    fluid_pulse_audio_driver_t *dev = userdata;
+    const size_t frame_bytes = sizeof(float) * 2;
+    size_t len;
+    void *data;
+    double start;
+    int frames;
+
+    if(!dev->callback_started)
+    {
+        /* the mainloop thread takes the place of the audio thread */
+        dev->callback_started = TRUE;
+        fluid_thread_self_set_prio(dev->realtime_prio);
+
+        if(dev->cpu_count > 0)
         {
-            pa_usec_t pa_latency = pa_simple_get_latency(dev->pa_handle, &err);
+            fluid_thread_self_set_affinity(dev->cpus, dev->cpu_count);
+        }
+    }
 
-            if(err == PA_OK)
-            {
-                FLUID_LOG(FLUID_DBG, "PulseAudio latency: %d ms", (int) pa_latency / 1000);
-            }
+    while(nbytes >= frame_bytes)
+    {
+        len = nbytes;
+
+        if(pa_stream_begin_write(stream, &data, &len) < 0 || data == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Error writing to PulseAudio stream: %s",
+                      pa_strerror(pa_context_errno(dev->context)));
+            return;
         }
-#endif
-    }	/* while (dev->cont) */
 
-    return FLUID_THREAD_RETURN_VALUE;
+        /* the memory handed out may be bigger than requested */
+        len = ((len < nbytes) ? len : nbytes) / frame_bytes * frame_bytes;
+
+        if(len == 0)
+        {
+            pa_stream_cancel_write(stream);
+            return;
+        }
+
+        frames = (int)(len / frame_bytes);
+
+        start = fluid_utime();
+        fluid_pulse_audio_render(dev, data, frames);
+        fluid_audio_driver_period_done(&dev->driver, start, frames, dev->sample_rate);
+
+        if(pa_stream_write(stream, data, len, NULL, 0, PA_SEEK_RELATIVE) < 0)
+        {
+            FLUID_LOG(FLUID_ERR, "Error writing to PulseAudio stream: %s",
+                      pa_strerror(pa_context_errno(dev->context)));
+            return;
+        }
+
+        nbytes -= len;
+        fluid_pulse_update_latency(dev);
+    }
+}
+
+static void
+fluid_pulse_audio_context_state(pa_context *context, void *userdata)
+{
+    fluid_pulse_audio_driver_t *dev = userdata;
+    pa_threaded_mainloop_signal(dev->mainloop, 0);
+}
+
+static void
+fluid_pulse_audio_stream_state(pa_stream *stream, void *userdata)
+{
+    fluid_pulse_audio_driver_t *dev = userdata;
+    pa_threaded_mainloop_signal(dev->mainloop, 0);
+}
+
+/* Connects a playback stream driven by a threaded mainloop, see audio.pulseaudio.async */
+static int
+fluid_pulse_audio_connect_async(fluid_pulse_audio_driver_t *dev,
+                                const char *server, const char *device,
+                                const pa_sample_spec *samplespec, const pa_buffer_attr *bufattr,
+                                int adjust_latency)
+{
+    pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE;
+    pa_context_state_t context_state;
+    pa_stream_state_t stream_state;
+
+    if(adjust_latency)
+    {
+        flags |= PA_STREAM_ADJUST_LATENCY;
+    }
+
+    dev->mainloop = pa_threaded_mainloop_new();
+
+    if(dev->mainloop == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the PulseAudio mainloop");
+        return FLUID_FAILED;
+    }
+
+    dev->context = pa_context_new(pa_threaded_mainloop_get_api(dev->mainloop), "FluidSynth");
+
+    if(dev->context == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the PulseAudio context");
+        return FLUID_FAILED;
+    }
+
+    pa_context_set_state_callback(dev->context, fluid_pulse_audio_context_state, dev);
+
+    if(pa_context_connect(dev->context, server, PA_CONTEXT_NOFLAGS, NULL) < 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to connect to the PulseAudio server: %s",
+                  pa_strerror(pa_context_errno(dev->context)));
+        return FLUID_FAILED;
+    }
+
+    pa_threaded_mainloop_lock(dev->mainloop);
+
+    if(pa_threaded_mainloop_start(dev->mainloop) < 0)
+    {
+        pa_threaded_mainloop_unlock(dev->mainloop);
+        FLUID_LOG(FLUID_ERR, "Failed to start the PulseAudio mainloop");
+        return FLUID_FAILED;
+    }
+
+    while((context_state = pa_context_get_state(dev->context)) != PA_CONTEXT_READY)
+    {
+        if(!PA_CONTEXT_IS_GOOD(context_state))
+        {
+            goto error_recovery;
+        }
+
+        pa_threaded_mainloop_wait(dev->mainloop);
+    }
+
+    dev->stream = pa_stream_new(dev->context, "FluidSynth output", samplespec, NULL);
+
+    if(dev->stream == NULL)
+    {
+        goto error_recovery;
+    }
+
+    pa_stream_set_state_callback(dev->stream, fluid_pulse_audio_stream_state, dev);
+    pa_stream_set_write_callback(dev->stream, fluid_pulse_audio_stream_write, dev);
+
+    if(pa_stream_connect_playback(dev->stream, device, bufattr, flags, NULL, NULL) < 0)
+    {
+        goto error_recovery;
+    }
+
+    while((stream_state = pa_stream_get_state(dev->stream)) != PA_STREAM_READY)
+    {
+        if(!PA_STREAM_IS_GOOD(stream_state))
+        {
+            goto error_recovery;
+        }
+
+        pa_threaded_mainloop_wait(dev->mainloop);
+    }
+
+    pa_threaded_mainloop_unlock(dev->mainloop);
+    return FLUID_OK;
+
+error_recovery:
+    FLUID_LOG(FLUID_ERR, "Failed to create the PulseAudio stream: %s",
+              pa_strerror(pa_context_errno(dev->context)));
+    pa_threaded_mainloop_unlock(dev->mainloop);
+    return FLUID_FAILED;
 }
 
 #endif /* PULSE_SUPPORT */
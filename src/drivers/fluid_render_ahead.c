@@ -0,0 +1,212 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_render_ahead.h"
+#include "fluid_adriver.h"
+#include "fluid_sys.h"
+
+static fluid_thread_return_t fluid_render_ahead_run(void *data);
+
+/*
+ * Renders blocks into the ring until it has no room for another one.
+ * Returns the number of frames rendered.
+ */
+static int
+fluid_render_ahead_fill(fluid_render_ahead_t *ahead)
+{
+    fluid_ringbuffer_t *ring = ahead->ring;
+    float *buf;
+    int n, total = 0;
+
+    while(fluid_ringbuffer_get_space(ring) >= ahead->block)
+    {
+        /* a block wrapping around the end of the ring is rendered in two pieces */
+        n = ring->totalcount - ring->in;
+
+        if(n > ahead->block)
+        {
+            n = ahead->block;
+        }
+
+        buf = fluid_ringbuffer_get_inptr_at(ring, 0);
+        fluid_synth_write_float(ahead->synth, n, buf, 0, 2, buf, 1, 2);
+        fluid_ringbuffer_next_inptr(ring, n);
+        total += n;
+    }
+
+    return total;
+}
+
+/*
+ * The thread rendering ahead. The audio callback doesn't take any lock, so it doesn't wake
+ * the thread either: the thread polls for room once per block.
+ */
+static fluid_thread_return_t
+fluid_render_ahead_run(void *data)
+{
+    fluid_render_ahead_t *ahead = data;
+
+    while(fluid_atomic_int_get(&ahead->cont))
+    {
+        fluid_render_ahead_fill(ahead);
+        fluid_msleep(ahead->sleep_msec);
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/*
+ * Creates the ring of the given number of frames, rounded up to whole blocks, renders it
+ * full and starts the thread keeping it full. The thread isn't a realtime thread.
+ */
+fluid_render_ahead_t *
+new_fluid_render_ahead(fluid_synth_t *synth, int frames, int block, double sample_rate)
+{
+    fluid_render_ahead_t *ahead;
+
+    fluid_return_val_if_fail(synth != NULL, NULL);
+    fluid_return_val_if_fail(block > 0, NULL);
+
+    ahead = FLUID_NEW(fluid_render_ahead_t);
+
+    if(ahead == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(ahead, 0, sizeof(*ahead));
+
+    /* at least two blocks, the driver takes from one while the next one is rendered */
+    frames = (frames < 2 * block) ? 2 * block : (frames + block - 1) / block * block;
+
+    ahead->synth = synth;
+    ahead->block = block;
+    ahead->sleep_msec = (int)(block * 1000.0 / sample_rate);
+
+    if(ahead->sleep_msec < 1)
+    {
+        ahead->sleep_msec = 1;
+    }
+
+    ahead->ring = new_fluid_ringbuffer(frames, 2 * sizeof(float));
+
+    if(ahead->ring == NULL)
+    {
+        goto error_recovery;
+    }
+
+    fluid_render_ahead_fill(ahead);
+
+    fluid_atomic_int_set(&ahead->cont, TRUE);
+    ahead->thread = new_fluid_thread("render-ahead", fluid_render_ahead_run, ahead, 0, FALSE);
+
+    if(ahead->thread == NULL)
+    {
+        goto error_recovery;
+    }
+
+    return ahead;
+
+error_recovery:
+    delete_fluid_render_ahead(ahead);
+    return NULL;
+}
+
+/*
+ * Stops the thread and frees the ring. The driver must not call fluid_render_ahead_process()
+ * anymore.
+ */
+void
+delete_fluid_render_ahead(fluid_render_ahead_t *ahead)
+{
+    fluid_return_if_fail(ahead != NULL);
+
+    if(ahead->thread != NULL)
+    {
+        fluid_atomic_int_set(&ahead->cont, FALSE);
+        fluid_thread_join(ahead->thread);
+        delete_fluid_thread(ahead->thread);
+    }
+
+    if(ahead->ring != NULL)
+    {
+        delete_fluid_ringbuffer(ahead->ring);
+    }
+
+    FLUID_FREE(ahead);
+}
+
+/* Sets the driver whose telemetry counts the periods the ring couldn't fill */
+void
+fluid_render_ahead_set_driver(fluid_render_ahead_t *ahead, fluid_audio_driver_t *driver)
+{
+    fluid_atomic_pointer_set(&ahead->driver, driver);
+}
+
+/*
+ * The fluid_audio_func_t of the driver: copies len frames from the ring to the first two
+ * output buffers. An underrun is filled with silence and counted as an xrun of the driver.
+ * Further output buffers are left as they are, the ring holds a stereo mix.
+ */
+int
+fluid_render_ahead_process(void *data, int len, int nfx, float *fx[], int nout, float *out[])
+{
+    fluid_render_ahead_t *ahead = data;
+    fluid_audio_driver_t *driver;
+    float *frames;
+    int i, n, done = 0;
+
+    if(nout < 2)
+    {
+        return FLUID_FAILED;
+    }
+
+    while(done < len && (n = fluid_ringbuffer_get_outptrs(ahead->ring, (void **)&frames)) > 0)
+    {
+        if(n > len - done)
+        {
+            n = len - done;
+        }
+
+        for(i = 0; i < n; i++)
+        {
+            out[0][done + i] = frames[2 * i];
+            out[1][done + i] = frames[2 * i + 1];
+        }
+
+        fluid_ringbuffer_next_outptrs(ahead->ring, n);
+        done += n;
+    }
+
+    if(done < len)
+    {
+        FLUID_MEMSET(out[0] + done, 0, (len - done) * sizeof(float));
+        FLUID_MEMSET(out[1] + done, 0, (len - done) * sizeof(float));
+
+        driver = fluid_atomic_pointer_get(&ahead->driver);
+
+        if(driver != NULL)
+        {
+            fluid_audio_driver_xrun(driver);
+        }
+    }
+
+    return FLUID_OK;
+}
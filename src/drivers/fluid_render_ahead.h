@@ -0,0 +1,55 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLUID_RENDER_AHEAD_H
+#define _FLUID_RENDER_AHEAD_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_ringbuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Renders a synth ahead of an audio driver, see audio.render-ahead: a thread keeps a ring of
+ * stereo frames full, the audio callback fluid_render_ahead_process() only copies from it.
+ */
+typedef struct _fluid_render_ahead_t
+{
+    fluid_synth_t *synth;
+    fluid_ringbuffer_t *ring;       /* interleaved stereo frames, the thread is the producer */
+    int block;                      /* frames rendered at a time */
+    int sleep_msec;                 /* time the thread waits for the driver to make room */
+    fluid_thread_t *thread;
+    fluid_atomic_int_t cont;        /* the thread runs while TRUE */
+    fluid_audio_driver_t *driver;   /* Atomic: driver the underruns are counted for */
+} fluid_render_ahead_t;
+
+fluid_render_ahead_t *new_fluid_render_ahead(fluid_synth_t *synth, int frames, int block,
+        double sample_rate);
+void delete_fluid_render_ahead(fluid_render_ahead_t *ahead);
+void fluid_render_ahead_set_driver(fluid_render_ahead_t *ahead, fluid_audio_driver_t *driver);
+int fluid_render_ahead_process(void *data, int len, int nfx, float *fx[], int nout, float *out[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_RENDER_AHEAD_H */
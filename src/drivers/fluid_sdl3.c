@@ -188,16 +188,15 @@ SDLAudioCallback(void *data, SDL_AudioStream *stream, int add_len, int len)
     }
 }
 
-void fluid_sdl3_audio_driver_settings(fluid_settings_t *settings)
+/* Adds the playback devices to the options of "audio.sdl3.device" once they are asked for,
+ * which also leaves the application the time to initialize SDL3 */
+static void fluid_sdl3_device_options(fluid_settings_t *settings, const char *name)
 {
     int n = 0, j = 0, nDevs = 0;
     SDL_Mutex *AudioDeviceLock = SDL_CreateMutex();
     AudioDeviceList *list = NULL;
     SDL_AudioDeviceID *devices = NULL;
 
-    fluid_settings_register_str(settings, "audio.sdl3.device", "default", 0);
-    fluid_settings_add_option(settings, "audio.sdl3.device", "default");
-
     if(!SDL_WasInit(SDL_INIT_AUDIO))
     {
         FLUID_LOG(FLUID_WARN, "SDL3 not initialized, SDL3 audio driver won't be usable. Have you called SDL_Init(SDL_INIT_AUDIO) ?");
@@ -286,6 +285,13 @@ void fluid_sdl3_audio_driver_settings(fluid_settings_t *settings)
     SDL_free(AudioDeviceLock);
 }
 
+void fluid_sdl3_audio_driver_settings(fluid_settings_t *settings)
+{
+    fluid_settings_register_str(settings, "audio.sdl3.device", "default", 0);
+    fluid_settings_add_option(settings, "audio.sdl3.device", "default");
+    fluid_settings_lazy_options(settings, "audio.sdl3.device", fluid_sdl3_device_options);
+}
+
 
 /*
  * new_fluid_sdl3_audio_driver
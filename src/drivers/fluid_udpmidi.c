@@ -0,0 +1,291 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+/* fluid_udpmidi.c
+ *
+ * MIDI driver receiving timestamped MIDI events over UDP
+ *
+ * Each datagram holds a timestamp of its sender followed by the events it sends, all
+ * numbers in network byte order:
+ *
+ *   datagram: uint32 time    in microseconds, of the clock of the sender, may wrap around
+ *             followed by any number of events of 8 bytes each
+ *   event:    uint32 offset  in microseconds, relative to the time of the datagram
+ *             uint8  status  MIDI status byte of a channel message, or 0xFF (system reset)
+ *             uint8  data1   first MIDI data byte
+ *             uint8  data2   second MIDI data byte, 0 if the message has only one
+ *             uint8  port    MIDI port, the event goes to channel port * 16 + (status & 0x0F)
+ *
+ * The events are played with the timing the sender gave them, delayed by the transit time
+ * of the fastest datagram of the sender and midi.udp.latency. Datagrams arriving within
+ * that latency have their events queued to the synth at the sample they are due at, which
+ * absorbs the jitter of the network. The events of late datagrams are played right away.
+ */
+
+#include "fluid_mdriver.h"
+#include "fluid_midi.h"
+#include "fluid_settings.h"
+
+#ifdef NETWORK_SUPPORT
+
+#define FLUID_UDP_MIDI_HEADER_SIZE      4
+#define FLUID_UDP_MIDI_EVENT_SIZE       8
+
+/* Number of senders whose clocks are followed, the one heard from least recently makes
+ * room for a new one */
+#define FLUID_UDP_MIDI_MAX_SENDERS      16
+
+/* Largest address of a sender told apart, sizeof(struct sockaddr_in6) */
+#define FLUID_UDP_MIDI_MAX_ADDR         28
+
+/* Time in microseconds after which the fastest transit time of a sender is measured
+ * anew, to follow the drift between its clock and ours */
+#define FLUID_UDP_MIDI_DRIFT_WINDOW     2000000.0
+
+/* The furthest in microseconds an event is scheduled ahead, beyond the latency */
+#define FLUID_UDP_MIDI_MAX_AHEAD        1000000.0
+
+typedef struct
+{
+    unsigned char addr[FLUID_UDP_MIDI_MAX_ADDR];
+    int addr_len;           /* 0 for an unused slot */
+    double last_heard;      /* our time of the last datagram received */
+
+    unsigned int last_time; /* the time of the last datagram, as sent */
+    double time;            /* the same, unwrapped */
+
+    double transit;         /* the fastest transit time, our time minus the time sent */
+    double window_transit;  /* the fastest transit time since window_start */
+    double window_start;
+} fluid_udp_midi_sender_t;
+
+typedef struct
+{
+    fluid_midi_driver_t driver;
+    fluid_udp_server_socket_t *socket;
+    double sample_rate;
+    double latency;         /* in microseconds */
+    fluid_udp_midi_sender_t senders[FLUID_UDP_MIDI_MAX_SENDERS];
+
+    /* only used by the thread of the socket */
+    fluid_midi_event_t events[FLUID_MIDI_DRIVER_BATCH];
+    unsigned int offsets[FLUID_MIDI_DRIVER_BATCH];
+} fluid_udp_midi_driver_t;
+
+
+void fluid_udp_midi_driver_settings(fluid_settings_t *settings)
+{
+    fluid_settings_register_int(settings, "midi.udp.port", 5004, 1, 65535, 0);
+    fluid_settings_register_int(settings, "midi.udp.latency", 10, 0, 1000, 0);
+}
+
+static unsigned int fluid_udp_midi_get_uint32(const unsigned char *buf)
+{
+    return ((unsigned int)buf[0] << 24) | ((unsigned int)buf[1] << 16)
+           | ((unsigned int)buf[2] << 8) | buf[3];
+}
+
+/* Returns the state of the sender of a datagram, taking over a slot for a new sender */
+static fluid_udp_midi_sender_t *
+fluid_udp_midi_get_sender(fluid_udp_midi_driver_t *dev, const void *addr, int addr_len,
+                          unsigned int time, double now)
+{
+    fluid_udp_midi_sender_t *sender, *oldest = &dev->senders[0];
+    int i;
+
+    if(addr_len > FLUID_UDP_MIDI_MAX_ADDR)
+    {
+        addr_len = FLUID_UDP_MIDI_MAX_ADDR;
+    }
+
+    for(i = 0; i < FLUID_UDP_MIDI_MAX_SENDERS; i++)
+    {
+        sender = &dev->senders[i];
+
+        if(sender->addr_len == addr_len && memcmp(sender->addr, addr, addr_len) == 0)
+        {
+            /* the difference of the 32 bit times is correct across a wrap around */
+            sender->time += (int)(time - sender->last_time);
+            sender->last_time = time;
+            sender->last_heard = now;
+            return sender;
+        }
+
+        if(sender->addr_len == 0 || sender->last_heard < oldest->last_heard)
+        {
+            oldest = sender;
+        }
+    }
+
+    sender = oldest;
+    FLUID_MEMCPY(sender->addr, addr, addr_len);
+    sender->addr_len = addr_len;
+    sender->last_heard = now;
+    sender->last_time = time;
+    sender->time = time;
+    sender->transit = now - sender->time;
+    sender->window_transit = sender->transit;
+    sender->window_start = now;
+
+    return sender;
+}
+
+/*
+ * Receive function of the socket. Converts the events of a datagram and passes them to
+ * the handler of the driver, a batch at a time, each one with the offset in samples it is
+ * due at.
+ */
+static void
+fluid_udp_midi_receive(void *data, const unsigned char *buf, int len, const void *addr, int addr_len)
+{
+    fluid_udp_midi_driver_t *dev = (fluid_udp_midi_driver_t *) data;
+    fluid_udp_midi_sender_t *sender;
+    double now, transit, delay;
+    int pos, count = 0;
+
+    if(len < FLUID_UDP_MIDI_HEADER_SIZE || (len - FLUID_UDP_MIDI_HEADER_SIZE) % FLUID_UDP_MIDI_EVENT_SIZE != 0)
+    {
+        FLUID_LOG(FLUID_WARN, "Ignoring UDP MIDI datagram of invalid size %d", len);
+        return;
+    }
+
+    now = fluid_utime();
+    sender = fluid_udp_midi_get_sender(dev, addr, addr_len, fluid_udp_midi_get_uint32(buf), now);
+
+    /* the fastest datagram tells the offset between the clocks, plus the least transit time */
+    transit = now - sender->time;
+
+    if(transit < sender->transit)
+    {
+        sender->transit = transit;
+    }
+
+    if(transit < sender->window_transit)
+    {
+        sender->window_transit = transit;
+    }
+
+    if(now - sender->window_start >= FLUID_UDP_MIDI_DRIFT_WINDOW)
+    {
+        sender->transit = sender->window_transit;
+        sender->window_transit = transit;
+        sender->window_start = now;
+    }
+
+    for(pos = FLUID_UDP_MIDI_HEADER_SIZE; pos < len; pos += FLUID_UDP_MIDI_EVENT_SIZE)
+    {
+        if(fluid_midi_event_unpack(&dev->events[count], &buf[pos + 4]) != FLUID_OK)
+        {
+            FLUID_LOG(FLUID_WARN, "Ignoring event with unsupported status byte 0x%02X", buf[pos + 4]);
+            continue;
+        }
+
+        fluid_midi_event_stamp(&dev->events[count]);
+        delay = sender->time + fluid_udp_midi_get_uint32(&buf[pos]) + sender->transit + dev->latency - now;
+
+        if(delay < 0)
+        {
+            delay = 0;
+        }
+        else if(delay > dev->latency + FLUID_UDP_MIDI_MAX_AHEAD)
+        {
+            delay = dev->latency + FLUID_UDP_MIDI_MAX_AHEAD;
+        }
+
+        dev->offsets[count] = (unsigned int)(delay * dev->sample_rate / 1000000.0 + 0.5);
+
+        if(++count == FLUID_MIDI_DRIVER_BATCH)
+        {
+            fluid_midi_driver_handle_events_at(&dev->driver, dev->events, dev->offsets, count);
+            count = 0;
+        }
+    }
+
+    if(count > 0)
+    {
+        fluid_midi_driver_handle_events_at(&dev->driver, dev->events, dev->offsets, count);
+    }
+}
+
+/*
+ * new_fluid_udp_midi_driver
+ */
+fluid_midi_driver_t *
+new_fluid_udp_midi_driver(fluid_settings_t *settings,
+                          handle_midi_event_func_t handler, void *data)
+{
+    fluid_udp_midi_driver_t *dev;
+    int port, latency, realtime_prio = 0;
+
+    /* not much use doing anything */
+    if(handler == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Invalid argument");
+        return NULL;
+    }
+
+    dev = FLUID_NEW(fluid_udp_midi_driver_t);
+
+    if(dev == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(dev, 0, sizeof(fluid_udp_midi_driver_t));
+
+    dev->driver.handler = handler;
+    dev->driver.data = data;
+
+    /* the events of a datagram are only played at their time when queued */
+    dev->driver.batch_events = TRUE;
+
+    fluid_settings_getint(settings, "midi.udp.port", &port);
+    fluid_settings_getint(settings, "midi.udp.latency", &latency);
+    fluid_settings_getnum(settings, "synth.sample-rate", &dev->sample_rate);
+    fluid_settings_getint(settings, "midi.realtime-prio", &realtime_prio);
+    dev->latency = latency * 1000.0;
+
+    dev->socket = new_fluid_udp_server_socket(port, fluid_udp_midi_receive, dev, realtime_prio);
+
+    if(dev->socket == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to open the UDP MIDI port %d", port);
+        FLUID_FREE(dev);
+        return NULL;
+    }
+
+    return (fluid_midi_driver_t *) dev;
+}
+
+/*
+ * delete_fluid_udp_midi_driver
+ */
+void
+delete_fluid_udp_midi_driver(fluid_midi_driver_t *p)
+{
+    fluid_udp_midi_driver_t *dev = (fluid_udp_midi_driver_t *) p;
+    fluid_return_if_fail(dev != NULL);
+
+    delete_fluid_udp_server_socket(dev->socket);
+    FLUID_FREE(dev);
+}
+
+#endif /* NETWORK_SUPPORT */
@@ -41,6 +41,7 @@
 #include <oaidl.h>
 #include <ksguid.h>
 #include <ksmedia.h>
+#include <avrt.h>
 
 // these symbols are either never found in headers, or
 // only defined but there are no library containing the actual symbol...
@@ -84,11 +85,14 @@ static const IID   _IID_IAudioRenderClient =
  *    to use the default Windows audio device for media playback.
  *
  * Notes:
+ *  - The stream is event driven: the render thread sleeps until the device
+ *    signals that a buffer is free, and it is registered with MMCSS as a
+ *    "Pro Audio" task.
  *  - If exclusive mode is selected, audio.period-size is used as the periodicity
  *    of the IAudioClient stream, which is the sole factor of audio latency.
- *    audio.periods still determines the buffer size, but has no direct impact on
- *    the latency (at least according to Microsoft). The valid range for
- *    audio.period-size may vary depending on the driver and sample rate.
+ *    Periods shorter than the minimum period of the device are raised to that
+ *    minimum, so a very small audio.period-size runs the device as fast as it
+ *    allows. The device double-buffers one period, so audio.periods is ignored.
  *  - In shared mode, audio.period-size is completely ignored. Instead, a value
  *    provided by the audio driver is used. In theory this means the latency in
  *    shared mode is out of fluidsynth's control, but you may still increase
@@ -130,14 +134,6 @@ typedef struct
     wchar_t *id;
 } fluid_wasapi_finddev_data_t;
 
-typedef enum
-{
-    FLUID_WASAPI_FMT_FLOAT = 0,
-    FLUID_WASAPI_FMT_S16,
-    FLUID_WASAPI_FMT_S24, /* 24-bit PCM in 32-bit container */
-    FLUID_WASAPI_FMT_S32
-} fluid_wasapi_outfmt_t;
-
 typedef struct
 {
     fluid_audio_driver_t driver;
@@ -150,9 +146,10 @@ typedef struct
     UINT32 nframes;
     double buffer_duration;
     int channels_count;
-    fluid_wasapi_outfmt_t outfmt;
+    enum fluid_sample_format outfmt;
 
     HANDLE start_ev;
+    HANDLE buffer_ev;
     HANDLE thread;
     DWORD thread_id;
     HANDLE quit_ev;
@@ -222,26 +219,26 @@ fluid_audio_driver_t *new_fluid_wasapi_audio_driver2(fluid_settings_t *settings,
     /* Parse requested sample format (strict for now) */
     if (fluid_settings_str_equal(settings, "audio.sample-format", "float"))
     {
-        dev->outfmt = FLUID_WASAPI_FMT_FLOAT;
+        dev->outfmt = FLUID_SAMPLE_FORMAT_FLOAT;
         dev->sample_size = sizeof(float);
         dev->sample_format = WAVE_FORMAT_IEEE_FLOAT;
     }
     else if (fluid_settings_str_equal(settings, "audio.sample-format", "16bits"))
     {
-        dev->outfmt = FLUID_WASAPI_FMT_S16;
+        dev->outfmt = FLUID_SAMPLE_FORMAT_S16;
         dev->sample_size = sizeof(int16_t);
         dev->sample_format = WAVE_FORMAT_PCM;
     }
     else if (fluid_settings_str_equal(settings, "audio.sample-format", "24bits"))
     {
         /* 24-bit PCM, left-aligned in 32-bit container */
-        dev->outfmt = FLUID_WASAPI_FMT_S24;
+        dev->outfmt = FLUID_SAMPLE_FORMAT_S24;
         dev->sample_size = sizeof(int32_t);
         dev->sample_format = WAVE_FORMAT_EXTENSIBLE;
     }
     else if (fluid_settings_str_equal(settings, "audio.sample-format", "32bits"))
     {
-        dev->outfmt = FLUID_WASAPI_FMT_S32;
+        dev->outfmt = FLUID_SAMPLE_FORMAT_S32;
         dev->sample_size = sizeof(int32_t);
         dev->sample_format = WAVE_FORMAT_PCM;
     }
@@ -280,6 +277,14 @@ fluid_audio_driver_t *new_fluid_wasapi_audio_driver2(fluid_settings_t *settings,
         goto cleanup;
     }
 
+    dev->buffer_ev = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    if(dev->buffer_ev == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "wasapi: failed to create buffer event: '%s'", fluid_get_windows_error());
+        goto cleanup;
+    }
+
     dev->thread = CreateThread(NULL, 0, fluid_wasapi_audio_run, dev, 0, &dev->thread_id);
 
     if(dev->thread == NULL)
@@ -342,6 +347,11 @@ void delete_fluid_wasapi_audio_driver(fluid_audio_driver_t *p)
         CloseHandle(dev->start_ev);
     }
 
+    if(dev->buffer_ev != NULL)
+    {
+        CloseHandle(dev->buffer_ev);
+    }
+
     if(dev->drybuf)
     {
         for(i = 0; i < dev->channels_count; ++i)
@@ -357,18 +367,27 @@ void delete_fluid_wasapi_audio_driver(fluid_audio_driver_t *p)
     FLUID_FREE(dev);
 }
 
+/* enumerating the devices initializes COM and MMDevice, only done once the options are asked for */
+static void fluid_wasapi_device_options(fluid_settings_t *settings, const char *name)
+{
+    fluid_wasapi_foreach_device(fluid_wasapi_register_callback, settings);
+}
+
 void fluid_wasapi_audio_driver_settings(fluid_settings_t *settings)
 {
     fluid_settings_register_int(settings, "audio.wasapi.exclusive-mode", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_str(settings, "audio.wasapi.device", "default", 0);
     fluid_settings_add_option(settings, "audio.wasapi.device", "default");
-    fluid_wasapi_foreach_device(fluid_wasapi_register_callback, settings);
+    fluid_settings_lazy_options(settings, "audio.wasapi.device", fluid_wasapi_device_options);
 }
 
 static DWORD WINAPI fluid_wasapi_audio_run(void *p)
 {
     fluid_wasapi_audio_driver_t *dev = (fluid_wasapi_audio_driver_t *)p;
     DWORD time_to_sleep;
+    HANDLE wait_handles[2];
+    HANDLE mmcss = NULL;
+    DWORD mmcss_task = 0;
     UINT32 pos;
     DWORD len;
     void *channels_out[2];
@@ -378,13 +397,15 @@ static DWORD WINAPI fluid_wasapi_audio_run(void *p)
     HRESULT ret;
     IMMDeviceEnumerator *denum = NULL;
     IMMDevice *mmdev = NULL;
-    DWORD flags = 0;
+    DWORD flags = AUDCLNT_STREAMFLAGS_EVENTCALLBACK;
     WAVEFORMATEXTENSIBLE wfx;
     WAVEFORMATEXTENSIBLE *rwfx = NULL;
     AUDCLNT_SHAREMODE share_mode;
     OSVERSIONINFOEXW vi = { sizeof(vi), 6, 0, 0, 0, { 0 }, 0, 0, 0, 0, 0 };
     int needs_com_uninit = FALSE;
     int aucl_started = 0;
+    int primed = FALSE;
+    double start;
     int i;
 
     /* Clear format structure */
@@ -393,7 +414,7 @@ static DWORD WINAPI fluid_wasapi_audio_run(void *p)
     wfx.Format.nChannels = 2;
     wfx.Format.nSamplesPerSec = (DWORD)dev->sample_rate;
 
-    if (dev->outfmt == FLUID_WASAPI_FMT_S24)
+    if (dev->outfmt == FLUID_SAMPLE_FORMAT_S24)
     {
         /* 24-bit PCM in 32-bit container (EXTENSIBLE) */
         wfx.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
@@ -458,8 +479,19 @@ static DWORD WINAPI fluid_wasapi_audio_run(void *p)
 
     if(dev->exclusive)
     {
+        fluid_long_long_t minp;
         share_mode = AUDCLNT_SHAREMODE_EXCLUSIVE;
         FLUID_LOG(FLUID_DBG, "wasapi: using exclusive mode.");
+
+        if(SUCCEEDED(IAudioClient_GetDevicePeriod(dev->aucl, NULL, &minp)) && dev->periods_reftime < minp)
+        {
+            FLUID_LOG(FLUID_DBG, "wasapi: raising period to the device minimum of %d frames.",
+                      (int)(minp / 1e7 * dev->sample_rate));
+            dev->periods_reftime = minp;
+        }
+
+        /* event driven exclusive streams require the buffer to be exactly one period */
+        dev->buffer_duration_reftime = dev->periods_reftime;
     }
     else
     {
@@ -520,7 +552,7 @@ static DWORD WINAPI fluid_wasapi_audio_run(void *p)
 
             if (rwfx->Format.nSamplesPerSec != wfx.Format.nSamplesPerSec) /* needs resampling */
             {
-                flags = AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM;
+                flags |= AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM;
                 vi.dwMinorVersion = 1;
 
                 if (VerifyVersionInfoW(&vi,
@@ -549,6 +581,36 @@ static DWORD WINAPI fluid_wasapi_audio_run(void *p)
     ret = IAudioClient_Initialize(
     dev->aucl, share_mode, flags, dev->buffer_duration_reftime, dev->periods_reftime, (WAVEFORMATEX *)&wfx, &GUID_NULL);
 
+    if(ret == AUDCLNT_E_BUFFER_SIZE_NOT_ALIGNED)
+    {
+        /* Exclusive mode wants a period that matches the hardware's buffer alignment.
+         * Retry once with the aligned size, which requires a fresh audio client. */
+        ret = IAudioClient_GetBufferSize(dev->aucl, &dev->nframes);
+        IAudioClient_Release(dev->aucl);
+        dev->aucl = NULL;
+
+        if(FAILED(ret))
+        {
+            FLUID_LOG(FLUID_ERR, "wasapi: cannot get aligned buffer size. 0x%x", (unsigned)ret);
+            goto cleanup;
+        }
+
+        FLUID_LOG(FLUID_DBG, "wasapi: aligning period to %u frames.", dev->nframes);
+        dev->periods_reftime = (fluid_long_long_t)(dev->nframes / dev->sample_rate * 1e7 + .5);
+        dev->buffer_duration_reftime = dev->periods_reftime;
+
+        ret = IMMDevice_Activate(mmdev, &_IID_IAudioClient, CLSCTX_ALL, NULL, (void **)&dev->aucl);
+
+        if(FAILED(ret))
+        {
+            FLUID_LOG(FLUID_ERR, "wasapi: cannot activate audio client. 0x%x", (unsigned)ret);
+            goto cleanup;
+        }
+
+        ret = IAudioClient_Initialize(
+        dev->aucl, share_mode, flags, dev->buffer_duration_reftime, dev->periods_reftime, (WAVEFORMATEX *)&wfx, &GUID_NULL);
+    }
+
     if(FAILED(ret))
     {
         FLUID_LOG(FLUID_ERR, "wasapi: failed to initialize audio client. 0x%x", (unsigned)ret);
@@ -586,10 +648,21 @@ static DWORD WINAPI fluid_wasapi_audio_run(void *p)
               dev->periods * dev->period_size,
               dev->nframes);
     dev->buffer_duration = dev->nframes / dev->sample_rate;
-    time_to_sleep = (DWORD)(dev->buffer_duration * 1000.0 / 2.0);
-    if(time_to_sleep < 1)
+
+    ret = IAudioClient_SetEventHandle(dev->aucl, dev->buffer_ev);
+
+    if(FAILED(ret))
+    {
+        FLUID_LOG(FLUID_ERR, "wasapi: cannot set buffer event. 0x%x", (unsigned)ret);
+        goto cleanup;
+    }
+
+    /* Only a safety net in case the device stops signalling, e.g. when it is unplugged */
+    time_to_sleep = (DWORD)(dev->buffer_duration * 1000.0 * 2.0);
+
+    if(time_to_sleep < 10)
     {
-        time_to_sleep = 1;
+        time_to_sleep = 10;
     }
 
     dev->drybuf = FLUID_ARRAY(float *, dev->audio_channels * 2);
@@ -626,6 +699,19 @@ static DWORD WINAPI fluid_wasapi_audio_run(void *p)
         FLUID_LOG(FLUID_DBG, "wasapi: latency: %fms.", dev->latency_reftime / 1e4);
     }
 
+    /* Queue one buffer of silence, so that the first event doesn't find the device starving */
+    if(SUCCEEDED(IAudioRenderClient_GetBuffer(dev->arcl, dev->nframes, &pbuf)))
+    {
+        IAudioRenderClient_ReleaseBuffer(dev->arcl, dev->nframes, AUDCLNT_BUFFERFLAGS_SILENT);
+    }
+
+    mmcss = AvSetMmThreadCharacteristicsW(L"Pro Audio", &mmcss_task);
+
+    if(mmcss == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "wasapi: failed to register the audio thread with MMCSS: '%s'", fluid_get_windows_error());
+    }
+
     ret = IAudioClient_Start(dev->aucl);
 
     if(FAILED(ret))
@@ -639,45 +725,75 @@ static DWORD WINAPI fluid_wasapi_audio_run(void *p)
     /* Signal the success of the driver initialization */
     SetEvent(dev->start_ev);
 
+    wait_handles[0] = dev->quit_ev;
+    wait_handles[1] = dev->buffer_ev;
+
     for(;;)
     {
-        ret = IAudioClient_GetCurrentPadding(dev->aucl, &pos);
-
-        if(FAILED(ret))
+        if(dev->exclusive)
         {
-            FLUID_LOG(FLUID_ERR, "wasapi: cannot get buffer padding. 0x%x", (unsigned)ret);
-            goto cleanup;
+            /* event driven exclusive streams hand over the whole buffer on every event */
+            pos = 0;
         }
+        else
+        {
+            ret = IAudioClient_GetCurrentPadding(dev->aucl, &pos);
 
-        len = dev->nframes - pos;
+            if(FAILED(ret))
+            {
+                FLUID_LOG(FLUID_ERR, "wasapi: cannot get buffer padding. 0x%x", (unsigned)ret);
+                goto cleanup;
+            }
 
-        if(len == 0)
-        {
-            Sleep(0);
-            continue;
+            /* the device ran dry since the last wakeup */
+            if(primed && pos == 0)
+            {
+                fluid_audio_driver_xrun(&dev->driver);
+            }
         }
 
-        ret = IAudioRenderClient_GetBuffer(dev->arcl, len, &pbuf);
+        fluid_audio_driver_set_latency(&dev->driver,
+                                       dev->latency_reftime / 10.0 + (dev->exclusive ? dev->nframes : pos) * 1000000.0 / dev->sample_rate);
 
-        if(FAILED(ret))
+        len = dev->nframes - pos;
+
+        if(len > 0)
         {
-            FLUID_LOG(FLUID_ERR, "wasapi: cannot get buffer. 0x%x", (unsigned)ret);
-            goto cleanup;
-        }
+            ret = IAudioRenderClient_GetBuffer(dev->arcl, len, &pbuf);
 
-        channels_out[0] = channels_out[1] = (void *)pbuf;
+            if(FAILED(ret))
+            {
+                FLUID_LOG(FLUID_ERR, "wasapi: cannot get buffer. 0x%x", (unsigned)ret);
+                goto cleanup;
+            }
+
+            start = fluid_utime();
+            channels_out[0] = channels_out[1] = (void *)pbuf;
+
+            if(dev->func == fluid_wasapi_synth_write_float)
+            {
+                /* no user callback, the synth stores its samples straight into the device buffer */
+                fluid_synth_write_channels((fluid_synth_t *)dev->user_pointer, (int)len, dev->outfmt,
+                                           2, channels_out, channels_off, channels_incr);
+            }
+            else
+            {
+                fluid_wasapi_write_processed_channels(dev, (int)len, 2, channels_out, channels_off, channels_incr);
+            }
 
-        fluid_wasapi_write_processed_channels(dev, (int)len, 2, channels_out, channels_off, channels_incr);
+            ret = IAudioRenderClient_ReleaseBuffer(dev->arcl, len, 0);
 
-        ret = IAudioRenderClient_ReleaseBuffer(dev->arcl, len, 0);
+            if(FAILED(ret))
+            {
+                FLUID_LOG(FLUID_ERR, "wasapi: failed to release buffer. 0x%x", (unsigned)ret);
+                goto cleanup;
+            }
 
-        if(FAILED(ret))
-        {
-            FLUID_LOG(FLUID_ERR, "wasapi: failed to release buffer. 0x%x", (unsigned)ret);
-            goto cleanup;
+            fluid_audio_driver_period_done(&dev->driver, start, (int)len, dev->sample_rate);
+            primed = TRUE;
         }
 
-        if(WaitForSingleObject(dev->quit_ev, time_to_sleep) == WAIT_OBJECT_0)
+        if(WaitForMultipleObjects(FLUID_N_ELEMENTS(wait_handles), wait_handles, FALSE, time_to_sleep) == WAIT_OBJECT_0)
         {
             break;
         }
@@ -714,6 +830,11 @@ cleanup:
         denum = NULL;
     }
 
+    if(mmcss != NULL)
+    {
+        AvRevertMmThreadCharacteristics(mmcss);
+    }
+
     if(needs_com_uninit)
     {
         CoUninitialize();
@@ -787,7 +908,7 @@ static int fluid_wasapi_write_processed_channels(void *data,
 
         switch (drv->outfmt)
         {
-            case FLUID_WASAPI_FMT_FLOAT: {
+            case FLUID_SAMPLE_FORMAT_FLOAT: {
                 /* Interleave planar float -> interleaved float */
                 float *dstf = (float *)dst;
                 int i;
@@ -799,7 +920,7 @@ static int fluid_wasapi_write_processed_channels(void *data,
                 return FLUID_OK;
             }
 
-            case FLUID_WASAPI_FMT_S16:
+            case FLUID_SAMPLE_FORMAT_S16:
                 return fluid_audio_planar_float_to_s16((int16_t *)dst,
                                                        2, /* dst_stride (samples) */
                                                        (const float *const *)drv->drybuf,
@@ -807,7 +928,7 @@ static int fluid_wasapi_write_processed_channels(void *data,
                                                        len /* frames */
                 );
 
-            case FLUID_WASAPI_FMT_S24:
+            case FLUID_SAMPLE_FORMAT_S24:
                 return fluid_audio_planar_float_to_s24((int32_t *)dst,
                                                        2, /* dst_stride (samples) */
                                                        (const float *const *)drv->drybuf,
@@ -815,7 +936,7 @@ static int fluid_wasapi_write_processed_channels(void *data,
                                                        len /* frames */
                 );
 
-            case FLUID_WASAPI_FMT_S32:
+            case FLUID_SAMPLE_FORMAT_S32:
                 return fluid_audio_planar_float_to_s32((int32_t *)dst,
                                                        2, /* dst_stride (samples) */
                                                        (const float *const *)drv->drybuf,
@@ -0,0 +1,296 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/* fluid_webaudio.c
+ *
+ * Audio driver for browsers, using the Wasm Audio Worklets of Emscripten.
+ *
+ * The synth renders in the process callback of an AudioWorkletNode, i.e. on the audio
+ * rendering thread of the browser, straight into the output buffers of the node. As the
+ * wasm memory is a SharedArrayBuffer, neither the rendering nor the audio data pass the
+ * main JS thread. The page must be served cross-origin isolated for this.
+ */
+
+#include "fluid_synth.h"
+#include "fluid_adriver.h"
+#include "fluid_settings.h"
+
+#if WEBAUDIO_SUPPORT
+
+#include <emscripten/webaudio.h>
+
+/* Frames the process callback renders, the render quantum of Web Audio */
+#define FLUID_WEBAUDIO_QUANTUM 128
+
+/* Stack of the audio worklet thread */
+#define FLUID_WEBAUDIO_STACK_SIZE (64 * 1024)
+
+typedef struct
+{
+    fluid_audio_driver_t driver;
+    fluid_audio_func_t callback;
+    void *data;
+    double sample_rate;
+
+    EMSCRIPTEN_WEBAUDIO_T context;
+    EMSCRIPTEN_AUDIO_WORKLET_NODE_T node;
+    void *stack;
+
+    /* The worklet is set up asynchronously on the main thread. A driver deleted before
+     * that finished is freed by the last setup callback. If the setup fails, the driver
+     * stays silent until it is deleted. */
+    int pending;
+    int deleted;
+
+    fluid_atomic_int_t stop;        /* set when the process callback must not render anymore */
+    fluid_atomic_int_t processing;  /* TRUE while the process callback runs */
+} fluid_webaudio_driver_t;
+
+static void fluid_webaudio_worklet_started(EMSCRIPTEN_WEBAUDIO_T context, EM_BOOL success, void *user_data);
+static void fluid_webaudio_processor_created(EMSCRIPTEN_WEBAUDIO_T context, EM_BOOL success, void *user_data);
+static EM_BOOL fluid_webaudio_process(int num_inputs, const AudioSampleFrame *inputs,
+                                      int num_outputs, AudioSampleFrame *outputs,
+                                      int num_params, const AudioParamFrame *params,
+                                      void *user_data);
+static void fluid_webaudio_free(fluid_webaudio_driver_t *dev);
+
+
+void fluid_webaudio_audio_driver_settings(fluid_settings_t *settings)
+{
+    fluid_settings_register_str(settings, "audio.webaudio.latency-hint", "interactive", 0);
+    fluid_settings_add_option(settings, "audio.webaudio.latency-hint", "interactive");
+    fluid_settings_add_option(settings, "audio.webaudio.latency-hint", "balanced");
+    fluid_settings_add_option(settings, "audio.webaudio.latency-hint", "playback");
+}
+
+
+fluid_audio_driver_t *
+new_fluid_webaudio_audio_driver(fluid_settings_t *settings, fluid_synth_t *synth)
+{
+    return new_fluid_webaudio_audio_driver2(settings, NULL, synth);
+}
+
+fluid_audio_driver_t *
+new_fluid_webaudio_audio_driver2(fluid_settings_t *settings, fluid_audio_func_t func, void *data)
+{
+    fluid_webaudio_driver_t *dev;
+    EmscriptenWebAudioCreateAttributes attributes;
+    char *latency_hint = NULL;
+
+    dev = FLUID_NEW(fluid_webaudio_driver_t);
+
+    if(dev == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(dev, 0, sizeof(*dev));
+
+    dev->callback = func;
+    dev->data = data;
+    fluid_settings_getnum(settings, "synth.sample-rate", &dev->sample_rate);
+    fluid_settings_dupstr(settings, "audio.webaudio.latency-hint", &latency_hint);  /* ++ alloc latency hint */
+
+    dev->stack = FLUID_MALLOC(FLUID_WEBAUDIO_STACK_SIZE);
+
+    if(dev->stack == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    attributes.latencyHint = latency_hint;
+    attributes.sampleRate = (uint32_t)dev->sample_rate;
+
+    dev->context = emscripten_create_audio_context(&attributes);
+    FLUID_FREE(latency_hint);    /* -- free latency hint */
+    latency_hint = NULL;
+
+    if(dev->context == 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the Web Audio context");
+        goto error_recovery;
+    }
+
+    /* continued in fluid_webaudio_worklet_started() once the browser returns to its event loop */
+    dev->pending = TRUE;
+    emscripten_start_wasm_audio_worklet_thread_async(dev->context, dev->stack, FLUID_WEBAUDIO_STACK_SIZE,
+            fluid_webaudio_worklet_started, dev);
+
+    FLUID_LOG(FLUID_INFO, "Using Web Audio driver");
+
+    return (fluid_audio_driver_t *) dev;
+
+error_recovery:
+    FLUID_FREE(latency_hint);    /* -- free latency hint */
+    fluid_webaudio_free(dev);
+    return NULL;
+}
+
+void delete_fluid_webaudio_audio_driver(fluid_audio_driver_t *p)
+{
+    fluid_webaudio_driver_t *dev = (fluid_webaudio_driver_t *) p;
+    fluid_return_if_fail(dev != NULL);
+
+    if(dev->pending)
+    {
+        dev->deleted = TRUE;
+        return;
+    }
+
+    fluid_webaudio_free(dev);
+}
+
+static void
+fluid_webaudio_free(fluid_webaudio_driver_t *dev)
+{
+    fluid_atomic_int_set(&dev->stop, TRUE);
+
+    if(dev->node != 0)
+    {
+        emscripten_destroy_web_audio_node(dev->node);
+    }
+
+    if(dev->context != 0)
+    {
+        /* stops the process callbacks along with the audio worklet thread */
+        emscripten_destroy_audio_context(dev->context);
+    }
+
+    /* The context closes asynchronously, a callback might still be rendering. The main
+     * thread can't block, but a render quantum takes no more than a few milliseconds. */
+    while(fluid_atomic_int_get(&dev->processing))
+    {
+    }
+
+    FLUID_FREE(dev->stack);
+    FLUID_FREE(dev);
+}
+
+/* Registers the processor in the audio worklet thread, which is running now */
+static void
+fluid_webaudio_worklet_started(EMSCRIPTEN_WEBAUDIO_T context, EM_BOOL success, void *user_data)
+{
+    fluid_webaudio_driver_t *dev = user_data;
+    WebAudioWorkletProcessorCreateOptions options;
+
+    if(dev->deleted)
+    {
+        fluid_webaudio_free(dev);
+        return;
+    }
+
+    if(!success)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to start the audio worklet thread, is the page cross-origin isolated?");
+        dev->pending = FALSE;
+        return;
+    }
+
+    FLUID_MEMSET(&options, 0, sizeof(options));
+    options.name = "fluidsynth";
+
+    emscripten_create_wasm_audio_worklet_processor_async(context, &options,
+            fluid_webaudio_processor_created, dev);
+}
+
+/* Creates the node rendering the synth and connects it to the speakers */
+static void
+fluid_webaudio_processor_created(EMSCRIPTEN_WEBAUDIO_T context, EM_BOOL success, void *user_data)
+{
+    fluid_webaudio_driver_t *dev = user_data;
+    EmscriptenAudioWorkletNodeCreateOptions options;
+    int channels = 2;
+
+    dev->pending = FALSE;
+
+    if(dev->deleted)
+    {
+        fluid_webaudio_free(dev);
+        return;
+    }
+
+    if(!success)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the audio worklet processor");
+        return;
+    }
+
+    FLUID_MEMSET(&options, 0, sizeof(options));
+    options.numberOfInputs = 0;
+    options.numberOfOutputs = 1;
+    options.outputChannelCounts = &channels;
+
+    dev->node = emscripten_create_wasm_audio_worklet_node(context, "fluidsynth", &options,
+                fluid_webaudio_process, dev);
+    emscripten_audio_node_connect(dev->node, context, 0, 0);
+
+    /* Browsers only let a context start playing after a user gesture. If this call
+     * doesn't come from one, the application has to resume the context itself. */
+    emscripten_resume_audio_context_sync(context);
+}
+
+/* Called on the audio worklet thread for every render quantum */
+static EM_BOOL
+fluid_webaudio_process(int num_inputs, const AudioSampleFrame *inputs,
+                       int num_outputs, AudioSampleFrame *outputs,
+                       int num_params, const AudioParamFrame *params,
+                       void *user_data)
+{
+    fluid_webaudio_driver_t *dev = user_data;
+    /* the channels of an output are planar, one quantum after the other */
+    float *left = outputs[0].data;
+    float *right = outputs[0].data + FLUID_WEBAUDIO_QUANTUM;
+    double start;
+
+    /* announced before looking at stop, see fluid_webaudio_free() */
+    fluid_atomic_int_set(&dev->processing, TRUE);
+
+    if(fluid_atomic_int_get(&dev->stop))
+    {
+        fluid_atomic_int_set(&dev->processing, FALSE);
+        return EM_FALSE;
+    }
+
+    start = fluid_utime();
+
+    if(dev->callback == NULL)
+    {
+        fluid_synth_write_float(dev->data, FLUID_WEBAUDIO_QUANTUM, left, 0, 1, right, 0, 1);
+    }
+    else
+    {
+        float *handle[2];
+
+        handle[0] = left;
+        handle[1] = right;
+
+        FLUID_MEMSET(left, 0, 2 * FLUID_WEBAUDIO_QUANTUM * sizeof(float));
+        (*dev->callback)(dev->data, FLUID_WEBAUDIO_QUANTUM, 0, NULL, 2, handle);
+    }
+
+    fluid_audio_driver_period_done(&dev->driver, start, FLUID_WEBAUDIO_QUANTUM, dev->sample_rate);
+    fluid_atomic_int_set(&dev->processing, FALSE);
+
+    /* keep the node alive */
+    return EM_TRUE;
+}
+
+#endif /* WEBAUDIO_SUPPORT */
@@ -153,6 +153,8 @@ fluid_winmidi_callback(HMIDIIN hmi, UINT wMsg, DWORD_PTR dwInstance,
         break;
 
     case MIM_DATA:
+        fluid_midi_event_stamp(&event);
+
         if(msg_type(msg_param) < 0xf0)      /* Voice category message */
         {
             event.type = msg_type(msg_param);
@@ -196,6 +198,7 @@ fluid_winmidi_callback(HMIDIIN hmi, UINT wMsg, DWORD_PTR dwInstance,
         if(pMidiHdr->dwBytesRecorded > 2 && data[0] == 0xF0
                 && data[pMidiHdr->dwBytesRecorded - 1] == 0xF7)
         {
+            fluid_midi_event_stamp(&event);
             fluid_midi_event_set_sysex(&event, pMidiHdr->lpData + 1,
                                        pMidiHdr->dwBytesRecorded - 2, FALSE);
             (*dev->driver.handler)(dev->driver.data, &event);
@@ -298,6 +298,371 @@ fast_render_loop(fluid_settings_t *settings, fluid_synth_t *synth, fluid_player_
     delete_fluid_file_renderer(renderer);
 }
 
+/*
+ * Batch rendering: every MIDI file is rendered into a file of its own, several
+ * files at once. Each file is rendered by a new synth, so that it sounds exactly
+ * as if it had been rendered alone.
+ */
+typedef struct
+{
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;   /* has the SoundFonts loaded, keeping their samples in the sample cache */
+    char **midifiles;
+    int count;
+    const char *outdir;
+    const char *extension;
+    int quiet;
+
+    /* only accessed in the batch_render critical section */
+    int next;               /* the next MIDI file to render */
+    int done;
+    int failed;
+    double audio_seconds;   /* length of the audio rendered so far */
+} batch_render_t;
+
+/* Returns the wall clock time in seconds */
+static double
+batch_render_time(void)
+{
+#if HAVE_OPENMP
+    return omp_get_wtime();
+#else
+    /* only one file is rendered at once without OpenMP, CPU time is close enough */
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Returns the output file of a MIDI file: its name in the output directory, with the extension replaced */
+static char *
+batch_render_output_name(const batch_render_t *batch, const char *midifile)
+{
+    const char *base = midifile, *p;
+    size_t len;
+    char *name;
+
+    for(p = midifile; *p != '\0'; p++)
+    {
+        if(*p == '/' || *p == '\\')
+        {
+            base = p + 1;
+        }
+    }
+
+    p = FLUID_STRRCHR(base, '.');
+    len = (p != NULL && p != base) ? (size_t)(p - base) : FLUID_STRLEN(base);
+
+    name = malloc(FLUID_STRLEN(batch->outdir) + len + FLUID_STRLEN(batch->extension) + 3);
+
+    if(name != NULL)
+    {
+        FLUID_SPRINTF(name, "%s/%.*s.%s", batch->outdir, (int)len, base, batch->extension);
+    }
+
+    return name;
+}
+
+/* Creates a synth loading the SoundFonts of synth, in the same order and with the same bank offsets */
+static fluid_synth_t *
+batch_render_new_synth(fluid_settings_t *settings, fluid_synth_t *synth)
+{
+    fluid_synth_t *worker = new_fluid_synth(settings);
+    fluid_sfont_t *sfont;
+    int i, id;
+
+    if(worker == NULL)
+    {
+        fprintf(stderr, "Failed to create a synthesizer for batch rendering\n");
+        return NULL;
+    }
+
+    /* the SoundFont loaded last is the first one of the stack */
+    for(i = fluid_synth_sfcount(synth) - 1; i >= 0; i--)
+    {
+        sfont = fluid_synth_get_sfont(synth, i);
+        id = fluid_synth_sfload(worker, fluid_sfont_get_name(sfont), 1);
+
+        if(id == FLUID_FAILED)
+        {
+            fprintf(stderr, "Failed to load the SoundFont %s for batch rendering\n", fluid_sfont_get_name(sfont));
+            delete_fluid_synth(worker);
+            return NULL;
+        }
+
+        fluid_synth_set_bank_offset(worker, id, fluid_synth_get_bank_offset(synth, fluid_sfont_get_id(sfont)));
+    }
+
+    return worker;
+}
+
+/* Renders one MIDI file, returns the number of audio frames written or -1 on error */
+static long
+batch_render_file(batch_render_t *batch, const char *midifile, const char *outfile)
+{
+    fluid_file_renderer_t *renderer;
+    fluid_player_t *player;
+    fluid_synth_t *synth;
+    long frames = 0;
+    int period_size;
+
+    synth = batch_render_new_synth(batch->settings, batch->synth);
+
+    if(synth == NULL)
+    {
+        return -1;
+    }
+
+    player = new_fluid_player(synth);
+
+    if(player == NULL || fluid_player_add(player, midifile) != FLUID_OK || fluid_player_play(player) != FLUID_OK)
+    {
+        delete_fluid_player(player);
+        delete_fluid_synth(synth);
+        return -1;
+    }
+
+    /* the renderer takes the name of its file from the settings shared by all synths */
+    #pragma omp critical(batch_render_settings)
+    {
+        fluid_settings_setstr(batch->settings, "audio.file.name", outfile);
+        renderer = new_fluid_file_renderer(synth);
+    }
+
+    if(renderer == NULL)
+    {
+        delete_fluid_player(player);
+        delete_fluid_synth(synth);
+        return -1;
+    }
+
+    fluid_settings_getint(batch->settings, "audio.period-size", &period_size);
+
+    while(fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+    {
+        if(fluid_file_renderer_process_block(renderer) != FLUID_OK)
+        {
+            frames = -1;
+            break;
+        }
+
+        frames += period_size;
+    }
+
+    delete_fluid_file_renderer(renderer);
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+
+    return frames;
+}
+
+/* Renders MIDI files until there are none left */
+static void
+batch_render_worker(batch_render_t *batch)
+{
+    double sample_rate, start, seconds;
+    char *outfile;
+    long frames;
+    int i, done;
+
+    fluid_settings_getnum(batch->settings, "synth.sample-rate", &sample_rate);
+
+    while(1)
+    {
+        #pragma omp critical(batch_render)
+        i = batch->next++;
+
+        if(i >= batch->count)
+        {
+            break;
+        }
+
+        outfile = batch_render_output_name(batch, batch->midifiles[i]);
+        start = batch_render_time();
+        frames = (outfile != NULL) ? batch_render_file(batch, batch->midifiles[i], outfile) : -1;
+        seconds = batch_render_time() - start;
+
+        #pragma omp critical(batch_render)
+        {
+            done = ++batch->done;
+
+            if(frames < 0)
+            {
+                batch->failed++;
+                fprintf(stderr, "[%d/%d] Failed to render '%s'\n", done, batch->count, batch->midifiles[i]);
+            }
+            else
+            {
+                batch->audio_seconds += frames / sample_rate;
+
+                if(!batch->quiet)
+                {
+                    printf("[%d/%d] '%s' -> '%s': %.1f s of audio in %.2f s (%.1fx realtime)\n",
+                           done, batch->count, batch->midifiles[i], outfile, frames / sample_rate,
+                           seconds, (seconds > 0) ? frames / sample_rate / seconds : 0.0);
+                    fflush(stdout);
+                }
+            }
+        }
+
+        free(outfile);
+    }
+}
+
+/*
+ * Renders all MIDI files given on the command line into outdir, jobs files at once (as
+ * many as CPUs if jobs is 0, one without OpenMP). The synths rendering them load the
+ * SoundFonts of synth, sharing their sample data through the sample cache.
+ */
+static int
+batch_render(fluid_settings_t *settings, fluid_synth_t *synth, char **argv, int arg1, int argc,
+             const char *outdir, int jobs, int quiet)
+{
+    batch_render_t batch;
+    char *type = NULL;
+    double start, seconds;
+    int i;
+
+    FLUID_MEMSET(&batch, 0, sizeof(batch));
+    batch.settings = settings;
+    batch.synth = synth;
+    batch.outdir = outdir;
+    batch.quiet = quiet;
+    batch.midifiles = (char **) calloc(argc, sizeof(char *));
+
+    if(batch.midifiles == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return FLUID_FAILED;
+    }
+
+    for(i = arg1; i < argc; i++)
+    {
+        if((argv[i][0] != '-') && fluid_is_midifile(argv[i]))
+        {
+            batch.midifiles[batch.count++] = argv[i];
+        }
+    }
+
+    if(batch.count == 0)
+    {
+        fprintf(stderr, "No midi file specified!\n");
+        free(batch.midifiles);
+        return FLUID_FAILED;
+    }
+
+    /* the files are named after the file type, except for "auto" which is decided by the name */
+    fluid_settings_dupstr(settings, "audio.file.type", &type);
+    batch.extension = (type == NULL || FLUID_STRCMP(type, "auto") == 0) ? "wav" : type;
+
+#if HAVE_OPENMP
+    if(jobs <= 0)
+    {
+        jobs = omp_get_num_procs();
+    }
+
+    if(jobs > batch.count)
+    {
+        jobs = batch.count;
+    }
+#else
+    jobs = 1;
+#endif
+
+    if(!quiet)
+    {
+        printf("Rendering %d MIDI files to '%s' with %d jobs..\n", batch.count, outdir, jobs);
+    }
+
+    start = batch_render_time();
+
+    #pragma omp parallel num_threads(jobs) default(none) shared(batch)
+    batch_render_worker(&batch);
+
+    seconds = batch_render_time() - start;
+
+    if(!quiet)
+    {
+        printf("Rendered %d of %d MIDI files, %.1f s of audio in %.2f s (%.1fx realtime)\n",
+               batch.count - batch.failed, batch.count, batch.audio_seconds, seconds,
+               (seconds > 0) ? batch.audio_seconds / seconds : 0.0);
+    }
+
+    FLUID_FREE(type);
+    free(batch.midifiles);
+    return (batch.failed == 0) ? FLUID_OK : FLUID_FAILED;
+}
+
+static volatile sig_atomic_t render_server_quit = 0;
+
+static void
+render_server_signal(int sig)
+{
+    render_server_quit = 1;
+}
+
+/*
+ * Serves a pool of synths loading the SoundFonts of synth to the clients attaching
+ * through the file at path, until SIGINT or SIGTERM is received.
+ */
+static int
+render_server(fluid_settings_t *settings, fluid_synth_t *synth, const char *path, int quiet)
+{
+    fluid_synth_pool_t *pool;
+    fluid_render_server_t *server;
+    fluid_sfont_t *sfont;
+    int i, clients;
+
+    fluid_settings_getint(settings, "shell.render-clients", &clients);
+    pool = new_fluid_synth_pool(settings, clients);
+
+    if(pool == NULL)
+    {
+        fprintf(stderr, "Failed to create the synths of the render server\n");
+        return FLUID_FAILED;
+    }
+
+    /* the SoundFont loaded last is the first one of the stack */
+    for(i = fluid_synth_sfcount(synth) - 1; i >= 0; i--)
+    {
+        sfont = fluid_synth_get_sfont(synth, i);
+
+        if(fluid_synth_pool_sfload(pool, fluid_sfont_get_name(sfont)) == FLUID_FAILED)
+        {
+            fprintf(stderr, "Failed to load the SoundFont %s for the render server\n", fluid_sfont_get_name(sfont));
+        }
+    }
+
+    server = new_fluid_render_server(settings, pool, path, clients);
+
+    if(server == NULL)
+    {
+        fprintf(stderr, "Failed to create the render server\n");
+        delete_fluid_synth_pool(pool);
+        return FLUID_FAILED;
+    }
+
+    if(!quiet)
+    {
+        printf("Rendering for up to %d clients attaching to '%s', press Ctrl-C to stop..\n", clients, path);
+    }
+
+    signal(SIGINT, render_server_signal);
+    signal(SIGTERM, render_server_signal);
+
+    while(!render_server_quit)
+    {
+#ifdef _WIN32
+        Sleep(100);
+#else
+        usleep(100000);
+#endif
+    }
+
+    delete_fluid_render_server(server);
+    delete_fluid_synth_pool(pool);
+
+    return FLUID_OK;
+}
+
 static void load_and_execute_config_file(fluid_cmd_handler_t *cmd_handler, const char *config_file, int verbose, int early)
 {
     if(config_file != NULL)
@@ -379,7 +744,10 @@ int main(int argc, char **argv)
     int audio_channels = 0;
     int dump = 0;
     int fast_render = 0;
-    static const char optchars[] = "+a:b:C:c:dE:f:F:G:g:hijK:L:lm:nO:o:p:QqR:r:sT:Vvz:";
+    char *batch_dir = NULL;
+    int batch_jobs = 0;
+    char *render_server_path = NULL;
+    static const char optchars[] = "+a:B:b:C:c:dE:f:F:G:g:hiJ:jK:L:lm:nO:o:p:QqR:r:S:sT:Vvz:";
 
 #if defined(_WIN32) && defined(_UNICODE)
 // WC_ERR_INVALID_CHARS is only supported on Windows Vista and newer. To support older Windows, our only chance is to use zero for this flag.
@@ -467,6 +835,7 @@ int main(int argc, char **argv)
             {"audio-file-type", 1, 0, 'T'},
             {"audio-groups", 1, 0, 'G'},
             {"bank-offset", 1, 0, 'b'},
+            {"batch-render", 1, 0, 'B'},
             {"chorus", 1, 0, 'C'},
             {"connect-jack-outputs", 0, 0, 'j'},
             {"disable-lash", 0, 0, 'l'},
@@ -474,6 +843,7 @@ int main(int argc, char **argv)
             {"fast-render", 1, 0, 'F'},
             {"gain", 1, 0, 'g'},
             {"help", 0, 0, 'h'},
+            {"jobs", 1, 0, 'J'},
             {"load-config", 1, 0, 'f'},
             {"midi-channels", 1, 0, 'K'},
             {"midi-driver", 1, 0, 'm'},
@@ -483,6 +853,7 @@ int main(int argc, char **argv)
             {"portname", 1, 0, 'p'},
             {"query-audio-devices", 0, 0, 'Q'},
             {"quiet", 0, 0, 'q'},
+            {"render-server", 1, 0, 'S'},
             {"reverb", 1, 0, 'R'},
             {"sample-rate", 1, 0, 'r'},
             {"server", 0, 0, 's'},
@@ -529,6 +900,11 @@ int main(int argc, char **argv)
 
             break;
 
+        case 'B':
+            batch_dir = optarg;
+            fast_render = 1;
+            break;
+
         case 'b':
             bank_ofs = atoi(optarg);
             break;
@@ -616,6 +992,10 @@ int main(int argc, char **argv)
             interactive = 0;
             break;
 
+        case 'J':
+            batch_jobs = atoi(optarg);
+            break;
+
         case 'j':
 #if JACK_SUPPORT
             fluid_settings_setint(settings, "audio.jack.autoconnect", 1);
@@ -744,6 +1124,10 @@ int main(int argc, char **argv)
             }
             break;
 
+        case 'S':
+            render_server_path = optarg;
+            break;
+
         case 's':
 #ifdef NETWORK_SUPPORT
             with_server = 1;
@@ -854,6 +1238,17 @@ int main(int argc, char **argv)
         fluid_settings_setstr(settings, "player.timing-source", "sample");
         fluid_settings_setint(settings, "synth.lock-memory", 0);
     }
+    else if(render_server_path != NULL)
+    {
+        /* the clients play the synths of the server, nothing else does */
+        midi_in = 0;
+        interactive = 0;
+#ifdef NETWORK_SUPPORT
+        with_server = 0;
+#endif
+        /* the synth only loads the SoundFonts for the pool to share them */
+        fluid_settings_setint(settings, "synth.shared-soundfonts", 1);
+    }
 
     cmd_handler = new_fluid_cmd_handler2(settings, NULL, NULL, NULL);
     if(cmd_handler == NULL)
@@ -999,7 +1394,7 @@ int main(int argc, char **argv)
     }
 
     /* create the player and add any midi files, if requested */
-    for(i = arg1; i < argc; i++)
+    for(i = arg1; batch_dir == NULL && i < argc; i++)
     {
         const char *u8_path = argv[i];
         if((u8_path[0] != '-') && fluid_is_midifile(u8_path))
@@ -1073,8 +1468,16 @@ int main(int argc, char **argv)
 
 #endif
 
+    /* batch rendering every midi file into a file of its own, if requested */
+    if(batch_dir != NULL)
+    {
+        if(batch_render(settings, synth, argv, arg1, argc, batch_dir, batch_jobs, quiet) != FLUID_OK)
+        {
+            goto cleanup;
+        }
+    }
     /* fast rendering audio file, if requested */
-    if(fast_render)
+    else if(fast_render)
     {
         char *filename;
 
@@ -1097,6 +1500,14 @@ int main(int argc, char **argv)
 
         fast_render_loop(settings, synth, player);
     }
+    /* render for other processes, if requested */
+    else if(render_server_path != NULL)
+    {
+        if(render_server(settings, synth, render_server_path, quiet) != FLUID_OK)
+        {
+            goto cleanup;
+        }
+    }
     else /* start the synthesis thread */
     {
         adriver = new_fluid_audio_driver(settings, synth);
@@ -1107,6 +1518,15 @@ int main(int argc, char **argv)
             goto cleanup;
         }
 
+#ifdef NETWORK_SUPPORT
+
+        if(server != NULL)
+        {
+            fluid_server_set_audio_driver(server, adriver);
+        }
+
+#endif
+
         /* run the shell */
         if(interactive)
         {
@@ -1239,6 +1659,8 @@ print_help(fluid_settings_t *settings)
     printf(" -a, --audio-driver=[label]\n"
            "    The name of the audio driver to use.\n"
            "    Valid values: %s\n", audio_options ? audio_options : "ERROR");
+    printf(" -B, --batch-render=[dir]\n"
+           "    Render each MIDI file to an audio file of its own in [dir], several files at once\n");
     printf(" -b, --bank-offset=[num]\n"
            "    A positional flag that specifies the bank-offset for any Soundfonts\n"
            "    following that flag. Can be specified multiple times.\n");
@@ -1263,6 +1685,9 @@ print_help(fluid_settings_t *settings)
            "    Print out this help summary\n");
     printf(" -i, --no-shell\n"
            "    Don't read commands from the shell [default = yes]\n");
+    printf(" -J, --jobs=[num]\n"
+           "    Number of MIDI files rendered at once by --batch-render [default = number of CPUs]\n"
+           "    (only with OpenMP support)\n");
     printf(" -j, --connect-jack-outputs\n"
            "    Attempt to connect the jack outputs to the physical ports\n");
 
@@ -1295,6 +1720,9 @@ print_help(fluid_settings_t *settings)
            "    Set the sample rate\n");
     printf(" -R, --reverb\n"
            "    Turn the reverb on or off [0|1|yes|no, default = on]\n");
+    printf(" -S, --render-server=[path]\n"
+           "    Render synths for other processes attaching through the file [path],\n"
+           "    e.g. in /dev/shm, instead of playing through the audio driver\n");
     printf(" -s, --server\n"
            "    Start FluidSynth as a server process\n");
     printf(" -T, --audio-file-type\n"
@@ -4,6 +4,13 @@
 #include "fluidsynth_priv.h"
 
 
+// Rounds a table value to a fixed point number with the given count of fractional bits,
+// for the tables of enable-fixed-point
+static constexpr int32_t fixed_from_real(double val, int bits)
+{
+    return static_cast<int32_t>(val * (1 << bits) + (val < 0 ? -0.5 : 0.5));
+}
+
 struct IsBoundary
 {
     // Checks whether N is a multiple of 10
@@ -24,11 +31,12 @@ template<typename F, bool NisMult10, int N, int... Rest> struct ConstExprArr_imp
 
 // === Partial Specialization for N==0 ===
 // When N == 0, this specialization is used.
-// It defines a static constant array value containing the values as calculated by the functor.
+// It defines a static constant array value containing the values as calculated by the functor,
+// of the type the functor returns.
 // At this point, Rest... actually contains all previous N values, so the array will be { 0, 1, 2, ..., N }
 template<typename F, int... Rest> struct ConstExprArr_impl<F, true, 0, Rest...>
 {
-    static constexpr fluid_real_t value[] = { F::calc(0), F::calc(Rest)... };
+    static constexpr decltype(F::calc(0)) value[] = { F::calc(0), F::calc(Rest)... };
 };
 
 // === Partial Specialization whenever N is positive and a multiple of 10 ===
@@ -43,7 +51,7 @@ template<typename F, int N, int... Rest> struct ConstExprArr_impl<F, true, N, Re
 };
 
 // Out-of-class Definition of the Static Array (needed for linkage)
-template<typename F, int... Rest> constexpr fluid_real_t ConstExprArr_impl<F, true, 0, Rest...>::value[];
+template<typename F, int... Rest> constexpr decltype(F::calc(0)) ConstExprArr_impl<F, true, 0, Rest...>::value[];
 
 template<typename F, int N> struct ConstExprArr
 {
@@ -31,3 +31,17 @@ struct InterpCubicFunctor
 extern "C" const constexpr auto interp_coeff_cpp = ConstExprArr<InterpCubicFunctor, FLUID_INTERP_MAX * CUBIC_INTERP_ORDER>::value;
 
 extern "C" const fluid_real_t *const interp_coeff = interp_coeff_cpp;
+
+#if WITH_FIXED_POINT
+struct InterpCubicFixedFunctor
+{
+    static constexpr int32_t calc(int i)
+    {
+        return fixed_from_real(InterpCubicFunctor::calc(i), FLUID_INTERP_FIXED_BITS);
+    }
+};
+
+extern "C" const constexpr auto interp_coeff_fixed_cpp = ConstExprArr<InterpCubicFixedFunctor, FLUID_INTERP_MAX * CUBIC_INTERP_ORDER>::value;
+
+extern "C" const int32_t *const interp_coeff_fixed = interp_coeff_fixed_cpp;
+#endif
@@ -0,0 +1,53 @@
+
+#include "rvoice/fluid_rvoice_dsp_tables.h"
+#include "gentables/ConstExprArr.hpp"
+
+#include "gcem.hpp"
+
+struct InterpSinc16Functor
+{
+    // Polyphase table of a Hann-windowed sinc with SINC16_INTERP_ORDER taps. Row i2 holds the
+    // taps for the fractional phase i2 / FLUID_INTERP_MAX, tap i weights the sample point
+    // i - 7 relative to the phase index, i.e. the points index - 7 ... index + 8:
+    //
+    //for (i2 = 0; i2 < FLUID_INTERP_MAX; i2++)
+    //{
+    //    for (i = 0; i < SINC16_INTERP_ORDER; i++)
+    //    {
+    //        double i_shifted = (double)i - ((double)SINC16_INTERP_ORDER / 2.0 - 1.0) -
+    //                           (double)i2 / (double)FLUID_INTERP_MAX;
+    //
+    //        if (fabs(i_shifted) > 0.000001)
+    //        {
+    //            double arg = M_PI * i_shifted;
+    //            v = sin(arg) / arg;
+    //            /* Hanning window */
+    //            v *= 0.5 * (1.0 + cos(2.0 * arg / (double)SINC16_INTERP_ORDER));
+    //        }
+    //        else
+    //        {
+    //            v = 1.0;
+    //        }
+    //
+    //        sinc_table16[i2][i] = v;
+    //    }
+    //}
+    //
+    // The taps of a phase are contiguous and their count is a multiple of the SIMD vector
+    // widths, so that a row can be loaded without any tail handling.
+    static constexpr fluid_real_t calc(int i)
+    {
+#define I2 (i / SINC16_INTERP_ORDER)
+#define I (i % SINC16_INTERP_ORDER)
+#define I_SHIFTED ((fluid_real_t)I - ((fluid_real_t)SINC16_INTERP_ORDER / 2.0 - 1.0) - (fluid_real_t)I2 / (fluid_real_t)FLUID_INTERP_MAX)
+#define ARG (static_cast<double>(GCEM_PI) * I_SHIFTED)
+
+        return gcem::fabs(I_SHIFTED) > 0.000001
+        ? (gcem::sin(ARG) / (ARG)) * (0.5 * (1.0 + gcem::cos(2.0 * ARG / (fluid_real_t)SINC16_INTERP_ORDER)))
+        : 1.0;
+    }
+};
+
+extern "C" const constexpr auto interp_coeff_sinc16_cpp = ConstExprArr<InterpSinc16Functor, FLUID_INTERP_MAX * SINC16_INTERP_ORDER>::value;
+
+extern "C" const fluid_real_t *const sinc_table16 = interp_coeff_sinc16_cpp;
@@ -77,3 +77,17 @@ struct InterpSincFunctor
 extern "C" const constexpr auto interp_coeff_sinc7_cpp = ConstExprArr<InterpSincFunctor, FLUID_INTERP_MAX * SINC_INTERP_ORDER>::value;
 
 extern "C" const fluid_real_t *const sinc_table7 = interp_coeff_sinc7_cpp;
+
+#if WITH_FIXED_POINT
+struct InterpSincFixedFunctor
+{
+    static constexpr int32_t calc(int i)
+    {
+        return fixed_from_real(InterpSincFunctor::calc(i), FLUID_INTERP_FIXED_BITS);
+    }
+};
+
+extern "C" const constexpr auto interp_coeff_sinc7_fixed_cpp = ConstExprArr<InterpSincFixedFunctor, FLUID_INTERP_MAX * SINC_INTERP_ORDER>::value;
+
+extern "C" const int32_t *const sinc_table7_fixed = interp_coeff_sinc7_fixed_cpp;
+#endif
@@ -20,7 +20,10 @@
 #include "fluid_midi.h"
 #include "fluid_sys.h"
 #include "fluid_synth.h"
+#include "fluid_chan.h"
 #include "fluid_settings.h"
+#include "fluid_object_cache.h"
+#include "fluid_perf.h"
 
 
 static int fluid_midi_event_length(unsigned char event);
@@ -34,7 +37,7 @@ static long fluid_getlength(const unsigned char *s);
  * Returns NULL if there was an error reading or allocating memory.
  */
 typedef FILE  *fluid_file;
-static char *fluid_file_read_full(fluid_file fp, size_t *length);
+static char *fluid_file_read_full(fluid_file fp, size_t *length, fluid_file_map_t *map);
 static void fluid_midi_event_set_sysex_LOCAL(fluid_midi_event_t *evt, int type, void *data, int size, int dynamic);
 static void fluid_midi_event_get_sysex_LOCAL(fluid_midi_event_t *evt, void **data, int *size);
 #define READ_FULL_INITIAL_BUFLEN 1024
@@ -42,31 +45,42 @@ static void fluid_midi_event_get_sysex_LOCAL(fluid_midi_event_t *evt, void **dat
 static fluid_track_t *new_fluid_track(int num);
 static void delete_fluid_track(fluid_track_t *track);
 static int fluid_track_set_name(fluid_track_t *track, char *name);
-static int fluid_track_add_event(fluid_track_t *track, fluid_midi_event_t *evt);
-static fluid_midi_event_t *fluid_track_next_event(fluid_track_t *track);
-static int fluid_track_get_duration(fluid_track_t *track);
-static int fluid_track_reset(fluid_track_t *track);
+static int fluid_track_add_event(fluid_track_t *track, const fluid_midi_event_t *evt);
+static void *fluid_track_alloc_payload(fluid_track_t *track, int size);
 
 static int fluid_player_add_track(fluid_player_t *player, fluid_track_t *track);
+static int fluid_player_build_timeline(fluid_player_t *player);
+static int fluid_player_open_stream(fluid_player_t *player, fluid_midi_file *mf, char *buffer,
+                                    const fluid_file_map_t *map);
+static void delete_fluid_player_stream(fluid_player_stream_t *stream);
+static void fluid_player_stream_fill(fluid_player_t *player);
+static void fluid_player_send_events(fluid_player_t *player, double time);
 static int fluid_player_callback(void *data, unsigned int msec);
 static int fluid_player_reset(fluid_player_t *player);
 static int fluid_player_load(fluid_player_t *player, fluid_playlist_item *item);
 static void fluid_player_advancefile(fluid_player_t *player);
 static void fluid_player_playlist_load(fluid_player_t *player, unsigned int msec);
-static void fluid_player_update_tempo(fluid_player_t *player);
-
-static fluid_midi_file *new_fluid_midi_file(const char *buffer, size_t length);
+static void fluid_player_swap_file(fluid_player_t *player, fluid_player_t *other);
+static void fluid_player_pin_presets(fluid_player_t *player, fluid_player_t *file);
+static void fluid_player_unpin_presets(fluid_player_t *player, fluid_player_t *file);
+static void fluid_player_request_preload(fluid_player_t *player);
+static fluid_thread_return_t fluid_player_preload_thread(void *data);
+static void fluid_player_set_anchor(fluid_player_t *player, double ticks, double time, int tempo);
+static void fluid_player_update_tempo(fluid_player_t *player, int tempo);
+
+static fluid_midi_file *new_fluid_midi_file(char *buffer, size_t length, int persistent);
 static void delete_fluid_midi_file(fluid_midi_file *mf);
 static int fluid_midi_file_read_mthd(fluid_midi_file *midifile);
 static int fluid_midi_file_load_tracks(fluid_midi_file *midifile, fluid_player_t *player);
-static int fluid_midi_file_read_track(fluid_midi_file *mf, fluid_player_t *player, int num);
+static int fluid_midi_file_find_track(fluid_midi_file *mf);
+static fluid_track_t *fluid_midi_file_read_track(fluid_midi_file *mf, int num);
 static int fluid_midi_file_read_event(fluid_midi_file *mf, fluid_track_t *track);
 static int fluid_midi_file_read_varlen(fluid_midi_file *mf);
 static int fluid_midi_file_getc(fluid_midi_file *mf);
-static int fluid_midi_file_push(fluid_midi_file *mf, int c);
+static void fluid_midi_file_unget(fluid_midi_file *mf);
 static int fluid_midi_file_read(fluid_midi_file *mf, void *buf, int len);
+static char *fluid_midi_file_get_data(fluid_midi_file *mf, int len);
 static int fluid_midi_file_skip(fluid_midi_file *mf, int len);
-static int fluid_midi_file_eof(fluid_midi_file *mf);
 static int fluid_midi_file_read_tracklen(fluid_midi_file *mf);
 static int fluid_midi_file_eot(fluid_midi_file *mf);
 static int fluid_midi_file_get_division(fluid_midi_file *midifile);
@@ -118,10 +132,12 @@ int fluid_is_midifile(const char *filename)
  * @param buffer Pointer to full contents of MIDI file (borrows the pointer).
  *  The caller must not free buffer until after the fluid_midi_file is deleted.
  * @param length Size of the buffer in bytes.
+ * @param persistent TRUE if the buffer outlives the events loaded from it, so that
+ *  the data of SYSEX events may point into it instead of being copied.
  * @return New MIDI file handle or NULL on error.
  */
 fluid_midi_file *
-new_fluid_midi_file(const char *buffer, size_t length)
+new_fluid_midi_file(char *buffer, size_t length, int persistent)
 {
     fluid_midi_file *mf;
 
@@ -140,13 +156,13 @@ new_fluid_midi_file(const char *buffer, size_t length)
 
     FLUID_MEMSET(mf, 0, sizeof(fluid_midi_file));
 
-    mf->c = -1;
     mf->running_status = 0;
 
     mf->buffer = buffer;
     mf->buf_len = (int)length;
     mf->buf_pos = 0;
     mf->eof = FALSE;
+    mf->persistent = persistent;
 
     if(fluid_midi_file_read_mthd(mf) != FLUID_OK)
     {
@@ -157,8 +173,12 @@ new_fluid_midi_file(const char *buffer, size_t length)
     return mf;
 }
 
+/*
+ * Maps the whole file into memory where possible, otherwise reads it into
+ * a buffer that must be freed by the caller if map->addr is NULL.
+ */
 static char *
-fluid_file_read_full(fluid_file fp, size_t *length)
+fluid_file_read_full(fluid_file fp, size_t *length, fluid_file_map_t *map)
 {
     size_t buflen;
     char *buffer;
@@ -179,6 +199,15 @@ fluid_file_read_full(fluid_file fp, size_t *length)
         return NULL;
     }
 
+    buffer = fluid_file_map(fp, 0, buflen, map);
+
+    if(buffer != NULL)
+    {
+        FLUID_LOG(FLUID_DBG, "File load: Mapped %lu bytes", (unsigned long)buflen);
+        *length = buflen;
+        return buffer;
+    }
+
     FLUID_LOG(FLUID_DBG, "File load: Allocating %lu bytes", (unsigned long)buflen);
     buffer = FLUID_MALLOC(buflen);
 
@@ -217,44 +246,32 @@ delete_fluid_midi_file(fluid_midi_file *mf)
 }
 
 /*
- * Gets the next byte in a MIDI file, taking into account previous running status.
+ * Gets the next byte in a MIDI file.
  *
  * returns -1 if EOF or read error
  */
 int
 fluid_midi_file_getc(fluid_midi_file *mf)
 {
-    unsigned char c;
-
-    if(mf->c >= 0)
+    if(mf->buf_pos >= mf->buf_len)
     {
-        c = mf->c;
-        mf->c = -1;
-    }
-    else
-    {
-        if(mf->buf_pos >= mf->buf_len)
-        {
-            mf->eof = TRUE;
-            return -1;
-        }
-
-        c = mf->buffer[mf->buf_pos++];
-        mf->trackpos++;
+        mf->eof = TRUE;
+        return -1;
     }
 
-    return (int) c;
+    mf->trackpos++;
+    return (unsigned char)mf->buffer[mf->buf_pos++];
 }
 
 /*
- * Saves a byte to be returned the next time fluid_midi_file_getc() is called,
- * when it is necessary according to running status.
+ * Steps back over the byte just returned by fluid_midi_file_getc(), when it
+ * turns out to be data under running status.
  */
-int
-fluid_midi_file_push(fluid_midi_file *mf, int c)
+void
+fluid_midi_file_unget(fluid_midi_file *mf)
 {
-    mf->c = c;
-    return FLUID_OK;
+    mf->buf_pos--;
+    mf->trackpos--;
 }
 
 /*
@@ -297,6 +314,26 @@ fluid_midi_file_read(fluid_midi_file *mf, void *buf, int len)
     return (num != len) ? FLUID_FAILED : FLUID_OK;
 }
 
+/*
+ * Returns a pointer to the next len bytes of the file and skips them,
+ * NULL if there aren't enough bytes left.
+ */
+char *
+fluid_midi_file_get_data(fluid_midi_file *mf, int len)
+{
+    char *data = mf->buffer + mf->buf_pos;
+
+    if(len > mf->buf_len - mf->buf_pos)
+    {
+        mf->eof = TRUE;
+        return NULL;
+    }
+
+    mf->buf_pos += len;
+    mf->trackpos += len;
+    return data;
+}
+
 /*
  * fluid_midi_file_skip
  */
@@ -320,20 +357,6 @@ fluid_midi_file_skip(fluid_midi_file *mf, int skip)
     return FLUID_OK;
 }
 
-/*
- * fluid_midi_file_eof
- */
-int fluid_midi_file_eof(fluid_midi_file *mf)
-{
-    /* Note: This does not simply test whether the file read pointer is past
-     * the end of the file. It mimics the behaviour of feof by actually
-     * testing the stateful EOF condition, which is set to TRUE if getc or
-     * fread have attempted to read past the end (but not if they have
-     * precisely reached the end), but reset to FALSE upon a successful seek.
-     */
-    return mf->eof;
-}
-
 /*
  * fluid_midi_file_read_mthd
  */
@@ -384,21 +407,95 @@ fluid_midi_file_read_mthd(fluid_midi_file *mf)
 
 /*
  * fluid_midi_file_load_tracks
+ * The tracks are found one after the other from the lengths in their headers, then their events
+ * are read in parallel, each track from a copy of the file handle of its own.
  */
 int
 fluid_midi_file_load_tracks(fluid_midi_file *mf, fluid_player_t *player)
 {
-    int i;
+    fluid_midi_file *cursors;
+    fluid_track_t **tracks;
+    int i, n = mf->ntracks, result = FLUID_OK;
 
-    for(i = 0; i < mf->ntracks; i++)
+    if(n == 0)
+    {
+        return FLUID_OK;
+    }
+
+    if(n > MAX_NUMBER_OF_TRACKS)
+    {
+        FLUID_LOG(FLUID_ERR, "Too many tracks in the MIDI file");
+        return FLUID_FAILED;
+    }
+
+    cursors = FLUID_ARRAY(fluid_midi_file, n);
+    tracks = FLUID_ARRAY(fluid_track_t *, n);
+
+    if(cursors == NULL || tracks == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(cursors);
+        FLUID_FREE(tracks);
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(tracks, 0, n * sizeof(*tracks));
+
+    for(i = 0; i < n; i++)
     {
-        if(fluid_midi_file_read_track(mf, player, i) != FLUID_OK)
+        if(fluid_midi_file_find_track(mf) != FLUID_OK)
         {
-            return FLUID_FAILED;
+            result = FLUID_FAILED;
+            break;
+        }
+
+        cursors[i] = *mf;
+
+        if(fluid_midi_file_skip(mf, mf->tracklen) != FLUID_OK)
+        {
+            result = FLUID_FAILED;
+            break;
         }
     }
 
-    return FLUID_OK;
+    if(result == FLUID_OK)
+    {
+        #pragma omp parallel if(n > 1)
+        #pragma omp single
+        for(i = 0; i < n; i++)
+        {
+            #pragma omp task firstprivate(i) shared(cursors, tracks, result) default(none)
+            {
+                tracks[i] = fluid_midi_file_read_track(&cursors[i], i);
+
+                if(tracks[i] == NULL)
+                {
+                    #pragma omp critical
+                    {
+                        result = FLUID_FAILED;
+                    }
+                }
+            }
+        }
+    }
+
+    /* keep the tracks in the order of the file */
+    for(i = 0; i < n; i++)
+    {
+        if(result == FLUID_OK)
+        {
+            fluid_player_add_track(player, tracks[i]);
+        }
+        else
+        {
+            delete_fluid_track(tracks[i]);
+        }
+    }
+
+    FLUID_FREE(cursors);
+    FLUID_FREE(tracks);
+
+    return result;
 }
 
 /*
@@ -473,104 +570,77 @@ fluid_midi_file_eot(fluid_midi_file *mf)
 }
 
 /*
- * fluid_midi_file_read_track
+ * fluid_midi_file_find_track
+ * Skips any unknown chunks up to the next track and reads its length.
  */
 int
-fluid_midi_file_read_track(fluid_midi_file *mf, fluid_player_t *player, int num)
+fluid_midi_file_find_track(fluid_midi_file *mf)
 {
-    fluid_track_t *track;
     unsigned char id[5], length[5];
-    int found_track = 0;
-    int skip;
 
-    if(fluid_midi_file_read(mf, id, 4) != FLUID_OK)
+    while(TRUE)
     {
-        return FLUID_FAILED;
-    }
-
-    id[4] = '\0';
-    mf->dtime = 0;
+        if(fluid_midi_file_read(mf, id, 4) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
 
-    while(!found_track)
-    {
+        id[4] = '\0';
 
         if(fluid_isasciistring((char *) id) == 0)
         {
             FLUID_LOG(FLUID_ERR,
                       "A non-ascii track header found, corrupt file");
             return FLUID_FAILED;
-
         }
-        else if(FLUID_STRCMP((char *) id, "MTrk") == 0)
-        {
-
-            found_track = 1;
-
-            if(fluid_midi_file_read_tracklen(mf) != FLUID_OK)
-            {
-                return FLUID_FAILED;
-            }
-
-            track = new_fluid_track(num);
-
-            if(track == NULL)
-            {
-                FLUID_LOG(FLUID_ERR, "Out of memory");
-                return FLUID_FAILED;
-            }
-
-            while(!fluid_midi_file_eot(mf))
-            {
-                if(fluid_midi_file_read_event(mf, track) != FLUID_OK)
-                {
-                    delete_fluid_track(track);
-                    return FLUID_FAILED;
-                }
-            }
-
-            /* Skip remaining track data, if any */
-            if(mf->trackpos < mf->tracklen)
-            {
-                if(fluid_midi_file_skip(mf, mf->tracklen - mf->trackpos) != FLUID_OK)
-                {
-                    delete_fluid_track(track);
-                    return FLUID_FAILED;
-                }
-            }
-
-            if(fluid_player_add_track(player, track) != FLUID_OK)
-            {
-                delete_fluid_track(track);
-                return FLUID_FAILED;
-            }
 
+        if(FLUID_STRCMP((char *) id, "MTrk") == 0)
+        {
+            return fluid_midi_file_read_tracklen(mf);
         }
-        else
+
+        if(fluid_midi_file_read(mf, length, 4) != FLUID_OK)
         {
-            found_track = 0;
+            return FLUID_FAILED;
+        }
 
-            if(fluid_midi_file_read(mf, length, 4) != FLUID_OK)
-            {
-                return FLUID_FAILED;
-            }
+        if(fluid_midi_file_skip(mf, fluid_getlength(length)) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+    }
+}
 
-            skip = fluid_getlength(length);
+/*
+ * fluid_midi_file_read_track
+ * Reads the events of the track found by fluid_midi_file_find_track(). mf may be a copy of the
+ * file handle made then, so that several tracks can be read at the same time.
+ */
+fluid_track_t *
+fluid_midi_file_read_track(fluid_midi_file *mf, int num)
+{
+    fluid_track_t *track = new_fluid_track(num);
 
-            /* fseek(mf->fp, skip, SEEK_CUR); */
-            if(fluid_midi_file_skip(mf, skip) != FLUID_OK)
-            {
-                return FLUID_FAILED;
-            }
-        }
+    if(track == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
     }
 
-    if(fluid_midi_file_eof(mf))
+    /* a running status doesn't carry over from the previous track */
+    mf->running_status = 0;
+    mf->dtime = 0;
+
+    while(!fluid_midi_file_eot(mf))
     {
-        FLUID_LOG(FLUID_ERR, "Unexpected end of file");
-        return FLUID_FAILED;
+        if(fluid_midi_file_read_event(mf, track) != FLUID_OK)
+        {
+            delete_fluid_track(track);
+            return NULL;
+        }
     }
 
-    return FLUID_OK;
+    return track;
 }
 
 /*
@@ -627,12 +697,15 @@ fluid_midi_file_read_event(fluid_midi_file *mf, fluid_track_t *track)
     unsigned char *dyn_buf = NULL;
     unsigned char static_buf[256];
     int nominator, denominator, clocks, notes;
-    fluid_midi_event_t *evt;
+    fluid_midi_event_t evt;
     int channel = 0;
     int param1 = 0;
     int param2 = 0;
     int size;
 
+    /* events are copied into the track */
+    FLUID_MEMSET(&evt, 0, sizeof(evt));
+
     /* read the delta-time of the event */
     if(fluid_midi_file_read_varlen(mf) != FLUID_OK)
     {
@@ -660,7 +733,7 @@ fluid_midi_file_read_event(fluid_midi_file *mf, fluid_track_t *track)
             return FLUID_FAILED;
         }
 
-        fluid_midi_file_push(mf, status);
+        fluid_midi_file_unget(mf);
         status = mf->running_status;
     }
 
@@ -676,34 +749,33 @@ fluid_midi_file_read_event(fluid_midi_file *mf, fluid_track_t *track)
 
         if(mf->varlen)
         {
-            FLUID_LOG(FLUID_DBG, "%s: %d: alloc metadata, len = %d", __FILE__,
-                      __LINE__, mf->varlen);
-            metadata = FLUID_MALLOC(mf->varlen + 1);
+            /* read the data of the message */
+            char *data = fluid_midi_file_get_data(mf, mf->varlen);
 
-            if(metadata == NULL)
+            if(data == NULL)
             {
-                FLUID_LOG(FLUID_PANIC, "Out of memory");
+                FLUID_LOG(FLUID_DBG, "Failed to read data of SYSEX msg (track=%d)", track->num);
                 return FLUID_FAILED;
             }
 
-            /* read the data of the message */
-            if(fluid_midi_file_read(mf, metadata, mf->varlen) != FLUID_OK)
+            if(mf->persistent)
             {
-                FLUID_LOG(FLUID_DBG, "Failed to read data of SYSEX msg (track=%d)", track->num);
-                FLUID_FREE(metadata);
-                return FLUID_FAILED;
+                /* the buffer outlives the event, no need to copy the data */
+                metadata = (unsigned char *)data;
             }
+            else
+            {
+                metadata = fluid_track_alloc_payload(track, mf->varlen);
 
-            evt = new_fluid_midi_event();
+                if(metadata == NULL)
+                {
+                    return FLUID_FAILED;
+                }
 
-            if(evt == NULL)
-            {
-                FLUID_LOG(FLUID_ERR, "Out of memory");
-                FLUID_FREE(metadata);
-                return FLUID_FAILED;
+                FLUID_MEMCPY(metadata, data, mf->varlen);
             }
 
-            evt->dtime = mf->dtime;
+            evt.dtime = mf->dtime;
             size = mf->varlen;
 
             if(metadata[mf->varlen - 1] == MIDI_EOX)
@@ -711,9 +783,14 @@ fluid_midi_file_read_event(fluid_midi_file *mf, fluid_track_t *track)
                 size--;
             }
 
-            /* Add SYSEX event and indicate that its dynamically allocated and should be freed with event */
-            fluid_midi_event_set_sysex(evt, metadata, size, TRUE);
-            fluid_track_add_event(track, evt);
+            /* Add SYSEX event, the data is owned by the track or the buffer */
+            fluid_midi_event_set_sysex(&evt, metadata, size, FALSE);
+
+            if(fluid_track_add_event(track, &evt) != FLUID_OK)
+            {
+                return FLUID_FAILED;
+            }
+
             mf->dtime = 0;
         }
 
@@ -801,32 +878,20 @@ fluid_midi_file_read_event(fluid_midi_file *mf, fluid_track_t *track)
             /* NULL terminate strings for safety */
             metadata[size - 1] = '\0';
 
-            evt = new_fluid_midi_event();
-
-            if(evt == NULL)
-            {
-                FLUID_LOG(FLUID_ERR, "Out of memory");
-                result = FLUID_FAILED;
-                break;
-            }
-
-            evt->dtime = mf->dtime;
+            evt.dtime = mf->dtime;
 
-            tmp = FLUID_MALLOC(size);
+            tmp = fluid_track_alloc_payload(track, size);
 
             if(tmp == NULL)
             {
-                FLUID_LOG(FLUID_PANIC, "Out of memory");
-                delete_fluid_midi_event(evt);
-                evt = NULL;
                 result = FLUID_FAILED;
                 break;
             }
 
             FLUID_MEMCPY(tmp, metadata, size);
 
-            fluid_midi_event_set_sysex_LOCAL(evt, type, tmp, size, TRUE);
-            fluid_track_add_event(track, evt);
+            fluid_midi_event_set_sysex_LOCAL(&evt, type, tmp, size, FALSE);
+            result = fluid_track_add_event(track, &evt);
             mf->dtime = 0;
         }
         break;
@@ -846,18 +911,9 @@ fluid_midi_file_read_event(fluid_midi_file *mf, fluid_track_t *track)
             }
 
             mf->eot = 1;
-            evt = new_fluid_midi_event();
-
-            if(evt == NULL)
-            {
-                FLUID_LOG(FLUID_ERR, "Out of memory");
-                result = FLUID_FAILED;
-                break;
-            }
-
-            evt->dtime = mf->dtime;
-            evt->type = MIDI_EOT;
-            fluid_track_add_event(track, evt);
+            evt.dtime = mf->dtime;
+            evt.type = MIDI_EOT;
+            result = fluid_track_add_event(track, &evt);
             mf->dtime = 0;
             break;
 
@@ -871,21 +927,12 @@ fluid_midi_file_read_event(fluid_midi_file *mf, fluid_track_t *track)
             }
 
             tempo = (metadata[0] << 16) + (metadata[1] << 8) + metadata[2];
-            evt = new_fluid_midi_event();
-
-            if(evt == NULL)
-            {
-                FLUID_LOG(FLUID_ERR, "Out of memory");
-                result = FLUID_FAILED;
-                break;
-            }
-
-            evt->dtime = mf->dtime;
-            evt->type = MIDI_SET_TEMPO;
-            evt->channel = 0;
-            evt->param1 = tempo;
-            evt->param2 = 0;
-            fluid_track_add_event(track, evt);
+            evt.dtime = mf->dtime;
+            evt.type = MIDI_SET_TEMPO;
+            evt.channel = 0;
+            evt.param1 = tempo;
+            evt.param2 = 0;
+            result = fluid_track_add_event(track, &evt);
             mf->dtime = 0;
             break;
 
@@ -1027,20 +1074,17 @@ fluid_midi_file_read_event(fluid_midi_file *mf, fluid_track_t *track)
             return FLUID_FAILED;
         }
 
-        evt = new_fluid_midi_event();
+        evt.dtime = mf->dtime;
+        evt.type = type;
+        evt.channel = channel;
+        evt.param1 = param1;
+        evt.param2 = param2;
 
-        if(evt == NULL)
+        if(fluid_track_add_event(track, &evt) != FLUID_OK)
         {
-            FLUID_LOG(FLUID_ERR, "Out of memory");
             return FLUID_FAILED;
         }
 
-        evt->dtime = mf->dtime;
-        evt->type = type;
-        evt->channel = channel;
-        evt->param1 = param1;
-        evt->param2 = param2;
-        fluid_track_add_event(track, evt);
         mf->dtime = 0;
     }
 
@@ -1061,20 +1105,31 @@ fluid_midi_file_get_division(fluid_midi_file *midifile)
  *     fluid_track_t
  */
 
+/* MIDI events deleted by the application, reused by new_fluid_midi_event() */
+static fluid_object_cache_t fluid_midi_event_cache = FLUID_OBJECT_CACHE_INIT;
+
 /**
  * Create a MIDI event structure.
  * @return New MIDI event structure or NULL when out of memory.
+ *
+ * Deleted events are kept in a small lock-free cache shared by all threads and handed out
+ * again, so creating and deleting events at a high rate doesn't stress the memory allocator.
  */
 fluid_midi_event_t *
 new_fluid_midi_event(void)
 {
     fluid_midi_event_t *evt;
-    evt = FLUID_NEW(fluid_midi_event_t);
+    evt = fluid_object_cache_take(&fluid_midi_event_cache);
 
     if(evt == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return NULL;
+        evt = FLUID_NEW(fluid_midi_event_t);
+
+        if(evt == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return NULL;
+        }
     }
 
     evt->dtime = 0;
@@ -1082,6 +1137,7 @@ new_fluid_midi_event(void)
     evt->channel = 0;
     evt->param1 = 0;
     evt->param2 = 0;
+    evt->ingress = 0;
     evt->next = NULL;
     evt->paramptr = NULL;
     return evt;
@@ -1108,7 +1164,11 @@ delete_fluid_midi_event(fluid_midi_event_t *evt)
             FLUID_FREE(evt->paramptr);
         }
 
-        FLUID_FREE(evt);
+        if(!fluid_object_cache_put(&fluid_midi_event_cache, evt))
+        {
+            FLUID_FREE(evt);
+        }
+
         evt = temp;
     }
 }
@@ -1438,10 +1498,10 @@ new_fluid_track(int num)
 
     track->name = NULL;
     track->num = num;
-    track->first = NULL;
-    track->cur = NULL;
-    track->last = NULL;
-    track->ticks = 0;
+    track->events = NULL;
+    track->nevents = 0;
+    track->size = 0;
+    track->arena = NULL;
     return track;
 }
 
@@ -1454,7 +1514,8 @@ delete_fluid_track(fluid_track_t *track)
     fluid_return_if_fail(track != NULL);
 
     FLUID_FREE(track->name);
-    delete_fluid_midi_event(track->first);
+    FLUID_FREE(track->events);
+    delete_fluid_arena(track->arena);
     FLUID_FREE(track);
 }
 
@@ -1491,165 +1552,1084 @@ fluid_track_set_name(fluid_track_t *track, char *name)
 }
 
 /*
- * fluid_track_get_duration
+ * fluid_track_add_event
+ * Appends a copy of the event. Its data, if any, must have been allocated
+ * by fluid_track_alloc_payload().
  */
 int
-fluid_track_get_duration(fluid_track_t *track)
+fluid_track_add_event(fluid_track_t *track, const fluid_midi_event_t *evt)
 {
-    int time = 0;
-    fluid_midi_event_t *evt = track->first;
+    fluid_midi_event_t *events;
+    int size;
 
-    while(evt != NULL)
+    if(track->nevents == track->size)
     {
-        time += evt->dtime;
-        evt = evt->next;
-    }
-
-    return time;
-}
+        size = (track->size > 0) ? 2 * track->size : FLUID_TRACK_INITIAL_EVENTS;
+        events = FLUID_REALLOC(track->events, size * sizeof(*events));
 
-/*
- * fluid_track_add_event
- */
-int
-fluid_track_add_event(fluid_track_t *track, fluid_midi_event_t *evt)
-{
-    evt->next = NULL;
+        if(events == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
 
-    if(track->first == NULL)
-    {
-        track->first = evt;
-        track->cur = evt;
-        track->last = evt;
-    }
-    else
-    {
-        track->last->next = evt;
-        track->last = evt;
+        track->events = events;
+        track->size = size;
     }
 
+    track->events[track->nevents] = *evt;
+    track->events[track->nevents].next = NULL;
+    track->nevents++;
+
     return FLUID_OK;
 }
 
 /*
- * fluid_track_next_event
+ * fluid_track_alloc_payload
+ * Allocates the data of a SYSEX or text event, living as long as the track.
  */
-fluid_midi_event_t *
-fluid_track_next_event(fluid_track_t *track)
+void *
+fluid_track_alloc_payload(fluid_track_t *track, int size)
 {
-    if(track->cur != NULL)
+    if(track->arena == NULL)
     {
-        track->cur = track->cur->next;
+        track->arena = new_fluid_arena(FLUID_TRACK_ARENA_BLOCK_SIZE);
+
+        if(track->arena == NULL)
+        {
+            return NULL;
+        }
     }
 
-    return track->cur;
+    return fluid_arena_alloc(track->arena, size);
 }
 
-/*
- * fluid_track_reset
+/******************************************************
+ *
+ *     fluid_player
  */
-int
-fluid_track_reset(fluid_track_t *track)
+static void
+fluid_player_handle_reset_synth(void *data, const char *name, int value)
 {
-    track->ticks = 0;
-    track->cur = track->first;
-    return FLUID_OK;
+    fluid_player_t *player = data;
+    fluid_return_if_fail(player != NULL);
+
+    player->reset_synth_between_songs = value;
 }
 
-/*
- * fluid_track_send_events
- */
-static void
-fluid_track_send_events(fluid_track_t *track,
-                        fluid_synth_t *synth,
-                        fluid_player_t *player,
-                        unsigned int ticks,
-                        int seek_ticks
-                       )
+/* Sorting the events of all tracks into the timeline */
+typedef struct
 {
-    fluid_midi_event_t *event;
-    int seeking = seek_ticks >= 0;
-
-    if(seeking)
-    {
-        ticks = seek_ticks; /* update target ticks */
+    unsigned int ticks;
+    int pos;        /* position in the concatenation of all tracks */
+    int track;
+    int index;      /* index of the event in its track */
+} fluid_player_timeline_sort_t;
 
-        // the track ticks is beyond the current ticks,
-        // or if the track ticks is equal to the current ticks,
-        // we want to play all events from the beginning of that tick
-        if(track->ticks >= ticks)
+static int
+fluid_player_timeline_sort_compare(const void *a, const void *b)
+{
+    const fluid_player_timeline_sort_t *left = a, *right = b;
+
+    if(left->ticks != right->ticks)
+    {
+        return (left->ticks < right->ticks) ? -1 : 1;
+    }
+
+    /* events at the same tick keep the order of the tracks */
+    return left->pos - right->pos;
+}
+
+static int
+fluid_player_compare_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/*
+ * Returns the slot of the state an event sets, FLUID_PLAYER_SLOT_KEPT if it always
+ * needs to be replayed when seeking or FLUID_PLAYER_SLOT_NONE if it never needs to be.
+ */
+static int
+fluid_player_event_slot(const fluid_midi_event_t *evt)
+{
+    int chan_slots = (evt->channel % MAX_NUMBER_OF_CHANNELS) * FLUID_PLAYER_CHANNEL_SLOTS;
+
+    switch(evt->type)
+    {
+    case NOTE_ON:
+    case NOTE_OFF:
+    case MIDI_EOT:
+        return FLUID_PLAYER_SLOT_NONE;
+
+    case CONTROL_CHANGE:
+        switch(evt->param1)
         {
-            fluid_track_reset(track);    /* reset track if seeking backwards */
+        case ALL_SOUND_OFF:
+        case ALL_NOTES_OFF:
+            return FLUID_PLAYER_SLOT_NONE;
+
+        /* these depend on the controllers sent before them */
+        case DATA_ENTRY_MSB:
+        case DATA_ENTRY_LSB:
+        case DATA_ENTRY_INCR:
+        case DATA_ENTRY_DECR:
+        case NRPN_LSB:
+        case NRPN_MSB:
+        case RPN_LSB:
+        case RPN_MSB:
+        case ALL_CTRL_OFF:
+        case LOCAL_CONTROL:
+        case OMNI_OFF:
+        case OMNI_ON:
+        case POLY_OFF:
+        case POLY_ON:
+            return FLUID_PLAYER_SLOT_KEPT;
+
+        default:
+            return chan_slots + (evt->param1 & 0x7f);
         }
+
+    case PROGRAM_CHANGE:
+        return chan_slots + FLUID_PLAYER_SLOT_PROGRAM;
+
+    case PITCH_BEND:
+        return chan_slots + FLUID_PLAYER_SLOT_PITCH_BEND;
+
+    case CHANNEL_PRESSURE:
+        return chan_slots + FLUID_PLAYER_SLOT_CHANNEL_PRESSURE;
+
+    case MIDI_SET_TEMPO:
+        return FLUID_PLAYER_SLOT_TEMPO;
+
+    case MIDI_TEXT:
+        return FLUID_PLAYER_SLOT_TEXT;
+
+    case MIDI_LYRIC:
+        return FLUID_PLAYER_SLOT_LYRIC;
+
+    default:
+        /* SYSEX and key pressure */
+        return FLUID_PLAYER_SLOT_KEPT;
     }
+}
 
-    while(1)
+/*
+ * Frees the timeline of the current file.
+ */
+static void
+fluid_player_clear_timeline(fluid_player_t *player)
+{
+    FLUID_FREE(player->events);
+    FLUID_FREE(player->event_ticks);
+    FLUID_FREE(player->kept_events);
+    FLUID_FREE(player->keyframes);
+    FLUID_FREE(player->seek_events);
+    FLUID_FREE(player->tempo_map);
+    FLUID_FREE(player->event_usec);
+    delete_fluid_player_stream(player->stream);
+
+    player->events = NULL;
+    player->event_ticks = NULL;
+    player->kept_events = NULL;
+    player->keyframes = NULL;
+    player->seek_events = NULL;
+    player->tempo_map = NULL;
+    player->event_usec = NULL;
+    player->stream = NULL;
+    player->nevents = 0;
+    player->nkept_events = 0;
+    player->ntempos = 0;
+    player->cur_event = 0;
+}
+
+/*
+ * Builds the tempo map of the timeline and the time of each event at the tempos of the file,
+ * so that the player calculates the exact time of an event from its tick, see
+ * fluid_player_get_event_time(), instead of accumulating the time passed at each tempo change.
+ */
+static int
+fluid_player_build_tempo_map(fluid_player_t *player)
+{
+    fluid_player_tempo_t *tempo;
+    double usec;
+    int i, n = 1;
+
+    for(i = 0; i < player->nevents; i++)
     {
+        n += (player->events[i].type == MIDI_SET_TEMPO);
+    }
 
-        event = track->cur;
+    player->tempo_map = FLUID_ARRAY(fluid_player_tempo_t, n);
+    player->event_usec = FLUID_ARRAY(double, player->nevents);
 
-        if(event == NULL)
+    if(player->tempo_map == NULL || player->event_usec == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* the default tempo of 120 bpm up to the first tempo change */
+    tempo = player->tempo_map;
+    tempo->ticks = 0;
+    tempo->tempo = 500000;
+    tempo->usec = 0.0;
+
+    for(i = 0; i < player->nevents; i++)
+    {
+        usec = tempo->usec + (double)(player->event_ticks[i] - tempo->ticks) * tempo->tempo / player->division;
+        player->event_usec[i] = usec;
+
+        if(player->events[i].type == MIDI_SET_TEMPO)
         {
-            return;
+            /* the last of several tempo changes at the same tick is in effect */
+            if(player->event_ticks[i] != tempo->ticks)
+            {
+                tempo++;
+                tempo->ticks = player->event_ticks[i];
+                tempo->usec = usec;
+            }
+
+            tempo->tempo = player->events[i].param1;
         }
+    }
 
-        /*         printf("track=%02d\tticks=%05u\ttrack=%05u\tdtime=%05u\tnext=%05u\n", */
-        /*                track->num, */
-        /*                ticks, */
-        /*                track->ticks, */
-        /*                event->dtime, */
-        /*                track->ticks + event->dtime); */
+    player->ntempos = (int)(tempo - player->tempo_map) + 1;
+
+    return FLUID_OK;
+}
 
-        if(track->ticks + event->dtime > ticks)
+/*
+ * Merges the events of all tracks into one timeline, sorted by their absolute tick. Every
+ * FLUID_PLAYER_KEYFRAME_INTERVAL events, a keyframe records the events that make up the state
+ * of the channels at that point, so that seeking only needs to replay those and the events
+ * since the keyframe, instead of all events since the beginning of the file.
+ */
+static int
+fluid_player_build_timeline(fluid_player_t *player)
+{
+    fluid_player_timeline_sort_t *sort = NULL;
+    fluid_player_keyframe_t *keyframe;
+    int slots[FLUID_PLAYER_SLOTS];
+    unsigned int ticks;
+    int i, j, n = 0, slot, kept_size = 0;
+
+    fluid_player_clear_timeline(player);
+
+    for(i = 0; i < player->ntracks; i++)
+    {
+        n += player->track[i]->nevents;
+    }
+
+    if(n == 0)
+    {
+        return FLUID_OK;
+    }
+
+    sort = FLUID_ARRAY(fluid_player_timeline_sort_t, n);
+    player->events = FLUID_ARRAY(fluid_midi_event_t, n);
+    player->event_ticks = FLUID_ARRAY(unsigned int, n);
+    player->keyframes = FLUID_ARRAY(fluid_player_keyframe_t, n / FLUID_PLAYER_KEYFRAME_INTERVAL + 1);
+
+    if(sort == NULL || player->events == NULL || player->event_ticks == NULL || player->keyframes == NULL)
+    {
+        goto error_rec;
+    }
+
+    for(i = 0, n = 0; i < player->ntracks; i++)
+    {
+        ticks = 0;
+
+        for(j = 0; j < player->track[i]->nevents; j++, n++)
         {
-            return;
+            ticks += player->track[i]->events[j].dtime;
+            sort[n].ticks = ticks;
+            sort[n].pos = n;
+            sort[n].track = i;
+            sort[n].index = j;
         }
+    }
+
+    qsort(sort, n, sizeof(*sort), fluid_player_timeline_sort_compare);
+
+    for(i = 0; i < n; i++)
+    {
+        player->events[i] = player->track[sort[i].track]->events[sort[i].index];
+        player->event_ticks[i] = sort[i].ticks;
+    }
+
+    /* the tracks only keep the data of SYSEX and text events */
+    for(i = 0; i < player->ntracks; i++)
+    {
+        FLUID_FREE(player->track[i]->events);
+        player->track[i]->events = NULL;
+        player->track[i]->nevents = player->track[i]->size = 0;
+    }
+
+    FLUID_FREE(sort);
+    sort = NULL;
+    player->nevents = n;
 
-        track->ticks += event->dtime;
+    if(fluid_player_build_tempo_map(player) != FLUID_OK)
+    {
+        goto error_rec;
+    }
+
+    for(i = 0; i < FLUID_PLAYER_SLOTS; i++)
+    {
+        slots[i] = -1;
+    }
 
-        if(!player || event->type == MIDI_EOT)
+    for(i = 0; i < n; i++)
+    {
+        if(i % FLUID_PLAYER_KEYFRAME_INTERVAL == 0)
         {
-            /* don't send EOT events to the callback */
+            keyframe = &player->keyframes[i / FLUID_PLAYER_KEYFRAME_INTERVAL];
+            keyframe->nkept = player->nkept_events;
+            FLUID_MEMCPY(keyframe->slot, slots, sizeof(slots));
         }
-        else if(seeking && track->ticks != ticks && (event->type == NOTE_ON || event->type == NOTE_OFF))
+
+        slot = fluid_player_event_slot(&player->events[i]);
+
+        if(slot == FLUID_PLAYER_SLOT_KEPT)
         {
-            /* skip on/off messages */
+            if(player->nkept_events == kept_size)
+            {
+                int *kept;
+
+                kept_size = (kept_size > 0) ? 2 * kept_size : 64;
+                kept = FLUID_REALLOC(player->kept_events, kept_size * sizeof(*kept));
+
+                if(kept == NULL)
+                {
+                    goto error_rec;
+                }
+
+                player->kept_events = kept;
+            }
+
+            player->kept_events[player->nkept_events++] = i;
         }
-        else
+        else if(slot != FLUID_PLAYER_SLOT_NONE)
         {
-            if(player->playback_callback)
+            if(player->events[i].type == PROGRAM_CHANGE)
             {
-                player->playback_callback(player->playback_userdata, event);
-                if(event->type == NOTE_ON && event->param2 != 0 && !player->channel_isplaying[event->channel])
+                /* the program has been selected from the bank at that time */
+                int chan_slots = slot - FLUID_PLAYER_SLOT_PROGRAM;
+                slots[chan_slots + FLUID_PLAYER_SLOT_PROGRAM_BANK_MSB] = slots[chan_slots + BANK_SELECT_MSB];
+                slots[chan_slots + FLUID_PLAYER_SLOT_PROGRAM_BANK_LSB] = slots[chan_slots + BANK_SELECT_LSB];
+            }
+
+            slots[slot] = i;
+        }
+    }
+
+    player->seek_events = FLUID_ARRAY(int, player->nkept_events + FLUID_PLAYER_SLOTS);
+
+    if(player->seek_events == NULL)
+    {
+        goto error_rec;
+    }
+
+    return FLUID_OK;
+
+error_rec:
+    FLUID_LOG(FLUID_ERR, "Out of memory");
+    FLUID_FREE(sort);
+    fluid_player_clear_timeline(player);
+    return FLUID_FAILED;
+}
+
+/*
+ * Frees a streamed file, along with its contents if owned by it.
+ */
+static void
+delete_fluid_player_stream(fluid_player_stream_t *stream)
+{
+    fluid_return_if_fail(stream != NULL);
+
+    if(stream->map.addr != NULL)
+    {
+        fluid_file_unmap(&stream->map);
+    }
+    else
+    {
+        FLUID_FREE(stream->buffer);
+    }
+
+    FLUID_FREE(stream->start);
+    FLUID_FREE(stream->cursor);
+    FLUID_FREE(stream->track_ticks);
+    delete_fluid_arena(stream->arena);
+    FLUID_FREE(stream);
+}
+
+/*
+ * Reads the next event of a track of a streamed file into the track, which is left empty
+ * at the end of the track.
+ */
+static int
+fluid_player_stream_read_track(fluid_player_t *player, fluid_player_stream_t *stream, int i)
+{
+    fluid_track_t *track = player->track[i];
+    fluid_midi_file *cursor = &stream->cursor[i];
+
+    /* the data of the previous event has been copied to the window */
+    track->nevents = 0;
+
+    if(track->arena != NULL)
+    {
+        fluid_arena_clear(track->arena);
+    }
+
+    /* meta events such as the track name don't make it into the timeline */
+    while(track->nevents == 0 && !fluid_midi_file_eot(cursor))
+    {
+        if(fluid_midi_file_read_event(cursor, track) != FLUID_OK)
+        {
+            cursor->eot = 1;
+            return FLUID_FAILED;
+        }
+    }
+
+    if(track->nevents > 0)
+    {
+        stream->track_ticks[i] += track->events[0].dtime;
+    }
+
+    return FLUID_OK;
+}
+
+/*
+ * Returns the track of a streamed file the next event of the timeline comes from, -1 at the
+ * end of the file.
+ */
+static int
+fluid_player_stream_next_track(fluid_player_t *player, fluid_player_stream_t *stream)
+{
+    int i, next = -1;
+
+    for(i = 0; i < stream->ntracks; i++)
+    {
+        /* events at the same tick keep the order of the tracks */
+        if(player->track[i]->nevents > 0
+                && (next < 0 || stream->track_ticks[i] < stream->track_ticks[next]))
+        {
+            next = i;
+        }
+    }
+
+    return next;
+}
+
+/*
+ * Goes back to the beginning of a streamed file, with an empty window.
+ */
+static int
+fluid_player_stream_rewind(fluid_player_t *player, fluid_player_stream_t *stream)
+{
+    int i, result = FLUID_OK;
+
+    FLUID_MEMCPY(stream->cursor, stream->start, stream->ntracks * sizeof(*stream->cursor));
+
+    for(i = 0; i < stream->ntracks; i++)
+    {
+        stream->track_ticks[i] = 0;
+
+        if(fluid_player_stream_read_track(player, stream, i) != FLUID_OK)
+        {
+            result = FLUID_FAILED;
+        }
+    }
+
+    stream->window_pos = 0;
+    stream->window_ticks = 0;
+    stream->tempo = 0;
+    player->nevents = 0;
+    player->cur_event = 0;
+
+    return result;
+}
+
+/*
+ * Reads a streamed file once for its tempo map and its last tick, the same as
+ * fluid_player_build_tempo_map() does for a file loaded at once.
+ */
+static int
+fluid_player_stream_scan(fluid_player_t *player, fluid_player_stream_t *stream)
+{
+    fluid_player_tempo_t *tempo;
+    const fluid_midi_event_t *evt;
+    unsigned int ticks;
+    double usec;
+    int i, size = 16;
+
+    player->tempo_map = FLUID_ARRAY(fluid_player_tempo_t, size);
+
+    if(player->tempo_map == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    /* the default tempo of 120 bpm up to the first tempo change */
+    tempo = player->tempo_map;
+    tempo->ticks = 0;
+    tempo->tempo = 500000;
+    tempo->usec = 0.0;
+    player->ntempos = 1;
+
+    if(fluid_player_stream_rewind(player, stream) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    while((i = fluid_player_stream_next_track(player, stream)) >= 0)
+    {
+        evt = &player->track[i]->events[0];
+        ticks = stream->track_ticks[i];
+
+        if(evt->type == MIDI_SET_TEMPO)
+        {
+            /* the last of several tempo changes at the same tick is in effect */
+            if(ticks != tempo->ticks)
+            {
+                usec = tempo->usec + (double)(ticks - tempo->ticks) * tempo->tempo / player->division;
+
+                if(player->ntempos == size)
                 {
-                    player->channel_isplaying[event->channel] = TRUE;
+                    fluid_player_tempo_t *tempo_map;
+
+                    size *= 2;
+                    tempo_map = FLUID_REALLOC(player->tempo_map, size * sizeof(*tempo_map));
+
+                    if(tempo_map == NULL)
+                    {
+                        FLUID_LOG(FLUID_ERR, "Out of memory");
+                        return FLUID_FAILED;
+                    }
+
+                    player->tempo_map = tempo_map;
                 }
+
+                tempo = &player->tempo_map[player->ntempos++];
+                tempo->ticks = ticks;
+                tempo->usec = usec;
             }
+
+            tempo->tempo = evt->param1;
         }
 
-        if(event->type == MIDI_SET_TEMPO && player != NULL)
+        stream->total_ticks = ticks;
+
+        if(fluid_player_stream_read_track(player, stream, i) != FLUID_OK)
         {
-            /* memorize the tempo change value coming from the MIDI file */
-            fluid_atomic_int_set(&player->miditempo, event->param1);
-            fluid_player_update_tempo(player);
+            return FLUID_FAILED;
         }
+    }
+
+    return FLUID_OK;
+}
+
+/*
+ * Sets up the playback of a file with player.streaming. Only the beginning of each track is
+ * indexed and the file is read once for its tempo map, its events are decoded again just ahead
+ * of the playhead, see fluid_player_stream_fill(). The stream takes over the contents of the
+ * file if buffer isn't NULL, as long as the file is loaded.
+ */
+static int
+fluid_player_open_stream(fluid_player_t *player, fluid_midi_file *mf, char *buffer,
+                         const fluid_file_map_t *map)
+{
+    fluid_player_stream_t *stream;
+    fluid_track_t *track;
+    int i, n = (mf->ntracks > 0) ? mf->ntracks : 1;
 
-        fluid_track_next_event(track);
+    fluid_player_clear_timeline(player);
 
+    if(mf->ntracks > MAX_NUMBER_OF_TRACKS)
+    {
+        FLUID_LOG(FLUID_ERR, "Too many tracks in the MIDI file");
+        return FLUID_FAILED;
+    }
+
+    stream = FLUID_NEW(fluid_player_stream_t);
+
+    if(stream == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
     }
+
+    FLUID_MEMSET(stream, 0, sizeof(*stream));
+    stream->ntracks = mf->ntracks;
+    stream->start = FLUID_ARRAY(fluid_midi_file, n);
+    stream->cursor = FLUID_ARRAY(fluid_midi_file, n);
+    stream->track_ticks = FLUID_ARRAY(unsigned int, n);
+    stream->arena = new_fluid_arena(FLUID_PLAYER_STREAM_ARENA_BLOCK_SIZE);
+    player->events = FLUID_ARRAY(fluid_midi_event_t, FLUID_PLAYER_STREAM_WINDOW);
+    player->event_ticks = FLUID_ARRAY(unsigned int, FLUID_PLAYER_STREAM_WINDOW);
+    player->event_usec = FLUID_ARRAY(double, FLUID_PLAYER_STREAM_WINDOW);
+
+    if(stream->start == NULL || stream->cursor == NULL || stream->track_ticks == NULL
+            || stream->arena == NULL || player->events == NULL || player->event_ticks == NULL
+            || player->event_usec == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_rec;
+    }
+
+    /* index the beginning of the tracks */
+    for(i = 0; i < mf->ntracks; i++)
+    {
+        if(fluid_midi_file_find_track(mf) != FLUID_OK)
+        {
+            goto error_rec;
+        }
+
+        stream->start[i] = *mf;
+        stream->start[i].dtime = 0;
+        /* a running status doesn't carry over from the previous track */
+        stream->start[i].running_status = 0;
+
+        track = new_fluid_track(i);
+
+        if(track == NULL || fluid_player_add_track(player, track) != FLUID_OK)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            delete_fluid_track(track);
+            goto error_rec;
+        }
+
+        if(fluid_midi_file_skip(mf, mf->tracklen) != FLUID_OK)
+        {
+            goto error_rec;
+        }
+    }
+
+    if(fluid_player_stream_scan(player, stream) != FLUID_OK)
+    {
+        goto error_rec;
+    }
+
+    stream->buffer = buffer;
+
+    if(buffer != NULL)
+    {
+        stream->map = *map;
+    }
+
+    player->stream = stream;
+    fluid_player_stream_rewind(player, stream);
+    fluid_player_stream_fill(player);
+
+    return FLUID_OK;
+
+error_rec:
+    delete_fluid_player_stream(stream);
+    fluid_player_clear_timeline(player);
+    return FLUID_FAILED;
 }
 
-/******************************************************
- *
- *     fluid_player
+/*
+ * Decodes the next events of a streamed file into the timeline, once all events in it have been
+ * played. At the end of the file, the timeline is left as it is, so that its last event stays
+ * available, see fluid_player_playlist_load().
  */
 static void
-fluid_player_handle_reset_synth(void *data, const char *name, int value)
+fluid_player_stream_fill(fluid_player_t *player)
 {
-    fluid_player_t *player = data;
-    fluid_return_if_fail(player != NULL);
+    fluid_player_stream_t *stream = player->stream;
+    const fluid_player_tempo_t *tempo;
+    fluid_midi_event_t *evt;
+    unsigned int ticks;
+    int i, n;
 
-    player->reset_synth_between_songs = value;
+    if(fluid_player_stream_next_track(player, stream) < 0)
+    {
+        return;
+    }
+
+    if(player->nevents > 0)
+    {
+        stream->window_pos += player->nevents;
+        stream->window_ticks = player->event_ticks[player->nevents - 1];
+    }
+
+    fluid_arena_clear(stream->arena);
+
+    for(n = 0; n < FLUID_PLAYER_STREAM_WINDOW; n++)
+    {
+        i = fluid_player_stream_next_track(player, stream);
+
+        if(i < 0)
+        {
+            break;
+        }
+
+        evt = &player->events[n];
+        *evt = player->track[i]->events[0];
+        ticks = stream->track_ticks[i];
+
+        if(evt->type == MIDI_TEXT || evt->type == MIDI_LYRIC)
+        {
+            /* the data of the event lives as long as the window */
+            void *data = fluid_arena_alloc(stream->arena, evt->param1);
+
+            if(data == NULL)
+            {
+                FLUID_LOG(FLUID_ERR, "Out of memory");
+                break;
+            }
+
+            FLUID_MEMCPY(data, evt->paramptr, evt->param1);
+            evt->paramptr = data;
+        }
+
+        while(stream->tempo + 1 < player->ntempos && player->tempo_map[stream->tempo + 1].ticks <= ticks)
+        {
+            stream->tempo++;
+        }
+
+        tempo = &player->tempo_map[stream->tempo];
+        player->event_ticks[n] = ticks;
+        player->event_usec[n] = tempo->usec + (double)(ticks - tempo->ticks) * tempo->tempo / player->division;
+
+        /* the file has been read once already, it can't fail now */
+        fluid_player_stream_read_track(player, stream, i);
+    }
+
+    player->nevents = n;
+    player->cur_event = 0;
+}
+
+/*
+ * Sends an event of the timeline to the playback callback.
+ */
+static void
+fluid_player_send_event(fluid_player_t *player, fluid_midi_event_t *event)
+{
+    if(event->type == MIDI_EOT)
+    {
+        /* don't send EOT events to the callback */
+    }
+    else if(player->playback_callback)
+    {
+        player->playback_callback(player->playback_userdata, event);
+        if(event->type == NOTE_ON && event->param2 != 0 && !player->channel_isplaying[event->channel])
+        {
+            player->channel_isplaying[event->channel] = TRUE;
+        }
+    }
+
+    if(event->type == MIDI_SET_TEMPO)
+    {
+        /* memorize the tempo change value coming from the MIDI file, the tempo map
+           already takes it into account */
+        fluid_atomic_int_set(&player->miditempo, event->param1);
+    }
+}
+
+/*
+ * Restores the state of the channels at the given position of the timeline: replays
+ * the events recorded by the last keyframe before it, and all events since then except
+ * notes.
+ */
+static void
+fluid_player_seek_timeline(fluid_player_t *player, int pos)
+{
+    const fluid_player_keyframe_t *keyframe;
+    int i, n, k;
+
+    if(player->nevents == 0)
+    {
+        return;
+    }
+
+    /* the last keyframe before pos, there is none at the end of the timeline */
+    k = ((pos < player->nevents) ? pos : player->nevents - 1) / FLUID_PLAYER_KEYFRAME_INTERVAL;
+
+    if(player->cur_event > pos || player->cur_event < k * FLUID_PLAYER_KEYFRAME_INTERVAL)
+    {
+        /* start from the keyframe, unless the current position is closer */
+        keyframe = &player->keyframes[k];
+        n = keyframe->nkept;
+        FLUID_MEMCPY(player->seek_events, player->kept_events, n * sizeof(int));
+
+        for(i = 0; i < FLUID_PLAYER_SLOTS; i++)
+        {
+            if(keyframe->slot[i] >= 0)
+            {
+                player->seek_events[n++] = keyframe->slot[i];
+            }
+        }
+
+        /* replay them in their original order */
+        qsort(player->seek_events, n, sizeof(int), fluid_player_compare_int);
+
+        for(i = 0; i < n; i++)
+        {
+            /* a bank select may also be recorded for a program change */
+            if(i == 0 || player->seek_events[i] != player->seek_events[i - 1])
+            {
+                fluid_player_send_event(player, &player->events[player->seek_events[i]]);
+            }
+        }
+
+        player->cur_event = k * FLUID_PLAYER_KEYFRAME_INTERVAL;
+    }
+
+    for(; player->cur_event < pos; player->cur_event++)
+    {
+        fluid_midi_event_t *event = &player->events[player->cur_event];
+
+        if(fluid_player_event_slot(event) != FLUID_PLAYER_SLOT_NONE)
+        {
+            fluid_player_send_event(player, event);
+        }
+    }
+}
+
+/*
+ * Restores the state of the channels at the given tick of a streamed file, like
+ * fluid_player_seek_timeline(): replays all events before it except notes. Seeking
+ * backwards decodes the file again from its beginning.
+ */
+static void
+fluid_player_stream_seek(fluid_player_t *player, unsigned int ticks)
+{
+    fluid_player_stream_t *stream = player->stream;
+    unsigned int played = (player->cur_event > 0) ? player->event_ticks[player->cur_event - 1] : stream->window_ticks;
+
+    if((player->cur_event > 0 || stream->window_pos > 0) && played >= ticks)
+    {
+        fluid_player_stream_rewind(player, stream);
+        fluid_player_stream_fill(player);
+    }
+
+    while(player->cur_event < player->nevents && player->event_ticks[player->cur_event] < ticks)
+    {
+        fluid_midi_event_t *event = &player->events[player->cur_event];
+
+        if(fluid_player_event_slot(event) != FLUID_PLAYER_SLOT_NONE)
+        {
+            fluid_player_send_event(player, event);
+        }
+
+        if(++player->cur_event == player->nevents)
+        {
+            fluid_player_stream_fill(player);
+        }
+    }
+}
+
+/*
+ * Returns the index of the first event of the timeline at or after the given tick.
+ */
+static int
+fluid_player_find_event(fluid_player_t *player, unsigned int ticks)
+{
+    int lo = 0, hi = player->nevents;
+
+    while(lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+
+        if(player->event_ticks[mid] < ticks)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/*
+ * Returns the index of the entry of the tempo map in effect at the given tick, -1 if
+ * no file is loaded.
+ */
+static int
+fluid_player_find_tempo(fluid_player_t *player, double ticks)
+{
+    int lo = 0, hi = player->ntempos;
+
+    while(lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+
+        if(player->tempo_map[mid].ticks <= ticks)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo - 1;
+}
+
+/*
+ * Returns the exact time (msec) of the player: with the sample timer, the time of the
+ * block about to be rendered, which the msec of the callback are rounded from.
+ */
+static double
+fluid_player_get_time(fluid_player_t *player, unsigned int msec)
+{
+    if(player->use_system_timer)
+    {
+        return msec;
+    }
+
+    return fluid_sample_timer_get_ticks(player->synth, player->sample_timer)
+           * 1000.0 / player->synth->sample_rate;
+}
+
+/*
+ * Plays the tick of the timeline at the given time (msec) from now on. The file is played at
+ * the given tempo up to its next tempo change, or at the tempo of the file if it is 0.
+ */
+static void
+fluid_player_set_anchor(fluid_player_t *player, double ticks, double time, int tempo)
+{
+    int k = fluid_player_find_tempo(player, ticks);
+
+    player->anchor_ticks = ticks;
+    player->anchor_time = time;
+    player->anchor_tempo = (tempo > 0) ? tempo : (k >= 0) ? player->tempo_map[k].tempo : 500000;
+    player->anchor_next = k + 1;
+    player->anchor_usec = 0.0;
+
+    if(player->anchor_next < player->ntempos)
+    {
+        const fluid_player_tempo_t *next = &player->tempo_map[player->anchor_next];
+
+        /* the times after the next tempo change are counted from where the tempo of the
+           anchor would have begun to get there in time */
+        player->anchor_usec = next->usec - (next->ticks - ticks) * player->anchor_tempo / player->division;
+    }
+}
+
+/*
+ * Returns the time (msec) the event of the timeline is played at.
+ */
+static double
+fluid_player_get_event_time(fluid_player_t *player, int event)
+{
+    double ticks = player->event_ticks[event];
+    double usec;
+
+    if(!fluid_atomic_int_get(&player->sync_mode))
+    {
+        return player->anchor_time + (ticks - player->anchor_ticks)
+               * fluid_atomic_int_get(&player->exttempo) / player->division / 1000.0;
+    }
+
+    if(player->anchor_next >= player->ntempos || ticks <= player->tempo_map[player->anchor_next].ticks)
+    {
+        usec = (ticks - player->anchor_ticks) * player->anchor_tempo / player->division;
+    }
+    else
+    {
+        usec = player->event_usec[event] - player->anchor_usec;
+    }
+
+    return player->anchor_time + usec / 1000.0 / fluid_atomic_float_get(&player->multempo);
+}
+
+/*
+ * Returns the position of the timeline in ticks at the given time (msec), the inverse of
+ * fluid_player_get_event_time().
+ */
+static double
+fluid_player_get_ticks_at(fluid_player_t *player, double time)
+{
+    const fluid_player_tempo_t *tempo;
+    double usec, ticks;
+    int lo, hi;
+
+    if(!fluid_atomic_int_get(&player->sync_mode))
+    {
+        return player->anchor_ticks + (time - player->anchor_time) * 1000.0
+               * player->division / fluid_atomic_int_get(&player->exttempo);
+    }
+
+    usec = (time - player->anchor_time) * 1000.0 * fluid_atomic_float_get(&player->multempo);
+    ticks = player->anchor_ticks + usec * player->division / player->anchor_tempo;
+
+    if(player->anchor_next >= player->ntempos || ticks <= player->tempo_map[player->anchor_next].ticks)
+    {
+        return ticks;
+    }
+
+    /* the last tempo change before that time */
+    usec += player->anchor_usec;
+    lo = player->anchor_next;
+    hi = player->ntempos;
+
+    while(hi - lo > 1)
+    {
+        int mid = lo + (hi - lo) / 2;
+
+        if(player->tempo_map[mid].usec <= usec)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    tempo = &player->tempo_map[lo];
+
+    return tempo->ticks + (usec - tempo->usec) * player->division / tempo->tempo;
+}
+
+/*
+ * Sends the events of the timeline that are due at the given time (msec). With the sample
+ * timer and synth.sample-accurate-events, the events due within the block about to be
+ * rendered are sent at its start, and start and release their voices at their offset in it.
+ */
+static void
+fluid_player_send_events(fluid_player_t *player, double time)
+{
+    fluid_synth_t *synth = player->synth;
+    int lookahead = !player->use_system_timer && synth->sample_accurate_events;
+    double end = time + (lookahead ? FLUID_BUFSIZE * 1000.0 / synth->sample_rate : 0.0);
+    double due;
+
+    while(player->cur_event < player->nevents)
+    {
+        due = fluid_player_get_event_time(player, player->cur_event);
+
+        if(lookahead ? (due >= end) : (due > end))
+        {
+            break;
+        }
+
+        if(lookahead)
+        {
+            fluid_synth_begin_event_offset(synth, (int)((due - time) * synth->sample_rate / 1000.0));
+            fluid_player_send_event(player, &player->events[player->cur_event]);
+            fluid_synth_end_event_offset(synth);
+        }
+        else
+        {
+            fluid_player_send_event(player, &player->events[player->cur_event]);
+        }
+
+        player->cur_event++;
+
+        if(player->cur_event == player->nevents && player->stream != NULL)
+        {
+            fluid_player_stream_fill(player);
+        }
+    }
 }
 
 static int check_for_on_notes(fluid_synth_t *synth)
@@ -1687,6 +2667,7 @@ new_fluid_player(fluid_synth_t *synth)
         return NULL;
     }
 
+    fluid_mutex_init(player->pinned_m);
     fluid_atomic_int_set(&player->status, FLUID_PLAYER_READY);
     fluid_atomic_int_set(&player->stopping, 0);
     player->loop = 1;
@@ -1697,9 +2678,28 @@ new_fluid_player(fluid_synth_t *synth)
         player->track[i] = NULL;
     }
 
+    player->events = NULL;
+    player->event_ticks = NULL;
+    player->kept_events = NULL;
+    player->keyframes = NULL;
+    player->seek_events = NULL;
+    player->tempo_map = NULL;
+    player->event_usec = NULL;
+    player->stream = NULL;
+    player->nevents = 0;
+    player->nkept_events = 0;
+    player->ntempos = 0;
+    player->cur_event = 0;
+    player->pinned = NULL;
+    player->npinned = 0;
+
     player->synth = synth;
     player->system_timer = NULL;
     player->sample_timer = NULL;
+    player->preload_thread = NULL;
+    player->preload_cond = NULL;
+    player->preload_m = NULL;
+    player->preload = NULL;
     player->playlist = NULL;
     player->currentfile = NULL;
     player->division = 0;
@@ -1712,9 +2712,10 @@ new_fluid_player(fluid_synth_t *synth)
     /* tempo multiplier */
     player->multempo = 1.0F;
 
-    player->deltatime = 4.0;
     player->cur_msec = 0;
+    player->cur_time = 0.0;
     player->cur_ticks = 0;
+    fluid_player_set_anchor(player, 0.0, 0.0, 0);
     player->end_msec = -1;
     player->end_pedals_disabled = 0;
     player->last_callback_ticks = -1;
@@ -1725,7 +2726,7 @@ new_fluid_player(fluid_synth_t *synth)
                                "player.timing-source", "system");
     if(player->use_system_timer)
     {
-        player->system_timer = new_fluid_timer((int) player->deltatime,
+        player->system_timer = new_fluid_timer(FLUID_PLAYER_SYSTEM_TIMER_MS,
                                                fluid_player_callback, player, TRUE, FALSE, TRUE);
 
         if(player->system_timer == NULL)
@@ -1738,10 +2739,46 @@ new_fluid_player(fluid_synth_t *synth)
         player->sample_timer = new_fluid_sample_timer(player->synth,
                                fluid_player_callback, player);
 
-        if(player->sample_timer == NULL)
-        {
-            goto err;
-        }
+        if(player->sample_timer == NULL)
+        {
+            goto err;
+        }
+    }
+
+    fluid_settings_getint(synth->settings, "player.gapless", &i);
+    player->gapless = (i != 0);
+
+    fluid_settings_getint(synth->settings, "player.streaming", &i);
+    player->streaming = (i != 0);
+
+    /* pinning only makes a difference to presets loaded on demand */
+    fluid_settings_getint(synth->settings, "player.preload-presets", &i);
+    player->preload_presets = (i != 0);
+    fluid_settings_getint(synth->settings, "synth.dynamic-sample-loading", &i);
+    player->preload_presets &= (i != 0);
+
+    player->preload_state = FLUID_PLAYER_PRELOAD_IDLE;
+    player->preload_item = NULL;
+    player->preload_cond = new_fluid_cond();
+    player->preload_m = new_fluid_cond_mutex();
+    player->preload = FLUID_NEW(fluid_player_t);
+
+    if(player->preload_cond == NULL || player->preload_m == NULL || player->preload == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto err;
+    }
+
+    FLUID_MEMSET(player->preload, 0, sizeof(*player->preload));
+    player->preload->streaming = player->streaming;
+    player->preload->preload_presets = player->preload_presets;
+    player->preload->synth = synth;
+    player->preload_thread = new_fluid_thread("player-preload", fluid_player_preload_thread, player, 0, FALSE);
+
+    if(player->preload_thread == NULL)
+    {
+        /* the files are loaded by the timer then */
+        FLUID_LOG(FLUID_WARN, "Failed to create the thread preloading the playlist");
     }
 
     fluid_settings_getint(synth->settings, "player.reset-synth", &i);
@@ -1776,11 +2813,40 @@ delete_fluid_player(fluid_player_t *player)
                                 NULL, NULL);
 
     fluid_player_stop(player);
+    fluid_player_unpin_presets(player, player);
     fluid_player_reset(player);
 
     delete_fluid_timer(player->system_timer);
     delete_fluid_sample_timer(player->synth, player->sample_timer);
 
+    if(player->preload_thread != NULL)
+    {
+        fluid_cond_mutex_lock(player->preload_m);
+        player->preload_state = FLUID_PLAYER_PRELOAD_TERMINATE;
+        fluid_cond_broadcast(player->preload_cond);
+        fluid_cond_mutex_unlock(player->preload_m);
+
+        fluid_thread_join(player->preload_thread);
+        delete_fluid_thread(player->preload_thread);
+    }
+
+    if(player->preload != NULL)
+    {
+        fluid_player_unpin_presets(player, player->preload);
+        fluid_player_reset(player->preload);
+        FLUID_FREE(player->preload);
+    }
+
+    if(player->preload_cond != NULL)
+    {
+        delete_fluid_cond(player->preload_cond);
+    }
+
+    if(player->preload_m != NULL)
+    {
+        delete_fluid_cond_mutex(player->preload_m);
+    }
+
     while(player->playlist != NULL)
     {
         q = player->playlist->next;
@@ -1792,6 +2858,7 @@ delete_fluid_player(fluid_player_t *player)
         player->playlist = q;
     }
 
+    fluid_mutex_destroy(player->pinned_m);
     FLUID_FREE(player);
 }
 
@@ -1809,6 +2876,15 @@ fluid_player_settings(fluid_settings_t *settings)
 
     /* Selects whether the player should reset the synth between songs, or not. */
     fluid_settings_register_int(settings, "player.reset-synth", 1, 0, 1, FLUID_HINT_TOGGLED);
+
+    /* Selects whether the next song starts at the end of the previous one, or when it's loaded. */
+    fluid_settings_register_int(settings, "player.gapless", 0, 0, 1, FLUID_HINT_TOGGLED);
+
+    /* Selects whether the events of the files are decoded while playing them, or all at once when loading them. */
+    fluid_settings_register_int(settings, "player.streaming", 0, 0, 1, FLUID_HINT_TOGGLED);
+
+    /* Selects whether the presets a MIDI file selects are loaded before playing it, with synth.dynamic-sample-loading. */
+    fluid_settings_register_int(settings, "player.preload-presets", 1, 0, 1, FLUID_HINT_TOGGLED);
 }
 
 
@@ -1826,6 +2902,8 @@ fluid_player_reset(fluid_player_t *player)
         }
     }
 
+    fluid_player_clear_timeline(player);
+
     for(i = 0; i < MAX_NUMBER_OF_CHANNELS; i++)
     {
         player->channel_isplaying[i] = FALSE;
@@ -1837,7 +2915,6 @@ fluid_player_reset(fluid_player_t *player)
     player->ntracks = 0;
     player->division = 0;
     player->miditempo = 500000;
-    player->deltatime = 4.0;
     return 0;
 }
 
@@ -1910,180 +2987,509 @@ fluid_player_set_tick_callback(fluid_player_t *player, handle_midi_tick_func_t h
  * @param midifile File name of the MIDI file to add
  * @return #FLUID_OK or #FLUID_FAILED
  */
-int
-fluid_player_add(fluid_player_t *player, const char *midifile)
+int
+fluid_player_add(fluid_player_t *player, const char *midifile)
+{
+    fluid_playlist_item *pi = FLUID_MALLOC(sizeof(fluid_playlist_item));
+    char *f = FLUID_STRDUP(midifile);
+
+    if(!pi || !f)
+    {
+        FLUID_FREE(pi);
+        FLUID_FREE(f);
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    pi->filename = f;
+    pi->buffer = NULL;
+    pi->buffer_len = 0;
+    player->playlist = fluid_list_append(player->playlist, pi);
+    return FLUID_OK;
+}
+
+/**
+ * Add a MIDI file to a player queue, from a buffer in memory.
+ * @param player MIDI player instance
+ * @param buffer Pointer to memory containing the bytes of a complete MIDI
+ *   file. The data is copied, so the caller may free or modify it immediately
+ *   without affecting the playlist.
+ * @param len Length of the buffer, in bytes.
+ * @return #FLUID_OK or #FLUID_FAILED
+ */
+int
+fluid_player_add_mem(fluid_player_t *player, const void *buffer, size_t len)
+{
+    /* Take a copy of the buffer, so the caller can free immediately. */
+    fluid_playlist_item *pi = FLUID_MALLOC(sizeof(fluid_playlist_item));
+    void *buf_copy = FLUID_MALLOC(len);
+
+    if(!pi || !buf_copy)
+    {
+        FLUID_FREE(pi);
+        FLUID_FREE(buf_copy);
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMCPY(buf_copy, buffer, len);
+    pi->filename = NULL;
+    pi->buffer = buf_copy;
+    pi->buffer_len = len;
+    player->playlist = fluid_list_append(player->playlist, pi);
+    return FLUID_OK;
+}
+
+/*
+ * fluid_player_load
+ */
+int
+fluid_player_load(fluid_player_t *player, fluid_playlist_item *item)
+{
+    fluid_midi_file *midifile;
+    fluid_file_map_t map = { NULL, 0 };
+    char *buffer;
+    size_t buffer_length;
+    int buffer_owned;
+    int result;
+
+    if(item->filename != NULL)
+    {
+        fluid_file fp;
+        /* This file is specified by filename; load the file from disk */
+        FLUID_LOG(FLUID_DBG, "%s: %d: Loading midifile %s", __FILE__, __LINE__,
+                  item->filename);
+        /* Map or read the entire contents of the file into the buffer */
+        fp = FLUID_FOPEN(item->filename, "rb");
+
+        if(fp == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Couldn't open the MIDI file");
+            return FLUID_FAILED;
+        }
+
+        buffer = fluid_file_read_full(fp, &buffer_length, &map);
+
+        FLUID_FCLOSE(fp);
+
+        if(buffer == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        /* Free or unmap the buffer once the file is loaded, the events are copied,
+           unless the file is streamed */
+        buffer_owned = 1;
+    }
+    else
+    {
+        /* This file is specified by a pre-loaded buffer; load from memory */
+        FLUID_LOG(FLUID_DBG, "%s: %d: Loading midifile from memory (%p)",
+                  __FILE__, __LINE__, item->buffer);
+        buffer = (char *) item->buffer;
+        buffer_length = item->buffer_len;
+        /* Do not free the buffer (it is owned by the playlist and outlives the events) */
+        buffer_owned = 0;
+    }
+
+    midifile = new_fluid_midi_file(buffer, buffer_length, !buffer_owned || player->streaming);
+
+    if(midifile == NULL)
+    {
+        result = FLUID_FAILED;
+    }
+    else
+    {
+        player->division = fluid_midi_file_get_division(midifile);
+        /*FLUID_LOG(FLUID_DBG, "quarter note division=%d\n", player->division); */
+
+        if(player->division == 0)
+        {
+            FLUID_LOG(FLUID_ERR, "Invalid division of the MIDI file");
+            result = FLUID_FAILED;
+        }
+        else if(player->streaming)
+        {
+            result = fluid_player_open_stream(player, midifile, buffer_owned ? buffer : NULL, &map);
+        }
+        else
+        {
+            result = fluid_midi_file_load_tracks(midifile, player);
+        }
+
+        delete_fluid_midi_file(midifile);
+    }
+
+    if(buffer_owned && player->stream == NULL)
+    {
+        if(map.addr != NULL)
+        {
+            fluid_file_unmap(&map);
+        }
+        else
+        {
+            FLUID_FREE(buffer);
+        }
+    }
+
+    if(result != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    return (player->stream != NULL) ? FLUID_OK : fluid_player_build_timeline(player);
+}
+
+void
+fluid_player_advancefile(fluid_player_t *player)
+{
+    if(player->playlist == NULL)
+    {
+        return; /* No files to play */
+    }
+
+    if(player->currentfile != NULL)
+    {
+        player->currentfile = fluid_list_next(player->currentfile);
+    }
+
+    if(player->currentfile == NULL)
+    {
+        if(player->loop == 0)
+        {
+            return; /* We're done playing */
+        }
+
+        if(player->loop > 0)
+        {
+            player->loop--;
+        }
+
+        player->currentfile = player->playlist;
+    }
+}
+
+/*
+ * Exchanges the loaded files of two players: their tracks, their timelines, their divisions
+ * and the presets pinned for them.
+ */
+static void
+fluid_player_swap_file(fluid_player_t *player, fluid_player_t *other)
+{
+    fluid_player_t tmp;
+
+    /* copies the arrays of tracks along */
+    FLUID_MEMCPY(&tmp, player, sizeof(tmp));
+
+#define FLUID_PLAYER_SWAP(_field) \
+    player->_field = other->_field; \
+    other->_field = tmp._field
+
+    FLUID_PLAYER_SWAP(ntracks);
+    FLUID_PLAYER_SWAP(events);
+    FLUID_PLAYER_SWAP(event_ticks);
+    FLUID_PLAYER_SWAP(nevents);
+    FLUID_PLAYER_SWAP(kept_events);
+    FLUID_PLAYER_SWAP(nkept_events);
+    FLUID_PLAYER_SWAP(keyframes);
+    FLUID_PLAYER_SWAP(seek_events);
+    FLUID_PLAYER_SWAP(tempo_map);
+    FLUID_PLAYER_SWAP(ntempos);
+    FLUID_PLAYER_SWAP(event_usec);
+    FLUID_PLAYER_SWAP(stream);
+    FLUID_PLAYER_SWAP(division);
+    FLUID_PLAYER_SWAP(pinned);
+    FLUID_PLAYER_SWAP(npinned);
+
+#undef FLUID_PLAYER_SWAP
+
+    FLUID_MEMCPY(player->track, other->track, sizeof(player->track));
+    FLUID_MEMCPY(other->track, tmp.track, sizeof(other->track));
+}
+
+/*
+ * With player.preload-presets, pins the presets selected by the bank selects and program
+ * changes of the file loaded into file, player or player->preload, so that their samples are
+ * loaded along with the file rather than when playing reaches them. The files loaded by the
+ * preload thread have their presets loaded in the background. With player.streaming, only the
+ * events decoded at load are looked at.
+ */
+static void
+fluid_player_pin_presets(fluid_player_t *player, fluid_player_t *file)
+{
+    enum fluid_midi_channel_type type[MAX_NUMBER_OF_CHANNELS];
+    int bank[MAX_NUMBER_OF_CHANNELS];
+    fluid_player_pinned_preset_t pin, *pinned;
+    fluid_midi_event_t *evt;
+    int i, j, chan;
+
+    if(!player->preload_presets)
+    {
+        return;
+    }
+
+    /* the banks of the channels after a reset */
+    for(chan = 0; chan < MAX_NUMBER_OF_CHANNELS; chan++)
+    {
+        type[chan] = (chan == 9) ? CHANNEL_TYPE_DRUM : CHANNEL_TYPE_MELODIC;
+        bank[chan] = (chan == 9) ? DRUM_INST_BANK : 0;
+    }
+
+    for(i = 0; i < file->nevents; i++)
+    {
+        evt = &file->events[i];
+        chan = fluid_midi_event_get_channel(evt);
+
+        if(chan < 0 || chan >= MAX_NUMBER_OF_CHANNELS || chan >= player->synth->midi_channels)
+        {
+            continue;
+        }
+
+        if(evt->type == CONTROL_CHANGE && (evt->param1 == BANK_SELECT_MSB || evt->param1 == BANK_SELECT_LSB))
+        {
+            bank[chan] = fluid_channel_select_bank(player->synth->bank_select, &type[chan], bank[chan],
+                                                   evt->param1, evt->param2);
+            continue;
+        }
+
+        if(evt->type != PROGRAM_CHANGE
+                || fluid_synth_pin_program(player->synth, type[chan], bank[chan], evt->param1,
+                                           &pin.sfont_id, &pin.bank, &pin.prog) != FLUID_OK)
+        {
+            continue;
+        }
+
+        for(j = 0; j < file->npinned; j++)
+        {
+            if(file->pinned[j].sfont_id == pin.sfont_id && file->pinned[j].bank == pin.bank
+                    && file->pinned[j].prog == pin.prog)
+            {
+                break;
+            }
+        }
+
+        if(j < file->npinned)
+        {
+            continue;
+        }
+
+        /* the other file is looked at by fluid_player_unpin_presets() */
+        fluid_mutex_lock(player->pinned_m);
+        pinned = FLUID_REALLOC(file->pinned, (file->npinned + 1) * sizeof(*pinned));
+
+        if(pinned != NULL)
+        {
+            file->pinned = pinned;
+            file->pinned[file->npinned++] = pin;
+        }
+
+        fluid_mutex_unlock(player->pinned_m);
+
+        if(pinned == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            break;
+        }
+    }
+}
+
+/*
+ * Unpins the presets pinned by fluid_player_pin_presets() for the file loaded into file,
+ * except those the other file, of player or player->preload, uses as well.
+ */
+static void
+fluid_player_unpin_presets(fluid_player_t *player, fluid_player_t *file)
+{
+    fluid_player_t *other = (file == player) ? player->preload : player;
+    fluid_player_pinned_preset_t *pin;
+    int i, j;
+
+    fluid_mutex_lock(player->pinned_m);
+
+    for(i = 0; i < file->npinned; i++)
+    {
+        pin = &file->pinned[i];
+
+        for(j = 0; other != NULL && j < other->npinned; j++)
+        {
+            if(other->pinned[j].sfont_id == pin->sfont_id && other->pinned[j].bank == pin->bank
+                    && other->pinned[j].prog == pin->prog)
+            {
+                break;
+            }
+        }
+
+        if(other == NULL || j == other->npinned)
+        {
+            fluid_synth_unpin_preset(player->synth, pin->sfont_id, pin->bank, pin->prog);
+        }
+    }
+
+    FLUID_FREE(file->pinned);
+    file->pinned = NULL;
+    file->npinned = 0;
+
+    fluid_mutex_unlock(player->pinned_m);
+}
+
+/*
+ * Returns the playlist item played after the current file, NULL if there is none.
+ */
+static fluid_playlist_item *
+fluid_player_next_item(fluid_player_t *player)
 {
-    fluid_playlist_item *pi = FLUID_MALLOC(sizeof(fluid_playlist_item));
-    char *f = FLUID_STRDUP(midifile);
+    fluid_list_t *next = fluid_list_next(player->currentfile);
 
-    if(!pi || !f)
+    if(next == NULL && player->loop != 0)
     {
-        FLUID_FREE(pi);
-        FLUID_FREE(f);
-        FLUID_LOG(FLUID_PANIC, "Out of memory");
-        return FLUID_FAILED;
+        next = player->playlist;
     }
 
-    pi->filename = f;
-    pi->buffer = NULL;
-    pi->buffer_len = 0;
-    player->playlist = fluid_list_append(player->playlist, pi);
-    return FLUID_OK;
+    return (next != NULL) ? (fluid_playlist_item *) next->data : NULL;
 }
 
-/**
- * Add a MIDI file to a player queue, from a buffer in memory.
- * @param player MIDI player instance
- * @param buffer Pointer to memory containing the bytes of a complete MIDI
- *   file. The data is copied, so the caller may free or modify it immediately
- *   without affecting the playlist.
- * @param len Length of the buffer, in bytes.
- * @return #FLUID_OK or #FLUID_FAILED
+/*
+ * Asks the preload thread to load the item played after the current file.
  */
-int
-fluid_player_add_mem(fluid_player_t *player, const void *buffer, size_t len)
+static void
+fluid_player_request_preload(fluid_player_t *player)
 {
-    /* Take a copy of the buffer, so the caller can free immediately. */
-    fluid_playlist_item *pi = FLUID_MALLOC(sizeof(fluid_playlist_item));
-    void *buf_copy = FLUID_MALLOC(len);
+    fluid_playlist_item *item = fluid_player_next_item(player);
 
-    if(!pi || !buf_copy)
+    if(player->preload_thread == NULL || item == NULL)
     {
-        FLUID_FREE(pi);
-        FLUID_FREE(buf_copy);
-        FLUID_LOG(FLUID_PANIC, "Out of memory");
-        return FLUID_FAILED;
+        return;
     }
 
-    FLUID_MEMCPY(buf_copy, buffer, len);
-    pi->filename = NULL;
-    pi->buffer = buf_copy;
-    pi->buffer_len = len;
-    player->playlist = fluid_list_append(player->playlist, pi);
-    return FLUID_OK;
+    fluid_cond_mutex_lock(player->preload_m);
+
+    if(player->preload_state != FLUID_PLAYER_PRELOAD_TERMINATE)
+    {
+        player->preload_item = item;
+        player->preload_state = FLUID_PLAYER_PRELOAD_REQUESTED;
+        fluid_cond_broadcast(player->preload_cond);
+    }
+
+    fluid_cond_mutex_unlock(player->preload_m);
 }
 
 /*
- * fluid_player_load
+ * Thread loading the requested playlist items into player->preload. This also frees the
+ * file that has been played before, which the switch left in player->preload.
  */
-int
-fluid_player_load(fluid_player_t *player, fluid_playlist_item *item)
+static fluid_thread_return_t
+fluid_player_preload_thread(void *data)
 {
-    fluid_midi_file *midifile;
-    char *buffer;
-    size_t buffer_length;
-    int buffer_owned;
+    fluid_player_t *player = data;
+    fluid_playlist_item *item;
+    int result;
 
-    if(item->filename != NULL)
-    {
-        fluid_file fp;
-        /* This file is specified by filename; load the file from disk */
-        FLUID_LOG(FLUID_DBG, "%s: %d: Loading midifile %s", __FILE__, __LINE__,
-                  item->filename);
-        /* Read the entire contents of the file into the buffer */
-        fp = FLUID_FOPEN(item->filename, "rb");
+    fluid_cond_mutex_lock(player->preload_m);
 
-        if(fp == NULL)
+    while(player->preload_state != FLUID_PLAYER_PRELOAD_TERMINATE)
+    {
+        if(player->preload_state != FLUID_PLAYER_PRELOAD_REQUESTED)
         {
-            FLUID_LOG(FLUID_ERR, "Couldn't open the MIDI file");
-            return FLUID_FAILED;
+            fluid_cond_wait(player->preload_cond, player->preload_m);
+            continue;
         }
 
-        buffer = fluid_file_read_full(fp, &buffer_length);
+        item = player->preload_item;
+        player->preload_state = FLUID_PLAYER_PRELOAD_LOADING;
+        fluid_cond_mutex_unlock(player->preload_m);
 
-        FLUID_FCLOSE(fp);
+        fluid_player_unpin_presets(player, player->preload);
+        fluid_player_reset(player->preload);
+        result = fluid_player_load(player->preload, item);
 
-        if(buffer == NULL)
+        if(result == FLUID_OK)
         {
-            return FLUID_FAILED;
+            fluid_player_pin_presets(player, player->preload);
         }
 
-        buffer_owned = 1;
-    }
-    else
-    {
-        /* This file is specified by a pre-loaded buffer; load from memory */
-        FLUID_LOG(FLUID_DBG, "%s: %d: Loading midifile from memory (%p)",
-                  __FILE__, __LINE__, item->buffer);
-        buffer = (char *) item->buffer;
-        buffer_length = item->buffer_len;
-        /* Do not free the buffer (it is owned by the playlist) */
-        buffer_owned = 0;
-    }
-
-    midifile = new_fluid_midi_file(buffer, buffer_length);
+        fluid_cond_mutex_lock(player->preload_m);
 
-    if(midifile == NULL)
-    {
-        if(buffer_owned)
+        /* unless another item has been requested in the meantime */
+        if(player->preload_state == FLUID_PLAYER_PRELOAD_LOADING)
         {
-            FLUID_FREE(buffer);
+            player->preload_state = (result == FLUID_OK) ? FLUID_PLAYER_PRELOAD_READY : FLUID_PLAYER_PRELOAD_FAILED;
+            fluid_cond_broadcast(player->preload_cond);
         }
-
-        return FLUID_FAILED;
     }
 
-    player->division = fluid_midi_file_get_division(midifile);
-    fluid_player_update_tempo(player);  // Update deltatime
-    /*FLUID_LOG(FLUID_DBG, "quarter note division=%d\n", player->division); */
+    fluid_cond_mutex_unlock(player->preload_m);
 
-    if(fluid_midi_file_load_tracks(midifile, player) != FLUID_OK)
-    {
-        if(buffer_owned)
-        {
-            FLUID_FREE(buffer);
-        }
+    return FLUID_THREAD_RETURN_VALUE;
+}
 
-        delete_fluid_midi_file(midifile);
-        return FLUID_FAILED;
+/*
+ * Switches to the given playlist item if the preload thread has loaded it, waiting for it
+ * if it's still being loaded.
+ *
+ * @return TRUE if the player plays the item now, FALSE if it has to be loaded by
+ *   fluid_player_load()
+ */
+static int
+fluid_player_take_preload(fluid_player_t *player, fluid_playlist_item *item)
+{
+    int i, taken;
+
+    if(player->preload_thread == NULL)
+    {
+        return FALSE;
     }
 
-    delete_fluid_midi_file(midifile);
+    fluid_cond_mutex_lock(player->preload_m);
 
-    if(buffer_owned)
+    while(player->preload_item == item
+            && (player->preload_state == FLUID_PLAYER_PRELOAD_REQUESTED
+                || player->preload_state == FLUID_PLAYER_PRELOAD_LOADING))
     {
-        FLUID_FREE(buffer);
+        fluid_cond_wait(player->preload_cond, player->preload_m);
     }
 
-    return FLUID_OK;
-}
+    taken = (player->preload_item == item && player->preload_state == FLUID_PLAYER_PRELOAD_READY);
 
-void
-fluid_player_advancefile(fluid_player_t *player)
-{
-    if(player->playlist == NULL)
+    if(taken)
     {
-        return; /* No files to play */
+        fluid_mutex_lock(player->pinned_m);
+        fluid_player_swap_file(player, player->preload);
+        fluid_mutex_unlock(player->pinned_m);
+        player->preload_state = FLUID_PLAYER_PRELOAD_IDLE;
     }
 
-    if(player->currentfile != NULL)
+    fluid_cond_mutex_unlock(player->preload_m);
+
+    if(!taken)
     {
-        player->currentfile = fluid_list_next(player->currentfile);
+        return FALSE;
     }
 
-    if(player->currentfile == NULL)
+    /* the rest of fluid_player_reset() */
+    for(i = 0; i < MAX_NUMBER_OF_CHANNELS; i++)
     {
-        if(player->loop == 0)
-        {
-            return; /* We're done playing */
-        }
+        player->channel_isplaying[i] = FALSE;
+    }
 
-        if(player->loop > 0)
-        {
-            player->loop--;
-        }
+    player->miditempo = 500000;
+    player->cur_event = 0;
 
-        player->currentfile = player->playlist;
-    }
+    return TRUE;
 }
 
 void
 fluid_player_playlist_load(fluid_player_t *player, unsigned int msec)
 {
     fluid_playlist_item *current_playitem;
-    int i;
+    double start = player->cur_time;
 
-    do
+    /* with player.gapless, the next file starts where the last event of this one has been due */
+    if(player->gapless && player->currentfile != NULL && player->nevents > 0)
+    {
+        start = fluid_player_get_event_time(player, player->nevents - 1);
+    }
+
+    while(1)
     {
         fluid_player_advancefile(player);
 
@@ -2094,25 +3500,31 @@ fluid_player_playlist_load(fluid_player_t *player, unsigned int msec)
             return;
         }
 
-        fluid_player_reset(player);
         current_playitem = (fluid_playlist_item *) player->currentfile->data;
+
+        if(fluid_player_take_preload(player, current_playitem))
+        {
+            break;
+        }
+
+        fluid_player_unpin_presets(player, player);
+        fluid_player_reset(player);
+
+        if(fluid_player_load(player, current_playitem) == FLUID_OK)
+        {
+            fluid_player_pin_presets(player, player);
+            break;
+        }
     }
-    while(fluid_player_load(player, current_playitem) != FLUID_OK);
 
     /* Successfully loaded midi file */
 
     player->begin_msec = msec;
-    player->start_msec = msec;
-    player->start_ticks = 0;
     player->cur_ticks = 0;
+    player->cur_event = 0;
+    fluid_player_set_anchor(player, 0.0, start, 0);
 
-    for(i = 0; i < player->ntracks; i++)
-    {
-        if(player->track[i] != NULL)
-        {
-            fluid_track_reset(player->track[i]);
-        }
-    }
+    fluid_player_request_preload(player);
 }
 
 /*
@@ -2151,13 +3563,21 @@ fluid_player_callback(void *data, unsigned int msec)
             }
             fluid_atomic_int_set(&player->stopping, 0);
         }
+
+        /* nothing to do until fluid_player_play() or fluid_player_stop() wake the timer */
+        if(player->sample_timer != NULL)
+        {
+            fluid_sample_timer_suspend(synth, player->sample_timer);
+        }
+
         return 1;
     }
     do
     {
-        float deltatime;
         int seek_ticks;
 
+        player->cur_time = fluid_player_get_time(player, msec);
+
         if(loadnextfile)
         {
             loadnextfile = 0;
@@ -2180,10 +3600,6 @@ fluid_player_callback(void *data, unsigned int msec)
         }
 
         player->cur_msec = msec;
-        deltatime = fluid_atomic_float_get(&player->deltatime);
-        player->cur_ticks = (player->start_ticks
-                             + (int)((double)(player->cur_msec - player->start_msec)
-                                     / deltatime + 0.5)); /* 0.5 to average overall error when casting */
 
         seek_ticks = fluid_atomic_int_get(&player->seek_ticks);
         if(seek_ticks >= 0)
@@ -2197,25 +3613,38 @@ fluid_player_callback(void *data, unsigned int msec)
                     player->channel_isplaying[i] = FALSE;
                 }
             }
-        }
 
-        for(i = 0; i < player->ntracks; i++)
-        {
-            fluid_track_send_events(player->track[i], synth, player, player->cur_ticks, seek_ticks);
-            if(!fluid_track_eot(player->track[i]))
+            /* the events at seek_ticks are played now */
+            if(player->stream != NULL)
             {
-                status = FLUID_PLAYER_PLAYING;
+                fluid_player_stream_seek(player, seek_ticks);
+            }
+            else
+            {
+                fluid_player_seek_timeline(player, fluid_player_find_event(player, seek_ticks));
             }
+
+            fluid_player_set_anchor(player, seek_ticks, player->cur_time, 0);
+        }
+
+        fluid_player_send_events(player, player->cur_time);
+
+        if(player->cur_event < player->nevents)
+        {
+            status = FLUID_PLAYER_PLAYING;
         }
 
         if(seek_ticks >= 0)
         {
-            player->start_ticks = seek_ticks;   /* tick position of last tempo value (which is now) */
             player->cur_ticks = seek_ticks;
             player->begin_msec = msec;      /* only used to calculate the duration of playing */
-            player->start_msec = msec;      /* should be the (synth)-time of the last tempo change */
             fluid_atomic_int_set(&player->seek_ticks, -1); /* clear seek_ticks */
         }
+        else
+        {
+            double ticks = fluid_player_get_ticks_at(player, player->cur_time);
+            player->cur_ticks = (ticks > 0.0) ? (int)ticks : 0;
+        }
         
         if(fluid_list_next(player->currentfile) == NULL && player->loop == 0)
         {
@@ -2282,6 +3711,48 @@ fluid_player_callback(void *data, unsigned int msec)
     return 1;
 }
 
+/*
+ * Returns for how many milliseconds after the latest call of fluid_player_callback()
+ * the callback has nothing to do, so that fluid_player_render() may skip them. 0 if
+ * that isn't known.
+ */
+unsigned int
+fluid_player_get_idle_msec(fluid_player_t *player)
+{
+    double msec;
+
+    if(fluid_player_get_status(player) != FLUID_PLAYER_PLAYING
+       || player->currentfile == NULL
+       || fluid_atomic_int_get(&player->seek_ticks) >= 0)
+    {
+        return 0;
+    }
+
+    if(player->cur_event < player->nevents)
+    {
+        msec = fluid_player_get_event_time(player, player->cur_event);
+
+        /* the events due in the next block may be sent before it */
+        if(!player->use_system_timer && player->synth->sample_accurate_events)
+        {
+            msec -= FLUID_BUFSIZE * 1000.0 / player->synth->sample_rate;
+        }
+    }
+    else if(player->end_msec >= 0)
+    {
+        /* the grace period after the last event */
+        msec = player->end_msec;
+    }
+    else
+    {
+        return 0;
+    }
+
+    msec -= player->cur_time;
+
+    return (msec > 1.0) ? (unsigned int)msec - 1 : 0;
+}
+
 /**
  * Activates play mode for a MIDI player if not already playing.
  * @param player MIDI player instance
@@ -2303,6 +3774,7 @@ fluid_player_play(fluid_player_t *player)
     {
         fluid_sample_timer_reset(player->synth, player->sample_timer);
         player->cur_msec = 0;
+        player->cur_time = 0.0;
     }
 
     /* If we're at the end of the playlist and there are no loops left, loop once */
@@ -2314,8 +3786,20 @@ fluid_player_play(fluid_player_t *player)
     player->end_msec = -1;
     player->end_pedals_disabled = 0;
 
+    /* the first file is loaded in the background as well */
+    if(player->currentfile == NULL)
+    {
+        fluid_player_request_preload(player);
+    }
+
     fluid_atomic_int_set(&player->status, FLUID_PLAYER_PLAYING);
 
+    /* the callback may have seen the previous status after the reset */
+    if(!player->use_system_timer)
+    {
+        fluid_sample_timer_wake(player->synth, player->sample_timer);
+    }
+
     return FLUID_OK;
 }
 
@@ -2332,6 +3816,13 @@ fluid_player_stop(fluid_player_t *player)
 {
     fluid_atomic_int_set(&player->status, FLUID_PLAYER_DONE);
     fluid_atomic_int_set(&player->stopping, 1);
+
+    /* the callback mutes the channels played */
+    if(player->sample_timer != NULL)
+    {
+        fluid_sample_timer_wake(player->synth, player->sample_timer);
+    }
+
     fluid_player_seek(player, fluid_player_get_current_tick(player));
     return FLUID_OK;
 }
@@ -2413,45 +3904,33 @@ int fluid_player_set_loop(fluid_player_t *player, int loop)
 }
 
 /**
- * update the MIDI player internal deltatime dependent of actual tempo.
+ * Keeps playing the current position at the current time, before the tempo settings change.
  * @param player MIDI player instance
+ * @param tempo the tempo to play the file at up to its next tempo change, 0 to keep the
+ *   current one.
  */
-static void fluid_player_update_tempo(fluid_player_t *player)
+static void fluid_player_update_tempo(fluid_player_t *player, int tempo)
 {
-    int tempo; /* tempo in micro seconds by quarter note */
-    float deltatime;
+    double ticks;
 
-    /* do nothing if the division is still unknown to avoid a div by zero */
-    if(player->division == 0)
+    /* nothing to do before a file is loaded, which starts at the settings in effect then */
+    if(player->ntempos == 0)
     {
         return;
     }
 
-    if(fluid_atomic_int_get(&player->sync_mode))
-    {
-        /* take internal tempo from MIDI file */
-        tempo = fluid_atomic_int_get(&player->miditempo);
-        /* compute deltattime (in ms) from current tempo and apply tempo multiplier */
-        deltatime = (float)tempo / (float)player->division / (float)1000.0;
-        deltatime /= fluid_atomic_float_get(&player->multempo); /* multiply tempo */
-    }
-    else
+    ticks = fluid_player_get_ticks_at(player, player->cur_time);
+
+    if(tempo == 0 && (player->anchor_next >= player->ntempos
+                      || ticks <= player->tempo_map[player->anchor_next].ticks))
     {
-        /* take  external tempo */
-        tempo = fluid_atomic_int_get(&player->exttempo);
-        /* compute deltattime (in ms) from current tempo */
-        deltatime = (float)tempo / (float)player->division / (float)1000.0;
+        tempo = player->anchor_tempo;
     }
 
-    fluid_atomic_float_set(&player->deltatime, deltatime);
-
-    player->start_msec = player->cur_msec;
-    player->start_ticks = player->cur_ticks;
-
-    FLUID_LOG(FLUID_DBG,
-              "tempo=%d, tick time=%f msec, cur time=%d msec, cur tick=%d",
-              tempo, player->deltatime, player->cur_msec, player->cur_ticks);
+    fluid_player_set_anchor(player, ticks, player->cur_time, tempo);
 
+    FLUID_LOG(FLUID_DBG, "tempo=%d, cur time=%f msec, cur tick=%f",
+              player->anchor_tempo, player->cur_time, ticks);
 }
 
 /**
@@ -2504,6 +3983,9 @@ int fluid_player_set_tempo(fluid_player_t *player, int tempo_type, double tempo)
     fluid_return_val_if_fail(tempo_type >= FLUID_PLAYER_TEMPO_INTERNAL, FLUID_FAILED);
     fluid_return_val_if_fail(tempo_type < FLUID_PLAYER_TEMPO_NBR, FLUID_FAILED);
 
+    /* the new tempo applies from the current position on */
+    fluid_player_update_tempo(player, 0);
+
     switch(tempo_type)
     {
         /* set the player to be driven by internal tempo coming from MIDI file */
@@ -2537,9 +4019,6 @@ int fluid_player_set_tempo(fluid_player_t *player, int tempo_type, double tempo)
             break;
     }
 
-    /* update deltatime depending of current tempo */
-    fluid_player_update_tempo(player);
-
     return FLUID_OK;
 }
 
@@ -2555,7 +4034,7 @@ int fluid_player_set_midi_tempo(fluid_player_t *player, int tempo)
 {
     player->miditempo = tempo;
 
-    fluid_player_update_tempo(player);
+    fluid_player_update_tempo(player, tempo);
     return FLUID_OK;
 }
 
@@ -2614,23 +4093,12 @@ int fluid_player_get_current_tick(fluid_player_t *player)
  */
 int fluid_player_get_total_ticks(fluid_player_t *player)
 {
-    int i;
-    int maxTicks = 0;
-
-    for(i = 0; i < player->ntracks; i++)
+    if(player->stream != NULL)
     {
-        if(player->track[i] != NULL)
-        {
-            int ticks = fluid_track_get_duration(player->track[i]);
-
-            if(ticks > maxTicks)
-            {
-                maxTicks = ticks;
-            }
-        }
+        return (int)player->stream->total_ticks;
     }
 
-    return maxTicks;
+    return (player->nevents > 0) ? (int)player->event_ticks[player->nevents - 1] : 0;
 }
 
 /**
@@ -2823,6 +4291,7 @@ fluid_midi_parser_parse(fluid_midi_parser_t *parser, unsigned char c)
     parser->event.type = parser->status;
     parser->event.channel = parser->channel;
     parser->nr_bytes = 0; /* Reset data size, in case there are additional running status messages */
+    fluid_midi_event_stamp(&parser->event);
 
     switch(parser->status)
     {
@@ -2848,6 +4317,73 @@ fluid_midi_parser_parse(fluid_midi_parser_t *parser, unsigned char c)
     return &parser->event;
 }
 
+/*
+ * Decodes a MIDI event packed into 4 bytes, as sent to the event port of the shell server
+ * and to the UDP MIDI driver: status byte of a channel message or 0xFF (system reset), two
+ * data bytes (the second one 0 if the message has only one) and the MIDI port, the event
+ * goes to channel port * 16 + (status & 0x0F). Returns FLUID_FAILED for unsupported status
+ * bytes.
+ */
+int
+fluid_midi_event_unpack(fluid_midi_event_t *event, const unsigned char *buf)
+{
+    int status = buf[0], data1 = buf[1] & 0x7F, data2 = buf[2] & 0x7F;
+
+    FLUID_MEMSET(event, 0, sizeof(*event));
+    event->type = status & 0xF0;
+    event->channel = buf[3] * 16 + (status & 0x0F);
+    event->param1 = data1;
+    event->param2 = data2;
+
+    switch(event->type)
+    {
+    case NOTE_OFF:
+    case NOTE_ON:
+    case KEY_PRESSURE:
+    case CONTROL_CHANGE:
+    case PROGRAM_CHANGE:
+    case CHANNEL_PRESSURE:
+        return FLUID_OK;
+
+    case PITCH_BEND:
+        event->param1 = (data2 << 7) | data1;
+        return FLUID_OK;
+
+    default:
+        if(status == MIDI_SYSTEM_RESET)
+        {
+            event->type = MIDI_SYSTEM_RESET;
+            event->channel = 0;
+            return FLUID_OK;
+        }
+
+        return FLUID_FAILED;
+    }
+}
+
+/*
+ * The clock of the ingress time of MIDI events, in microseconds of fluid_perf_now(),
+ * wrapping around after about 71 minutes. Never 0, which marks an unknown time.
+ */
+unsigned int
+fluid_midi_ingress_now(void)
+{
+    double usec = fluid_perf_now();
+    unsigned int now = (unsigned int)(uint64_t)usec;
+
+    return (now != 0) ? now : 1;
+}
+
+/*
+ * Marks an event as received by a MIDI driver now. The synth measures the latency of the
+ * notes started by such events, see fluid_synth_get_note_latency_stats().
+ */
+void
+fluid_midi_event_stamp(fluid_midi_event_t *event)
+{
+    event->ingress = fluid_midi_ingress_now();
+}
+
 /* Purpose:
  * Returns the length of a MIDI message. */
 static int
@@ -23,6 +23,7 @@
 #include "fluidsynth_priv.h"
 #include "fluid_sys.h"
 #include "fluid_list.h"
+#include "fluid_arena.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,6 +34,9 @@ typedef struct _fluid_midi_parser_t fluid_midi_parser_t;
 fluid_midi_parser_t *new_fluid_midi_parser(void);
 void delete_fluid_midi_parser(fluid_midi_parser_t *parser);
 fluid_midi_event_t *fluid_midi_parser_parse(fluid_midi_parser_t *parser, unsigned char c);
+int fluid_midi_event_unpack(fluid_midi_event_t *event, const unsigned char *buf);
+unsigned int fluid_midi_ingress_now(void);
+void fluid_midi_event_stamp(fluid_midi_event_t *event);
 
 
 /***************************************************************
@@ -240,6 +244,7 @@ struct _fluid_midi_event_t
     unsigned int dtime;       /* Delay (ticks) between this and previous event. midi tracks. */
     unsigned int param1;      /* First parameter */
     unsigned int param2;      /* Second parameter */
+    unsigned int ingress;     /* Time received by a MIDI driver, see fluid_midi_event_stamp(), 0 if unknown */
     unsigned char type;       /* MIDI event type */
     unsigned char channel;    /* MIDI channel */
 };
@@ -252,15 +257,16 @@ struct _fluid_track_t
 {
     char *name;
     int num;
-    fluid_midi_event_t *first;
-    fluid_midi_event_t *cur;
-    fluid_midi_event_t *last;
-    unsigned int ticks;
+    fluid_midi_event_t *events;     /* all events of the track, in order */
+    int nevents;
+    int size;                       /* number of events allocated */
+    fluid_arena_t *arena;           /* data of SYSEX and text events, NULL if there are none */
 };
 
 typedef struct _fluid_track_t fluid_track_t;
 
-#define fluid_track_eot(track)  ((track)->cur == NULL)
+#define FLUID_TRACK_INITIAL_EVENTS 256
+#define FLUID_TRACK_ARENA_BLOCK_SIZE 4096
 
 
 /*
@@ -283,15 +289,90 @@ typedef struct
 #define MIN_TEMPO_MULTIPLIER (0.001f)
 #define MAX_TEMPO_MULTIPLIER (1000.0f)
 
+/*
+ * fluid_player_keyframe_t
+ * The state of the channels at a position of the player's timeline, given by the events
+ * that have set it. Each slot holds the index of the last event that has set a controller,
+ * the program, etc. or -1.
+ */
+enum fluid_player_slot
+{
+    /* the slots 0 to 127 of a channel are its controllers */
+    FLUID_PLAYER_SLOT_PROGRAM = 128,
+    FLUID_PLAYER_SLOT_PROGRAM_BANK_MSB,     /* the bank select events in effect at the program change */
+    FLUID_PLAYER_SLOT_PROGRAM_BANK_LSB,
+    FLUID_PLAYER_SLOT_PITCH_BEND,
+    FLUID_PLAYER_SLOT_CHANNEL_PRESSURE,
+    FLUID_PLAYER_CHANNEL_SLOTS,
+
+    /* after the slots of all channels */
+    FLUID_PLAYER_SLOT_TEMPO = MAX_NUMBER_OF_CHANNELS * FLUID_PLAYER_CHANNEL_SLOTS,
+    FLUID_PLAYER_SLOT_TEXT,
+    FLUID_PLAYER_SLOT_LYRIC,
+    FLUID_PLAYER_SLOTS,
+
+    /* events which don't just set a state, they are always replayed when seeking */
+    FLUID_PLAYER_SLOT_KEPT = -1,
+    /* events which are never replayed when seeking */
+    FLUID_PLAYER_SLOT_NONE = -2
+};
+
+typedef struct
+{
+    int nkept;                      /* number of kept events before the keyframe */
+    int slot[FLUID_PLAYER_SLOTS];
+} fluid_player_keyframe_t;
+
+#define FLUID_PLAYER_KEYFRAME_INTERVAL 4096
+
+/*
+ * fluid_player_tempo_t
+ * An entry of the tempo map of the player's timeline: the tempo of the file from a tick on,
+ * and the time of that tick at the tempos of the file.
+ */
+typedef struct
+{
+    unsigned int ticks;
+    int tempo;                      /* micro seconds per quarter note */
+    double usec;                    /* time of ticks since the beginning of the file */
+} fluid_player_tempo_t;
+
+typedef struct _fluid_player_stream_t fluid_player_stream_t;
+
 /*
  * fluid_player
  */
+/* a preset pinned by the player, see fluid_synth_pin_program() */
+typedef struct
+{
+    int sfont_id;
+    int bank;
+    int prog;
+} fluid_player_pinned_preset_t;
+
 struct _fluid_player_t
 {
     fluid_atomic_int_t status;
     fluid_atomic_int_t stopping; /* Flag for sending all_notes_off when player is stopped */
     int ntracks;
     fluid_track_t *track[MAX_NUMBER_OF_TRACKS];
+
+    /* the events of all tracks, sorted by their tick, see fluid_player_build_timeline() */
+    fluid_midi_event_t *events;
+    unsigned int *event_ticks;      /* absolute tick of each event */
+    int nevents;
+    int cur_event;                  /* index of the next event to play */
+    int *kept_events;               /* the events of FLUID_PLAYER_SLOT_KEPT */
+    int nkept_events;
+    fluid_player_keyframe_t *keyframes; /* one every FLUID_PLAYER_KEYFRAME_INTERVAL events */
+    int *seek_events;               /* room for the events to replay when seeking */
+    fluid_player_tempo_t *tempo_map; /* the tempo changes of the file, starting at tick 0 */
+    int ntempos;
+    double *event_usec;             /* time of each event at the tempos of the file */
+    /* with player.streaming, events, event_ticks and event_usec only hold a window of the
+       timeline, see fluid_player_stream_fill(). NULL if the file has been loaded at once. */
+    fluid_player_stream_t *stream;
+
     fluid_synth_t *synth;
     fluid_timer_t *system_timer;
     fluid_sample_timer_t *sample_timer;
@@ -303,12 +384,18 @@ struct _fluid_player_t
     char use_system_timer;   /* if zero, use sample timers, otherwise use system clock timer */
     char reset_synth_between_songs; /* 1 if system reset should be sent to the synth between songs. */
     fluid_atomic_int_t seek_ticks; /* new position in tempo ticks (midi ticks) for seeking */
-    int start_ticks;          /* the number of tempo ticks passed at the last tempo change */
     int cur_ticks;            /* the number of tempo ticks passed */
     int last_callback_ticks;  /* the last tick number that was passed to player->tick_callback */
     int begin_msec;           /* the time (msec) of the beginning of the file */
-    int start_msec;           /* the start time of the last tempo change */
     unsigned int cur_msec;    /* the current time */
+    double cur_time;          /* the exact current time (msec), in samples of the synth with the sample timer */
+    /* the position the times of the events are calculated from, moved by seeking and by the
+       tempo settings: the tick anchor_ticks is played at the time anchor_time (msec) */
+    double anchor_ticks;
+    double anchor_time;
+    int anchor_tempo;         /* tempo from anchor_ticks up to the next tempo change of the file */
+    int anchor_next;          /* index of that tempo change in tempo_map, ntempos if none */
+    double anchor_usec;       /* time at the tempos of the file that the times after it count from */
     int end_msec;             /* when >=0, playback is extended until this time (for, e.g., reverb) */
     char end_pedals_disabled; /* 1 once the pedals have been released after the last midi event, 0 otherwise */
     /* sync mode: indicates the tempo mode the player is driven by (see fluid_player_set_tempo()):
@@ -324,7 +411,6 @@ struct _fluid_player_t
     int exttempo;
     /* multempo: tempo multiplier set by fluid_player_set_tempo() */
     float multempo;
-    float deltatime;   /* milliseconds per midi tick. depends on current tempo mode (see sync_mode) */
     unsigned int division;
 
     handle_midi_event_func_t playback_callback; /* function fired on each midi event as it is played */
@@ -333,11 +419,40 @@ struct _fluid_player_t
     void *tick_userdata; /* pointer to user-defined data passed to tick_callback function */
 
     int channel_isplaying[MAX_NUMBER_OF_CHANNELS]; /* flags indicating channels on which notes have played */
+
+    /* the next playlist item is loaded by preload_thread into the tracks and the timeline of
+       preload, so that switching to it only exchanges them, see fluid_player_swap_file() */
+    fluid_thread_t *preload_thread;
+    fluid_cond_t *preload_cond;     /* signalled when preload_state changes */
+    fluid_cond_mutex_t *preload_m;  /* protects preload_item, preload_state and preload */
+    fluid_player_t *preload;
+    fluid_playlist_item *preload_item;
+    int preload_state;              /* see enum fluid_player_preload_state */
+    char gapless;             /* 1 if the next file starts at the end of the previous one, see player.gapless */
+    char streaming;           /* 1 if the files are decoded while playing them, see player.streaming */
+    char preload_presets;     /* 1 if the presets of the files are pinned when loading them, see player.preload-presets */
+
+    /* the presets pinned for the program changes of the loaded file, see fluid_player_pin_presets() */
+    fluid_player_pinned_preset_t *pinned;
+    int npinned;
+    fluid_mutex_t pinned_m;   /* protects pinned of the player and of preload */
+};
+
+enum fluid_player_preload_state
+{
+    FLUID_PLAYER_PRELOAD_IDLE,      /* nothing has been requested */
+    FLUID_PLAYER_PRELOAD_REQUESTED, /* preload_item should be loaded */
+    FLUID_PLAYER_PRELOAD_LOADING,   /* preload_item is being loaded */
+    FLUID_PLAYER_PRELOAD_READY,     /* preload_item has been loaded into preload */
+    FLUID_PLAYER_PRELOAD_FAILED,    /* preload_item couldn't be loaded */
+    FLUID_PLAYER_PRELOAD_TERMINATE  /* preload_thread should terminate */
 };
 
 #define FLUID_PLAYER_STOP_GRACE_MS 2000
+#define FLUID_PLAYER_SYSTEM_TIMER_MS 4 /* interval of the system timer driving the player */
 
 void fluid_player_settings(fluid_settings_t *settings);
+unsigned int fluid_player_get_idle_msec(fluid_player_t *player);
 
 
 /*
@@ -345,12 +460,12 @@ void fluid_player_settings(fluid_settings_t *settings);
  */
 typedef struct
 {
-    const char *buffer;           /* Entire contents of MIDI file (borrowed) */
+    char *buffer;                 /* Entire contents of MIDI file (borrowed) */
     int buf_len;                  /* Length of buffer, in bytes */
     int buf_pos;                  /* Current read position in contents buffer */
     int eof;                      /* The "end of file" condition */
+    int persistent;               /* Whether the buffer outlives the loaded events */
     int running_status;
-    int c;
     int type;
     int ntracks;
     int uses_smpte;
@@ -366,6 +481,30 @@ typedef struct
     int dtime;
 } fluid_midi_file;
 
+#define FLUID_PLAYER_STREAM_WINDOW 1024
+#define FLUID_PLAYER_STREAM_ARENA_BLOCK_SIZE 4096
+
+/*
+ * fluid_player_stream_t
+ * A file played with player.streaming. Its events are decoded from the contents of the file
+ * just ahead of the playhead, FLUID_PLAYER_STREAM_WINDOW at a time, into the timeline of the
+ * player. The next event of each track is held by the track of the player.
+ */
+struct _fluid_player_stream_t
+{
+    char *buffer;                   /* the contents of the file if owned by the stream, NULL if borrowed */
+    fluid_file_map_t map;           /* the mapping of buffer, if it's mapped */
+    int ntracks;
+    fluid_midi_file *start;         /* the beginning of each track */
+    fluid_midi_file *cursor;        /* the position of each track after its next event */
+    unsigned int *track_ticks;      /* absolute tick of the next event of each track */
+    fluid_arena_t *arena;           /* the data of the text events in the window */
+    int window_pos;                 /* number of events of the file before the window */
+    unsigned int window_ticks;      /* tick of the last event before the window */
+    int tempo;                      /* entry of the tempo map in effect at the end of the window */
+    unsigned int total_ticks;       /* tick of the last event of the file */
+};
+
 
 
 #define FLUID_MIDI_PARSER_MAX_DATA_SIZE 1024    /**< Maximum size of MIDI parameters/data (largest is SYSEX data) */
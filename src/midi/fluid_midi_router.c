@@ -27,14 +27,36 @@
 #include "fluid_midi.h"
 #include "fluid_synth.h"
 
+/*
+ * The rules compiled for handling events: for each rule type and input channel, the
+ * rules matching that channel, in the order of the rule list. Tables are never changed
+ * once published, new ones replace them when the rules change.
+ */
+typedef struct
+{
+    fluid_midi_router_rule_t *rule;
+    int chan;                                /* Channel of the generated events */
+} fluid_midi_router_entry_t;
+
+typedef struct
+{
+    int nr_midi_channels;
+    int *first;                              /* Index of the first entry for each rule type and channel,
+                                                channel nr_midi_channels is for the channels out of range */
+    fluid_midi_router_entry_t *entries;
+} fluid_midi_router_table_t;
+
 /*
  * fluid_midi_router
  */
 struct _fluid_midi_router_t
 {
-    fluid_mutex_t rules_mutex;
+    fluid_mutex_t rules_mutex;                 /* Serializes changes of the rules */
     fluid_midi_router_rule_t *rules[FLUID_MIDI_ROUTER_RULE_COUNT];        /* List of rules for each rule type */
-    fluid_midi_router_rule_t *free_rules;      /* List of rules to free (was waiting for final events which were received) */
+    fluid_midi_router_table_t *table;          /* The rules compiled for the event handler */
+    unsigned int serial;                       /* Number of tables published so far */
+    fluid_atomic_int_t epoch;                  /* Number of table replacements, selects the reader count of new events */
+    fluid_atomic_int_t readers[2];             /* Number of events being handled, by the parity of the epoch they started in */
 
     handle_midi_event_func_t event_handler;    /* Callback function for generated events */
     void *event_handler_data;                  /* One arg for the callback */
@@ -59,12 +81,261 @@ struct _fluid_midi_router_rule_t
     fluid_real_t par2_mul;
     int par2_add;
 
-    int pending_events;                      /* In case of noteon: How many keys are still down? */
-    char keys_cc[128];                       /* Flags, whether a key is down / controller is set (sustain) */
+    fluid_atomic_int_t pending_events;       /* In case of noteon: How many keys are still down? */
+    fluid_atomic_int_t keys_cc[128];         /* Flags, whether a key is down / controller is set (sustain) */
     fluid_midi_router_rule_t *next;          /* next entry */
-    int waiting;                             /* Set to TRUE when rule has been deactivated but there are still pending_events */
+    fluid_atomic_int_t waiting;              /* Set to TRUE when rule has been deactivated but there are still pending_events */
+    unsigned int waiting_serial;             /* Serial of the router when the rule has been deactivated */
+    int dropped;                             /* TRUE if the rule has been left out of the current table */
 };
 
+/* Whether an event on the channel matches the channel window of the rule */
+static int
+fluid_midi_router_rule_match_chan(const fluid_midi_router_rule_t *rule, int chan)
+{
+    if(rule->chan_min > rule->chan_max)
+    {
+        /* Inverted rule: Exclude everything between max and min (but not min/max) */
+        return !(chan > rule->chan_max && chan < rule->chan_min);
+    }
+
+    /* Normal rule: Exclude everything < max or > min (but not min/max) */
+    return !(chan > rule->chan_max || chan < rule->chan_min);
+}
+
+/* Channel scaling / offset
+ * Note: rule->chan_mul will probably be 0 or 1. If it's 0, input from all
+ * input channels is mapped to the same synth channel.
+ */
+static int
+fluid_midi_router_rule_map_chan(const fluid_midi_router_rule_t *rule, int chan)
+{
+    return rule->chan_add + (int)((fluid_real_t)chan * rule->chan_mul + (fluid_real_t)0.5);
+}
+
+static void
+delete_fluid_midi_router_table(fluid_midi_router_table_t *table)
+{
+    fluid_return_if_fail(table != NULL);
+
+    FLUID_FREE(table->first);
+    FLUID_FREE(table->entries);
+    FLUID_FREE(table);
+}
+
+/* Whether a rule is left out of the next table: once it has been waiting for a
+ * whole table, no event handler can add pending events to it anymore */
+static int
+fluid_midi_router_rule_is_done(const fluid_midi_router_t *router, fluid_midi_router_rule_t *rule)
+{
+    return fluid_atomic_int_get(&rule->waiting) && rule->waiting_serial != router->serial
+           && fluid_atomic_int_get(&rule->pending_events) == 0;
+}
+
+/*
+ * Compiles the rules of the router into a new table, must be called with rules_mutex locked.
+ */
+static fluid_midi_router_table_t *
+fluid_midi_router_compile(fluid_midi_router_t *router)
+{
+    fluid_midi_router_table_t *table;
+    fluid_midi_router_rule_t *rule;
+    int nr_channels = router->nr_midi_channels;
+    int i, chan, pass, n = 0;
+
+    table = FLUID_NEW(fluid_midi_router_table_t);
+
+    if(table == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(table, 0, sizeof(*table));
+    table->nr_midi_channels = nr_channels;
+    table->first = FLUID_ARRAY(int, FLUID_MIDI_ROUTER_RULE_COUNT * (nr_channels + 1) + 1);
+
+    if(table->first == NULL)
+    {
+        goto error_recovery;
+    }
+
+    for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
+    {
+        for(rule = router->rules[i]; rule; rule = rule->next)
+        {
+            rule->dropped = fluid_midi_router_rule_is_done(router, rule);
+        }
+    }
+
+    /* the first pass counts the entries, the second one fills them in */
+    for(pass = 0; pass < 2; pass++)
+    {
+        n = 0;
+
+        for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
+        {
+            for(chan = 0; chan <= nr_channels; chan++)
+            {
+                table->first[i * (nr_channels + 1) + chan] = n;
+
+                for(rule = router->rules[i]; rule; rule = rule->next)
+                {
+                    if(rule->dropped || (chan < nr_channels && !fluid_midi_router_rule_match_chan(rule, chan)))
+                    {
+                        continue;
+                    }
+
+                    if(pass == 1)
+                    {
+                        table->entries[n].rule = rule;
+                        table->entries[n].chan = fluid_midi_router_rule_map_chan(rule, chan);
+                    }
+
+                    n++;
+                }
+            }
+        }
+
+        table->first[FLUID_MIDI_ROUTER_RULE_COUNT * (nr_channels + 1)] = n;
+
+        if(pass == 0)
+        {
+            table->entries = FLUID_ARRAY(fluid_midi_router_entry_t, (n > 0) ? n : 1);
+
+            if(table->entries == NULL)
+            {
+                goto error_recovery;
+            }
+        }
+    }
+
+    return table;
+
+error_recovery:
+    FLUID_LOG(FLUID_ERR, "Out of memory");
+    delete_fluid_midi_router_table(table);
+    return NULL;
+}
+
+/*
+ * Compiles the rules and replaces the table of the router by the new one, then frees
+ * the rules left out of it. Must be called with rules_mutex locked.
+ *
+ * @return FLUID_FAILED if the rules could not be compiled, the table is unchanged then
+ */
+static int
+fluid_midi_router_update(fluid_midi_router_t *router)
+{
+    fluid_midi_router_table_t *table, *old_table;
+    fluid_midi_router_rule_t *rule, **prev;
+    int i, epoch, published = FALSE, again;
+
+    do
+    {
+        table = fluid_midi_router_compile(router);
+
+        if(table == NULL)
+        {
+            /* rules which could not be dropped are dropped the next time */
+            return published ? FLUID_OK : FLUID_FAILED;
+        }
+
+        old_table = fluid_atomic_pointer_get(&router->table);
+        fluid_atomic_pointer_set(&router->table, table);
+        published = TRUE;
+
+        /* Events acquiring the table from now on count in the other reader count. Those still
+         * counted in the count of the old epoch may be using the old table, wait until they
+         * are done. Events of the epoch before have been waited for by the previous update. */
+        epoch = fluid_atomic_int_exchange_and_add(&router->epoch, 1);
+
+        while(fluid_atomic_int_get(&router->readers[epoch & 1]) > 0)
+        {
+            fluid_msleep(1);
+        }
+
+        delete_fluid_midi_router_table(old_table);
+        router->serial++;
+
+        /* the dropped rules aren't referred to anymore */
+        again = FALSE;
+
+        for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
+        {
+            for(prev = &router->rules[i]; (rule = *prev) != NULL;)
+            {
+                if(rule->dropped)
+                {
+                    *prev = rule->next;
+                    FLUID_FREE(rule);
+                    continue;
+                }
+
+                /* rules deactivated before that table without pending events can be dropped now */
+                again |= fluid_midi_router_rule_is_done(router, rule);
+                prev = &rule->next;
+            }
+        }
+    }
+    while(again);
+
+    return FLUID_OK;
+}
+
+/* Deactivates all rules of the router, they are only kept until their pending events have been received */
+static void
+fluid_midi_router_deactivate_rules(fluid_midi_router_t *router)
+{
+    fluid_midi_router_rule_t *rule;
+    int i;
+
+    for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
+    {
+        for(rule = router->rules[i]; rule; rule = rule->next)
+        {
+            if(!fluid_atomic_int_get(&rule->waiting))
+            {
+                rule->waiting_serial = router->serial;
+                fluid_atomic_int_set(&rule->waiting, TRUE);
+            }
+        }
+    }
+}
+
+/*
+ * Gets the table of the router for handling an event, it is freed only once released again.
+ * The reader counts belong to the router, so unlike the table they can't be freed while an
+ * event increments one. Stores the reader count to pass to fluid_midi_router_release_table()
+ * in slot.
+ */
+static fluid_midi_router_table_t *
+fluid_midi_router_acquire_table(fluid_midi_router_t *router, int *slot)
+{
+    int epoch;
+
+    while(1)
+    {
+        epoch = fluid_atomic_int_get(&router->epoch);
+        fluid_atomic_int_inc(&router->readers[epoch & 1]);
+
+        /* an update that started in the meantime may not wait for this reader count */
+        if(fluid_atomic_int_get(&router->epoch) == epoch)
+        {
+            *slot = epoch & 1;
+            return fluid_atomic_pointer_get(&router->table);
+        }
+
+        fluid_atomic_int_add(&router->readers[epoch & 1], -1);
+    }
+}
+
+static void
+fluid_midi_router_release_table(fluid_midi_router_t *router, int slot)
+{
+    fluid_atomic_int_add(&router->readers[slot], -1);
+}
+
 
 /**
  * Create a new midi router.
@@ -117,6 +388,11 @@ new_fluid_midi_router(fluid_settings_t *settings, handle_midi_event_func_t handl
         }
     }
 
+    if(fluid_midi_router_update(router) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
     return router;
 
 error_recovery:
@@ -146,6 +422,7 @@ delete_fluid_midi_router(fluid_midi_router_t *router)
         }
     }
 
+    delete_fluid_midi_router_table(router->table);
     fluid_mutex_destroy(router->rules_mutex);
     FLUID_FREE(router);
 }
@@ -164,9 +441,7 @@ int
 fluid_midi_router_set_default_rules(fluid_midi_router_t *router)
 {
     fluid_midi_router_rule_t *new_rules[FLUID_MIDI_ROUTER_RULE_COUNT];
-    fluid_midi_router_rule_t *del_rules[FLUID_MIDI_ROUTER_RULE_COUNT];
-    fluid_midi_router_rule_t *rule, *next_rule, *prev_rule;
-    int i, i2;
+    int i, i2, ret_val;
 
     fluid_return_val_if_fail(router != NULL, FLUID_FAILED);
 
@@ -191,59 +466,21 @@ fluid_midi_router_set_default_rules(fluid_midi_router_t *router)
 
     fluid_mutex_lock(router->rules_mutex);        /* ++ lock */
 
+    /* Existing rules are removed once they have no pending events anymore */
+    fluid_midi_router_deactivate_rules(router);
+
     for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
     {
-        del_rules[i] = NULL;
-        prev_rule = NULL;
-
-        /* Process existing rules */
-        for(rule = router->rules[i]; rule; rule = next_rule)
-        {
-            next_rule = rule->next;
-
-            if(rule->pending_events == 0)     /* Rule has no pending events? */
-            {
-                /* Remove rule from rule list */
-                if(prev_rule)
-                {
-                    prev_rule->next = next_rule;
-                }
-                else if(rule == router->rules[i])
-                {
-                    router->rules[i] = next_rule;
-                }
-
-                /* Prepend to delete list */
-                rule->next = del_rules[i];
-                del_rules[i] = rule;
-            }
-            else
-            {
-                rule->waiting = TRUE;          /* Pending events, mark as waiting */
-                prev_rule = rule;
-            }
-        }
-
         /* Prepend new default rule */
         new_rules[i]->next = router->rules[i];
         router->rules[i] = new_rules[i];
     }
 
-    fluid_mutex_unlock(router->rules_mutex);      /* -- unlock */
-
+    ret_val = fluid_midi_router_update(router);
 
-    /* Free old rules outside of lock */
-
-    for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
-    {
-        for(rule = del_rules[i]; rule; rule = next_rule)
-        {
-            next_rule = rule->next;
-            FLUID_FREE(rule);
-        }
-    }
+    fluid_mutex_unlock(router->rules_mutex);      /* -- unlock */
 
-    return FLUID_OK;
+    return ret_val;
 }
 
 /**
@@ -259,63 +496,19 @@ fluid_midi_router_set_default_rules(fluid_midi_router_t *router)
 int
 fluid_midi_router_clear_rules(fluid_midi_router_t *router)
 {
-    fluid_midi_router_rule_t *del_rules[FLUID_MIDI_ROUTER_RULE_COUNT];
-    fluid_midi_router_rule_t *rule, *next_rule, *prev_rule;
-    int i;
+    int ret_val;
 
     fluid_return_val_if_fail(router != NULL, FLUID_FAILED);
 
     fluid_mutex_lock(router->rules_mutex);        /* ++ lock */
 
-    for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
-    {
-        del_rules[i] = NULL;
-        prev_rule = NULL;
-
-        /* Process existing rules */
-        for(rule = router->rules[i]; rule; rule = next_rule)
-        {
-            next_rule = rule->next;
-
-            if(rule->pending_events == 0)     /* Rule has no pending events? */
-            {
-                /* Remove rule from rule list */
-                if(prev_rule)
-                {
-                    prev_rule->next = next_rule;
-                }
-                else if(rule == router->rules[i])
-                {
-                    router->rules[i] = next_rule;
-                }
-
-                /* Prepend to delete list */
-                rule->next = del_rules[i];
-                del_rules[i] = rule;
-            }
-            else
-            {
-                rule->waiting = TRUE;           /* Pending events, mark as waiting */
-                prev_rule = rule;
-            }
-        }
-    }
+    /* Existing rules are removed once they have no pending events anymore */
+    fluid_midi_router_deactivate_rules(router);
+    ret_val = fluid_midi_router_update(router);
 
     fluid_mutex_unlock(router->rules_mutex);      /* -- unlock */
 
-
-    /* Free old rules outside of lock */
-
-    for(i = 0; i < FLUID_MIDI_ROUTER_RULE_COUNT; i++)
-    {
-        for(rule = del_rules[i]; rule; rule = next_rule)
-        {
-            next_rule = rule->next;
-            FLUID_FREE(rule);
-        }
-    }
-
-    return FLUID_OK;
+    return ret_val;
 }
 
 /**
@@ -331,7 +524,7 @@ int
 fluid_midi_router_add_rule(fluid_midi_router_t *router, fluid_midi_router_rule_t *rule,
                            int type)
 {
-    fluid_midi_router_rule_t *free_rules, *next_rule;
+    int ret_val;
 
     fluid_return_val_if_fail(router != NULL, FLUID_FAILED);
     fluid_return_val_if_fail(rule != NULL, FLUID_FAILED);
@@ -340,25 +533,20 @@ fluid_midi_router_add_rule(fluid_midi_router_t *router, fluid_midi_router_rule_t
 
     fluid_mutex_lock(router->rules_mutex);        /* ++ lock */
 
-    /* Take over free rules list, if any (to free outside of lock) */
-    free_rules = router->free_rules;
-    router->free_rules = NULL;
-
     rule->next = router->rules[type];
     router->rules[type] = rule;
 
-    fluid_mutex_unlock(router->rules_mutex);      /* -- unlock */
-
+    ret_val = fluid_midi_router_update(router);
 
-    /* Free any deactivated rules which were waiting for events and are now done */
-
-    for(; free_rules; free_rules = next_rule)
+    if(ret_val != FLUID_OK)
     {
-        next_rule = free_rules->next;
-        FLUID_FREE(free_rules);
+        /* The caller keeps the rule, it is not part of any table */
+        router->rules[type] = rule->next;
     }
 
-    return FLUID_OK;
+    fluid_mutex_unlock(router->rules_mutex);      /* -- unlock */
+
+    return ret_val;
 }
 
 /**
@@ -570,7 +758,26 @@ int
 fluid_midi_router_handle_midi_event(void *data, fluid_midi_event_t *event)
 {
     fluid_midi_router_t *router = (fluid_midi_router_t *)data;
-    fluid_midi_router_rule_t **rulep, *rule, *next_rule, *prev_rule = NULL;
+
+    return fluid_midi_router_route_midi_event(router, event, router->event_handler,
+                                              router->event_handler_data);
+}
+
+/*
+ * Like fluid_midi_router_handle_midi_event(), but passes the generated events to the
+ * given handler instead of the one of the router, e.g. to collect them, see
+ * fluid_midi_driver_handle_events().
+ */
+int
+fluid_midi_router_route_midi_event(fluid_midi_router_t *router, fluid_midi_event_t *event,
+                                   handle_midi_event_func_t handler, void *handler_data)
+{
+    fluid_midi_router_table_t *table;
+    const fluid_midi_router_entry_t *entry, *last;
+    fluid_midi_router_rule_t *rule;
+    int type;
+    int slot; /* Reader count of the router counting this event */
+    int is_chan_mapped; /* Flag, the channel of the generated event has been computed in advance */
     int event_has_par2 = 0; /* Flag, indicates that current event needs two parameters */
     int is_par1_ignored = 0; /* Flag, indicates that current event should be
                                 ignored/clamped when par1 is getting out of range
@@ -584,6 +791,7 @@ fluid_midi_router_handle_midi_event(void *data, fluid_midi_event_t *event)
     int par2;
     int event_par1;
     int event_par2;
+    int i;
     fluid_midi_event_t new_event;
 
     /* Some keyboards report noteoff through a noteon event with vel=0.
@@ -594,29 +802,27 @@ fluid_midi_router_handle_midi_event(void *data, fluid_midi_event_t *event)
         event->param2 = 127;        /* Release velocity */
     }
 
-    fluid_mutex_lock(router->rules_mutex);    /* ++ lock rules */
-
     /* Depending on the event type, choose the correct list of rules. */
     switch(event->type)
     {
     /* For NOTE_ON event, par1(pitch) and par2(velocity) will be clamped if
        they are out of range after the rule had been applied */
     case NOTE_ON:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_NOTE];
+        type = FLUID_MIDI_ROUTER_RULE_NOTE;
         event_has_par2 = 1;
         break;
 
     /* For NOTE_OFF event, par1(pitch) and par2(velocity) will be clamped if
        they are out of range after the rule had been applied */
     case NOTE_OFF:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_NOTE];
+        type = FLUID_MIDI_ROUTER_RULE_NOTE;
         event_has_par2 = 1;
         break;
 
     /* CONTROL_CHANGE event will be ignored if par1 (ctrl num) is out
        of range after the rule had been applied */
     case CONTROL_CHANGE:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_CC];
+        type = FLUID_MIDI_ROUTER_RULE_CC;
         event_has_par2 = 1;
         is_par1_ignored = 1;
         break;
@@ -624,63 +830,65 @@ fluid_midi_router_handle_midi_event(void *data, fluid_midi_event_t *event)
     /* PROGRAM_CHANGE event will be ignored if par1 (program num) is out
        of range after the rule had been applied */
     case PROGRAM_CHANGE:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_PROG_CHANGE];
+        type = FLUID_MIDI_ROUTER_RULE_PROG_CHANGE;
         is_par1_ignored = 1;
         break;
 
     /* For PITCH_BEND event, par1(bend value) will be clamped if
        it is out of range after the rule had been applied */
     case PITCH_BEND:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_PITCH_BEND];
+        type = FLUID_MIDI_ROUTER_RULE_PITCH_BEND;
         par1_max = 16383;
         break;
 
     /* For CHANNEL_PRESSURE event, par1(pressure value) will be clamped if
        it is out of range after the rule had been applied */
     case CHANNEL_PRESSURE:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_CHANNEL_PRESSURE];
+        type = FLUID_MIDI_ROUTER_RULE_CHANNEL_PRESSURE;
         break;
 
     /* For KEY_PRESSURE event, par1(pitch) and par2(pressure value) will be
        clamped if they are out of range after the rule had been applied */
     case KEY_PRESSURE:
-        rulep = &router->rules[FLUID_MIDI_ROUTER_RULE_KEY_PRESSURE];
+        type = FLUID_MIDI_ROUTER_RULE_KEY_PRESSURE;
         event_has_par2 = 1;
         break;
 
     case MIDI_SYSTEM_RESET:
     case MIDI_SYSEX:
-        ret_val = router->event_handler(router->event_handler_data, event);
-        fluid_mutex_unlock(router->rules_mutex);   /* -- unlock rules */
-        return ret_val;
+        return handler(handler_data, event);
 
     default:
-        rulep = NULL;    /* Event will not be passed on */
-        break;
+        return FLUID_OK;    /* Event will not be passed on */
     }
 
+    table = fluid_midi_router_acquire_table(router, &slot);
+
+    /* The rules matching the channel of the event, those of other channels need the channel window to be checked */
+    is_chan_mapped = (event->channel < table->nr_midi_channels);
+    i = type * (table->nr_midi_channels + 1) + (is_chan_mapped ? event->channel : table->nr_midi_channels);
+    entry = &table->entries[table->first[i]];
+    last = &table->entries[table->first[i + 1]];
+
     /* Loop over rules in the list, looking for matches for this event. */
-    for(rule = rulep ? *rulep : NULL; rule; prev_rule = rule, rule = next_rule)
+    for(; entry < last; entry++)
     {
+        rule = entry->rule;
         event_par1 = (int)event->param1;
         event_par2 = (int)event->param2;
-        next_rule = rule->next;     /* Rule may get removed from list, so get next here */
 
         /* Channel window */
-        if(rule->chan_min > rule->chan_max)
+        if(is_chan_mapped)
         {
-            /* Inverted rule: Exclude everything between max and min (but not min/max) */
-            if(event->channel > rule->chan_max && event->channel < rule->chan_min)
-            {
-                continue;
-            }
+            chan = entry->chan;
         }
-        else        /* Normal rule: Exclude everything < max or > min (but not min/max) */
+        else if(fluid_midi_router_rule_match_chan(rule, event->channel))
         {
-            if(event->channel > rule->chan_max || event->channel < rule->chan_min)
-            {
-                continue;
-            }
+            chan = fluid_midi_router_rule_map_chan(rule, event->channel);
+        }
+        else
+        {
+            continue;
         }
 
         /* Par 1 window */
@@ -723,13 +931,6 @@ fluid_midi_router_handle_midi_event(void *data, fluid_midi_event_t *event)
             }
         }
 
-        /* Channel scaling / offset
-         * Note: rule->chan_mul will probably be 0 or 1. If it's 0, input from all
-         * input channels is mapped to the same synth channel.
-         */
-        chan = rule->chan_add + (int)((fluid_real_t)event->channel * rule->chan_mul
-                     + (fluid_real_t)0.5);
-
         /* We ignore the event if chan is out of range */
         if((chan < 0) || (chan >= router->nr_midi_channels))
         {
@@ -793,51 +994,32 @@ fluid_midi_router_handle_midi_event(void *data, fluid_midi_event_t *event)
         if(event->type == NOTE_ON || (event->type == CONTROL_CHANGE
                                       && par1 == SUSTAIN_SWITCH && par2 >= 64))
         {
-            /* Noteon or sustain pedal down event generated */
-            if(rule->keys_cc[par1] == 0)
+            /* Noteon or sustain pedal down event generated, a deactivated rule doesn't get new pending events */
+            if(!fluid_atomic_int_get(&rule->waiting)
+                    && fluid_atomic_int_compare_and_exchange(&rule->keys_cc[par1], 0, 1))
             {
-                rule->keys_cc[par1] = 1;
-                rule->pending_events++;
+                fluid_atomic_int_inc(&rule->pending_events);
             }
         }
         else if(event->type == NOTE_OFF || (event->type == CONTROL_CHANGE
                                             && par1 == SUSTAIN_SWITCH && par2 < 64))
         {
             /* Noteoff or sustain pedal up event generated */
-            if(rule->keys_cc[par1] > 0)
+            if(fluid_atomic_int_compare_and_exchange(&rule->keys_cc[par1], 1, 0))
             {
-                rule->keys_cc[par1] = 0;
-                rule->pending_events--;
+                fluid_atomic_int_add(&rule->pending_events, -1);
 
-                /* Rule is waiting for negative event to be destroyed? */
-                if(rule->waiting)
+                /* Rule is waiting for negative event to be destroyed?
+                 * It is removed by the next change of the rules once it has no pending events. */
+                if(fluid_atomic_int_get(&rule->waiting))
                 {
-                    if(rule->pending_events == 0)
-                    {
-                        /* Remove rule from rule list */
-                        if(prev_rule)
-                        {
-                            prev_rule->next = next_rule;
-                        }
-                        else
-                        {
-                            *rulep = next_rule;
-                        }
-
-                        /* Add to free list */
-                        rule->next = router->free_rules;
-                        router->free_rules = rule;
-
-                        rule = prev_rule;   /* Set rule to previous rule, which gets assigned to the next prev_rule value (in for() statement) */
-                    }
-
                     goto send_event;      /* Pass the event to complete the cycle */
                 }
             }
         }
 
         /* Rule is still waiting for negative event? (note off or pedal up) */
-        if(rule->waiting)
+        if(fluid_atomic_int_get(&rule->waiting))
         {
             continue;    /* Skip (rule is inactive except for matching negative event) */
         }
@@ -851,19 +1033,35 @@ send_event:
         fluid_midi_event_set_channel(&new_event, chan);
         new_event.param1 = par1;
         new_event.param2 = par2;
+        new_event.ingress = event->ingress;
 
         /* On failure, continue to process events, but return failure to caller. */
-        if(router->event_handler(router->event_handler_data, &new_event) != FLUID_OK)
+        if(handler(handler_data, &new_event) != FLUID_OK)
         {
             ret_val = FLUID_FAILED;
         }
     }
 
-    fluid_mutex_unlock(router->rules_mutex);          /* -- unlock rules */
+    fluid_midi_router_release_table(router, slot);
 
     return ret_val;
 }
 
+/*
+ * Returns the synth the router passes its events to, NULL if its handler isn't
+ * fluid_synth_handle_midi_event().
+ */
+fluid_synth_t *
+fluid_midi_router_get_synth(fluid_midi_router_t *router)
+{
+    if(router->event_handler != fluid_synth_handle_midi_event)
+    {
+        return NULL;
+    }
+
+    return (fluid_synth_t *)router->event_handler_data;
+}
+
 /**
  * MIDI event callback function to display event information to stdout
  * @param data MIDI router instance
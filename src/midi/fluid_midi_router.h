@@ -27,5 +27,8 @@
 #include "fluid_midi.h"
 #include "fluid_sys.h"
 
+int fluid_midi_router_route_midi_event(fluid_midi_router_t *router, fluid_midi_event_t *event,
+                                       handle_midi_event_func_t handler, void *handler_data);
+fluid_synth_t *fluid_midi_router_get_synth(fluid_midi_router_t *router);
 
 #endif
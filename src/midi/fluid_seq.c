@@ -30,6 +30,7 @@
 #include "fluid_sys.h"	// timer, threads, etc...
 #include "fluid_list.h"
 #include "fluid_seq_queue.h"
+#include "fluid_trace.h"
 
 /***************************************************************
  *
@@ -38,6 +39,17 @@
 
 #define FLUID_SEQUENCER_EVENTS_MAX	1000
 
+/* Events sent by one call of fluid_sequencer_send_at() or fluid_sequencer_send_batch(),
+ * waiting to be moved to the queue */
+typedef struct _fluid_seq_staged_event_t fluid_seq_staged_event_t;
+
+struct _fluid_seq_staged_event_t
+{
+    fluid_seq_staged_event_t *next;
+    int count;
+    fluid_event_t evt[1];   /* allocated for count events */
+};
+
 /* Private data for SEQUENCER */
 struct _fluid_sequencer_t
 {
@@ -66,6 +78,10 @@ struct _fluid_sequencer_t
     // Pointer to the C++ event queue
     void *queue;
     fluid_rec_mutex_t mutex;
+
+    // Lock-free stack of the events sent since the queue has been updated for the last time,
+    // the most recent one first. Any thread may push to it, it is emptied with the mutex locked.
+    fluid_seq_staged_event_t *staged;
 };
 
 /* Private data for clients */
@@ -74,10 +90,15 @@ typedef struct _fluid_sequencer_client_t
     fluid_seq_id_t id;
     char *name;
     fluid_event_callback_t callback;
+    fluid_event_batch_callback_t batch_callback;
     void *data;
 } fluid_sequencer_client_t;
 
 
+static fluid_seq_staged_event_t *new_fluid_seq_staged_event(int count);
+static void fluid_sequencer_push_staged(fluid_sequencer_t *seq, fluid_seq_staged_event_t *staged);
+static int fluid_sequencer_drain_staged(fluid_sequencer_t *seq);
+
 /* API implementation */
 
 /**
@@ -164,6 +185,7 @@ delete_fluid_sequencer(fluid_sequencer_t *seq)
         fluid_sequencer_unregister_client(seq, client->id);
     }
 
+    fluid_sequencer_drain_staged(seq);
     fluid_rec_mutex_destroy(seq->mutex);
     delete_fluid_seq_queue(seq->queue);
 
@@ -236,6 +258,7 @@ fluid_sequencer_register_client(fluid_sequencer_t *seq, const char *name,
     client->name = nameCopy;
     client->id = seq->clientsID;
     client->callback = callback;
+    client->batch_callback = NULL;
     client->data = data;
 
     seq->clients = fluid_list_append(seq->clients, (void *)client);
@@ -297,6 +320,50 @@ fluid_sequencer_unregister_client(fluid_sequencer_t *seq, fluid_seq_id_t id)
     return;
 }
 
+/**
+ * Set a callback receiving several events at once of a destination client.
+ *
+ * @param seq Sequencer object
+ * @param id ID of a destination client, as returned by fluid_sequencer_register_client()
+ * @param callback Batch callback or NULL to receive every event by the callback of the client again
+ * @return #FLUID_OK on success, #FLUID_FAILED if the client isn't found or isn't a destination
+ *
+ * Events the queue dispatches one after the other to the client are passed to \a callback at
+ * once, along with the data the client has been registered with, instead of to its callback
+ * one by one. The events sent by fluid_sequencer_send_now() and the #FLUID_SEQ_UNREGISTERING
+ * event still go to the callback of the client.
+ *
+ * A batch ends with an event of type #FLUID_SEQ_NOTE or #FLUID_SEQ_SCALE, because handling them
+ * may change the events still queued.
+ *
+ * @since 2.6.0
+ */
+int
+fluid_sequencer_set_client_batch_callback(fluid_sequencer_t *seq, fluid_seq_id_t id,
+        fluid_event_batch_callback_t callback)
+{
+    fluid_list_t *tmp;
+
+    fluid_return_val_if_fail(seq != NULL, FLUID_FAILED);
+
+    fluid_rec_mutex_lock(seq->mutex);
+
+    for(tmp = seq->clients; tmp; tmp = tmp->next)
+    {
+        fluid_sequencer_client_t *client = (fluid_sequencer_client_t *)tmp->data;
+
+        if(client->id == id && client->callback != NULL)
+        {
+            client->batch_callback = callback;
+            fluid_rec_mutex_unlock(seq->mutex);
+            return FLUID_OK;
+        }
+    }
+
+    fluid_rec_mutex_unlock(seq->mutex);
+    return FLUID_FAILED;
+}
+
 /**
  * Count a sequencers registered clients.
  *
@@ -470,13 +537,16 @@ fluid_sequencer_send_now(fluid_sequencer_t *seq, fluid_event_t *evt)
  * \n
  * Or mathematically: #FLUID_SEQ_NOTEOFF < #FLUID_SEQ_SYSTEMRESET < #FLUID_SEQ_UNREGISTERING < ... < (#FLUID_SEQ_NOTEON && #FLUID_SEQ_NOTE)
  *
+ * @note This function may be called from any thread at the same time, it doesn't wait for the
+ * sequencer. The event is moved to the queue with the next call to fluid_sequencer_process().
+ *
  * @warning Be careful with relative ticks when sending many events! See #fluid_event_callback_t for details.
  */
 int
 fluid_sequencer_send_at(fluid_sequencer_t *seq, fluid_event_t *evt,
                         unsigned int time, int absolute)
 {
-    int res;
+    fluid_seq_staged_event_t *staged;
     unsigned int now = fluid_sequencer_get_tick(seq);
 
     fluid_return_val_if_fail(seq != NULL, FLUID_FAILED);
@@ -491,11 +561,156 @@ fluid_sequencer_send_at(fluid_sequencer_t *seq, fluid_event_t *evt,
     /* time stamp event */
     fluid_event_set_time(evt, time);
 
-    fluid_rec_mutex_lock(seq->mutex);
-    res = fluid_seq_queue_push(seq->queue, evt);
-    fluid_rec_mutex_unlock(seq->mutex);
+    staged = new_fluid_seq_staged_event(1);
+
+    if(staged == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    staged->evt[0] = *evt;
+    fluid_sequencer_push_staged(seq, staged);
 
-    return res;
+    return FLUID_OK;
+}
+
+/**
+ * Schedule several events for sending at a later time.
+ *
+ * @param seq Sequencer object
+ * @param evts Array of \a count events to send (will be copied into internal queue)
+ * @param times Array of \a count time values in ticks, one for each event
+ * @param count Number of events
+ * @param absolute TRUE if the \a times are absolute sequencer time (time since sequencer
+ *   creation), FALSE if relative to current time.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise, in which case none of the events has been sent
+ *
+ * Like calling fluid_sequencer_send_at() for each of the events in turn, but much cheaper for many events.
+ * Relative times all refer to the same current time. Events with the same timestamp are dispatched
+ * in the order described for fluid_sequencer_send_at().
+ *
+ * @since 2.6.0
+ */
+int
+fluid_sequencer_send_batch(fluid_sequencer_t *seq, fluid_event_t **evts,
+                           const unsigned int *times, int count, int absolute)
+{
+    fluid_seq_staged_event_t *staged;
+    unsigned int now;
+    int i;
+
+    fluid_return_val_if_fail(seq != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(count >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(count == 0 || (evts != NULL && times != NULL), FLUID_FAILED);
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_return_val_if_fail(evts[i] != NULL, FLUID_FAILED);
+    }
+
+    if(count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    staged = new_fluid_seq_staged_event(count);
+
+    if(staged == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    now = absolute ? 0 : fluid_sequencer_get_tick(seq);
+
+    for(i = 0; i < count; i++)
+    {
+        /* time stamp event */
+        fluid_event_set_time(evts[i], now + times[i]);
+        staged->evt[i] = *evts[i];
+    }
+
+    fluid_sequencer_push_staged(seq, staged);
+
+    return FLUID_OK;
+}
+
+static fluid_seq_staged_event_t *
+new_fluid_seq_staged_event(int count)
+{
+    fluid_seq_staged_event_t *staged;
+
+    staged = FLUID_MALLOC(sizeof(*staged) + (count - 1) * sizeof(fluid_event_t));
+
+    if(staged == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "sequencer: Out of memory\n");
+        return NULL;
+    }
+
+    staged->count = count;
+    return staged;
+}
+
+/* Pushes the events without taking the mutex, so that threads sending events
+ * don't wait for each other or for the events being dispatched. */
+static void
+fluid_sequencer_push_staged(fluid_sequencer_t *seq, fluid_seq_staged_event_t *staged)
+{
+    fluid_seq_staged_event_t *head;
+
+    do
+    {
+        head = fluid_atomic_pointer_get(&seq->staged);
+        staged->next = head;
+    }
+    while(!fluid_atomic_pointer_compare_and_exchange((void **)&seq->staged, head, staged));
+}
+
+/*
+ * Moves the events sent by fluid_sequencer_send_at() to the queue, in the order they have been sent.
+ * Must be called with the mutex locked, or when no other thread uses the sequencer.
+ * Returns TRUE if any of them is due at the current tick.
+ */
+static int
+fluid_sequencer_drain_staged(fluid_sequencer_t *seq)
+{
+    fluid_seq_staged_event_t *staged, *next, *reversed = NULL;
+    int i, due = FALSE;
+
+    /* take all of them at once, only pushing may happen concurrently */
+    do
+    {
+        staged = fluid_atomic_pointer_get(&seq->staged);
+    }
+    while(staged != NULL && !fluid_atomic_pointer_compare_and_exchange((void **)&seq->staged, staged, NULL));
+
+    for(; staged != NULL; staged = next)
+    {
+        next = staged->next;
+        staged->next = reversed;
+        reversed = staged;
+    }
+
+    for(; reversed != NULL; reversed = next)
+    {
+        next = reversed->next;
+
+        for(i = 0; i < reversed->count; i++)
+        {
+            if(fluid_seq_queue_push(seq->queue, &reversed->evt[i]) != FLUID_OK)
+            {
+                FLUID_LOG(FLUID_ERR, "sequencer: Out of memory, event dropped\n");
+            }
+            else
+            {
+                due |= (fluid_event_get_time(&reversed->evt[i]) <= seq->cur_ticks);
+            }
+        }
+
+        FLUID_FREE(reversed);
+    }
+
+    return due;
 }
 
 /**
@@ -513,6 +728,7 @@ fluid_sequencer_remove_events(fluid_sequencer_t *seq, fluid_seq_id_t source,
     fluid_return_if_fail(seq != NULL);
 
     fluid_rec_mutex_lock(seq->mutex);
+    fluid_sequencer_drain_staged(seq);
     fluid_seq_queue_remove(seq->queue, source, dest, type);
     fluid_rec_mutex_unlock(seq->mutex);
 }
@@ -613,20 +829,96 @@ fluid_sequencer_get_time_scale(fluid_sequencer_t *seq)
 void
 fluid_sequencer_process(fluid_sequencer_t *seq, unsigned int msec)
 {
+    double trace_ref = fluid_trace_ref();
+
     fluid_atomic_int_set(&seq->currentMs, msec);
     seq->cur_ticks = fluid_sequencer_get_tick_LOCAL(seq, msec);
 
     fluid_rec_mutex_lock(seq->mutex);
-    fluid_seq_queue_process(seq->queue, seq, seq->cur_ticks);
+    fluid_sequencer_drain_staged(seq);
+
+    /* callbacks may send events due at the current tick, dispatch them as well */
+    do
+    {
+        fluid_seq_queue_process(seq->queue, seq, seq->cur_ticks);
+    }
+    while(fluid_sequencer_drain_staged(seq));
+
     fluid_rec_mutex_unlock(seq->mutex);
+    fluid_trace_span("sequencer_process", trace_ref);
 }
 
 
+/**
+ * @internal
+ * only used privately by fluid_player_render() and fluid_sequencer_render(). Returns for how many
+ * milliseconds after the latest call of fluid_sequencer_process() no event is due, UINT_MAX if no
+ * event is queued at all.
+ */
+unsigned int fluid_sequencer_get_idle_msec(fluid_sequencer_t *seq)
+{
+    unsigned int tick;
+    int found;
+    double msec;
+
+    if(seq->useSystemTimer)
+    {
+        return 0;
+    }
+
+    fluid_rec_mutex_lock(seq->mutex);
+    fluid_sequencer_drain_staged(seq);
+    found = fluid_seq_queue_get_next_tick(seq->queue, &tick);
+    fluid_rec_mutex_unlock(seq->mutex);
+
+    if(!found)
+    {
+        return UINT_MAX;
+    }
+
+    if(tick <= seq->cur_ticks)
+    {
+        return 0;
+    }
+
+    /* the inverse of fluid_sequencer_get_tick_LOCAL() */
+    msec = seq->startMs + (tick - seq->start_ticks) * 1000.0 / seq->scale
+           - (unsigned int)fluid_atomic_int_get(&seq->currentMs);
+
+    return (msec > 1.0) ? (unsigned int)msec - 1 : 0;
+}
+
 /**
  * @internal
  * only used privately by fluid_seqbind and only from sequencer callback, thus lock acquire is not needed.
  */
 void fluid_sequencer_invalidate_note(fluid_sequencer_t *seq, fluid_seq_id_t dest, fluid_note_id_t id)
 {
+    /* the noteoff may have been sent since the queue has been processed */
+    fluid_sequencer_drain_staged(seq);
     fluid_seq_queue_invalidate_note_private(seq->queue, dest, id);
 }
+
+/**
+ * @internal
+ * only used privately by fluid_seq_queue_process(), with the lock held. Returns the batch callback of
+ * the destination client \a id and stores its data to \a data, NULL if it has none.
+ */
+fluid_event_batch_callback_t
+fluid_sequencer_get_batch_callback(fluid_sequencer_t *seq, fluid_seq_id_t id, void **data)
+{
+    fluid_list_t *tmp;
+
+    for(tmp = seq->clients; tmp; tmp = tmp->next)
+    {
+        fluid_sequencer_client_t *client = (fluid_sequencer_client_t *)tmp->data;
+
+        if(client->id == id)
+        {
+            *data = client->data;
+            return client->batch_callback;
+        }
+    }
+
+    return NULL;
+}
@@ -20,24 +20,160 @@
 #include "fluid_seq_queue.h"
 
 #include <deque>
+#include <vector>
 #include <algorithm>
 #include <limits>
+#include <unordered_map>
 
 /*
  * This is an implementation of an event queue, sorted according to their timestamp.
  *
- * Very similar to std::priority_queue.
+ * The events are kept in a hierarchical timer wheel: the first level has one slot for each of the
+ * next 256 ticks, each further level has 64 slots, each one covering 64 slots of the level below.
+ * The 5 levels cover the whole range of 32 bit ticks. An event is pushed into the slot of its tick
+ * on the lowest level that reaches it, and moved down level by level ("cascaded") as the time
+ * approaches it. This makes pushing and dispatching an event O(1) on average, independently of the
+ * number of events in the queue.
  *
- * However, we cannot use std::priority_queue, because fluid_sequencer_remove_events() requires
- * access to the underlying container, which however std::priority_queue doesn't provide (without hacks).
- * On the other hand, implementing a priority_queue while managing our own heap structure is very
- * simple to do using std::make_heap() and friends.
+ * Once the events of a tick are due, they are moved to a small heap, which dispatches them in the
+ * order given by event_compare(). Events pushed for a tick that has already been passed go there, too.
+ *
+ * Every event is also linked into a list of the events of its source and of its destination, so that
+ * fluid_sequencer_remove_events() and fluid_sequencer_invalidate_note() only have to look at
+ * the events of one client.
  */
 
-// we are using a deque rather than vector, because:
-// "Expansion of a deque is cheaper than the expansion of a std::vector because it does not involve
-// copying of the existing elements to a new memory location."
-typedef std::deque<fluid_event_t> seq_queue_t;
+namespace
+{
+
+struct seq_queue_node_t
+{
+    fluid_event_t evt;
+    unsigned long long order; // the order of pushing, to dispatch events of the same precedence FIFO
+
+    // the slot list or, if slot is NULL, the position in the heap of due events
+    seq_queue_node_t *next;
+    seq_queue_node_t **slot;
+
+    // the lists of the source and destination client
+    seq_queue_node_t *src_next, **src_prev;
+    seq_queue_node_t *dest_next, **dest_prev;
+};
+
+const int WHEEL_LEVELS = 5;
+
+// the most events passed at once to a batch callback, see fluid_sequencer_set_client_batch_callback()
+const int FLUID_SEQ_QUEUE_MAX_BATCH = 64;
+const int WHEEL_LEVEL0_BITS = 8;
+const int WHEEL_LEVELN_BITS = 6;
+const int WHEEL_LEVEL0_SIZE = 1 << WHEEL_LEVEL0_BITS;
+const int WHEEL_LEVELN_SIZE = 1 << WHEEL_LEVELN_BITS;
+
+// the number of bits of a tick below the slot index of the given level
+inline int wheel_shift(int level)
+{
+    return (level == 0) ? 0 : WHEEL_LEVEL0_BITS + (level - 1) * WHEEL_LEVELN_BITS;
+}
+
+inline unsigned int wheel_slot_count(int level)
+{
+    return (level == 0) ? WHEEL_LEVEL0_SIZE : WHEEL_LEVELN_SIZE;
+}
+
+struct seq_queue_t
+{
+    // the next tick to look at, all events before it are either dispatched or in the heap of due events
+    unsigned long long now = 0;
+    unsigned long long pushed = 0;
+
+    seq_queue_node_t *level0[WHEEL_LEVEL0_SIZE] = {};
+    seq_queue_node_t *levels[WHEEL_LEVELS - 1][WHEEL_LEVELN_SIZE] = {};
+    // one bit for each non-empty slot
+    unsigned long long bits0[WHEEL_LEVEL0_SIZE / 64] = {};
+    unsigned long long bits[WHEEL_LEVELS - 1] = {};
+
+    std::vector<seq_queue_node_t *> due;
+
+    std::unordered_map<fluid_seq_id_t, seq_queue_node_t *> by_src;
+    std::unordered_map<fluid_seq_id_t, seq_queue_node_t *> by_dest;
+
+    // a deque keeps the nodes in place when growing
+    std::deque<seq_queue_node_t> nodes;
+    seq_queue_node_t *free_nodes = nullptr;
+
+    seq_queue_node_t **slot(int level, unsigned int index)
+    {
+        return (level == 0) ? &level0[index] : &levels[level - 1][index];
+    }
+
+    void set_bit(int level, unsigned int index)
+    {
+        if(level == 0)
+        {
+            bits0[index / 64] |= 1ULL << (index % 64);
+        }
+        else
+        {
+            bits[level - 1] |= 1ULL << index;
+        }
+    }
+
+    void clear_bit(int level, unsigned int index)
+    {
+        if(level == 0)
+        {
+            bits0[index / 64] &= ~(1ULL << (index % 64));
+        }
+        else
+        {
+            bits[level - 1] &= ~(1ULL << index);
+        }
+    }
+
+    bool level_is_empty(int level) const
+    {
+        if(level != 0)
+        {
+            return bits[level - 1] == 0;
+        }
+
+        for(unsigned long long b : bits0)
+        {
+            if(b != 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // the first non-empty slot of the level at or after index, or -1
+    int find_slot(int level, unsigned int index) const
+    {
+        for(unsigned int i = index; i < wheel_slot_count(level); i++)
+        {
+            unsigned long long b = (level == 0) ? bits0[i / 64] : bits[level - 1];
+            unsigned int bit = (level == 0) ? i % 64 : i;
+
+            if(b >> bit == 0)
+            {
+                // skip the rest of this word
+                i |= 63;
+                continue;
+            }
+
+            if(b & (1ULL << bit))
+            {
+                return static_cast<int>(i);
+            }
+        }
+
+        return -1;
+    }
+};
+
+}
 
 static bool event_compare(const fluid_event_t& left, const fluid_event_t& right)
 {
@@ -119,16 +255,278 @@ int event_compare_for_test(const fluid_event_t* left, const fluid_event_t* right
     return event_compare(*left, *right);
 }
 
+// ordering of the heap of due events, see event_compare()
+static bool node_compare(const seq_queue_node_t *left, const seq_queue_node_t *right)
+{
+    if(event_compare(left->evt, right->evt))
+    {
+        return true;
+    }
+
+    if(event_compare(right->evt, left->evt))
+    {
+        return false;
+    }
+
+    // same tick and same precedence
+    return left->order > right->order;
+}
+
+static void link_client(std::unordered_map<fluid_seq_id_t, seq_queue_node_t *> &map, fluid_seq_id_t id,
+                        seq_queue_node_t *node, seq_queue_node_t *seq_queue_node_t::*next,
+                        seq_queue_node_t **seq_queue_node_t::*prev)
+{
+    seq_queue_node_t *&head = map[id];
+
+    node->*next = head;
+    node->*prev = &head;
+
+    if(head != nullptr)
+    {
+        head->*prev = &(node->*next);
+    }
+
+    head = node;
+}
+
+static void unlink_client(seq_queue_node_t *node, seq_queue_node_t *seq_queue_node_t::*next,
+                          seq_queue_node_t **seq_queue_node_t::*prev)
+{
+    if(node->*prev == nullptr)
+    {
+        return;
+    }
+
+    *(node->*prev) = node->*next;
+
+    if(node->*next != nullptr)
+    {
+        (node->*next)->*prev = node->*prev;
+    }
+
+    node->*next = nullptr;
+    node->*prev = nullptr;
+}
+
+static seq_queue_node_t *new_node(seq_queue_t &queue)
+{
+    seq_queue_node_t *node = queue.free_nodes;
+
+    if(node != nullptr)
+    {
+        queue.free_nodes = node->next;
+    }
+    else
+    {
+        queue.nodes.emplace_back();
+        node = &queue.nodes.back();
+    }
+
+    return node;
+}
+
+static void delete_node(seq_queue_t &queue, seq_queue_node_t *node)
+{
+    unlink_client(node, &seq_queue_node_t::src_next, &seq_queue_node_t::src_prev);
+    unlink_client(node, &seq_queue_node_t::dest_next, &seq_queue_node_t::dest_prev);
+
+    node->next = queue.free_nodes;
+    node->slot = nullptr;
+    queue.free_nodes = node;
+}
+
+// Puts the node into the wheel or, if its tick has already been passed, into the heap of due events
+static void insert_node(seq_queue_t &queue, seq_queue_node_t *node)
+{
+    unsigned int time = node->evt.time;
+    unsigned long long delta;
+    int level;
+
+    if(time < queue.now)
+    {
+        node->slot = nullptr;
+        queue.due.push_back(node);
+        std::push_heap(queue.due.begin(), queue.due.end(), node_compare);
+        return;
+    }
+
+    delta = time - queue.now;
+
+    for(level = 0; level < WHEEL_LEVELS - 1; level++)
+    {
+        if(delta < (1ULL << wheel_shift(level + 1)))
+        {
+            break;
+        }
+    }
+
+    unsigned int index = (time >> wheel_shift(level)) & (wheel_slot_count(level) - 1);
+    seq_queue_node_t **slot = queue.slot(level, index);
+
+    // the order within a slot doesn't matter, the heap of due events sorts them
+    node->next = *slot;
+    node->slot = slot;
+    *slot = node;
+    queue.set_bit(level, index);
+}
+
+// Unlinks a node from its slot or from the heap of due events, returns whether the heap needs to be rebuilt
+static bool remove_node(seq_queue_t &queue, seq_queue_node_t *node)
+{
+    if(node->slot == nullptr)
+    {
+        queue.due.erase(std::find(queue.due.begin(), queue.due.end(), node));
+        return true;
+    }
+
+    seq_queue_node_t **it = node->slot;
+
+    while(*it != node)
+    {
+        it = &(*it)->next;
+    }
+
+    *it = node->next;
+
+    if(*node->slot == nullptr)
+    {
+        // find the slot the node has been in, to clear its bit
+        for(int level = 0; level < WHEEL_LEVELS; level++)
+        {
+            seq_queue_node_t **first = queue.slot(level, 0);
+
+            if(node->slot >= first && node->slot < first + wheel_slot_count(level))
+            {
+                queue.clear_bit(level, static_cast<unsigned int>(node->slot - first));
+                break;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Takes all nodes out of a slot and inserts them again relative to the current tick
+static void cascade_slot(seq_queue_t &queue, int level, unsigned int index)
+{
+    seq_queue_node_t **slot = queue.slot(level, index);
+    seq_queue_node_t *node = *slot;
+
+    *slot = nullptr;
+    queue.clear_bit(level, index);
+
+    while(node != nullptr)
+    {
+        seq_queue_node_t *next = node->next;
+        insert_node(queue, node);
+        node = next;
+    }
+}
+
+// Called when the current tick reaches the start of a slot on the levels above the first one
+static void cascade(seq_queue_t &queue)
+{
+    for(int level = 1; level < WHEEL_LEVELS; level++)
+    {
+        if((queue.now & ((1ULL << wheel_shift(level)) - 1)) != 0 || queue.now > std::numeric_limits<unsigned int>::max())
+        {
+            break;
+        }
+
+        cascade_slot(queue, level, (queue.now >> wheel_shift(level)) & (WHEEL_LEVELN_SIZE - 1));
+    }
+}
+
+// Advances the current tick up to cur_ticks + 1, stopping at the next tick with events.
+// Those events are moved to the heap of due events. Returns false if there are none up to cur_ticks.
+static bool advance(seq_queue_t &queue, unsigned int cur_ticks)
+{
+    const unsigned long long end = static_cast<unsigned long long>(cur_ticks) + 1;
+
+    while(queue.now < end)
+    {
+        unsigned int index = queue.now & (WHEEL_LEVEL0_SIZE - 1);
+        int found = queue.find_slot(0, index);
+
+        if(found >= 0)
+        {
+            unsigned long long time = queue.now - index + found;
+
+            if(time >= end)
+            {
+                queue.now = end;
+                return false;
+            }
+
+            // all events of the slot are at this tick, they are due now
+            queue.now = time + 1;
+            cascade_slot(queue, 0, found);
+
+            if((queue.now & (WHEEL_LEVEL0_SIZE - 1)) == 0)
+            {
+                cascade(queue);
+            }
+
+            return true;
+        }
+
+        // Nothing more in the current range of the first level. Skip to the start of the next
+        // slot of the lowest level that has events ahead.
+        unsigned long long next = 0;
+
+        for(int level = 0; level < WHEEL_LEVELS && next == 0; level++)
+        {
+            const int shift = wheel_shift(level);
+            const unsigned long long upper = 1ULL << wheel_shift(level + 1);
+
+            if(queue.level_is_empty(level))
+            {
+                continue;
+            }
+
+            if(level > 0)
+            {
+                found = queue.find_slot(level, ((queue.now >> shift) & (WHEEL_LEVELN_SIZE - 1)) + 1);
+
+                if(found >= 0)
+                {
+                    next = (queue.now & ~(upper - 1)) + (static_cast<unsigned long long>(found) << shift);
+                    break;
+                }
+            }
+
+            // the events on this level are in its next turn
+            next = (queue.now & ~(upper - 1)) + upper;
+        }
+
+        if(next == 0 || next > end)
+        {
+            // no slot to cascade up to cur_ticks
+            queue.now = end;
+            return false;
+        }
+
+        queue.now = next;
+        cascade(queue);
+    }
+
+    return false;
+}
+
 void* new_fluid_seq_queue(int nb_events)
 {
     try
     {
-        // As workaround for a missing deque::reserve(), allocate a deque with a size of nb_events
-        seq_queue_t* queue = new seq_queue_t(nb_events);
-        // and clear the queue again
-        queue->clear();
-        // C++11 introduced a deque::shrink_to_fit(), so hopefully not calling shrink_to_fit() will
-        // leave the previously used memory allocated, avoiding reallocation for subsequent insertions.
+        seq_queue_t* queue = new seq_queue_t;
+
+        // allocate the nodes for nb_events upfront, avoiding allocations for subsequent insertions
+        queue->due.reserve(nb_events);
+
+        for(int i = 0; i < nb_events; i++)
+        {
+            seq_queue_node_t *node = new_node(*queue);
+            delete_node(*queue, node);
+        }
 
         return queue;
     }
@@ -148,9 +546,23 @@ int fluid_seq_queue_push(void *que, const fluid_event_t *evt)
     try
     {
         seq_queue_t& queue = *static_cast<seq_queue_t*>(que);
+        seq_queue_node_t *node = new_node(queue);
 
-        queue.push_back(*evt);
-        std::push_heap(queue.begin(), queue.end(), event_compare);
+        node->evt = *evt;
+        node->order = queue.pushed++;
+        node->src_prev = node->dest_prev = nullptr;
+
+        try
+        {
+            link_client(queue.by_src, evt->src, node, &seq_queue_node_t::src_next, &seq_queue_node_t::src_prev);
+            link_client(queue.by_dest, evt->dest, node, &seq_queue_node_t::dest_next, &seq_queue_node_t::dest_prev);
+            insert_node(queue, node);
+        }
+        catch(...)
+        {
+            delete_node(queue, node);
+            throw;
+        }
 
         return FLUID_OK;
     }
@@ -163,90 +575,205 @@ int fluid_seq_queue_push(void *que, const fluid_event_t *evt)
 void fluid_seq_queue_remove(void *que, fluid_seq_id_t src, fluid_seq_id_t dest, int type)
 {
     seq_queue_t& queue = *static_cast<seq_queue_t*>(que);
+    std::vector<seq_queue_node_t *>::size_type i;
+    bool rebuild_heap = false;
 
     if(src == -1 && dest == -1 && type == -1)
     {
         // shortcut for deleting everything
-        queue.clear();
+        for(i = 0; i < queue.nodes.size(); i++)
+        {
+            seq_queue_node_t *node = &queue.nodes[i];
+
+            if(node->src_prev != nullptr)
+            {
+                node->src_prev = node->dest_prev = nullptr;
+                delete_node(queue, node);
+            }
+        }
+
+        std::fill(std::begin(queue.level0), std::end(queue.level0), nullptr);
+        std::fill(&queue.levels[0][0], &queue.levels[0][0] + (WHEEL_LEVELS - 1) * WHEEL_LEVELN_SIZE, nullptr);
+        std::fill(std::begin(queue.bits0), std::end(queue.bits0), 0);
+        std::fill(std::begin(queue.bits), std::end(queue.bits), 0);
+        queue.due.clear();
+        queue.by_src.clear();
+        queue.by_dest.clear();
+        return;
     }
-    else
+
+    if(dest != -1 || src != -1)
     {
-        for (seq_queue_t::iterator it = queue.begin(); it != queue.end();)
+        // only look at the events of one client
+        const bool by_dest = (dest != -1);
+        auto &map = by_dest ? queue.by_dest : queue.by_src;
+        auto client = map.find(by_dest ? dest : src);
+        seq_queue_node_t *node = (client != map.end()) ? client->second : nullptr;
+
+        while(node != nullptr)
         {
-            if((src == -1 || it->src == src) &&
-            (dest == -1 || it->dest == dest) &&
-            (type == -1 || it->type == type))
+            seq_queue_node_t *next = by_dest ? node->dest_next : node->src_next;
+
+            if((src == -1 || node->evt.src == src) &&
+            (dest == -1 || node->evt.dest == dest) &&
+            (type == -1 || node->evt.type == type))
             {
-                it = queue.erase(it);
+                rebuild_heap |= remove_node(queue, node);
+                delete_node(queue, node);
             }
-            else
+
+            node = next;
+        }
+    }
+    else
+    {
+        for(i = 0; i < queue.nodes.size(); i++)
+        {
+            seq_queue_node_t *node = &queue.nodes[i];
+
+            // nodes in the free list aren't linked to a source
+            if(node->src_prev != nullptr && node->evt.type == type)
             {
-                ++it;
+                rebuild_heap |= remove_node(queue, node);
+                delete_node(queue, node);
             }
         }
+    }
+
+    if(rebuild_heap)
+    {
+        std::make_heap(queue.due.begin(), queue.due.end(), node_compare);
+    }
+}
 
-        std::make_heap(queue.begin(), queue.end(), event_compare);
+int fluid_seq_queue_get_next_tick(void *que, unsigned int *tick)
+{
+    seq_queue_t& queue = *static_cast<seq_queue_t*>(que);
+    bool found = false;
+
+    // every queued event is in the list of its source
+    for(const auto &client : queue.by_src)
+    {
+        for(const seq_queue_node_t *node = client.second; node != nullptr; node = node->src_next)
+        {
+            if(!found || node->evt.time < *tick)
+            {
+                *tick = node->evt.time;
+                found = true;
+            }
+        }
     }
+
+    return found;
 }
 
 void fluid_seq_queue_invalidate_note_private(void *que, fluid_seq_id_t dest, fluid_note_id_t id)
 {
     seq_queue_t& queue = *static_cast<seq_queue_t*>(que);
 
-    seq_queue_t::iterator event_to_invalidate = queue.end();
+    seq_queue_node_t *event_to_invalidate = nullptr;
     unsigned int earliest_noteoff_tick = std::numeric_limits<unsigned int>::max();
+    auto client = queue.by_dest.find(dest);
 
-    for (seq_queue_t::iterator it = queue.begin(); it != queue.end(); it++)
+    for (seq_queue_node_t *it = (client != queue.by_dest.end()) ? client->second : nullptr; it != nullptr; it = it->dest_next)
     {
-        if((it->dest == dest) &&
-        (it->type == FLUID_SEQ_NOTEOFF) &&
-        (it->id == id) &&
-        (it->time < earliest_noteoff_tick))
+        if((it->evt.dest == dest) &&
+        (it->evt.type == FLUID_SEQ_NOTEOFF) &&
+        (fluid_event_get_id(&it->evt) == id) &&
+        (it->evt.time < earliest_noteoff_tick))
         {
-            earliest_noteoff_tick = it->time;
+            earliest_noteoff_tick = it->evt.time;
             event_to_invalidate = it;
         }
     }
 
-    if(event_to_invalidate != queue.end())
+    if(event_to_invalidate != nullptr)
     {
         // Invalidate the event, by setting invalidating its destination.
-        // Instead, removing the event from the queue would mess up the heap structure. We would need to
-        // make_heap again, which costs time, etc...
-        event_to_invalidate->dest = -1;
+        // It stays in the wheel, but leaves the list of its former destination.
+        unlink_client(event_to_invalidate, &seq_queue_node_t::dest_next, &seq_queue_node_t::dest_prev);
+        event_to_invalidate->evt.dest = -1;
+        link_client(queue.by_dest, -1, event_to_invalidate, &seq_queue_node_t::dest_next, &seq_queue_node_t::dest_prev);
     }
 }
 
-static void fluid_seq_queue_pop(seq_queue_t &queue)
+// Returns the next event due up to cur_ticks, nullptr if there is none
+static seq_queue_node_t *next_due(seq_queue_t &queue, unsigned int cur_ticks)
 {
-    std::pop_heap(queue.begin(), queue.end(), event_compare);
-    queue.pop_back();
+    while(queue.due.empty() || queue.due.front()->evt.time > cur_ticks)
+    {
+        // move the events of the next tick up to cur_ticks into the heap
+        if(!advance(queue, cur_ticks))
+        {
+            return nullptr;
+        }
+    }
+
+    return queue.due.front();
+}
+
+// Copies the next due event to evt and pops it from the queue.
+// The copy is required because the content of the queue should be read-only to the client,
+// however, most client function receive a non-const fluid_event_t pointer.
+// Popping it first lets client-callbacks add new events without messing up the heap structure
+// while we are still processing.
+static void pop_due(seq_queue_t &queue, fluid_event_t &evt)
+{
+    seq_queue_node_t *top = queue.due.front();
+
+    evt = top->evt;
+    std::pop_heap(queue.due.begin(), queue.due.end(), node_compare);
+    queue.due.pop_back();
+    delete_node(queue, top);
+}
+
+// whether handling the event may change the events still queued, which ends a batch
+static bool ends_batch(const fluid_event_t &evt)
+{
+    return evt.type == FLUID_SEQ_NOTE || evt.type == FLUID_SEQ_SCALE;
 }
 
 void fluid_seq_queue_process(void *que, fluid_sequencer_t *seq, unsigned int cur_ticks)
 {
     seq_queue_t& queue = *static_cast<seq_queue_t*>(que);
+    fluid_event_t batch[FLUID_SEQ_QUEUE_MAX_BATCH];
+    fluid_event_t *events[FLUID_SEQ_QUEUE_MAX_BATCH];
+    fluid_event_batch_callback_t callback;
+    seq_queue_node_t *top;
+    void *data;
+    int count;
 
-    while(!queue.empty())
+    while((top = next_due(queue, cur_ticks)) != nullptr)
     {
-        // Get the top most event.
-        const fluid_event_t& top = queue.front();
-        if(top.time <= cur_ticks)
+        callback = nullptr;
+
+        if(top->evt.type != FLUID_SEQ_UNREGISTERING)
         {
-            // First, copy it to a local buffer.
-            // This is required because the content of the queue should be read-only to the client,
-            // however, most client function receive a non-const fluid_event_t pointer
-            fluid_event_t local_evt = top;
+            callback = fluid_sequencer_get_batch_callback(seq, top->evt.dest, &data);
+        }
 
-            // Then, pop the queue, so that client-callbacks may add new events without
-            // messing up the heap structure while we are still processing
-            fluid_seq_queue_pop(queue);
+        if(callback == nullptr)
+        {
+            fluid_event_t local_evt;
+
+            pop_due(queue, local_evt);
             fluid_sequencer_send_now(seq, &local_evt);
+            continue;
         }
-        else
+
+        // the events of the client following each other are passed at once
+        count = 0;
+
+        do
         {
-            break;
+            pop_due(queue, batch[count]);
+            events[count] = &batch[count];
+            count++;
         }
+        while(count < FLUID_SEQ_QUEUE_MAX_BATCH && !ends_batch(batch[count - 1])
+              && (top = next_due(queue, cur_ticks)) != nullptr
+              && top->evt.dest == batch[0].dest && top->evt.type != FLUID_SEQ_UNREGISTERING);
+
+        callback(fluid_sequencer_get_tick(seq), events, count, seq, data);
     }
 }
-
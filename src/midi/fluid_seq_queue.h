@@ -34,8 +34,12 @@ void delete_fluid_seq_queue(void *queue);
 int fluid_seq_queue_push(void *queue, const fluid_event_t *evt);
 void fluid_seq_queue_remove(void *queue, fluid_seq_id_t src, fluid_seq_id_t dest, int type);
 void fluid_seq_queue_process(void *que, fluid_sequencer_t *seq, unsigned int cur_ticks);
+int fluid_seq_queue_get_next_tick(void *que, unsigned int *tick);
 void fluid_seq_queue_invalidate_note_private(void *que, fluid_seq_id_t dest, fluid_note_id_t id);
 
+/* implemented by fluid_seq.c */
+fluid_event_batch_callback_t fluid_sequencer_get_batch_callback(fluid_sequencer_t *seq, fluid_seq_id_t id, void **data);
+
 int event_compare_for_test(const fluid_event_t* left, const fluid_event_t* right);
 
 #ifdef __cplusplus
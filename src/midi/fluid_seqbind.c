@@ -51,6 +51,9 @@ extern void fluid_sequencer_invalidate_note(fluid_sequencer_t *seq, fluid_seq_id
 
 int fluid_seqbind_timer_callback(void *data, unsigned int msec);
 void fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *event, fluid_sequencer_t *seq, void *data);
+void fluid_seq_fluidsynth_batch_callback(unsigned int time, fluid_event_t **events, int count,
+        fluid_sequencer_t *seq, void *data);
+static void fluid_seqbind_handle_event(fluid_seqbind_t *seqbind, fluid_event_t *evt, fluid_sequencer_t *seq);
 
 /* Proper cleanup of the seqbind struct. */
 void
@@ -142,7 +145,7 @@ fluid_sequencer_register_fluidsynth(fluid_sequencer_t *seq, fluid_synth_t *synth
         }
     }
 
-    seqbind->note_container = new_fluid_note_container();
+    seqbind->note_container = new_fluid_note_container(fluid_synth_count_midi_channels(synth));
     if(seqbind->note_container == NULL)
     {
         delete_fluid_sample_timer(seqbind->synth, seqbind->sample_timer);
@@ -162,6 +165,8 @@ fluid_sequencer_register_fluidsynth(fluid_sequencer_t *seq, fluid_synth_t *synth
         return FLUID_FAILED;
     }
 
+    fluid_sequencer_set_client_batch_callback(seq, seqbind->client_id, fluid_seq_fluidsynth_batch_callback);
+
     return seqbind->client_id;
 }
 
@@ -178,9 +183,32 @@ fluid_seqbind_timer_callback(void *data, unsigned int msec)
 void
 fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *evt, fluid_sequencer_t *seq, void *data)
 {
-    fluid_synth_t *synth;
+    fluid_seqbind_handle_event((fluid_seqbind_t *) data, evt, seq);
+}
+
+/* Callback for the midi events due one after the other, handled with the API lock of the synth taken once */
+void
+fluid_seq_fluidsynth_batch_callback(unsigned int time, fluid_event_t **events, int count,
+                                    fluid_sequencer_t *seq, void *data)
+{
     fluid_seqbind_t *seqbind = (fluid_seqbind_t *) data;
-    synth = seqbind->synth;
+    fluid_synth_t *synth = seqbind->synth;
+    int i;
+
+    fluid_synth_api_hold(synth);
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_seqbind_handle_event(seqbind, events[i], seq);
+    }
+
+    fluid_synth_api_release(synth);
+}
+
+static void
+fluid_seqbind_handle_event(fluid_seqbind_t *seqbind, fluid_event_t *evt, fluid_sequencer_t *seq)
+{
+    fluid_synth_t *synth = seqbind->synth;
 
     switch(fluid_event_get_type(evt))
     {
@@ -209,11 +237,7 @@ fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *evt, fluid_seque
         fluid_note_id_t id = fluid_note_compute_id(chan, key);
 
         int res = fluid_note_container_insert(seqbind->note_container, id);
-        if(res == FLUID_FAILED)
-        {
-            goto err;
-        }
-        else if(res)
+        if(res)
         {
             // Note is already playing ATM, the following call to fluid_synth_noteon() will kill that note.
             // Thus, we need to remove its noteoff from the queue
@@ -230,7 +254,6 @@ fluid_seq_fluidsynth_callback(unsigned int time, fluid_event_t *evt, fluid_seque
         res = fluid_sequencer_send_at(seq, evt, dur, 0);
         if(res == FLUID_FAILED)
         {
-            err:
             FLUID_LOG(FLUID_ERR, "seqbind: Unable to process FLUID_SEQ_NOTE event, something went horribly wrong");
             return;
         }
@@ -19,11 +19,13 @@
 
 #include "fluid_seqbind_notes.h"
 
-#include <set>
+#include <vector>
+#include <algorithm>
 
 /*
- * This is a hash container allows us to detect overlapping notes, by storing a bunch of unique integers,
- * that allow us to track noteOn events.
+ * This is a container that allows us to detect overlapping notes, by storing a bunch of unique integers,
+ * that allow us to track noteOn events. As the IDs are bounded by the number of MIDI channels of the synth,
+ * it is a bitmap with one bit for each ID, so that the sequencer callback never needs to allocate memory.
  * If an ID is part of the container, it means that we have received a noteOn on a certain channel and key.
  * Once we receive a noteOff, we remove that ID again.
  *
@@ -52,7 +54,7 @@ fluidsynth: debug: Tick 1921: Normal NoteOFF on chan 15, key 44
 this noteoff will immediately kill the voice that we've just started 1 tick ago)
 */
 
-typedef std::set<fluid_note_id_t> note_container_t;
+typedef std::vector<bool> note_container_t;
 
 // Compute a unique ID for a given channel-key combination. Think of it as a two-dimensional array index.
 fluid_note_id_t fluid_note_compute_id(int chan, short key)
@@ -60,11 +62,11 @@ fluid_note_id_t fluid_note_compute_id(int chan, short key)
     return 128 * chan + key;
 }
 
-void* new_fluid_note_container()
+void* new_fluid_note_container(int midi_channels)
 {
     try
     {
-        note_container_t* cont = new note_container_t;
+        note_container_t* cont = new note_container_t(fluid_note_compute_id(midi_channels, 0), false);
         return cont;
     }
     catch(...)
@@ -78,37 +80,37 @@ void delete_fluid_note_container(void *cont)
     delete static_cast<note_container_t*>(cont);
 }
 
-// Returns true, if the ID was already included in the container before, false if it was just inserted and
-// FLUID_FAILED in case of error.
+// Returns true, if the ID was already included in the container before, false if it was just inserted or
+// is out of range.
 int fluid_note_container_insert(void* cont, fluid_note_id_t id)
 {
-    try
-    {
-        std::pair<note_container_t::iterator, bool> res = static_cast<note_container_t*>(cont)->insert(id);
-        // res.second tells us whether the element was inserted
-        // by inverting it, we know whether it contained the element previously
-        return !res.second;
-    }
-    catch(...)
+    note_container_t& notes = *static_cast<note_container_t*>(cont);
+
+    if(id < 0 || static_cast<note_container_t::size_type>(id) >= notes.size())
     {
-        return FLUID_FAILED;
+        // the synth can't play that note, thus it's never playing
+        return false;
     }
+
+    // whether it contained the element previously
+    bool res = notes[id];
+    notes[id] = true;
+    return res;
 }
 
 void fluid_note_container_remove(void* cont, fluid_note_id_t id)
 {
-    try
-    {
-        static_cast<note_container_t*>(cont)->erase(id);
-    }
-    catch(...)
+    note_container_t& notes = *static_cast<note_container_t*>(cont);
+
+    if(id >= 0 && static_cast<note_container_t::size_type>(id) < notes.size())
     {
-        // should never happen
+        notes[id] = false;
     }
 }
 
 // Empties the entire collection, e.g. in case of a AllNotesOff event
 void fluid_note_container_clear(void* cont)
 {
-    static_cast<note_container_t*>(cont)->clear();
+    note_container_t& notes = *static_cast<note_container_t*>(cont);
+    std::fill(notes.begin(), notes.end(), false);
 }
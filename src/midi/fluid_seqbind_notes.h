@@ -28,7 +28,7 @@ extern "C" {
 #endif
 
 fluid_note_id_t fluid_note_compute_id(int chan, short key);
-void* new_fluid_note_container(void);
+void* new_fluid_note_container(int midi_channels);
 void delete_fluid_note_container(void *cont);
 int fluid_note_container_insert(void* cont, fluid_note_id_t id);
 void fluid_note_container_remove(void* cont, fluid_note_id_t id);
@@ -57,10 +57,11 @@ typedef struct _fluid_adsr_env_t fluid_adsr_env_t;
 
 struct _fluid_adsr_env_t
 {
-    fluid_env_data_t data[FLUID_VOICE_ENVLAST];
+    /* the current state first, it is read every block while only one section of data is */
     unsigned int section; // type fluid_adsr_env_section_t, but declare it unsigned to make C++ happy
     unsigned int count;
     fluid_real_t val;         /* the current value of the envelope */
+    fluid_env_data_t data[FLUID_VOICE_ENVLAST];
 };
 
 /* For performance, all functions are inlined */
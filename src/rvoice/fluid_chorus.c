@@ -162,45 +162,46 @@
 #define INTERP_SAMPLES_NBR 1
 
 
-/*-----------------------------------------------------------------------------
- Sinusoidal modulator
------------------------------------------------------------------------------*/
-/* modulator */
-typedef struct
-{
-    // for sufficient precision members MUST be double! See https://github.com/FluidSynth/fluidsynth/issues/1331
-    double   a1;           /* Coefficient: a1 = 2 * cos(w) */
-    double   buffer1;      /* buffer1 */
-    double   buffer2;      /* buffer2 */
-    double   reset_buffer2;/* reset value of buffer2 */
-} sinus_modulator;
+/*
+ Number of samples following the end of the delay line which repeat its
+ beginning. This allows to read the samples of a whole block past the read
+ position of a modulator without circular motion.
+*/
+#define GUARD_SAMPLES_NBR FLUID_BUFSIZE
 
-/*-----------------------------------------------------------------------------
- Triangle modulator
------------------------------------------------------------------------------*/
-typedef struct
-{
-    fluid_real_t   freq;       /* Osc. Frequency (in Hertz) */
-    fluid_real_t   val;         /* internal current value */
-    fluid_real_t   inc;         /* increment value */
-} triang_modulator;
 
 /*-----------------------------------------------------------------------------
- modulator
+ modulators
+
+ The members of the modulators are arrays indexed by the chorus blocks, so
+ that the modulators and interpolators of all blocks are processed at once
+ using SIMD instructions.
 -----------------------------------------------------------------------------*/
 typedef struct
 {
     /*-------------*/
-    int line_out; /* current line out position for this modulator */
+    int line_out[MAX_CHORUS]; /* current line out position for each modulator */
     /*-------------*/
-    sinus_modulator sinus; /* sinus lfo */
-    triang_modulator triang; /* triangle lfo */
+    /* sinus lfo */
+    // for sufficient precision members MUST be double! See https://github.com/FluidSynth/fluidsynth/issues/1331
+    double   sinus_a1[MAX_CHORUS];           /* Coefficient: a1 = 2 * cos(w) */
+    double   sinus_buffer1[MAX_CHORUS];      /* buffer1 */
+    double   sinus_buffer2[MAX_CHORUS];      /* buffer2 */
+    double   sinus_reset_buffer2[MAX_CHORUS];/* reset value of buffer2 */
+    /*-------------*/
+    /* triangle lfo */
+    fluid_real_t   triang_val[MAX_CHORUS];   /* internal current value */
+    fluid_real_t   triang_inc[MAX_CHORUS];   /* increment value */
     /*-------------------------*/
     /* first order All-Pass interpolator members */
-    fluid_real_t  frac_pos_mod; /* fractional position part between samples */
+    fluid_real_t  frac_pos_mod[MAX_CHORUS]; /* fractional position part between samples */
     /* previous value used when interpolating using fractional */
-    fluid_real_t  buffer;
-} modulator;
+    fluid_real_t  buffer[MAX_CHORUS];
+    /*-------------------------*/
+    /* gains of each block output into the stereo unit inputs */
+    fluid_real_t  gain_left[MAX_CHORUS];
+    fluid_real_t  gain_right[MAX_CHORUS];
+} modulators;
 
 /* Private data for SKEL file */
 struct _fluid_chorus_t
@@ -216,7 +217,7 @@ struct _fluid_chorus_t
     fluid_real_t width;
     fluid_real_t wet1, wet2;
 
-    fluid_real_t *line; /* buffer line */
+    fluid_real_t *line; /* buffer line, followed by GUARD_SAMPLES_NBR samples */
     int   size;    /* effective internal size (in samples) */
 
     int line_in;  /* line in position */
@@ -229,8 +230,8 @@ struct _fluid_chorus_t
     int index_rate;  /* index rate to know when to update center_pos_mod */
     int mod_rate;    /* rate at which center_pos_mod is updated */
 
-    /* modulator member */
-    modulator mod[MAX_CHORUS]; /* sinus/triangle modulator */
+    /* modulators member */
+    modulators mod; /* sinus/triangle modulators */
 };
 
 /*-----------------------------------------------------------------------------
@@ -240,55 +241,26 @@ struct _fluid_chorus_t
  Never use: fluid_real_t , cosf(), sinf(), FLUID_COS(), FLUID_SIN(), FLUID_M_PI.
  See https://github.com/FluidSynth/fluidsynth/issues/1331
 
- @param mod pointer on modulator structure.
+ @param mod pointer on modulators structure.
+ @param i index of the modulator.
  @param freq frequency of the oscillator in Hz.
  @param sample_rate sample rate on audio output in Hz.
  @param phase initial phase of the oscillator in degree (0 to 360).
 -----------------------------------------------------------------------------*/
-static void set_sinus_frequency(sinus_modulator *mod,
+static void set_sinus_frequency(modulators *mod, int i,
                                 float freq, float sample_rate, float phase)
 {
     double w = (2.0 * M_PI) * freq / sample_rate;  /* step phase between each sinus wave sample (in radian) */
     double a; /* initial phase at which the sinus wave must begin (in radian) */
 
     // DO NOT use potentially single precision cosf or FLUID_COS here! See https://github.com/FluidSynth/fluidsynth/issues/1331
-    mod->a1 = 2 * cos(w);
+    mod->sinus_a1[i] = 2 * cos(w);
 
     a = (2.0 * M_PI / 360.0) * phase;
 
-    mod->buffer2 = sin(a - w); /* y(n-1) = sin(-initial angle) */
-    mod->buffer1 = sin(a); /* y(n) = sin(initial phase) */
-    mod->reset_buffer2 = sin((M_PI / 2.0) - w); /* reset value for PI/2 */
-}
-
-/*-----------------------------------------------------------------------------
- Gets current value of sinus modulator:
-   y(n) = a1 . y(n-1)  -  y(n-2)
-   out = a1 . buffer1  -  buffer2
-
- @param mod pointer on modulator structure.
- @return current value of the modulator sine wave.
------------------------------------------------------------------------------*/
-static FLUID_INLINE double get_mod_sinus(sinus_modulator *mod)
-{
-    double out;
-    out = mod->a1 * mod->buffer1 - mod->buffer2;
-    mod->buffer2 = mod->buffer1;
-
-    if(out >= 1.0) /* reset in case of instability near PI/2 */
-    {
-        out = 1.0; /* forces output to the right value */
-        mod->buffer2 = mod->reset_buffer2;
-    }
-
-    if(out <= -1.0) /* reset in case of instability near -PI/2 */
-    {
-        out = -1.0; /* forces output to the right value */
-        mod->buffer2 = - mod->reset_buffer2;
-    }
-
-    mod->buffer1 = out;
-    return  out;
+    mod->sinus_buffer2[i] = sin(a - w); /* y(n-1) = sin(-initial angle) */
+    mod->sinus_buffer1[i] = sin(a); /* y(n) = sin(initial phase) */
+    mod->sinus_reset_buffer2[i] = sin((M_PI / 2.0) - w); /* reset value for PI/2 */
 }
 
 /*-----------------------------------------------------------------------------
@@ -299,163 +271,288 @@ static FLUID_INLINE double get_mod_sinus(sinus_modulator *mod)
  For example: 0 is the beginning of the period, 1/4 is at 1/4 of the period
  relative to the beginning.
 
- @param mod pointer on modulator structure.
+ @param mod pointer on modulators structure.
+ @param i index of the modulator.
  @param freq frequency of the oscillator in Hz.
  @param sample_rate sample rate on audio output in Hz.
  @param frac_phase initial phase (see comment above).
 -----------------------------------------------------------------------------*/
-static void set_triangle_frequency(triang_modulator *mod, float freq,
+static void set_triangle_frequency(modulators *mod, int i, float freq,
                                    float sample_rate, float frac_phase)
 {
     fluid_real_t ns_period; /* period in numbers of sample */
+    fluid_real_t val, inc;
 
     if(freq <= 0.0)
     {
         freq = 0.5f;
     }
 
-    mod->freq = freq;
-
     ns_period = sample_rate / freq;
 
     /* the slope of a triangular osc (0 up to +1 down to -1 up to 0....) is equivalent
     to the slope of a saw osc (0 -> +4) */
-    mod->inc  = 4 / ns_period; /* positive slope */
+    inc  = 4 / ns_period; /* positive slope */
 
     /* The initial value and the sign of the slope depend of initial phase:
       initial value = = (ns_period * frac_phase) * slope
     */
-    mod->val =  ns_period * frac_phase * mod->inc;
+    val =  ns_period * frac_phase * inc;
 
-    if(1.0 <= mod->val && mod->val < 3.0)
+    if(1.0 <= val && val < 3.0)
     {
-        mod->val = 2.0 - mod->val; /*  1.0 down to -1.0 */
-        mod->inc = -mod->inc; /* negative slope */
+        val = 2.0 - val; /*  1.0 down to -1.0 */
+        inc = -inc; /* negative slope */
     }
-    else if(3.0 <= mod->val)
+    else if(3.0 <= val)
     {
-        mod->val = mod->val - 4.0; /*  -1.0 up to +1.0. */
+        val = val - 4.0; /*  -1.0 up to +1.0. */
     }
 
     /* else val < 1.0 */
+    mod->triang_val[i] = val;
+    mod->triang_inc[i] = inc;
 }
 
 /*-----------------------------------------------------------------------------
-   Get current value of triangular oscillator
-       y(n) = y(n-1) + dy
+ Updates the modulators of all chorus blocks and their read positions.
+
+ The lfo of each block gives its next value:
+ - sinus:    y(n) = a1 . y(n-1)  -  y(n-2)
+ - triangle: y(n) = y(n-1) + dy
+ which modulates the read position (line_out, frac_pos_mod) of the block
+ around center_pos_mod.
 
- @param mod pointer on triang_modulator structure.
- @return current value.
+ @param chorus pointer on chorus unit.
 -----------------------------------------------------------------------------*/
-static FLUID_INLINE fluid_real_t get_mod_triang(triang_modulator *mod)
+static FLUID_INLINE void update_mod_positions(fluid_chorus_t *chorus)
 {
-    mod->val = mod->val + mod->inc ;
+    modulators *mod = &chorus->mod;
+    fluid_real_t out_index[MAX_CHORUS];  /* new modulated index position */
+    int i;
 
-    if(mod->val >= 1.0)
+    if(chorus->type == FLUID_CHORUS_MOD_SINE)
     {
-        mod->inc = -mod->inc;
-        return 1.0;
-    }
+        #pragma omp simd
+        for(i = 0; i < chorus->number_blocks; i++)
+        {
+            double out = mod->sinus_a1[i] * mod->sinus_buffer1[i] - mod->sinus_buffer2[i];
+            mod->sinus_buffer2[i] = mod->sinus_buffer1[i];
 
-    if(mod->val <= -1.0)
+            if(out >= 1.0) /* reset in case of instability near PI/2 */
+            {
+                out = 1.0; /* forces output to the right value */
+                mod->sinus_buffer2[i] = mod->sinus_reset_buffer2[i];
+            }
+
+            if(out <= -1.0) /* reset in case of instability near -PI/2 */
+            {
+                out = -1.0; /* forces output to the right value */
+                mod->sinus_buffer2[i] = - mod->sinus_reset_buffer2[i];
+            }
+
+            mod->sinus_buffer1[i] = out;
+
+            /* out_index = center position (center_pos_mod) + sinus waweform */
+            out_index[i] = chorus->center_pos_mod + out * chorus->mod_depth;
+        }
+    }
+    else
     {
-        mod->inc = -mod->inc;
-        return -1.0;
+        #pragma omp simd
+        for(i = 0; i < chorus->number_blocks; i++)
+        {
+            fluid_real_t out = mod->triang_val[i] + mod->triang_inc[i];
+            mod->triang_val[i] = out;
+
+            if(out >= 1.0)
+            {
+                mod->triang_inc[i] = -mod->triang_inc[i];
+                out = 1.0;
+            }
+
+            if(out <= -1.0)
+            {
+                mod->triang_inc[i] = -mod->triang_inc[i];
+                out = -1.0;
+            }
+
+            /* out_index = center position (center_pos_mod) + triangle waweform */
+            out_index[i] = chorus->center_pos_mod + out * chorus->mod_depth;
+        }
     }
 
-    return  mod->val;
+    #pragma omp simd
+    for(i = 0; i < chorus->number_blocks; i++)
+    {
+        /* extracts integer part in int_out_index */
+        int int_out_index = (out_index[i] >= 0.0f) ? (int)out_index[i] /* current integer part */
+                            : (int)(out_index[i] - 1); /* previous integer part */
+
+        /* forces read index (line_out) with integer modulation value  */
+        /* Boundary check and circular motion as needed */
+        int line_out = int_out_index;
+
+        if(line_out >= chorus->size)
+        {
+            line_out -= chorus->size;
+        }
+
+        if(line_out < 0)
+        {
+            line_out += chorus->size;
+        }
+
+        mod->line_out[i] = line_out;
+
+        /* extracts fractionnal part. (it will be used when interpolating
+          between line_out and line_out +1) and memorize it.
+          Memorizing is necessary for modulation rate above 1 */
+        mod->frac_pos_mod[i] = out_index[i] - int_out_index;
+    }
 }
+
 /*-----------------------------------------------------------------------------
- Reads the sample value out of the modulated delay line.
+ Push a block of FLUID_BUFSIZE samples into the delay line, repeating the
+ beginning of the line in its guard samples.
 
  @param chorus pointer on chorus unit.
- @param mod pointer on modulator structure.
- @return current value.
+ @param in the samples to push into the delay line.
 -----------------------------------------------------------------------------*/
-static FLUID_INLINE fluid_real_t get_mod_delay(fluid_chorus_t *chorus,
-                                               modulator *mod)
+static void push_block_in_delay_line(fluid_chorus_t *chorus, const fluid_real_t *in)
 {
-    fluid_real_t out_index;  /* new modulated index position */
-    int int_out_index; /* integer part of out_index */
-    fluid_real_t out; /* value to return */
-
-    /* Checks if the modulator must be updated (every mod_rate samples). */
-    /* Important: center_pos_mod must be used immediately for the
-       first sample. So, mdl->index_rate must be initialized
-       to mdl->mod_rate (new_mod_delay_line())  */
+    int i, count;
 
-    if(chorus->index_rate >= chorus->mod_rate)
+    for(i = 0; i < FLUID_BUFSIZE; i += count)
     {
-        /* out_index = center position (center_pos_mod) + sinus waweform */
-        if(chorus->type == FLUID_CHORUS_MOD_SINE)
+        /* up to the end of the line, then circular motion */
+        count = chorus->size - chorus->line_in;
+
+        if(count > FLUID_BUFSIZE - i)
         {
-            out_index = chorus->center_pos_mod +
-                        get_mod_sinus(&mod->sinus) * chorus->mod_depth;
+            count = FLUID_BUFSIZE - i;
         }
-        else
+
+        FLUID_MEMCPY(&chorus->line[chorus->line_in], &in[i], count * sizeof(fluid_real_t));
+
+        /* repeats the beginning of the line in the guard samples */
+        if(chorus->line_in < GUARD_SAMPLES_NBR)
         {
-            out_index = chorus->center_pos_mod +
-                        get_mod_triang(&mod->triang) * chorus->mod_depth;
+            int guard_count = GUARD_SAMPLES_NBR - chorus->line_in;
+
+            FLUID_MEMCPY(&chorus->line[chorus->size + chorus->line_in], &in[i],
+                         ((count < guard_count) ? count : guard_count) * sizeof(fluid_real_t));
         }
 
-        /* extracts integer part in int_out_index */
-        if(out_index >= 0.0f)
+        if((chorus->line_in += count) >= chorus->size)
         {
-            int_out_index = (int)out_index; /* current integer part */
+            chorus->line_in -= chorus->size;
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+ Processes one block of FLUID_BUFSIZE samples through the modulated delay
+ line of all chorus blocks.
+
+ The input block is pushed into the line first: the line is longer than
+ the highest delay by FLUID_BUFSIZE samples, so the samples read during the
+ block are still in the line. The samples of the block are then processed
+ in runs between the updates of the modulators. During a run the read
+ positions of all chorus blocks advance by one sample at each sample, so the
+ interpolators of all blocks are computed at once using SIMD instructions.
+
+ @param chorus pointer on chorus unit.
+ @param in, pointer on monophonic input buffer of FLUID_BUFSIZE samples.
+ @param d_out_left, d_out_right, stereo unit inputs (FLUID_BUFSIZE samples).
+-----------------------------------------------------------------------------*/
+static void process_mod_delay_line(fluid_chorus_t *chorus, const fluid_real_t *in,
+                                   fluid_real_t *d_out_left, fluid_real_t *d_out_right)
+{
+    modulators *mod = &chorus->mod;
+    const fluid_real_t *line = chorus->line;
+    int sample_index, n, i, count;
+
+    /* Note that 'in' may be aliased with 'left_out'. Hence this must be done
+     * before producing any output.
+     */
+    push_block_in_delay_line(chorus, in);
+
+    for(sample_index = 0; sample_index < FLUID_BUFSIZE; sample_index += count)
+    {
+        /* Checks if the modulators must be updated (every mod_rate samples). */
+        /* Important: center_pos_mod must be used immediately for the
+           first sample. So, index_rate must be initialized
+           to mod_rate (set_center_position())  */
+        if(++chorus->index_rate >= chorus->mod_rate)
+        {
+            chorus->index_rate = 0; /* clear modulator index rate */
 
-            /* forces read index (line_out)  with integer modulation value  */
-            /* Boundary check and circular motion as needed */
-            if((mod->line_out = int_out_index) >= chorus->size)
+            update_mod_positions(chorus);
+
+            /* updates center position (center_pos_mod) to the next position
+               specified by modulation rate */
+            if((chorus->center_pos_mod += chorus->mod_rate) >= chorus->size)
             {
-                mod->line_out -= chorus->size;
+                chorus->center_pos_mod -= chorus->size;
             }
         }
-        else /* negative */
+
+        count = chorus->mod_rate - chorus->index_rate;
+
+        if(count > FLUID_BUFSIZE - sample_index)
         {
-            int_out_index = (int)(out_index - 1); /* previous integer part */
-            /* forces read index (line_out) with integer modulation value  */
-            /* circular motion as needed */
-            mod->line_out   = int_out_index + chorus->size;
+            count = FLUID_BUFSIZE - sample_index;
         }
 
-        /* extracts fractionnal part. (it will be used when interpolating
-          between line_out and line_out +1) and memorize it.
-          Memorizing is necessary for modulation rate above 1 */
-        mod->frac_pos_mod = out_index - int_out_index;
-    }
+        /* the following samples of the run pass the check above without update */
+        chorus->index_rate += count - 1;
+
+        for(n = 0; n < count; n++)
+        {
+            fluid_real_t d_left = 0, d_right = 0;
 
-    /*  First order all-pass interpolation ----------------------------------*/
-    /* https://ccrma.stanford.edu/~jos/pasp/First_Order_Allpass_Interpolation.html */
-    /*  begins interpolation: read current sample */
-    out = chorus->line[mod->line_out];
+            #pragma omp simd reduction(+:d_left,d_right)
+            for(i = 0; i < chorus->number_blocks; i++)
+            {
+                int pos = mod->line_out[i] + n;
+
+                /*  First order all-pass interpolation ------------------------*/
+                /* https://ccrma.stanford.edu/~jos/pasp/First_Order_Allpass_Interpolation.html */
+                /* Fractional interpolation between next sample (at next position) and
+                   previous output added to current sample. The terms which
+                   don't depend on the previous output are added first.
+                */
+                fluid_real_t out = (line[pos] + mod->frac_pos_mod[i] * line[pos + 1])
+                                   - mod->frac_pos_mod[i] * mod->buffer[i];
+                mod->buffer[i] = out; /* memorizes current output */
+
+                /* accumulate out into stereo unit input */
+                d_left += out * mod->gain_left[i];
+                d_right += out * mod->gain_right[i];
+            }
 
-    /* updates line_out to the next sample.
-       Boundary check and circular motion as needed */
-    if(++mod->line_out >= chorus->size)
-    {
-        mod->line_out -= chorus->size;
+            d_out_left[sample_index + n] = d_left;
+            d_out_right[sample_index + n] = d_right;
+        }
     }
 
-    /* Fractional interpolation between next sample (at next position) and
-       previous output added to current sample.
-    */
-    out += mod->frac_pos_mod * (chorus->line[mod->line_out] - mod->buffer);
-    mod->buffer = out; /* memorizes current output */
-    return out;
-}
+    /* updates line_out of the last run to the next sample, other runs have
+       been followed by an update of the modulators.
+       Boundary check and circular motion as needed */
+    #pragma omp simd
+    for(i = 0; i < chorus->number_blocks; i++)
+    {
+        int line_out = mod->line_out[i] + count;
 
-/*-----------------------------------------------------------------------------
- Push a sample val into the delay line
+        if(line_out >= chorus->size)
+        {
+            line_out -= chorus->size;
+        }
 
- @param dl delay line to push value into.
- @param val the value to push into dl.
------------------------------------------------------------------------------*/
-#define push_in_delay_line(dl, val) \
-{\
-    dl->line[dl->line_in] = val;\
-    /* Incrementation and circular motion if necessary */\
-    if(++dl->line_in >= dl->size) dl->line_in -= dl->size;\
-}\
+        mod->line_out[i] = line_out;
+    }
+}
 
 /*-----------------------------------------------------------------------------
  Initialize : mod_rate, center_pos_mod,  and index rate
@@ -500,7 +597,7 @@ static void set_center_position(fluid_chorus_t *chorus)
 
     /* index rate to control when to update center_pos_mod */
     /* Important: must be set to get center_pos_mod immediately used for the
-       reading of first sample (see get_mod_delay()) */
+       reading of first sample (see process_mod_delay_line()) */
     chorus->index_rate = chorus->mod_rate;
 }
 
@@ -547,17 +644,30 @@ static void update_parameters_from_sample_rate(fluid_chorus_t *chorus)
     /* initialize modulator frequency */
     for(i = 0; i < chorus->number_blocks; i++)
     {
-        set_sinus_frequency(&chorus->mod[i].sinus,
+        set_sinus_frequency(&chorus->mod, i,
                             chorus->speed_Hz * chorus->mod_rate,
                             chorus->sample_rate,
                             /* phase offset between modulators waveform */
                             (float)((360.0f / (float) chorus->number_blocks) * i));
 
-        set_triangle_frequency(&chorus->mod[i].triang,
+        set_triangle_frequency(&chorus->mod, i,
                                chorus->speed_Hz * chorus->mod_rate,
                                chorus->sample_rate,
                                /* phase offset between modulators waveform */
                                (float)i / chorus->number_blocks);
+
+        /* even blocks feed the left stereo unit input, odd ones the right input */
+        chorus->mod.gain_left[i] = (i & 1) ? 0 : 1;
+        chorus->mod.gain_right[i] = (i & 1) ? 1 : 0;
+    }
+
+    /* Adjust stereo input level in case of number_blocks odd:
+       In those case, right input level is lower than left input, so the
+       last block is also added to the right input to have them balanced.
+    */
+    if((chorus->number_blocks & 1) && chorus->number_blocks > 2)  // 3,5,7...
+    {
+        chorus->mod.gain_right[chorus->number_blocks - 1] = 1;
     }
 }
 
@@ -566,7 +676,8 @@ static void update_parameters_from_sample_rate(fluid_chorus_t *chorus)
 
  Sets the length line ( alloc delay samples).
  Remark: the function sets the internal size according to the length delay_length.
- The size is augmented by INTERP_SAMPLES_NBR to take account of interpolation.
+ The size is augmented by INTERP_SAMPLES_NBR to take account of interpolation,
+ and by FLUID_BUFSIZE to push a whole block before reading it.
 
  @param chorus, pointer on chorus unit.
  @param delay_length the length of the delay line in samples.
@@ -587,9 +698,10 @@ static int new_mod_delay_line(fluid_chorus_t *chorus, int delay_length)
     /*-----------------------------------------------------------------------
      allocates delay_line and initialize members: - line, size, line_in...
     */
-    /* total size of the line:  size = INTERP_SAMPLES_NBR + delay_length */
-    chorus->size = delay_length + INTERP_SAMPLES_NBR;
-    chorus->line = FLUID_ARRAY(fluid_real_t, chorus->size);
+    /* total size of the line:  size = INTERP_SAMPLES_NBR + delay_length + FLUID_BUFSIZE,
+       the input block is pushed before reading the line (see process_mod_delay_line()) */
+    chorus->size = delay_length + INTERP_SAMPLES_NBR + FLUID_BUFSIZE;
+    chorus->line = FLUID_ARRAY(fluid_real_t, chorus->size + GUARD_SAMPLES_NBR);
 
     if(! chorus->line)
     {
@@ -678,28 +790,32 @@ delete_fluid_chorus(fluid_chorus_t *chorus)
 }
 
 /**
- * Clear the internal delay line and associate filter.
+ * Clear the internal delay line and associate filter, and restart the
+ * modulators. The chorus then continues exactly like a new one.
  * @param chorus pointer on chorus unit returned by new_fluid_chorus().
  */
 void
 fluid_chorus_reset(fluid_chorus_t *chorus)
 {
     int i;
-    unsigned int u;
 
-    /* reset delay line */
-    for(i = 0; i < chorus->size; i++)
+    /* reset delay line and its guard samples */
+    for(i = 0; i < chorus->size + GUARD_SAMPLES_NBR; i++)
     {
         chorus->line[i] = 0;
     }
 
     /* reset modulators's allpass filter */
-    for(u = 0; u < FLUID_N_ELEMENTS(chorus->mod); u++)
+    for(i = 0; i < MAX_CHORUS; i++)
     {
         /* initializes 1st order All-Pass interpolator members */
-        chorus->mod[u].buffer = 0;       /* previous delay sample value */
-        chorus->mod[u].frac_pos_mod = 0; /* fractional position (between consecutives sample) */
+        chorus->mod.buffer[i] = 0;       /* previous delay sample value */
+        chorus->mod.frac_pos_mod[i] = 0; /* fractional position (between consecutives sample) */
     }
+
+    /* restarts the modulators from the start of the line */
+    chorus->line_in = 0;
+    update_parameters_from_sample_rate(chorus);
 }
 
 /**
@@ -924,6 +1040,16 @@ fluid_chorus_samplerate_change(fluid_chorus_t *chorus, fluid_real_t sample_rate)
     update_parameters_from_sample_rate(chorus);
 }
 
+/**
+ * Return the memory used by the chorus in bytes, including its delay line.
+ * @param chorus pointer on chorus unit returned by new_fluid_chorus().
+ */
+size_t
+fluid_chorus_get_memory(const fluid_chorus_t *chorus)
+{
+    return sizeof(*chorus) + (size_t)(chorus->size + GUARD_SAMPLES_NBR) * sizeof(fluid_real_t);
+}
+
 /**
  * Process chorus by mixing the result in output buffer.
  * @param chorus pointer on chorus unit returned by new_fluid_chorus().
@@ -935,67 +1061,17 @@ void fluid_chorus_processmix(fluid_chorus_t *chorus, const fluid_real_t *in,
                              fluid_real_t *left_out, fluid_real_t *right_out)
 {
     int sample_index;
-    int i;
-    fluid_real_t d_out[2];               /* output stereo Left and Right  */
+    fluid_real_t d_out_left[FLUID_BUFSIZE], d_out_right[FLUID_BUFSIZE]; /* stereo unit input */
+
+    process_mod_delay_line(chorus, in, d_out_left, d_out_right);
 
-    /* foreach sample, process output sample then input sample */
+    /* process stereo unit */
+    /* Add the chorus stereo unit d_out to left and right output */
+    #pragma omp simd
     for(sample_index = 0; sample_index < FLUID_BUFSIZE; sample_index++)
     {
-        fluid_real_t out; /* block output */
-
-        d_out[0] = d_out[1] = 0.0f; /* clear stereo unit input */
-
-#if 0
-        /* Debug: Listen to the chorus signal only */
-        left_out[sample_index] = 0;
-        right_out[sample_index] = 0;
-#endif
-
-        ++chorus->index_rate; /* modulator rate */
-
-        /* foreach chorus block, process output sample */
-        for(i = 0; i < chorus->number_blocks; i++)
-        {
-            /* get sample from the output of modulated delay line */
-            out = get_mod_delay(chorus, &chorus->mod[i]);
-
-            /* accumulate out into stereo unit input */
-            d_out[i & 1] += out;
-        }
-
-        /* update modulator index rate and output center position */
-        if(chorus->index_rate >= chorus->mod_rate)
-        {
-            chorus->index_rate = 0; /* clear modulator index rate */
-
-            /* updates center position (center_pos_mod) to the next position
-               specified by modulation rate */
-            if((chorus->center_pos_mod += chorus->mod_rate) >= chorus->size)
-            {
-                chorus->center_pos_mod -= chorus->size;
-            }
-        }
-
-        /* Adjust stereo input level in case of number_blocks odd:
-           In those case, d_out[1] level is lower than d_out[0], so we need to
-           add out value to d_out[1] to have d_out[0] and d_out[1] balanced.
-        */
-        if((i & 1) && i > 2)  // i = 3,5,7...
-        {
-            d_out[1] +=  out ;
-        }
-
-        /* Write the current input sample into the circular buffer.
-         * Note that 'in' may be aliased with 'left_out'. Hence this must be done
-         * before "processing stereo unit" (below). This ensures input buffer
-         * not being overwritten by stereo unit output.
-         */
-        push_in_delay_line(chorus, in[sample_index]);
-
-        /* process stereo unit */
-        /* Add the chorus stereo unit d_out to left and right output */
-        left_out[sample_index]  += d_out[0] * chorus->wet1  + d_out[1] * chorus->wet2;
-        right_out[sample_index] += d_out[1] * chorus->wet1  + d_out[0] * chorus->wet2;
+        left_out[sample_index]  += d_out_left[sample_index] * chorus->wet1  + d_out_right[sample_index] * chorus->wet2;
+        right_out[sample_index] += d_out_right[sample_index] * chorus->wet1  + d_out_left[sample_index] * chorus->wet2;
     }
 }
 
@@ -1006,71 +1082,20 @@ void fluid_chorus_processmix(fluid_chorus_t *chorus, const fluid_real_t *in,
  * @param left_out, right_out, pointers on stereo output buffers of
  *  FLUID_BUFSIZE samples.
  */
-/* Duplication of code ... (replaces sample data instead of mixing) */
 void fluid_chorus_processreplace(fluid_chorus_t *chorus, const fluid_real_t *in,
                                  fluid_real_t *left_out, fluid_real_t *right_out)
 {
     int sample_index;
-    int i;
-    fluid_real_t d_out[2];               /* output stereo Left and Right  */
+    fluid_real_t d_out_left[FLUID_BUFSIZE], d_out_right[FLUID_BUFSIZE]; /* stereo unit input */
+
+    process_mod_delay_line(chorus, in, d_out_left, d_out_right);
 
-    /* foreach sample, process output sample then input sample */
+    /* process stereo unit */
+    /* store the chorus stereo unit d_out to left and right output */
+    #pragma omp simd
     for(sample_index = 0; sample_index < FLUID_BUFSIZE; sample_index++)
     {
-        fluid_real_t out; /* block output */
-
-        d_out[0] = d_out[1] = 0.0f; /* clear stereo unit input */
-
-#if 0
-        /* Debug: Listen to the chorus signal only */
-        left_out[sample_index] = 0;
-        right_out[sample_index] = 0;
-#endif
-
-        ++chorus->index_rate; /* modulator rate */
-
-        /* foreach chorus block, process output sample */
-        for(i = 0; i < chorus->number_blocks; i++)
-        {
-            /* get sample from the output of modulated delay line */
-            out = get_mod_delay(chorus, &chorus->mod[i]);
-
-            /* accumulate out into stereo unit input */
-            d_out[i & 1] += out;
-        }
-
-        /* update modulator index rate and output center position */
-        if(chorus->index_rate >= chorus->mod_rate)
-        {
-            chorus->index_rate = 0; /* clear modulator index rate */
-
-            /* updates center position (center_pos_mod) to the next position
-               specified by modulation rate */
-            if((chorus->center_pos_mod += chorus->mod_rate) >= chorus->size)
-            {
-                chorus->center_pos_mod -= chorus->size;
-            }
-        }
-
-        /* Adjust stereo input level in case of number_blocks odd:
-           In those case, d_out[1] level is lower than d_out[0], so we need to
-           add out value to d_out[1] to have d_out[0] and d_out[1] balanced.
-        */
-        if((i & 1) && i > 2)  // i = 3,5,7...
-        {
-            d_out[1] +=  out ;
-        }
-
-        /* Write the current input sample into the circular buffer.
-         * Note that 'in' may be aliased with 'left_out'. Hence this must be done
-         * before "processing stereo unit" (below). This ensures input buffer
-         * not being overwritten by stereo unit output.
-         */
-        push_in_delay_line(chorus, in[sample_index]);
-
-        /* process stereo unit */
-        /* store the chorus stereo unit d_out to left and right output */
-        left_out[sample_index]  = d_out[0] * chorus->wet1  + d_out[1] * chorus->wet2;
-        right_out[sample_index] = d_out[1] * chorus->wet1  + d_out[0] * chorus->wet2;
+        left_out[sample_index]  = d_out_left[sample_index] * chorus->wet1  + d_out_right[sample_index] * chorus->wet2;
+        right_out[sample_index] = d_out_right[sample_index] * chorus->wet1  + d_out_left[sample_index] * chorus->wet2;
     }
 }
@@ -71,6 +71,7 @@ void fluid_chorus_set(fluid_chorus_t *chorus, int set, int nr, fluid_real_t leve
                       fluid_real_t speed, fluid_real_t depth_ms, int type);
 void
 fluid_chorus_samplerate_change(fluid_chorus_t *chorus, fluid_real_t sample_rate);
+size_t fluid_chorus_get_memory(const fluid_chorus_t *chorus);
 
 void fluid_chorus_processmix(fluid_chorus_t *chorus, const fluid_real_t *in,
                              fluid_real_t *left_out, fluid_real_t *right_out);
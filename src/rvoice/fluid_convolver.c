@@ -0,0 +1,369 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Uniformly partitioned convolution with overlap-save:
+ *
+ * The impulse response is cut into partitions of FLUID_BUFSIZE samples, each
+ * zero padded and transformed with an FFT of twice that size. Every input
+ * block is transformed together with the previous one and stored in a
+ * frequency domain delay line. The spectrum of an output block is the sum of
+ * the products of the last "partitions" input spectra with the partitions of
+ * the impulse response, the second half of its inverse transform is the
+ * output. Since the input is real, only the lower half of the bins is kept.
+ * Both output channels are transformed back at once, as real and imaginary
+ * part of a single inverse FFT.
+ */
+
+#include "fluid_convolver.h"
+#include "fluid_sys.h"
+
+#define FLUID_CONV_FFT_SIZE (2 * FLUID_BUFSIZE)
+#define FLUID_CONV_BINS (FLUID_BUFSIZE + 1)
+
+struct _fluid_convolver_t
+{
+    int partitions;     /* number of partitions of the impulse response */
+    int head;           /* slot of the most recent input spectrum in the delay line */
+
+    /* spectra of the impulse response partitions, scaled by 1 / FLUID_CONV_FFT_SIZE,
+     * FLUID_CONV_BINS values per partition */
+    fluid_real_t *left_re;
+    fluid_real_t *left_im;
+    fluid_real_t *right_re;
+    fluid_real_t *right_im;
+
+    /* frequency domain delay line, the spectra of the last input blocks */
+    fluid_real_t *fdl_re;
+    fluid_real_t *fdl_im;
+
+    fluid_real_t last_in[FLUID_BUFSIZE]; /* previous input block */
+
+    /* twiddle factors of all FFT stages, the one of half size h starts at index h - 1 */
+    fluid_real_t twiddle_re[FLUID_CONV_FFT_SIZE - 1];
+    fluid_real_t twiddle_im[FLUID_CONV_FFT_SIZE - 1];
+    int bitrev[FLUID_CONV_FFT_SIZE];
+
+    fluid_atomic_int_t retired; /* set once the mixer doesn't use the convolver anymore */
+};
+
+/* In place radix-2 FFT of FLUID_CONV_FFT_SIZE complex values */
+static void
+fluid_conv_fft(const fluid_convolver_t *conv, fluid_real_t *re, fluid_real_t *im)
+{
+    int i, j, half;
+    fluid_real_t t;
+
+    for(i = 0; i < FLUID_CONV_FFT_SIZE; i++)
+    {
+        j = conv->bitrev[i];
+
+        if(i < j)
+        {
+            t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for(half = 1; half < FLUID_CONV_FFT_SIZE; half <<= 1)
+    {
+        const fluid_real_t *w_re = &conv->twiddle_re[half - 1];
+        const fluid_real_t *w_im = &conv->twiddle_im[half - 1];
+
+        for(i = 0; i < FLUID_CONV_FFT_SIZE; i += 2 * half)
+        {
+            fluid_real_t *FLUID_RESTRICT a_re = &re[i];
+            fluid_real_t *FLUID_RESTRICT a_im = &im[i];
+            fluid_real_t *FLUID_RESTRICT b_re = &re[i + half];
+            fluid_real_t *FLUID_RESTRICT b_im = &im[i + half];
+
+            #pragma omp simd
+            for(j = 0; j < half; j++)
+            {
+                fluid_real_t tr = b_re[j] * w_re[j] - b_im[j] * w_im[j];
+                fluid_real_t ti = b_re[j] * w_im[j] + b_im[j] * w_re[j];
+
+                b_re[j] = a_re[j] - tr;
+                b_im[j] = a_im[j] - ti;
+                a_re[j] += tr;
+                a_im[j] += ti;
+            }
+        }
+    }
+}
+
+/**
+ * Creates a convolver for an impulse response.
+ * @param left left channel of the impulse response
+ * @param right right channel of the impulse response, NULL to use the left one for both
+ * @param length number of samples of each channel
+ * @return the new convolver, NULL on error
+ */
+fluid_convolver_t *
+new_fluid_convolver(const float *left, const float *right, int length)
+{
+    fluid_real_t re[FLUID_CONV_FFT_SIZE], im[FLUID_CONV_FFT_SIZE];
+    fluid_convolver_t *conv;
+    const float *ir;
+    fluid_real_t *dst_re, *dst_im;
+    int bits, size, i, j, p, c;
+
+    fluid_return_val_if_fail(left != NULL, NULL);
+    fluid_return_val_if_fail(length > 0, NULL);
+
+    if(right == NULL)
+    {
+        right = left;
+    }
+
+    conv = FLUID_NEW(fluid_convolver_t);
+
+    if(conv == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(conv, 0, sizeof(*conv));
+    conv->partitions = (length + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
+    size = conv->partitions * FLUID_CONV_BINS;
+
+    conv->left_re = FLUID_ARRAY(fluid_real_t, size);
+    conv->left_im = FLUID_ARRAY(fluid_real_t, size);
+    conv->right_re = FLUID_ARRAY(fluid_real_t, size);
+    conv->right_im = FLUID_ARRAY(fluid_real_t, size);
+    conv->fdl_re = FLUID_ARRAY(fluid_real_t, size);
+    conv->fdl_im = FLUID_ARRAY(fluid_real_t, size);
+
+    if(conv->left_re == NULL || conv->left_im == NULL || conv->right_re == NULL
+            || conv->right_im == NULL || conv->fdl_re == NULL || conv->fdl_im == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_convolver(conv);
+        return NULL;
+    }
+
+    for(bits = 0; (1 << bits) < FLUID_CONV_FFT_SIZE; bits++)
+    {
+    }
+
+    for(i = 0; i < FLUID_CONV_FFT_SIZE; i++)
+    {
+        for(j = 0, p = 0; p < bits; p++)
+        {
+            j |= ((i >> p) & 1) << (bits - 1 - p);
+        }
+
+        conv->bitrev[i] = j;
+    }
+
+    for(i = 1; i < FLUID_CONV_FFT_SIZE; i <<= 1)
+    {
+        for(j = 0; j < i; j++)
+        {
+            conv->twiddle_re[i - 1 + j] = FLUID_COS(FLUID_M_PI * j / i);
+            conv->twiddle_im[i - 1 + j] = -FLUID_SIN(FLUID_M_PI * j / i);
+        }
+    }
+
+    /* transform the zero padded partitions of both channels */
+    for(c = 0; c < 2; c++)
+    {
+        ir = (c == 0) ? left : right;
+        dst_re = (c == 0) ? conv->left_re : conv->right_re;
+        dst_im = (c == 0) ? conv->left_im : conv->right_im;
+
+        for(p = 0; p < conv->partitions; p++, dst_re += FLUID_CONV_BINS, dst_im += FLUID_CONV_BINS)
+        {
+            for(i = 0; i < FLUID_CONV_FFT_SIZE; i++)
+            {
+                j = p * FLUID_BUFSIZE + i;
+                re[i] = (i < FLUID_BUFSIZE && j < length) ? (fluid_real_t)ir[j] : 0;
+                im[i] = 0;
+            }
+
+            fluid_conv_fft(conv, re, im);
+
+            for(i = 0; i < FLUID_CONV_BINS; i++)
+            {
+                dst_re[i] = re[i] / FLUID_CONV_FFT_SIZE;
+                dst_im[i] = im[i] / FLUID_CONV_FFT_SIZE;
+            }
+        }
+    }
+
+    fluid_convolver_reset(conv);
+    return conv;
+}
+
+void
+delete_fluid_convolver(fluid_convolver_t *conv)
+{
+    fluid_return_if_fail(conv != NULL);
+
+    FLUID_FREE(conv->left_re);
+    FLUID_FREE(conv->left_im);
+    FLUID_FREE(conv->right_re);
+    FLUID_FREE(conv->right_im);
+    FLUID_FREE(conv->fdl_re);
+    FLUID_FREE(conv->fdl_im);
+    FLUID_FREE(conv);
+}
+
+/**
+ * Clears the input history, as if the input had been silent since the
+ * length of the impulse response.
+ */
+void
+fluid_convolver_reset(fluid_convolver_t *conv)
+{
+    int size = conv->partitions * FLUID_CONV_BINS * sizeof(fluid_real_t);
+
+    FLUID_MEMSET(conv->fdl_re, 0, size);
+    FLUID_MEMSET(conv->fdl_im, 0, size);
+    FLUID_MEMSET(conv->last_in, 0, sizeof(conv->last_in));
+    conv->head = 0;
+}
+
+/**
+ * Returns the number of blocks of FLUID_BUFSIZE samples in the impulse response,
+ * after that many silent input blocks the output is silent as well.
+ */
+int
+fluid_convolver_get_partitions(const fluid_convolver_t *conv)
+{
+    return conv->partitions;
+}
+
+/**
+ * Marks the convolver as no longer used by the mixer, so that it can be
+ * deleted by the thread that created it.
+ */
+void
+fluid_convolver_retire(fluid_convolver_t *conv)
+{
+    fluid_atomic_int_set(&conv->retired, TRUE);
+}
+
+int
+fluid_convolver_is_retired(fluid_convolver_t *conv)
+{
+    return fluid_atomic_int_get(&conv->retired);
+}
+
+/* Convolves a block of FLUID_BUFSIZE samples, the output is left in the upper half of re and -im */
+static void
+fluid_convolver_process(fluid_convolver_t *conv, const fluid_real_t *in,
+                        fluid_real_t *re, fluid_real_t *im)
+{
+    fluid_real_t acc_lr[FLUID_CONV_BINS], acc_li[FLUID_CONV_BINS];
+    fluid_real_t acc_rr[FLUID_CONV_BINS], acc_ri[FLUID_CONV_BINS];
+    int i, k, p, slot;
+
+    /* spectrum of the previous and the current input block */
+    FLUID_MEMCPY(re, conv->last_in, FLUID_BUFSIZE * sizeof(fluid_real_t));
+    FLUID_MEMCPY(&re[FLUID_BUFSIZE], in, FLUID_BUFSIZE * sizeof(fluid_real_t));
+    FLUID_MEMSET(im, 0, FLUID_CONV_FFT_SIZE * sizeof(fluid_real_t));
+    FLUID_MEMCPY(conv->last_in, in, FLUID_BUFSIZE * sizeof(fluid_real_t));
+    fluid_conv_fft(conv, re, im);
+
+    conv->head = (conv->head + 1 < conv->partitions) ? conv->head + 1 : 0;
+    FLUID_MEMCPY(&conv->fdl_re[conv->head * FLUID_CONV_BINS], re, FLUID_CONV_BINS * sizeof(fluid_real_t));
+    FLUID_MEMCPY(&conv->fdl_im[conv->head * FLUID_CONV_BINS], im, FLUID_CONV_BINS * sizeof(fluid_real_t));
+
+    FLUID_MEMSET(acc_lr, 0, sizeof(acc_lr));
+    FLUID_MEMSET(acc_li, 0, sizeof(acc_li));
+    FLUID_MEMSET(acc_rr, 0, sizeof(acc_rr));
+    FLUID_MEMSET(acc_ri, 0, sizeof(acc_ri));
+
+    /* multiply and accumulate, partition p applies to the input of p blocks ago */
+    for(p = 0, slot = conv->head; p < conv->partitions; p++)
+    {
+        const fluid_real_t *FLUID_RESTRICT x_re = &conv->fdl_re[slot * FLUID_CONV_BINS];
+        const fluid_real_t *FLUID_RESTRICT x_im = &conv->fdl_im[slot * FLUID_CONV_BINS];
+        const fluid_real_t *FLUID_RESTRICT l_re = &conv->left_re[p * FLUID_CONV_BINS];
+        const fluid_real_t *FLUID_RESTRICT l_im = &conv->left_im[p * FLUID_CONV_BINS];
+        const fluid_real_t *FLUID_RESTRICT r_re = &conv->right_re[p * FLUID_CONV_BINS];
+        const fluid_real_t *FLUID_RESTRICT r_im = &conv->right_im[p * FLUID_CONV_BINS];
+
+        #pragma omp simd
+        for(k = 0; k < FLUID_CONV_BINS; k++)
+        {
+            acc_lr[k] += x_re[k] * l_re[k] - x_im[k] * l_im[k];
+            acc_li[k] += x_re[k] * l_im[k] + x_im[k] * l_re[k];
+            acc_rr[k] += x_re[k] * r_re[k] - x_im[k] * r_im[k];
+            acc_ri[k] += x_re[k] * r_im[k] + x_im[k] * r_re[k];
+        }
+
+        slot = (slot > 0) ? slot - 1 : conv->partitions - 1;
+    }
+
+    /* Inverse transform of Z = L + i * R, done as the conjugate of the FFT of its conjugate.
+     * The upper bins follow from the symmetry of the spectra of real signals. */
+    for(k = 0; k < FLUID_CONV_BINS; k++)
+    {
+        re[k] = acc_lr[k] - acc_ri[k];
+        im[k] = -(acc_li[k] + acc_rr[k]);
+    }
+
+    for(k = FLUID_CONV_BINS, i = FLUID_BUFSIZE - 1; k < FLUID_CONV_FFT_SIZE; k++, i--)
+    {
+        re[k] = acc_lr[i] + acc_ri[i];
+        im[k] = acc_li[i] - acc_rr[i];
+    }
+
+    fluid_conv_fft(conv, re, im);
+}
+
+void
+fluid_convolver_processmix(fluid_convolver_t *conv, const fluid_real_t *in,
+                           fluid_real_t *left_out, fluid_real_t *right_out)
+{
+    fluid_real_t re[FLUID_CONV_FFT_SIZE], im[FLUID_CONV_FFT_SIZE];
+    int i;
+
+    fluid_convolver_process(conv, in, re, im);
+
+    for(i = 0; i < FLUID_BUFSIZE; i++)
+    {
+        left_out[i] += re[FLUID_BUFSIZE + i];
+        right_out[i] -= im[FLUID_BUFSIZE + i];
+    }
+}
+
+void
+fluid_convolver_processreplace(fluid_convolver_t *conv, const fluid_real_t *in,
+                               fluid_real_t *left_out, fluid_real_t *right_out)
+{
+    fluid_real_t re[FLUID_CONV_FFT_SIZE], im[FLUID_CONV_FFT_SIZE];
+    int i;
+
+    fluid_convolver_process(conv, in, re, im);
+
+    for(i = 0; i < FLUID_BUFSIZE; i++)
+    {
+        left_out[i] = re[FLUID_BUFSIZE + i];
+        right_out[i] = -im[FLUID_BUFSIZE + i];
+    }
+}
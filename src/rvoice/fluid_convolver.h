@@ -0,0 +1,60 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FLUID_CONVOLVER_H
+#define _FLUID_CONVOLVER_H
+
+#include "fluidsynth_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Uniformly partitioned FFT convolution of a mono input with a stereo impulse
+ * response, processing blocks of FLUID_BUFSIZE samples without latency and at a
+ * constant cost per block. Used by the mixer instead of the reverb model of an fx
+ * unit, see fluid_synth_set_reverb_ir().
+ *
+ * Creating a convolver partitions and transforms the impulse response, which is
+ * not realtime safe, the processing functions are.
+ */
+typedef struct _fluid_convolver_t fluid_convolver_t;
+
+fluid_convolver_t *new_fluid_convolver(const float *left, const float *right, int length);
+void delete_fluid_convolver(fluid_convolver_t *conv);
+
+void fluid_convolver_processmix(fluid_convolver_t *conv, const fluid_real_t *in,
+                                fluid_real_t *left_out, fluid_real_t *right_out);
+
+void fluid_convolver_processreplace(fluid_convolver_t *conv, const fluid_real_t *in,
+                                    fluid_real_t *left_out, fluid_real_t *right_out);
+
+void fluid_convolver_reset(fluid_convolver_t *conv);
+int fluid_convolver_get_partitions(const fluid_convolver_t *conv);
+
+void fluid_convolver_retire(fluid_convolver_t *conv);
+int fluid_convolver_is_retired(fluid_convolver_t *conv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_CONVOLVER_H */
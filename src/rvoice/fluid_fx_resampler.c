@@ -0,0 +1,301 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Polyphase decimation and interpolation by an integer factor:
+ *
+ * Both use the same linear phase lowpass, a Kaiser windowed sinc of
+ * TAPS_PER_PHASE * factor taps with its cutoff at the reduced Nyquist
+ * frequency. Aliases of the transition band fold back into the transition
+ * band, above the passband. The decimator only computes every factor-th
+ * output sample. The interpolator splits the filter into factor phases of
+ * TAPS_PER_PHASE taps, each computing one of the consecutive output samples
+ * from the input at the reduced rate without multiplying the inserted zeros.
+ */
+
+#include "fluid_fx_resampler.h"
+#include "fluid_sys.h"
+
+#define TAPS_PER_PHASE 16
+#define MAX_TAPS (TAPS_PER_PHASE * FLUID_FX_RESAMPLER_MAX_FACTOR)
+
+/* about 70 dB stopband attenuation */
+#define KAISER_BETA 7.0
+
+struct _fluid_fx_resampler_t
+{
+    int factor;
+    int taps;           /* length of the lowpass, TAPS_PER_PHASE * factor */
+    int low_count;      /* number of samples gathered in low_in */
+    int out_pos;        /* next sample of out_left and out_right to output */
+
+    fluid_real_t coefs[MAX_TAPS];                       /* lowpass, summing up to 1 */
+    fluid_real_t phases[FLUID_FX_RESAMPLER_MAX_FACTOR][TAPS_PER_PHASE]; /* the same, split into phases summing up to 1 */
+
+    /* input at the output rate, the block preceded by the last taps - 1 samples */
+    fluid_real_t in_hist[MAX_TAPS - 1 + FLUID_BUFSIZE];
+    fluid_real_t low_in[FLUID_BUFSIZE];
+
+    /* output of the unit at the reduced rate, preceded by the last TAPS_PER_PHASE - 1
+     * samples of the previous block */
+    fluid_real_t low_left[TAPS_PER_PHASE - 1 + FLUID_BUFSIZE];
+    fluid_real_t low_right[TAPS_PER_PHASE - 1 + FLUID_BUFSIZE];
+
+    /* the last block at the reduced rate, interpolated to the output rate */
+    fluid_real_t out_left[FLUID_FX_RESAMPLER_MAX_FACTOR * FLUID_BUFSIZE];
+    fluid_real_t out_right[FLUID_FX_RESAMPLER_MAX_FACTOR * FLUID_BUFSIZE];
+};
+
+/* Modified Bessel function of the first kind and order 0 */
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    int k;
+
+    for(k = 1; term > sum * 1e-12; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+fluid_fx_resampler_t *new_fluid_fx_resampler(void)
+{
+    fluid_fx_resampler_t *rs = FLUID_NEW(fluid_fx_resampler_t);
+
+    if(rs == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    fluid_fx_resampler_set_factor(rs, 1);
+    return rs;
+}
+
+void delete_fluid_fx_resampler(fluid_fx_resampler_t *rs)
+{
+    fluid_return_if_fail(rs != NULL);
+    FLUID_FREE(rs);
+}
+
+/*
+ * Sets the rate reduction, a power of two up to FLUID_FX_RESAMPLER_MAX_FACTOR.
+ * A factor of 1 passes the signal through unchanged. Resets the resampler.
+ */
+void fluid_fx_resampler_set_factor(fluid_fx_resampler_t *rs, int factor)
+{
+    double center, cutoff, x, w, sum;
+    int k, p, j;
+
+    fluid_clip(factor, 1, FLUID_FX_RESAMPLER_MAX_FACTOR);
+
+    FLUID_MEMSET(rs, 0, sizeof(*rs));
+    rs->factor = factor;
+
+    if(factor == 1)
+    {
+        rs->taps = 1;
+        rs->coefs[0] = 1;
+        rs->phases[0][0] = 1;
+        return;
+    }
+
+    rs->taps = TAPS_PER_PHASE * factor;
+    center = 0.5 * (rs->taps - 1);
+    cutoff = 0.5 / factor;
+    sum = 0;
+
+    for(k = 0; k < rs->taps; k++)
+    {
+        x = k - center; /* never 0, the number of taps is even */
+        w = bessel_i0(KAISER_BETA * sqrt(1.0 - (x / center) * (x / center))) / bessel_i0(KAISER_BETA);
+        rs->coefs[k] = (fluid_real_t)(w * sin(2.0 * M_PI * cutoff * x) / (M_PI * x));
+        sum += rs->coefs[k];
+    }
+
+    for(k = 0; k < rs->taps; k++)
+    {
+        rs->coefs[k] /= (fluid_real_t)sum;
+    }
+
+    /* normalizing every phase avoids a ripple at the reduced rate in the interpolated output */
+    for(p = 0; p < factor; p++)
+    {
+        sum = 0;
+
+        for(j = 0; j < TAPS_PER_PHASE; j++)
+        {
+            sum += rs->coefs[p + j * factor];
+        }
+
+        for(j = 0; j < TAPS_PER_PHASE; j++)
+        {
+            rs->phases[p][j] = (fluid_real_t)(rs->coefs[p + j * factor] / sum);
+        }
+    }
+}
+
+int fluid_fx_resampler_get_factor(const fluid_fx_resampler_t *rs)
+{
+    return rs->factor;
+}
+
+/*
+ * Clears the filter histories and the pending output, the next block at the
+ * reduced rate starts with the next input block.
+ */
+void fluid_fx_resampler_reset(fluid_fx_resampler_t *rs)
+{
+    rs->low_count = 0;
+    rs->out_pos = 0;
+    FLUID_MEMSET(rs->in_hist, 0, sizeof(rs->in_hist));
+    FLUID_MEMSET(rs->low_left, 0, sizeof(rs->low_left));
+    FLUID_MEMSET(rs->low_right, 0, sizeof(rs->low_right));
+    FLUID_MEMSET(rs->out_left, 0, sizeof(rs->out_left));
+    FLUID_MEMSET(rs->out_right, 0, sizeof(rs->out_right));
+}
+
+/*
+ * TRUE if no input has been gathered for the next block at the reduced rate.
+ */
+int fluid_fx_resampler_is_between_blocks(const fluid_fx_resampler_t *rs)
+{
+    return rs->low_count == 0;
+}
+
+/*
+ * Decimates a block of FLUID_BUFSIZE input samples.
+ * @return the FLUID_BUFSIZE samples at the reduced rate to be processed when
+ *   complete, NULL otherwise
+ */
+const fluid_real_t *fluid_fx_resampler_push(fluid_fx_resampler_t *rs, const fluid_real_t *in)
+{
+    const int hist = rs->taps - 1;
+    const int factor = rs->factor;
+    const int taps = rs->taps;
+    fluid_real_t *x = rs->in_hist;
+    fluid_real_t *low = &rs->low_in[rs->low_count];
+    int n, k;
+
+    FLUID_MEMCPY(&x[hist], in, FLUID_BUFSIZE * sizeof(*in));
+
+    for(n = factor - 1; n < FLUID_BUFSIZE; n += factor)
+    {
+        const fluid_real_t *src = &x[n];
+        fluid_real_t sum = 0;
+
+        /* the lowpass is symmetric, no need to reverse the input */
+        for(k = 0; k < taps; k++)
+        {
+            sum += rs->coefs[k] * src[k];
+        }
+
+        *low++ = sum;
+    }
+
+    FLUID_MEMMOVE(x, &x[FLUID_BUFSIZE], hist * sizeof(*x));
+    rs->low_count += FLUID_BUFSIZE / factor;
+
+    if(rs->low_count < FLUID_BUFSIZE)
+    {
+        return NULL;
+    }
+
+    rs->low_count = 0;
+    return rs->low_in;
+}
+
+/*
+ * Outputs the next FLUID_BUFSIZE samples of the interpolated output, added to
+ * the output buffers if mix is TRUE.
+ */
+void fluid_fx_resampler_pull(fluid_fx_resampler_t *rs, fluid_real_t *left_out, fluid_real_t *right_out, int mix)
+{
+    const fluid_real_t *left = &rs->out_left[rs->out_pos];
+    const fluid_real_t *right = &rs->out_right[rs->out_pos];
+    int i;
+
+    if(mix)
+    {
+        for(i = 0; i < FLUID_BUFSIZE; i++)
+        {
+            left_out[i] += left[i];
+            right_out[i] += right[i];
+        }
+    }
+    else
+    {
+        FLUID_MEMCPY(left_out, left, FLUID_BUFSIZE * sizeof(*left));
+        FLUID_MEMCPY(right_out, right, FLUID_BUFSIZE * sizeof(*right));
+    }
+
+    rs->out_pos += FLUID_BUFSIZE;
+}
+
+/*
+ * Returns the buffers the unit outputs the block returned by
+ * fluid_fx_resampler_push() to, FLUID_BUFSIZE samples each.
+ */
+void fluid_fx_resampler_get_output(fluid_fx_resampler_t *rs, fluid_real_t **left, fluid_real_t **right)
+{
+    *left = &rs->low_left[TAPS_PER_PHASE - 1];
+    *right = &rs->low_right[TAPS_PER_PHASE - 1];
+}
+
+/*
+ * Interpolates the block the unit has output, to be pulled over the next
+ * "factor" blocks.
+ */
+void fluid_fx_resampler_commit(fluid_fx_resampler_t *rs)
+{
+    const int hist = TAPS_PER_PHASE - 1;
+    const int factor = rs->factor;
+    fluid_real_t *out_l = rs->out_left;
+    fluid_real_t *out_r = rs->out_right;
+    int m, p, j;
+
+    for(m = 0; m < FLUID_BUFSIZE; m++)
+    {
+        const fluid_real_t *src_l = &rs->low_left[hist + m];
+        const fluid_real_t *src_r = &rs->low_right[hist + m];
+
+        for(p = 0; p < factor; p++)
+        {
+            const fluid_real_t *h = rs->phases[p];
+            fluid_real_t l = 0, r = 0;
+
+            for(j = 0; j < TAPS_PER_PHASE; j++)
+            {
+                l += h[j] * src_l[-j];
+                r += h[j] * src_r[-j];
+            }
+
+            *out_l++ = l;
+            *out_r++ = r;
+        }
+    }
+
+    FLUID_MEMMOVE(rs->low_left, &rs->low_left[FLUID_BUFSIZE], hist * sizeof(*rs->low_left));
+    FLUID_MEMMOVE(rs->low_right, &rs->low_right[FLUID_BUFSIZE], hist * sizeof(*rs->low_right));
+    rs->out_pos = 0;
+}
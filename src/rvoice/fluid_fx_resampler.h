@@ -0,0 +1,74 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FLUID_FX_RESAMPLER_H
+#define _FLUID_FX_RESAMPLER_H
+
+#include "fluidsynth_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Highest rate reduction, the factor must be a power of two */
+#define FLUID_FX_RESAMPLER_MAX_FACTOR 4
+
+/*
+ * Runs an effects unit at the output rate divided by the factor: the mono input
+ * is decimated, FLUID_BUFSIZE samples at the reduced rate are gathered from
+ * "factor" input blocks and processed at once, and the stereo output of that
+ * block is interpolated back to the output rate over the next "factor" blocks.
+ * Adds a latency of factor * FLUID_BUFSIZE samples plus the delay of the
+ * linear phase filters, about factor * (FLUID_BUFSIZE + 16) samples in total.
+ *
+ * A block at the reduced rate is processed by:
+ *
+ *     low_in = fluid_fx_resampler_push(rs, in);
+ *     fluid_fx_resampler_pull(rs, out_l, out_r, mix);
+ *
+ *     if(low_in != NULL)
+ *     {
+ *         fluid_fx_resampler_get_output(rs, &low_l, &low_r);
+ *         process(unit, low_in, low_l, low_r);
+ *         fluid_fx_resampler_commit(rs);
+ *     }
+ *
+ * Creating a resampler isn't realtime safe, everything else is.
+ */
+typedef struct _fluid_fx_resampler_t fluid_fx_resampler_t;
+
+fluid_fx_resampler_t *new_fluid_fx_resampler(void);
+void delete_fluid_fx_resampler(fluid_fx_resampler_t *rs);
+
+void fluid_fx_resampler_set_factor(fluid_fx_resampler_t *rs, int factor);
+int fluid_fx_resampler_get_factor(const fluid_fx_resampler_t *rs);
+void fluid_fx_resampler_reset(fluid_fx_resampler_t *rs);
+int fluid_fx_resampler_is_between_blocks(const fluid_fx_resampler_t *rs);
+
+const fluid_real_t *fluid_fx_resampler_push(fluid_fx_resampler_t *rs, const fluid_real_t *in);
+void fluid_fx_resampler_pull(fluid_fx_resampler_t *rs, fluid_real_t *left_out, fluid_real_t *right_out, int mix);
+void fluid_fx_resampler_get_output(fluid_fx_resampler_t *rs, fluid_real_t **left, fluid_real_t **right);
+void fluid_fx_resampler_commit(fluid_fx_resampler_t *rs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_FX_RESAMPLER_H */
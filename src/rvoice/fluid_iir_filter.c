@@ -20,6 +20,98 @@
 #include "fluid_iir_filter.h"
 #include "fluid_sys.h"
 #include "fluid_conv.h"
+#include "fluid_list.h"
+
+/* A table of sin and cos values for one sample rate, shared by all synths of the process */
+typedef struct
+{
+    fluid_real_t sample_rate;
+    int num_references;
+    fluid_iir_sincos_t table[SINCOS_TAB_SIZE];
+} fluid_iir_sincos_entry_t;
+
+static fluid_list_t *iir_sincos_list = NULL;
+static fluid_mutex_t iir_sincos_mutex = FLUID_MUTEX_INIT;
+
+/**
+ * Get the table of sin and cos values for a sample rate, calculating it if no other
+ * synth of the process uses it yet.
+ * @param sample_rate Output rate of the filters
+ * @return The table, to be released with fluid_iir_filter_release_table(), or NULL if out of memory
+ */
+fluid_iir_sincos_t *
+fluid_iir_filter_acquire_table(fluid_real_t sample_rate)
+{
+    fluid_iir_sincos_entry_t *entry = NULL;
+    fluid_list_t *list;
+
+    fluid_mutex_lock(iir_sincos_mutex);
+
+    for(list = iir_sincos_list; list != NULL; list = fluid_list_next(list))
+    {
+        entry = fluid_list_get(list);
+
+        if(entry->sample_rate == sample_rate)
+        {
+            break;
+        }
+    }
+
+    if(list == NULL)
+    {
+        entry = FLUID_NEW(fluid_iir_sincos_entry_t);
+
+        if(entry == NULL)
+        {
+            fluid_mutex_unlock(iir_sincos_mutex);
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return NULL;
+        }
+
+        entry->sample_rate = sample_rate;
+        entry->num_references = 0;
+        fluid_iir_filter_init_table(entry->table, sample_rate);
+        iir_sincos_list = fluid_list_prepend(iir_sincos_list, entry);
+    }
+
+    entry->num_references++;
+    fluid_mutex_unlock(iir_sincos_mutex);
+
+    return entry->table;
+}
+
+/**
+ * Release a table returned by fluid_iir_filter_acquire_table(), freeing it when no synth uses it anymore.
+ * @param sincos_table The table, may be NULL
+ */
+void
+fluid_iir_filter_release_table(fluid_iir_sincos_t *sincos_table)
+{
+    fluid_iir_sincos_entry_t *entry;
+    fluid_list_t *list;
+
+    fluid_return_if_fail(sincos_table != NULL);
+
+    fluid_mutex_lock(iir_sincos_mutex);
+
+    for(list = iir_sincos_list; list != NULL; list = fluid_list_next(list))
+    {
+        entry = fluid_list_get(list);
+
+        if(entry->table == sincos_table)
+        {
+            if(--entry->num_references == 0)
+            {
+                iir_sincos_list = fluid_list_remove(iir_sincos_list, entry);
+                FLUID_FREE(entry);
+            }
+
+            break;
+        }
+    }
+
+    fluid_mutex_unlock(iir_sincos_mutex);
+}
 
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_iir_filter_init)
@@ -45,6 +137,7 @@ fluid_iir_filter_reset(fluid_iir_filter_t *iir_filter)
     iir_filter->last_fres = -1.;
     iir_filter->last_q = 0;
     iir_filter->filter_startup = 1;
+    iir_filter->settled = 0;
     iir_filter->amp = 0;
     iir_filter->amp_incr = 0;
 }
@@ -45,6 +45,13 @@ typedef struct _sincos_t
     IIR_COEFF_T cos;
 } fluid_iir_sincos_t;
 
+/* How the filter coefficients follow a changing fres or Q, see synth.filter-smoothing */
+enum fluid_iir_filter_smoothing
+{
+    FLUID_IIR_SMOOTHING_SAMPLE, /* recalculate the coefficients after every sample */
+    FLUID_IIR_SMOOTHING_BLOCK   /* calculate the coefficients once per block and interpolate them linearly */
+};
+
 /* We can't do information hiding here, as fluid_voice_t includes the struct
    without a pointer. */
 struct _fluid_iir_filter_t
@@ -62,11 +69,14 @@ struct _fluid_iir_filter_t
 
     fluid_real_t hist1, hist2;      /* Sample history for the IIR filter */
     int filter_startup;             /* Flag: If set, the filter parameters will be set directly. Else it changes smoothly. */
+    enum fluid_iir_filter_smoothing smoothing; /* How the coefficients follow changes of fres and Q, set by the mixer */
 
     fluid_real_t fres;              /* The desired resonance frequency, in absolute cents, this filter is currently set to */
     fluid_real_t last_fres;         /* The filter's current (smoothed out) resonance frequency in Hz, which will converge towards its target fres once fres_incr_count has become zero */
     fluid_real_t fres_incr;         /* The linear increment of fres each sample */
     int fres_incr_count;            /* The number of samples left for the smoothed last_fres adjustment to complete */
+    int settled;                    /* Flag: If set, fluid_iir_filter_calc() has nothing to do while it's called with a modulated fres of settled_fres */
+    fluid_real_t settled_fres;      /* The fres plus modulation, in absolute cents, fluid_iir_filter_calc() was last called with */
 
     fluid_real_t last_q;            /* The filter's current (smoothed) Q-factor (or "bandwidth", or "resonance-friendlyness") on a linear scale. Just like fres, this will converge towards its target Q once q_incr_count has become zero. */
     fluid_real_t q_incr;            /* The linear increment of q each sample */
@@ -80,7 +90,7 @@ struct _fluid_iir_filter_t
     fluid_real_t amp;                /* current linear amplitude */
     fluid_real_t amp_incr;           /* amplitude increment value for the next FLUID_BUFSIZE samples */
 
-    fluid_iir_sincos_t *sincos_table; /* pointer to the precalculated sin and cos values, owned by the synth */
+    fluid_iir_sincos_t *sincos_table; /* pointer to the precalculated sin and cos values, see fluid_iir_filter_acquire_table() */
 };
 
 enum
@@ -101,6 +111,8 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_iir_filter_set_fres);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_iir_filter_set_q);
 
 void fluid_iir_filter_init_table(fluid_iir_sincos_t *sincos_table, fluid_real_t sample_rate);
+fluid_iir_sincos_t *fluid_iir_filter_acquire_table(fluid_real_t sample_rate);
+void fluid_iir_filter_release_table(fluid_iir_sincos_t *sincos_table);
 
 void fluid_iir_filter_reset(fluid_iir_filter_t *iir_filter);
 
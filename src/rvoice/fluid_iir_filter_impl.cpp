@@ -130,6 +130,52 @@ static inline void fluid_iir_filter_calculate_coefficients(R fres,
     *b1_out = b1_temp;
 }
 
+/*
+ * Advances fres and Q by up to count samples of their linear smoothing and calculates the
+ * coefficients they end up with. FLUID_IIR_SMOOTHING_BLOCK interpolates the coefficients
+ * linearly towards these values instead of recalculating them after every sample.
+ * Returns the number of samples the interpolation takes, zero if neither fres nor Q change.
+ */
+template<bool GAIN_NORM, enum fluid_iir_filter_type TYPE>
+static unsigned int
+fluid_iir_filter_ramp_coefficients(const fluid_iir_filter_t *iir_filter, unsigned int count,
+                                   IIR_COEFF_T *fres, IIR_COEFF_T *q,
+                                   int *fres_incr_count, int *q_incr_count,
+                                   IIR_COEFF_T *a1_end, IIR_COEFF_T *a2_end,
+                                   IIR_COEFF_T *b02_end, IIR_COEFF_T *b1_end)
+{
+    unsigned int fres_steps = 0, q_steps = 0;
+
+    if(*fres_incr_count > 0)
+    {
+        fres_steps = std::min(count, static_cast<unsigned int>(*fres_incr_count));
+        *fres_incr_count -= fres_steps;
+        *fres += static_cast<IIR_COEFF_T>(iir_filter->fres_incr) * fres_steps;
+    }
+
+    if(*q_incr_count > 0)
+    {
+        q_steps = std::min(count, static_cast<unsigned int>(*q_incr_count));
+        *q_incr_count -= q_steps;
+        *q += static_cast<IIR_COEFF_T>(iir_filter->q_incr) * q_steps;
+
+        if(*q < Q_MIN)
+        {
+            *q_incr_count = 0;
+            *q = Q_MIN;
+        }
+    }
+
+    if(fres_steps == 0 && q_steps == 0)
+    {
+        return 0;
+    }
+
+    fluid_iir_filter_calculate_coefficients<IIR_COEFF_T, GAIN_NORM, TYPE>(*fres, *q, iir_filter->sincos_table, a1_end, a2_end, b02_end, b1_end);
+
+    return std::max(fres_steps, q_steps);
+}
+
 /**
  * Applies a low- or high-pass filter with variable cutoff frequency and quality factor
  * for a given biquad transfer function:
@@ -154,7 +200,7 @@ static inline void fluid_iir_filter_calculate_coefficients(R fres,
  * - dsp_hist1: same
  * - dsp_hist2: same
  */
-template<bool GAIN_NORM, bool AMPLIFY, enum fluid_iir_filter_type TYPE>
+template<bool GAIN_NORM, bool AMPLIFY, enum fluid_iir_filter_type TYPE, bool BLOCK>
 static void
 fluid_iir_filter_apply_local(fluid_iir_filter_t *iir_filter, fluid_real_t *dsp_buf, unsigned int count)
 {
@@ -187,6 +233,25 @@ fluid_iir_filter_apply_local(fluid_iir_filter_t *iir_filter, fluid_real_t *dsp_b
         const IIR_COEFF_T fres_incr = static_cast<IIR_COEFF_T>(iir_filter->fres_incr);
         const IIR_COEFF_T q_incr = static_cast<IIR_COEFF_T>(iir_filter->q_incr);
 
+        /* coefficient ramp of FLUID_IIR_SMOOTHING_BLOCK */
+        IIR_COEFF_T a1_end, a2_end, b02_end, b1_end;
+        IIR_COEFF_T a1_incr = 0, a2_incr = 0, b02_incr = 0, b1_incr = 0;
+        unsigned int ramp = 0;
+
+        if(BLOCK)
+        {
+            ramp = fluid_iir_filter_ramp_coefficients<GAIN_NORM, TYPE>(iir_filter, count, &fres, &q,
+                    &fres_incr_count, &q_incr_count, &a1_end, &a2_end, &b02_end, &b1_end);
+
+            if(ramp > 0)
+            {
+                a1_incr = (a1_end - dsp_a1) / ramp;
+                a2_incr = (a2_end - dsp_a2) / ramp;
+                b02_incr = (b02_end - dsp_b02) / ramp;
+                b1_incr = (b1_end - dsp_b1) / ramp;
+            }
+        }
+
         /* filter (implement the voice filter according to SoundFont standard) */
 
         unsigned int dsp_i;
@@ -222,7 +287,17 @@ fluid_iir_filter_apply_local(fluid_iir_filter_t *iir_filter, fluid_real_t *dsp_b
                 dsp_buf[dsp_i] = sample;
             }
 
-            if(fres_incr_count > 0 || q_incr_count > 0)
+            if(BLOCK)
+            {
+                if(dsp_i < ramp)
+                {
+                    dsp_a1 += a1_incr;
+                    dsp_a2 += a2_incr;
+                    dsp_b02 += b02_incr;
+                    dsp_b1 += b1_incr;
+                }
+            }
+            else if(fres_incr_count > 0 || q_incr_count > 0)
             {
                 if(fres_incr_count > 0)
                 {
@@ -249,6 +324,15 @@ fluid_iir_filter_apply_local(fluid_iir_filter_t *iir_filter, fluid_real_t *dsp_b
             }
         }
 
+        if(BLOCK && ramp > 0)
+        {
+            /* don't let rounding errors of the ramp accumulate */
+            dsp_a1 = a1_end;
+            dsp_a2 = a2_end;
+            dsp_b02 = b02_end;
+            dsp_b1 = b1_end;
+        }
+
         iir_filter->a1 = dsp_a1;
         iir_filter->a2 = dsp_a2;
         iir_filter->b02= dsp_b02;
@@ -274,36 +358,56 @@ fluid_iir_filter_apply_local(fluid_iir_filter_t *iir_filter, fluid_real_t *dsp_b
     }
 }
 
-extern "C" void fluid_iir_filter_apply(fluid_iir_filter_t *resonant_filter,
-                                       fluid_iir_filter_t *resonant_custom_filter,
-                                       fluid_real_t *dsp_buf,
-                                       unsigned int count)
+template<bool GAIN_NORM, bool AMPLIFY, enum fluid_iir_filter_type TYPE>
+static FLUID_INLINE void
+fluid_iir_filter_apply_smoothing(fluid_iir_filter_t *iir_filter, fluid_real_t *dsp_buf, unsigned int count)
+{
+    if(iir_filter->smoothing == FLUID_IIR_SMOOTHING_BLOCK)
+    {
+        fluid_iir_filter_apply_local<GAIN_NORM, AMPLIFY, TYPE, true>(iir_filter, dsp_buf, count);
+    }
+    else
+    {
+        fluid_iir_filter_apply_local<GAIN_NORM, AMPLIFY, TYPE, false>(iir_filter, dsp_buf, count);
+    }
+}
+
+static void
+fluid_iir_filter_apply_custom(fluid_iir_filter_t *resonant_custom_filter, fluid_real_t *dsp_buf, unsigned int count)
 {
     if(resonant_custom_filter->flags & FLUID_IIR_NO_GAIN_AMP)
     {
         if(resonant_custom_filter->type == FLUID_IIR_HIGHPASS)
         {
-            fluid_iir_filter_apply_local<false, false, FLUID_IIR_HIGHPASS>(resonant_custom_filter, dsp_buf, count);
+            fluid_iir_filter_apply_smoothing<false, false, FLUID_IIR_HIGHPASS>(resonant_custom_filter, dsp_buf, count);
         }
         else
         {
-            fluid_iir_filter_apply_local<false, false, FLUID_IIR_LOWPASS>(resonant_custom_filter, dsp_buf, count);
+            fluid_iir_filter_apply_smoothing<false, false, FLUID_IIR_LOWPASS>(resonant_custom_filter, dsp_buf, count);
         }
     }
     else
     {
         if(resonant_custom_filter->type == FLUID_IIR_HIGHPASS)
         {
-            fluid_iir_filter_apply_local<true, false, FLUID_IIR_HIGHPASS>(resonant_custom_filter, dsp_buf, count);
+            fluid_iir_filter_apply_smoothing<true, false, FLUID_IIR_HIGHPASS>(resonant_custom_filter, dsp_buf, count);
         }
         else
         {
-            fluid_iir_filter_apply_local<true, false, FLUID_IIR_LOWPASS>(resonant_custom_filter, dsp_buf, count);
+            fluid_iir_filter_apply_smoothing<true, false, FLUID_IIR_LOWPASS>(resonant_custom_filter, dsp_buf, count);
         }
     }
+}
+
+extern "C" void fluid_iir_filter_apply(fluid_iir_filter_t *resonant_filter,
+                                       fluid_iir_filter_t *resonant_custom_filter,
+                                       fluid_real_t *dsp_buf,
+                                       unsigned int count)
+{
+    fluid_iir_filter_apply_custom(resonant_custom_filter, dsp_buf, count);
 
     // This is the last filter in the chain - the default SF2 filter that always runs. This one must apply the final envelope gain.
-    fluid_iir_filter_apply_local<true, true, FLUID_IIR_LOWPASS>(resonant_filter, dsp_buf, count);
+    fluid_iir_filter_apply_smoothing<true, true, FLUID_IIR_LOWPASS>(resonant_filter, dsp_buf, count);
 }
 
 void fluid_iir_filter_calc(fluid_iir_filter_t *iir_filter,
@@ -312,14 +416,23 @@ void fluid_iir_filter_calc(fluid_iir_filter_t *iir_filter,
 {
     bool calc_coeff_flag = false;
     fluid_real_t fres, fres_diff;
+    fluid_real_t fres_in = iir_filter->fres + fres_mod;
     
     if(iir_filter->type == FLUID_IIR_DISABLED)
     {
         return;
     }
 
+    /* Neither the cutoff nor its smoothing have changed since the last call, which would
+     * leave everything as it is. This is the case for every block of an unmodulated filter. */
+    if(iir_filter->settled && fres_in == iir_filter->settled_fres
+            && !iir_filter->filter_startup && iir_filter->fres_incr_count == 0)
+    {
+        return;
+    }
+
     /* calculate the frequency of the resonant filter in Hz */
-    fres = fluid_ct2hz(iir_filter->fres + fres_mod);
+    fres = fluid_ct2hz(fres_in);
 
     /* I removed the optimization of turning the filter off when the
      * resonance frequency is above the maximum frequency. Instead, the
@@ -442,4 +555,7 @@ void fluid_iir_filter_calc(fluid_iir_filter_t *iir_filter,
             }
         }
     }
+
+    iir_filter->settled = !iir_filter->filter_startup && iir_filter->fres_incr_count == 0;
+    iir_filter->settled_fres = fres_in;
 }
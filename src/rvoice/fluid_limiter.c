@@ -20,12 +20,47 @@
  */
 
 #include "fluidsynth_priv.h"
+#include "fluid_limiter.h"
+#include "fluid_sys.h"
 
 #ifdef LIMITER_SUPPORT
-
-#include "fluid_limiter.h"
 #include "fluid_limiter_impl.h"
-#include "fluid_sys.h"
+#endif
+
+/*
+ * The look-ahead-free limiter computes the gain envelopes of all channels of
+ * all channel pairs together, one channel per lane: for each sample, the peak
+ * hold and the smoothing stages of every channel are updated by a single loop
+ * over the lanes, which is vectorized. Without look-ahead the gain is reduced
+ * instantly when a peak arrives, only its release is smoothed.
+ */
+struct _fluid_limiter_t
+{
+    fluid_limiter_settings_t settings;
+    int num_pairs;
+
+#ifdef LIMITER_SUPPORT
+    /* look-ahead limiters, one per channel pair, NULL for the look-ahead-free limiter */
+    fluid_limiter_impl_t **impl;
+#endif
+
+    /* look-ahead-free limiter */
+    int lanes;                  /* one lane per channel: 2 * num_pairs */
+    fluid_real_t hold_samples;
+    fluid_real_t release_coeff; /* of each smoothing stage */
+    fluid_real_t *held;         /* held gain of each lane */
+    fluid_real_t *hold_left;    /* samples left until the held gain is released */
+    fluid_real_t *stage;        /* smoothed gains, FLUID_LIMITER_MAX_SMOOTHING_STAGES * lanes */
+    fluid_real_t *env;          /* gain of each lane for one block, sample-major */
+};
+
+static void fluid_limiter_set_times(fluid_limiter_t *lim, fluid_real_t sample_rate)
+{
+    fluid_real_t release = lim->settings.release_ms * sample_rate / (1000 * lim->settings.smoothing_stages);
+
+    lim->hold_samples = (fluid_real_t)(int)(lim->settings.hold_ms * sample_rate / 1000 + 0.5);
+    lim->release_coeff = (release > 1) ? (fluid_real_t)(1.0 - exp(-1.0 / release)) : 1;
+}
 
 /*----------------------------------------------------------------------------
                             Limiter API
@@ -34,27 +69,97 @@
 * Creates a limiter with default parameters
 *
 * @param sample_rate actual sample rate needed in Hz.
+* @param settings the limiter parameters
+* @param num_pairs number of stereo channel pairs to limit independently
 * @return pointer on the new limiter or NULL if memory error.
 * Limiter API.
 */
 fluid_limiter_t *
-new_fluid_limiter(fluid_real_t sample_rate, fluid_limiter_settings_t* settings)
+new_fluid_limiter(fluid_real_t sample_rate, fluid_limiter_settings_t* settings, int num_pairs)
 {
     fluid_limiter_t *lim;
+    int i;
 
-    if(sample_rate <= 0)
+    if(sample_rate <= 0 || num_pairs <= 0)
     {
         return NULL;
     }
 
-    lim = fluid_limiter_impl_new(sample_rate, settings, FLUID_BUFSIZE);
+    lim = FLUID_NEW(fluid_limiter_t);
 
     if(lim == NULL)
     {
         return NULL;
     }
 
+    FLUID_MEMSET(lim, 0, sizeof(*lim));
+    lim->settings = *settings;
+    lim->num_pairs = num_pairs;
+
+    if(lim->settings.smoothing_stages < 1)
+    {
+        lim->settings.smoothing_stages = 1;
+    }
+    else if(lim->settings.smoothing_stages > FLUID_LIMITER_MAX_SMOOTHING_STAGES)
+    {
+        lim->settings.smoothing_stages = FLUID_LIMITER_MAX_SMOOTHING_STAGES;
+    }
+
+    if(settings->look_ahead)
+    {
+#ifdef LIMITER_SUPPORT
+        lim->impl = FLUID_ARRAY(fluid_limiter_impl_t *, num_pairs);
+
+        if(lim->impl == NULL)
+        {
+            goto error_recovery;
+        }
+
+        FLUID_MEMSET(lim->impl, 0, num_pairs * sizeof(*lim->impl));
+
+        for(i = 0; i < num_pairs; i++)
+        {
+            lim->impl[i] = fluid_limiter_impl_new(sample_rate, settings, FLUID_BUFSIZE);
+
+            if(lim->impl[i] == NULL)
+            {
+                goto error_recovery;
+            }
+        }
+
+        return lim;
+#else
+        FLUID_LOG(FLUID_WARN, "FluidSynth has not been compiled with the look-ahead limiter, using the look-ahead-free one");
+        lim->settings.look_ahead = FALSE;
+#endif
+    }
+
+    lim->lanes = 2 * num_pairs;
+    lim->held = FLUID_ARRAY(fluid_real_t, (2 + FLUID_LIMITER_MAX_SMOOTHING_STAGES + FLUID_BUFSIZE) * lim->lanes);
+
+    if(lim->held == NULL)
+    {
+        goto error_recovery;
+    }
+
+    lim->hold_left = lim->held + lim->lanes;
+    lim->stage = lim->hold_left + lim->lanes;
+    lim->env = lim->stage + FLUID_LIMITER_MAX_SMOOTHING_STAGES * lim->lanes;
+
+    /* start with all channels at unity gain and nothing held */
+    for(i = 0; i < (2 + FLUID_LIMITER_MAX_SMOOTHING_STAGES) * lim->lanes; i++)
+    {
+        lim->held[i] = 1;
+    }
+
+    FLUID_MEMSET(lim->hold_left, 0, lim->lanes * sizeof(fluid_real_t));
+    fluid_limiter_set_times(lim, sample_rate);
+
     return lim;
+
+error_recovery:
+    delete_fluid_limiter(lim);
+    return NULL;
 }
 
 /*
@@ -66,7 +171,26 @@ void
 delete_fluid_limiter(fluid_limiter_t *lim)
 {
     fluid_return_if_fail(lim != NULL);
-    fluid_limiter_impl_delete(lim);
+
+#ifdef LIMITER_SUPPORT
+    if(lim->impl != NULL)
+    {
+        int i;
+
+        for(i = 0; i < lim->num_pairs; i++)
+        {
+            if(lim->impl[i] != NULL)
+            {
+                fluid_limiter_impl_delete(lim->impl[i]);
+            }
+        }
+
+        FLUID_FREE(lim->impl);
+    }
+#endif
+
+    FLUID_FREE(lim->held);
+    FLUID_FREE(lim);
 }
 
 /*
@@ -84,34 +208,176 @@ fluid_limiter_samplerate_change(fluid_limiter_t *lim, fluid_real_t sample_rate)
 
     fluid_return_val_if_fail(lim != NULL, FLUID_FAILED);
 
-    fluid_limiter_impl_set_sample_rate(lim, sample_rate, FLUID_BUFSIZE);
+#ifdef LIMITER_SUPPORT
+    if(lim->impl != NULL)
+    {
+        int i;
+
+        for(i = 0; i < lim->num_pairs; i++)
+        {
+            fluid_limiter_impl_set_sample_rate(lim->impl[i], sample_rate, FLUID_BUFSIZE);
+        }
+
+        return status;
+    }
+#endif
+
+    fluid_limiter_set_times(lim, sample_rate);
 
     return status;
 }
 
-/*-----------------------------------------------------------------------------
-* Run the limiter
-* @param lim pointer on limiter.
-* @param buf_l left buffer to process (will be modified in-place)
-* @param buf_r right buffer to process (will be modified in-place)
-* Limiter API.
------------------------------------------------------------------------------*/
-void
-fluid_limiter_run(fluid_limiter_t *lim, fluid_real_t *buf_l, fluid_real_t *buf_r, int block_count)
+/*
+ * Look-ahead-free limiting of one block of the channel pairs first to last (exclusive).
+ * buf_l and buf_r point to the buffers of pair 0. Only the lanes of these pairs are
+ * touched, so that disjoint ranges of pairs can be processed by different threads.
+ */
+static void
+fluid_limiter_process_block(fluid_limiter_t *lim, fluid_real_t *buf_l, fluid_real_t *buf_r, int pair_stride,
+                            int first, int last)
+{
+    const fluid_real_t input_gain = lim->settings.input_gain;
+    const fluid_real_t limit = lim->settings.output_limit;
+    const fluid_real_t link = lim->settings.link_channels;
+    const fluid_real_t hold_samples = lim->hold_samples;
+    const fluid_real_t coeff = lim->release_coeff;
+    const int stages = lim->settings.smoothing_stages;
+    const int lanes = lim->lanes;
+    fluid_real_t *FLUID_RESTRICT held = lim->held;
+    fluid_real_t *FLUID_RESTRICT hold_left = lim->hold_left;
+    fluid_real_t *FLUID_RESTRICT stage = lim->stage;
+    fluid_real_t *FLUID_RESTRICT env = lim->env;
+    int p, n, c, k;
+
+    /* the gain each channel must not exceed, from its peak mixed with the peak of its pair */
+    for(p = first; p < last; p++)
+    {
+        const fluid_real_t *FLUID_RESTRICT l = buf_l + p * pair_stride;
+        const fluid_real_t *FLUID_RESTRICT r = buf_r + p * pair_stride;
+
+        #pragma omp simd
+        for(n = 0; n < FLUID_BUFSIZE; n++)
+        {
+            fluid_real_t peak_l = FLUID_FABS(l[n]) * input_gain;
+            fluid_real_t peak_r = FLUID_FABS(r[n]) * input_gain;
+            fluid_real_t peak = (peak_l > peak_r) ? peak_l : peak_r;
+
+            peak_l += link * (peak - peak_l);
+            peak_r += link * (peak - peak_r);
+            env[n * lanes + 2 * p] = (peak_l > limit) ? limit / peak_l : 1;
+            env[n * lanes + 2 * p + 1] = (peak_r > limit) ? limit / peak_r : 1;
+        }
+    }
+
+    /* the envelopes of all lanes, sample by sample */
+    for(n = 0; n < FLUID_BUFSIZE; n++)
+    {
+        fluid_real_t *FLUID_RESTRICT gain = &env[n * lanes];
+
+        #pragma omp simd
+        for(c = 2 * first; c < 2 * last; c++)
+        {
+            fluid_real_t target = gain[c];
+            int down = target < held[c];
+            int waiting = !down && hold_left[c] > 0;
+
+            /* a lower gain is held for hold_samples, then the gain follows the target again */
+            held[c] = waiting ? held[c] : target;
+            hold_left[c] = down ? hold_samples : (waiting ? hold_left[c] - 1 : hold_left[c]);
+            target = held[c];
+
+            /* each smoothing stage follows a lower gain instantly and a higher one slowly */
+            for(k = 0; k < stages; k++)
+            {
+                fluid_real_t s = stage[k * lanes + c];
+
+                s += coeff * (target - s);
+                target = (s < target) ? s : target;
+                stage[k * lanes + c] = target;
+            }
+
+            gain[c] = target * input_gain;
+        }
+    }
+
+    for(p = first; p < last; p++)
+    {
+        fluid_real_t *FLUID_RESTRICT l = buf_l + p * pair_stride;
+        fluid_real_t *FLUID_RESTRICT r = buf_r + p * pair_stride;
+
+        #pragma omp simd
+        for(n = 0; n < FLUID_BUFSIZE; n++)
+        {
+            l[n] *= env[n * lanes + 2 * p];
+            r[n] *= env[n * lanes + 2 * p + 1];
+        }
+    }
+}
+
+/* Runs the limiter on the channel pairs first to last (exclusive) */
+static void
+fluid_limiter_run_pairs(fluid_limiter_t *lim, fluid_real_t *buf_l, fluid_real_t *buf_r, int pair_stride,
+                        int first, int last, int block_count)
 {
     int i;
-    fluid_real_t *bufs[FLUID_LIMITER_NUM_CHANNELS_AT_ONCE];
 
     for(i = 0; i < block_count; i++)
     {
+#ifdef LIMITER_SUPPORT
+        if(lim->impl != NULL)
+        {
+            fluid_real_t *bufs[FLUID_LIMITER_NUM_CHANNELS_AT_ONCE];
+            int p;
 #if FLUID_LIMITER_NUM_CHANNELS_AT_ONCE < 2
 #error "expected FLUID_LIMITER_NUM_CHANNELS_AT_ONCE >= 2"
 #endif
-        bufs[0] = buf_l + i * FLUID_BUFSIZE;
-        bufs[1] = buf_r + i * FLUID_BUFSIZE;
 
-        fluid_limiter_impl_process_buffers(lim, bufs, FLUID_BUFSIZE);
+            for(p = first; p < last; p++)
+            {
+                bufs[0] = buf_l + p * pair_stride + i * FLUID_BUFSIZE;
+                bufs[1] = buf_r + p * pair_stride + i * FLUID_BUFSIZE;
+
+                fluid_limiter_impl_process_buffers(lim->impl[p], bufs, FLUID_BUFSIZE);
+            }
+
+            continue;
+        }
+#endif
+
+        fluid_limiter_process_block(lim, buf_l + i * FLUID_BUFSIZE, buf_r + i * FLUID_BUFSIZE, pair_stride,
+                                    first, last);
     }
 }
 
-#endif /* LIMITER_SUPPORT */
+/*-----------------------------------------------------------------------------
+* Run the limiter
+* @param lim pointer on limiter.
+* @param buf_l left buffer of the first pair to process (will be modified in-place)
+* @param buf_r right buffer of the first pair to process (will be modified in-place)
+* @param pair_stride distance in samples between the buffers of two pairs
+* Limiter API.
+-----------------------------------------------------------------------------*/
+void
+fluid_limiter_run(fluid_limiter_t *lim, fluid_real_t *buf_l, fluid_real_t *buf_r, int pair_stride, int block_count)
+{
+    fluid_limiter_run_pairs(lim, buf_l, buf_r, pair_stride, 0, lim->num_pairs, block_count);
+}
+
+/*-----------------------------------------------------------------------------
+* Run the limiter on a single channel pair. The pairs are limited independently,
+* so different pairs may be run concurrently by different threads.
+* @param lim pointer on limiter.
+* @param pair index of the pair to process
+* @param buf_l left buffer of pair 0 (the one of \c pair will be modified in-place)
+* @param buf_r right buffer of pair 0 (the one of \c pair will be modified in-place)
+* @param pair_stride distance in samples between the buffers of two pairs
+* Limiter API.
+-----------------------------------------------------------------------------*/
+void
+fluid_limiter_run_pair(fluid_limiter_t *lim, int pair, fluid_real_t *buf_l, fluid_real_t *buf_r, int pair_stride,
+                       int block_count)
+{
+    fluid_return_if_fail(pair >= 0 && pair < lim->num_pairs);
+
+    fluid_limiter_run_pairs(lim, buf_l, buf_r, pair_stride, pair, pair + 1, block_count);
+}
@@ -21,12 +21,13 @@
 #ifndef _FLUID_LIMITER_H
 #define _FLUID_LIMITER_H
 
-#ifdef LIMITER_SUPPORT
-
 // how many channel buffers to process at once
 // maybe if we want to parallelize, we might set this to 1
 #define FLUID_LIMITER_NUM_CHANNELS_AT_ONCE 2
 
+// maximum number of smoothing stages of the look-ahead-free limiter
+#define FLUID_LIMITER_MAX_SMOOTHING_STAGES 3
+
 typedef struct
 {
     fluid_real_t input_gain;
@@ -36,19 +37,20 @@ typedef struct
     fluid_real_t release_ms;
     int smoothing_stages;
     fluid_real_t link_channels;
+    int look_ahead;     /* FALSE to use the look-ahead-free limiter, which ignores attack_ms */
 } fluid_limiter_settings_t;
 
-typedef void fluid_limiter_t;
+typedef struct _fluid_limiter_t fluid_limiter_t;
 
 fluid_limiter_t *
-new_fluid_limiter(fluid_real_t sample_rate, fluid_limiter_settings_t* settings);
+new_fluid_limiter(fluid_real_t sample_rate, fluid_limiter_settings_t* settings, int num_pairs);
 
 void delete_fluid_limiter(fluid_limiter_t* lim);
 
 int fluid_limiter_samplerate_change(fluid_limiter_t* lim, fluid_real_t sample_rate);
 
-void fluid_limiter_run(fluid_limiter_t *lim, fluid_real_t *buf_l, fluid_real_t *buf_r, int block_count);
-
-#endif /* LIMITER_SUPPORT */
+void fluid_limiter_run(fluid_limiter_t *lim, fluid_real_t *buf_l, fluid_real_t *buf_r, int pair_stride, int block_count);
+void fluid_limiter_run_pair(fluid_limiter_t *lim, int pair, fluid_real_t *buf_l, fluid_real_t *buf_r, int pair_stride,
+                            int block_count);
 
 #endif /* _FLUID_LIMITER_H */
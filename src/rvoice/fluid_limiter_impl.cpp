@@ -38,12 +38,12 @@ using Limiter = signalsmith::basics::LimiterFloat;
 using Limiter = signalsmith::basics::LimiterDouble;
 #endif
 
-extern "C" void fluid_limiter_impl_set_sample_rate(fluid_limiter_t* lim, fluid_real_t sample_rate, unsigned int block_size)
+extern "C" void fluid_limiter_impl_set_sample_rate(fluid_limiter_impl_t* lim, fluid_real_t sample_rate, unsigned int block_size)
 {
     ((Limiter*)lim)->configure(sample_rate, block_size, FLUID_LIMITER_NUM_CHANNELS_AT_ONCE);
 }
 
-extern "C" fluid_limiter_t *fluid_limiter_impl_new(fluid_real_t sample_rate, fluid_limiter_settings_t* settings, unsigned int block_size)
+extern "C" fluid_limiter_impl_t *fluid_limiter_impl_new(fluid_real_t sample_rate, fluid_limiter_settings_t* settings, unsigned int block_size)
 {
     auto lim = new (std::nothrow) Limiter(settings->attack_ms + settings->hold_ms);
     if(lim == nullptr)
@@ -70,13 +70,13 @@ extern "C" fluid_limiter_t *fluid_limiter_impl_new(fluid_real_t sample_rate, flu
     return lim;
 }
 
-extern "C" void fluid_limiter_impl_delete(fluid_limiter_t* lim)
+extern "C" void fluid_limiter_impl_delete(fluid_limiter_impl_t* lim)
 {
     delete(Limiter*)lim;
 }
 
 extern "C" void fluid_limiter_impl_process_buffers(
-    fluid_limiter_t *lim,
+    fluid_limiter_impl_t *lim,
     fluid_real_t *bufs[FLUID_LIMITER_NUM_CHANNELS_AT_ONCE],
     unsigned int block_size)
 {
@@ -0,0 +1,476 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Polyphase sample rate conversion by an arbitrary ratio:
+ *
+ * The lowpass is a Kaiser windowed sinc, passing PASSBAND and stopping
+ * STOPBAND of the lower of both rates. Its length grows with the rate
+ * reduction, the transition band is always as wide relative to the output.
+ * The filter is tabulated for a number of fractional positions between two
+ * input frames, the phases. If both rates are integers with a small enough
+ * ratio L/M, there are exactly L phases and the position of an output frame
+ * always lands on one of them. Otherwise the position is tracked with
+ * INTERP_SHIFT bits below the phase and the coefficients are interpolated
+ * between the two phases surrounding it.
+ *
+ * An output frame at input position p is computed from the taps input frames
+ * p - taps/2 + 1 to p + taps/2, each channel by a dot product with the same
+ * coefficients. The input is kept in a fifo per channel, which starts with
+ * taps/2 - 1 frames of silence, so the first output frame is centered on the
+ * first input frame.
+ */
+
+#include "fluid_out_resampler.h"
+#include "fluid_sys.h"
+
+/* about 72 dB stopband attenuation */
+#define KAISER_BETA 7.0
+#define KAISER_ATTEN 72.0
+
+/* edges of the transition band, relative to the lower rate */
+#define PASSBAND 0.45
+#define STOPBAND 0.5
+
+/* limits of an exact filter table */
+#define MAX_EXACT_PHASES 1024
+#define MAX_TABLE_SIZE (256 * 1024)
+
+/* phases of an interpolated filter table and the position bits below them */
+#define INTERP_PHASES 256
+#define INTERP_SHIFT 16
+
+struct _fluid_out_resampler_t
+{
+    int buf_count;      /* stereo dry buffers, one per audio group */
+    int fx_buf_count;   /* stereo effects buffers */
+    int channels;       /* 2 * (buf_count + fx_buf_count) */
+    int taps;           /* length of the lowpass, a multiple of 8 */
+
+    unsigned int phases;    /* rows of the table, not counting the extra last one */
+    int shift;              /* bits of the position below the phase, 0 if exact */
+    unsigned int den;       /* phases << shift, a whole input frame */
+    unsigned int step;      /* advance of the position per output frame, in 1 / den frames */
+
+    int pos;            /* fifo frame of the first tap of the next output frame */
+    unsigned int frac;  /* and the fraction of a frame to add, 0 <= frac < den */
+    int fifo_len;       /* frames in the fifo of each channel */
+    int fifo_size;
+
+    fluid_real_t *coefs;    /* (phases + 1) * taps, the last row is the first shifted by a frame */
+    fluid_real_t *interp;   /* taps, the coefficients at a position between two phases */
+    fluid_real_t *fifo;     /* channels * fifo_size */
+    int *zeros;             /* per channel, number of silent frames at the end of the fifo */
+    int *silent;            /* per channel, TRUE if the input of the current pull is silent */
+
+    /* the output, in the layout of the mixer buffers */
+    fluid_real_t *bufs;
+    fluid_real_t *left_buf;
+    fluid_real_t *right_buf;
+    fluid_real_t *fx_left_buf;
+    fluid_real_t *fx_right_buf;
+    unsigned char *live;
+};
+
+/* Modified Bessel function of the first kind and order 0 */
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    int k;
+
+    for(k = 1; term > sum * 1e-12; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+    while(b != 0)
+    {
+        unsigned int t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/* Tabulates the lowpass with a cutoff of fc cycles per input frame */
+static void
+fluid_out_resampler_design(fluid_out_resampler_t *rs, double fc)
+{
+    const int taps = rs->taps;
+    const double half = 0.5 * taps;
+    const double i0_beta = bessel_i0(KAISER_BETA);
+    unsigned int q;
+    int j;
+
+    for(q = 0; q <= rs->phases; q++)
+    {
+        fluid_real_t *row = &rs->coefs[q * taps];
+        double sum = 0;
+
+        for(j = 0; j < taps; j++)
+        {
+            double t = half - 1 + (double)q / rs->phases - j;
+            double x = t / half;
+            double w = (x * x < 1.0) ? bessel_i0(KAISER_BETA * sqrt(1.0 - x * x)) / i0_beta : 0.0;
+            double s = (t == 0.0) ? 2.0 * fc : sin(2.0 * M_PI * fc * t) / (M_PI * t);
+
+            row[j] = (fluid_real_t)(w * s);
+            sum += row[j];
+        }
+
+        /* normalizing every phase avoids a ripple at the input rate */
+        for(j = 0; j < taps; j++)
+        {
+            row[j] = (fluid_real_t)(row[j] / sum);
+        }
+    }
+}
+
+/*
+ * Creates a resampler from in_rate to out_rate for buf_count stereo dry
+ * buffers and fx_buf_count stereo effects buffers.
+ */
+fluid_out_resampler_t *
+new_fluid_out_resampler(double in_rate, double out_rate, int buf_count, int fx_buf_count)
+{
+    fluid_out_resampler_t *rs;
+    double ratio = out_rate / in_rate;
+    double r = (ratio < 1.0) ? ratio : 1.0;
+    double frames;
+    int c;
+
+    fluid_return_val_if_fail(in_rate > 0 && out_rate > 0, NULL);
+
+    rs = FLUID_NEW(fluid_out_resampler_t);
+
+    if(rs == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(rs, 0, sizeof(*rs));
+
+    rs->buf_count = buf_count;
+    rs->fx_buf_count = fx_buf_count;
+    rs->channels = 2 * (buf_count + fx_buf_count);
+
+    frames = ceil((KAISER_ATTEN - 8.0) / (2.285 * 2.0 * M_PI * (STOPBAND - PASSBAND) * r));
+    rs->taps = ((int)frames + 7) & ~7;
+
+    if(in_rate == floor(in_rate) && out_rate == floor(out_rate))
+    {
+        unsigned int g = gcd((unsigned int)in_rate, (unsigned int)out_rate);
+
+        rs->phases = (unsigned int)out_rate / g;
+        rs->step = (unsigned int)in_rate / g;
+    }
+
+    if(rs->phases > 0 && rs->phases <= MAX_EXACT_PHASES && (rs->phases + 1) * rs->taps <= MAX_TABLE_SIZE)
+    {
+        rs->shift = 0;
+        rs->den = rs->phases;
+    }
+    else
+    {
+        rs->phases = INTERP_PHASES;
+        rs->shift = INTERP_SHIFT;
+        rs->den = INTERP_PHASES << INTERP_SHIFT;
+        rs->step = (unsigned int)(in_rate / out_rate * rs->den + 0.5);
+    }
+
+    /* the history, the input of a whole mixer run of output and a partially used block */
+    frames = ceil(FLUID_MIXER_FRAMES * in_rate / out_rate);
+    rs->fifo_size = rs->taps + (int)frames + FLUID_BUFSIZE + 1;
+
+    rs->coefs = FLUID_ARRAY(fluid_real_t, (rs->phases + 1) * rs->taps);
+    rs->interp = FLUID_ARRAY(fluid_real_t, rs->taps);
+    rs->fifo = FLUID_ARRAY(fluid_real_t, rs->channels * rs->fifo_size);
+    rs->zeros = FLUID_ARRAY(int, rs->channels);
+    rs->silent = FLUID_ARRAY(int, rs->channels);
+    rs->bufs = FLUID_ARRAY(fluid_real_t, rs->channels * FLUID_MIXER_FRAMES);
+    rs->live = FLUID_ARRAY(unsigned char, 2 * buf_count + fx_buf_count);
+
+    if(rs->coefs == NULL || rs->interp == NULL || rs->fifo == NULL || rs->zeros == NULL
+            || rs->silent == NULL || rs->bufs == NULL || rs->live == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_out_resampler(rs);
+        return NULL;
+    }
+
+    fluid_out_resampler_design(rs, 0.5 * (PASSBAND + STOPBAND) * r);
+
+    rs->left_buf = rs->bufs;
+    rs->right_buf = rs->left_buf + buf_count * FLUID_MIXER_FRAMES;
+    rs->fx_left_buf = rs->right_buf + buf_count * FLUID_MIXER_FRAMES;
+    rs->fx_right_buf = rs->fx_left_buf + fx_buf_count * FLUID_MIXER_FRAMES;
+
+    FLUID_MEMSET(rs->fifo, 0, rs->channels * rs->fifo_size * sizeof(fluid_real_t));
+    FLUID_MEMSET(rs->bufs, 0, rs->channels * FLUID_MIXER_FRAMES * sizeof(fluid_real_t));
+    FLUID_MEMSET(rs->live, FALSE, 2 * buf_count + fx_buf_count);
+    rs->fifo_len = rs->taps / 2 - 1;
+
+    for(c = 0; c < rs->channels; c++)
+    {
+        rs->zeros[c] = rs->fifo_len;
+    }
+
+    FLUID_LOG(FLUID_DBG, "Resampling from %.0f Hz to %.0f Hz with %d taps and %u %s phases",
+              in_rate, out_rate, rs->taps, rs->phases, rs->shift ? "interpolated" : "exact");
+
+    return rs;
+}
+
+void delete_fluid_out_resampler(fluid_out_resampler_t *rs)
+{
+    fluid_return_if_fail(rs != NULL);
+
+    FLUID_FREE(rs->coefs);
+    FLUID_FREE(rs->interp);
+    FLUID_FREE(rs->fifo);
+    FLUID_FREE(rs->zeros);
+    FLUID_FREE(rs->silent);
+    FLUID_FREE(rs->bufs);
+    FLUID_FREE(rs->live);
+    FLUID_FREE(rs);
+}
+
+/* Returns buffer c of the four mixer style buffers, counting left and right of each */
+static FLUID_INLINE fluid_real_t *
+fluid_out_resampler_chan(const fluid_out_resampler_t *rs, int c,
+                         fluid_real_t *left, fluid_real_t *right,
+                         fluid_real_t *fx_left, fluid_real_t *fx_right)
+{
+    if(c < 2 * rs->buf_count)
+    {
+        return ((c & 1) ? right : left) + (c >> 1) * FLUID_MIXER_FRAMES;
+    }
+
+    c -= 2 * rs->buf_count;
+    return ((c & 1) ? fx_right : fx_left) + (c >> 1) * FLUID_MIXER_FRAMES;
+}
+
+/* Same for the buffers pushed to the resampler */
+static FLUID_INLINE const fluid_real_t *
+fluid_out_resampler_const_chan(const fluid_out_resampler_t *rs, int c,
+                               const fluid_real_t *left, const fluid_real_t *right,
+                               const fluid_real_t *fx_left, const fluid_real_t *fx_right)
+{
+    if(c < 2 * rs->buf_count)
+    {
+        return ((c & 1) ? right : left) + (c >> 1) * FLUID_MIXER_FRAMES;
+    }
+
+    c -= 2 * rs->buf_count;
+    return ((c & 1) ? fx_right : fx_left) + (c >> 1) * FLUID_MIXER_FRAMES;
+}
+
+/* Index of the live flag of channel c, the effects buffers share one for left and right */
+static FLUID_INLINE int
+fluid_out_resampler_live_idx(const fluid_out_resampler_t *rs, int c)
+{
+    return (c < 2 * rs->buf_count) ? c : 2 * rs->buf_count + ((c - 2 * rs->buf_count) >> 1);
+}
+
+/*
+ * Returns how many more input frames fluid_out_resampler_push() has to get
+ * before count output frames can be pulled, 0 if there are enough.
+ */
+int fluid_out_resampler_get_needed(const fluid_out_resampler_t *rs, int count)
+{
+    fluid_long_long_t last;
+    int needed;
+
+    fluid_clip(count, 1, FLUID_MIXER_FRAMES);
+
+    last = rs->pos + ((fluid_long_long_t)rs->frac + (fluid_long_long_t)(count - 1) * rs->step) / rs->den;
+    needed = (int)(last + rs->taps - rs->fifo_len);
+
+    return (needed > 0) ? needed : 0;
+}
+
+/*
+ * Appends count frames of the mixer buffers to the input. The buffers that
+ * aren't live are taken as silent without looking at them.
+ */
+void fluid_out_resampler_push(fluid_out_resampler_t *rs,
+                              const fluid_real_t *left, const fluid_real_t *right,
+                              const fluid_real_t *fx_left, const fluid_real_t *fx_right,
+                              const unsigned char *live, int count)
+{
+    int c, k;
+
+    /* can't happen as long as no more than needed is pushed, rounded up to a block */
+    if(count > rs->fifo_size - rs->fifo_len)
+    {
+        count = rs->fifo_size - rs->fifo_len;
+    }
+
+    for(c = 0; c < rs->channels; c++)
+    {
+        fluid_real_t *dst = &rs->fifo[c * rs->fifo_size + rs->fifo_len];
+        const fluid_real_t *src = fluid_out_resampler_const_chan(rs, c, left, right, fx_left, fx_right);
+
+        if(!live[fluid_out_resampler_live_idx(rs, c)])
+        {
+            FLUID_MEMSET(dst, 0, count * sizeof(fluid_real_t));
+            rs->zeros[c] += count;
+            continue;
+        }
+
+        FLUID_MEMCPY(dst, src, count * sizeof(fluid_real_t));
+
+        for(k = count; k > 0 && src[k - 1] == 0; k--)
+        {
+        }
+
+        rs->zeros[c] = (k > 0) ? count - k : rs->zeros[c] + count;
+    }
+
+    rs->fifo_len += count;
+}
+
+/*
+ * Computes count output frames into the output buffers, count must not exceed
+ * FLUID_MIXER_FRAMES. Channels without any sound in the input used are
+ * cleared and flagged as not live instead.
+ */
+void fluid_out_resampler_pull(fluid_out_resampler_t *rs, int count)
+{
+    const int taps = rs->taps;
+    const unsigned int mask = (1U << rs->shift) - 1;
+    const fluid_real_t scale = (fluid_real_t)1.0 / (1 << rs->shift);
+    int c, n, j;
+
+    fluid_clip(count, 0, FLUID_MIXER_FRAMES);
+    FLUID_MEMSET(rs->live, FALSE, 2 * rs->buf_count + rs->fx_buf_count);
+
+    for(c = 0; c < rs->channels; c++)
+    {
+        rs->silent[c] = rs->zeros[c] >= rs->fifo_len - rs->pos;
+
+        if(rs->silent[c])
+        {
+            FLUID_MEMSET(fluid_out_resampler_chan(rs, c, rs->left_buf, rs->right_buf, rs->fx_left_buf, rs->fx_right_buf),
+                         0, count * sizeof(fluid_real_t));
+        }
+        else
+        {
+            rs->live[fluid_out_resampler_live_idx(rs, c)] = TRUE;
+        }
+    }
+
+    for(n = 0; n < count; n++)
+    {
+        const fluid_real_t *h;
+
+        if(rs->shift == 0)
+        {
+            h = &rs->coefs[rs->frac * taps];
+        }
+        else
+        {
+            const fluid_real_t *h0 = &rs->coefs[(rs->frac >> rs->shift) * taps];
+            const fluid_real_t *h1 = h0 + taps;
+            fluid_real_t a = (rs->frac & mask) * scale;
+
+            #pragma omp simd
+            for(j = 0; j < taps; j++)
+            {
+                rs->interp[j] = h0[j] + a * (h1[j] - h0[j]);
+            }
+
+            h = rs->interp;
+        }
+
+        for(c = 0; c < rs->channels; c++)
+        {
+            const fluid_real_t *x = &rs->fifo[c * rs->fifo_size + rs->pos];
+            fluid_real_t sum = 0;
+
+            if(rs->silent[c])
+            {
+                continue;
+            }
+
+            #pragma omp simd reduction(+:sum)
+            for(j = 0; j < taps; j++)
+            {
+                sum += h[j] * x[j];
+            }
+
+            fluid_out_resampler_chan(rs, c, rs->left_buf, rs->right_buf, rs->fx_left_buf, rs->fx_right_buf)[n] = sum;
+        }
+
+        rs->frac += rs->step;
+        rs->pos += rs->frac / rs->den;
+        rs->frac %= rs->den;
+    }
+
+    /* drop the input no further output frame needs */
+    if(rs->pos > 0)
+    {
+        rs->fifo_len -= rs->pos;
+
+        for(c = 0; c < rs->channels; c++)
+        {
+            fluid_real_t *fifo = &rs->fifo[c * rs->fifo_size];
+
+            FLUID_MEMMOVE(fifo, &fifo[rs->pos], rs->fifo_len * sizeof(fluid_real_t));
+
+            if(rs->zeros[c] > rs->fifo_len)
+            {
+                rs->zeros[c] = rs->fifo_len;
+            }
+        }
+
+        rs->pos = 0;
+    }
+}
+
+/* Like fluid_rvoice_mixer_get_bufs(), for the output of the last pull */
+int fluid_out_resampler_get_bufs(fluid_out_resampler_t *rs, fluid_real_t **left, fluid_real_t **right)
+{
+    *left = rs->left_buf;
+    *right = rs->right_buf;
+    return rs->buf_count;
+}
+
+/* Like fluid_rvoice_mixer_get_fx_bufs(), for the output of the last pull */
+int fluid_out_resampler_get_fx_bufs(fluid_out_resampler_t *rs, fluid_real_t **fx_left, fluid_real_t **fx_right)
+{
+    *fx_left = rs->fx_left_buf;
+    *fx_right = rs->fx_right_buf;
+    return rs->fx_buf_count;
+}
+
+/* Like fluid_rvoice_mixer_get_live_bufs(), for the output of the last pull */
+const unsigned char *fluid_out_resampler_get_live_bufs(fluid_out_resampler_t *rs)
+{
+    return rs->live;
+}
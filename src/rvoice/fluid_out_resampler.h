@@ -0,0 +1,67 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLUID_OUT_RESAMPLER_H
+#define _FLUID_OUT_RESAMPLER_H
+
+#include "fluidsynth_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Converts the output of the mixer from the rate the voices are rendered at to
+ * the rate of the audio device, see synth.render-rate. It takes and provides
+ * the dry and effects buffers in the layout of fluid_rvoice_mixer_get_bufs()
+ * and fluid_rvoice_mixer_get_fx_bufs(), so the synth can hand out either.
+ *
+ * Output of count frames is produced by:
+ *
+ *     while((needed = fluid_out_resampler_get_needed(rs, count)) > 0)
+ *     {
+ *         render at most needed frames into the mixer buffers
+ *         fluid_out_resampler_push(rs, left, right, fx_left, fx_right, live, rendered);
+ *     }
+ *
+ *     fluid_out_resampler_pull(rs, count);
+ *
+ * Creating a resampler isn't realtime safe, everything else is.
+ */
+typedef struct _fluid_out_resampler_t fluid_out_resampler_t;
+
+fluid_out_resampler_t *new_fluid_out_resampler(double in_rate, double out_rate, int buf_count, int fx_buf_count);
+void delete_fluid_out_resampler(fluid_out_resampler_t *rs);
+
+int fluid_out_resampler_get_needed(const fluid_out_resampler_t *rs, int count);
+void fluid_out_resampler_push(fluid_out_resampler_t *rs,
+                              const fluid_real_t *left, const fluid_real_t *right,
+                              const fluid_real_t *fx_left, const fluid_real_t *fx_right,
+                              const unsigned char *live, int count);
+void fluid_out_resampler_pull(fluid_out_resampler_t *rs, int count);
+
+int fluid_out_resampler_get_bufs(fluid_out_resampler_t *rs, fluid_real_t **left, fluid_real_t **right);
+int fluid_out_resampler_get_fx_bufs(fluid_out_resampler_t *rs, fluid_real_t **fx_left, fluid_real_t **fx_right);
+const unsigned char *fluid_out_resampler_get_live_bufs(fluid_out_resampler_t *rs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_OUT_RESAMPLER_H */
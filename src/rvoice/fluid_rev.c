@@ -325,214 +325,156 @@ a flatter response on comb filter. So the input gain is set to 0.1 rather 1.0. *
 
 
 /*-----------------------------------------------------------------------------
- Delay absorbent low pass filter
+ Modulated delay lines.
+ Each line is composed of:
+ - the delay line with its damping low pass filter.
+ - the sinusoidal modulator.
+ - center output position modulated by the modulator.
+ - variable rate control of center output position.
+ - first order All-Pass interpolator.
+
+ The lines are independent of each other within one sample step, so their
+ state is kept in a structure of arrays, one element per line, which lets
+ the compiler process all lines at once with SIMD instructions. The sample
+ buffers of all lines are allocated in one block.
 -----------------------------------------------------------------------------*/
 typedef struct
 {
-    fluid_real_t buffer;
-    fluid_real_t b0, a1;         /* filter coefficients */
-} fdn_delay_lpf;
+    /* delay lines members */
+    fluid_real_t *buffer;          /* sample buffers of all lines */
+    int offset[NBR_DELAYS];        /* start of each line in buffer */
+    int size[NBR_DELAYS];          /* effective internal size (in samples) */
+    /*-------------*/
+    int line_in[NBR_DELAYS];       /* line in position */
+    int line_out[NBR_DELAYS];      /* line out position */
+    /*-------------*/
+    /* damping low pass filter members */
+    fluid_real_t damping_buffer[NBR_DELAYS];
+    fluid_real_t damping_b0[NBR_DELAYS], damping_a1[NBR_DELAYS]; /* filter coefficients */
+    /*---------------------------*/
+    /* Sinusoidal modulator members */
+    fluid_real_t mod_a1[NBR_DELAYS];            /* Coefficient: a1 = 2 * cos(w) */
+    fluid_real_t mod_buffer1[NBR_DELAYS];       /* buffer1 */
+    fluid_real_t mod_buffer2[NBR_DELAYS];       /* buffer2 */
+    fluid_real_t mod_reset_buffer2[NBR_DELAYS]; /* reset value of buffer2 */
+    /*-------------------------*/
+    /* center output position members */
+    fluid_real_t center_pos_mod[NBR_DELAYS]; /* center output position modulated by modulator */
+    int mod_depth[NBR_DELAYS];               /* modulation depth (in samples) */
+    /*-------------------------*/
+    /* variable rate control of center output position, the same for all lines */
+    int index_rate;  /* index rate to know when to update center_pos_mod */
+    int mod_rate;    /* rate at which center_pos_mod is updated */
+    /*-------------------------*/
+    /* first order All-Pass interpolator members */
+    fluid_real_t frac_pos_mod[NBR_DELAYS]; /* fractional position part between samples) */
+    /* previous value used when interpolating using fractional */
+    fluid_real_t interp_buffer[NBR_DELAYS];
+} mod_delay_lines;
 
 /*-----------------------------------------------------------------------------
  Sets coefficients for delay absorbent low pass filter.
- @param lpf pointer on low pass filter structure.
+ @param mdl pointer on modulated delay lines structure.
+ @param i index of the line.
  @param b0,a1 coefficients.
 -----------------------------------------------------------------------------*/
-static void set_fdn_delay_lpf(fdn_delay_lpf *lpf,
+static void set_fdn_delay_lpf(mod_delay_lines *mdl, int i,
                               fluid_real_t b0, fluid_real_t  a1)
 {
-    lpf->b0 = b0;
-    lpf->a1 = a1;
+    mdl->damping_b0[i] = b0;
+    mdl->damping_a1[i] = a1;
 }
 
-/*-----------------------------------------------------------------------------
- Process delay absorbent low pass filter.
- @param mod_delay modulated delay line.
- @param in, input sample.
- @param out output sample.
------------------------------------------------------------------------------*/
-/* process low pass damping filter (input, output, delay) */
-#define process_damping_filter(in,out,mod_delay) \
-{\
-    out = in * mod_delay->dl.damping.b0 - mod_delay->dl.damping.buffer * \
-                                            mod_delay->dl.damping.a1;\
-    mod_delay->dl.damping.buffer = out;\
-}\
-
-
-/*-----------------------------------------------------------------------------
- Delay line :
- The delay line is composed of the line plus an absorbent low pass filter
- to get frequency dependent reverb time.
------------------------------------------------------------------------------*/
-typedef struct
-{
-    fluid_real_t *line; /* buffer line */
-    int   size;         /* effective internal size (in samples) */
-    /*-------------*/
-    int line_in;  /* line in position */
-    int line_out; /* line out position */
-    /*-------------*/
-    fdn_delay_lpf damping; /* damping low pass filter */
-} delay_line;
-
-
 /*-----------------------------------------------------------------------------
  Clears a delay line to DC_OFFSET float value.
- @param dl pointer on delay line structure
+ @param mdl pointer on modulated delay lines structure.
+ @param i index of the line.
 -----------------------------------------------------------------------------*/
-static void clear_delay_line(delay_line *dl)
+static void clear_delay_line(mod_delay_lines *mdl, int i)
 {
-    int i;
+    fluid_real_t *line = &mdl->buffer[mdl->offset[i]];
+    int k;
 
-    for(i = 0; i < dl->size; i++)
+    for(k = 0; k < mdl->size[i]; k++)
     {
-        dl->line[i] = DC_OFFSET;
+        line[k] = DC_OFFSET;
     }
 }
 
-/*-----------------------------------------------------------------------------
- Push a sample val into the delay line
------------------------------------------------------------------------------*/
-#define push_in_delay_line(dl, val) \
-{\
-    dl->line[dl->line_in] = val;\
-    /* Incrementation and circular motion if necessary */\
-    if(++dl->line_in >= dl->size) dl->line_in -= dl->size;\
-}\
-
-/*-----------------------------------------------------------------------------
- Modulator for modulated delay line
------------------------------------------------------------------------------*/
-
-/*-----------------------------------------------------------------------------
- Sinusoidal modulator
------------------------------------------------------------------------------*/
-/* modulator are integrated in modulated delay line */
-typedef struct
-{
-    fluid_real_t   a1;          /* Coefficient: a1 = 2 * cos(w) */
-    fluid_real_t   buffer1;     /* buffer1 */
-    fluid_real_t   buffer2;     /* buffer2 */
-    fluid_real_t   reset_buffer2;/* reset value of buffer2 */
-} sinus_modulator;
-
 /*-----------------------------------------------------------------------------
  Sets the frequency of sinus oscillator.
 
- @param mod pointer on modulator structure.
+ @param mdl pointer on modulated delay lines structure.
+ @param i index of the line whose modulator is set.
  @param freq frequency of the oscillator in Hz.
  @param sample_rate sample rate on audio output in Hz.
  @param phase initial phase of the oscillator in degree (0 to 360).
 -----------------------------------------------------------------------------*/
-static void set_mod_frequency(sinus_modulator *mod,
+static void set_mod_frequency(mod_delay_lines *mdl, int i,
                               float freq, float sample_rate, float phase)
 {
     fluid_real_t w = 2 * FLUID_M_PI * freq / sample_rate; /* initial angle */
     fluid_real_t a;
 
-    mod->a1 = 2 * FLUID_COS(w);
+    mdl->mod_a1[i] = 2 * FLUID_COS(w);
 
     a = (2 * FLUID_M_PI / 360) * phase;
 
-    mod->buffer2 = FLUID_SIN(a - w); /* y(n-1) = sin(-initial angle) */
-    mod->buffer1 = FLUID_SIN(a); /* y(n) = sin(initial phase) */
-    mod->reset_buffer2 = FLUID_SIN(FLUID_M_PI / 2 - w); /* reset value for PI/2 */
+    mdl->mod_buffer2[i] = FLUID_SIN(a - w); /* y(n-1) = sin(-initial angle) */
+    mdl->mod_buffer1[i] = FLUID_SIN(a); /* y(n) = sin(initial phase) */
+    mdl->mod_reset_buffer2[i] = FLUID_SIN(FLUID_M_PI / 2 - w); /* reset value for PI/2 */
 }
 
 /*-----------------------------------------------------------------------------
- Gets current value of sinus modulator:
-   y(n) = a1 . y(n-1)  -  y(n-2)
-   out = a1 . buffer1  -  buffer2
+ Return norminal delay length
 
- @param pointer on modulator structure.
- @return current value of the modulator sine wave.
+ @param mdl, pointer on modulated delay lines structure.
+ @param i index of the line.
 -----------------------------------------------------------------------------*/
-static FLUID_INLINE fluid_real_t get_mod_sinus(sinus_modulator *mod)
+static int get_mod_delay_line_length(mod_delay_lines *mdl, int i)
 {
-    fluid_real_t out;
-    out = mod->a1 * mod->buffer1 - mod->buffer2;
-    mod->buffer2 = mod->buffer1;
-
-    if(out >= 1.0f) /* reset in case of instability near PI/2 */
-    {
-        out = 1.0f; /* forces output to the right value */
-        mod->buffer2 = mod->reset_buffer2;
-    }
-
-    if(out <= -1.0f) /* reset in case of instability near -PI/2 */
-    {
-        out = -1.0f; /* forces output to the right value */
-        mod->buffer2 = - mod->reset_buffer2;
-    }
-
-    mod->buffer1 = out;
-    return  out;
+    return (mdl->size[i] - mdl->mod_depth[i] - INTERP_SAMPLES_NBR);
 }
 
 /*-----------------------------------------------------------------------------
- Modulated delay line. The line is composed of:
- - the delay line with its damping low pass filter.
- - the sinusoidal modulator.
- - center output position modulated by the modulator.
- - variable rate control of center output position.
- - first order All-Pass interpolator.
------------------------------------------------------------------------------*/
-typedef struct
-{
-    /* delay line with damping low pass filter member */
-    delay_line dl; /* delayed line */
-    /*---------------------------*/
-    /* Sinusoidal modulator member */
-    sinus_modulator mod; /* sinus modulator */
-    /*-------------------------*/
-    /* center output position members */
-    fluid_real_t  center_pos_mod; /* center output position modulated by modulator */
-    int          mod_depth;   /* modulation depth (in samples) */
-    /*-------------------------*/
-    /* variable rate control of center output position */
-    int index_rate;  /* index rate to know when to update center_pos_mod */
-    int mod_rate;    /* rate at which center_pos_mod is updated */
-    /*-------------------------*/
-    /* first order All-Pass interpolator members */
-    fluid_real_t  frac_pos_mod; /* fractional position part between samples) */
-    /* previous value used when interpolating using fractional */
-    fluid_real_t  buffer;
-} mod_delay_line;
+ Updates the modulated read positions of all lines (every mod_rate samples).
 
-/*-----------------------------------------------------------------------------
- Return norminal delay length
+ The modulators are sinus oscillators:
+   y(n) = a1 . y(n-1)  -  y(n-2)
+   out = a1 . buffer1  -  buffer2
 
- @param mdl, pointer on modulated delay line.
+ @param mdl, pointer on modulated delay lines structure.
 -----------------------------------------------------------------------------*/
-static int get_mod_delay_line_length(mod_delay_line *mdl)
+static FLUID_INLINE void update_mod_delay_positions(mod_delay_lines *mdl)
 {
-    return (mdl->dl.size - mdl->mod_depth - INTERP_SAMPLES_NBR);
-}
+    int i;
 
-/*-----------------------------------------------------------------------------
- Reads the sample value out of the modulated delay line.
- @param mdl, pointer on modulated delay line.
- @return the sample value.
------------------------------------------------------------------------------*/
-static FLUID_INLINE fluid_real_t get_mod_delay(mod_delay_line *mdl)
-{
-    fluid_real_t out_index;  /* new modulated index position */
-    int int_out_index; /* integer part of out_index */
-    fluid_real_t out; /* value to return */
+    #pragma omp simd
+    for(i = 0; i < NBR_DELAYS; i++)
+    {
+        fluid_real_t mod_out;     /* current value of the modulator sine wave */
+        fluid_real_t out_index;   /* new modulated index position */
+        int int_out_index;        /* integer part of out_index */
 
-    /* Checks if the modulator must be updated (every mod_rate samples). */
-    /* Important: center_pos_mod must be used immediately for the
-       first sample. So, mdl->index_rate must be initialized
-       to mdl->mod_rate (set_mod_delay_line())  */
+        mod_out = mdl->mod_a1[i] * mdl->mod_buffer1[i] - mdl->mod_buffer2[i];
+        mdl->mod_buffer2[i] = mdl->mod_buffer1[i];
 
-    if(++mdl->index_rate >= mdl->mod_rate)
-    {
-        mdl->index_rate = 0;
+        if(mod_out >= 1.0f) /* reset in case of instability near PI/2 */
+        {
+            mod_out = 1.0f; /* forces output to the right value */
+            mdl->mod_buffer2[i] = mdl->mod_reset_buffer2[i];
+        }
+
+        if(mod_out <= -1.0f) /* reset in case of instability near -PI/2 */
+        {
+            mod_out = -1.0f; /* forces output to the right value */
+            mdl->mod_buffer2[i] = - mdl->mod_reset_buffer2[i];
+        }
+
+        mdl->mod_buffer1[i] = mod_out;
 
         /* out_index = center position (center_pos_mod) + sinus waweform */
-        out_index = mdl->center_pos_mod +
-                    get_mod_sinus(&mdl->mod) * mdl->mod_depth;
+        out_index = mdl->center_pos_mod[i] + mod_out * mdl->mod_depth[i];
 
         /* extracts integer part in int_out_index */
         if(out_index >= 0.0f)
@@ -541,50 +483,30 @@ static FLUID_INLINE fluid_real_t get_mod_delay(mod_delay_line *mdl)
 
             /* forces read index (line_out)  with integer modulation value  */
             /* Boundary check and circular motion as needed */
-            if((mdl->dl.line_out = int_out_index) >= mdl->dl.size)
-            {
-                mdl->dl.line_out -= mdl->dl.size;
-            }
+            mdl->line_out[i] = (int_out_index >= mdl->size[i]) ? int_out_index - mdl->size[i] : int_out_index;
         }
         else /* negative */
         {
             int_out_index = (int)(out_index - 1); /* previous integer part */
             /* forces read index (line_out) with integer modulation value  */
             /* circular motion as needed */
-            mdl->dl.line_out   = int_out_index + mdl->dl.size;
+            mdl->line_out[i] = int_out_index + mdl->size[i];
         }
 
         /* extracts fractionnal part. (it will be used when interpolating
           between line_out and line_out +1) and memorize it.
           Memorizing is necessary for modulation rate above 1 */
-        mdl->frac_pos_mod = out_index - int_out_index;
+        mdl->frac_pos_mod[i] = out_index - int_out_index;
 
         /* updates center position (center_pos_mod) to the next position
            specified by modulation rate */
-        if((mdl->center_pos_mod += mdl->mod_rate) >= mdl->dl.size)
+        mdl->center_pos_mod[i] += mdl->mod_rate;
+
+        if(mdl->center_pos_mod[i] >= mdl->size[i])
         {
-            mdl->center_pos_mod -= mdl->dl.size;
+            mdl->center_pos_mod[i] -= mdl->size[i];
         }
     }
-
-    /*  First order all-pass interpolation ----------------------------------*/
-    /* https://ccrma.stanford.edu/~jos/pasp/First_Order_Allpass_Interpolation.html */
-    /*  begins interpolation: read current sample */
-    out = mdl->dl.line[mdl->dl.line_out];
-
-    /* updates line_out to the next sample.
-       Boundary check and circular motion as needed */
-    if(++mdl->dl.line_out >= mdl->dl.size)
-    {
-        mdl->dl.line_out -= mdl->dl.size;
-    }
-
-    /* Fractional interpolation between next sample (at next position) and
-       previous output added to current sample.
-    */
-    out += mdl->frac_pos_mod * (mdl->dl.line[mdl->dl.line_out] - mdl->buffer);
-    mdl->buffer = out; /* memorizes current output */
-    return out;
 }
 
 /*-----------------------------------------------------------------------------
@@ -598,7 +520,7 @@ struct _fluid_late
     fluid_real_t tone_buffer;
     fluid_real_t b1, b2;
     /*----- Modulated delay lines lines ----------------------------------*/
-    mod_delay_line mod_delay_lines[NBR_DELAYS];
+    mod_delay_lines lines;
     /*-----------------------------------------------------------------------*/
     /* Output coefficients for separate Left and right stereo outputs */
     fluid_real_t out_left_gain[NBR_DELAYS]; /* Left delay lines' output gains */
@@ -656,7 +578,7 @@ static void update_rev_time_damping(fluid_late *late,
               Computes dc_rev_time
         ------------------------------------------*/
         dc_rev_time = GET_DC_REV_TIME(roomsize);
-        delay_length = get_mod_delay_line_length(&late->mod_delay_lines[NBR_DELAYS - 1]);
+        delay_length = get_mod_delay_line_length(&late->lines, NBR_DELAYS - 1);
         /* computes gi_tmp from dc_rev_time using relation E2 */
         gi_tmp = FLUID_POW(10, -3 * delay_length *
                            sample_period / dc_rev_time); /* E2 */
@@ -672,7 +594,7 @@ static void update_rev_time_damping(fluid_late *late,
 
             /* values gi_min et gi_max are computed using E2 for the line with
               maximum delay */
-            delay_length = get_mod_delay_line_length(&late->mod_delay_lines[NBR_DELAYS - 1]);
+            delay_length = get_mod_delay_line_length(&late->lines, NBR_DELAYS - 1);
             gi_max = FLUID_POW(10, (-3 * delay_length / MAX_DC_REV_TIME) *
                                     sample_period); /* E2 */
             gi_min = FLUID_POW(10, (-3 * delay_length / MIN_DC_REV_TIME) *
@@ -715,7 +637,7 @@ static void update_rev_time_damping(fluid_late *late,
         fluid_real_t gi, ai;
 
         /* delay length */
-        delay_length = get_mod_delay_line_length(&late->mod_delay_lines[i]);
+        delay_length = get_mod_delay_line_length(&late->lines, i);
 
         /* iir low pass filter gain */
         gi = FLUID_POW(10, -3 * delay_length * sample_period / dc_rev_time);
@@ -724,8 +646,7 @@ static void update_rev_time_damping(fluid_late *late,
         ai = (20.f / 80.f) * FLUID_LOGF(gi) * (1.f - 1.f / alpha2);
 
         /* b0 = gi * (1 - ai),  a1 = - ai */
-        set_fdn_delay_lpf(&late->mod_delay_lines[i].dl.damping,
-                          gi * (1.f - ai), -ai);
+        set_fdn_delay_lpf(&late->lines, i, gi * (1.f - ai), -ai);
     }
 }
 
@@ -786,14 +707,10 @@ static void update_stereo_coefficient(fluid_late *late, fluid_real_t wet1)
 -----------------------------------------------------------------------------*/
 static void delete_fluid_rev_late(fluid_late *late)
 {
-    int i;
     fluid_return_if_fail(late != NULL);
 
     /* free the delay lines */
-    for(i = 0; i < NBR_DELAYS; i++)
-    {
-        FLUID_FREE(late->mod_delay_lines[i].dl.line);
-    }
+    FLUID_FREE(late->lines.buffer);
 }
 
 
@@ -852,6 +769,8 @@ static int create_mod_delay_lines(fluid_late *late,
                                   fluid_real_t sample_rate_max)
 {
     int i;
+    int total_size = 0;   /* size of all lines (in samples) */
+    mod_delay_lines *mdl = &late->lines;
 
     fluid_real_t mod_depth, length_factor;
 
@@ -883,11 +802,11 @@ static int create_mod_delay_lines(fluid_late *late,
     for(i = 0; i < NBR_DELAYS; i++) /* for each delay line */
     {
         int delay_length = nom_delay_length[i] * length_factor;
-        mod_delay_line *mdl = &late->mod_delay_lines[i];
 
         /*-------------------------------------------------------------------*/
-        /* checks parameter */
-        if(delay_length < 1)
+        /* checks parameter, the lines must delay by more than one block
+           (see process_late_block()) */
+        if(delay_length - mod_depth <= FLUID_BUFSIZE + INTERP_SAMPLES_NBR)
         {
             return FLUID_FAILED;
         }
@@ -900,20 +819,23 @@ static int create_mod_delay_lines(fluid_late *late,
             mod_depth = delay_length - 1;
         }
 
-        /*---------------------------------------------------------------------
-         allocates delay lines
-        */
-
         /* real size of the line in use (in samples):
         size = INTERP_SAMPLES_NBR + mod_depth + delay_length */
-        mdl->dl.size = delay_length + mod_depth + INTERP_SAMPLES_NBR;
-        mdl->dl.line = FLUID_ARRAY(fluid_real_t, mdl->dl.size);
+        mdl->size[i] = delay_length + mod_depth + INTERP_SAMPLES_NBR;
+        mdl->offset[i] = total_size;
+        total_size += mdl->size[i];
+    }
 
-        if(! mdl->dl.line)
-        {
-            return FLUID_FAILED;
-        }
+    /*---------------------------------------------------------------------
+     allocates delay lines
+    */
+    mdl->buffer = FLUID_ARRAY(fluid_real_t, total_size);
+
+    if(! mdl->buffer)
+    {
+        return FLUID_FAILED;
     }
+
     return FLUID_OK;
 }
 
@@ -927,6 +849,7 @@ static void initialize_mod_delay_lines(fluid_late *late, fluid_real_t sample_rat
 {
     int i;
     fluid_real_t mod_depth, length_factor;
+    mod_delay_lines *mdl = &late->lines;
 
     /* update delay line parameter dependent of sample rate */
     late->samplerate = sample_rate;
@@ -936,7 +859,6 @@ static void initialize_mod_delay_lines(fluid_late *late, fluid_real_t sample_rat
 
     for(i = 0; i < NBR_DELAYS; i++) /* for each delay line */
     {
-        mod_delay_line *mdl = &late->mod_delay_lines[i];
         int delay_length = nom_delay_length[i] * length_factor;
 
         /* limits mod_depth to the requested delay length */
@@ -945,88 +867,85 @@ static void initialize_mod_delay_lines(fluid_late *late, fluid_real_t sample_rat
             mod_depth = delay_length - 1;
         }
 
-        mdl->mod_depth = mod_depth;
+        mdl->mod_depth[i] = mod_depth;
 
-        clear_delay_line(&mdl->dl); /* clears the buffer */
+        clear_delay_line(mdl, i); /* clears the buffer */
 
         /* Initializes line_in to the start of the buffer */
-        mdl->dl.line_in = 0;
+        mdl->line_in[i] = 0;
 
         /* Initializes line_out index INTERP_SAMPLES_NBR samples after
            line_in so that the delay between line_out and line_in is:
            mod_depth + delay_length
         */
-        mdl->dl.line_out = mdl->dl.line_in + INTERP_SAMPLES_NBR;
+        mdl->line_out[i] = mdl->line_in[i] + INTERP_SAMPLES_NBR;
 
         /* Damping low pass filter ------------------------------------------*/
-        mdl->dl.damping.buffer = 0;
+        mdl->damping_buffer[i] = 0;
 
         /*---------------------------------------------------------------------
          Initializes modulation members:
          - modulated center position: center_pos_mod
-         - modulation rate (the speed at which center_pos_mod is modulated: mod_rate
-         - index rate to know when to update center_pos_mod:index_rate
          - interpolator member: buffer, frac_pos_mod
         ---------------------------------------------------------------------*/
         /* Initializes the modulated center position (center_pos_mod) so that:
            - the delay between line_out and center_pos_mod is mod_depth.
            - the delay between center_pos_mod and line_in is delay_length.
         */
-        mdl->center_pos_mod = (fluid_real_t) INTERP_SAMPLES_NBR + mod_depth;
-
-        /* Sets the modulation rate. This rate defines how often
-           the  center position (center_pos_mod ) is modulated .
-           The value is expressed in samples. The default value is 1 that means that
-           center_pos_mod is updated at every sample.
-           For example with a value of 2, the center position position will be
-           updated only one time every 2 samples only.
-        */
-        if(MOD_RATE < 1 || MOD_RATE > mdl->dl.size)
-        {
-            FLUID_LOG(FLUID_INFO, "fdn reverb: modulation rate is out of range");
-            mdl->mod_rate = 1; /* default modulation rate: every one sample */
-        }
-        else
-        {
-            mdl->mod_rate = MOD_RATE;
-        }
-
-        /* index rate to control when to update center_pos_mod.
-           Important: must be set to get center_pos_mod immediately used for
-           the reading of first sample (see get_mod_delay())
-        */
-        mdl->index_rate = mdl->mod_rate;
+        mdl->center_pos_mod[i] = (fluid_real_t) INTERP_SAMPLES_NBR + mod_depth;
 
         /* initializes first order All-Pass interpolator members */
-        mdl->buffer = 0;       /* previous delay sample value */
-        mdl->frac_pos_mod = 0; /* frac. position (between consecutives sample) */
+        mdl->interp_buffer[i] = 0; /* previous delay sample value */
+        mdl->frac_pos_mod[i] = 0;  /* frac. position (between consecutives sample) */
 
 
         /* Sets local Modulators parameters: frequency and phase.
            Each modulateur are shifted of MOD_PHASE degree
         */
-        set_mod_frequency(&mdl->mod,
+        set_mod_frequency(mdl, i,
                           MOD_FREQ * MOD_RATE,
                           sample_rate,
                           (float)(MOD_PHASE * i));
     }
+
+    /* Sets the modulation rate. This rate defines how often
+       the  center position (center_pos_mod ) is modulated .
+       The value is expressed in samples. The default value is 1 that means that
+       center_pos_mod is updated at every sample.
+       For example with a value of 2, the center position position will be
+       updated only one time every 2 samples only.
+       The rate is the same for all lines, the first line is the shortest one.
+    */
+    if(MOD_RATE < 1 || MOD_RATE > mdl->size[0])
+    {
+        FLUID_LOG(FLUID_INFO, "fdn reverb: modulation rate is out of range");
+        mdl->mod_rate = 1; /* default modulation rate: every one sample */
+    }
+    else
+    {
+        mdl->mod_rate = MOD_RATE;
+    }
+
+    /* index rate to control when to update center_pos_mod.
+       Important: must be set to get center_pos_mod immediately used for
+       the reading of first sample (see process_late_block())
+    */
+    mdl->index_rate = mdl->mod_rate;
 }
 
 /*
- Clears the delay lines.
+ Clears the delay lines and the tone corrector, and restarts the modulators,
+ so that the reverb continues exactly like a new one.
 
  @param rev pointer on the reverb.
 */
 static void
 fluid_revmodel_init(fluid_revmodel_t *rev)
 {
-    int i;
+    /* clears all the delay lines and restarts their modulators */
+    initialize_mod_delay_lines(&rev->late, rev->late.samplerate);
 
-    /* clears all the delay lines */
-    for(i = 0; i < NBR_DELAYS; i ++)
-    {
-        clear_delay_line(&rev->late.mod_delay_lines[i].dl);
-    }
+    rev->late.tone_buffer = 0.0f;
 }
 
 
@@ -1267,7 +1186,8 @@ fluid_revmodel_samplerate_change(fluid_revmodel_t *rev, fluid_real_t sample_rate
 }
 
 /*
-* Damps the reverb by clearing the delay lines.
+* Damps the reverb by clearing the delay lines. The reverb then continues
+* exactly like a new one.
 * @param rev the reverb.
 *
 * Reverb API.
@@ -1280,125 +1200,256 @@ fluid_revmodel_reset(fluid_revmodel_t *rev)
     fluid_revmodel_init(rev);
 }
 
-/*-----------------------------------------------------------------------------
-* fdn reverb process replace.
-* @param rev pointer on reverb.
-* @param in monophonic buffer input (FLUID_BUFSIZE sample).
-* @param left_out stereo left processed output (FLUID_BUFSIZE sample).
-* @param right_out stereo right processed output (FLUID_BUFSIZE sample).
+/*
+* Returns the memory used by the reverb in bytes, including its delay lines.
+* @param rev the reverb.
 *
-* The processed reverb is replacing anything there in out.
 * Reverb API.
------------------------------------------------------------------------------*/
-void
-fluid_revmodel_processreplace(fluid_revmodel_t *rev, const fluid_real_t *in,
-                              fluid_real_t *left_out, fluid_real_t *right_out)
+*/
+size_t
+fluid_revmodel_get_memory(const fluid_revmodel_t *rev)
 {
-    int i, k;
+    size_t size = 0;
+    int i;
+
+    for(i = 0; i < NBR_DELAYS; i++)
+    {
+        size += rev->late.lines.size[i];
+    }
 
-    fluid_real_t xn;                   /* mono input x(n) */
-    fluid_real_t out_tone_filter;      /* tone corrector output */
-    fluid_real_t out_left, out_right;  /* output stereo Left  and Right  */
-    fluid_real_t matrix_factor;        /* partial matrix computation */
-    fluid_real_t delay_out_s;          /* sample */
-    fluid_real_t delay_out[NBR_DELAYS]; /* Line output + damper output */
+    return sizeof(*rev) + size * sizeof(fluid_real_t);
+}
+
+/*-----------------------------------------------------------------------------
+ Processes one block of FLUID_BUFSIZE samples through the feedback delay network.
 
+ The lines delay by far more than FLUID_BUFSIZE samples (see
+ create_mod_delay_lines()), so the samples read out of the lines during a
+ block never depend on the samples pushed into them during the same block.
+ Hence the samples of the whole block are first copied out of each line,
+ where they are contiguous. The interpolators and damping filters then
+ process all lines at once sample by sample, using SIMD instructions. Finally
+ the block is pushed into each line in contiguous runs. The result is exactly
+ the same as processing each line sample by sample.
+
+ @param late pointer on late structure.
+ @param in monophonic buffer input (FLUID_BUFSIZE samples).
+ @param out_left, out_right output stereo Left and Right, wet1 integrated
+   (FLUID_BUFSIZE samples).
+-----------------------------------------------------------------------------*/
+static void process_late_block(fluid_late *late, const fluid_real_t *in,
+                               fluid_real_t *out_left, fluid_real_t *out_right)
+{
+    mod_delay_lines *mdl = &late->lines;
+    int i, k, n, count, pos;
+
+    fluid_real_t xn;                                    /* mono input x(n) */
+    fluid_real_t tone_out[FLUID_BUFSIZE];               /* tone corrector output */
+    fluid_real_t matrix_factor[FLUID_BUFSIZE];          /* partial matrix computation */
+    fluid_real_t left, right;                           /* output stereo Left  and Right  */
+    fluid_real_t line_cur[FLUID_BUFSIZE][NBR_DELAYS];   /* samples at line_out in each line */
+    fluid_real_t line_next[FLUID_BUFSIZE][NBR_DELAYS];  /* samples following them */
+    fluid_real_t delay_out[FLUID_BUFSIZE][NBR_DELAYS];  /* Line output + damper output */
+    const fluid_real_t *line;
+    fluid_real_t *line_in;
+
+    /*--------------------------------------------------------------------
+     tone correction.
+    */
     for(k = 0; k < FLUID_BUFSIZE; k++)
     {
-        /* stereo output */
-        out_left = out_right = 0;
-
 #ifdef DENORMALISING
         /* Input is adjusted by DC_OFFSET. */
         xn = (in[k]) * FIXED_GAIN + DC_OFFSET;
 #else
         xn = (in[k]) * FIXED_GAIN;
 #endif
+        tone_out[k] = xn * late->b1 - late->b2 * late->tone_buffer;
+        late->tone_buffer = xn;
+    }
 
-        /*--------------------------------------------------------------------
-         tone correction.
-        */
-        out_tone_filter = xn * rev->late.b1 - rev->late.b2 * rev->late.tone_buffer;
-        rev->late.tone_buffer = xn;
-        xn = out_tone_filter;
-        /*--------------------------------------------------------------------
-         process  feedback delayed network:
-          - xn is the input signal.
-          - before inserting in the line input we first we get the delay lines
-            output, filter them and compute output in delay_out[].
-          - also matrix_factor is computed (to simplify further matrix product)
-        ---------------------------------------------------------------------*/
-        /* We begin with the modulated output delay line + damping filter */
-        matrix_factor = 0;
+    /*--------------------------------------------------------------------
+     process  feedback delayed network:
+      - tone_out[] is the input signal.
+      - before inserting in the line input we first we get the delay lines
+        output, filter them and compute output in delay_out[].
+      - also matrix_factor is computed (to simplify further matrix product)
+    ---------------------------------------------------------------------*/
+    /* We begin with the modulated output delay line + damping filter,
+       in runs of samples between the updates of the modulated positions */
+    for(k = 0; k < FLUID_BUFSIZE; k += count)
+    {
+        /* Checks if the modulators must be updated (every mod_rate samples). */
+        /* Important: center_pos_mod must be used immediately for the
+           first sample. So, mdl->index_rate must be initialized
+           to mdl->mod_rate (initialize_mod_delay_lines())  */
+        if(++mdl->index_rate >= mdl->mod_rate)
+        {
+            mdl->index_rate = 0;
+            update_mod_delay_positions(mdl);
+        }
+
+        count = mdl->mod_rate - mdl->index_rate;
 
+        if(count > FLUID_BUFSIZE - k)
+        {
+            count = FLUID_BUFSIZE - k;
+        }
+
+        /* the following samples of the run pass the check above without update */
+        mdl->index_rate += count - 1;
+
+        /* reads the run out of each line: the current sample and the next one,
+           with boundary check and circular motion as needed */
         for(i = 0; i < NBR_DELAYS; i++)
         {
-            mod_delay_line *mdl = &rev->late.mod_delay_lines[i];
-            /* get current modulated output */
-            delay_out_s = get_mod_delay(mdl);
+            line = &mdl->buffer[mdl->offset[i]];
+            pos = mdl->line_out[i];
 
-            /* process low pass damping filter
-              (input:delay_out_s, output:delay_out_s) */
-            process_damping_filter(delay_out_s, delay_out_s, mdl);
+            for(n = k; n < k + count; n++)
+            {
+                line_cur[n][i] = line[pos];
 
-            /* Result in delay_out[], and matrix_factor.
-               These will be of use later during input line process */
-            delay_out[i] = delay_out_s;   /* result in delay_out[] */
-            matrix_factor += delay_out_s; /* result in matrix_factor */
+                if(++pos >= mdl->size[i])
+                {
+                    pos -= mdl->size[i];
+                }
 
-            /* Process stereo output */
-            /* stereo left = left + out_left_gain * delay_out */
-            out_left += rev->late.out_left_gain[i] * delay_out_s;
-            /* stereo right= right+ out_right_gain * delay_out */
-            out_right += rev->late.out_right_gain[i] * delay_out_s;
-        }
+                line_next[n][i] = line[pos];
+            }
 
-        /* now we process the input delay line.Each input is a combination of
-           - xn: input signal
-           - delay_out[] the output of a delay line given by a permutation matrix P
-           - and matrix_factor.
-          This computes: in_delay_line = xn + (delay_out[] * matrix A) with
-          an algorithm equivalent but faster than using a product with matrix A.
-        */
-        /* matrix_factor = output sum * (-2.0)/N  */
-        matrix_factor *= FDN_MATRIX_FACTOR;
-        matrix_factor += xn; /* adds reverb input signal */
+            mdl->line_out[i] = pos;
+        }
 
-        for(i = 1; i < NBR_DELAYS; i++)
+        for(n = k; n < k + count; n++)
         {
-            /* delay_in[i-1] = delay_out[i] + matrix_factor */
-            delay_line *dl = &rev->late.mod_delay_lines[i - 1].dl;
-            push_in_delay_line(dl, delay_out[i] + matrix_factor);
+            #pragma omp simd
+            for(i = 0; i < NBR_DELAYS; i++)
+            {
+                fluid_real_t out;
+
+                /*  First order all-pass interpolation --------------------------*/
+                /* https://ccrma.stanford.edu/~jos/pasp/First_Order_Allpass_Interpolation.html */
+                /* Fractional interpolation between next sample (at next position) and
+                   previous output added to current sample.
+                */
+                out = line_cur[n][i] + mdl->frac_pos_mod[i] * (line_next[n][i] - mdl->interp_buffer[i]);
+                mdl->interp_buffer[i] = out; /* memorizes current output */
+
+                /* process low pass damping filter (input:out, output:out) */
+                out = out * mdl->damping_b0[i] - mdl->damping_buffer[i] * mdl->damping_a1[i];
+                mdl->damping_buffer[i] = out;
+
+                delay_out[n][i] = out;   /* result in delay_out[] */
+            }
         }
+    }
 
-        /* last line input (NB_DELAY-1) */
-        /* delay_in[0] = delay_out[NB_DELAY -1] + matrix_factor */
+    for(k = 0; k < FLUID_BUFSIZE; k++)
+    {
+        /* Result in matrix_factor and stereo output */
+        matrix_factor[k] = left = right = 0;
+
+        for(i = 0; i < NBR_DELAYS; i++)
         {
-            delay_line *dl = &rev->late.mod_delay_lines[NBR_DELAYS - 1].dl;
-            push_in_delay_line(dl, delay_out[0] + matrix_factor);
+            matrix_factor[k] += delay_out[k][i]; /* result in matrix_factor */
+
+            /* Process stereo output */
+            /* stereo left = left + out_left_gain * delay_out */
+            left += late->out_left_gain[i] * delay_out[k][i];
+            /* stereo right= right+ out_right_gain * delay_out */
+            right += late->out_right_gain[i] * delay_out[k][i];
         }
 
-        /*-------------------------------------------------------------------*/
+        /* matrix_factor = output sum * (-2.0)/N  */
+        matrix_factor[k] *= FDN_MATRIX_FACTOR;
+        matrix_factor[k] += tone_out[k]; /* adds reverb input signal */
+
 #ifdef DENORMALISING
         /* Removes the DC offset */
-        out_left -= DC_OFFSET;
-        out_right -= DC_OFFSET;
+        left -= DC_OFFSET;
+        right -= DC_OFFSET;
 #endif
+        out_left[k] = left;
+        out_right[k] = right;
+    }
 
-        /* Calculates stereo output REPLACING anything already there: */
-        /*
-            left_out[k]  = out_left * rev->wet1 + out_right * rev->wet2;
-            right_out[k] = out_right * rev->wet1 + out_left * rev->wet2;
+    /* now we process the input delay line.Each input is a combination of
+       - tone_out: input signal
+       - delay_out[] the output of a delay line given by a permutation matrix P
+       - and matrix_factor.
+      This computes: in_delay_line = xn + (delay_out[] * matrix A) with
+      an algorithm equivalent but faster than using a product with matrix A.
 
-            As wet1 is integrated in stereo coefficient wet 1 is now
-            integrated in out_left and out_right, so we simplify previous
-            relation by suppression of one multiply as this:
+      delay_in[i] = delay_out[i + 1] + matrix_factor
+      last line input (NB_DELAY-1): delay_in[NB_DELAY -1] = delay_out[0] + matrix_factor
+    */
+    for(i = 0; i < NBR_DELAYS; i++)
+    {
+        int src = (i + 1) % NBR_DELAYS;
+
+        /* up to the end of the line, then circular motion */
+        for(k = 0; k < FLUID_BUFSIZE; k += count)
+        {
+            count = mdl->size[i] - mdl->line_in[i];
+
+            if(count > FLUID_BUFSIZE - k)
+            {
+                count = FLUID_BUFSIZE - k;
+            }
+
+            line_in = &mdl->buffer[mdl->offset[i] + mdl->line_in[i]];
+
+            for(n = 0; n < count; n++)
+            {
+                line_in[n] = delay_out[k + n][src] + matrix_factor[k + n];
+            }
+
+            if((mdl->line_in[i] += count) >= mdl->size[i])
+            {
+                mdl->line_in[i] -= mdl->size[i];
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------------------------
+* fdn reverb process replace.
+* @param rev pointer on reverb.
+* @param in monophonic buffer input (FLUID_BUFSIZE sample).
+* @param left_out stereo left processed output (FLUID_BUFSIZE sample).
+* @param right_out stereo right processed output (FLUID_BUFSIZE sample).
+*
+* The processed reverb is replacing anything there in out.
+* Reverb API.
+-----------------------------------------------------------------------------*/
+void
+fluid_revmodel_processreplace(fluid_revmodel_t *rev, const fluid_real_t *in,
+                              fluid_real_t *left_out, fluid_real_t *right_out)
+{
+    int k;
+
+    fluid_real_t out_left[FLUID_BUFSIZE], out_right[FLUID_BUFSIZE];  /* output stereo Left  and Right  */
+
+    process_late_block(&rev->late, in, out_left, out_right);
+
+    /* Calculates stereo output REPLACING anything already there: */
+    /*
+        left_out[k]  = out_left * rev->wet1 + out_right * rev->wet2;
+        right_out[k] = out_right * rev->wet1 + out_left * rev->wet2;
+
+        As wet1 is integrated in stereo coefficient wet 1 is now
+        integrated in out_left and out_right, so we simplify previous
+        relation by suppression of one multiply as this:
 
-            left_out[k]  = out_left  + out_right * rev->wet2;
-            right_out[k] = out_right + out_left * rev->wet2;
-        */
         left_out[k]  = out_left  + out_right * rev->wet2;
         right_out[k] = out_right + out_left * rev->wet2;
+    */
+    #pragma omp simd
+    for(k = 0; k < FLUID_BUFSIZE; k++)
+    {
+        left_out[k]  = out_left[k]  + out_right[k] * rev->wet2;
+        right_out[k] = out_right[k] + out_left[k] * rev->wet2;
     }
 }
 
@@ -1416,108 +1467,28 @@ fluid_revmodel_processreplace(fluid_revmodel_t *rev, const fluid_real_t *in,
 void fluid_revmodel_processmix(fluid_revmodel_t *rev, const fluid_real_t *in,
                                fluid_real_t *left_out, fluid_real_t *right_out)
 {
-    int i, k;
-
-    fluid_real_t xn;                   /* mono input x(n) */
-    fluid_real_t out_tone_filter;      /* tone corrector output */
-    fluid_real_t out_left, out_right;  /* output stereo Left  and Right  */
-    fluid_real_t matrix_factor;        /* partial matrix term */
-    fluid_real_t delay_out_s;          /* sample */
-    fluid_real_t delay_out[NBR_DELAYS]; /* Line output + damper output */
-
-    for(k = 0; k < FLUID_BUFSIZE; k++)
-    {
-        /* stereo output */
-        out_left = out_right = 0;
-#ifdef DENORMALISING
-        /* Input is adjusted by DC_OFFSET. */
-        xn = (in[k]) * FIXED_GAIN + DC_OFFSET;
-#else
-        xn = (in[k]) * FIXED_GAIN;
-#endif
-
-        /*--------------------------------------------------------------------
-         tone correction
-        */
-        out_tone_filter = xn * rev->late.b1 - rev->late.b2 * rev->late.tone_buffer;
-        rev->late.tone_buffer = xn;
-        xn = out_tone_filter;
-        /*--------------------------------------------------------------------
-         process feedback delayed network:
-          - xn is the input signal.
-          - before inserting in the line input we first we get the delay lines
-            output, filter them and compute output in local delay_out[].
-          - also matrix_factor is computed (to simplify further matrix product).
-        ---------------------------------------------------------------------*/
-        /* We begin with the modulated output delay line + damping filter */
-        matrix_factor = 0;
-
-        for(i = 0; i < NBR_DELAYS; i++)
-        {
-            mod_delay_line *mdl = &rev->late.mod_delay_lines[i];
-            /* get current modulated output */
-            delay_out_s = get_mod_delay(mdl);
-
-            /* process low pass damping filter
-              (input:delay_out_s, output:delay_out_s) */
-            process_damping_filter(delay_out_s, delay_out_s, mdl);
-
-            /* Result in delay_out[], and matrix_factor.
-               These will be of use later during input line process */
-            delay_out[i] = delay_out_s;   /* result in delay_out[] */
-            matrix_factor += delay_out_s; /* result in matrix_factor */
-
-            /* Process stereo output */
-            /* stereo left = left + out_left_gain * delay_out */
-            out_left += rev->late.out_left_gain[i] * delay_out_s;
-            /* stereo right= right+ out_right_gain * delay_out */
-            out_right += rev->late.out_right_gain[i] * delay_out_s;
-        }
+    int k;
 
-        /* now we process the input delay line. Each input is a combination of:
-           - xn: input signal
-           - delay_out[] the output of a delay line given by a permutation matrix P
-           - and matrix_factor.
-          This computes: in_delay_line = xn + (delay_out[] * matrix A) with
-          an algorithm equivalent but faster than using a product with matrix A.
-        */
-        /* matrix_factor = output sum * (-2.0)/N  */
-        matrix_factor *= FDN_MATRIX_FACTOR;
-        matrix_factor += xn; /* adds reverb input signal */
+    fluid_real_t out_left[FLUID_BUFSIZE], out_right[FLUID_BUFSIZE];  /* output stereo Left  and Right  */
 
-        for(i = 1; i < NBR_DELAYS; i++)
-        {
-            /* delay_in[i-1] = delay_out[i] + matrix_factor */
-            delay_line *dl = &rev->late.mod_delay_lines[i - 1].dl;
-            push_in_delay_line(dl, delay_out[i] + matrix_factor);
-        }
+    process_late_block(&rev->late, in, out_left, out_right);
 
-        /* last line input (NB_DELAY-1) */
-        /* delay_in[0] = delay_out[NB_DELAY -1] + matrix_factor */
-        {
-            delay_line *dl = &rev->late.mod_delay_lines[NBR_DELAYS - 1].dl;
-            push_in_delay_line(dl, delay_out[0] + matrix_factor);
-        }
+    /* Calculates stereo output MIXING anything already there: */
+    /*
+        left_out[k]  += out_left * rev->wet1 + out_right * rev->wet2;
+        right_out[k] += out_right * rev->wet1 + out_left * rev->wet2;
 
-        /*-------------------------------------------------------------------*/
-#ifdef DENORMALISING
-        /* Removes the DC offset */
-        out_left -= DC_OFFSET;
-        out_right -= DC_OFFSET;
-#endif
-        /* Calculates stereo output MIXING anything already there: */
-        /*
-            left_out[k]  += out_left * rev->wet1 + out_right * rev->wet2;
-            right_out[k] += out_right * rev->wet1 + out_left * rev->wet2;
-
-            As wet1 is integrated in stereo coefficient wet 1 is now
-            integrated in out_left and out_right, so we simplify previous
-            relation by suppression of one multiply as this:
+        As wet1 is integrated in stereo coefficient wet 1 is now
+        integrated in out_left and out_right, so we simplify previous
+        relation by suppression of one multiply as this:
 
-            left_out[k]  += out_left  + out_right * rev->wet2;
-            right_out[k] += out_right + out_left * rev->wet2;
-        */
         left_out[k]  += out_left  + out_right * rev->wet2;
         right_out[k] += out_right + out_left * rev->wet2;
+    */
+    #pragma omp simd
+    for(k = 0; k < FLUID_BUFSIZE; k++)
+    {
+        left_out[k]  += out_left[k]  + out_right[k] * rev->wet2;
+        right_out[k] += out_right[k] + out_left[k] * rev->wet2;
     }
 }
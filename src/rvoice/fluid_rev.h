@@ -91,6 +91,8 @@ void fluid_revmodel_set(fluid_revmodel_t *rev, int set, fluid_real_t roomsize,
 
 int fluid_revmodel_samplerate_change(fluid_revmodel_t *rev, fluid_real_t sample_rate);
 
+size_t fluid_revmodel_get_memory(const fluid_revmodel_t *rev);
+
 #ifdef __cplusplus
 }
 #endif
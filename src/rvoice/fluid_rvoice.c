@@ -18,20 +18,157 @@
  */
 
 #include "fluid_rvoice.h"
+#include "fluid_rvoice_cache.h"
 #include "fluid_conv.h"
 #include "fluid_sys.h"
 
 
 static void fluid_rvoice_noteoff_LOCAL(fluid_rvoice_t *voice, unsigned int min_ticks);
 
+/* The values that a voice converts from cents and centibels for every block */
+typedef struct
+{
+    fluid_real_t pitch_hz;      /* the pitch, before dividing by the root pitch */
+    fluid_real_t att_amp;       /* the attenuation */
+    fluid_real_t env_amp;       /* the volume envelope and the modulation LFO */
+    fluid_real_t min_att_amp;   /* the lower boundary of the attenuation */
+} fluid_rvoice_conv_t;
+
+/* Output amplitudes below which FLUID_INTERP_AUTO uses cheaper interpolation. The errors of
+ * linear and no interpolation are roughly 40 and 20 dB below the signal, which keeps them below
+ * the noise floor of 16 bit audio. */
+#define FLUID_INTERP_AUTO_LINEAR_AMP ((fluid_real_t)1.e-3)
+#define FLUID_INTERP_AUTO_NONE_AMP ((fluid_real_t)1.e-4)
+
+/*
+ * Upper bound of the output amplitude of a voice's block with the given target amplitude,
+ * taking the current amplitude as well as the gains of its pan, balance and effect sends
+ * into account.
+ */
+static FLUID_INLINE fluid_real_t
+fluid_rvoice_get_output_amp(const fluid_rvoice_t *voice, fluid_real_t target_amp)
+{
+    fluid_real_t amp = voice->resonant_filter.amp;
+    fluid_real_t buf_amp = 0.0f;
+    unsigned int i;
+
+    for(i = 0; i < voice->buffers.count; i++)
+    {
+        buf_amp = (voice->buffers.bufs[i].target_amp > buf_amp) ? voice->buffers.bufs[i].target_amp : buf_amp;
+        buf_amp = (voice->buffers.bufs[i].current_amp > buf_amp) ? voice->buffers.bufs[i].current_amp : buf_amp;
+    }
+
+    amp = (target_amp > amp) ? target_amp : amp;
+
+    /* The buffer gains include the synth gain and the scaling of the 24 bit samples
+     * to [-1.0, 1.0], see fluid_voice_calculate_gain_amplitude(). */
+    return amp * buf_amp * (fluid_real_t)(1 << 23);
+}
+
+/*
+ * Interpolation method of a FLUID_INTERP_AUTO voice for the next block, after its phase
+ * increment and amplitude have been calculated.
+ */
+static FLUID_INLINE enum fluid_interp
+fluid_rvoice_get_auto_interp_method(const fluid_rvoice_t *voice)
+{
+    fluid_real_t amp = fluid_rvoice_get_output_amp(voice, voice->resonant_filter.amp
+                       + voice->resonant_filter.amp_incr * FLUID_BUFSIZE);
+
+    /* playing the sample points as they are, nothing to interpolate */
+    if(voice->dsp.phase_incr == 1.0f && fluid_phase_fract(voice->dsp.phase) == 0)
+    {
+        return FLUID_INTERP_NONE;
+    }
+
+    if(amp < FLUID_INTERP_AUTO_NONE_AMP)
+    {
+        return FLUID_INTERP_NONE;
+    }
+
+    /* Transposed up by an octave or more, the voice skips sample points and aliases anyway,
+     * which higher orders don't help with. Transposed down, the images of the sample's
+     * spectrum that the interpolation leaves fall into the audible range. */
+    if(amp < FLUID_INTERP_AUTO_LINEAR_AMP || voice->dsp.phase_incr >= 2.0f)
+    {
+        return FLUID_INTERP_LINEAR;
+    }
+
+    return (voice->dsp.phase_incr > 1.0f) ? FLUID_INTERP_4THORDER : FLUID_INTERP_7THORDER;
+}
+
+/* Value of the modulation envelope, as applied to the pitch and the filter cutoff */
+static FLUID_INLINE fluid_real_t
+fluid_rvoice_get_modenv_val(fluid_rvoice_t *voice)
+{
+    /* SF2.04 section 8.1.2 #26:
+     * attack of modEnv is convex ?!?
+     */
+    return (fluid_adsr_env_get_section(&voice->envlfo.modenv) == FLUID_VOICE_ENVATTACK)
+           ? fluid_convex(127 * fluid_adsr_env_get_val(&voice->envlfo.modenv))
+           : fluid_adsr_env_get_val(&voice->envlfo.modenv);
+}
+
+/*
+ * Gets the arguments of the conversions of a voice for the next block, after its
+ * envelopes and LFOs have been advanced: the pitch in cents and, in the order of
+ * fluid_rvoice_conv_t, the three attenuations in centibels.
+ */
+static void
+fluid_rvoice_get_conv_args(fluid_rvoice_t *voice, fluid_real_t *cents, fluid_real_t *cb)
+{
+    fluid_real_t lfo_cb = 0.0f;
+
+    *cents = voice->dsp.pitch + voice->dsp.pitchoffset;
+
+    /* the terms of unused modulation paths would be zero */
+    if(voice->envlfo.features & FLUID_RVOICE_PITCH_MOD)
+    {
+        *cents = *cents
+                 + fluid_lfo_get_val(&voice->envlfo.modlfo) * voice->envlfo.modlfo_to_pitch
+                 + fluid_lfo_get_val(&voice->envlfo.viblfo) * voice->envlfo.viblfo_to_pitch
+                 + fluid_rvoice_get_modenv_val(voice) * voice->envlfo.modenv_to_pitch;
+    }
+
+    if(voice->envlfo.features & FLUID_RVOICE_VOL_MOD)
+    {
+        lfo_cb = fluid_lfo_get_val(&voice->envlfo.modlfo) * -voice->envlfo.modlfo_to_vol;
+    }
+
+    cb[0] = voice->dsp.attenuation;
+
+    /* A positive modlfo_to_vol should increase volume (negative attenuation). In the attack
+     * section, the envelope ramps linearly to the max value and is applied as a factor. */
+    cb[1] = (fluid_adsr_env_get_section(&voice->envlfo.volenv) == FLUID_VOICE_ENVATTACK)
+            ? lfo_cb
+            : FLUID_PEAK_ATTENUATION * (1.0f - fluid_adsr_env_get_val(&voice->envlfo.volenv)) + lfo_cb;
+
+    cb[2] = voice->dsp.min_attenuation_cB;
+}
+
+/* Converts the arguments of fluid_rvoice_get_conv_args() */
+static void
+fluid_rvoice_convert(fluid_rvoice_t *voice, fluid_rvoice_conv_t *conv)
+{
+    fluid_real_t cents, cb[3];
+
+    fluid_rvoice_get_conv_args(voice, &cents, cb);
+    conv->pitch_hz = fluid_ct2hz_real(cents);
+    conv->att_amp = fluid_cb2amp(cb[0]);
+    conv->env_amp = fluid_cb2amp(cb[1]);
+    conv->min_att_amp = fluid_cb2amp(cb[2]);
+}
+
 /**
  * @return -1 if voice is quiet, 0 if voice has finished, 1 otherwise
  */
 static FLUID_INLINE int
-fluid_rvoice_calc_amp(fluid_rvoice_t *voice)
+fluid_rvoice_calc_amp(fluid_rvoice_t *voice, const fluid_rvoice_conv_t *conv)
 {
     fluid_real_t target_amp;	/* target amplitude */
 
+    voice->dsp.inaudible = FALSE;
+
     if(fluid_adsr_env_get_section(&voice->envlfo.volenv) == FLUID_VOICE_ENVDELAY)
     {
         return -1;    /* The volume amplitude is in hold phase. No sound is produced. */
@@ -42,18 +179,14 @@ fluid_rvoice_calc_amp(fluid_rvoice_t *voice)
         /* the envelope is in the attack section: ramp linearly to max value.
          * A positive modlfo_to_vol should increase volume (negative attenuation).
          */
-        target_amp = fluid_cb2amp(voice->dsp.attenuation)
-                     * fluid_cb2amp(fluid_lfo_get_val(&voice->envlfo.modlfo) * -voice->envlfo.modlfo_to_vol)
-                     * fluid_adsr_env_get_val(&voice->envlfo.volenv);
+        target_amp = conv->att_amp * conv->env_amp * fluid_adsr_env_get_val(&voice->envlfo.volenv);
     }
     else
     {
         fluid_real_t amplitude_that_reaches_noise_floor;
         fluid_real_t amp_max;
 
-        target_amp = fluid_cb2amp(voice->dsp.attenuation)
-                     * fluid_cb2amp(FLUID_PEAK_ATTENUATION * (1.0f - fluid_adsr_env_get_val(&voice->envlfo.volenv))
-                                    + fluid_lfo_get_val(&voice->envlfo.modlfo) * -voice->envlfo.modlfo_to_vol);
+        target_amp = conv->att_amp * conv->env_amp;
 
         /* We turn off a voice, if the volume has dropped low enough. */
 
@@ -82,8 +215,7 @@ fluid_rvoice_calc_amp(fluid_rvoice_t *voice)
          * volenv_val can only drop):
          */
 
-        amp_max = fluid_cb2amp(voice->dsp.min_attenuation_cB) *
-                  fluid_adsr_env_get_val(&voice->envlfo.volenv);
+        amp_max = conv->min_att_amp * fluid_adsr_env_get_val(&voice->envlfo.volenv);
 
         /* And if amp_max is already smaller than the known amplitude,
          * which will attenuate the sample below the noise floor, then we
@@ -99,6 +231,18 @@ fluid_rvoice_calc_amp(fluid_rvoice_t *voice)
 
     fluid_check_fpe("voice_write amplitude calculation");
 
+    /* The voice may still become audible, e.g. by raising the volume or moving the pan,
+     * but this block is below the noise floor: it is rendered silent. The filters still run
+     * on a cheaper interpolation, so that their history follows the sample and the voice
+     * comes back without a transient. */
+    if(fluid_rvoice_get_output_amp(voice, target_amp) < voice->dsp.noise_floor)
+    {
+        voice->resonant_filter.amp = target_amp;
+        voice->resonant_filter.amp_incr = 0.0f;
+        voice->dsp.inaudible = TRUE;
+        return 1;
+    }
+
     /* no volume and not changing? - No need to process */
     if ((voice->resonant_filter.amp == 0.0f) && (voice->resonant_filter.amp_incr == 0.0f))
     {
@@ -219,10 +363,25 @@ fluid_rvoice_check_sample_sanity(fluid_rvoice_t *voice)
         if((int)voice->dsp.loopstart >= (int)voice->dsp.sample->loopstart
                 && (int)voice->dsp.loopend <= (int)voice->dsp.sample->loopend)
         {
+            int is_valid = voice->dsp.sample->amplitude_that_reaches_noise_floor_is_valid;
+            double amplitude = voice->dsp.sample->amplitude_that_reaches_noise_floor;
+
+            /* a voice playing a stereo pair stops once the louder of both samples is inaudible */
+            if(voice->stereo != NULL)
+            {
+                const fluid_sample_t *other = voice->stereo->dsp.sample;
+
+                is_valid = is_valid && other->amplitude_that_reaches_noise_floor_is_valid;
+                amplitude = (other->amplitude_that_reaches_noise_floor < amplitude)
+                            ? other->amplitude_that_reaches_noise_floor : amplitude;
+            }
+
             /* Is there a valid peak amplitude available for the loop, and can we use it? */
-            if(voice->dsp.sample->amplitude_that_reaches_noise_floor_is_valid && voice->dsp.samplemode == FLUID_LOOP_DURING_RELEASE)
+            if(is_valid && voice->dsp.samplemode == FLUID_LOOP_DURING_RELEASE)
             {
-                voice->dsp.amplitude_that_reaches_noise_floor_loop = voice->dsp.sample->amplitude_that_reaches_noise_floor / voice->dsp.synth_gain;
+                /* the sample's estimate is based on FLUID_NOISE_FLOOR and scales with the noise floor */
+                voice->dsp.amplitude_that_reaches_noise_floor_loop = amplitude
+                        * (voice->dsp.noise_floor / FLUID_NOISE_FLOOR) / voice->dsp.synth_gain;
             }
             else
             {
@@ -288,29 +447,193 @@ fluid_rvoice_check_sample_sanity(fluid_rvoice_t *voice)
 }
 
 
+/* Returns non-zero if the given filter will actually be applied by fluid_iir_filter_apply() */
+static FLUID_INLINE int
+fluid_rvoice_filter_is_active(const fluid_iir_filter_t *iir_filter)
+{
+    return iir_filter->type != FLUID_IIR_DISABLED && iir_filter->last_q >= Q_MIN;
+}
+
+/*
+ * Returns the cost of rendering an audible block with an interpolation method, without
+ * filters. Also used by the synth to estimate the cost of a voice before it starts.
+ */
+int
+fluid_rvoice_interp_cost(int interp_method)
+{
+    switch(interp_method)
+    {
+    case FLUID_INTERP_NONE:
+        return 16;
+
+    case FLUID_INTERP_LINEAR:
+        return 24;
+
+    case FLUID_INTERP_7THORDER:
+        return 72;
+
+    case FLUID_INTERP_16THORDER:
+        return 180;
+
+    case FLUID_INTERP_4THORDER:
+    default:
+        return FLUID_RVOICE_COST_DEFAULT;
+    }
+}
+
+/**
+ * Update the running estimate of the per-block rendering cost of a voice.
+ * Silent blocks are cheap, audible blocks are weighted by the interpolation
+ * method and the number of active filters. The estimate is a moving average,
+ * so that it follows the ratio of silent to audible blocks of the voice.
+ */
+static FLUID_INLINE void
+fluid_rvoice_update_cost(fluid_rvoice_t *voice, int audible)
+{
+    int block_cost = FLUID_RVOICE_COST_SILENT;
+
+    if(audible)
+    {
+        block_cost = fluid_rvoice_interp_cost(voice->dsp.inaudible ? FLUID_INTERP_LINEAR : voice->dsp.interp_method);
+
+        if(fluid_rvoice_filter_is_active(&voice->resonant_filter))
+        {
+            block_cost += FLUID_RVOICE_COST_FILTER;
+        }
+
+        if(fluid_rvoice_filter_is_active(&voice->resonant_custom_filter))
+        {
+            block_cost += FLUID_RVOICE_COST_FILTER;
+        }
+    }
+
+    voice->cost += (block_cost - voice->cost) / 4;
+}
+/*
+ * Delays the block written by a voice started within a block by its start_delay, the voice
+ * cache keeps the undelayed blocks. count is the result of fluid_rvoice_write(), the result
+ * for the delayed block is returned. A voice that finishes within a block keeps playing
+ * for one more block if the samples carried over don't fit into it anymore.
+ */
+static int
+fluid_rvoice_delay_block(fluid_rvoice_t *voice, fluid_real_t *dsp_buf, int count)
+{
+    fluid_real_t tail[FLUID_BUFSIZE];
+    int delay = voice->start_delay;
+    int tail_count, n;
+
+    if(delay == 0)
+    {
+        return count;
+    }
+
+    if(count < 0)
+    {
+        /* a quiet block stays quiet unless sound is carried over into it */
+        if(voice->delay_pending == 0)
+        {
+            return count;
+        }
+
+        FLUID_MEMSET(dsp_buf, 0, FLUID_BUFSIZE * sizeof(*dsp_buf));
+        n = 0;
+    }
+    else
+    {
+        n = count;
+    }
+
+    /* the samples that end up in the next block */
+    tail_count = n - (FLUID_BUFSIZE - delay);
+
+    if(tail_count > 0)
+    {
+        FLUID_MEMCPY(tail, &dsp_buf[FLUID_BUFSIZE - delay], tail_count * sizeof(*tail));
+    }
+    else
+    {
+        tail_count = 0;
+    }
+
+    FLUID_MEMMOVE(&dsp_buf[delay], dsp_buf, (n - tail_count) * sizeof(*dsp_buf));
+    FLUID_MEMCPY(dsp_buf, voice->delay_buf, delay * sizeof(*dsp_buf));
+
+    FLUID_MEMCPY(voice->delay_buf, tail, tail_count * sizeof(*tail));
+    FLUID_MEMSET(&voice->delay_buf[tail_count], 0, (delay - tail_count) * sizeof(*tail));
+    voice->delay_pending = tail_count;
+
+    if(count < 0 || n == FLUID_BUFSIZE || tail_count > 0)
+    {
+        return FLUID_BUFSIZE;
+    }
+
+    /* the voice has finished, once the samples carried over have been written */
+    return delay + n;
+}
+
+/* Lets the filter of the partner of a stereo voice follow the one of the voice, keeping its own
+ * sample history */
+static void
+fluid_rvoice_follow_filter(fluid_iir_filter_t *partner, const fluid_iir_filter_t *filter)
+{
+    fluid_real_t hist1 = partner->hist1, hist2 = partner->hist2;
+
+    *partner = *filter;
+    partner->hist1 = hist1;
+    partner->hist2 = hist2;
+}
+
 /**
  * Synthesize a voice to a buffer.
  *
+ * A voice playing the other sample of a stereo pair along with its own (see
+ * fluid_rvoice_t::stereo) writes that one to stereo_buf. The other sample is read at the
+ * phase of the voice and goes through the envelopes, amplitude and filter coefficients
+ * calculated for the voice, only the filter history and the mix into the buffers belong
+ * to the partner.
+ *
  * @param voice rvoice to synthesize
  * @param dsp_buf Audio buffer to synthesize to (#FLUID_BUFSIZE in length)
- * @return Count of samples written to dsp_buf. (-1 means voice is currently
+ * @param stereo_buf Audio buffer to synthesize the sample of the partner to (#FLUID_BUFSIZE
+ * in length), NULL unless the voice has a stereo partner
+ * @return Count of samples written to dsp_buf (and stereo_buf). (-1 means voice is currently
  * quiet, 0 .. #FLUID_BUFSIZE-1 means voice finished.)
  *
  * Panning, reverb and chorus are processed separately. The dsp interpolation
  * routine is in (fluid_rvoice_dsp.c).
  */
 int
-fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
+fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf, fluid_real_t *stereo_buf)
 {
-    int ticks = voice->envlfo.ticks;
-    int count, is_looping;
-    fluid_real_t modenv_val, fmod;
+    fluid_rvoice_t *partner = (stereo_buf != NULL) ? voice->stereo : NULL;
+    int is_looping;
+    int count, partner_count;
+    unsigned int ticks;
+    fluid_real_t fmod;
+    fluid_rvoice_conv_t conv;
+
+    if(voice->cache_mode == FLUID_RVOICE_CACHE_PLAY)
+    {
+        count = fluid_rvoice_cache_play(voice, dsp_buf);
+
+        if(count != FLUID_RVOICE_WRITE_INTERPOLATE)
+        {
+            fluid_rvoice_update_cost(voice, FALSE);
+            return fluid_rvoice_delay_block(voice, dsp_buf, count);
+        }
+    }
+
+    if(voice->cache_mode == FLUID_RVOICE_CACHE_RECORD)
+    {
+        fluid_rvoice_cache_record_begin(voice);
+    }
 
     /******************* sample sanity check **********/
 
     if(!voice->dsp.sample)
     {
-        return 0;
+        count = 0;
+        goto done;
     }
 
     if(voice->dsp.check_sample_sanity_flag)
@@ -326,6 +649,7 @@ fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
         fluid_rvoice_noteoff_LOCAL(voice, 0);
     }
 
+    ticks = voice->envlfo.ticks;
     voice->envlfo.ticks += FLUID_BUFSIZE;
 
     /******************* vol env **********************/
@@ -335,7 +659,8 @@ fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
 
     if(fluid_adsr_env_get_section(&voice->envlfo.volenv) == FLUID_VOICE_ENVFINISHED)
     {
-        return 0;
+        count = 0;
+        goto done;
     }
 
     /******************* mod env **********************/
@@ -350,36 +675,25 @@ fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
     fluid_lfo_calc(&voice->envlfo.viblfo, ticks);
     fluid_check_fpe("voice_write vib LFO");
 
+    fluid_rvoice_convert(voice, &conv);
+
     /******************* amplitude **********************/
 
-    count = fluid_rvoice_calc_amp(voice);
+    count = fluid_rvoice_calc_amp(voice, &conv);
     if(count == 0)
     {
         // Voice has finished, remove from dsp loop
-        return 0;
+        goto done;
     }
     // else if count is negative, still process the voice
 
-
     /******************* phase **********************/
 
-    /* SF2.04 section 8.1.2 #26:
-     * attack of modEnv is convex ?!?
-     */
-    modenv_val = (fluid_adsr_env_get_section(&voice->envlfo.modenv) == FLUID_VOICE_ENVATTACK)
-                 ? fluid_convex(127 * fluid_adsr_env_get_val(&voice->envlfo.modenv))
-                 : fluid_adsr_env_get_val(&voice->envlfo.modenv);
     /* Calculate the number of samples, that the DSP loop advances
      * through the original waveform with each step in the output
      * buffer. It is the ratio between the frequencies of original
      * waveform and output waveform.*/
-    voice->dsp.phase_incr = fluid_ct2hz_real(voice->dsp.pitch +
-                            voice->dsp.pitchoffset +
-                            fluid_lfo_get_val(&voice->envlfo.modlfo) * voice->envlfo.modlfo_to_pitch
-                            + fluid_lfo_get_val(&voice->envlfo.viblfo) * voice->envlfo.viblfo_to_pitch
-                            + modenv_val * voice->envlfo.modenv_to_pitch)
-                            / 
-                            voice->dsp.root_pitch_hz;
+    voice->dsp.phase_incr = conv.pitch_hz / voice->dsp.root_pitch_hz;
 
     /******************* portamento ****************/
     /* pitchoffset is updated if enabled.
@@ -427,13 +741,20 @@ fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
      * since that's what polyphone does (PR #1400) */
     if(voice->dsp.samplemode == FLUID_START_ON_RELEASE && fluid_adsr_env_get_section(&voice->envlfo.volenv) < FLUID_VOICE_ENVRELEASE)
     {
-        return -1;
+        fluid_rvoice_update_cost(voice, FALSE);
+        count = -1;
+        goto done;
     }
 
     /* voice is currently looping? */
     is_looping = voice->dsp.samplemode == FLUID_LOOP_DURING_RELEASE
-                 || (voice->dsp.samplemode == FLUID_LOOP_UNTIL_RELEASE
-                     && fluid_adsr_env_get_section(&voice->envlfo.volenv) < FLUID_VOICE_ENVRELEASE);
+                || (voice->dsp.samplemode == FLUID_LOOP_UNTIL_RELEASE
+                    && fluid_adsr_env_get_section(&voice->envlfo.volenv) < FLUID_VOICE_ENVRELEASE);
+
+    if(voice->dsp.interp_auto && count > 0 && !voice->dsp.inaudible)
+    {
+        voice->dsp.interp_method = fluid_rvoice_get_auto_interp_method(voice);
+    }
 
     /*************** resonant filter ******************/
     // Only "prepare" the filter here, the filter itself will be applied in the dsp_interpolation routines below.
@@ -444,7 +765,10 @@ fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
     // Note that at this point we are using voice->dsp.output_rate which is set to the synth's output rate, because
     // the filter will receive the interpolated waveform.
 
-    fmod = fluid_lfo_get_val(&voice->envlfo.modlfo) * voice->envlfo.modlfo_to_fc + modenv_val * voice->envlfo.modenv_to_fc;
+    fmod = (voice->envlfo.features & FLUID_RVOICE_FC_MOD)
+         ? fluid_lfo_get_val(&voice->envlfo.modlfo) * voice->envlfo.modlfo_to_fc
+           + fluid_rvoice_get_modenv_val(voice) * voice->envlfo.modenv_to_fc
+         : 0;
     fluid_iir_filter_calc(&voice->resonant_filter, voice->dsp.output_rate, fmod);
 
     fluid_check_fpe("voice_write IIR coefficients");
@@ -463,28 +787,85 @@ fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
      * Depending on the position in the loop and the loop size, this
      * may require several runs. */
 
+    if(voice->stream_slot != NULL && voice->dsp.sample->stream_preload != 0)
+    {
+        fluid_rvoice_stream_slot_advance(voice->stream_slot, fluid_phase_index(voice->dsp.phase),
+                                         voice->dsp.phase_incr, count >= 0);
+    }
+
     if(count < 0)
     {
         // The voice is quite, i.e. either in delay phase or zero volume.
         // We need to update the rvoice's dsp phase, as the delay phase shall not "postpone" the sound, rather
         // it should be played silently, see https://github.com/FluidSynth/fluidsynth/issues/1312
-        return fluid_rvoice_dsp_silence(voice, dsp_buf, is_looping);
+        fluid_rvoice_update_cost(voice, FALSE);
+        count = fluid_rvoice_dsp_silence(voice, dsp_buf, is_looping);
+        goto done;
     }
 
-    count = fluid_rvoice_dsp_interpolate(voice, dsp_buf, is_looping);
+    if(partner != NULL)
+    {
+        /* the partner first, from the phase the voice starts the block at */
+        partner_count = fluid_rvoice_dsp_interpolate_pair(voice, partner->dsp.sample, stereo_buf, is_looping);
+    }
 
+    count = fluid_rvoice_dsp_interpolate(voice, dsp_buf, is_looping);
     fluid_check_fpe("voice_write interpolation");
 
-    if (count == 0)
+    if(count == 0)
     {
         // voice has finished
-        return count;
+        goto done;
     }
-    
+
+    if(partner != NULL)
+    {
+        if(partner_count < count)
+        {
+            FLUID_MEMSET(&stereo_buf[partner_count], 0, (count - partner_count) * sizeof(*stereo_buf));
+        }
+
+        fluid_rvoice_follow_filter(&partner->resonant_filter, &voice->resonant_filter);
+        fluid_rvoice_follow_filter(&partner->resonant_custom_filter, &voice->resonant_custom_filter);
+    }
+
+    fluid_rvoice_update_cost(voice, TRUE);
     fluid_iir_filter_apply(&voice->resonant_filter, &voice->resonant_custom_filter, dsp_buf, count);
     fluid_check_fpe("voice_filter fluid_iir_filter_apply()");
 
-    return count;
+    if(voice->dsp.inaudible)
+    {
+        FLUID_MEMSET(dsp_buf, 0, count * sizeof(*dsp_buf));
+    }
+
+    if(partner != NULL)
+    {
+        fluid_iir_filter_apply(&partner->resonant_filter, &partner->resonant_custom_filter, stereo_buf, count);
+        fluid_check_fpe("voice_filter fluid_iir_filter_apply()");
+
+        if(voice->dsp.inaudible)
+        {
+            FLUID_MEMSET(stereo_buf, 0, count * sizeof(*stereo_buf));
+        }
+    }
+
+    if(count == FLUID_BUFSIZE)
+    {
+        fluid_rvoice_dsp_prefetch(voice, is_looping);
+    }
+
+done:
+    if(voice->cache_mode == FLUID_RVOICE_CACHE_RECORD)
+    {
+        fluid_rvoice_cache_record_end(voice, dsp_buf, count);
+    }
+
+    if(partner != NULL)
+    {
+        fluid_rvoice_delay_block(partner, stereo_buf, count);
+    }
+
+    return fluid_rvoice_delay_block(voice, dsp_buf, count);
 }
 
 /**
@@ -548,10 +929,15 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_mapping)
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_reset)
 {
     fluid_rvoice_t *voice = obj;
+    unsigned int i;
 
     voice->dsp.has_looped = 0;
+    voice->dsp.inaudible = 0;
     voice->envlfo.ticks = 0;
     voice->envlfo.noteoff_ticks = 0;
+    voice->start_delay = 0;
+    voice->delay_pending = 0;
+    voice->stereo = NULL;
 
     /* legato initialization */
     voice->dsp.pitchoffset = 0.0;   /* portamento initialization */
@@ -573,16 +959,59 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_reset)
     fluid_iir_filter_reset(&voice->resonant_filter);
     fluid_iir_filter_reset(&voice->resonant_custom_filter);
 
+    /* Fade in from silence, not from the amplitude the previous note of this
+     * voice ended with, so that a note sounds the same on any voice */
+    for(i = 0; i < voice->buffers.count; i++)
+    {
+        voice->buffers.bufs[i].target_amp = 0.0f;
+        voice->buffers.bufs[i].current_amp = 0.0f;
+    }
+
     /* Force setting of the phase at the first DSP loop run
      * This cannot be done earlier, because it depends on modulators.
        [DH] Is that comment really true? */
     voice->dsp.check_sample_sanity_flag |= FLUID_SAMPLESANITY_STARTUP;
+
+    /* assume an audible voice until the first blocks have been rendered */
+    voice->cost = FLUID_RVOICE_COST_DEFAULT;
+
+    /* not accounted unless the synth tells otherwise */
+    voice->perf_chan = -1;
+    voice->perf_preset = -1;
+}
+
+/*
+ * Applies the first param[0].i parameter updates collected in param_block by the synth
+ * thread, as if they had been sent as separate events.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_apply_param_block)
+{
+    fluid_rvoice_t *voice = obj;
+    int i, count = param[0].i;
+
+    for(i = 0; i < count; i++)
+    {
+        voice->param_block[i].method(voice->param_block[i].object, voice->param_block[i].param);
+    }
 }
 
+/*
+ * Starts the release of a voice. param[0].i is the tick of the voice to release it at the
+ * earliest, see synth.min-note-length, param[1].i the sample offset of the noteoff within
+ * the next block. The envelopes advance by blocks of the voice, which are shifted against
+ * those of the synth by the start_delay of the voice, so the release starts at the boundary
+ * of these blocks nearest to the offset.
+ */
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_noteoff)
 {
     fluid_rvoice_t *rvoice = obj;
     unsigned int min_ticks = param[0].i;
+    int offset = param[1].i - (int)rvoice->start_delay;
+
+    if(offset >= FLUID_BUFSIZE / 2 && min_ticks < rvoice->envlfo.ticks + FLUID_BUFSIZE)
+    {
+        min_ticks = rvoice->envlfo.ticks + FLUID_BUFSIZE;
+    }
 
     fluid_rvoice_noteoff_LOCAL(rvoice, min_ticks);
 }
@@ -747,12 +1176,10 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_multi_retrigger_attack)
  *   pitchoffset is accumulated in current dsp pitchoffset.
  * 2) And to get constant portamento duration, dsp pitch increment is updated.
 */
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_portamento)
+static FLUID_INLINE void
+fluid_rvoice_local_set_portamento(fluid_rvoice_t *voice, unsigned int countinc,
+                                  fluid_real_t pitchoffset)
 {
-    fluid_rvoice_t *voice = obj;
-    unsigned int countinc = param[0].i;
-    fluid_real_t pitchoffset = param[1].real;
-
     if(countinc)
     {
         voice->dsp.pitchoffset += pitchoffset;
@@ -763,6 +1190,27 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_portamento)
     dsp.pitchoffset will be incremented by dsp pitchinc. */
 }
 
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_portamento)
+{
+    fluid_rvoice_local_set_portamento(obj, param[0].i, param[1].real);
+}
+
+/**
+ * Used by legato mode single_trigger: sets the new pitch and the portamento
+ * of the voice at once, leaving the envelopes running.
+ * @param voice rvoice to update.
+ * @param pitch new dsp pitch.
+ * @param countinc increment count number, 0 without portamento.
+ * @param pitchoffset pitch offset to apply to voice dsp.pitch.
+*/
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_legato)
+{
+    fluid_rvoice_t *voice = obj;
+
+    voice->dsp.pitch = param[0].real;
+    fluid_rvoice_local_set_portamento(voice, param[1].i, param[2].real);
+}
+
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_output_rate)
 {
@@ -777,7 +1225,8 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_interp_method)
     fluid_rvoice_t *voice = obj;
     int value = param[0].i;
 
-    voice->dsp.interp_method = value;
+    voice->dsp.interp_auto = (value == FLUID_INTERP_AUTO);
+    voice->dsp.interp_method = voice->dsp.interp_auto ? FLUID_INTERP_DEFAULT : value;
 }
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_root_pitch_hz)
@@ -814,12 +1263,38 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_min_attenuation_cB)
     voice->dsp.min_attenuation_cB = value;
 }
 
+/* Updates the modulation paths of a voice after one of their amounts has changed */
+static void
+fluid_rvoice_update_features(fluid_rvoice_t *voice)
+{
+    const fluid_rvoice_envlfo_t *envlfo = &voice->envlfo;
+    unsigned int features = 0;
+
+    if(envlfo->modlfo_to_pitch != 0 || envlfo->viblfo_to_pitch != 0 || envlfo->modenv_to_pitch != 0)
+    {
+        features |= FLUID_RVOICE_PITCH_MOD;
+    }
+
+    if(envlfo->modlfo_to_vol != 0)
+    {
+        features |= FLUID_RVOICE_VOL_MOD;
+    }
+
+    if(envlfo->modlfo_to_fc != 0 || envlfo->modenv_to_fc != 0)
+    {
+        features |= FLUID_RVOICE_FC_MOD;
+    }
+
+    voice->envlfo.features = features;
+}
+
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_viblfo_to_pitch)
 {
     fluid_rvoice_t *voice = obj;
     fluid_real_t value = param[0].real;
 
     voice->envlfo.viblfo_to_pitch = value;
+    fluid_rvoice_update_features(voice);
 }
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modlfo_to_pitch)
@@ -828,6 +1303,7 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modlfo_to_pitch)
     fluid_real_t value = param[0].real;
 
     voice->envlfo.modlfo_to_pitch = value;
+    fluid_rvoice_update_features(voice);
 }
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modlfo_to_vol)
@@ -836,6 +1312,7 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modlfo_to_vol)
     fluid_real_t value = param[0].real;
 
     voice->envlfo.modlfo_to_vol = value;
+    fluid_rvoice_update_features(voice);
 }
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modlfo_to_fc)
@@ -844,6 +1321,7 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modlfo_to_fc)
     fluid_real_t value = param[0].real;
 
     voice->envlfo.modlfo_to_fc = value;
+    fluid_rvoice_update_features(voice);
 }
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modenv_to_fc)
@@ -852,6 +1330,7 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modenv_to_fc)
     fluid_real_t value = param[0].real;
 
     voice->envlfo.modenv_to_fc = value;
+    fluid_rvoice_update_features(voice);
 }
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modenv_to_pitch)
@@ -860,6 +1339,7 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modenv_to_pitch)
     fluid_real_t value = param[0].real;
 
     voice->envlfo.modenv_to_pitch = value;
+    fluid_rvoice_update_features(voice);
 }
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_synth_gain)
@@ -873,11 +1353,20 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_synth_gain)
      * loop parameters are initialized (they may depend on modulators).
      * This value can be kept, it is a worst-case estimate.
      */
-    voice->dsp.amplitude_that_reaches_noise_floor_nonloop = FLUID_NOISE_FLOOR / value;
-    voice->dsp.amplitude_that_reaches_noise_floor_loop = FLUID_NOISE_FLOOR / value;
+    voice->dsp.amplitude_that_reaches_noise_floor_nonloop = voice->dsp.noise_floor / value;
+    voice->dsp.amplitude_that_reaches_noise_floor_loop = voice->dsp.noise_floor / value;
     voice->dsp.check_sample_sanity_flag |= FLUID_SAMPLESANITY_CHECK;
 }
 
+/* Must be set before fluid_rvoice_set_synth_gain(), which derives the noise floor estimates */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_noise_floor)
+{
+    fluid_rvoice_t *voice = obj;
+    fluid_real_t value = param[0].real;
+
+    voice->dsp.noise_floor = value;
+}
+
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_start)
 {
     fluid_rvoice_t *voice = obj;
@@ -924,6 +1413,32 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_samplemode)
 }
 
 
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_perf_slots)
+{
+    fluid_rvoice_t *voice = obj;
+
+    voice->perf_chan = param[0].i;
+    voice->perf_preset = param[1].i;
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_note)
+{
+    fluid_rvoice_t *voice = obj;
+
+    voice->note_chan = param[0].i;
+    voice->note_key = param[1].i;
+    voice->note_vel = param[2].i;
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_start_delay)
+{
+    fluid_rvoice_t *voice = obj;
+
+    voice->start_delay = param[0].i;
+    voice->delay_pending = 0;
+    FLUID_MEMSET(voice->delay_buf, 0, sizeof(voice->delay_buf));
+}
+
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_sample)
 {
     fluid_rvoice_t *voice = obj;
@@ -935,6 +1450,11 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_sample)
     {
         voice->dsp.check_sample_sanity_flag |= FLUID_SAMPLESANITY_STARTUP;
     }
+
+    if(voice->stream_slot != NULL)
+    {
+        fluid_rvoice_stream_slot_start(voice->stream_slot, value);
+    }
 }
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_voiceoff)
@@ -943,6 +1463,10 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_voiceoff)
 
     fluid_adsr_env_set_section(&voice->envlfo.volenv, FLUID_VOICE_ENVFINISHED);
     fluid_adsr_env_set_section(&voice->envlfo.modenv, FLUID_VOICE_ENVFINISHED);
+
+    /* silent at once, without the samples a delayed voice carries over into the next block */
+    voice->start_delay = 0;
+    voice->delay_pending = 0;
 }
 
 
@@ -27,6 +27,7 @@
 #include "fluid_lfo.h"
 #include "fluid_phase.h"
 #include "fluid_sfont.h"
+#include "fluid_rvoice_stream.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,6 +36,19 @@ typedef struct _fluid_rvoice_envlfo_t fluid_rvoice_envlfo_t;
 typedef struct _fluid_rvoice_dsp_t fluid_rvoice_dsp_t;
 typedef struct _fluid_rvoice_buffers_t fluid_rvoice_buffers_t;
 typedef struct _fluid_rvoice_t fluid_rvoice_t;
+typedef struct _fluid_rvoice_cache_entry_t fluid_rvoice_cache_entry_t;
+typedef struct _fluid_rvoice_event_t fluid_rvoice_event_t;
+
+struct _fluid_rvoice_event_t
+{
+    fluid_rvoice_function_t method;
+    void *object;
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+};
+
+/* Maximum number of parameter updates of a starting voice sent as one event, see
+ * fluid_rvoice_apply_param_block() */
+#define FLUID_RVOICE_PARAM_BLOCK_SIZE 64
 
 /* Smallest amplitude that can be perceived (full scale is +/- 0.5)
  * 16 bits => 96+4=100 dB dynamic range => 0.00001
@@ -51,23 +65,36 @@ enum fluid_loop
     FLUID_LOOP_UNTIL_RELEASE = 3
 };
 
+/* What an rvoice does with its entry of the voice cache, see fluid_rvoice_cache.h */
+enum fluid_rvoice_cache_mode
+{
+    FLUID_RVOICE_CACHE_OFF,     /* renders itself */
+    FLUID_RVOICE_CACHE_RECORD,  /* renders itself and records the blocks into the entry */
+    FLUID_RVOICE_CACHE_PLAY     /* copies the blocks from the entry */
+};
+
+/* Modulation paths fluid_rvoice_write() evaluates for a voice, kept up to date by the setters
+ * of their amounts. A voice without any of them, e.g. a drum or an organ, skips them. */
+enum fluid_rvoice_feature
+{
+    FLUID_RVOICE_PITCH_MOD = 1 << 0,    /* the envelope or an LFO modulates the pitch */
+    FLUID_RVOICE_VOL_MOD = 1 << 1,      /* the mod LFO modulates the volume */
+    FLUID_RVOICE_FC_MOD = 1 << 2        /* the envelope or the mod LFO modulates the filter cutoff */
+};
+
 /*
  * rvoice ticks-based parameters
  * These parameters must be updated even if the voice is currently quiet.
+ *
+ * The small fields come first, so that they share a cache line with the current
+ * values of the envelopes, see fluid_adsr_env_t.
  */
 struct _fluid_rvoice_envlfo_t
 {
     /* Note-off minimum length */
     unsigned int ticks;
     unsigned int noteoff_ticks;
-
-    /* vol env */
-    fluid_adsr_env_t volenv;
-
-    /* mod env */
-    fluid_adsr_env_t modenv;
-    fluid_real_t modenv_to_fc;
-    fluid_real_t modenv_to_pitch;
+    unsigned int features;      /* enum fluid_rvoice_feature */
 
     /* mod lfo */
     fluid_lfo_t modlfo;
@@ -78,24 +105,50 @@ struct _fluid_rvoice_envlfo_t
     /* vib lfo */
     fluid_lfo_t viblfo;
     fluid_real_t viblfo_to_pitch;
+
+    /* mod env */
+    fluid_real_t modenv_to_fc;
+    fluid_real_t modenv_to_pitch;
+
+    /* vol env */
+    fluid_adsr_env_t volenv;
+
+    /* mod env */
+    fluid_adsr_env_t modenv;
 };
 
 /*
  * rvoice parameters needed for dsp interpolation
+ *
+ * Ordered by how often they are read: the fields needed for every block of a playing voice
+ * first, the ones only needed when parameters change last.
  */
 struct _fluid_rvoice_dsp_t
 {
-    /* interpolation method, as in fluid_interp in fluidsynth.h */
-    enum fluid_interp interp_method;
-    enum fluid_loop samplemode;
+    fluid_sample_t *sample;
 
-    /* Flag that is set as soon as the first loop is completed. */
-    char has_looped;
+    /* Dynamic input to the interpolator below */
 
-    /* Flag that initiates, that sample-related parameters have to be checked. */
-    char check_sample_sanity_flag;
+    fluid_phase_t phase;             /* the phase (current sample offset) of the sample wave */
+    fluid_real_t phase_incr;	/* the phase increment for the next FLUID_BUFSIZE samples */
 
-    fluid_sample_t *sample;
+    /* Stuff needed for phase calculations */
+
+    fluid_real_t pitch;              /* the pitch in midicents */
+    fluid_real_t root_pitch_hz;      /* the base note of the note in hz */
+    fluid_real_t output_rate;
+
+    /* Stuff needed for portamento calculations */
+    fluid_real_t pitchoffset;        /* the portamento range in midicents */
+    fluid_real_t pitchinc;           /* the portamento increment in midicents */
+
+    /* Stuff needed for amplitude calculations */
+
+    fluid_real_t attenuation;        /* the attenuation in centibels */
+    fluid_real_t synth_gain; 	/* master gain */
+    fluid_real_t noise_floor;       /* amplitude below which the voice is inaudible, see synth.noise-floor */
+    fluid_real_t amplitude_that_reaches_noise_floor_nonloop;
+    fluid_real_t amplitude_that_reaches_noise_floor_loop;
 
     /* sample and loop start and end points (offset in sample memory).  */
     int start;
@@ -103,31 +156,27 @@ struct _fluid_rvoice_dsp_t
     int loopstart;
     int loopend;	/* Note: first point following the loop (superimposed on loopstart) */
 
-    /* Stuff needed for portamento calculations */
-    fluid_real_t pitchoffset;        /* the portamento range in midicents */
-    fluid_real_t pitchinc;           /* the portamento increment in midicents */
+    /* interpolation method, as in fluid_interp in fluidsynth.h */
+    enum fluid_interp interp_method;
+    enum fluid_loop samplemode;
+    char interp_auto;               /* TRUE if interp_method is chosen every block, see FLUID_INTERP_AUTO */
+    char float_interp;              /* TRUE to interpolate in single precision, see synth.float-interpolation */
 
-    /* Stuff needed for phase calculations */
+    /* Flag that is set as soon as the first loop is completed. */
+    char has_looped;
 
-    fluid_real_t pitch;              /* the pitch in midicents */
-    fluid_real_t root_pitch_hz;      /* the base note of the note in hz */
-    fluid_real_t output_rate;
+    /* Flag: the current block is below the noise floor, see fluid_rvoice_calc_amp() */
+    char inaudible;
 
-    /* Stuff needed for amplitude calculations */
+    /* Flag that initiates, that sample-related parameters have to be checked. */
+    char check_sample_sanity_flag;
+
+    /* only read when parameters change */
 
-    fluid_real_t attenuation;        /* the attenuation in centibels */
     fluid_real_t prev_attenuation;   /* the previous attenuation in centibels
 					used by fluid_rvoice_multi_retrigger_attack() */
     fluid_real_t min_attenuation_cB; /* Estimate on the smallest possible attenuation
 					  * during the lifetime of the voice */
-    fluid_real_t amplitude_that_reaches_noise_floor_nonloop;
-    fluid_real_t amplitude_that_reaches_noise_floor_loop;
-    fluid_real_t synth_gain; 	/* master gain */
-
-    /* Dynamic input to the interpolator below */
-
-    fluid_phase_t phase;             /* the phase (current sample offset) of the sample wave */
-    fluid_real_t phase_incr;	/* the phase increment for the next FLUID_BUFSIZE samples */
 };
 
 /* Currently left, right, reverb, chorus. To be changed if we
@@ -156,18 +205,65 @@ struct _fluid_rvoice_buffers_t
 
 /*
  * Hard realtime parameters needed to synthesize a voice
+ *
+ * The state read for every block comes first, so that rendering a voice touches as few
+ * cache lines as possible, the setup and bookkeeping fields follow after it.
  */
 struct _fluid_rvoice_t
 {
-    fluid_rvoice_envlfo_t envlfo;
     fluid_rvoice_dsp_t dsp;
+    fluid_rvoice_envlfo_t envlfo;
     fluid_iir_filter_t resonant_filter; /* IIR resonant dsp filter */
     fluid_iir_filter_t resonant_custom_filter; /* optional custom/general-purpose IIR resonant filter */
     fluid_rvoice_buffers_t buffers;
+
+    /* running estimate of the cost to render one block of this voice, see fluid_rvoice_update_cost() */
+    int cost;
+
+    /* if not NULL, where the voice tells the streaming thread its position, see synth.sample-streaming */
+    fluid_rvoice_stream_slot_t *stream_slot;
+
+    /* if not NULL, the voice of the other sample of a stereo pair, which this voice plays along with
+     * its own sample instead of letting it play by itself, see synth.stereo-voices */
+    fluid_rvoice_t *stereo;
+
+    /* channel and preset slot the voice is accounted to, -1 if none, see synth.cpu-accounting */
+    int perf_chan;
+    int perf_preset;
+
+    /* the note the voice plays, published by synth.voice-snapshot */
+    int note_chan;
+    int note_key;
+    int note_vel;
+
+    /* entry of the voice cache and the block the voice is at, see synth.voice-cache */
+    enum fluid_rvoice_cache_mode cache_mode;
+    fluid_rvoice_cache_entry_t *cache_entry;
+    int cache_block;
+
+    /* the output of the voice is delayed by start_delay samples, to start it at the sample offset of its
+     * noteon within the block, delay_buf carries the last delay_pending samples of a block into the next
+     * one, see synth.sample-accurate-events */
+    unsigned int start_delay;
+    int delay_pending;
+    fluid_real_t delay_buf[FLUID_BUFSIZE];
+
+    /* parameter updates collected by the synth thread from the noteon until the voice starts, only read by
+     * fluid_rvoice_apply_param_block() */
+    fluid_rvoice_event_t param_block[FLUID_RVOICE_PARAM_BLOCK_SIZE];
 };
 
 
-int fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf);
+/* Relative cost units of rendering a single block, used to balance the mixer threads */
+#define FLUID_RVOICE_COST_SILENT     (4)  /* only envelopes, LFOs and phase are advanced */
+#define FLUID_RVOICE_COST_FILTER     (24) /* per active IIR filter */
+#define FLUID_RVOICE_COST_DEFAULT    (40) /* initial estimate for a freshly started voice */
+
+/* Returned by fluid_rvoice_cache_play() if the block still needs to be interpolated */
+#define FLUID_RVOICE_WRITE_INTERPOLATE (FLUID_BUFSIZE + 1)
+
+int fluid_rvoice_interp_cost(int interp_method);
+int fluid_rvoice_write(fluid_rvoice_t *voice, fluid_real_t *dsp_buf, fluid_real_t *stereo_buf);
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_amp);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_mapping);
@@ -175,8 +271,10 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_buffers_set_mapping);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_noteoff);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_voiceoff);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_reset);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_apply_param_block);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_multi_retrigger_attack);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_portamento);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_legato);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_output_rate);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_interp_method);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_root_pitch_hz);
@@ -190,16 +288,24 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modlfo_to_fc);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modenv_to_fc);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_modenv_to_pitch);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_synth_gain);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_noise_floor);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_start);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_end);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_loopstart);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_loopend);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_samplemode);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_sample);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_perf_slots);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_note);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_set_start_delay);
 
 
 int fluid_rvoice_dsp_silence(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf, int looping);
 int fluid_rvoice_dsp_interpolate(fluid_rvoice_t *voice, fluid_real_t *FLUID_RESTRICT dsp_buf, int is_looping);
+int fluid_rvoice_dsp_interpolate_pair(fluid_rvoice_t *voice, fluid_sample_t *sample,
+                                      fluid_real_t *FLUID_RESTRICT dsp_buf, int is_looping);
+void fluid_rvoice_dsp_prefetch(const fluid_rvoice_t *rvoice, int is_looping);
+void fluid_rvoice_dsp_set_simd_enabled(int enabled);
 
 
 /*
@@ -240,6 +346,30 @@ fluid_rvoice_get_sample(const short int *FLUID_RESTRICT dsp_msb, const char *FLU
     }
 }
 
+/*
+ * The compressed sample format, see synth.sample-format. The points are stored in blocks of
+ * FLUID_SAMPLE_BLOCK_POINTS, each block being a byte holding the exponent shared by the block,
+ * followed by a signed 8 bit mantissa per point. Like fluid_rvoice_get_sample(), a point
+ * decodes to the scale of 24 bit samples.
+ */
+#define FLUID_SAMPLE_BLOCK_POINTS 32
+#define FLUID_SAMPLE_BLOCK_SIZE (FLUID_SAMPLE_BLOCK_POINTS + 1)
+
+/* The largest exponent, fits all 24 bit points into the mantissas */
+#define FLUID_SAMPLE_BLOCK_MAX_SHIFT 17
+
+/* Number of bytes taking count points */
+#define FLUID_SAMPLE_COMPRESSED_SIZE(count) \
+    ((((count) + FLUID_SAMPLE_BLOCK_POINTS - 1) / FLUID_SAMPLE_BLOCK_POINTS) * FLUID_SAMPLE_BLOCK_SIZE)
+
+static FLUID_INLINE int32_t
+fluid_rvoice_get_sample_compressed(const signed char *FLUID_RESTRICT data, unsigned int idx)
+{
+    const signed char *block = data + (idx / FLUID_SAMPLE_BLOCK_POINTS) * FLUID_SAMPLE_BLOCK_SIZE;
+
+    return (int32_t)block[1 + idx % FLUID_SAMPLE_BLOCK_POINTS] * ((int32_t)1 << block[0]);
+}
+
 #ifdef __cplusplus
 }
 #endif
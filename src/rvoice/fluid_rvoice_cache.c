@@ -0,0 +1,453 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_rvoice_cache.h"
+
+/* Blocks between two copies of the state of a recording rvoice */
+#define FLUID_RVOICE_CACHE_SNAPSHOT 16
+
+enum fluid_rvoice_cache_status
+{
+    FLUID_RVOICE_CACHE_EMPTY,
+    FLUID_RVOICE_CACHE_RECORDING,
+    FLUID_RVOICE_CACHE_READY
+};
+
+/* The part of an rvoice that determines its mono output */
+typedef struct _fluid_rvoice_cache_state_t
+{
+    fluid_rvoice_dsp_t dsp;
+    fluid_rvoice_envlfo_t envlfo;
+    fluid_iir_filter_t resonant_filter;
+    fluid_iir_filter_t resonant_custom_filter;
+} fluid_rvoice_cache_state_t;
+
+struct _fluid_rvoice_cache_entry_t
+{
+    enum fluid_rvoice_cache_status status;
+    int stale;                      /* TRUE if the entry mustn't be found anymore, see fluid_rvoice_cache_clear() */
+    unsigned int hash;              /* of key */
+    unsigned int stamp;             /* when the entry was used last, for evicting the least recently used */
+    fluid_atomic_int_t users;       /* Atomic: number of rvoices recording or playing the entry */
+
+    int max_blocks;                 /* number of blocks that can be recorded */
+    int blocks;                     /* number of recorded blocks */
+    int finished;                   /* TRUE if the rvoice finished in the last recorded block */
+    int last_count;                 /* samples written in the last recorded block */
+
+    fluid_rvoice_cache_state_t key;     /* the state of the rvoice when it was added to the mixer */
+    fluid_rvoice_cache_state_t final;   /* the state after the last recorded block, unless finished */
+    fluid_rvoice_cache_state_t *snapshots;  /* the state before every FLUID_RVOICE_CACHE_SNAPSHOT'th block */
+    fluid_real_t *data;             /* the recorded blocks */
+};
+
+struct _fluid_rvoice_cache_t
+{
+    int count;
+    int max_blocks;
+    unsigned int clock;
+    int hits;
+    fluid_rvoice_cache_entry_t *entries;
+    fluid_rvoice_cache_state_t *snapshots;
+    fluid_real_t *data;
+    fluid_rvoice_cache_state_t key;     /* key of the rvoice being looked up */
+};
+
+static void
+fluid_rvoice_cache_save(const fluid_rvoice_t *voice, fluid_rvoice_cache_state_t *state)
+{
+    FLUID_MEMCPY(&state->dsp, &voice->dsp, sizeof(state->dsp));
+    FLUID_MEMCPY(&state->envlfo, &voice->envlfo, sizeof(state->envlfo));
+    FLUID_MEMCPY(&state->resonant_filter, &voice->resonant_filter, sizeof(state->resonant_filter));
+    FLUID_MEMCPY(&state->resonant_custom_filter, &voice->resonant_custom_filter, sizeof(state->resonant_custom_filter));
+}
+
+static void
+fluid_rvoice_cache_restore(fluid_rvoice_t *voice, const fluid_rvoice_cache_state_t *state)
+{
+    FLUID_MEMCPY(&voice->dsp, &state->dsp, sizeof(state->dsp));
+    FLUID_MEMCPY(&voice->envlfo, &state->envlfo, sizeof(state->envlfo));
+    FLUID_MEMCPY(&voice->resonant_filter, &state->resonant_filter, sizeof(state->resonant_filter));
+    FLUID_MEMCPY(&voice->resonant_custom_filter, &state->resonant_custom_filter, sizeof(state->resonant_custom_filter));
+}
+
+/* FNV-1a */
+static unsigned int
+fluid_rvoice_cache_hash(const fluid_rvoice_cache_state_t *key)
+{
+    const unsigned char *bytes = (const unsigned char *)key;
+    unsigned int hash = 2166136261u;
+    unsigned int i;
+
+    for(i = 0; i < sizeof(*key); i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * Create a voice cache.
+ * @param entries Number of notes that can be cached
+ * @param blocks Maximum number of blocks recorded per note
+ * @return New cache or NULL if out of memory (error message logged)
+ */
+fluid_rvoice_cache_t *
+new_fluid_rvoice_cache(int entries, int blocks)
+{
+    int snapshots = (blocks + FLUID_RVOICE_CACHE_SNAPSHOT - 1) / FLUID_RVOICE_CACHE_SNAPSHOT;
+    fluid_rvoice_cache_t *cache = FLUID_NEW(fluid_rvoice_cache_t);
+    int i;
+
+    if(cache == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(cache, 0, sizeof(*cache));
+    cache->count = entries;
+    cache->max_blocks = blocks;
+    cache->entries = FLUID_ARRAY(fluid_rvoice_cache_entry_t, entries);
+    cache->snapshots = FLUID_ARRAY(fluid_rvoice_cache_state_t, entries * snapshots);
+    cache->data = FLUID_ARRAY(fluid_real_t, (size_t)entries * blocks * FLUID_BUFSIZE);
+
+    if(cache->entries == NULL || cache->snapshots == NULL || cache->data == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_rvoice_cache(cache);
+        return NULL;
+    }
+
+    /* all keys are compared bytewise, including their padding */
+    FLUID_MEMSET(cache->entries, 0, entries * sizeof(*cache->entries));
+
+    for(i = 0; i < entries; i++)
+    {
+        cache->entries[i].max_blocks = blocks;
+        cache->entries[i].snapshots = &cache->snapshots[i * snapshots];
+        cache->entries[i].data = &cache->data[(size_t)i * blocks * FLUID_BUFSIZE];
+    }
+
+    return cache;
+}
+
+void
+delete_fluid_rvoice_cache(fluid_rvoice_cache_t *cache)
+{
+    fluid_return_if_fail(cache != NULL);
+
+    FLUID_FREE(cache->entries);
+    FLUID_FREE(cache->snapshots);
+    FLUID_FREE(cache->data);
+    FLUID_FREE(cache);
+}
+
+/* Gets the key of an rvoice that has just been added to the mixer. The fields left over from
+ * the previous note, which are set before they're used, don't belong to it. */
+static void
+fluid_rvoice_cache_get_key(const fluid_rvoice_t *voice, fluid_rvoice_cache_state_t *key)
+{
+    fluid_rvoice_cache_save(voice, key);
+
+    key->dsp.phase = 0;
+    key->dsp.phase_incr = 0;
+    key->dsp.amplitude_that_reaches_noise_floor_loop = 0;
+}
+
+/* Stops the rvoice from using its entry */
+static void
+fluid_rvoice_cache_release(fluid_rvoice_t *voice)
+{
+    fluid_atomic_int_add(&voice->cache_entry->users, -1);
+    voice->cache_entry = NULL;
+    voice->cache_mode = FLUID_RVOICE_CACHE_OFF;
+}
+
+/* Makes the blocks recorded so far available to other rvoices */
+static void
+fluid_rvoice_cache_commit(fluid_rvoice_t *voice, int finished, int last_count)
+{
+    fluid_rvoice_cache_entry_t *entry = voice->cache_entry;
+
+    entry->blocks = voice->cache_block;
+    entry->finished = finished;
+    entry->last_count = last_count;
+    entry->status = (entry->blocks > 0) ? FLUID_RVOICE_CACHE_READY : FLUID_RVOICE_CACHE_EMPTY;
+
+    fluid_rvoice_cache_release(voice);
+}
+
+/**
+ * Look up an rvoice that has just been added to the mixer. It plays from the entry
+ * if its state has been recorded before, otherwise it records into the least
+ * recently used entry. Must only be called by the thread dispatching the rvoice events.
+ */
+void
+fluid_rvoice_cache_start(fluid_rvoice_cache_t *cache, fluid_rvoice_t *voice)
+{
+    fluid_rvoice_cache_entry_t *entry, *victim = NULL;
+    unsigned int hash;
+    int i;
+
+    voice->cache_mode = FLUID_RVOICE_CACHE_OFF;
+    voice->cache_entry = NULL;
+    voice->cache_block = 0;
+
+    /* the interpolation of FLUID_INTERP_AUTO and the skipping of inaudible blocks depend on
+     * the amplitudes of the buffers, which aren't part of the key */
+    if(cache == NULL || voice->dsp.sample == NULL || voice->dsp.interp_auto
+            || voice->dsp.sample->stream_preload != 0)
+    {
+        return;
+    }
+
+    fluid_rvoice_cache_get_key(voice, &cache->key);
+    hash = fluid_rvoice_cache_hash(&cache->key);
+    cache->clock++;
+
+    for(i = 0; i < cache->count; i++)
+    {
+        entry = &cache->entries[i];
+
+        if(entry->status != FLUID_RVOICE_CACHE_EMPTY && !entry->stale && entry->hash == hash
+                && memcmp(&entry->key, &cache->key, sizeof(cache->key)) == 0)
+        {
+            if(entry->status == FLUID_RVOICE_CACHE_READY)
+            {
+                fluid_atomic_int_inc(&entry->users);
+                entry->stamp = cache->clock;
+                cache->hits++;
+
+                voice->cache_mode = FLUID_RVOICE_CACHE_PLAY;
+                voice->cache_entry = entry;
+            }
+
+            /* still being recorded by another rvoice */
+            return;
+        }
+
+        if(fluid_atomic_int_get(&entry->users) == 0
+                && (victim == NULL || entry->status == FLUID_RVOICE_CACHE_EMPTY || entry->stale
+                    || (victim->status != FLUID_RVOICE_CACHE_EMPTY && !victim->stale && entry->stamp < victim->stamp)))
+        {
+            victim = entry;
+        }
+    }
+
+    if(victim == NULL)
+    {
+        return;
+    }
+
+    FLUID_MEMCPY(&victim->key, &cache->key, sizeof(cache->key));
+    victim->hash = hash;
+    victim->stamp = cache->clock;
+    victim->stale = FALSE;
+    victim->status = FLUID_RVOICE_CACHE_RECORDING;
+    victim->blocks = 0;
+    fluid_atomic_int_set(&victim->users, 1);
+
+    voice->cache_mode = FLUID_RVOICE_CACHE_RECORD;
+    voice->cache_entry = victim;
+}
+
+/**
+ * Called by the mixer when the rvoice has finished or is removed. A recording that
+ * didn't end by itself is discarded.
+ */
+void
+fluid_rvoice_cache_stop(fluid_rvoice_t *voice)
+{
+    if(voice->cache_mode == FLUID_RVOICE_CACHE_RECORD)
+    {
+        voice->cache_block = 0;
+        fluid_rvoice_cache_commit(voice, FALSE, 0);
+    }
+    else if(voice->cache_mode == FLUID_RVOICE_CACHE_PLAY)
+    {
+        fluid_rvoice_cache_release(voice);
+    }
+}
+
+/**
+ * Make sure that no entry is found anymore, e.g. because the samples of the keys may be
+ * freed. Must only be called by the thread dispatching the rvoice events.
+ */
+void
+fluid_rvoice_cache_clear(fluid_rvoice_cache_t *cache)
+{
+    int i;
+
+    for(i = 0; i < cache->count; i++)
+    {
+        cache->entries[i].stale = TRUE;
+    }
+}
+
+/**
+ * Number of rvoices that have been played from the cache.
+ */
+int
+fluid_rvoice_cache_get_hits(const fluid_rvoice_cache_t *cache)
+{
+    return cache->hits;
+}
+
+/**
+ * Return the memory used by the cache in bytes, including the recorded blocks.
+ */
+size_t
+fluid_rvoice_cache_get_memory(const fluid_rvoice_cache_t *cache)
+{
+    size_t snapshots = (cache->max_blocks + FLUID_RVOICE_CACHE_SNAPSHOT - 1) / FLUID_RVOICE_CACHE_SNAPSHOT;
+
+    return sizeof(*cache)
+           + cache->count * (sizeof(*cache->entries) + snapshots * sizeof(*cache->snapshots))
+           + (size_t)cache->count * cache->max_blocks * FLUID_BUFSIZE * sizeof(*cache->data);
+}
+
+/**
+ * Copy the next recorded block of an rvoice playing from the cache.
+ * @return Like fluid_rvoice_write(), or #FLUID_RVOICE_WRITE_INTERPOLATE if the recorded
+ *   blocks are exhausted and the rvoice must render the block itself.
+ */
+int
+fluid_rvoice_cache_play(fluid_rvoice_t *voice, fluid_real_t *dsp_buf)
+{
+    fluid_rvoice_cache_entry_t *entry = voice->cache_entry;
+    int block = voice->cache_block;
+    int count = FLUID_BUFSIZE;
+
+    if(block == entry->blocks)
+    {
+        /* continue from where the recording stopped */
+        fluid_rvoice_cache_restore(voice, &entry->final);
+        fluid_rvoice_cache_release(voice);
+        return FLUID_RVOICE_WRITE_INTERPOLATE;
+    }
+
+    if(entry->finished && block == entry->blocks - 1)
+    {
+        count = entry->last_count;
+    }
+
+    FLUID_MEMCPY(dsp_buf, &entry->data[block * FLUID_BUFSIZE], count * sizeof(fluid_real_t));
+    voice->cache_block++;
+
+    return count;
+}
+
+/**
+ * Called before a recording rvoice renders a block.
+ */
+void
+fluid_rvoice_cache_record_begin(fluid_rvoice_t *voice)
+{
+    fluid_rvoice_cache_entry_t *entry = voice->cache_entry;
+    int block = voice->cache_block;
+
+    if(block % FLUID_RVOICE_CACHE_SNAPSHOT == 0)
+    {
+        fluid_rvoice_cache_save(voice, &entry->snapshots[block / FLUID_RVOICE_CACHE_SNAPSHOT]);
+    }
+
+    /* the recording may have to stop before this block */
+    fluid_rvoice_cache_save(voice, &entry->final);
+}
+
+/**
+ * Called after a recording rvoice has rendered a block.
+ * @param count The result of fluid_rvoice_write()
+ */
+void
+fluid_rvoice_cache_record_end(fluid_rvoice_t *voice, const fluid_real_t *dsp_buf, int count)
+{
+    fluid_rvoice_cache_entry_t *entry = voice->cache_entry;
+
+    if(count == -1)
+    {
+        /* a skipped block depends on the amplitudes of the buffers */
+        fluid_rvoice_cache_commit(voice, FALSE, 0);
+        return;
+    }
+
+    FLUID_MEMCPY(&entry->data[voice->cache_block * FLUID_BUFSIZE], dsp_buf, count * sizeof(fluid_real_t));
+    voice->cache_block++;
+
+    if(count < FLUID_BUFSIZE)
+    {
+        fluid_rvoice_cache_commit(voice, TRUE, count);
+    }
+    else if(voice->cache_block == entry->max_blocks)
+    {
+        fluid_rvoice_cache_save(voice, &entry->final);
+        fluid_rvoice_cache_commit(voice, FALSE, FLUID_BUFSIZE);
+    }
+}
+
+/**
+ * Sent by the synth before the parameters of a started rvoice change. A recording rvoice
+ * keeps the blocks recorded so far, an rvoice playing from the cache catches up with
+ * rendering, so that the change applies to its actual state.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_cache_leave)
+{
+    fluid_rvoice_t *voice = obj;
+    fluid_rvoice_cache_entry_t *entry = voice->cache_entry;
+    fluid_real_t dsp_buf[FLUID_BUFSIZE];
+    int block = voice->cache_block;
+    int snapshot;
+
+    if(voice->cache_mode == FLUID_RVOICE_CACHE_RECORD)
+    {
+        fluid_rvoice_cache_save(voice, &entry->final);
+        fluid_rvoice_cache_commit(voice, FALSE, FLUID_BUFSIZE);
+        return;
+    }
+
+    if(voice->cache_mode != FLUID_RVOICE_CACHE_PLAY)
+    {
+        return;
+    }
+
+    if(block >= entry->blocks)
+    {
+        /* either finished or just about to continue from the final state */
+        snapshot = block;
+
+        if(!entry->finished)
+        {
+            fluid_rvoice_cache_restore(voice, &entry->final);
+        }
+    }
+    else
+    {
+        snapshot = block - block % FLUID_RVOICE_CACHE_SNAPSHOT;
+        fluid_rvoice_cache_restore(voice, &entry->snapshots[snapshot / FLUID_RVOICE_CACHE_SNAPSHOT]);
+    }
+
+    fluid_rvoice_cache_release(voice);
+
+    for(; snapshot < block; snapshot++)
+    {
+        fluid_rvoice_write(voice, dsp_buf, NULL);
+    }
+}
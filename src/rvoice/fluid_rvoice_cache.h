@@ -0,0 +1,67 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLUID_RVOICE_CACHE_H
+#define _FLUID_RVOICE_CACHE_H
+
+#include "fluid_rvoice.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cache of rendered notes, see synth.voice-cache.
+ *
+ * The mono output of an rvoice only depends on its state when it starts, as long as
+ * nothing changes its parameters afterwards. When an rvoice is added to the mixer, its
+ * state is looked up in the cache. If it isn't found, the rvoice records its blocks into
+ * a free entry, together with a copy of its state every few blocks. If it is found, the
+ * rvoice copies the recorded blocks instead of rendering them.
+ *
+ * Before the parameters of a started rvoice change, the synth sends it
+ * fluid_rvoice_cache_leave(). An rvoice playing from the cache then restores the
+ * closest earlier copy of the state and renders the few blocks up to where it is, so
+ * that it continues as if it had been rendered all the time.
+ *
+ * Entries are only looked up and evicted by the thread dispatching the rvoice events,
+ * while the render threads record and play them.
+ */
+typedef struct _fluid_rvoice_cache_t fluid_rvoice_cache_t;
+
+fluid_rvoice_cache_t *new_fluid_rvoice_cache(int entries, int blocks);
+void delete_fluid_rvoice_cache(fluid_rvoice_cache_t *cache);
+
+void fluid_rvoice_cache_start(fluid_rvoice_cache_t *cache, fluid_rvoice_t *voice);
+void fluid_rvoice_cache_stop(fluid_rvoice_t *voice);
+void fluid_rvoice_cache_clear(fluid_rvoice_cache_t *cache);
+int fluid_rvoice_cache_get_hits(const fluid_rvoice_cache_t *cache);
+size_t fluid_rvoice_cache_get_memory(const fluid_rvoice_cache_t *cache);
+
+int fluid_rvoice_cache_play(fluid_rvoice_t *voice, fluid_real_t *dsp_buf);
+void fluid_rvoice_cache_record_begin(fluid_rvoice_t *voice);
+void fluid_rvoice_cache_record_end(fluid_rvoice_t *voice, const fluid_real_t *dsp_buf, int count);
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_cache_leave);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_RVOICE_CACHE_H */
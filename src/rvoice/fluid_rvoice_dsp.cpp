@@ -49,13 +49,38 @@
 extern "C" const fluid_real_t *const interp_coeff_linear;
 extern "C" const fluid_real_t *const interp_coeff;
 extern "C" const fluid_real_t *const sinc_table7;
+extern "C" const fluid_real_t *const sinc_table16;
 
-template<bool IS_24BIT>
+#if WITH_FIXED_POINT
+extern "C" const int32_t *const interp_coeff_fixed;
+extern "C" const int32_t *const sinc_table7_fixed;
+#endif
+
+/* How the sample data points are stored, selects the specialization of the DSP functions */
+enum fluid_rvoice_dsp_format
+{
+    FLUID_RVOICE_DSP_S16,   /* 16 bit data only */
+    FLUID_RVOICE_DSP_S24,   /* 16 bit data plus the least significant byte of 24 bit samples */
+    FLUID_RVOICE_DSP_FLOAT, /* pre-converted data, see synth.sample-format */
+    FLUID_RVOICE_DSP_COMPRESSED /* blocks of 8 bit mantissas, see fluid_rvoice_get_sample_compressed() */
+};
+
+template<int FORMAT>
 static FLUID_INLINE fluid_real_t
-fluid_rvoice_get_float_sample(const short int *FLUID_RESTRICT dsp_msb, const char *FLUID_RESTRICT dsp_lsb, unsigned int idx)
+fluid_rvoice_get_float_sample(const short int *FLUID_RESTRICT dsp_msb, const char *FLUID_RESTRICT dsp_lsb,
+                              const fluid_real_t *FLUID_RESTRICT dsp_float,
+                              const signed char *FLUID_RESTRICT dsp_compressed, unsigned int idx)
 {
     int32_t sample;
-    if (IS_24BIT)
+    if (FORMAT == FLUID_RVOICE_DSP_FLOAT)
+    {
+        return dsp_float[idx];
+    }
+    else if (FORMAT == FLUID_RVOICE_DSP_COMPRESSED)
+    {
+        sample = fluid_rvoice_get_sample_compressed(dsp_compressed, idx);
+    }
+    else if (FORMAT == FLUID_RVOICE_DSP_S24)
     {
         sample = fluid_rvoice_get_sample24(dsp_msb, dsp_lsb, idx);
     }
@@ -128,7 +153,7 @@ static int fluid_rvoice_dsp_silence_local(fluid_rvoice_t *rvoice, fluid_real_t *
 /* No interpolation. Just take the sample, which is closest to
   * the playback pointer.  Questionable quality, but very
   * efficient. */
-template<bool IS_24BIT, bool LOOPING>
+template<int FORMAT, bool LOOPING>
 static int
 fluid_rvoice_dsp_interpolate_none_local(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf)
 {
@@ -137,6 +162,8 @@ fluid_rvoice_dsp_interpolate_none_local(fluid_rvoice_t *rvoice, fluid_real_t *FL
     fluid_phase_t dsp_phase_incr;
     const short int *FLUID_RESTRICT dsp_data = voice->sample->data;
     const char *FLUID_RESTRICT dsp_data24 = voice->sample->data24;
+    const fluid_real_t *FLUID_RESTRICT dsp_data_float = voice->sample->data_float;
+    const signed char *FLUID_RESTRICT dsp_data_compressed = voice->sample->data_compressed;
     unsigned short dsp_i = 0;
     unsigned int dsp_phase_index;
     unsigned int end_index;
@@ -153,7 +180,7 @@ fluid_rvoice_dsp_interpolate_none_local(fluid_rvoice_t *rvoice, fluid_real_t *FL
         /* interpolate sequence of sample points */
         for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
         {
-            fluid_real_t sample = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index);
+            fluid_real_t sample = fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, dsp_phase_index);
             
             dsp_buf[dsp_i] = sample;
 
@@ -191,7 +218,7 @@ fluid_rvoice_dsp_interpolate_none_local(fluid_rvoice_t *rvoice, fluid_real_t *FL
  * Returns number of samples processed (usually FLUID_BUFSIZE but could be
  * smaller if end of sample occurs).
  */
-template<bool IS_24BIT, bool LOOPING>
+template<int FORMAT, bool LOOPING>
 static int
 fluid_rvoice_dsp_interpolate_linear_local(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf)
 {
@@ -200,6 +227,8 @@ fluid_rvoice_dsp_interpolate_linear_local(fluid_rvoice_t *rvoice, fluid_real_t *
     fluid_phase_t dsp_phase_incr;
     const short int *FLUID_RESTRICT dsp_data = voice->sample->data;
     const char *FLUID_RESTRICT dsp_data24 = voice->sample->data24;
+    const fluid_real_t *FLUID_RESTRICT dsp_data_float = voice->sample->data_float;
+    const signed char *FLUID_RESTRICT dsp_data_compressed = voice->sample->data_compressed;
     unsigned short dsp_i = 0;
     unsigned int dsp_phase_index;
     unsigned int end_index;
@@ -215,11 +244,11 @@ fluid_rvoice_dsp_interpolate_linear_local(fluid_rvoice_t *rvoice, fluid_real_t *
     /* 2nd interpolation point to use at end of loop or sample */
     if(LOOPING)
     {
-        point = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopstart);    /* loop start */
+        point = fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, voice->loopstart);    /* loop start */
     }
     else
     {
-        point = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->end);    /* duplicate end for samples no longer looping */
+        point = fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, voice->end);    /* duplicate end for samples no longer looping */
     }
 
     while(1)
@@ -232,8 +261,8 @@ fluid_rvoice_dsp_interpolate_linear_local(fluid_rvoice_t *rvoice, fluid_real_t *
             fluid_real_t sample;
             coeffs = &interp_coeff_linear[fluid_phase_fract_to_tablerow(dsp_phase) * LINEAR_INTERP_ORDER];
             
-            sample =  (coeffs[0] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[1] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 1));
+            sample =  (coeffs[0] * fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, dsp_phase_index)
+                     + coeffs[1] * fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, dsp_phase_index + 1));
                         
             dsp_buf[dsp_i] = sample;
 
@@ -256,7 +285,7 @@ fluid_rvoice_dsp_interpolate_linear_local(fluid_rvoice_t *rvoice, fluid_real_t *
             fluid_real_t sample;
             coeffs = &interp_coeff_linear[fluid_phase_fract_to_tablerow(dsp_phase) * LINEAR_INTERP_ORDER];
             
-            sample =  (coeffs[0] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
+            sample =  (coeffs[0] * fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, dsp_phase_index)
                      + coeffs[1] * point);
 
             dsp_buf[dsp_i] = sample;
@@ -292,318 +321,813 @@ fluid_rvoice_dsp_interpolate_linear_local(fluid_rvoice_t *rvoice, fluid_real_t *
     return (dsp_i);
 }
 
-/* 4th order (cubic) interpolation.
- * Returns number of samples processed (usually FLUID_BUFSIZE but could be
- * smaller if end of sample occurs).
+/* Hand-vectorized kernels for the main loops of the 4th and 7th order interpolators.
+ *
+ * Auto-vectorization of the scalar loops fails because every output sample depends on the
+ * phase of the previous one. The kernels below first compute the sample index and the
+ * coefficient row of a whole batch of output samples from the phase increment, and then
+ * evaluate all outputs of the batch in parallel. They are selected at runtime according
+ * to the features of the CPU and only used for 16 bit samples. 24 bit samples and the
+ * points near the start and end of the sample or loop are left to the scalar code.
  */
-template<bool IS_24BIT, bool LOOPING>
-static int
-fluid_rvoice_dsp_interpolate_4th_order_local(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf)
-{
-    fluid_rvoice_dsp_t *voice = &rvoice->dsp;
-    fluid_phase_t dsp_phase = voice->phase;
-    fluid_phase_t dsp_phase_incr;
-    const short int *FLUID_RESTRICT dsp_data = voice->sample->data;
-    const char *FLUID_RESTRICT dsp_data24 = voice->sample->data24;
-    unsigned short dsp_i = 0;
-    unsigned int dsp_phase_index;
-    unsigned int start_index, end_index;
-    fluid_real_t start_point, end_point1, end_point2;
-    const fluid_real_t *FLUID_RESTRICT coeffs;
 
-    /* Convert playback "speed" floating point value to phase index/fract */
-    fluid_phase_set_float(dsp_phase_incr, voice->phase_incr);
+/* processes as many complete batches as fit before end_index, returns the new dsp_i */
+typedef unsigned int (*fluid_rvoice_dsp_kernel_t)(const short int *FLUID_RESTRICT dsp_data,
+        fluid_real_t *FLUID_RESTRICT dsp_buf, unsigned int dsp_i,
+        fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr, unsigned int end_index);
 
-    /* last index before 4th interpolation point must be specially handled */
-    end_index = (LOOPING ? voice->loopend - 1 : voice->end) - 2;
+struct fluid_rvoice_dsp_kernels
+{
+    fluid_rvoice_dsp_kernel_t interp_4th;
+    fluid_rvoice_dsp_kernel_t interp_7th;
+    /* computing in single precision, see synth.float-interpolation */
+    fluid_rvoice_dsp_kernel_t interp_4th_single;
+    fluid_rvoice_dsp_kernel_t interp_7th_single;
+};
+
+/* The coefficient tables of the kernels computing in single precision. With enable-floats
+ * these are the tables of the interpolators, otherwise converted copies of them. */
+#if !WITH_FIXED_POINT
+static const float *interp_coeff_single = NULL;
+static const float *sinc_table7_single = NULL;
+#endif
+
+/* Computes index and coefficient table offset of the next N output samples.
+ * Returns false if the batch would exceed the output buffer or go past end_index. */
+template<int N, int ORDER>
+static FLUID_INLINE bool
+fluid_rvoice_dsp_batch_setup(fluid_phase_t dsp_phase, fluid_phase_t dsp_phase_incr,
+                             unsigned int dsp_i, unsigned int end_index,
+                             int *FLUID_RESTRICT index, int *FLUID_RESTRICT row)
+{
+    int k;
 
-    if(voice->has_looped)	/* set start_index and start point if looped or not */
+    if(dsp_i + N > FLUID_BUFSIZE
+            || fluid_phase_index(dsp_phase + (N - 1) * dsp_phase_incr) > end_index)
     {
-        start_index = voice->loopstart;
-        start_point = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopend - 1);	/* last point in loop (wrap around) */
+        return false;
     }
-    else
+
+    for(k = 0; k < N; k++)
     {
-        start_index = voice->start;
-        start_point = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->start);	/* just duplicate the point */
+        index[k] = (int)fluid_phase_index(dsp_phase);
+        row[k] = (int)fluid_phase_fract_to_tablerow(dsp_phase) * ORDER;
+        fluid_phase_incr(dsp_phase, dsp_phase_incr);
     }
 
-    /* get points off the end (loop start if looping, duplicate point if end) */
-    if(LOOPING)
+    return true;
+}
+
+#if WITH_FIXED_POINT
+/* The kernels of enable-fixed-point, for CPUs without an FPU. The 16 bit sample points are
+ * multiplied with coefficients of FLUID_INTERP_FIXED_BITS fractional bits and summed up in
+ * 64 bits, a single multiply-accumulate instruction on 32 bit microcontrollers. This leaves
+ * one conversion to floating point per output sample.
+ * Unlike the SIMD kernels they interpolate every point up to end_index, so that the output
+ * doesn't depend on where a block is split between them and the scalar code. */
+template<int ORDER>
+static unsigned int
+fluid_rvoice_dsp_interpolate_fixed(const short int *FLUID_RESTRICT dsp_data,
+                                   fluid_real_t *FLUID_RESTRICT dsp_buf, unsigned int dsp_i,
+                                   fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                                   unsigned int end_index)
+{
+    const int32_t *FLUID_RESTRICT table = (ORDER == CUBIC_INTERP_ORDER) ? interp_coeff_fixed : sinc_table7_fixed;
+    /* to the scale of fluid_rvoice_get_sample16() */
+    const fluid_real_t scale = (fluid_real_t)(1 << 8) / (fluid_real_t)(1 << FLUID_INTERP_FIXED_BITS);
+    fluid_phase_t phase = *dsp_phase;
+    int index, row, j;
+
+    while(fluid_rvoice_dsp_batch_setup<1, ORDER>(phase, dsp_phase_incr, dsp_i, end_index, &index, &row))
     {
-        end_point1 = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopstart);
-        end_point2 = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopstart + 1);
+        const short int *points = &dsp_data[index - (ORDER - 1) / 2];
+        const int32_t *coeffs = &table[row];
+        int64_t sum = 0;
+
+        for(j = 0; j < ORDER; j++)
+        {
+            sum += (int64_t)coeffs[j] * points[j];
+        }
+
+        dsp_buf[dsp_i++] = scale * (fluid_real_t)sum;
+        fluid_phase_incr(phase, dsp_phase_incr);
     }
-    else
+
+    *dsp_phase = phase;
+    return dsp_i;
+}
+
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLUID_DSP_X86_KERNELS 1
+#include <immintrin.h>
+
+/* The x86 kernels compute every output sample as a dot product of consecutive sample
+ * points with a coefficient row, which are both contiguous in memory, and then sum up the
+ * products of a batch horizontally. A row of at most 7 coefficients fits into 256 bits,
+ * which makes AVX2 the widest instruction set worth using: gathering the coefficients
+ * column-wise into 512 bit registers was found to be slower. */
+
+#define FLUID_DSP_AVX2_TARGET __attribute__((target("avx2,fma")))
+
+/* loads 4 consecutive 16 bit sample points scaled like fluid_rvoice_get_sample16() */
+FLUID_DSP_AVX2_TARGET static FLUID_INLINE __m128i
+fluid_dsp_avx2_points(const short int *p)
+{
+    return _mm_slli_epi32(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)p)), 8);
+}
+
+#if !WITH_FLOAT
+/* sums up each of the 4 vectors and stores the results to out[0..3] */
+FLUID_DSP_AVX2_TARGET static FLUID_INLINE void
+fluid_dsp_avx2_store_sums(fluid_real_t *out, const __m256d *p)
+{
+    __m256d s01 = _mm256_hadd_pd(p[0], p[1]);
+    __m256d s23 = _mm256_hadd_pd(p[2], p[3]);
+
+    _mm256_storeu_pd(out, _mm256_add_pd(_mm256_permute2f128_pd(s01, s23, 0x20),
+                                        _mm256_permute2f128_pd(s01, s23, 0x31)));
+}
+
+FLUID_DSP_AVX2_TARGET static unsigned int
+fluid_rvoice_dsp_interpolate_4th_avx2(const short int *FLUID_RESTRICT dsp_data,
+                                      fluid_real_t *FLUID_RESTRICT dsp_buf, unsigned int dsp_i,
+                                      fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                                      unsigned int end_index)
+{
+    fluid_phase_t phase = *dsp_phase;
+    __m256d p[4];
+    int index[4], row[4];
+    int k;
+
+    while(fluid_rvoice_dsp_batch_setup<4, CUBIC_INTERP_ORDER>(phase, dsp_phase_incr, dsp_i, end_index, index, row))
     {
-        end_point1 = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->end);
-        end_point2 = end_point1;
+        for(k = 0; k < 4; k++)
+        {
+            __m128i points = fluid_dsp_avx2_points(&dsp_data[index[k] - 1]);
+            p[k] = _mm256_mul_pd(_mm256_loadu_pd(&interp_coeff[row[k]]), _mm256_cvtepi32_pd(points));
+        }
+
+        fluid_dsp_avx2_store_sums(&dsp_buf[dsp_i], p);
+
+        dsp_i += 4;
+        phase += 4 * dsp_phase_incr;
     }
 
-    while(1)
-    {
-        dsp_phase_index = fluid_phase_index(dsp_phase);
+    *dsp_phase = phase;
+    return dsp_i;
+}
 
-        /* interpolate first sample point (start or loop start) if needed */
-        for(; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+FLUID_DSP_AVX2_TARGET static unsigned int
+fluid_rvoice_dsp_interpolate_7th_avx2(const short int *FLUID_RESTRICT dsp_data,
+                                      fluid_real_t *FLUID_RESTRICT dsp_buf, unsigned int dsp_i,
+                                      fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                                      unsigned int end_index)
+{
+    fluid_phase_t phase = *dsp_phase;
+    __m256d p[4];
+    int index[4], row[4];
+    int k;
+
+    while(fluid_rvoice_dsp_batch_setup<4, SINC_INTERP_ORDER>(phase, dsp_phase_incr, dsp_i, end_index, index, row))
+    {
+        for(k = 0; k < 4; k++)
         {
-            fluid_real_t sample;
-            coeffs = &interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase) * CUBIC_INTERP_ORDER];
+            /* points idx-3..idx and idx..idx+3, the coefficient of the duplicated point idx
+             * is cleared in the second half, so that the row can be loaded without padding
+             * and nothing beyond idx+3 is read */
+            const short int *points = &dsp_data[index[k] - 3];
+            const fluid_real_t *coeffs = &sinc_table7[row[k]];
+            __m128i lo = fluid_dsp_avx2_points(points);
+            __m128i hi = fluid_dsp_avx2_points(points + 3);
+            __m256d c_hi = _mm256_blend_pd(_mm256_loadu_pd(coeffs + 3), _mm256_setzero_pd(), 1);
+
+            p[k] = _mm256_fmadd_pd(c_hi, _mm256_cvtepi32_pd(hi),
+                                   _mm256_mul_pd(_mm256_loadu_pd(coeffs), _mm256_cvtepi32_pd(lo)));
+        }
 
-            sample =  (coeffs[0] * start_point
-                     + coeffs[1] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[2] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 1)
-                     + coeffs[3] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 2));
-                        
-            dsp_buf[dsp_i] = sample;
+        fluid_dsp_avx2_store_sums(&dsp_buf[dsp_i], p);
 
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index(dsp_phase);
-        }
+        dsp_i += 4;
+        phase += 4 * dsp_phase_incr;
+    }
 
-        /* interpolate the sequence of sample points */
-        for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
-        {
-            fluid_real_t sample;
-            coeffs = &interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase) * CUBIC_INTERP_ORDER];
+    *dsp_phase = phase;
+    return dsp_i;
+}
+#endif
 
-            sample =  (coeffs[0] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 1)
-                     + coeffs[1] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[2] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 1)
-                     + coeffs[3] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 2));
+/* stores 4 single precision results to out[0..3] */
+FLUID_DSP_AVX2_TARGET static FLUID_INLINE void
+fluid_dsp_avx2_store4_single(fluid_real_t *out, __m128 s)
+{
+#if WITH_FLOAT
+    _mm_storeu_ps(out, s);
+#else
+    _mm256_storeu_pd(out, _mm256_cvtps_pd(s));
+#endif
+}
 
-            dsp_buf[dsp_i] = sample;
+/* stores 8 single precision results to out[0..7] */
+FLUID_DSP_AVX2_TARGET static FLUID_INLINE void
+fluid_dsp_avx2_store8_single(fluid_real_t *out, __m256 s)
+{
+#if WITH_FLOAT
+    _mm256_storeu_ps(out, s);
+#else
+    _mm256_storeu_pd(out, _mm256_cvtps_pd(_mm256_castps256_ps128(s)));
+    _mm256_storeu_pd(out + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(s, 1)));
+#endif
+}
 
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index(dsp_phase);
+/* The kernels computing in single precision, which process twice as many sample points per
+ * instruction. They are the only ones with enable-floats. */
+
+FLUID_DSP_AVX2_TARGET static unsigned int
+fluid_rvoice_dsp_interpolate_4th_avx2_single(const short int *FLUID_RESTRICT dsp_data,
+        fluid_real_t *FLUID_RESTRICT dsp_buf, unsigned int dsp_i,
+        fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+        unsigned int end_index)
+{
+    fluid_phase_t phase = *dsp_phase;
+    __m128 p[4];
+    int index[4], row[4];
+    int k;
+
+    while(fluid_rvoice_dsp_batch_setup<4, CUBIC_INTERP_ORDER>(phase, dsp_phase_incr, dsp_i, end_index, index, row))
+    {
+        for(k = 0; k < 4; k++)
+        {
+            __m128i points = fluid_dsp_avx2_points(&dsp_data[index[k] - 1]);
+            p[k] = _mm_mul_ps(_mm_loadu_ps(&interp_coeff_single[row[k]]), _mm_cvtepi32_ps(points));
         }
 
-        /* break out if buffer filled */
-        if(dsp_i >= FLUID_BUFSIZE)
+        fluid_dsp_avx2_store4_single(&dsp_buf[dsp_i], _mm_hadd_ps(_mm_hadd_ps(p[0], p[1]), _mm_hadd_ps(p[2], p[3])));
+
+        dsp_i += 4;
+        phase += 4 * dsp_phase_incr;
+    }
+
+    *dsp_phase = phase;
+    return dsp_i;
+}
+
+FLUID_DSP_AVX2_TARGET static unsigned int
+fluid_rvoice_dsp_interpolate_7th_avx2_single(const short int *FLUID_RESTRICT dsp_data,
+        fluid_real_t *FLUID_RESTRICT dsp_buf, unsigned int dsp_i,
+        fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+        unsigned int end_index)
+{
+    fluid_phase_t phase = *dsp_phase;
+    __m256 p[8];
+    int index[8], row[8];
+    int k;
+
+    while(fluid_rvoice_dsp_batch_setup<8, SINC_INTERP_ORDER>(phase, dsp_phase_incr, dsp_i, end_index, index, row))
+    {
+        __m256 s0123, s4567;
+
+        for(k = 0; k < 8; k++)
         {
-            break;
+            /* like the double precision kernel, both halves in one register */
+            const short int *points = &dsp_data[index[k] - 3];
+            const float *coeffs = &sinc_table7_single[row[k]];
+            __m128i lo = fluid_dsp_avx2_points(points);
+            __m128i hi = fluid_dsp_avx2_points(points + 3);
+            __m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(coeffs)),
+                                            _mm_blend_ps(_mm_loadu_ps(coeffs + 3), _mm_setzero_ps(), 1), 1);
+            __m256 s = _mm256_cvtepi32_ps(_mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+
+            p[k] = _mm256_mul_ps(c, s);
         }
 
-        end_index++;	/* we're now interpolating the 2nd to last point */
+        s0123 = _mm256_hadd_ps(_mm256_hadd_ps(p[0], p[1]), _mm256_hadd_ps(p[2], p[3]));
+        s4567 = _mm256_hadd_ps(_mm256_hadd_ps(p[4], p[5]), _mm256_hadd_ps(p[6], p[7]));
+        fluid_dsp_avx2_store8_single(&dsp_buf[dsp_i], _mm256_add_ps(_mm256_permute2f128_ps(s0123, s4567, 0x20),
+                                     _mm256_permute2f128_ps(s0123, s4567, 0x31)));
 
-        /* interpolate within 2nd to last point */
-        for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        dsp_i += 8;
+        phase += 8 * dsp_phase_incr;
+    }
+
+    *dsp_phase = phase;
+    return dsp_i;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define FLUID_DSP_NEON_KERNELS 1
+#include <arm_neon.h>
+
+/* Like on x86, every output sample is a dot product of a coefficient row with the sample
+ * points. */
+
+/* loads 4 consecutive 16 bit sample points scaled like fluid_rvoice_get_sample16() */
+static FLUID_INLINE int32x4_t
+fluid_dsp_neon_points(const short int *p)
+{
+    return vshlq_n_s32(vmovl_s16(vld1_s16(p)), 8);
+}
+
+/* dot product of 4 coefficients with 4 sample points, in single precision */
+static FLUID_INLINE float
+fluid_dsp_neon_dot4_single(const float *FLUID_RESTRICT coeffs, int32x4_t points)
+{
+    return vaddvq_f32(vmulq_f32(vld1q_f32(coeffs), vcvtq_f32_s32(points)));
+}
+
+/* same as fluid_dsp_neon_dot4_single() but leaves out the first coefficient and point */
+static FLUID_INLINE float
+fluid_dsp_neon_dot3_single(const float *FLUID_RESTRICT coeffs, int32x4_t points)
+{
+    float32x4_t c = vsetq_lane_f32(0.0f, vld1q_f32(coeffs), 0);
+
+    return vaddvq_f32(vmulq_f32(c, vcvtq_f32_s32(points)));
+}
+
+/* dot product of 4 coefficients with 4 sample points */
+static FLUID_INLINE fluid_real_t
+fluid_dsp_neon_dot4(const fluid_real_t *FLUID_RESTRICT coeffs, int32x4_t points)
+{
+#if WITH_FLOAT
+    return fluid_dsp_neon_dot4_single(coeffs, points);
+#else
+    float64x2_t lo = vmulq_f64(vld1q_f64(coeffs), vcvtq_f64_s64(vmovl_s32(vget_low_s32(points))));
+    float64x2_t hi = vmulq_f64(vld1q_f64(coeffs + 2), vcvtq_f64_s64(vmovl_high_s32(points)));
+
+    return vaddvq_f64(vaddq_f64(lo, hi));
+#endif
+}
+
+/* same as fluid_dsp_neon_dot4() but leaves out the first coefficient and point */
+static FLUID_INLINE fluid_real_t
+fluid_dsp_neon_dot3(const fluid_real_t *FLUID_RESTRICT coeffs, int32x4_t points)
+{
+#if WITH_FLOAT
+    return fluid_dsp_neon_dot3_single(coeffs, points);
+#else
+    float64x2_t hi = vmulq_f64(vld1q_f64(coeffs + 2), vcvtq_f64_s64(vmovl_high_s32(points)));
+
+    return coeffs[1] * (double)vgetq_lane_s32(points, 1) + vaddvq_f64(hi);
+#endif
+}
+
+template<int ORDER, bool SINGLE>
+static unsigned int
+fluid_rvoice_dsp_interpolate_neon(const short int *FLUID_RESTRICT dsp_data,
+                                  fluid_real_t *FLUID_RESTRICT dsp_buf, unsigned int dsp_i,
+                                  fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                                  unsigned int end_index)
+{
+    const fluid_real_t *FLUID_RESTRICT table = (ORDER == CUBIC_INTERP_ORDER) ? interp_coeff : sinc_table7;
+    const float *FLUID_RESTRICT table_single = (ORDER == CUBIC_INTERP_ORDER) ? interp_coeff_single : sinc_table7_single;
+    fluid_phase_t phase = *dsp_phase;
+    int index[4], row[4];
+    int k;
+
+    while(fluid_rvoice_dsp_batch_setup<4, ORDER>(phase, dsp_phase_incr, dsp_i, end_index, index, row))
+    {
+        for(k = 0; k < 4; k++)
         {
+            const short int *points = &dsp_data[index[k] - (ORDER - 1) / 2];
             fluid_real_t sample;
-            coeffs = &interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase) * CUBIC_INTERP_ORDER];
 
-            sample =  (coeffs[0] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 1)
-                     + coeffs[1] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[2] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 1)
-                     + coeffs[3] * end_point1);
+            if(SINGLE)
+            {
+                const float *coeffs = &table_single[row[k]];
+                float sample_single = fluid_dsp_neon_dot4_single(coeffs, fluid_dsp_neon_points(points));
 
-            dsp_buf[dsp_i] = sample;
+                if(ORDER > 4)
+                {
+                    sample_single += fluid_dsp_neon_dot3_single(coeffs + 3, fluid_dsp_neon_points(points + 3));
+                }
 
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index(dsp_phase);
+                sample = sample_single;
+            }
+            else
+            {
+                const fluid_real_t *coeffs = &table[row[k]];
+                sample = fluid_dsp_neon_dot4(coeffs, fluid_dsp_neon_points(points));
+
+                if(ORDER > 4)
+                {
+                    /* the remaining 3 points, loaded together with the one before them to
+                     * neither read past the sample nor past the coefficient table */
+                    sample += fluid_dsp_neon_dot3(coeffs + 3, fluid_dsp_neon_points(points + 3));
+                }
+            }
+
+            dsp_buf[dsp_i + k] = sample;
         }
 
-        end_index++;	/* we're now interpolating the last point */
+        dsp_i += 4;
+        phase += 4 * dsp_phase_incr;
+    }
 
-        /* interpolate within the last point */
-        for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+    *dsp_phase = phase;
+    return dsp_i;
+}
+
+#elif defined(__wasm_simd128__)
+#define FLUID_DSP_WASM_KERNELS 1
+#include <wasm_simd128.h>
+
+/* Same scheme as the NEON kernels, with 128 bit WebAssembly SIMD (enable-wasm-simd) */
+
+/* loads 4 consecutive 16 bit sample points scaled like fluid_rvoice_get_sample16() */
+static FLUID_INLINE v128_t
+fluid_dsp_wasm_points(const short int *p)
+{
+    return wasm_i32x4_shl(wasm_i32x4_load16x4(p), 8);
+}
+
+/* there is no horizontal add */
+static FLUID_INLINE float
+fluid_dsp_wasm_sum_single(v128_t v)
+{
+    v = wasm_f32x4_add(v, wasm_i32x4_shuffle(v, v, 2, 3, 0, 1));
+    return wasm_f32x4_extract_lane(v, 0) + wasm_f32x4_extract_lane(v, 1);
+}
+
+/* dot product of 4 coefficients with 4 sample points, in single precision */
+static FLUID_INLINE float
+fluid_dsp_wasm_dot4_single(const float *FLUID_RESTRICT coeffs, v128_t points)
+{
+    return fluid_dsp_wasm_sum_single(wasm_f32x4_mul(wasm_v128_load(coeffs), wasm_f32x4_convert_i32x4(points)));
+}
+
+/* same as fluid_dsp_wasm_dot4_single() but leaves out the first coefficient and point */
+static FLUID_INLINE float
+fluid_dsp_wasm_dot3_single(const float *FLUID_RESTRICT coeffs, v128_t points)
+{
+    v128_t c = wasm_f32x4_replace_lane(wasm_v128_load(coeffs), 0, 0.0f);
+
+    return fluid_dsp_wasm_sum_single(wasm_f32x4_mul(c, wasm_f32x4_convert_i32x4(points)));
+}
+
+#if !WITH_FLOAT
+/* the upper two sample points converted to double */
+static FLUID_INLINE v128_t
+fluid_dsp_wasm_points_high_f64(v128_t points)
+{
+    return wasm_f64x2_convert_low_i32x4(wasm_i32x4_shuffle(points, points, 2, 3, 2, 3));
+}
+#endif
+
+/* dot product of 4 coefficients with 4 sample points */
+static FLUID_INLINE fluid_real_t
+fluid_dsp_wasm_dot4(const fluid_real_t *FLUID_RESTRICT coeffs, v128_t points)
+{
+#if WITH_FLOAT
+    return fluid_dsp_wasm_dot4_single(coeffs, points);
+#else
+    v128_t lo = wasm_f64x2_mul(wasm_v128_load(coeffs), wasm_f64x2_convert_low_i32x4(points));
+    v128_t hi = wasm_f64x2_mul(wasm_v128_load(coeffs + 2), fluid_dsp_wasm_points_high_f64(points));
+    v128_t sum = wasm_f64x2_add(lo, hi);
+
+    return wasm_f64x2_extract_lane(sum, 0) + wasm_f64x2_extract_lane(sum, 1);
+#endif
+}
+
+/* same as fluid_dsp_wasm_dot4() but leaves out the first coefficient and point */
+static FLUID_INLINE fluid_real_t
+fluid_dsp_wasm_dot3(const fluid_real_t *FLUID_RESTRICT coeffs, v128_t points)
+{
+#if WITH_FLOAT
+    return fluid_dsp_wasm_dot3_single(coeffs, points);
+#else
+    v128_t hi = wasm_f64x2_mul(wasm_v128_load(coeffs + 2), fluid_dsp_wasm_points_high_f64(points));
+
+    return coeffs[1] * (double)wasm_i32x4_extract_lane(points, 1)
+           + (wasm_f64x2_extract_lane(hi, 0) + wasm_f64x2_extract_lane(hi, 1));
+#endif
+}
+
+template<int ORDER, bool SINGLE>
+static unsigned int
+fluid_rvoice_dsp_interpolate_wasm(const short int *FLUID_RESTRICT dsp_data,
+                                  fluid_real_t *FLUID_RESTRICT dsp_buf, unsigned int dsp_i,
+                                  fluid_phase_t *dsp_phase, fluid_phase_t dsp_phase_incr,
+                                  unsigned int end_index)
+{
+    const fluid_real_t *FLUID_RESTRICT table = (ORDER == CUBIC_INTERP_ORDER) ? interp_coeff : sinc_table7;
+    const float *FLUID_RESTRICT table_single = (ORDER == CUBIC_INTERP_ORDER) ? interp_coeff_single : sinc_table7_single;
+    fluid_phase_t phase = *dsp_phase;
+    int index[4], row[4];
+    int k;
+
+    while(fluid_rvoice_dsp_batch_setup<4, ORDER>(phase, dsp_phase_incr, dsp_i, end_index, index, row))
+    {
+        for(k = 0; k < 4; k++)
         {
+            const short int *points = &dsp_data[index[k] - (ORDER - 1) / 2];
             fluid_real_t sample;
-            coeffs = &interp_coeff[fluid_phase_fract_to_tablerow(dsp_phase) * CUBIC_INTERP_ORDER];
 
-            
-            sample =  (coeffs[0] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 1)
-                     + coeffs[1] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[2] * end_point1
-                     + coeffs[3] * end_point2);
+            if(SINGLE)
+            {
+                const float *coeffs = &table_single[row[k]];
+                float sample_single = fluid_dsp_wasm_dot4_single(coeffs, fluid_dsp_wasm_points(points));
 
-            dsp_buf[dsp_i] = sample;
+                if(ORDER > 4)
+                {
+                    sample_single += fluid_dsp_wasm_dot3_single(coeffs + 3, fluid_dsp_wasm_points(points + 3));
+                }
 
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index(dsp_phase);
+                sample = sample_single;
+            }
+            else
+            {
+                const fluid_real_t *coeffs = &table[row[k]];
+                sample = fluid_dsp_wasm_dot4(coeffs, fluid_dsp_wasm_points(points));
+
+                if(ORDER > 4)
+                {
+                    /* see fluid_rvoice_dsp_interpolate_neon() */
+                    sample += fluid_dsp_wasm_dot3(coeffs + 3, fluid_dsp_wasm_points(points + 3));
+                }
+            }
+
+            dsp_buf[dsp_i + k] = sample;
         }
 
-        if(!LOOPING)
+        dsp_i += 4;
+        phase += 4 * dsp_phase_incr;
+    }
+
+    *dsp_phase = phase;
+    return dsp_i;
+}
+#endif
+
+#if !WITH_FIXED_POINT
+/* Provides the coefficient tables of the kernels computing in single precision */
+static void fluid_rvoice_dsp_init_single_tables(void)
+{
+#if WITH_FLOAT
+    interp_coeff_single = interp_coeff;
+    sinc_table7_single = sinc_table7;
+#else
+    static float interp_coeff_f[FLUID_INTERP_MAX * CUBIC_INTERP_ORDER];
+    static float sinc_table7_f[FLUID_INTERP_MAX * SINC_INTERP_ORDER];
+    int i;
+
+    for(i = 0; i < FLUID_INTERP_MAX * CUBIC_INTERP_ORDER; i++)
+    {
+        interp_coeff_f[i] = (float)interp_coeff[i];
+    }
+
+    for(i = 0; i < FLUID_INTERP_MAX * SINC_INTERP_ORDER; i++)
+    {
+        sinc_table7_f[i] = (float)sinc_table7[i];
+    }
+
+    interp_coeff_single = interp_coeff_f;
+    sinc_table7_single = sinc_table7_f;
+#endif
+}
+#endif
+
+static fluid_rvoice_dsp_kernels fluid_rvoice_dsp_select_kernels(int use_simd)
+{
+    fluid_rvoice_dsp_kernels kernels = { NULL, NULL, NULL, NULL };
+
+    if(!use_simd)
+    {
+        return kernels;
+    }
+
+#if WITH_FIXED_POINT
+    /* chosen at build time, whatever the CPU supports */
+    kernels.interp_4th = fluid_rvoice_dsp_interpolate_fixed<CUBIC_INTERP_ORDER>;
+    kernels.interp_7th = fluid_rvoice_dsp_interpolate_fixed<SINC_INTERP_ORDER>;
+    kernels.interp_4th_single = kernels.interp_4th;
+    kernels.interp_7th_single = kernels.interp_7th;
+#else
+
+    if(interp_coeff_single == NULL)
+    {
+        fluid_rvoice_dsp_init_single_tables();
+    }
+
+#if FLUID_DSP_X86_KERNELS
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        kernels.interp_4th_single = fluid_rvoice_dsp_interpolate_4th_avx2_single;
+        kernels.interp_7th_single = fluid_rvoice_dsp_interpolate_7th_avx2_single;
+#if WITH_FLOAT
+        kernels.interp_4th = kernels.interp_4th_single;
+        kernels.interp_7th = kernels.interp_7th_single;
+#else
+        kernels.interp_4th = fluid_rvoice_dsp_interpolate_4th_avx2;
+        kernels.interp_7th = fluid_rvoice_dsp_interpolate_7th_avx2;
+#endif
+    }
+#elif FLUID_DSP_NEON_KERNELS
+    /* Advanced SIMD is mandatory on AArch64 */
+    kernels.interp_4th = fluid_rvoice_dsp_interpolate_neon<CUBIC_INTERP_ORDER, false>;
+    kernels.interp_7th = fluid_rvoice_dsp_interpolate_neon<SINC_INTERP_ORDER, false>;
+#if WITH_FLOAT
+    kernels.interp_4th_single = kernels.interp_4th;
+    kernels.interp_7th_single = kernels.interp_7th;
+#else
+    kernels.interp_4th_single = fluid_rvoice_dsp_interpolate_neon<CUBIC_INTERP_ORDER, true>;
+    kernels.interp_7th_single = fluid_rvoice_dsp_interpolate_neon<SINC_INTERP_ORDER, true>;
+#endif
+#elif FLUID_DSP_WASM_KERNELS
+    /* a module built with SIMD128 doesn't load without it */
+    kernels.interp_4th = fluid_rvoice_dsp_interpolate_wasm<CUBIC_INTERP_ORDER, false>;
+    kernels.interp_7th = fluid_rvoice_dsp_interpolate_wasm<SINC_INTERP_ORDER, false>;
+#if WITH_FLOAT
+    kernels.interp_4th_single = kernels.interp_4th;
+    kernels.interp_7th_single = kernels.interp_7th;
+#else
+    kernels.interp_4th_single = fluid_rvoice_dsp_interpolate_wasm<CUBIC_INTERP_ORDER, true>;
+    kernels.interp_7th_single = fluid_rvoice_dsp_interpolate_wasm<SINC_INTERP_ORDER, true>;
+#endif
+#endif
+#endif
+
+    return kernels;
+}
+
+static fluid_rvoice_dsp_kernels fluid_rvoice_dsp_simd = fluid_rvoice_dsp_select_kernels(TRUE);
+
+/* Enables or disables the SIMD kernels, mainly useful for comparing them with the scalar code.
+ * Must not be called while a synth is rendering. */
+extern "C" void
+fluid_rvoice_dsp_set_simd_enabled(int enabled)
+{
+    fluid_rvoice_dsp_simd = fluid_rvoice_dsp_select_kernels(enabled);
+}
+
+/* The kernel of the 4th or 7th order interpolation of a voice, NULL if there is none */
+template<int FORMAT, int ORDER>
+static FLUID_INLINE fluid_rvoice_dsp_kernel_t
+fluid_rvoice_dsp_get_kernel(const fluid_rvoice_t *rvoice)
+{
+    if(FORMAT != FLUID_RVOICE_DSP_S16)
+    {
+        return NULL;
+    }
+
+    if(ORDER == CUBIC_INTERP_ORDER)
+    {
+        return rvoice->dsp.float_interp ? fluid_rvoice_dsp_simd.interp_4th_single : fluid_rvoice_dsp_simd.interp_4th;
+    }
+
+    return rvoice->dsp.float_interp ? fluid_rvoice_dsp_simd.interp_7th_single : fluid_rvoice_dsp_simd.interp_7th;
+}
+
+/* Returns a sample point of an interpolation that lies before the start or after the end
+ * of the sample or loop: the points wrap around the loop like the voice does, the first
+ * and last point of a sample that doesn't loop are duplicated. */
+template<int FORMAT, bool LOOPING>
+static fluid_real_t
+fluid_rvoice_dsp_get_edge_point(const fluid_rvoice_dsp_t *voice, int index)
+{
+    const fluid_sample_t *sample = voice->sample;
+    int start_index = voice->has_looped ? voice->loopstart : voice->start;
+    int loop_len = voice->loopend - voice->loopstart;
+
+    if(index < start_index)
+    {
+        if(!voice->has_looped || loop_len <= 0)
         {
-            break;    /* break out if not looping (end of sample) */
+            index = start_index;
         }
-
-        /* go back to loop start */
-        if(dsp_phase_index > end_index)
+        else
         {
-            fluid_phase_sub_int(dsp_phase, voice->loopend - voice->loopstart);
-
-            if(!voice->has_looped)
+            while(index < start_index)
             {
-                voice->has_looped = 1;
-                start_index = voice->loopstart;
-                start_point = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopend - 1);
+                index += loop_len;
             }
         }
-
-        /* break out if filled buffer */
-        if(dsp_i >= FLUID_BUFSIZE)
+    }
+    else if(LOOPING)
+    {
+        while(index >= (int)voice->loopend)
         {
-            break;
+            index -= loop_len;
         }
-
-        end_index -= 2;	/* set end back to third to last sample point */
+    }
+    else if(index > (int)voice->end)
+    {
+        index = voice->end;
     }
 
-    voice->phase = dsp_phase;
-
-    return (dsp_i);
+    return fluid_rvoice_get_float_sample<FORMAT>(sample->data, sample->data24, sample->data_float, sample->data_compressed, index);
 }
 
-/* 7th order interpolation.
+/* 4th order (cubic) and 7th order interpolation, over the points index - LEFT ...
+ * index + RIGHT, the 7th order one being centered on the 4th point.
  * Returns number of samples processed (usually FLUID_BUFSIZE but could be
  * smaller if end of sample occurs).
+ *
+ * The outputs whose points reach past the start or the end of the sample or loop
+ * interpolate over guard copies of the points around it, with the points beyond it
+ * filled in by fluid_rvoice_dsp_get_edge_point(). They use the same loop as the
+ * outputs in between, instead of one loop per point that lies beyond the edge.
  */
-template<bool IS_24BIT, bool LOOPING>
+template<int FORMAT, bool LOOPING, int ORDER>
 static int
-fluid_rvoice_dsp_interpolate_7th_order_local(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf)
+fluid_rvoice_dsp_interpolate_guarded_local(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf,
+        fluid_rvoice_dsp_kernel_t kernel)
 {
+    enum
+    {
+        LEFT = (ORDER - 1) / 2, /* points before the one of the phase index */
+        RIGHT = ORDER - 1 - LEFT /* points after it */
+    };
+
+    const fluid_real_t *FLUID_RESTRICT table = (ORDER == CUBIC_INTERP_ORDER) ? interp_coeff : sinc_table7;
     fluid_rvoice_dsp_t *voice = &rvoice->dsp;
     fluid_phase_t dsp_phase = voice->phase;
     fluid_phase_t dsp_phase_incr;
     const short int *FLUID_RESTRICT dsp_data = voice->sample->data;
     const char *FLUID_RESTRICT dsp_data24 = voice->sample->data24;
+    const fluid_real_t *FLUID_RESTRICT dsp_data_float = voice->sample->data_float;
+    const signed char *FLUID_RESTRICT dsp_data_compressed = voice->sample->data_compressed;
     unsigned short dsp_i = 0;
     unsigned int dsp_phase_index;
-    unsigned int start_index, end_index;
-    fluid_real_t start_points[3], end_points[3];
+    /* last point of the sample or loop the phase index may reach, and the last one
+     * whose points all lie within it */
+    unsigned int last_index = LOOPING ? voice->loopend - 1 : voice->end;
+    unsigned int end_index = last_index - RIGHT;
+    unsigned int start_index;
+    /* the guard points, head[0] is the point start_index - LEFT, tail[0] the point
+     * end_index + 1 - LEFT */
+    fluid_real_t head[2 * LEFT + RIGHT], tail[LEFT + 2 * RIGHT];
+    int head_valid = FALSE, tail_valid = FALSE;
     const fluid_real_t *FLUID_RESTRICT coeffs;
+    int k;
 
     /* Convert playback "speed" floating point value to phase index/fract */
     fluid_phase_set_float(dsp_phase_incr, voice->phase_incr);
 
-    /* add 1/2 sample to dsp_phase since 7th order interpolation is centered on
-     * the 4th sample point */
-    fluid_phase_incr(dsp_phase, (fluid_phase_t)0x80000000);
-
-    /* last index before 7th interpolation point must be specially handled */
-    end_index = (LOOPING ? voice->loopend - 1 : voice->end) - 3;
-
-    if(voice->has_looped)	/* set start_index and start point if looped or not */
-    {
-        start_index = voice->loopstart;
-        start_points[0] = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopend - 1);
-        start_points[1] = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopend - 2);
-        start_points[2] = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopend - 3);
-    }
-    else
+    if(ORDER == SINC_INTERP_ORDER)
     {
-        start_index = voice->start;
-        start_points[0] = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->start);	/* just duplicate the start point */
-        start_points[1] = start_points[0];
-        start_points[2] = start_points[0];
-    }
-
-    /* get the 3 points off the end (loop start if looping, duplicate point if end) */
-    if(LOOPING)
-    {
-        end_points[0] = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopstart);
-        end_points[1] = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopstart + 1);
-        end_points[2] = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopstart + 2);
-    }
-    else
-    {
-        end_points[0] = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->end);
-        end_points[1] = end_points[0];
-        end_points[2] = end_points[0];
+        /* add 1/2 sample to dsp_phase since 7th order interpolation is centered on
+         * the 4th sample point */
+        fluid_phase_incr(dsp_phase, (fluid_phase_t)0x80000000);
     }
 
     while(1)
     {
+        start_index = voice->has_looped ? voice->loopstart : voice->start;
         dsp_phase_index = fluid_phase_index(dsp_phase);
 
-        /* interpolate first sample point (start or loop start) if needed */
-        for(; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        /* interpolate the first points of the sample or loop */
+        if(dsp_phase_index - start_index < (unsigned int)LEFT && dsp_i < FLUID_BUFSIZE)
         {
-            fluid_real_t sample;
-            coeffs = &sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase) * SINC_INTERP_ORDER];
-
-            sample =  (coeffs[0] * start_points[2]
-                     + coeffs[1] * start_points[1]
-                     + coeffs[2] * start_points[0]
-                     + coeffs[3] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[4] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 1)
-                     + coeffs[5] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 2)
-                     + coeffs[6] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 3));
-
-            dsp_buf[dsp_i] = sample;
+            if(!head_valid)
+            {
+                for(k = 0; k < 2 * LEFT + RIGHT; k++)
+                {
+                    head[k] = fluid_rvoice_dsp_get_edge_point<FORMAT, LOOPING>(voice, (int)start_index - LEFT + k);
+                }
 
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index(dsp_phase);
-        }
+                head_valid = TRUE;
+            }
 
-        start_index++;
+            for(; dsp_phase_index - start_index < (unsigned int)LEFT && dsp_i < FLUID_BUFSIZE; dsp_i++)
+            {
+                const fluid_real_t *points = &head[dsp_phase_index - start_index];
+                fluid_real_t sample;
+                coeffs = &table[fluid_phase_fract_to_tablerow(dsp_phase) * ORDER];
 
-        /* interpolate 2nd to first sample point (start or loop start) if needed */
-        for(; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
-        {
-            fluid_real_t sample;
-            coeffs = &sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase) * SINC_INTERP_ORDER];
+                sample = coeffs[0] * points[0];
 
-            sample =  (coeffs[0] * start_points[1]
-                     + coeffs[1] * start_points[0]
-                     + coeffs[2] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 1)
-                     + coeffs[3] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[4] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 1)
-                     + coeffs[5] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 2)
-                     + coeffs[6] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 3));
+                for(k = 1; k < ORDER; k++)
+                {
+                    sample += coeffs[k] * points[k];
+                }
 
-            dsp_buf[dsp_i] = sample;
+                dsp_buf[dsp_i] = sample;
 
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index(dsp_phase);
+                /* increment phase and amplitude */
+                fluid_phase_incr(dsp_phase, dsp_phase_incr);
+                dsp_phase_index = fluid_phase_index(dsp_phase);
+            }
         }
 
-        start_index++;
-
-        /* interpolate 3rd to first sample point (start or loop start) if needed */
-        for(; dsp_phase_index == start_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        /* interpolate the sequence of sample points */
+        if(kernel != NULL)
         {
-            fluid_real_t sample;
-            coeffs = &sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase) * SINC_INTERP_ORDER];
-
-            sample =  (coeffs[0] * start_points[0]
-                     + coeffs[1] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 2)
-                     + coeffs[2] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 1)
-                     + coeffs[3] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[4] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 1)
-                     + coeffs[5] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 2)
-                     + coeffs[6] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 3));
-
-            dsp_buf[dsp_i] = sample;
-
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
+            dsp_i = kernel(dsp_data, dsp_buf, dsp_i, &dsp_phase, dsp_phase_incr, end_index);
             dsp_phase_index = fluid_phase_index(dsp_phase);
         }
 
-        start_index -= 2;	/* set back to original start index */
-
-
-        /* interpolate the sequence of sample points */
         for(; dsp_i < FLUID_BUFSIZE && dsp_phase_index <= end_index; dsp_i++)
         {
             fluid_real_t sample;
-            coeffs = &sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase) * SINC_INTERP_ORDER];
+            coeffs = &table[fluid_phase_fract_to_tablerow(dsp_phase) * ORDER];
+
+            sample = coeffs[0] * fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, dsp_phase_index - LEFT);
 
-            sample =  (coeffs[0] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 3)
-                     + coeffs[1] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 2)
-                     + coeffs[2] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 1)
-                     + coeffs[3] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[4] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 1)
-                     + coeffs[5] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 2)
-                     + coeffs[6] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 3));
+            for(k = 1; k < ORDER; k++)
+            {
+                sample += coeffs[k] * fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, dsp_phase_index - LEFT + k);
+            }
 
             dsp_buf[dsp_i] = sample;
 
@@ -618,67 +1142,29 @@ fluid_rvoice_dsp_interpolate_7th_order_local(fluid_rvoice_t *rvoice, fluid_real_
             break;
         }
 
-        end_index++;	/* we're now interpolating the 3rd to last point */
-
-        /* interpolate within 3rd to last point */
-        for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        /* interpolate the last points of the sample or loop */
+        if(!tail_valid)
         {
-            fluid_real_t sample;
-            coeffs = &sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase) * SINC_INTERP_ORDER];
-
-            sample =  (coeffs[0] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 3)
-                     + coeffs[1] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 2)
-                     + coeffs[2] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 1)
-                     + coeffs[3] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[4] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 1)
-                     + coeffs[5] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 2)
-                     + coeffs[6] * end_points[0]);
-
-            dsp_buf[dsp_i] = sample;
+            for(k = 0; k < LEFT + 2 * RIGHT; k++)
+            {
+                tail[k] = fluid_rvoice_dsp_get_edge_point<FORMAT, LOOPING>(voice, (int)end_index + 1 - LEFT + k);
+            }
 
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index(dsp_phase);
+            tail_valid = TRUE;
         }
 
-        end_index++;	/* we're now interpolating the 2nd to last point */
-
-        /* interpolate within 2nd to last point */
-        for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
+        for(; dsp_phase_index <= last_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
         {
+            const fluid_real_t *points = &tail[dsp_phase_index - (end_index + 1)];
             fluid_real_t sample;
-            coeffs = &sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase) * SINC_INTERP_ORDER];
-
-            sample =  (coeffs[0] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 3)
-                     + coeffs[1] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 2)
-                     + coeffs[2] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 1)
-                     + coeffs[3] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[4] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index + 1)
-                     + coeffs[5] * end_points[0]
-                     + coeffs[6] * end_points[1]);
-
-            dsp_buf[dsp_i] = sample;
-
-            /* increment phase and amplitude */
-            fluid_phase_incr(dsp_phase, dsp_phase_incr);
-            dsp_phase_index = fluid_phase_index(dsp_phase);
-        }
+            coeffs = &table[fluid_phase_fract_to_tablerow(dsp_phase) * ORDER];
 
-        end_index++;	/* we're now interpolating the last point */
+            sample = coeffs[0] * points[0];
 
-        /* interpolate within last point */
-        for(; dsp_phase_index <= end_index && dsp_i < FLUID_BUFSIZE; dsp_i++)
-        {
-            fluid_real_t sample;
-            coeffs = &sinc_table7[fluid_phase_fract_to_tablerow(dsp_phase) * SINC_INTERP_ORDER];
-
-            sample =  (coeffs[0] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 3)
-                     + coeffs[1] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 2)
-                     + coeffs[2] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index - 1)
-                     + coeffs[3] * fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, dsp_phase_index)
-                     + coeffs[4] * end_points[0]
-                     + coeffs[5] * end_points[1]
-                     + coeffs[6] * end_points[2]);
+            for(k = 1; k < ORDER; k++)
+            {
+                sample += coeffs[k] * points[k];
+            }
 
             dsp_buf[dsp_i] = sample;
 
@@ -693,17 +1179,16 @@ fluid_rvoice_dsp_interpolate_7th_order_local(fluid_rvoice_t *rvoice, fluid_real_
         }
 
         /* go back to loop start */
-        if(dsp_phase_index > end_index)
+        if(dsp_phase_index > last_index)
         {
             fluid_phase_sub_int(dsp_phase, voice->loopend - voice->loopstart);
 
             if(!voice->has_looped)
             {
+                /* the points before the loop start wrap around from now on */
                 voice->has_looped = 1;
-                start_index = voice->loopstart;
-                start_points[0] = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopend - 1);
-                start_points[1] = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopend - 2);
-                start_points[2] = fluid_rvoice_get_float_sample<IS_24BIT>(dsp_data, dsp_data24, voice->loopend - 3);
+                head_valid = FALSE;
+                tail_valid = FALSE;
             }
         }
 
@@ -712,13 +1197,100 @@ fluid_rvoice_dsp_interpolate_7th_order_local(fluid_rvoice_t *rvoice, fluid_real_
         {
             break;
         }
+    }
 
-        end_index -= 3;	/* set end back to 4th to last sample point */
+    if(ORDER == SINC_INTERP_ORDER)
+    {
+        /* sub 1/2 sample from dsp_phase since 7th order interpolation is centered on
+         * the 4th sample point (correct back to real value) */
+        fluid_phase_decr(dsp_phase, (fluid_phase_t)0x80000000);
     }
 
-    /* sub 1/2 sample from dsp_phase since 7th order interpolation is centered on
-     * the 4th sample point (correct back to real value) */
-    fluid_phase_decr(dsp_phase, (fluid_phase_t)0x80000000);
+    voice->phase = dsp_phase;
+
+    return (dsp_i);
+}
+
+/* 16 point sinc interpolation, over the points index - 7 ... index + 8.
+ * Returns number of samples processed (usually FLUID_BUFSIZE but could be
+ * smaller if end of sample occurs). Points within the sample or loop are read
+ * directly, so that the 16 taps of a row multiply 16 contiguous points, only the
+ * outputs near its start and end fetch each point on its own.
+ */
+template<int FORMAT, bool LOOPING>
+static int
+fluid_rvoice_dsp_interpolate_16th_order_local(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf)
+{
+    fluid_rvoice_dsp_t *voice = &rvoice->dsp;
+    fluid_phase_t dsp_phase = voice->phase;
+    fluid_phase_t dsp_phase_incr;
+    const short int *FLUID_RESTRICT dsp_data = voice->sample->data;
+    const char *FLUID_RESTRICT dsp_data24 = voice->sample->data24;
+    const fluid_real_t *FLUID_RESTRICT dsp_data_float = voice->sample->data_float;
+    const signed char *FLUID_RESTRICT dsp_data_compressed = voice->sample->data_compressed;
+    unsigned short dsp_i = 0;
+    unsigned int dsp_phase_index;
+    /* last point of the sample or loop, the phase index may reach */
+    unsigned int end_index = LOOPING ? voice->loopend - 1 : voice->end;
+    const fluid_real_t *FLUID_RESTRICT coeffs;
+    int k;
+
+    /* Convert playback "speed" floating point value to phase index/fract */
+    fluid_phase_set_float(dsp_phase_incr, voice->phase_incr);
+
+    dsp_phase_index = fluid_phase_index(dsp_phase);
+
+    while(dsp_i < FLUID_BUFSIZE)
+    {
+        unsigned int start_index = voice->has_looped ? voice->loopstart : voice->start;
+        fluid_real_t sample = 0;
+        int first = (int)dsp_phase_index - 7;
+
+        if(dsp_phase_index > end_index)
+        {
+            if(!LOOPING)
+            {
+                break;    /* end of sample */
+            }
+
+            /* go back to loop start */
+            fluid_phase_sub_int(dsp_phase, voice->loopend - voice->loopstart);
+            dsp_phase_index = fluid_phase_index(dsp_phase);
+            voice->has_looped = 1;
+            continue;
+        }
+
+        coeffs = &sinc_table16[fluid_phase_fract_to_tablerow(dsp_phase) * SINC16_INTERP_ORDER];
+
+        if(first >= (int)start_index && dsp_phase_index + 8 <= end_index)
+        {
+            /* four independent sums, one per vector lane */
+            fluid_real_t sum[4] = { 0, 0, 0, 0 };
+
+            for(k = 0; k < SINC16_INTERP_ORDER; k += 4)
+            {
+                sum[0] += coeffs[k] * fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, first + k);
+                sum[1] += coeffs[k + 1] * fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, first + k + 1);
+                sum[2] += coeffs[k + 2] * fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, first + k + 2);
+                sum[3] += coeffs[k + 3] * fluid_rvoice_get_float_sample<FORMAT>(dsp_data, dsp_data24, dsp_data_float, dsp_data_compressed, first + k + 3);
+            }
+
+            sample = (sum[0] + sum[2]) + (sum[1] + sum[3]);
+        }
+        else
+        {
+            for(k = 0; k < SINC16_INTERP_ORDER; k++)
+            {
+                sample += coeffs[k] * fluid_rvoice_dsp_get_edge_point<FORMAT, LOOPING>(voice, first + k);
+            }
+        }
+
+        dsp_buf[dsp_i++] = sample;
+
+        /* increment phase */
+        fluid_phase_incr(dsp_phase, dsp_phase_incr);
+        dsp_phase_index = fluid_phase_index(dsp_phase);
+    }
 
     voice->phase = dsp_phase;
 
@@ -727,7 +1299,7 @@ fluid_rvoice_dsp_interpolate_7th_order_local(fluid_rvoice_t *rvoice, fluid_real_
 
 struct ProcessSilence
 {
-    template<bool IS_24BIT, bool LOOPING>
+    template<int FORMAT, bool LOOPING>
     int operator()(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf) const
     {
         return fluid_rvoice_dsp_silence_local<LOOPING>(rvoice, dsp_buf);
@@ -736,37 +1308,48 @@ struct ProcessSilence
 
 struct InterpolateNone
 {
-    template<bool IS_24BIT, bool LOOPING>
+    template<int FORMAT, bool LOOPING>
     int operator()(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf) const
     {
-        return fluid_rvoice_dsp_interpolate_none_local<IS_24BIT, LOOPING>(rvoice, dsp_buf);
+        return fluid_rvoice_dsp_interpolate_none_local<FORMAT, LOOPING>(rvoice, dsp_buf);
     }
 };
 
 struct InterpolateLinear
 {
-    template<bool IS_24BIT, bool LOOPING>
+    template<int FORMAT, bool LOOPING>
     int operator()(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf) const
     {
-        return fluid_rvoice_dsp_interpolate_linear_local<IS_24BIT, LOOPING>(rvoice, dsp_buf);
+        return fluid_rvoice_dsp_interpolate_linear_local<FORMAT, LOOPING>(rvoice, dsp_buf);
     }
 };
 
 struct Interpolate4thOrder
 {
-    template<bool IS_24BIT, bool LOOPING>
+    template<int FORMAT, bool LOOPING>
     int operator()(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf) const
     {
-        return fluid_rvoice_dsp_interpolate_4th_order_local<IS_24BIT, LOOPING>(rvoice, dsp_buf);
+        return fluid_rvoice_dsp_interpolate_guarded_local<FORMAT, LOOPING, CUBIC_INTERP_ORDER>(rvoice, dsp_buf,
+                fluid_rvoice_dsp_get_kernel<FORMAT, CUBIC_INTERP_ORDER>(rvoice));
     }
 };
 
 struct Interpolate7thOrder
 {
-    template<bool IS_24BIT, bool LOOPING>
+    template<int FORMAT, bool LOOPING>
     int operator()(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf) const
     {
-        return fluid_rvoice_dsp_interpolate_7th_order_local<IS_24BIT, LOOPING>(rvoice, dsp_buf);
+        return fluid_rvoice_dsp_interpolate_guarded_local<FORMAT, LOOPING, SINC_INTERP_ORDER>(rvoice, dsp_buf,
+                fluid_rvoice_dsp_get_kernel<FORMAT, SINC_INTERP_ORDER>(rvoice));
+    }
+};
+
+struct Interpolate16thOrder
+{
+    template<int FORMAT, bool LOOPING>
+    int operator()(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf) const
+    {
+        return fluid_rvoice_dsp_interpolate_16th_order_local<FORMAT, LOOPING>(rvoice, dsp_buf);
     }
 };
 
@@ -774,17 +1357,38 @@ template<typename T>
 int dsp_invoker(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf, int looping)
 {
     T func;
-    bool is_24bit = rvoice->dsp.sample->data24 != NULL;
 
-    if (is_24bit)
+    if (rvoice->dsp.sample->data_float != NULL)
     {
         if (looping)
         {
-            return func.template operator()<true, true>(rvoice, dsp_buf);
+            return func.template operator()<FLUID_RVOICE_DSP_FLOAT, true>(rvoice, dsp_buf);
         }
         else
         {
-            return func.template operator()<true, false>(rvoice, dsp_buf);
+            return func.template operator()<FLUID_RVOICE_DSP_FLOAT, false>(rvoice, dsp_buf);
+        }
+    }
+    else if (rvoice->dsp.sample->data_compressed != NULL)
+    {
+        if (looping)
+        {
+            return func.template operator()<FLUID_RVOICE_DSP_COMPRESSED, true>(rvoice, dsp_buf);
+        }
+        else
+        {
+            return func.template operator()<FLUID_RVOICE_DSP_COMPRESSED, false>(rvoice, dsp_buf);
+        }
+    }
+    else if (rvoice->dsp.sample->data24 != NULL)
+    {
+        if (looping)
+        {
+            return func.template operator()<FLUID_RVOICE_DSP_S24, true>(rvoice, dsp_buf);
+        }
+        else
+        {
+            return func.template operator()<FLUID_RVOICE_DSP_S24, false>(rvoice, dsp_buf);
         }
     }
     else
@@ -792,11 +1396,11 @@ int dsp_invoker(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf, in
         // This case is most common, thanks to templating it will also become the fastest one
         if (looping)
         {
-            return func.template operator()<false, true>(rvoice, dsp_buf);
+            return func.template operator()<FLUID_RVOICE_DSP_S16, true>(rvoice, dsp_buf);
         }
         else
         {
-            return func.template operator()<false, false>(rvoice, dsp_buf);
+            return func.template operator()<FLUID_RVOICE_DSP_S16, false>(rvoice, dsp_buf);
         }
     }
 }
@@ -807,10 +1411,11 @@ fluid_rvoice_dsp_silence(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT ds
     return dsp_invoker<ProcessSilence>(rvoice, dsp_buf, looping);
 }
 
-extern "C" int
-fluid_rvoice_dsp_interpolate(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf, int looping)
+static int
+fluid_rvoice_dsp_interpolate_local(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf, int looping)
 {
-    switch (rvoice->dsp.interp_method)
+    /* an inaudible block only feeds the filters, which don't need the precise interpolation */
+    switch (rvoice->dsp.inaudible ? FLUID_INTERP_LINEAR : rvoice->dsp.interp_method)
     {
         case FLUID_INTERP_NONE:
             return dsp_invoker<InterpolateNone>(rvoice, dsp_buf, looping);
@@ -824,5 +1429,223 @@ fluid_rvoice_dsp_interpolate(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRIC
 
         case FLUID_INTERP_7THORDER:
             return dsp_invoker<Interpolate7thOrder>(rvoice, dsp_buf, looping);
+
+        case FLUID_INTERP_16THORDER:
+            return dsp_invoker<Interpolate16thOrder>(rvoice, dsp_buf, looping);
+    }
+}
+
+/* Mipmaps.
+ *
+ * A voice transposed up by an octave or more skips sample points, and the part of the sample's
+ * spectrum above the Nyquist frequency of the output aliases. If the sample has band-limited
+ * copies at 1/2, 1/4, ... of its rate (see fluid_sample_build_mipmap()), such a block is read
+ * from the level that brings the phase increment below 2, which also touches fewer points.
+ * The loop points of a level generally aren't integer, so blocks that may wrap around the
+ * loop or read across its start are left to the sample itself.
+ */
+
+/* Returns the mipmap level to read the next block of a voice from, 0 for the sample itself */
+static int
+fluid_rvoice_dsp_get_mip_level(const fluid_rvoice_t *rvoice, int looping)
+{
+    const fluid_rvoice_dsp_t *voice = &rvoice->dsp;
+    unsigned int index, reach;
+    int level = 0;
+
+    if(voice->sample->mip_levels == 0 || voice->phase_incr < 2.0f)
+    {
+        return 0;
+    }
+
+    while(level < voice->sample->mip_levels && voice->phase_incr >= (fluid_real_t)(2 << level))
+    {
+        level++;
+    }
+
+    if(looping)
+    {
+        /* points passed by the block plus the interpolation window, in points of the sample */
+        index = fluid_phase_index(voice->phase);
+        reach = (unsigned int)(voice->phase_incr * FLUID_BUFSIZE) + (8U << level);
+
+        if(index + reach >= (unsigned int)voice->loopend
+                || (voice->has_looped && index < (unsigned int)voice->loopstart + (4U << level)))
+        {
+            return 0;
+        }
+    }
+
+    return level;
+}
+
+/* Interpolates a block from a mipmap level, presented to the interpolators as a sample of its
+ * own. The block doesn't reach the loop end, so it is rendered as if the voice wasn't looping. */
+static int
+fluid_rvoice_dsp_interpolate_mip(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf, int level)
+{
+    fluid_rvoice_dsp_t *voice = &rvoice->dsp;
+    const fluid_sample_t *sample = voice->sample;
+    fluid_phase_t base = fluid_phase_from_index_fract(sample->start, 0);
+    fluid_sample_t mip_sample;
+    fluid_rvoice_t view;
+    int count;
+
+    mip_sample.data = NULL;
+    mip_sample.data24 = NULL;
+    mip_sample.data_float = &sample->mipmap[sample->mip_offset[level - 1]];
+    mip_sample.data_compressed = NULL;
+
+    view.dsp = *voice;
+    view.dsp.sample = &mip_sample;
+    view.dsp.phase = (voice->phase - base) >> level;
+    view.dsp.phase_incr = voice->phase_incr / (fluid_real_t)(1 << level);
+    view.dsp.start = (voice->start - sample->start) >> level;
+    view.dsp.end = (voice->end - sample->start) >> level;
+    view.dsp.has_looped = 0;
+
+    count = fluid_rvoice_dsp_interpolate_local(&view, dsp_buf, FALSE);
+
+    voice->phase = (view.dsp.phase << level) + base;
+
+    return count;
+}
+
+extern "C" int
+fluid_rvoice_dsp_interpolate(fluid_rvoice_t *rvoice, fluid_real_t *FLUID_RESTRICT dsp_buf, int looping)
+{
+    int level = fluid_rvoice_dsp_get_mip_level(rvoice, looping);
+
+    if(level > 0)
+    {
+        return fluid_rvoice_dsp_interpolate_mip(rvoice, dsp_buf, level);
     }
-}
\ No newline at end of file
+
+    return fluid_rvoice_dsp_interpolate_local(rvoice, dsp_buf, looping);
+}
+
+/* Interpolates the next block of another sample of the same length and loop as the one of the
+ * voice, the other sample of a stereo pair, at the phase of the voice, see fluid_rvoice_write().
+ * The voice itself isn't changed. */
+extern "C" int
+fluid_rvoice_dsp_interpolate_pair(fluid_rvoice_t *rvoice, fluid_sample_t *sample,
+                                  fluid_real_t *FLUID_RESTRICT dsp_buf, int looping)
+{
+    const fluid_rvoice_dsp_t *voice = &rvoice->dsp;
+    int delta = (int)sample->start - (int)voice->sample->start;
+    fluid_rvoice_t view;
+
+    view.dsp = *voice;
+    view.dsp.sample = sample;
+    view.dsp.phase = voice->phase + ((fluid_phase_t)(int64_t)delta << 32);
+    view.dsp.start = voice->start + delta;
+    view.dsp.end = voice->end + delta;
+    view.dsp.loopstart = voice->loopstart + delta;
+    view.dsp.loopend = voice->loopend + delta;
+
+    return fluid_rvoice_dsp_interpolate(&view, dsp_buf, looping);
+}
+
+/* Sample prefetching.
+ *
+ * A voice reads the points of a sample in order, but moves on to points that are no longer in
+ * the cache with every block, and jumps back to the loop start at the end of the loop. After a
+ * block, the points of the next one are therefore requested from memory, so that they arrive
+ * while the other voices of the block are rendered. A block crossing the loop end reads from
+ * the loop start as well. Samples small enough to stay in the cache and blocks read from a
+ * mipmap level are left alone.
+ */
+
+/* Sample data is prefetched in steps of a cache line, at most this many lines per array and range */
+#define FLUID_PREFETCH_LINE 64
+#define FLUID_PREFETCH_MAX_LINES 16
+
+/* Samples with fewer points are assumed to stay in the cache while they play */
+#define FLUID_PREFETCH_MIN_POINTS (128 * 1024)
+
+static void
+fluid_rvoice_dsp_prefetch_bytes(const void *data, size_t first, size_t last)
+{
+    const char *addr = (const char *)data + first;
+    const char *end = (const char *)data + last;
+    int lines;
+
+    for(lines = 0; addr < end && lines < FLUID_PREFETCH_MAX_LINES; lines++)
+    {
+        FLUID_PREFETCH(addr);
+        addr += FLUID_PREFETCH_LINE;
+    }
+
+    if(lines < FLUID_PREFETCH_MAX_LINES)
+    {
+        FLUID_PREFETCH(end);
+    }
+}
+
+/* Prefetches count points of a sample from point first on */
+static void
+fluid_rvoice_dsp_prefetch_points(const fluid_sample_t *sample, unsigned int first, unsigned int count)
+{
+    size_t last = (size_t)first + count - 1;
+
+    if(count == 0)
+    {
+        return;
+    }
+
+    if(sample->data_float != NULL)
+    {
+        fluid_rvoice_dsp_prefetch_bytes(sample->data_float, first * sizeof(fluid_real_t), last * sizeof(fluid_real_t));
+    }
+    else if(sample->data_compressed != NULL)
+    {
+        fluid_rvoice_dsp_prefetch_bytes(sample->data_compressed,
+                                        (first / FLUID_SAMPLE_BLOCK_POINTS) * FLUID_SAMPLE_BLOCK_SIZE,
+                                        FLUID_SAMPLE_COMPRESSED_SIZE(last + 1) - 1);
+    }
+    else
+    {
+        fluid_rvoice_dsp_prefetch_bytes(sample->data, first * sizeof(short), last * sizeof(short));
+
+        if(sample->data24 != NULL)
+        {
+            fluid_rvoice_dsp_prefetch_bytes(sample->data24, first, last);
+        }
+    }
+}
+
+/**
+ * Prefetch the sample points the next block of a voice is going to read.
+ *
+ * @param rvoice rvoice that has just rendered a whole block
+ * @param is_looping whether the voice is looping
+ */
+extern "C" void
+fluid_rvoice_dsp_prefetch(const fluid_rvoice_t *rvoice, int is_looping)
+{
+    const fluid_rvoice_dsp_t *voice = &rvoice->dsp;
+    unsigned int index = fluid_phase_index(voice->phase);
+    unsigned int reach, before_end;
+    fluid_real_t span = voice->phase_incr * FLUID_BUFSIZE;
+
+    if(voice->sample == NULL || voice->sample->end - voice->sample->start < FLUID_PREFETCH_MIN_POINTS
+            || fluid_rvoice_dsp_get_mip_level(rvoice, is_looping) > 0)
+    {
+        return;
+    }
+
+    /* points passed by the block plus the interpolation window after it */
+    reach = ((span < 65536.0f) ? (unsigned int)span : 65536U) + SINC16_INTERP_ORDER;
+
+    if(is_looping && index + reach >= (unsigned int)voice->loopend)
+    {
+        before_end = (index < (unsigned int)voice->loopend) ? (unsigned int)voice->loopend - index : 0;
+        fluid_rvoice_dsp_prefetch_points(voice->sample, index, before_end);
+        fluid_rvoice_dsp_prefetch_points(voice->sample, voice->loopstart, reach - before_end);
+    }
+    else if(index <= (unsigned int)voice->end)
+    {
+        before_end = (unsigned int)voice->end - index + 1;
+        fluid_rvoice_dsp_prefetch_points(voice->sample, index, (reach < before_end) ? reach : before_end);
+    }
+}
@@ -4,7 +4,9 @@
 
 #define FLUID_INTERP_MAX         256
 #define SINC_INTERP_ORDER 7  /* 7th order constant */
+#define SINC16_INTERP_ORDER 16 /* taps of the 16 point sinc, a multiple of the SIMD widths */
 #define CUBIC_INTERP_ORDER 4 /* 4th order constant */
 #define LINEAR_INTERP_ORDER 2
+#define FLUID_INTERP_FIXED_BITS 30 /* fractional bits of the coefficients of enable-fixed-point */
 
 #endif
@@ -24,6 +24,19 @@
 #include "fluid_lfo.h"
 #include "fluid_adsr_env.h"
 
+/* Number of events in one segment of the overflow chain */
+#define FLUID_RVOICE_EVENT_SEGMENT_SIZE 256
+
+struct _fluid_rvoice_event_segment_t
+{
+    fluid_rvoice_event_segment_t *next; /**< Atomic: next segment, NULL until allocated */
+    fluid_atomic_int_t committed; /**< Atomic: number of flushed events */
+    fluid_atomic_int_t done;    /**< Atomic: TRUE once all events have been dispatched, the segment may be freed then */
+    int pushed;                 /**< Pushing thread only: number of events pushed */
+    int read;                   /**< Dispatching thread only: number of events dispatched */
+    fluid_rvoice_event_t events[FLUID_RVOICE_EVENT_SEGMENT_SIZE];
+};
+
 static int fluid_rvoice_eventhandler_push_LOCAL(fluid_rvoice_eventhandler_t *handler, const fluid_rvoice_event_t *src_event);
 
 static FLUID_INLINE void
@@ -77,25 +90,178 @@ fluid_rvoice_eventhandler_push_ptr(fluid_rvoice_eventhandler_t *handler,
     return fluid_rvoice_eventhandler_push_LOCAL(handler, &local_event);
 }
 
+/* Frees the segments all events of which have been dispatched, except for the last one */
+static void
+fluid_rvoice_eventhandler_free_segments(fluid_rvoice_eventhandler_t *handler)
+{
+    fluid_rvoice_event_segment_t *segment;
+
+    while(handler->overflow_first != handler->overflow_last
+            && fluid_atomic_int_get(&handler->overflow_first->done))
+    {
+        segment = handler->overflow_first;
+        handler->overflow_first = segment->next;
+        FLUID_FREE(segment);
+    }
+}
+
+/* Appends an event to the overflow segments, allocating a new one if the last is full */
+static int
+fluid_rvoice_eventhandler_push_overflow(fluid_rvoice_eventhandler_t *handler, const fluid_rvoice_event_t *src_event)
+{
+    fluid_rvoice_event_segment_t *segment = handler->overflow_last;
+
+    if(segment == NULL || segment->pushed == FLUID_RVOICE_EVENT_SEGMENT_SIZE)
+    {
+        fluid_rvoice_eventhandler_free_segments(handler);
+        segment = FLUID_NEW(fluid_rvoice_event_segment_t);
+
+        if(segment == NULL)
+        {
+            FLUID_LOG(FLUID_WARN, "Out of memory, dropping an event for the mixer");
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMSET(segment, 0, sizeof(*segment) - sizeof(segment->events));
+
+        if(handler->overflow_last == NULL)
+        {
+            handler->overflow_first = handler->overflow_commit = segment;
+            fluid_atomic_pointer_set(&handler->overflow_start, segment);
+        }
+        else
+        {
+            fluid_atomic_pointer_set(&handler->overflow_last->next, segment);
+        }
+
+        handler->overflow_last = segment;
+    }
+
+    if(!handler->overflow_active)
+    {
+        FLUID_LOG(FLUID_DBG, "Event queue full, queueing events in overflow segments");
+        handler->overflow_active = TRUE;
+    }
+
+    FLUID_MEMCPY(&segment->events[segment->pushed++], src_event, sizeof(*src_event));
+    handler->overflow_stored++;
+
+    return FLUID_OK;
+}
+
 static int fluid_rvoice_eventhandler_push_LOCAL(fluid_rvoice_eventhandler_t *handler, const fluid_rvoice_event_t *src_event)
 {
     fluid_rvoice_event_t *event;
-    int old_queue_stored = fluid_atomic_int_add(&handler->queue_stored, 1);
+    int old_queue_stored;
 
-    event = fluid_ringbuffer_get_inptr(handler->queue, old_queue_stored);
+    /* events following ones in the overflow segments must wait behind them */
+    if(handler->overflow_active)
+    {
+        if(handler->overflow_stored > 0 || fluid_atomic_int_get(&handler->overflow_pending) > 0)
+        {
+            return fluid_rvoice_eventhandler_push_overflow(handler, src_event);
+        }
+
+        /* all dispatched, back to the queue */
+        handler->overflow_active = FALSE;
+        fluid_rvoice_eventhandler_free_segments(handler);
+    }
 
-    if(event == NULL)
+    old_queue_stored = fluid_atomic_int_add(&handler->queue_stored, 1);
+
+    /* the free space only shrinks by our own pushes, only look again when it seems used up */
+    if(old_queue_stored >= handler->queue_space)
     {
-        fluid_atomic_int_add(&handler->queue_stored, -1);
-        FLUID_LOG(FLUID_WARN, "Ringbuffer full, try increasing synth.polyphony!");
-        return FLUID_FAILED; // Buffer full...
+        handler->queue_space = fluid_ringbuffer_get_space(handler->queue);
+
+        if(old_queue_stored >= handler->queue_space)
+        {
+            fluid_atomic_int_add(&handler->queue_stored, -1);
+            return fluid_rvoice_eventhandler_push_overflow(handler, src_event);
+        }
     }
 
+    event = fluid_ringbuffer_get_inptr_at(handler->queue, old_queue_stored);
+
     FLUID_MEMCPY(event, src_event, sizeof(*event));
 
     return FLUID_OK;
 }
 
+/**
+ * Make the events pushed to the overflow segments available to the dispatching thread,
+ * called by fluid_rvoice_eventhandler_flush() after flushing the queue.
+ */
+void
+fluid_rvoice_eventhandler_flush_overflow(fluid_rvoice_eventhandler_t *handler)
+{
+    fluid_rvoice_event_segment_t *segment;
+    int queued;
+
+    if(handler->overflow_stored == 0)
+    {
+        return;
+    }
+
+    queued = fluid_atomic_int_add(&handler->overflow_pending, handler->overflow_stored) + handler->overflow_stored;
+    handler->overflow_stored = 0;
+
+    for(segment = handler->overflow_commit; segment != handler->overflow_last; segment = segment->next)
+    {
+        fluid_atomic_int_set(&segment->committed, segment->pushed);
+    }
+
+    fluid_atomic_int_set(&segment->committed, segment->pushed);
+    handler->overflow_commit = segment;
+
+    queued += fluid_ringbuffer_get_count(handler->queue);
+
+    if(queued > handler->peak)
+    {
+        handler->peak = queued;
+    }
+}
+
+/* Dispatches the flushed events of the overflow segments */
+static int
+fluid_rvoice_eventhandler_dispatch_overflow(fluid_rvoice_eventhandler_t *handler)
+{
+    fluid_rvoice_event_segment_t *segment = handler->overflow_read, *next;
+    int committed, result = 0;
+
+    if(segment == NULL)
+    {
+        segment = fluid_atomic_pointer_get(&handler->overflow_start);
+    }
+
+    while(1)
+    {
+        committed = fluid_atomic_int_get(&segment->committed);
+
+        for(; segment->read < committed; segment->read++)
+        {
+            fluid_rvoice_event_dispatch(&segment->events[segment->read]);
+            result++;
+        }
+
+        next = fluid_atomic_pointer_get(&segment->next);
+
+        if(segment->read < FLUID_RVOICE_EVENT_SEGMENT_SIZE || next == NULL)
+        {
+            break;
+        }
+
+        /* the pushing thread may free it from now on */
+        fluid_atomic_int_set(&segment->done, TRUE);
+        segment = next;
+    }
+
+    handler->overflow_read = segment;
+    fluid_atomic_int_add(&handler->overflow_pending, -result);
+
+    return result;
+}
+
 
 void
 fluid_rvoice_eventhandler_finished_voice_callback(fluid_rvoice_eventhandler_t *eventhandler, fluid_rvoice_t *rvoice)
@@ -115,7 +281,8 @@ fluid_rvoice_eventhandler_t *
 new_fluid_rvoice_eventhandler(int queuesize,
                               int finished_voices_size, int bufs, int fx_bufs, int fx_units,
                               fluid_real_t sample_rate_max, fluid_real_t sample_rate,
-                              int extra_threads, int prio)
+                              int extra_threads, int prio,
+                              const int *cpus, int cpu_count)
 {
     fluid_rvoice_eventhandler_t *eventhandler = FLUID_NEW(fluid_rvoice_eventhandler_t);
 
@@ -125,11 +292,10 @@ new_fluid_rvoice_eventhandler(int queuesize,
         return NULL;
     }
 
-    eventhandler->mixer = NULL;
-    eventhandler->queue = NULL;
-    eventhandler->finished_voices = NULL;
+    FLUID_MEMSET(eventhandler, 0, sizeof(*eventhandler));
 
     fluid_atomic_int_set(&eventhandler->queue_stored, 0);
+    eventhandler->queue_space = 0;
 
     eventhandler->finished_voices = new_fluid_ringbuffer(finished_voices_size,
                                     sizeof(fluid_rvoice_t *));
@@ -147,7 +313,8 @@ new_fluid_rvoice_eventhandler(int queuesize,
     }
 
     eventhandler->mixer = new_fluid_rvoice_mixer(bufs, fx_bufs, fx_units,
-                          sample_rate_max, sample_rate, eventhandler, extra_threads, prio);
+                          sample_rate_max, sample_rate, eventhandler, extra_threads, prio,
+                          cpus, cpu_count);
 
     if(eventhandler->mixer == NULL)
     {
@@ -164,7 +331,7 @@ error_recovery:
 int
 fluid_rvoice_eventhandler_dispatch_count(fluid_rvoice_eventhandler_t *handler)
 {
-    return fluid_ringbuffer_get_count(handler->queue);
+    return fluid_ringbuffer_get_count(handler->queue) + fluid_atomic_int_get(&handler->overflow_pending);
 }
 
 
@@ -175,20 +342,50 @@ fluid_rvoice_eventhandler_dispatch_count(fluid_rvoice_eventhandler_t *handler)
 int
 fluid_rvoice_eventhandler_dispatch_all(fluid_rvoice_eventhandler_t *handler)
 {
-    fluid_rvoice_event_t *event;
-    int result = 0;
+    void *events;
+    int i, count, result = 0;
+
+    /* consume the events in contiguous batches, giving their space back once per batch */
+    while(0 < (count = fluid_ringbuffer_get_outptrs(handler->queue, &events)))
+    {
+        for(i = 0; i < count; i++)
+        {
+            fluid_rvoice_event_dispatch((fluid_rvoice_event_t *)events + i);
+        }
+
+        result += count;
+        fluid_ringbuffer_next_outptrs(handler->queue, count);
+    }
 
-    while(NULL != (event = fluid_ringbuffer_get_outptr(handler->queue)))
+    /* pushed while the queue was full, after all of the events in it */
+    if(fluid_atomic_int_get(&handler->overflow_pending) > 0)
     {
-        fluid_rvoice_event_dispatch(event);
-        result++;
-        fluid_ringbuffer_next_outptr(handler->queue);
+        result += fluid_rvoice_eventhandler_dispatch_overflow(handler);
     }
 
     return result;
 }
 
 
+/**
+ * Get the memory used by the event queues in bytes.
+ */
+size_t
+fluid_rvoice_eventhandler_get_queue_memory(const fluid_rvoice_eventhandler_t *handler)
+{
+    const fluid_rvoice_event_segment_t *segment;
+    size_t size = sizeof(*handler) + sizeof(*handler->queue) + handler->queue->totalcount * handler->queue->elementsize
+                  + sizeof(*handler->finished_voices)
+                  + handler->finished_voices->totalcount * handler->finished_voices->elementsize;
+
+    for(segment = handler->overflow_first; segment != NULL; segment = segment->next)
+    {
+        size += sizeof(*segment);
+    }
+
+    return size;
+}
+
 void
 delete_fluid_rvoice_eventhandler(fluid_rvoice_eventhandler_t *handler)
 {
@@ -196,6 +393,15 @@ delete_fluid_rvoice_eventhandler(fluid_rvoice_eventhandler_t *handler)
 
     delete_fluid_rvoice_mixer(handler->mixer);
     delete_fluid_ringbuffer(handler->queue);
+
+    while(handler->overflow_first != NULL)
+    {
+        fluid_rvoice_event_segment_t *segment = handler->overflow_first;
+
+        handler->overflow_first = segment->next;
+        FLUID_FREE(segment);
+    }
+
     delete_fluid_ringbuffer(handler->finished_voices);
     FLUID_FREE(handler);
 }
@@ -29,14 +29,7 @@
 extern "C" {
 #endif
 
-typedef struct _fluid_rvoice_event_t fluid_rvoice_event_t;
-
-struct _fluid_rvoice_event_t
-{
-    fluid_rvoice_function_t method;
-    void *object;
-    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
-};
+typedef struct _fluid_rvoice_event_segment_t fluid_rvoice_event_segment_t;
 
 /*
  * Bridge between the renderer thread and the midi state thread.
@@ -47,20 +40,37 @@ struct _fluid_rvoice_eventhandler_t
 {
     fluid_ringbuffer_t *queue; /**< List of fluid_rvoice_event_t */
     fluid_atomic_int_t queue_stored; /**< Extras pushed but not flushed */
+    int queue_space; /**< Free elements of queue when last read, so that push doesn't read the shared count every time */
     fluid_ringbuffer_t *finished_voices; /**< return queue from handler, list of fluid_rvoice_t* */
     fluid_rvoice_mixer_t *mixer;
+
+    /* Events pushed while queue is full go to a chain of segments allocated by the pushing
+     * thread. Until they have all been dispatched, the following events are appended to
+     * them as well, so that the order is kept. */
+    int overflow_active;       /**< Pushing thread only: TRUE while events go to the segments */
+    int overflow_stored;       /**< Pushing thread only: events pushed to the segments but not flushed */
+    fluid_rvoice_event_segment_t *overflow_first;  /**< Pushing thread only: oldest segment not freed yet */
+    fluid_rvoice_event_segment_t *overflow_last;   /**< Pushing thread only: segment events are pushed to */
+    fluid_rvoice_event_segment_t *overflow_commit; /**< Pushing thread only: first segment with events not flushed */
+    fluid_rvoice_event_segment_t *overflow_start;  /**< Atomic: first segment ever allocated */
+    fluid_rvoice_event_segment_t *overflow_read;   /**< Dispatching thread only: segment events are dispatched from */
+    fluid_atomic_int_t overflow_pending; /**< Atomic: events flushed to the segments but not dispatched yet */
+    int peak;                  /**< Pushing thread only: most events queued at once after a flush */
 };
 
 fluid_rvoice_eventhandler_t *new_fluid_rvoice_eventhandler(
     int queuesize, int finished_voices_size, int bufs,
-    int fx_bufs, int fx_units, fluid_real_t sample_rate_max, fluid_real_t sample_rate, int, int);
+    int fx_bufs, int fx_units, fluid_real_t sample_rate_max, fluid_real_t sample_rate, int, int,
+    const int *, int);
 
 void delete_fluid_rvoice_eventhandler(fluid_rvoice_eventhandler_t *);
 
 int fluid_rvoice_eventhandler_dispatch_all(fluid_rvoice_eventhandler_t *);
 int fluid_rvoice_eventhandler_dispatch_count(fluid_rvoice_eventhandler_t *);
+size_t fluid_rvoice_eventhandler_get_queue_memory(const fluid_rvoice_eventhandler_t *handler);
 void fluid_rvoice_eventhandler_finished_voice_callback(fluid_rvoice_eventhandler_t *eventhandler,
         fluid_rvoice_t *rvoice);
+void fluid_rvoice_eventhandler_flush_overflow(fluid_rvoice_eventhandler_t *handler);
 
 static FLUID_INLINE void
 fluid_rvoice_eventhandler_flush(fluid_rvoice_eventhandler_t *handler)
@@ -71,6 +81,20 @@ fluid_rvoice_eventhandler_flush(fluid_rvoice_eventhandler_t *handler)
     {
         fluid_atomic_int_set(&handler->queue_stored, 0);
         fluid_ringbuffer_next_inptr(handler->queue, queue_stored);
+        handler->queue_space -= queue_stored;
+
+        queue_stored = fluid_ringbuffer_get_count(handler->queue);
+
+        if(queue_stored > handler->peak)
+        {
+            handler->peak = queue_stored;
+        }
+    }
+
+    /* the segments are only flushed after the queue, the events in there are older */
+    if(handler->overflow_active)
+    {
+        fluid_rvoice_eventhandler_flush_overflow(handler);
     }
 }
 
@@ -112,6 +136,18 @@ fluid_rvoice_eventhandler_add_rvoice(fluid_rvoice_eventhandler_t *handler,
                                        handler->mixer, rvoice);
 }
 
+/* Adds the rvoice of one sample of a stereo pair, played along with partner, see synth.stereo-voices */
+static FLUID_INLINE void
+fluid_rvoice_eventhandler_add_stereo_rvoice(fluid_rvoice_eventhandler_t *handler,
+                                            fluid_rvoice_t *rvoice, fluid_rvoice_t *partner)
+{
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+
+    param[0].ptr = rvoice;
+    param[1].ptr = partner;
+    fluid_rvoice_eventhandler_push(handler, fluid_rvoice_mixer_add_stereo_voice, handler->mixer, param);
+}
+
 #ifdef __cplusplus
 }
 #endif
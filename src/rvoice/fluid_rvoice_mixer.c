@@ -19,9 +19,12 @@
 
 #include "fluid_rvoice_mixer.h"
 #include "fluid_rvoice.h"
+#include "fluid_rvoice_cache.h"
 #include "fluid_sys.h"
 #include "fluid_rev.h"
 #include "fluid_chorus.h"
+#include "fluid_convolver.h"
+#include "fluid_fx_resampler.h"
 #include "fluid_limiter.h"
 #include "fluid_ladspa.h"
 #include "fluid_synth.h"
@@ -31,6 +34,22 @@
 // so don't activate the thread(s).
 #define VOICES_PER_THREAD 8
 
+// Number of consecutive voices rendered and summed up together with synth.deterministic-render
+#define FLUID_MIXER_SLICE_VOICES 8
+
+// Number of blocks after which the voices are sorted by their playback position again with synth.voice-locality
+#define FLUID_MIXER_LOCALITY_BLOCKS 64
+
+// An effects unit is bypassed once its input and output have stayed below this
+// level (-140 dB) for FLUID_FX_TAIL_SECONDS, but at least FLUID_FX_TAIL_MIN_SAMPLES.
+// The minimum covers the delay line of the chorus, which doesn't depend on the sample rate.
+#define FLUID_FX_SILENCE_LEVEL 1e-7
+#define FLUID_FX_TAIL_SECONDS 0.1
+#define FLUID_FX_TAIL_MIN_SAMPLES 4096
+
+// The rate of the reverb and chorus units is never reduced below this, see synth.fx-decimation
+#define FLUID_FX_MIN_DECIMATED_RATE 44100
+
 typedef struct _fluid_mixer_buffers_t fluid_mixer_buffers_t;
 
 struct _fluid_mixer_buffers_t
@@ -39,10 +58,23 @@ struct _fluid_mixer_buffers_t
 #if ENABLE_MIXER_THREADS
     fluid_thread_t *thread;     /**< Thread object */
     fluid_atomic_int_t ready;   /**< Atomic: buffers are ready for mixing */
+
+    /* The voices of one render run are split into contiguous chunks of mixer->rvoices,
+     * one chunk per participating thread. A thread first works through its own chunk
+     * and then steals voices from the chunks of its neighbours. */
+    int thread_idx;                  /**< Index of this thread among the render participants, 0 is the main thread */
+    fluid_atomic_int_t next_rvoice;  /**< Atomic: index of the next unrendered voice in this chunk */
+    int end_rvoice;                  /**< Read-only during rendering: end (exclusive) of this chunk */
+    fluid_mixer_buffers_t *next_task; /**< Next queued task of the render pool, protected by its mutex */
+    int cpu;                         /**< CPU the thread pins itself to on startup, -1 if none */
+    int workgroup_serial;            /**< Value of mixer->workgroup_serial when the thread last joined the workgroup */
+    void *workgroup_membership;      /**< Membership of the thread in mixer->workgroup, NULL if none */
+    int deadline_checked;            /**< TRUE once the thread applied mixer->deadline_period */
 #endif
 
     fluid_rvoice_t **finished_voices; /* List of voices who have finished */
     int finished_voice_count;
+    int finished_voices_size; /**< Number of elements of finished_voices */
 
     fluid_real_t *local_buf;
 
@@ -70,9 +102,18 @@ struct _fluid_mixer_buffers_t
      */
     fluid_real_t *fx_left_buf;
     fluid_real_t *fx_right_buf;
+
+    /** For each buffer in the order of fluid_mixer_buffers_prepare(), i.e. the left and right
+     * buffer of each audio group followed by each effects channel (left and right together):
+     * TRUE if it may hold non-zero samples. The other buffers are entirely silent, so that
+     * clearing, effects processing and the output can skip them.
+     */
+    unsigned char *live;
+    int live_blockcount; /**< Number of blocks at the start of the live buffers that may be non-zero */
 };
 
 typedef struct _fluid_mixer_fx_t fluid_mixer_fx_t;
+typedef struct _fluid_mixer_arrays_t fluid_mixer_arrays_t;
 
 struct _fluid_mixer_fx_t
 {
@@ -80,11 +121,30 @@ struct _fluid_mixer_fx_t
     /* reverb shadow parameters here will be returned if queried */
     double reverb_param[FLUID_REVERB_PARAM_LAST];
     int reverb_on; /* reverb on/off */
+    fluid_convolver_t *convolver; /**< Convolution reverb used instead of the reverb unit, NULL if none. Owned by the synth */
 
     fluid_chorus_t *chorus; /**< Chorus unit */
     /* chorus shadow parameters here will be returned if queried */
     double chorus_param[FLUID_CHORUS_PARAM_LAST];
     int chorus_on; /* chorus on/off */
+
+    /* number of consecutive blocks the input and output of each unit have been silent,
+     * the unit is bypassed once it reaches fx_tail_blocks */
+    int reverb_silent_blocks;
+    int chorus_silent_blocks;
+
+    /* run the reverb and chorus at a reduced rate, NULL unless synth.fx-decimation is set */
+    fluid_fx_resampler_t *reverb_rs;
+    fluid_fx_resampler_t *chorus_rs;
+
+    /* parameters the units have been set to in the mixer context, to find identical units */
+    fluid_real_t reverb_set[FLUID_REVERB_PARAM_LAST];
+    fluid_real_t chorus_set[FLUID_CHORUS_PARAM_LAST];
+
+    /* index of the unit processing the sends of this one in mix mode, itself
+     * unless it shares the reverb or chorus of another unit, see synth.fx-share */
+    int reverb_leader;
+    int chorus_leader;
 };
 
 struct _fluid_rvoice_mixer_t
@@ -96,16 +156,31 @@ struct _fluid_rvoice_mixer_t
 
     fluid_rvoice_t **rvoices; /**< Read-only: Voices array, sorted so that all nulls are last */
     int polyphony; /**< Read-only: Length of voices array */
+    fluid_mixer_arrays_t *retired; /**< Atomic: arrays swapped out, to be freed by the API thread, linked by next */
+    int queued_polyphony;   /**< Used by the API thread only: polyphony once all queued events are processed */
     int active_voices; /**< Read-only: Number of non-null voices */
     int current_blockcount;      /**< Read-only: how many blocks to process this time */
     int fx_units;
     int with_reverb;        /**< Should the synth use the built-in reverb unit? */
     int with_chorus;        /**< Should the synth use the built-in chorus unit? */
     int mix_fx_to_out;      /**< Should the effects be mixed in with the primary output? */
+    int fx_tail_blocks;     /**< Number of silent blocks after which an effects unit is bypassed */
+    int fx_decimation;      /**< Highest factor the rate of the reverb and chorus may be reduced by, see synth.fx-decimation */
+    int fx_factor;          /**< Factor the rate of the reverb and chorus is currently reduced by */
+    int fx_share;           /**< Process the sends of units with identical parameters by one unit? See synth.fx-share */
+    fluid_real_t sample_rate; /**< Output sample rate */
+    int voice_locality;     /**< Order the voices by the sample memory they read? See synth.voice-locality */
+    int locality_blocks;    /**< Blocks rendered since the voices were last sorted by their position */
+    int parallel_groups;    /**< Render each audio group end-to-end on a thread of its own? See synth.parallel-audio-groups */
+    enum fluid_iir_filter_smoothing filter_smoothing; /**< How the voice filters follow fres and Q, see synth.filter-smoothing */
+    int float_interp;       /**< Interpolate the voices in single precision? See synth.float-interpolation */
 
-#ifdef LIMITER_SUPPORT
     fluid_limiter_t *limiter;
-#endif
+    fluid_perf_t *perf;      /**< Render stage statistics of the synth, NULL if none */
+    fluid_voice_snapshot_t *voice_snapshot; /**< Voice snapshot of the synth, NULL if none, see synth.voice-snapshot */
+    fluid_meter_t *meter;    /**< Level meters of the synth, NULL if none, see synth.metering */
+    fluid_rvoice_cache_t *voice_cache; /**< Rendered notes, NULL if disabled, see synth.voice-cache */
+    fluid_mixer_buffers_t *slice_buffers; /**< Buffers the main thread renders slices into, NULL unless synth.deterministic-render is set */
 
 #ifdef LADSPA
     fluid_ladspa_fx_t *ladspa_fx; /**< Used by mixer only: Effects unit for LADSPA support. Never created or freed */
@@ -115,1630 +190,4869 @@ struct _fluid_rvoice_mixer_t
 //  int sleeping_threads;        /**< Atomic: number of threads currently asleep */
 //  int active_threads;          /**< Atomic: number of threads in the thread loop */
     fluid_atomic_int_t threads_should_terminate; /**< Atomic: Set to TRUE when threads should terminate */
-    fluid_atomic_int_t current_rvoice;           /**< Atomic: for the threads to know next voice to  */
+    int active_threads;          /**< Read-only during rendering: number of threads (incl. the main thread) rendering voices this run */
+    fluid_atomic_int_t next_slice; /**< Atomic: index of the next slice to render, see synth.deterministic-render */
+    fluid_atomic_int_t mixed_slices; /**< Atomic: number of slices added to the mixer buffers so far */
+    int groups_active;           /**< Read-only during rendering: TRUE if the audio groups are rendered in parallel this run */
+    fluid_atomic_int_t next_group; /**< Atomic: index of the next audio group to render, see synth.parallel-audio-groups */
     fluid_cond_t *wakeup_threads; /**< Signalled when the threads should wake up */
     fluid_cond_mutex_t *wakeup_threads_m; /**< wakeup_threads mutex companion */
     fluid_cond_t *thread_ready; /**< Signalled from thread, when the thread has a buffer ready for mixing */
     fluid_cond_mutex_t *thread_ready_m; /**< thread_ready mutex companion */
 
+    int thread_wait;             /**< How threads wait for each other, see enum fluid_mixer_thread_wait */
+    fluid_atomic_int_t threads_sleeping; /**< Atomic: number of threads blocked (or about to block) on wakeup_threads */
+    fluid_atomic_int_t main_sleeping; /**< Atomic: TRUE while the main thread is blocked (or about to block) on thread_ready */
+
     int thread_count;            /**< Number of extra mixer threads for multi-core rendering */
     fluid_mixer_buffers_t *threads;    /**< Array of mixer threads (thread_count in length) */
+
+    int own_thread_count;        /**< Number of extra mixer threads to use when not attached to a render pool */
+    int queued_thread_count;     /**< Used by the API thread only: thread_count once all queued events are processed */
+    fluid_render_pool_t *queued_pool; /**< Used by the API thread only: pool once all queued events are processed */
+    int prio_level;              /**< realtime prio level for the extra mixer threads */
+    int *cpus;                   /**< CPUs the extra mixer threads are pinned to, round-robin */
+    int cpu_count;               /**< Number of elements in cpus, 0 if the threads are not pinned */
+    fluid_render_pool_t *pool;   /**< Render pool whose workers render the voices, NULL if using own threads */
+    int pool_tasks_running;      /**< Number of our tasks currently processed by pool workers, protected by the pool mutex */
+    int pool_detaching;          /**< TRUE while waiting for pool_tasks_running to drop to zero, protected by the pool mutex */
+
+    fluid_mixer_buffers_t *fx_stage; /**< Buffers of the pipelined effects stage, NULL if the effects are processed in line, see synth.fx-pipeline */
+    fluid_thread_t *fx_thread;   /**< Thread processing the effects of fx_stage */
+    fluid_cond_t *fx_stage_cond; /**< Signalled when fx_stage_state changes */
+    fluid_cond_mutex_t *fx_stage_m; /**< fx_stage_cond mutex companion, protects fx_stage_state */
+    int fx_stage_state;          /**< Whether fx_stage is being processed, see enum fluid_mixer_fx_stage_state */
+    int fx_stage_blockcount;     /**< Number of blocks in fx_stage waiting for their effects */
+    int fx_workgroup_serial;     /**< Used by the fx thread only, see fluid_mixer_buffers_t::workgroup_serial */
+    void *fx_workgroup_membership; /**< Used by the fx thread only, see fluid_mixer_buffers_t::workgroup_membership */
+    int fx_deadline_checked;     /**< Used by the fx thread only, see fluid_mixer_buffers_t::deadline_checked */
+    int deadline_runtime;        /**< CPU time in us reserved per period for the extra threads, see fluid_rvoice_mixer_set_deadline() */
+    int deadline_period;         /**< Period in us of the deadline scheduling, 0 if not used */
+    int flush_denormals;         /**< TRUE if the extra threads flush denormal numbers to zero, see synth.flush-denormals */
+
+    fluid_mutex_t workgroup_m;   /**< Protects workgroup */
+    void *workgroup;             /**< Audio workgroup the extra threads join, NULL if none, see fluid_rvoice_mixer_set_workgroup() */
+    fluid_atomic_int_t workgroup_serial; /**< Atomic: incremented whenever workgroup changes */
 #endif
 };
 
+/*
+ * Arrays sized for a new polyphony or the buffers of new extra threads, passed from the API
+ * thread to the mixer with fluid_rvoice_mixer_set_polyphony() or
+ * fluid_rvoice_mixer_set_render_pool(). The mixer swaps them with its current ones and puts
+ * the block on its retired list, so that the audio thread neither allocates nor frees memory
+ * when it is reconfigured. The API thread frees the retired blocks the next time it
+ * reconfigures the mixer.
+ */
+struct _fluid_mixer_arrays_t
+{
+    int polyphony;                /**< Length of rvoices and of each finished_voices array */
+    fluid_rvoice_t **rvoices;     /**< Voices array of the mixer */
+    int finished_count;           /**< Number of elements of finished_voices */
+    fluid_rvoice_t ***finished_voices; /**< For the own buffers, each thread and the slice buffers */
 #if ENABLE_MIXER_THREADS
-static void delete_rvoice_mixer_threads(fluid_rvoice_mixer_t *mixer);
-static int fluid_rvoice_mixer_set_threads(fluid_rvoice_mixer_t *mixer, int thread_count, int prio_level);
+    fluid_render_pool_t *pool;    /**< Render pool to attach to, NULL for the own threads */
+    int thread_count;             /**< Number of elements of threads */
+    fluid_mixer_buffers_t *threads; /**< Buffers of the extra threads, not started yet */
+    int old_thread_count;         /**< Number of elements of old_threads */
+    fluid_mixer_buffers_t *old_threads; /**< Buffers of the stopped threads */
 #endif
+    fluid_mixer_arrays_t *next;   /**< Next block on the retired list */
+};
 
-static FLUID_INLINE void
-fluid_rvoice_mixer_process_fx(fluid_rvoice_mixer_t *mixer, int current_blockcount)
-{
-    // Making those variables const causes gcc to fail with "variable is predetermined ‘shared’ for ‘shared’".
-    // Not explicitly marking them shared makes it fail for clang and MSVC...
-    /*const*/ int fx_channels_per_unit = mixer->buffers.fx_buf_count / mixer->fx_units;
-    /*const*/ int dry_count = mixer->buffers.buf_count; /* dry buffers count */
-    /*const*/ int mix_fx_to_out = mixer->mix_fx_to_out; /* get mix_fx_to_out mode */
-    
-    void (*reverb_process_func)(fluid_revmodel_t *rev, const fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out);
-    void (*chorus_process_func)(fluid_chorus_t *chorus, const fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out);
+#if ENABLE_MIXER_THREADS
+/*
+ * A set of worker threads shared by several mixers. Instead of waking its own threads,
+ * an attached mixer queues the buffers of its extra render participants as tasks,
+ * which are picked up by the next idle worker of the pool.
+ */
+typedef struct _fluid_render_batch_t fluid_render_batch_t;
 
-    fluid_real_t *out_rev_l, *out_rev_r, *out_ch_l, *out_ch_r;
+struct _fluid_render_pool_t
+{
+    int thread_count;             /**< Number of worker threads */
+    fluid_thread_t **threads;     /**< Array of worker threads (thread_count in length) */
+    fluid_cond_t *task_ready;     /**< Signalled when tasks have been queued or the workers should terminate */
+    fluid_cond_mutex_t *task_m;   /**< Protects the task queue and should_terminate */
+    fluid_mixer_buffers_t *head;  /**< First pending task, linked by next_task */
+    fluid_mixer_buffers_t *tail;  /**< Last pending task */
+    int should_terminate;         /**< Set to TRUE when the workers should terminate */
+    fluid_atomic_int_t attached;  /**< Atomic: number of mixers using this pool */
+    int *cpus;                    /**< CPUs the workers are pinned to, round-robin */
+    int cpu_count;                /**< Number of elements in cpus, 0 if the workers are not pinned */
+    fluid_atomic_int_t started;   /**< Atomic: number of workers started so far, used to assign their CPU */
+    int deadline_runtime;         /**< CPU time in us reserved per period for the workers */
+    int deadline_period;          /**< Period in us of the deadline scheduling, 0 if not used */
+    fluid_render_batch_t *batches; /**< Batches with items not taken yet, linked by next_batch, protected by task_m */
+};
 
-    // all dry unprocessed mono input is stored in the left channel
-    fluid_real_t *in_rev = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-    fluid_real_t *in_ch = in_rev;
+/*
+ * Independent items run by fluid_rvoice_render_pool_run(). Idle workers of the pool and the
+ * calling thread take the next item until all have been taken. Protected by the task_m of the pool.
+ */
+struct _fluid_render_batch_t
+{
+    fluid_render_pool_func_t func; /**< Runs one item */
+    void *data;                   /**< User data passed to func */
+    int count;                    /**< Number of items */
+    int next;                     /**< Next item to take */
+    int done;                     /**< Number of items run to completion */
+    fluid_render_batch_t *next_batch; /**< Next batch with items not taken yet */
+};
 
-    fluid_profile_ref_var(prof_ref);
+enum fluid_mixer_fx_stage_state
+{
+    FX_STAGE_IDLE,          /* the contents of fx_stage are not being processed */
+    FX_STAGE_PROCESSING,    /* the effects thread processes fx_stage */
+    FX_STAGE_TERMINATE      /* the effects thread should terminate */
+};
 
-#ifdef LADSPA
+static void delete_rvoice_mixer_threads(fluid_rvoice_mixer_t *mixer);
+static void delete_fluid_mixer_threads(fluid_mixer_buffers_t *threads, int thread_count);
+static void delete_rvoice_mixer_fx_stage(fluid_rvoice_mixer_t *mixer);
+static int fluid_rvoice_mixer_set_threads(fluid_rvoice_mixer_t *mixer, int thread_count, int prio_level);
+#endif
+static void fluid_rvoice_mixer_update_fx_share(fluid_rvoice_mixer_t *mixer);
 
-    /* Run the signal through the LADSPA Fx unit. The buffers have already been
-     * set up in fluid_rvoice_mixer_set_ladspa. */
-    if(mixer->ladspa_fx)
+/*
+ * Returns the number of silent blocks after which an effects unit is bypassed.
+ */
+static int fluid_rvoice_mixer_fx_tail_blocks(fluid_real_t sample_rate)
+{
+    int samples = (int)(sample_rate * FLUID_FX_TAIL_SECONDS);
+
+    if(samples < FLUID_FX_TAIL_MIN_SAMPLES)
     {
-        fluid_ladspa_run(mixer->ladspa_fx, current_blockcount, FLUID_BUFSIZE);
-        fluid_check_fpe("LADSPA");
+        samples = FLUID_FX_TAIL_MIN_SAMPLES;
     }
 
-#endif
+    return (samples + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
+}
 
-    if(mix_fx_to_out)
-    {
-        // mix effects to first stereo channel
-        out_ch_l = out_rev_l = fluid_align_ptr(mixer->buffers.left_buf, FLUID_DEFAULT_ALIGNMENT);
-        out_ch_r = out_rev_r = fluid_align_ptr(mixer->buffers.right_buf, FLUID_DEFAULT_ALIGNMENT);
+/*
+ * TRUE if all samples of a block are below FLUID_FX_SILENCE_LEVEL.
+ */
+static FLUID_INLINE int
+fluid_rvoice_mixer_block_is_silent(const fluid_real_t *buf)
+{
+    fluid_real_t peak = 0;
+    int i;
 
-        reverb_process_func = fluid_revmodel_processmix;
-        chorus_process_func = fluid_chorus_processmix;
-    }
-    else
+    for(i = 0; i < FLUID_BUFSIZE; i++)
     {
-        // replace effects into respective stereo effects channel
-        out_ch_l = out_rev_l = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-        out_ch_r = out_rev_r = fluid_align_ptr(mixer->buffers.fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
-
-        reverb_process_func = fluid_revmodel_processreplace;
-        chorus_process_func = fluid_chorus_processreplace;
+        fluid_real_t v = FLUID_FABS(buf[i]);
+        peak = (v > peak) ? v : peak;
     }
 
-    if(mixer->with_reverb || mixer->with_chorus)
-    {
-#if ENABLE_MIXER_THREADS && !defined(WITH_PROFILING)
-        int fx_mixer_threads = mixer->fx_units;
-        fluid_clip(fx_mixer_threads, 1, mixer->thread_count + 1);
-        #pragma omp parallel default(none) shared(mixer, reverb_process_func, chorus_process_func, dry_count, current_blockcount, mix_fx_to_out, fx_channels_per_unit) firstprivate(in_rev, in_ch, out_rev_l, out_rev_r, out_ch_l, out_ch_r) num_threads(fx_mixer_threads)
-#endif
-        {
-            int i, f;
-            int buf_idx;  /* buffer index */
-            int samp_idx; /* sample index in buffer */
-            int dry_idx = 0; /* dry buffer index */
-            int sample_count; /* sample count to process */
-            if(mixer->with_reverb)
-            {
-#if ENABLE_MIXER_THREADS && !defined(WITH_PROFILING)
-                #pragma omp for schedule(static)
-#endif
-                for(f = 0; f < mixer->fx_units; f++)
-                {
-                    if(!mixer->fx[f].reverb_on)
-                    {
-                        continue; /* this reverb unit is disabled */
-                    }
-
-                    buf_idx = f * fx_channels_per_unit + SYNTH_REVERB_CHANNEL;
-                    samp_idx = buf_idx * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE;
-                    sample_count = current_blockcount * FLUID_BUFSIZE;
-
-                    /* in mix mode, map fx out_rev at index f to a dry buffer at index dry_idx */
-                    if(mix_fx_to_out)
-                    {
-                        /* dry buffer mapping, should be done more flexible in the future */
-                        dry_idx = (f % dry_count) * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE;
-                    }
-
-                    for(i = 0; i < sample_count; i += FLUID_BUFSIZE, samp_idx += FLUID_BUFSIZE)
-                    {
-                        reverb_process_func(mixer->fx[f].reverb,
-                                            &in_rev[samp_idx],
-                                            mix_fx_to_out ? &out_rev_l[dry_idx + i] : &out_rev_l[samp_idx],
-                                            mix_fx_to_out ? &out_rev_r[dry_idx + i] : &out_rev_r[samp_idx]);
-                    }
-                } // implicit omp barrier - required, because out_rev_l aliases with out_ch_l
-
-                fluid_profile(FLUID_PROF_ONE_BLOCK_REVERB, prof_ref, 0,
-                            current_blockcount * FLUID_BUFSIZE);
-            }
+    return peak < FLUID_FX_SILENCE_LEVEL;
+}
 
-            if(mixer->with_chorus)
-            {
-#if ENABLE_MIXER_THREADS && !defined(WITH_PROFILING)
-                #pragma omp for schedule(static)
-#endif
-                for(f = 0; f < mixer->fx_units; f++)
-                {
-                    if(!mixer->fx[f].chorus_on)
-                    {
-                        continue; /* this chorus unit is disabled */
-                    }
-
-                    buf_idx = f * fx_channels_per_unit + SYNTH_CHORUS_CHANNEL;
-                    samp_idx = buf_idx * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE;
-                    sample_count = current_blockcount * FLUID_BUFSIZE;
-
-                    /* in mix mode, map fx out_ch at index f to a dry buffer at index dry_idx */
-                    if(mix_fx_to_out)
-                    {
-                        /* dry buffer mapping, should be done more flexible in the future */
-                        dry_idx = (f % dry_count) * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE;
-                    }
-
-                    for(i = 0; i < sample_count; i += FLUID_BUFSIZE, samp_idx += FLUID_BUFSIZE)
-                    {
-                        chorus_process_func(mixer->fx[f].chorus,
-                                            &in_ch [samp_idx],
-                                            mix_fx_to_out ? &out_ch_l[dry_idx + i] : &out_ch_l[samp_idx],
-                                            mix_fx_to_out ? &out_ch_r[dry_idx + i] : &out_ch_r[samp_idx]);
-                    }
-                }
+/*
+ * Outputs a block of an effects unit processed from silent input, and counts
+ * the consecutive blocks its tail has also been silent.
+ * @return TRUE if the tail has died out, i.e. the unit can be reset and bypassed
+ */
+static int
+fluid_rvoice_mixer_fx_tail(fluid_rvoice_mixer_t *mixer, int *silent_blocks,
+                           const fluid_real_t *tail_l, const fluid_real_t *tail_r,
+                           fluid_real_t *out_l, fluid_real_t *out_r)
+{
+    int i;
 
-                fluid_profile(FLUID_PROF_ONE_BLOCK_CHORUS, prof_ref, 0,
-                            current_blockcount * FLUID_BUFSIZE);
-            }
+    /* same result as the processmix() functions, which add the output of a sample in one go */
+    if(mixer->mix_fx_to_out)
+    {
+        for(i = 0; i < FLUID_BUFSIZE; i++)
+        {
+            out_l[i] += tail_l[i];
+            out_r[i] += tail_r[i];
         }
     }
+    else
+    {
+        FLUID_MEMCPY(out_l, tail_l, FLUID_BUFSIZE * sizeof(fluid_real_t));
+        FLUID_MEMCPY(out_r, tail_r, FLUID_BUFSIZE * sizeof(fluid_real_t));
+    }
 
-#ifdef LIMITER_SUPPORT
-    if(mixer->limiter)
+    if(fluid_rvoice_mixer_block_is_silent(tail_l) && fluid_rvoice_mixer_block_is_silent(tail_r))
     {
-        fluid_real_t* buf_l = fluid_align_ptr(mixer->buffers.left_buf, FLUID_DEFAULT_ALIGNMENT);
-        fluid_real_t* buf_r = fluid_align_ptr(mixer->buffers.right_buf, FLUID_DEFAULT_ALIGNMENT);
-        fluid_limiter_run(mixer->limiter, buf_l, buf_r, current_blockcount);
-        fluid_check_fpe("LIMITER");
+        return ++*silent_blocks >= mixer->fx_tail_blocks;
     }
-#endif
 
+    *silent_blocks = 0;
+    return FALSE;
 }
 
-/**
- * Glue to get fluid_rvoice_buffers_mix what it wants
- * Note: Make sure outbufs has 2 * (buf_count + fx_buf_count) elements before calling
+/*
+ * Processes a block of the convolution reverb of an fx unit. Its output is exactly
+ * silent once the input has been silent for the length of the impulse response,
+ * from then on the convolver is bypassed.
  */
-static FLUID_INLINE int
-fluid_mixer_buffers_prepare(fluid_mixer_buffers_t *buffers, fluid_real_t **outbufs)
+static void
+fluid_rvoice_mixer_convolve(fluid_rvoice_mixer_t *mixer, fluid_mixer_fx_t *fx,
+                            const fluid_real_t *in, fluid_real_t *out_l, fluid_real_t *out_r)
 {
-    fluid_real_t *base_ptr;
-    int i;
-    const int fx_channels_per_unit = buffers->fx_buf_count / buffers->mixer->fx_units;
-    const int offset = buffers->buf_count * 2;
-    int with_reverb = buffers->mixer->with_reverb;
-    int with_chorus = buffers->mixer->with_chorus;
-
-    /* Set up the reverb and chorus buffers only when the effect is enabled or
-     * when LADSPA is active. Nonexisting buffers are detected in the DSP loop.
-     * Not sending the effect signals saves some time in that case. */
-#ifdef LADSPA
-    int with_ladspa = (buffers->mixer->ladspa_fx != NULL);
-    with_reverb = (with_reverb | with_ladspa);
-    with_chorus = (with_chorus | with_ladspa);
-#endif
-
-    // all the dry, non-processed mono audio for effects is to be stored in the left buffers
-    base_ptr = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    int tail_blocks = fluid_convolver_get_partitions(fx->convolver);
 
-    for(i = 0; i < buffers->mixer->fx_units; i++)
+    if(!fluid_rvoice_mixer_block_is_silent(in))
     {
-        int fx_idx = i * fx_channels_per_unit;
-
-        outbufs[offset + fx_idx + SYNTH_REVERB_CHANNEL] =
-            (with_reverb)
-            ? &base_ptr[(fx_idx + SYNTH_REVERB_CHANNEL) * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT]
-            : NULL;
-
-        outbufs[offset + fx_idx + SYNTH_CHORUS_CHANNEL] =
-            (with_chorus)
-            ? &base_ptr[(fx_idx + SYNTH_CHORUS_CHANNEL) * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT]
-            : NULL;
+        fx->reverb_silent_blocks = 0;
     }
-
-    /* The output associated with a MIDI channel is wrapped around
-     * using the number of audio groups as modulo divider.  This is
-     * typically the number of output channels on the 'sound card',
-     * as long as the LADSPA Fx unit is not used. In case of LADSPA
-     * unit, think of it as subgroups on a mixer.
-     *
-     * For example: Assume that the number of groups is set to 2.
-     * Then MIDI channel 1, 3, 5, 7 etc. go to output 1, channels 2,
-     * 4, 6, 8 etc to output 2.  Or assume 3 groups: Then MIDI
-     * channels 1, 4, 7, 10 etc go to output 1; 2, 5, 8, 11 etc to
-     * output 2, 3, 6, 9, 12 etc to output 3.
-     */
-    base_ptr = fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
-
-    for(i = 0; i < buffers->buf_count; i++)
+    else if(fx->reverb_silent_blocks < tail_blocks && ++fx->reverb_silent_blocks == tail_blocks)
     {
-        outbufs[i * 2] = &base_ptr[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
+        /* forget the input below the silence level, to resume from a clean state */
+        fluid_convolver_reset(fx->convolver);
     }
 
-    base_ptr = fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT);
-
-    for(i = 0; i < buffers->buf_count; i++)
+    if(fx->reverb_silent_blocks >= tail_blocks)
     {
-        outbufs[i * 2 + 1] = &base_ptr[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
-    }
-
-    return offset + buffers->fx_buf_count;
-}
+        if(!mixer->mix_fx_to_out)
+        {
+            FLUID_MEMSET(out_l, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
+            FLUID_MEMSET(out_r, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
+        }
 
+        return;
+    }
 
-static FLUID_INLINE void
-fluid_finish_rvoice(fluid_mixer_buffers_t *buffers, fluid_rvoice_t *rvoice)
-{
-    if(buffers->finished_voice_count < buffers->mixer->polyphony)
+    if(mixer->mix_fx_to_out)
     {
-        buffers->finished_voices[buffers->finished_voice_count++] = rvoice;
+        fluid_convolver_processmix(fx->convolver, in, out_l, out_r);
     }
     else
     {
-        FLUID_LOG(FLUID_ERR, "Exceeded finished voices array, try increasing polyphony");
+        fluid_convolver_processreplace(fx->convolver, in, out_l, out_r);
     }
 }
 
+/*
+ * Processes a block of the reverb or chorus of an fx unit running at a reduced rate,
+ * see fluid_fx_resampler.h. Silence is detected on the blocks at the reduced rate,
+ * each of them counts for fx_factor blocks at the output rate.
+ */
 static void
-fluid_mixer_buffer_process_finished_voices(fluid_mixer_buffers_t *buffers)
+fluid_rvoice_mixer_fx_decimated(fluid_rvoice_mixer_t *mixer, fluid_mixer_fx_t *fx, int channel,
+                                const fluid_real_t *in, fluid_real_t *out_l, fluid_real_t *out_r)
 {
-    int i, j;
+    int is_reverb = (channel == SYNTH_REVERB_CHANNEL);
+    fluid_fx_resampler_t *rs = is_reverb ? fx->reverb_rs : fx->chorus_rs;
+    int *silent_blocks = is_reverb ? &fx->reverb_silent_blocks : &fx->chorus_silent_blocks;
+    const fluid_real_t *low_in = fluid_fx_resampler_push(rs, in);
+    fluid_real_t *low_l, *low_r;
+    int silent_in;
 
-    for(i = 0; i < buffers->finished_voice_count; i++)
+    fluid_fx_resampler_pull(rs, out_l, out_r, mixer->mix_fx_to_out);
+
+    if(low_in == NULL)
     {
-        fluid_rvoice_t *v = buffers->finished_voices[i];
-        int av = buffers->mixer->active_voices;
+        return; /* the block at the reduced rate isn't complete yet */
+    }
 
-        for(j = 0; j < av; j++)
-        {
-            if(v == buffers->mixer->rvoices[j])
-            {
-                av--;
+    fluid_fx_resampler_get_output(rs, &low_l, &low_r);
+    silent_in = fluid_rvoice_mixer_block_is_silent(low_in);
 
-                /* Pack the array */
-                if(j < av)
-                {
-                    buffers->mixer->rvoices[j] = buffers->mixer->rvoices[av];
-                }
-            }
+    if(silent_in && *silent_blocks >= mixer->fx_tail_blocks)
+    {
+        FLUID_MEMSET(low_l, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
+        FLUID_MEMSET(low_r, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
+    }
+    else
+    {
+        if(is_reverb)
+        {
+            fluid_revmodel_processreplace(fx->reverb, low_in, low_l, low_r);
+        }
+        else
+        {
+            fluid_chorus_processreplace(fx->chorus, low_in, low_l, low_r);
         }
 
-        buffers->mixer->active_voices = av;
+        if(!silent_in || !fluid_rvoice_mixer_block_is_silent(low_l) || !fluid_rvoice_mixer_block_is_silent(low_r))
+        {
+            *silent_blocks = 0;
+        }
+        else if((*silent_blocks += mixer->fx_factor) >= mixer->fx_tail_blocks)
+        {
+            /* the tail has died out, bypass the unit until input arrives */
+            if(is_reverb)
+            {
+                fluid_revmodel_reset(fx->reverb);
+            }
+            else
+            {
+                fluid_chorus_reset(fx->chorus);
+            }
 
-        fluid_rvoice_eventhandler_finished_voice_callback(buffers->mixer->eventhandler, v);
+            fluid_fx_resampler_reset(rs);
+            return;
+        }
     }
 
-    buffers->finished_voice_count = 0;
+    fluid_fx_resampler_commit(rs);
 }
 
-static FLUID_INLINE void fluid_rvoice_mixer_process_finished_voices(fluid_rvoice_mixer_t *mixer)
+/*
+ * TRUE if the reverb of an fx unit has nothing to do: its input buffer isn't live and
+ * the unit is bypassed, so that its output would be silent.
+ */
+static FLUID_INLINE int
+fluid_rvoice_mixer_reverb_idle(const fluid_rvoice_mixer_t *mixer, const fluid_mixer_buffers_t *buffers, int f)
 {
-#if ENABLE_MIXER_THREADS
-    int i;
-
-    for(i = 0; i < mixer->thread_count; i++)
-    {
-        fluid_mixer_buffer_process_finished_voices(&mixer->threads[i]);
-    }
+    const fluid_mixer_fx_t *fx = &mixer->fx[f];
+    int buf_idx = f * (buffers->fx_buf_count / mixer->fx_units) + SYNTH_REVERB_CHANNEL;
+    int tail_blocks = (fx->convolver != NULL) ? fluid_convolver_get_partitions(fx->convolver) : mixer->fx_tail_blocks;
 
-#endif
-    fluid_mixer_buffer_process_finished_voices(&mixer->buffers);
+    return !buffers->live[buffers->buf_count * 2 + buf_idx] && fx->reverb_silent_blocks >= tail_blocks
+           && (fx->convolver != NULL || mixer->fx_factor == 1 || fluid_fx_resampler_is_between_blocks(fx->reverb_rs));
 }
 
-
-static FLUID_INLINE fluid_real_t *
-get_dest_buf(fluid_rvoice_buffers_t *buffers, int index,
-             fluid_real_t **dest_bufs, int dest_bufcount)
+/* Ditto for the chorus */
+static FLUID_INLINE int
+fluid_rvoice_mixer_chorus_idle(const fluid_rvoice_mixer_t *mixer, const fluid_mixer_buffers_t *buffers, int f)
 {
-    int j = buffers->bufs[index].mapping;
+    int buf_idx = f * (buffers->fx_buf_count / mixer->fx_units) + SYNTH_CHORUS_CHANNEL;
 
-    if(j >= dest_bufcount || j < 0)
+    return !buffers->live[buffers->buf_count * 2 + buf_idx] && mixer->fx[f].chorus_silent_blocks >= mixer->fx_tail_blocks
+           && (mixer->fx_factor == 1 || fluid_fx_resampler_is_between_blocks(mixer->fx[f].chorus_rs));
+}
+
+/*
+ * Marks the buffers an fx unit outputs to as live: the dry buffers of its audio group
+ * in mix mode, its own effects channel otherwise.
+ */
+static FLUID_INLINE void
+fluid_rvoice_mixer_mark_fx_out(const fluid_rvoice_mixer_t *mixer, fluid_mixer_buffers_t *buffers, int f, int channel)
+{
+    if(mixer->mix_fx_to_out)
     {
-        return NULL;
+        buffers->live[(f % buffers->buf_count) * 2] = TRUE;
+        buffers->live[(f % buffers->buf_count) * 2 + 1] = TRUE;
+    }
+    else
+    {
+        buffers->live[buffers->buf_count * 2 + f * (buffers->fx_buf_count / mixer->fx_units) + channel] = TRUE;
     }
-
-    return dest_bufs[j];
 }
 
-/**
- * Mix samples down from internal dsp_buf to output buffers
- *
- * @param buffers Destination buffer(s)
- * @param dsp_buf Mono sample source
- * @param start_block starting sample in dsp_buf
- * @param sample_count number of samples to mix following \c start_block
- * @param dest_bufs Array of buffers to mixdown to
- * @param dest_bufcount Length of dest_bufs (i.e count of buffers)
+/*
+ * Processes the reverb unit of fx unit f, unless it is disabled or idle.
  */
 static void
-fluid_rvoice_buffers_mix(fluid_rvoice_buffers_t *buffers,
-                         const fluid_real_t *FLUID_RESTRICT dsp_buf,
-                         int start_block, int sample_count,
-                         fluid_real_t **dest_bufs, int dest_bufcount)
+fluid_rvoice_mixer_process_reverb(fluid_rvoice_mixer_t *mixer, fluid_mixer_buffers_t *buffers, int f, int current_blockcount)
 {
-    /* buffers count to mixdown to */
-    int bufcount = buffers->count;
-    int i, dsp_i;
+    const int mix_fx_to_out = mixer->mix_fx_to_out;
+    const int sample_count = current_blockcount * FLUID_BUFSIZE;
+    int buf_idx = f * (buffers->fx_buf_count / mixer->fx_units) + SYNTH_REVERB_CHANNEL;
+    int samp_idx = buf_idx * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE; /* sample index in buffer */
+    int dry_idx = 0; /* dry buffer index */
+    int i;
+    void (*reverb_process_func)(fluid_revmodel_t *rev, const fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out);
+    // all dry unprocessed mono input is stored in the left channel
+    fluid_real_t *in_rev = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_real_t *out_rev_l, *out_rev_r;
+    fluid_real_t *in, *out_l, *out_r;
+    fluid_real_t tail_l[FLUID_BUFSIZE], tail_r[FLUID_BUFSIZE]; /* output of a unit with silent input */
 
-    /* if there is nothing to mix, return immediately */
-    if(sample_count <= 0 || dest_bufcount <= 0)
+    if(!mixer->fx[f].reverb_on)
     {
-        return;
+        return; /* this reverb unit is disabled */
     }
 
-    FLUID_ASSERT((uintptr_t)dsp_buf % FLUID_DEFAULT_ALIGNMENT == 0);
-    FLUID_ASSERT((uintptr_t)(&dsp_buf[start_block * FLUID_BUFSIZE]) % FLUID_DEFAULT_ALIGNMENT == 0);
+    if(mix_fx_to_out && mixer->fx[f].reverb_leader != f)
+    {
+        return; /* the sends have been added to those of the unit shared */
+    }
 
-    /* mixdown for each buffer */
-    for(i = 0; i < bufcount; i++)
+    if(fluid_rvoice_mixer_reverb_idle(mixer, buffers, f))
     {
-        fluid_real_t *FLUID_RESTRICT buf = get_dest_buf(buffers, i, dest_bufs, dest_bufcount);
-        fluid_real_t target_amp = buffers->bufs[i].target_amp;
-        fluid_real_t current_amp = buffers->bufs[i].current_amp;
-        fluid_real_t amp_incr;
+        return; /* silent input and no tail, the output is silent as well */
+    }
 
-        if(buf == NULL || (current_amp == 0.0f && target_amp == 0.0f))
-        {
-            continue;
-        }
+    if(mix_fx_to_out)
+    {
+        // mix effects to first stereo channel
+        out_rev_l = fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
+        out_rev_r = fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT);
+        reverb_process_func = fluid_revmodel_processmix;
 
-        amp_incr = (target_amp - current_amp) / FLUID_BUFSIZE;
+        /* in mix mode, map fx out_rev at index f to a dry buffer at index dry_idx,
+         * dry buffer mapping, should be done more flexible in the future */
+        dry_idx = (f % buffers->buf_count) * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE;
+    }
+    else
+    {
+        // replace effects into respective stereo effects channel
+        out_rev_l = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+        out_rev_r = fluid_align_ptr(buffers->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+        reverb_process_func = fluid_revmodel_processreplace;
+    }
 
-        FLUID_ASSERT((uintptr_t)buf % FLUID_DEFAULT_ALIGNMENT == 0);
+    for(i = 0; i < sample_count; i += FLUID_BUFSIZE, samp_idx += FLUID_BUFSIZE)
+    {
+        in = &in_rev[samp_idx];
+        out_l = mix_fx_to_out ? &out_rev_l[dry_idx + i] : &out_rev_l[samp_idx];
+        out_r = mix_fx_to_out ? &out_rev_r[dry_idx + i] : &out_rev_r[samp_idx];
 
-        /* Mixdown sample_count samples in the current buffer buf
-         *
-         * For the first FLUID_BUFSIZE samples, we linearly interpolate the buffers amplitude to
-         * avoid clicks/pops when rapidly changing the channels panning (issue 768).
-         * 
-         * We could have squashed this into one single loop by using an if clause within the loop body.
-         * But it seems like having two separate loops is easier for compilers to understand, and therefore
-         * auto-vectorizing the loops.
-         */
-        if(sample_count < FLUID_BUFSIZE)
+        if(mixer->fx[f].convolver != NULL)
         {
-            // scalar loop variant, the voice will have finished afterwards
-            for(dsp_i = 0; dsp_i < sample_count; dsp_i++)
-            {
-                buf[start_block * FLUID_BUFSIZE + dsp_i] += current_amp * dsp_buf[start_block * FLUID_BUFSIZE + dsp_i];
-                current_amp += amp_incr;
-            }
+            fluid_rvoice_mixer_convolve(mixer, &mixer->fx[f], in, out_l, out_r);
         }
-        else
+        else if(mixer->fx_factor > 1)
         {
-            // here goes the vectorizable loop
-            #pragma omp simd aligned(dsp_buf,buf:FLUID_DEFAULT_ALIGNMENT)
-            for(dsp_i = 0; dsp_i < FLUID_BUFSIZE; dsp_i++)
-            {
-                // We cannot simply increment current_amp by amp_incr during every iteration, as this would create a dependency and prevent vectorization.
-                buf[start_block * FLUID_BUFSIZE + dsp_i] += (current_amp + amp_incr * dsp_i) * dsp_buf[start_block * FLUID_BUFSIZE + dsp_i];
-            }
-            
-            // we have reached the target_amp
-            if(target_amp > 0)
-            {
-                /* Note, that this loop could be unrolled by FLUID_BUFSIZE elements */
-                #pragma omp simd aligned(dsp_buf,buf:FLUID_DEFAULT_ALIGNMENT)
-                for(dsp_i = FLUID_BUFSIZE; dsp_i < sample_count; dsp_i++)
-                {
-                    // Index by blocks (not by samples) to let the compiler know that we always start accessing
-                    // buf and dsp_buf at the FLUID_BUFSIZE*sizeof(fluid_real_t) byte boundary and never somewhere
-                    // in between.
-                    // A good compiler should understand: Aha, so I don't need to add a peel loop when vectorizing
-                    // this loop. Great.
-                    buf[start_block * FLUID_BUFSIZE + dsp_i] += target_amp * dsp_buf[start_block * FLUID_BUFSIZE + dsp_i];
-                }
-            }
+            fluid_rvoice_mixer_fx_decimated(mixer, &mixer->fx[f], SYNTH_REVERB_CHANNEL, in, out_l, out_r);
         }
-        
-        buffers->bufs[i].current_amp = target_amp;
-    }
-}
-
-/**
- * Synthesize one voice and add to buffer.
- * NOTE: If return value is less than blockcount*FLUID_BUFSIZE, that means
- * voice has been finished, removed and possibly replaced with another voice.
- */
-static FLUID_INLINE void
-fluid_mixer_buffers_render_one(fluid_mixer_buffers_t *buffers,
-                               fluid_rvoice_t *rvoice, fluid_real_t **dest_bufs,
-                               unsigned int dest_bufcount, fluid_real_t *src_buf, int blockcount)
-{
-    int i, total_samples = 0, last_block_mixed = 0;
-
-    for(i = 0; i < blockcount; i++)
-    {
-        /* render one block in src_buf */
-        int s = fluid_rvoice_write(rvoice, &src_buf[FLUID_BUFSIZE * i]);
-
-        if(s == -1)
+        else if(!fluid_rvoice_mixer_block_is_silent(in))
         {
-            /* the voice is silent, mix back all the previously rendered sound */
-            fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, last_block_mixed,
-                                     total_samples - (last_block_mixed * FLUID_BUFSIZE),
-                                     dest_bufs, dest_bufcount);
-
-            last_block_mixed = i + 1; /* future block start index to mix from */
-            total_samples += FLUID_BUFSIZE; /* accumulate samples count rendered */
+            mixer->fx[f].reverb_silent_blocks = 0;
+            reverb_process_func(mixer->fx[f].reverb, in, out_l, out_r);
         }
-        else
+        else if(mixer->fx[f].reverb_silent_blocks < mixer->fx_tail_blocks)
         {
-            /* the voice wasn't quiet. Some samples have been rendered [0..FLUID_BUFSIZE] */
-            total_samples += s;
+            /* silent input, watch the tail */
+            fluid_revmodel_processreplace(mixer->fx[f].reverb, in, tail_l, tail_r);
 
-            if(s < FLUID_BUFSIZE)
+            if(fluid_rvoice_mixer_fx_tail(mixer, &mixer->fx[f].reverb_silent_blocks,
+                                          tail_l, tail_r, out_l, out_r))
             {
-                /* voice has finished */
-                break;
+                /* the tail has died out, bypass the unit until input arrives */
+                fluid_revmodel_reset(mixer->fx[f].reverb);
             }
         }
-    }
-
-    /* Now mix the remaining blocks from last_block_mixed to total_sample */
-    fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, last_block_mixed,
-                             total_samples - (last_block_mixed * FLUID_BUFSIZE),
-                             dest_bufs, dest_bufcount);
-
-    if(total_samples < blockcount * FLUID_BUFSIZE)
-    {
-        /* voice has finished */
-        fluid_finish_rvoice(buffers, rvoice);
-    }
-}
-
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_add_voice)
-{
-    int i;
-    fluid_rvoice_mixer_t *mixer = obj;
-    fluid_rvoice_t *voice = param[0].ptr;
-
-    if(mixer->active_voices < mixer->polyphony)
-    {
-        mixer->rvoices[mixer->active_voices++] = voice;
-        return; // success
-    }
-
-    /* See if any voices just finished, if so, take its place.
-       This can happen in voice overflow conditions. */
-    for(i = 0; i < mixer->active_voices; i++)
-    {
-        if(mixer->rvoices[i] == voice)
-        {
-            FLUID_LOG(FLUID_ERR, "Internal error: Trying to replace an existing rvoice in fluid_rvoice_mixer_add_voice?!");
-            return;
-        }
-
-        if(mixer->rvoices[i]->envlfo.volenv.section == FLUID_VOICE_ENVFINISHED)
+        else if(!mix_fx_to_out)
         {
-            fluid_finish_rvoice(&mixer->buffers, mixer->rvoices[i]);
-            mixer->rvoices[i] = voice;
-            return; // success
+            FLUID_MEMSET(out_l, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
+            FLUID_MEMSET(out_r, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
         }
     }
-
-    /* This should never happen */
-    FLUID_LOG(FLUID_ERR, "Trying to exceed polyphony in fluid_rvoice_mixer_add_voice");
 }
 
-static int
-fluid_mixer_buffers_update_polyphony(fluid_mixer_buffers_t *buffers, int value)
+/*
+ * Processes the chorus unit of fx unit f, unless it is disabled or idle.
+ */
+static void
+fluid_rvoice_mixer_process_chorus(fluid_rvoice_mixer_t *mixer, fluid_mixer_buffers_t *buffers, int f, int current_blockcount)
 {
-    void *newptr;
+    const int mix_fx_to_out = mixer->mix_fx_to_out;
+    const int sample_count = current_blockcount * FLUID_BUFSIZE;
+    int buf_idx = f * (buffers->fx_buf_count / mixer->fx_units) + SYNTH_CHORUS_CHANNEL;
+    int samp_idx = buf_idx * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE; /* sample index in buffer */
+    int dry_idx = 0; /* dry buffer index */
+    int i;
+    void (*chorus_process_func)(fluid_chorus_t *chorus, const fluid_real_t *in, fluid_real_t *left_out, fluid_real_t *right_out);
+    // all dry unprocessed mono input is stored in the left channel
+    fluid_real_t *in_ch = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_real_t *out_ch_l, *out_ch_r;
+    fluid_real_t *in, *out_l, *out_r;
+    fluid_real_t tail_l[FLUID_BUFSIZE], tail_r[FLUID_BUFSIZE]; /* output of a unit with silent input */
 
-    if(buffers->finished_voice_count > value)
+    if(!mixer->fx[f].chorus_on)
     {
-        return FLUID_FAILED;
+        return; /* this chorus unit is disabled */
     }
 
-    newptr = FLUID_REALLOC(buffers->finished_voices, value * sizeof(fluid_rvoice_t *));
-
-    if(newptr == NULL && value > 0)
+    if(mix_fx_to_out && mixer->fx[f].chorus_leader != f)
     {
-        return FLUID_FAILED;
+        return; /* the sends have been added to those of the unit shared */
     }
 
-    buffers->finished_voices = newptr;
-    return FLUID_OK;
-}
-
-/**
- * Update polyphony - max number of voices (NOTE: not hard realtime capable)
- * @return FLUID_OK or FLUID_FAILED
- */
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_polyphony)
-{
-    void *newptr;
-    fluid_rvoice_mixer_t *handler = obj;
-    int value = param[0].i;
-
-    if(handler->active_voices > value)
+    if(fluid_rvoice_mixer_chorus_idle(mixer, buffers, f))
     {
-        return /*FLUID_FAILED*/;
+        return; /* silent input and no tail, the output is silent as well */
     }
 
-    newptr = FLUID_REALLOC(handler->rvoices, value * sizeof(fluid_rvoice_t *));
-
-    if(newptr == NULL)
+    if(mix_fx_to_out)
     {
-        return /*FLUID_FAILED*/;
-    }
-
-    handler->rvoices = newptr;
+        // mix effects to first stereo channel
+        out_ch_l = fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
+        out_ch_r = fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT);
+        chorus_process_func = fluid_chorus_processmix;
 
-    if(fluid_mixer_buffers_update_polyphony(&handler->buffers, value)
-            == FLUID_FAILED)
+        /* in mix mode, map fx out_ch at index f to a dry buffer at index dry_idx,
+         * dry buffer mapping, should be done more flexible in the future */
+        dry_idx = (f % buffers->buf_count) * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE;
+    }
+    else
     {
-        return /*FLUID_FAILED*/;
+        // replace effects into respective stereo effects channel
+        out_ch_l = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+        out_ch_r = fluid_align_ptr(buffers->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+        chorus_process_func = fluid_chorus_processreplace;
     }
 
-#if ENABLE_MIXER_THREADS
+    for(i = 0; i < sample_count; i += FLUID_BUFSIZE, samp_idx += FLUID_BUFSIZE)
     {
-        int i;
+        in = &in_ch[samp_idx];
+        out_l = mix_fx_to_out ? &out_ch_l[dry_idx + i] : &out_ch_l[samp_idx];
+        out_r = mix_fx_to_out ? &out_ch_r[dry_idx + i] : &out_ch_r[samp_idx];
 
-        for(i = 0; i < handler->thread_count; i++)
+        if(mixer->fx_factor > 1)
+        {
+            fluid_rvoice_mixer_fx_decimated(mixer, &mixer->fx[f], SYNTH_CHORUS_CHANNEL, in, out_l, out_r);
+        }
+        else if(!fluid_rvoice_mixer_block_is_silent(in))
+        {
+            mixer->fx[f].chorus_silent_blocks = 0;
+            chorus_process_func(mixer->fx[f].chorus, in, out_l, out_r);
+        }
+        else if(mixer->fx[f].chorus_silent_blocks < mixer->fx_tail_blocks)
         {
-            if(fluid_mixer_buffers_update_polyphony(&handler->threads[i], value)
-                    == FLUID_FAILED)
+            /* silent input, watch the tail */
+            fluid_chorus_processreplace(mixer->fx[f].chorus, in, tail_l, tail_r);
+
+            if(fluid_rvoice_mixer_fx_tail(mixer, &mixer->fx[f].chorus_silent_blocks,
+                                          tail_l, tail_r, out_l, out_r))
             {
-                return /*FLUID_FAILED*/;
+                /* the tail has died out, bypass the unit until input arrives */
+                fluid_chorus_reset(mixer->fx[f].chorus);
             }
         }
+        else if(!mix_fx_to_out)
+        {
+            FLUID_MEMSET(out_l, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
+            FLUID_MEMSET(out_r, 0, FLUID_BUFSIZE * sizeof(fluid_real_t));
+        }
     }
-#endif
-
-    handler->polyphony = value;
-    /*return FLUID_OK*/;
 }
 
-
+/*
+ * Adds the sends of the units sharing the reverb or chorus of another unit to the sends
+ * of that unit, see synth.fx-share. Only done in mix mode, where the units sharing a
+ * reverb or chorus output to the same dry buffers.
+ */
 static void
-fluid_render_loop_singlethread(fluid_rvoice_mixer_t *mixer, int blockcount)
+fluid_rvoice_mixer_share_fx_sends(fluid_rvoice_mixer_t *mixer, fluid_mixer_buffers_t *buffers, int current_blockcount)
 {
-    int i;
-    FLUID_DECLARE_VLA(fluid_real_t *, bufs,
-                      mixer->buffers.buf_count * 2 + mixer->buffers.fx_buf_count * 2);
-    int bufcount = fluid_mixer_buffers_prepare(&mixer->buffers, bufs);
+    const int fx_channels_per_unit = buffers->fx_buf_count / mixer->fx_units;
+    const int sample_count = current_blockcount * FLUID_BUFSIZE;
+    fluid_real_t *sends = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    unsigned char *live = &buffers->live[buffers->buf_count * 2];
+    int f, channel, leader, from, to, i;
+    const fluid_real_t *in;
+    fluid_real_t *out;
+
+    for(f = 0; f < mixer->fx_units; f++)
+    {
+        for(channel = SYNTH_REVERB_CHANNEL; channel <= SYNTH_CHORUS_CHANNEL; channel++)
+        {
+            if(channel == SYNTH_REVERB_CHANNEL)
+            {
+                leader = mixer->with_reverb ? mixer->fx[f].reverb_leader : f;
+            }
+            else
+            {
+                leader = mixer->with_chorus ? mixer->fx[f].chorus_leader : f;
+            }
 
-    fluid_real_t *local_buf = fluid_align_ptr(mixer->buffers.local_buf, FLUID_DEFAULT_ALIGNMENT);
+            from = f * fx_channels_per_unit + channel;
+            to = leader * fx_channels_per_unit + channel;
 
-    fluid_profile_ref_var(prof_ref);
+            if(leader == f || !live[from])
+            {
+                continue;
+            }
 
-    for(i = 0; i < mixer->active_voices; i++)
-    {
-        fluid_mixer_buffers_render_one(&mixer->buffers, mixer->rvoices[i], bufs,
-                                       bufcount, local_buf, blockcount);
-        fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, 1,
-                      blockcount * FLUID_BUFSIZE);
+            /* buffers that aren't live are silent, so they can be added to as well */
+            in = &sends[from * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
+            out = &sends[to * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE];
+
+            for(i = 0; i < sample_count; i++)
+            {
+                out[i] += in[i];
+            }
+
+            live[to] = TRUE;
+        }
     }
 }
 
+/*
+ * Marks the outputs of the reverb and chorus of fx unit f that are going to be processed.
+ * Units working on silence are skipped, so this must be done before processing any of
+ * them, as units can share their output buffers in mix mode.
+ */
 static FLUID_INLINE void
-fluid_mixer_buffers_zero(fluid_mixer_buffers_t *buffers, int current_blockcount)
+fluid_rvoice_mixer_mark_unit_fx_out(fluid_rvoice_mixer_t *mixer, fluid_mixer_buffers_t *buffers, int f)
 {
-    int i, size = current_blockcount * FLUID_BUFSIZE * sizeof(fluid_real_t);
-
-    /* TODO: Optimize by only zero out the buffers we actually use later on. */
-    int buf_count = buffers->buf_count, fx_buf_count = buffers->fx_buf_count;
-
-    fluid_real_t *FLUID_RESTRICT buf_l = fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
-    fluid_real_t *FLUID_RESTRICT buf_r = fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT);
+    /* units sharing the unit of another one don't output anything of their own in mix mode */
+    int reverb_shared = mixer->mix_fx_to_out && mixer->fx[f].reverb_leader != f;
+    int chorus_shared = mixer->mix_fx_to_out && mixer->fx[f].chorus_leader != f;
 
-    for(i = 0; i < buf_count; i++)
+    if(mixer->with_reverb && mixer->fx[f].reverb_on && !reverb_shared && !fluid_rvoice_mixer_reverb_idle(mixer, buffers, f))
     {
-        FLUID_MEMSET(&buf_l[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
-        FLUID_MEMSET(&buf_r[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
+        fluid_rvoice_mixer_mark_fx_out(mixer, buffers, f, SYNTH_REVERB_CHANNEL);
     }
 
-    buf_l = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-    buf_r = fluid_align_ptr(buffers->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
-
-    for(i = 0; i < fx_buf_count; i++)
+    if(mixer->with_chorus && mixer->fx[f].chorus_on && !chorus_shared && !fluid_rvoice_mixer_chorus_idle(mixer, buffers, f))
     {
-        FLUID_MEMSET(&buf_l[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
-        FLUID_MEMSET(&buf_r[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
+        fluid_rvoice_mixer_mark_fx_out(mixer, buffers, f, SYNTH_CHORUS_CHANNEL);
     }
 }
 
-static int
-fluid_mixer_buffers_init(fluid_mixer_buffers_t *buffers, fluid_rvoice_mixer_t *mixer)
+static FLUID_INLINE void
+fluid_rvoice_mixer_process_fx(fluid_rvoice_mixer_t *mixer, fluid_mixer_buffers_t *buffers, int current_blockcount)
 {
-    static const int samplecount = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
-
-    buffers->mixer = mixer;
-    buffers->buf_count = mixer->buffers.buf_count;
-    buffers->fx_buf_count = mixer->buffers.fx_buf_count;
-
-    /* Local mono voice buf */
-    buffers->local_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, samplecount, FLUID_DEFAULT_ALIGNMENT);
+    double trace_ref = fluid_trace_ref();
 
-    /* Left and right audio buffers */
+    fluid_profile_ref_var(prof_ref);
 
-    buffers->left_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
-    buffers->right_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+#ifdef LADSPA
 
-    if((buffers->local_buf == NULL) || (buffers->left_buf == NULL) || (buffers->right_buf == NULL))
+    /* Run the signal through the LADSPA Fx unit. The buffers have already been
+     * set up in fluid_rvoice_mixer_set_ladspa. */
+    if(mixer->ladspa_fx)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return 0;
-    }
+        fluid_ladspa_run(mixer->ladspa_fx, current_blockcount, FLUID_BUFSIZE);
+        fluid_check_fpe("LADSPA");
 
-    /* Effects audio buffers */
+        /* the effects may have written to any of the buffers */
+        FLUID_MEMSET(buffers->live, TRUE, buffers->buf_count * 2 + buffers->fx_buf_count);
+    }
 
-    buffers->fx_left_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->fx_buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
-    buffers->fx_right_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->fx_buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+#endif
 
-    if((buffers->fx_left_buf == NULL) || (buffers->fx_right_buf == NULL))
+    if(mixer->with_reverb || mixer->with_chorus)
+    {
+        int f;
+#if ENABLE_MIXER_THREADS && !defined(WITH_PROFILING)
+        int fx_mixer_threads = mixer->fx_units;
+        fluid_clip(fx_mixer_threads, 1, mixer->thread_count + 1);
+#endif
+
+        if(mixer->fx_share && mixer->mix_fx_to_out)
+        {
+            fluid_rvoice_mixer_share_fx_sends(mixer, buffers, current_blockcount);
+        }
+
+        for(f = 0; f < mixer->fx_units; f++)
+        {
+            fluid_rvoice_mixer_mark_unit_fx_out(mixer, buffers, f);
+        }
+
+#if ENABLE_MIXER_THREADS && !defined(WITH_PROFILING)
+        #pragma omp parallel default(none) shared(mixer, buffers, current_blockcount) private(f) num_threads(fx_mixer_threads)
+#endif
+        {
+            double perf_ref = fluid_perf_ref(mixer->perf); /* only used by the master thread of the team */
+
+            if(mixer->with_reverb)
+            {
+#if ENABLE_MIXER_THREADS && !defined(WITH_PROFILING)
+                #pragma omp for schedule(static)
+#endif
+                for(f = 0; f < mixer->fx_units; f++)
+                {
+                    fluid_rvoice_mixer_process_reverb(mixer, buffers, f, current_blockcount);
+                } // implicit omp barrier - required, because the reverb and chorus outputs alias in mix mode
+
+                fluid_profile(FLUID_PROF_ONE_BLOCK_REVERB, prof_ref, 0,
+                            current_blockcount * FLUID_BUFSIZE);
+
+#if ENABLE_MIXER_THREADS && !defined(WITH_PROFILING)
+                #pragma omp master
+#endif
+                {
+                    fluid_perf_stage(mixer->perf, FLUID_PERF_STAGE_REVERB, perf_ref);
+                    perf_ref = fluid_perf_ref(mixer->perf);
+                }
+            }
+
+            if(mixer->with_chorus)
+            {
+#if ENABLE_MIXER_THREADS && !defined(WITH_PROFILING)
+                #pragma omp for schedule(static)
+#endif
+                for(f = 0; f < mixer->fx_units; f++)
+                {
+                    fluid_rvoice_mixer_process_chorus(mixer, buffers, f, current_blockcount);
+                }
+
+                fluid_profile(FLUID_PROF_ONE_BLOCK_CHORUS, prof_ref, 0,
+                            current_blockcount * FLUID_BUFSIZE);
+
+#if ENABLE_MIXER_THREADS && !defined(WITH_PROFILING)
+                #pragma omp master
+#endif
+                fluid_perf_stage(mixer->perf, FLUID_PERF_STAGE_CHORUS, perf_ref);
+            }
+        }
+    }
+
+    if(mixer->limiter)
+    {
+        fluid_real_t* buf_l = fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
+        fluid_real_t* buf_r = fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT);
+        fluid_limiter_run(mixer->limiter, buf_l, buf_r, FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE,
+                          current_blockcount);
+        fluid_check_fpe("LIMITER");
+    }
+
+    fluid_trace_span("fx", trace_ref);
+}
+
+/**
+ * Glue to get fluid_rvoice_buffers_mix what it wants
+ * Note: Make sure outbufs has 2 * (buf_count + fx_buf_count) elements before calling
+ */
+static FLUID_INLINE int
+fluid_mixer_buffers_prepare(fluid_mixer_buffers_t *buffers, fluid_real_t **outbufs)
+{
+    fluid_real_t *base_ptr;
+    int i;
+    const int fx_channels_per_unit = buffers->fx_buf_count / buffers->mixer->fx_units;
+    const int offset = buffers->buf_count * 2;
+    int with_reverb = buffers->mixer->with_reverb;
+    int with_chorus = buffers->mixer->with_chorus;
+
+    /* Set up the reverb and chorus buffers only when the effect is enabled or
+     * when LADSPA is active. Nonexisting buffers are detected in the DSP loop.
+     * Not sending the effect signals saves some time in that case. */
+#ifdef LADSPA
+    int with_ladspa = (buffers->mixer->ladspa_fx != NULL);
+    with_reverb = (with_reverb | with_ladspa);
+    with_chorus = (with_chorus | with_ladspa);
+#endif
+
+    // all the dry, non-processed mono audio for effects is to be stored in the left buffers
+    base_ptr = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    for(i = 0; i < buffers->mixer->fx_units; i++)
+    {
+        int fx_idx = i * fx_channels_per_unit;
+
+        outbufs[offset + fx_idx + SYNTH_REVERB_CHANNEL] =
+            (with_reverb)
+            ? &base_ptr[(fx_idx + SYNTH_REVERB_CHANNEL) * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT]
+            : NULL;
+
+        outbufs[offset + fx_idx + SYNTH_CHORUS_CHANNEL] =
+            (with_chorus)
+            ? &base_ptr[(fx_idx + SYNTH_CHORUS_CHANNEL) * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT]
+            : NULL;
+    }
+
+    /* The output associated with a MIDI channel is wrapped around
+     * using the number of audio groups as modulo divider.  This is
+     * typically the number of output channels on the 'sound card',
+     * as long as the LADSPA Fx unit is not used. In case of LADSPA
+     * unit, think of it as subgroups on a mixer.
+     *
+     * For example: Assume that the number of groups is set to 2.
+     * Then MIDI channel 1, 3, 5, 7 etc. go to output 1, channels 2,
+     * 4, 6, 8 etc to output 2.  Or assume 3 groups: Then MIDI
+     * channels 1, 4, 7, 10 etc go to output 1; 2, 5, 8, 11 etc to
+     * output 2, 3, 6, 9, 12 etc to output 3.
+     */
+    base_ptr = fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    for(i = 0; i < buffers->buf_count; i++)
+    {
+        outbufs[i * 2] = &base_ptr[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
+    }
+
+    base_ptr = fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    for(i = 0; i < buffers->buf_count; i++)
+    {
+        outbufs[i * 2 + 1] = &base_ptr[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
+    }
+
+    return offset + buffers->fx_buf_count;
+}
+
+
+static FLUID_INLINE void
+fluid_finish_rvoice(fluid_mixer_buffers_t *buffers, fluid_rvoice_t *rvoice)
+{
+    fluid_rvoice_cache_stop(rvoice);
+
+    /* the partner of a stereo voice only plays along with it */
+    if(rvoice->stereo != NULL)
+    {
+        fluid_rvoice_t *partner = rvoice->stereo;
+
+        rvoice->stereo = NULL;
+        fluid_finish_rvoice(buffers, partner);
+    }
+
+    if(buffers->finished_voice_count < buffers->finished_voices_size)
+    {
+        buffers->finished_voices[buffers->finished_voice_count++] = rvoice;
+    }
+    else
+    {
+        FLUID_LOG(FLUID_ERR, "Exceeded finished voices array, try increasing polyphony");
+    }
+}
+
+/* Hand a finished voice back to the synth */
+static void
+fluid_mixer_release_rvoice(fluid_rvoice_mixer_t *mixer, fluid_rvoice_t *rvoice)
+{
+    if(rvoice->stream_slot != NULL)
+    {
+        fluid_rvoice_stream_slot_stop(rvoice->stream_slot);
+    }
+
+    fluid_rvoice_eventhandler_finished_voice_callback(mixer->eventhandler, rvoice);
+}
+
+static void
+fluid_mixer_buffer_process_finished_voices(fluid_mixer_buffers_t *buffers)
+{
+    int i, j;
+
+    for(i = 0; i < buffers->finished_voice_count; i++)
+    {
+        fluid_rvoice_t *v = buffers->finished_voices[i];
+        int av = buffers->mixer->active_voices;
+
+        for(j = 0; j < av; j++)
+        {
+            if(v == buffers->mixer->rvoices[j])
+            {
+                av--;
+
+                /* Pack the array */
+                if(j < av)
+                {
+                    buffers->mixer->rvoices[j] = buffers->mixer->rvoices[av];
+                }
+            }
+        }
+
+        buffers->mixer->active_voices = av;
+        fluid_mixer_release_rvoice(buffers->mixer, v);
+    }
+
+    buffers->finished_voice_count = 0;
+}
+
+/* Returns the buffers of finished voice list \c idx, or NULL if there are no more lists */
+static fluid_mixer_buffers_t *
+fluid_mixer_get_finished_list(fluid_rvoice_mixer_t *mixer, int idx)
+{
+    if(idx == 0)
+    {
+        return &mixer->buffers;
+    }
+
+    if(idx == 1)
+    {
+        return mixer->slice_buffers;
+    }
+
+#if ENABLE_MIXER_THREADS
+
+    if(idx - 2 < mixer->thread_count)
+    {
+        return &mixer->threads[idx - 2];
+    }
+
+#endif
+    return NULL;
+}
+
+static int
+fluid_mixer_is_finished(fluid_rvoice_mixer_t *mixer, const fluid_rvoice_t *rvoice)
+{
+    fluid_mixer_buffers_t *buffers;
+    int i, j;
+
+    for(i = 0; (buffers = fluid_mixer_get_finished_list(mixer, i)) != NULL; i++)
+    {
+        for(j = 0; j < buffers->finished_voice_count; j++)
+        {
+            if(buffers->finished_voices[j] == rvoice)
+            {
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Remove the finished voices, keeping the order of the remaining ones. Unlike
+ * fluid_mixer_buffer_process_finished_voices(), the resulting order doesn't depend on
+ * which thread rendered which voice, see synth.deterministic-render.
+ */
+static void
+fluid_rvoice_mixer_process_finished_voices_ordered(fluid_rvoice_mixer_t *mixer)
+{
+    fluid_mixer_buffers_t *buffers;
+    int i, j, n;
+
+    /* voices replaced by fluid_rvoice_mixer_add_voice() are not in the array anymore */
+    for(i = 0; (buffers = fluid_mixer_get_finished_list(mixer, i)) != NULL; i++)
+    {
+        for(j = 0; j < buffers->finished_voice_count; j++)
+        {
+            fluid_rvoice_t *v = buffers->finished_voices[j];
+
+            for(n = 0; n < mixer->active_voices && mixer->rvoices[n] != v; n++)
+            {
+            }
+
+            if(n == mixer->active_voices)
+            {
+                fluid_mixer_release_rvoice(mixer, v);
+            }
+        }
+    }
+
+    for(i = 0, n = 0; i < mixer->active_voices; i++)
+    {
+        fluid_rvoice_t *v = mixer->rvoices[i];
+
+        if(fluid_mixer_is_finished(mixer, v))
+        {
+            fluid_mixer_release_rvoice(mixer, v);
+        }
+        else
+        {
+            mixer->rvoices[n++] = v;
+        }
+    }
+
+    mixer->active_voices = n;
+
+    for(i = 0; (buffers = fluid_mixer_get_finished_list(mixer, i)) != NULL; i++)
+    {
+        buffers->finished_voice_count = 0;
+    }
+}
+
+static FLUID_INLINE void fluid_rvoice_mixer_process_finished_voices(fluid_rvoice_mixer_t *mixer)
+{
+#if ENABLE_MIXER_THREADS
+    int i;
+#endif
+
+    if(mixer->slice_buffers != NULL)
+    {
+        fluid_rvoice_mixer_process_finished_voices_ordered(mixer);
+        return;
+    }
+
+#if ENABLE_MIXER_THREADS
+
+    for(i = 0; i < mixer->thread_count; i++)
+    {
+        fluid_mixer_buffer_process_finished_voices(&mixer->threads[i]);
+    }
+
+#endif
+    fluid_mixer_buffer_process_finished_voices(&mixer->buffers);
+}
+
+
+static FLUID_INLINE fluid_real_t *
+get_dest_buf(fluid_rvoice_buffers_t *buffers, int index,
+             fluid_real_t **dest_bufs, int dest_bufcount)
+{
+    int j = buffers->bufs[index].mapping;
+
+    if(j >= dest_bufcount || j < 0)
+    {
+        return NULL;
+    }
+
+    return dest_bufs[j];
+}
+
+/*
+ * Adds the levels a voice contributes to the dry left and right buffers to the meter of its
+ * channel. Measuring the voice once and scaling by the gains of the two sides costs a single
+ * pass over its samples, which are still in the cache for the mixdown.
+ */
+static void
+fluid_rvoice_buffers_meter(const fluid_rvoice_buffers_t *buffers, const fluid_real_t *dsp_buf,
+                           int sample_count, fluid_meter_acc_t *meter)
+{
+    fluid_real_t peak, amp;
+    double sumsq;
+    unsigned int i;
+
+    fluid_meter_measure(dsp_buf, sample_count, &peak, &sumsq);
+
+    for(i = 0; i < 2 && i < buffers->count; i++)
+    {
+        /* the larger one of the ramp ends, the ramp only lasts the first block anyway */
+        amp = FLUID_FABS(buffers->bufs[i].current_amp);
+
+        if(FLUID_FABS(buffers->bufs[i].target_amp) > amp)
+        {
+            amp = FLUID_FABS(buffers->bufs[i].target_amp);
+        }
+
+        if(peak * amp > meter->peak[i])
+        {
+            meter->peak[i] = peak * amp;
+        }
+
+        meter->sumsq[i] += sumsq * amp * amp;
+    }
+}
+
+/**
+ * Mix samples down from internal dsp_buf to output buffers
+ *
+ * @param buffers Destination buffer(s)
+ * @param dsp_buf Mono sample source
+ * @param start_block starting sample in dsp_buf
+ * @param sample_count number of samples to mix following \c start_block
+ * @param dest_bufs Array of buffers to mixdown to
+ * @param dest_bufcount Length of dest_bufs (i.e count of buffers)
+ * @param dest_live Live flags of dest_bufs, set for each buffer mixed to
+ */
+void
+fluid_rvoice_buffers_mix(fluid_rvoice_buffers_t *buffers,
+                         const fluid_real_t *FLUID_RESTRICT dsp_buf,
+                         int start_block, int sample_count,
+                         fluid_real_t **dest_bufs, int dest_bufcount,
+                         unsigned char *dest_live, fluid_meter_acc_t *meter)
+{
+    /* buffers count to mixdown to */
+    int bufcount = buffers->count;
+    int i, dsp_i;
+
+    /* if there is nothing to mix, return immediately */
+    if(sample_count <= 0 || dest_bufcount <= 0)
+    {
+        return;
+    }
+
+    if(meter != NULL)
+    {
+        fluid_rvoice_buffers_meter(buffers, &dsp_buf[start_block * FLUID_BUFSIZE], sample_count, meter);
+    }
+
+    FLUID_ASSERT((uintptr_t)dsp_buf % FLUID_DEFAULT_ALIGNMENT == 0);
+    FLUID_ASSERT((uintptr_t)(&dsp_buf[start_block * FLUID_BUFSIZE]) % FLUID_DEFAULT_ALIGNMENT == 0);
+
+    /* mixdown for each buffer */
+    for(i = 0; i < bufcount; i++)
+    {
+        fluid_real_t *FLUID_RESTRICT buf = get_dest_buf(buffers, i, dest_bufs, dest_bufcount);
+        fluid_real_t target_amp = buffers->bufs[i].target_amp;
+        fluid_real_t current_amp = buffers->bufs[i].current_amp;
+        fluid_real_t amp_incr;
+
+        if(buf == NULL || (current_amp == 0.0f && target_amp == 0.0f))
+        {
+            continue;
+        }
+
+        amp_incr = (target_amp - current_amp) / FLUID_BUFSIZE;
+        dest_live[buffers->bufs[i].mapping] = TRUE;
+
+        FLUID_ASSERT((uintptr_t)buf % FLUID_DEFAULT_ALIGNMENT == 0);
+
+        /* Mixdown sample_count samples in the current buffer buf
+         *
+         * For the first FLUID_BUFSIZE samples, we linearly interpolate the buffers amplitude to
+         * avoid clicks/pops when rapidly changing the channels panning (issue 768).
+         * 
+         * We could have squashed this into one single loop by using an if clause within the loop body.
+         * But it seems like having two separate loops is easier for compilers to understand, and therefore
+         * auto-vectorizing the loops.
+         */
+        if(sample_count < FLUID_BUFSIZE)
+        {
+            // scalar loop variant, the voice will have finished afterwards
+            for(dsp_i = 0; dsp_i < sample_count; dsp_i++)
+            {
+                buf[start_block * FLUID_BUFSIZE + dsp_i] += current_amp * dsp_buf[start_block * FLUID_BUFSIZE + dsp_i];
+                current_amp += amp_incr;
+            }
+        }
+        else
+        {
+            // here goes the vectorizable loop
+            #pragma omp simd aligned(dsp_buf,buf:FLUID_DEFAULT_ALIGNMENT)
+            for(dsp_i = 0; dsp_i < FLUID_BUFSIZE; dsp_i++)
+            {
+                // We cannot simply increment current_amp by amp_incr during every iteration, as this would create a dependency and prevent vectorization.
+                buf[start_block * FLUID_BUFSIZE + dsp_i] += (current_amp + amp_incr * dsp_i) * dsp_buf[start_block * FLUID_BUFSIZE + dsp_i];
+            }
+            
+            // we have reached the target_amp
+            if(target_amp > 0)
+            {
+                /* Note, that this loop could be unrolled by FLUID_BUFSIZE elements */
+                #pragma omp simd aligned(dsp_buf,buf:FLUID_DEFAULT_ALIGNMENT)
+                for(dsp_i = FLUID_BUFSIZE; dsp_i < sample_count; dsp_i++)
+                {
+                    // Index by blocks (not by samples) to let the compiler know that we always start accessing
+                    // buf and dsp_buf at the FLUID_BUFSIZE*sizeof(fluid_real_t) byte boundary and never somewhere
+                    // in between.
+                    // A good compiler should understand: Aha, so I don't need to add a peel loop when vectorizing
+                    // this loop. Great.
+                    buf[start_block * FLUID_BUFSIZE + dsp_i] += target_amp * dsp_buf[start_block * FLUID_BUFSIZE + dsp_i];
+                }
+            }
+        }
+        
+        buffers->bufs[i].current_amp = target_amp;
+    }
+}
+
+/* Levels the voices of the channel of rvoice are metered to by this participant, NULL if not metered */
+static FLUID_INLINE fluid_meter_acc_t *
+fluid_mixer_buffers_meter(const fluid_mixer_buffers_t *buffers, const fluid_rvoice_t *rvoice)
+{
+#if ENABLE_MIXER_THREADS
+    return fluid_meter_row(buffers->mixer->meter, buffers->thread_idx, rvoice->note_chan);
+#else
+    return fluid_meter_row(buffers->mixer->meter, 0, rvoice->note_chan);
+#endif
+}
+
+/**
+ * Synthesize a voice playing a stereo pair along with its partner and add both to the buffers.
+ * Like fluid_mixer_buffers_render_one(), but mixes block by block, so that the second block of
+ * src_buf can hold the one of the partner, see fluid_rvoice_write().
+ */
+static void
+fluid_mixer_buffers_render_stereo(fluid_mixer_buffers_t *buffers,
+                                  fluid_rvoice_t *rvoice, fluid_real_t **dest_bufs,
+                                  unsigned int dest_bufcount, unsigned char *dest_live,
+                                  fluid_real_t *src_buf, int blockcount)
+{
+    fluid_real_t *stereo_buf = &src_buf[FLUID_BUFSIZE];
+    FLUID_DECLARE_VLA(fluid_real_t *, block_bufs, dest_bufcount);
+    unsigned int j;
+    int i, s;
+
+    for(i = 0; i < blockcount; i++)
+    {
+        /* let the mixdown address the current block of the output buffers */
+        for(j = 0; j < dest_bufcount; j++)
+        {
+            block_bufs[j] = (dest_bufs[j] != NULL) ? &dest_bufs[j][FLUID_BUFSIZE * i] : NULL;
+        }
+
+        s = fluid_rvoice_write(rvoice, src_buf, stereo_buf);
+
+        if(s == -1)
+        {
+            continue;
+        }
+
+        fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, 0, s, block_bufs, dest_bufcount, dest_live,
+                                 fluid_mixer_buffers_meter(buffers, rvoice));
+        fluid_rvoice_buffers_mix(&rvoice->stereo->buffers, stereo_buf, 0, s, block_bufs, dest_bufcount, dest_live,
+                                 fluid_mixer_buffers_meter(buffers, rvoice->stereo));
+
+        if(s < FLUID_BUFSIZE)
+        {
+            /* voice has finished, and so has its partner */
+            fluid_finish_rvoice(buffers, rvoice);
+            break;
+        }
+    }
+}
+
+/**
+ * Synthesize one voice and add to buffer.
+ * NOTE: If return value is less than blockcount*FLUID_BUFSIZE, that means
+ * voice has been finished, removed and possibly replaced with another voice.
+ */
+static FLUID_INLINE void
+fluid_mixer_buffers_render_one(fluid_mixer_buffers_t *buffers,
+                               fluid_rvoice_t *rvoice, fluid_real_t **dest_bufs,
+                               unsigned int dest_bufcount, unsigned char *dest_live,
+                               fluid_real_t *src_buf, int blockcount)
+{
+    fluid_meter_acc_t *meter = fluid_mixer_buffers_meter(buffers, rvoice);
+    int i, total_samples = 0, last_block_mixed = 0;
+
+    if(rvoice->stereo != NULL)
+    {
+        if(rvoice->stereo->envlfo.volenv.section != FLUID_VOICE_ENVFINISHED)
+        {
+            fluid_mixer_buffers_render_stereo(buffers, rvoice, dest_bufs, dest_bufcount, dest_live, src_buf, blockcount);
+            return;
+        }
+
+        /* the partner has been turned off by itself, e.g. to make room for another voice */
+        fluid_finish_rvoice(buffers, rvoice->stereo);
+        rvoice->stereo = NULL;
+    }
+
+    for(i = 0; i < blockcount; i++)
+    {
+        /* render one block in src_buf */
+        int s = fluid_rvoice_write(rvoice, &src_buf[FLUID_BUFSIZE * i], NULL);
+
+        if(s == -1)
+        {
+            /* the voice is silent, mix back all the previously rendered sound */
+            fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, last_block_mixed,
+                                     total_samples - (last_block_mixed * FLUID_BUFSIZE),
+                                     dest_bufs, dest_bufcount, dest_live, meter);
+
+            last_block_mixed = i + 1; /* future block start index to mix from */
+            total_samples += FLUID_BUFSIZE; /* accumulate samples count rendered */
+        }
+        else
+        {
+            /* the voice wasn't quiet. Some samples have been rendered [0..FLUID_BUFSIZE] */
+            total_samples += s;
+
+            if(s < FLUID_BUFSIZE)
+            {
+                /* voice has finished */
+                break;
+            }
+        }
+    }
+
+    /* Now mix the remaining blocks from last_block_mixed to total_sample */
+    fluid_rvoice_buffers_mix(&rvoice->buffers, src_buf, last_block_mixed,
+                             total_samples - (last_block_mixed * FLUID_BUFSIZE),
+                             dest_bufs, dest_bufcount, dest_live, meter);
+
+    if(total_samples < blockcount * FLUID_BUFSIZE)
+    {
+        /* voice has finished */
+        fluid_finish_rvoice(buffers, rvoice);
+    }
+}
+
+/**
+ * Renders a voice like fluid_mixer_buffers_render_one() and, if enabled by
+ * synth.cpu-accounting, accounts the time spent to the channel and preset of the voice.
+ */
+static void
+fluid_mixer_buffers_render_voice(fluid_mixer_buffers_t *buffers,
+                                 fluid_rvoice_t *rvoice, fluid_real_t **dest_bufs,
+                                 unsigned int dest_bufcount, unsigned char *dest_live,
+                                 fluid_real_t *src_buf, int blockcount)
+{
+    fluid_perf_t *perf = buffers->mixer->perf;
+    double acct_ref;
+#if ENABLE_MIXER_THREADS
+    int thread_idx = buffers->thread_idx;
+#else
+    int thread_idx = 0;
+#endif
+
+    if(!fluid_perf_accounting(perf))
+    {
+        fluid_mixer_buffers_render_one(buffers, rvoice, dest_bufs, dest_bufcount, dest_live, src_buf, blockcount);
+        return;
+    }
+
+    acct_ref = fluid_perf_now();
+    fluid_mixer_buffers_render_one(buffers, rvoice, dest_bufs, dest_bufcount, dest_live, src_buf, blockcount);
+    fluid_perf_account(perf, thread_idx, rvoice->perf_chan, rvoice->perf_preset,
+                       fluid_perf_now() - acct_ref, blockcount);
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_add_voice)
+{
+    int i;
+    fluid_rvoice_mixer_t *mixer = obj;
+    fluid_rvoice_t *voice = param[0].ptr;
+
+    voice->resonant_filter.smoothing = mixer->filter_smoothing;
+    voice->resonant_custom_filter.smoothing = mixer->filter_smoothing;
+    voice->dsp.float_interp = mixer->float_interp;
+    fluid_rvoice_cache_start(mixer->voice_cache, voice);
+
+    if(mixer->active_voices < mixer->polyphony)
+    {
+        mixer->rvoices[mixer->active_voices++] = voice;
+        return; // success
+    }
+
+    /* See if any voices just finished, if so, take its place.
+       This can happen in voice overflow conditions. */
+    for(i = 0; i < mixer->active_voices; i++)
+    {
+        if(mixer->rvoices[i] == voice)
+        {
+            FLUID_LOG(FLUID_ERR, "Internal error: Trying to replace an existing rvoice in fluid_rvoice_mixer_add_voice?!");
+            return;
+        }
+
+        if(mixer->rvoices[i]->envlfo.volenv.section == FLUID_VOICE_ENVFINISHED)
+        {
+            fluid_finish_rvoice(&mixer->buffers, mixer->rvoices[i]);
+            mixer->rvoices[i] = voice;
+            return; // success
+        }
+    }
+
+    /* This should never happen */
+    fluid_rvoice_cache_stop(voice);
+    FLUID_LOG(FLUID_ERR, "Trying to exceed polyphony in fluid_rvoice_mixer_add_voice");
+}
+
+/*
+ * Adds the voice of one sample of a stereo pair, which is played along with the voice of the
+ * other sample added before, see fluid_rvoice_write(). If that one isn't playing
+ * anymore, the voice is added like any other.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_add_stereo_voice)
+{
+    int i;
+    fluid_rvoice_mixer_t *mixer = obj;
+    fluid_rvoice_t *voice = param[0].ptr;
+    fluid_rvoice_t *partner = param[1].ptr;
+
+    for(i = 0; i < mixer->active_voices && mixer->rvoices[i] != partner; i++)
+    {
+    }
+
+    if(i == mixer->active_voices || partner->stereo != NULL
+            || partner->envlfo.volenv.section == FLUID_VOICE_ENVFINISHED)
+    {
+        fluid_rvoice_mixer_add_voice(mixer, param);
+        return;
+    }
+
+    /* the partner renders both samples itself, recording only one of them wouldn't do */
+    fluid_rvoice_cache_stop(partner);
+    partner->cache_mode = FLUID_RVOICE_CACHE_OFF;
+    partner->cache_entry = NULL;
+    voice->cache_mode = FLUID_RVOICE_CACHE_OFF;
+    voice->cache_entry = NULL;
+
+    partner->stereo = voice;
+}
+
+/* Frees the arrays of a block and the block itself */
+static void
+delete_fluid_mixer_arrays(fluid_mixer_arrays_t *arrays)
+{
+    int i;
+
+    fluid_return_if_fail(arrays != NULL);
+
+    FLUID_FREE(arrays->rvoices);
+
+    for(i = 0; i < arrays->finished_count; i++)
+    {
+        FLUID_FREE(arrays->finished_voices[i]);
+    }
+
+    FLUID_FREE(arrays->finished_voices);
+
+#if ENABLE_MIXER_THREADS
+    delete_fluid_mixer_threads(arrays->threads, arrays->thread_count);
+    delete_fluid_mixer_threads(arrays->old_threads, arrays->old_thread_count);
+#endif
+
+    FLUID_FREE(arrays);
+}
+
+/* Called by the mixer: hands a block over to the API thread for freeing */
+static void
+fluid_rvoice_mixer_retire_arrays(fluid_rvoice_mixer_t *mixer, fluid_mixer_arrays_t *arrays)
+{
+    fluid_mixer_arrays_t *head;
+
+    do
+    {
+        head = fluid_atomic_pointer_get(&mixer->retired);
+        arrays->next = head;
+    }
+    while(!fluid_atomic_pointer_compare_and_exchange((void **)&mixer->retired, head, arrays));
+}
+
+/* Called by the API thread: frees the blocks retired by the mixer so far */
+static void
+fluid_rvoice_mixer_free_retired(fluid_rvoice_mixer_t *mixer)
+{
+    fluid_mixer_arrays_t *arrays, *next;
+
+    do
+    {
+        arrays = fluid_atomic_pointer_get(&mixer->retired);
+    }
+    while(!fluid_atomic_pointer_compare_and_exchange((void **)&mixer->retired, arrays, NULL));
+
+    for(; arrays != NULL; arrays = next)
+    {
+        next = arrays->next;
+        delete_fluid_mixer_arrays(arrays);
+    }
+}
+
+/* Returns the buffers whose finished voices are kept in finished_voices[idx] of a block */
+static fluid_mixer_buffers_t *
+fluid_mixer_arrays_get_buffers(fluid_rvoice_mixer_t *mixer, int idx)
+{
+    if(idx == 0)
+    {
+        return &mixer->buffers;
+    }
+
+#if ENABLE_MIXER_THREADS
+
+    if(idx - 1 < mixer->thread_count)
+    {
+        return &mixer->threads[idx - 1];
+    }
+
+    idx -= mixer->thread_count;
+#endif
+
+    return (idx == 1) ? mixer->slice_buffers : NULL;
+}
+
+/**
+ * Update polyphony - max number of voices. Swaps in the arrays prepared by
+ * fluid_rvoice_mixer_push_polyphony(), the old ones are retired.
+ */
+static DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_polyphony)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    fluid_mixer_arrays_t *arrays = param[0].ptr;
+    fluid_mixer_buffers_t *buffers;
+    fluid_rvoice_t **swap;
+    int i;
+
+    /* the number of lists only changes along with the queued thread count */
+    if(mixer->active_voices > arrays->polyphony
+            || fluid_mixer_arrays_get_buffers(mixer, arrays->finished_count - 1) == NULL
+            || fluid_mixer_arrays_get_buffers(mixer, arrays->finished_count) != NULL)
+    {
+        fluid_rvoice_mixer_retire_arrays(mixer, arrays);
+        return /*FLUID_FAILED*/;
+    }
+
+    for(i = 0; i < arrays->finished_count; i++)
+    {
+        if(fluid_mixer_arrays_get_buffers(mixer, i)->finished_voice_count > arrays->polyphony)
+        {
+            fluid_rvoice_mixer_retire_arrays(mixer, arrays);
+            return /*FLUID_FAILED*/;
+        }
+    }
+
+    /* the arrays of a mixer without voices may not have been allocated yet */
+    if(mixer->active_voices > 0)
+    {
+        FLUID_MEMCPY(arrays->rvoices, mixer->rvoices, mixer->active_voices * sizeof(*mixer->rvoices));
+    }
+
+    swap = mixer->rvoices;
+    mixer->rvoices = arrays->rvoices;
+    arrays->rvoices = swap;
+
+    for(i = 0; i < arrays->finished_count; i++)
+    {
+        buffers = fluid_mixer_arrays_get_buffers(mixer, i);
+
+        if(buffers->finished_voice_count > 0)
+        {
+            FLUID_MEMCPY(arrays->finished_voices[i], buffers->finished_voices,
+                         buffers->finished_voice_count * sizeof(*buffers->finished_voices));
+        }
+
+        swap = buffers->finished_voices;
+        buffers->finished_voices = arrays->finished_voices[i];
+        buffers->finished_voices_size = arrays->polyphony;
+        arrays->finished_voices[i] = swap;
+    }
+
+    mixer->polyphony = arrays->polyphony;
+    fluid_rvoice_mixer_retire_arrays(mixer, arrays);
+    /*return FLUID_OK*/;
+}
+
+/* Allocates a block with the arrays of polyphony elements for count finished lists */
+static fluid_mixer_arrays_t *
+new_fluid_mixer_arrays(int polyphony, int count)
+{
+    fluid_mixer_arrays_t *arrays = FLUID_NEW(fluid_mixer_arrays_t);
+    int i;
+
+    if(arrays == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(arrays, 0, sizeof(*arrays));
+    arrays->polyphony = polyphony;
+    arrays->rvoices = FLUID_ARRAY(fluid_rvoice_t *, polyphony);
+    arrays->finished_voices = FLUID_ARRAY(fluid_rvoice_t **, count);
+
+    if(arrays->rvoices == NULL || arrays->finished_voices == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_mixer_arrays(arrays);
+        return NULL;
+    }
+
+    FLUID_MEMSET(arrays->finished_voices, 0, count * sizeof(*arrays->finished_voices));
+    arrays->finished_count = count;
+
+    for(i = 0; i < count; i++)
+    {
+        arrays->finished_voices[i] = FLUID_ARRAY(fluid_rvoice_t *, polyphony);
+
+        if(arrays->finished_voices[i] == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            delete_fluid_mixer_arrays(arrays);
+            return NULL;
+        }
+    }
+
+    return arrays;
+}
+
+/**
+ * Change the polyphony of the mixer. The arrays are allocated here, by the API thread, the
+ * mixer only swaps them in when it processes the event.
+ * @return FLUID_OK or FLUID_FAILED
+ */
+int
+fluid_rvoice_mixer_push_polyphony(fluid_rvoice_mixer_t *mixer, int polyphony)
+{
+    fluid_mixer_arrays_t *arrays;
+    int count = 1;
+
+    fluid_return_val_if_fail(polyphony > 0, FLUID_FAILED);
+
+    fluid_rvoice_mixer_free_retired(mixer);
+
+#if ENABLE_MIXER_THREADS
+    count += mixer->queued_thread_count;
+#endif
+
+    if(mixer->slice_buffers != NULL)
+    {
+        count++;
+    }
+
+    arrays = new_fluid_mixer_arrays(polyphony, count);
+
+    if(arrays == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(fluid_rvoice_eventhandler_push_ptr(mixer->eventhandler, fluid_rvoice_mixer_set_polyphony,
+                                          mixer, arrays) != FLUID_OK)
+    {
+        delete_fluid_mixer_arrays(arrays);
+        return FLUID_FAILED;
+    }
+
+    mixer->queued_polyphony = polyphony;
+    return FLUID_OK;
+}
+
+
+/**
+ * Clear the live buffers, to render current_blockcount blocks into them
+ */
+static FLUID_INLINE void
+fluid_mixer_buffers_zero(fluid_mixer_buffers_t *buffers, int current_blockcount)
+{
+    int i, size = buffers->live_blockcount * FLUID_BUFSIZE * sizeof(fluid_real_t);
+    int buf_count = buffers->buf_count, fx_buf_count = buffers->fx_buf_count;
+    const unsigned char *fx_live = &buffers->live[buf_count * 2];
+
+    fluid_real_t *FLUID_RESTRICT buf_l = fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_real_t *FLUID_RESTRICT buf_r = fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    for(i = 0; i < buf_count; i++)
+    {
+        if(buffers->live[i * 2])
+        {
+            FLUID_MEMSET(&buf_l[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
+        }
+
+        if(buffers->live[i * 2 + 1])
+        {
+            FLUID_MEMSET(&buf_r[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
+        }
+    }
+
+    buf_l = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    buf_r = fluid_align_ptr(buffers->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    for(i = 0; i < fx_buf_count; i++)
+    {
+        if(fx_live[i])
+        {
+            FLUID_MEMSET(&buf_l[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
+            FLUID_MEMSET(&buf_r[i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE], 0, size);
+        }
+    }
+
+    FLUID_MEMSET(buffers->live, 0, buf_count * 2 + fx_buf_count);
+    buffers->live_blockcount = current_blockcount;
+}
+
+/* Adds the live buffers of src to dst */
+static void
+fluid_mixer_buffers_mix(fluid_mixer_buffers_t *dst, fluid_mixer_buffers_t *src, int current_blockcount)
+{
+    int i, j;
+    int scount = current_blockcount * FLUID_BUFSIZE;
+    int minbuf;
+    fluid_real_t *FLUID_RESTRICT base_src;
+    fluid_real_t *FLUID_RESTRICT base_dst;
+    const unsigned char *src_live;
+    unsigned char *dst_live;
+
+    minbuf = dst->buf_count;
+
+    if(minbuf > src->buf_count)
+    {
+        minbuf = src->buf_count;
+    }
+
+    base_src = fluid_align_ptr(src->left_buf, FLUID_DEFAULT_ALIGNMENT);
+    base_dst = fluid_align_ptr(dst->left_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    for(i = 0; i < minbuf; i++)
+    {
+        if(!src->live[i * 2])
+        {
+            continue;
+        }
+
+        dst->live[i * 2] = TRUE;
+
+        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+
+        for(j = 0; j < scount; j++)
+        {
+            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
+            base_dst[dsp_i] += base_src[dsp_i];
+        }
+    }
+
+    base_src = fluid_align_ptr(src->right_buf, FLUID_DEFAULT_ALIGNMENT);
+    base_dst = fluid_align_ptr(dst->right_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    for(i = 0; i < minbuf; i++)
+    {
+        if(!src->live[i * 2 + 1])
+        {
+            continue;
+        }
+
+        dst->live[i * 2 + 1] = TRUE;
+
+        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+
+        for(j = 0; j < scount; j++)
+        {
+            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
+            base_dst[dsp_i] += base_src[dsp_i];
+        }
+    }
+
+    minbuf = dst->fx_buf_count;
+
+    if(minbuf > src->fx_buf_count)
+    {
+        minbuf = src->fx_buf_count;
+    }
+
+    src_live = &src->live[src->buf_count * 2];
+    dst_live = &dst->live[dst->buf_count * 2];
+    base_src = fluid_align_ptr(src->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    base_dst = fluid_align_ptr(dst->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    for(i = 0; i < minbuf; i++)
+    {
+        if(!src_live[i])
+        {
+            continue;
+        }
+
+        dst_live[i] = TRUE;
+
+        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+
+        for(j = 0; j < scount; j++)
+        {
+            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
+            base_dst[dsp_i] += base_src[dsp_i];
+        }
+    }
+
+    base_src = fluid_align_ptr(src->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+    base_dst = fluid_align_ptr(dst->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+
+    for(i = 0; i < minbuf; i++)
+    {
+        if(!src_live[i])
+        {
+            continue;
+        }
+
+        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+
+        for(j = 0; j < scount; j++)
+        {
+            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
+            base_dst[dsp_i] += base_src[dsp_i];
+        }
+    }
+}
+
+
+/**
+ * Clear the given buffers and render the voices of one slice into them, see
+ * synth.deterministic-render. A slice consists of FLUID_MIXER_SLICE_VOICES consecutive
+ * voices.
+ */
+static void
+fluid_mixer_buffers_render_slice(fluid_mixer_buffers_t *buffers, int slice, int blockcount)
+{
+    fluid_rvoice_mixer_t *mixer = buffers->mixer;
+    FLUID_DECLARE_VLA(fluid_real_t *, bufs, buffers->buf_count * 2 + buffers->fx_buf_count * 2);
+    fluid_real_t *local_buf = fluid_align_ptr(buffers->local_buf, FLUID_DEFAULT_ALIGNMENT);
+    int i = slice * FLUID_MIXER_SLICE_VOICES;
+    int end = i + FLUID_MIXER_SLICE_VOICES;
+    int bufcount;
+
+    if(end > mixer->active_voices)
+    {
+        end = mixer->active_voices;
+    }
+
+    fluid_mixer_buffers_zero(buffers, blockcount);
+    bufcount = fluid_mixer_buffers_prepare(buffers, bufs);
+
+    for(; i < end; i++)
+    {
+        fluid_mixer_buffers_render_voice(buffers, mixer->rvoices[i], bufs,
+                                         bufcount, buffers->live, local_buf, blockcount);
+    }
+}
+
+static void
+fluid_render_loop_singlethread(fluid_rvoice_mixer_t *mixer, int blockcount)
+{
+    int i;
+    FLUID_DECLARE_VLA(fluid_real_t *, bufs,
+                      mixer->buffers.buf_count * 2 + mixer->buffers.fx_buf_count * 2);
+    int bufcount = fluid_mixer_buffers_prepare(&mixer->buffers, bufs);
+
+    fluid_real_t *local_buf = fluid_align_ptr(mixer->buffers.local_buf, FLUID_DEFAULT_ALIGNMENT);
+    double perf_ref = fluid_perf_ref(mixer->perf);
+    double trace_ref = fluid_trace_ref();
+
+    fluid_profile_ref_var(prof_ref);
+
+    if(mixer->slice_buffers != NULL)
+    {
+        /* sum up the slices in the same order as fluid_mixer_buffers_render_slices() */
+        for(i = 0; i * FLUID_MIXER_SLICE_VOICES < mixer->active_voices; i++)
+        {
+            fluid_mixer_buffers_render_slice(mixer->slice_buffers, i, blockcount);
+            fluid_mixer_buffers_mix(&mixer->buffers, mixer->slice_buffers, blockcount);
+        }
+    }
+    else
+    {
+        for(i = 0; i < mixer->active_voices; i++)
+        {
+            fluid_mixer_buffers_render_voice(&mixer->buffers, mixer->rvoices[i], bufs,
+                                             bufcount, mixer->buffers.live, local_buf, blockcount);
+            fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, 1,
+                          blockcount * FLUID_BUFSIZE);
+        }
+    }
+
+    fluid_perf_thread(mixer->perf, 0, perf_ref, perf_ref != 0.0 ? fluid_perf_now() - perf_ref : 0.0);
+    fluid_trace_span("voices", trace_ref);
+}
+
+/**
+ * Allocate the live flags, with all buffers marked live, so that they get cleared entirely
+ * before they are used for the first time
+ */
+static int
+fluid_mixer_buffers_init_live(fluid_mixer_buffers_t *buffers)
+{
+    int count = buffers->buf_count * 2 + buffers->fx_buf_count;
+
+    buffers->live = FLUID_ARRAY(unsigned char, count);
+
+    if(buffers->live == NULL)
+    {
+        return FALSE;
+    }
+
+    FLUID_MEMSET(buffers->live, TRUE, count);
+    buffers->live_blockcount = FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+    return TRUE;
+}
+
+static int
+fluid_mixer_buffers_init(fluid_mixer_buffers_t *buffers, fluid_rvoice_mixer_t *mixer, int polyphony)
+{
+    static const int samplecount = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+
+    buffers->mixer = mixer;
+    buffers->buf_count = mixer->buffers.buf_count;
+    buffers->fx_buf_count = mixer->buffers.fx_buf_count;
+
+    /* Local mono voice buf */
+    buffers->local_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, samplecount, FLUID_DEFAULT_ALIGNMENT);
+
+    /* Left and right audio buffers */
+
+    buffers->left_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+    buffers->right_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+
+    if((buffers->local_buf == NULL) || (buffers->left_buf == NULL) || (buffers->right_buf == NULL))
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return 0;
+    }
+
+    /* Effects audio buffers */
+
+    buffers->fx_left_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->fx_buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+    buffers->fx_right_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->fx_buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+
+    if((buffers->fx_left_buf == NULL) || (buffers->fx_right_buf == NULL)
+            || !fluid_mixer_buffers_init_live(buffers))
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return 0;
+    }
+
+    buffers->finished_voices = NULL;
+    buffers->finished_voices_size = polyphony;
+
+    if(polyphony > 0)
+    {
+        buffers->finished_voices = FLUID_ARRAY(fluid_rvoice_t *, polyphony);
+
+        if(buffers->finished_voices == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Enable or disable ordering the voices by the sample memory they read.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_voice_locality)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+
+    mixer->voice_locality = param[0].i;
+    mixer->locality_blocks = FLUID_MIXER_LOCALITY_BLOCKS;
+}
+
+/**
+ * Enable or disable rendering each audio group end-to-end on a thread of its own.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_parallel_groups)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+
+    mixer->parallel_groups = param[0].i;
+}
+
+/**
+ * Set how the filters of all voices follow changes of fres and Q, see enum fluid_iir_filter_smoothing.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_filter_smoothing)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int i;
+
+    mixer->filter_smoothing = param[0].i;
+
+    for(i = 0; i < mixer->active_voices; i++)
+    {
+        mixer->rvoices[i]->resonant_filter.smoothing = mixer->filter_smoothing;
+        mixer->rvoices[i]->resonant_custom_filter.smoothing = mixer->filter_smoothing;
+    }
+}
+
+/**
+ * Set whether all voices interpolate their samples in single precision, see synth.float-interpolation.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_float_interp)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int i;
+
+    mixer->float_interp = param[0].i;
+
+    for(i = 0; i < mixer->active_voices; i++)
+    {
+        mixer->rvoices[i]->dsp.float_interp = mixer->float_interp;
+    }
+}
+
+/**
+ * Set how the mixer threads wait for each other, see enum fluid_mixer_thread_wait.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_thread_wait)
+{
+#if ENABLE_MIXER_THREADS
+    fluid_rvoice_mixer_t *mixer = obj;
+
+    mixer->thread_wait = param[0].i;
+#endif
+}
+
+/*
+ * Sets the rate of the reverb and chorus units from the output sample rate: the
+ * highest power of two up to fx_decimation that keeps the rate of the effects
+ * at FLUID_FX_MIN_DECIMATED_RATE or above divides it.
+ * Note: Not hard realtime capable (calls malloc)
+ */
+static void
+fluid_rvoice_mixer_update_fx_rate(fluid_rvoice_mixer_t *mixer, fluid_real_t samplerate)
+{
+    int factor = 1;
+    int i;
+
+    while(factor * 2 <= mixer->fx_decimation && samplerate / (factor * 2) >= FLUID_FX_MIN_DECIMATED_RATE)
+    {
+        factor *= 2;
+    }
+
+    mixer->sample_rate = samplerate;
+    mixer->fx_factor = factor;
+
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        if(mixer->fx[i].chorus)
+        {
+            fluid_chorus_samplerate_change(mixer->fx[i].chorus, samplerate / factor);
+        }
+
+        if(mixer->fx[i].reverb)
+        {
+            fluid_revmodel_samplerate_change(mixer->fx[i].reverb, samplerate / factor);
+
+            /*
+              fluid_revmodel_samplerate_change() shouldn't fail if the reverb was created
+              with sample_rate_max set to the maximum sample rate indicated in the settings.
+              If this condition isn't respected, the reverb will continue to work but with
+              lost of quality.
+            */
+        }
+
+        if(mixer->fx[i].reverb_rs)
+        {
+            fluid_fx_resampler_set_factor(mixer->fx[i].reverb_rs, factor);
+            fluid_fx_resampler_set_factor(mixer->fx[i].chorus_rs, factor);
+        }
+    }
+}
+
+/**
+ * Note: Not hard realtime capable (calls malloc)
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_samplerate)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    fluid_real_t samplerate = param[1].real; // because fluid_synth_update_mixer() puts real into arg2
+
+    mixer->fx_tail_blocks = fluid_rvoice_mixer_fx_tail_blocks(samplerate);
+    fluid_rvoice_mixer_update_fx_rate(mixer, samplerate);
+
+    if(mixer->limiter != NULL)
+    {
+        fluid_limiter_samplerate_change(mixer->limiter, samplerate);
+    }
+
+#if LADSPA
+
+    if(mixer->ladspa_fx != NULL)
+    {
+        fluid_ladspa_set_sample_rate(mixer->ladspa_fx, samplerate);
+    }
+
+#endif
+}
+
+
+/**
+ * @param buf_count number of primary stereo buffers
+ * @param fx_buf_count number of stereo effect buffers
+ * @param cpus CPUs to pin the extra mixer threads to, round-robin (may be NULL)
+ * @param cpu_count number of elements in \c cpus, 0 to leave the threads unpinned
+ */
+fluid_rvoice_mixer_t *
+new_fluid_rvoice_mixer(int buf_count, int fx_buf_count, int fx_units,
+                       fluid_real_t sample_rate_max,
+                       fluid_real_t sample_rate,
+                       fluid_rvoice_eventhandler_t *evthandler,
+                       int extra_threads, int prio,
+                       const int *cpus, int cpu_count)
+{
+    int i;
+    fluid_rvoice_mixer_t *mixer = FLUID_NEW(fluid_rvoice_mixer_t);
+
+    if(mixer == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(mixer, 0, sizeof(fluid_rvoice_mixer_t));
+#if ENABLE_MIXER_THREADS
+    fluid_mutex_init(mixer->workgroup_m);
+#endif
+    mixer->eventhandler = evthandler;
+    mixer->fx_units = fx_units;
+    mixer->fx_tail_blocks = fluid_rvoice_mixer_fx_tail_blocks(sample_rate);
+    mixer->fx_decimation = mixer->fx_factor = 1;
+    mixer->sample_rate = sample_rate;
+    mixer->buffers.buf_count = buf_count;
+    mixer->buffers.fx_buf_count = fx_buf_count * fx_units;
+
+    /* allocate the reverb module */
+    mixer->fx = FLUID_ARRAY(fluid_mixer_fx_t, fx_units);
+
+    if(mixer->fx == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    FLUID_MEMSET(mixer->fx, 0, fx_units * sizeof(*mixer->fx));
+
+    for(i = 0; i < fx_units; i++)
+    {
+        /* create reverb and chorus units */
+        mixer->fx[i].reverb = new_fluid_revmodel(sample_rate_max, sample_rate);
+        mixer->fx[i].chorus = new_fluid_chorus(sample_rate);
+
+        if(mixer->fx[i].reverb == NULL || mixer->fx[i].chorus == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
+
+        /* new units are in the same state as units reset after their tail died out,
+         * they are bypassed until input arrives */
+        mixer->fx[i].reverb_silent_blocks = mixer->fx_tail_blocks;
+        mixer->fx[i].chorus_silent_blocks = mixer->fx_tail_blocks;
+        mixer->fx[i].reverb_leader = mixer->fx[i].chorus_leader = i;
+    }
+
+    if(!fluid_mixer_buffers_init(&mixer->buffers, mixer, 0))
+    {
+        goto error_recovery;
+    }
+
+#if ENABLE_MIXER_THREADS
+    mixer->thread_ready = new_fluid_cond();
+    mixer->wakeup_threads = new_fluid_cond();
+    mixer->thread_ready_m = new_fluid_cond_mutex();
+    mixer->wakeup_threads_m = new_fluid_cond_mutex();
+
+    if(!mixer->thread_ready || !mixer->wakeup_threads ||
+            !mixer->thread_ready_m || !mixer->wakeup_threads_m)
+    {
+        goto error_recovery;
+    }
+
+    mixer->own_thread_count = extra_threads;
+    mixer->prio_level = prio;
+
+    if(cpu_count > 0)
+    {
+        mixer->cpus = FLUID_ARRAY(int, cpu_count);
+
+        if(mixer->cpus == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
+
+        FLUID_MEMCPY(mixer->cpus, cpus, cpu_count * sizeof(*cpus));
+        mixer->cpu_count = cpu_count;
+    }
+
+    if(fluid_rvoice_mixer_set_threads(mixer, extra_threads, prio) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+#endif
+
+    return mixer;
+
+error_recovery:
+    delete_fluid_rvoice_mixer(mixer);
+    return NULL;
+}
+
+static void
+fluid_mixer_buffers_free(fluid_mixer_buffers_t *buffers)
+{
+    FLUID_FREE(buffers->finished_voices);
+
+    /* free all the sample buffers */
+    FLUID_FREE(buffers->local_buf);
+    FLUID_FREE(buffers->left_buf);
+    FLUID_FREE(buffers->right_buf);
+    FLUID_FREE(buffers->fx_left_buf);
+    FLUID_FREE(buffers->fx_right_buf);
+    FLUID_FREE(buffers->live);
+}
+
+void delete_fluid_rvoice_mixer(fluid_rvoice_mixer_t *mixer)
+{
+    int i;
+
+    fluid_return_if_fail(mixer != NULL);
+
+#if ENABLE_MIXER_THREADS
+    delete_rvoice_mixer_fx_stage(mixer);
+    delete_rvoice_mixer_threads(mixer);
+
+    if(mixer->pool != NULL)
+    {
+        fluid_atomic_int_add(&mixer->pool->attached, -1);
+    }
+
+    FLUID_FREE(mixer->cpus);
+
+    if(mixer->thread_ready)
+    {
+        delete_fluid_cond(mixer->thread_ready);
+    }
+
+    if(mixer->wakeup_threads)
+    {
+        delete_fluid_cond(mixer->wakeup_threads);
+    }
+
+    if(mixer->thread_ready_m)
+    {
+        delete_fluid_cond_mutex(mixer->thread_ready_m);
+    }
+
+    if(mixer->wakeup_threads_m)
+    {
+        delete_fluid_cond_mutex(mixer->wakeup_threads_m);
+    }
+
+    if(mixer->workgroup != NULL)
+    {
+        fluid_workgroup_release(mixer->workgroup);
+    }
+
+    fluid_mutex_destroy(mixer->workgroup_m);
+#endif
+    fluid_rvoice_mixer_free_retired(mixer);
+    fluid_mixer_buffers_free(&mixer->buffers);
+
+    if(mixer->slice_buffers != NULL)
+    {
+        fluid_mixer_buffers_free(mixer->slice_buffers);
+        FLUID_FREE(mixer->slice_buffers);
+    }
+
+    if(mixer->limiter)
+    {
+        delete_fluid_limiter(mixer->limiter);
+    }
+
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        if(mixer->fx[i].reverb)
+        {
+            delete_fluid_revmodel(mixer->fx[i].reverb);
+        }
+
+        if(mixer->fx[i].chorus)
+        {
+            delete_fluid_chorus(mixer->fx[i].chorus);
+        }
+
+        delete_fluid_fx_resampler(mixer->fx[i].reverb_rs);
+        delete_fluid_fx_resampler(mixer->fx[i].chorus_rs);
+    }
+
+    delete_fluid_rvoice_cache(mixer->voice_cache);
+    FLUID_FREE(mixer->fx);
+    FLUID_FREE(mixer->rvoices);
+    FLUID_FREE(mixer);
+}
+
+#ifdef LADSPA
+/* Returns the buffers the effects are processed in */
+static fluid_mixer_buffers_t *
+fluid_rvoice_mixer_fx_buffers(fluid_rvoice_mixer_t *mixer)
+{
+#if ENABLE_MIXER_THREADS
+
+    if(mixer->fx_stage != NULL)
+    {
+        return mixer->fx_stage;
+    }
+
+#endif
+    return &mixer->buffers;
+}
+
+/**
+ * Set a LADSPS fx instance to be used by the mixer and assign the mixer buffers
+ * as LADSPA host buffers with sensible names */
+void fluid_rvoice_mixer_set_ladspa(fluid_rvoice_mixer_t *mixer,
+                                   fluid_ladspa_fx_t *ladspa_fx, int audio_groups)
+{
+    mixer->ladspa_fx = ladspa_fx;
+
+    if(ladspa_fx == NULL)
+    {
+        return;
+    }
+    else
+    {
+        /* the effects are processed in the buffers of the pipelined stage if there is one */
+        fluid_mixer_buffers_t *buffers = fluid_rvoice_mixer_fx_buffers(mixer);
+
+        fluid_real_t *main_l = fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
+        fluid_real_t *main_r = fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT);
+
+        fluid_real_t *rev = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+        fluid_real_t *chor = rev;
+
+        rev = &rev[SYNTH_REVERB_CHANNEL * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
+        chor = &chor[SYNTH_CHORUS_CHANNEL * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
+
+        fluid_ladspa_add_host_ports(ladspa_fx, "Main:L", audio_groups,
+                                    main_l,
+                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+
+        fluid_ladspa_add_host_ports(ladspa_fx, "Main:R", audio_groups,
+                                    main_r,
+                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+
+        fluid_ladspa_add_host_ports(ladspa_fx, "Reverb:Send", 1,
+                                    rev,
+                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+
+        fluid_ladspa_add_host_ports(ladspa_fx, "Chorus:Send", 1,
+                                    chor,
+                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+
+#if ENABLE_MIXER_THREADS
+        /* independent effect chains may use as many threads as the voices */
+        fluid_ladspa_set_max_threads(ladspa_fx, mixer->thread_count + 1);
+#endif
+    }
+}
+#endif
+
+/* Limits the dry output of each audio group, i.e. each buffer pair, independently */
+int fluid_rvoice_mixer_set_limiter(fluid_rvoice_mixer_t *mixer, fluid_real_t sample_rate, fluid_limiter_settings_t* settings)
+{
+    mixer->limiter = new_fluid_limiter(sample_rate, settings, mixer->buffers.buf_count);
+
+    return mixer->limiter != NULL;
+}
+
+/**
+ * set one or more reverb shadow parameters for one fx group.
+ * These parameters will be returned if queried.
+ * (see fluid_rvoice_mixer_reverb_get_param())
+ *
+ * @param mixer that contains all fx units.
+ * @param fx_group index of the fx group to which parameters must be set.
+ *  must be in the range [-1..mixer->fx_units[. If -1 the changes are applied to
+ *  all fx units.
+ * @param set Flags indicating which parameters should be set (#fluid_revmodel_set_t)
+ * @param values table of parameters values.
+ */
+void
+fluid_rvoice_mixer_set_reverb_full(const fluid_rvoice_mixer_t *mixer,
+                                   int fx_group, int set, const double values[])
+{
+    fluid_mixer_fx_t *fx = mixer->fx;
+    int nr_units = mixer->fx_units;
+
+    if(fx_group >= 0) /* apply parameters to this fx group only */
+    {
+        nr_units = fx_group + 1;
+    }
+    else /* apply parameters to all fx groups */
+    {
+        fx_group = 0;
+    }
+
+    for(; fx_group < nr_units; fx_group++)
+    {
+        int param;
+
+        for(param = 0; param < FLUID_REVERB_PARAM_LAST; param++)
+        {
+            if(set & FLUID_REVPARAM_TO_SETFLAG(param))
+            {
+                fx[fx_group].reverb_param[param] = values[param];
+            }
+        }
+    }
+}
+
+/**
+ * get one reverb shadow parameter for one fx group.
+ * (see fluid_rvoice_mixer_set_reverb_full())
+ *
+ * @param mixer that contains all fx group units.
+ * @param fx_group index of the fx group to get parameter from.
+ *  must be in the range [0..mixer->fx_units[.
+ * @param enum indicating the parameter to get.
+ *  FLUID_REVERB_ROOMSIZE, reverb room size value.
+ *  FLUID_REVERB_DAMP, reverb damping value.
+ *  FLUID_REVERB_WIDTH, reverb width value.
+ *  FLUID_REVERB_LEVEL, reverb level value.
+ * @return value.
+ */
+double
+fluid_rvoice_mixer_reverb_get_param(const fluid_rvoice_mixer_t *mixer,
+                                    int fx_group, int param)
+{
+    return mixer->fx[fx_group].reverb_param[param];
+}
+
+/**
+ * set one or more chorus shadow parameters for one fx group.
+ * These parameters will be returned if queried.
+ * (see fluid_rvoice_mixer_chorus_get_param())
+ *
+ * @param mixer that contains all fx units.
+ * @param fx_group index of the fx group to which parameters must be set.
+ *  must be in the range [-1..mixer->fx_units[. If -1 the changes are applied
+ *  to all fx group.
+ * Keep in mind, that the needed CPU time is proportional to 'nr'.
+ * @param set Flags indicating which parameters to set (#fluid_chorus_set_t)
+ * @param values table of pararameters.
+ */
+void
+fluid_rvoice_mixer_set_chorus_full(const fluid_rvoice_mixer_t *mixer,
+                                   int fx_group, int set, const double values[])
+{
+    fluid_mixer_fx_t *fx = mixer->fx;
+    int nr_units = mixer->fx_units;
+
+    if(fx_group >= 0) /* apply parameters to this group fx only */
+    {
+        nr_units = fx_group + 1;
+    }
+    else /* apply parameters to all fx units*/
+    {
+        fx_group = 0;
+    }
+
+    for(; fx_group < nr_units; fx_group++)
+    {
+        int param;
+
+        for(param = 0; param < FLUID_CHORUS_PARAM_LAST; param++)
+        {
+            if(set & FLUID_CHORPARAM_TO_SETFLAG(param))
+            {
+                fx[fx_group].chorus_param[param] = values[param];
+            }
+        }
+    }
+}
+
+/**
+ * get one chorus shadow parameter for one fx group.
+ * (see fluid_rvoice_mixer_set_chorus_full())
+ *
+ * @param mixer that contains all fx groups units.
+ * @param fx_group index of the fx group to get parameter from.
+ *  must be in the range [0..mixer->fx_units[.
+ * @param get Flags indicating which parameter to get (#fluid_chorus_set_t)
+ * @return the parameter value (0.0 is returned if error)
+ */
+double
+fluid_rvoice_mixer_chorus_get_param(const fluid_rvoice_mixer_t *mixer,
+                                    int fx_group, int param)
+{
+    return mixer->fx[fx_group].chorus_param[param];
+}
+
+/* @deprecated: use fluid_rvoice_mixer_reverb_enable instead */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_reverb_enabled)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int on = param[0].i;
+
+    mixer->with_reverb = on;
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reverb_enable)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int fx_group = param[0].i; /* reverb fx group index */
+    int on = param[1].i;       /* on/off */
+
+    int nr_units = mixer->fx_units;
+
+    /* does on/off must be applied only to fx group at index fx_group ? */
+    if(fx_group >= 0)
+    {
+        mixer->fx[fx_group].reverb_on = on;
+    }
+    /* on/off must be applied to all fx groups */
+    else
+    {
+        for(fx_group = 0; fx_group < nr_units; fx_group++)
+        {
+            mixer->fx[fx_group].reverb_on = on;
+        }
+    }
+
+    /* set with_reverb if at least one reverb unit is on */
+    for(fx_group = 0; fx_group < nr_units; fx_group++)
+    {
+        on = mixer->fx[fx_group].reverb_on;
+
+        if(on)
+        {
+            break;
+        }
+    }
+
+    mixer->with_reverb = on;
+    fluid_rvoice_mixer_update_fx_share(mixer);
+}
+
+/* @deprecated: use fluid_rvoice_mixer_chorus_enable instead */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_enabled)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int on = param[0].i;
+    mixer->with_chorus = on;
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_chorus_enable)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int fx_group = param[0].i; /* chorus fx group index */
+    int on = param[1].i;       /* on/off */
+
+    int nr_units = mixer->fx_units;
+
+    /* does on/off must be applied only to fx group at index fx_group ? */
+    if(fx_group >= 0)
+    {
+        mixer->fx[fx_group].chorus_on = on;
+    }
+    /* on/off must be applied to all fx groups */
+    else
+    {
+        for(fx_group = 0; fx_group < nr_units; fx_group++)
+        {
+            mixer->fx[fx_group].chorus_on = on;
+        }
+    }
+
+    /* set with_chorus if at least one chorus unit is on */
+    for(fx_group = 0; fx_group < nr_units; fx_group++)
+    {
+        on = mixer->fx[fx_group].chorus_on;
+
+        if(on)
+        {
+            break;
+        }
+    }
+
+    mixer->with_chorus = on;
+    fluid_rvoice_mixer_update_fx_share(mixer);
+}
+
+void fluid_rvoice_mixer_set_mix_fx(fluid_rvoice_mixer_t *mixer, int on)
+{
+    mixer->mix_fx_to_out = on;
+}
+
+/*
+ * Returns the unit whose reverb (or chorus) the sends of unit f can be processed by:
+ * the first enabled unit with identical parameters outputting to the same dry buffers,
+ * or f itself if there is none, see synth.fx-share.
+ */
+static int
+fluid_rvoice_mixer_find_fx_leader(const fluid_rvoice_mixer_t *mixer, int f, int is_reverb)
+{
+    const fluid_mixer_fx_t *fx = &mixer->fx[f];
+    const fluid_mixer_fx_t *other;
+    int g;
+
+    if(!mixer->fx_share || !(is_reverb ? fx->reverb_on && fx->convolver == NULL : fx->chorus_on))
+    {
+        return f;
+    }
+
+    for(g = 0; g < f; g++)
+    {
+        other = &mixer->fx[g];
+
+        if(g % mixer->buffers.buf_count != f % mixer->buffers.buf_count)
+        {
+            continue;
+        }
+
+        if(is_reverb && other->reverb_leader == g && other->reverb_on && other->convolver == NULL
+                && memcmp(other->reverb_set, fx->reverb_set, sizeof(fx->reverb_set)) == 0)
+        {
+            return g;
+        }
+
+        if(!is_reverb && other->chorus_leader == g && other->chorus_on
+                && memcmp(other->chorus_set, fx->chorus_set, sizeof(fx->chorus_set)) == 0)
+        {
+            return g;
+        }
+    }
+
+    return f;
+}
+
+/*
+ * Finds the units sharing their reverb and chorus, to be called whenever the parameters,
+ * on/off state or convolver of a unit change. A unit joining another one is reset, its
+ * tail is lost.
+ */
+static void
+fluid_rvoice_mixer_update_fx_share(fluid_rvoice_mixer_t *mixer)
+{
+    fluid_mixer_fx_t *fx;
+    int f, leader;
+
+    for(f = 0; f < mixer->fx_units; f++)
+    {
+        fx = &mixer->fx[f];
+
+        leader = fluid_rvoice_mixer_find_fx_leader(mixer, f, TRUE);
+
+        if(leader != f && fx->reverb_leader == f)
+        {
+            fluid_revmodel_reset(fx->reverb);
+
+            if(fx->reverb_rs != NULL)
+            {
+                fluid_fx_resampler_reset(fx->reverb_rs);
+            }
+
+            fx->reverb_silent_blocks = mixer->fx_tail_blocks;
+        }
+
+        fx->reverb_leader = leader;
+
+        leader = fluid_rvoice_mixer_find_fx_leader(mixer, f, FALSE);
+
+        if(leader != f && fx->chorus_leader == f)
+        {
+            fluid_chorus_reset(fx->chorus);
+
+            if(fx->chorus_rs != NULL)
+            {
+                fluid_fx_resampler_reset(fx->chorus_rs);
+            }
+
+            fx->chorus_silent_blocks = mixer->fx_tail_blocks;
+        }
+
+        fx->chorus_leader = leader;
+    }
+}
+
+/**
+ * Process the sends of fx units with identical parameters by a single reverb and
+ * chorus in mix mode, see synth.fx-share. Must be called before rendering.
+ */
+void fluid_rvoice_mixer_set_fx_share(fluid_rvoice_mixer_t *mixer, int on)
+{
+    mixer->fx_share = on;
+    fluid_rvoice_mixer_update_fx_share(mixer);
+}
+
+/* Records the parameters flagged in set, as passed to fluid_revmodel_set() or fluid_chorus_set() */
+static void
+fluid_rvoice_mixer_record_fx_params(fluid_real_t *dest, const fluid_real_t *values, int set, int count)
+{
+    int param;
+
+    for(param = 0; param < count; param++)
+    {
+        if(set & (1 << param))
+        {
+            dest[param] = values[param];
+        }
+    }
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_params)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int i = param[0].i;
+    int set = param[1].i;
+    int nr = param[2].i;
+    fluid_real_t level = param[3].real;
+    fluid_real_t speed = param[4].real;
+    fluid_real_t depth_ms = param[5].real;
+    int type = param[6].i;
+    fluid_real_t values[FLUID_CHORUS_PARAM_LAST];
+
+    int nr_units = mixer->fx_units;
+
+    /* does parameters must be applied only to fx group i ? */
+    if(i >= 0)
+    {
+        nr_units = i + 1;
+    }
+    else
+    {
+        i = 0; /* parameters must be applied to all fx groups */
+    }
+
+    values[FLUID_CHORUS_NR] = nr;
+    values[FLUID_CHORUS_LEVEL] = level;
+    values[FLUID_CHORUS_SPEED] = speed;
+    values[FLUID_CHORUS_DEPTH] = depth_ms;
+    values[FLUID_CHORUS_TYPE] = type;
+
+    while(i < nr_units)
+    {
+        fluid_rvoice_mixer_record_fx_params(mixer->fx[i].chorus_set, values, set, FLUID_CHORUS_PARAM_LAST);
+        fluid_chorus_set(mixer->fx[i++].chorus, set, nr, level, speed, depth_ms, type);
+    }
+
+    fluid_rvoice_mixer_update_fx_share(mixer);
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_reverb_params)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int i = param[0].i; /* fx group index */
+    int set = param[1].i;
+    fluid_real_t roomsize = param[2].real;
+    fluid_real_t damping = param[3].real;
+    fluid_real_t width = param[4].real;
+    fluid_real_t level = param[5].real;
+    fluid_real_t values[FLUID_REVERB_PARAM_LAST];
+
+    int nr_units = mixer->fx_units;
+
+    /* does parameters change should be applied only to fx group i ? */
+    if(i >= 0)
+    {
+        nr_units = i + 1; /* parameters change must be applied to fx groups i */
+    }
+    else
+    {
+        i = 0; /* parameters change must be applied to all fx groups */
+    }
+
+    values[FLUID_REVERB_ROOMSIZE] = roomsize;
+    values[FLUID_REVERB_DAMP] = damping;
+    values[FLUID_REVERB_WIDTH] = width;
+    values[FLUID_REVERB_LEVEL] = level;
+
+    while(i < nr_units)
+    {
+        fluid_rvoice_mixer_record_fx_params(mixer->fx[i].reverb_set, values, set, FLUID_REVERB_PARAM_LAST);
+        fluid_revmodel_set(mixer->fx[i++].reverb, set, roomsize, damping, width, level);
+    }
+
+    fluid_rvoice_mixer_update_fx_share(mixer);
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_reverb)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int i;
+
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        fluid_revmodel_reset(mixer->fx[i].reverb);
+
+        if(mixer->fx[i].reverb_rs != NULL)
+        {
+            fluid_fx_resampler_reset(mixer->fx[i].reverb_rs);
+        }
+
+        if(mixer->fx[i].convolver != NULL)
+        {
+            fluid_convolver_reset(mixer->fx[i].convolver);
+        }
+    }
+}
+
+/**
+ * Replace the reverb of an fx unit by a convolution reverb, or return to the
+ * reverb model if the convolver is NULL. The convolver previously used by the
+ * unit is retired, to be deleted by the synth.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_convolver)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int fx_group = param[0].i;
+    fluid_convolver_t *conv = param[1].ptr;
+
+    if(mixer->fx[fx_group].convolver != NULL)
+    {
+        fluid_convolver_retire(mixer->fx[fx_group].convolver);
+    }
+
+    if(conv == NULL)
+    {
+        /* the reverb model has not been processing while the convolver was used */
+        fluid_revmodel_reset(mixer->fx[fx_group].reverb);
+
+        if(mixer->fx[fx_group].reverb_rs != NULL)
+        {
+            fluid_fx_resampler_reset(mixer->fx[fx_group].reverb_rs);
+        }
+    }
+
+    mixer->fx[fx_group].convolver = conv;
+    mixer->fx[fx_group].reverb_silent_blocks = 0;
+    fluid_rvoice_mixer_update_fx_share(mixer);
+}
+
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_chorus)
+{
+    fluid_rvoice_mixer_t *mixer = obj;
+    int i;
+
+    for(i = 0; i < mixer->fx_units; i++)
+    {
+        fluid_chorus_reset(mixer->fx[i].chorus);
+
+        if(mixer->fx[i].chorus_rs != NULL)
+        {
+            fluid_fx_resampler_reset(mixer->fx[i].chorus_rs);
+        }
+    }
+}
+
+int fluid_rvoice_mixer_get_bufs(fluid_rvoice_mixer_t *mixer,
+                                fluid_real_t **left, fluid_real_t **right)
+{
+    *left = fluid_align_ptr(mixer->buffers.left_buf, FLUID_DEFAULT_ALIGNMENT);
+    *right = fluid_align_ptr(mixer->buffers.right_buf, FLUID_DEFAULT_ALIGNMENT);
+    return mixer->buffers.buf_count;
+}
+
+int fluid_rvoice_mixer_get_fx_bufs(fluid_rvoice_mixer_t *mixer,
+                                   fluid_real_t **fx_left, fluid_real_t **fx_right)
+{
+    *fx_left = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    *fx_right = fluid_align_ptr(mixer->buffers.fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+    return mixer->buffers.fx_buf_count;
+}
+
+/*
+ * Returns for the buffers of fluid_rvoice_mixer_get_bufs(), i.e. the left and right buffer of
+ * each audio group, followed by the buffers of fluid_rvoice_mixer_get_fx_bufs(), i.e. each
+ * effects channel, whether they hold any sound. The others are silent.
+ */
+const unsigned char *fluid_rvoice_mixer_get_live_bufs(fluid_rvoice_mixer_t *mixer)
+{
+    return mixer->buffers.live;
+}
+
+int fluid_rvoice_mixer_get_bufcount(fluid_rvoice_mixer_t *mixer)
+{
+    return FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+}
+
+#if WITH_PROFILING
+int fluid_rvoice_mixer_get_active_voices(fluid_rvoice_mixer_t *mixer)
+{
+    return mixer->active_voices;
+}
+#endif
+
+#if ENABLE_MIXER_THREADS
+
+/* Returns the buffers of render participant \c idx, 0 being the main thread */
+static FLUID_INLINE fluid_mixer_buffers_t *
+fluid_mixer_get_participant(fluid_rvoice_mixer_t *mixer, int idx)
+{
+    return (idx == 0) ? &mixer->buffers : &mixer->threads[idx - 1];
+}
+
+/**
+ * Split the active voices into one contiguous chunk per render participant,
+ * so that each chunk carries about the same estimated rendering cost.
+ * Must be called before the participants are woken up.
+ */
+static void
+fluid_mixer_partition_rvoices(fluid_rvoice_mixer_t *mixer, int participants)
+{
+    int i, v = 0;
+    int count = mixer->active_voices;
+    long total_cost = 0, acc_cost = 0;
+
+    mixer->active_threads = participants;
+
+    for(i = 0; i < count; i++)
+    {
+        total_cost += mixer->rvoices[i]->cost;
+    }
+
+    for(i = 0; i < participants; i++)
+    {
+        fluid_mixer_buffers_t *b = fluid_mixer_get_participant(mixer, i);
+        long target = (total_cost * (i + 1)) / participants;
+
+        fluid_atomic_int_set(&b->next_rvoice, v);
+
+        if(i == participants - 1)
+        {
+            v = count;
+        }
+        else
+        {
+            while(v < count && acc_cost + mixer->rvoices[v]->cost <= target)
+            {
+                acc_cost += mixer->rvoices[v++]->cost;
+            }
+        }
+
+        b->end_rvoice = v;
+    }
+}
+
+/**
+ * Let the render participants take the slices of the active voices (see
+ * synth.deterministic-render) or the audio groups (see synth.parallel-audio-groups)
+ * one by one instead of splitting the voices into chunks.
+ * Must be called before the participants are woken up.
+ */
+static void
+fluid_mixer_prepare_shared_work(fluid_rvoice_mixer_t *mixer, int participants)
+{
+    int i;
+
+    mixer->active_threads = participants;
+
+    /* leave all chunks empty */
+    for(i = 0; i < participants; i++)
+    {
+        fluid_mixer_buffers_t *b = fluid_mixer_get_participant(mixer, i);
+
+        fluid_atomic_int_set(&b->next_rvoice, 0);
+        b->end_rvoice = 0;
+    }
+
+    fluid_atomic_int_set(&mixer->next_slice, 0);
+    fluid_atomic_int_set(&mixer->mixed_slices, 0);
+    fluid_atomic_int_set(&mixer->next_group, 0);
+}
+
+/**
+ * Render the next unrendered slices into the given buffers until all slices have been
+ * handed out. Each slice is added to the mixer buffers right away, but only after the
+ * slices before it, so that the sum doesn't depend on the number or timing of the threads.
+ * @return TRUE if at least one slice has been rendered
+ */
+static int
+fluid_mixer_buffers_render_slices(fluid_mixer_buffers_t *buffers)
+{
+    fluid_rvoice_mixer_t *mixer = buffers->mixer;
+    int slices = (mixer->active_voices + FLUID_MIXER_SLICE_VOICES - 1) / FLUID_MIXER_SLICE_VOICES;
+    int slice, rendered = FALSE;
+
+    while((slice = fluid_atomic_int_exchange_and_add(&mixer->next_slice, 1)) < slices)
+    {
+        fluid_mixer_buffers_render_slice(buffers, slice, mixer->current_blockcount);
+
+        /* the previous slice has been taken by a participant that is rendering it already */
+        while(fluid_atomic_int_get(&mixer->mixed_slices) != slice)
+        {
+        }
+
+        fluid_mixer_buffers_mix(&mixer->buffers, buffers, mixer->current_blockcount);
+        fluid_atomic_int_set(&mixer->mixed_slices, slice + 1);
+        rendered = TRUE;
+    }
+
+    return rendered;
+}
+
+/* Returns the audio group a voice renders to, from the mapping of its left dry buffer */
+static FLUID_INLINE int
+fluid_mixer_rvoice_group(const fluid_rvoice_t *rvoice)
+{
+    return rvoice->buffers.bufs[0].mapping / 2;
+}
+
+/**
+ * Whether the audio groups can be rendered end-to-end by separate threads this run, see
+ * synth.parallel-audio-groups. Each group must have an fx unit of its own, which only
+ * outputs to that group, and no effect may process several groups together.
+ */
+static int
+fluid_mixer_parallel_groups_usable(const fluid_rvoice_mixer_t *mixer)
+{
+    if(!mixer->parallel_groups || mixer->thread_count == 0 || mixer->buffers.buf_count < 2
+            || mixer->fx_stage != NULL)
+    {
+        return FALSE;
+    }
+
+#ifdef LADSPA
+
+    if(mixer->ladspa_fx != NULL)
+    {
+        return FALSE;
+    }
+
+#endif
+
+    return mixer->fx_units == mixer->buffers.buf_count || (!mixer->with_reverb && !mixer->with_chorus);
+}
+
+/**
+ * Render the next unrendered audio groups until all groups have been handed out. Each
+ * group is rendered end-to-end: its voices are rendered straight into the mixer buffers,
+ * followed by its fx unit and its pair of the limiter. The groups don't share any
+ * buffers, so nothing has to be mixed in afterwards.
+ * @param buffers the buffers of the calling participant, providing its voice buffer and
+ *   its list of finished voices
+ * @return TRUE if at least one group has been rendered
+ */
+static int
+fluid_mixer_buffers_render_groups(fluid_mixer_buffers_t *buffers)
+{
+    fluid_rvoice_mixer_t *mixer = buffers->mixer;
+    fluid_mixer_buffers_t *dest = &mixer->buffers;
+    FLUID_DECLARE_VLA(fluid_real_t *, bufs, dest->buf_count * 2 + dest->fx_buf_count * 2);
+    int bufcount = fluid_mixer_buffers_prepare(dest, bufs);
+    fluid_real_t *local_buf = fluid_align_ptr(buffers->local_buf, FLUID_DEFAULT_ALIGNMENT);
+    int blockcount = mixer->current_blockcount;
+    int group, i, rendered = FALSE;
+
+    while((group = fluid_atomic_int_exchange_and_add(&mixer->next_group, 1)) < dest->buf_count)
+    {
+        for(i = 0; i < mixer->active_voices; i++)
+        {
+            if(fluid_mixer_rvoice_group(mixer->rvoices[i]) == group)
+            {
+                fluid_mixer_buffers_render_voice(buffers, mixer->rvoices[i], bufs, bufcount,
+                                                 dest->live, local_buf, blockcount);
+            }
+        }
+
+        if(mixer->with_reverb || mixer->with_chorus)
+        {
+            fluid_rvoice_mixer_mark_unit_fx_out(mixer, dest, group);
+
+            if(mixer->with_reverb)
+            {
+                fluid_rvoice_mixer_process_reverb(mixer, dest, group, blockcount);
+            }
+
+            if(mixer->with_chorus)
+            {
+                fluid_rvoice_mixer_process_chorus(mixer, dest, group, blockcount);
+            }
+        }
+
+        if(mixer->limiter)
+        {
+            fluid_limiter_run_pair(mixer->limiter, group,
+                                   fluid_align_ptr(dest->left_buf, FLUID_DEFAULT_ALIGNMENT),
+                                   fluid_align_ptr(dest->right_buf, FLUID_DEFAULT_ALIGNMENT),
+                                   FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE, blockcount);
+        }
+
+        rendered = TRUE;
+    }
+
+    return rendered;
+}
+
+/* Take the next voice of a chunk, or NULL if that chunk has been fully handed out */
+static FLUID_INLINE fluid_rvoice_t *
+fluid_mixer_take_rvoice(fluid_rvoice_mixer_t *mixer, fluid_mixer_buffers_t *chunk)
+{
+    int i;
+
+    /* cheap check first, to avoid bouncing the cache line of an exhausted chunk */
+    if(fluid_atomic_int_get(&chunk->next_rvoice) >= chunk->end_rvoice)
+    {
+        return NULL;
+    }
+
+    i = fluid_atomic_int_exchange_and_add(&chunk->next_rvoice, 1);
+
+    if(i >= chunk->end_rvoice)
+    {
+        return NULL;
+    }
+
+    return mixer->rvoices[i];
+}
+
+/**
+ * Get the next voice to render for the given participant: from its own chunk first,
+ * otherwise steal one from the neighbouring chunks.
+ * @return NULL if all voices of this run have been handed out
+ */
+static fluid_rvoice_t *
+fluid_mixer_get_mt_rvoice(fluid_rvoice_mixer_t *mixer, fluid_mixer_buffers_t *buffers)
+{
+    int i, participants = mixer->active_threads;
+    fluid_rvoice_t *rvoice = fluid_mixer_take_rvoice(mixer, buffers);
+
+    for(i = 1; rvoice == NULL && i < participants; i++)
+    {
+        int victim = (buffers->thread_idx + i) % participants;
+        rvoice = fluid_mixer_take_rvoice(mixer, fluid_mixer_get_participant(mixer, victim));
+    }
+
+    return rvoice;
+}
+
+#define THREAD_BUF_PROCESSING 0
+#define THREAD_BUF_VALID 1
+#define THREAD_BUF_NODATA 2
+#define THREAD_BUF_TERMINATE 3
+#define THREAD_BUF_QUEUED 4 /* waiting in the queue of a render pool */
+
+/* Number of polls of a ready flag before a hybrid wait falls back to blocking */
+#define FLUID_MIXER_THREAD_SPIN_COUNT 4096
+
+/* The same for the spin wait, about the time between the render calls of a small audio period:
+ * the threads of a mixer that isn't rendered anymore still go to sleep */
+#define FLUID_MIXER_THREAD_SPIN_COUNT_MAX (64 * FLUID_MIXER_THREAD_SPIN_COUNT)
+
+/**
+ * Busy-wait on a ready flag, as allowed by the configured wait mode.
+ * @param state the flag to poll
+ * @param value the value to wait for; if \c equal is FALSE, wait for the flag to change from this value
+ * @param equal see \c value
+ * @return TRUE if the condition has been met, FALSE if the caller must block
+ */
+static int
+fluid_mixer_spin_wait(fluid_rvoice_mixer_t *mixer, fluid_atomic_int_t *state, int value, int equal)
+{
+    int i, count;
+
+    if(mixer->thread_wait == FLUID_MIXER_THREAD_WAIT_BLOCK)
+    {
+        return FALSE;
+    }
+
+    count = (mixer->thread_wait == FLUID_MIXER_THREAD_WAIT_SPIN)
+            ? FLUID_MIXER_THREAD_SPIN_COUNT_MAX : FLUID_MIXER_THREAD_SPIN_COUNT;
+
+    for(i = 0; i < count; i++)
+    {
+        int j = fluid_atomic_int_get(state);
+
+        if(j == THREAD_BUF_TERMINATE || (j == value) == equal)
+        {
+            return TRUE;
+        }
+
+        fluid_cpu_pause();
+    }
+
+    return FALSE;
+}
+
+/**
+ * Write to all pages of the buffers from the calling thread. With the first-touch
+ * policy of NUMA systems, this places the memory on the node of the thread that
+ * renders into it. The buffers are only allocated, but never touched, beforehand.
+ */
+static void
+fluid_mixer_buffers_first_touch(fluid_mixer_buffers_t *buffers)
+{
+    static const int samplecount = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+
+    FLUID_MEMSET(fluid_align_ptr(buffers->local_buf, FLUID_DEFAULT_ALIGNMENT), 0,
+                 samplecount * sizeof(fluid_real_t));
+    FLUID_MEMSET(fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT), 0,
+                 buffers->buf_count * samplecount * sizeof(fluid_real_t));
+    FLUID_MEMSET(fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT), 0,
+                 buffers->buf_count * samplecount * sizeof(fluid_real_t));
+    FLUID_MEMSET(fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT), 0,
+                 buffers->fx_buf_count * samplecount * sizeof(fluid_real_t));
+    FLUID_MEMSET(fluid_align_ptr(buffers->fx_right_buf, FLUID_DEFAULT_ALIGNMENT), 0,
+                 buffers->fx_buf_count * samplecount * sizeof(fluid_real_t));
+}
+
+/**
+ * Add the buffers of the children of a participant in the binary reduction tree of the
+ * participants to its own: participant p + 2^l for every l below the lowest set bit of p.
+ * Children still rendering are waited for as long as the wait mode allows, all voices have
+ * been handed out by now. The main thread only mixes in its own children and those whose
+ * parent is done without them, see fluid_mixer_mix_in(). So every buffer has a single
+ * consumer at a time and is handed over by a plain store of its ready flag.
+ * @param has_data whether the buffers of the participant hold rendered voices
+ * @return whether they do after mixing in the children
+ */
+static int
+fluid_mixer_buffers_mix_children(fluid_mixer_buffers_t *buffers, int has_data)
+{
+    fluid_rvoice_mixer_t *mixer = buffers->mixer;
+    int idx = buffers->thread_idx;
+    int step;
+
+    for(step = 1; (idx & step) == 0 && idx + step < mixer->active_threads; step <<= 1)
+    {
+        fluid_mixer_buffers_t *child = &mixer->threads[idx + step - 1];
+
+        fluid_mixer_spin_wait(mixer, &child->ready, THREAD_BUF_PROCESSING, FALSE);
+
+        if(fluid_atomic_int_get(&child->ready) != THREAD_BUF_VALID)
+        {
+            continue; /* left to the main thread, or nothing rendered */
+        }
+
+        if(!has_data)
+        {
+            fluid_mixer_buffers_zero(buffers, mixer->current_blockcount);
+            has_data = TRUE;
+        }
+
+        fluid_mixer_buffers_mix(buffers, child, mixer->current_blockcount);
+        fluid_atomic_int_set(&child->ready, THREAD_BUF_NODATA);
+    }
+
+    return has_data;
+}
+
+/**
+ * Render voices into the given participant buffers until no voices are left, then
+ * hand the buffers back to the main thread.
+ */
+static void
+fluid_mixer_buffers_render_run(fluid_mixer_buffers_t *buffers)
+{
+    fluid_rvoice_mixer_t *mixer = buffers->mixer;
+    int hasValidData = 0;
+    FLUID_DECLARE_VLA(fluid_real_t *, bufs, buffers->buf_count * 2 + buffers->fx_buf_count * 2);
+    int bufcount = 0;
+    int current_blockcount = 0;
+    fluid_real_t *local_buf = fluid_align_ptr(buffers->local_buf, FLUID_DEFAULT_ALIGNMENT);
+    fluid_rvoice_t *rvoice;
+    // slices and groups are in the mixer buffers already, there is nothing left to mix in
+    int rendered = FALSE;
+    double perf_ref = fluid_perf_ref(mixer->perf);
+    double trace_ref = fluid_trace_ref();
+
+    if(mixer->groups_active)
+    {
+        rendered = fluid_mixer_buffers_render_groups(buffers);
+    }
+    else if(mixer->slice_buffers != NULL)
+    {
+        rendered = fluid_mixer_buffers_render_slices(buffers);
+    }
+
+    while((rvoice = fluid_mixer_get_mt_rvoice(mixer, buffers)) != NULL)
+    {
+        // if buffer is not zeroed, zero buffers
+        if(!hasValidData)
+        {
+            // blockcount may have changed, since thread was put to sleep
+            current_blockcount = mixer->current_blockcount;
+            fluid_mixer_buffers_zero(buffers, current_blockcount);
+            bufcount = fluid_mixer_buffers_prepare(buffers, bufs);
+            hasValidData = 1;
+        }
+
+        // then render voice to buffers
+        fluid_mixer_buffers_render_voice(buffers, rvoice, bufs, bufcount, buffers->live, local_buf, current_blockcount);
+    }
+
+    if(hasValidData || rendered)
+    {
+        fluid_perf_thread(mixer->perf, buffers->thread_idx, perf_ref, perf_ref != 0.0 ? fluid_perf_now() - perf_ref : 0.0);
+        fluid_trace_span("voices", trace_ref);
+    }
+
+    hasValidData = fluid_mixer_buffers_mix_children(buffers, hasValidData);
+
+    // no more voices: signal rendered buffers
+    fluid_atomic_int_set(&buffers->ready, hasValidData ? THREAD_BUF_VALID : THREAD_BUF_NODATA);
+
+    // only take the mutex if the main thread might be sleeping, it rechecks the flags otherwise
+    if(fluid_atomic_int_get(&mixer->main_sleeping))
+    {
+        fluid_cond_mutex_lock(mixer->thread_ready_m);
+        fluid_cond_signal(mixer->thread_ready);
+        fluid_cond_mutex_unlock(mixer->thread_ready_m);
+    }
+}
+
+/* Let the calling extra thread leave the audio workgroup it joined, if any */
+static void
+fluid_mixer_thread_leave_workgroup(void **membership)
+{
+    if(*membership != NULL)
+    {
+        fluid_thread_self_leave_workgroup(*membership);
+        *membership = NULL;
+    }
+}
+
+/* Let the calling extra thread join mixer->workgroup if it has changed since the thread
+ * last looked at it. Only takes the lock when it has. */
+static void
+fluid_mixer_thread_update_workgroup(fluid_rvoice_mixer_t *mixer, int *serial, void **membership)
+{
+    if(fluid_atomic_int_get(&mixer->workgroup_serial) == *serial)
+    {
+        return;
+    }
+
+    fluid_mutex_lock(mixer->workgroup_m);
+    fluid_mixer_thread_leave_workgroup(membership);
+
+    if(mixer->workgroup != NULL)
+    {
+        fluid_thread_self_join_workgroup(mixer->workgroup, membership);
+    }
+
+    *serial = fluid_atomic_int_get(&mixer->workgroup_serial);
+    fluid_mutex_unlock(mixer->workgroup_m);
+}
+
+/* Switch the calling extra thread to deadline scheduling on its first call, if the mixer uses it */
+static void
+fluid_mixer_thread_check_deadline(fluid_rvoice_mixer_t *mixer, int *checked)
+{
+    if(*checked)
+    {
+        return;
+    }
+
+    *checked = TRUE;
+
+    if(mixer->deadline_period > 0)
+    {
+        fluid_thread_self_set_deadline(mixer->deadline_runtime, mixer->deadline_period);
+    }
+}
+
+/* Core thread function (processes voices in parallel to primary synthesis thread) */
+static fluid_thread_return_t
+fluid_mixer_thread_func(void *data)
+{
+    fluid_mixer_buffers_t *buffers = data;
+    fluid_rvoice_mixer_t *mixer = buffers->mixer;
+    unsigned int fp_mode;
+
+    if(buffers->cpu >= 0 && fluid_thread_self_set_affinity(&buffers->cpu, 1) == FLUID_OK)
+    {
+        fluid_mixer_buffers_first_touch(buffers);
+    }
+
+    while(!fluid_atomic_int_get(&mixer->threads_should_terminate))
+    {
+        // sleep until there is new work. A freshly started thread must not look at the
+        // chunks before it has been woken up, they might still describe a previous
+        // run with a different number of participants.
+        if(fluid_mixer_spin_wait(mixer, &buffers->ready, THREAD_BUF_PROCESSING, TRUE))
+        {
+            fluid_perf_wait(mixer->perf, buffers->thread_idx, FALSE);
+        }
+        else
+        {
+            fluid_perf_wait(mixer->perf, buffers->thread_idx, TRUE);
+            fluid_cond_mutex_lock(mixer->wakeup_threads_m);
+            fluid_atomic_int_inc(&mixer->threads_sleeping);
+
+            while(1)
+            {
+                int j = fluid_atomic_int_get(&buffers->ready);
+
+                if(j == THREAD_BUF_PROCESSING || j == THREAD_BUF_TERMINATE)
+                {
+                    break;
+                }
+
+                fluid_cond_wait(mixer->wakeup_threads, mixer->wakeup_threads_m);
+            }
+
+            fluid_atomic_int_add(&mixer->threads_sleeping, -1);
+            fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+        }
+
+        if(fluid_atomic_int_get(&buffers->ready) == THREAD_BUF_TERMINATE)
+        {
+            break;
+        }
+
+        fluid_mixer_thread_check_deadline(mixer, &buffers->deadline_checked);
+        fluid_mixer_thread_update_workgroup(mixer, &buffers->workgroup_serial, &buffers->workgroup_membership);
+
+        fluid_rt_thread_enter();
+        fp_mode = mixer->flush_denormals ? fluid_denormals_flush_enter() : 0;
+        fluid_mixer_buffers_render_run(buffers);
+
+        if(mixer->flush_denormals)
+        {
+            fluid_denormals_flush_exit(fp_mode);
+        }
+
+        fluid_rt_thread_exit();
+    }
+
+    fluid_mixer_thread_leave_workgroup(&buffers->workgroup_membership);
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/*
+ * Remove a batch from the batches of the pool, if it is still linked. Called with task_m locked.
+ */
+static void
+fluid_render_pool_unlink_batch(fluid_render_pool_t *pool, fluid_render_batch_t *batch)
+{
+    fluid_render_batch_t **prev = &pool->batches;
+
+    while(*prev != NULL && *prev != batch)
+    {
+        prev = &(*prev)->next_batch;
+    }
+
+    if(*prev != NULL)
+    {
+        *prev = batch->next_batch;
+    }
+}
+
+/*
+ * Run the next item of a batch, which must have items left. Called with task_m locked,
+ * which is released while the item runs.
+ */
+static void
+fluid_render_pool_run_item(fluid_render_pool_t *pool, fluid_render_batch_t *batch)
+{
+    int item = batch->next++;
+
+    if(batch->next == batch->count)
+    {
+        fluid_render_pool_unlink_batch(pool, batch);
+    }
+
+    fluid_cond_mutex_unlock(pool->task_m);
+    batch->func(batch->data, item);
+    fluid_cond_mutex_lock(pool->task_m);
+
+    if(++batch->done == batch->count)
+    {
+        fluid_cond_broadcast(pool->task_ready);
+    }
+}
+
+/* Worker thread function of a render pool (processes queued tasks of all attached mixers,
+ * and the items of batches while there are none) */
+static fluid_thread_return_t
+fluid_render_pool_thread_func(void *data)
+{
+    fluid_render_pool_t *pool = data;
+    int idx = fluid_atomic_int_exchange_and_add(&pool->started, 1);
+    unsigned int fp_mode;
+
+    if(pool->cpu_count > 0)
+    {
+        fluid_thread_self_set_affinity(&pool->cpus[idx % pool->cpu_count], 1);
+    }
+
+    if(pool->deadline_period > 0)
+    {
+        fluid_thread_self_set_deadline(pool->deadline_runtime, pool->deadline_period);
+    }
+
+    fluid_cond_mutex_lock(pool->task_m);
+
+    while(!pool->should_terminate)
+    {
+        fluid_mixer_buffers_t *task = pool->head;
+
+        if(task == NULL)
+        {
+            if(pool->batches != NULL)
+            {
+                fluid_render_pool_run_item(pool, pool->batches);
+            }
+            else
+            {
+                fluid_cond_wait(pool->task_ready, pool->task_m);
+            }
+
+            continue;
+        }
+
+        pool->head = task->next_task;
+
+        if(pool->head == NULL)
+        {
+            pool->tail = NULL;
+        }
+
+        // state changes from QUEUED are protected by task_m, see fluid_render_pool_cancel()
+        fluid_atomic_int_set(&task->ready, THREAD_BUF_PROCESSING);
+        task->mixer->pool_tasks_running++;
+        fluid_cond_mutex_unlock(pool->task_m);
+
+        fluid_rt_thread_enter();
+        fp_mode = task->mixer->flush_denormals ? fluid_denormals_flush_enter() : 0;
+        fluid_mixer_buffers_render_run(task);
+
+        if(task->mixer->flush_denormals)
+        {
+            fluid_denormals_flush_exit(fp_mode);
+        }
+
+        fluid_rt_thread_exit();
+
+        // the mixer may only go away once we don't touch it anymore, see fluid_render_pool_detach()
+        fluid_cond_mutex_lock(pool->task_m);
+
+        if(--task->mixer->pool_tasks_running == 0 && task->mixer->pool_detaching)
+        {
+            fluid_cond_broadcast(pool->task_ready);
+        }
+    }
+
+    fluid_cond_mutex_unlock(pool->task_m);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/**
+ * Wait until no worker of the pool accesses the given mixer anymore.
+ * Must not be called while the mixer is rendering.
+ */
+static void
+fluid_render_pool_detach(fluid_render_pool_t *pool, fluid_rvoice_mixer_t *mixer)
+{
+    fluid_cond_mutex_lock(pool->task_m);
+    mixer->pool_detaching = TRUE;
+
+    while(mixer->pool_tasks_running > 0)
+    {
+        fluid_cond_wait(pool->task_ready, pool->task_m);
+    }
+
+    mixer->pool_detaching = FALSE;
+    fluid_cond_mutex_unlock(pool->task_m);
+}
+
+/* Queue the buffers of \c count render participants of a mixer as tasks */
+static void
+fluid_render_pool_submit(fluid_render_pool_t *pool, fluid_mixer_buffers_t *tasks, int count)
+{
+    int i;
+
+    fluid_cond_mutex_lock(pool->task_m);
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_mixer_buffers_t *task = &tasks[i];
+
+        fluid_atomic_int_set(&task->ready, THREAD_BUF_QUEUED);
+        task->next_task = NULL;
+
+        if(pool->tail != NULL)
+        {
+            pool->tail->next_task = task;
+        }
+        else
+        {
+            pool->head = task;
+        }
+
+        pool->tail = task;
+    }
+
+    fluid_cond_broadcast(pool->task_ready);
+    fluid_cond_mutex_unlock(pool->task_m);
+}
+
+/**
+ * Remove all tasks of the given mixer that have not been picked up by a worker yet.
+ * Only to be called once all voices have been handed out, so that these tasks
+ * would not have anything to render anyway.
+ */
+static void
+fluid_render_pool_cancel(fluid_render_pool_t *pool, fluid_rvoice_mixer_t *mixer)
+{
+    fluid_mixer_buffers_t *task, *prev = NULL;
+
+    fluid_cond_mutex_lock(pool->task_m);
+
+    for(task = pool->head; task != NULL; task = task->next_task)
+    {
+        if(task->mixer != mixer)
+        {
+            prev = task;
+            continue;
+        }
+
+        if(prev != NULL)
+        {
+            prev->next_task = task->next_task;
+        }
+        else
+        {
+            pool->head = task->next_task;
+        }
+
+        if(pool->tail == task)
+        {
+            pool->tail = prev;
+        }
+
+        fluid_atomic_int_set(&task->ready, THREAD_BUF_NODATA);
+    }
+
+    fluid_cond_mutex_unlock(pool->task_m);
+}
+
+/* Whether the parent of participant idx in the reduction tree won't mix it in anymore,
+ * see fluid_mixer_buffers_mix_children() */
+static FLUID_INLINE int
+fluid_mixer_parent_done(fluid_rvoice_mixer_t *mixer, int idx)
+{
+    int parent = idx & (idx - 1);
+    int state;
+
+    if(parent == 0)
+    {
+        return TRUE; /* the main thread */
+    }
+
+    state = fluid_atomic_int_get(&mixer->threads[parent - 1].ready);
+    return state != THREAD_BUF_PROCESSING && state != THREAD_BUF_QUEUED;
+}
+
+/**
+ * Go through all threads and see if someone is finished for mixing
+ */
+static int
+fluid_mixer_mix_in(fluid_rvoice_mixer_t *mixer, int extra_threads, int current_blockcount)
+{
+    int i, result, hasmixed;
+
+    do
+    {
+        hasmixed = 0;
+        result = 0;
+
+        for(i = 0; i < extra_threads; i++)
+        {
+            int j = fluid_atomic_int_get(&mixer->threads[i].ready);
+
+            switch(j)
+            {
+            case THREAD_BUF_PROCESSING:
+            case THREAD_BUF_QUEUED:
+                result = 1;
+                break;
+
+            case THREAD_BUF_VALID:
+                if(!fluid_mixer_parent_done(mixer, i + 1))
+                {
+                    result = 1; /* its parent may still mix it in */
+                    break;
+                }
+
+                fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_NODATA);
+                fluid_mixer_buffers_mix(&mixer->buffers, &mixer->threads[i], current_blockcount);
+                hasmixed = 1;
+                break;
+            }
+        }
+    }
+    while(hasmixed);
+
+    return result;
+}
+
+static void
+fluid_render_loop_multithread(fluid_rvoice_mixer_t *mixer, int current_blockcount)
+{
+    int i, bufcount;
+    fluid_real_t *local_buf = fluid_align_ptr(mixer->buffers.local_buf, FLUID_DEFAULT_ALIGNMENT);
+    // time the main thread spent rendering voices, excluding mixing and waiting
+    double perf_ref, perf_busy = 0.0;
+    double trace_ref;
+
+    FLUID_DECLARE_VLA(fluid_real_t *, bufs,
+                      mixer->buffers.buf_count * 2 + mixer->buffers.fx_buf_count * 2);
+    // How many threads should we start this time? One per audio group if rendered in parallel
+    int extra_threads = mixer->groups_active ? mixer->buffers.buf_count - 1
+                        : mixer->active_voices / VOICES_PER_THREAD;
+
+    if(extra_threads > mixer->thread_count)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return 0;
+        extra_threads = mixer->thread_count;
     }
 
-    buffers->finished_voices = NULL;
+    if(extra_threads == 0)
+    {
+        // No extra threads? No thread overhead!
+        fluid_render_loop_singlethread(mixer, current_blockcount);
+        return;
+    }
 
-    if(fluid_mixer_buffers_update_polyphony(buffers, mixer->polyphony)
-            == FLUID_FAILED)
+    perf_ref = fluid_perf_ref(mixer->perf);
+    trace_ref = fluid_trace_ref();
+    bufcount = fluid_mixer_buffers_prepare(&mixer->buffers, bufs);
+
+    // Prepare voice list
+    fluid_cond_mutex_lock(mixer->wakeup_threads_m);
+
+    if(mixer->groups_active || mixer->slice_buffers != NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return 0;
+        fluid_mixer_prepare_shared_work(mixer, extra_threads + 1);
+    }
+    else
+    {
+        fluid_mixer_partition_rvoices(mixer, extra_threads + 1);
     }
 
-    return 1;
-}
+    if(mixer->pool != NULL)
+    {
+        // Hand our participants over to the workers of the pool
+        fluid_render_pool_submit(mixer->pool, mixer->threads, extra_threads);
+    }
+    else
+    {
+        for(i = 0; i < extra_threads; i++)
+        {
+            fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_PROCESSING);
+        }
 
-/**
- * Note: Not hard realtime capable (calls malloc)
- */
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_samplerate)
-{
-    fluid_rvoice_mixer_t *mixer = obj;
-    fluid_real_t samplerate = param[1].real; // because fluid_synth_update_mixer() puts real into arg2
+        // Signal threads to wake up, spinning threads will notice the flag by themselves
+        if(fluid_atomic_int_get(&mixer->threads_sleeping) > 0)
+        {
+            fluid_cond_broadcast(mixer->wakeup_threads);
+        }
+    }
 
-    int i;
+    fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
 
-    for(i = 0; i < mixer->fx_units; i++)
+    if(mixer->groups_active || mixer->slice_buffers != NULL)
     {
-        if(mixer->fx[i].chorus)
+        double slices_ref = (perf_ref != 0.0) ? fluid_perf_now() : 0.0;
+
+        if(mixer->groups_active)
+        {
+            fluid_mixer_buffers_render_groups(&mixer->buffers);
+        }
+        else
         {
-            fluid_chorus_samplerate_change(mixer->fx[i].chorus, samplerate);
+            fluid_mixer_buffers_render_slices(mixer->slice_buffers);
         }
 
-        if(mixer->fx[i].reverb)
+        if(slices_ref != 0.0)
         {
-            fluid_revmodel_samplerate_change(mixer->fx[i].reverb, samplerate);
+            perf_busy += fluid_perf_now() - slices_ref;
+        }
+    }
 
-            /*
-              fluid_revmodel_samplerate_change() shouldn't fail if the reverb was created
-              with sample_rate_max set to the maximum sample rate indicated in the settings.
-              If this condition isn't respected, the reverb will continue to work but with
-              lost of quality.
-            */
+    // If thread is finished, mix it in
+    while(fluid_mixer_mix_in(mixer, extra_threads, current_blockcount))
+    {
+        // Otherwise get a voice and render it
+        fluid_rvoice_t *rvoice = fluid_mixer_get_mt_rvoice(mixer, &mixer->buffers);
+
+        if(rvoice != NULL)
+        {
+            double voice_ref = (perf_ref != 0.0) ? fluid_perf_now() : 0.0;
+            fluid_profile_ref_var(prof_ref);
+            fluid_mixer_buffers_render_voice(&mixer->buffers, rvoice, bufs, bufcount, mixer->buffers.live,
+                                             local_buf, current_blockcount);
+            fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, 1,
+                          current_blockcount * FLUID_BUFSIZE);
+
+            if(voice_ref != 0.0)
+            {
+                perf_busy += fluid_perf_now() - voice_ref;
+            }
+            //test++;
+        }
+        else
+        {
+            // If no voices, wait for mixes. Make sure one is still processing to avoid deadlock
+            int is_processing = 0;
+
+            // tasks not picked up by a pool worker yet would find nothing to render, don't wait for them
+            if(mixer->pool != NULL)
+            {
+                fluid_render_pool_cancel(mixer->pool, mixer);
+            }
+
+            // spin on the first thread still processing, fluid_mixer_mix_in() will pick up any other
+            for(i = 0; i < extra_threads; i++)
+            {
+                if(fluid_atomic_int_get(&mixer->threads[i].ready) == THREAD_BUF_PROCESSING)
+                {
+                    break;
+                }
+            }
+
+            if(i == extra_threads)
+            {
+                continue;
+            }
+
+            if(fluid_mixer_spin_wait(mixer, &mixer->threads[i].ready, THREAD_BUF_PROCESSING, FALSE))
+            {
+                fluid_perf_wait(mixer->perf, 0, FALSE);
+                continue;
+            }
+
+            fluid_perf_wait(mixer->perf, 0, TRUE);
+            fluid_cond_mutex_lock(mixer->thread_ready_m);
+            fluid_atomic_int_set(&mixer->main_sleeping, TRUE);
+
+            for(i = 0; i < extra_threads; i++)
+            {
+                if(fluid_atomic_int_get(&mixer->threads[i].ready) ==
+                        THREAD_BUF_PROCESSING)
+                {
+                    is_processing = 1;
+                }
+            }
+
+            if(is_processing)
+            {
+                fluid_cond_wait(mixer->thread_ready, mixer->thread_ready_m);
+            }
+
+            fluid_atomic_int_set(&mixer->main_sleeping, FALSE);
+            fluid_cond_mutex_unlock(mixer->thread_ready_m);
         }
     }
 
-#ifdef LIMITER_SUPPORT
-    if(mixer->limiter != NULL)
+    fluid_perf_thread(mixer->perf, 0, perf_ref, perf_busy);
+    fluid_trace_span("voices", trace_ref);
+
+    //FLUID_LOG(FLUID_DBG, "Blockcount: %d, mixed %d of %d voices myself, waits = %d",
+    //	    current_blockcount, test, mixer->active_voices, waits);
+}
+
+/* Stops the extra threads, their buffers are left to the caller */
+static void fluid_rvoice_mixer_stop_threads(fluid_rvoice_mixer_t *mixer)
+{
+    int i;
+
+    // if no threads have been created yet (e.g. because a previous error prevented creation of threads
+    // mutexes and condition variables), skip terminating threads
+    if(mixer->thread_count != 0)
     {
-        fluid_limiter_samplerate_change(mixer->limiter, samplerate);
+        if(mixer->pool != NULL)
+        {
+            // pool workers might still be finishing up with our buffers
+            fluid_render_pool_detach(mixer->pool, mixer);
+        }
+
+        fluid_atomic_int_set(&mixer->threads_should_terminate, 1);
+        // Signal threads to wake up
+        fluid_cond_mutex_lock(mixer->wakeup_threads_m);
+
+        for(i = 0; i < mixer->thread_count; i++)
+        {
+            fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_TERMINATE);
+        }
+
+        fluid_cond_broadcast(mixer->wakeup_threads);
+        fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+
+        for(i = 0; i < mixer->thread_count; i++)
+        {
+            if(mixer->threads[i].thread)
+            {
+                fluid_thread_join(mixer->threads[i].thread);
+            }
+        }
     }
-#endif
+}
 
-#if LADSPA
+/* Frees the buffers of stopped threads along with their array */
+static void delete_fluid_mixer_threads(fluid_mixer_buffers_t *threads, int thread_count)
+{
+    int i;
 
-    if(mixer->ladspa_fx != NULL)
+    for(i = 0; i < thread_count; i++)
     {
-        fluid_ladspa_set_sample_rate(mixer->ladspa_fx, samplerate);
+        if(threads[i].thread)
+        {
+            delete_fluid_thread(threads[i].thread);
+        }
+
+        fluid_mixer_buffers_free(&threads[i]);
     }
 
-#endif
+    FLUID_FREE(threads);
 }
 
+static void delete_rvoice_mixer_threads(fluid_rvoice_mixer_t *mixer)
+{
+    fluid_rvoice_mixer_stop_threads(mixer);
+    delete_fluid_mixer_threads(mixer->threads, mixer->thread_count);
+
+    mixer->thread_count = 0;
+    mixer->threads = NULL;
+}
 
 /**
- * @param buf_count number of primary stereo buffers
- * @param fx_buf_count number of stereo effect buffers
+ * Allocate the buffers of extra mixer threads, without starting them.
+ * @param thread_count Number of extra mixer threads for multi-core rendering
+ * @param polyphony Length of the finished voices arrays
  */
-fluid_rvoice_mixer_t *
-new_fluid_rvoice_mixer(int buf_count, int fx_buf_count, int fx_units,
-                       fluid_real_t sample_rate_max,
-                       fluid_real_t sample_rate,
-                       fluid_rvoice_eventhandler_t *evthandler,
-                       int extra_threads, int prio)
+static fluid_mixer_buffers_t *
+new_fluid_mixer_threads(fluid_rvoice_mixer_t *mixer, int thread_count, int polyphony)
 {
+    fluid_mixer_buffers_t *threads;
     int i;
-    fluid_rvoice_mixer_t *mixer = FLUID_NEW(fluid_rvoice_mixer_t);
-
-    if(mixer == NULL)
-    {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return NULL;
-    }
-
-    FLUID_MEMSET(mixer, 0, sizeof(fluid_rvoice_mixer_t));
-    mixer->eventhandler = evthandler;
-    mixer->fx_units = fx_units;
-    mixer->buffers.buf_count = buf_count;
-    mixer->buffers.fx_buf_count = fx_buf_count * fx_units;
 
-    /* allocate the reverb module */
-    mixer->fx = FLUID_ARRAY(fluid_mixer_fx_t, fx_units);
+    threads = FLUID_ARRAY(fluid_mixer_buffers_t, thread_count);
 
-    if(mixer->fx == NULL)
+    if(threads == NULL)
     {
         FLUID_LOG(FLUID_ERR, "Out of memory");
-        goto error_recovery;
+        return NULL;
     }
 
-    FLUID_MEMSET(mixer->fx, 0, fx_units * sizeof(*mixer->fx));
+    FLUID_MEMSET(threads, 0, thread_count * sizeof(fluid_mixer_buffers_t));
 
-    for(i = 0; i < fx_units; i++)
+    for(i = 0; i < thread_count; i++)
     {
-        /* create reverb and chorus units */
-        mixer->fx[i].reverb = new_fluid_revmodel(sample_rate_max, sample_rate);
-        mixer->fx[i].chorus = new_fluid_chorus(sample_rate);
+        fluid_mixer_buffers_t *b = &threads[i];
 
-        if(mixer->fx[i].reverb == NULL || mixer->fx[i].chorus == NULL)
+        if(!fluid_mixer_buffers_init(b, mixer, polyphony))
         {
-            FLUID_LOG(FLUID_ERR, "Out of memory");
-            goto error_recovery;
+            delete_fluid_mixer_threads(threads, i + 1);
+            return NULL;
         }
+
+        fluid_atomic_int_set(&b->ready, THREAD_BUF_NODATA);
+        b->thread_idx = i + 1;
+        b->cpu = (mixer->cpu_count > 0) ? mixer->cpus[i % mixer->cpu_count] : -1;
     }
 
-    if(!fluid_mixer_buffers_init(&mixer->buffers, mixer))
+    return threads;
+}
+
+/**
+ * Start the extra mixer threads of mixer->threads. Nothing to do when attached to a
+ * render pool, the buffers are rendered by the workers of the pool then.
+ * @param prio_level realtime prio level for the extra mixer threads
+ */
+static int fluid_rvoice_mixer_start_threads(fluid_rvoice_mixer_t *mixer, int prio_level)
+{
+    char name[16];
+    int i;
+
+    fluid_atomic_int_set(&mixer->threads_should_terminate, 0);
+
+    if(mixer->pool != NULL)
     {
-        goto error_recovery;
+        return FLUID_OK;
     }
 
-#if ENABLE_MIXER_THREADS
-    mixer->thread_ready = new_fluid_cond();
-    mixer->wakeup_threads = new_fluid_cond();
-    mixer->thread_ready_m = new_fluid_cond_mutex();
-    mixer->wakeup_threads_m = new_fluid_cond_mutex();
-
-    if(!mixer->thread_ready || !mixer->wakeup_threads ||
-            !mixer->thread_ready_m || !mixer->wakeup_threads_m)
+    for(i = 0; i < mixer->thread_count; i++)
     {
-        goto error_recovery;
+        fluid_mixer_buffers_t *b = &mixer->threads[i];
+
+        FLUID_SNPRINTF(name, sizeof(name), "mixer%d", i);
+        b->thread = new_fluid_thread(name, fluid_mixer_thread_func, b, prio_level, 0);
+
+        if(!b->thread)
+        {
+            return FLUID_FAILED;
+        }
     }
 
-    if(fluid_rvoice_mixer_set_threads(mixer, extra_threads, prio) != FLUID_OK)
+    return FLUID_OK;
+}
+
+/**
+ * Set up the extra mixer threads of a new mixer.
+ * @param thread_count Number of extra mixer threads for multi-core rendering
+ * @param prio_level realtime prio level for the extra mixer threads
+ */
+static int fluid_rvoice_mixer_set_threads(fluid_rvoice_mixer_t *mixer, int thread_count, int prio_level)
+{
+    mixer->queued_thread_count = thread_count;
+
+    if(thread_count == 0)
     {
-        goto error_recovery;
+        return FLUID_OK;
     }
 
-#endif
+    mixer->threads = new_fluid_mixer_threads(mixer, thread_count, mixer->polyphony);
 
-    return mixer;
+    if(mixer->threads == NULL)
+    {
+        return FLUID_FAILED;
+    }
 
-error_recovery:
-    delete_fluid_rvoice_mixer(mixer);
-    return NULL;
+    mixer->thread_count = thread_count;
+    return fluid_rvoice_mixer_start_threads(mixer, prio_level);
 }
 
-static void
-fluid_mixer_buffers_free(fluid_mixer_buffers_t *buffers)
+/* Effects thread function (processes the effects of the previous run in parallel to the voices) */
+static fluid_thread_return_t
+fluid_mixer_fx_thread_func(void *data)
 {
-    FLUID_FREE(buffers->finished_voices);
+    fluid_rvoice_mixer_t *mixer = data;
+    unsigned int fp_mode;
 
-    /* free all the sample buffers */
-    FLUID_FREE(buffers->local_buf);
-    FLUID_FREE(buffers->left_buf);
-    FLUID_FREE(buffers->right_buf);
-    FLUID_FREE(buffers->fx_left_buf);
-    FLUID_FREE(buffers->fx_right_buf);
-}
+    fluid_cond_mutex_lock(mixer->fx_stage_m);
 
-void delete_fluid_rvoice_mixer(fluid_rvoice_mixer_t *mixer)
-{
-    int i;
+    while(1)
+    {
+        while(mixer->fx_stage_state == FX_STAGE_IDLE)
+        {
+            fluid_cond_wait(mixer->fx_stage_cond, mixer->fx_stage_m);
+        }
 
-    fluid_return_if_fail(mixer != NULL);
+        if(mixer->fx_stage_state == FX_STAGE_TERMINATE)
+        {
+            break;
+        }
 
-#if ENABLE_MIXER_THREADS
-    delete_rvoice_mixer_threads(mixer);
+        fluid_cond_mutex_unlock(mixer->fx_stage_m);
+        fluid_mixer_thread_check_deadline(mixer, &mixer->fx_deadline_checked);
+        fluid_mixer_thread_update_workgroup(mixer, &mixer->fx_workgroup_serial, &mixer->fx_workgroup_membership);
 
-    if(mixer->thread_ready)
-    {
-        delete_fluid_cond(mixer->thread_ready);
+        fluid_rt_thread_enter();
+        fp_mode = mixer->flush_denormals ? fluid_denormals_flush_enter() : 0;
+        fluid_rvoice_mixer_process_fx(mixer, mixer->fx_stage, mixer->fx_stage_blockcount);
+
+        if(mixer->flush_denormals)
+        {
+            fluid_denormals_flush_exit(fp_mode);
+        }
+
+        fluid_rt_thread_exit();
+        fluid_cond_mutex_lock(mixer->fx_stage_m);
+
+        mixer->fx_stage_state = FX_STAGE_IDLE;
+        fluid_cond_broadcast(mixer->fx_stage_cond);
     }
 
-    if(mixer->wakeup_threads)
+    fluid_cond_mutex_unlock(mixer->fx_stage_m);
+    fluid_mixer_thread_leave_workgroup(&mixer->fx_workgroup_membership);
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+static void delete_rvoice_mixer_fx_stage(fluid_rvoice_mixer_t *mixer)
+{
+    if(mixer->fx_thread != NULL)
     {
-        delete_fluid_cond(mixer->wakeup_threads);
+        fluid_cond_mutex_lock(mixer->fx_stage_m);
+        mixer->fx_stage_state = FX_STAGE_TERMINATE;
+        fluid_cond_broadcast(mixer->fx_stage_cond);
+        fluid_cond_mutex_unlock(mixer->fx_stage_m);
+
+        fluid_thread_join(mixer->fx_thread);
+        delete_fluid_thread(mixer->fx_thread);
+        mixer->fx_thread = NULL;
     }
 
-    if(mixer->thread_ready_m)
+    if(mixer->fx_stage != NULL)
     {
-        delete_fluid_cond_mutex(mixer->thread_ready_m);
+        fluid_mixer_buffers_free(mixer->fx_stage);
+        FLUID_FREE(mixer->fx_stage);
+        mixer->fx_stage = NULL;
     }
 
-    if(mixer->wakeup_threads_m)
+    if(mixer->fx_stage_cond)
     {
-        delete_fluid_cond_mutex(mixer->wakeup_threads_m);
+        delete_fluid_cond(mixer->fx_stage_cond);
+        mixer->fx_stage_cond = NULL;
     }
 
-#endif
-    fluid_mixer_buffers_free(&mixer->buffers);
-
-#ifdef LIMITER_SUPPORT
-    if(mixer->limiter)
+    if(mixer->fx_stage_m)
     {
-        delete_fluid_limiter(mixer->limiter);
+        delete_fluid_cond_mutex(mixer->fx_stage_m);
+        mixer->fx_stage_m = NULL;
     }
-#endif
+}
 
-    for(i = 0; i < mixer->fx_units; i++)
+/*
+ * Swaps the first count samples of each of the channels of two buffer arrays, skipping
+ * the channels that are silent in both. The live flag of channel i is live_x[i * live_stride].
+ */
+static void
+fluid_mixer_swap_bufs(fluid_real_t *a, fluid_real_t *b, int channels, int count,
+                      const unsigned char *live_a, const unsigned char *live_b, int live_stride)
+{
+    fluid_real_t *FLUID_RESTRICT buf_a = fluid_align_ptr(a, FLUID_DEFAULT_ALIGNMENT);
+    fluid_real_t *FLUID_RESTRICT buf_b = fluid_align_ptr(b, FLUID_DEFAULT_ALIGNMENT);
+    fluid_real_t tmp;
+    int i, j;
+
+    for(i = 0; i < channels; i++, buf_a += FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE,
+            buf_b += FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE)
     {
-        if(mixer->fx[i].reverb)
+        if(!live_a[i * live_stride] && !live_b[i * live_stride])
         {
-            delete_fluid_revmodel(mixer->fx[i].reverb);
+            continue;
         }
 
-        if(mixer->fx[i].chorus)
+        #pragma omp simd private(tmp)
+        for(j = 0; j < count; j++)
         {
-            delete_fluid_chorus(mixer->fx[i].chorus);
+            tmp = buf_a[j];
+            buf_a[j] = buf_b[j];
+            buf_b[j] = tmp;
         }
     }
-
-    FLUID_FREE(mixer->fx);
-    FLUID_FREE(mixer->rvoices);
-    FLUID_FREE(mixer);
 }
 
-#ifdef LADSPA
-/**
- * Set a LADSPS fx instance to be used by the mixer and assign the mixer buffers
- * as LADSPA host buffers with sensible names */
-void fluid_rvoice_mixer_set_ladspa(fluid_rvoice_mixer_t *mixer,
-                                   fluid_ladspa_fx_t *ladspa_fx, int audio_groups)
+/* Hands the voices just rendered to the effects stage, in exchange for the effects of the previous run */
+static void
+fluid_mixer_buffers_swap(fluid_mixer_buffers_t *a, fluid_mixer_buffers_t *b, int blockcount)
 {
-    mixer->ladspa_fx = ladspa_fx;
-
-    if(ladspa_fx == NULL)
+    int count = blockcount * FLUID_BUFSIZE;
+    int fx_offset = a->buf_count * 2;
+    int i, live_blockcount = a->live_blockcount;
+
+    fluid_mixer_swap_bufs(a->left_buf, b->left_buf, a->buf_count, count, a->live, b->live, 2);
+    fluid_mixer_swap_bufs(a->right_buf, b->right_buf, a->buf_count, count, &a->live[1], &b->live[1], 2);
+    fluid_mixer_swap_bufs(a->fx_left_buf, b->fx_left_buf, a->fx_buf_count, count,
+                          &a->live[fx_offset], &b->live[fx_offset], 1);
+    fluid_mixer_swap_bufs(a->fx_right_buf, b->fx_right_buf, a->fx_buf_count, count,
+                          &a->live[fx_offset], &b->live[fx_offset], 1);
+
+    /* the live flags follow the audio */
+    for(i = 0; i < fx_offset + a->fx_buf_count; i++)
     {
-        return;
+        unsigned char live = a->live[i];
+        a->live[i] = b->live[i];
+        b->live[i] = live;
     }
-    else
-    {
-        fluid_real_t *main_l = fluid_align_ptr(mixer->buffers.left_buf, FLUID_DEFAULT_ALIGNMENT);
-        fluid_real_t *main_r = fluid_align_ptr(mixer->buffers.right_buf, FLUID_DEFAULT_ALIGNMENT);
 
-        fluid_real_t *rev = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-        fluid_real_t *chor = rev;
+    a->live_blockcount = b->live_blockcount;
+    b->live_blockcount = live_blockcount;
+}
 
-        rev = &rev[SYNTH_REVERB_CHANNEL * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
-        chor = &chor[SYNTH_CHORUS_CHANNEL * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT];
+/* Wakes up the effects thread to process the blocks rendered by the previous run */
+static void
+fluid_rvoice_mixer_fx_stage_start(fluid_rvoice_mixer_t *mixer, int blockcount)
+{
+    if(mixer->fx_stage_blockcount == 0)
+    {
+        // very first run, there is nothing to process yet
+        return;
+    }
 
-        fluid_ladspa_add_host_ports(ladspa_fx, "Main:L", audio_groups,
-                                    main_l,
-                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+    fluid_cond_mutex_lock(mixer->fx_stage_m);
+    mixer->fx_stage_state = FX_STAGE_PROCESSING;
+    fluid_cond_signal(mixer->fx_stage_cond);
+    fluid_cond_mutex_unlock(mixer->fx_stage_m);
+}
 
-        fluid_ladspa_add_host_ports(ladspa_fx, "Main:R", audio_groups,
-                                    main_r,
-                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+/*
+ * Waits for the effects thread and swaps the buffers, so that the output buffers contain
+ * the finished blocks of the previous run and the effects stage the voices of this one.
+ * @return number of blocks in the output buffers
+ */
+static int
+fluid_rvoice_mixer_fx_stage_finish(fluid_rvoice_mixer_t *mixer, int blockcount)
+{
+    // the very first run outputs the silence the effects stage has been created with
+    int done = (mixer->fx_stage_blockcount > 0) ? mixer->fx_stage_blockcount : blockcount;
 
-        fluid_ladspa_add_host_ports(ladspa_fx, "Reverb:Send", 1,
-                                    rev,
-                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+    fluid_cond_mutex_lock(mixer->fx_stage_m);
 
-        fluid_ladspa_add_host_ports(ladspa_fx, "Chorus:Send", 1,
-                                    chor,
-                                    FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+    while(mixer->fx_stage_state == FX_STAGE_PROCESSING)
+    {
+        fluid_cond_wait(mixer->fx_stage_cond, mixer->fx_stage_m);
     }
-}
-#endif
 
-#ifdef LIMITER_SUPPORT
-int fluid_rvoice_mixer_set_limiter(fluid_rvoice_mixer_t *mixer, fluid_real_t sample_rate, fluid_limiter_settings_t* settings)
-{
-    mixer->limiter = new_fluid_limiter(sample_rate, settings);
+    fluid_cond_mutex_unlock(mixer->fx_stage_m);
 
-    return mixer->limiter != NULL;
+    fluid_mixer_buffers_swap(&mixer->buffers, mixer->fx_stage, (done > blockcount) ? done : blockcount);
+    mixer->fx_stage_blockcount = blockcount;
+
+    return done;
 }
-#endif /* LIMITER_SUPPORT */
+#endif
 
 /**
- * set one or more reverb shadow parameters for one fx group.
- * These parameters will be returned if queried.
- * (see fluid_rvoice_mixer_reverb_get_param())
- *
- * @param mixer that contains all fx units.
- * @param fx_group index of the fx group to which parameters must be set.
- *  must be in the range [-1..mixer->fx_units[. If -1 the changes are applied to
- *  all fx units.
- * @param set Flags indicating which parameters should be set (#fluid_revmodel_set_t)
- * @param values table of parameters values.
+ * Process the effects on a dedicated thread, one run behind the voices.
+ * Must be called before fluid_rvoice_mixer_set_ladspa().
+ * @param prio_level realtime prio level for the effects thread
  */
-void
-fluid_rvoice_mixer_set_reverb_full(const fluid_rvoice_mixer_t *mixer,
-                                   int fx_group, int set, const double values[])
+int fluid_rvoice_mixer_set_fx_pipeline(fluid_rvoice_mixer_t *mixer, int prio_level)
 {
-    fluid_mixer_fx_t *fx = mixer->fx;
-    int nr_units = mixer->fx_units;
+#if ENABLE_MIXER_THREADS
+    static const int samplecount = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+    fluid_mixer_buffers_t *buffers;
 
-    if(fx_group >= 0) /* apply parameters to this fx group only */
+    fluid_return_val_if_fail(mixer->fx_stage == NULL, FLUID_FAILED);
+
+    buffers = mixer->fx_stage = FLUID_NEW(fluid_mixer_buffers_t);
+
+    if(buffers == NULL)
     {
-        nr_units = fx_group + 1;
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
     }
-    else /* apply parameters to all fx groups */
+
+    FLUID_MEMSET(buffers, 0, sizeof(*buffers));
+    buffers->mixer = mixer;
+    buffers->buf_count = mixer->buffers.buf_count;
+    buffers->fx_buf_count = mixer->buffers.fx_buf_count;
+
+    /* the stage only holds audio, the voices are never rendered into it */
+    buffers->left_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+    buffers->right_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+    buffers->fx_left_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->fx_buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+    buffers->fx_right_buf = FLUID_ARRAY_ALIGNED(fluid_real_t, buffers->fx_buf_count * samplecount, FLUID_DEFAULT_ALIGNMENT);
+    mixer->fx_stage_cond = new_fluid_cond();
+    mixer->fx_stage_m = new_fluid_cond_mutex();
+
+    if(buffers->left_buf == NULL || buffers->right_buf == NULL || buffers->fx_left_buf == NULL
+            || buffers->fx_right_buf == NULL || !fluid_mixer_buffers_init_live(buffers)
+            || mixer->fx_stage_cond == NULL || mixer->fx_stage_m == NULL)
     {
-        fx_group = 0;
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_rvoice_mixer_fx_stage(mixer);
+        return FLUID_FAILED;
     }
 
-    for(; fx_group < nr_units; fx_group++)
-    {
-        int param;
+    fluid_mixer_buffers_zero(buffers, FLUID_MIXER_MAX_BUFFERS_DEFAULT);
+    mixer->fx_stage_state = FX_STAGE_IDLE;
+    mixer->fx_stage_blockcount = 0;
 
-        for(param = 0; param < FLUID_REVERB_PARAM_LAST; param++)
-        {
-            if(set & FLUID_REVPARAM_TO_SETFLAG(param))
-            {
-                fx[fx_group].reverb_param[param] = values[param];
-            }
-        }
+    mixer->fx_thread = new_fluid_thread("mixer-fx", fluid_mixer_fx_thread_func, mixer, prio_level, 0);
+
+    if(mixer->fx_thread == NULL)
+    {
+        delete_rvoice_mixer_fx_stage(mixer);
+        return FLUID_FAILED;
     }
+
+    return FLUID_OK;
+#else
+    FLUID_LOG(FLUID_WARN, "FluidSynth has been compiled without multi-threading support, synth.fx-pipeline has no effect");
+    return FLUID_OK;
+#endif
 }
 
 /**
- * get one reverb shadow parameter for one fx group.
- * (see fluid_rvoice_mixer_set_reverb_full())
- *
- * @param mixer that contains all fx group units.
- * @param fx_group index of the fx group to get parameter from.
- *  must be in the range [0..mixer->fx_units[.
- * @param enum indicating the parameter to get.
- *  FLUID_REVERB_ROOMSIZE, reverb room size value.
- *  FLUID_REVERB_DAMP, reverb damping value.
- *  FLUID_REVERB_WIDTH, reverb width value.
- *  FLUID_REVERB_LEVEL, reverb level value.
- * @return value.
+ * Let the mixer time its render stages into the statistics of the synth, see synth.perf-stats.
+ * Must be called before rendering.
  */
-double
-fluid_rvoice_mixer_reverb_get_param(const fluid_rvoice_mixer_t *mixer,
-                                    int fx_group, int param)
+void fluid_rvoice_mixer_set_perf(fluid_rvoice_mixer_t *mixer, fluid_perf_t *perf)
 {
-    return mixer->fx[fx_group].reverb_param[param];
+    mixer->perf = perf;
 }
 
 /**
- * set one or more chorus shadow parameters for one fx group.
- * These parameters will be returned if queried.
- * (see fluid_rvoice_mixer_chorus_get_param())
- *
- * @param mixer that contains all fx units.
- * @param fx_group index of the fx group to which parameters must be set.
- *  must be in the range [-1..mixer->fx_units[. If -1 the changes are applied
- *  to all fx group.
- * Keep in mind, that the needed CPU time is proportional to 'nr'.
- * @param set Flags indicating which parameters to set (#fluid_chorus_set_t)
- * @param values table of pararameters.
+ * Let the mixer publish the state of its voices after every render call, see synth.voice-snapshot.
+ * Must be called before rendering.
  */
-void
-fluid_rvoice_mixer_set_chorus_full(const fluid_rvoice_mixer_t *mixer,
-                                   int fx_group, int set, const double values[])
+void fluid_rvoice_mixer_set_voice_snapshot(fluid_rvoice_mixer_t *mixer, fluid_voice_snapshot_t *snapshot)
 {
-    fluid_mixer_fx_t *fx = mixer->fx;
-    int nr_units = mixer->fx_units;
-
-    if(fx_group >= 0) /* apply parameters to this group fx only */
-    {
-        nr_units = fx_group + 1;
-    }
-    else /* apply parameters to all fx units*/
-    {
-        fx_group = 0;
-    }
-
-    for(; fx_group < nr_units; fx_group++)
-    {
-        int param;
-
-        for(param = 0; param < FLUID_CHORUS_PARAM_LAST; param++)
-        {
-            if(set & FLUID_CHORPARAM_TO_SETFLAG(param))
-            {
-                fx[fx_group].chorus_param[param] = values[param];
-            }
-        }
-    }
+    mixer->voice_snapshot = snapshot;
 }
 
 /**
- * get one chorus shadow parameter for one fx group.
- * (see fluid_rvoice_mixer_set_chorus_full())
- *
- * @param mixer that contains all fx groups units.
- * @param fx_group index of the fx group to get parameter from.
- *  must be in the range [0..mixer->fx_units[.
- * @param get Flags indicating which parameter to get (#fluid_chorus_set_t)
- * @return the parameter value (0.0 is returned if error)
+ * Let the mixer meter the levels of the MIDI channels, audio groups and effects buffers,
+ * see synth.metering. Must be called before rendering.
  */
-double
-fluid_rvoice_mixer_chorus_get_param(const fluid_rvoice_mixer_t *mixer,
-                                    int fx_group, int param)
+void fluid_rvoice_mixer_set_meter(fluid_rvoice_mixer_t *mixer, fluid_meter_t *meter)
 {
-    return mixer->fx[fx_group].chorus_param[param];
+    mixer->meter = meter;
 }
 
-/* @deprecated: use fluid_rvoice_mixer_reverb_enable instead */
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_reverb_enabled)
+/**
+ * Let the extra mixer threads and the fx thread use deadline scheduling instead of
+ * the realtime priority they have been created with, see audio.realtime-deadline.
+ * The threads switch when they're woken up for the first time, so this must be called
+ * before rendering. A thread keeps its realtime priority if the switch fails.
+ * @param runtime_us CPU time reserved per period for each thread in microseconds
+ * @param period_us period in microseconds, 0 to keep the realtime priority
+ */
+void fluid_rvoice_mixer_set_deadline(fluid_rvoice_mixer_t *mixer, int runtime_us, int period_us)
 {
-    fluid_rvoice_mixer_t *mixer = obj;
-    int on = param[0].i;
-
-    mixer->with_reverb = on;
+#if ENABLE_MIXER_THREADS
+    mixer->deadline_runtime = runtime_us;
+    mixer->deadline_period = period_us;
+#endif
 }
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reverb_enable)
+/**
+ * Let the extra mixer threads, the fx thread and the workers of a render pool flush
+ * denormal numbers to zero while they render for this mixer, like the synthesis thread
+ * does, see synth.flush-denormals. Must be called before rendering.
+ */
+void fluid_rvoice_mixer_set_flush_denormals(fluid_rvoice_mixer_t *mixer, int flush)
 {
-    fluid_rvoice_mixer_t *mixer = obj;
-    int fx_group = param[0].i; /* reverb fx group index */
-    int on = param[1].i;       /* on/off */
+#if ENABLE_MIXER_THREADS
+    mixer->flush_denormals = flush;
+#endif
+}
+
+/**
+ * Hand over the audio workgroup of the device the mixer renders for, so that the extra
+ * mixer threads and the fx thread are scheduled like its IO thread. The threads join it
+ * when they're woken up next. May be called at any time.
+ * @param workgroup a reference to an os_workgroup_t that the mixer takes ownership of,
+ *   NULL to let the threads leave the current one
+ */
+void fluid_rvoice_mixer_set_workgroup(fluid_rvoice_mixer_t *mixer, void *workgroup)
+{
+#if ENABLE_MIXER_THREADS
+    void *previous;
 
-    int nr_units = mixer->fx_units;
+    fluid_mutex_lock(mixer->workgroup_m);
+    previous = mixer->workgroup;
+    mixer->workgroup = workgroup;
+    fluid_atomic_int_inc(&mixer->workgroup_serial);
+    fluid_mutex_unlock(mixer->workgroup_m);
 
-    /* does on/off must be applied only to fx group at index fx_group ? */
-    if(fx_group >= 0)
-    {
-        mixer->fx[fx_group].reverb_on = on;
-    }
-    /* on/off must be applied to all fx groups */
-    else
+    /* the threads that joined it hold their own reference */
+    workgroup = previous;
+#endif
+
+    if(workgroup != NULL)
     {
-        for(fx_group = 0; fx_group < nr_units; fx_group++)
-        {
-            mixer->fx[fx_group].reverb_on = on;
-        }
+        fluid_workgroup_release(workgroup);
     }
+}
 
-    /* set with_reverb if at least one reverb unit is on */
-    for(fx_group = 0; fx_group < nr_units; fx_group++)
+/**
+ * Create the cache of rendered notes, see synth.voice-cache. Must be called before rendering.
+ * @param entries Number of notes cached
+ * @param blocks Maximum length of a cached note in blocks
+ * @return #FLUID_OK on success, #FLUID_FAILED if out of memory
+ */
+int fluid_rvoice_mixer_set_voice_cache(fluid_rvoice_mixer_t *mixer, int entries, int blocks)
+{
+    delete_fluid_rvoice_cache(mixer->voice_cache);
+    mixer->voice_cache = NULL;
+
+    if(entries > 0)
     {
-        on = mixer->fx[fx_group].reverb_on;
+        mixer->voice_cache = new_fluid_rvoice_cache(entries, blocks);
 
-        if(on)
+        if(mixer->voice_cache == NULL)
         {
-            break;
+            return FLUID_FAILED;
         }
     }
 
-    mixer->with_reverb = on;
-}
-
-/* @deprecated: use fluid_rvoice_mixer_chorus_enable instead */
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_enabled)
-{
-    fluid_rvoice_mixer_t *mixer = obj;
-    int on = param[0].i;
-    mixer->with_chorus = on;
+    return FLUID_OK;
 }
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_chorus_enable)
+/**
+ * Render the voices in fixed slices and sum them up in a fixed order, so that the output
+ * is the same bit for bit no matter how many threads render, see synth.deterministic-render.
+ * Must be called before rendering.
+ */
+int fluid_rvoice_mixer_set_deterministic(fluid_rvoice_mixer_t *mixer)
 {
-    fluid_rvoice_mixer_t *mixer = obj;
-    int fx_group = param[0].i; /* chorus fx group index */
-    int on = param[1].i;       /* on/off */
+    fluid_return_val_if_fail(mixer->slice_buffers == NULL, FLUID_FAILED);
 
-    int nr_units = mixer->fx_units;
+    mixer->slice_buffers = FLUID_NEW(fluid_mixer_buffers_t);
 
-    /* does on/off must be applied only to fx group at index fx_group ? */
-    if(fx_group >= 0)
-    {
-        mixer->fx[fx_group].chorus_on = on;
-    }
-    /* on/off must be applied to all fx groups */
-    else
+    if(mixer->slice_buffers == NULL)
     {
-        for(fx_group = 0; fx_group < nr_units; fx_group++)
-        {
-            mixer->fx[fx_group].chorus_on = on;
-        }
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
     }
 
-    /* set with_chorus if at least one chorus unit is on */
-    for(fx_group = 0; fx_group < nr_units; fx_group++)
-    {
-        on = mixer->fx[fx_group].chorus_on;
+    FLUID_MEMSET(mixer->slice_buffers, 0, sizeof(*mixer->slice_buffers));
 
-        if(on)
-        {
-            break;
-        }
+    if(!fluid_mixer_buffers_init(mixer->slice_buffers, mixer, mixer->polyphony))
+    {
+        fluid_mixer_buffers_free(mixer->slice_buffers);
+        FLUID_FREE(mixer->slice_buffers);
+        mixer->slice_buffers = NULL;
+        return FLUID_FAILED;
     }
 
-    mixer->with_chorus = on;
+    return FLUID_OK;
 }
 
-void fluid_rvoice_mixer_set_mix_fx(fluid_rvoice_mixer_t *mixer, int on)
+/**
+ * Number of notes that have been played from the voice cache.
+ */
+int fluid_rvoice_mixer_get_voice_cache_hits(const fluid_rvoice_mixer_t *mixer)
 {
-    mixer->mix_fx_to_out = on;
+    return (mixer->voice_cache != NULL) ? fluid_rvoice_cache_get_hits(mixer->voice_cache) : 0;
 }
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_params)
+static size_t
+fluid_mixer_buffers_get_memory(const fluid_mixer_buffers_t *buffers)
 {
-    fluid_rvoice_mixer_t *mixer = obj;
-    int i = param[0].i;
-    int set = param[1].i;
-    int nr = param[2].i;
-    fluid_real_t level = param[3].real;
-    fluid_real_t speed = param[4].real;
-    fluid_real_t depth_ms = param[5].real;
-    int type = param[6].i;
-
-    int nr_units = mixer->fx_units;
+    size_t samples = 2 * (buffers->buf_count + buffers->fx_buf_count);
+    int count = buffers->buf_count * 2 + buffers->fx_buf_count;
 
-    /* does parameters must be applied only to fx group i ? */
-    if(i >= 0)
-    {
-        nr_units = i + 1;
-    }
-    else
+    /* the effects stage doesn't render voices */
+    if(buffers->local_buf != NULL)
     {
-        i = 0; /* parameters must be applied to all fx groups */
+        samples++;
     }
 
-    while(i < nr_units)
-    {
-        fluid_chorus_set(mixer->fx[i++].chorus, set, nr, level, speed, depth_ms, type);
-    }
+    return samples * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT * sizeof(fluid_real_t)
+           + count * sizeof(*buffers->live)
+           + buffers->finished_voices_size * sizeof(*buffers->finished_voices);
 }
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_reverb_params)
+/**
+ * Get the memory used by the mixer in bytes.
+ * @param buffers Receives the size of the mixer, the audio buffers of it, its threads and
+ *   the effects stage
+ * @param effects Receives the size of the reverb and chorus units
+ * @param cache Receives the size of the voice cache
+ */
+void fluid_rvoice_mixer_get_memory(const fluid_rvoice_mixer_t *mixer, size_t *buffers,
+                                   size_t *effects, size_t *cache)
 {
-    fluid_rvoice_mixer_t *mixer = obj;
-    int i = param[0].i; /* fx group index */
-    int set = param[1].i;
-    fluid_real_t roomsize = param[2].real;
-    fluid_real_t damping = param[3].real;
-    fluid_real_t width = param[4].real;
-    fluid_real_t level = param[5].real;
+    int i;
 
-    int nr_units = mixer->fx_units;
+    *buffers = sizeof(*mixer) + fluid_mixer_buffers_get_memory(&mixer->buffers)
+               + mixer->polyphony * sizeof(*mixer->rvoices);
 
-    /* does parameters change should be applied only to fx group i ? */
-    if(i >= 0)
+    if(mixer->slice_buffers != NULL)
     {
-        nr_units = i + 1; /* parameters change must be applied to fx groups i */
+        *buffers += sizeof(*mixer->slice_buffers) + fluid_mixer_buffers_get_memory(mixer->slice_buffers);
     }
-    else
+
+#if ENABLE_MIXER_THREADS
+
+    for(i = 0; i < mixer->thread_count; i++)
     {
-        i = 0; /* parameters change must be applied to all fx groups */
+        *buffers += sizeof(mixer->threads[i]) + fluid_mixer_buffers_get_memory(&mixer->threads[i]);
     }
 
-    while(i < nr_units)
+    if(mixer->fx_stage != NULL)
     {
-        fluid_revmodel_set(mixer->fx[i++].reverb, set, roomsize, damping, width, level);
+        *buffers += sizeof(*mixer->fx_stage) + fluid_mixer_buffers_get_memory(mixer->fx_stage);
     }
-}
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_reverb)
-{
-    fluid_rvoice_mixer_t *mixer = obj;
-    int i;
+#endif
+
+    *effects = mixer->fx_units * sizeof(*mixer->fx);
 
     for(i = 0; i < mixer->fx_units; i++)
     {
-        fluid_revmodel_reset(mixer->fx[i].reverb);
+        *effects += fluid_revmodel_get_memory(mixer->fx[i].reverb) + fluid_chorus_get_memory(mixer->fx[i].chorus);
     }
+
+    *cache = (mixer->voice_cache != NULL) ? fluid_rvoice_cache_get_memory(mixer->voice_cache) : 0;
 }
 
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_chorus)
+/**
+ * Forget all notes of the voice cache, e.g. because their samples are about to be freed.
+ */
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_clear_voice_cache)
 {
     fluid_rvoice_mixer_t *mixer = obj;
-    int i;
 
-    for(i = 0; i < mixer->fx_units; i++)
+    if(mixer->voice_cache != NULL)
     {
-        fluid_chorus_reset(mixer->fx[i].chorus);
+        fluid_rvoice_cache_clear(mixer->voice_cache);
     }
 }
 
-int fluid_rvoice_mixer_get_bufs(fluid_rvoice_mixer_t *mixer,
-                                fluid_real_t **left, fluid_real_t **right)
+/**
+ * Allow the reverb and chorus units to run at the sample rate divided by up to
+ * \c decimation, see synth.fx-decimation. Must be called before rendering.
+ * @param decimation highest rate reduction, rounded down to a power of two
+ *   up to FLUID_FX_RESAMPLER_MAX_FACTOR
+ */
+int fluid_rvoice_mixer_set_fx_decimation(fluid_rvoice_mixer_t *mixer, int decimation)
 {
-    *left = fluid_align_ptr(mixer->buffers.left_buf, FLUID_DEFAULT_ALIGNMENT);
-    *right = fluid_align_ptr(mixer->buffers.right_buf, FLUID_DEFAULT_ALIGNMENT);
-    return mixer->buffers.buf_count;
-}
+    int i;
 
-int fluid_rvoice_mixer_get_fx_bufs(fluid_rvoice_mixer_t *mixer,
-                                   fluid_real_t **fx_left, fluid_real_t **fx_right)
-{
-    *fx_left = fluid_align_ptr(mixer->buffers.fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-    *fx_right = fluid_align_ptr(mixer->buffers.fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
-    return mixer->buffers.fx_buf_count;
-}
+    fluid_clip(decimation, 1, FLUID_FX_RESAMPLER_MAX_FACTOR);
 
-int fluid_rvoice_mixer_get_bufcount(fluid_rvoice_mixer_t *mixer)
-{
-    return FLUID_MIXER_MAX_BUFFERS_DEFAULT;
-}
+    for(i = 0; i < mixer->fx_units && decimation > 1; i++)
+    {
+        if(mixer->fx[i].reverb_rs == NULL)
+        {
+            mixer->fx[i].reverb_rs = new_fluid_fx_resampler();
+            mixer->fx[i].chorus_rs = new_fluid_fx_resampler();
+        }
 
-#if WITH_PROFILING
-int fluid_rvoice_mixer_get_active_voices(fluid_rvoice_mixer_t *mixer)
-{
-    return mixer->active_voices;
+        if(mixer->fx[i].reverb_rs == NULL || mixer->fx[i].chorus_rs == NULL)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    mixer->fx_decimation = decimation;
+    fluid_rvoice_mixer_update_fx_rate(mixer, mixer->sample_rate);
+
+    return FLUID_OK;
 }
-#endif
 
 #if ENABLE_MIXER_THREADS
-
-static FLUID_INLINE fluid_rvoice_t *
-fluid_mixer_get_mt_rvoice(fluid_rvoice_mixer_t *mixer)
+/**
+ * Create a render pool.
+ * @param thread_count Number of worker threads
+ * @param prio_level realtime prio level for the worker threads
+ * @param cpus CPUs to pin the workers to, round-robin (may be NULL)
+ * @param cpu_count number of elements in \c cpus, 0 to leave the workers unpinned
+ * @param deadline_runtime CPU time in us reserved per period for each worker
+ * @param deadline_period period in us of the deadline scheduling of the workers, 0 to
+ *   keep their realtime priority
+ * @return the new pool or NULL on error
+ */
+fluid_render_pool_t *
+new_fluid_rvoice_render_pool(int thread_count, int prio_level, const int *cpus, int cpu_count,
+                             int deadline_runtime, int deadline_period)
 {
-    int i = fluid_atomic_int_exchange_and_add(&mixer->current_rvoice, 1);
+    char name[16];
+    int i;
+    fluid_render_pool_t *pool = FLUID_NEW(fluid_render_pool_t);
 
-    if(i >= mixer->active_voices)
+    if(pool == NULL)
     {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
-    return mixer->rvoices[i];
-}
+    FLUID_MEMSET(pool, 0, sizeof(*pool));
 
-#define THREAD_BUF_PROCESSING 0
-#define THREAD_BUF_VALID 1
-#define THREAD_BUF_NODATA 2
-#define THREAD_BUF_TERMINATE 3
+    pool->task_ready = new_fluid_cond();
+    pool->task_m = new_fluid_cond_mutex();
+    pool->threads = FLUID_ARRAY(fluid_thread_t *, thread_count);
 
-/* Core thread function (processes voices in parallel to primary synthesis thread) */
-static fluid_thread_return_t
-fluid_mixer_thread_func(void *data)
-{
-    fluid_mixer_buffers_t *buffers = data;
-    fluid_rvoice_mixer_t *mixer = buffers->mixer;
-    int hasValidData = 0;
-    FLUID_DECLARE_VLA(fluid_real_t *, bufs, buffers->buf_count * 2 + buffers->fx_buf_count * 2);
-    int bufcount = 0;
-    int current_blockcount = 0;
-    fluid_real_t *local_buf = fluid_align_ptr(buffers->local_buf, FLUID_DEFAULT_ALIGNMENT);
+    if(pool->task_ready == NULL || pool->task_m == NULL || pool->threads == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
 
-    while(!fluid_atomic_int_get(&mixer->threads_should_terminate))
+    if(cpu_count > 0)
     {
-        fluid_rvoice_t *rvoice = fluid_mixer_get_mt_rvoice(mixer);
+        pool->cpus = FLUID_ARRAY(int, cpu_count);
 
-        if(rvoice == NULL)
+        if(pool->cpus == NULL)
         {
-            // if no voices: signal rendered buffers, sleep
-            fluid_atomic_int_set(&buffers->ready, hasValidData ? THREAD_BUF_VALID : THREAD_BUF_NODATA);
-            fluid_cond_mutex_lock(mixer->thread_ready_m);
-            fluid_cond_signal(mixer->thread_ready);
-            fluid_cond_mutex_unlock(mixer->thread_ready_m);
-
-            fluid_cond_mutex_lock(mixer->wakeup_threads_m);
-
-            while(1)
-            {
-                int j = fluid_atomic_int_get(&buffers->ready);
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            goto error_recovery;
+        }
 
-                if(j == THREAD_BUF_PROCESSING || j == THREAD_BUF_TERMINATE)
-                {
-                    break;
-                }
+        FLUID_MEMCPY(pool->cpus, cpus, cpu_count * sizeof(*cpus));
+        pool->cpu_count = cpu_count;
+    }
 
-                fluid_cond_wait(mixer->wakeup_threads, mixer->wakeup_threads_m);
-            }
+    pool->deadline_runtime = deadline_runtime;
+    pool->deadline_period = deadline_period;
 
-            fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+    for(i = 0; i < thread_count; i++)
+    {
+        FLUID_SNPRINTF(name, sizeof(name), "rpool%d", i);
+        pool->threads[i] = new_fluid_thread(name, fluid_render_pool_thread_func, pool, prio_level, 0);
 
-            hasValidData = 0;
-        }
-        else
+        if(pool->threads[i] == NULL)
         {
-            // else: if buffer is not zeroed, zero buffers
-            if(!hasValidData)
-            {
-                // blockcount may have changed, since thread was put to sleep
-                current_blockcount = mixer->current_blockcount;
-                fluid_mixer_buffers_zero(buffers, current_blockcount);
-                bufcount = fluid_mixer_buffers_prepare(buffers, bufs);
-                hasValidData = 1;
-            }
-
-            // then render voice to buffers
-            fluid_mixer_buffers_render_one(buffers, rvoice, bufs, bufcount, local_buf, current_blockcount);
+            goto error_recovery;
         }
+
+        pool->thread_count++;
     }
 
-    return FLUID_THREAD_RETURN_VALUE;
+    return pool;
+
+error_recovery:
+    delete_fluid_rvoice_render_pool(pool);
+    return NULL;
 }
 
-static void
-fluid_mixer_buffers_mix(fluid_mixer_buffers_t *dst, fluid_mixer_buffers_t *src, int current_blockcount)
+/**
+ * Run func for the items 0 to count - 1, in parallel on the idle workers of the pool and the
+ * calling thread, and return once all of them have finished. The voices of attached mixers
+ * are rendered first, so a batch only takes the time the workers are not needed for them.
+ * Not realtime capable.
+ */
+void
+fluid_rvoice_render_pool_run(fluid_render_pool_t *pool, fluid_render_pool_func_t func, void *data, int count)
 {
-    int i, j;
-    int scount = current_blockcount * FLUID_BUFSIZE;
-    int minbuf;
-    fluid_real_t *FLUID_RESTRICT base_src;
-    fluid_real_t *FLUID_RESTRICT base_dst;
-
-    minbuf = dst->buf_count;
+    fluid_render_batch_t batch;
 
-    if(minbuf > src->buf_count)
+    if(count <= 0)
     {
-        minbuf = src->buf_count;
+        return;
     }
 
-    base_src = fluid_align_ptr(src->left_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->left_buf, FLUID_DEFAULT_ALIGNMENT);
-
-    for(i = 0; i < minbuf; i++)
-    {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+    batch.func = func;
+    batch.data = data;
+    batch.count = count;
+    batch.next = 0;
+    batch.done = 0;
 
-        for(j = 0; j < scount; j++)
-        {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
-        }
-    }
+    fluid_cond_mutex_lock(pool->task_m);
 
-    base_src = fluid_align_ptr(src->right_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->right_buf, FLUID_DEFAULT_ALIGNMENT);
+    batch.next_batch = pool->batches;
+    pool->batches = &batch;
+    fluid_cond_broadcast(pool->task_ready);
 
-    for(i = 0; i < minbuf; i++)
+    while(batch.next < batch.count)
     {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+        fluid_render_pool_run_item(pool, &batch);
+    }
 
-        for(j = 0; j < scount; j++)
-        {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
-        }
+    while(batch.done < batch.count)
+    {
+        fluid_cond_wait(pool->task_ready, pool->task_m);
     }
 
-    minbuf = dst->fx_buf_count;
+    /* taking the last item has unlinked the batch already, but it lives on this stack:
+     * make sure no pointer to it is left in the pool before returning */
+    fluid_render_pool_unlink_batch(pool, &batch);
 
-    if(minbuf > src->fx_buf_count)
+    fluid_cond_mutex_unlock(pool->task_m);
+}
+
+/**
+ * Terminate the workers of a render pool and free it.
+ * Fails if a mixer is still attached to the pool.
+ */
+void
+delete_fluid_rvoice_render_pool(fluid_render_pool_t *pool)
+{
+    int i;
+
+    fluid_return_if_fail(pool != NULL);
+
+    if(fluid_atomic_int_get(&pool->attached) != 0)
     {
-        minbuf = src->fx_buf_count;
+        FLUID_LOG(FLUID_ERR, "Render pool is still used by %d synth(s), not deleting it",
+                  fluid_atomic_int_get(&pool->attached));
+        return;
     }
 
-    base_src = fluid_align_ptr(src->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
-
-    for(i = 0; i < minbuf; i++)
+    if(pool->task_m != NULL)
     {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+        fluid_cond_mutex_lock(pool->task_m);
+        pool->should_terminate = TRUE;
+        fluid_cond_broadcast(pool->task_ready);
+        fluid_cond_mutex_unlock(pool->task_m);
+    }
 
-        for(j = 0; j < scount; j++)
-        {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
-        }
+    for(i = 0; i < pool->thread_count; i++)
+    {
+        fluid_thread_join(pool->threads[i]);
+        delete_fluid_thread(pool->threads[i]);
     }
 
-    base_src = fluid_align_ptr(src->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
-    base_dst = fluid_align_ptr(dst->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+    FLUID_FREE(pool->threads);
+    FLUID_FREE(pool->cpus);
 
-    for(i = 0; i < minbuf; i++)
+    if(pool->task_ready != NULL)
     {
-        #pragma omp simd aligned(base_dst,base_src:FLUID_DEFAULT_ALIGNMENT)
+        delete_fluid_cond(pool->task_ready);
+    }
 
-        for(j = 0; j < scount; j++)
-        {
-            int dsp_i = i * FLUID_MIXER_MAX_BUFFERS_DEFAULT * FLUID_BUFSIZE + j;
-            base_dst[dsp_i] += base_src[dsp_i];
-        }
+    if(pool->task_m != NULL)
+    {
+        delete_fluid_cond_mutex(pool->task_m);
     }
-}
 
+    FLUID_FREE(pool);
+}
+#endif
 
 /**
- * Go through all threads and see if someone is finished for mixing
+ * Attach the mixer to a render pool, or detach it from its current one if the pool is NULL.
+ * While attached, the workers of the pool render the voices instead of the own mixer threads.
+ * The buffers of the new threads have been allocated by fluid_rvoice_mixer_push_render_pool(),
+ * the old ones are retired.
+ * Note: Not hard realtime capable (creates and joins threads)
  */
-static int
-fluid_mixer_mix_in(fluid_rvoice_mixer_t *mixer, int extra_threads, int current_blockcount)
+#if ENABLE_MIXER_THREADS
+static DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_render_pool)
 {
-    int i, result, hasmixed;
+    fluid_rvoice_mixer_t *mixer = obj;
+    fluid_mixer_arrays_t *arrays = param[0].ptr;
 
-    do
+    // drop the old threads or pool tasks before switching
+    fluid_rvoice_mixer_stop_threads(mixer);
+    arrays->old_threads = mixer->threads;
+    arrays->old_thread_count = mixer->thread_count;
+
+    if(mixer->pool != NULL)
     {
-        hasmixed = 0;
-        result = 0;
+        fluid_atomic_int_add(&mixer->pool->attached, -1);
+    }
 
-        for(i = 0; i < extra_threads; i++)
-        {
-            int j = fluid_atomic_int_get(&mixer->threads[i].ready);
+    mixer->pool = arrays->pool;
 
-            switch(j)
-            {
-            case THREAD_BUF_PROCESSING:
-                result = 1;
-                break;
+    if(mixer->pool != NULL)
+    {
+        fluid_atomic_int_inc(&mixer->pool->attached);
+    }
 
-            case THREAD_BUF_VALID:
-                fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_NODATA);
-                fluid_mixer_buffers_mix(&mixer->buffers, &mixer->threads[i], current_blockcount);
-                hasmixed = 1;
-                break;
-            }
-        }
+    mixer->threads = arrays->threads;
+    mixer->thread_count = arrays->thread_count;
+    arrays->threads = NULL;
+    arrays->thread_count = 0;
+
+    if(fluid_rvoice_mixer_start_threads(mixer, mixer->prio_level) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to set up the mixer threads, rendering on a single thread");
+        fluid_rvoice_mixer_stop_threads(mixer);
+        arrays->threads = mixer->threads;
+        arrays->thread_count = mixer->thread_count;
+        mixer->threads = NULL;
+        mixer->thread_count = 0;
     }
-    while(hasmixed);
 
-    return result;
+    fluid_rvoice_mixer_retire_arrays(mixer, arrays);
 }
+#endif
 
-static void
-fluid_render_loop_multithread(fluid_rvoice_mixer_t *mixer, int current_blockcount)
+/**
+ * Attach the mixer to a render pool, or detach it if the pool is NULL. The buffers of the
+ * extra threads are allocated here, by the API thread, the mixer only swaps them in when it
+ * processes the event.
+ * @return FLUID_OK or FLUID_FAILED
+ */
+int
+fluid_rvoice_mixer_push_render_pool(fluid_rvoice_mixer_t *mixer, fluid_render_pool_t *pool)
 {
-    int i, bufcount;
-    fluid_real_t *local_buf = fluid_align_ptr(mixer->buffers.local_buf, FLUID_DEFAULT_ALIGNMENT);
-
-    FLUID_DECLARE_VLA(fluid_real_t *, bufs,
-                      mixer->buffers.buf_count * 2 + mixer->buffers.fx_buf_count * 2);
-    // How many threads should we start this time?
-    int extra_threads = mixer->active_voices / VOICES_PER_THREAD;
-
-    if(extra_threads > mixer->thread_count)
-    {
-        extra_threads = mixer->thread_count;
-    }
+#if ENABLE_MIXER_THREADS
+    fluid_mixer_arrays_t *arrays;
+    int thread_count;
 
-    if(extra_threads == 0)
+    if(mixer->queued_pool == pool)
     {
-        // No extra threads? No thread overhead!
-        fluid_render_loop_singlethread(mixer, current_blockcount);
-        return;
+        return FLUID_OK;
     }
 
-    bufcount = fluid_mixer_buffers_prepare(&mixer->buffers, bufs);
+    fluid_rvoice_mixer_free_retired(mixer);
 
-    // Prepare voice list
-    fluid_cond_mutex_lock(mixer->wakeup_threads_m);
-    fluid_atomic_int_set(&mixer->current_rvoice, 0);
+    arrays = FLUID_NEW(fluid_mixer_arrays_t);
 
-    for(i = 0; i < extra_threads; i++)
+    if(arrays == NULL)
     {
-        fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_PROCESSING);
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
     }
 
-    // Signal threads to wake up
-    fluid_cond_broadcast(mixer->wakeup_threads);
-    fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+    FLUID_MEMSET(arrays, 0, sizeof(*arrays));
+    thread_count = (pool != NULL) ? pool->thread_count : mixer->own_thread_count;
 
-    // If thread is finished, mix it in
-    while(fluid_mixer_mix_in(mixer, extra_threads, current_blockcount))
+    if(thread_count > 0)
     {
-        // Otherwise get a voice and render it
-        fluid_rvoice_t *rvoice = fluid_mixer_get_mt_rvoice(mixer);
+        arrays->threads = new_fluid_mixer_threads(mixer, thread_count, mixer->queued_polyphony);
 
-        if(rvoice != NULL)
+        if(arrays->threads == NULL)
         {
-            fluid_profile_ref_var(prof_ref);
-            fluid_mixer_buffers_render_one(&mixer->buffers, rvoice, bufs, bufcount, local_buf, current_blockcount);
-            fluid_profile(FLUID_PROF_ONE_BLOCK_VOICE, prof_ref, 1,
-                          current_blockcount * FLUID_BUFSIZE);
-            //test++;
+            FLUID_FREE(arrays);
+            return FLUID_FAILED;
         }
-        else
-        {
-            // If no voices, wait for mixes. Make sure one is still processing to avoid deadlock
-            int is_processing = 0;
-            //waits++;
-            fluid_cond_mutex_lock(mixer->thread_ready_m);
 
-            for(i = 0; i < extra_threads; i++)
-            {
-                if(fluid_atomic_int_get(&mixer->threads[i].ready) ==
-                        THREAD_BUF_PROCESSING)
-                {
-                    is_processing = 1;
-                }
-            }
+        arrays->thread_count = thread_count;
+    }
 
-            if(is_processing)
-            {
-                fluid_cond_wait(mixer->thread_ready, mixer->thread_ready_m);
-            }
+    arrays->pool = pool;
 
-            fluid_cond_mutex_unlock(mixer->thread_ready_m);
-        }
+    if(fluid_rvoice_eventhandler_push_ptr(mixer->eventhandler, fluid_rvoice_mixer_set_render_pool,
+                                          mixer, arrays) != FLUID_OK)
+    {
+        delete_fluid_mixer_arrays(arrays);
+        return FLUID_FAILED;
     }
 
-    //FLUID_LOG(FLUID_DBG, "Blockcount: %d, mixed %d of %d voices myself, waits = %d",
-    //	    current_blockcount, test, mixer->active_voices, waits);
+    mixer->queued_pool = pool;
+    mixer->queued_thread_count = thread_count;
+#endif
+    return FLUID_OK;
 }
 
-static void delete_rvoice_mixer_threads(fluid_rvoice_mixer_t *mixer)
+/* Sort order of fluid_mixer_group_rvoices(), by_position also orders the voices playing
+ * the same sample by the position they read at */
+static FLUID_INLINE int
+fluid_mixer_rvoices_before(const fluid_rvoice_t *a, const fluid_rvoice_t *b, int by_position)
 {
-    int i;
+    if(a->dsp.sample != b->dsp.sample)
+    {
+        return (uintptr_t)a->dsp.sample < (uintptr_t)b->dsp.sample;
+    }
 
-    // if no threads have been created yet (e.g. because a previous error prevented creation of threads
-    // mutexes and condition variables), skip terminating threads
-    if(mixer->thread_count != 0)
+    if(a->dsp.interp_method != b->dsp.interp_method)
     {
-        fluid_atomic_int_set(&mixer->threads_should_terminate, 1);
-        // Signal threads to wake up
-        fluid_cond_mutex_lock(mixer->wakeup_threads_m);
+        return a->dsp.interp_method < b->dsp.interp_method;
+    }
 
-        for(i = 0; i < mixer->thread_count; i++)
-        {
-            fluid_atomic_int_set(&mixer->threads[i].ready, THREAD_BUF_TERMINATE);
-        }
+    return by_position && a->dsp.phase < b->dsp.phase;
+}
 
-        fluid_cond_broadcast(mixer->wakeup_threads);
-        fluid_cond_mutex_unlock(mixer->wakeup_threads_m);
+/**
+ * Reorder the active voices so that voices reading the same sample with the same
+ * interpolation are next to each other. The order carries over from the previous run and only
+ * changes where voices have been added or removed, so insertion sort mostly takes
+ * linear time here. Sorting by the position as well is left to every
+ * FLUID_MIXER_LOCALITY_BLOCKS blocks, in between the sort is stable and keeps
+ * the voices of a sample roughly in the order of their positions.
+ */
+static void
+fluid_mixer_group_rvoices(fluid_rvoice_mixer_t *mixer, int by_position)
+{
+    int i, j;
 
-        for(i = 0; i < mixer->thread_count; i++)
-        {
-            if(mixer->threads[i].thread)
-            {
-                fluid_thread_join(mixer->threads[i].thread);
-                delete_fluid_thread(mixer->threads[i].thread);
-            }
+    for(i = 1; i < mixer->active_voices; i++)
+    {
+        fluid_rvoice_t *rvoice = mixer->rvoices[i];
 
-            fluid_mixer_buffers_free(&mixer->threads[i]);
+        for(j = i; j > 0 && fluid_mixer_rvoices_before(rvoice, mixer->rvoices[j - 1], by_position); j--)
+        {
+            mixer->rvoices[j] = mixer->rvoices[j - 1];
         }
+
+        mixer->rvoices[j] = rvoice;
     }
+}
 
-    FLUID_FREE(mixer->threads);
-    mixer->thread_count = 0;
-    mixer->threads = NULL;
+/* Measures a left and right buffer of blockcount blocks into acc, unless they are silent */
+static void
+fluid_rvoice_mixer_meter_bufs(const fluid_real_t *left, const fluid_real_t *right,
+                              int live, int blockcount, fluid_meter_acc_t *acc)
+{
+    FLUID_MEMSET(acc, 0, sizeof(*acc));
+
+    if(live)
+    {
+        fluid_meter_measure(left, blockcount * FLUID_BUFSIZE, &acc->peak[0], &acc->sumsq[0]);
+        fluid_meter_measure(right, blockcount * FLUID_BUFSIZE, &acc->peak[1], &acc->sumsq[1]);
+    }
 }
 
-/**
- * Update amount of extra mixer threads.
- * @param thread_count Number of extra mixer threads for multi-core rendering
- * @param prio_level realtime prio level for the extra mixer threads
+/*
+ * Records the levels of the MIDI channels, which the render participants metered while mixing
+ * down the voices, and meters the audio groups and effects buffers of the blockcount blocks
+ * the mixer returns.
  */
-static int fluid_rvoice_mixer_set_threads(fluid_rvoice_mixer_t *mixer, int thread_count, int prio_level)
+static void
+fluid_rvoice_mixer_meter(fluid_rvoice_mixer_t *mixer, int blockcount)
 {
-    char name[16];
+    fluid_meter_t *meter = mixer->meter;
+    fluid_mixer_buffers_t *buffers = &mixer->buffers;
+    const fluid_real_t *left = fluid_align_ptr(buffers->left_buf, FLUID_DEFAULT_ALIGNMENT);
+    const fluid_real_t *right = fluid_align_ptr(buffers->right_buf, FLUID_DEFAULT_ALIGNMENT);
+    const fluid_real_t *fx_left = fluid_align_ptr(buffers->fx_left_buf, FLUID_DEFAULT_ALIGNMENT);
+    const fluid_real_t *fx_right = fluid_align_ptr(buffers->fx_right_buf, FLUID_DEFAULT_ALIGNMENT);
+    const int bufsize = FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+    fluid_meter_acc_t acc;
+    int participants = 1;
     int i;
 
-    // Kill all existing threads first
-    if(mixer->thread_count)
+#if ENABLE_MIXER_THREADS
+    participants += mixer->thread_count;
+#endif
+
+    fluid_meter_record_channels(meter, participants, mixer->current_blockcount * FLUID_BUFSIZE);
+
+    for(i = 0; i < buffers->buf_count && i < meter->groups; i++)
     {
-        delete_rvoice_mixer_threads(mixer);
+        fluid_rvoice_mixer_meter_bufs(&left[i * bufsize], &right[i * bufsize],
+                                      buffers->live[2 * i] || buffers->live[2 * i + 1], blockcount, &acc);
+        fluid_meter_record(meter, meter->channels + i, &acc, blockcount * FLUID_BUFSIZE);
     }
 
-    if(thread_count == 0)
+    for(i = 0; i < buffers->fx_buf_count && i < meter->fx_channels; i++)
     {
-        return FLUID_OK;
+        fluid_rvoice_mixer_meter_bufs(&fx_left[i * bufsize], &fx_right[i * bufsize],
+                                      buffers->live[2 * buffers->buf_count + i], blockcount, &acc);
+        fluid_meter_record(meter, meter->channels + meter->groups + i, &acc, blockcount * FLUID_BUFSIZE);
     }
+}
 
-    // Now prepare the new threads
-    fluid_atomic_int_set(&mixer->threads_should_terminate, 0);
-    mixer->threads = FLUID_ARRAY(fluid_mixer_buffers_t, thread_count);
+/* Publishes the voices still active after a render call, if snapshots are enabled */
+static void
+fluid_rvoice_mixer_take_voice_snapshot(fluid_rvoice_mixer_t *mixer)
+{
+    fluid_voice_snapshot_buf_t *buf = fluid_voice_snapshot_begin(mixer->voice_snapshot);
+    int i;
 
-    if(mixer->threads == NULL)
+    if(buf == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return FLUID_FAILED;
+        return;
     }
 
-    FLUID_MEMSET(mixer->threads, 0, thread_count * sizeof(fluid_mixer_buffers_t));
-    mixer->thread_count = thread_count;
-
-    for(i = 0; i < thread_count; i++)
+    for(i = 0; i < mixer->active_voices; i++)
     {
-        fluid_mixer_buffers_t *b = &mixer->threads[i];
-
-        if(!fluid_mixer_buffers_init(b, mixer))
-        {
-            return FLUID_FAILED;
-        }
-
-        fluid_atomic_int_set(&b->ready, THREAD_BUF_NODATA);
-        FLUID_SNPRINTF(name, sizeof(name), "mixer%d", i);
-        b->thread = new_fluid_thread(name, fluid_mixer_thread_func, b, prio_level, 0);
+        fluid_rvoice_t *voice = mixer->rvoices[i];
 
-        if(!b->thread)
-        {
-            return FLUID_FAILED;
-        }
+        /* only the last filter of the chain applies the gain, the other one has zero */
+        fluid_voice_snapshot_add_voice(mixer->voice_snapshot, buf, voice->note_chan, voice->note_key, voice->note_vel,
+                                 fluid_adsr_env_get_section(&voice->envlfo.volenv),
+                                 (float)(voice->resonant_filter.amp + voice->resonant_custom_filter.amp));
     }
 
-    return FLUID_OK;
+    fluid_voice_snapshot_commit(mixer->voice_snapshot, buf);
 }
-#endif
 
 /**
  * Synthesize audio into buffers
  * @param blockcount number of blocks to render, each having FLUID_BUFSIZE samples
- * @return number of blocks rendered
+ * @return number of blocks rendered, with a pipelined effects stage these are the
+ * blocks of the previous call
  */
 int
 fluid_rvoice_mixer_render(fluid_rvoice_mixer_t *mixer, int blockcount)
 {
+    double perf_ref;
     fluid_profile_ref_var(prof_ref);
 
     mixer->current_blockcount = blockcount;
 
+    if(mixer->voice_locality)
+    {
+        /* voices reading the same sample memory are rendered back to back, and by
+         * the same thread as the chunks handed out to the threads are contiguous */
+        int by_position = mixer->voice_locality && mixer->locality_blocks >= FLUID_MIXER_LOCALITY_BLOCKS;
+
+        fluid_mixer_group_rvoices(mixer, by_position);
+        mixer->locality_blocks = by_position ? 0 : mixer->locality_blocks + blockcount;
+    }
+
+#if ENABLE_MIXER_THREADS
+
+    if(mixer->fx_stage != NULL)
+    {
+        // the effects of the previous run are processed while the voices of this one are rendered
+        fluid_rvoice_mixer_fx_stage_start(mixer, blockcount);
+    }
+
+#endif
+
     // Zero buffers
     fluid_mixer_buffers_zero(&mixer->buffers, blockcount);
     fluid_profile(FLUID_PROF_ONE_BLOCK_CLEAR, prof_ref, mixer->active_voices,
                   blockcount * FLUID_BUFSIZE);
 
+    perf_ref = fluid_perf_ref(mixer->perf);
+
 #if ENABLE_MIXER_THREADS
+    mixer->groups_active = fluid_mixer_parallel_groups_usable(mixer);
 
     if(mixer->thread_count > 0)
     {
@@ -1752,13 +5066,40 @@ fluid_rvoice_mixer_render(fluid_rvoice_mixer_t *mixer, int blockcount)
 
     fluid_profile(FLUID_PROF_ONE_BLOCK_VOICES, prof_ref, mixer->active_voices,
                   blockcount * FLUID_BUFSIZE);
+    fluid_perf_stage(mixer->perf, FLUID_PERF_STAGE_VOICES, perf_ref);
+
+    if(fluid_perf_accounting(mixer->perf))
+    {
+        fluid_perf_account_blocks(mixer->perf, blockcount);
+    }
 
 
-    // Process reverb & chorus
-    fluid_rvoice_mixer_process_fx(mixer, blockcount);
+#if ENABLE_MIXER_THREADS
+
+    if(mixer->fx_stage != NULL)
+    {
+        blockcount = fluid_rvoice_mixer_fx_stage_finish(mixer, blockcount);
+    }
+    else if(mixer->groups_active)
+    {
+        // the effects have been processed together with the voices of each group
+    }
+    else
+#endif
+    {
+        // Process reverb & chorus
+        fluid_rvoice_mixer_process_fx(mixer, &mixer->buffers, blockcount);
+    }
 
     // Call the callback and pack active voice array
     fluid_rvoice_mixer_process_finished_voices(mixer);
 
+    fluid_rvoice_mixer_take_voice_snapshot(mixer);
+
+    if(fluid_meter_enabled(mixer->meter))
+    {
+        fluid_rvoice_mixer_meter(mixer, blockcount);
+    }
+
     return blockcount;
 }
@@ -25,6 +25,9 @@
 #include "fluid_rvoice.h"
 #include "fluid_ladspa.h"
 #include "fluid_limiter.h"
+#include "fluid_perf.h"
+#include "fluid_voice_snapshot.h"
+#include "fluid_meter.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,20 +35,63 @@ extern "C" {
 
 typedef struct _fluid_rvoice_mixer_t fluid_rvoice_mixer_t;
 
+/* How mixer threads wait for work and for each other, see synth.mixer-thread-wait */
+enum fluid_mixer_thread_wait
+{
+    FLUID_MIXER_THREAD_WAIT_BLOCK,  /* block on condition variables right away */
+    FLUID_MIXER_THREAD_WAIT_HYBRID, /* spin for a bounded time, then block */
+    FLUID_MIXER_THREAD_WAIT_SPIN    /* spin for about an audio period, then block */
+};
+
 int fluid_rvoice_mixer_render(fluid_rvoice_mixer_t *mixer, int blockcount);
 int fluid_rvoice_mixer_get_bufs(fluid_rvoice_mixer_t *mixer,
                                 fluid_real_t **left, fluid_real_t **right);
 int fluid_rvoice_mixer_get_fx_bufs(fluid_rvoice_mixer_t *mixer,
                                    fluid_real_t **fx_left, fluid_real_t **fx_right);
+const unsigned char *fluid_rvoice_mixer_get_live_bufs(fluid_rvoice_mixer_t *mixer);
 int fluid_rvoice_mixer_get_bufcount(fluid_rvoice_mixer_t *mixer);
 #if WITH_PROFILING
 int fluid_rvoice_mixer_get_active_voices(fluid_rvoice_mixer_t *mixer);
 #endif
 fluid_rvoice_mixer_t *new_fluid_rvoice_mixer(int buf_count, int fx_buf_count, int fx_units,
         fluid_real_t sample_rate_max, fluid_real_t sample_rate,
-        fluid_rvoice_eventhandler_t *, int, int);
+        fluid_rvoice_eventhandler_t *, int, int, const int *, int);
 
 void delete_fluid_rvoice_mixer(fluid_rvoice_mixer_t *);
+int fluid_rvoice_mixer_set_fx_pipeline(fluid_rvoice_mixer_t *mixer, int prio_level);
+int fluid_rvoice_mixer_set_fx_decimation(fluid_rvoice_mixer_t *mixer, int decimation);
+void fluid_rvoice_mixer_set_fx_share(fluid_rvoice_mixer_t *mixer, int on);
+void fluid_rvoice_mixer_set_perf(fluid_rvoice_mixer_t *mixer, fluid_perf_t *perf);
+void fluid_rvoice_mixer_set_voice_snapshot(fluid_rvoice_mixer_t *mixer, fluid_voice_snapshot_t *snapshot);
+void fluid_rvoice_mixer_set_meter(fluid_rvoice_mixer_t *mixer, fluid_meter_t *meter);
+void fluid_rvoice_mixer_set_deadline(fluid_rvoice_mixer_t *mixer, int runtime_us, int period_us);
+void fluid_rvoice_mixer_set_flush_denormals(fluid_rvoice_mixer_t *mixer, int flush);
+void fluid_rvoice_mixer_set_workgroup(fluid_rvoice_mixer_t *mixer, void *workgroup);
+int fluid_rvoice_mixer_set_voice_cache(fluid_rvoice_mixer_t *mixer, int entries, int blocks);
+int fluid_rvoice_mixer_set_deterministic(fluid_rvoice_mixer_t *mixer);
+int fluid_rvoice_mixer_push_polyphony(fluid_rvoice_mixer_t *mixer, int polyphony);
+int fluid_rvoice_mixer_push_render_pool(fluid_rvoice_mixer_t *mixer, fluid_render_pool_t *pool);
+int fluid_rvoice_mixer_get_voice_cache_hits(const fluid_rvoice_mixer_t *mixer);
+void fluid_rvoice_mixer_get_memory(const fluid_rvoice_mixer_t *mixer, size_t *buffers,
+                                   size_t *effects, size_t *cache);
+
+void fluid_rvoice_buffers_mix(fluid_rvoice_buffers_t *buffers,
+                              const fluid_real_t *FLUID_RESTRICT dsp_buf,
+                              int start_block, int sample_count,
+                              fluid_real_t **dest_bufs, int dest_bufcount,
+                              unsigned char *dest_live, fluid_meter_acc_t *meter);
+
+#if ENABLE_MIXER_THREADS
+fluid_render_pool_t *new_fluid_rvoice_render_pool(int thread_count, int prio_level,
+        const int *cpus, int cpu_count, int deadline_runtime, int deadline_period);
+void delete_fluid_rvoice_render_pool(fluid_render_pool_t *pool);
+
+/* Runs the item index of a batch, see fluid_rvoice_render_pool_run() */
+typedef void (*fluid_render_pool_func_t)(void *data, int index);
+
+void fluid_rvoice_render_pool_run(fluid_render_pool_t *pool, fluid_render_pool_func_t func,
+                                  void *data, int count);
+#endif
 
 void
 fluid_rvoice_mixer_set_reverb_full(const fluid_rvoice_mixer_t *mixer,
@@ -63,8 +109,14 @@ fluid_rvoice_mixer_chorus_get_param(const fluid_rvoice_mixer_t *mixer,
 
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_add_voice);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_add_stereo_voice);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_samplerate);
-DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_polyphony);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_thread_wait);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_voice_locality);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_parallel_groups);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_filter_smoothing);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_float_interp);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_clear_voice_cache);
 
 /* @deprecated */
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_enabled);
@@ -78,6 +130,7 @@ DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_chorus_params);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_reverb_params);
 
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_reverb);
+DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_set_convolver);
 DECLARE_FLUID_RVOICE_FUNCTION(fluid_rvoice_mixer_reset_chorus);
 
 
@@ -87,9 +140,7 @@ void fluid_rvoice_mixer_set_mix_fx(fluid_rvoice_mixer_t *mixer, int on);
 void fluid_rvoice_mixer_set_ladspa(fluid_rvoice_mixer_t *mixer,
                                    fluid_ladspa_fx_t *ladspa_fx, int audio_groups);
 #endif
-#ifdef LIMITER_SUPPORT
 int fluid_rvoice_mixer_set_limiter(fluid_rvoice_mixer_t *mixer, fluid_real_t sample_rate, fluid_limiter_settings_t* settings);
-#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,220 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_rvoice_stream.h"
+#include "fluid_list.h"
+
+/* How often the background thread reads ahead of the rvoices */
+#define FLUID_RVOICE_STREAM_INTERVAL_MS (4)
+
+struct _fluid_rvoice_stream_t
+{
+    fluid_mutex_t mutex;            /* protects the list of slots */
+    fluid_list_t *slots;
+    fluid_timer_t *timer;
+    int readahead;                  /* sample points to read ahead of every rvoice */
+    fluid_atomic_int_t underruns;
+};
+
+static int fluid_rvoice_stream_run(void *data, unsigned int msec);
+static void fluid_rvoice_stream_read_ahead(fluid_rvoice_stream_t *stream, fluid_rvoice_stream_slot_t *slot);
+
+/*
+ * Creates the background thread streaming the sample data ahead of the rvoices.
+ *
+ * @param readahead count of sample points to read ahead of every rvoice
+ * @return the new stream, NULL on error or on platforms without memory mapped files
+ */
+fluid_rvoice_stream_t *new_fluid_rvoice_stream(int readahead)
+{
+    fluid_rvoice_stream_t *stream;
+
+    if(!FLUID_HAVE_FILE_MAP)
+    {
+        FLUID_LOG(FLUID_WARN, "Sample streaming is not supported on this platform");
+        return NULL;
+    }
+
+    stream = FLUID_NEW(fluid_rvoice_stream_t);
+
+    if(stream == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(stream, 0, sizeof(*stream));
+    fluid_mutex_init(stream->mutex);
+    stream->readahead = readahead;
+
+    stream->timer = new_fluid_timer(FLUID_RVOICE_STREAM_INTERVAL_MS, fluid_rvoice_stream_run,
+                                    stream, TRUE, FALSE, FALSE);
+
+    if(stream->timer == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the sample streaming thread");
+        delete_fluid_rvoice_stream(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+/*
+ * Stops the background thread and deletes all slots. The rvoices must not use
+ * their slots anymore.
+ */
+void delete_fluid_rvoice_stream(fluid_rvoice_stream_t *stream)
+{
+    fluid_list_t *list;
+
+    fluid_return_if_fail(stream != NULL);
+
+    delete_fluid_timer(stream->timer);
+
+    for(list = stream->slots; list; list = fluid_list_next(list))
+    {
+        FLUID_FREE(fluid_list_get(list));
+    }
+
+    delete_fluid_list(stream->slots);
+    fluid_mutex_destroy(stream->mutex);
+    FLUID_FREE(stream);
+}
+
+/*
+ * Creates a slot for an rvoice, owned by the stream.
+ */
+fluid_rvoice_stream_slot_t *fluid_rvoice_stream_new_slot(fluid_rvoice_stream_t *stream)
+{
+    fluid_rvoice_stream_slot_t *slot = FLUID_NEW(fluid_rvoice_stream_slot_t);
+
+    if(slot == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(slot, 0, sizeof(*slot));
+    slot->stream = stream;
+
+    fluid_mutex_lock(stream->mutex);
+    stream->slots = fluid_list_prepend(stream->slots, slot);
+    fluid_mutex_unlock(stream->mutex);
+
+    return slot;
+}
+
+/*
+ * Returns how often the mixer has reached sample data that has not yet been streamed.
+ */
+int fluid_rvoice_stream_get_underruns(fluid_rvoice_stream_t *stream)
+{
+    return fluid_atomic_int_get(&stream->underruns);
+}
+
+void fluid_rvoice_stream_underrun(fluid_rvoice_stream_t *stream)
+{
+    fluid_atomic_int_inc(&stream->underruns);
+}
+
+static int fluid_rvoice_stream_run(void *data, unsigned int msec)
+{
+    fluid_rvoice_stream_t *stream = data;
+    fluid_list_t *list;
+
+    fluid_mutex_lock(stream->mutex);
+
+    for(list = stream->slots; list; list = fluid_list_next(list))
+    {
+        fluid_rvoice_stream_read_ahead(stream, fluid_list_get(list));
+    }
+
+    fluid_mutex_unlock(stream->mutex);
+
+    return 1;
+}
+
+/*
+ * Reads the sample data ahead of the position of a slot and tells the mixer how far
+ * it may play without waiting. The values published by the mixer may belong to
+ * different blocks, or even to the previous sample of the rvoice, and the sample may
+ * have been unloaded already, so the data is only accessed by fluid_file_map_prefetch().
+ */
+static void fluid_rvoice_stream_read_ahead(fluid_rvoice_stream_t *stream, fluid_rvoice_stream_slot_t *slot)
+{
+    short *data = fluid_atomic_pointer_get(&slot->data);
+    char *data24 = fluid_atomic_pointer_get(&slot->data24);
+    int position, end, loopstart, loopend, count;
+    unsigned int played;
+
+    if(data == NULL)
+    {
+        return;
+    }
+
+    position = fluid_atomic_int_get(&slot->position);
+    played = (unsigned int)fluid_atomic_int_get(&slot->played);
+    end = fluid_atomic_int_get(&slot->end);
+    loopstart = fluid_atomic_int_get(&slot->loopstart);
+    loopend = fluid_atomic_int_get(&slot->loopend);
+
+    if(position < 0 || position > end)
+    {
+        return;
+    }
+
+    count = end - position + 1;
+
+    if(count > stream->readahead)
+    {
+        count = stream->readahead;
+    }
+
+    if(fluid_file_map_prefetch(data + position, count * sizeof(short)) != FLUID_OK
+            || (data24 != NULL && fluid_file_map_prefetch(data24 + position, count) != FLUID_OK))
+    {
+        return;
+    }
+
+    /* a looping rvoice continues at the start of the loop */
+    if(loopstart < loopend && loopend <= end && position < loopend && position + count >= loopend)
+    {
+        int loop_count = loopend - loopstart;
+
+        if(loop_count > stream->readahead)
+        {
+            loop_count = stream->readahead;
+        }
+
+        if(fluid_file_map_prefetch(data + loopstart, loop_count * sizeof(short)) != FLUID_OK
+                || (data24 != NULL && fluid_file_map_prefetch(data24 + loopstart, loop_count) != FLUID_OK))
+        {
+            return;
+        }
+    }
+
+    /* at the end of the sample, the rvoice either stops or continues in the loop read above */
+    if(position + count > end)
+    {
+        count = stream->readahead;
+    }
+
+    fluid_atomic_int_set(&slot->ready, (int)(played + (unsigned int)count));
+}
@@ -0,0 +1,143 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FLUID_RVOICE_STREAM_H
+#define _FLUID_RVOICE_STREAM_H
+
+#include "fluid_sys.h"
+#include "fluid_sfont.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Streaming of sample data from disk, see synth.sample-streaming.
+ *
+ * Streamed samples are memory mapped files, of which only the first
+ * _fluid_sample_t::stream_preload sample points are read when loading. Every rvoice
+ * has a slot, through which the mixer tells a background thread where the rvoice
+ * is playing. That thread reads the sample data ahead of each rvoice from the file,
+ * so that the mixer never has to wait for the disk. If the mixer reaches data that
+ * has not been read yet, it counts an underrun and waits for the data to be read
+ * by the page fault.
+ *
+ * Positions are counted in sample points the rvoice has advanced through since it
+ * has been started, wrapping around and only compared by their difference, so that
+ * looping doesn't need to be known by the background thread.
+ */
+typedef struct _fluid_rvoice_stream_t fluid_rvoice_stream_t;
+typedef struct _fluid_rvoice_stream_slot_t fluid_rvoice_stream_slot_t;
+
+struct _fluid_rvoice_stream_slot_t
+{
+    fluid_rvoice_stream_t *stream;
+
+    /* published by the mixer, NULL if the rvoice doesn't play a streamed sample */
+    short *data;
+    char *data24;
+    fluid_atomic_int_t end;         /* last sample point of the sample */
+    fluid_atomic_int_t loopstart;
+    fluid_atomic_int_t loopend;
+    fluid_atomic_int_t position;    /* sample point the rvoice is playing */
+    fluid_atomic_int_t played;      /* count of sample points played, see above */
+
+    /* published by the background thread: the data up to this value of 'played' has been read */
+    fluid_atomic_int_t ready;
+
+    /* private to the mixer */
+    unsigned int mixer_played;
+    unsigned int preloaded;         /* the data up to this value of 'played' has been read on loading */
+};
+
+/* Sample points of the interpolation window beyond the current phase */
+#define FLUID_RVOICE_STREAM_MARGIN (4)
+
+fluid_rvoice_stream_t *new_fluid_rvoice_stream(int readahead);
+void delete_fluid_rvoice_stream(fluid_rvoice_stream_t *stream);
+
+fluid_rvoice_stream_slot_t *fluid_rvoice_stream_new_slot(fluid_rvoice_stream_t *stream);
+int fluid_rvoice_stream_get_underruns(fluid_rvoice_stream_t *stream);
+void fluid_rvoice_stream_underrun(fluid_rvoice_stream_t *stream);
+
+/*
+ * Called by the mixer when the rvoice has finished.
+ */
+static FLUID_INLINE void
+fluid_rvoice_stream_slot_stop(fluid_rvoice_stream_slot_t *slot)
+{
+    fluid_atomic_pointer_set(&slot->data, NULL);
+}
+
+/*
+ * Called by the mixer when the rvoice starts playing a sample, which may be NULL.
+ */
+static FLUID_INLINE void
+fluid_rvoice_stream_slot_start(fluid_rvoice_stream_slot_t *slot, fluid_sample_t *sample)
+{
+    if(sample == NULL || sample->stream_preload == 0)
+    {
+        fluid_rvoice_stream_slot_stop(slot);
+        return;
+    }
+
+    slot->preloaded = slot->mixer_played + sample->stream_preload;
+
+    fluid_atomic_int_set(&slot->ready, (int)slot->mixer_played);
+    fluid_atomic_int_set(&slot->end, (int)sample->end);
+    fluid_atomic_int_set(&slot->loopstart, (int)sample->loopstart);
+    fluid_atomic_int_set(&slot->loopend, (int)sample->loopend);
+    fluid_atomic_int_set(&slot->position, (int)sample->start);
+    fluid_atomic_int_set(&slot->played, (int)slot->mixer_played);
+    fluid_atomic_pointer_set(&slot->data24, sample->data24);
+    fluid_atomic_pointer_set(&slot->data, sample->data);
+}
+
+/*
+ * Called by the mixer before rendering a block that advances the rvoice by
+ * phase_incr sample points per output sample from position. If interpolating
+ * is FALSE, the block will not access the sample data.
+ */
+static FLUID_INLINE void
+fluid_rvoice_stream_slot_advance(fluid_rvoice_stream_slot_t *slot, int position,
+                                 fluid_real_t phase_incr, int interpolating)
+{
+    unsigned int needed, advance = (unsigned int)(phase_incr * FLUID_BUFSIZE) + 1;
+
+    fluid_atomic_int_set(&slot->position, position);
+    fluid_atomic_int_set(&slot->played, (int)slot->mixer_played);
+
+    needed = slot->mixer_played + advance + FLUID_RVOICE_STREAM_MARGIN;
+
+    if(interpolating && (int)(needed - slot->preloaded) > 0
+            && (int)(needed - (unsigned int)fluid_atomic_int_get(&slot->ready)) > 0)
+    {
+        /* the data will be read by the page fault instead */
+        fluid_rvoice_stream_underrun(slot->stream);
+    }
+
+    slot->mixer_played += advance;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_RVOICE_STREAM_H */
@@ -25,23 +25,55 @@
 #include "fluid_sys.h"
 #include "fluid_synth.h"
 #include "fluid_samplecache.h"
+#include "fluid_presetcache.h"
 #include "fluid_chan.h"
+#include "fluid_hash.h"
 
 /* EMU8k/10k hardware applies this factor to initial attenuation generator values set at preset and
  * instrument level in a soundfont. We apply this factor when loading the generator values to stay
  * compatible as most existing soundfonts expect exactly this (strange, non-standard) behaviour. */
 #define EMU_ATTENUATION_FACTOR (0.4f)
 
+/* How often the background thread of dynamic sample loading looks for samples to load */
+#define FLUID_DEFSFONT_LOADER_INTERVAL_MS (2)
+
+/* The statistics of dynamic sample loading of all SoundFonts, see fluid_sample_get_residency_stats() */
+static fluid_mutex_t residency_mutex = FLUID_MUTEX_INIT;
+static fluid_sample_residency_stats_t residency_stats;
+
+/* The smallest page size of common platforms, warming up a preset touches its data in these steps */
+#define FLUID_WARM_PAGE_SIZE (4096)
+
+/* A sample to be loaded by the background thread of dynamic sample loading */
+typedef struct
+{
+    fluid_sample_t *sample;     /* the sample of the SoundFont, only accessed by the synth */
+    fluid_sample_t loaded;      /* a copy of it, which the background thread loads the sample data into */
+    int status;                 /* FLUID_OK if the sample data has been loaded */
+} fluid_defsfont_load_job_t;
+
 /* Dynamic sample loading functions */
 static int pin_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static int unpin_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static void unload_sample(fluid_sample_t *sample);
+static void release_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample);
+static void unkeep_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample);
+static int queue_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample);
+static void cancel_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample);
+static void apply_loaded_samples(fluid_defsfont_t *defsfont);
+static int preset_samples_loaded(fluid_preset_t *preset);
+static size_t sample_mipmap_size(const fluid_sample_t *sample);
+static int sample_loader_run(void *data, unsigned int msec);
 static int dynamic_samples_preset_notify(fluid_preset_t *preset, int reason, int chan);
+static int loaded_samples_preset_notify(fluid_preset_t *preset, int reason, int chan);
+static int warm_preset(fluid_defsfont_t *defsfont, fluid_preset_t *preset);
 static int dynamic_samples_sample_notify(fluid_sample_t *sample, int reason);
-static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone);
 static fluid_inst_t *find_inst_by_idx(fluid_defsfont_t *defsfont, int idx);
+static int fluid_defsfont_import_insts(fluid_defsfont_t *defsfont, SFData *sfdata);
+static int fluid_defsfont_import_presets(fluid_defsfont_t *defsfont, SFData *sfdata);
+static int fluid_defsfont_import_sfont(fluid_defsfont_t *defsfont, SFData *sfdata);
 
 
 /***************************************************************
@@ -79,6 +111,8 @@ fluid_sfont_t *fluid_defsfloader_load(fluid_sfloader_t *loader, const char *file
 {
     fluid_defsfont_t *defsfont;
     fluid_sfont_t *sfont;
+    double trace_ref = fluid_trace_ref();
+    int ret;
 
     defsfont = new_fluid_defsfont(fluid_sfloader_get_data(loader));
 
@@ -100,10 +134,14 @@ fluid_sfont_t *fluid_defsfloader_load(fluid_sfloader_t *loader, const char *file
     }
 
     fluid_sfont_set_data(sfont, defsfont);
+    sfont->get_memory = fluid_defsfont_sfont_get_memory;
 
     defsfont->sfont = sfont;
 
-    if(fluid_defsfont_load(defsfont, &loader->file_callbacks, filename) == FLUID_FAILED)
+    ret = fluid_defsfont_load(defsfont, &loader->file_callbacks, filename);
+    fluid_trace_span("defsfont_load", trace_ref);
+
+    if(ret == FLUID_FAILED)
     {
         fluid_defsfont_sfont_delete(sfont);
         return NULL;
@@ -151,6 +189,11 @@ fluid_preset_t *fluid_defsfont_sfont_iteration_next(fluid_sfont_t *sfont)
     return fluid_defsfont_iteration_next(fluid_sfont_get_data(sfont));
 }
 
+int fluid_defsfont_sfont_get_memory(fluid_sfont_t *sfont, fluid_sfont_memory_t *usage)
+{
+    return fluid_defsfont_get_memory(fluid_sfont_get_data(sfont), usage);
+}
+
 void fluid_defpreset_preset_delete(fluid_preset_t *preset)
 {
     fluid_defsfont_t *defsfont;
@@ -162,9 +205,14 @@ void fluid_defpreset_preset_delete(fluid_preset_t *preset)
     if(defsfont)
     {
         defsfont->preset = fluid_list_remove(defsfont->preset, defpreset);
+
+        /* the index would point to the deleted preset, lookups walk the list from now on */
+        FLUID_FREE(defsfont->preset_index);
+        defsfont->preset_index = NULL;
+        defsfont->preset_index_count = 0;
     }
 
-    delete_fluid_defpreset(defpreset);
+    /* the defpreset is freed with the arena of the SoundFont */
     delete_fluid_preset(preset);
 }
 
@@ -186,6 +234,14 @@ int fluid_defpreset_preset_get_num(fluid_preset_t *preset)
 int fluid_defpreset_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth,
                                   int chan, int key, int vel)
 {
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(preset->sfont);
+
+    /* play the samples that have been loaded in the meantime */
+    if(defsfont->loader != NULL)
+    {
+        apply_loaded_samples(defsfont);
+    }
+
     return fluid_defpreset_noteon(fluid_preset_get_data(preset), synth, chan, key, vel);
 }
 
@@ -201,6 +257,8 @@ int fluid_defpreset_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth,
 fluid_defsfont_t *new_fluid_defsfont(fluid_settings_t *settings)
 {
     fluid_defsfont_t *defsfont;
+    int async = FALSE;
+    int budget = 0;
 
     defsfont = FLUID_NEW(fluid_defsfont_t);
 
@@ -212,9 +270,66 @@ fluid_defsfont_t *new_fluid_defsfont(fluid_settings_t *settings)
 
     FLUID_MEMSET(defsfont, 0, sizeof(*defsfont));
 
+    defsfont->arena = new_fluid_arena(FLUID_DEFSFONT_ARENA_BLOCK_SIZE);
+
+    if(defsfont->arena == NULL)
+    {
+        FLUID_FREE(defsfont);
+        return NULL;
+    }
+
     fluid_settings_getint(settings, "synth.lock-memory", &defsfont->mlock);
+    fluid_settings_getint(settings, "synth.huge-pages", &defsfont->huge_pages);
+    fluid_settings_getint(settings, "synth.async-io", &defsfont->async_io);
+    fluid_settings_getint(settings, "synth.sample-mmap", &defsfont->mmap_samples);
+    fluid_settings_dupstr(settings, "synth.sample-cache-dir", &defsfont->shared_cache_dir);
+    fluid_settings_dupstr(settings, "synth.preset-cache-dir", &defsfont->preset_cache_dir);
+
+    if(fluid_settings_getint(settings, "synth.sample-streaming", &defsfont->stream_preload) == FLUID_OK
+            && defsfont->stream_preload)
+    {
+        fluid_settings_getint(settings, "synth.sample-streaming-preload", &defsfont->stream_preload);
+    }
+
     fluid_settings_getint(settings, "synth.dynamic-sample-loading", &defsfont->dynamic_samples);
 
+    if(defsfont->dynamic_samples
+            && fluid_settings_getint(settings, "synth.dynamic-sample-loading-budget", &budget) == FLUID_OK)
+    {
+        defsfont->sample_budget = (size_t)budget * 1024 * 1024;
+    }
+    defsfont->float_samples = fluid_settings_str_equal(settings, "synth.sample-format", "float");
+    defsfont->compressed_samples = fluid_settings_str_equal(settings, "synth.sample-format", "compressed");
+
+    /* those load the original points whenever they are needed */
+    if(defsfont->compressed_samples && (defsfont->stream_preload || defsfont->dynamic_samples))
+    {
+        FLUID_LOG(FLUID_WARN, "Compressed samples can't be streamed or loaded dynamically, keeping them uncompressed");
+        defsfont->compressed_samples = FALSE;
+    }
+
+    fluid_settings_getint(settings, "synth.sample-mipmap-levels", &defsfont->mipmap_levels);
+
+    /* mapped data takes no memory of its own */
+    if(!defsfont->mmap_samples && !defsfont->stream_preload)
+    {
+        fluid_settings_getint(settings, "synth.sample-dedup", &defsfont->dedup_samples);
+    }
+
+    fluid_mutex_init(defsfont->loader_mutex);
+
+    if(defsfont->dynamic_samples && fluid_settings_getint(settings, "synth.dynamic-sample-loading-async", &async) == FLUID_OK
+            && async)
+    {
+        defsfont->loader = new_fluid_timer(FLUID_DEFSFONT_LOADER_INTERVAL_MS, sample_loader_run,
+                                           defsfont, TRUE, FALSE, FALSE);
+
+        if(defsfont->loader == NULL)
+        {
+            FLUID_LOG(FLUID_WARN, "Failed to create the sample loading thread, loading samples synchronously");
+        }
+    }
+
     return defsfont;
 }
 
@@ -229,6 +344,14 @@ int delete_fluid_defsfont(fluid_defsfont_t *defsfont)
 
     fluid_return_val_if_fail(defsfont != NULL, FLUID_OK);
 
+    /* Stop loading samples in the background, and take over the samples loaded so far */
+    if(defsfont->loader != NULL)
+    {
+        delete_fluid_timer(defsfont->loader);
+        defsfont->loader = NULL;
+        apply_loaded_samples(defsfont);
+    }
+
     /* If we use dynamic sample loading, make sure we unpin any
      * pinned presets before removing this soundfont */
     if(defsfont->dynamic_samples)
@@ -240,6 +363,12 @@ int delete_fluid_defsfont(fluid_defsfont_t *defsfont)
         }
     }
 
+    /* the kept samples are unloaded with the others */
+    while(defsfont->kept_samples != NULL)
+    {
+        unkeep_sample(defsfont, fluid_list_get(defsfont->kept_samples));
+    }
+
     /* Check that no samples are currently used */
     for(list = defsfont->sample; list; list = fluid_list_next(list))
     {
@@ -256,6 +385,18 @@ int delete_fluid_defsfont(fluid_defsfont_t *defsfont)
         FLUID_FREE(defsfont->filename);
     }
 
+    FLUID_FREE(defsfont->shared_cache_dir);
+    FLUID_FREE(defsfont->preset_cache_dir);
+
+    /* samples of presets that are still selected may not have been loaded yet */
+    for(list = defsfont->loader_queue; list; list = fluid_list_next(list))
+    {
+        FLUID_FREE(fluid_list_get(list));
+    }
+
+    delete_fluid_list(defsfont->loader_queue);
+    fluid_mutex_destroy(defsfont->loader_mutex);
+
     for(list = defsfont->sample; list; list = fluid_list_next(list))
     {
         sample = (fluid_sample_t *) fluid_list_get(list);
@@ -269,6 +410,10 @@ int delete_fluid_defsfont(fluid_defsfont_t *defsfont)
         {
             fluid_samplecache_unload(sample->data);
         }
+        else if ((sample->data_compressed != NULL) && (sample->data_compressed != defsfont->samplecompresseddata))
+        {
+            fluid_samplecache_unload(sample->data_compressed);
+        }
         delete_fluid_sample(sample);
     }
 
@@ -281,6 +426,10 @@ int delete_fluid_defsfont(fluid_defsfont_t *defsfont)
     {
         fluid_samplecache_unload(defsfont->sampledata);
     }
+    else if(defsfont->samplecompresseddata != NULL)
+    {
+        fluid_samplecache_unload(defsfont->samplecompresseddata);
+    }
 
     for(list = defsfont->preset; list; list = fluid_list_next(list))
     {
@@ -288,15 +437,13 @@ int delete_fluid_defsfont(fluid_defsfont_t *defsfont)
         fluid_defpreset_preset_delete(preset);
     }
 
+    FLUID_FREE(defsfont->preset_index);
     delete_fluid_list(defsfont->preset);
-
-    for(list = defsfont->inst; list; list = fluid_list_next(list))
-    {
-        delete_fluid_inst(fluid_list_get(list));
-    }
-
     delete_fluid_list(defsfont->inst);
 
+    /* frees the instruments, presets and their zones */
+    delete_fluid_arena(defsfont->arena);
+
     FLUID_FREE(defsfont);
     return FLUID_OK;
 }
@@ -309,16 +456,160 @@ const char *fluid_defsfont_get_name(fluid_defsfont_t *defsfont)
     return defsfont->filename;
 }
 
+/* Adds the memory of sample data to usage, unless it has been seen already */
+static void fluid_defsfont_add_data_memory(fluid_hashtable_t *seen, const fluid_sample_t *sample,
+        void *data, fluid_sfont_memory_t *usage)
+{
+    fluid_samplecache_memory_t memory;
+    size_t count = sample->end - sample->start + 1;
+
+    if(fluid_hashtable_lookup(seen, data) != NULL)
+    {
+        return;
+    }
+
+    fluid_hashtable_insert(seen, data, data);
+
+    if(fluid_samplecache_get_memory(data, &memory) != FLUID_OK)
+    {
+        /* not from the cache, e.g. a sample without any points */
+        memory.in_memory = (sample->data != NULL) ? count * sizeof(short) : 0;
+        memory.in_memory += (sample->data24 != NULL) ? count : 0;
+        memory.mapped = 0;
+        memory.shared = FALSE;
+    }
+
+    usage->samples += memory.in_memory;
+    usage->samples_mapped += memory.mapped;
+
+    if(memory.shared)
+    {
+        usage->samples_shared += memory.in_memory + memory.mapped;
+    }
+}
+
+/*
+ * Get the memory used by the SoundFont. The sample data is looked up in the sample cache, which
+ * tells whether other SoundFonts share it. Must be called by the synth thread, which hands the
+ * samples loaded by dynamic sample loading over to the SoundFont.
+ */
+int fluid_defsfont_get_memory(fluid_defsfont_t *defsfont, fluid_sfont_memory_t *usage)
+{
+    fluid_hashtable_t *seen;
+    fluid_sample_t *sample;
+    fluid_list_t *list;
+    void *data;
+
+    seen = new_fluid_hashtable(fluid_direct_hash, fluid_direct_equal);
+
+    if(seen == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(usage, 0, sizeof(*usage));
+
+    for(list = defsfont->sample; list != NULL; list = fluid_list_next(list))
+    {
+        sample = fluid_list_get(list);
+
+        /* the samples of an SF2 file loaded in one block share its data */
+        data = (sample->data_compressed != NULL) ? (void *)sample->data_compressed : (void *)sample->data;
+
+        if(data != NULL)
+        {
+            fluid_defsfont_add_data_memory(seen, sample, data, usage);
+        }
+
+        usage->samples += sample_mipmap_size(sample);
+        usage->metadata += sizeof(*sample) + sizeof(*list);
+    }
+
+    delete_fluid_hashtable(seen);
+
+    usage->metadata += sizeof(*defsfont) + FLUID_STRLEN(defsfont->filename) + 1
+                       + fluid_arena_get_size(defsfont->arena)
+                       + defsfont->preset_index_count * sizeof(*defsfont->preset_index);
+
+    usage->total = usage->samples + usage->samples_mapped + usage->metadata;
+
+    return FLUID_OK;
+}
+
+/* How the sample cache should get the sample data */
+static int fluid_defsfont_sample_mode(const fluid_defsfont_t *defsfont)
+{
+    if(defsfont->stream_preload)
+    {
+        return FLUID_SAMPLECACHE_STREAM;
+    }
+
+    return defsfont->mmap_samples ? FLUID_SAMPLECACHE_MAP : FLUID_SAMPLECACHE_READ;
+}
+
+/* Reads the start of a streamed sample from the file, the rest is read while the sample plays */
+static void fluid_defsfont_preload_sample(const fluid_defsfont_t *defsfont, fluid_sample_t *sample, int is_mapped)
+{
+    unsigned int count, length;
+
+    sample->stream_preload = 0;
+
+    /* floating point data is always kept in memory */
+    if(!defsfont->stream_preload || !is_mapped || sample->data == NULL || sample->data_float != NULL
+            || sample->end < sample->start)
+    {
+        return;
+    }
+
+    length = sample->end - sample->start + 1;
+    count = (length > (unsigned int)defsfont->stream_preload) ? (unsigned int)defsfont->stream_preload : length;
+
+    fluid_file_map_prefetch(sample->data + sample->start, count * sizeof(short));
+
+    if(sample->data24 != NULL)
+    {
+        fluid_file_map_prefetch(sample->data24 + sample->start, count);
+    }
+
+    /* It's okay if this fails, the streaming thread will still read the data in time */
+    if(defsfont->mlock)
+    {
+        fluid_mlock(sample->data + sample->start, count * sizeof(short));
+
+        if(sample->data24 != NULL)
+        {
+            fluid_mlock(sample->data24 + sample->start, count);
+        }
+    }
+
+    /* if all of the sample has been read, there is nothing to stream */
+    sample->stream_preload = (count < length) ? count : 0;
+}
+
+/* Creates the band-limited copies of a loaded sample, see synth.sample-mipmap-levels. The sample
+ * can still be played without them if that fails. */
+static void fluid_defsfont_build_mipmap(const fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    if(defsfont->mipmap_levels > 0)
+    {
+        fluid_sample_build_mipmap(sample, defsfont->mipmap_levels);
+    }
+}
+
 /* Load sample data for a single sample from the Soundfont file.
  * Returns FLUID_OK on error, otherwise FLUID_FAILED
  */
 int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, fluid_sample_t *sample)
 {
-    int num_samples;
+    int num_samples, is_mapped;
 
     num_samples = fluid_samplecache_load(
                       sfdata, sample->source_start, sample->source_end, sample->sampletype,
-                      defsfont->mlock, &sample->data, &sample->data24);
+                      defsfont->mlock, fluid_defsfont_sample_mode(defsfont), defsfont->shared_cache_dir,
+                      defsfont->dedup_samples,
+                      &sample->data, &sample->data24, defsfont->float_samples ? &sample->data_float : NULL,
+                      defsfont->compressed_samples ? &sample->data_compressed : NULL, &is_mapped);
 
     if(num_samples < 0)
     {
@@ -329,6 +620,7 @@ int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, f
     {
         sample->start = sample->end = 0;
         sample->loopstart = sample->loopend = 0;
+        sample->stream_preload = 0;
         return FLUID_OK;
     }
 
@@ -345,6 +637,8 @@ int fluid_defsfont_load_sampledata(fluid_defsfont_t *defsfont, SFData *sfdata, f
     sample->start = 0;
     sample->end = num_samples - 1;
 
+    fluid_defsfont_preload_sample(defsfont, sample, is_mapped);
+
     return FLUID_OK;
 }
 
@@ -357,17 +651,24 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
     fluid_list_t *list;
     fluid_sample_t *sample;
     int sf3_file = (sfdata->version.major == 3);
+    /* deduplicated samples are loaded one by one, so that identical ones can be found */
+    int individual = sf3_file || defsfont->dedup_samples;
     int sample_parsing_result = FLUID_OK;
     int invalid_loops_were_sanitized = FALSE;
+    int is_mapped = FALSE;
 
     /* For SF2 files, we load the sample data in one large block */
-    if(!sf3_file)
+    if(!individual)
     {
         int read_samples;
         int num_samples = sfdata->samplesize / sizeof(short);
 
         read_samples = fluid_samplecache_load(sfdata, 0, num_samples - 1, 0, defsfont->mlock,
-                                              &defsfont->sampledata, &defsfont->sample24data);
+                                              fluid_defsfont_sample_mode(defsfont), defsfont->shared_cache_dir, FALSE,
+                                              &defsfont->sampledata, &defsfont->sample24data,
+                                              defsfont->float_samples ? &defsfont->samplefloatdata : NULL,
+                                              defsfont->compressed_samples ? &defsfont->samplecompresseddata : NULL,
+                                              &is_mapped);
 
         if(read_samples != num_samples)
         {
@@ -383,7 +684,7 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
     {
         sample = fluid_list_get(list);
 
-        if(sf3_file)
+        if(individual)
         {
             /* SF3 samples get loaded individually, as most (or all) of them are in Ogg Vorbis format
              * anyway */
@@ -408,17 +709,21 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
                         }
                     }
                     fluid_voice_optimize_sample(sample);
+                    fluid_defsfont_build_mipmap(defsfont, sample);
                 }
             }
         }
         else
         {
-            #pragma omp task firstprivate(sample, defsfont) shared(invalid_loops_were_sanitized) default(none)
+            #pragma omp task firstprivate(sample, defsfont, is_mapped) shared(invalid_loops_were_sanitized) default(none)
             {
                 int modified;
                 /* Data pointers of SF2 samples point to large sample data block loaded above */
                 sample->data = defsfont->sampledata;
                 sample->data24 = defsfont->sample24data;
+                sample->data_float = defsfont->samplefloatdata;
+                sample->data_compressed = defsfont->samplecompresseddata;
+                fluid_defsfont_preload_sample(defsfont, sample, is_mapped);
                 modified = fluid_sample_sanitize_loop(sample, defsfont->samplesize);
                 if(modified)
                 {
@@ -428,6 +733,7 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
                     }
                 }
                 fluid_voice_optimize_sample(sample);
+                fluid_defsfont_build_mipmap(defsfont, sample);
             }
         }
     }
@@ -444,64 +750,34 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
 
 // declared here so it can be used for default modulators in fluid_defsfont_load
 static int
-fluid_mod_import_sfont(fluid_mod_t **mod, fluid_list_t *sfmod);
+fluid_mod_import_sfont(fluid_arena_t *arena, fluid_mod_t **mod, fluid_list_t *sfmod);
 
-/*
- * fluid_defsfont_load
- */
-int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t *fcbs, const char *file)
+/* Parses the HYDRA chunk of a SoundFont, and imports its default modulators,
+ * samples, instruments and presets */
+static int fluid_defsfont_import_sfont(fluid_defsfont_t *defsfont, SFData *sfdata)
 {
-    SFData *sfdata;
     fluid_list_t *p;
     fluid_list_t *dmod_data;
-    SFPreset *sfpreset;
     SFSample *sfsample;
     fluid_sample_t *sample;
-    fluid_defpreset_t *defpreset = NULL;
-
-    defsfont->filename = FLUID_STRDUP(file);
-
-    if(defsfont->filename == NULL)
-    {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return FLUID_FAILED;
-    }
-
-    defsfont->fcbs = *fcbs;
-
-    /* The actual loading is done in the sfont and sffile files */
-    sfdata = fluid_sffile_open(file, &defsfont->fcbs);
-
-    if(sfdata == NULL)
-    {
-        /* error message already printed */
-        return FLUID_FAILED;
-    }
 
     if(fluid_sffile_parse_presets(sfdata) == FLUID_FAILED)
     {
         FLUID_LOG(FLUID_ERR, "Couldn't parse presets from soundfont file");
-        goto err_exit;
+        return FLUID_FAILED;
     }
 
     dmod_data = sfdata->default_mod_list;
     if (dmod_data != NULL)
     {
         /* Load the default modulators*/
-        if (fluid_mod_import_sfont(&defsfont->sfont->default_mod_list, dmod_data) != FLUID_OK)
+        if (fluid_mod_import_sfont(NULL, &defsfont->sfont->default_mod_list, dmod_data) != FLUID_OK)
         {
             FLUID_LOG(FLUID_ERR, "Unable to load the default modulators");
-            goto err_exit;
+            return FLUID_FAILED;
         }
     }
 
-    /* Keep track of the position and size of the sample data because
-       it's loaded separately (and might be unoaded/reloaded in future) */
-    defsfont->samplepos = sfdata->samplepos;
-    defsfont->samplesize = sfdata->samplesize;
-    defsfont->sample24pos = sfdata->sample24pos;
-    defsfont->sample24size = sfdata->sample24size;
-
     /* Create all samples from sample headers */
     p = sfdata->sample;
 
@@ -513,7 +789,7 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
 
         if(sample == NULL)
         {
-            goto err_exit;
+            return FLUID_FAILED;
         }
 
         if(fluid_sample_import_sfont(sample, sfsample, defsfont) == FLUID_OK)
@@ -532,40 +808,87 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
         p = fluid_list_next(p);
     }
 
-    /* If dynamic sample loading is disabled, load all samples in the Soundfont */
-    if(!defsfont->dynamic_samples)
+    /* Load all the instruments used by presets, then all the presets */
+    if(fluid_defsfont_import_insts(defsfont, sfdata) == FLUID_FAILED
+            || fluid_defsfont_import_presets(defsfont, sfdata) == FLUID_FAILED)
     {
-        if(fluid_defsfont_load_all_sampledata(defsfont, sfdata) == FLUID_FAILED)
-        {
-            FLUID_LOG(FLUID_ERR, "Unable to load all sample data");
-            goto err_exit;
-        }
+        return FLUID_FAILED;
     }
 
-    /* Load all the presets */
-    p = sfdata->preset;
+    return FLUID_OK;
+}
 
-    while(p != NULL)
+/*
+ * fluid_defsfont_load
+ */
+int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t *fcbs, const char *file)
+{
+    SFData *sfdata;
+    double trace_ref;
+
+    defsfont->filename = FLUID_STRDUP(file);
+
+    if(defsfont->filename == NULL)
     {
-        sfpreset = (SFPreset *)fluid_list_get(p);
-        defpreset = new_fluid_defpreset();
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    defsfont->fcbs = *fcbs;
+
+    /* The actual loading is done in the sfont and sffile files */
+    trace_ref = fluid_trace_ref();
+    sfdata = fluid_sffile_open(file, &defsfont->fcbs);
+    fluid_trace_span("sffile_open", trace_ref);
+
+    if(sfdata == NULL)
+    {
+        /* error message already printed */
+        return FLUID_FAILED;
+    }
+
+    sfdata->huge_pages = defsfont->huge_pages;
+    sfdata->async_io = defsfont->async_io;
+
+    /* Keep track of the position and size of the sample data because
+       it's loaded separately (and might be unoaded/reloaded in future) */
+    defsfont->samplepos = sfdata->samplepos;
+    defsfont->samplesize = sfdata->samplesize;
+    defsfont->sample24pos = sfdata->sample24pos;
+    defsfont->sample24size = sfdata->sample24size;
 
-        if(defpreset == NULL)
+    /* Presets imported before from the same SoundFont don't need to be parsed again */
+    trace_ref = fluid_trace_ref();
+
+    if(defsfont->preset_cache_dir == NULL || defsfont->preset_cache_dir[0] == '\0'
+            || fluid_presetcache_load(defsfont, sfdata, defsfont->preset_cache_dir) != FLUID_OK)
+    {
+        if(fluid_defsfont_import_sfont(defsfont, sfdata) == FLUID_FAILED)
         {
             goto err_exit;
         }
 
-        if(fluid_defpreset_import_sfont(defpreset, sfpreset, defsfont, sfdata) != FLUID_OK)
+        if(defsfont->preset_cache_dir != NULL && defsfont->preset_cache_dir[0] != '\0')
         {
-            goto err_exit;
+            fluid_presetcache_store(defsfont, sfdata, defsfont->preset_cache_dir);
         }
+    }
+
+    fluid_defsfont_build_preset_index(defsfont);
+    fluid_trace_span("defsfont_import", trace_ref);
+
+    /* If dynamic sample loading is disabled, load all samples in the Soundfont */
+    if(!defsfont->dynamic_samples)
+    {
+        trace_ref = fluid_trace_ref();
 
-        if(fluid_defsfont_add_preset(defsfont, defpreset) == FLUID_FAILED)
+        if(fluid_defsfont_load_all_sampledata(defsfont, sfdata) == FLUID_FAILED)
         {
+            FLUID_LOG(FLUID_ERR, "Unable to load all sample data");
             goto err_exit;
         }
 
-        p = fluid_list_next(p);
+        fluid_trace_span("load_sampledata", trace_ref);
     }
 
     fluid_sffile_close(sfdata);
@@ -574,36 +897,221 @@ int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t
 
 err_exit:
     fluid_sffile_close(sfdata);
-    delete_fluid_defpreset(defpreset);
     return FLUID_FAILED;
 }
 
-/* fluid_defsfont_add_sample
- *
- * Add a sample to the SoundFont
- */
-int fluid_defsfont_add_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+/* Returns the index of the instrument referenced by a preset zone, -1 for a global zone */
+static int fluid_defsfont_get_zone_inst_idx(SFZone *sfzone)
 {
-    defsfont->sample = fluid_list_prepend(defsfont->sample, sample);
-    return FLUID_OK;
+    fluid_list_t *list;
+    SFGen *sfgen;
+    int inst_idx = -1;
+
+    for(list = sfzone->gen; list; list = fluid_list_next(list))
+    {
+        sfgen = fluid_list_get(list);
+
+        if(sfgen->id == GEN_INSTRUMENT)
+        {
+            inst_idx = sfgen->amount.uword;
+        }
+    }
+
+    return inst_idx;
 }
 
-/* fluid_defsfont_add_preset
- *
- * Add a preset to the SoundFont
- */
-int fluid_defsfont_add_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *defpreset)
+/* Imports the instruments used by any preset zone. The instruments are independent of
+ * each other, so they get imported in parallel. */
+static int fluid_defsfont_import_insts(fluid_defsfont_t *defsfont, SFData *sfdata)
 {
-    fluid_preset_t *preset;
+    fluid_list_t *p, *z;
+    SFInst *sfinst, **sfinsts;
+    fluid_inst_t **insts;
+    char *used;
+    int i, count = 0, result = FLUID_OK;
 
-    preset = new_fluid_preset(defsfont->sfont,
-                              fluid_defpreset_preset_get_name,
-                              fluid_defpreset_preset_get_banknum,
-                              fluid_defpreset_preset_get_num,
-                              fluid_defpreset_preset_noteon,
-                              fluid_defpreset_preset_delete);
-
-    if(preset == NULL)
+    for(p = sfdata->inst; p; p = fluid_list_next(p))
+    {
+        sfinst = fluid_list_get(p);
+
+        if(sfinst->idx >= count)
+        {
+            count = sfinst->idx + 1;
+        }
+    }
+
+    if(count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    /* the instruments by index, and whether they are used by a preset */
+    sfinsts = FLUID_ARRAY(SFInst *, count);
+    insts = FLUID_ARRAY(fluid_inst_t *, count);
+    used = FLUID_ARRAY(char, count);
+
+    if(sfinsts == NULL || insts == NULL || used == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(sfinsts);
+        FLUID_FREE(insts);
+        FLUID_FREE(used);
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(sfinsts, 0, count * sizeof(*sfinsts));
+    FLUID_MEMSET(insts, 0, count * sizeof(*insts));
+    FLUID_MEMSET(used, 0, count);
+
+    for(p = sfdata->inst; p; p = fluid_list_next(p))
+    {
+        sfinst = fluid_list_get(p);
+        sfinsts[sfinst->idx] = sfinst;
+    }
+
+    for(p = sfdata->preset; p; p = fluid_list_next(p))
+    {
+        for(z = ((SFPreset *)fluid_list_get(p))->zone; z; z = fluid_list_next(z))
+        {
+            i = fluid_defsfont_get_zone_inst_idx(fluid_list_get(z));
+
+            if(i >= 0 && i < count)
+            {
+                used[i] = TRUE;
+            }
+        }
+    }
+
+    #pragma omp parallel
+    #pragma omp single
+    for(i = 0; i < count; i++)
+    {
+        /* references to instruments that don't exist fail when importing the presets */
+        if(!used[i] || sfinsts[i] == NULL)
+        {
+            continue;
+        }
+
+        #pragma omp task firstprivate(i, defsfont, sfdata) shared(sfinsts, insts, result) default(none)
+        {
+            insts[i] = fluid_inst_import_sfont(sfinsts[i], defsfont, sfdata);
+
+            if(insts[i] == NULL)
+            {
+                #pragma omp critical
+                {
+                    result = FLUID_FAILED;
+                }
+            }
+        }
+    }
+
+    /* keep the instruments in the order of the file */
+    for(i = 0; i < count; i++)
+    {
+        if(insts[i] != NULL)
+        {
+            defsfont->inst = fluid_list_append(defsfont->inst, insts[i]);
+        }
+    }
+
+    FLUID_FREE(sfinsts);
+    FLUID_FREE(insts);
+    FLUID_FREE(used);
+
+    return result;
+}
+
+/* Imports all presets, after their instruments have been imported. The presets only
+ * read the instruments, so they get imported in parallel. */
+static int fluid_defsfont_import_presets(fluid_defsfont_t *defsfont, SFData *sfdata)
+{
+    fluid_list_t *p;
+    SFPreset *sfpreset;
+    fluid_defpreset_t **defpresets;
+    int i, count, result = FLUID_OK;
+
+    count = fluid_list_size(sfdata->preset);
+
+    if(count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    defpresets = FLUID_ARRAY(fluid_defpreset_t *, count);
+
+    if(defpresets == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(defpresets, 0, count * sizeof(*defpresets));
+
+    #pragma omp parallel
+    #pragma omp single
+    for(i = 0, p = sfdata->preset; p; i++, p = fluid_list_next(p))
+    {
+        sfpreset = fluid_list_get(p);
+
+        #pragma omp task firstprivate(i, sfpreset, defsfont, sfdata) shared(defpresets, result) default(none)
+        {
+            fluid_defpreset_t *defpreset = new_fluid_defpreset(defsfont->arena);
+
+            if(defpreset != NULL && fluid_defpreset_import_sfont(defpreset, sfpreset, defsfont, sfdata) == FLUID_OK)
+            {
+                defpresets[i] = defpreset;
+            }
+            else
+            {
+                #pragma omp critical
+                {
+                    result = FLUID_FAILED;
+                }
+            }
+        }
+    }
+
+    /* keep the presets in the order of the file, the ones not added are freed with the arena */
+    for(i = 0; i < count && result == FLUID_OK; i++)
+    {
+        if(defpresets[i] != NULL && fluid_defsfont_add_preset(defsfont, defpresets[i]) == FLUID_FAILED)
+        {
+            result = FLUID_FAILED;
+        }
+    }
+
+    FLUID_FREE(defpresets);
+
+    return result;
+}
+
+/* fluid_defsfont_add_sample
+ *
+ * Add a sample to the SoundFont
+ */
+int fluid_defsfont_add_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    defsfont->sample = fluid_list_prepend(defsfont->sample, sample);
+    return FLUID_OK;
+}
+
+/* fluid_defsfont_add_preset
+ *
+ * Add a preset to the SoundFont
+ */
+int fluid_defsfont_add_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *defpreset)
+{
+    fluid_preset_t *preset;
+
+    preset = new_fluid_preset(defsfont->sfont,
+                              fluid_defpreset_preset_get_name,
+                              fluid_defpreset_preset_get_banknum,
+                              fluid_defpreset_preset_get_num,
+                              fluid_defpreset_preset_noteon,
+                              fluid_defpreset_preset_delete);
+
+    if(preset == NULL)
     {
         return FLUID_FAILED;
     }
@@ -612,6 +1120,10 @@ int fluid_defsfont_add_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *def
     {
         preset->notify = dynamic_samples_preset_notify;
     }
+    else
+    {
+        preset->notify = loaded_samples_preset_notify;
+    }
 
     fluid_preset_set_data(preset, defpreset);
 
@@ -620,6 +1132,75 @@ int fluid_defsfont_add_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *def
     return FLUID_OK;
 }
 
+/* Compares two entries of the preset index by bank and program, then by their position in
+ * the list of presets */
+static int fluid_defsfont_preset_index_compare(const void *a, const void *b)
+{
+    const fluid_defsfont_preset_key_t *key_a = a;
+    const fluid_defsfont_preset_key_t *key_b = b;
+
+    if(key_a->key != key_b->key)
+    {
+        return (key_a->key < key_b->key) ? -1 : 1;
+    }
+
+    return (key_a->pos < key_b->pos) ? -1 : (key_a->pos > key_b->pos);
+}
+
+/*
+ * Builds the index of the presets sorted by bank and program, which lets
+ * fluid_defsfont_get_preset() find a preset by binary search instead of walking the list.
+ * Of several presets with the same bank and program, only the first one in the list is
+ * indexed, as walking the list would find that one. Called once the presets have been
+ * loaded. If the index can't be built, the lookups walk the list.
+ */
+void fluid_defsfont_build_preset_index(fluid_defsfont_t *defsfont)
+{
+    fluid_defsfont_preset_key_t *index;
+    fluid_preset_t *preset;
+    fluid_list_t *list;
+    int i, n, count = fluid_list_size(defsfont->preset);
+
+    FLUID_FREE(defsfont->preset_index);
+    defsfont->preset_index = NULL;
+    defsfont->preset_index_count = 0;
+
+    if(count == 0)
+    {
+        return;
+    }
+
+    index = FLUID_ARRAY(fluid_defsfont_preset_key_t, count);
+
+    if(index == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "Out of memory, looking up presets without an index");
+        return;
+    }
+
+    for(list = defsfont->preset, i = 0; list != NULL; list = fluid_list_next(list), i++)
+    {
+        preset = (fluid_preset_t *)fluid_list_get(list);
+        index[i].key = FLUID_DEFSFONT_PRESET_KEY(fluid_preset_get_banknum(preset), fluid_preset_get_num(preset));
+        index[i].pos = i;
+        index[i].preset = preset;
+    }
+
+    qsort(index, count, sizeof(*index), fluid_defsfont_preset_index_compare);
+
+    /* drop all but the first of the presets with the same key */
+    for(i = 1, n = 1; i < count; i++)
+    {
+        if(index[i].key != index[n - 1].key)
+        {
+            index[n++] = index[i];
+        }
+    }
+
+    defsfont->preset_index = index;
+    defsfont->preset_index_count = n;
+}
+
 /*
  * fluid_defsfont_get_preset
  */
@@ -628,6 +1209,33 @@ fluid_preset_t *fluid_defsfont_get_preset(fluid_defsfont_t *defsfont, int bank,
     fluid_preset_t *preset;
     fluid_list_t *list;
 
+    if(defsfont->preset_index != NULL)
+    {
+        int key = FLUID_DEFSFONT_PRESET_KEY(bank, num);
+        int lo = 0, hi = defsfont->preset_index_count - 1;
+
+        while(lo <= hi)
+        {
+            int mid = lo + (hi - lo) / 2;
+
+            if(defsfont->preset_index[mid].key == key)
+            {
+                return defsfont->preset_index[mid].preset;
+            }
+
+            if(defsfont->preset_index[mid].key < key)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid - 1;
+            }
+        }
+
+        return NULL;
+    }
+
     for(list = defsfont->preset; list != NULL; list = fluid_list_next(list))
     {
         preset = (fluid_preset_t *)fluid_list_get(list);
@@ -670,13 +1278,12 @@ fluid_preset_t *fluid_defsfont_iteration_next(fluid_defsfont_t *defsfont)
  * new_fluid_defpreset
  */
 fluid_defpreset_t *
-new_fluid_defpreset(void)
+new_fluid_defpreset(fluid_arena_t *arena)
 {
-    fluid_defpreset_t *defpreset = FLUID_NEW(fluid_defpreset_t);
+    fluid_defpreset_t *defpreset = FLUID_ARENA_NEW(arena, fluid_defpreset_t);
 
     if(defpreset == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
@@ -687,34 +1294,11 @@ new_fluid_defpreset(void)
     defpreset->global_zone = NULL;
     defpreset->zone = NULL;
     defpreset->pinned = FALSE;
+    defpreset->arena = arena;
+    defpreset->key_zones = NULL;
     return defpreset;
 }
 
-/*
- * delete_fluid_defpreset
- */
-void
-delete_fluid_defpreset(fluid_defpreset_t *defpreset)
-{
-    fluid_preset_zone_t *zone;
-
-    fluid_return_if_fail(defpreset != NULL);
-
-    delete_fluid_preset_zone(defpreset->global_zone);
-    defpreset->global_zone = NULL;
-
-    zone = defpreset->zone;
-
-    while(zone != NULL)
-    {
-        defpreset->zone = zone->next;
-        delete_fluid_preset_zone(zone);
-        zone = defpreset->zone;
-    }
-
-    FLUID_FREE(defpreset);
-}
-
 int
 fluid_defpreset_get_banknum(fluid_defpreset_t *defpreset)
 {
@@ -743,28 +1327,19 @@ fluid_defpreset_next(fluid_defpreset_t *defpreset)
 }
 
 /*
- * Adds global and local modulators list to the voice. This is done in 2 steps:
- * - Step 1: Local modulators replace identical global modulators.
- * - Step 2: global + local modulators are added to the voice using mode.
+ * Merges the global and local modulators lists of a zone, the first step of adding
+ * them to a voice: local modulators replace identical global modulators.
+ * Done once at load time, see fluid_voice_zone_merge().
  *
- * Instrument zone list (local/global) must be added using FLUID_VOICE_OVERWRITE.
- * Preset zone list (local/global) must be added using FLUID_VOICE_ADD.
- *
- * @param voice voice instance.
+ * @param mod_list receives the local and the remaining global modulators.
  * @param global_mod global list of modulators.
  * @param local_mod local list of modulators.
- * @param mode Determines how to handle an existing identical modulator.
- *   #FLUID_VOICE_ADD to add (offset) the modulator amounts,
- *   #FLUID_VOICE_OVERWRITE to replace the modulator,
+ * @return the number of modulators in mod_list.
 */
-static void
-fluid_defpreset_noteon_add_mod_to_voice(fluid_voice_t *voice,
-                                        fluid_mod_t *global_mod, fluid_mod_t *local_mod,
-                                        int mode)
+static int
+fluid_zone_merge_mods(fluid_mod_t *mod_list[FLUID_NUM_MOD],
+                      fluid_mod_t *global_mod, fluid_mod_t *local_mod)
 {
-    fluid_mod_t *mod;
-    /* list for 'sorting' global/local modulators */
-    fluid_mod_t *mod_list[FLUID_NUM_MOD];
     int mod_list_count, i;
 
     /* identity_limit_count is the modulator upper limit number to handle with
@@ -772,13 +1347,10 @@ fluid_defpreset_noteon_add_mod_to_voice(fluid_voice_t *voice,
      * When identity_limit_count is below the actual number of modulators, this
      * will restrict identity check to this upper limit,
      * This is useful when we know by advance that there is no duplicate with
-     * modulators at index above this limit. This avoid wasting cpu cycles at
-     * noteon.
+     * modulators at index above this limit.
      */
     int identity_limit_count;
 
-    /* Step 1: Local modulators replace identical global modulators. */
-
     /* local (instrument zone/preset zone), modulators: Put them all into a list. */
     mod_list_count = 0;
 
@@ -844,7 +1416,29 @@ fluid_defpreset_noteon_add_mod_to_voice(fluid_voice_t *voice,
         global_mod = global_mod->next;
     }
 
-    /* Step 2: global + local modulators are added to the voice using mode. */
+    return mod_list_count;
+}
+
+/*
+ * Adds the merged global and local modulators of a zone to the voice, the second
+ * step after fluid_zone_merge_mods().
+ *
+ * Instrument zone list (local/global) must be added using FLUID_VOICE_OVERWRITE.
+ * Preset zone list (local/global) must be added using FLUID_VOICE_ADD.
+ *
+ * @param voice voice instance.
+ * @param mod_list merged list of modulators.
+ * @param mod_list_count number of modulators in mod_list.
+ * @param mode Determines how to handle an existing identical modulator.
+ *   #FLUID_VOICE_ADD to add (offset) the modulator amounts,
+ *   #FLUID_VOICE_OVERWRITE to replace the modulator,
+*/
+static void
+fluid_defpreset_noteon_add_mod_to_voice(fluid_voice_t *voice,
+                                        fluid_mod_t **mod_list, int mod_list_count,
+                                        int mode)
+{
+    int i;
 
     /*
      * mod_list contains local and global modulators, we know that:
@@ -856,25 +1450,159 @@ fluid_defpreset_noteon_add_mod_to_voice(fluid_voice_t *voice,
 
     /* Restrict identity check to the actual number of voice modulators */
     /* Actual number of voice modulators : defaults + [instruments] */
-    identity_limit_count = voice->mod_count;
+    int identity_limit_count = voice->mod_count;
 
     for(i = 0; i < mod_list_count; i++)
     {
+        /* Instrument modulators -supersede- existing (default) modulators.
+           SF 2.01 page 69, 'bullet' 6 */
+
+        /* Preset modulators -add- to existing instrument modulators.
+           SF2.01 page 70 first bullet on page */
+        fluid_voice_add_mod_local(voice, mod_list[i], mode, identity_limit_count);
+    }
+}
+
+/*
+ * Merges mod into the modulators mods[0] to mods[count - 1] the way
+ * fluid_voice_add_mod_local() adds it to a voice.
+ * @return the new count, -1 if mods is full
+ */
+static int
+fluid_defpreset_merge_mod(fluid_mod_t *mods, int count, int size,
+                          const fluid_mod_t *mod, int mode, int identity_limit_count)
+{
+    int i;
+
+    for(i = 0; i < identity_limit_count; i++)
+    {
+        if(fluid_mod_test_identity(&mods[i], mod))
+        {
+            if(mode == FLUID_VOICE_ADD)
+            {
+                mods[i].amount += mod->amount;
+            }
+            else
+            {
+                mods[i].amount = mod->amount;
+            }
+
+            return count;
+        }
+    }
+
+    if(count >= size)
+    {
+        return -1;
+    }
+
+    fluid_mod_clone(&mods[count], mod);
+    mods[count].next = NULL;
+    return count + 1;
+}
+
+/*
+ * Returns the modulators a voice of the voice zone gets on the channel: the default
+ * modulators merged with the instrument and the preset modulators. They are merged once
+ * and kept on the voice zone until the default modulators change, the voices share them
+ * (see fluid_voice_set_shared_mods()).
+ * @return NULL if they can't be merged in advance, the voice zone modulators have to be
+ *   added to the voice one by one then.
+ */
+static fluid_voice_mods_t *
+fluid_defpreset_noteon_get_mods(fluid_defpreset_t *defpreset, fluid_voice_zone_t *voice_zone,
+                                fluid_synth_t *synth, int chan)
+{
+    fluid_voice_mods_t *mods;
+    fluid_mod_t *default_mod, *mod;
+    unsigned int generation;
+    int i, n, size, identity_limit_count;
+
+    if(!fluid_synth_get_default_mods_LOCAL(synth, voice_zone->inst_zone->sample, chan,
+                                           &default_mod, &generation))
+    {
+        return NULL;
+    }
+
+    if(voice_zone->merged != NULL && voice_zone->merged_generation == generation)
+    {
+        return voice_zone->merged;
+    }
+
+    for(mod = default_mod, size = 0; mod != NULL; mod = mod->next)
+    {
+        size++;
+    }
+
+    size += voice_zone->mod_overwrite_count + voice_zone->mod_add_count;
 
-        mod = mod_list[i];
-        /* in mode FLUID_VOICE_OVERWRITE disabled instruments modulators CANNOT be skipped. */
-        /* in mode FLUID_VOICE_ADD disabled preset modulators can be skipped. */
+    /* more than a voice takes, leave the warning to fluid_voice_add_mod_local() */
+    if(size > FLUID_NUM_MOD)
+    {
+        return NULL;
+    }
 
-        if((mode == FLUID_VOICE_OVERWRITE) || (mod->amount != 0))
+    /* the voices still playing keep the modulators they started with, so merge them
+     * into a list no voice uses. The arena only frees with the SoundFont, the lists are
+     * reused instead. */
+    for(mods = voice_zone->merged_list; mods != NULL; mods = mods->next)
+    {
+        if(fluid_atomic_int_get(&mods->refcount) == 0 && mods->size >= size)
         {
-            /* Instrument modulators -supersede- existing (default) modulators.
-               SF 2.01 page 69, 'bullet' 6 */
+            break;
+        }
+    }
+
+    if(mods == NULL)
+    {
+        mods = FLUID_ARENA_NEW(defpreset->arena, fluid_voice_mods_t);
+        mod = fluid_arena_alloc(defpreset->arena, size * sizeof(fluid_mod_t));
 
-            /* Preset modulators -add- to existing instrument modulators.
-               SF2.01 page 70 first bullet on page */
-            fluid_voice_add_mod_local(voice, mod, mode, identity_limit_count);
+        if(mods == NULL || mod == NULL)
+        {
+            return NULL;
         }
+
+        fluid_atomic_int_set(&mods->refcount, 0);
+        mods->size = size;
+        mods->mod = mod;
+        mods->next = voice_zone->merged_list;
+        voice_zone->merged_list = mods;
+    }
+
+    mod = mods->mod;
+
+    /* the default modulators are added without looking for identical ones */
+    for(n = 0; default_mod != NULL; default_mod = default_mod->next)
+    {
+        fluid_mod_clone(&mod[n], default_mod);
+        mod[n++].next = NULL;
+    }
+
+    /* as in fluid_defpreset_noteon_add_mod_to_voice() */
+    identity_limit_count = n;
+
+    for(i = 0; i < voice_zone->mod_overwrite_count; i++)
+    {
+        n = fluid_defpreset_merge_mod(mod, n, size, voice_zone->mod[i],
+                                      FLUID_VOICE_OVERWRITE, identity_limit_count);
     }
+
+    identity_limit_count = n;
+
+    for(; i < voice_zone->mod_overwrite_count + voice_zone->mod_add_count; i++)
+    {
+        n = fluid_defpreset_merge_mod(mod, n, size, voice_zone->mod[i],
+                                      FLUID_VOICE_ADD, identity_limit_count);
+    }
+
+    mods->count = n;
+    fluid_voice_mods_link(mods);
+
+    voice_zone->merged = mods;
+    voice_zone->merged_generation = generation;
+
+    return mods;
 }
 
 /*
@@ -883,14 +1611,12 @@ fluid_defpreset_noteon_add_mod_to_voice(fluid_voice_t *voice,
 int
 fluid_defpreset_noteon(fluid_defpreset_t *defpreset, fluid_synth_t *synth, int chan, int key, int vel)
 {
-    fluid_preset_zone_t *preset_zone, *global_preset_zone;
-    fluid_inst_t *inst;
-    fluid_inst_zone_t *inst_zone, *global_inst_zone;
+    fluid_inst_zone_t *inst_zone;
     fluid_voice_zone_t *voice_zone;
-    fluid_list_t *list;
     fluid_voice_t *voice;
-    int tuned_key;
-    int i;
+    fluid_voice_mods_t *merged_mods;
+    int tuned_key, index;
+    int i, z;
 
     /* For detuned channels it might be better to use another key for Soundfont sample selection
      * giving better approximations for the pitch than the original key.
@@ -909,148 +1635,99 @@ fluid_defpreset_noteon(fluid_defpreset_t *defpreset, fluid_synth_t *synth, int c
         tuned_key = key;
     }
 
-    global_preset_zone = fluid_defpreset_get_global_zone(defpreset);
-
-    /* run thru all the zones of this preset */
-    preset_zone = fluid_defpreset_get_zone(defpreset);
+    /* run thru the voice zones of all preset zones that could start a voice for this key */
+    index = (tuned_key >= 0 && tuned_key < 128) ? tuned_key : 128;
 
-    while(preset_zone != NULL)
+    for(z = defpreset->key_zone_index[index]; z < defpreset->key_zone_index[index + 1]; z++)
     {
+        voice_zone = defpreset->key_zones[z];
 
-        /* check if the note falls into the key and velocity range of this
-           preset */
-        if(fluid_zone_inside_range(&preset_zone->range, tuned_key, vel))
+        /* check if the instrument zone is ignored and the note falls into
+           the key and velocity range of this preset zone and instrument zone.
+           An instrument zone must be ignored when its voice is already running
+           played by a legato passage (see fluid_synth_noteon_monopoly_legato()) */
+        if(fluid_zone_inside_range(&voice_zone->range, tuned_key, vel))
         {
+            inst_zone = voice_zone->inst_zone;
 
-            inst = fluid_preset_zone_get_inst(preset_zone);
-            global_inst_zone = fluid_inst_get_global_zone(inst);
-
-            /* run thru all the zones of this instrument that could start a voice */
-            for(list = preset_zone->voice_zone; list != NULL; list = fluid_list_next(list))
+            /* voices of samples still being loaded in the background are dropped */
+            if(inst_zone->sample->loading)
             {
-                voice_zone = fluid_list_get(list);
-
-                /* check if the instrument zone is ignored and the note falls into
-                   the key and velocity range of this  instrument zone.
-                   An instrument zone must be ignored when its voice is already running
-                   played by a legato passage (see fluid_synth_noteon_monopoly_legato()) */
-                if(fluid_zone_inside_range(&voice_zone->range, tuned_key, vel))
-                {
-
-                    inst_zone = voice_zone->inst_zone;
+                continue;
+            }
 
-                    /* this is a good zone. allocate a new synthesis process and initialize it */
-                    voice = fluid_synth_alloc_voice_LOCAL(synth, inst_zone->sample, chan, key, vel, &voice_zone->range);
-
-                    if(voice == NULL)
-                    {
-                        return FLUID_FAILED;
-                    }
+            /* this is a good zone. allocate a new synthesis process and initialize it */
+            merged_mods = fluid_defpreset_noteon_get_mods(defpreset, voice_zone, synth, chan);
+            voice = fluid_synth_alloc_voice_LOCAL(synth, inst_zone->sample, chan, key, vel, &voice_zone->range,
+                                                  merged_mods == NULL);
 
+            if(voice == NULL)
+            {
+                return FLUID_FAILED;
+            }
 
-                    /* Instrument level, generators */
+            /* the default, instrument and preset modulators, already merged */
+            if(merged_mods != NULL)
+            {
+                fluid_voice_set_shared_mods(voice, merged_mods);
+            }
 
-                    for(i = 0; i < GEN_LAST; i++)
-                    {
-                        /* SF 2.01 section 9.4 'bullet' 4:
-                         *
-                         * A generator in a local instrument zone supersedes a
-                         * global instrument zone generator.  Both cases supersede
-                         * the default generator -> voice_gen_set */
+            /* Instrument level: the generators of the local instrument zone
+             * supersede those of the global instrument zone, and both cases
+             * supersede the default generator -> voice_gen_set
+             * (SF 2.01 section 9.4 'bullet' 4) */
+            for(i = 0; i < voice_zone->gen_set_count; i++)
+            {
+                fluid_voice_gen_set(voice, voice_zone->gen_num[i], voice_zone->gen_val[i]);
+            }
 
-                        if(inst_zone->gen[i].flags)
-                        {
-                            fluid_voice_gen_set(voice, i, inst_zone->gen[i].val);
+            /* Adds instrument zone modulators (global and local) to the voice.*/
+            if(merged_mods == NULL)
+            {
+                fluid_defpreset_noteon_add_mod_to_voice(voice, voice_zone->mod,
+                                                        voice_zone->mod_overwrite_count,
+                                                        FLUID_VOICE_OVERWRITE); /* mode */
+            }
 
-                        }
-                        else if((global_inst_zone != NULL) && (global_inst_zone->gen[i].flags))
-                        {
-                            fluid_voice_gen_set(voice, i, global_inst_zone->gen[i].val);
+            /* Preset level: the generators of the local preset zone supersede
+             * those of the global preset zone. The effect is -added- to the
+             * destination summing node -> voice_gen_incr
+             * (SF 2.01 section 9.4 'bullet' 9) */
+            for(; i < voice_zone->gen_set_count + voice_zone->gen_incr_count; i++)
+            {
+                fluid_voice_gen_incr(voice, voice_zone->gen_num[i], voice_zone->gen_val[i]);
+            }
 
-                        }
-                        else
-                        {
-                            /* The generator has not been defined in this instrument.
-                             * Do nothing, leave it at the default.
-                             */
-                        }
-                    } /* for all generators */
+            /* ...unless the default value has been overridden by an AWE32 NRPN */
+            for(i = 0; i < GEN_LAST; i++)
+            {
+                fluid_real_t awe_val;
 
-                    /* Adds instrument zone modulators (global and local) to the voice.*/
-                    fluid_defpreset_noteon_add_mod_to_voice(voice,
-                                                            /* global instrument modulators */
-                                                            global_inst_zone ? global_inst_zone->mod : NULL,
-                                                            inst_zone->mod, /* local instrument modulators */
-                                                            FLUID_VOICE_OVERWRITE); /* mode */
+                if(fluid_channel_get_override_gen_default(synth->channel[chan], i, &awe_val))
+                {
+                    fluid_voice_gen_set(voice, i, awe_val);
+                }
+            }
 
-                    /* Preset level, generators */
+            /* Adds preset zone modulators (global and local) to the voice.*/
+            if(merged_mods == NULL)
+            {
+                fluid_defpreset_noteon_add_mod_to_voice(voice,
+                                                        voice_zone->mod + voice_zone->mod_overwrite_count,
+                                                        voice_zone->mod_add_count,
+                                                        FLUID_VOICE_ADD); /* mode */
+            }
 
-                    for(i = 0; i < GEN_LAST; i++)
-                    {
-                        fluid_real_t awe_val;
-                        /* SF 2.01 section 8.5 page 58: If some generators are
-                         encountered at preset level, they should be ignored.
-                         However this check is not necessary when the soundfont
-                         loader has ignored invalid preset generators.
-                         Actually load_pgen()has ignored these invalid preset
-                         generators:
-                           GEN_STARTADDROFS,      GEN_ENDADDROFS,
-                           GEN_STARTLOOPADDROFS,  GEN_ENDLOOPADDROFS,
-                           GEN_STARTADDRCOARSEOFS,GEN_ENDADDRCOARSEOFS,
-                           GEN_STARTLOOPADDRCOARSEOFS,
-                           GEN_KEYNUM, GEN_VELOCITY,
-                           GEN_ENDLOOPADDRCOARSEOFS,
-                           GEN_SAMPLEMODE, GEN_EXCLUSIVECLASS,GEN_OVERRIDEROOTKEY
-                        */
-
-                        /* SF 2.01 section 9.4 'bullet' 9: A generator in a
-                         * local preset zone supersedes a global preset zone
-                         * generator.  The effect is -added- to the destination
-                         * summing node -> voice_gen_incr */
-
-                        if(preset_zone->gen[i].flags)
-                        {
-                            fluid_voice_gen_incr(voice, i, preset_zone->gen[i].val);
-                        }
-                        else if((global_preset_zone != NULL) && global_preset_zone->gen[i].flags)
-                        {
-                            fluid_voice_gen_incr(voice, i, global_preset_zone->gen[i].val);
-                        }
-                        else
-                        {
-                            /* The generator has not been defined in this preset
-                             * Do nothing, leave it unchanged.
-                             */
-                        }
+            /* add the synthesis process to the synthesis loop. */
+            fluid_synth_start_voice(synth, voice);
 
-                        /* ...unless the default value has been overridden by an AWE32 NRPN */
-                        if (fluid_channel_get_override_gen_default(synth->channel[chan], i, &awe_val))
-                        {
-                            fluid_voice_gen_set(voice, i, awe_val);
-                        }
-                    } /* for all generators */
-
-                    /* Adds preset zone modulators (global and local) to the voice.*/
-                    fluid_defpreset_noteon_add_mod_to_voice(voice,
-                                                            /* global preset modulators */
-                                                            global_preset_zone ? global_preset_zone->mod : NULL,
-                                                            preset_zone->mod, /* local preset modulators */
-                                                            FLUID_VOICE_ADD); /* mode */
-
-                    /* add the synthesis process to the synthesis loop. */
-                    fluid_synth_start_voice(synth, voice);
-
-                    /* Store the ID of the first voice that was created by this noteon event.
-                     * Exclusive class may only terminate older voices.
-                     * That avoids killing voices, which have just been created.
-                     * (a noteon event can create several voice processes with the same exclusive
-                     * class - for example when using stereo samples)
-                     */
-                }
-            }
+            /* Store the ID of the first voice that was created by this noteon event.
+             * Exclusive class may only terminate older voices.
+             * That avoids killing voices, which have just been created.
+             * (a noteon event can create several voice processes with the same exclusive
+             * class - for example when using stereo samples)
+             */
         }
-
-        preset_zone = fluid_preset_zone_next(preset_zone);
     }
 
     return FLUID_OK;
@@ -1099,7 +1776,7 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
     {
         sfzone = (SFZone *)fluid_list_get(p);
         FLUID_SNPRINTF(zone_name, sizeof(zone_name), "pz:%s/%d", defpreset->name, count);
-        zone = new_fluid_preset_zone(zone_name);
+        zone = new_fluid_preset_zone(defsfont->arena, zone_name);
 
         if(zone == NULL)
         {
@@ -1108,7 +1785,6 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
 
         if(fluid_preset_zone_import_sfont(zone, defpreset->global_zone, sfzone, defsfont, sfdata) != FLUID_OK)
         {
-            delete_fluid_preset_zone(zone);
             return FLUID_FAILED;
         }
 
@@ -1118,7 +1794,6 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
         }
         else if(fluid_defpreset_add_zone(defpreset, zone) != FLUID_OK)
         {
-            delete_fluid_preset_zone(zone);
             return FLUID_FAILED;
         }
 
@@ -1126,7 +1801,7 @@ fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset,
         count++;
     }
 
-    return FLUID_OK;
+    return fluid_defpreset_index_zones(defsfont->arena, defpreset);
 }
 
 /*
@@ -1149,6 +1824,74 @@ fluid_defpreset_add_zone(fluid_defpreset_t *defpreset, fluid_preset_zone_t *zone
     return FLUID_OK;
 }
 
+/*
+ * Lists the voice zones of a preset that key can start into zones, if not NULL,
+ * and returns their number. Key 128 lists all of them.
+ */
+static int
+fluid_defpreset_list_key_zones(fluid_defpreset_t *defpreset, int key, fluid_voice_zone_t **zones)
+{
+    fluid_preset_zone_t *preset_zone;
+    fluid_voice_zone_t *voice_zone;
+    fluid_list_t *list;
+    int count = 0;
+
+    for(preset_zone = defpreset->zone; preset_zone != NULL; preset_zone = preset_zone->next)
+    {
+        for(list = preset_zone->voice_zone; list != NULL; list = fluid_list_next(list))
+        {
+            voice_zone = fluid_list_get(list);
+
+            if(key == 128 || (voice_zone->range.keylo <= key && key <= voice_zone->range.keyhi))
+            {
+                if(zones != NULL)
+                {
+                    zones[count] = voice_zone;
+                }
+
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+/*
+ * Builds the key index of the voice zones of a preset, once all its zones have been
+ * added. The voice zones of each key keep the order of the preset zones and of their
+ * instrument zones, which is the order noteon starts their voices in.
+ */
+int
+fluid_defpreset_index_zones(fluid_arena_t *arena, fluid_defpreset_t *defpreset)
+{
+    int key, count = 0;
+
+    for(key = 0; key <= 128; key++)
+    {
+        count += fluid_defpreset_list_key_zones(defpreset, key, NULL);
+    }
+
+    defpreset->key_zones = fluid_arena_alloc(arena, count * sizeof(*defpreset->key_zones));
+
+    if(defpreset->key_zones == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    count = 0;
+
+    for(key = 0; key <= 128; key++)
+    {
+        defpreset->key_zone_index[key] = count;
+        count += fluid_defpreset_list_key_zones(defpreset, key, &defpreset->key_zones[count]);
+    }
+
+    defpreset->key_zone_index[key] = count;
+
+    return FLUID_OK;
+}
+
 /*
  * fluid_defpreset_get_zone
  */
@@ -1185,25 +1928,22 @@ fluid_preset_zone_next(fluid_preset_zone_t *zone)
  * new_fluid_preset_zone
  */
 fluid_preset_zone_t *
-new_fluid_preset_zone(char *name)
+new_fluid_preset_zone(fluid_arena_t *arena, char *name)
 {
     fluid_preset_zone_t *zone = NULL;
-    zone = FLUID_NEW(fluid_preset_zone_t);
+    zone = FLUID_ARENA_NEW(arena, fluid_preset_zone_t);
 
     if(zone == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
     zone->next = NULL;
     zone->voice_zone = NULL;
-    zone->name = FLUID_STRDUP(name);
+    zone->name = fluid_arena_strdup(arena, name);
 
     if(zone->name == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        FLUID_FREE(zone);
         return NULL;
     }
 
@@ -1223,38 +1963,117 @@ new_fluid_preset_zone(char *name)
 }
 
 /*
- * delete_fluid_preset_zone
+ * Merges the generators and modulators of a preset zone and an instrument zone with
+ * those of their global zones, in the order fluid_defpreset_noteon() applies them.
  */
-void
-delete_fluid_preset_zone(fluid_preset_zone_t *zone)
+static int
+fluid_voice_zone_merge(fluid_arena_t *arena, fluid_voice_zone_t *voice_zone,
+                       fluid_preset_zone_t *preset_zone, fluid_preset_zone_t *global_preset_zone)
 {
-    fluid_list_t *list;
+    fluid_inst_zone_t *inst_zone = voice_zone->inst_zone;
+    fluid_inst_zone_t *global_inst_zone = fluid_inst_get_global_zone(preset_zone->inst);
+    fluid_mod_t *mod_list[2 * FLUID_NUM_MOD];
+    unsigned char gen_num[2 * GEN_LAST];
+    double gen_val[2 * GEN_LAST];
+    int i, count, add_count;
+
+    count = 0;
+
+    /* SF 2.01 section 9.4 'bullet' 4: A generator in a local instrument zone
+     * supersedes a global instrument zone generator */
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        if(inst_zone->gen[i].flags)
+        {
+            gen_num[count] = i;
+            gen_val[count++] = inst_zone->gen[i].val;
+        }
+        else if((global_inst_zone != NULL) && global_inst_zone->gen[i].flags)
+        {
+            gen_num[count] = i;
+            gen_val[count++] = global_inst_zone->gen[i].val;
+        }
+    }
 
-    fluid_return_if_fail(zone != NULL);
+    voice_zone->gen_set_count = count;
 
-    delete_fluid_list_mod(zone->mod);
+    /* SF 2.01 section 8.5 page 58: If some generators are encountered at preset
+     * level, they should be ignored. load_pgen() has ignored these already.
+     * SF 2.01 section 9.4 'bullet' 9: A generator in a local preset zone
+     * supersedes a global preset zone generator. */
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        if(preset_zone->gen[i].flags)
+        {
+            gen_num[count] = i;
+            gen_val[count++] = preset_zone->gen[i].val;
+        }
+        else if((global_preset_zone != NULL) && global_preset_zone->gen[i].flags)
+        {
+            gen_num[count] = i;
+            gen_val[count++] = global_preset_zone->gen[i].val;
+        }
+    }
 
-    for(list = zone->voice_zone; list != NULL; list = fluid_list_next(list))
+    voice_zone->gen_incr_count = count - voice_zone->gen_set_count;
+
+    /* in mode FLUID_VOICE_OVERWRITE disabled instruments modulators CANNOT be skipped. */
+    count = fluid_zone_merge_mods(mod_list,
+                                  global_inst_zone ? global_inst_zone->mod : NULL,
+                                  inst_zone->mod);
+    voice_zone->mod_overwrite_count = count;
+
+    /* in mode FLUID_VOICE_ADD disabled preset modulators can be skipped. */
+    add_count = fluid_zone_merge_mods(&mod_list[count],
+                                      global_preset_zone ? global_preset_zone->mod : NULL,
+                                      preset_zone->mod);
+
+    for(i = 0; i < add_count; i++)
     {
-        FLUID_FREE(fluid_list_get(list));
+        if(mod_list[count + i]->amount != 0)
+        {
+            mod_list[count + voice_zone->mod_add_count++] = mod_list[count + i];
+        }
+    }
+
+    /* one allocation for the three arrays, the values first for their alignment */
+    count = voice_zone->gen_set_count + voice_zone->gen_incr_count;
+    add_count = voice_zone->mod_overwrite_count + voice_zone->mod_add_count;
+    voice_zone->gen_val = fluid_arena_alloc(arena, count * (sizeof(*gen_val) + sizeof(*gen_num))
+                                            + add_count * sizeof(*mod_list));
+
+    if(voice_zone->gen_val == NULL)
+    {
+        return FLUID_FAILED;
     }
 
-    delete_fluid_list(zone->voice_zone);
+    voice_zone->mod = (fluid_mod_t **)&voice_zone->gen_val[count];
+    voice_zone->gen_num = (unsigned char *)&voice_zone->mod[add_count];
 
-    FLUID_FREE(zone->name);
-    FLUID_FREE(zone);
+    FLUID_MEMCPY(voice_zone->gen_val, gen_val, count * sizeof(*gen_val));
+    FLUID_MEMCPY(voice_zone->mod, mod_list, add_count * sizeof(*mod_list));
+    FLUID_MEMCPY(voice_zone->gen_num, gen_num, count * sizeof(*gen_num));
+
+    return FLUID_OK;
 }
 
-static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone)
+int fluid_preset_zone_create_voice_zones(fluid_arena_t *arena, fluid_preset_zone_t *preset_zone,
+                                        fluid_preset_zone_t *global_preset_zone)
 {
     fluid_inst_zone_t *inst_zone;
     fluid_sample_t *sample;
     fluid_voice_zone_t *voice_zone;
     fluid_zone_range_t *irange;
     fluid_zone_range_t *prange = &preset_zone->range;
+    fluid_list_t **last = &preset_zone->voice_zone;
 
     fluid_return_val_if_fail(preset_zone->inst != NULL, FLUID_FAILED);
 
+    while(*last != NULL)
+    {
+        last = &(*last)->next;
+    }
+
     inst_zone = fluid_inst_get_zone(preset_zone->inst);
 
     while(inst_zone != NULL)
@@ -1270,15 +2089,17 @@ static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone
             continue;
         }
 
-        voice_zone = FLUID_NEW(fluid_voice_zone_t);
+        voice_zone = FLUID_ARENA_NEW(arena, fluid_voice_zone_t);
 
         if(voice_zone == NULL)
         {
-            FLUID_LOG(FLUID_ERR, "Out of memory");
             return FLUID_FAILED;
         }
 
         voice_zone->inst_zone = inst_zone;
+        voice_zone->merged_generation = 0;
+        voice_zone->merged = NULL;
+        voice_zone->merged_list = NULL;
 
         irange = &inst_zone->range;
 
@@ -1288,7 +2109,20 @@ static int fluid_preset_zone_create_voice_zones(fluid_preset_zone_t *preset_zone
         voice_zone->range.velhi = (prange->velhi < irange->velhi) ? prange->velhi : irange->velhi;
         voice_zone->range.ignore = FALSE;
 
-        preset_zone->voice_zone = fluid_list_append(preset_zone->voice_zone, voice_zone);
+        if(fluid_voice_zone_merge(arena, voice_zone, preset_zone, global_preset_zone) == FLUID_FAILED)
+        {
+            return FLUID_FAILED;
+        }
+
+        /* keep the order of the instrument zones */
+        *last = fluid_arena_list_prepend(arena, NULL, voice_zone);
+
+        if(*last == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        last = &(*last)->next;
 
         inst_zone = fluid_inst_zone_next(inst_zone);
     }
@@ -1355,7 +2189,6 @@ static void fluid_limit_mod_list(char *zone_name, fluid_mod_t **list_mod)
                 *list_mod = NULL;
             }
 
-            delete_fluid_list_mod(mod);
             FLUID_LOG(FLUID_WARN, "%s, modulators count limited to %d", zone_name,
                       FLUID_NUM_MOD);
             break;
@@ -1403,8 +2236,6 @@ fluid_zone_check_mod(char *zone_name, fluid_mod_t **list_mod)
             {
                 *list_mod = next;
             }
-
-            delete_fluid_mod(mod); /* freeing */
         }
         else
         {
@@ -1570,7 +2401,7 @@ fluid_zone_mod_source_import_sfont(unsigned char *src, unsigned char *flags, uns
  * @return FLUID_OK if success, FLUID_FAILED otherwise.
  */
 static int
-fluid_mod_import_sfont(fluid_mod_t **mod, fluid_list_t *sfmod)
+fluid_mod_import_sfont(fluid_arena_t *arena, fluid_mod_t **mod, fluid_list_t *sfmod)
 {
     fluid_list_t *r;
     int count;
@@ -1580,7 +2411,7 @@ fluid_mod_import_sfont(fluid_mod_t **mod, fluid_list_t *sfmod)
     {
 
         SFMod *mod_src = (SFMod*)(r->data);
-        fluid_mod_t *mod_dest = new_fluid_mod();
+        fluid_mod_t *mod_dest;
 
         if (mod_src == NULL)
         {
@@ -1588,6 +2419,8 @@ fluid_mod_import_sfont(fluid_mod_t **mod, fluid_list_t *sfmod)
             return FLUID_OK;
         }
 
+        mod_dest = (arena != NULL) ? FLUID_ARENA_NEW(arena, fluid_mod_t) : new_fluid_mod();
+
         if(mod_dest == NULL)
         {
             return FLUID_FAILED;
@@ -1667,9 +2500,9 @@ fluid_mod_import_sfont(fluid_mod_t **mod, fluid_list_t *sfmod)
  * @return FLUID_OK if success, FLUID_FAILED otherwise.
  */
 static int
-fluid_zone_mod_import_sfont(char *zone_name, fluid_mod_t **mod, SFZone *sfzone)
+fluid_zone_mod_import_sfont(fluid_arena_t *arena, char *zone_name, fluid_mod_t **mod, SFZone *sfzone)
 {
-    if (fluid_mod_import_sfont(mod, sfzone->mod) != FLUID_OK)
+    if (fluid_mod_import_sfont(arena, mod, sfzone->mod) != FLUID_OK)
     {
         return FLUID_FAILED;
     }
@@ -1692,13 +2525,9 @@ fluid_preset_zone_import_sfont(fluid_preset_zone_t *zone, fluid_preset_zone_t *g
     {
         int inst_idx = (int) zone->gen[GEN_INSTRUMENT].val;
 
+        /* the instruments have been imported by fluid_defsfont_import_insts() */
         zone->inst = find_inst_by_idx(defsfont, inst_idx);
 
-        if(zone->inst == NULL)
-        {
-            zone->inst = fluid_inst_import_sfont(inst_idx, defsfont, sfdata);
-        }
-
         if(zone->inst == NULL)
         {
 
@@ -1707,17 +2536,23 @@ fluid_preset_zone_import_sfont(fluid_preset_zone_t *zone, fluid_preset_zone_t *g
             return FLUID_FAILED;
         }
 
-        if(fluid_preset_zone_create_voice_zones(zone) == FLUID_FAILED)
-        {
-            return FLUID_FAILED;
-        }
-
         /* We don't need this generator anymore */
         zone->gen[GEN_INSTRUMENT].flags = GEN_UNUSED;
     }
 
     /* Import the modulators (only SF2.1 and higher) */
-    return fluid_zone_mod_import_sfont(zone->name, &zone->mod, sfzone);
+    if(fluid_zone_mod_import_sfont(defsfont->arena, zone->name, &zone->mod, sfzone) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* the voice zones merge the generators and modulators imported above */
+    if(zone->inst != NULL && fluid_preset_zone_create_voice_zones(defsfont->arena, zone, global_zone) == FLUID_FAILED)
+    {
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
 }
 
 /*
@@ -1739,13 +2574,12 @@ fluid_preset_zone_get_inst(fluid_preset_zone_t *zone)
  * new_fluid_inst
  */
 fluid_inst_t *
-new_fluid_inst(void)
+new_fluid_inst(fluid_arena_t *arena)
 {
-    fluid_inst_t *inst = FLUID_NEW(fluid_inst_t);
+    fluid_inst_t *inst = FLUID_ARENA_NEW(arena, fluid_inst_t);
 
     if(inst == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
@@ -1755,31 +2589,6 @@ new_fluid_inst(void)
     return inst;
 }
 
-/*
- * delete_fluid_inst
- */
-void
-delete_fluid_inst(fluid_inst_t *inst)
-{
-    fluid_inst_zone_t *zone;
-
-    fluid_return_if_fail(inst != NULL);
-
-    delete_fluid_inst_zone(inst->global_zone);
-    inst->global_zone = NULL;
-
-    zone = inst->zone;
-
-    while(zone != NULL)
-    {
-        inst->zone = zone->next;
-        delete_fluid_inst_zone(zone);
-        zone = inst->zone;
-    }
-
-    FLUID_FREE(inst);
-}
-
 /*
  * fluid_inst_set_global_zone
  */
@@ -1794,35 +2603,19 @@ fluid_inst_set_global_zone(fluid_inst_t *inst, fluid_inst_zone_t *zone)
  * fluid_inst_import_sfont
  */
 fluid_inst_t *
-fluid_inst_import_sfont(int inst_idx, fluid_defsfont_t *defsfont, SFData *sfdata)
+fluid_inst_import_sfont(SFInst *sfinst, fluid_defsfont_t *defsfont, SFData *sfdata)
 {
     fluid_list_t *p;
-    fluid_list_t *inst_list;
     fluid_inst_t *inst;
     SFZone *sfzone;
-    SFInst *sfinst;
     fluid_inst_zone_t *inst_zone;
     char zone_name[256];
     int count;
 
-    for (inst_list = sfdata->inst; inst_list; inst_list = fluid_list_next(inst_list))
-    {
-        sfinst = fluid_list_get(inst_list);
-        if (sfinst->idx == inst_idx)
-        {
-            break;
-        }
-    }
-    if (inst_list == NULL)
-    {
-        return NULL;
-    }
-
-    inst = (fluid_inst_t *) new_fluid_inst();
+    inst = new_fluid_inst(defsfont->arena);
 
     if(inst == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
@@ -1848,18 +2641,16 @@ fluid_inst_import_sfont(int inst_idx, fluid_defsfont_t *defsfont, SFData *sfdata
         /* instrument zone name */
         FLUID_SNPRINTF(zone_name, sizeof(zone_name), "iz:%s/%d", inst->name, count);
 
-        inst_zone = new_fluid_inst_zone(zone_name);
+        inst_zone = new_fluid_inst_zone(defsfont->arena, zone_name);
         if(inst_zone == NULL)
         {
-            FLUID_LOG(FLUID_ERR, "Out of memory");
-            goto error;
+            return NULL;
         }
 
         if(fluid_inst_zone_import_sfont(inst_zone, inst->global_zone, sfzone, defsfont, sfdata) != FLUID_OK)
         {
             FLUID_LOG(FLUID_ERR, "fluid_inst_zone_import_sfont() failed for instrument %s", inst->name);
-            delete_fluid_inst_zone(inst_zone);
-            goto error;
+            return NULL;
         }
 
         if((count == 0) && (fluid_inst_zone_get_sample(inst_zone) == NULL))
@@ -1870,20 +2661,14 @@ fluid_inst_import_sfont(int inst_idx, fluid_defsfont_t *defsfont, SFData *sfdata
         else if(fluid_inst_add_zone(inst, inst_zone) != FLUID_OK)
         {
             FLUID_LOG(FLUID_ERR, "fluid_inst_add_zone() failed for instrument %s", inst->name);
-            delete_fluid_inst_zone(inst_zone);
-            goto error;
+            return NULL;
         }
 
         p = fluid_list_next(p);
         count++;
     }
 
-    defsfont->inst = fluid_list_append(defsfont->inst, inst);
     return inst;
-
-error:
-    delete_fluid_inst(inst);
-    return NULL;
 }
 
 /*
@@ -1933,24 +2718,21 @@ fluid_inst_get_global_zone(fluid_inst_t *inst)
  * new_fluid_inst_zone
  */
 fluid_inst_zone_t *
-new_fluid_inst_zone(char *name)
+new_fluid_inst_zone(fluid_arena_t *arena, char *name)
 {
     fluid_inst_zone_t *zone = NULL;
-    zone = FLUID_NEW(fluid_inst_zone_t);
+    zone = FLUID_ARENA_NEW(arena, fluid_inst_zone_t);
 
     if(zone == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
     zone->next = NULL;
-    zone->name = FLUID_STRDUP(name);
+    zone->name = fluid_arena_strdup(arena, name);
 
     if(zone->name == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        FLUID_FREE(zone);
         return NULL;
     }
 
@@ -1963,22 +2745,8 @@ new_fluid_inst_zone(char *name)
     /* Flag the generators as unused.
      * This also sets the generator values to default, but they will be overwritten anyway, if used.*/
     fluid_gen_init(&zone->gen[0], NULL);
-    zone->mod = NULL; /* list of modulators */
-    return zone;
-}
-
-/*
- * delete_fluid_inst_zone
- */
-void
-delete_fluid_inst_zone(fluid_inst_zone_t *zone)
-{
-    fluid_return_if_fail(zone != NULL);
-
-    delete_fluid_list_mod(zone->mod);
-
-    FLUID_FREE(zone->name);
-    FLUID_FREE(zone);
+    zone->mod = NULL; /* list of modulators */
+    return zone;
 }
 
 /*
@@ -2033,7 +2801,7 @@ fluid_inst_zone_import_sfont(fluid_inst_zone_t *inst_zone, fluid_inst_zone_t *gl
     }
 
     /* Import the modulators (only SF2.1 and higher) */
-    return fluid_zone_mod_import_sfont(inst_zone->name, &inst_zone->mod, sfzone);
+    return fluid_zone_mod_import_sfont(defsfont->arena, inst_zone->name, &inst_zone->mod, sfzone);
 }
 
 /*
@@ -2102,6 +2870,7 @@ fluid_sample_import_sfont(fluid_sample_t *sample, SFSample *sfsample, fluid_defs
     if(defsfont->dynamic_samples)
     {
         sample->notify = dynamic_samples_sample_notify;
+        sample->owner = defsfont;
     }
 
     FLUID_LOG(FLUID_DBG, "Discovering sample '%s', src_start %d, loop_start %d, loop_end %d, src_end %d", sample->name, sample->source_start, sample->loopstart, sample->loopend, sample->source_end);
@@ -2121,7 +2890,7 @@ static int dynamic_samples_sample_notify(fluid_sample_t *sample, int reason)
 {
     if(reason == FLUID_SAMPLE_DONE && sample->preset_count == 0)
     {
-        unload_sample(sample);
+        release_sample(sample->owner, sample);
     }
 
     return FLUID_OK;
@@ -2131,34 +2900,174 @@ static int dynamic_samples_sample_notify(fluid_sample_t *sample, int reason)
  * dynamic sample loading to load and unload samples on demand. */
 static int dynamic_samples_preset_notify(fluid_preset_t *preset, int reason, int chan)
 {
-    fluid_defsfont_t *defsfont;
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(preset->sfont);
+    double trace_ref;
+    int ret;
+
+    apply_loaded_samples(defsfont);
 
     if(reason == FLUID_PRESET_SELECTED)
     {
         FLUID_LOG(FLUID_DBG, "Selected preset '%s' on channel %d", fluid_preset_get_name(preset), chan);
-        defsfont = fluid_sfont_get_data(preset->sfont);
-        return load_preset_samples(defsfont, preset);
+        trace_ref = fluid_trace_ref();
+        ret = load_preset_samples(defsfont, preset);
+        fluid_trace_span("load_preset_samples", trace_ref);
+        return ret;
     }
 
     if(reason == FLUID_PRESET_UNSELECTED)
     {
         FLUID_LOG(FLUID_DBG, "Deselected preset '%s' from channel %d", fluid_preset_get_name(preset), chan);
-        defsfont = fluid_sfont_get_data(preset->sfont);
         return unload_preset_samples(defsfont, preset);
     }
 
     if(reason == FLUID_PRESET_PIN)
     {
-        defsfont = fluid_sfont_get_data(preset->sfont);
         return pin_preset_samples(defsfont, preset);
     }
 
     if(reason == FLUID_PRESET_UNPIN)
     {
-        defsfont = fluid_sfont_get_data(preset->sfont);
         return unpin_preset_samples(defsfont, preset);
     }
 
+    if(reason == FLUID_PRESET_IS_LOADED)
+    {
+        return preset_samples_loaded(preset) ? FLUID_OK : FLUID_FAILED;
+    }
+
+    if(reason == FLUID_PRESET_WARM)
+    {
+        /* the samples of other presets may be unloaded while they are warmed */
+        if(!((fluid_defpreset_t *)fluid_preset_get_data(preset))->pinned)
+        {
+            FLUID_LOG(FLUID_WARN, "Preset '%s' must be pinned to warm it up", fluid_preset_get_name(preset));
+            return FLUID_FAILED;
+        }
+
+        return warm_preset(defsfont, preset);
+    }
+
+    return FLUID_OK;
+}
+
+/* Called for the presets of SoundFonts whose samples are loaded with the SoundFont */
+static int loaded_samples_preset_notify(fluid_preset_t *preset, int reason, int chan)
+{
+    if(reason == FLUID_PRESET_WARM)
+    {
+        return warm_preset(fluid_sfont_get_data(preset->sfont), preset);
+    }
+
+    return FLUID_OK;
+}
+
+/* Makes sure that the pages of size bytes at addr are in memory, reading them from the disk
+ * or from swap space if needed, and pins them to RAM if requested. */
+static void warm_data(const void *addr, size_t size, int lock)
+{
+    const volatile char *bytes = addr;
+    size_t i;
+
+    if(addr == NULL || size == 0)
+    {
+        return;
+    }
+
+    /* lets the operating system read all the pages at once, rather than one fault at a time */
+    fluid_file_map_prefetch(addr, size);
+
+    for(i = 0; i < size; i += FLUID_WARM_PAGE_SIZE)
+    {
+        (void)bytes[i];
+    }
+
+    (void)bytes[size - 1];
+
+    /* It's okay if this fails, the pages are in memory for now */
+    if(lock)
+    {
+        fluid_mlock(addr, size);
+    }
+}
+
+/* Warms the sample points a voice of the sample may read, see warm_preset() */
+static void warm_sample(const fluid_defsfont_t *defsfont, const fluid_sample_t *sample)
+{
+    unsigned int count, level;
+
+    if(sample->end < sample->start)
+    {
+        return;
+    }
+
+    /* only the preloaded part of streamed samples is kept in memory */
+    count = (sample->stream_preload != 0) ? sample->stream_preload : sample->end - sample->start + 1;
+
+    if(sample->data_compressed != NULL)
+    {
+        size_t first = sample->start / FLUID_SAMPLE_BLOCK_POINTS;
+        size_t last = (sample->start + count - 1) / FLUID_SAMPLE_BLOCK_POINTS;
+
+        warm_data(sample->data_compressed + first * FLUID_SAMPLE_BLOCK_SIZE,
+                  (last - first + 1) * FLUID_SAMPLE_BLOCK_SIZE, defsfont->mlock);
+    }
+    else if(sample->data_float != NULL)
+    {
+        warm_data(sample->data_float + sample->start, count * sizeof(fluid_real_t), defsfont->mlock);
+    }
+    else if(sample->data != NULL)
+    {
+        warm_data(sample->data + sample->start, count * sizeof(short), defsfont->mlock);
+
+        if(sample->data24 != NULL)
+        {
+            warm_data(sample->data24 + sample->start, count, defsfont->mlock);
+        }
+    }
+
+    if(sample->mipmap != NULL && sample->mip_levels > 0)
+    {
+        for(level = 0; level < (unsigned int)sample->mip_levels; level++)
+        {
+            count = (count + 1) / 2;
+        }
+
+        warm_data(sample->mipmap, (sample->mip_offset[sample->mip_levels - 1] + count) * sizeof(fluid_real_t),
+                  defsfont->mlock);
+    }
+}
+
+/* Touches all the memory a noteon of the preset reads, i.e. its merged voice zones and the data
+ * of their samples, so that the first notes don't wait for page faults. The sample data is
+ * pinned to RAM if synth.lock-memory is enabled. See fluid_synth_warm_preset(). */
+static int warm_preset(fluid_defsfont_t *defsfont, fluid_preset_t *preset)
+{
+    fluid_defpreset_t *defpreset = fluid_preset_get_data(preset);
+    fluid_voice_zone_t *voice_zone;
+    int i, count;
+
+    FLUID_LOG(FLUID_DBG, "Warming up preset '%s'", fluid_preset_get_name(preset));
+
+    /* index 128 lists all voice zones of the preset */
+    count = defpreset->key_zone_index[129] - defpreset->key_zone_index[128];
+    warm_data(&defpreset->key_zones[defpreset->key_zone_index[128]], count * sizeof(*defpreset->key_zones), FALSE);
+
+    for(i = defpreset->key_zone_index[128]; i < defpreset->key_zone_index[129]; i++)
+    {
+        voice_zone = defpreset->key_zones[i];
+
+        warm_data(voice_zone, sizeof(*voice_zone), FALSE);
+        warm_data(voice_zone->gen_num, voice_zone->gen_set_count + voice_zone->gen_incr_count, FALSE);
+        warm_data(voice_zone->gen_val, (voice_zone->gen_set_count + voice_zone->gen_incr_count) * sizeof(double), FALSE);
+        warm_data(voice_zone->mod, (voice_zone->mod_overwrite_count + voice_zone->mod_add_count) * sizeof(fluid_mod_t *), FALSE);
+
+        if(voice_zone->inst_zone->sample != NULL)
+        {
+            warm_sample(defsfont, voice_zone->inst_zone->sample);
+        }
+    }
+
     return FLUID_OK;
 }
 
@@ -2166,6 +3075,8 @@ static int dynamic_samples_preset_notify(fluid_preset_t *preset, int reason, int
 static int pin_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset)
 {
     fluid_defpreset_t *defpreset;
+    double trace_ref;
+    int ret;
 
     defpreset = fluid_preset_get_data(preset);
     if (defpreset->pinned)
@@ -2175,11 +3086,21 @@ static int pin_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *preset
 
     FLUID_LOG(FLUID_DBG, "Pinning preset '%s'", fluid_preset_get_name(preset));
 
-    if(load_preset_samples(defsfont, preset) == FLUID_FAILED)
+    trace_ref = fluid_trace_ref();
+    ret = load_preset_samples(defsfont, preset);
+    fluid_trace_span("load_preset_samples", trace_ref);
+
+    if(ret == FLUID_FAILED)
     {
         return FLUID_FAILED;
     }
 
+    /* pinned samples have to be in memory when returning */
+    while(!preset_samples_loaded(preset))
+    {
+        fluid_msleep(1);
+    }
+
     defpreset->pinned = TRUE;
 
     return FLUID_OK;
@@ -2236,9 +3157,39 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
             {
                 sample->preset_count++;
 
-                /* If this is the first time this sample has been selected,
-                 * load the sampledata */
                 if(sample->preset_count == 1)
+                {
+                    if(sample->kept_unused)
+                    {
+                        unkeep_sample(defsfont, sample);
+                    }
+
+                    fluid_mutex_lock(residency_mutex);
+
+                    if(sample->data != NULL)
+                    {
+                        residency_stats.hits++;
+                    }
+                    else
+                    {
+                        residency_stats.misses++;
+                    }
+
+                    fluid_mutex_unlock(residency_mutex);
+                }
+
+                /* If this is the first time this sample has been selected,
+                 * load the sampledata, either in the background or right away.
+                 * If it has been unselected before, its data may still be in
+                 * memory because a voice was using it. */
+                if(sample->preset_count == 1 && sample->data == NULL && defsfont->loader != NULL)
+                {
+                    if(!sample->loading && queue_sample(defsfont, sample) == FLUID_FAILED)
+                    {
+                        return FLUID_FAILED;
+                    }
+                }
+                else if(sample->preset_count == 1 && sample->data == NULL)
                 {
                     /* Make sure we have an open Soundfont file. Do this here
                      * to avoid having to open the file if no loading is necessary
@@ -2252,12 +3203,16 @@ static int load_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *prese
                             FLUID_LOG(FLUID_ERR, "Unable to open Soundfont file");
                             return FLUID_FAILED;
                         }
+
+                        sffile->huge_pages = defsfont->huge_pages;
+                        sffile->async_io = defsfont->async_io;
                     }
 
                     if(fluid_defsfont_load_sampledata(defsfont, sffile, sample) == FLUID_OK)
                     {
                         fluid_sample_sanitize_loop(sample, (sample->end + 1) * sizeof(short));
                         fluid_voice_optimize_sample(sample);
+                        fluid_defsfont_build_mipmap(defsfont, sample);
                     }
                     else
                     {
@@ -2313,9 +3268,13 @@ static int unload_preset_samples(fluid_defsfont_t *defsfont, fluid_preset_t *pre
                  * still in use by a voice, dynamic_samples_sample_notify will
                  * take care of unloading the sample as soon as the voice is
                  * finished with it (but only on the next API call). */
-                if(sample->preset_count == 0 && sample->refcount == 0)
+                if(sample->preset_count == 0 && sample->loading)
                 {
-                    unload_sample(sample);
+                    cancel_sample(defsfont, sample);
+                }
+                else if(sample->preset_count == 0 && sample->refcount == 0)
+                {
+                    release_sample(defsfont, sample);
                 }
             }
 
@@ -2346,7 +3305,331 @@ static void unload_sample(fluid_sample_t *sample)
     {
         sample->data = NULL;
         sample->data24 = NULL;
+        sample->data_float = NULL;
+        fluid_sample_free_mipmap(sample);
+    }
+}
+
+/* The memory taken by the mipmap of a sample */
+static size_t sample_mipmap_size(const fluid_sample_t *sample)
+{
+    size_t count = sample->end - sample->start + 1;
+    int level;
+
+    if(sample->mipmap == NULL || sample->mip_levels <= 0)
+    {
+        return 0;
+    }
+
+    for(level = 0; level < sample->mip_levels; level++)
+    {
+        count = (count + 1) / 2;
+    }
+
+    return (sample->mip_offset[sample->mip_levels - 1] + count) * sizeof(fluid_real_t);
+}
+
+/* The memory taken by the data of a loaded sample */
+static size_t sample_data_size(const fluid_sample_t *sample)
+{
+    size_t count = sample->end - sample->start + 1;
+    size_t size = count * sizeof(short);
+
+    if(sample->data24 != NULL)
+    {
+        size += count;
+    }
+
+    if(sample->data_float != NULL)
+    {
+        size += count * sizeof(fluid_real_t);
+    }
+
+    return size + sample_mipmap_size(sample);
+}
+
+/* Called once no selected preset and no voice uses a sample anymore. Keeps its data in
+ * memory as long as the unused samples of the SoundFont fit into synth.dynamic-sample-loading-budget,
+ * unloading the samples used least recently first. */
+static void release_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    size_t size;
+
+    if(sample->kept_unused)
+    {
+        return;
     }
+
+    if(defsfont->sample_budget == 0 || sample->data == NULL)
+    {
+        unload_sample(sample);
+        return;
+    }
+
+    size = sample_data_size(sample);
+    defsfont->kept_samples = fluid_list_append(defsfont->kept_samples, sample);
+    defsfont->kept_bytes += size;
+    sample->kept_unused = TRUE;
+
+    fluid_mutex_lock(residency_mutex);
+    residency_stats.unused_samples++;
+    residency_stats.unused_bytes += size;
+    fluid_mutex_unlock(residency_mutex);
+
+    while(defsfont->kept_bytes > defsfont->sample_budget)
+    {
+        sample = fluid_list_get(defsfont->kept_samples);
+        unkeep_sample(defsfont, sample);
+        unload_sample(sample);
+
+        fluid_mutex_lock(residency_mutex);
+        residency_stats.evictions++;
+        fluid_mutex_unlock(residency_mutex);
+    }
+}
+
+/* Takes a sample kept by release_sample() off the list, as it's used again or unloaded */
+static void unkeep_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    size_t size = sample_data_size(sample);
+
+    defsfont->kept_samples = fluid_list_remove(defsfont->kept_samples, sample);
+    defsfont->kept_bytes -= size;
+    sample->kept_unused = FALSE;
+
+    fluid_mutex_lock(residency_mutex);
+    residency_stats.unused_samples--;
+    residency_stats.unused_bytes -= size;
+    fluid_mutex_unlock(residency_mutex);
+}
+
+/**
+ * Get how often dynamic sample loading found the samples of a selected preset in memory.
+ *
+ * @param stats Filled with the counts of all SoundFonts of the process loaded with
+ *   \setting{synth_dynamic-sample-loading}, since the start of the process
+ * @return #FLUID_OK on success, #FLUID_FAILED if @p stats is NULL
+ *
+ * The hit rate is <code>hits / (hits + misses)</code>. Samples are only kept in memory
+ * once no selected preset uses them with \setting{synth_dynamic-sample-loading-budget}, without
+ * it only samples shared with another selected preset or still played by a voice are hits.
+ *
+ * @since 2.6.0
+ */
+int fluid_sample_get_residency_stats(fluid_sample_residency_stats_t *stats)
+{
+    fluid_return_val_if_fail(stats != NULL, FLUID_FAILED);
+
+    fluid_mutex_lock(residency_mutex);
+    *stats = residency_stats;
+    fluid_mutex_unlock(residency_mutex);
+
+    return FLUID_OK;
+}
+
+/* Queues a sample to be loaded by the background thread. Its voices are not
+ * started until the loaded data has been handed over by apply_loaded_samples(). */
+static int queue_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    fluid_defsfont_load_job_t *job = FLUID_NEW(fluid_defsfont_load_job_t);
+
+    if(job == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    FLUID_LOG(FLUID_DBG, "Queueing sample '%s' to be loaded", sample->name);
+
+    job->sample = sample;
+    job->loaded = *sample;
+    job->status = FLUID_FAILED;
+    sample->loading = TRUE;
+
+    fluid_mutex_lock(defsfont->loader_mutex);
+    defsfont->loader_queue = fluid_list_append(defsfont->loader_queue, job);
+    fluid_mutex_unlock(defsfont->loader_mutex);
+
+    return FLUID_OK;
+}
+
+/* Removes a sample that isn't used by any selected preset anymore from the queue of
+ * the background thread. If it is being loaded already, apply_loaded_samples() will
+ * unload it again. */
+static void cancel_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    fluid_list_t *list;
+    fluid_defsfont_load_job_t *job;
+
+    fluid_mutex_lock(defsfont->loader_mutex);
+
+    for(list = defsfont->loader_queue; list; list = fluid_list_next(list))
+    {
+        job = fluid_list_get(list);
+
+        if(job->sample == sample)
+        {
+            defsfont->loader_queue = fluid_list_remove(defsfont->loader_queue, job);
+            FLUID_FREE(job);
+            sample->loading = FALSE;
+            break;
+        }
+    }
+
+    fluid_mutex_unlock(defsfont->loader_mutex);
+}
+
+/* Hands the samples loaded by the background thread over to the synth. */
+static void apply_loaded_samples(fluid_defsfont_t *defsfont)
+{
+    fluid_list_t *done, *list;
+    fluid_defsfont_load_job_t *job;
+    fluid_sample_t *sample;
+
+    if(!fluid_atomic_int_get(&defsfont->loader_has_done))
+    {
+        return;
+    }
+
+    fluid_mutex_lock(defsfont->loader_mutex);
+    done = defsfont->loader_done;
+    defsfont->loader_done = NULL;
+    fluid_atomic_int_set(&defsfont->loader_has_done, FALSE);
+    fluid_mutex_unlock(defsfont->loader_mutex);
+
+    for(list = done; list; list = fluid_list_next(list))
+    {
+        job = fluid_list_get(list);
+        sample = job->sample;
+        sample->loading = FALSE;
+
+        if(job->status == FLUID_FAILED)
+        {
+            FLUID_LOG(FLUID_ERR, "Unable to load sample '%s', disabling", sample->name);
+            sample->start = sample->end = 0;
+        }
+        else if(sample->preset_count == 0)
+        {
+            /* the presets using it have been unselected while loading */
+            if(job->loaded.data != NULL && fluid_samplecache_unload(job->loaded.data) == FLUID_FAILED)
+            {
+                FLUID_LOG(FLUID_ERR, "Unable to unload sample '%s'", sample->name);
+            }
+
+            fluid_sample_free_mipmap(&job->loaded);
+        }
+        else
+        {
+            sample->start = job->loaded.start;
+            sample->end = job->loaded.end;
+            sample->loopstart = job->loaded.loopstart;
+            sample->loopend = job->loaded.loopend;
+            sample->data = job->loaded.data;
+            sample->data24 = job->loaded.data24;
+            sample->data_float = job->loaded.data_float;
+            sample->mipmap = job->loaded.mipmap;
+            FLUID_MEMCPY(sample->mip_offset, job->loaded.mip_offset, sizeof(sample->mip_offset));
+            sample->mip_levels = job->loaded.mip_levels;
+            sample->stream_preload = job->loaded.stream_preload;
+            sample->amplitude_that_reaches_noise_floor_is_valid = job->loaded.amplitude_that_reaches_noise_floor_is_valid;
+            sample->amplitude_that_reaches_noise_floor = job->loaded.amplitude_that_reaches_noise_floor;
+        }
+
+        FLUID_FREE(job);
+    }
+
+    delete_fluid_list(done);
+}
+
+/* Returns TRUE if none of the samples of a preset is being loaded in the background. */
+static int preset_samples_loaded(fluid_preset_t *preset)
+{
+    fluid_defpreset_t *defpreset;
+    fluid_preset_zone_t *preset_zone;
+    fluid_inst_zone_t *inst_zone;
+    fluid_sample_t *sample;
+
+    apply_loaded_samples(fluid_sfont_get_data(preset->sfont));
+
+    defpreset = fluid_preset_get_data(preset);
+
+    for(preset_zone = fluid_defpreset_get_zone(defpreset); preset_zone != NULL;
+            preset_zone = fluid_preset_zone_next(preset_zone))
+    {
+        for(inst_zone = fluid_inst_get_zone(fluid_preset_zone_get_inst(preset_zone)); inst_zone != NULL;
+                inst_zone = fluid_inst_zone_next(inst_zone))
+        {
+            sample = fluid_inst_zone_get_sample(inst_zone);
+
+            if(sample != NULL && sample->loading)
+            {
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/* The background thread of dynamic sample loading. It only works on the copies of
+ * the samples in the queue, so that it never touches a sample used by the synth. */
+static int sample_loader_run(void *data, unsigned int msec)
+{
+    fluid_defsfont_t *defsfont = data;
+    fluid_defsfont_load_job_t *job;
+    SFData *sffile = NULL;
+    int open_failed = FALSE;
+
+    while(TRUE)
+    {
+        fluid_mutex_lock(defsfont->loader_mutex);
+        job = (defsfont->loader_queue != NULL) ? fluid_list_get(defsfont->loader_queue) : NULL;
+        defsfont->loader_queue = fluid_list_remove(defsfont->loader_queue, job);
+        fluid_mutex_unlock(defsfont->loader_mutex);
+
+        if(job == NULL)
+        {
+            break;
+        }
+
+        /* keep the Soundfont file open while there are samples to load */
+        if(sffile == NULL && !open_failed)
+        {
+            sffile = fluid_sffile_open(defsfont->filename, &defsfont->fcbs);
+
+            if(sffile == NULL)
+            {
+                FLUID_LOG(FLUID_ERR, "Unable to open Soundfont file");
+                open_failed = TRUE;
+            }
+            else
+            {
+                sffile->huge_pages = defsfont->huge_pages;
+                sffile->async_io = defsfont->async_io;
+            }
+        }
+
+        if(sffile != NULL && fluid_defsfont_load_sampledata(defsfont, sffile, &job->loaded) == FLUID_OK)
+        {
+            fluid_sample_sanitize_loop(&job->loaded, (job->loaded.end + 1) * sizeof(short));
+            fluid_voice_optimize_sample(&job->loaded);
+            fluid_defsfont_build_mipmap(defsfont, &job->loaded);
+            job->status = FLUID_OK;
+        }
+
+        /* hand over every sample right away, so that its voices can start */
+        fluid_mutex_lock(defsfont->loader_mutex);
+        defsfont->loader_done = fluid_list_append(defsfont->loader_done, job);
+        fluid_atomic_int_set(&defsfont->loader_has_done, TRUE);
+        fluid_mutex_unlock(defsfont->loader_mutex);
+    }
+
+    if(sffile != NULL)
+    {
+        fluid_sffile_close(sffile);
+    }
+
+    return 1;
 }
 
 static fluid_inst_t *find_inst_by_idx(fluid_defsfont_t *defsfont, int idx)
@@ -31,6 +31,8 @@
 #include "fluid_mod.h"
 #include "fluid_gen.h"
 #include "fluid_sfont.h"
+#include "fluid_arena.h"
+#include "fluid_voice.h"
 
 
 
@@ -70,11 +72,30 @@ struct _fluid_zone_range_t
 };
 
 /* Stored on a preset zone to keep track of the inst zones that could start a voice
- * and their combined preset zone/instrument zone ranges */
+ * and their combined preset zone/instrument zone ranges. The generators and modulators
+ * of both zones and their global zones are merged at load time, so that noteon only has
+ * to apply them to the voice (see fluid_voice_zone_merge()). */
 struct _fluid_voice_zone_t
 {
     fluid_inst_zone_t *inst_zone;
     fluid_zone_range_t range;
+
+    int gen_set_count;          /* instrument generators, set on the voice */
+    int gen_incr_count;         /* preset generators, added to the voice after the instrument ones */
+    unsigned char *gen_num;     /* generator numbers of the instrument and preset generators */
+    double *gen_val;            /* and their values */
+
+    int mod_overwrite_count;    /* instrument modulators, replacing identical voice modulators */
+    int mod_add_count;          /* preset modulators, added to identical voice modulators after the instrument ones */
+    fluid_mod_t **mod;
+
+    /* The default modulators of the synth with the modulators above merged in, as they end up
+     * on the voice. Merged at the first noteon and again once the default modulators have
+     * changed (see fluid_synth_get_default_mods_LOCAL()), into a list of merged_list that
+     * no voice shares anymore. */
+    unsigned int merged_generation;
+    fluid_voice_mods_t *merged;
+    fluid_voice_mods_t *merged_list;
 };
 
 /*
@@ -91,6 +112,7 @@ const char *fluid_defsfont_sfont_get_name(fluid_sfont_t *sfont);
 fluid_preset_t *fluid_defsfont_sfont_get_preset(fluid_sfont_t *sfont, int bank, int prenum);
 void fluid_defsfont_sfont_iteration_start(fluid_sfont_t *sfont);
 fluid_preset_t *fluid_defsfont_sfont_iteration_next(fluid_sfont_t *sfont);
+int fluid_defsfont_sfont_get_memory(fluid_sfont_t *sfont, fluid_sfont_memory_t *usage);
 
 
 void fluid_defpreset_preset_delete(fluid_preset_t *preset);
@@ -101,6 +123,20 @@ int fluid_defpreset_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth,
 
 int fluid_zone_inside_range(fluid_zone_range_t *zone_range, int key, int vel);
 
+/* size of the blocks of the arena holding the instruments and presets of a SoundFont */
+#define FLUID_DEFSFONT_ARENA_BLOCK_SIZE (64 * 1024)
+
+/* An entry of the preset index of a SoundFont, see fluid_defsfont_build_preset_index() */
+typedef struct
+{
+    int key;                  /* the bank and program, see FLUID_DEFSFONT_PRESET_KEY() */
+    int pos;                  /* the position of the preset in the list of presets */
+    fluid_preset_t *preset;
+} fluid_defsfont_preset_key_t;
+
+/* The key of a bank and program in the preset index, ordered by bank, then by program */
+#define FLUID_DEFSFONT_PRESET_KEY(_bank, _prog) (((_bank) << 8) + (_prog))
+
 /*
  * fluid_defsfont_t
  */
@@ -115,13 +151,38 @@ struct _fluid_defsfont_t
     unsigned int sample24pos;       /* position within sffd of the sm24 chunk, set to zero if no 24 bit sample support */
     unsigned int sample24size;      /* length within sffd of the sm24 chunk */
     char *sample24data;        /* if not NULL, the least significant byte of the 24bit sample data, loaded in ram */
+    fluid_real_t *samplefloatdata;  /* if not NULL, the sample data converted to floating point */
+    signed char *samplecompresseddata; /* if not NULL, the compressed sample data, replacing sampledata */
 
     fluid_sfont_t *sfont;           /* pointer to parent sfont */
     fluid_list_t *sample;           /* the samples in this soundfont */
     fluid_list_t *preset;           /* the presets of this soundfont */
+    fluid_defsfont_preset_key_t *preset_index; /* the presets sorted by bank and program, NULL if not built, see fluid_defsfont_build_preset_index() */
+    int preset_index_count;         /* number of presets in preset_index */
     fluid_list_t *inst;             /* the instruments of this soundfont */
+    fluid_arena_t *arena;           /* the instruments, presets and their zones, freed with the soundfont */
     int mlock;                      /* Should we try memlock (avoid swapping)? */
+    int mmap_samples;               /* Should we try to map the sample data instead of reading it? */
+    char *shared_cache_dir;         /* if not NULL, where to share decoded samples with other processes */
+    char *preset_cache_dir;         /* if not NULL, where to cache the imported presets, see fluid_presetcache.c */
+    int stream_preload;             /* if not 0, stream mapped samples and read this many sample points of each on loading */
     int dynamic_samples;            /* Enables dynamic sample loading if set */
+    size_t sample_budget;           /* Memory for the samples no selected preset uses, see synth.dynamic-sample-loading-budget */
+    fluid_list_t *kept_samples;     /* These samples, the one used least recently first */
+    size_t kept_bytes;              /* The memory they take */
+
+    /* if not NULL, dynamic sample loading loads the samples in this background thread */
+    fluid_timer_t *loader;
+    fluid_mutex_t loader_mutex;     /* protects the lists of samples to be loaded and loaded */
+    fluid_list_t *loader_queue;     /* the samples to be loaded by the background thread */
+    fluid_list_t *loader_done;      /* the samples loaded, waiting to be handed to the synth */
+    fluid_atomic_int_t loader_has_done; /* TRUE if loader_done isn't empty */
+    int float_samples;              /* Keep a floating point copy of the sample data, see synth.sample-format */
+    int compressed_samples;         /* Keep the sample data compressed, see synth.sample-format */
+    int dedup_samples;              /* Store samples with identical data once, see synth.sample-dedup */
+    int huge_pages;                 /* Back the sample data read into memory by huge pages, see synth.huge-pages */
+    int async_io;                   /* Read the sample data with many reads in flight, see synth.async-io */
+    int mipmap_levels;              /* Band-limited copies of the sample data to create, see synth.sample-mipmap-levels */
 
     fluid_list_t *preset_iter_cur;       /* the current preset in the iteration */
 };
@@ -131,6 +192,7 @@ fluid_defsfont_t *new_fluid_defsfont(fluid_settings_t *settings);
 int delete_fluid_defsfont(fluid_defsfont_t *defsfont);
 int fluid_defsfont_load(fluid_defsfont_t *defsfont, const fluid_file_callbacks_t *file_callbacks, const char *file);
 const char *fluid_defsfont_get_name(fluid_defsfont_t *defsfont);
+int fluid_defsfont_get_memory(fluid_defsfont_t *defsfont, fluid_sfont_memory_t *usage);
 fluid_preset_t *fluid_defsfont_get_preset(fluid_defsfont_t *defsfont, int bank, int prenum);
 void fluid_defsfont_iteration_start(fluid_defsfont_t *defsfont);
 fluid_preset_t *fluid_defsfont_iteration_next(fluid_defsfont_t *defsfont);
@@ -139,6 +201,7 @@ int fluid_defsfont_load_all_sampledata(fluid_defsfont_t *defsfont, SFData *sfdat
 
 int fluid_defsfont_add_sample(fluid_defsfont_t *defsfont, fluid_sample_t *sample);
 int fluid_defsfont_add_preset(fluid_defsfont_t *defsfont, fluid_defpreset_t *defpreset);
+void fluid_defsfont_build_preset_index(fluid_defsfont_t *defsfont);
 
 
 /*
@@ -153,14 +216,22 @@ struct _fluid_defpreset_t
     fluid_preset_zone_t *global_zone;        /* the global zone of the preset */
     fluid_preset_zone_t *zone;               /* the chained list of preset zones */
     int pinned;                           /* preset samples pinned to sample cache? */
+    fluid_arena_t *arena;                 /* the arena of the SoundFont, for the merged modulators of the voice zones */
+
+    /* The voice zones of all preset zones, in noteon order, indexed by key (see
+     * fluid_defpreset_index_zones()): key k can only start the voice zones
+     * key_zones[key_zone_index[k]] to key_zones[key_zone_index[k + 1] - 1].
+     * Index 128 lists all voice zones, for tuned keys outside of 0-127. */
+    int key_zone_index[128 + 2];
+    fluid_voice_zone_t **key_zones;
 };
 
-fluid_defpreset_t *new_fluid_defpreset(void);
-void delete_fluid_defpreset(fluid_defpreset_t *defpreset);
+fluid_defpreset_t *new_fluid_defpreset(fluid_arena_t *arena);
 fluid_defpreset_t *fluid_defpreset_next(fluid_defpreset_t *defpreset);
 int fluid_defpreset_import_sfont(fluid_defpreset_t *defpreset, SFPreset *sfpreset, fluid_defsfont_t *defsfont, SFData *sfdata);
 int fluid_defpreset_set_global_zone(fluid_defpreset_t *defpreset, fluid_preset_zone_t *zone);
 int fluid_defpreset_add_zone(fluid_defpreset_t *defpreset, fluid_preset_zone_t *zone);
+int fluid_defpreset_index_zones(fluid_arena_t *arena, fluid_defpreset_t *defpreset);
 fluid_preset_zone_t *fluid_defpreset_get_zone(fluid_defpreset_t *defpreset);
 fluid_preset_zone_t *fluid_defpreset_get_global_zone(fluid_defpreset_t *defpreset);
 int fluid_defpreset_get_banknum(fluid_defpreset_t *defpreset);
@@ -182,11 +253,12 @@ struct _fluid_preset_zone_t
     fluid_mod_t *mod;  /* List of modulators */
 };
 
-fluid_preset_zone_t *new_fluid_preset_zone(char *name);
-void delete_fluid_preset_zone(fluid_preset_zone_t *zone);
+fluid_preset_zone_t *new_fluid_preset_zone(fluid_arena_t *arena, char *name);
 fluid_preset_zone_t *fluid_preset_zone_next(fluid_preset_zone_t *zone);
 int fluid_preset_zone_import_sfont(fluid_preset_zone_t *zone, fluid_preset_zone_t *global_zone, SFZone *sfzone, fluid_defsfont_t *defssfont, SFData *sfdata);
 fluid_inst_t *fluid_preset_zone_get_inst(fluid_preset_zone_t *zone);
+int fluid_preset_zone_create_voice_zones(fluid_arena_t *arena, fluid_preset_zone_t *preset_zone,
+                                        fluid_preset_zone_t *global_preset_zone);
 
 /*
  * fluid_inst_t
@@ -199,9 +271,8 @@ struct _fluid_inst_t
     fluid_inst_zone_t *zone;
 };
 
-fluid_inst_t *new_fluid_inst(void);
-fluid_inst_t *fluid_inst_import_sfont(int inst_idx, fluid_defsfont_t *defsfont, SFData *sfdata);
-void delete_fluid_inst(fluid_inst_t *inst);
+fluid_inst_t *new_fluid_inst(fluid_arena_t *arena);
+fluid_inst_t *fluid_inst_import_sfont(SFInst *sfinst, fluid_defsfont_t *defsfont, SFData *sfdata);
 int fluid_inst_set_global_zone(fluid_inst_t *inst, fluid_inst_zone_t *zone);
 int fluid_inst_add_zone(fluid_inst_t *inst, fluid_inst_zone_t *zone);
 fluid_inst_zone_t *fluid_inst_get_zone(fluid_inst_t *inst);
@@ -221,8 +292,7 @@ struct _fluid_inst_zone_t
 };
 
 
-fluid_inst_zone_t *new_fluid_inst_zone(char *name);
-void delete_fluid_inst_zone(fluid_inst_zone_t *zone);
+fluid_inst_zone_t *new_fluid_inst_zone(fluid_arena_t *arena, char *name);
 fluid_inst_zone_t *fluid_inst_zone_next(fluid_inst_zone_t *zone);
 int fluid_inst_zone_import_sfont(fluid_inst_zone_t *inst_zone, fluid_inst_zone_t *global_inst_zone, SFZone *sfzone, fluid_defsfont_t *defsfont, SFData *sfdata);
 fluid_sample_t *fluid_inst_zone_get_sample(fluid_inst_zone_t *zone);
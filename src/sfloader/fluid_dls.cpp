@@ -18,6 +18,8 @@
 #include "fluid_mod.h"
 #include "fluid_synth.h"
 #include "fluid_chan.h"
+#include "fluid_samplecache.h"
+#include "fluid_trace.h"
 
 #if LIBSNDFILE_SUPPORT
 #include <sndfile.h>
@@ -143,78 +145,6 @@ public:
     }
 };
 
-// RAII wrapper for mlock
-struct mlock_guard
-{
-    mlock_guard() noexcept : ptr(nullptr), size(0), locked(false)
-    {
-    }
-
-    mlock_guard(void *ptr, fluid_long_long_t size) noexcept : ptr(ptr), size(size), locked(false)
-    {
-    }
-
-    mlock_guard(const mlock_guard &) = delete;
-    mlock_guard &operator=(const mlock_guard &) = delete;
-    mlock_guard(mlock_guard &&other) noexcept
-        : ptr(std::exchange(other.ptr, nullptr)), size(std::exchange(other.size, 0)),
-          locked(std::exchange(other.locked, false))
-    {
-    }
-
-    mlock_guard &operator=(mlock_guard &&other) noexcept
-    {
-        if(this == &other)
-        {
-            return *this; // self-assignment
-        }
-
-        unlock();
-        ptr = std::exchange(other.ptr, nullptr);
-        size = std::exchange(other.size, 0);
-        locked = std::exchange(other.locked, false);
-        return *this;
-    }
-
-    int lock() noexcept
-    {
-        if(ptr == nullptr || locked)
-        {
-            return 0;
-        }
-
-        int result = fluid_mlock(ptr, size);
-
-        if(result == 0)
-        {
-            locked = true;
-        }
-
-        return result;
-    }
-
-    void unlock() noexcept
-    {
-        if(ptr == nullptr || !locked)
-        {
-            return;
-        }
-
-        fluid_munlock(ptr, size);
-        locked = false;
-    }
-
-    ~mlock_guard() noexcept
-    {
-        unlock();
-    }
-
-private:
-    void *ptr;
-    fluid_long_long_t size;
-    bool locked;
-};
-
 // fluid_sfloader_t interface
 static fluid_sfont_t *fluid_dls_loader_load(fluid_sfloader_t *loader, const char *filename) noexcept;
 static void fluid_dls_loader_delete(fluid_sfloader_t *loader) noexcept;
@@ -290,6 +220,11 @@ struct fluid_dls_articulation
 
         mods.push_back(mod);
     }
+
+    // the default modulators of the font merged with mods once at load, as a voice gets
+    // them, see fluid_dls_font::merge_mods(). Not used if there are more than a voice takes.
+    std::vector<fluid_mod_t> merged_mods;
+    bool mods_merged{};
 };
 
 // wsmp is used in LIST[wave] chunk and LIST[rgn ] chunk, converting to different fluid structures
@@ -313,6 +248,11 @@ struct fluid_dls_sample
     unsigned start;
     unsigned end; // past the end
     std::optional<fluid_dls_wsmp> wsmp;
+
+    // where the wave data is, see fluid_dls_font::convert_sampledata()
+    fluid_long_long_t data_offset{}; // offset to the data chunk data, or to LIST[wave] if decoded by libsndfile
+    uint32_t data_size{};            // in bytes
+    uint16_t bits_per_sample{};      // 8 or 16, 0 if decoded by libsndfile
 };
 
 struct fluid_dls_region
@@ -325,6 +265,10 @@ struct fluid_dls_region
     uint32_t sampleindex{};
     unsigned char samplemode_inherited{}; // loop_type from sample's wsmp, converted to SF2 sample mode
     fluid_real_t gain_inherited{};        // gain from sample's wsmp, in cB
+
+    // the generators a voice of the region gets, flattened at load, see fluid_dls_font::flatten_region()
+    std::vector<std::pair<int, fluid_real_t>> gen_set;  // set first
+    std::vector<std::pair<int, fluid_real_t>> gen_incr; // then added to the defaults
 };
 
 // SF2's instrument level does not exist in DLS, preset is called instrument in DLS
@@ -398,9 +342,17 @@ struct fluid_dls_font
     fluid_long_long_t pgaloffset{};
     fluid_long_long_t pgalsize{};
 
-    // this MUST NOT be modified after initialization, because of probable mlock
-    std::vector<int16_t> sampledata;
-    mlock_guard sampledata_mlock;
+    // the converted waves, shared with other fonts loading the same file, see fluid_samplecache_load_converted()
+    int16_t *sampledata{};
+    scope_guard<std::function<void()>> on_sampledata_exit{ [this]()
+        {
+            if(sampledata != nullptr)
+            {
+                fluid_samplecache_unload(sampledata);
+                sampledata = nullptr;
+            }
+        } };
+    fluid_long_long_t sampledata_count{}; // number of sample points of all waves
     std::vector<uint32_t> poolcues; // data of ptbl
 
     std::vector<fluid_dls_sample> samples;
@@ -418,6 +370,11 @@ struct fluid_dls_font
 
     decltype(instruments_fluid_data)::iterator fluid_preset_iterator;
 
+    // the presets by bank * 128 + program, sorted, see fluid_dls_sfont_get_preset()
+    std::vector<std::pair<int, fluid_preset_t *>> preset_index;
+    // the bank select style preset_index was built for, the banks depend on it
+    int preset_index_bank_select{ -1 };
+
     fluid_long_long_t total_presets{}; // total number of presets, including aliases
 
     // ---
@@ -452,11 +409,14 @@ struct fluid_dls_font
     // wave, offset is at chunk header
     inline void parse_wvpl(fluid_long_long_t offset);
     inline void parse_wave(fluid_long_long_t offset, fluid_dls_sample &sample);
+    inline void load_sampledata(bool try_mlock);
+    inline int convert_sampledata(int16_t *dest) noexcept;
     // offset is at wsmpnnnn^... (chunk data)
     inline uint32_t parse_wsmp(fluid_long_long_t offset, fluid_dls_wsmp &wsmp);
 
 #if LIBSNDFILE_SUPPORT
     inline void parse_wave_sndfile(fluid_long_long_t offset, fluid_dls_sample &sample);
+    inline void read_wave_sndfile(const fluid_dls_sample &sample, int16_t *dest);
 #endif
 
     // lins, offset is at chunk header
@@ -474,6 +434,10 @@ struct fluid_dls_font
     // info
     inline std::string read_name_from_info_entries(fluid_long_long_t offset, uint32_t size);
 
+    // voice setup, done once at load so that a note-on only copies the results
+    inline void merge_mods(fluid_dls_articulation &articulation);
+    inline void flatten_region(fluid_dls_region &region);
+
     // utilities
     void fseek(fluid_long_long_t pos, int whence)
     {
@@ -778,6 +742,140 @@ inline std::string fluid_dls_font::read_name_from_info_entries(fluid_long_long_t
     return "";
 }
 
+// Merges the articulation modulators into the default ones of the font, like
+// fluid_voice_add_mod_local() with FLUID_VOICE_OVERWRITE does when adding them to a voice
+inline void fluid_dls_font::merge_mods(fluid_dls_articulation &articulation)
+{
+    auto &merged = articulation.merged_mods;
+
+    for(const fluid_mod_t *mod = sfont->default_mod_list; mod != nullptr; mod = mod->next)
+    {
+        merged.push_back(*mod);
+        merged.back().next = nullptr;
+    }
+
+    const auto default_count = merged.size();
+
+    for(const auto &mod : articulation.mods)
+    {
+        auto end = merged.begin() + default_count;
+        auto existing = std::find_if(merged.begin(), end, [&mod](const fluid_mod_t &default_mod)
+        {
+            return fluid_mod_test_identity(&default_mod, &mod);
+        });
+
+        if(existing != end)
+        {
+            existing->amount = mod.amount;
+        }
+        else
+        {
+            merged.push_back(mod);
+        }
+    }
+
+    // more than a voice takes, leave the warning to fluid_voice_add_mod_local()
+    articulation.mods_merged = merged.size() <= FLUID_NUM_MOD;
+}
+
+// Collects the generators the articulation and the wsmp of a region set on a voice, into
+// the values set and those added to the defaults of the voice
+inline void fluid_dls_font::flatten_region(fluid_dls_region &region)
+{
+    std::optional<fluid_real_t> set[GEN_LAST];
+    std::optional<fluid_real_t> incr[GEN_LAST];
+    const auto &sample = samples_fluid.at(region.sampleindex);
+
+    // the values are rounded to float as fluid_voice_gen_set() and fluid_voice_gen_incr() do
+    auto gen_set = [&set, &incr](int gen, float value)
+    {
+        set[gen] = value;
+        incr[gen].reset();
+    };
+
+    auto gen_incr = [&set, &incr](int gen, float value)
+    {
+        if(set[gen].has_value())
+        {
+            set[gen] = set[gen].value() + value;
+        }
+        else
+        {
+            incr[gen] = incr[gen].value_or(0) + value;
+        }
+    };
+
+    if(region.artindex != static_cast<uint32_t>(-1))
+    {
+        const auto &art = articulations.at(region.artindex);
+
+        for(int i = 0; i < GEN_LAST; i++)
+        {
+            if(art.gens[i].has_value())
+            {
+                gen_set(i, art.gens[i].value());
+            }
+        }
+
+        // See also https://github.com/FluidSynth/fluidsynth/pull/1626 conversation for "Key Number to Pitch" articulation implementation
+        gen_set(GEN_SCALETUNE, art.keyToPitch.amount / 128.0);
+    }
+
+    if(region.wsmp.has_value())
+    {
+        const auto &wsmp = region.wsmp.value();
+
+        gen_set(GEN_OVERRIDEROOTKEY, wsmp.unity_note);
+        gen_incr(GEN_FINETUNE, wsmp.fine_tune - sample.pitchadj);
+        gen_incr(GEN_ATTENUATION, -wsmp.gain / 65536.0f);
+
+        if(wsmp.loop_length != 0)
+        {
+            if(wsmp.loop_type == 0)
+            {
+                gen_set(GEN_SAMPLEMODE, 1);
+            }
+            else if(wsmp.loop_type == 1)
+            {
+                gen_set(GEN_SAMPLEMODE, 3);
+            }
+            else
+            {
+                FLUID_LOG(FLUID_WARN, "invalid loop type of region wsmp, set to loop and release");
+                gen_set(GEN_SAMPLEMODE, 3);
+            }
+        }
+        else
+        {
+            gen_set(GEN_SAMPLEMODE, 0);
+        }
+
+        gen_set(GEN_STARTLOOPADDROFS,
+                static_cast<int>(sample.start + wsmp.loop_start) - static_cast<int>(sample.loopstart));
+        gen_set(GEN_ENDLOOPADDROFS,
+                static_cast<int>(sample.start + wsmp.loop_start + wsmp.loop_length) - static_cast<int>(sample.loopend));
+    }
+    else
+    {
+        gen_incr(GEN_ATTENUATION, -region.gain_inherited);
+        gen_set(GEN_SAMPLEMODE, region.samplemode_inherited);
+    }
+
+    gen_set(GEN_EXCLUSIVECLASS, region.exclusive_class);
+
+    for(int i = 0; i < GEN_LAST; i++)
+    {
+        if(set[i].has_value())
+        {
+            region.gen_set.emplace_back(i, set[i].value());
+        }
+        else if(incr[i].has_value())
+        {
+            region.gen_incr.emplace_back(i, incr[i].value());
+        }
+    }
+}
+
 // DLS-2.2 2.5 <dlid-ck>, DLSID Chunk
 struct DLSID
 {
@@ -826,7 +924,8 @@ inline static void READGUID(fluid_dls_font *sf, DLSID &id)
 constexpr uint16_t WAVE_FORMAT_PCM = 0x0001;
 #endif
 
-static inline void read_data_lpcm(void *dest, const void *data, fluid_long_long_t size, int bitdepth)
+// bitdepth is 8 or 16, as checked by parse_wave()
+static inline void read_data_lpcm(void *dest, const void *data, fluid_long_long_t size, int bitdepth) noexcept
 {
     if(bitdepth == 16)
     {
@@ -834,12 +933,6 @@ static inline void read_data_lpcm(void *dest, const void *data, fluid_long_long_
         return;
     }
 
-    if(bitdepth != 8)
-    {
-        // this should never happen!
-        throw std::runtime_error{ "Unsupported bitdepth" };
-    }
-
     const auto *src = static_cast<const uint8_t *>(data);
     auto *dest16 = static_cast<int16_t *>(dest);
 
@@ -1637,22 +1730,19 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
 
     // reading sample data is now completed
 
-    FLUID_LOG(FLUID_DBG, "DLS %zu samples read, %zu bytes", samples.size(), sampledata.size());
-
-    sampledata_mlock = mlock_guard{ sampledata.data(), static_cast<fluid_long_long_t>(sampledata.size()) };
-
-    if(try_mlock && !sampledata.empty())
+    try
     {
-        if(sampledata_mlock.lock() != 0)
-        {
-            FLUID_LOG(FLUID_WARN, "Failed to pin the sample data to RAM; swapping is possible.");
-        }
-        else
-        {
-            FLUID_LOG(FLUID_DBG, "Sample data pinned to RAM, %zu bytes", sampledata.size());
-        }
+        const double trace_ref = fluid_trace_ref();
+        load_sampledata(try_mlock);
+        fluid_trace_span("dls_load_sampledata", trace_ref);
+    }
+    catch(...)
+    {
+        std::throw_with_nested(std::runtime_error{ "Exception thrown while loading samples" });
     }
 
+    FLUID_LOG(FLUID_DBG, "DLS %zu samples read, %lld sample points", samples.size(), sampledata_count);
+
     // Parse LIST[lins]
     try
     {
@@ -1722,11 +1812,23 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
             fluid.pitchadj = 0;
         }
 
-        fluid.data = sampledata.data();
+        fluid.data = sampledata;
         fluid.sampletype = FLUID_SAMPLETYPE_MONO;
         fluid.default_modulators = this->sfont->default_mod_list;
     }
 
+    try
+    {
+        for(auto &articulation : articulations)
+        {
+            merge_mods(articulation);
+        }
+    }
+    catch(...)
+    {
+        std::throw_with_nested(std::runtime_error{ "Exception thrown while merging modulators" });
+    }
+
     // put info in dls_sample into region
     for(auto &instrument : instruments)
     {
@@ -1768,6 +1870,15 @@ fluid_dls_font::fluid_dls_font(fluid_synth_t *synth,
                 region.samplemode_inherited = 0;
                 region.gain_inherited = 0;
             }
+
+            try
+            {
+                flatten_region(region);
+            }
+            catch(...)
+            {
+                std::throw_with_nested(std::runtime_error{ "Exception thrown while flattening region generators" });
+            }
         }
     }
 
@@ -2233,31 +2344,19 @@ inline void fluid_dls_font::parse_wave(fluid_long_long_t offset, fluid_dls_sampl
                 throw std::runtime_error{ "DLS data chunk not align to bitsPerSample" };
             }
 
-            auto samplelen = subchunk.size / (bitsPerSample / 8);
-            sample.start = sampledata.size();
-            sample.end = sample.start + samplelen;
-            sampledata.resize(sampledata.size() + samplelen);
-
-            char buffer[4096];
-            uint32_t remaining = subchunk.size;
-            int16_t *destination = sampledata.data() + sample.start;
-
-            while(remaining > 0)
+            if(pos + headersize + subchunk.size > filesize)
             {
-                uint32_t c = remaining > sizeof(buffer) ? sizeof(buffer) : remaining;
-
-                if(fcbs.fread(buffer, c, file) != FLUID_OK)
-                {
-                    FLUID_LOG(FLUID_ERR, "fcbs::fread failed when reading DLS data chunk");
-                    throw std::exception{};
-                }
-
-                read_data_lpcm(destination, buffer, c, bitsPerSample);
-
-                destination += c / (bitsPerSample / 8);
-                remaining -= c;
+                throw std::runtime_error{ "DLS data chunk exceeds file size" };
             }
 
+            // the data is read by load_sampledata(), once all waves are known
+            auto samplelen = subchunk.size / (bitsPerSample / 8);
+            sample.start = sampledata_count;
+            sample.end = sample.start + samplelen;
+            sample.data_offset = pos + headersize;
+            sample.data_size = subchunk.size;
+            sample.bits_per_sample = bitsPerSample;
+            sampledata_count += samplelen;
             break;
         }
 
@@ -2294,6 +2393,139 @@ inline void fluid_dls_font::parse_wave(fluid_long_long_t offset, fluid_dls_sampl
 #endif
 }
 
+// Gets the data of all waves, either from the sample cache or, if no other font has loaded the
+// same file, by converting the waves
+inline void fluid_dls_font::load_sampledata(bool try_mlock)
+{
+    if(sampledata_count <= 0)
+    {
+        return;
+    }
+
+    if(sampledata_count > std::numeric_limits<int>::max())
+    {
+        throw std::runtime_error{ "DLS waves are too large" };
+    }
+
+    auto convert = [](void *user_data, short *dest, int count [[maybe_unused]]) noexcept -> int
+    {
+        const double trace_ref = fluid_trace_ref();
+        const int ret = static_cast<fluid_dls_font *>(user_data)->convert_sampledata(dest);
+        fluid_trace_span("dls_convert_sampledata", trace_ref);
+        return ret;
+    };
+
+    // tells versions of the file apart in the cache
+    fluid_stat_buf_t statbuf;
+    const time_t mtime = (fluid_stat(filename.c_str(), &statbuf) == 0) ? statbuf.st_mtime : 0;
+
+    short *data = nullptr;
+    const int count = fluid_samplecache_load_converted(filename.c_str(), mtime,
+                      static_cast<unsigned int>(wvploffset), static_cast<unsigned int>(filesize),
+                      static_cast<int>(sampledata_count), try_mlock, convert, this, &data);
+
+    if(count != sampledata_count)
+    {
+        if(count >= 0)
+        {
+            fluid_samplecache_unload(data);
+        }
+
+        throw std::runtime_error{ "Failed to load the DLS waves" };
+    }
+
+    sampledata = data;
+}
+
+// Converts all waves to 16 bit, at dest + sample.start each.
+// If the file can be mapped, the PCM waves are converted in parallel, as reading them doesn't
+// need the file callbacks, which aren't thread safe.
+inline int fluid_dls_font::convert_sampledata(int16_t *dest) noexcept
+{
+    fluid_file_map_t map{};
+    const char *base = nullptr;
+
+    try
+    {
+#if LIBSNDFILE_SUPPORT
+
+        for(const auto &sample : samples)
+        {
+            if(sample.bits_per_sample == 0)
+            {
+                read_wave_sndfile(sample, dest + sample.start);
+            }
+        }
+
+#endif
+
+        if(fcbs.fread == safe_fread && fcbs.fseek == safe_fseek)
+        {
+            base = static_cast<const char *>(fluid_file_map(static_cast<FILE *>(file), 0, filesize, &map));
+        }
+
+        if(base == nullptr)
+        {
+            char buffer[4096];
+
+            for(const auto &sample : samples)
+            {
+                uint32_t remaining = sample.data_size;
+                int16_t *destination = dest + sample.start;
+
+                if(sample.bits_per_sample == 0)
+                {
+                    continue;
+                }
+
+                fseek(sample.data_offset, SEEK_SET);
+
+                while(remaining > 0)
+                {
+                    uint32_t c = remaining > sizeof(buffer) ? sizeof(buffer) : remaining;
+
+                    if(fcbs.fread(buffer, c, file) != FLUID_OK)
+                    {
+                        throw std::runtime_error{ "fcbs::fread failed when reading DLS data chunk" };
+                    }
+
+                    read_data_lpcm(destination, buffer, c, sample.bits_per_sample);
+
+                    destination += c / (sample.bits_per_sample / 8);
+                    remaining -= c;
+                }
+            }
+
+            return FLUID_OK;
+        }
+    }
+    catch(const std::exception &exc)
+    {
+        FLUID_LOG(FLUID_ERR, "Exception thrown while converting the DLS waves");
+        log_exception(FLUID_ERR, exc);
+        fluid_file_unmap(&map);
+        return FLUID_FAILED;
+    }
+
+    const fluid_dls_sample *waves = samples.data();
+    const int num_waves = static_cast<int>(samples.size());
+
+    #pragma omp parallel for schedule(dynamic) default(none) shared(waves, num_waves, base, dest)
+    for(int i = 0; i < num_waves; i++)
+    {
+        const fluid_dls_sample &sample = waves[i];
+
+        if(sample.bits_per_sample != 0)
+        {
+            read_data_lpcm(dest + sample.start, base + sample.data_offset, sample.data_size, sample.bits_per_sample);
+        }
+    }
+
+    FLUID_LOG(FLUID_DBG, "Converted %d DLS waves from the mapped file", num_waves);
+    fluid_file_unmap(&map);
+    return FLUID_OK;
+}
+
 inline uint32_t fluid_dls_font::parse_wsmp(fluid_long_long_t offset, fluid_dls_wsmp &wsmp)
 {
     fseek(offset, SEEK_SET);
@@ -2935,15 +3167,41 @@ inline void fluid_dls_font::parse_wave_sndfile(fluid_long_long_t offset, fluid_d
                                                 sfinfo.channels) };
     }
 
-    sample.start = sampledata.size();
+    // the wave is decoded by read_wave_sndfile(), once all waves are known
+    sample.start = sampledata_count;
     sample.end = sample.start + sfinfo.frames;
-    sampledata.resize(sampledata.size() + sfinfo.frames);
+    sample.data_offset = offset;
+    sample.bits_per_sample = 0;
+    sampledata_count += sfinfo.frames;
+
+    sf_close(sndfile);
+}
+
+inline void fluid_dls_font::read_wave_sndfile(const fluid_dls_sample &sample, int16_t *dest)
+{
+    RIFFChunk chunk;
+    fseek(sample.data_offset, SEEK_SET);
+    READCHUNK(this, chunk);
+
+    sfvio_data data{ this, sample.data_offset, 0, chunk.size + 12 };
+    sfvio_seek(0, SEEK_SET, &data);
+
+    SF_INFO sfinfo{};
+    auto *sndfile = sf_open_virtual(&sfvio, SFM_READ, &sfinfo, &data);
+
+    if(sndfile == nullptr)
+    {
+        throw std::runtime_error{ string_format("Failed to open 'wave' chunk using libsndfile: %s",
+                                                sf_strerror(sndfile)) };
+    }
 
-    auto count = sf_read_short(sndfile, sampledata.data() + sample.start, sfinfo.frames);
+    const sf_count_t frames = sample.end - sample.start;
+    auto count = sf_read_short(sndfile, dest, frames);
 
-    if(count != sfinfo.frames)
+    if(count != frames)
     {
         FLUID_LOG(FLUID_WARN, "Read 'wave' using libsndfile reached unexpected EOF");
+        std::fill(dest + std::max<sf_count_t>(count, 0), dest + frames, 0);
     }
 
     sf_close(sndfile);
@@ -3057,8 +3315,10 @@ static fluid_sfont_t *fluid_dls_loader_load(fluid_sfloader_t *loader, const char
         }
     }
 
+    const double trace_ref = fluid_trace_ref();
     auto *dlsfont =
         new_fluid_dls_font(sfloader_data->synth, sfont, &loader->file_callbacks, filename, sample_rate, try_mlock);
+    fluid_trace_span("dls_load", trace_ref);
 
     if(dlsfont == nullptr)
     {
@@ -3080,11 +3340,60 @@ static fluid_preset_t *fluid_dls_sfont_get_preset(fluid_sfont_t *sfont, int bank
 {
     auto *dlsfont = static_cast<fluid_dls_font *>(fluid_sfont_get_data(sfont));
 
-    for(auto &inst : dlsfont->instruments_fluid_data)
+    if(dlsfont->preset_index_bank_select != dlsfont->synth->bank_select)
     {
-        if(fluid_dls_preset_get_banknum(&inst.fluid) == bank && inst.pcnum == prenum)
+        try
         {
-            return &inst.fluid;
+            dlsfont->preset_index.clear();
+            dlsfont->preset_index.reserve(dlsfont->instruments_fluid_data.size());
+
+            for(auto &inst : dlsfont->instruments_fluid_data)
+            {
+                dlsfont->preset_index.emplace_back(fluid_dls_preset_get_banknum(&inst.fluid) * 128 + inst.pcnum,
+                                                   &inst.fluid);
+            }
+
+            // stable, so that the first of the presets with the same bank and program is found
+            std::stable_sort(dlsfont->preset_index.begin(),
+                             dlsfont->preset_index.end(),
+                             [](const auto & lhs, const auto & rhs)
+            {
+                return lhs.first < rhs.first;
+            });
+
+            dlsfont->preset_index_bank_select = dlsfont->synth->bank_select;
+        }
+        catch(...)
+        {
+            dlsfont->preset_index.clear();
+            dlsfont->preset_index_bank_select = -1;
+        }
+    }
+
+    if(dlsfont->preset_index_bank_select == dlsfont->synth->bank_select)
+    {
+        const int key = bank * 128 + prenum;
+        auto it = std::lower_bound(dlsfont->preset_index.begin(),
+                                   dlsfont->preset_index.end(),
+                                   key,
+                                   [](const auto & entry, int k)
+        {
+            return entry.first < k;
+        });
+
+        if(it != dlsfont->preset_index.end() && it->first == key)
+        {
+            return it->second;
+        }
+    }
+    else
+    {
+        for(auto &inst : dlsfont->instruments_fluid_data)
+        {
+            if(fluid_dls_preset_get_banknum(&inst.fluid) == bank && inst.pcnum == prenum)
+            {
+                return &inst.fluid;
+            }
         }
     }
 
@@ -3241,87 +3550,55 @@ static int fluid_dls_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth,
             continue;
         }
 
-        auto *voice = fluid_synth_alloc_voice_LOCAL(
-                          synth, dlspreset->samples_fluid + region.sampleindex, chan, adjusted_key, vel, &region.range);
+        auto *sample = dlspreset->samples_fluid + region.sampleindex;
+        fluid_dls_articulation *art = nullptr;
+        fluid_mod_t *default_mod;
+        unsigned int generation;
+
+        if(region.artindex != static_cast<uint32_t>(-1))
+        {
+            art = &dlspreset->articulations[region.artindex];
+        }
+
+        // the modulators merged at load apply unless the channel replaces default ones
+        const bool merged = art != nullptr && art->mods_merged
+                            && fluid_synth_get_default_mods_LOCAL(synth, sample, chan, &default_mod, &generation);
+
+        auto *voice = fluid_synth_alloc_voice_LOCAL(synth, sample, chan, adjusted_key, vel, &region.range, !merged);
 
         if(voice == nullptr)
         {
             return FLUID_FAILED;
         }
 
-        if(region.artindex != static_cast<uint32_t>(-1))
+        if(merged)
         {
-            auto &art = dlspreset->articulations[region.artindex];
-
-            for(int i = 0; i < GEN_LAST; i++)
+            for(auto &mod : art->merged_mods)
             {
-                if(art.gens[i].has_value())
-                {
-                    fluid_voice_gen_set(voice, i, art.gens[i].value());
-                }
+                fluid_voice_add_mod_local(voice, &mod, FLUID_VOICE_DEFAULT, 0);
             }
-
+        }
+        else if(art != nullptr)
+        {
             // this should be the count of default mods to be probably overwritten
             auto existing_mod_count = voice->mod_count;
 
-            for(auto &mod : art.mods)
+            for(auto &mod : art->mods)
             {
                 fluid_voice_add_mod_local(voice, &mod, FLUID_VOICE_OVERWRITE, existing_mod_count);
             }
-
-            // See also https://github.com/FluidSynth/fluidsynth/pull/1626 conversation for "Key Number to Pitch" articulation implementation
-            fluid_voice_gen_set(voice,
-                                GEN_SCALETUNE,
-                                dlspreset->articulations[region.artindex].keyToPitch.amount / 128.0);
         }
 
-        if(region.wsmp.has_value())
+        for(const auto &[gen, value] : region.gen_set)
         {
-            const auto &wsmp = region.wsmp.value();
-            const auto &sample = dlspreset->samples_fluid[region.sampleindex];
-
-            fluid_voice_gen_set(voice, GEN_OVERRIDEROOTKEY, wsmp.unity_note);
-            fluid_voice_gen_incr(voice, GEN_FINETUNE, wsmp.fine_tune - sample.pitchadj);
-            fluid_voice_gen_incr(voice, GEN_ATTENUATION, -wsmp.gain / 65536.0f);
-
-            if(wsmp.loop_length != 0)
-            {
-                if(wsmp.loop_type == 0)
-                {
-                    fluid_voice_gen_set(voice, GEN_SAMPLEMODE, 1);
-                }
-                else if(wsmp.loop_type == 1)
-                {
-                    fluid_voice_gen_set(voice, GEN_SAMPLEMODE, 3);
-                }
-                else
-                {
-                    FLUID_LOG(FLUID_WARN, "invalid loop type of region wsmp, set to loop and release");
-                    fluid_voice_gen_set(voice, GEN_SAMPLEMODE, 3);
-                }
-            }
-            else
-            {
-                fluid_voice_gen_set(voice, GEN_SAMPLEMODE, 0);
-            }
-
-            fluid_voice_gen_set(voice,
-                                GEN_STARTLOOPADDROFS,
-                                static_cast<int>(sample.start + wsmp.loop_start) -
-                                static_cast<int>(sample.loopstart));
-            fluid_voice_gen_set(voice,
-                                GEN_ENDLOOPADDROFS,
-                                static_cast<int>(sample.start + wsmp.loop_start + wsmp.loop_length) -
-                                static_cast<int>(sample.loopend));
+            fluid_voice_gen_set(voice, gen, value);
         }
-        else
+
+        for(const auto &[gen, value] : region.gen_incr)
         {
-            fluid_voice_gen_incr(voice, GEN_ATTENUATION, -region.gain_inherited);
-            fluid_voice_gen_set(voice, GEN_SAMPLEMODE, region.samplemode_inherited);
+            fluid_voice_gen_incr(voice, gen, value);
         }
 
-        fluid_voice_gen_set(voice, GEN_EXCLUSIVECLASS, region.exclusive_class);
-
         fluid_synth_start_voice(synth, voice);
     }
 
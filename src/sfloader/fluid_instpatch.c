@@ -2,6 +2,8 @@
 #include "fluid_instpatch.h"
 #include "fluid_list.h"
 #include "fluid_sfont.h"
+#include "fluid_samplecache.h"
+#include "fluid_mod.h"
 #include "fluid_sys.h"
 
 #include <libinstpatch/libinstpatch.h>
@@ -10,6 +12,8 @@ typedef struct _fluid_instpatch_font_t
 {
     char name[256];
     IpatchDLS2 *dls;
+    int try_mlock;                  /* see synth.lock-memory */
+    time_t mtime;                   /* modification time of the file, see fluid_samplecache_load_converted() */
 
     fluid_list_t *preset_list;      /* the presets of this soundfont */
     fluid_list_t *preset_iter_cur;       /* the current preset in the iteration */
@@ -30,11 +34,18 @@ typedef struct _fluid_instpatch_preset_t
 // private struct for storing additional data for each instpatch voice
 typedef struct _instpatch_voice_user_data
 {
-    /* pointer to the sample store that holds the PCM */
+    /* pointer to the sample store that holds the PCM, NULL if the PCM is in the sample cache */
     IpatchSampleStoreCache *sample_store;
 
-    /* pointer to a preallocated fluid_sample_t that we can use during noteon for this voice */
+    /* the PCM read into the sample cache, NULL if it is held by sample_store */
+    short *cached_data;
+
+    /* the sample of this voice, set up at load to reference the PCM without copying it */
     fluid_sample_t *sample;
+
+    /* the modulators of this voice, converted at load */
+    fluid_mod_t *mods;
+    int mod_count;
 } fluid_instpatch_voice_user_data_t;
 
 
@@ -115,13 +126,11 @@ fluid_instpatch_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int
     /* voice index array */
     guint16 voice_indices[MAX_INST_VOICES];
     int sel_values[IPATCH_SF2_VOICE_CACHE_MAX_SEL_VALUES];
-    fluid_mod_t *fmod = g_alloca(fluid_mod_sizeof());
     fluid_voice_t *flvoice;
 
     fluid_instpatch_preset_t *preset_data = fluid_preset_get_data(preset);
 
     int i, voice_count, voice_num, ret = FLUID_FAILED;
-    GSList *p;
 
     /* lookup the voice cache that we've created on loading */
     IpatchSF2VoiceCache *cache = preset_data->cache;
@@ -161,50 +170,19 @@ fluid_instpatch_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int
     for(voice_num = 0; voice_num < voice_count; voice_num++)
     {
         IpatchSF2GenArray *gen_array;
-        fluid_sample_t *fsample;
+        fluid_instpatch_voice_user_data_t *data;
 
         IpatchSF2Voice *voice = IPATCH_SF2_VOICE_CACHE_GET_VOICE(cache, voice_indices[voice_num]);
+        data = voice->user_data;
 
-        if(!voice->sample_store)
+        if(data->sample->data == NULL)
         {
             /* For ROM and other non-readable samples */
             continue;
         }
 
-        fsample = ((fluid_instpatch_voice_user_data_t *)voice->user_data)->sample;
-
-        ret = fluid_sample_set_sound_data(fsample,
-                                          ipatch_sample_store_cache_get_location(IPATCH_SAMPLE_STORE_CACHE(voice->sample_store)),
-                                          NULL,
-                                          voice->sample_size,
-                                          voice->rate,
-                                          FALSE
-                                         );
-
-        if(FLUID_UNLIKELY(ret == FLUID_FAILED))
-        {
-            FLUID_LOG(FLUID_ERR, "fluid_sample_set_sound_data() failed");
-            goto error_rec;
-        }
-
-        ret = fluid_sample_set_loop(fsample, voice->loop_start, voice->loop_end);
-
-        if(FLUID_UNLIKELY(ret == FLUID_FAILED))
-        {
-            FLUID_LOG(FLUID_ERR, "fluid_sample_set_loop() failed");
-            goto error_rec;
-        }
-
-        ret = fluid_sample_set_pitch(fsample, voice->root_note, voice->fine_tune);
-
-        if(FLUID_UNLIKELY(ret == FLUID_FAILED))
-        {
-            FLUID_LOG(FLUID_ERR, "fluid_sample_set_pitch() failed");
-            goto error_rec;
-        }
-
         /* allocate the FluidSynth voice */
-        flvoice = fluid_synth_alloc_voice(synth, fsample, chan, key, vel);
+        flvoice = fluid_synth_alloc_voice(synth, data->sample, chan, key, vel);
 
         if(flvoice == NULL)
         {
@@ -223,35 +201,12 @@ fluid_instpatch_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int
             }
         }
 
-        p = voice->mod_list;
-
-        while(p)
+        for(i = 0; i < data->mod_count; i++)
         {
-            static const unsigned int mod_mask =
-                (IPATCH_SF2_MOD_MASK_DIRECTION | IPATCH_SF2_MOD_MASK_POLARITY | IPATCH_SF2_MOD_MASK_TYPE);
-
-            IpatchSF2Mod *mod = p->data;
-
-            fluid_mod_set_dest(fmod, mod->dest);
-            fluid_mod_set_source1(fmod,
-                                  mod->src & IPATCH_SF2_MOD_MASK_CONTROL,
-                                  ((mod->src & mod_mask) >> IPATCH_SF2_MOD_SHIFT_DIRECTION)
-                                  | ((mod->src & IPATCH_SF2_MOD_MASK_CC) ? FLUID_MOD_CC : 0));
-
-            fluid_mod_set_source2(fmod,
-                                  mod->amtsrc & IPATCH_SF2_MOD_MASK_CONTROL,
-                                  ((mod->amtsrc & mod_mask) >> IPATCH_SF2_MOD_SHIFT_DIRECTION)
-                                  | ((mod->amtsrc & IPATCH_SF2_MOD_MASK_CC) ? FLUID_MOD_CC : 0));
-
-            fluid_mod_set_amount(fmod, mod->amount);
-            fluid_voice_add_mod(flvoice, fmod, FLUID_VOICE_OVERWRITE);
-
-            p = p->next;
+            fluid_voice_add_mod(flvoice, &data->mods[i], FLUID_VOICE_OVERWRITE);
         }
 
         fluid_synth_start_voice(synth, flvoice);
-
-        /* sample store reference taken over by fsample structure */
     }
 
     ret = FLUID_OK;
@@ -314,41 +269,218 @@ fluid_instpatch_sfont_get_preset(fluid_sfont_t *sfont, int bank, int prenum)
     return NULL;
 }
 
-static fluid_instpatch_voice_user_data_t *new_fluid_instpatch_voice_user_data(IpatchSampleStoreCache *sample_store)
+/* sample cache callback reading the PCM of a voice */
+static int fluid_instpatch_read_sample(void *user_data, short *sample_data, int sample_count)
 {
-    fluid_instpatch_voice_user_data_t *data = FLUID_NEW(fluid_instpatch_voice_user_data_t);
-    fluid_sample_t *sample = new_fluid_sample();
+    IpatchSF2Voice *voice = user_data;
+    GError *err = NULL;
 
-    if(data == NULL || sample == NULL)
+    if(!ipatch_sample_read_transform(IPATCH_SAMPLE(voice->sample_data), 0, sample_count, sample_data,
+                                     IPATCH_SAMPLE_16BIT | IPATCH_SAMPLE_MONO | IPATCH_SAMPLE_SIGNED | IPATCH_SAMPLE_ENDIAN_HOST,
+                                     IPATCH_SAMPLE_UNITY_CHANNEL_MAP, &err))
+    {
+        FLUID_LOG(FLUID_ERR, "ipatch_sample_read_transform() failed with error: '%s'", ipatch_gerror_message(err));
+        g_clear_error(&err);
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
+}
+
+/*
+ * Reads the PCM of a mono sample stored in the patch file into the sample cache, so
+ * that loading the file again, e.g. by another synth, shares it.
+ * @return the PCM, NULL if the sample isn't read from the file this way
+ */
+static short *fluid_instpatch_load_cached_sample(fluid_instpatch_font_t *patchfont, IpatchSF2Voice *voice)
+{
+    IpatchSampleStore *store;
+    guint location = 0;
+    gboolean in_file;
+    short *data = NULL;
+    int format;
+
+    if(voice->sample_data == NULL || voice->sample_size == 0)
+    {
+        return NULL;
+    }
+
+    format = ipatch_sample_get_format(IPATCH_SAMPLE(voice->sample_data));
+
+    if(IPATCH_SAMPLE_FORMAT_GET_CHANNEL_COUNT(format) != 1)
     {
-        FLUID_FREE(data);
-        delete_fluid_sample(sample);
-        FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
 
-    data->sample = sample;
+    /* ++ ref primary store */
+    store = ipatch_sample_data_get_primary_store(voice->sample_data);
+
+    if(store == NULL)
+    {
+        return NULL;
+    }
+
+    in_file = IPATCH_IS_SAMPLE_STORE_FILE(store);
+
+    if(in_file)
+    {
+        g_object_get(store, "location", &location, NULL);
+    }
+
+    /* -- unref primary store */
+    g_object_unref(store);
+
+    if(!in_file
+            || fluid_samplecache_load_converted(patchfont->name, patchfont->mtime, location,
+                                                voice->sample_size * ipatch_sample_format_size(format),
+                                                voice->sample_size, patchfont->try_mlock,
+                                                fluid_instpatch_read_sample, voice, &data) < 0)
+    {
+        return NULL;
+    }
 
-    /* Keep sample store cached by doing a dummy open */
-    ipatch_sample_store_cache_open(sample_store);
-    data->sample_store = sample_store;
     return data;
 }
 
+/* converts the modulators of the voice, the libinstpatch ones to the fluidsynth ones */
+static int fluid_instpatch_convert_mods(fluid_instpatch_voice_user_data_t *data, IpatchSF2Voice *voice)
+{
+    static const unsigned int mod_mask =
+        (IPATCH_SF2_MOD_MASK_DIRECTION | IPATCH_SF2_MOD_MASK_POLARITY | IPATCH_SF2_MOD_MASK_TYPE);
+
+    GSList *p;
+    int count = g_slist_length(voice->mod_list);
+
+    if(count == 0)
+    {
+        return FLUID_OK;
+    }
+
+    data->mods = FLUID_ARRAY(fluid_mod_t, count);
+
+    if(data->mods == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMSET(data->mods, 0, count * sizeof(fluid_mod_t));
+
+    for(p = voice->mod_list; p != NULL; p = p->next)
+    {
+        IpatchSF2Mod *mod = p->data;
+        fluid_mod_t *fmod = &data->mods[data->mod_count++];
+
+        fluid_mod_set_dest(fmod, mod->dest);
+        fluid_mod_set_source1(fmod,
+                              mod->src & IPATCH_SF2_MOD_MASK_CONTROL,
+                              ((mod->src & mod_mask) >> IPATCH_SF2_MOD_SHIFT_DIRECTION)
+                              | ((mod->src & IPATCH_SF2_MOD_MASK_CC) ? FLUID_MOD_CC : 0));
+
+        fluid_mod_set_source2(fmod,
+                              mod->amtsrc & IPATCH_SF2_MOD_MASK_CONTROL,
+                              ((mod->amtsrc & mod_mask) >> IPATCH_SF2_MOD_SHIFT_DIRECTION)
+                              | ((mod->amtsrc & IPATCH_SF2_MOD_MASK_CC) ? FLUID_MOD_CC : 0));
+
+        fluid_mod_set_amount(fmod, mod->amount);
+    }
+
+    return FLUID_OK;
+}
+
 static void fluid_instpatch_on_voice_user_data_destroy(gpointer user_data)
 {
     fluid_instpatch_voice_user_data_t *data = user_data;
 
+    fluid_return_if_fail(data != NULL);
+
     delete_fluid_sample(data->sample);
-    ipatch_sample_store_cache_close(data->sample_store);
+
+    if(data->cached_data != NULL)
+    {
+        fluid_samplecache_unload(data->cached_data);
+    }
+
+    if(data->sample_store != NULL)
+    {
+        ipatch_sample_store_cache_close(data->sample_store);
+    }
+
+    FLUID_FREE(data->mods);
     FLUID_FREE(data);
 }
 
+/*
+ * Sets up the sample and the modulators of a voice, so that a noteon only has to copy them.
+ * The sample references the PCM either in the sample cache or in a RAM store of libinstpatch.
+ */
+static fluid_instpatch_voice_user_data_t *new_fluid_instpatch_voice_user_data(fluid_instpatch_font_t *patchfont,
+        IpatchSF2Voice *voice, const char **err)
+{
+    static const char cache_fail[] = "Failed to cache DLS inst to SF2 voices";
+    static const char sample_fail[] = "Failed to set up the sample of a voice";
+    static const char oom[] = "Out of memory";
+
+    fluid_instpatch_voice_user_data_t *data = FLUID_NEW(fluid_instpatch_voice_user_data_t);
+    short *pcm;
+
+    if(data == NULL)
+    {
+        *err = oom;
+        return NULL;
+    }
+
+    FLUID_MEMSET(data, 0, sizeof(*data));
+    data->sample = new_fluid_sample();
+
+    if(data->sample == NULL || fluid_instpatch_convert_mods(data, voice) == FLUID_FAILED)
+    {
+        *err = oom;
+        goto error_rec;
+    }
+
+    data->cached_data = fluid_instpatch_load_cached_sample(patchfont, voice);
+    pcm = data->cached_data;
+
+    if(pcm == NULL)
+    {
+        /* load the sample data into a RAM store of libinstpatch */
+        if(!ipatch_sf2_voice_cache_sample_data(voice, NULL))
+        {
+            *err = cache_fail;
+            goto error_rec;
+        }
+
+        if(voice->sample_store == NULL)
+        {
+            /* For ROM and other non-readable samples, the voice is skipped at noteon */
+            return data;
+        }
+
+        /* Keep sample store cached by doing a dummy open */
+        data->sample_store = IPATCH_SAMPLE_STORE_CACHE(voice->sample_store);
+        ipatch_sample_store_cache_open(data->sample_store);
+        pcm = ipatch_sample_store_cache_get_location(data->sample_store);
+    }
+
+    if(fluid_sample_set_sound_data(data->sample, pcm, NULL, voice->sample_size, voice->rate, FALSE) == FLUID_FAILED
+            || fluid_sample_set_loop(data->sample, voice->loop_start, voice->loop_end) == FLUID_FAILED
+            || fluid_sample_set_pitch(data->sample, voice->root_note, voice->fine_tune) == FLUID_FAILED)
+    {
+        *err = sample_fail;
+        goto error_rec;
+    }
+
+    return data;
+
+error_rec:
+    fluid_instpatch_on_voice_user_data_destroy(data);
+    return NULL;
+}
+
 static IpatchSF2VoiceCache *convert_dls_to_sf2_instrument(fluid_instpatch_font_t *patchfont, IpatchDLS2Inst *item, const char **err)
 {
     static const char no_conv[] = "Unable to find a voice cache converter for this type";
     static const char conv_fail[] = "Failed to convert DLS inst to SF2 voices";
-    static const char cache_fail[] = "Failed to cache DLS inst to SF2 voices";
     static const char oom[] = "Out of memory";
     
     IpatchConverter *conv;
@@ -394,23 +526,15 @@ static IpatchSF2VoiceCache *convert_dls_to_sf2_instrument(fluid_instpatch_font_t
     /* Use voice->user_data to close open cached stores */
     cache->voice_user_data_destroy = fluid_instpatch_on_voice_user_data_destroy;
 
-    /* loop over voices and load sample data into RAM */
+    /* loop over voices and set up their samples */
     count = cache->voices->len;
 
     for(i = 0; i < count; i++)
     {
         IpatchSF2Voice *voice = &g_array_index(cache->voices, IpatchSF2Voice, i);
 
-        if(!ipatch_sf2_voice_cache_sample_data(voice, NULL))
+        if((voice->user_data = new_fluid_instpatch_voice_user_data(patchfont, voice, err)) == NULL)
         {
-            *err = cache_fail;
-            g_object_unref(cache);
-            return NULL;
-        }
-
-        if((voice->user_data = new_fluid_instpatch_voice_user_data(IPATCH_SAMPLE_STORE_CACHE(voice->sample_store))) == NULL)
-        {
-            *err = oom;
             g_object_unref(cache);
             return NULL;
         }
@@ -421,9 +545,11 @@ static IpatchSF2VoiceCache *convert_dls_to_sf2_instrument(fluid_instpatch_font_t
 }
 
 
-fluid_instpatch_font_t *new_fluid_instpatch(fluid_sfont_t *sfont, const fluid_file_callbacks_t *fcbs, const char *filename)
+fluid_instpatch_font_t *new_fluid_instpatch(fluid_sfont_t *sfont, const fluid_file_callbacks_t *fcbs, const char *filename,
+        int try_mlock)
 {
     fluid_instpatch_font_t *patchfont = NULL;
+    fluid_stat_buf_t statbuf;
     GError *err = NULL;
     IpatchDLSReader *reader = NULL;
     IpatchDLSFile *file = NULL;
@@ -439,6 +565,12 @@ fluid_instpatch_font_t *new_fluid_instpatch(fluid_sfont_t *sfont, const fluid_fi
     FLUID_MEMSET(patchfont, 0, sizeof(*patchfont));
 
     FLUID_STRNCPY(&patchfont->name[0], filename, sizeof(patchfont->name));
+    patchfont->try_mlock = try_mlock;
+
+    if(fluid_stat(filename, &statbuf) == 0)
+    {
+        patchfont->mtime = statbuf.st_mtime;
+    }
 
     /* open a file, we get a reference */
     if((file = ipatch_dls_file_new()) == NULL)
@@ -655,6 +787,9 @@ static fluid_sfont_t *fluid_instpatch_loader_load(fluid_sfloader_t *loader, cons
 {
     fluid_instpatch_font_t *patchfont = NULL;
     fluid_sfont_t *sfont = NULL;
+    int try_mlock = FALSE;
+
+    fluid_settings_getint(fluid_sfloader_get_data(loader), "synth.lock-memory", &try_mlock);
 
     sfont = new_fluid_sfont(fluid_instpatch_sfont_get_name,
                             fluid_instpatch_sfont_get_preset,
@@ -667,7 +802,7 @@ static fluid_sfont_t *fluid_instpatch_loader_load(fluid_sfloader_t *loader, cons
         return NULL;
     }
 
-    if((patchfont = new_fluid_instpatch(sfont, &loader->file_callbacks, filename)) == NULL)
+    if((patchfont = new_fluid_instpatch(sfont, &loader->file_callbacks, filename, try_mlock)) == NULL)
     {
         delete_fluid_sfont(sfont);
         return NULL;
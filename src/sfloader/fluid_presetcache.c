@@ -0,0 +1,891 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/* PRESET CACHE
+ *
+ * Stores the presets, instruments and sample headers imported from a SoundFont in a file
+ * in the directory given by synth.preset-cache-dir, so that loading the SoundFont again
+ * neither needs to parse its HYDRA chunk nor to import all the zones again. A file consists
+ * of the header below, the key padded with zeros to a multiple of eight bytes, and the
+ * records written by preset_cache_write(), in native byte order. Files are only published
+ * complete by renaming them, so no locking is needed.
+ *
+ * The key is made of the layout of the SoundFont file and a hash of its HYDRA chunk, so the
+ * files stay valid when the SoundFont is moved, and are never used for a SoundFont that has
+ * been changed in the meantime. PRESET_CACHE_MAGIC has to be changed whenever the records
+ * or the way SoundFonts are imported change.
+ */
+
+#include "fluid_presetcache.h"
+#include "fluid_sys.h"
+#include "fluid_list.h"
+#include "fluid_hash.h"
+#include "fluid_mod.h"
+
+#define PRESET_CACHE_MAGIC "FLPRST01"
+
+typedef struct
+{
+    char magic[8];
+    uint32_t key_size;      /* size of the padded key following the header */
+    uint32_t data_size;     /* size of the records following the key */
+} preset_cache_header_t;
+
+/* A growing buffer the records get written to */
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t alloc;
+    int failed;
+} preset_cache_writer_t;
+
+/* The records read from a file */
+typedef struct
+{
+    const char *data;
+    size_t size;
+    size_t pos;
+    int failed;
+} preset_cache_reader_t;
+
+static void write_bytes(preset_cache_writer_t *writer, const void *data, size_t size)
+{
+    if(writer->failed)
+    {
+        return;
+    }
+
+    if(writer->size + size > writer->alloc)
+    {
+        size_t alloc = (writer->alloc > 0) ? writer->alloc : 65536;
+        char *new_data;
+
+        while(alloc < writer->size + size)
+        {
+            alloc *= 2;
+        }
+
+        new_data = FLUID_REALLOC(writer->data, alloc);
+
+        if(new_data == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            writer->failed = TRUE;
+            return;
+        }
+
+        writer->data = new_data;
+        writer->alloc = alloc;
+    }
+
+    FLUID_MEMCPY(writer->data + writer->size, data, size);
+    writer->size += size;
+}
+
+static void write_u8(preset_cache_writer_t *writer, unsigned int value)
+{
+    unsigned char byte = (unsigned char)value;
+    write_bytes(writer, &byte, sizeof(byte));
+}
+
+static void write_int(preset_cache_writer_t *writer, int value)
+{
+    int32_t word = value;
+    write_bytes(writer, &word, sizeof(word));
+}
+
+static void write_double(preset_cache_writer_t *writer, double value)
+{
+    write_bytes(writer, &value, sizeof(value));
+}
+
+static void read_bytes(preset_cache_reader_t *reader, void *data, size_t size)
+{
+    if(reader->failed || size > reader->size - reader->pos)
+    {
+        reader->failed = TRUE;
+        FLUID_MEMSET(data, 0, size);
+        return;
+    }
+
+    FLUID_MEMCPY(data, reader->data + reader->pos, size);
+    reader->pos += size;
+}
+
+static unsigned int read_u8(preset_cache_reader_t *reader)
+{
+    unsigned char byte;
+    read_bytes(reader, &byte, sizeof(byte));
+    return byte;
+}
+
+static int read_int(preset_cache_reader_t *reader)
+{
+    int32_t word;
+    read_bytes(reader, &word, sizeof(word));
+    return word;
+}
+
+/* Reads a count of records of at least record_size bytes each */
+static int read_count(preset_cache_reader_t *reader, size_t record_size)
+{
+    int count = read_int(reader);
+
+    if(count < 0 || (size_t)count > (reader->size - reader->pos) / record_size)
+    {
+        reader->failed = TRUE;
+        return 0;
+    }
+
+    return count;
+}
+
+static double read_double(preset_cache_reader_t *reader)
+{
+    double value;
+    read_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+/* Describes the imported SoundFont uniquely */
+static char *new_preset_cache_key(SFData *sf)
+{
+    uint64_t hash[2];
+    char *key;
+
+    if(fluid_sffile_hash_hydra(sf, hash) != FLUID_OK)
+    {
+        return NULL;
+    }
+
+    key = FLUID_MALLOC(256);
+
+    if(key == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_SNPRINTF(key, 256, "%u|%u.%u|%u|%u|%u|%u|%u|%u|%08x%08x|%08x%08x|%d|%d",
+                   sf->filesize, sf->version.major, sf->version.minor,
+                   sf->samplepos, sf->samplesize, sf->sample24pos, sf->sample24size,
+                   sf->hydrapos, sf->hydrasize,
+                   (unsigned int)(hash[0] >> 32), (unsigned int)(hash[0] & 0xffffffff),
+                   (unsigned int)(hash[1] >> 32), (unsigned int)(hash[1] & 0xffffffff),
+                   GEN_LAST, (int)FLUID_IS_BIG_ENDIAN);
+
+    return key;
+}
+
+static uint32_t preset_cache_key_size(const char *key)
+{
+    return (uint32_t)((FLUID_STRLEN(key) + 1 + 7) & ~(size_t)7);
+}
+
+/* The name of the file is a 64 bit FNV-1a hash of its key */
+static void preset_cache_path(char *path, size_t size, const char *cache_dir, const char *key, const char *suffix)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char *c;
+
+    for(c = (const unsigned char *)key; *c != '\0'; c++)
+    {
+        hash = (hash ^ *c) * 1099511628211ULL;
+    }
+
+    FLUID_SNPRINTF(path, size, "%s/fluidsynth-%08x%08x%s", cache_dir,
+                   (unsigned int)(hash >> 32), (unsigned int)(hash & 0xffffffff), suffix);
+}
+
+/*
+ * Records
+ */
+
+static void write_mods(preset_cache_writer_t *writer, const fluid_mod_t *mod)
+{
+    const fluid_mod_t *m;
+    int count = 0;
+
+    for(m = mod; m != NULL; m = m->next)
+    {
+        count++;
+    }
+
+    write_int(writer, count);
+
+    for(m = mod; m != NULL; m = m->next)
+    {
+        write_u8(writer, m->dest);
+        write_u8(writer, m->src1);
+        write_u8(writer, m->flags1);
+        write_u8(writer, m->src2);
+        write_u8(writer, m->flags2);
+        write_u8(writer, m->trans);
+        write_double(writer, m->amount);
+    }
+}
+
+/* Reads a list of modulators, allocated from the arena if not NULL */
+static int read_mods(preset_cache_reader_t *reader, fluid_arena_t *arena, fluid_mod_t **mod)
+{
+    fluid_mod_t *m, *last = NULL;
+    int i, count = read_count(reader, 6 + sizeof(double));
+
+    for(i = 0; i < count; i++)
+    {
+        m = (arena != NULL) ? FLUID_ARENA_NEW(arena, fluid_mod_t) : new_fluid_mod();
+
+        if(m == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        m->dest = read_u8(reader);
+        m->src1 = read_u8(reader);
+        m->flags1 = read_u8(reader);
+        m->src2 = read_u8(reader);
+        m->flags2 = read_u8(reader);
+        m->trans = read_u8(reader);
+        m->amount = read_double(reader);
+        m->next = NULL;
+
+        /* keep the order of the modulators */
+        if(last == NULL)
+        {
+            *mod = m;
+        }
+        else
+        {
+            last->next = m;
+        }
+
+        last = m;
+    }
+
+    return reader->failed ? FLUID_FAILED : FLUID_OK;
+}
+
+/* Zones of presets and instruments, ref is the index of the instrument or sample, -1 if none */
+static void write_zone(preset_cache_writer_t *writer, int ref, const fluid_zone_range_t *range,
+                       const fluid_gen_t *gen, const fluid_mod_t *mod)
+{
+    int i, count = 0;
+
+    write_int(writer, ref);
+    write_int(writer, range->keylo);
+    write_int(writer, range->keyhi);
+    write_int(writer, range->vello);
+    write_int(writer, range->velhi);
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        if(gen[i].flags != GEN_UNUSED)
+        {
+            count++;
+        }
+    }
+
+    write_int(writer, count);
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        if(gen[i].flags != GEN_UNUSED)
+        {
+            write_u8(writer, i);
+            write_u8(writer, gen[i].flags);
+            write_double(writer, gen[i].val);
+        }
+    }
+
+    write_mods(writer, mod);
+}
+
+static int read_zone(preset_cache_reader_t *reader, fluid_arena_t *arena, int *ref, fluid_zone_range_t *range,
+                     fluid_gen_t *gen, fluid_mod_t **mod)
+{
+    int i, id, count;
+
+    *ref = read_int(reader);
+    range->keylo = read_int(reader);
+    range->keyhi = read_int(reader);
+    range->vello = read_int(reader);
+    range->velhi = read_int(reader);
+
+    count = read_count(reader, 2 + sizeof(double));
+
+    for(i = 0; i < count; i++)
+    {
+        id = read_u8(reader);
+
+        if(id >= GEN_LAST)
+        {
+            return FLUID_FAILED;
+        }
+
+        gen[id].flags = read_u8(reader);
+        gen[id].val = read_double(reader);
+    }
+
+    return read_mods(reader, arena, mod);
+}
+
+static void write_inst_zone(preset_cache_writer_t *writer, const fluid_inst_zone_t *zone, fluid_hashtable_t *sample_idx)
+{
+    void *idx = zone->sample ? fluid_hashtable_lookup(sample_idx, zone->sample) : NULL;
+    write_zone(writer, FLUID_POINTER_TO_INT(idx) - 1, &zone->range, zone->gen, zone->mod);
+}
+
+static void write_preset_zone(preset_cache_writer_t *writer, const fluid_preset_zone_t *zone)
+{
+    write_zone(writer, zone->inst ? zone->inst->source_idx : -1, &zone->range, zone->gen, zone->mod);
+}
+
+/* Zones are prepended when adding them, so they get written from the last one
+ * to restore them in the original order */
+static void write_inst_zones(preset_cache_writer_t *writer, const fluid_inst_zone_t *zone, fluid_hashtable_t *sample_idx)
+{
+    if(zone != NULL)
+    {
+        write_inst_zones(writer, zone->next, sample_idx);
+        write_inst_zone(writer, zone, sample_idx);
+    }
+}
+
+static void write_preset_zones(preset_cache_writer_t *writer, const fluid_preset_zone_t *zone)
+{
+    if(zone != NULL)
+    {
+        write_preset_zones(writer, zone->next);
+        write_preset_zone(writer, zone);
+    }
+}
+
+static void preset_cache_write(preset_cache_writer_t *writer, const fluid_defsfont_t *defsfont, SFData *sf)
+{
+    fluid_hashtable_t *sample_idx = new_fluid_hashtable(fluid_direct_hash, fluid_direct_equal);
+    fluid_list_t *list;
+    fluid_inst_t *inst;
+    fluid_inst_zone_t *inst_zone;
+    fluid_defpreset_t *defpreset;
+    fluid_preset_zone_t *preset_zone;
+    SFSample *sfsample;
+    int i, count;
+
+    if(sample_idx == NULL)
+    {
+        writer->failed = TRUE;
+        return;
+    }
+
+    write_mods(writer, defsfont->sfont->default_mod_list);
+
+    /* all sample headers, they are validated again when reading them */
+    write_int(writer, fluid_list_size(sf->sample));
+
+    for(i = 1, list = sf->sample; list; i++, list = fluid_list_next(list))
+    {
+        sfsample = fluid_list_get(list);
+
+        if(sfsample->fluid_sample != NULL)
+        {
+            fluid_hashtable_insert(sample_idx, sfsample->fluid_sample, FLUID_INT_TO_POINTER(i));
+        }
+
+        write_bytes(writer, sfsample->name, sizeof(sfsample->name));
+        write_int(writer, sfsample->start);
+        write_int(writer, sfsample->end);
+        write_int(writer, sfsample->loopstart);
+        write_int(writer, sfsample->loopend);
+        write_int(writer, sfsample->samplerate);
+        write_u8(writer, sfsample->origpitch);
+        write_u8(writer, (unsigned char)sfsample->pitchadj);
+        write_int(writer, sfsample->sampletype);
+    }
+
+    write_int(writer, fluid_list_size(defsfont->inst));
+
+    for(list = defsfont->inst; list; list = fluid_list_next(list))
+    {
+        inst = fluid_list_get(list);
+
+        for(count = 0, inst_zone = inst->zone; inst_zone; inst_zone = inst_zone->next)
+        {
+            count++;
+        }
+
+        write_int(writer, inst->source_idx);
+        write_bytes(writer, inst->name, sizeof(inst->name));
+        write_u8(writer, inst->global_zone != NULL);
+        write_int(writer, count);
+
+        if(inst->global_zone != NULL)
+        {
+            write_inst_zone(writer, inst->global_zone, sample_idx);
+        }
+
+        write_inst_zones(writer, inst->zone, sample_idx);
+    }
+
+    write_int(writer, fluid_list_size(defsfont->preset));
+
+    for(list = defsfont->preset; list; list = fluid_list_next(list))
+    {
+        defpreset = fluid_preset_get_data((fluid_preset_t *)fluid_list_get(list));
+
+        for(count = 0, preset_zone = defpreset->zone; preset_zone; preset_zone = preset_zone->next)
+        {
+            count++;
+        }
+
+        write_bytes(writer, defpreset->name, sizeof(defpreset->name));
+        write_int(writer, defpreset->bank);
+        write_int(writer, defpreset->num);
+        write_u8(writer, defpreset->global_zone != NULL);
+        write_int(writer, count);
+
+        if(defpreset->global_zone != NULL)
+        {
+            write_preset_zone(writer, defpreset->global_zone);
+        }
+
+        write_preset_zones(writer, defpreset->zone);
+    }
+
+    delete_fluid_hashtable(sample_idx);
+}
+
+static fluid_inst_t *read_inst(preset_cache_reader_t *reader, fluid_arena_t *arena, fluid_sample_t **samples, int sample_count)
+{
+    fluid_inst_t *inst = new_fluid_inst(arena);
+    fluid_inst_zone_t *zone;
+    char zone_name[256];
+    int i, ref, has_global, count;
+
+    if(inst == NULL)
+    {
+        return NULL;
+    }
+
+    inst->source_idx = read_int(reader);
+    read_bytes(reader, inst->name, sizeof(inst->name));
+    inst->name[sizeof(inst->name) - 1] = '\0';
+    has_global = read_u8(reader);
+    count = read_count(reader, 6 * sizeof(int32_t));
+
+    for(i = has_global ? -1 : 0; !reader->failed && i < count; i++)
+    {
+        /* the same names as given by fluid_inst_import_sfont() */
+        FLUID_SNPRINTF(zone_name, sizeof(zone_name), "iz:%s/%d", inst->name, has_global ? i + 1 : i);
+        zone = new_fluid_inst_zone(arena, zone_name);
+
+        if(zone == NULL)
+        {
+            break;
+        }
+
+        if(read_zone(reader, arena, &ref, &zone->range, zone->gen, &zone->mod) != FLUID_OK || ref >= sample_count)
+        {
+            break;
+        }
+
+        zone->sample = (ref >= 0) ? samples[ref] : NULL;
+
+        if(i < 0)
+        {
+            fluid_inst_set_global_zone(inst, zone);
+        }
+        else if(fluid_inst_add_zone(inst, zone) != FLUID_OK)
+        {
+            break;
+        }
+    }
+
+    /* on failure, the instrument and its zones are freed with the arena */
+    if(i < count)
+    {
+        return NULL;
+    }
+
+    return inst;
+}
+
+static fluid_defpreset_t *read_preset(preset_cache_reader_t *reader, fluid_arena_t *arena, fluid_hashtable_t *insts)
+{
+    fluid_defpreset_t *defpreset = new_fluid_defpreset(arena);
+    fluid_preset_zone_t *zone;
+    char zone_name[256];
+    int i, ref, has_global, count;
+
+    if(defpreset == NULL)
+    {
+        return NULL;
+    }
+
+    read_bytes(reader, defpreset->name, sizeof(defpreset->name));
+    defpreset->name[sizeof(defpreset->name) - 1] = '\0';
+    defpreset->bank = read_int(reader);
+    defpreset->num = read_int(reader);
+    has_global = read_u8(reader);
+    count = read_count(reader, 6 * sizeof(int32_t));
+
+    for(i = has_global ? -1 : 0; !reader->failed && i < count; i++)
+    {
+        /* the same names as given by fluid_defpreset_import_sfont() */
+        FLUID_SNPRINTF(zone_name, sizeof(zone_name), "pz:%s/%d", defpreset->name, has_global ? i + 1 : i);
+        zone = new_fluid_preset_zone(arena, zone_name);
+
+        if(zone == NULL)
+        {
+            break;
+        }
+
+        if(read_zone(reader, arena, &ref, &zone->range, zone->gen, &zone->mod) != FLUID_OK)
+        {
+            break;
+        }
+
+        if(ref >= 0)
+        {
+            zone->inst = fluid_hashtable_lookup(insts, FLUID_INT_TO_POINTER(ref + 1));
+
+            if(zone->inst == NULL || fluid_preset_zone_create_voice_zones(arena, zone, defpreset->global_zone) == FLUID_FAILED)
+            {
+                break;
+            }
+        }
+
+        if(i < 0)
+        {
+            fluid_defpreset_set_global_zone(defpreset, zone);
+        }
+        else if(fluid_defpreset_add_zone(defpreset, zone) != FLUID_OK)
+        {
+            break;
+        }
+    }
+
+    /* on failure, the preset and its zones are freed with the arena */
+    if(i < count || fluid_defpreset_index_zones(arena, defpreset) != FLUID_OK)
+    {
+        return NULL;
+    }
+
+    return defpreset;
+}
+
+/* Removes everything preset_cache_read() might have added to the SoundFont */
+static void preset_cache_clear(fluid_defsfont_t *defsfont)
+{
+    fluid_list_t *list;
+    fluid_mod_t *mod;
+
+    for(list = defsfont->preset; list; list = fluid_list_next(list))
+    {
+        fluid_defpreset_preset_delete(fluid_list_get(list));
+    }
+
+    delete_fluid_list(defsfont->preset);
+    defsfont->preset = NULL;
+    delete_fluid_list(defsfont->inst);
+    defsfont->inst = NULL;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        delete_fluid_sample(fluid_list_get(list));
+    }
+
+    delete_fluid_list(defsfont->sample);
+    defsfont->sample = NULL;
+
+    while(defsfont->sfont->default_mod_list != NULL)
+    {
+        mod = defsfont->sfont->default_mod_list;
+        defsfont->sfont->default_mod_list = mod->next;
+        delete_fluid_mod(mod);
+    }
+
+    /* the instruments, presets and their zones */
+    fluid_arena_clear(defsfont->arena);
+}
+
+static int preset_cache_read(preset_cache_reader_t *reader, fluid_defsfont_t *defsfont)
+{
+    fluid_sample_t **samples = NULL;
+    fluid_inst_t **insts = NULL;
+    fluid_hashtable_t *inst_idx = new_fluid_hashtable(fluid_direct_hash, fluid_direct_equal);
+    fluid_defpreset_t *defpreset;
+    SFSample sfsample;
+    int i, sample_count, inst_count = 0, count, ret = FLUID_FAILED;
+
+    if(inst_idx == NULL || read_mods(reader, NULL, &defsfont->sfont->default_mod_list) != FLUID_OK)
+    {
+        goto exit;
+    }
+
+    sample_count = read_count(reader, sizeof(sfsample.name) + 6 * sizeof(int32_t) + 2);
+    samples = FLUID_ARRAY(fluid_sample_t *, sample_count + 1);
+
+    if(samples == NULL)
+    {
+        goto exit;
+    }
+
+    for(i = 0; i < sample_count; i++)
+    {
+        FLUID_MEMSET(&sfsample, 0, sizeof(sfsample));
+        read_bytes(reader, sfsample.name, sizeof(sfsample.name));
+        sfsample.name[sizeof(sfsample.name) - 1] = '\0';
+        sfsample.idx = i;
+        sfsample.start = read_int(reader);
+        sfsample.end = read_int(reader);
+        sfsample.loopstart = read_int(reader);
+        sfsample.loopend = read_int(reader);
+        sfsample.samplerate = read_int(reader);
+        sfsample.origpitch = read_u8(reader);
+        sfsample.pitchadj = (signed char)read_u8(reader);
+        sfsample.sampletype = read_int(reader);
+
+        samples[i] = new_fluid_sample();
+
+        if(samples[i] == NULL)
+        {
+            goto exit;
+        }
+
+        /* the same as fluid_defsfont_load() does with the sample headers */
+        if(fluid_sample_import_sfont(samples[i], &sfsample, defsfont) == FLUID_OK)
+        {
+            fluid_defsfont_add_sample(defsfont, samples[i]);
+        }
+        else
+        {
+            delete_fluid_sample(samples[i]);
+            samples[i] = NULL;
+        }
+    }
+
+    inst_count = read_count(reader, 3 * sizeof(int32_t));
+    insts = FLUID_ARRAY(fluid_inst_t *, inst_count + 1);
+
+    if(insts == NULL)
+    {
+        goto exit;
+    }
+
+    FLUID_MEMSET(insts, 0, (inst_count + 1) * sizeof(*insts));
+
+    for(i = 0; i < inst_count; i++)
+    {
+        insts[i] = read_inst(reader, defsfont->arena, samples, sample_count);
+
+        if(insts[i] == NULL)
+        {
+            goto exit;
+        }
+
+        fluid_hashtable_insert(inst_idx, FLUID_INT_TO_POINTER(insts[i]->source_idx + 1), insts[i]);
+    }
+
+    /* build the list backwards, to keep the order without walking it */
+    for(i = inst_count - 1; i >= 0; i--)
+    {
+        defsfont->inst = fluid_list_prepend(defsfont->inst, insts[i]);
+    }
+
+    count = read_count(reader, sizeof(defpreset->name) + 3 * sizeof(int32_t) + 1);
+
+    for(i = 0; i < count; i++)
+    {
+        defpreset = read_preset(reader, defsfont->arena, inst_idx);
+
+        if(defpreset == NULL || fluid_defsfont_add_preset(defsfont, defpreset) == FLUID_FAILED)
+        {
+            goto exit;
+        }
+    }
+
+    if(!reader->failed && reader->pos == reader->size)
+    {
+        ret = FLUID_OK;
+    }
+
+exit:
+    FLUID_FREE(insts);
+    FLUID_FREE(samples);
+    delete_fluid_hashtable(inst_idx);
+
+    if(ret != FLUID_OK)
+    {
+        preset_cache_clear(defsfont);
+    }
+
+    return ret;
+}
+
+/*
+ * Restores the samples, instruments and presets of a SoundFont from the preset cache.
+ *
+ * @param defsfont the SoundFont being loaded, without any samples or presets yet
+ * @param sf the SoundFont file, only opened and not parsed
+ * @param cache_dir the directory of the preset cache
+ * @return FLUID_OK if the SoundFont has been restored, FLUID_FAILED if the SoundFont has not
+ * been found in the cache, leaving defsfont unchanged
+ */
+int fluid_presetcache_load(fluid_defsfont_t *defsfont, SFData *sf, const char *cache_dir)
+{
+    char path[1024];
+    preset_cache_header_t header;
+    preset_cache_reader_t reader;
+    char *key, *stored_key = NULL, *data = NULL;
+    uint32_t key_size;
+    FILE *file;
+    int ret = FLUID_FAILED;
+
+    key = new_preset_cache_key(sf);
+
+    if(key == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    key_size = preset_cache_key_size(key);
+    preset_cache_path(path, sizeof(path), cache_dir, key, ".prst");
+    file = FLUID_FOPEN(path, "rb");
+
+    if(file == NULL)
+    {
+        FLUID_FREE(key);
+        return FLUID_FAILED;
+    }
+
+    stored_key = FLUID_MALLOC(key_size);
+
+    if(stored_key != NULL
+            && FLUID_FREAD(&header, sizeof(header), 1, file) == 1
+            && memcmp(header.magic, PRESET_CACHE_MAGIC, sizeof(header.magic)) == 0
+            && header.key_size == key_size
+            && FLUID_FREAD(stored_key, key_size, 1, file) == 1
+            && FLUID_STRCMP(stored_key, key) == 0
+            && (data = FLUID_MALLOC(header.data_size + 1)) != NULL
+            && FLUID_FREAD(data, 1, header.data_size, file) == header.data_size)
+    {
+        FLUID_MEMSET(&reader, 0, sizeof(reader));
+        reader.data = data;
+        reader.size = header.data_size;
+        ret = preset_cache_read(&reader, defsfont);
+
+        if(ret != FLUID_OK)
+        {
+            FLUID_LOG(FLUID_WARN, "Ignoring invalid preset cache file '%s'", path);
+        }
+        else
+        {
+            FLUID_LOG(FLUID_DBG, "Loaded the presets of '%s' from '%s'", sf->fname, path);
+        }
+    }
+
+    FLUID_FCLOSE(file);
+    FLUID_FREE(data);
+    FLUID_FREE(stored_key);
+    FLUID_FREE(key);
+
+    return ret;
+}
+
+/*
+ * Stores the samples, instruments and presets imported from a SoundFont in the
+ * preset cache. Failing to do so only slows down loading the SoundFont again.
+ *
+ * @param defsfont the SoundFont that has been loaded
+ * @param sf the SoundFont file the presets have been parsed from
+ * @param cache_dir the directory of the preset cache
+ */
+void fluid_presetcache_store(const fluid_defsfont_t *defsfont, SFData *sf, const char *cache_dir)
+{
+    char path[1024], temp_path[1024], suffix[64];
+    preset_cache_header_t header;
+    preset_cache_writer_t writer;
+    char *key, *padded_key;
+    uint32_t key_size;
+    FILE *file;
+    int written;
+    long pid = 0;
+
+    key = new_preset_cache_key(sf);
+
+    if(key == NULL)
+    {
+        return;
+    }
+
+    FLUID_MEMSET(&writer, 0, sizeof(writer));
+    preset_cache_write(&writer, defsfont, sf);
+
+    key_size = preset_cache_key_size(key);
+    padded_key = FLUID_MALLOC(key_size);
+
+    if(writer.failed || writer.size > UINT32_MAX || padded_key == NULL)
+    {
+        FLUID_FREE(writer.data);
+        FLUID_FREE(padded_key);
+        FLUID_FREE(key);
+        return;
+    }
+
+    FLUID_MEMSET(padded_key, 0, key_size);
+    FLUID_STRCPY(padded_key, key);
+
+    FLUID_MEMCPY(header.magic, PRESET_CACHE_MAGIC, sizeof(header.magic));
+    header.key_size = key_size;
+    header.data_size = (uint32_t)writer.size;
+
+#if HAVE_UNISTD_H
+    pid = (long)getpid();
+#endif
+
+    /* the temporary file is unique to this process and SoundFont */
+    FLUID_SNPRINTF(suffix, sizeof(suffix), ".%ld.%lx.tmp", pid, (unsigned long)(uintptr_t)defsfont);
+    preset_cache_path(path, sizeof(path), cache_dir, key, ".prst");
+    preset_cache_path(temp_path, sizeof(temp_path), cache_dir, key, suffix);
+
+    file = FLUID_FOPEN(temp_path, "wb");
+
+    if(file == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to create '%s', presets are not cached", temp_path);
+    }
+    else
+    {
+        written = (fwrite(&header, sizeof(header), 1, file) == 1
+                   && fwrite(padded_key, key_size, 1, file) == 1
+                   && fwrite(writer.data, 1, writer.size, file) == writer.size);
+        written = (FLUID_FCLOSE(file) == 0) && written;
+
+        if(!written || rename(temp_path, path) != 0)
+        {
+            FLUID_LOG(FLUID_WARN, "Failed to write '%s', presets are not cached", path);
+            remove(temp_path);
+        }
+    }
+
+    FLUID_FREE(writer.data);
+    FLUID_FREE(padded_key);
+    FLUID_FREE(key);
+}
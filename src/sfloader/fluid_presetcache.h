@@ -0,0 +1,30 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FLUID_PRESETCACHE_H
+#define _FLUID_PRESETCACHE_H
+
+#include "fluid_defsfont.h"
+#include "fluid_sffile.h"
+
+int fluid_presetcache_load(fluid_defsfont_t *defsfont, SFData *sf, const char *cache_dir);
+void fluid_presetcache_store(const fluid_defsfont_t *defsfont, SFData *sf, const char *cache_dir);
+
+#endif /* _FLUID_PRESETCACHE_H */
@@ -24,19 +24,26 @@
  *
  * This is a wrapper around fluid_sffile_read_sample_data that attempts to cache the read
  * data across all FluidSynth instances in a global (process-wide) list.
+ *
+ * The entries are found by their key and by their sample data through hash tables. The data
+ * is loaded without holding the mutex, so that instances can load SoundFonts in parallel. An
+ * entry is added to the key index before its data is loaded, so that other threads asking
+ * for the same data wait for the thread loading it instead of loading it again.
  */
 
 #include "fluid_samplecache.h"
 #include "fluid_sys.h"
 #include "fluid_list.h"
+#include "fluid_hash.h"
+#include "fluid_rvoice.h"
 
 
 typedef struct _fluid_samplecache_entry_t fluid_samplecache_entry_t;
 
-struct _fluid_samplecache_entry_t
+/* Identifies the sample data of an entry */
+typedef struct
 {
-    /* The following members all form the cache key */
-    char *filename;
+    const char *filename;
     time_t modification_time;
     unsigned int sf_samplepos;
     unsigned int sf_samplesize;
@@ -45,194 +52,584 @@ struct _fluid_samplecache_entry_t
     unsigned int sample_start;
     unsigned int sample_end;
     int sample_type;
-    /*  End of cache key members */
+} fluid_samplecache_key_t;
+
+struct _fluid_samplecache_entry_t
+{
+    fluid_samplecache_key_t key;     /* its filename points to the one below */
+    char *filename;
 
     int sample_count;
     short *sample_data;
     char *sample_data24;
+    fluid_real_t *sample_data_float; /* converted on first request, see synth.sample-format */
+    signed char *sample_data_compressed; /* if not NULL, replaces sample_data and sample_data24 */
+    fluid_file_map_t map;            /* if mapped, the mapping of sample_data, see synth.sample-mmap */
+    fluid_file_map_t map24;          /* if mapped, the mapping of sample_data24 */
+
+    /* if not NULL, the entry with identical sample data that is used instead of this one,
+     * which keeps no data of its own, see synth.sample-dedup */
+    fluid_samplecache_entry_t *alias_of;
+    uint64_t hash;                   /* of the sample data, if it may be deduplicated */
 
     int num_references;
     int mlocked;
+    int mlocked_float;
+
+    /* while the thread that added the entry loads its data, see samplecache_acquire() */
+    int loading;
+    int waiters;                     /* threads waiting for the data to be loaded */
+    fluid_samplecache_entry_t *result; /* the entry to use once loaded, NULL if loading failed */
+    fluid_cond_mutex_t *load_m;      /* protects loading and result */
+    fluid_cond_t *load_cond;         /* signalled when loading is done */
 };
 
 static fluid_list_t *samplecache_list = NULL;
+static fluid_hashtable_t *samplecache_index = NULL;      /* all entries by their key */
+static fluid_hashtable_t *samplecache_data_index = NULL; /* entries holding data by its address */
 static fluid_mutex_t samplecache_mutex = FLUID_MUTEX_INIT;
 
-static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf, unsigned int sample_start,
-        unsigned int sample_end, int sample_type, time_t mtime);
-static fluid_samplecache_entry_t *get_samplecache_entry(SFData *sf, unsigned int sample_start,
-        unsigned int sample_end, int sample_type, time_t mtime);
+static void samplecache_init_key(fluid_samplecache_key_t *key, const char *filename, time_t mtime,
+                                 unsigned int samplepos, unsigned int samplesize,
+                                 unsigned int sample24pos, unsigned int sample24size,
+                                 unsigned int sample_start, unsigned int sample_end, int sample_type);
+static fluid_samplecache_entry_t *samplecache_acquire(const fluid_samplecache_key_t *key, int *is_new);
+static fluid_samplecache_entry_t *samplecache_entry_loaded(fluid_samplecache_entry_t *entry, int loaded, int dedup);
+static void samplecache_entry_release(fluid_samplecache_entry_t *entry);
+static int samplecache_entry_read(fluid_samplecache_entry_t *entry, SFData *sf, int sample_type,
+                                  int try_mmap, const char *shared_dir);
 static void delete_samplecache_entry(fluid_samplecache_entry_t *entry);
+static int samplecache_entry_convert_float(fluid_samplecache_entry_t *entry, int huge_pages);
+static int samplecache_entry_compress(fluid_samplecache_entry_t *entry, int huge_pages);
+static void samplecache_entry_mlock(fluid_samplecache_entry_t *entry);
+static fluid_samplecache_entry_t *samplecache_entry_dedup(fluid_samplecache_entry_t *entry);
+static void samplecache_remove_aliases(const fluid_samplecache_entry_t *entry);
 
-static int fluid_get_file_modification_time(char *filename, time_t *modification_time);
+#if FLUID_HAVE_FILE_MAP
+static char *new_shared_cache_key(SFData *sf, unsigned int sample_start, unsigned int sample_end,
+                                  int sample_type);
+static int shared_cache_attach(fluid_samplecache_entry_t *entry, const char *shared_dir, const char *key);
+static void shared_cache_publish(const fluid_samplecache_entry_t *entry, const char *shared_dir, const char *key);
+#endif
 
 
 /* PUBLIC INTERFACE */
 
 int fluid_samplecache_load(SFData *sf,
                            unsigned int sample_start, unsigned int sample_end, int sample_type,
-                           int try_mlock, short **sample_data, char **sample_data24)
+                           int try_mlock, int mode, const char *shared_dir, int dedup,
+                           short **sample_data, char **sample_data24, fluid_real_t **sample_data_float,
+                           signed char **sample_data_compressed, int *is_mapped)
 {
+    fluid_samplecache_key_t key;
     fluid_samplecache_entry_t *entry;
-    int ret;
-    time_t mtime;
+    int is_new, loaded;
+    /* the compressed data replaces the original points, so it can't be shared with the entries
+     * keeping them */
+    int key_type = (sample_data_compressed != NULL) ? (sample_type | FLUID_SAMPLECACHE_COMPRESSED) : sample_type;
+
+    samplecache_init_key(&key, sf->fname, sf->mtime, sf->samplepos, sf->samplesize,
+                         sf->sample24pos, sf->sample24size, sample_start, sample_end, key_type);
 
     fluid_mutex_lock(samplecache_mutex);
+    entry = samplecache_acquire(&key, &is_new);
 
-    if(fluid_get_file_modification_time(sf->fname, &mtime) == FLUID_FAILED)
+    if(entry == NULL)
     {
-        mtime = 0;
+        fluid_mutex_unlock(samplecache_mutex);
+        return -1;
     }
 
-    entry = get_samplecache_entry(sf, sample_start, sample_end, sample_type, mtime);
-
-    if(entry == NULL)
+    if(is_new)
     {
         fluid_mutex_unlock(samplecache_mutex);
-        entry = new_samplecache_entry(sf, sample_start, sample_end, sample_type, mtime);
 
-        if(entry == NULL)
+        /* data that is compressed right away is neither mapped nor shared with other processes */
+        if(sample_data_compressed != NULL)
         {
-            ret = -1;
-            goto unlock_exit;
+            mode = FLUID_SAMPLECACHE_READ;
+            shared_dir = NULL;
         }
 
+        loaded = (samplecache_entry_read(entry, sf, sample_type, mode != FLUID_SAMPLECACHE_READ, shared_dir) == FLUID_OK)
+                 && (sample_data_compressed == NULL
+                     || samplecache_entry_compress(entry, sf->huge_pages) == FLUID_OK);
+
         fluid_mutex_lock(samplecache_mutex);
-        samplecache_list = fluid_list_prepend(samplecache_list, entry);
+
+        /* only the data read into memory takes memory of its own */
+        entry = samplecache_entry_loaded(entry, loaded, dedup && entry->map.addr == NULL);
+
+        if(entry == NULL)
+        {
+            fluid_mutex_unlock(samplecache_mutex);
+            return -1;
+        }
     }
+
+    /* the entry may be shared with a soundfont that didn't ask for floats */
+    if(sample_data_float != NULL && entry->sample_data_float == NULL
+            && samplecache_entry_convert_float(entry, sf->huge_pages) == FLUID_FAILED)
+    {
+        samplecache_entry_release(entry);
         fluid_mutex_unlock(samplecache_mutex);
+        return -1;
+    }
+
+    fluid_mutex_unlock(samplecache_mutex);
 
-    if(try_mlock && !entry->mlocked)
+    /* streamed data is paged in and out on demand */
+    if(mode == FLUID_SAMPLECACHE_STREAM && entry->map.addr != NULL)
     {
-        /* Lock the memory to disable paging. It's okay if this fails. It
-         * probably means that the user doesn't have the required permission. */
-        if(fluid_mlock(entry->sample_data, entry->sample_count * sizeof(short)) == 0)
-        {
-            if(entry->sample_data24 != NULL)
-            {
-                entry->mlocked = (fluid_mlock(entry->sample_data24, entry->sample_count) == 0);
-            }
-            else
-            {
-                entry->mlocked = TRUE;
-            }
-
-            if(!entry->mlocked)
-            {
-                fluid_munlock(entry->sample_data, entry->sample_count * sizeof(short));
-                FLUID_LOG(FLUID_WARN, "Failed to pin the sample data to RAM; swapping is possible.");
-            }
-        }
+        try_mlock = FALSE;
+    }
+
+    if(try_mlock)
+    {
+        samplecache_entry_mlock(entry);
+    }
+
+    if(try_mlock && entry->sample_data_float != NULL && !entry->mlocked_float)
+    {
+        entry->mlocked_float = (fluid_mlock(entry->sample_data_float,
+                                            entry->sample_count * sizeof(fluid_real_t)) == 0);
     }
 
-    entry->num_references++;
     *sample_data = entry->sample_data;
     *sample_data24 = entry->sample_data24;
-    ret = entry->sample_count;
+    *is_mapped = (entry->map.addr != NULL);
 
-unlock_exit:
-    return ret;
+    if(sample_data_float != NULL)
+    {
+        *sample_data_float = entry->sample_data_float;
+    }
+
+    if(sample_data_compressed != NULL)
+    {
+        *sample_data_compressed = entry->sample_data_compressed;
+    }
+
+    return entry->sample_count;
 }
 
-int fluid_samplecache_unload(const short *sample_data)
+/*
+ * Like fluid_samplecache_load(), for sample data that doesn't come from a SoundFont file
+ * but is converted from another file format, like the waves of a DLS file.
+ *
+ * The entry is keyed by the file name and modification time and by data_pos and data_size,
+ * which must identify the converted data within the file, such as the position and
+ * size of the chunk holding it. If there is no such entry yet, sample_count points are
+ * allocated and filled by convert().
+ *
+ * @return the number of sample points, -1 on error
+ */
+int fluid_samplecache_load_converted(const char *filename, time_t mtime,
+                                     unsigned int data_pos, unsigned int data_size,
+                                     int sample_count, int try_mlock,
+                                     fluid_samplecache_convert_t convert, void *user_data,
+                                     short **sample_data)
 {
-    fluid_list_t *entry_list;
+    fluid_samplecache_key_t key;
     fluid_samplecache_entry_t *entry;
-    int ret;
+    int is_new, loaded;
 
-    fluid_mutex_lock(samplecache_mutex);
+    fluid_return_val_if_fail(sample_count > 0, -1);
 
-    entry_list = samplecache_list;
+    samplecache_init_key(&key, filename, mtime, data_pos, data_size, 0, 0,
+                         0, sample_count - 1, FLUID_SAMPLECACHE_CONVERTED);
 
-    while(entry_list)
+    fluid_mutex_lock(samplecache_mutex);
+    entry = samplecache_acquire(&key, &is_new);
+
+    if(entry != NULL && is_new)
     {
-        entry = (fluid_samplecache_entry_t *)fluid_list_get(entry_list);
+        fluid_mutex_unlock(samplecache_mutex);
+
+        entry->sample_count = sample_count;
+        entry->sample_data = FLUID_ARRAY(short, sample_count);
 
-        if(sample_data == entry->sample_data)
+        if(entry->sample_data == NULL)
         {
-            entry->num_references--;
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+        }
 
-            if(entry->num_references == 0)
-            {
-                if(entry->mlocked)
-                {
-                    fluid_munlock(entry->sample_data, entry->sample_count * sizeof(short));
+        loaded = (entry->sample_data != NULL && convert(user_data, entry->sample_data, sample_count) == FLUID_OK);
 
-                    if(entry->sample_data24 != NULL)
-                    {
-                        fluid_munlock(entry->sample_data24, entry->sample_count);
-                    }
-                }
+        fluid_mutex_lock(samplecache_mutex);
+        entry = samplecache_entry_loaded(entry, loaded, FALSE);
+    }
 
-                samplecache_list = fluid_list_remove(samplecache_list, entry);
-                delete_samplecache_entry(entry);
-            }
+    fluid_mutex_unlock(samplecache_mutex);
 
-            ret = FLUID_OK;
-            goto unlock_exit;
-        }
+    if(entry == NULL)
+    {
+        return -1;
+    }
 
-        entry_list = fluid_list_next(entry_list);
+    if(try_mlock)
+    {
+        samplecache_entry_mlock(entry);
     }
 
-    FLUID_LOG(FLUID_ERR, "Trying to free sample data not found in cache.");
-    ret = FLUID_FAILED;
+    *sample_data = entry->sample_data;
+
+    return entry->sample_count;
+}
+
+int fluid_samplecache_unload(const void *sample_data)
+{
+    fluid_samplecache_entry_t *entry = NULL;
+
+    fluid_return_val_if_fail(sample_data != NULL, FLUID_FAILED);
+
+    fluid_mutex_lock(samplecache_mutex);
+
+    if(samplecache_data_index != NULL)
+    {
+        entry = (fluid_samplecache_entry_t *)fluid_hashtable_lookup(samplecache_data_index, sample_data);
+    }
+
+    if(entry != NULL)
+    {
+        samplecache_entry_release(entry);
+    }
 
-unlock_exit:
     fluid_mutex_unlock(samplecache_mutex);
-    return ret;
+
+    if(entry == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Trying to free sample data not found in cache.");
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
 }
 
 
 /* Private functions */
-static fluid_samplecache_entry_t *new_samplecache_entry(SFData *sf,
-        unsigned int sample_start,
-        unsigned int sample_end,
-        int sample_type,
-        time_t mtime)
+
+static unsigned int samplecache_key_hash(const void *key)
 {
-    fluid_samplecache_entry_t *entry;
+    const fluid_samplecache_key_t *k = (const fluid_samplecache_key_t *)key;
+    unsigned int values[8];
+    unsigned int hash = fluid_str_hash(k->filename);
+    int i;
+
+    values[0] = (unsigned int)k->modification_time;
+    values[1] = k->sf_samplepos;
+    values[2] = k->sf_samplesize;
+    values[3] = k->sf_sample24pos;
+    values[4] = k->sf_sample24size;
+    values[5] = k->sample_start;
+    values[6] = k->sample_end;
+    values[7] = (unsigned int)k->sample_type;
+
+    for(i = 0; i < 8; i++)
+    {
+        hash = (hash ^ values[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static int samplecache_key_equal(const void *a, const void *b)
+{
+    const fluid_samplecache_key_t *ka = (const fluid_samplecache_key_t *)a;
+    const fluid_samplecache_key_t *kb = (const fluid_samplecache_key_t *)b;
+
+    return (FLUID_STRCMP(ka->filename, kb->filename) == 0) &&
+           (ka->modification_time == kb->modification_time) &&
+           (ka->sf_samplepos == kb->sf_samplepos) &&
+           (ka->sf_samplesize == kb->sf_samplesize) &&
+           (ka->sf_sample24pos == kb->sf_sample24pos) &&
+           (ka->sf_sample24size == kb->sf_sample24size) &&
+           (ka->sample_start == kb->sample_start) &&
+           (ka->sample_end == kb->sample_end) &&
+           (ka->sample_type == kb->sample_type);
+}
+
+static void samplecache_init_key(fluid_samplecache_key_t *key, const char *filename, time_t mtime,
+                                 unsigned int samplepos, unsigned int samplesize,
+                                 unsigned int sample24pos, unsigned int sample24size,
+                                 unsigned int sample_start, unsigned int sample_end, int sample_type)
+{
+    key->filename = filename;
+    key->modification_time = mtime;
+    key->sf_samplepos = samplepos;
+    key->sf_samplesize = samplesize;
+    key->sf_sample24pos = sample24pos;
+    key->sf_sample24size = sample24size;
+    key->sample_start = sample_start;
+    key->sample_end = sample_end;
+    key->sample_type = sample_type;
+}
+
+/* The address an entry is unloaded by, NULL if it holds no data of its own */
+static void *samplecache_entry_data(fluid_samplecache_entry_t *entry)
+{
+    if(entry->sample_data_compressed != NULL)
+    {
+        return entry->sample_data_compressed;
+    }
+
+    return entry->sample_data;
+}
+
+/* Finds the entry of a key and takes a reference to it, or to the entry it is an alias of.
+ * If another thread is still loading the data of the entry, waits for it to be done.
+ *
+ * If there is no such entry, adds a new one with is_new set, whose data is to be loaded by
+ * the calling thread without holding the mutex, and passed to samplecache_entry_loaded().
+ *
+ * Returns NULL on error or if the data couldn't be loaded. Must be called with the mutex
+ * held, which is released while waiting. */
+static fluid_samplecache_entry_t *samplecache_acquire(const fluid_samplecache_key_t *key, int *is_new)
+{
+    fluid_samplecache_entry_t *entry, *result;
 
-    entry = FLUID_NEW(fluid_samplecache_entry_t);
+    *is_new = FALSE;
+
+    if(samplecache_index == NULL)
+    {
+        samplecache_index = new_fluid_hashtable(samplecache_key_hash, samplecache_key_equal);
+        samplecache_data_index = new_fluid_hashtable(fluid_direct_hash, fluid_direct_equal);
+
+        if(samplecache_index == NULL || samplecache_data_index == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            delete_fluid_hashtable(samplecache_index);
+            delete_fluid_hashtable(samplecache_data_index);
+            samplecache_index = samplecache_data_index = NULL;
+            return NULL;
+        }
+    }
+
+    entry = (fluid_samplecache_entry_t *)fluid_hashtable_lookup(samplecache_index, key);
 
     if(entry == NULL)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        return NULL;
+        entry = FLUID_NEW(fluid_samplecache_entry_t);
+
+        if(entry == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return NULL;
+        }
+
+        FLUID_MEMSET(entry, 0, sizeof(*entry));
+        entry->key = *key;
+        entry->filename = FLUID_STRDUP(key->filename);
+        entry->key.filename = entry->filename;
+        entry->load_m = new_fluid_cond_mutex();
+        entry->load_cond = new_fluid_cond();
+        entry->loading = TRUE;
+
+        if(entry->filename == NULL || entry->load_m == NULL || entry->load_cond == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            delete_samplecache_entry(entry);
+            return NULL;
+        }
+
+        fluid_hashtable_insert(samplecache_index, &entry->key, entry);
+        *is_new = TRUE;
+
+        return entry;
     }
 
-    FLUID_MEMSET(entry, 0, sizeof(*entry));
+    if(!entry->loading)
+    {
+        result = (entry->alias_of != NULL) ? entry->alias_of : entry;
+        result->num_references++;
 
-    entry->filename = FLUID_STRDUP(sf->fname);
+        return result;
+    }
+
+    /* the loading thread takes a reference to the result for each waiting thread */
+    entry->waiters++;
+    fluid_mutex_unlock(samplecache_mutex);
 
-    if(entry->filename == NULL)
+    fluid_cond_mutex_lock(entry->load_m);
+
+    while(entry->loading)
     {
-        FLUID_LOG(FLUID_ERR, "Out of memory");
-        goto error_exit;
+        fluid_cond_wait(entry->load_cond, entry->load_m);
+    }
+
+    result = entry->result;
+    fluid_cond_mutex_unlock(entry->load_m);
+
+    fluid_mutex_lock(samplecache_mutex);
+
+    if(--entry->waiters == 0)
+    {
+        delete_fluid_cond(entry->load_cond);
+        delete_fluid_cond_mutex(entry->load_m);
+        entry->load_cond = NULL;
+        entry->load_m = NULL;
+
+        /* a failed entry is no longer in the cache */
+        if(result == NULL)
+        {
+            delete_samplecache_entry(entry);
+        }
+    }
+
+    return result;
+}
+
+/* Publishes an entry added by samplecache_acquire() once its data is loaded, possibly as an
+ * alias of another entry holding the same data, or removes it if loading failed. Hands a
+ * reference to the entry to use to the calling thread and each thread waiting for it, and
+ * returns it, NULL if loading failed. Must be called with the mutex held. */
+static fluid_samplecache_entry_t *samplecache_entry_loaded(fluid_samplecache_entry_t *entry, int loaded, int dedup)
+{
+    fluid_samplecache_entry_t *result = NULL;
+
+    if(loaded)
+    {
+        if(dedup)
+        {
+            result = samplecache_entry_dedup(entry);
+        }
+        else
+        {
+            samplecache_list = fluid_list_prepend(samplecache_list, entry);
+            result = entry;
+        }
+
+        if(result == entry && samplecache_entry_data(entry) != NULL)
+        {
+            fluid_hashtable_insert(samplecache_data_index, samplecache_entry_data(entry), entry);
+        }
+
+        result->num_references += 1 + entry->waiters;
+    }
+    else
+    {
+        fluid_hashtable_remove(samplecache_index, &entry->key);
+    }
+
+    fluid_cond_mutex_lock(entry->load_m);
+    entry->result = result;
+    entry->loading = FALSE;
+    fluid_cond_broadcast(entry->load_cond);
+    fluid_cond_mutex_unlock(entry->load_m);
+
+    /* otherwise the last waiting thread cleans up */
+    if(entry->waiters == 0)
+    {
+        delete_fluid_cond(entry->load_cond);
+        delete_fluid_cond_mutex(entry->load_m);
+        entry->load_cond = NULL;
+        entry->load_m = NULL;
+
+        if(result == NULL)
+        {
+            delete_samplecache_entry(entry);
+        }
+    }
+
+    return result;
+}
+
+/* Drops a reference to an entry, which is removed from the cache along with its aliases
+ * once unused. Must be called with the mutex held. */
+static void samplecache_entry_release(fluid_samplecache_entry_t *entry)
+{
+    if(--entry->num_references > 0)
+    {
+        return;
+    }
+
+    if(entry->mlocked && entry->sample_data_compressed != NULL)
+    {
+        fluid_munlock(entry->sample_data_compressed, FLUID_SAMPLE_COMPRESSED_SIZE(entry->sample_count));
+    }
+    else if(entry->mlocked)
+    {
+        fluid_munlock(entry->sample_data, entry->sample_count * sizeof(short));
+
+        if(entry->sample_data24 != NULL)
+        {
+            fluid_munlock(entry->sample_data24, entry->sample_count);
+        }
+    }
+
+    if(entry->mlocked_float)
+    {
+        fluid_munlock(entry->sample_data_float, entry->sample_count * sizeof(fluid_real_t));
+    }
+
+    if(samplecache_entry_data(entry) != NULL)
+    {
+        fluid_hashtable_remove(samplecache_data_index, samplecache_entry_data(entry));
+    }
+
+    fluid_hashtable_remove(samplecache_index, &entry->key);
+    samplecache_list = fluid_list_remove(samplecache_list, entry);
+    samplecache_remove_aliases(entry);
+    delete_samplecache_entry(entry);
+}
+
+/* Loads the sample data of an entry made by samplecache_acquire() */
+static int samplecache_entry_read(fluid_samplecache_entry_t *entry, SFData *sf, int sample_type,
+                                  int try_mmap, const char *shared_dir)
+{
+    unsigned int sample_start = entry->key.sample_start;
+    unsigned int sample_end = entry->key.sample_end;
+    char *shared_key = NULL;
+
+    if(try_mmap)
+    {
+        entry->sample_count = fluid_sffile_map_sample_data(sf, sample_start, sample_end, sample_type,
+                              &entry->sample_data, &entry->sample_data24,
+                              &entry->map, &entry->map24);
+
+        if(entry->sample_count >= 0)
+        {
+            return FLUID_OK;
+        }
+
+        FLUID_LOG(FLUID_DBG, "Cannot map the sample data of '%s', reading it instead", sf->fname);
+    }
+
+#if FLUID_HAVE_FILE_MAP
+
+    /* Decoding compressed samples takes long, so another process may have done it already */
+    if(shared_dir != NULL && shared_dir[0] != '\0' && (sample_type & FLUID_SAMPLETYPE_OGG_VORBIS))
+    {
+        shared_key = new_shared_cache_key(sf, sample_start, sample_end, sample_type);
+
+        if(shared_key != NULL && shared_cache_attach(entry, shared_dir, shared_key) == FLUID_OK)
+        {
+            FLUID_FREE(shared_key);
+            return FLUID_OK;
+        }
     }
 
-    entry->sf_samplepos = sf->samplepos;
-    entry->sf_samplesize = sf->samplesize;
-    entry->sf_sample24pos = sf->sample24pos;
-    entry->sf_sample24size = sf->sample24size;
-    entry->sample_start = sample_start;
-    entry->sample_end = sample_end;
-    entry->sample_type = sample_type;
-    entry->modification_time = mtime;
+#endif
 
     entry->sample_count = fluid_sffile_read_sample_data(sf, sample_start, sample_end, sample_type,
                           &entry->sample_data, &entry->sample_data24);
 
     if(entry->sample_count < 0)
     {
-        goto error_exit;
+        FLUID_FREE(shared_key);
+        return FLUID_FAILED;
     }
 
-    return entry;
+#if FLUID_HAVE_FILE_MAP
 
-error_exit:
-    delete_samplecache_entry(entry);
-    return NULL;
+    if(shared_key != NULL && entry->sample_count > 0)
+    {
+        shared_cache_publish(entry, shared_dir, shared_key);
+    }
+
+#endif
+
+    FLUID_FREE(shared_key);
+    return FLUID_OK;
 }
 
 static void delete_samplecache_entry(fluid_samplecache_entry_t *entry)
@@ -240,58 +637,451 @@ static void delete_samplecache_entry(fluid_samplecache_entry_t *entry)
     fluid_return_if_fail(entry != NULL);
 
     FLUID_FREE(entry->filename);
-    FLUID_FREE(entry->sample_data);
-    FLUID_FREE(entry->sample_data24);
+
+    if(entry->map.addr != NULL)
+    {
+        fluid_file_unmap(&entry->map);
+        fluid_file_unmap(&entry->map24);
+    }
+    else
+    {
+        FLUID_FREE(entry->sample_data);
+        FLUID_FREE(entry->sample_data24);
+    }
+
+    FLUID_FREE(entry->sample_data_float);
+    FLUID_FREE(entry->sample_data_compressed);
+
+    if(entry->load_cond != NULL)
+    {
+        delete_fluid_cond(entry->load_cond);
+    }
+
+    if(entry->load_m != NULL)
+    {
+        delete_fluid_cond_mutex(entry->load_m);
+    }
+
     FLUID_FREE(entry);
 }
 
-static fluid_samplecache_entry_t *get_samplecache_entry(SFData *sf,
-        unsigned int sample_start,
-        unsigned int sample_end,
-        int sample_type,
-        time_t mtime)
+/* Lock the memory to disable paging. It's okay if this fails. It
+ * probably means that the user doesn't have the required permission. */
+static void samplecache_entry_mlock(fluid_samplecache_entry_t *entry)
 {
-    fluid_list_t *entry_list;
-    fluid_samplecache_entry_t *entry;
+    if(entry->mlocked)
+    {
+        return;
+    }
+
+    if(entry->sample_data_compressed != NULL)
+    {
+        entry->mlocked = (fluid_mlock(entry->sample_data_compressed,
+                                      FLUID_SAMPLE_COMPRESSED_SIZE(entry->sample_count)) == 0);
+
+        if(!entry->mlocked)
+        {
+            FLUID_LOG(FLUID_WARN, "Failed to pin the sample data to RAM; swapping is possible.");
+        }
 
-    entry_list = samplecache_list;
+        return;
+    }
 
-    while(entry_list)
+    if(fluid_mlock(entry->sample_data, entry->sample_count * sizeof(short)) == 0)
     {
-        entry = (fluid_samplecache_entry_t *)fluid_list_get(entry_list);
+        if(entry->sample_data24 != NULL)
+        {
+            entry->mlocked = (fluid_mlock(entry->sample_data24, entry->sample_count) == 0);
+        }
+        else
+        {
+            entry->mlocked = TRUE;
+        }
 
-        if((FLUID_STRCMP(sf->fname, entry->filename) == 0) &&
-                (mtime == entry->modification_time) &&
-                (sf->samplepos == entry->sf_samplepos) &&
-                (sf->samplesize == entry->sf_samplesize) &&
-                (sf->sample24pos == entry->sf_sample24pos) &&
-                (sf->sample24size == entry->sf_sample24size) &&
-                (sample_start == entry->sample_start) &&
-                (sample_end == entry->sample_end) &&
-                (sample_type == entry->sample_type))
+        if(!entry->mlocked)
         {
-            return entry;
+            fluid_munlock(entry->sample_data, entry->sample_count * sizeof(short));
+            FLUID_LOG(FLUID_WARN, "Failed to pin the sample data to RAM; swapping is possible.");
         }
+    }
+}
+
+/* Store a copy of the sample data points as they are fed to the interpolation, so that the
+ * DSP loop doesn't need to combine the 16 and 24 bit parts over and over again */
+static int samplecache_entry_convert_float(fluid_samplecache_entry_t *entry, int huge_pages)
+{
+    int i;
+
+    if(entry->sample_count <= 0)
+    {
+        return FLUID_OK;
+    }
 
-        entry_list = fluid_list_next(entry_list);
+    entry->sample_data_float = fluid_alloc_huge(entry->sample_count * sizeof(fluid_real_t), huge_pages);
+
+    if(entry->sample_data_float == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < entry->sample_count; i++)
+    {
+        int32_t point = fluid_rvoice_get_sample(entry->sample_data, entry->sample_data24, i);
+        entry->sample_data_float[i] = (fluid_real_t)point;
     }
 
-    return NULL;
+    return FLUID_OK;
 }
 
-static int fluid_get_file_modification_time(char *filename, time_t *modification_time)
+/* Replace the sample data points by blocks of FLUID_SAMPLE_BLOCK_POINTS 8 bit mantissas sharing
+ * the smallest exponent that fits the largest point of the block, see
+ * fluid_rvoice_get_sample_compressed(). Halves the memory taken by 16 bit samples. */
+static int samplecache_entry_compress(fluid_samplecache_entry_t *entry, int huge_pages)
 {
-    fluid_stat_buf_t buf;
+    signed char *block;
+    int i, j, count;
+
+    if(entry->sample_count <= 0)
+    {
+        return FLUID_OK;
+    }
 
-    if(fluid_stat(filename, &buf))
+    entry->sample_data_compressed = fluid_alloc_huge(FLUID_SAMPLE_COMPRESSED_SIZE(entry->sample_count), huge_pages);
+
+    if(entry->sample_data_compressed == NULL)
     {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
         return FLUID_FAILED;
     }
 
-    *modification_time = buf.st_mtime;
+    block = entry->sample_data_compressed;
+
+    for(i = 0; i < entry->sample_count; i += FLUID_SAMPLE_BLOCK_POINTS)
+    {
+        int32_t points[FLUID_SAMPLE_BLOCK_POINTS];
+        int32_t peak = 0, half;
+        int shift = 0;
+
+        count = entry->sample_count - i;
+        count = (count < FLUID_SAMPLE_BLOCK_POINTS) ? count : FLUID_SAMPLE_BLOCK_POINTS;
+
+        for(j = 0; j < FLUID_SAMPLE_BLOCK_POINTS; j++)
+        {
+            int32_t point = (j < count) ? fluid_rvoice_get_sample(entry->sample_data, entry->sample_data24, i + j) : 0;
+            int32_t mag = (point < 0) ? -point : point;
+
+            points[j] = point;
+            peak = (mag > peak) ? mag : peak;
+        }
+
+        while(shift < FLUID_SAMPLE_BLOCK_MAX_SHIFT && peak > ((int32_t)127 << shift))
+        {
+            shift++;
+        }
+
+        /* round to the nearest mantissa, which stays within -127..127 */
+        half = ((int32_t)1 << shift) >> 1;
+        block[0] = (signed char)shift;
+
+        for(j = 0; j < FLUID_SAMPLE_BLOCK_POINTS; j++)
+        {
+            int32_t point = points[j];
+            block[1 + j] = (signed char)((point < 0) ? -((-point + half) >> shift) : ((point + half) >> shift));
+        }
+
+        block += FLUID_SAMPLE_BLOCK_SIZE;
+    }
+
+    /* the data was read, never mapped */
+    FLUID_FREE(entry->sample_data);
+    FLUID_FREE(entry->sample_data24);
+    entry->sample_data = NULL;
+    entry->sample_data24 = NULL;
+
     return FLUID_OK;
 }
 
+/* Size of the sample data of an entry in bytes */
+static size_t samplecache_entry_size(const fluid_samplecache_entry_t *entry)
+{
+    if(entry->sample_data_compressed != NULL)
+    {
+        return FLUID_SAMPLE_COMPRESSED_SIZE(entry->sample_count);
+    }
+
+    return (size_t)entry->sample_count * ((entry->sample_data24 != NULL) ? 3 : 2);
+}
+
+/* 64 bit FNV-1a hash of the sample data of an entry */
+static uint64_t samplecache_entry_hash(const fluid_samplecache_entry_t *entry)
+{
+    const unsigned char *parts[3];
+    size_t sizes[3];
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i;
+    int p;
+
+    parts[0] = (const unsigned char *)entry->sample_data;
+    sizes[0] = (entry->sample_data != NULL) ? entry->sample_count * sizeof(short) : 0;
+    parts[1] = (const unsigned char *)entry->sample_data24;
+    sizes[1] = (entry->sample_data24 != NULL) ? entry->sample_count : 0;
+    parts[2] = (const unsigned char *)entry->sample_data_compressed;
+    sizes[2] = (entry->sample_data_compressed != NULL) ? FLUID_SAMPLE_COMPRESSED_SIZE(entry->sample_count) : 0;
+
+    for(p = 0; p < 3; p++)
+    {
+        for(i = 0; i < sizes[p]; i++)
+        {
+            hash = (hash ^ parts[p][i]) * 1099511628211ULL;
+        }
+    }
+
+    return hash;
+}
+
+static int samplecache_entry_data_equal(const fluid_samplecache_entry_t *a, const fluid_samplecache_entry_t *b)
+{
+    if(a->sample_count != b->sample_count || a->hash != b->hash
+            || (a->key.sample_type & FLUID_SAMPLECACHE_COMPRESSED) != (b->key.sample_type & FLUID_SAMPLECACHE_COMPRESSED)
+            || (a->sample_data24 == NULL) != (b->sample_data24 == NULL)
+            || a->map.addr != NULL || b->map.addr != NULL)
+    {
+        return FALSE;
+    }
+
+    if(a->sample_data_compressed != NULL)
+    {
+        return memcmp(a->sample_data_compressed, b->sample_data_compressed,
+                      FLUID_SAMPLE_COMPRESSED_SIZE(a->sample_count)) == 0;
+    }
+
+    return memcmp(a->sample_data, b->sample_data, a->sample_count * sizeof(short)) == 0
+           && (a->sample_data24 == NULL
+               || memcmp(a->sample_data24, b->sample_data24, a->sample_count) == 0);
+}
+
+/* Adds a new entry to the cache, unless another entry holds the same sample data. The new entry
+ * then drops its data and becomes an alias of the other one, which is returned instead.
+ * Must be called with the mutex held. */
+static fluid_samplecache_entry_t *samplecache_entry_dedup(fluid_samplecache_entry_t *entry)
+{
+    fluid_list_t *list;
+    fluid_samplecache_entry_t *other;
+
+    entry->hash = samplecache_entry_hash(entry);
+
+    for(list = samplecache_list; list != NULL; list = fluid_list_next(list))
+    {
+        other = (fluid_samplecache_entry_t *)fluid_list_get(list);
+
+        if(other->alias_of == NULL && other->sample_count > 0 && samplecache_entry_data_equal(entry, other))
+        {
+            FLUID_FREE(entry->sample_data);
+            FLUID_FREE(entry->sample_data24);
+            FLUID_FREE(entry->sample_data_compressed);
+            entry->sample_data = NULL;
+            entry->sample_data24 = NULL;
+            entry->sample_data_compressed = NULL;
+            entry->alias_of = other;
+            samplecache_list = fluid_list_prepend(samplecache_list, entry);
+
+            return other;
+        }
+    }
+
+    samplecache_list = fluid_list_prepend(samplecache_list, entry);
+
+    return entry;
+}
+
+/* Removes the aliases of an entry about to be deleted. Must be called with the mutex held. */
+static void samplecache_remove_aliases(const fluid_samplecache_entry_t *entry)
+{
+    fluid_list_t *list = samplecache_list;
+
+    while(list != NULL)
+    {
+        fluid_samplecache_entry_t *alias = (fluid_samplecache_entry_t *)fluid_list_get(list);
+        list = fluid_list_next(list);
+
+        if(alias->alias_of == entry)
+        {
+            fluid_hashtable_remove(samplecache_index, &alias->key);
+            samplecache_list = fluid_list_remove(samplecache_list, alias);
+            delete_samplecache_entry(alias);
+        }
+    }
+}
+
+#if FLUID_HAVE_FILE_MAP
+
+/* SHARED CACHE OF DECODED SAMPLES
+ *
+ * Samples decoded by one process are stored as files in a directory shared by all processes,
+ * see synth.sample-cache-dir. Other processes, or the same program started again, map these
+ * files instead of decoding the samples again. A file consists of the header below, the key of
+ * the cache entry padded with zeros to a multiple of eight bytes, and the 16 bit sample points
+ * in native byte order. Files are only published complete by renaming them, so no locking is
+ * needed.
+ *
+ * The key is made of hashes of the compressed data rather than the name of the SoundFont file,
+ * so the files stay valid when the SoundFont is copied or moved, and are never used for a
+ * SoundFont that has been changed in the meantime.
+ */
+
+#define SHARED_CACHE_MAGIC "FLSMPL02"
+
+typedef struct
+{
+    char magic[8];
+    uint32_t key_size;      /* size of the padded key following the header */
+    uint32_t sample_count;  /* number of sample points following the key */
+} shared_cache_header_t;
+
+/* Describes the decoded sample uniquely across processes and SoundFont files */
+static char *new_shared_cache_key(SFData *sf, unsigned int sample_start, unsigned int sample_end,
+                                  int sample_type)
+{
+    uint64_t hash[2];
+    char *key;
+
+    if(fluid_sffile_hash_vorbis_data(sf, sample_start, sample_end, hash) != FLUID_OK)
+    {
+        return NULL;
+    }
+
+    key = FLUID_MALLOC(128);
+
+    if(key == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_SNPRINTF(key, 128, "%u|%08x%08x|%08x%08x|%d|%d", (sample_end + 1) - sample_start,
+                   (unsigned int)(hash[0] >> 32), (unsigned int)(hash[0] & 0xffffffff),
+                   (unsigned int)(hash[1] >> 32), (unsigned int)(hash[1] & 0xffffffff),
+                   sample_type, (int)sizeof(short));
+
+    return key;
+}
+
+static uint32_t shared_cache_key_size(const char *key)
+{
+    return (uint32_t)((FLUID_STRLEN(key) + 1 + 7) & ~(size_t)7);
+}
+
+/* The name of the file of the entry is a 64 bit FNV-1a hash of its key */
+static void shared_cache_path(char *path, size_t size, const char *shared_dir, const char *key, const char *suffix)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char *c;
+
+    for(c = (const unsigned char *)key; *c != '\0'; c++)
+    {
+        hash = (hash ^ *c) * 1099511628211ULL;
+    }
+
+    FLUID_SNPRINTF(path, size, "%s/fluidsynth-%08x%08x%s", shared_dir,
+                   (unsigned int)(hash >> 32), (unsigned int)(hash & 0xffffffff), suffix);
+}
+
+static int shared_cache_attach(fluid_samplecache_entry_t *entry, const char *shared_dir, const char *key)
+{
+    char path[1024];
+    shared_cache_header_t header;
+    uint32_t key_size = shared_cache_key_size(key);
+    char *stored_key;
+    FILE *file;
+    int ret = FLUID_FAILED;
+
+    shared_cache_path(path, sizeof(path), shared_dir, key, ".smpl");
+    file = FLUID_FOPEN(path, "rb");
+
+    if(file == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    stored_key = FLUID_MALLOC(key_size);
+
+    if(stored_key != NULL
+            && FLUID_FREAD(&header, sizeof(header), 1, file) == 1
+            && memcmp(header.magic, SHARED_CACHE_MAGIC, sizeof(header.magic)) == 0
+            && header.key_size == key_size && header.sample_count > 0 && header.sample_count <= INT_MAX
+            && FLUID_FREAD(stored_key, key_size, 1, file) == 1
+            && FLUID_STRCMP(stored_key, key) == 0)
+    {
+        entry->sample_data = fluid_file_map(file, sizeof(header) + key_size,
+                                            (fluid_long_long_t)header.sample_count * sizeof(short), &entry->map);
+
+        if(entry->sample_data != NULL)
+        {
+            entry->sample_count = (int)header.sample_count;
+            entry->sample_data24 = NULL;
+            ret = FLUID_OK;
+        }
+    }
+
+    FLUID_FREE(stored_key);
+    FLUID_FCLOSE(file);
+
+    return ret;
+}
+
+static void shared_cache_publish(const fluid_samplecache_entry_t *entry, const char *shared_dir, const char *key)
+{
+    char path[1024], temp_path[1024], suffix[64];
+    shared_cache_header_t header;
+    uint32_t key_size = shared_cache_key_size(key);
+    char *padded_key;
+    FILE *file;
+    int written;
+
+    /* the temporary file is unique to this process and entry */
+    FLUID_SNPRINTF(suffix, sizeof(suffix), ".%ld.%lx.tmp", (long)getpid(), (unsigned long)(uintptr_t)entry);
+    shared_cache_path(path, sizeof(path), shared_dir, key, ".smpl");
+    shared_cache_path(temp_path, sizeof(temp_path), shared_dir, key, suffix);
+
+    padded_key = FLUID_MALLOC(key_size);
+
+    if(padded_key == NULL)
+    {
+        return;
+    }
+
+    FLUID_MEMSET(padded_key, 0, key_size);
+    FLUID_STRCPY(padded_key, key);
+
+    FLUID_MEMCPY(header.magic, SHARED_CACHE_MAGIC, sizeof(header.magic));
+    header.key_size = key_size;
+    header.sample_count = (uint32_t)entry->sample_count;
+
+    file = FLUID_FOPEN(temp_path, "wb");
+
+    if(file == NULL)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to create '%s', decoded samples are not shared", temp_path);
+        FLUID_FREE(padded_key);
+        return;
+    }
+
+    written = (fwrite(&header, sizeof(header), 1, file) == 1
+               && fwrite(padded_key, key_size, 1, file) == 1
+               && fwrite(entry->sample_data, sizeof(short), entry->sample_count, file) == (size_t)entry->sample_count);
+    written = (FLUID_FCLOSE(file) == 0) && written;
+
+    if(!written || rename(temp_path, path) != 0)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to write '%s', decoded samples are not shared", path);
+        remove(temp_path);
+    }
+
+    FLUID_FREE(padded_key);
+}
+
+#endif /* FLUID_HAVE_FILE_MAP */
 
 /* Only used for tests */
 int fluid_samplecache_count_entries(void)
@@ -303,7 +1093,188 @@ int fluid_samplecache_count_entries(void)
 
     for(entry = samplecache_list; entry != NULL; entry = fluid_list_next(entry))
     {
-        count++;
+        count += (((fluid_samplecache_entry_t *)fluid_list_get(entry))->alias_of == NULL);
+    }
+
+    fluid_mutex_unlock(samplecache_mutex);
+
+    return count;
+}
+
+/**
+ * Get how much memory is saved by storing identical sample data only once.
+ * @param stats Filled with the statistics of the SoundFonts loaded in this process
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * Only samples loaded with \setting{synth_sample-dedup} enabled are deduplicated.
+ *
+ * @since 2.6.0
+ */
+int fluid_sample_get_dedup_stats(fluid_sample_dedup_stats_t *stats)
+{
+    fluid_list_t *list;
+
+    fluid_return_val_if_fail(stats != NULL, FLUID_FAILED);
+
+    FLUID_MEMSET(stats, 0, sizeof(*stats));
+
+    fluid_mutex_lock(samplecache_mutex);
+
+    for(list = samplecache_list; list != NULL; list = fluid_list_next(list))
+    {
+        const fluid_samplecache_entry_t *entry = (fluid_samplecache_entry_t *)fluid_list_get(list);
+
+        if(entry->alias_of != NULL)
+        {
+            stats->samples++;
+            stats->bytes_saved += samplecache_entry_size(entry->alias_of);
+        }
+        else if(entry->hash != 0)
+        {
+            stats->unique_samples++;
+            stats->bytes_stored += samplecache_entry_size(entry);
+        }
+    }
+
+    fluid_mutex_unlock(samplecache_mutex);
+
+    return FLUID_OK;
+}
+
+/* Size of the sample data held by the cache in bytes, mapped or not, once per identical data */
+size_t fluid_samplecache_get_size(void)
+{
+    fluid_list_t *list;
+    size_t size = 0;
+
+    fluid_mutex_lock(samplecache_mutex);
+
+    for(list = samplecache_list; list != NULL; list = fluid_list_next(list))
+    {
+        const fluid_samplecache_entry_t *entry = (fluid_samplecache_entry_t *)fluid_list_get(list);
+
+        if(entry->alias_of == NULL)
+        {
+            size += samplecache_entry_size(entry);
+        }
+    }
+
+    fluid_mutex_unlock(samplecache_mutex);
+
+    return size;
+}
+
+/* The memory of the data of an entry holding data of its own */
+static void samplecache_entry_get_memory(const fluid_samplecache_entry_t *entry, fluid_samplecache_memory_t *memory)
+{
+    size_t size = samplecache_entry_size(entry);
+
+    memory->mapped = 0;
+
+    if(entry->map.addr != NULL)
+    {
+        memory->mapped = (size_t)entry->sample_count * sizeof(short);
+
+        if(entry->map24.addr != NULL)
+        {
+            memory->mapped += entry->sample_count;
+        }
+    }
+
+    memory->in_memory = size - memory->mapped;
+
+    if(entry->sample_data_float != NULL)
+    {
+        memory->in_memory += (size_t)entry->sample_count * sizeof(fluid_real_t);
+    }
+
+    memory->shared = (entry->num_references > 1);
+}
+
+/*
+ * Get the memory of the cache entry holding sample_data, which is the sample data or the
+ * compressed sample data returned by fluid_samplecache_load(), or the data returned by
+ * fluid_samplecache_load_converted(). Returns FLUID_FAILED if the cache doesn't hold it.
+ */
+int fluid_samplecache_get_memory(const void *sample_data, fluid_samplecache_memory_t *memory)
+{
+    const fluid_samplecache_entry_t *entry = NULL;
+
+    fluid_mutex_lock(samplecache_mutex);
+
+    if(samplecache_data_index != NULL)
+    {
+        entry = (const fluid_samplecache_entry_t *)fluid_hashtable_lookup(samplecache_data_index, sample_data);
+    }
+
+    if(entry != NULL)
+    {
+        samplecache_entry_get_memory(entry, memory);
+    }
+
+    fluid_mutex_unlock(samplecache_mutex);
+
+    return (entry != NULL) ? FLUID_OK : FLUID_FAILED;
+}
+
+/**
+ * Get the memory taken by the sample data of the SoundFonts loaded in this process.
+ * @param usage Filled with the sizes
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * SoundFonts loaded by several synths share their sample data, which is counted once.
+ * The shares of the individual SoundFonts are returned by fluid_synth_get_sfont_memory_usage().
+ *
+ * @since 2.6.0
+ */
+int fluid_sample_get_cache_memory(fluid_sample_cache_memory_t *usage)
+{
+    fluid_samplecache_memory_t memory;
+    fluid_list_t *list;
+
+    fluid_return_val_if_fail(usage != NULL, FLUID_FAILED);
+
+    FLUID_MEMSET(usage, 0, sizeof(*usage));
+
+    fluid_mutex_lock(samplecache_mutex);
+
+    for(list = samplecache_list; list != NULL; list = fluid_list_next(list))
+    {
+        const fluid_samplecache_entry_t *entry = (fluid_samplecache_entry_t *)fluid_list_get(list);
+
+        if(entry->alias_of != NULL)
+        {
+            continue;
+        }
+
+        samplecache_entry_get_memory(entry, &memory);
+        usage->in_memory += memory.in_memory;
+        usage->mapped += memory.mapped;
+
+        if(memory.shared)
+        {
+            usage->shared += memory.in_memory + memory.mapped;
+        }
+
+        usage->entries++;
+    }
+
+    fluid_mutex_unlock(samplecache_mutex);
+
+    return FLUID_OK;
+}
+
+/* Only used for tests */
+int fluid_samplecache_count_mapped_entries(void)
+{
+    fluid_list_t *entry;
+    int count = 0;
+
+    fluid_mutex_lock(samplecache_mutex);
+
+    for(entry = samplecache_list; entry != NULL; entry = fluid_list_next(entry))
+    {
+        count += (((fluid_samplecache_entry_t *)fluid_list_get(entry))->map.addr != NULL);
     }
 
     fluid_mutex_unlock(samplecache_mutex);
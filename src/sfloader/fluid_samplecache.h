@@ -24,13 +24,58 @@
 #include "fluid_sfont.h"
 #include "fluid_sffile.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* How fluid_samplecache_load() gets the sample data */
+enum fluid_samplecache_mode
+{
+    FLUID_SAMPLECACHE_READ,     /* read the data into memory */
+    FLUID_SAMPLECACHE_MAP,      /* map the data if possible, see synth.sample-mmap */
+    FLUID_SAMPLECACHE_STREAM    /* map the data if possible, but never lock it to RAM, see synth.sample-streaming */
+};
+
 int fluid_samplecache_load(SFData *sf,
                            unsigned int sample_start, unsigned int sample_end, int sample_type,
-                           int try_mlock, short **data, char **data24);
+                           int try_mlock, int mode, const char *shared_dir, int dedup,
+                           short **data, char **data24, fluid_real_t **data_float,
+                           signed char **data_compressed, int *is_mapped);
+
+/* The sample type of entries made by fluid_samplecache_load_converted(), never used by SoundFont samples */
+#define FLUID_SAMPLECACHE_CONVERTED 0x10000
+
+/* Added to the sample type of entries holding compressed data, see fluid_rvoice_get_sample_compressed() */
+#define FLUID_SAMPLECACHE_COMPRESSED 0x20000
+
+/* Fills sample_count points at sample_data, returns FLUID_OK or FLUID_FAILED */
+typedef int (*fluid_samplecache_convert_t)(void *user_data, short *sample_data, int sample_count);
 
-int fluid_samplecache_unload(const short *sample_data);
+int fluid_samplecache_load_converted(const char *filename, time_t mtime,
+                                     unsigned int data_pos, unsigned int data_size,
+                                     int sample_count, int try_mlock,
+                                     fluid_samplecache_convert_t convert, void *user_data,
+                                     short **sample_data);
+
+int fluid_samplecache_unload(const void *sample_data);
+size_t fluid_samplecache_get_size(void);
+
+/* Memory of the sample data of a cache entry */
+typedef struct
+{
+    size_t in_memory;   /* data read, decoded, converted or compressed into memory */
+    size_t mapped;      /* data mapped from the file */
+    int shared;         /* TRUE if more than one load of the samples uses the entry */
+} fluid_samplecache_memory_t;
+
+int fluid_samplecache_get_memory(const void *sample_data, fluid_samplecache_memory_t *memory);
 
 /* Only used for tests */
 int fluid_samplecache_count_entries(void);
+int fluid_samplecache_count_mapped_entries(void);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* _FLUID_SAMPLECACHE_H */
@@ -24,11 +24,17 @@
 #include "fluid_sffile.h"
 #include "fluid_sfont.h"
 #include "fluid_sys.h"
+#include "fluid_trace.h"
 
 #if LIBSNDFILE_SUPPORT
 #include <sndfile.h>
 #endif
 
+#if VORBISFILE_SUPPORT
+#include <limits.h>
+#include <vorbis/vorbisfile.h>
+#endif
+
 #if LIBINSTPATCH_SUPPORT
 #include <libinstpatch/libinstpatch.h>
 #endif
@@ -38,6 +44,9 @@
   =================================================================*/
 
 /* FOURCC definitions */
+/* The size of the parts sample data is read in by fluid_sffile_read_parallel() */
+#define FLUID_SFFILE_READ_CHUNK (128 * 1024)
+
 #define RIFF_FCC    FLUID_FOURCC('R','I','F','F')
 #define LIST_FCC    FLUID_FOURCC('L','I','S','T')
 #define SFBK_FCC    FLUID_FOURCC('s','f','b','k')
@@ -158,9 +167,9 @@ static const unsigned short invalid_preset_gen[] =
 #define READCHUNK(sf, var)                                                  \
     do                                                                      \
     {                                                                       \
-        if (sf->fcbs->fread(&(var)->id, 4, sf->sffd) == FLUID_FAILED)       \
+        if (sfread(sf, &(var)->id, 4) == FLUID_FAILED)                      \
             return FALSE;                                                   \
-        if (sf->fcbs->fread(&(var)->size, 4, sf->sffd) == FLUID_FAILED)     \
+        if (sfread(sf, &(var)->size, 4) == FLUID_FAILED)                    \
             return FALSE;                                                   \
         (var)->size = FLUID_LE32TOH((var)->size); \
     } while (0)
@@ -169,7 +178,7 @@ static const unsigned short invalid_preset_gen[] =
     do                                                            \
     {                                                             \
         uint32_t _temp;                                           \
-        if (sf->fcbs->fread(&_temp, 4, sf->sffd) == FLUID_FAILED) \
+        if (sfread(sf, &_temp, 4) == FLUID_FAILED)                \
             return FALSE;                                         \
         var = FLUID_LE32TOH(_temp);                               \
     } while (0)
@@ -178,7 +187,7 @@ static const unsigned short invalid_preset_gen[] =
     do                                                            \
     {                                                             \
         uint16_t _temp;                                           \
-        if (sf->fcbs->fread(&_temp, 2, sf->sffd) == FLUID_FAILED) \
+        if (sfread(sf, &_temp, 2) == FLUID_FAILED)                \
             return FALSE;                                         \
         var = FLUID_LE16TOH(_temp);                               \
     } while (0)
@@ -186,14 +195,14 @@ static const unsigned short invalid_preset_gen[] =
 #define READID(sf, var)                                        \
     do                                                         \
     {                                                          \
-        if (sf->fcbs->fread(var, 4, sf->sffd) == FLUID_FAILED) \
+        if (sfread(sf, var, 4) == FLUID_FAILED)                \
             return FALSE;                                      \
     } while (0)
 
 #define READSTR(sf, var)                                        \
     do                                                          \
     {                                                           \
-        if (sf->fcbs->fread(var, 20, sf->sffd) == FLUID_FAILED) \
+        if (sfread(sf, var, 20) == FLUID_FAILED)                \
             return FALSE;                                       \
         (*var)[20] = '\0';                                      \
     } while (0)
@@ -201,21 +210,21 @@ static const unsigned short invalid_preset_gen[] =
 #define READB(sf, var)                                          \
     do                                                          \
     {                                                           \
-        if (sf->fcbs->fread(&var, 1, sf->sffd) == FLUID_FAILED) \
+        if (sfread(sf, &var, 1) == FLUID_FAILED)                \
             return FALSE;                                       \
     } while (0)
 
 #define FSKIP(sf, size)                                                \
     do                                                                 \
     {                                                                  \
-        if (sf->fcbs->fseek(sf->sffd, size, SEEK_CUR) == FLUID_FAILED) \
+        if (sfskip(sf, size) == FLUID_FAILED)                          \
             return FALSE;                                              \
     } while (0)
 
 #define FSKIPW(sf)                                                  \
     do                                                              \
     {                                                               \
-        if (sf->fcbs->fseek(sf->sffd, 2, SEEK_CUR) == FLUID_FAILED) \
+        if (sfskip(sf, 2) == FLUID_FAILED)                          \
             return FALSE;                                           \
     } while (0)
 
@@ -226,7 +235,6 @@ static const unsigned short invalid_preset_gen[] =
         fluid_list_t *_temp = item;                 \
         item = fluid_list_next(item);               \
         list = fluid_list_remove_link(list, _temp); \
-        delete1_fluid_list(_temp);                  \
     } while (0)
 
 
@@ -243,11 +251,14 @@ static int load_ibag(SFData *sf, int size);
 static int load_imod(SFData *sf, int size);
 static int load_shdr(SFData *sf, unsigned int size);
 
+static int sfread(SFData *sf, void *buf, unsigned int count);
+static int sfskip(SFData *sf, unsigned int count);
 static int chunkid(uint32_t id);
 static int read_listchunk(SFData *sf, SFChunk *chunk);
 static int pdtahelper(SFData *sf, unsigned int expid, unsigned int reclen, SFChunk *chunk, int *size);
 static int preset_compare_func(const void *a, const void *b);
 static fluid_list_t *find_gen_by_id(int gen, fluid_list_t *genlist);
+static int prepend_placeholders(SFData *sf, fluid_list_t **list, int count);
 static int valid_inst_genid(unsigned short genid);
 static int valid_preset_genid(unsigned short genid);
 
@@ -355,6 +366,7 @@ SFData *fluid_sffile_open(const char *fname, const fluid_file_callbacks_t *fcbs)
 {
     SFData *sf;
     fluid_long_long_t fsize = 0;
+    fluid_stat_buf_t statbuf;
 
     if(!(sf = FLUID_NEW(SFData)))
     {
@@ -367,6 +379,14 @@ SFData *fluid_sffile_open(const char *fname, const fluid_file_callbacks_t *fcbs)
     fluid_rec_mutex_init(sf->mtx);
     sf->fcbs = fcbs;
 
+    /* the HYDRA chunk consists of many small records */
+    sf->arena = new_fluid_arena(FLUID_SFFILE_ARENA_BLOCK_SIZE);
+
+    if(sf->arena == NULL)
+    {
+        goto error_exit;
+    }
+
     if((sf->sffd = fcbs->fopen(fname)) == NULL)
     {
         FLUID_LOG(FLUID_ERR, "Unable to open file '%s'", fname);
@@ -381,6 +401,12 @@ SFData *fluid_sffile_open(const char *fname, const fluid_file_callbacks_t *fcbs)
         goto error_exit;
     }
 
+    /* the sample cache tells versions of the file apart by it, stat it only once per load */
+    if(fluid_stat(fname, &statbuf) == 0)
+    {
+        sf->mtime = statbuf.st_mtime;
+    }
+
     /* get size of file by seeking to end */
     if(fcbs->fseek(sf->sffd, 0L, SEEK_END) == FLUID_FAILED)
     {
@@ -448,10 +474,13 @@ int fluid_sffile_read_sample_data(SFData *sf, unsigned int sample_start, unsigne
                                   int sample_type, short **data, char **data24)
 {
     int num_samples;
+    double trace_ref;
 
     if(sample_type & FLUID_SAMPLETYPE_OGG_VORBIS)
     {
+        trace_ref = fluid_trace_ref();
         num_samples = fluid_sffile_read_vorbis(sf, sample_start, sample_end, data);
+        fluid_trace_span("sample_decode", trace_ref);
     }
     else
     {
@@ -461,69 +490,210 @@ int fluid_sffile_read_sample_data(SFData *sf, unsigned int sample_start, unsigne
     return num_samples;
 }
 
+/* Two independent 64 bit hashes over a part of the file, read in blocks through the file callbacks */
+static int fluid_sffile_hash_range(SFData *sf, unsigned int pos, unsigned int size, uint64_t hash[2])
+{
+    unsigned char buf[16384];
+    unsigned int remain, count, i;
+    int ret = FLUID_OK;
+
+    /* FNV-1a and a multiply-rotate hash, seeded differently */
+    hash[0] = 14695981039346656037ULL;
+    hash[1] = size;
+
+    fluid_rec_mutex_lock(sf->mtx);
+
+    if(sf->fcbs->fseek(sf->sffd, pos, SEEK_SET) == FLUID_FAILED)
+    {
+        ret = FLUID_FAILED;
+    }
+
+    for(remain = size; ret == FLUID_OK && remain > 0; remain -= count)
+    {
+        count = (remain < sizeof(buf)) ? remain : sizeof(buf);
+
+        if(sf->fcbs->fread(buf, count, sf->sffd) == FLUID_FAILED)
+        {
+            ret = FLUID_FAILED;
+            break;
+        }
+
+        for(i = 0; i < count; i++)
+        {
+            hash[0] = (hash[0] ^ buf[i]) * 1099511628211ULL;
+            hash[1] = (hash[1] + buf[i]) * 0x9E3779B97F4A7C15ULL;
+            hash[1] = (hash[1] << 31) | (hash[1] >> 33);
+        }
+    }
+
+    fluid_rec_mutex_unlock(sf->mtx);
+
+    return ret;
+}
+
 /*
- * Close a SoundFont file and free the SFData structure.
+ * Compute a hash of the compressed data of an Ogg Vorbis sample as it is stored in the
+ * Soundfont file, so that the decoded sample can be recognized independently of the file
+ * it has been found in.
  *
- * @param sf pointer to SFData structure
- * @param fcbs file callback structure
+ * @param sf SoundFont to read sample data from
+ * @param start_byte offset of the first byte of the compressed data in the sample chunk
+ * @param end_byte offset of the last byte of the compressed data in the sample chunk
+ * @param hash array receiving two independent 64 bit hashes on success
+ *
+ * @return FLUID_OK on success, FLUID_FAILED otherwise
  */
-void fluid_sffile_close(SFData *sf)
+int fluid_sffile_hash_vorbis_data(SFData *sf, unsigned int start_byte, unsigned int end_byte, uint64_t hash[2])
 {
-    fluid_list_t *entry;
-    SFPreset *preset;
-    SFInst *inst;
+    if((end_byte + 1) <= start_byte || (start_byte > sf->samplesize) || (end_byte > sf->samplesize))
+    {
+        return FLUID_FAILED;
+    }
 
-    fluid_rec_mutex_destroy(sf->mtx);
+    if(fluid_sffile_hash_range(sf, sf->samplepos + start_byte, (end_byte + 1) - start_byte, hash) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to read compressed sample data");
+        return FLUID_FAILED;
+    }
 
-    if(sf->sffd)
+    return FLUID_OK;
+}
+
+/*
+ * Compute a hash of the HYDRA chunk of the Soundfont, which holds all preset,
+ * instrument and sample headers, without parsing it.
+ *
+ * @param sf SoundFont opened with fluid_sffile_open()
+ * @param hash array receiving two independent 64 bit hashes on success
+ *
+ * @return FLUID_OK on success, FLUID_FAILED otherwise
+ */
+int fluid_sffile_hash_hydra(SFData *sf, uint64_t hash[2])
+{
+    if(fluid_sffile_hash_range(sf, sf->hydrapos, sf->hydrasize, hash) != FLUID_OK)
     {
-        sf->fcbs->fclose(sf->sffd);
+        FLUID_LOG(FLUID_ERR, "Failed to read the HYDRA chunk");
+        return FLUID_FAILED;
     }
 
-    FLUID_FREE(sf->fname);
+    return FLUID_OK;
+}
 
-    entry = sf->info;
+/*
+ * Map sample data of a Soundfont file into memory instead of reading it, so that
+ * the data is shared with all other processes using the same file.
+ *
+ * This only works for uncompressed samples in files opened with the default file
+ * callbacks, on little endian machines where the data can be used as it is stored.
+ * The caller is expected to fall back to fluid_sffile_read_sample_data() otherwise.
+ *
+ * @param sf SoundFont to read sample data from
+ * @param sample_start index of first sample point in Soundfont sample chunk
+ * @param sample_end index of last sample point in Soundfont sample chunk
+ * @param sample_type type of the sample in Soundfont
+ * @param data pointer to sample data pointer, will point into the mapping on success
+ * @param data24 pointer to 24-bit sample data pointer, will point into the mapping of the
+ *               24-bit sample data on success or NULL if no 24-bit data is present in file
+ * @param map the mapping of the 16-bit sample data, to be released with fluid_file_unmap()
+ * @param map24 the mapping of the 24-bit sample data, to be released with fluid_file_unmap()
+ *
+ * @return The number of sample words in returned buffers or -1 if the data cannot be mapped
+ */
+int fluid_sffile_map_sample_data(SFData *sf, unsigned int sample_start, unsigned int sample_end,
+                                 int sample_type, short **data, char **data24,
+                                 fluid_file_map_t *map, fluid_file_map_t *map24)
+{
+    fluid_long_long_t offset;
+    unsigned int num_samples;
 
-    while(entry)
+    map->addr = map24->addr = NULL;
+
+    if((sample_type & FLUID_SAMPLETYPE_OGG_VORBIS) || FLUID_IS_BIG_ENDIAN
+            || sf->fcbs->fread != safe_fread || sf->fcbs->fseek != safe_fseek)
     {
-        FLUID_FREE(fluid_list_get(entry));
-        entry = fluid_list_next(entry);
+        return -1;
     }
 
-    delete_fluid_list(sf->info);
+    if((sample_end + 1) <= sample_start
+            || (sample_start * sizeof(short) > sf->samplesize) || (sample_end * sizeof(short) > sf->samplesize))
+    {
+        return -1;
+    }
 
-    // clean up default modulators
-    entry = sf->default_mod_list;
+    num_samples = (sample_end + 1) - sample_start;
+    offset = (fluid_long_long_t)sf->samplepos + sample_start * sizeof(short);
 
-    while (entry)
+    /* the mapping starts at a page boundary, so the data is only aligned if its offset is */
+    if(offset % sizeof(short) != 0)
     {
-        FLUID_FREE(fluid_list_get(entry));
-        entry = fluid_list_next(entry);
+        return -1;
     }
 
-    delete_fluid_list(sf->default_mod_list);
+    *data = fluid_file_map((FILE *)sf->sffd, offset, (fluid_long_long_t)num_samples * sizeof(short), map);
 
-    entry = sf->preset;
+    if(*data == NULL)
+    {
+        return -1;
+    }
 
-    while(entry)
+    *data24 = NULL;
+
+    if(sf->sample24pos)
     {
-        preset = (SFPreset *)fluid_list_get(entry);
-        delete_preset(preset);
-        entry = fluid_list_next(entry);
+        if((sample_start > sf->sample24size) || (sample_end > sf->sample24size))
+        {
+            FLUID_LOG(FLUID_ERR, "Sample offsets exceed 24-bit sample data chunk");
+            FLUID_LOG(FLUID_WARN, "Ignoring 24-bit sample data, sound quality might suffer");
+            return num_samples;
+        }
+
+        *data24 = fluid_file_map((FILE *)sf->sffd, (fluid_long_long_t)sf->sample24pos + sample_start,
+                                 num_samples, map24);
+
+        if(*data24 == NULL)
+        {
+            fluid_file_unmap(map);
+            return -1;
+        }
     }
 
-    delete_fluid_list(sf->preset);
+    return num_samples;
+}
+
+/*
+ * Close a SoundFont file and free the SFData structure.
+ *
+ * @param sf pointer to SFData structure
+ * @param fcbs file callback structure
+ */
+void fluid_sffile_close(SFData *sf)
+{
+    fluid_list_t *entry;
 
-    entry = sf->inst;
+    fluid_rec_mutex_destroy(sf->mtx);
+
+    if(sf->sffd)
+    {
+        sf->fcbs->fclose(sf->sffd);
+    }
+
+    FLUID_FREE(sf->fname);
+
+    entry = sf->info;
 
     while(entry)
     {
-        inst = (SFInst *)fluid_list_get(entry);
-        delete_inst(inst);
+        FLUID_FREE(fluid_list_get(entry));
         entry = fluid_list_next(entry);
     }
 
+    delete_fluid_list(sf->info);
+
+    /* the presets, instruments, zones, generators and modulators are freed with the arena */
+    delete_fluid_list(sf->default_mod_list);
+    delete_fluid_list(sf->preset);
     delete_fluid_list(sf->inst);
+    delete_fluid_arena(sf->arena);
 
     entry = sf->sample;
 
@@ -640,15 +810,85 @@ static int load_header(SFData *sf)
     return TRUE;
 }
 
+/* Reads from the HYDRA chunk in memory while it is parsed, otherwise from the file */
+static int sfread(SFData *sf, void *buf, unsigned int count)
+{
+    if(sf->hydra == NULL)
+    {
+        return sf->fcbs->fread(buf, count, sf->sffd);
+    }
+
+    if(count > sf->hydrasize - sf->hydra_pos)
+    {
+        return FLUID_FAILED;
+    }
+
+    FLUID_MEMCPY(buf, sf->hydra + sf->hydra_pos, count);
+    sf->hydra_pos += count;
+
+    return FLUID_OK;
+}
+
+static int sfskip(SFData *sf, unsigned int count)
+{
+    if(sf->hydra == NULL)
+    {
+        return sf->fcbs->fseek(sf->sffd, count, SEEK_CUR);
+    }
+
+    if(count > sf->hydrasize - sf->hydra_pos)
+    {
+        return FLUID_FAILED;
+    }
+
+    sf->hydra_pos += count;
+
+    return FLUID_OK;
+}
+
+/* The HYDRA chunk is read in a single block and parsed from memory, instead of
+ * calling the file callbacks for every field of its records */
 static int load_body(SFData *sf)
 {
+    unsigned char *hydra;
+    int ok;
+
+    if(sf->hydrasize > sf->filesize - sf->hydrapos)
+    {
+        FLUID_LOG(FLUID_ERR, "HYDRA chunk size exceeds file size");
+        return FALSE;
+    }
+
     if(sf->fcbs->fseek(sf->sffd, sf->hydrapos, SEEK_SET) == FLUID_FAILED)
     {
         FLUID_LOG(FLUID_ERR, "Failed to seek to HYDRA position");
         return FALSE;
     }
 
-    if(!process_pdta(sf, sf->hydrasize))
+    hydra = FLUID_MALLOC(sf->hydrasize);
+
+    if(hydra == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FALSE;
+    }
+
+    if(sf->fcbs->fread(hydra, sf->hydrasize, sf->sffd) == FLUID_FAILED)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to read the HYDRA chunk");
+        FLUID_FREE(hydra);
+        return FALSE;
+    }
+
+    sf->hydra = hydra;
+    sf->hydra_pos = 0;
+
+    ok = process_pdta(sf, sf->hydrasize);
+
+    sf->hydra = NULL;
+    FLUID_FREE(hydra);
+
+    if(!ok)
     {
         return FALSE;
     }
@@ -719,7 +959,7 @@ static int process_info(SFData *sf, int size)
 
             if(sf->version.major == 3)
             {
-#if !LIBSNDFILE_SUPPORT
+#if !LIBSNDFILE_SUPPORT && !VORBISFILE_SUPPORT
                 FLUID_LOG(FLUID_WARN,
                           "Sound font version is %d.%d but fluidsynth was compiled without"
                           " support for (v3.x)",
@@ -771,7 +1011,7 @@ static int process_info(SFData *sf, int size)
             for(; count > 0; count--)
             {
 
-                if((dmod = FLUID_NEW(SFMod)) == NULL)
+                if((dmod = FLUID_ARENA_NEW(sf->arena, SFMod)) == NULL)
                 {
                     FLUID_LOG(FLUID_ERR, "Out of memory");
                     return FALSE;
@@ -1122,7 +1362,7 @@ static int load_phdr(SFData *sf, unsigned int size)
     for(; i > 0; i--)
     {
         /* load all preset headers */
-        if((preset = FLUID_NEW(SFPreset)) == NULL)
+        if((preset = FLUID_ARENA_NEW(sf->arena, SFPreset)) == NULL)
         {
             FLUID_LOG(FLUID_PANIC, "Out of memory");
             return FALSE;
@@ -1149,9 +1389,9 @@ static int load_phdr(SFData *sf, unsigned int size)
 
             i2 = pbag_idx - prev_pbag_idx;
 
-            while(i2--)
+            if(!prepend_placeholders(sf, &prev_preset->zone, i2))
             {
-                prev_preset->zone = fluid_list_prepend(prev_preset->zone, NULL);
+                return FALSE;
             }
         }
         else if(pbag_idx > 0)  /* 1st preset, warn if ofs >0 */
@@ -1175,9 +1415,9 @@ static int load_phdr(SFData *sf, unsigned int size)
 
     i2 = pbag_idx - prev_pbag_idx;
 
-    while(i2--)
+    if(!prepend_placeholders(sf, &prev_preset->zone, i2))
     {
-        prev_preset->zone = fluid_list_prepend(prev_preset->zone, NULL);
+        return FALSE;
     }
 
     return TRUE;
@@ -1215,7 +1455,7 @@ static int load_pbag(SFData *sf, int size)
                 return FALSE;
             }
 
-            if((z = FLUID_NEW(SFZone)) == NULL)
+            if((z = FLUID_ARENA_NEW(sf->arena, SFZone)) == NULL)
             {
                 FLUID_LOG(FLUID_PANIC, "Out of memory");
                 return FALSE;
@@ -1244,16 +1484,16 @@ static int load_pbag(SFData *sf, int size)
 
                 i = genndx - pgenndx;
 
-                while(i--)
+                if(!prepend_placeholders(sf, &pz->gen, i))
                 {
-                    pz->gen = fluid_list_prepend(pz->gen, NULL);
+                    return FALSE;
                 }
 
                 i = modndx - pmodndx;
 
-                while(i--)
+                if(!prepend_placeholders(sf, &pz->mod, i))
                 {
-                    pz->mod = fluid_list_prepend(pz->mod, NULL);
+                    return FALSE;
                 }
             }
 
@@ -1306,16 +1546,16 @@ static int load_pbag(SFData *sf, int size)
 
     i = genndx - pgenndx;
 
-    while(i--)
+    if(!prepend_placeholders(sf, &pz->gen, i))
     {
-        pz->gen = fluid_list_prepend(pz->gen, NULL);
+        return FALSE;
     }
 
     i = modndx - pmodndx;
 
-    while(i--)
+    if(!prepend_placeholders(sf, &pz->mod, i))
     {
-        pz->mod = fluid_list_prepend(pz->mod, NULL);
+        return FALSE;
     }
 
     return TRUE;
@@ -1350,7 +1590,7 @@ static int load_pmod(SFData *sf, int size)
                     return FALSE;
                 }
 
-                if((m = FLUID_NEW(SFMod)) == NULL)
+                if((m = FLUID_ARENA_NEW(sf->arena, SFMod)) == NULL)
                 {
                     FLUID_LOG(FLUID_PANIC, "Out of memory");
                     return FALSE;
@@ -1523,7 +1763,7 @@ int load_pgen(SFData *sf, int size)
                     if(!dup)
                     {
                         /* if gen ! dup alloc new */
-                        if((g = FLUID_NEW(SFGen)) == NULL)
+                        if((g = FLUID_ARENA_NEW(sf->arena, SFGen)) == NULL)
                         {
                             FLUID_LOG(FLUID_PANIC, "Out of memory");
                             return FALSE;
@@ -1570,13 +1810,10 @@ int load_pgen(SFData *sf, int size)
              * other global zones we encounter */
             if(level < 3 && (zone_list != preset->zone))
             {
-                /* advance to next zone before deleting the current list element */
-                zone_list = fluid_list_next(zone_list);
-
                 FLUID_LOG(FLUID_WARN, "Preset '%s': Discarding invalid global zone (global zones must appear first in presets per SoundFont spec 7.3)",
                           preset->name);
-                preset->zone = fluid_list_remove(preset->zone, zone);
-                delete_zone(zone);
+                /* unlink the zone and advance to the next one, the zone is freed with the arena */
+                SLADVREM(preset->zone, zone_list);
 
                 z++;
                 /* we have already advanced the zone_list pointer, so continue with next zone */
@@ -1672,7 +1909,7 @@ static int load_ihdr(SFData *sf, unsigned int size)
     for(i = 0; i < size; i++)
     {
         /* load all instrument headers */
-        if((inst = FLUID_NEW(SFInst)) == NULL)
+        if((inst = FLUID_ARENA_NEW(sf->arena, SFInst)) == NULL)
         {
             FLUID_LOG(FLUID_PANIC, "Out of memory");
             return FALSE;
@@ -1695,9 +1932,9 @@ static int load_ihdr(SFData *sf, unsigned int size)
 
             i2 = zndx - pzndx;
 
-            while(i2--)
+            if(!prepend_placeholders(sf, &prev_inst->zone, i2))
             {
-                prev_inst->zone = fluid_list_prepend(prev_inst->zone, NULL);
+                return FALSE;
             }
         }
         else if(zndx > 0)  /* 1st inst, warn if ofs >0 */
@@ -1720,9 +1957,9 @@ static int load_ihdr(SFData *sf, unsigned int size)
 
     i2 = zndx - pzndx;
 
-    while(i2--)
+    if(!prepend_placeholders(sf, &prev_inst->zone, i2))
     {
-        prev_inst->zone = fluid_list_prepend(prev_inst->zone, NULL);
+        return FALSE;
     }
 
     return TRUE;
@@ -1759,7 +1996,7 @@ static int load_ibag(SFData *sf, int size)
                 return FALSE;
             }
 
-            if((z = FLUID_NEW(SFZone)) == NULL)
+            if((z = FLUID_ARENA_NEW(sf->arena, SFZone)) == NULL)
             {
                 FLUID_LOG(FLUID_PANIC, "Out of memory");
                 return FALSE;
@@ -1788,16 +2025,16 @@ static int load_ibag(SFData *sf, int size)
 
                 i = genndx - pgenndx;
 
-                while(i--)
+                if(!prepend_placeholders(sf, &pz->gen, i))
                 {
-                    pz->gen = fluid_list_prepend(pz->gen, NULL);
+                    return FALSE;
                 }
 
                 i = modndx - pmodndx;
 
-                while(i--)
+                if(!prepend_placeholders(sf, &pz->mod, i))
                 {
-                    pz->mod = fluid_list_prepend(pz->mod, NULL);
+                    return FALSE;
                 }
             }
 
@@ -1851,16 +2088,16 @@ static int load_ibag(SFData *sf, int size)
 
     i = genndx - pgenndx;
 
-    while(i--)
+    if(!prepend_placeholders(sf, &pz->gen, i))
     {
-        pz->gen = fluid_list_prepend(pz->gen, NULL);
+        return FALSE;
     }
 
     i = modndx - pmodndx;
 
-    while(i--)
+    if(!prepend_placeholders(sf, &pz->mod, i))
     {
-        pz->mod = fluid_list_prepend(pz->mod, NULL);
+        return FALSE;
     }
 
     return TRUE;
@@ -1895,7 +2132,7 @@ static int load_imod(SFData *sf, int size)
                     return FALSE;
                 }
 
-                if((m = FLUID_NEW(SFMod)) == NULL)
+                if((m = FLUID_ARENA_NEW(sf->arena, SFMod)) == NULL)
                 {
                     FLUID_LOG(FLUID_PANIC, "Out of memory");
                     return FALSE;
@@ -2066,7 +2303,7 @@ int load_igen(SFData *sf, int size)
                     if(!dup)
                     {
                         /* if gen ! dup alloc new */
-                        if((g = FLUID_NEW(SFGen)) == NULL)
+                        if((g = FLUID_ARENA_NEW(sf->arena, SFGen)) == NULL)
                         {
                             FLUID_LOG(FLUID_PANIC, "Out of memory");
                             return FALSE;
@@ -2123,13 +2360,10 @@ int load_igen(SFData *sf, int size)
              * other global zones we encounter */
             if(level < 3 && (zone_list != inst->zone))
             {
-                /* advance to next zone before deleting the current list element */
-                zone_list = fluid_list_next(zone_list);
-
                 FLUID_LOG(FLUID_WARN, "Instrument '%s': Discarding invalid global zone (global zones must appear first in instruments per SoundFont spec 7.7).",
                           inst->name);
-                inst->zone = fluid_list_remove(inst->zone, zone);
-                delete_zone(zone);
+                /* unlink the zone and advance to the next one, the zone is freed with the arena */
+                SLADVREM(inst->zone, zone_list);
 
                 z++;
                 /* we have already advanced the zone_list pointer, so continue with next zone */
@@ -2249,86 +2483,26 @@ static int load_shdr(SFData *sf, unsigned int size)
     return TRUE;
 }
 
-void delete_preset(SFPreset *preset)
+/* Prepends count empty entries to a list of zones, generators or modulators,
+ * which are filled in when loading the following chunk */
+static int prepend_placeholders(SFData *sf, fluid_list_t **list, int count)
 {
     fluid_list_t *entry;
-    SFZone *zone;
 
-    if(!preset)
+    for(; count > 0; count--)
     {
-        return;
-    }
-
-    entry = preset->zone;
-
-    while(entry)
-    {
-        zone = (SFZone *)fluid_list_get(entry);
-        delete_zone(zone);
-        entry = fluid_list_next(entry);
-    }
-
-    delete_fluid_list(preset->zone);
-
-    FLUID_FREE(preset);
-}
-
-void delete_inst(SFInst *inst)
-{
-    fluid_list_t *entry;
-    SFZone *zone;
-
-    if(!inst)
-    {
-        return;
-    }
-
-    entry = inst->zone;
-
-    while(entry)
-    {
-        zone = (SFZone *)fluid_list_get(entry);
-        delete_zone(zone);
-        entry = fluid_list_next(entry);
-    }
-
-    delete_fluid_list(inst->zone);
-
-    FLUID_FREE(inst);
-}
+        entry = fluid_arena_list_prepend(sf->arena, *list, NULL);
 
+        if(entry == NULL)
+        {
+            FLUID_LOG(FLUID_PANIC, "Out of memory");
+            return FALSE;
+        }
 
-/* Free all elements of a zone (Preset or Instrument) */
-void delete_zone(SFZone *zone)
-{
-    fluid_list_t *entry;
-
-    if(!zone)
-    {
-        return;
-    }
-
-    entry = zone->gen;
-
-    while(entry)
-    {
-        FLUID_FREE(fluid_list_get(entry));
-        entry = fluid_list_next(entry);
-    }
-
-    delete_fluid_list(zone->gen);
-
-    entry = zone->mod;
-
-    while(entry)
-    {
-        FLUID_FREE(fluid_list_get(entry));
-        entry = fluid_list_next(entry);
+        *list = entry;
     }
 
-    delete_fluid_list(zone->mod);
-
-    FLUID_FREE(zone);
+    return TRUE;
 }
 
 /* preset sort function, first by bank, then by preset # */
@@ -2417,6 +2591,52 @@ static int valid_preset_genid(unsigned short genid)
 }
 
 
+/*
+ * Reads size bytes of the file at offset with many reads in flight at the same time, by
+ * splitting them into parts of FLUID_SFFILE_READ_CHUNK bytes, see fluid_file_read_ranges().
+ * This needs the default file callbacks, which read from a FILE, and doesn't move its position.
+ *
+ * @return FLUID_OK if the data has been read, FLUID_FAILED if it has to be read by the file
+ *   callbacks instead: because synth.async-io is off, the data fits into one part, custom
+ *   callbacks are used or the parallel reads failed
+ */
+static int fluid_sffile_read_parallel(SFData *sf, fluid_long_long_t offset, void *buf, size_t size)
+{
+    fluid_file_range_t *ranges;
+    int i, count, result;
+
+    if(!sf->async_io || size <= FLUID_SFFILE_READ_CHUNK
+            || sf->fcbs->fread != safe_fread || sf->fcbs->fseek != safe_fseek)
+    {
+        return FLUID_FAILED;
+    }
+
+    count = (int)((size + FLUID_SFFILE_READ_CHUNK - 1) / FLUID_SFFILE_READ_CHUNK);
+    ranges = FLUID_ARRAY(fluid_file_range_t, count);
+
+    if(ranges == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        ranges[i].offset = offset + (fluid_long_long_t)i * FLUID_SFFILE_READ_CHUNK;
+        ranges[i].buf = (char *)buf + (size_t)i * FLUID_SFFILE_READ_CHUNK;
+        ranges[i].length = (i < count - 1) ? FLUID_SFFILE_READ_CHUNK : size - (size_t)i * FLUID_SFFILE_READ_CHUNK;
+    }
+
+    result = fluid_file_read_ranges((FILE *)sf->sffd, ranges, count);
+    FLUID_FREE(ranges);
+
+    if(result != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_DBG, "Failed to read the sample data in parallel, reading it sequentially");
+    }
+
+    return result;
+}
+
 static int fluid_sffile_read_wav(SFData *sf, unsigned int start, unsigned int end, short **data, char **data24)
 {
     short *loaded_data = NULL;
@@ -2433,30 +2653,34 @@ static int fluid_sffile_read_wav(SFData *sf, unsigned int start, unsigned int en
         goto error_exit;
     }
 
-    fluid_rec_mutex_lock(sf->mtx);
-
-    /* Load 16-bit sample data */
-    if(sf->fcbs->fseek(sf->sffd, sf->samplepos + (start * sizeof(short)), SEEK_SET) == FLUID_FAILED)
-    {
-        FLUID_LOG(FLUID_ERR, "Failed to seek to sample position");
-        goto error_exit_unlock;
-    }
-
-    loaded_data = FLUID_ARRAY(short, num_samples);
+    loaded_data = fluid_alloc_huge(num_samples * sizeof(short), sf->huge_pages);
 
     if(loaded_data == NULL)
     {
         FLUID_LOG(FLUID_PANIC, "Out of memory");
-        goto error_exit_unlock;
+        goto error_exit;
     }
 
-    if(sf->fcbs->fread(loaded_data, num_samples * sizeof(short), sf->sffd) == FLUID_FAILED)
+    /* Load 16-bit sample data */
+    if(fluid_sffile_read_parallel(sf, sf->samplepos + (fluid_long_long_t)start * sizeof(short),
+                                  loaded_data, num_samples * sizeof(short)) != FLUID_OK)
     {
-        FLUID_LOG(FLUID_ERR, "Failed to read sample data");
-        goto error_exit_unlock;
-    }
+        fluid_rec_mutex_lock(sf->mtx);
 
-    fluid_rec_mutex_unlock(sf->mtx);
+        if(sf->fcbs->fseek(sf->sffd, sf->samplepos + (start * sizeof(short)), SEEK_SET) == FLUID_FAILED)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to seek to sample position");
+            goto error_exit_unlock;
+        }
+
+        if(sf->fcbs->fread(loaded_data, num_samples * sizeof(short), sf->sffd) == FLUID_FAILED)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to read sample data");
+            goto error_exit_unlock;
+        }
+
+        fluid_rec_mutex_unlock(sf->mtx);
+    }
 
     /* If this machine is big endian, byte swap the 16 bit samples */
     if(FLUID_IS_BIG_ENDIAN)
@@ -2482,7 +2706,7 @@ static int fluid_sffile_read_wav(SFData *sf, unsigned int start, unsigned int en
             goto error24_exit;
         }
 
-        loaded_data24 = FLUID_ARRAY(char, num_samples);
+        loaded_data24 = fluid_alloc_huge(num_samples, sf->huge_pages);
 
         if(loaded_data24 == NULL)
         {
@@ -2490,21 +2714,25 @@ static int fluid_sffile_read_wav(SFData *sf, unsigned int start, unsigned int en
             goto error24_exit;
         }
 
-        fluid_rec_mutex_lock(sf->mtx);
-
-        if(sf->fcbs->fseek(sf->sffd, sf->sample24pos + start, SEEK_SET) == FLUID_FAILED)
+        if(fluid_sffile_read_parallel(sf, (fluid_long_long_t)sf->sample24pos + start, loaded_data24,
+                                      num_samples) != FLUID_OK)
         {
-            FLUID_LOG(FLUID_ERR, "Failed to seek position for 24-bit sample data in data file");
-            goto error24_exit_unlock;
-        }
+            fluid_rec_mutex_lock(sf->mtx);
 
-        if(sf->fcbs->fread(loaded_data24, num_samples, sf->sffd) == FLUID_FAILED)
-        {
-            FLUID_LOG(FLUID_ERR, "Failed to read 24-bit sample data");
-            goto error24_exit_unlock;
-        }
+            if(sf->fcbs->fseek(sf->sffd, sf->sample24pos + start, SEEK_SET) == FLUID_FAILED)
+            {
+                FLUID_LOG(FLUID_ERR, "Failed to seek position for 24-bit sample data in data file");
+                goto error24_exit_unlock;
+            }
 
-        fluid_rec_mutex_unlock(sf->mtx);
+            if(sf->fcbs->fread(loaded_data24, num_samples, sf->sffd) == FLUID_FAILED)
+            {
+                FLUID_LOG(FLUID_ERR, "Failed to read 24-bit sample data");
+                goto error24_exit_unlock;
+            }
+
+            fluid_rec_mutex_unlock(sf->mtx);
+        }
     }
 
     *data24 = loaded_data24;
@@ -2529,7 +2757,243 @@ error_exit:
 
 
 /* Ogg Vorbis loading and decompression */
-#if LIBSNDFILE_SUPPORT
+#if VORBISFILE_SUPPORT
+
+/* The compressed data of a sample, which libvorbisfile reads from memory */
+typedef struct _vorbis_mem_t
+{
+    const unsigned char *data;
+    size_t size;
+    size_t offset;
+} vorbis_mem_t;
+
+static size_t vorbis_mem_read(void *ptr, size_t size, size_t nmemb, void *datasource)
+{
+    vorbis_mem_t *mem = datasource;
+    size_t count = (size != 0) ? (mem->size - mem->offset) / size : 0;
+
+    if(count > nmemb)
+    {
+        count = nmemb;
+    }
+
+    FLUID_MEMCPY(ptr, mem->data + mem->offset, count * size);
+    mem->offset += count * size;
+
+    return count;
+}
+
+static int vorbis_mem_seek(void *datasource, ogg_int64_t offset, int whence)
+{
+    vorbis_mem_t *mem = datasource;
+    ogg_int64_t new_offset;
+
+    switch(whence)
+    {
+    case SEEK_SET:
+        new_offset = offset;
+        break;
+
+    case SEEK_CUR:
+        new_offset = (ogg_int64_t)mem->offset + offset;
+        break;
+
+    case SEEK_END:
+        new_offset = (ogg_int64_t)mem->size + offset;
+        break;
+
+    default:
+        return -1;
+    }
+
+    if(new_offset < 0 || new_offset > (ogg_int64_t)mem->size)
+    {
+        return -1;
+    }
+
+    mem->offset = (size_t)new_offset;
+
+    return 0;
+}
+
+static long vorbis_mem_tell(void *datasource)
+{
+    vorbis_mem_t *mem = datasource;
+
+    return (long)mem->offset;
+}
+
+/**
+ * Read Ogg Vorbis compressed data from the Soundfont and decompress it, returning the number of samples
+ * in the decompressed WAV. Only 16-bit mono samples are supported.
+ *
+ * Note that this function takes byte indices for start and end source data. The sample headers in SF3
+ * files use byte indices, so those pointers can be passed directly to this function.
+ *
+ * libvorbisfile decodes the data from memory: a mapping of the file if it is opened with the default
+ * file callbacks, so that the samples loaded in parallel don't wait for each other, or else a copy read
+ * at once.
+ */
+static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigned int end_byte, short **data)
+{
+    ov_callbacks callbacks =
+    {
+        vorbis_mem_read,
+        vorbis_mem_seek,
+        NULL,
+        vorbis_mem_tell
+    };
+    vorbis_mem_t mem;
+    fluid_file_map_t map;
+    OggVorbis_File vf;
+    void *buf = NULL;
+    float *pcm_data = NULL;
+    short *wav_data = NULL;
+    ogg_int64_t frames;
+    double peak = 0;
+    long count;
+    int i, bitstream, num_frames = -1;
+
+    if((start_byte > sf->samplesize) || (end_byte > sf->samplesize) || (end_byte < start_byte))
+    {
+        FLUID_LOG(FLUID_ERR, "Ogg Vorbis data offsets exceed sample data chunk");
+        return -1;
+    }
+
+    mem.data = NULL;
+    mem.size = (size_t)(end_byte + 1) - start_byte;
+    mem.offset = 0;
+    map.addr = NULL;
+
+    if(sf->fcbs->fread == safe_fread && sf->fcbs->fseek == safe_fseek)
+    {
+        mem.data = fluid_file_map((FILE *)sf->sffd, (fluid_long_long_t)sf->samplepos + start_byte,
+                                  (fluid_long_long_t)mem.size, &map);
+    }
+
+    if(mem.data == NULL)
+    {
+        int ok;
+
+        buf = FLUID_MALLOC(mem.size);
+
+        if(buf == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return -1;
+        }
+
+        fluid_rec_mutex_lock(sf->mtx);
+        ok = sf->fcbs->fseek(sf->sffd, (fluid_long_long_t)sf->samplepos + start_byte, SEEK_SET) != FLUID_FAILED
+             && sf->fcbs->fread(buf, (fluid_long_long_t)mem.size, sf->sffd) != FLUID_FAILED;
+        fluid_rec_mutex_unlock(sf->mtx);
+
+        if(!ok)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to read compressed sample data");
+            FLUID_FREE(buf);
+            return -1;
+        }
+
+        mem.data = buf;
+    }
+
+    if(ov_open_callbacks(&mem, &vf, NULL, 0, callbacks) != 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to open the Ogg Vorbis data of a sample");
+        fluid_file_unmap(&map);
+        FLUID_FREE(buf);
+        return -1;
+    }
+
+    frames = ov_pcm_total(&vf, -1);
+
+    // Empty sample
+    if(frames <= 0)
+    {
+        FLUID_LOG(FLUID_DBG, "Empty decompressed sample");
+        *data = NULL;
+        num_frames = 0;
+        goto exit;
+    }
+
+    // Mono sample
+    if(ov_info(&vf, -1)->channels != 1)
+    {
+        FLUID_LOG(FLUID_DBG, "Unsupported channel count %d in ogg sample", ov_info(&vf, -1)->channels);
+        goto exit;
+    }
+
+    if(frames > INT_MAX)
+    {
+        FLUID_LOG(FLUID_ERR, "Decompressed sample too large");
+        goto exit;
+    }
+
+    pcm_data = FLUID_ARRAY(float, frames);
+    wav_data = fluid_alloc_huge((size_t)frames * sizeof(short), sf->huge_pages);
+
+    if(pcm_data == NULL || wav_data == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory");
+        goto exit;
+    }
+
+    for(i = 0; i < frames; i += count)
+    {
+        float **pcm;
+
+        count = ov_read_float(&vf, &pcm, (int)(frames - i), &bitstream);
+
+        if(count <= 0 || count > frames - i)
+        {
+            FLUID_LOG(FLUID_DBG, "Decompression failed!");
+            FLUID_LOG(FLUID_ERR, "ov_read_float(): error %ld", count);
+            goto exit;
+        }
+
+        FLUID_MEMCPY(pcm_data + i, pcm[0], count * sizeof(float));
+    }
+
+    for(i = 0; i < frames; i++)
+    {
+        if(fabs(pcm_data[i]) > peak)
+        {
+            peak = fabs(pcm_data[i]);
+        }
+    }
+
+    // Scaled to the peak of the sample to avoid clipping loud samples, the same way as
+    // libsndfile does with SFC_SET_SCALE_FLOAT_INT_READ, see
+    // https://github.com/FluidSynth/fluidsynth/issues/1380
+    if(peak > 0)
+    {
+        float inverse = (float)(1.0 / ((32768.0 / 32767.0) * peak));
+
+        for(i = 0; i < frames; i++)
+        {
+            wav_data[i] = (short)lrintf((pcm_data[i] * inverse) * 32767.0f);
+        }
+    }
+    else
+    {
+        FLUID_MEMSET(wav_data, 0, (size_t)frames * sizeof(short));
+    }
+
+    *data = wav_data;
+    wav_data = NULL;
+    num_frames = (int)frames;
+
+exit:
+    FLUID_FREE(wav_data);
+    FLUID_FREE(pcm_data);
+    ov_clear(&vf);
+    fluid_file_unmap(&map);
+    FLUID_FREE(buf);
+
+    return num_frames;
+}
+#elif LIBSNDFILE_SUPPORT
 
 /* Virtual file access routines to allow loading individually compressed
  * samples from the Soundfont sample data chunk using the file callbacks
@@ -2715,7 +3179,7 @@ static int fluid_sffile_read_vorbis(SFData *sf, unsigned int start_byte, unsigne
         FLUID_LOG(FLUID_WARN, "OGG sample is not OGG compressed, this is not officially supported");
     }
 
-    wav_data = FLUID_ARRAY(short, sfinfo.frames * sfinfo.channels);
+    wav_data = fluid_alloc_huge((size_t)sfinfo.frames * sfinfo.channels * sizeof(short), sf->huge_pages);
 
     if(!wav_data)
     {
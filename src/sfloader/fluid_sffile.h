@@ -29,6 +29,7 @@
 #include "fluid_mod.h"
 #include "fluidsynth.h"
 #include "fluid_sys.h"
+#include "fluid_arena.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -150,19 +151,33 @@ struct _SFData
     unsigned int hydrapos;
     unsigned int hydrasize;
 
+    const unsigned char *hydra; /* while parsing, the HYDRA chunk read into memory in one block */
+    unsigned int hydra_pos; /* the position of the next record within it */
+
     char *fname; /* file name */
+    time_t mtime; /* modification time of the file when opened, 0 if unknown, see fluid_samplecache_load() */
     FILE *sffd; /* loaded sfont file descriptor */
     const fluid_file_callbacks_t *fcbs; /* file callbacks used to read this file */
 
     fluid_rec_mutex_t mtx; /* this mutex can be used to synchronize calls to fcbs when using multiple threads (e.g. SF3 loading) */
 
+    int huge_pages; /* allocate the sample data read from the file from huge pages, see fluid_alloc_huge() */
+    int async_io; /* read large sample data in parallel parts, see fluid_file_read_ranges() */
+
     fluid_list_t *info; /* linked list of info strings (1st byte is ID) */
     fluid_list_t *preset; /* linked list of preset info */
     fluid_list_t *inst; /* linked list of instrument info */
     fluid_list_t *sample; /* linked list of sample info */
     fluid_list_t *default_mod_list; /* default modulator list */
+
+    /* the presets, instruments, zones, generators and modulators, and the lists of
+     * zones, generators and modulators are allocated from this arena */
+    fluid_arena_t *arena;
 };
 
+/* Size of the blocks of SFData::arena */
+#define FLUID_SFFILE_ARENA_BLOCK_SIZE (64 * 1024)
+
 /* functions */
 
 
@@ -185,14 +200,16 @@ void fluid_sffile_close(SFData *sf);
 int fluid_sffile_parse_presets(SFData *sf);
 int fluid_sffile_read_sample_data(SFData *sf, unsigned int sample_start, unsigned int sample_end,
                                   int sample_type, short **data, char **data24);
+int fluid_sffile_map_sample_data(SFData *sf, unsigned int sample_start, unsigned int sample_end,
+                                 int sample_type, short **data, char **data24,
+                                 fluid_file_map_t *map, fluid_file_map_t *map24);
+int fluid_sffile_hash_vorbis_data(SFData *sf, unsigned int start_byte, unsigned int end_byte, uint64_t hash[2]);
+int fluid_sffile_hash_hydra(SFData *sf, uint64_t hash[2]);
 
 
 /* extern only for unit test purposes */
 int load_igen(SFData *sf, int size);
 int load_pgen(SFData *sf, int size);
-void delete_preset(SFPreset *preset);
-void delete_inst(SFInst *inst);
-void delete_zone(SFZone *zone);
 
 #ifdef __cplusplus
 }
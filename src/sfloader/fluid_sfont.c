@@ -20,6 +20,7 @@
 #include "fluid_sfont.h"
 #include "fluid_sys.h"
 #include "fluid_mod.h"
+#include "fluid_rvoice.h"
 
 
 void *default_fopen(const char *path)
@@ -404,6 +405,38 @@ fluid_preset_t *fluid_sfont_iteration_next(fluid_sfont_t *sfont)
     return sfont->iteration_next(sfont);
 }
 
+/**
+ * Pages in the memory used by all presets of a SoundFont, so that their first notes
+ * don't wait for page faults.
+ *
+ * This is the synchronous version of fluid_synth_warm_preset() for all presets of a
+ * SoundFont, see there. It returns once all presets have been warmed up. It iterates the
+ * presets, see fluid_sfont_iteration_start().
+ *
+ * @param sfont The SoundFont instance.
+ * @return #FLUID_OK if all presets have been warmed up, #FLUID_FAILED otherwise
+ * @since 2.6.0
+ */
+int fluid_sfont_warm(fluid_sfont_t *sfont)
+{
+    fluid_preset_t *preset;
+    int ret = FLUID_OK;
+
+    fluid_return_val_if_fail(sfont != NULL, FLUID_FAILED);
+
+    fluid_sfont_iteration_start(sfont);
+
+    while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        if(fluid_preset_notify(preset, FLUID_PRESET_WARM, -1) != FLUID_OK)
+        {
+            ret = FLUID_FAILED;
+        }
+    }
+
+    return ret;
+}
+
 /**
  * Destroys a SoundFont instance created with new_fluid_sfont().
  *
@@ -598,6 +631,7 @@ delete_fluid_sample(fluid_sample_t *sample)
         FLUID_FREE(sample->data24);
     }
 
+    fluid_sample_free_mipmap(sample);
     FLUID_FREE(sample);
 }
 
@@ -672,6 +706,9 @@ fluid_sample_set_sound_data(fluid_sample_t *sample,
 
     sample->data = NULL;
     sample->data24 = NULL;
+    sample->data_float = NULL;
+    sample->data_compressed = NULL;
+    fluid_sample_free_mipmap(sample);
 
     if(copy_data)
     {
@@ -916,3 +953,128 @@ int fluid_sample_sanitize_loop(fluid_sample_t *sample, unsigned int buffer_size)
 
     return modified;
 }
+
+/* Half of the taps of the half-band lowpass of the mipmap levels, which has 2 * order + 1 taps */
+#define FLUID_MIPMAP_FILTER_ORDER 31
+
+/* Point idx of the level a mipmap level is computed from, level 0 being the sample itself */
+static FLUID_INLINE double
+fluid_sample_get_mip_source(const fluid_sample_t *sample, const fluid_real_t *src, int count, int idx)
+{
+    if(idx < 0 || idx >= count)
+    {
+        return 0.0;
+    }
+
+    if(src != NULL)
+    {
+        return src[idx];
+    }
+
+    if(sample->data_float != NULL)
+    {
+        return sample->data_float[sample->start + idx];
+    }
+
+    if(sample->data_compressed != NULL)
+    {
+        return fluid_rvoice_get_sample_compressed(sample->data_compressed, sample->start + idx);
+    }
+
+    return fluid_rvoice_get_sample(sample->data, sample->data24, sample->start + idx);
+}
+
+/*
+ * Create the band-limited copies of a sample's data that voices transposed up by an octave
+ * or more read from, see fluid_rvoice_dsp_interpolate(). Every level is the previous one
+ * filtered by a Blackman windowed half-band lowpass and decimated by two, the points
+ * outside of the sample count as zero. Samples that are streamed from disk are left
+ * alone, since this would read all of their data.
+ *
+ * @param levels Number of levels, at most #FLUID_SAMPLE_MIP_LEVELS, 0 only removes the mipmap
+ * @return #FLUID_OK on success, #FLUID_FAILED if out of memory
+ */
+int
+fluid_sample_build_mipmap(fluid_sample_t *sample, int levels)
+{
+    double taps[FLUID_MIPMAP_FILTER_ORDER + 1];
+    double sum, acc;
+    const fluid_real_t *src = NULL;
+    fluid_real_t *dst;
+    int count[FLUID_SAMPLE_MIP_LEVELS + 1];
+    int i, j, k, total = 0;
+
+    fluid_return_val_if_fail(sample != NULL, FLUID_FAILED);
+
+    fluid_sample_free_mipmap(sample);
+
+    if(levels <= 0 || (sample->data == NULL && sample->data_compressed == NULL) || sample->stream_preload != 0 || sample->end <= sample->start)
+    {
+        return FLUID_OK;
+    }
+
+    levels = (levels < FLUID_SAMPLE_MIP_LEVELS) ? levels : FLUID_SAMPLE_MIP_LEVELS;
+    count[0] = sample->end - sample->start + 1;
+
+    for(i = 1; i <= levels; i++)
+    {
+        count[i] = (count[i - 1] + 1) / 2;
+        sample->mip_offset[i - 1] = total;
+        total += count[i];
+    }
+
+    sample->mipmap = FLUID_ARRAY(fluid_real_t, total);
+
+    if(sample->mipmap == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    /* taps[k] is the tap k points away from the center, every even one but the center is 0 */
+    taps[0] = 0.5;
+    sum = taps[0];
+
+    for(k = 1; k <= FLUID_MIPMAP_FILTER_ORDER; k++)
+    {
+        taps[k] = (k % 2 == 0) ? 0.0 : sin(M_PI * k / 2) / (M_PI * k)
+                  * (0.42 + 0.5 * cos(M_PI * k / (FLUID_MIPMAP_FILTER_ORDER + 1))
+                     + 0.08 * cos(2 * M_PI * k / (FLUID_MIPMAP_FILTER_ORDER + 1)));
+        sum += 2 * taps[k];
+    }
+
+    for(i = 1; i <= levels; i++)
+    {
+        dst = &sample->mipmap[sample->mip_offset[i - 1]];
+
+        for(j = 0; j < count[i]; j++)
+        {
+            acc = taps[0] * fluid_sample_get_mip_source(sample, src, count[i - 1], 2 * j);
+
+            for(k = 1; k <= FLUID_MIPMAP_FILTER_ORDER; k += 2)
+            {
+                acc += taps[k] * (fluid_sample_get_mip_source(sample, src, count[i - 1], 2 * j - k)
+                                  + fluid_sample_get_mip_source(sample, src, count[i - 1], 2 * j + k));
+            }
+
+            dst[j] = (fluid_real_t)(acc / sum);
+        }
+
+        src = dst;
+    }
+
+    sample->mip_levels = levels;
+
+    return FLUID_OK;
+}
+
+/*
+ * Remove the band-limited copies of a sample's data, if any.
+ */
+void
+fluid_sample_free_mipmap(fluid_sample_t *sample)
+{
+    FLUID_FREE(sample->mipmap);
+    sample->mipmap = NULL;
+    sample->mip_levels = 0;
+}
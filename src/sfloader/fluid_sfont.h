@@ -22,12 +22,18 @@
 #define _PRIV_FLUID_SFONT_H
 
 #include "fluidsynth.h"
+#include "fluidsynth_priv.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 int fluid_sample_validate(fluid_sample_t *sample, unsigned int max_end);
 int fluid_sample_sanitize_loop(fluid_sample_t *sample, unsigned int max_end);
+int fluid_sample_build_mipmap(fluid_sample_t *sample, int levels);
+void fluid_sample_free_mipmap(fluid_sample_t *sample);
+
+/* Maximum number of band-limited copies of a sample, see synth.sample-mipmap-levels */
+#define FLUID_SAMPLE_MIP_LEVELS 4
 
 /*
  * Utility macros to access soundfonts, presets, and samples
@@ -56,11 +62,11 @@ fluid_sfont_t *new_fluid_sfont_local(fluid_sfont_get_name_t get_name,
   ( ((_preset) && (_preset)->notify) ? (*(_preset)->notify)(_preset,_reason,_chan) : FLUID_OK )
 
 
-#define fluid_sample_incr_ref(_sample) { (_sample)->refcount++; }
+/* atomic, the voices of synths sharing a SoundFont (see synth.shared-soundfonts) may run in different threads */
+#define fluid_sample_incr_ref(_sample) { fluid_atomic_int_inc(&(_sample)->refcount); }
 
 #define fluid_sample_decr_ref(_sample) \
-  (_sample)->refcount--; \
-  if (((_sample)->refcount == 0) && ((_sample)->notify)) \
+  if (fluid_atomic_int_dec_and_test(&(_sample)->refcount) && ((_sample)->notify)) \
     (*(_sample)->notify)(_sample, FLUID_SAMPLE_DONE);
 
 
@@ -77,6 +83,13 @@ struct _fluid_file_callbacks_t
     fluid_sfloader_callback_tell_t  ftell;
 };
 
+/* The default file callbacks of a SoundFont loader, which operate on FILE handles */
+void *default_fopen(const char *path);
+int default_fclose(void *handle);
+fluid_long_long_t default_ftell(void *handle);
+int safe_fread(void *buf, fluid_long_long_t count, void *handle);
+int safe_fseek(void *handle, fluid_long_long_t ofs, int whence);
+
 /**
  * SoundFont loader structure.
  */
@@ -113,6 +126,10 @@ struct _fluid_sfont_t
     fluid_sfont_iteration_start_t iteration_start;
 
     fluid_sfont_iteration_next_t iteration_next;
+
+    /* Fills in the memory used by the SoundFont, NULL if the loader doesn't account it.
+     * Called with the API lock of the synth held. */
+    int (*get_memory)(fluid_sfont_t *sfont, fluid_sfont_memory_t *usage);
 };
 
 /**
@@ -174,6 +191,12 @@ struct _fluid_sample_t
 
     short *data;                  /**< Pointer to the sample's 16 bit PCM data */
     char *data24;                 /**< If not NULL, pointer to the least significant byte counterparts of each sample data point in order to create 24 bit audio samples */
+    fluid_real_t *data_float;     /**< If not NULL, the sample data points converted to floating point, used instead of data and data24 for rendering (see synth.sample-format). Owned by the sample cache. */
+    signed char *data_compressed; /**< If not NULL, the sample data points in blocks of 8 bit mantissas sharing an exponent, used instead of data and data24, which are NULL then (see synth.sample-format). Owned by the sample cache. */
+    fluid_real_t *mipmap;         /**< If not NULL, copies of the points from start to end band-limited to 1/2, 1/4, ... of the sample rate and decimated accordingly (see synth.sample-mipmap-levels). Owned by the sample. */
+    unsigned int mip_offset[FLUID_SAMPLE_MIP_LEVELS]; /**< Index of the first point of each level in mipmap, the first level has half the sample rate */
+    int mip_levels;               /**< Number of levels in mipmap */
+    unsigned int stream_preload;  /**< If not 0, data and data24 are streamed from a memory mapped file, and this many sample points from start on have been read when loading (see synth.sample-streaming) */
     unsigned int samplerate;      /**< Sample rate */
     int origpitch;                /**< Original pitch (MIDI note number, 0-127) */
     int pitchadj;                 /**< Fine pitch adjustment (+/- 99 cents) */
@@ -183,8 +206,11 @@ struct _fluid_sample_t
     int amplitude_that_reaches_noise_floor_is_valid;      /**< Indicates if \a amplitude_that_reaches_noise_floor is valid (TRUE), set to FALSE initially to calculate. */
     double amplitude_that_reaches_noise_floor;            /**< The amplitude at which the sample's loop will be below the noise floor.  For voice off optimization, calculated automatically. */
 
-    unsigned int refcount;             /**< Count of voices using this sample */
+    fluid_atomic_int_t refcount;       /**< Count of voices using this sample */
     int preset_count;                  /**< Count of selected presets using this sample (used for dynamic sample loading) */
+    int loading;                       /**< TRUE while the sample data is being loaded in the background (see synth.dynamic-sample-loading-async) */
+    int kept_unused;                   /**< TRUE while the data of the sample is kept in memory although no selected preset uses it (see synth.dynamic-sample-loading-budget) */
+    void *owner;                       /**< The data of the SoundFont owning the sample, only used by the SoundFont loader */
     fluid_mod_t *default_modulators;   /**< Default soundfont modulators for this sample to allocate the voice for it. NULL will use the synth's defaults. */
 
     /**
@@ -0,0 +1,427 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+/* SHARED SOUNDFONTS
+ *
+ * Keeps the SoundFonts loaded by synths with synth.shared-soundfonts enabled in a global
+ * (process-wide) list, so that other synths loading the same file attach to the SoundFont
+ * instead of importing it again. Every synth gets its own fluid_sfont_t and fluid_preset_t
+ * objects, which carry the ID, bank offset and reference counts of that synth, and which
+ * forward to the shared SoundFont and its presets. The shared SoundFont is freed once the
+ * last synth has unloaded it.
+ */
+
+#include "fluid_sfregistry.h"
+#include "fluid_sys.h"
+
+
+typedef struct _fluid_sfregistry_entry_t fluid_sfregistry_entry_t;
+
+struct _fluid_sfregistry_entry_t
+{
+    /* The following members all form the registry key */
+    char *filename;
+    time_t modification_time;
+    int float_samples;
+    int compressed_samples;
+    int mipmap_levels;
+    int mmap_samples;
+    int stream_samples;
+    int stream_preload;
+    int mlock;
+    /*  End of registry key members */
+
+    fluid_sfont_t *sfont;       /* the loaded SoundFont, never added to a synth */
+    int num_references;
+};
+
+/* The fluid_sfont_t data of a synth attached to a shared SoundFont */
+typedef struct
+{
+    fluid_sfregistry_entry_t *entry;    /* NULL once released */
+    fluid_sfont_t *unloading;           /* the shared SoundFont, if released last and its deletion blocked */
+    fluid_list_t *preset;               /* the presets of the synth, in the order of the shared presets */
+    fluid_list_t *preset_iter_cur;
+} fluid_shared_sfont_t;
+
+static fluid_list_t *sfregistry_list = NULL;
+static fluid_mutex_t sfregistry_mutex = FLUID_MUTEX_INIT;
+
+static fluid_sfregistry_entry_t *new_sfregistry_entry(const fluid_sfregistry_entry_t *key,
+        const char *filename, fluid_list_t *loaders);
+static void delete_sfregistry_entry(fluid_sfregistry_entry_t *entry);
+static fluid_sfont_t *new_shared_sfont(fluid_sfregistry_entry_t *entry);
+static fluid_sfont_t *sfregistry_release(fluid_sfregistry_entry_t *entry);
+
+
+/**
+ * Loads a SoundFont, or attaches to the one loaded by another synth with the same settings.
+ * @param settings Settings of the synth, the sample settings are part of the registry key
+ * @param loaders The SoundFont loaders of the synth, used if the SoundFont isn't loaded yet
+ * @param filename File to load
+ * @return A new SoundFont forwarding to the shared one, to be added to the synth, NULL on error
+ */
+fluid_sfont_t *
+fluid_sfregistry_load(fluid_settings_t *settings, fluid_list_t *loaders, const char *filename)
+{
+    fluid_sfregistry_entry_t key, *entry = NULL;
+    fluid_stat_buf_t buf;
+    fluid_sfont_t *sfont;
+    fluid_list_t *list;
+
+    FLUID_MEMSET(&key, 0, sizeof(key));
+
+    /* files that can't be examined, e.g. loaded by custom file callbacks, are matched by name */
+    if(fluid_stat(filename, &buf) == 0)
+    {
+        key.modification_time = buf.st_mtime;
+    }
+
+    key.float_samples = fluid_settings_str_equal(settings, "synth.sample-format", "float");
+    key.compressed_samples = fluid_settings_str_equal(settings, "synth.sample-format", "compressed");
+    fluid_settings_getint(settings, "synth.sample-mipmap-levels", &key.mipmap_levels);
+    fluid_settings_getint(settings, "synth.sample-mmap", &key.mmap_samples);
+    fluid_settings_getint(settings, "synth.sample-streaming", &key.stream_samples);
+    fluid_settings_getint(settings, "synth.sample-streaming-preload", &key.stream_preload);
+    fluid_settings_getint(settings, "synth.lock-memory", &key.mlock);
+
+    fluid_mutex_lock(sfregistry_mutex);
+
+    for(list = sfregistry_list; list != NULL; list = fluid_list_next(list))
+    {
+        entry = fluid_list_get(list);
+
+        if(FLUID_STRCMP(entry->filename, filename) == 0
+                && entry->modification_time == key.modification_time
+                && entry->float_samples == key.float_samples
+                && entry->compressed_samples == key.compressed_samples
+                && entry->mipmap_levels == key.mipmap_levels
+                && entry->mmap_samples == key.mmap_samples
+                && entry->stream_samples == key.stream_samples
+                && entry->stream_preload == key.stream_preload
+                && entry->mlock == key.mlock)
+        {
+            break;
+        }
+    }
+
+    if(list == NULL)
+    {
+        /* loaded with the mutex held, so that two synths never load the same file */
+        entry = new_sfregistry_entry(&key, filename, loaders);
+
+        if(entry == NULL)
+        {
+            fluid_mutex_unlock(sfregistry_mutex);
+            return NULL;
+        }
+
+        sfregistry_list = fluid_list_prepend(sfregistry_list, entry);
+    }
+
+    sfont = new_shared_sfont(entry);
+
+    if(sfont == NULL && entry->num_references == 0)
+    {
+        sfregistry_list = fluid_list_remove(sfregistry_list, entry);
+        delete_sfregistry_entry(entry);
+    }
+
+    fluid_mutex_unlock(sfregistry_mutex);
+
+    return sfont;
+}
+
+/* Drops a reference to an entry. Returns its SoundFont if that was the last one, to be deleted
+ * by the caller. */
+static fluid_sfont_t *
+sfregistry_release(fluid_sfregistry_entry_t *entry)
+{
+    fluid_sfont_t *sfont = NULL;
+
+    fluid_mutex_lock(sfregistry_mutex);
+
+    if(--entry->num_references == 0)
+    {
+        sfregistry_list = fluid_list_remove(sfregistry_list, entry);
+        sfont = entry->sfont;
+        entry->sfont = NULL;
+        delete_sfregistry_entry(entry);
+    }
+
+    fluid_mutex_unlock(sfregistry_mutex);
+
+    return sfont;
+}
+
+static fluid_sfregistry_entry_t *
+new_sfregistry_entry(const fluid_sfregistry_entry_t *key, const char *filename, fluid_list_t *loaders)
+{
+    fluid_sfregistry_entry_t *entry;
+    fluid_sfloader_t *loader;
+
+    entry = FLUID_NEW(fluid_sfregistry_entry_t);
+
+    if(entry == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    *entry = *key;
+    entry->sfont = NULL;
+    entry->num_references = 0;
+    entry->filename = FLUID_STRDUP(filename);
+
+    if(entry->filename == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(entry);
+        return NULL;
+    }
+
+    for(; loaders != NULL && entry->sfont == NULL; loaders = fluid_list_next(loaders))
+    {
+        loader = fluid_list_get(loaders);
+        entry->sfont = fluid_sfloader_load(loader, entry->filename);
+    }
+
+    if(entry->sfont == NULL)
+    {
+        delete_sfregistry_entry(entry);
+        return NULL;
+    }
+
+    return entry;
+}
+
+static void
+delete_sfregistry_entry(fluid_sfregistry_entry_t *entry)
+{
+    /* a SoundFont still referenced by its entry has never been attached to, so no voice uses it */
+    fluid_sfont_delete_internal(entry->sfont);
+    FLUID_FREE(entry->filename);
+    FLUID_FREE(entry);
+}
+
+/* Returns the number of SoundFonts shared by the synths of the process */
+int fluid_sfregistry_count_entries(void)
+{
+    int count;
+
+    fluid_mutex_lock(sfregistry_mutex);
+    count = fluid_list_size(sfregistry_list);
+    fluid_mutex_unlock(sfregistry_mutex);
+
+    return count;
+}
+
+
+/*
+ * The SoundFont and presets of a synth, forwarding to the shared ones
+ */
+
+static const char *shared_preset_get_name(fluid_preset_t *preset)
+{
+    return fluid_preset_get_name(fluid_preset_get_data(preset));
+}
+
+static int shared_preset_get_banknum(fluid_preset_t *preset)
+{
+    return fluid_preset_get_banknum(fluid_preset_get_data(preset));
+}
+
+static int shared_preset_get_num(fluid_preset_t *preset)
+{
+    return fluid_preset_get_num(fluid_preset_get_data(preset));
+}
+
+static int shared_preset_noteon(fluid_preset_t *preset, fluid_synth_t *synth, int chan, int key, int vel)
+{
+    fluid_preset_t *shared = fluid_preset_get_data(preset);
+
+    return fluid_preset_noteon(shared, synth, chan, key, vel);
+}
+
+static int shared_preset_notify(fluid_preset_t *preset, int reason, int chan)
+{
+    fluid_preset_t *shared = fluid_preset_get_data(preset);
+
+    return fluid_preset_notify(shared, reason, chan);
+}
+
+static const char *shared_sfont_get_name(fluid_sfont_t *sfont)
+{
+    fluid_shared_sfont_t *shared = fluid_sfont_get_data(sfont);
+
+    return fluid_sfont_get_name(shared->entry->sfont);
+}
+
+static fluid_preset_t *shared_sfont_get_preset(fluid_sfont_t *sfont, int bank, int prenum)
+{
+    fluid_shared_sfont_t *shared = fluid_sfont_get_data(sfont);
+    fluid_preset_t *preset;
+    fluid_list_t *list;
+
+    preset = fluid_sfont_get_preset(shared->entry->sfont, bank, prenum);
+
+    if(preset == NULL)
+    {
+        return NULL;
+    }
+
+    for(list = shared->preset; list != NULL; list = fluid_list_next(list))
+    {
+        if(fluid_preset_get_data(fluid_list_get(list)) == preset)
+        {
+            return fluid_list_get(list);
+        }
+    }
+
+    return NULL;
+}
+
+static void shared_sfont_iteration_start(fluid_sfont_t *sfont)
+{
+    fluid_shared_sfont_t *shared = fluid_sfont_get_data(sfont);
+
+    shared->preset_iter_cur = shared->preset;
+}
+
+static fluid_preset_t *shared_sfont_iteration_next(fluid_sfont_t *sfont)
+{
+    fluid_shared_sfont_t *shared = fluid_sfont_get_data(sfont);
+    fluid_preset_t *preset;
+
+    if(shared->preset_iter_cur == NULL)
+    {
+        return NULL;
+    }
+
+    preset = fluid_list_get(shared->preset_iter_cur);
+    shared->preset_iter_cur = fluid_list_next(shared->preset_iter_cur);
+
+    return preset;
+}
+
+static int shared_sfont_free(fluid_sfont_t *sfont)
+{
+    fluid_shared_sfont_t *shared = fluid_sfont_get_data(sfont);
+    fluid_list_t *list;
+
+    if(shared->entry != NULL)
+    {
+        shared->unloading = sfregistry_release(shared->entry);
+        shared->entry = NULL;
+    }
+
+    /* the last synth to release the SoundFont deletes it, which the voices of any synth may
+     * still block, the synth will try again later */
+    if(shared->unloading != NULL)
+    {
+        if(fluid_sfont_delete_internal(shared->unloading) != 0)
+        {
+            return -1;
+        }
+
+        shared->unloading = NULL;
+    }
+
+    for(list = shared->preset; list != NULL; list = fluid_list_next(list))
+    {
+        delete_fluid_preset(fluid_list_get(list));
+    }
+
+    delete_fluid_list(shared->preset);
+    FLUID_FREE(shared);
+    delete_fluid_sfont(sfont);
+
+    return 0;
+}
+
+/* Creates the SoundFont of a synth attaching to an entry. Call with the registry mutex held. */
+static fluid_sfont_t *
+new_shared_sfont(fluid_sfregistry_entry_t *entry)
+{
+    fluid_shared_sfont_t *shared;
+    fluid_sfont_t *sfont;
+    fluid_preset_t *preset, *shared_preset;
+    fluid_mod_t *mods = NULL;
+    int nmods;
+
+    shared = FLUID_NEW(fluid_shared_sfont_t);
+    sfont = new_fluid_sfont_local(shared_sfont_get_name, shared_sfont_get_preset,
+                                  shared_sfont_iteration_start, shared_sfont_iteration_next,
+                                  shared_sfont_free);
+
+    if(shared == NULL || sfont == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(shared);
+        delete_fluid_sfont(sfont);
+        return NULL;
+    }
+
+    FLUID_MEMSET(shared, 0, sizeof(*shared));
+    fluid_sfont_set_data(sfont, shared);
+
+    /* nobody else iterates the shared SoundFont, all synths iterate their own presets */
+    fluid_sfont_iteration_start(entry->sfont);
+
+    while((shared_preset = fluid_sfont_iteration_next(entry->sfont)) != NULL)
+    {
+        preset = new_fluid_preset(sfont, shared_preset_get_name, shared_preset_get_banknum,
+                                  shared_preset_get_num, shared_preset_noteon, delete_fluid_preset);
+
+        if(preset == NULL)
+        {
+            goto error_recovery;
+        }
+
+        fluid_preset_set_data(preset, shared_preset);
+
+        if(shared_preset->notify != NULL)
+        {
+            preset->notify = shared_preset_notify;
+        }
+
+        shared->preset = fluid_list_append(shared->preset, preset);
+    }
+
+    nmods = fluid_sfont_get_default_mod(entry->sfont, &mods);
+
+    if(nmods == FLUID_FAILED || fluid_sfont_set_default_mod(sfont, mods, nmods) != FLUID_OK)
+    {
+        FLUID_FREE(mods);
+        goto error_recovery;
+    }
+
+    FLUID_FREE(mods);
+
+    shared->entry = entry;
+    entry->num_references++;
+
+    return sfont;
+
+error_recovery:
+    /* nothing attached yet, nothing to release */
+    shared->entry = NULL;
+    shared_sfont_free(sfont);
+    return NULL;
+}
@@ -0,0 +1,40 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FLUID_SFREGISTRY_H
+#define _FLUID_SFREGISTRY_H
+
+#include "fluid_sfont.h"
+#include "fluid_list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+fluid_sfont_t *fluid_sfregistry_load(fluid_settings_t *settings, fluid_list_t *loaders, const char *filename);
+
+/* Only used for tests */
+int fluid_sfregistry_count_entries(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_SFREGISTRY_H */
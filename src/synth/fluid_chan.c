@@ -55,6 +55,8 @@ new_fluid_channel(fluid_synth_t *synth, int num)
     chan->channum = num;
     chan->preset = NULL;
     chan->tuning = NULL;
+    chan->polyphony = 0;
+    chan->cost_budget = 0;
 
     fluid_channel_init(chan);
     fluid_channel_init_ctrl(chan, 0);
@@ -69,6 +71,9 @@ fluid_channel_init(fluid_channel_t *chan)
     int i, prognum, banknum;
 
     chan->sostenuto_orderid = 0;
+    FLUID_MEMSET(chan->modulate_pending, 0, sizeof(chan->modulate_pending));
+    chan->modulate_pending_all = FALSE;
+    chan->modulate_stamp = 0;
     /*--- Init poly/mono modes variables --------------------------------------*/
     chan->mode = 0;
     chan->mode_val = 0;
@@ -90,6 +95,7 @@ fluid_channel_init(fluid_channel_t *chan)
     /*--- End of poly/mono initialization --------------------------------------*/
 
     chan->channel_type = (chan->channum == 9) ? CHANNEL_TYPE_DRUM : CHANNEL_TYPE_MELODIC;
+    fluid_synth_invalidate_overflow_prio_LOCAL(chan->synth);
     prognum = 0;
     banknum = (chan->channel_type == CHANNEL_TYPE_DRUM) ? DRUM_INST_BANK : 0;
 
@@ -285,6 +291,43 @@ fluid_channel_set_sfont_bank_prog(fluid_channel_t *chan, int sfontnum,
     chan->sfont_bank_prog = newval;
 }
 
+/*
+ * Returns the bank a channel selects after the bank select controller ctrl (BANK_SELECT_MSB
+ * or BANK_SELECT_LSB) with the given value, starting from bank, in the given bank select
+ * style. Like fluid_channel_set_bank_msb() and fluid_channel_set_bank_lsb(), without a channel:
+ * *type is the type of the channel, switched by the bank MSB of the XG style.
+ */
+int
+fluid_channel_select_bank(int style, enum fluid_midi_channel_type *type, int bank, int ctrl, int value)
+{
+    if(ctrl == BANK_SELECT_LSB)
+    {
+        if(style == FLUID_BANK_STYLE_GM || style == FLUID_BANK_STYLE_GS
+                || (style == FLUID_BANK_STYLE_XG && *type == CHANNEL_TYPE_DRUM))
+        {
+            return bank;
+        }
+
+        return (style == FLUID_BANK_STYLE_XG) ? value : (bank & ~0x7F) | value;
+    }
+
+    switch(style)
+    {
+    case FLUID_BANK_STYLE_XG:
+        *type = (120 == value || 126 == value || 127 == value) ? CHANNEL_TYPE_DRUM : CHANNEL_TYPE_MELODIC;
+        return (*type == CHANNEL_TYPE_DRUM) ? DRUM_INST_BANK : bank;
+
+    case FLUID_BANK_STYLE_GM:
+        return bank;
+
+    case FLUID_BANK_STYLE_GS:
+        return (*type == CHANNEL_TYPE_DRUM) ? value + DRUM_INST_BANK : value;
+
+    default: /* FLUID_BANK_STYLE_MMA */
+        return (bank & 0x7F) | (value << 7);
+    }
+}
+
 /* Set bank LSB 7 bits */
 void
 fluid_channel_set_bank_lsb(fluid_channel_t *chan, int banklsb)
@@ -321,6 +364,7 @@ void
 fluid_channel_set_bank_msb(fluid_channel_t *chan, int bankmsb)
 {
     int oldval, newval, style;
+    enum fluid_midi_channel_type type;
 
     style = chan->synth->bank_select;
     oldval = chan->sfont_bank_prog;
@@ -330,7 +374,14 @@ fluid_channel_set_bank_msb(fluid_channel_t *chan, int bankmsb)
         /* XG bank, do drum-channel auto-switch */
         /* The number "120" was based on several keyboards having drums at 120 - 127,
            reference: https://lists.nongnu.org/archive/html/fluid-dev/2011-02/msg00003.html */
-        chan->channel_type = (120 == bankmsb || 126 == bankmsb || 127 == bankmsb) ? CHANNEL_TYPE_DRUM : CHANNEL_TYPE_MELODIC;
+        type = (120 == bankmsb || 126 == bankmsb || 127 == bankmsb) ? CHANNEL_TYPE_DRUM : CHANNEL_TYPE_MELODIC;
+
+        if(chan->channel_type != type)
+        {
+            chan->channel_type = type;
+            fluid_synth_invalidate_overflow_prio_LOCAL(chan->synth);
+        }
+
         if(chan->channel_type == CHANNEL_TYPE_MELODIC)
         {
             // bankMSB is ignored for meldodic channels
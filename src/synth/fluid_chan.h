@@ -108,6 +108,11 @@ struct _fluid_channel_t
     enum fluid_midi_channel_type channel_type;
     enum fluid_interp interp_method;                    /**< Interpolation method (enum fluid_interp) */
 
+    /* Limits of the playing voices, see fluid_synth_set_channel_polyphony(). Not MIDI state,
+     * so they are kept across resets. */
+    int polyphony;                        /**< Maximum number of voices, 0 for no limit */
+    int cost_budget;                      /**< Maximum summed cost of the voices in the units of fluid_rvoice_interp_cost(), 0 for no limit */
+
     unsigned char channel_pressure;                 /**< MIDI channel pressure from [0;127] */
     float pitch_wheel_sensitivity;          /**< Current pitch wheel sensitivity */
     short pitch_bend;                      /**< Current pitch bend value */
@@ -117,6 +122,11 @@ struct _fluid_channel_t
      */
     unsigned int  sostenuto_orderid;
 
+    /* Controller changes not applied to the voices yet, see fluid_synth_modulate_voices_LOCAL() */
+    uint32_t modulate_pending[8];         /**< Bit n is CC n, bit 128 + n general controller n */
+    char modulate_pending_all;            /**< All controllers have changed */
+    unsigned int modulate_stamp;          /**< Value of the synth's modulate_stamp at the latest change */
+
     int tuning_bank;                      /**< Current tuning bank number */
     int tuning_prog;                      /**< Current tuning program number */
     fluid_tuning_t *tuning;               /**< Micro tuning */
@@ -151,6 +161,7 @@ void fluid_channel_set_sfont_bank_prog(fluid_channel_t *chan, int sfont,
                                        int bank, int prog);
 void fluid_channel_set_bank_lsb(fluid_channel_t *chan, int banklsb);
 void fluid_channel_set_bank_msb(fluid_channel_t *chan, int bankmsb);
+int fluid_channel_select_bank(int style, enum fluid_midi_channel_type *type, int bank, int ctrl, int value);
 void fluid_channel_get_sfont_bank_prog(fluid_channel_t *chan, int *sfont,
                                        int *bank, int *prog);
 fluid_real_t fluid_channel_get_key_pitch(fluid_channel_t *chan, int key);
@@ -180,7 +191,7 @@ fluid_real_t fluid_channel_get_key_pitch(fluid_channel_t *chan, int key);
 #define fluid_channel_set_interp_method(chan, new_method) \
   ((chan)->interp_method = (new_method))
 #define fluid_channel_get_interp_method(chan) \
-  ((chan)->interp_method);
+  ((chan)->interp_method)
 #define fluid_channel_set_tuning(_c, _t)        { (_c)->tuning = _t; }
 #define fluid_channel_has_tuning(_c)            ((_c)->tuning != NULL)
 #define fluid_channel_get_tuning(_c)            ((_c)->tuning)
@@ -30,6 +30,7 @@
 #include "fluid_event.h"
 #include "fluidsynth_priv.h"
 #include "fluid_midi.h"
+#include "fluid_object_cache.h"
 
 /***************************************************************
  *
@@ -47,24 +48,34 @@ fluid_event_clear(fluid_event_t *evt)
     evt->dest = -1;
     evt->src = -1;
     evt->type = -1;
-    evt->id = -1;
 }
 
+/* Sequencer events deleted by the application, reused by new_fluid_event() */
+static fluid_object_cache_t fluid_event_cache = FLUID_OBJECT_CACHE_INIT;
+
 /**
  * Create a new sequencer event structure.
  * @return New sequencer event structure or NULL if out of memory
+ *
+ * Deleted events are kept in a small lock-free cache shared by all threads and handed out
+ * again, so creating and deleting events at a high rate doesn't stress the memory allocator.
  */
 fluid_event_t *
 new_fluid_event(void)
 {
     fluid_event_t *evt;
 
-    evt = FLUID_NEW(fluid_event_t);
+    evt = fluid_object_cache_take(&fluid_event_cache);
 
     if(evt == NULL)
     {
-        FLUID_LOG(FLUID_PANIC, "event: Out of memory\n");
-        return NULL;
+        evt = FLUID_NEW(fluid_event_t);
+
+        if(evt == NULL)
+        {
+            FLUID_LOG(FLUID_PANIC, "event: Out of memory\n");
+            return NULL;
+        }
     }
 
     fluid_event_clear(evt);
@@ -81,7 +92,10 @@ delete_fluid_event(fluid_event_t *evt)
 {
     fluid_return_if_fail(evt != NULL);
 
-    FLUID_FREE(evt);
+    if(!fluid_object_cache_put(&fluid_event_cache, evt))
+    {
+        FLUID_FREE(evt);
+    }
 }
 
 /**
@@ -96,10 +110,11 @@ fluid_event_set_time(fluid_event_t *evt, unsigned int time)
     evt->time = time;
 }
 
+/* Only for note events, their id is kept in the value field */
 void
 fluid_event_set_id(fluid_event_t *evt, fluid_note_id_t id)
 {
-    evt->id = id;
+    evt->value = id;
 }
 
 /**
@@ -133,7 +148,7 @@ void
 fluid_event_timer(fluid_event_t *evt, void *data)
 {
     evt->type = FLUID_SEQ_TIMER;
-    evt->data = data;
+    evt->u.data = data;
 }
 
 /**
@@ -157,7 +172,8 @@ fluid_event_noteon(fluid_event_t *evt, int channel, short key, short vel)
     evt->type = FLUID_SEQ_NOTEON;
     evt->channel = channel;
     evt->key = key;
-    evt->vel = vel;
+    evt->control = vel;
+    evt->value = -1;
 }
 
 /**
@@ -172,6 +188,7 @@ fluid_event_noteoff(fluid_event_t *evt, int channel, short key)
     evt->type = FLUID_SEQ_NOTEOFF;
     evt->channel = channel;
     evt->key = key;
+    evt->value = -1;
 }
 
 /**
@@ -196,8 +213,9 @@ fluid_event_note(fluid_event_t *evt, int channel, short key, short vel, unsigned
     evt->type = FLUID_SEQ_NOTE;
     evt->channel = channel;
     evt->key = key;
-    evt->vel = vel;
-    evt->duration = duration;
+    evt->control = vel;
+    evt->value = -1;
+    evt->u.duration = duration;
 }
 
 /**
@@ -266,7 +284,7 @@ fluid_event_program_select(fluid_event_t *evt, int channel,
 {
     evt->type = FLUID_SEQ_PROGRAMSELECT;
     evt->channel = channel;
-    evt->duration = sfont_id;
+    evt->u.duration = sfont_id;
     evt->value = preset_num;
     evt->control = bank_num;
 }
@@ -293,7 +311,7 @@ fluid_event_pitch_bend(fluid_event_t *evt, int channel, int pitch)
         pitch = 16383;
     }
 
-    evt->pitch = pitch;
+    evt->value = pitch;
 }
 
 /**
@@ -499,7 +517,7 @@ void
 fluid_event_scale(fluid_event_t *evt, double new_scale)
 {
     evt->type = FLUID_SEQ_SCALE;
-    evt->scale = new_scale;
+    evt->u.scale = new_scale;
 }
 
 /**
@@ -664,6 +682,13 @@ int fluid_event_from_midi_event(fluid_event_t *evt, const fluid_midi_event_t *ev
  * Accessing event data
  */
 
+/* Note events keep their velocity in control and their note id in value */
+static FLUID_INLINE int
+fluid_event_is_note(const fluid_event_t *evt)
+{
+    return evt->type == FLUID_SEQ_NOTEON || evt->type == FLUID_SEQ_NOTEOFF || evt->type == FLUID_SEQ_NOTE;
+}
+
 /**
  * Get the event type (#fluid_seq_event_type) field from a sequencer event structure.
  * @param evt Sequencer event structure
@@ -693,7 +718,7 @@ unsigned int fluid_event_get_time(fluid_event_t *evt)
  */
 fluid_note_id_t fluid_event_get_id(fluid_event_t *evt)
 {
-    return evt->id;
+    return fluid_event_is_note(evt) ? evt->value : -1;
 }
 
 /**
@@ -744,7 +769,7 @@ short fluid_event_get_key(fluid_event_t *evt)
 short fluid_event_get_velocity(fluid_event_t *evt)
 
 {
-    return evt->vel;
+    return fluid_event_is_note(evt) ? evt->control : 0;
 }
 
 /**
@@ -754,7 +779,7 @@ short fluid_event_get_velocity(fluid_event_t *evt)
  */
 short fluid_event_get_control(fluid_event_t *evt)
 {
-    return evt->control;
+    return fluid_event_is_note(evt) ? 0 : evt->control;
 }
 
 /**
@@ -770,7 +795,7 @@ short fluid_event_get_control(fluid_event_t *evt)
  */
 int fluid_event_get_value(fluid_event_t *evt)
 {
-    return evt->value;
+    return (fluid_event_is_note(evt) || evt->type == FLUID_SEQ_PITCHBEND) ? 0 : evt->value;
 }
 
 /**
@@ -782,7 +807,7 @@ int fluid_event_get_value(fluid_event_t *evt)
  */
 void *fluid_event_get_data(fluid_event_t *evt)
 {
-    return evt->data;
+    return (evt->type == FLUID_SEQ_TIMER) ? evt->u.data : NULL;
 }
 
 /**
@@ -794,7 +819,7 @@ void *fluid_event_get_data(fluid_event_t *evt)
  */
 unsigned int fluid_event_get_duration(fluid_event_t *evt)
 {
-    return evt->duration;
+    return (evt->type == FLUID_SEQ_NOTE || evt->type == FLUID_SEQ_PROGRAMSELECT) ? evt->u.duration : 0;
 }
 
 /**
@@ -807,7 +832,7 @@ unsigned int fluid_event_get_duration(fluid_event_t *evt)
  */
 short fluid_event_get_bank(fluid_event_t *evt)
 {
-    return evt->control;
+    return fluid_event_is_note(evt) ? 0 : evt->control;
 }
 
 /**
@@ -819,7 +844,7 @@ short fluid_event_get_bank(fluid_event_t *evt)
  */
 int fluid_event_get_pitch(fluid_event_t *evt)
 {
-    return evt->pitch;
+    return (evt->type == FLUID_SEQ_PITCHBEND) ? evt->value : 0;
 }
 
 /**
@@ -833,7 +858,7 @@ int fluid_event_get_pitch(fluid_event_t *evt)
 int
 fluid_event_get_program(fluid_event_t *evt)
 {
-    return evt->value;
+    return fluid_event_get_value(evt);
 }
 
 /**
@@ -846,7 +871,7 @@ fluid_event_get_program(fluid_event_t *evt)
 unsigned int
 fluid_event_get_sfont_id(fluid_event_t *evt)
 {
-    return evt->duration;
+    return fluid_event_get_duration(evt);
 }
 
 /**
@@ -858,5 +883,5 @@ fluid_event_get_sfont_id(fluid_event_t *evt)
  */
 double fluid_event_get_scale(fluid_event_t *evt)
 {
-    return evt->scale;
+    return (evt->type == FLUID_SEQ_SCALE) ? evt->u.scale : 0.0;
 }
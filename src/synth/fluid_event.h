@@ -29,24 +29,30 @@ extern "C" {
 
 typedef int fluid_note_id_t;
 
-/* Private data for event */
-/* ?? should be optimized in size, using unions */
+/* Private data for event
+ *
+ * The events are copied into the nodes of the sequencer queue, so they are kept small:
+ * the fields no event type uses at the same time share their storage. The accessors
+ * only return the fields of the type of the event, 0 for the others.
+ */
 struct _fluid_event_t
 {
     unsigned int time;
-    int type;
+    int channel;
+    int value;              /* the value of channel events, the pitch of FLUID_SEQ_PITCHBEND, the preset of
+                               FLUID_SEQ_PROGRAMSELECT and the note id of note events (see fluid_event_set_id()) */
     fluid_seq_id_t src;
     fluid_seq_id_t dest;
-    int channel;
     short key;
-    short vel;
-    short control;
-    int value;
-    fluid_note_id_t id;
-    int pitch;
-    unsigned int duration;
-    double scale;
-    void *data;
+    short control;          /* the controller or bank, the velocity of note events */
+    signed char type;
+
+    union
+    {
+        unsigned int duration;  /* FLUID_SEQ_NOTE, the SoundFont id of FLUID_SEQ_PROGRAMSELECT */
+        double scale;           /* FLUID_SEQ_SCALE */
+        void *data;             /* FLUID_SEQ_TIMER */
+    } u;
 };
 
 unsigned int fluid_event_get_time(fluid_event_t *evt);
@@ -0,0 +1,277 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_overflow_tree.h"
+
+struct _fluid_overflow_tree_t
+{
+    int count;                /* number of voices */
+    int size;                 /* number of leaves, the smallest power of two >= count */
+
+    /* Per node, the root is node 1, the leaf of voice i is node size + i */
+    float *prio;              /* lowest priority below the node */
+    unsigned int *start_time; /* oldest start time below the node */
+};
+
+/* State of fluid_overflow_tree_find_kill() */
+typedef struct
+{
+    const fluid_overflow_tree_t *tree;
+    fluid_voice_t **voices;
+    fluid_overflow_prio_t *score;
+    fluid_real_t output_rate;
+    unsigned int ticks;
+
+    float best_prio;
+    int best_index;
+} fluid_overflow_search_t;
+
+/* Returns TRUE if a voice started at tick a is older than one started at tick b */
+static FLUID_INLINE int
+fluid_overflow_tree_is_older(unsigned int a, unsigned int b)
+{
+    /* works across a wrap around of the tick counter */
+    return (int)(a - b) < 0;
+}
+
+fluid_overflow_tree_t *
+new_fluid_overflow_tree(int count)
+{
+    fluid_overflow_tree_t *tree;
+    int i;
+
+    fluid_return_val_if_fail(count > 0, NULL);
+
+    tree = FLUID_NEW(fluid_overflow_tree_t);
+
+    if(tree == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    tree->count = count;
+    tree->size = 1;
+
+    while(tree->size < count)
+    {
+        tree->size *= 2;
+    }
+
+    tree->prio = FLUID_ARRAY(float, 2 * tree->size);
+    tree->start_time = FLUID_ARRAY(unsigned int, 2 * tree->size);
+
+    if(tree->prio == NULL || tree->start_time == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        delete_fluid_overflow_tree(tree);
+        return NULL;
+    }
+
+    /* leaves without a voice are never selected */
+    for(i = 0; i < 2 * tree->size; i++)
+    {
+        tree->prio[i] = OVERFLOW_PRIO_CANNOT_KILL;
+        tree->start_time[i] = 0;
+    }
+
+    return tree;
+}
+
+void
+delete_fluid_overflow_tree(fluid_overflow_tree_t *tree)
+{
+    fluid_return_if_fail(tree != NULL);
+
+    FLUID_FREE(tree->prio);
+    FLUID_FREE(tree->start_time);
+    FLUID_FREE(tree);
+}
+
+/*
+ * Returns the memory used by the tree in bytes.
+ */
+size_t
+fluid_overflow_tree_get_memory(const fluid_overflow_tree_t *tree)
+{
+    return sizeof(*tree) + 2 * tree->size * (sizeof(*tree->prio) + sizeof(*tree->start_time));
+}
+
+/*
+ * Updates the priority and start time of the voice at the given index.
+ */
+void
+fluid_overflow_tree_set(fluid_overflow_tree_t *tree, int index, float prio, unsigned int start_time)
+{
+    int node = tree->size + index;
+
+    fluid_return_if_fail(index >= 0 && index < tree->count);
+
+    tree->prio[node] = prio;
+    tree->start_time[node] = start_time;
+
+    for(node /= 2; node >= 1; node /= 2)
+    {
+        int left = 2 * node;
+        int right = left + 1;
+
+        tree->prio[node] = (tree->prio[right] < tree->prio[left]) ? tree->prio[right] : tree->prio[left];
+
+        /* the start times of voices which cannot be killed would only weaken the bounds of the search */
+        if(tree->prio[left] >= (float)OVERFLOW_PRIO_CANNOT_KILL
+                || (tree->prio[right] < (float)OVERFLOW_PRIO_CANNOT_KILL
+                    && fluid_overflow_tree_is_older(tree->start_time[right], tree->start_time[left])))
+        {
+            tree->start_time[node] = tree->start_time[right];
+        }
+        else
+        {
+            tree->start_time[node] = tree->start_time[left];
+        }
+    }
+}
+
+/*
+ * Returns the lowest index of all available voices, or -1 if there is none.
+ */
+int
+fluid_overflow_tree_find_available(const fluid_overflow_tree_t *tree)
+{
+    int node = 1;
+
+    if(tree->prio[node] != (float)FLUID_OVERFLOW_PRIO_AVAILABLE)
+    {
+        return -1;
+    }
+
+    while(node < tree->size)
+    {
+        node *= 2;
+
+        if(tree->prio[node] != (float)FLUID_OVERFLOW_PRIO_AVAILABLE)
+        {
+            node++;
+        }
+    }
+
+    return node - tree->size;
+}
+
+/*
+ * The lowest priority fluid_voice_get_overflow_prio() can return for any voice below
+ * the given node: the lowest base priority plus the age score of the oldest voice.
+ */
+static float
+fluid_overflow_tree_get_bound(const fluid_overflow_search_t *search, int node)
+{
+    float bound = search->tree->prio[node];
+
+    if(search->score->age > 0)
+    {
+        bound += fluid_voice_get_overflow_age_prio(search->score, search->output_rate,
+                 search->ticks - search->tree->start_time[node]);
+    }
+    else if(search->score->age < 0)
+    {
+        /* negative age scores are the strongest for the youngest voices */
+        bound += fluid_voice_get_overflow_age_prio(search->score, search->output_rate, 1);
+    }
+
+    return bound;
+}
+
+static void
+fluid_overflow_tree_search(fluid_overflow_search_t *search, int node, float bound)
+{
+    const fluid_overflow_tree_t *tree = search->tree;
+
+    /* Nothing below this node can beat the best voice found so far. On equal
+     * priorities the voice with the lower index wins, so equal bounds are searched. */
+    if(bound > search->best_prio)
+    {
+        return;
+    }
+
+    if(node >= tree->size)
+    {
+        int index = node - tree->size;
+        float prio;
+
+        if(index >= tree->count)
+        {
+            return;
+        }
+
+        prio = fluid_voice_get_overflow_prio(search->voices[index], search->score, search->ticks);
+
+        if(prio < search->best_prio || (prio == search->best_prio && index < search->best_index))
+        {
+            search->best_prio = prio;
+            search->best_index = index;
+        }
+    }
+    else
+    {
+        int left = 2 * node;
+        int right = left + 1;
+        float left_bound = fluid_overflow_tree_get_bound(search, left);
+        float right_bound = fluid_overflow_tree_get_bound(search, right);
+
+        /* descend into the more promising subtree first, so that the other one is likely to be pruned */
+        if(right_bound < left_bound)
+        {
+            fluid_overflow_tree_search(search, right, right_bound);
+            fluid_overflow_tree_search(search, left, left_bound);
+        }
+        else
+        {
+            fluid_overflow_tree_search(search, left, left_bound);
+            fluid_overflow_tree_search(search, right, right_bound);
+        }
+    }
+}
+
+/*
+ * Returns the index of the voice with the lowest overflow priority, or -1 if no voice
+ * can be killed. The result is the same as comparing fluid_voice_get_overflow_prio()
+ * of all voices, including the preference of lower indices on equal priorities.
+ *
+ * @param voices The voices of the tree, indexed like the leaves
+ * @param output_rate The output rate of all voices
+ * @param ticks The current time of the synth
+ */
+int
+fluid_overflow_tree_find_kill(const fluid_overflow_tree_t *tree, fluid_voice_t **voices,
+                              fluid_overflow_prio_t *score, fluid_real_t output_rate,
+                              unsigned int ticks)
+{
+    fluid_overflow_search_t search;
+
+    search.tree = tree;
+    search.voices = voices;
+    search.score = score;
+    search.output_rate = output_rate;
+    search.ticks = ticks;
+    search.best_prio = OVERFLOW_PRIO_CANNOT_KILL - 1;
+    search.best_index = -1;
+
+    fluid_overflow_tree_search(&search, 1, fluid_overflow_tree_get_bound(&search, 1));
+
+    return search.best_index;
+}
@@ -0,0 +1,57 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _FLUID_OVERFLOW_TREE_H
+#define _FLUID_OVERFLOW_TREE_H
+
+#include "fluid_sys.h"
+#include "fluid_voice.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A tournament tree over the voices of a synth, ordered by their position in the voice
+ * array. Every leaf holds the age independent overflow priority of a voice (see
+ * fluid_voice_get_overflow_base_prio()) and its start time, every inner node the lowest
+ * priority and the oldest start time found below it. This allows to find the first
+ * available voice and the voice to kill without looking at every voice.
+ */
+typedef struct _fluid_overflow_tree_t fluid_overflow_tree_t;
+
+/* Leaf priority of voices that can be allocated right away, lower than any other priority */
+#define FLUID_OVERFLOW_PRIO_AVAILABLE (-OVERFLOW_PRIO_CANNOT_KILL)
+
+fluid_overflow_tree_t *new_fluid_overflow_tree(int count);
+void delete_fluid_overflow_tree(fluid_overflow_tree_t *tree);
+size_t fluid_overflow_tree_get_memory(const fluid_overflow_tree_t *tree);
+
+void fluid_overflow_tree_set(fluid_overflow_tree_t *tree, int index, float prio, unsigned int start_time);
+int fluid_overflow_tree_find_available(const fluid_overflow_tree_t *tree);
+int fluid_overflow_tree_find_kill(const fluid_overflow_tree_t *tree, fluid_voice_t **voices,
+                                  fluid_overflow_prio_t *score, fluid_real_t output_rate,
+                                  unsigned int ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_OVERFLOW_TREE_H */
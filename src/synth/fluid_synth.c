@@ -25,6 +25,7 @@
 #include "fluid_settings.h"
 #include "fluid_sfont.h"
 #include "fluid_defsfont.h"
+#include "fluid_sfregistry.h"
 #include "fluid_dls.h"
 #include "fluid_instpatch.h"
 #include "fluid_audio_convert.h"
@@ -37,6 +38,20 @@
 extern int feenableexcept(int excepts);
 #endif
 
+/* A warm-up running in a background thread, see fluid_synth_warm_preset() */
+typedef struct
+{
+    fluid_thread_t *thread;
+    fluid_sfont_t *sfont;               /* the SoundFont of the presets, not unloaded before they are warm */
+    fluid_list_t *presets;              /* the presets to warm up */
+    int sfont_id;
+    int bank_num;
+    int preset_num;
+    fluid_warm_callback_t callback;
+    void *data;
+    fluid_atomic_int_t done;            /* set by the thread once it has called the callback */
+} fluid_synth_warmup_t;
+
 #define FLUID_API_RETURN(return_value) \
   do { fluid_synth_api_exit(synth); \
   return return_value; } while (0)
@@ -56,15 +71,52 @@ extern int feenableexcept(int excepts);
   if (chan >= synth->midi_channels) { \
     FLUID_API_RETURN(fail_value); \
   } \
+  if (synth->channel[chan] == NULL && fluid_synth_create_channel_LOCAL(synth, chan) != FLUID_OK) { \
+    FLUID_API_RETURN(fail_value); \
+  } \
+
+/* Queues the call instead of entering the API if synth.api-queue is enabled. Falls through
+ * to the locking path if the queue is full, which applies the queued calls first, or if
+ * the channel has yet to be created with synth.sparse-channels. */
+#define FLUID_API_QUEUE_CHAN(type, param1, param2) \
+  FLUID_API_QUEUE_CHAN_INGRESS(type, param1, param2, 0)
+
+#define FLUID_API_QUEUE_CHAN_INGRESS(type, param1, param2, ingress) \
+  fluid_return_val_if_fail (synth != NULL, FLUID_FAILED); \
+  fluid_return_val_if_fail (chan >= 0, FLUID_FAILED); \
+  if (synth->api_queue != NULL) { \
+    if (chan >= synth->midi_channels) { \
+      return FLUID_FAILED; \
+    } \
+    if (fluid_atomic_pointer_get(&synth->channel[chan]) != NULL \
+        && fluid_synth_queue_api_call(synth, type, chan, param1, param2, ingress)) { \
+      return FLUID_OK; \
+    } \
+  }
 
 static void fluid_synth_init(void);
 static void fluid_synth_api_enter(fluid_synth_t *synth);
+static int fluid_synth_api_try_enter(fluid_synth_t *synth);
 static void fluid_synth_api_exit(fluid_synth_t *synth);
-
+static void fluid_synth_notify_released_samples_LOCAL(fluid_synth_t *synth);
+static int fluid_synth_init_api_queue(fluid_synth_t *synth, int size);
+static int fluid_synth_queue_api_call(fluid_synth_t *synth, enum fluid_synth_call type, int chan, int param1, int param2,
+                                      unsigned int ingress);
+static void fluid_synth_process_api_queue_LOCAL(fluid_synth_t *synth, int wait);
+static void fluid_synth_process_api_queue(fluid_synth_t *synth);
+
+static int fluid_synth_noteon_ingress(fluid_synth_t *synth, int chan, int key, int vel,
+                                      unsigned int ingress);
+static void fluid_synth_queue_note_latency_LOCAL(fluid_synth_t *synth);
 static int fluid_synth_noteon_LOCAL(fluid_synth_t *synth, int chan, int key,
                                     int vel);
 static int fluid_synth_noteoff_LOCAL(fluid_synth_t *synth, int chan, int key);
 static int fluid_synth_cc_LOCAL(fluid_synth_t *synth, int channum, int num);
+static int fluid_synth_noteon_enabled_LOCAL(fluid_synth_t *synth, int chan, int key, int vel);
+static int fluid_synth_noteoff_enabled_LOCAL(fluid_synth_t *synth, int chan, int key);
+static int fluid_synth_cc_global_LOCAL(fluid_synth_t *synth, int chan, int num, int val);
+static int fluid_synth_pitch_bend_LOCAL(fluid_synth_t *synth, int chan, int val);
+static int fluid_synth_program_change_LOCAL(fluid_synth_t *synth, int chan, int prognum);
 static int fluid_synth_sysex_midi_tuning(fluid_synth_t *synth, const char *data,
         int len, char *response,
         int *response_len, int avail_response,
@@ -102,13 +154,18 @@ fluid_synth_get_preset_by_sfont_name(fluid_synth_t *synth, const char *sfontname
                                      int banknum, int prognum);
 
 static void fluid_synth_update_presets(fluid_synth_t *synth);
+static void fluid_synth_clear_preset_cache(fluid_synth_t *synth);
 static void fluid_synth_update_gain_LOCAL(fluid_synth_t *synth);
 static int fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony);
+static int fluid_synth_add_voices_LOCAL(fluid_synth_t *synth, int count);
 
 static fluid_voice_t *fluid_synth_free_voice_by_kill_LOCAL(fluid_synth_t *synth);
+static int fluid_synth_governor_find_kill_LOCAL(fluid_synth_t *synth, float *prio, int last);
 static void fluid_synth_kill_by_exclusive_class_LOCAL(fluid_synth_t *synth,
         fluid_voice_t *new_voice);
+static void fluid_synth_count_voice_LOCAL(fluid_synth_t *synth, int chan, enum fluid_voice_counter counter);
 static int fluid_synth_sfunload_callback(void *data, unsigned int msec);
+static void fluid_synth_join_warmups(fluid_synth_t *synth, fluid_sfont_t *sfont, int finished_only);
 static fluid_tuning_t *fluid_synth_get_tuning(fluid_synth_t *synth,
         int bank, int prog);
 static int fluid_synth_replace_tuning_LOCK(fluid_synth_t *synth,
@@ -119,13 +176,21 @@ static void fluid_synth_replace_tuning_LOCAL(fluid_synth_t *synth,
         fluid_tuning_t *new_tuning,
         int apply, int unref_new);
 static void fluid_synth_update_voice_tuning_LOCAL(fluid_synth_t *synth,
-        fluid_channel_t *channel);
+        fluid_channel_t *channel, const uint32_t *changed);
+static int fluid_synth_update_tuning_LOCAL(fluid_synth_t *synth, int bank, int prog, const char *name,
+        int len, const int *keys, const double *pitch, int apply);
 static int fluid_synth_set_tuning_LOCAL(fluid_synth_t *synth, int chan,
                                         fluid_tuning_t *tuning, int apply);
 static void fluid_synth_set_gen_LOCAL(fluid_synth_t *synth, int chan,
                                       int param, float value);
 static void fluid_synth_stop_LOCAL(fluid_synth_t *synth, unsigned int id);
 
+static int fluid_synth_render_mixer_blocks(fluid_synth_t *synth, int blockcount);
+static void fluid_synth_get_out_bufs(fluid_synth_t *synth, fluid_real_t **left, fluid_real_t **right);
+static void fluid_synth_get_out_fx_bufs(fluid_synth_t *synth, fluid_real_t **fx_left, fluid_real_t **fx_right);
+static const unsigned char *fluid_synth_get_out_live_bufs(fluid_synth_t *synth);
+static int fluid_synth_update_resampler(fluid_synth_t *synth);
+
 
 static int fluid_synth_set_important_channels(fluid_synth_t *synth, const char *channels);
 
@@ -142,8 +207,16 @@ static void fluid_synth_handle_important_channels(void *data, const char *name,
 static void fluid_synth_handle_portamento_mode(void *data, const char *name, const char *value);
 static void fluid_synth_handle_reverb_chorus_num(void *data, const char *name, double value);
 static void fluid_synth_handle_reverb_chorus_int(void *data, const char *name, int value);
+static void fluid_synth_handle_perf_stats(void *data, const char *name, int value);
+static void fluid_synth_handle_cpu_accounting(void *data, const char *name, int value);
+static void fluid_synth_handle_voice_snapshot(void *data, const char *name, int value);
+static void fluid_synth_handle_metering(void *data, const char *name, int value);
+static void fluid_synth_handle_governor_int(void *data, const char *name, int value);
+static void fluid_synth_handle_governor_num(void *data, const char *name, double value);
+static void fluid_synth_governor_limit_interp_LOCAL(fluid_synth_t *synth, int limited);
 
 
+static int fluid_synth_create_channels_LOCAL(fluid_synth_t *synth);
 static void fluid_synth_reset_basic_channel_LOCAL(fluid_synth_t *synth, int chan, int nbr_chan);
 static int fluid_synth_check_next_basic_channel(fluid_synth_t *synth, int basicchan, int mode, int val);
 static void fluid_synth_set_basic_channel_LOCAL(fluid_synth_t *synth, int basicchan, int mode, int val);
@@ -157,6 +230,9 @@ static void fluid_synth_set_basic_channel_LOCAL(fluid_synth_t *synth, int basicc
 /* fluid_atomic_int_t may be anything, so init with {0} to catch most cases */
 static fluid_atomic_int_t fluid_synth_initialized = {0};
 
+/* last generation of a list of default modulators, see fluid_synth_get_default_mods_LOCAL() */
+static fluid_atomic_int_t fluid_synth_default_mod_generation = {0};
+
 /* default modulators
  * SF2.01 page 52 ff:
  *
@@ -220,11 +296,14 @@ void fluid_synth_settings(fluid_settings_t *settings)
     fluid_settings_register_num(settings, "synth.chorus.speed", FLUID_CHORUS_DEFAULT_SPEED, 0.1, 5.0, 0);
     fluid_settings_register_num(settings, "synth.chorus.depth", FLUID_CHORUS_DEFAULT_DEPTH, 0.0, 256.0, 0);
 
+    fluid_settings_register_int(settings, "synth.huge-pages", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.async-io", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_int(settings, "synth.ladspa.active", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_int(settings, "synth.lock-memory", 1, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.low-memory", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sparse-channels", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_str(settings, "midi.portname", "", 0);
 
-#ifdef LIMITER_SUPPORT
     fluid_settings_register_int(settings, "synth.limiter.active", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_num(settings, "synth.limiter.output-limit", FLUID_LIMITER_DEFAULT_OUTPUT_LIMIT, fluid_cb2amp(240), 1.0f, 0);
     fluid_settings_register_num(settings, "synth.limiter.attack", FLUID_LIMITER_DEFAULT_ATTACK_MS, 1.0f, 250.0f, 0);
@@ -232,7 +311,7 @@ void fluid_synth_settings(fluid_settings_t *settings)
     fluid_settings_register_num(settings, "synth.limiter.release", FLUID_LIMITER_DEFAULT_RELEASE_MS, 0.0f, 250.0f, 0);
     fluid_settings_register_int(settings, "synth.limiter.smoothing-stages", FLUID_LIMITER_DEFAULT_SMOOTHING_STAGES, 1, 3, 0);
     fluid_settings_register_num(settings, "synth.limiter.link-channels", FLUID_LIMITER_DEFAULT_LINK_CHANNELS, 0.0f, 1.0f, 0);
-#endif
+    fluid_settings_register_int(settings, "synth.limiter.look-ahead", 1, 0, 1, FLUID_HINT_TOGGLED);
 
 #ifdef DEFAULT_SOUNDFONT
     fluid_settings_register_str(settings, "synth.default-soundfont", DEFAULT_SOUNDFONT, 0);
@@ -246,6 +325,7 @@ void fluid_synth_settings(fluid_settings_t *settings)
     fluid_settings_register_int(settings, "synth.effects-channels", 2, 2, 2, 0);
     fluid_settings_register_int(settings, "synth.effects-groups", 1, 1, 128, 0);
     fluid_settings_register_num(settings, "synth.sample-rate", 44100.0, 8000.0, 96000.0, 0);
+    fluid_settings_register_num(settings, "synth.render-rate", 0.0, 0.0, 96000.0, 0);
     fluid_settings_register_int(settings, "synth.device-id", 16, 0, 127, 0);
 #ifdef ENABLE_MIXER_THREADS
     fluid_settings_register_int(settings, "synth.cpu-cores", 1, 1, 256, 0);
@@ -253,9 +333,41 @@ void fluid_synth_settings(fluid_settings_t *settings)
     fluid_settings_register_int(settings, "synth.cpu-cores", 1, 1, 1, 0);
 #endif
 
+    fluid_settings_register_str(settings, "synth.cpu-affinity", "", 0);
+    fluid_settings_register_str(settings, "synth.mixer-thread-wait", "block", 0);
+    fluid_settings_add_option(settings, "synth.mixer-thread-wait", "block");
+    fluid_settings_add_option(settings, "synth.mixer-thread-wait", "hybrid");
+    fluid_settings_add_option(settings, "synth.mixer-thread-wait", "spin");
+    fluid_settings_register_int(settings, "synth.deterministic-render", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.rt-alloc-check", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.flush-denormals", 1, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.parallel-audio-groups", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.voice-locality", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.voice-cache", 0, 0, 1024, 0);
+    fluid_settings_register_int(settings, "synth.voice-cache-length", 1000, 10, 10000, 0);
+    fluid_settings_register_int(settings, "synth.perf-stats", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.cpu-accounting", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.voice-snapshot", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.metering", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.governor.active", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_num(settings, "synth.governor.target-load", 0.8, 0.1, 1.0, 0);
+    fluid_settings_register_int(settings, "synth.governor.min-polyphony", 16, 1, 65535, 0);
+    fluid_settings_register_int(settings, "synth.governor.interpolation", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.fx-pipeline", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.fx-decimation", 1, 1, 4, 0);
+    fluid_settings_register_int(settings, "synth.fx-share", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_str(settings, "synth.filter-smoothing", "sample", 0);
+    fluid_settings_add_option(settings, "synth.filter-smoothing", "sample");
+    fluid_settings_add_option(settings, "synth.filter-smoothing", "block");
+    fluid_settings_register_int(settings, "synth.float-interpolation", 0, 0, 1, FLUID_HINT_TOGGLED);
+
     fluid_settings_register_int(settings, "synth.min-note-length", 10, 0, 65535, 0);
+    fluid_settings_register_int(settings, "synth.sample-accurate-events", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.stereo-voices", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_num(settings, "synth.noise-floor", -134.0, -160.0, -60.0, 0);
 
     fluid_settings_register_int(settings, "synth.threadsafe-api", FLUID_THREAD_SAFE_CAPABLE, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.api-queue", 0, 0, 65536, 0);
 
     fluid_settings_register_num(settings, "synth.overflow.percussion", 4000, -10000, 10000, 0);
     fluid_settings_register_num(settings, "synth.overflow.sustained", -1000, -10000, 10000, 0);
@@ -272,6 +384,20 @@ void fluid_synth_settings(fluid_settings_t *settings)
     fluid_settings_add_option(settings, "synth.midi-bank-select", "mma");
 
     fluid_settings_register_int(settings, "synth.dynamic-sample-loading", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.dynamic-sample-loading-async", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.dynamic-sample-loading-budget", 0, 0, 1024 * 1024, 0);
+    fluid_settings_register_str(settings, "synth.sample-cache-dir", "", 0);
+    fluid_settings_register_int(settings, "synth.sample-dedup", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_str(settings, "synth.preset-cache-dir", "", 0);
+    fluid_settings_register_int(settings, "synth.sample-mmap", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-streaming", 0, 0, 1, FLUID_HINT_TOGGLED);
+    fluid_settings_register_int(settings, "synth.sample-streaming-preload", 32768, 1024, 16777216, 0);
+    fluid_settings_register_str(settings, "synth.sample-format", "int", 0);
+    fluid_settings_add_option(settings, "synth.sample-format", "int");
+    fluid_settings_add_option(settings, "synth.sample-format", "float");
+    fluid_settings_add_option(settings, "synth.sample-format", "compressed");
+    fluid_settings_register_int(settings, "synth.sample-mipmap-levels", 0, 0, FLUID_SAMPLE_MIP_LEVELS, 0);
+    fluid_settings_register_int(settings, "synth.shared-soundfonts", 0, 0, 1, FLUID_HINT_TOGGLED);
     fluid_settings_register_int(settings, "synth.note-cut", 0, 0, 2, 0);
 
     fluid_settings_register_str(settings, "synth.portamento-time", "auto", 0);
@@ -559,29 +685,140 @@ static FLUID_INLINE void fluid_synth_add_ticks(fluid_synth_t *synth, int val)
  */
 struct _fluid_sample_timer_t
 {
-    fluid_sample_timer_t *next; /* Single linked list of timers */
+    fluid_sample_timer_t *next; /* Single linked list of timers, see fluid_synth_t::sample_timers */
     unsigned long starttick;
     fluid_timer_callback_t callback;
     void *data;
     int isfinished;
+
+    unsigned int due;           /* tick the timer is called for, in the schedule */
+    unsigned int next_due;      /* tick the timer is called for next, set by its callback */
+    int suspended;              /* TRUE if the callback suspended the timer until woken */
+    int offset;                 /* offset of due within the block the callback is called for */
+    fluid_atomic_int_t woken;   /* set by fluid_sample_timer_wake() */
 };
 
+/*
+ * Inserts a timer into the schedule of the timers ordered by the tick they are due, after
+ * the timers due at the same tick. The insertion starts at *hint if it isn't due later than
+ * the timer, *hint is set to the timer inserted.
+ */
+static void
+fluid_sample_timer_insert(fluid_synth_t *synth, fluid_sample_timer_t *timer, fluid_sample_timer_t **hint)
+{
+    fluid_sample_timer_t **ptr = &synth->sample_timers;
+
+    if(*hint != NULL && (int)(timer->due - (*hint)->due) >= 0)
+    {
+        ptr = &(*hint)->next;
+    }
+
+    while(*ptr != NULL && (int)(timer->due - (*ptr)->due) >= 0)
+    {
+        ptr = &(*ptr)->next;
+    }
+
+    timer->next = *ptr;
+    *ptr = timer;
+    *hint = timer;
+}
+
+/*
+ * Removes a timer from a list, returns FALSE if it isn't in it
+ */
+static int
+fluid_sample_timer_unlink(fluid_sample_timer_t **list, fluid_sample_timer_t *timer)
+{
+    fluid_sample_timer_t **ptr;
+
+    for(ptr = list; *ptr != NULL; ptr = &(*ptr)->next)
+    {
+        if(*ptr == timer)
+        {
+            *ptr = timer->next;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Puts the timers woken by fluid_sample_timer_wake() back into the schedule, due now.
+ * Their callbacks are called in the order they had been scheduled or suspended in.
+ */
+static void
+fluid_sample_timer_wake_all(fluid_synth_t *synth, unsigned int ticks)
+{
+    fluid_sample_timer_t *woken = NULL, **tail = &woken, **ptr, *st, *hint = NULL;
+    int pass;
+
+    for(pass = 0; pass < 2; pass++)
+    {
+        ptr = (pass == 0) ? &synth->sample_timers : &synth->idle_sample_timers;
+
+        while((st = *ptr) != NULL)
+        {
+            if(!fluid_atomic_int_get(&st->woken))
+            {
+                ptr = &st->next;
+                continue;
+            }
+
+            *ptr = st->next;
+            *tail = st;
+            tail = &st->next;
+            st->next = NULL;
+        }
+    }
+
+    while((st = woken) != NULL)
+    {
+        woken = st->next;
+        fluid_atomic_int_set(&st->woken, FALSE);
+        st->isfinished = 0;
+        st->due = ticks;
+        fluid_sample_timer_insert(synth, st, &hint);
+    }
+}
+
 /*
  * fluid_sample_timer_process - called when synth->ticks is updated
+ *
+ * Only calls the timers due in the block starting at the current tick: when none is due,
+ * the cost of a block doesn't depend on the number of timers. A callback is called once per
+ * block by default, fluid_sample_timer_schedule() and fluid_sample_timer_suspend() defer
+ * the next call.
  */
 static void fluid_sample_timer_process(fluid_synth_t *synth)
 {
-    fluid_sample_timer_t *st;
+    fluid_sample_timer_t *due = NULL, **tail = &due, *st, *hint = NULL;
     long msec;
     int cont;
     unsigned int ticks = fluid_synth_get_ticks(synth);
 
-    for(st = synth->sample_timers; st; st = st->next)
+    if(fluid_atomic_int_get(&synth->sample_timers_woken))
     {
-        if(st->isfinished)
-        {
-            continue;
-        }
+        fluid_atomic_int_set(&synth->sample_timers_woken, FALSE);
+        fluid_sample_timer_wake_all(synth, ticks);
+    }
+
+    /* taken out of the schedule first, the callbacks may schedule their timers */
+    while((st = synth->sample_timers) != NULL && (int)(st->due - ticks) < FLUID_BUFSIZE)
+    {
+        synth->sample_timers = st->next;
+        *tail = st;
+        tail = &st->next;
+        st->next = NULL;
+    }
+
+    while((st = due) != NULL)
+    {
+        due = st->next;
+
+        st->offset = ((int)(st->due - ticks) > 0) ? (int)(st->due - ticks) : 0;
+        st->next_due = ticks + FLUID_BUFSIZE;
+        st->suspended = FALSE;
 
         msec = (long)(1000.0 * ((double)(ticks - st->starttick)) / synth->sample_rate);
         cont = (*st->callback)(st->data, msec);
@@ -590,12 +827,25 @@ static void fluid_sample_timer_process(fluid_synth_t *synth)
         {
             st->isfinished = 1;
         }
+
+        /* finished timers are only called again once reset */
+        if(st->isfinished || st->suspended)
+        {
+            st->next = synth->idle_sample_timers;
+            synth->idle_sample_timers = st;
+        }
+        else
+        {
+            st->due = st->next_due;
+            fluid_sample_timer_insert(synth, st, &hint);
+        }
     }
 }
 
 fluid_sample_timer_t *new_fluid_sample_timer(fluid_synth_t *synth, fluid_timer_callback_t callback, void *data)
 {
     fluid_sample_timer_t *result = FLUID_NEW(fluid_sample_timer_t);
+    fluid_sample_timer_t *hint = NULL;
 
     if(result == NULL)
     {
@@ -603,39 +853,136 @@ fluid_sample_timer_t *new_fluid_sample_timer(fluid_synth_t *synth, fluid_timer_c
         return NULL;
     }
 
-    fluid_sample_timer_reset(synth, result);
+    result->starttick = fluid_synth_get_ticks(synth);
+    result->isfinished = 0;
     result->data = data;
     result->callback = callback;
-    result->next = synth->sample_timers;
-    synth->sample_timers = result;
+    result->due = fluid_synth_get_ticks(synth);
+    result->suspended = FALSE;
+    result->offset = 0;
+    fluid_atomic_int_set(&result->woken, FALSE);
+
+    /* ahead of the timers due now, like the timers prepended to the list used to be */
+    if(synth->sample_timers != NULL && (int)(result->due - synth->sample_timers->due) <= 0)
+    {
+        result->next = synth->sample_timers;
+        synth->sample_timers = result;
+    }
+    else
+    {
+        fluid_sample_timer_insert(synth, result, &hint);
+    }
+
     return result;
 }
 
 void delete_fluid_sample_timer(fluid_synth_t *synth, fluid_sample_timer_t *timer)
 {
-    fluid_sample_timer_t **ptr;
     fluid_return_if_fail(synth != NULL);
     fluid_return_if_fail(timer != NULL);
 
-    ptr = &synth->sample_timers;
-
-    while(*ptr)
+    if(fluid_sample_timer_unlink(&synth->sample_timers, timer)
+            || fluid_sample_timer_unlink(&synth->idle_sample_timers, timer))
     {
-        if(*ptr == timer)
-        {
-            *ptr = timer->next;
-            FLUID_FREE(timer);
-            return;
-        }
-
-        ptr = &((*ptr)->next);
+        FLUID_FREE(timer);
     }
 }
 
+/*
+ * Restarts the count of a timer. It is called again from the next block on, even if it had
+ * finished or was suspended. May be called from any thread.
+ */
 void fluid_sample_timer_reset(fluid_synth_t *synth, fluid_sample_timer_t *timer)
 {
     timer->starttick = fluid_synth_get_ticks(synth);
-    timer->isfinished = 0;
+    fluid_sample_timer_wake(synth, timer);
+}
+
+/*
+ * Called by the callback of a timer: calls it next for the block the given tick of the
+ * synth is in, instead of the next block. fluid_sample_timer_get_offset() then returns the
+ * offset of the tick within that block.
+ */
+void fluid_sample_timer_schedule(fluid_synth_t *synth, fluid_sample_timer_t *timer, unsigned int ticks)
+{
+    if((int)(ticks - fluid_synth_get_ticks(synth)) > 0)
+    {
+        timer->next_due = ticks;
+    }
+}
+
+/*
+ * Called by the callback of a timer: doesn't call it anymore until fluid_sample_timer_wake()
+ * or fluid_sample_timer_reset(). Suspended timers cost nothing while blocks are rendered.
+ */
+void fluid_sample_timer_suspend(fluid_synth_t *synth, fluid_sample_timer_t *timer)
+{
+    timer->suspended = TRUE;
+}
+
+/*
+ * Calls a suspended or scheduled timer from the next block on. May be called from any
+ * thread, also while the callback of the timer is running.
+ */
+void fluid_sample_timer_wake(fluid_synth_t *synth, fluid_sample_timer_t *timer)
+{
+    fluid_atomic_int_set(&timer->woken, TRUE);
+    fluid_atomic_int_set(&synth->sample_timers_woken, TRUE);
+}
+
+/*
+ * Returns the offset of the tick a timer has been scheduled for within the block its callback
+ * is called for, 0 if it is called once per block.
+ */
+int fluid_sample_timer_get_offset(fluid_sample_timer_t *timer)
+{
+    return timer->offset;
+}
+
+/*
+ * Returns the number of samples rendered since the timer has been reset, the exact
+ * time of the block the callback of the timer is called for.
+ */
+unsigned int fluid_sample_timer_get_ticks(fluid_synth_t *synth, fluid_sample_timer_t *timer)
+{
+    return fluid_synth_get_ticks(synth) - (unsigned int)timer->starttick;
+}
+
+/*
+ * Called by a sample timer callback before handling MIDI events that are due at the given
+ * sample offset within the next block: with synth.sample-accurate-events, the voices they
+ * start and release begin at that offset, like those of fluid_synth_queue_midi_events().
+ * Holds the API lock until fluid_synth_end_event_offset(), so that the events of other
+ * threads aren't delayed.
+ */
+void fluid_synth_begin_event_offset(fluid_synth_t *synth, int offset)
+{
+    fluid_synth_api_enter(synth);
+
+    if(synth->sample_accurate_events && offset > 0 && offset < FLUID_BUFSIZE)
+    {
+        synth->event_offset = offset;
+    }
+}
+
+void fluid_synth_end_event_offset(fluid_synth_t *synth)
+{
+    synth->event_offset = 0;
+    fluid_synth_api_exit(synth);
+}
+
+/*
+ * Holds the API lock across several calls of the API until fluid_synth_api_release(). The
+ * lock is then taken once, and the voice updates of all the calls reach the mixer at once.
+ */
+void fluid_synth_api_hold(fluid_synth_t *synth)
+{
+    fluid_synth_api_enter(synth);
+}
+
+void fluid_synth_api_release(fluid_synth_t *synth)
+{
+    fluid_synth_api_exit(synth);
 }
 
 /***************************************************************
@@ -661,6 +1008,32 @@ static FLUID_INLINE unsigned int fluid_synth_get_min_note_length_LOCAL(fluid_syn
     return (unsigned int)(i * synth->sample_rate / 1000.0f);
 }
 
+/* Deadline scheduling of the extra render threads as given by audio.realtime-deadline:
+ * each of them gets its share of CPU time within every audio period. Returns the
+ * period in microseconds, 0 if deadline scheduling is not used. */
+static int
+fluid_synth_get_deadline(fluid_settings_t *settings, int *runtime_us)
+{
+    int share = 0, period_size = 64, period_us;
+    double sample_rate = 44100.0;
+
+    *runtime_us = 0;
+    fluid_settings_getint(settings, "audio.realtime-deadline", &share);
+
+    if(share <= 0)
+    {
+        return 0;
+    }
+
+    fluid_settings_getint(settings, "audio.period-size", &period_size);
+    fluid_settings_getnum(settings, "synth.sample-rate", &sample_rate);
+
+    period_us = (int)(period_size * 1000000.0 / sample_rate);
+    *runtime_us = period_us * share / 100;
+
+    return (*runtime_us > 0) ? period_us : 0;
+}
+
 /**
  * Create new FluidSynth instance.
  * @param settings Configuration parameters to use (used directly).
@@ -683,13 +1056,13 @@ new_fluid_synth(fluid_settings_t *settings)
     fluid_sfloader_t *loader;
     char *important_channels;
     int i, prio_level = 0;
+    int cpus[FLUID_MAX_CPU_AFFINITY], cpu_count = 0;
+    int deadline_runtime, deadline_period;
     int with_ladspa = 0;
     int with_limiter = 0;
-    double sample_rate_min, sample_rate_max;
-#ifdef LIMITER_SUPPORT
+    double sample_rate_min, sample_rate_max, render_rate, noise_floor;
     fluid_limiter_settings_t limiter_settings;
     double limiter_value;
-#endif
 
     /* initialize all the conversion tables and other stuff */
     if(fluid_atomic_int_compare_and_exchange(&fluid_synth_initialized, 0, 1))
@@ -726,9 +1099,22 @@ new_fluid_synth(fluid_settings_t *settings)
     fluid_settings_getint(settings, "synth.verbose", &synth->verbose);
 
     fluid_settings_getint(settings, "synth.polyphony", &synth->polyphony);
+    fluid_settings_getint(settings, "synth.low-memory", &synth->low_memory);
     fluid_settings_getnum(settings, "synth.sample-rate", &synth->sample_rate);
     fluid_settings_getnum_range(settings, "synth.sample-rate", &sample_rate_min, &sample_rate_max);
+    fluid_settings_getnum(settings, "synth.render-rate", &render_rate);
+
+    /* the voices are rendered at the render rate, the output is resampled to the sample rate */
+    synth->output_rate = synth->sample_rate;
+
+    if(render_rate > 0)
+    {
+        fluid_clip(render_rate, sample_rate_min, sample_rate_max);
+        synth->sample_rate = render_rate;
+    }
+
     fluid_settings_getint(settings, "synth.midi-channels", &synth->midi_channels);
+    fluid_settings_getint(settings, "synth.sparse-channels", &synth->sparse_channels);
     fluid_settings_getint(settings, "synth.audio-channels", &synth->audio_channels);
     fluid_settings_getint(settings, "synth.audio-groups", &synth->audio_groups);
     fluid_settings_getint(settings, "synth.effects-channels", &synth->effects_channels);
@@ -747,6 +1133,15 @@ new_fluid_synth(fluid_settings_t *settings)
     fluid_settings_getint(settings, "synth.note-cut", &i);
     synth->msgs_note_cut_mode = i;
 
+    fluid_settings_getnum(settings, "synth.noise-floor", &noise_floor);
+    synth->noise_floor = (fluid_real_t)pow(10.0, noise_floor / 20.0);
+
+    fluid_settings_getint(settings, "synth.governor.active", &i);
+    fluid_atomic_int_set(&synth->governor.active, i);
+    fluid_settings_getnum(settings, "synth.governor.target-load", &synth->governor.target_load);
+    fluid_settings_getint(settings, "synth.governor.min-polyphony", &synth->governor.min_polyphony);
+    fluid_settings_getint(settings, "synth.governor.interpolation", &synth->governor.interpolation);
+
     /* register the callbacks */
     fluid_settings_callback_num(settings, "synth.gain",
                                 fluid_synth_handle_gain, synth);
@@ -788,6 +1183,22 @@ new_fluid_synth(fluid_settings_t *settings)
                                 fluid_synth_handle_reverb_chorus_num, synth);
     fluid_settings_callback_num(settings, "synth.chorus.speed",
                                 fluid_synth_handle_reverb_chorus_num, synth);
+    fluid_settings_callback_int(settings, "synth.perf-stats",
+                                fluid_synth_handle_perf_stats, synth);
+    fluid_settings_callback_int(settings, "synth.cpu-accounting",
+                                fluid_synth_handle_cpu_accounting, synth);
+    fluid_settings_callback_int(settings, "synth.voice-snapshot",
+                                fluid_synth_handle_voice_snapshot, synth);
+    fluid_settings_callback_int(settings, "synth.metering",
+                                fluid_synth_handle_metering, synth);
+    fluid_settings_callback_int(settings, "synth.governor.active",
+                                fluid_synth_handle_governor_int, synth);
+    fluid_settings_callback_num(settings, "synth.governor.target-load",
+                                fluid_synth_handle_governor_num, synth);
+    fluid_settings_callback_int(settings, "synth.governor.min-polyphony",
+                                fluid_synth_handle_governor_int, synth);
+    fluid_settings_callback_int(settings, "synth.governor.interpolation",
+                                fluid_synth_handle_governor_int, synth);
     fluid_settings_callback_str(settings, "synth.portamento-time",
                                 fluid_synth_handle_portamento_mode, synth);
 
@@ -903,6 +1314,7 @@ new_fluid_synth(fluid_settings_t *settings)
     if(synth->cores > 1)
     {
         fluid_settings_getint(synth->settings, "audio.realtime-prio", &prio_level);
+        cpu_count = fluid_settings_get_cpu_list(settings, "synth.cpu-affinity", cpus, FLUID_N_ELEMENTS(cpus));
     }
 
     /* Allocate event queue for rvoice mixer */
@@ -910,14 +1322,138 @@ new_fluid_synth(fluid_settings_t *settings)
     synth->eventhandler = new_fluid_rvoice_eventhandler(synth->polyphony * 64,
                           synth->polyphony, synth->audio_groups,
                           synth->effects_channels, synth->effects_groups,
-                          (fluid_real_t)sample_rate_max, synth->sample_rate,
-                          synth->cores - 1, prio_level);
+                          synth->low_memory ? synth->sample_rate : (fluid_real_t)sample_rate_max, synth->sample_rate,
+                          synth->cores - 1, prio_level, cpus, cpu_count);
 
     if(synth->eventhandler == NULL)
     {
         goto error_recovery;
     }
 
+    deadline_period = fluid_synth_get_deadline(settings, &deadline_runtime);
+    fluid_rvoice_mixer_set_deadline(synth->eventhandler->mixer, deadline_runtime, deadline_period);
+
+    synth->perf = new_fluid_perf(synth->midi_channels);
+
+    if(synth->perf == NULL)
+    {
+        goto error_recovery;
+    }
+
+    fluid_settings_getint(settings, "synth.perf-stats", &i);
+    fluid_atomic_int_set(&synth->perf->enabled, i);
+    fluid_rvoice_mixer_set_perf(synth->eventhandler->mixer, synth->perf);
+
+    synth->note_latency_queue = new_fluid_ringbuffer(FLUID_NOTE_LATENCY_QUEUE_SIZE, sizeof(fluid_synth_note_ingress_t));
+
+    if(synth->note_latency_queue == NULL)
+    {
+        goto error_recovery;
+    }
+
+    fluid_settings_getint(settings, "synth.cpu-accounting", &i);
+
+    if(fluid_perf_set_accounting(synth->perf, i) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    synth->voice_snapshot = new_fluid_voice_snapshot(synth->midi_channels);
+
+    if(synth->voice_snapshot == NULL)
+    {
+        goto error_recovery;
+    }
+
+    fluid_settings_getint(settings, "synth.voice-snapshot", &i);
+
+    if(fluid_voice_snapshot_set_enabled(synth->voice_snapshot, i, synth->polyphony) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    fluid_rvoice_mixer_set_voice_snapshot(synth->eventhandler->mixer, synth->voice_snapshot);
+
+    synth->meter = new_fluid_meter(synth->midi_channels, synth->audio_groups,
+                                   synth->effects_channels * synth->effects_groups);
+
+    if(synth->meter == NULL)
+    {
+        goto error_recovery;
+    }
+
+    fluid_settings_getint(settings, "synth.metering", &i);
+
+    if(fluid_meter_set_enabled(synth->meter, i) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    fluid_rvoice_mixer_set_meter(synth->eventhandler->mixer, synth->meter);
+
+    if(fluid_synth_update_resampler(synth) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    /* Must be set up before the LADSPA host ports are bound to the effects buffers */
+    fluid_settings_getint(settings, "synth.fx-pipeline", &i);
+
+    if(i)
+    {
+        fluid_settings_getint(settings, "audio.realtime-prio", &prio_level);
+
+        if(fluid_rvoice_mixer_set_fx_pipeline(synth->eventhandler->mixer, prio_level) != FLUID_OK)
+        {
+            goto error_recovery;
+        }
+    }
+
+    fluid_settings_getint(settings, "synth.deterministic-render", &i);
+
+    if(i && fluid_rvoice_mixer_set_deterministic(synth->eventhandler->mixer) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    fluid_settings_getint(settings, "synth.rt-alloc-check", &synth->rt_alloc_check);
+
+    if(synth->rt_alloc_check)
+    {
+        fluid_rt_alloc_check_enable(TRUE);
+    }
+
+    fluid_settings_getint(settings, "synth.flush-denormals", &synth->flush_denormals);
+    fluid_rvoice_mixer_set_flush_denormals(synth->eventhandler->mixer, synth->flush_denormals);
+
+    fluid_settings_getint(settings, "synth.fx-decimation", &i);
+
+    if(fluid_rvoice_mixer_set_fx_decimation(synth->eventhandler->mixer, i) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    fluid_settings_getint(settings, "synth.fx-share", &i);
+    fluid_rvoice_mixer_set_fx_share(synth->eventhandler->mixer, i);
+
+    fluid_settings_getint(settings, "synth.voice-cache", &synth->voice_cache);
+    fluid_settings_getint(settings, "synth.voice-cache-length", &i);
+
+    if(fluid_rvoice_mixer_set_voice_cache(synth->eventhandler->mixer, synth->voice_cache,
+                                          (int)(i * synth->sample_rate / (1000.0 * FLUID_BUFSIZE)) + 1) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    /* Without the streaming thread, streamed samples are only read by page faults */
+    fluid_settings_getint(settings, "synth.sample-streaming", &i);
+
+    if(i)
+    {
+        fluid_settings_getint(settings, "synth.sample-streaming-preload", &i);
+        synth->stream = new_fluid_rvoice_stream(i);
+    }
+
     /* Setup the list of default modulators.
      * Needs to happen after eventhandler has been set up, as fluid_synth_enter_api is called in the process */
     synth->default_mod = NULL;
@@ -959,7 +1495,6 @@ new_fluid_synth(fluid_settings_t *settings)
 
     if(with_limiter)
     {
-#ifdef LIMITER_SUPPORT
         limiter_settings.input_gain = 1.0;
         if(fluid_settings_getnum(settings, "synth.limiter.output-limit", &limiter_value) == FLUID_OK) {
             limiter_settings.output_limit = limiter_value;
@@ -977,14 +1512,12 @@ new_fluid_synth(fluid_settings_t *settings)
             limiter_settings.link_channels = limiter_value;
         }
         fluid_settings_getint(settings, "synth.limiter.smoothing-stages", &limiter_settings.smoothing_stages);
+        fluid_settings_getint(settings, "synth.limiter.look-ahead", &limiter_settings.look_ahead);
 
         if (!fluid_rvoice_mixer_set_limiter(synth->eventhandler->mixer, synth->sample_rate, &limiter_settings)) {
             FLUID_LOG(FLUID_ERR, "Out of memory");
             goto error_recovery;
         }
-#else /* LIMITER_SUPPORT */
-        FLUID_LOG(FLUID_WARN, "FluidSynth has not been compiled with limiter support");
-#endif /* LIMITER_SUPPORT */
     }
 
 
@@ -1037,36 +1570,90 @@ new_fluid_synth(fluid_settings_t *settings)
     }
 
     FLUID_MEMSET(synth->channel, 0, synth->midi_channels * sizeof(*synth->channel));
-    for(i = 0; i < synth->midi_channels; i++)
+
+    synth->active_channels = FLUID_ARRAY(uint32_t, (synth->midi_channels + 31) / 32);
+
+    if(synth->active_channels == NULL)
     {
-        synth->channel[i] = new_fluid_channel(synth, i);
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
 
-        if(synth->channel[i] == NULL)
+    FLUID_MEMSET(synth->active_channels, 0, (synth->midi_channels + 31) / 32 * sizeof(*synth->active_channels));
+    synth->interp_method = FLUID_INTERP_DEFAULT;
+
+    /* with synth.sparse-channels, only basic channel 0 exists from the start */
+    for(i = 0; i < (synth->sparse_channels ? 1 : synth->midi_channels); i++)
+    {
+        if(fluid_synth_create_channel_LOCAL(synth, i) != FLUID_OK)
         {
             goto error_recovery;
         }
     }
 
-    /* allocate all synthesis processes */
-    synth->nvoice = synth->polyphony;
-    synth->voice = FLUID_ARRAY(fluid_voice_t *, synth->nvoice);
+    fluid_settings_getint(settings, "synth.shared-soundfonts", &synth->shared_sfonts);
+    fluid_settings_getint(settings, "synth.dynamic-sample-loading", &i);
 
-    if(synth->voice == NULL)
+    if(synth->shared_sfonts && i)
     {
-        goto error_recovery;
+        FLUID_LOG(FLUID_WARN, "synth.shared-soundfonts is ignored with synth.dynamic-sample-loading");
+        synth->shared_sfonts = FALSE;
     }
 
-    FLUID_MEMSET(synth->voice, 0, synth->nvoice * sizeof(*synth->voice));
-    for(i = 0; i < synth->nvoice; i++)
-    {
-        synth->voice[i] = new_fluid_voice(synth->eventhandler, synth->sample_rate, synth->iir_sincos_table);
+    fluid_settings_getint(settings, "synth.sample-accurate-events", &synth->sample_accurate_events);
+    fluid_settings_getint(settings, "synth.stereo-voices", &synth->stereo_voices);
 
-        if(synth->voice[i] == NULL)
-        {
-            goto error_recovery;
-        }
+    fluid_settings_getint(settings, "synth.api-queue", &i);
+
+    if(i > 0 && fluid_synth_init_api_queue(synth, i) != FLUID_OK)
+    {
+        goto error_recovery;
     }
 
+    synth->iir_sincos_table = fluid_iir_filter_acquire_table(synth->sample_rate);
+
+    if(synth->iir_sincos_table == NULL)
+    {
+        goto error_recovery;
+    }
+
+    /* allocate all synthesis processes, or only a first block of them in low memory mode */
+    if(fluid_synth_add_voices_LOCAL(synth, synth->low_memory ? FLUID_SYNTH_VOICE_BLOCK : synth->polyphony) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    synth->overflow_tree = new_fluid_overflow_tree(synth->polyphony);
+
+    if(synth->overflow_tree == NULL)
+    {
+        goto error_recovery;
+    }
+
+    synth->note_voices = FLUID_ARRAY(fluid_voice_t *, synth->midi_channels * 128);
+    synth->channel_voices = FLUID_ARRAY(fluid_voice_t *, synth->midi_channels);
+    synth->voice_counters = FLUID_ARRAY(fluid_synth_voice_counters_t, synth->midi_channels + 1);
+
+    /* every dry and fx buffer is mixed into one output buffer at most */
+    i = (synth->audio_channels + synth->effects_channels * synth->effects_groups) * 2;
+    synth->mix_nout = synth->mix_nfx = -1;
+    synth->mix_sources = FLUID_ARRAY(fluid_synth_mix_source_t, i);
+    synth->mix_first = FLUID_ARRAY(int, i + 1);
+    synth->mix_bufs = FLUID_ARRAY(const fluid_real_t *, i);
+
+    if(synth->note_voices == NULL || synth->channel_voices == NULL || synth->voice_counters == NULL
+            || synth->mix_sources == NULL || synth->mix_first == NULL || synth->mix_bufs == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    FLUID_MEMSET(synth->note_voices, 0, synth->midi_channels * 128 * sizeof(*synth->note_voices));
+    FLUID_MEMSET(synth->channel_voices, 0, synth->midi_channels * sizeof(*synth->channel_voices));
+    FLUID_MEMSET(synth->voice_counters, 0, (synth->midi_channels + 1) * sizeof(*synth->voice_counters));
+
+    fluid_synth_invalidate_overflow_prio_LOCAL(synth);
+
     /* sets a default basic channel */
     /* Sets one basic channel: basic channel 0, mode 0 (Omni On - Poly) */
     /* (i.e all channels are polyphonic) */
@@ -1077,8 +1664,38 @@ new_fluid_synth(fluid_settings_t *settings)
     synth->min_note_length_ticks = fluid_synth_get_min_note_length_LOCAL(synth);
 
 
-    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_polyphony,
-                             synth->polyphony, 0.0f);
+    if(fluid_rvoice_mixer_push_polyphony(synth->eventhandler->mixer, synth->polyphony) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    if(fluid_settings_str_equal(settings, "synth.mixer-thread-wait", "hybrid"))
+    {
+        i = FLUID_MIXER_THREAD_WAIT_HYBRID;
+    }
+    else if(fluid_settings_str_equal(settings, "synth.mixer-thread-wait", "spin"))
+    {
+        i = FLUID_MIXER_THREAD_WAIT_SPIN;
+    }
+    else
+    {
+        i = FLUID_MIXER_THREAD_WAIT_BLOCK;
+    }
+
+    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_thread_wait, i, 0.0f);
+
+    fluid_settings_getint(settings, "synth.voice-locality", &i);
+    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_voice_locality, i, 0.0f);
+
+    fluid_settings_getint(settings, "synth.parallel-audio-groups", &i);
+    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_parallel_groups, i, 0.0f);
+
+    i = fluid_settings_str_equal(settings, "synth.filter-smoothing", "block")
+        ? FLUID_IIR_SMOOTHING_BLOCK : FLUID_IIR_SMOOTHING_SAMPLE;
+    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_filter_smoothing, i, 0.0f);
+
+    fluid_settings_getint(settings, "synth.float-interpolation", &i);
+    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_float_interp, i, 0.0f);
     fluid_synth_reverb_on(synth, -1, synth->with_reverb);
     fluid_synth_chorus_on(synth, -1, synth->with_chorus);
 
@@ -1130,7 +1747,8 @@ new_fluid_synth(fluid_settings_t *settings)
         synth->bank_select = FLUID_BANK_STYLE_MMA;
     }
 
-    fluid_iir_filter_init_table(synth->iir_sincos_table, synth->sample_rate);
+    fluid_synth_clear_preset_cache(synth);
+
     fluid_synth_process_event_queue(synth);
 
     /* FIXME */
@@ -1206,6 +1824,25 @@ delete_fluid_synth(fluid_synth_t *synth)
                                 NULL, NULL);
     fluid_settings_callback_num(synth->settings, "synth.chorus.speed",
                                 NULL, NULL);
+    fluid_settings_callback_int(synth->settings, "synth.perf-stats",
+                                NULL, NULL);
+    fluid_settings_callback_int(synth->settings, "synth.cpu-accounting",
+                                NULL, NULL);
+    fluid_settings_callback_int(synth->settings, "synth.voice-snapshot",
+                                NULL, NULL);
+    fluid_settings_callback_int(synth->settings, "synth.metering",
+                                NULL, NULL);
+    fluid_settings_callback_int(synth->settings, "synth.governor.active",
+                                NULL, NULL);
+    fluid_settings_callback_num(synth->settings, "synth.governor.target-load",
+                                NULL, NULL);
+    fluid_settings_callback_int(synth->settings, "synth.governor.min-polyphony",
+                                NULL, NULL);
+    fluid_settings_callback_int(synth->settings, "synth.governor.interpolation",
+                                NULL, NULL);
+
+    /* the warm-ups read the SoundFonts */
+    fluid_synth_join_warmups(synth, NULL, FALSE);
 
     /* turn off all voices, needed to unload SoundFont data */
     if(synth->voice != NULL)
@@ -1244,6 +1881,9 @@ delete_fluid_synth(fluid_synth_t *synth)
         }
     }
 
+    /* samples released by the synthesis thread are still referenced */
+    fluid_synth_notify_released_samples_LOCAL(synth);
+
     /* also unset all presets for clean SoundFont unload */
     if(synth->channel != NULL)
     {
@@ -1257,6 +1897,20 @@ delete_fluid_synth(fluid_synth_t *synth)
     }
 
     delete_fluid_rvoice_eventhandler(synth->eventhandler);
+    delete_fluid_rvoice_stream(synth->stream);
+    delete_fluid_perf(synth->perf);
+    delete_fluid_ringbuffer(synth->note_latency_queue);
+    delete_fluid_voice_snapshot(synth->voice_snapshot);
+    delete_fluid_meter(synth->meter);
+    delete_fluid_out_resampler(synth->resampler);
+
+    /* the mixer is gone, so are its references to the convolvers */
+    for(list = synth->convolvers; list; list = fluid_list_next(list))
+    {
+        delete_fluid_convolver(fluid_list_get(list));
+    }
+
+    delete_fluid_list(synth->convolvers);
 
     /* delete all the SoundFonts */
     for(list = synth->sfont; list; list = fluid_list_next(list))
@@ -1300,6 +1954,8 @@ delete_fluid_synth(fluid_synth_t *synth)
         FLUID_FREE(synth->channel);
     }
 
+    FLUID_FREE(synth->active_channels);
+
     if(synth->voice != NULL)
     {
         for(i = 0; i < synth->nvoice; i++)
@@ -1310,6 +1966,22 @@ delete_fluid_synth(fluid_synth_t *synth)
         FLUID_FREE(synth->voice);
     }
 
+    FLUID_FREE(synth->released_samples);
+
+    if(synth->rt_alloc_check)
+    {
+        fluid_rt_alloc_check_enable(FALSE);
+    }
+
+    fluid_iir_filter_release_table(synth->iir_sincos_table);
+    delete_fluid_overflow_tree(synth->overflow_tree);
+    FLUID_FREE(synth->note_voices);
+    FLUID_FREE(synth->channel_voices);
+    FLUID_FREE(synth->voice_counters);
+    FLUID_FREE(synth->mix_sources);
+    FLUID_FREE(synth->mix_first);
+    FLUID_FREE(synth->mix_bufs);
+
 
     /* free the tunings, if any */
     if(synth->tuning != NULL)
@@ -1342,6 +2014,18 @@ delete_fluid_synth(fluid_synth_t *synth)
 
     FLUID_FREE(synth->overflow.important_channels);
 
+    /* free the queued events that have not been applied */
+    for(i = synth->midi_queue_head; i < synth->midi_queue_tail; i++)
+    {
+        if(synth->midi_queue[i].type == MIDI_SYSEX)
+        {
+            FLUID_FREE(synth->midi_queue[i].paramptr);
+        }
+    }
+
+    FLUID_FREE(synth->midi_queue);
+    FLUID_FREE(synth->api_queue);
+
     fluid_rec_mutex_destroy(synth->mutex);
 
     FLUID_FREE(synth);
@@ -1383,17 +2067,51 @@ fluid_synth_error(fluid_synth_t *synth)
  */
 int
 fluid_synth_noteon(fluid_synth_t *synth, int chan, int key, int vel)
+{
+    return fluid_synth_noteon_ingress(synth, chan, key, vel, 0);
+}
+
+/* fluid_synth_noteon() of a note-on received by a MIDI driver at ingress, see
+ * fluid_midi_event_stamp(), whose latency is measured if ingress isn't 0 */
+static int
+fluid_synth_noteon_ingress(fluid_synth_t *synth, int chan, int key, int vel, unsigned int ingress)
 {
     int result;
     fluid_return_val_if_fail(key >= 0 && key <= 127, FLUID_FAILED);
     fluid_return_val_if_fail(vel >= 0 && vel <= 127, FLUID_FAILED);
+    FLUID_API_QUEUE_CHAN_INGRESS(FLUID_SYNTH_CALL_NOTEON, key, vel, ingress);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
+    synth->note_ingress = ingress;
+    result = fluid_synth_noteon_enabled_LOCAL(synth, chan, key, vel);
+    synth->note_ingress = 0;
+    FLUID_API_RETURN(result);
+}
+
+/* Returns TRUE if chan is enabled, logs that the event is dropped otherwise */
+static int
+fluid_synth_chan_enabled_LOCAL(fluid_synth_t *synth, int chan)
+{
+    if(FLUID_LIKELY(synth->channel[chan]->mode & FLUID_CHANNEL_ENABLED))
+    {
+        return TRUE;
+    }
+
+    FLUID_LOG(FLUID_INFO, "Channel %d is disabled, event dropped!", chan);
+    return FALSE;
+}
+
+/* fluid_synth_noteon() after entering the API */
+static int
+fluid_synth_noteon_enabled_LOCAL(fluid_synth_t *synth, int chan, int key, int vel)
+{
     /* Allowed only on MIDI channel enabled */
-    FLUID_API_RETURN_IF_CHAN_DISABLED(FLUID_FAILED);
+    if(!fluid_synth_chan_enabled_LOCAL(synth, chan))
+    {
+        return FLUID_FAILED;
+    }
 
-    result = fluid_synth_noteon_LOCAL(synth, chan, key, vel);
-    FLUID_API_RETURN(result);
+    return fluid_synth_noteon_LOCAL(synth, chan, key, vel);
 }
 
 /* Local synthesis thread variant of fluid_synth_noteon */
@@ -1470,13 +2188,24 @@ fluid_synth_noteoff(fluid_synth_t *synth, int chan, int key)
 {
     int result;
     fluid_return_val_if_fail(key >= 0 && key <= 127, FLUID_FAILED);
+    FLUID_API_QUEUE_CHAN(FLUID_SYNTH_CALL_NOTEOFF, key, 0);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
+    result = fluid_synth_noteoff_enabled_LOCAL(synth, chan, key);
+    FLUID_API_RETURN(result);
+}
+
+/* fluid_synth_noteoff() after entering the API */
+static int
+fluid_synth_noteoff_enabled_LOCAL(fluid_synth_t *synth, int chan, int key)
+{
     /* Allowed only on MIDI channel enabled */
-    FLUID_API_RETURN_IF_CHAN_DISABLED(FLUID_FAILED);
+    if(!fluid_synth_chan_enabled_LOCAL(synth, chan))
+    {
+        return FLUID_FAILED;
+    }
 
-    result = fluid_synth_noteoff_LOCAL(synth, chan, key);
-    FLUID_API_RETURN(result);
+    return fluid_synth_noteoff_LOCAL(synth, chan, key);
 }
 
 /* Local synthesis thread variant of fluid_synth_noteoff */
@@ -1516,12 +2245,11 @@ fluid_synth_damp_voices_by_sustain_LOCAL(fluid_synth_t *synth, int chan)
 {
     fluid_channel_t *channel = synth->channel[chan];
     fluid_voice_t *voice;
-    int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = FLUID_SYNTH_CHANNEL_VOICES(synth, chan);
+            voice != NULL && voice->index < synth->polyphony;
+            voice = voice->list_next[FLUID_VOICE_LIST_CHANNEL])
     {
-        voice = synth->voice[i];
-
         if((fluid_voice_get_channel(voice) == chan) && fluid_voice_is_sustained(voice))
         {
             if(voice->key == channel->key_mono_sustained)
@@ -1546,12 +2274,11 @@ fluid_synth_damp_voices_by_sostenuto_LOCAL(fluid_synth_t *synth, int chan)
 {
     fluid_channel_t *channel = synth->channel[chan];
     fluid_voice_t *voice;
-    int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = FLUID_SYNTH_CHANNEL_VOICES(synth, chan);
+            voice != NULL && voice->index < synth->polyphony;
+            voice = voice->list_next[FLUID_VOICE_LIST_CHANNEL])
     {
-        voice = synth->voice[i];
-
         if((fluid_voice_get_channel(voice) == chan) && fluid_voice_is_sostenuto(voice))
         {
             if(voice->key == channel->key_mono_sustained)
@@ -1569,6 +2296,54 @@ fluid_synth_damp_voices_by_sostenuto_LOCAL(fluid_synth_t *synth, int chan)
     return FLUID_OK;
 }
 
+/* Gives the list of default modulators a new generation, after it has been changed */
+static void
+fluid_synth_default_mods_changed_LOCAL(fluid_synth_t *synth)
+{
+    /* 0 is left to the default modulators of SoundFonts */
+    do
+    {
+        synth->default_mod_generation = fluid_atomic_int_exchange_and_add(&fluid_synth_default_mod_generation, 1) + 1;
+    }
+    while(synth->default_mod_generation == 0);
+}
+
+/*
+ * Returns the default modulators fluid_synth_alloc_voice_LOCAL() adds to a voice of the
+ * sample on the channel. A SoundFont loader may merge them with the modulators of its zones
+ * once and add the merged ones with default_mods FALSE, as long as generation stays the
+ * same: it identifies the list across synths and changes with fluid_synth_add_default_mod()
+ * and fluid_synth_remove_default_mod().
+ * @return FALSE if the default modulators depend on the channel (see
+ *   fluid_synth_set_breath_mode()), they can't be merged in advance then.
+ */
+int
+fluid_synth_get_default_mods_LOCAL(fluid_synth_t *synth, const fluid_sample_t *sample, int chan,
+                                   fluid_mod_t **mods, unsigned int *generation)
+{
+    fluid_channel_t *channel = synth->channel[chan];
+    int mono = fluid_channel_is_playing_mono(channel);
+
+    if((!mono && (channel->mode & FLUID_CHANNEL_BREATH_POLY))
+            || (mono && (channel->mode & FLUID_CHANNEL_BREATH_MONO)))
+    {
+        return FALSE;
+    }
+
+    if(sample->default_modulators != NULL)
+    {
+        *mods = sample->default_modulators;
+        *generation = 0;
+    }
+    else
+    {
+        *mods = synth->default_mod;
+        *generation = synth->default_mod_generation;
+    }
+
+    return TRUE;
+}
+
 /**
  * Adds the specified modulator \c mod as default modulator to the synth. \c mod will
  * take effect for any subsequently created voice.
@@ -1614,6 +2389,7 @@ fluid_synth_add_default_mod(fluid_synth_t *synth, const fluid_mod_t *mod, int mo
                 default_mod->amount = mod->amount;
             }
 
+            fluid_synth_default_mods_changed_LOCAL(synth);
             FLUID_API_RETURN(FLUID_OK);
         }
 
@@ -1641,6 +2417,7 @@ fluid_synth_add_default_mod(fluid_synth_t *synth, const fluid_mod_t *mod, int mo
         last_mod->next = new_mod;
     }
 
+    fluid_synth_default_mods_changed_LOCAL(synth);
     FLUID_API_RETURN(FLUID_OK);
 }
 
@@ -1680,6 +2457,7 @@ fluid_synth_remove_default_mod(fluid_synth_t *synth, const fluid_mod_t *mod)
             }
 
             delete_fluid_mod(default_mod);
+            fluid_synth_default_mods_changed_LOCAL(synth);
             FLUID_API_RETURN(FLUID_OK);
         }
 
@@ -1717,13 +2495,49 @@ fluid_synth_remove_default_mod(fluid_synth_t *synth, const fluid_mod_t *mod)
 int
 fluid_synth_cc(fluid_synth_t *synth, int chan, int num, int val)
 {
-    int result = FLUID_FAILED;
-    fluid_channel_t *channel;
+    int result;
     fluid_return_val_if_fail(num >= 0 && num <= 127, FLUID_FAILED);
     fluid_return_val_if_fail(val >= 0 && val <= 127, FLUID_FAILED);
+
+    /* a channel that doesn't exist yet has no notes and its controllers in their reset state:
+     * releasing or resetting them, as players do on all channels, doesn't need to create it */
+    if(synth != NULL && chan >= 0 && chan < synth->midi_channels
+            && fluid_atomic_pointer_get(&synth->channel[chan]) == NULL)
+    {
+        switch(num)
+        {
+        case ALL_SOUND_OFF:
+        case ALL_NOTES_OFF:
+        case ALL_CTRL_OFF:
+            return FLUID_OK;
+
+        case SUSTAIN_SWITCH:
+        case SOSTENUTO_SWITCH:
+            if(val < 64)
+            {
+                return FLUID_OK;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    FLUID_API_QUEUE_CHAN(FLUID_SYNTH_CALL_CC, num, val);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
-    channel = synth->channel[chan];
+    result = fluid_synth_cc_global_LOCAL(synth, chan, num, val);
+    FLUID_API_RETURN(result);
+}
+
+/* fluid_synth_cc() after entering the API, sends a global controller to its basic channel */
+static int
+fluid_synth_cc_global_LOCAL(fluid_synth_t *synth, int chan, int num, int val)
+{
+    int result = FLUID_FAILED;
+    fluid_channel_t *channel = synth->channel[chan];
 
     if(channel->mode &  FLUID_CHANNEL_ENABLED)
     {
@@ -1779,7 +2593,7 @@ fluid_synth_cc(fluid_synth_t *synth, int chan, int num, int val)
         }
     }
 
-    FLUID_API_RETURN(result);
+    return result;
 }
 
 /* Local synthesis thread variant of MIDI CC set function.
@@ -1872,7 +2686,8 @@ fluid_synth_cc_LOCAL(fluid_synth_t *synth, int channum, int num)
             /* Checks value range and changes this existing basic channel group */
             value = fluid_synth_check_next_basic_channel(synth, channum, new_mode, value);
 
-            if(value != FLUID_FAILED)
+            /* the channels of the changed group must exist */
+            if(value != FLUID_FAILED && fluid_synth_create_channels_LOCAL(synth) == FLUID_OK)
             {
                 /* reset the current basic channel before changing it */
                 fluid_synth_reset_basic_channel_LOCAL(synth, channum, chan->mode_val);
@@ -2387,7 +3202,8 @@ fluid_synth_sysex_midi_tuning(fluid_synth_t *synth, const char *data, int len,
         *resptr++ = MIDI_SYSEX_UNIV_NON_REALTIME;
         *resptr++ = synth->device_id;
         *resptr++ = MIDI_SYSEX_MIDI_TUNING_ID;
-        *resptr++ = MIDI_SYSEX_TUNING_BULK_DUMP;
+        *resptr++ = (msgid == MIDI_SYSEX_TUNING_BULK_DUMP_REQ_BANK) ? MIDI_SYSEX_TUNING_BULK_DUMP_BANK
+                    : MIDI_SYSEX_TUNING_BULK_DUMP;
 
         if(msgid == MIDI_SYSEX_TUNING_BULK_DUMP_REQ_BANK)
         {
@@ -2440,6 +3256,79 @@ fluid_synth_sysex_midi_tuning(fluid_synth_t *synth, const char *data, int len,
 
         break;
 
+    case MIDI_SYSEX_TUNING_BULK_DUMP:
+    case MIDI_SYSEX_TUNING_BULK_DUMP_BANK:
+        dataptr = data + 4;
+
+        /* the checksum isn't verified, senders don't agree on what it covers */
+        if(msgid == MIDI_SYSEX_TUNING_BULK_DUMP)
+        {
+            if(len != 406 || data[4] & 0x80)
+            {
+                return FLUID_OK;
+            }
+        }
+        else
+        {
+            if(len != 407 || data[4] & 0x80 || data[5] & 0x80)
+            {
+                return FLUID_OK;
+            }
+
+            bank = *dataptr++;
+        }
+
+        if(dryrun)
+        {
+            if(handled)
+            {
+                *handled = TRUE;
+            }
+
+            return FLUID_OK;
+        }
+
+        prog = *dataptr++;
+        FLUID_MEMCPY(name, dataptr, 16);
+        dataptr += 16;
+
+        for(i = 0, index = 0; i < 128; i++)
+        {
+            note = *dataptr++;
+            frac = *dataptr++;
+            frac2 = *dataptr++;
+
+            if(note & 0x80 || frac & 0x80 || frac2 & 0x80)
+            {
+                return FLUID_OK;
+            }
+
+            frac = frac << 7 | frac2;
+
+            /* keys that keep their pitch */
+            if(note == 0x7F && frac == 16383)
+            {
+                continue;
+            }
+
+            keys[index] = i;
+            tunedata[index] = note * 100.0 + (frac * 100.0 / 16384.0);
+            index++;
+        }
+
+        if(fluid_synth_update_tuning_LOCAL(synth, bank, prog, name, index, keys, tunedata,
+                                           realtime) == FLUID_FAILED)
+        {
+            return FLUID_FAILED;
+        }
+
+        if(handled)
+        {
+            *handled = TRUE;
+        }
+
+        break;
+
     case MIDI_SYSEX_TUNING_NOTE_TUNE:
     case MIDI_SYSEX_TUNING_NOTE_TUNE_BANK:
         dataptr = data + 4;
@@ -2509,8 +3398,8 @@ fluid_synth_sysex_midi_tuning(fluid_synth_t *synth, const char *data, int len,
 
         if(index > 0)
         {
-            if(fluid_synth_tune_notes(synth, bank, prog, index, keys, tunedata,
-                                      realtime) == FLUID_FAILED)
+            if(fluid_synth_update_tuning_LOCAL(synth, bank, prog, NULL, index, keys, tunedata,
+                                               realtime) == FLUID_FAILED)
             {
                 return FLUID_FAILED;
             }
@@ -2578,8 +3467,15 @@ fluid_synth_sysex_midi_tuning(fluid_synth_t *synth, const char *data, int len,
             }
         }
 
-        if(fluid_synth_activate_octave_tuning(synth, 0, 0, "SYSEX",
-                                              tunedata, realtime) == FLUID_FAILED)
+        /* like fluid_synth_activate_octave_tuning(), but retuning the existing tuning in place */
+        for(i = 127; i >= 0; i--)
+        {
+            keys[i] = i;
+            tunedata[i] = i * 100.0 + tunedata[i % 12];
+        }
+
+        if(fluid_synth_update_tuning_LOCAL(synth, 0, 0, "SYSEX", 128, keys, tunedata,
+                                           realtime) == FLUID_FAILED)
         {
             return FLUID_FAILED;
         }
@@ -2692,7 +3588,14 @@ fluid_synth_sysex_gs_dt1(fluid_synth_t *synth, const char *data, int len,
             //See the Patch Part parameters section in SC-88Pro/8850 owner's manual
             chan = chan >= 0x0a ? chan : (chan == 0 ? 9 : chan - 1);
             type = data[7] == 0x00 ? CHANNEL_TYPE_MELODIC : CHANNEL_TYPE_DRUM;
+
+            if(synth->channel[chan] == NULL && fluid_synth_create_channel_LOCAL(synth, chan) != FLUID_OK)
+            {
+                return FLUID_FAILED;
+            }
+
             synth->channel[chan]->channel_type = type;
+            fluid_synth_invalidate_overflow_prio_LOCAL(synth);
 
             FLUID_LOG(FLUID_DBG, "SysEx GS DT1: setting MIDI channel %d to type %d", chan, (int)synth->channel[chan]->channel_type);
             // Roland synths seem to "remember" the last instrument a channel
@@ -2798,7 +3701,13 @@ fluid_synth_all_notes_off_LOCAL(fluid_synth_t *synth, int chan)
     fluid_voice_t *voice;
     int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    /* no voices play on a channel that doesn't exist */
+    if(chan >= 0 && synth->channel[chan] == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
     {
         voice = synth->voice[i];
 
@@ -2847,7 +3756,13 @@ fluid_synth_all_sounds_off_LOCAL(fluid_synth_t *synth, int chan)
     fluid_voice_t *voice;
     int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    /* no voices play on a channel that doesn't exist */
+    if(chan >= 0 && synth->channel[chan] == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
     {
         voice = synth->voice[i];
 
@@ -2905,24 +3820,90 @@ fluid_synth_system_reset(fluid_synth_t *synth)
     FLUID_API_RETURN(result);
 }
 
-/* Local variant of the system reset command */
-static int
-fluid_synth_system_reset_LOCAL(fluid_synth_t *synth)
+/**
+ * Save the state of the synth into a snapshot, to restore it later with fluid_synth_restore().
+ *
+ * @param synth FluidSynth instance
+ * @param data Buffer to write the snapshot to, or NULL to only query the size of the snapshot
+ * @param size Size of \a data in bytes
+ * @return Size of the snapshot in bytes, #FLUID_FAILED if \a size is too small for it
+ *
+ * The snapshot contains what MIDI messages and setup calls change: for every MIDI channel its
+ * preset, bank and program, controllers, pressure, pitch bend and pitch wheel sensitivity,
+ * generator offsets (fluid_synth_set_gen() and NRPNs), basic channel mode, legato, portamento and
+ * breath mode, channel type, interpolation method and tuning. Furthermore all tunings, the gain,
+ * the reverb and chorus parameters of all effects groups, and the file names of the loaded
+ * SoundFonts in the order they have been loaded. Playing notes aren't part of the snapshot.
+ *
+ * The snapshot is a blob in the native byte order and memory layout of this build of
+ * libfluidsynth, it is not meant to be stored or sent to other machines.
+ *
+ * @since 2.6.0
+ */
+int
+fluid_synth_snapshot(fluid_synth_t *synth, void *data, int size)
 {
-    int i;
-
-    if(synth->verbose)
-    {
-        FLUID_LOG(FLUID_INFO, "=== systemreset ===");
-    }
+    int result;
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(data == NULL || size >= 0, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+    result = fluid_synth_snapshot_LOCAL(synth, data, size);
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Restore the state of the synth saved by fluid_synth_snapshot().
+ *
+ * @param synth FluidSynth instance
+ * @param data Snapshot
+ * @param size Size of the snapshot in bytes, as returned by fluid_synth_snapshot()
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * All playing voices are stopped immediately, and the state saved in the snapshot replaces the
+ * current one. Tunings created after the snapshot are kept. The snapshot may come from another
+ * synth with the same number of MIDI channels and effects groups.
+ *
+ * If the synth has the SoundFonts of the snapshot loaded in the same order, they are used as they
+ * are, which makes restoring as fast as copying the state. Otherwise the SoundFonts are loaded
+ * again from their files, and the SoundFonts loaded before are unloaded. If a file can't be loaded,
+ * or the snapshot is invalid or comes from another build of libfluidsynth, the synth is left
+ * unchanged and #FLUID_FAILED is returned.
+ *
+ * @since 2.6.0
+ */
+int
+fluid_synth_restore(fluid_synth_t *synth, const void *data, int size)
+{
+    int result;
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(data != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(size >= 0, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+    result = fluid_synth_restore_LOCAL(synth, data, size);
+    FLUID_API_RETURN(result);
+}
+
+/* Local variant of the system reset command */
+static int
+fluid_synth_system_reset_LOCAL(fluid_synth_t *synth)
+{
+    int i;
+
+    if(synth->verbose)
+    {
+        FLUID_LOG(FLUID_INFO, "=== systemreset ===");
+    }
 
     fluid_synth_all_sounds_off_LOCAL(synth, -1);
 
-    for(i = 0; i < synth->midi_channels; i++)
+    /* the channels that don't exist are in their reset state */
+    for(i = fluid_synth_next_channel(synth, 0); i < synth->midi_channels; i = fluid_synth_next_channel(synth, i + 1))
     {
         fluid_channel_reset(synth->channel[i]);
     }
 
+    synth->interp_method = FLUID_INTERP_DEFAULT;
+
     /* Basic channel 0, Mode Omni On Poly */
     fluid_synth_set_basic_channel(synth, 0, FLUID_CHANNEL_MODE_OMNION_POLY,
                                   synth->midi_channels);
@@ -2941,6 +3922,11 @@ fluid_synth_system_reset_LOCAL(fluid_synth_t *synth)
 
 /**
  * Update voices on a MIDI channel after a MIDI control change.
+ *
+ * The change is only marked on the channel: fluid_synth_apply_modulations() updates
+ * the voices before the next block is rendered. Changes of the same controller in
+ * between, like those of a controller sweep, thus update the voices only once.
+ *
  * @param synth FluidSynth instance
  * @param chan MIDI channel number (0 to MIDI channel count - 1)
  * @param is_cc Boolean value indicating if ctrl is a CC controller or not
@@ -2950,45 +3936,129 @@ fluid_synth_system_reset_LOCAL(fluid_synth_t *synth)
 static int
 fluid_synth_modulate_voices_LOCAL(fluid_synth_t *synth, int chan, int is_cc, int ctrl)
 {
-    fluid_voice_t *voice;
-    int i;
-
-    for(i = 0; i < synth->polyphony; i++)
-    {
-        voice = synth->voice[i];
+    fluid_channel_t *channel = synth->channel[chan];
+    int bit = (is_cc ? 0 : 128) + (ctrl & 0x7F);
 
-        if(fluid_voice_get_channel(voice) == chan)
-        {
-            fluid_voice_modulate(voice, is_cc, ctrl);
-        }
-    }
+    channel->modulate_pending[bit >> 5] |= (uint32_t)1 << (bit & 31);
+    channel->modulate_stamp = ++synth->modulate_stamp;
+    fluid_atomic_int_set(&synth->modulate_pending, TRUE);
 
     return FLUID_OK;
 }
 
 /**
  * Update voices on a MIDI channel after all MIDI controllers have been changed.
+ * Like fluid_synth_modulate_voices_LOCAL(), this only marks the change.
  * @param synth FluidSynth instance
  * @param chan MIDI channel number (0 to MIDI channel count - 1)
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
  */
 static int
 fluid_synth_modulate_voices_all_LOCAL(fluid_synth_t *synth, int chan)
+{
+    fluid_channel_t *channel = synth->channel[chan];
+
+    channel->modulate_pending_all = TRUE;
+    channel->modulate_stamp = ++synth->modulate_stamp;
+    fluid_atomic_int_set(&synth->modulate_pending, TRUE);
+
+    return FLUID_OK;
+}
+
+/*
+ * Applies the controller changes marked by fluid_synth_modulate_voices_LOCAL() and
+ * fluid_synth_modulate_voices_all_LOCAL() to the voices, in one pass over them.
+ * Voices started after the latest change of their channel are skipped, they have
+ * been set up with the current controller values already.
+ */
+static void
+fluid_synth_apply_modulations_LOCAL(fluid_synth_t *synth)
 {
     fluid_voice_t *voice;
-    int i;
+    fluid_channel_t *channel;
+    uint32_t pending;
+    int i, chan, word, bit;
 
-    for(i = 0; i < synth->polyphony; i++)
+    fluid_atomic_int_set(&synth->modulate_pending, FALSE);
+
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
     {
         voice = synth->voice[i];
+        chan = fluid_voice_get_channel(voice);
 
-        if(fluid_voice_get_channel(voice) == chan)
+        /* voices allocated for a noteon not started yet get the current values on start */
+        if(chan < 0 || chan >= synth->midi_channels || !fluid_voice_is_playing(voice))
+        {
+            continue;
+        }
+
+        channel = synth->channel[chan];
+
+        if((int)(voice->modulate_stamp - channel->modulate_stamp) >= 0)
+        {
+            continue;
+        }
+
+        if(channel->modulate_pending_all)
         {
             fluid_voice_modulate_all(voice);
+            continue;
+        }
+
+        for(word = 0; word < 8; word++)
+        {
+            for(pending = channel->modulate_pending[word]; pending != 0; pending &= pending - 1)
+            {
+                for(bit = 0; !(pending & ((uint32_t)1 << bit)); bit++)
+                {
+                }
+
+                bit += word << 5;
+                fluid_voice_modulate(voice, bit < 128, bit & 0x7F);
+            }
         }
     }
 
-    return FLUID_OK;
+    for(chan = fluid_synth_next_channel(synth, 0); chan < synth->midi_channels; chan = fluid_synth_next_channel(synth, chan + 1))
+    {
+        channel = synth->channel[chan];
+        FLUID_MEMSET(channel->modulate_pending, 0, sizeof(channel->modulate_pending));
+        channel->modulate_pending_all = FALSE;
+    }
+}
+
+/*
+ * Applies the controller changes waiting for the next block before the voices are ranked
+ * for stealing: their overflow priorities depend on the attenuation modulated by CC 7 and 11.
+ */
+void
+fluid_synth_apply_modulations_before_kill_LOCAL(fluid_synth_t *synth)
+{
+    if(fluid_atomic_int_get(&synth->modulate_pending))
+    {
+        fluid_synth_apply_modulations_LOCAL(synth);
+    }
+}
+
+/*
+ * Applies the controller changes waiting for the next block, unless another thread
+ * holds the API lock: then they are applied before a later block.
+ */
+static void
+fluid_synth_apply_modulations(fluid_synth_t *synth)
+{
+    if(!fluid_atomic_int_get(&synth->modulate_pending))
+    {
+        return;
+    }
+
+    if(!fluid_synth_api_try_enter(synth))
+    {
+        return;
+    }
+
+    fluid_synth_apply_modulations_LOCAL(synth);
+    fluid_synth_api_exit(synth);
 }
 
 /**
@@ -3064,13 +4134,12 @@ static int
 fluid_synth_update_key_pressure_LOCAL(fluid_synth_t *synth, int chan, int key)
 {
     fluid_voice_t *voice;
-    int i;
     int result = FLUID_OK;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = FLUID_SYNTH_NOTE_VOICES(synth, chan, key);
+            voice != NULL && voice->index < synth->polyphony;
+            voice = voice->list_next[FLUID_VOICE_LIST_NOTE])
     {
-        voice = synth->voice[i];
-
         if(voice->chan == chan && voice->key == key)
         {
             result = fluid_voice_modulate(voice, 0, FLUID_MOD_KEYPRESSURE);
@@ -3097,10 +4166,22 @@ fluid_synth_pitch_bend(fluid_synth_t *synth, int chan, int val)
 {
     int result;
     fluid_return_val_if_fail(val >= 0 && val <= 16383, FLUID_FAILED);
+    FLUID_API_QUEUE_CHAN(FLUID_SYNTH_CALL_PITCH_BEND, val, 0);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
+    result = fluid_synth_pitch_bend_LOCAL(synth, chan, val);
+    FLUID_API_RETURN(result);
+}
+
+/* fluid_synth_pitch_bend() after entering the API */
+static int
+fluid_synth_pitch_bend_LOCAL(fluid_synth_t *synth, int chan, int val)
+{
     /* Allowed only on MIDI channel enabled */
-    FLUID_API_RETURN_IF_CHAN_DISABLED(FLUID_FAILED);
+    if(!fluid_synth_chan_enabled_LOCAL(synth, chan))
+    {
+        return FLUID_FAILED;
+    }
 
     if(synth->verbose)
     {
@@ -3108,9 +4189,7 @@ fluid_synth_pitch_bend(fluid_synth_t *synth, int chan, int val)
     }
 
     fluid_channel_set_pitch_bend(synth->channel[chan], val);
-    result = fluid_synth_update_pitch_bend_LOCAL(synth, chan);
-
-    FLUID_API_RETURN(result);
+    return fluid_synth_update_pitch_bend_LOCAL(synth, chan);
 }
 
 /* Local synthesis thread variant of pitch bend */
@@ -3275,17 +4354,51 @@ fluid_synth_get_preset_by_sfont_name(fluid_synth_t *synth, const char *sfontname
     return NULL;
 }
 
+/* Forgets the presets found by fluid_synth_find_preset(). Called whenever the SoundFonts
+ * of the synth or their bank offsets change, the bank select style is checked by the lookup.
+ */
+static void
+fluid_synth_clear_preset_cache(fluid_synth_t *synth)
+{
+    int i;
+
+    for(i = 0; i < FLUID_SYNTH_PRESET_CACHE_SIZE; i++)
+    {
+        synth->preset_cache[i].prognum = -1;
+    }
+
+    synth->preset_cache_bank_select = synth->bank_select;
+}
+
 /* Find a preset by bank and program numbers.
  * Returns preset pointer or NULL.
+ *
+ * The result, even NULL, is cached: the search asks every SoundFont from the first one on,
+ * which is what a program change costs with many SoundFonts loaded.
  */
 fluid_preset_t *
 fluid_synth_find_preset(fluid_synth_t *synth, int banknum,
                         int prognum)
 {
-    fluid_preset_t *preset;
+    fluid_synth_preset_cache_t *entry;
+    fluid_preset_t *preset = NULL;
     fluid_sfont_t *sfont;
     fluid_list_t *list;
 
+    /* the banks of some presets depend on the bank select style, see fluid_dls.cpp */
+    if(synth->preset_cache_bank_select != synth->bank_select)
+    {
+        fluid_synth_clear_preset_cache(synth);
+    }
+
+    entry = &synth->preset_cache[((unsigned int)banknum * 131u + (unsigned int)prognum)
+                                 & (FLUID_SYNTH_PRESET_CACHE_SIZE - 1)];
+
+    if(entry->prognum == prognum && entry->banknum == banknum)
+    {
+        return entry->preset;
+    }
+
     for(list = synth->sfont; list; list = fluid_list_next(list))
     {
         sfont = fluid_list_get(list);
@@ -3294,11 +4407,15 @@ fluid_synth_find_preset(fluid_synth_t *synth, int banknum,
 
         if(preset)
         {
-            return preset;
+            break;
         }
     }
 
-    return NULL;
+    entry->banknum = banknum;
+    entry->prognum = prognum;
+    entry->preset = preset;
+
+    return preset;
 }
 
 /**
@@ -3313,15 +4430,101 @@ fluid_synth_find_preset(fluid_synth_t *synth, int banknum,
 int
 fluid_synth_program_change(fluid_synth_t *synth, int chan, int prognum)
 {
-    fluid_preset_t *preset = NULL;
-    fluid_channel_t *channel;
-    int subst_bank, subst_prog, banknum = 0, result = FLUID_FAILED;
+    int result;
 
     fluid_return_val_if_fail(prognum >= 0 && prognum <= 128, FLUID_FAILED);
+    FLUID_API_QUEUE_CHAN(FLUID_SYNTH_CALL_PROGRAM_CHANGE, prognum, 0);
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
+    result = fluid_synth_program_change_LOCAL(synth, chan, prognum);
+    FLUID_API_RETURN(result);
+}
+
+/*
+ * Finds the preset a program change selects on a channel of the given type, falling back
+ * to another preset if the one of *banknum and *prognum doesn't exist. Stores the bank and
+ * program of the preset found to them.
+ */
+static fluid_preset_t *
+fluid_synth_find_program_preset_LOCAL(fluid_synth_t *synth, int channel_type, int *banknum, int *prognum)
+{
+    fluid_preset_t *preset = fluid_synth_find_preset(synth, *banknum, *prognum);
+
+    /* Fallback to another preset if not found */
+    if(!preset)
+    {
+        /* Percussion: Fallback to preset 0 in percussion bank */
+        if(channel_type == CHANNEL_TYPE_DRUM)
+        {
+            *banknum = DRUM_INST_BANK;
+            preset = fluid_synth_find_preset(synth, *banknum, *prognum);
+            if(!preset)
+            {
+                *prognum = 0;
+                preset = fluid_synth_find_preset(synth, *banknum, *prognum);
+            }
+        }
+        /* Melodic instrument */
+        else
+        {
+            /* Fallback first to bank 0:prognum */
+            *banknum = 0;
+            preset = fluid_synth_find_preset(synth, *banknum, *prognum);
+
+            /* Fallback to first preset in bank 0 (usually piano...) */
+            if(!preset)
+            {
+                *prognum = 0;
+                preset = fluid_synth_find_preset(synth, *banknum, *prognum);
+            }
+        }
+    }
+
+    return preset;
+}
+
+/*
+ * Pins the preset a program change to prognum selects on a channel of the given type with
+ * the bank banknum, see fluid_synth_pin_preset(). Stores the SoundFont ID, bank and program
+ * of the preset pinned, to unpin it with fluid_synth_unpin_preset(). Only used privately by
+ * fluid_player.
+ */
+int
+fluid_synth_pin_program(fluid_synth_t *synth, int channel_type, int banknum, int prognum,
+                        int *sfont_id, int *pinned_bank, int *pinned_prog)
+{
+    fluid_preset_t *preset;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    *pinned_bank = banknum;
+    *pinned_prog = prognum;
+    preset = fluid_synth_find_program_preset_LOCAL(synth, channel_type, pinned_bank, pinned_prog);
+
+    if(preset == NULL)
+    {
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    *sfont_id = fluid_sfont_get_id(preset->sfont);
+
+    FLUID_API_RETURN(fluid_synth_pin_preset(synth, *sfont_id, *pinned_bank, *pinned_prog));
+}
+
+/* fluid_synth_program_change() after entering the API */
+static int
+fluid_synth_program_change_LOCAL(fluid_synth_t *synth, int chan, int prognum)
+{
+    fluid_preset_t *preset = NULL;
+    fluid_channel_t *channel;
+    int subst_bank, subst_prog, banknum = 0;
+
     /* Allowed only on MIDI channel enabled */
-    FLUID_API_RETURN_IF_CHAN_DISABLED(FLUID_FAILED);
+    if(!fluid_synth_chan_enabled_LOCAL(synth, chan))
+    {
+        return FLUID_FAILED;
+    }
 
     channel = synth->channel[chan];
 
@@ -3343,37 +4546,10 @@ fluid_synth_program_change(fluid_synth_t *synth, int chan, int prognum)
         subst_bank = banknum;
         subst_prog = prognum;
 
-        preset = fluid_synth_find_preset(synth, subst_bank, subst_prog);
+        preset = fluid_synth_find_program_preset_LOCAL(synth, channel->channel_type, &subst_bank, &subst_prog);
 
-        /* Fallback to another preset if not found */
-        if(!preset)
+        if(preset == NULL || subst_bank != banknum || subst_prog != prognum)
         {
-            /* Percussion: Fallback to preset 0 in percussion bank */
-            if(channel->channel_type == CHANNEL_TYPE_DRUM)
-            {
-                subst_bank = DRUM_INST_BANK;
-                preset = fluid_synth_find_preset(synth, subst_bank, subst_prog);
-                if(!preset)
-                {
-                    subst_prog = 0;
-                    preset = fluid_synth_find_preset(synth, subst_bank, subst_prog);
-                }
-            }
-            /* Melodic instrument */
-            else
-            {
-                /* Fallback first to bank 0:prognum */
-                subst_bank = 0;
-                preset = fluid_synth_find_preset(synth, subst_bank, subst_prog);
-
-                /* Fallback to first preset in bank 0 (usually piano...) */
-                if(!preset)
-                {
-                    subst_prog = 0;
-                    preset = fluid_synth_find_preset(synth, subst_bank, subst_prog);
-                }
-            }
-
             if(preset)
             {
                 FLUID_LOG(FLUID_WARN, "Instrument not found on channel %d [bank=%d prog=%d], substituted [bank=%d prog=%d]",
@@ -3389,9 +4565,7 @@ fluid_synth_program_change(fluid_synth_t *synth, int chan, int prognum)
     /* Assign the SoundFont ID and program number to the channel */
     fluid_channel_set_sfont_bank_prog(channel, preset ? fluid_sfont_get_id(preset->sfont) : 0,
                                       -1, prognum);
-    result = fluid_synth_set_preset(synth, chan, preset);
-
-    FLUID_API_RETURN(result);
+    return fluid_synth_set_preset(synth, chan, preset);
 }
 
 /**
@@ -3640,70 +4814,289 @@ fluid_synth_unpin_preset(fluid_synth_t *synth, int sfont_id, int bank_num, int p
         FLUID_API_RETURN(FLUID_FAILED);
     }
 
+    /* the samples of the preset may be unloaded now */
+    fluid_synth_join_warmups(synth, fluid_preset_get_sfont(preset), FALSE);
+
     ret = fluid_preset_notify(preset, FLUID_PRESET_UNPIN, -1); // channel unused for pinning messages
 
     FLUID_API_RETURN(ret);
 }
 
 /**
- * Select an instrument on a MIDI channel by SoundFont name, bank and program numbers.
+ * Checks if the samples of the given preset have been loaded.
+ *
  * @param synth FluidSynth instance
- * @param chan MIDI channel number (0 to MIDI channel count - 1)
- * @param sfont_name Name of a loaded SoundFont
+ * @param sfont_id ID of a loaded SoundFont
  * @param bank_num MIDI bank number
  * @param preset_num MIDI program number
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise
- * @since 1.1.0
+ * @return TRUE if no sample of the preset is still being loaded, FALSE if some are,
+ * #FLUID_FAILED if the preset was not found
+ *
+ * With \ref settings_synth_dynamic-sample-loading-async enabled, the samples of a
+ * preset selected on a MIDI channel are loaded in the background, and notes using
+ * samples that haven't been loaded yet are not played. Applications can use this
+ * function after a program change to find out when the preset is ready to play.
+ * Alternatively, fluid_synth_pin_preset() loads the samples of a preset ahead of
+ * time and returns when all of them have been loaded.
+ *
+ * @note Samples of presets that are neither selected nor pinned are not loaded at all,
+ * this function returns TRUE for them.
+ *
+ * @since 2.6.0
  */
 int
-fluid_synth_program_select_by_sfont_name(fluid_synth_t *synth, int chan,
-        const char *sfont_name, int bank_num,
-        int preset_num)
+fluid_synth_is_preset_loaded(fluid_synth_t *synth, int sfont_id, int bank_num, int preset_num)
 {
-    fluid_preset_t *preset = NULL;
-    fluid_channel_t *channel;
-    int result;
-    fluid_return_val_if_fail(sfont_name != NULL, FLUID_FAILED);
-    FLUID_API_ENTRY_CHAN(FLUID_FAILED);
+    int ret;
+    fluid_preset_t *preset;
 
-    /* Allowed only on MIDI channel enabled */
-    FLUID_API_RETURN_IF_CHAN_DISABLED(FLUID_FAILED);
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(bank_num >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(preset_num >= 0, FLUID_FAILED);
 
-    channel = synth->channel[chan];
+    fluid_synth_api_enter(synth);
 
-    preset = fluid_synth_get_preset_by_sfont_name(synth, sfont_name, bank_num,
-             preset_num);
+    preset = fluid_synth_get_preset(synth, sfont_id, bank_num, preset_num);
 
     if(preset == NULL)
     {
         FLUID_LOG(FLUID_ERR,
-                  "There is no preset with bank number %d and preset number %d in SoundFont %s",
-                  bank_num, preset_num, sfont_name);
+                  "There is no preset with bank number %d and preset number %d in SoundFont %d",
+                  bank_num, preset_num, sfont_id);
         FLUID_API_RETURN(FLUID_FAILED);
     }
 
-    /* Assign the new SoundFont ID, bank and program number to the channel */
-    fluid_channel_set_sfont_bank_prog(channel, fluid_sfont_get_id(preset->sfont),
-                                      bank_num, preset_num);
-    result = fluid_synth_set_preset(synth, chan, preset);
+    ret = (fluid_preset_notify(preset, FLUID_PRESET_IS_LOADED, -1) == FLUID_OK);
 
-    FLUID_API_RETURN(result);
+    FLUID_API_RETURN(ret);
 }
 
-/*
- * This function assures that every MIDI channel has a valid preset
- * (NULL is okay). This function is called after a SoundFont is
- * unloaded or reloaded.
- */
-static void
-fluid_synth_update_presets(fluid_synth_t *synth)
+/* Warms up the presets of a warm-up in its background thread */
+static fluid_thread_return_t
+fluid_synth_warmup_run(void *data)
 {
-    fluid_channel_t *channel;
-    fluid_preset_t *preset;
+    fluid_synth_warmup_t *warmup = data;
+    fluid_list_t *list;
+    int status = FLUID_OK;
+
+    for(list = warmup->presets; list; list = fluid_list_next(list))
+    {
+        if(fluid_preset_notify((fluid_preset_t *)fluid_list_get(list), FLUID_PRESET_WARM, -1) != FLUID_OK)
+        {
+            status = FLUID_FAILED;
+        }
+    }
+
+    if(warmup->callback != NULL)
+    {
+        warmup->callback(warmup->data, warmup->sfont_id, warmup->bank_num, warmup->preset_num, status);
+    }
+
+    fluid_atomic_int_set(&warmup->done, TRUE);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/*
+ * Waits for the warm-ups of the SoundFont to finish, of all SoundFonts if sfont is NULL,
+ * and frees them. If finished_only is set, only the finished warm-ups are freed.
+ */
+static void
+fluid_synth_join_warmups(fluid_synth_t *synth, fluid_sfont_t *sfont, int finished_only)
+{
+    fluid_list_t *list, *next;
+    fluid_synth_warmup_t *warmup;
+
+    for(list = synth->warmups; list; list = next)
+    {
+        next = fluid_list_next(list);
+        warmup = fluid_list_get(list);
+
+        if((sfont != NULL && warmup->sfont != sfont)
+                || (finished_only && !fluid_atomic_int_get(&warmup->done)))
+        {
+            continue;
+        }
+
+        fluid_thread_join(warmup->thread);
+        delete_fluid_thread(warmup->thread);
+        delete_fluid_list(warmup->presets);
+        FLUID_FREE(warmup);
+        synth->warmups = fluid_list_remove_link(synth->warmups, list);
+        delete1_fluid_list(list);
+    }
+}
+
+/**
+ * Pages in the memory used by a preset in a background thread, so that its first notes
+ * don't wait for page faults.
+ *
+ * @param synth FluidSynth instance
+ * @param sfont_id ID of a loaded SoundFont
+ * @param bank_num MIDI bank number, -1 together with @p preset_num to warm up all presets
+ *   of the SoundFont
+ * @param preset_num MIDI program number, or -1
+ * @param callback Called from the background thread when the warm-up has finished, may be NULL
+ * @param data User data passed to @p callback
+ * @return #FLUID_OK if the warm-up has been started, #FLUID_FAILED otherwise
+ *
+ * Even once a SoundFont has been loaded, its sample data may still have to be read from the
+ * disk when it is played first, e.g. with \ref settings_synth_sample-mmap or
+ * \ref settings_synth_sample-streaming, or after the operating system has swapped it out.
+ * The page faults then stall the audio thread. This function reads all the memory a noteon
+ * of the preset accesses, i.e. its zones and the data of their samples, ahead of time and,
+ * if \ref settings_synth_lock-memory is enabled, pins the sample data to RAM. Of streamed
+ * samples, only the preloaded part is read.
+ *
+ * @p callback receives @p data, @p sfont_id, @p bank_num, @p preset_num and #FLUID_OK if
+ * all presets have been warmed up, #FLUID_FAILED otherwise. It must not call
+ * fluid_synth_sfunload(), fluid_synth_unpin_preset() or delete_fluid_synth(), which wait for
+ * the warm-ups of the SoundFont to finish.
+ *
+ * @note Only presets loaded with the default SoundFont loader are warmed up, others are
+ * reported as warmed up right away. With \ref settings_synth_dynamic-sample-loading enabled,
+ * only presets pinned by fluid_synth_pin_preset() can be warmed up, as the samples of others
+ * may be unloaded at any time.
+ *
+ * @since 2.6.0
+ */
+int
+fluid_synth_warm_preset(fluid_synth_t *synth, int sfont_id, int bank_num, int preset_num,
+                        fluid_warm_callback_t callback, void *data)
+{
+    fluid_synth_warmup_t *warmup;
+    fluid_preset_t *preset;
+    fluid_sfont_t *sfont;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail((bank_num >= 0 && preset_num >= 0) || (bank_num == -1 && preset_num == -1), FLUID_FAILED);
+
+    fluid_synth_api_enter(synth);
+
+    fluid_synth_join_warmups(synth, NULL, TRUE);
+
+    sfont = fluid_synth_get_sfont_by_id(synth, sfont_id);
+
+    if(sfont == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "No SoundFont with id = %d", sfont_id);
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    warmup = FLUID_NEW(fluid_synth_warmup_t);
+
+    if(warmup == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    FLUID_MEMSET(warmup, 0, sizeof(*warmup));
+    warmup->sfont = sfont;
+    warmup->sfont_id = sfont_id;
+    warmup->bank_num = bank_num;
+    warmup->preset_num = preset_num;
+    warmup->callback = callback;
+    warmup->data = data;
+
+    if(bank_num == -1)
+    {
+        fluid_sfont_iteration_start(sfont);
+
+        while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+        {
+            warmup->presets = fluid_list_prepend(warmup->presets, preset);
+        }
+    }
+    else
+    {
+        preset = fluid_sfont_get_preset(sfont, bank_num, preset_num);
+
+        if(preset == NULL)
+        {
+            FLUID_LOG(FLUID_ERR,
+                      "There is no preset with bank number %d and preset number %d in SoundFont %d",
+                      bank_num, preset_num, sfont_id);
+            FLUID_FREE(warmup);
+            FLUID_API_RETURN(FLUID_FAILED);
+        }
+
+        warmup->presets = fluid_list_prepend(NULL, preset);
+    }
+
+    warmup->thread = new_fluid_thread("warmup", fluid_synth_warmup_run, warmup, 0, FALSE);
+
+    if(warmup->thread == NULL)
+    {
+        delete_fluid_list(warmup->presets);
+        FLUID_FREE(warmup);
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    synth->warmups = fluid_list_prepend(synth->warmups, warmup);
+
+    FLUID_API_RETURN(FLUID_OK);
+}
+
+/**
+ * Select an instrument on a MIDI channel by SoundFont name, bank and program numbers.
+ * @param synth FluidSynth instance
+ * @param chan MIDI channel number (0 to MIDI channel count - 1)
+ * @param sfont_name Name of a loaded SoundFont
+ * @param bank_num MIDI bank number
+ * @param preset_num MIDI program number
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @since 1.1.0
+ */
+int
+fluid_synth_program_select_by_sfont_name(fluid_synth_t *synth, int chan,
+        const char *sfont_name, int bank_num,
+        int preset_num)
+{
+    fluid_preset_t *preset = NULL;
+    fluid_channel_t *channel;
+    int result;
+    fluid_return_val_if_fail(sfont_name != NULL, FLUID_FAILED);
+    FLUID_API_ENTRY_CHAN(FLUID_FAILED);
+
+    /* Allowed only on MIDI channel enabled */
+    FLUID_API_RETURN_IF_CHAN_DISABLED(FLUID_FAILED);
+
+    channel = synth->channel[chan];
+
+    preset = fluid_synth_get_preset_by_sfont_name(synth, sfont_name, bank_num,
+             preset_num);
+
+    if(preset == NULL)
+    {
+        FLUID_LOG(FLUID_ERR,
+                  "There is no preset with bank number %d and preset number %d in SoundFont %s",
+                  bank_num, preset_num, sfont_name);
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    /* Assign the new SoundFont ID, bank and program number to the channel */
+    fluid_channel_set_sfont_bank_prog(channel, fluid_sfont_get_id(preset->sfont),
+                                      bank_num, preset_num);
+    result = fluid_synth_set_preset(synth, chan, preset);
+
+    FLUID_API_RETURN(result);
+}
+
+/*
+ * This function assures that every MIDI channel has a valid preset
+ * (NULL is okay). This function is called after a SoundFont is
+ * unloaded or reloaded.
+ */
+static void
+fluid_synth_update_presets(fluid_synth_t *synth)
+{
+    fluid_channel_t *channel;
+    fluid_preset_t *preset;
     int sfont, bank, prog;
     int chan;
 
-    for(chan = 0; chan < synth->midi_channels; chan++)
+    for(chan = fluid_synth_next_channel(synth, 0); chan < synth->midi_channels; chan = fluid_synth_next_channel(synth, chan + 1))
     {
         channel = synth->channel[chan];
         fluid_channel_get_sfont_bank_prog(channel, &sfont, &bank, &prog);
@@ -3721,7 +5114,7 @@ fluid_synth_set_sample_rate_LOCAL(fluid_synth_t *synth, float sample_rate)
 
     synth->min_note_length_ticks = fluid_synth_get_min_note_length_LOCAL(synth);
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
     {
         fluid_voice_set_output_rate(synth->voice[i], sample_rate);
     }
@@ -3766,9 +5159,26 @@ void
 fluid_synth_set_sample_rate_immediately(fluid_synth_t *synth, float sample_rate)
 {
     fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+    double render_rate;
     fluid_return_if_fail(synth != NULL);
     fluid_synth_api_enter(synth);
 
+    fluid_settings_getnum(synth->settings, "synth.render-rate", &render_rate);
+    fluid_clip(sample_rate, 8000.0f, 96000.0f);
+    synth->output_rate = sample_rate;
+
+    /* with a render rate, only the resampler follows the rate of the driver */
+    if(render_rate > 0)
+    {
+        if(fluid_synth_update_resampler(synth) != FLUID_OK)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to resample the output to %.0f Hz", synth->output_rate);
+        }
+
+        fluid_synth_api_exit(synth);
+        return;
+    }
+
     fluid_synth_set_sample_rate_LOCAL(synth, sample_rate);
 
     param[0].i = 0;
@@ -3778,6 +5188,27 @@ fluid_synth_set_sample_rate_immediately(fluid_synth_t *synth, float sample_rate)
     fluid_synth_api_exit(synth);
 }
 
+// internal function for the coreaudio driver: hands over the audio workgroup of the
+// output device (an os_workgroup_t reference) for the extra mixer threads to join,
+// NULL to let them leave it again. Safe to call while rendering.
+void
+fluid_synth_set_workgroup(fluid_synth_t *synth, void *workgroup)
+{
+    fluid_return_if_fail(synth != NULL);
+
+    fluid_rvoice_mixer_set_workgroup(synth->eventhandler->mixer, workgroup);
+}
+
+// internal function for the audio drivers: the output latency in usec of the audio driver
+// created for the synth, added to the note latencies. Safe to call while rendering.
+void
+fluid_synth_set_output_latency(fluid_synth_t *synth, double usec)
+{
+    fluid_return_if_fail(synth != NULL);
+
+    fluid_atomic_int_set(&synth->output_latency, (usec > 0.0) ? (int)usec : 0);
+}
+
 
 /* Handler for synth.gain setting. */
 static void
@@ -3815,7 +5246,7 @@ fluid_synth_update_gain_LOCAL(fluid_synth_t *synth)
 
     gain = synth->gain;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
     {
         voice = synth->voice[i];
 
@@ -3873,42 +5304,96 @@ fluid_synth_set_polyphony(fluid_synth_t *synth, int polyphony)
 }
 
 /* Called by synthesis thread to update the polyphony value */
+/*
+ * Creates voices until there are at least count of them, but not more than the polyphony
+ * in low memory mode. Voices created before a failure are kept.
+ */
 static int
-fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
+fluid_synth_add_voices_LOCAL(fluid_synth_t *synth, int count)
 {
+    fluid_voice_t **new_voices;
+    fluid_sample_t **new_released;
     fluid_voice_t *voice;
-    int i;
 
-    if(new_polyphony > synth->nvoice)
+    if(synth->low_memory && count > synth->polyphony)
+    {
+        count = synth->polyphony;
+    }
+
+    if(count <= synth->nvoice)
+    {
+        return FLUID_OK;
+    }
+
+    new_voices = FLUID_REALLOC(synth->voice, sizeof(fluid_voice_t *) * count);
+
+    if(new_voices == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    synth->voice = new_voices;
+
+    /* each voice holds up to two samples, see fluid_synth_release_sample_LOCAL() */
+    new_released = FLUID_REALLOC(synth->released_samples, sizeof(fluid_sample_t *) * 2 * count);
+
+    if(new_released == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    synth->released_samples = new_released;
+    synth->released_size = 2 * count;
+
+    while(synth->nvoice < count)
     {
-        /* Create more voices */
-        fluid_voice_t **new_voices = FLUID_REALLOC(synth->voice,
-                                     sizeof(fluid_voice_t *) * new_polyphony);
+        voice = new_fluid_voice(synth->eventhandler, synth->sample_rate, synth->iir_sincos_table, synth->stream);
 
-        if(new_voices == NULL)
+        if(voice == NULL)
         {
             return FLUID_FAILED;
         }
 
-        synth->voice = new_voices;
+        voice->index = synth->nvoice;
+        fluid_voice_set_custom_filter(voice, synth->custom_filter_type, synth->custom_filter_flags);
+        synth->voice[synth->nvoice++] = voice;
+    }
 
-        for(i = synth->nvoice; i < new_polyphony; i++)
-        {
-            synth->voice[i] = new_fluid_voice(synth->eventhandler, synth->sample_rate, synth->iir_sincos_table);
+    /* the new voices are available */
+    fluid_synth_invalidate_overflow_prio_LOCAL(synth);
 
-            if(synth->voice[i] == NULL)
-            {
-                return FLUID_FAILED;
-            }
+    return FLUID_OK;
+}
 
-            fluid_voice_set_custom_filter(synth->voice[i], synth->custom_filter_type, synth->custom_filter_flags);
-        }
+static int
+fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
+{
+    fluid_voice_t *voice;
+    fluid_overflow_tree_t *overflow_tree;
+    int i;
 
-        synth->nvoice = new_polyphony;
+    overflow_tree = new_fluid_overflow_tree(new_polyphony);
+
+    if(overflow_tree == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* Create more voices, in low memory mode they are created once they are needed */
+    if(!synth->low_memory && fluid_synth_add_voices_LOCAL(synth, new_polyphony) != FLUID_OK)
+    {
+        delete_fluid_overflow_tree(overflow_tree);
+        return FLUID_FAILED;
     }
 
     synth->polyphony = new_polyphony;
 
+    delete_fluid_overflow_tree(synth->overflow_tree);
+    synth->overflow_tree = overflow_tree;
+    fluid_synth_invalidate_overflow_prio_LOCAL(synth);
+
     /* turn off any voices above the new limit */
     for(i = synth->polyphony; i < synth->nvoice; i++)
     {
@@ -3920,10 +5405,7 @@ fluid_synth_update_polyphony_LOCAL(fluid_synth_t *synth, int new_polyphony)
         }
     }
 
-    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_set_polyphony,
-                             synth->polyphony, 0.0f);
-
-    return FLUID_OK;
+    return fluid_rvoice_mixer_push_polyphony(synth->eventhandler->mixer, synth->polyphony);
 }
 
 /**
@@ -3973,849 +5455,1553 @@ fluid_synth_get_active_voice_count(fluid_synth_t *synth)
 }
 
 /**
- * Get the internal synthesis buffer size value.
+ * Get the voice counters of a MIDI channel or of the whole synth.
  * @param synth FluidSynth instance
- * @return Internal buffer size in audio frames.
+ * @param chan MIDI channel number (0 to MIDI channel count - 1), or -1 for all channels
+ * @param counters Receives the counters
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @since 2.6.0
  *
- * Audio is synthesized at this number of frames at a time. Defaults to 64 frames. I.e. the synth can only react to notes,
- * control changes, and other audio affecting events after having processed 64 audio frames.
+ * The counters are always kept, since the synth was created or last reset by
+ * fluid_synth_reset_voice_counters(). Every voice started is eventually counted either as
+ * stolen or as finished, so that the voices started minus those two are still active.
+ * Voices killed by an exclusive class are counted as finished as well once they have ended.
+ *
+ * The counters are read without locking the synth, this function may be called from any
+ * thread at any time, e.g. while the synth renders.
  */
 int
-fluid_synth_get_internal_bufsize(fluid_synth_t *synth)
+fluid_synth_get_voice_counters(fluid_synth_t *synth, int chan, fluid_voice_counters_t *counters)
 {
-    return FLUID_BUFSIZE;
+    fluid_atomic_int_t *c;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(counters != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(chan >= -1 && chan < synth->midi_channels, FLUID_FAILED);
+
+    c = synth->voice_counters[(chan < 0) ? synth->midi_channels : chan];
+
+    counters->started = fluid_atomic_int_get(&c[FLUID_VOICE_COUNT_STARTED]);
+    counters->stolen = fluid_atomic_int_get(&c[FLUID_VOICE_COUNT_STOLEN]);
+    counters->killed_exclusive = fluid_atomic_int_get(&c[FLUID_VOICE_COUNT_KILLED_EXCLUSIVE]);
+    counters->finished = fluid_atomic_int_get(&c[FLUID_VOICE_COUNT_FINISHED]);
+    counters->dropped = fluid_atomic_int_get(&c[FLUID_VOICE_COUNT_DROPPED]);
+    counters->peak = fluid_atomic_int_get(&c[FLUID_VOICE_COUNT_PEAK]);
+
+    return FLUID_OK;
 }
 
 /**
- * Resend a bank select and a program change for every channel and assign corresponding instruments.
+ * Reset the voice counters of all MIDI channels and of the whole synth.
+ * @param synth FluidSynth instance
+ * @since 2.6.0
+ *
+ * May be called from any thread, events counted by the synth at the same time may be lost.
+ */
+void
+fluid_synth_reset_voice_counters(fluid_synth_t *synth)
+{
+    int i, counter;
+
+    fluid_return_if_fail(synth != NULL);
+
+    for(i = 0; i <= synth->midi_channels; i++)
+    {
+        for(counter = 0; counter < FLUID_VOICE_COUNT_ACTIVE; counter++)
+        {
+            fluid_atomic_int_set(&synth->voice_counters[i][counter], 0);
+        }
+    }
+}
+
+/**
+ * Limit the voices of a MIDI channel.
  * @param synth FluidSynth instance
+ * @param chan MIDI channel number (0 to MIDI channel count - 1)
+ * @param polyphony Maximum number of voices playing on the channel, 0 for no limit
+ * @param cost_budget Maximum summed rendering cost of the voices playing on the channel, 0 for no limit.
+ *   A voice rendered with #FLUID_INTERP_4THORDER costs 1.0, one with #FLUID_INTERP_LINEAR 0.6,
+ *   #FLUID_INTERP_7THORDER 1.8 and #FLUID_INTERP_16THORDER 4.5.
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @since 2.6.0
  *
- * This function is called mainly after a SoundFont has been loaded,
- * unloaded or reloaded.
+ * A channel reaching one of its limits steals from its own voices, by the same priorities
+ * as when \setting{synth_polyphony} is exceeded (see \setting{synth_overflow_age} and the
+ * other overflow scores), instead of taking voices from other channels. This bounds the
+ * share of the voices and of the CPU time a single channel, e.g. a sustained pad, can take.
+ * The voices of the noteon being started are never stolen, the noteon fails if the others
+ * don't make enough room. Lowering the limits doesn't stop the voices already playing, the
+ * next noteons on the channel do. The limits are kept across MIDI resets.
  */
 int
-fluid_synth_program_reset(fluid_synth_t *synth)
+fluid_synth_set_channel_polyphony(fluid_synth_t *synth, int chan, int polyphony, double cost_budget)
 {
-    int i, prog;
-    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
-    fluid_synth_api_enter(synth);
+    fluid_return_val_if_fail(polyphony >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(cost_budget >= 0, FLUID_FAILED);
+    FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
-    /* try to set the correct presets */
-    for(i = 0; i < synth->midi_channels; i++)
+    synth->channel[chan]->polyphony = polyphony;
+    synth->channel[chan]->cost_budget = (int)(cost_budget * FLUID_RVOICE_COST_DEFAULT + 0.5);
+
+    if(cost_budget > 0 && synth->channel[chan]->cost_budget == 0)
     {
-        fluid_channel_get_sfont_bank_prog(synth->channel[i], NULL, NULL, &prog);
-        fluid_synth_program_change(synth, i, prog);
+        synth->channel[chan]->cost_budget = 1;
     }
 
     FLUID_API_RETURN(FLUID_OK);
 }
 
 /**
- * Synthesize a block of floating point audio to separate audio buffers (multi-channel rendering).
- *
+ * Get the limits of the voices of a MIDI channel.
  * @param synth FluidSynth instance
- * @param len Count of audio frames to synthesize
- * @param left Array of float buffers to store left channel of planar audio (as many as \c synth.audio-channels buffers, each of \c len in size)
- * @param right Array of float buffers to store right channel of planar audio (size: ditto)
- * @param fx_left Since 1.1.7: If not \c NULL, array of float buffers to store left effect channels (as many as \c synth.effects-channels buffers, each of \c len in size)
- * @param fx_right Since 1.1.7: If not \c NULL, array of float buffers to store right effect channels (size: ditto)
+ * @param chan MIDI channel number (0 to MIDI channel count - 1)
+ * @param polyphony Location to store the maximum number of voices, 0 for no limit
+ * @param cost_budget Location to store the maximum summed cost of the voices, 0 for no limit
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @since 2.6.0
  *
- * First effect channel used by reverb, second for chorus.
- *
- * @note Should only be called from synthesis thread.
- *
- * @deprecated fluid_synth_nwrite_float() is deprecated and will be removed in a future release.
- * It may continue to work or it may return #FLUID_FAILED in the future. Consider using the more
- * powerful and flexible fluid_synth_process().
- *
- * Usage example:
- * @code{.cpp}
-    const int FramesToRender = 64;
-    int channels;
-    // retrieve number of stereo audio channels
-    fluid_settings_getint(settings, "synth.audio-channels", &channels);
-
-    // we need twice as many (mono-)buffers
-    channels *= 2;
-
-    // fluid_synth_nwrite_float renders planar audio, e.g. if synth.audio-channels==16:
-    // each midi channel gets rendered to its own stereo buffer, rather than having
-    // one buffer and interleaved PCM
-    float** mix_buf = new float*[channels];
-    for(int i = 0; i < channels; i++)
-    {
-        mix_buf[i] = new float[FramesToRender];
-    }
-
-    // retrieve number of (stereo) effect channels (internally hardcoded to reverb (first chan)
-    // and chrous (second chan))
-    fluid_settings_getint(settings, "synth.effects-channels", &channels);
-    channels *= 2;
-
-    float** fx_buf = new float*[channels];
-    for(int i = 0; i < channels; i++)
-    {
-        fx_buf[i] = new float[FramesToRender];
-    }
-
-    float** mix_buf_l = mix_buf;
-    float** mix_buf_r = &mix_buf[channels/2];
-
-    float** fx_buf_l = fx_buf;
-    float** fx_buf_r = &fx_buf[channels/2];
-
-    fluid_synth_nwrite_float(synth, FramesToRender, mix_buf_l, mix_buf_r, fx_buf_l, fx_buf_r)
- * @endcode
+ * See fluid_synth_set_channel_polyphony().
  */
 int
-fluid_synth_nwrite_float(fluid_synth_t *synth, int len,
-                         float **left, float **right,
-                         float **fx_left, float **fx_right)
+fluid_synth_get_channel_polyphony(fluid_synth_t *synth, int chan, int *polyphony, double *cost_budget)
 {
-    fluid_real_t *left_in, *fx_left_in;
-    fluid_real_t *right_in, *fx_right_in;
-    double time = fluid_utime();
-    int i, num, available, count;
-#ifdef WITH_FLOAT
-    int bytes;
-#endif
-    float cpu_load;
-
-    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
-    fluid_return_val_if_fail(left != NULL, FLUID_FAILED);
-    fluid_return_val_if_fail(right != NULL, FLUID_FAILED);
-    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
-    fluid_return_val_if_fail(len != 0, FLUID_OK); // to avoid raising FE_DIVBYZERO below
+    fluid_return_val_if_fail(polyphony != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(cost_budget != NULL, FLUID_FAILED);
+    FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
-    /* First, take what's still available in the buffer */
-    count = 0;
-    num = synth->cur;
+    *polyphony = synth->channel[chan]->polyphony;
+    *cost_budget = (double)synth->channel[chan]->cost_budget / FLUID_RVOICE_COST_DEFAULT;
 
-    if(synth->cur < FLUID_BUFSIZE)
-    {
-        available = FLUID_BUFSIZE - synth->cur;
-        fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
-        fluid_rvoice_mixer_get_fx_bufs(synth->eventhandler->mixer, &fx_left_in, &fx_right_in);
+    FLUID_API_RETURN(FLUID_OK);
+}
 
-        num = (available > len) ? len : available;
-#ifdef WITH_FLOAT
-        bytes = num * sizeof(float);
-#endif
+/**
+ * Get the internal synthesis buffer size value.
+ * @param synth FluidSynth instance
+ * @return Internal buffer size in audio frames.
+ *
+ * Audio is synthesized at this number of frames at a time. Defaults to 64 frames. I.e. the synth can only react to notes,
+ * control changes, and other audio affecting events after having processed 64 audio frames.
+ * The value is fixed at build time by the \c fluid-bufsize CMake option (a power of two from 16 to 512).
+ * Small blocks suit live use with short audio periods, large blocks amortize the per-block overhead
+ * of envelopes, modulators and the effects when rendering offline. Audio drivers whose period size is
+ * a multiple of it render the same number of blocks every period.
+ */
+int
+fluid_synth_get_internal_bufsize(fluid_synth_t *synth)
+{
+    return FLUID_BUFSIZE;
+}
 
-        for(i = 0; i < synth->audio_channels; i++)
-        {
-#ifdef WITH_FLOAT
-            FLUID_MEMCPY(left[i], &left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + synth->cur], bytes);
-            FLUID_MEMCPY(right[i], &right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + synth->cur], bytes);
-#else //WITH_FLOAT
-            int j;
+/* Handler for synth.perf-stats setting. */
+static void
+fluid_synth_handle_perf_stats(void *data, const char *name, int value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_atomic_int_set(&synth->perf->enabled, value);
+}
 
-            for(j = 0; j < num; j++)
-            {
-                left[i][j] = (float) left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j + synth->cur];
-                right[i][j] = (float) right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j + synth->cur];
-            }
+/* Handler for synth.cpu-accounting setting. */
+static void
+fluid_synth_handle_cpu_accounting(void *data, const char *name, int value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
 
-#endif //WITH_FLOAT
-        }
+    fluid_synth_api_enter(synth);
+    fluid_perf_set_accounting(synth->perf, value);
+    fluid_synth_api_exit(synth);
+}
 
-        for(i = 0; i < synth->effects_channels; i++)
-        {
-#ifdef WITH_FLOAT
+/* Handler for synth.voice-snapshot setting. */
+static void
+fluid_synth_handle_voice_snapshot(void *data, const char *name, int value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
 
-            if(fx_left != NULL)
-            {
-                FLUID_MEMCPY(fx_left[i], &fx_left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + synth->cur], bytes);
-            }
+    fluid_synth_api_enter(synth);
+    fluid_voice_snapshot_set_enabled(synth->voice_snapshot, value, synth->polyphony);
+    fluid_synth_api_exit(synth);
+}
 
-            if(fx_right != NULL)
-            {
-                FLUID_MEMCPY(fx_right[i], &fx_right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + synth->cur], bytes);
-            }
+/* Handler for synth.metering setting. */
+static void
+fluid_synth_handle_metering(void *data, const char *name, int value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
 
-#else //WITH_FLOAT
-            int j;
+    fluid_synth_api_enter(synth);
+    fluid_meter_set_enabled(synth->meter, value);
+    fluid_synth_api_exit(synth);
+}
 
-            if(fx_left != NULL)
-            {
-                for(j = 0; j < num; j++)
-                {
-                    fx_left[i][j] = (float) fx_left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j + synth->cur];
-                }
-            }
+/* Handler for synth.governor.* integer settings. */
+static void
+fluid_synth_handle_governor_int(void *data, const char *name, int value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_return_if_fail(synth != NULL);
 
-            if(fx_right != NULL)
-            {
-                for(j = 0; j < num; j++)
-                {
-                    fx_right[i][j] = (float) fx_right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j + synth->cur];
-                }
-            }
+    fluid_synth_api_enter(synth);
 
-#endif //WITH_FLOAT
+    if(FLUID_STRCMP(name, "synth.governor.active") == 0)
+    {
+        if(!value)
+        {
+            /* give back everything the governor has taken */
+            synth->governor.polyphony = 0;
+            fluid_synth_governor_limit_interp_LOCAL(synth, FALSE);
         }
 
-        count += num;
-        num += synth->cur; /* if we're now done, num becomes the new synth->cur below */
+        synth->governor.calm = FALSE;
+        fluid_atomic_int_set(&synth->governor.active, value);
     }
-
-    /* Then, run one_block() and copy till we have 'len' samples  */
-    while(count < len)
+    else if(FLUID_STRCMP(name, "synth.governor.min-polyphony") == 0)
     {
-        fluid_rvoice_mixer_set_mix_fx(synth->eventhandler->mixer, 0);
-        fluid_synth_render_blocks(synth, 1); // TODO:
-        fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
-        fluid_rvoice_mixer_get_fx_bufs(synth->eventhandler->mixer, &fx_left_in, &fx_right_in);
-
-        num = (FLUID_BUFSIZE > len - count) ? len - count : FLUID_BUFSIZE;
-#ifdef WITH_FLOAT
-        bytes = num * sizeof(float);
-#endif
+        synth->governor.min_polyphony = value;
 
-        for(i = 0; i < synth->audio_channels; i++)
+        if(synth->governor.polyphony != 0 && synth->governor.polyphony < value)
         {
-#ifdef WITH_FLOAT
-            FLUID_MEMCPY(left[i] + count, &left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT], bytes);
-            FLUID_MEMCPY(right[i] + count, &right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT], bytes);
-#else //WITH_FLOAT
-            int j;
-
-            for(j = 0; j < num; j++)
-            {
-                left[i][j + count] = (float) left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j];
-                right[i][j + count] = (float) right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j];
-            }
-
-#endif //WITH_FLOAT
+            synth->governor.polyphony = value;
         }
+    }
+    else if(FLUID_STRCMP(name, "synth.governor.interpolation") == 0)
+    {
+        synth->governor.interpolation = value;
 
-        for(i = 0; i < synth->effects_channels; i++)
+        if(!value)
         {
-#ifdef WITH_FLOAT
-
-            if(fx_left != NULL)
-            {
-                FLUID_MEMCPY(fx_left[i] + count, &fx_left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT], bytes);
-            }
-
-            if(fx_right != NULL)
-            {
-                FLUID_MEMCPY(fx_right[i] + count, &fx_right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT], bytes);
-            }
+            fluid_synth_governor_limit_interp_LOCAL(synth, FALSE);
+        }
+    }
 
-#else //WITH_FLOAT
-            int j;
+    fluid_synth_api_exit(synth);
+}
 
-            if(fx_left != NULL)
-            {
-                for(j = 0; j < num; j++)
-                {
-                    fx_left[i][j + count] = (float) fx_left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j];
-                }
-            }
+/* Handler for synth.governor.target-load setting. */
+static void
+fluid_synth_handle_governor_num(void *data, const char *name, double value)
+{
+    fluid_synth_t *synth = (fluid_synth_t *)data;
+    fluid_return_if_fail(synth != NULL);
 
-            if(fx_right != NULL)
-            {
-                for(j = 0; j < num; j++)
-                {
-                    fx_right[i][j + count] = (float) fx_right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j];
-                }
-            }
+    fluid_synth_api_enter(synth);
+    synth->governor.target_load = value;
+    fluid_synth_api_exit(synth);
+}
 
-#endif //WITH_FLOAT
-        }
+/**
+ * Get the timing statistics of a render stage.
+ * @param synth FluidSynth instance
+ * @param stage Render stage, see #fluid_perf_stage
+ * @param thread -1 for the stage as a whole. For #FLUID_PERF_STAGE_VOICES, the time a single
+ *   render participant spent rendering voices: 0 is the thread calling the synth, 1 up to
+ *   \setting{synth_cpu-cores} - 1 are the mixer threads.
+ * @param stats Receives the statistics, all zero if the stage hasn't been timed yet
+ * @return #FLUID_OK on success, #FLUID_FAILED if \c stage or \c thread are out of range
+ *
+ * The stages are only timed while \setting{synth_perf-stats} is enabled. The statistics are read
+ * without locking the render thread, so the values of a stage being timed at the same time may be
+ * slightly inconsistent with each other.
+ * @since 2.6.0
+ */
+int
+fluid_synth_get_perf_stats(fluid_synth_t *synth, enum fluid_perf_stage stage, int thread,
+                           fluid_perf_stats_t *stats)
+{
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(stats != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(stage >= 0 && stage < FLUID_PERF_STAGE_LAST, FLUID_FAILED);
+    fluid_return_val_if_fail(thread < FLUID_PERF_MAX_THREADS, FLUID_FAILED);
+    fluid_return_val_if_fail(thread < 0 || stage == FLUID_PERF_STAGE_VOICES, FLUID_FAILED);
 
-        count += num;
+    if(thread < 0)
+    {
+        fluid_perf_get_stats(&synth->perf->stages[stage], stats);
+    }
+    else
+    {
+        fluid_perf_get_stats(&synth->perf->threads[thread], stats);
     }
-
-    synth->cur = num;
-
-    time = fluid_utime() - time;
-    cpu_load = 0.5 * (fluid_atomic_float_get(&synth->cpu_load) + time * synth->sample_rate / len / 10000.0);
-    fluid_atomic_float_set(&synth->cpu_load, cpu_load);
 
     return FLUID_OK;
 }
 
 /**
- * mixes the samples of \p in to \p out
+ * Clear the timing statistics of all render stages.
+ * @param synth FluidSynth instance
  *
- * @param out the output sample buffer to mix to
- * @param ooff sample offset in \p out
- * @param in the rvoice_mixer input sample buffer to mix from
- * @param ioff sample offset in \p in
- * @param buf_idx the sample buffer index of \p in to mix from
- * @param num number of samples to mix
+ * The statistics are cleared by the render thread right before it times the next stage.
+ * @since 2.6.0
  */
-static FLUID_INLINE void fluid_synth_mix_single_buffer(float *FLUID_RESTRICT out,
-                                                       int ooff,
-                                                       const fluid_real_t *FLUID_RESTRICT in,
-                                                       int ioff,
-                                                       int buf_idx,
-                                                       int num)
+void
+fluid_synth_reset_perf_stats(fluid_synth_t *synth)
 {
-    if(out != NULL)
-    {
-        int j;
-
-        for(j = 0; j < num; j++)
-        {
-            out[j + ooff] += (float) in[buf_idx * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j + ioff];
-        }
-    }
+    fluid_return_if_fail(synth != NULL);
+    fluid_perf_reset(synth->perf);
 }
 
 /**
- * Synthesize floating point audio to stereo audio channels
- * (implements the default interface #fluid_audio_func_t).
- *
+ * Get how often a render participant waited for the others by polling and by sleeping.
  * @param synth FluidSynth instance
- *
- * @param len Count of audio frames to synthesize and store in every single buffer provided by \p out and \p fx.
- * Zero value is permitted, the function does nothing and return FLUID_OK.
- *
- * @param nfx Count of arrays in \c fx. Must be a multiple of 2 (because of stereo)
- * and in the range <code>0 <= nfx/2 <= (fluid_synth_count_effects_channels() * fluid_synth_count_effects_groups())</code>.
- * Note that zero value is valid and allows to skip mixing effects in all fx output buffers.
- *
- * @param fx Array of buffers to store effects audio to. Buffers may
- * alias with buffers of \c out. Individual NULL buffers are permitted and will cause to skip mixing any audio into that buffer.
- *
- * @param nout Count of arrays in \c out. Must be a multiple of 2
- * (because of stereo) and in the range <code>0 <= nout/2 <= fluid_synth_count_audio_channels()</code>.
- * Note that zero value is valid and allows to skip mixing dry audio in all out output buffers.
- *
- * @param out Array of buffers to store (dry) audio to. Buffers may
- * alias with buffers of \c fx. Individual NULL buffers are permitted and will cause to skip mixing any audio into that buffer.
- *
- * @return #FLUID_OK on success,
- * #FLUID_FAILED otherwise,
- *  - <code>fx == NULL</code> while <code>nfx > 0</code>, or <code>out == NULL</code> while <code>nout > 0</code>.
- *  - \c nfx or \c nout not multiple of 2.
- *  - <code>len < 0</code>.
- *  - \c nfx or \c nout exceed the range explained above.
- *
- * Synthesize and <strong>mix</strong> audio to a given number of planar audio buffers.
- * Therefore pass <code>nout = N*2</code> float buffers to \p out in order to render
- * the synthesized audio to \p N stereo channels. Each float buffer must be
- * able to hold \p len elements.
- *
- * \p out contains an array of planar buffers for normal, dry, stereo
- * audio (alternating left and right). Like:
-@code{.cpp}
-out[0]  = left_buffer_audio_channel_0
-out[1]  = right_buffer_audio_channel_0
-out[2]  = left_buffer_audio_channel_1
-out[3]  = right_buffer_audio_channel_1
-...
-out[ (i * 2 + 0) % nout ]  = left_buffer_audio_channel_i
-out[ (i * 2 + 1) % nout ]  = right_buffer_audio_channel_i
-@endcode
- *
- * for zero-based channel index \p i.
- * The buffer layout of \p fx used for storing effects
- * like reverb and chorus looks similar:
-@code{.cpp}
-fx[0]  = left_buffer_channel_of_reverb_unit_0
-fx[1]  = right_buffer_channel_of_reverb_unit_0
-fx[2]  = left_buffer_channel_of_chorus_unit_0
-fx[3]  = right_buffer_channel_of_chorus_unit_0
-fx[4]  = left_buffer_channel_of_reverb_unit_1
-fx[5]  = right_buffer_channel_of_reverb_unit_1
-fx[6]  = left_buffer_channel_of_chorus_unit_1
-fx[7]  = right_buffer_channel_of_chorus_unit_1
-fx[8]  = left_buffer_channel_of_reverb_unit_2
-...
-fx[ ((k * fluid_synth_count_effects_channels() + j) * 2 + 0) % nfx ]  = left_buffer_for_effect_channel_j_of_unit_k
-fx[ ((k * fluid_synth_count_effects_channels() + j) * 2 + 1) % nfx ]  = right_buffer_for_effect_channel_j_of_unit_k
-@endcode
- * where <code>0 <= k < fluid_synth_count_effects_groups()</code> is a zero-based index denoting the effects unit and
- * <code>0 <= j < fluid_synth_count_effects_channels()</code> is a zero-based index denoting the effect channel within
- * unit \p k.
- *
- * Any playing voice is assigned to audio channels based on the MIDI channel it's playing on: Let \p chan be the
- * zero-based MIDI channel index an arbitrary voice is playing on. To determine the audio channel and effects unit it is
- * going to be rendered to use:
- *
- * <code>i = chan % fluid_synth_count_audio_groups()</code>
- *
- * <code>k = chan % fluid_synth_count_effects_groups()</code>
- *
- * @parblock
- * @note The owner of the sample buffers must zero them out before calling this
- * function, because any synthesized audio is mixed (i.e. added) to the buffers.
- * E.g. if fluid_synth_process() is called from a custom audio driver process function
- * (see new_fluid_audio_driver2()), the audio driver takes care of zeroing the buffers.
- * @endparblock
- *
- * @parblock
- * @note No matter how many buffers you pass in, fluid_synth_process()
- * will always render all audio channels to the
- * buffers in \c out and all effects channels to the
- * buffers in \c fx, provided that <code>nout > 0</code> and <code>nfx > 0</code> respectively. If
- * <code>nout/2 < fluid_synth_count_audio_channels()</code> it will wrap around. Same
- * is true for effects audio if <code>nfx/2 < (fluid_synth_count_effects_channels() * fluid_synth_count_effects_groups())</code>.
- * See usage examples below.
- * @endparblock
- *
- * @parblock
- * @note Should only be called from synthesis thread.
- * @endparblock
+ * @param thread 0 is the thread calling the synth, waiting for the mixer threads to finish
+ *   their voices, 1 up to \setting{synth_cpu-cores} - 1 are the mixer threads, waiting for work
+ * @param spins Receives the number of waits satisfied by polling, may be NULL
+ * @param blocks Receives the number of waits that went to sleep on a condition variable, may be NULL
+ * @return #FLUID_OK on success, #FLUID_FAILED if \c thread is out of range
+ *
+ * Shows whether \setting{synth_mixer-thread-wait} polls long enough for the period size.
+ * The waits are counted regardless of \setting{synth_perf-stats}, the counters are cleared by
+ * fluid_synth_reset_perf_stats(). Threads of a render pool (see fluid_synth_set_render_pool())
+ * serve several synths and aren't counted.
+ * @since 2.6.0
  */
 int
-fluid_synth_process(fluid_synth_t *synth, int len, int nfx, float *fx[],
-                    int nout, float *out[])
+fluid_synth_get_thread_wait_stats(fluid_synth_t *synth, int thread, unsigned int *spins, unsigned int *blocks)
 {
-    return fluid_synth_process_LOCAL(synth, len, nfx, fx, nout, out, fluid_synth_render_blocks);
+    fluid_perf_waits_t waits;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(thread >= 0 && thread < FLUID_PERF_MAX_THREADS, FLUID_FAILED);
+
+    fluid_perf_get_waits(synth->perf, thread, &waits);
+
+    if(spins != NULL)
+    {
+        *spins = waits.spin;
+    }
+
+    if(blocks != NULL)
+    {
+        *blocks = waits.block;
+    }
+
+    return FLUID_OK;
 }
 
-/* declared public (instead of static) for testing purpose */
+/**
+ * Get the latency statistics of the notes played by MIDI drivers.
+ * @param synth FluidSynth instance
+ * @param stats Receives the statistics in microseconds, all zero if no note has been measured yet
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * While \setting{synth_perf-stats} is enabled, the latency of every note-on received by a MIDI
+ * driver is measured from the time the driver received the event to the time the first sample
+ * of the note is heard. That is the time until the block of the note got rendered, the offset of
+ * the note in the rendered buffer, and the output latency of the audio driver created for the
+ * synth, if it reports one. Notes played through the API rather than a MIDI driver aren't measured.
+ * The statistics are cleared by fluid_synth_reset_perf_stats().
+ * @since 2.6.0
+ */
 int
-fluid_synth_process_LOCAL(fluid_synth_t *synth, int len, int nfx, float *fx[],
-                    int nout, float *out[], int (*block_render_func)(fluid_synth_t *, int))
+fluid_synth_get_note_latency_stats(fluid_synth_t *synth, fluid_perf_stats_t *stats)
 {
-    fluid_real_t *left_in, *fx_left_in;
-    fluid_real_t *right_in, *fx_right_in;
-    int nfxchan, nfxunits, naudchan;
-
-    double time = fluid_utime();
-    int i, f, num, count, buffered_blocks;
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(stats != NULL, FLUID_FAILED);
 
-    float cpu_load;
+    fluid_perf_get_stats(&synth->perf->note_latency, stats);
+    return FLUID_OK;
+}
 
+/**
+ * Get the histogram of the note latencies, see fluid_synth_get_note_latency_stats().
+ * @param synth FluidSynth instance
+ * @param counts Array receiving the number of notes of each bin of the histogram
+ * @param limits Array receiving the upper bound of each bin in microseconds, a bin holds the
+ *   latencies above the limit of the previous one. The last bin also holds all longer latencies.
+ * @param size Number of elements of \c counts and \c limits
+ * @return The number of bins of the histogram, of which the first \c size ones are returned,
+ *   #FLUID_FAILED otherwise
+ *
+ * The bins are a quarter octave wide, ranging from below a microsecond up to about 130 milliseconds.
+ * @since 2.6.0
+ */
+int
+fluid_synth_get_note_latency_histogram(fluid_synth_t *synth, unsigned int *counts, double *limits, int size)
+{
     fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(size >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(size == 0 || (counts != NULL && limits != NULL), FLUID_FAILED);
 
-    /* fx NULL while nfx > 0 is invalid */
-    fluid_return_val_if_fail((fx != NULL) || (nfx == 0), FLUID_FAILED);
-    /* nfx must be multiple of 2. Note that 0 value is valid and
-       allows to skip mixing in fx output buffers
-    */
-    fluid_return_val_if_fail(nfx % 2 == 0, FLUID_FAILED);
+    return fluid_perf_get_histogram(&synth->perf->note_latency, counts, limits, size);
+}
 
-    /* out NULL while nout > 0 is invalid */
-    fluid_return_val_if_fail((out != NULL) || (nout == 0), FLUID_FAILED);
-    /* nout must be multiple of 2. Note that 0 value is valid and
-       allows to skip mixing in out output buffers
-    */
-    fluid_return_val_if_fail(nout % 2 == 0, FLUID_FAILED);
+/* Fill in the CPU statistics of a slot of the accounting */
+static void
+fluid_synth_get_cpu_stats_LOCAL(fluid_synth_t *synth, int slot, fluid_cpu_stats_t *stats)
+{
+    fluid_perf_slot_t sum;
+    double blocks = fluid_atomic_int_get(&synth->perf->blocks_reset) ? 0.0 : synth->perf->blocks;
 
-    /* check len value. Note that 0 value is valid, the function does nothing and returns FLUID_OK.
-    */
-    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
-    fluid_return_val_if_fail(len != 0, FLUID_OK); // to avoid raising FE_DIVBYZERO below
+    fluid_perf_get_slot(synth->perf, slot, &sum);
 
-    nfxchan = synth->effects_channels;
-    nfxunits = synth->effects_groups;
-    naudchan = synth->audio_channels;
+    FLUID_MEMSET(stats, 0, sizeof(*stats));
+    stats->usec = sum.usec;
 
-    fluid_return_val_if_fail(0 <= nfx / 2 && nfx / 2 <= nfxchan * nfxunits, FLUID_FAILED);
-    fluid_return_val_if_fail(0 <= nout / 2 && nout / 2 <= naudchan, FLUID_FAILED);
+    if(blocks > 0.0)
+    {
+        stats->load = sum.usec / (blocks * FLUID_BUFSIZE * 1000000.0 / synth->sample_rate);
+        stats->voices = sum.blocks / blocks;
+    }
+}
 
-    /* get internal mixer audio dry buffer's pointer (left and right channel) */
-    fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
-    /* get internal mixer audio effect buffer's pointer (left and right channel) */
-    fluid_rvoice_mixer_get_fx_bufs(synth->eventhandler->mixer, &fx_left_in, &fx_right_in);
+/**
+ * Get the CPU time spent on the voices of a MIDI channel.
+ * @param synth FluidSynth instance
+ * @param chan MIDI channel number (0 to MIDI channel count - 1)
+ * @param stats Receives the statistics, all zero if nothing has been accounted yet
+ * @return #FLUID_OK on success, #FLUID_FAILED if \c chan is out of range
+ *
+ * Voices are only accounted while \setting{synth_cpu-accounting} is enabled. The time covers
+ * synthesizing the voices and mixing them into the output buffers. The statistics are cleared by
+ * fluid_synth_reset_perf_stats().
+ * @since 2.6.0
+ */
+int
+fluid_synth_get_channel_cpu_stats(fluid_synth_t *synth, int chan, fluid_cpu_stats_t *stats)
+{
+    fluid_return_val_if_fail(stats != NULL, FLUID_FAILED);
+    FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
-    /* Conversely to fluid_synth_write_float(),fluid_synth_write_s16() (which handle only one
-       stereo output) we don't want rendered audio effect mixed in internal audio dry buffers.
-       FALSE instructs the mixer that internal audio effects will be mixed in respective internal
-       audio effects buffers.
-    */
-    fluid_rvoice_mixer_set_mix_fx(synth->eventhandler->mixer, FALSE);
+    fluid_synth_get_cpu_stats_LOCAL(synth, chan, stats);
 
+    FLUID_API_RETURN(FLUID_OK);
+}
 
-    /* First, take what's still available in the buffer */
-    count = 0;
-    /* synth->cur indicates if available samples are still in internal mixer buffer */
-    num = synth->cur;
+/**
+ * Get the CPU time spent on the voices of a preset.
+ * @param synth FluidSynth instance
+ * @param index Index of the preset, starting at 0 in the order the presets were first played
+ *   while accounting. At most 128 presets are accounted.
+ * @param sfont_id Receives the ID of the SoundFont of the preset, may be NULL
+ * @param bank Receives the bank number of the preset, may be NULL
+ * @param prog Receives the program number of the preset, may be NULL
+ * @param stats Receives the statistics
+ * @return #FLUID_OK on success, #FLUID_FAILED if no preset has been accounted at \c index
+ *
+ * See fluid_synth_get_channel_cpu_stats().
+ * @since 2.6.0
+ */
+int
+fluid_synth_get_preset_cpu_stats(fluid_synth_t *synth, int index, int *sfont_id, int *bank,
+                                 int *prog, fluid_cpu_stats_t *stats)
+{
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(stats != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
 
-    buffered_blocks = (synth->cur + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
-    if(synth->cur < buffered_blocks * FLUID_BUFSIZE)
+    if(index < 0 || index >= fluid_atomic_int_get(&synth->perf->preset_count))
     {
-        /* yes, available sample are in internal mixer buffer */
-        int available = (buffered_blocks * FLUID_BUFSIZE) - synth->cur;
-        num = (available > len) ? len : available;
-
-        /* mixing dry samples (or skip if requested by the caller) */
-        if(nout != 0)
-        {
-            for(i = 0; i < naudchan; i++)
-            {
-                /* mix num left samples from input mixer buffer (left_in) at input offset
-                   synth->cur to output buffer (out_buf) at offset 0 */
-                float *out_buf = out[(i * 2) % nout];
-                fluid_synth_mix_single_buffer(out_buf, 0, left_in, synth->cur, i, num);
-
-                /* mix num right samples from input mixer buffer (right_in) at input offset
-                   synth->cur to output buffer (out_buf) at offset 0 */
-                out_buf = out[(i * 2 + 1) % nout];
-                fluid_synth_mix_single_buffer(out_buf, 0, right_in, synth->cur, i, num);
-            }
-        }
-
-        /* mixing effects samples (or skip if requested by the caller) */
-        if(nfx != 0)
-        {
-            // loop over all effects units
-            for(f = 0; f < nfxunits; f++)
-            {
-                // write out all effects (i.e. reverb and chorus)
-                for(i = 0; i < nfxchan; i++)
-                {
-                    int buf_idx = f * nfxchan + i;
-
-                    /* mix num left samples from input mixer buffer (fx_left_in) at input offset
-                       synth->cur to output buffer (out_buf) at offset 0 */
-                    float *out_buf = fx[(buf_idx * 2) % nfx];
-                    fluid_synth_mix_single_buffer(out_buf, 0, fx_left_in, synth->cur, buf_idx, num);
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
 
-                    /* mix num right samples from input mixer buffer (fx_right_in) at input offset
-                       synth->cur to output buffer (out_buf) at offset 0 */
-                    out_buf = fx[(buf_idx * 2 + 1) % nfx];
-                    fluid_synth_mix_single_buffer(out_buf, 0, fx_right_in, synth->cur, buf_idx, num);
-                }
-            }
-        }
+    if(sfont_id != NULL)
+    {
+        *sfont_id = synth->perf->presets[index].sfont_id;
+    }
 
-        count += num;
-        num += synth->cur; /* if we're now done, num becomes the new synth->cur below */
+    if(bank != NULL)
+    {
+        *bank = synth->perf->presets[index].bank;
     }
 
-    /* Then, render blocks and copy till we have 'len' samples  */
-    while(count < len)
+    if(prog != NULL)
     {
-        /* always render full block multiple of FLUID_BUFSIZE */
-        int blocksleft = (len - count + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
-        /* render audio (dry and effect) to respective internal dry and effect buffers */
-        int blockcount = block_render_func(synth, blocksleft);
+        *prog = synth->perf->presets[index].prog;
+    }
 
-        num = (blockcount * FLUID_BUFSIZE > len - count) ? len - count : blockcount * FLUID_BUFSIZE;
+    fluid_synth_get_cpu_stats_LOCAL(synth, synth->midi_channels + index, stats);
 
-        /* mixing dry samples (or skip if requested by the caller) */
-        if(nout != 0)
-        {
-            for(i = 0; i < naudchan; i++)
-            {
-                /* mix num left samples from input mixer buffer (left_in) at input offset
-                   0 to output buffer (out_buf) at offset count */
-                float *out_buf = out[(i * 2) % nout];
-                fluid_synth_mix_single_buffer(out_buf, count, left_in, 0, i, num);
-
-                /* mix num right samples from input mixer buffer (right_in) at input offset
-                   0 to output buffer (out_buf) at offset count */
-                out_buf = out[(i * 2 + 1) % nout];
-                fluid_synth_mix_single_buffer(out_buf, count, right_in, 0, i, num);
-            }
-        }
+    FLUID_API_RETURN(FLUID_OK);
+}
 
-        /* mixing effects samples (or skip if requested by the caller) */
-        if(nfx != 0)
-        {
-            // loop over all effects units
-            for(f = 0; f < nfxunits; f++)
-            {
-                // write out all effects (i.e. reverb and chorus)
-                for(i = 0; i < nfxchan; i++)
-                {
-                    int buf_idx = f * nfxchan + i;
+/**
+ * Get the peak and RMS levels of a MIDI channel, an audio group or an effects buffer.
+ * @param synth FluidSynth instance
+ * @param type The kind of signal, see #fluid_meter_type
+ * @param index The MIDI channel, the audio group or the effects buffer. The effects buffers
+ *   are numbered like the \c fx buffers of fluid_synth_process(): the reverb and the chorus
+ *   of the first effects group, then those of the second one, and so on.
+ * @param stats Receives the levels, all zero if nothing has been rendered since the last call
+ * @return #FLUID_OK on success, #FLUID_FAILED if \setting{synth_metering} is disabled or
+ *   \c index is out of range
+ *
+ * The levels span the audio rendered since the previous call for the same signal, so that a
+ * meter polled at any rate doesn't miss a peak. They are metered by the render thread while
+ * \setting{synth_metering} is enabled and read without locking it.
+ *
+ * The levels of a channel are those of its voices after their pan and gain have been applied,
+ * without effects. They are metered voice by voice before the voices are summed up: the peak
+ * is the one of the loudest voice and the RMS level adds up the power of the voices, which is
+ * exact for voices that aren't correlated.
+ * @since 2.6.0
+ */
+int
+fluid_synth_get_meter(fluid_synth_t *synth, enum fluid_meter_type type, int index,
+                      fluid_meter_stats_t *stats)
+{
+    fluid_meter_t *meter;
+    int level;
 
-                    /* mix num left samples from input mixer buffer (fx_left_in) at input offset
-                       0 to output buffer (out_buf) at offset count */
-                    float *out_buf = fx[(buf_idx * 2) % nfx];
-                    fluid_synth_mix_single_buffer(out_buf, count, fx_left_in, 0, buf_idx, num);
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(stats != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(index >= 0, FLUID_FAILED);
 
-                    /* mix num right samples from input mixer buffer (fx_right_in) at input offset
-                       0 to output buffer (out_buf) at offset count */
-                    out_buf = fx[(buf_idx * 2 + 1) % nfx];
-                    fluid_synth_mix_single_buffer(out_buf, count, fx_right_in, 0, buf_idx, num);
-                }
-            }
-        }
+    meter = synth->meter;
 
-        count += num;
+    if(!fluid_meter_enabled(meter))
+    {
+        return FLUID_FAILED;
     }
 
-    synth->cur = num;
+    switch(type)
+    {
+    case FLUID_METER_CHANNEL:
+        fluid_return_val_if_fail(index < meter->channels, FLUID_FAILED);
+        level = index;
+        break;
 
-    time = fluid_utime() - time;
-    cpu_load = 0.5 * (fluid_atomic_float_get(&synth->cpu_load) + time * synth->sample_rate / len / 10000.0);
-    fluid_atomic_float_set(&synth->cpu_load, cpu_load);
+    case FLUID_METER_GROUP:
+        fluid_return_val_if_fail(index < meter->groups, FLUID_FAILED);
+        level = meter->channels + index;
+        break;
+
+    case FLUID_METER_FX:
+        fluid_return_val_if_fail(index < meter->fx_channels, FLUID_FAILED);
+        level = meter->channels + meter->groups + index;
+        break;
+
+    default:
+        return FLUID_FAILED;
+    }
+
+    fluid_meter_get(meter, level, stats);
 
     return FLUID_OK;
 }
 
-
 /**
- * Synthesize a block of floating point audio samples to audio buffers.
+ * Get the memory allocated by the synth.
  * @param synth FluidSynth instance
- * @param len Count of audio frames to synthesize
- * @param lout Array of floats to store left channel of audio
- * @param loff Offset index in 'lout' for first sample
- * @param lincr Increment between samples stored to 'lout'
- * @param rout Array of floats to store right channel of audio
- * @param roff Offset index in 'rout' for first sample
- * @param rincr Increment between samples stored to 'rout'
+ * @param usage Receives the sizes
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
  *
- * Useful for storing interleaved stereo (lout = rout, loff = 0, roff = 1,
- * lincr = 2, rincr = 2).
- *
- * @note Should only be called from synthesis thread.
- * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
- */
-int
-fluid_synth_write_float(fluid_synth_t *synth, int len,
-                        void *lout, int loff, int lincr,
-                        void *rout, int roff, int rincr)
-{
-    void *channels_out[2] = {lout, rout};
-    int channels_off[2] = {loff, roff };
-    int channels_incr[2] = {lincr, rincr };
-
-    return fluid_synth_write_float_channels(synth, len, 2, channels_out,
-                                            channels_off, channels_incr);
-}
-
-/**
- * Synthesize a block of float audio samples channels to audio buffers.
- * The function is convenient for audio driver to render multiple stereo
- * channels pairs on multi channels audio cards (i.e 2, 4, 6, 8,.. channels).
- *
- * @param synth FluidSynth instance.
- * @param len Count of audio frames to synthesize.
- * @param channels_count Count of channels in a frame.
- *  must be multiple of 2 and  channel_count/2 must not exceed the number
- *  of internal mixer buffers (synth->audio_groups)
- * @param channels_out Array of channels_count pointers on 16-bit words to
- *  store sample channels. Modified on return.
- * @param channels_off Array of channels_count offset index to add to respective pointer
- *  in channels_out for first sample.
- * @param channels_incr Array of channels_count increment between consecutive
- *  samples channels.
- * @return #FLUID_OK on success, #FLUID_FAILED otherwise.
- *
- * Useful for storing:
- * - interleaved channels in a unique buffer.
- * - non interleaved channels in an unique buffer (or in distinct buffers).
- *
- * Example for interleaved 4 channels (c1, c2, c3, c4) and n samples (s1, s2,..sn)
- * in a unique buffer:
- * { s1:c1, s1:c2, s1:c3, s1:c4,  s2:c1, s2:c2, s2:c3, s2:c4,...
- *   sn:c1, sn:c2, sn:c3, sn:c4 }.
- *
- * @note Should only be called from synthesis thread.
- * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
+ * The SoundFonts and their sample data are not included. With \setting{synth_low-memory}
+ * enabled, the voices grow as more notes play at the same time, with \setting{synth_sparse-channels}
+ * the channels as they are used.
+ * @since 2.6.0
  */
 int
-fluid_synth_write_float_channels(fluid_synth_t *synth, int len,
-                                 int channels_count,
-                                 void *channels_out[], int channels_off[],
-                                 int channels_incr[])
-{
-    return fluid_synth_write_float_channels_LOCAL(synth, len, channels_count,
-                                      channels_out, channels_off, channels_incr,
-                                      fluid_synth_render_blocks);
-}
-
-int
-fluid_synth_write_float_channels_LOCAL(fluid_synth_t *synth, int len,
-                                 int channels_count,
-                                 void *channels_out[], int channels_off[],
-                                 int channels_incr[],
-                                 int (*block_render_func)(fluid_synth_t *, int))
+fluid_synth_get_memory_usage(fluid_synth_t *synth, fluid_synth_memory_t *usage)
 {
-    float **chan_out = (float **)channels_out;
-    int n, cur, size;
-
-    /* pointers on first input mixer buffer */
-    fluid_real_t *left_in;
-    fluid_real_t *right_in;
-    int bufs_in_count; /* number of stereo input buffers */
-    int i;
-
-    /* start average cpu load probe */
-    double time = fluid_utime();
-    float cpu_load;
+    int i, channels, sources;
 
-    /* start profiling duration probe (if profiling is enabled) */
-    fluid_profile_ref_var(prof_ref);
-
-    /* check parameters */
     fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(usage != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
 
-    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
-    fluid_return_val_if_fail(len != 0, FLUID_OK); // to avoid raising FE_DIVBYZERO below
-
-    /* check for valid channel_count: must be multiple of 2 and
-       channel_count/2 must not exceed the number of internal mixer buffers
-       (synth->audio_groups)
-    */
-    fluid_return_val_if_fail(!(channels_count & 1)  /* must be multiple of 2 */
-                             && channels_count >= 2, FLUID_FAILED);
+    FLUID_MEMSET(usage, 0, sizeof(*usage));
+    sources = (synth->audio_channels + synth->effects_channels * synth->effects_groups) * 2;
 
-    bufs_in_count = (unsigned int)channels_count >> 1; /* channels_count/2 */
-    fluid_return_val_if_fail(bufs_in_count <= synth->audio_groups, FLUID_FAILED);
+    /* every voice has an rvoice and one for overflow */
+    usage->voices = synth->nvoice * (sizeof(*synth->voice) + sizeof(fluid_voice_t) + 2 * sizeof(fluid_rvoice_t))
+                    + fluid_overflow_tree_get_memory(synth->overflow_tree);
 
-    fluid_return_val_if_fail(channels_out != NULL, FLUID_FAILED);
-    fluid_return_val_if_fail(channels_off != NULL, FLUID_FAILED);
-    fluid_return_val_if_fail(channels_incr != NULL, FLUID_FAILED);
+    fluid_rvoice_mixer_get_memory(synth->eventhandler->mixer, &usage->mixer, &usage->effects, &usage->voice_cache);
+    usage->events = fluid_rvoice_eventhandler_get_queue_memory(synth->eventhandler);
 
-    /* initialize output channels buffers on first sample position */
-    i = channels_count;
-    do
+    if(synth->api_queue != NULL)
     {
-        i--;
-        chan_out[i] += channels_off[i];
+        usage->events += (synth->api_queue_mask + 1) * sizeof(*synth->api_queue);
     }
-    while(i);
-
-    /* Conversely to fluid_synth_process(),
-       we want rendered audio effect mixed in internal audio dry buffers.
-       TRUE instructs the mixer that internal audio effects will be mixed in internal
-       audio dry buffers.
-    */
-    fluid_rvoice_mixer_set_mix_fx(synth->eventhandler->mixer, TRUE);
 
-    /* get first internal mixer audio dry buffer's pointer (left and right channel) */
-    fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
-
-    size = len;
-
-    /* synth->cur indicates if available samples are still in internal mixer buffer */
-    cur = synth->cur; /* get previous sample position in internal buffer (due to prvious call) */
-
-    do
+    for(i = fluid_synth_next_channel(synth, 0), channels = 0; i < synth->midi_channels; i = fluid_synth_next_channel(synth, i + 1))
     {
-        /* fill up the buffers as needed */
-        if(cur >= synth->curmax)
-        {
-            /* render audio (dry and effect) to internal dry buffers */
-            /* always render full blocks multiple of FLUID_BUFSIZE */
-            int blocksleft = (size + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
-            synth->curmax = FLUID_BUFSIZE * block_render_func(synth, blocksleft);
-
-            /* get first internal mixer audio dry buffer's pointer (left and right channel) */
-            fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left_in, &right_in);
-            cur = 0;
-        }
-
-        /* calculate amount of available samples */
-        n = synth->curmax - cur;
-
-        /* keep track of emitted samples */
-        if(n > size)
-        {
-            n = size;
-        }
-
-        size -= n;
+        channels++;
+    }
 
-        /* update pointers to current position */
-        left_in  += cur + n;
-        right_in += cur + n;
+    usage->other = sizeof(*synth)
+                   + synth->midi_channels * sizeof(*synth->channel) + channels * sizeof(fluid_channel_t)
+                   + (synth->midi_channels + 31) / 32 * sizeof(*synth->active_channels)
+                   + synth->midi_channels * 128 * sizeof(*synth->note_voices)
+                   + synth->midi_channels * sizeof(*synth->channel_voices)
+                   + (synth->midi_channels + 1) * sizeof(*synth->voice_counters)
+                   + sources * (sizeof(*synth->mix_sources) + sizeof(*synth->mix_first) + sizeof(*synth->mix_bufs))
+                   + sizeof(*synth->mix_first);
 
-        /* set final cursor position */
-        cur += n;
+    usage->total = usage->voices + usage->mixer + usage->effects + usage->events
+                   + usage->voice_cache + usage->other;
 
-        /* reverse index */
-        n = 0 - n;
+    FLUID_API_RETURN(FLUID_OK);
+}
 
-        do
-        {
-            i = bufs_in_count;
-            do
-            {
-                /* input sample index in stereo buffer i */
-                int in_idx = --i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + n;
-                int c = i << 1; /* channel index c to write */
+/**
+ * Get the memory used by a loaded SoundFont.
+ * @param synth FluidSynth instance
+ * @param sfont_id ID of a loaded SoundFont
+ * @param usage Receives the sizes
+ * @return #FLUID_OK on success, #FLUID_FAILED if there is no such SoundFont or its loader
+ *   doesn't account its memory
+ *
+ * The sample data counts the samples in memory at the time of the call, which with
+ * \setting{synth_dynamic-sample-loading} are those of the selected presets and the ones
+ * kept within \setting{synth_dynamic-sample-loading-budget}. The sample data of a SoundFont
+ * loaded by several synths, or identical to that of other samples with \setting{synth_sample-dedup},
+ * is only stored once, each of the SoundFonts sharing it counts all of it in \c samples_shared.
+ *
+ * @note Only SoundFonts loaded by the default SoundFont loader, i.e. SF2 and SF3 files, account
+ * their memory.
+ * @since 2.6.0
+ */
+int
+fluid_synth_get_sfont_memory_usage(fluid_synth_t *synth, int sfont_id, fluid_sfont_memory_t *usage)
+{
+    fluid_sfont_t *sfont;
+    int ret = FLUID_FAILED;
 
-                /* write left input sample to channel sample */
-                *chan_out[c] = (float) left_in[in_idx];
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(usage != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
 
-                /* write right input sample to next channel sample */
-                *chan_out[c+1] = (float) right_in[in_idx];
+    sfont = fluid_synth_get_sfont_by_id(synth, sfont_id);
 
-                /* advance output pointers */
-                chan_out[c]   += channels_incr[c];
-                chan_out[c+1] += channels_incr[c+1];
-            }
-            while(i);
-        }
-        while(++n < 0);
+    if(sfont != NULL && sfont->get_memory != NULL)
+    {
+        ret = sfont->get_memory(sfont, usage);
     }
-    while(size);
-
-    synth->cur = cur; /* save current sample position. It will be used on next call */
-
-    /* save average cpu load, use by API for real time cpu load meter */
-    time = fluid_utime() - time;
-    cpu_load = 0.5 * (fluid_atomic_float_get(&synth->cpu_load) + time * synth->sample_rate / len / 10000.0);
-    fluid_atomic_float_set(&synth->cpu_load, cpu_load);
 
-    /* stop duration probe and save performance measurement (if profiling is enabled) */
-    fluid_profile_write(FLUID_PROF_WRITE, prof_ref,
-                        fluid_rvoice_mixer_get_active_voices(synth->eventhandler->mixer),
-                        len);
-    return FLUID_OK;
+    FLUID_API_RETURN(ret);
 }
 
-/* for testing purpose */
+/**
+ * Get the state of the active voices and the activity of the MIDI channels.
+ * @param synth FluidSynth instance
+ * @param states Array receiving the state of up to \c size voices, may be NULL if \c size is 0
+ * @param size Number of elements in \c states
+ * @param channels Array receiving the activity of the first \c channel_count MIDI channels,
+ *   may be NULL if \c channel_count is 0
+ * @param channel_count Number of elements in \c channels
+ * @return Number of active voices, which may exceed \c size, or #FLUID_FAILED if
+ *   \setting{synth_voice-snapshot} is disabled
+ *
+ * The render thread publishes the state of its voices once per rendered buffer while
+ * \setting{synth_voice-snapshot} is enabled. Unlike fluid_synth_get_voicelist() and the voice
+ * getters, this function neither takes the synth lock nor waits for the render thread,
+ * so a visualizer may poll it at any rate without delaying MIDI input. The snapshot holds
+ * up to as many voices as \setting{synth_polyphony} allowed when it was first enabled.
+ * @since 2.6.0
+ */
 int
-fluid_synth_write_float_LOCAL(fluid_synth_t *synth, int len,
-                              void *lout, int loff, int lincr,
-                              void *rout, int roff, int rincr,
-                              int (*block_render_func)(fluid_synth_t *, int)
-                             )
+fluid_synth_get_voice_states(fluid_synth_t *synth, fluid_voice_state_t *states, int size,
+                             fluid_channel_activity_t *channels, int channel_count)
 {
-    void *channels_out[2] = {lout, rout};
-    int channels_off[2] = {loff, roff };
-    int channels_incr[2] = {lincr, rincr };
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(size >= 0 && (states != NULL || size == 0), FLUID_FAILED);
+    fluid_return_val_if_fail(channel_count >= 0 && (channels != NULL || channel_count == 0), FLUID_FAILED);
 
-    return fluid_synth_write_float_channels_LOCAL(synth, len, 2, channels_out,
-                                            channels_off, channels_incr,
-                                            block_render_func);
+    return fluid_voice_snapshot_read(synth->voice_snapshot, states, size, channels, channel_count);
 }
 
 /**
- * Synthesize a block of 16 bit audio samples to audio buffers.
+ * Resend a bank select and a program change for every channel and assign corresponding instruments.
  * @param synth FluidSynth instance
- * @param len Count of audio frames to synthesize
- * @param lout Array of 16 bit words to store left channel of audio
- * @param loff Offset index in 'lout' for first sample
- * @param lincr Increment between samples stored to 'lout'
- * @param rout Array of 16 bit words to store right channel of audio
- * @param roff Offset index in 'rout' for first sample
- * @param rincr Increment between samples stored to 'rout'
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
  *
- * Useful for storing interleaved stereo (lout = rout, loff = 0, roff = 1,
- * lincr = 2, rincr = 2).
- *
- * @note Should only be called from synthesis thread.
- * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
- * @note Dithering is performed when converting from internal floating point to
- * 16 bit audio.
+ * This function is called mainly after a SoundFont has been loaded,
+ * unloaded or reloaded.
  */
 int
-fluid_synth_write_s16(fluid_synth_t *synth, int len,
-                      void *lout, int loff, int lincr,
-                      void *rout, int roff, int rincr)
+fluid_synth_program_reset(fluid_synth_t *synth)
 {
-    return fluid_synth_write_s16_cpp(synth, len,
-                                     lout, loff, lincr,
-                                     rout, roff, rincr);
+    int i, prog;
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    /* try to set the correct presets */
+    for(i = fluid_synth_next_channel(synth, 0); i < synth->midi_channels; i = fluid_synth_next_channel(synth, i + 1))
+    {
+        fluid_channel_get_sfont_bank_prog(synth->channel[i], NULL, NULL, &prog);
+        fluid_synth_program_change(synth, i, prog);
+    }
+
+    FLUID_API_RETURN(FLUID_OK);
 }
 
 /**
- * Synthesize a block of 24 bit audio samples to audio buffers.
+ * Synthesize a block of floating point audio to separate audio buffers (multi-channel rendering).
+ *
  * @param synth FluidSynth instance
  * @param len Count of audio frames to synthesize
- * @param lout Array of 32 bit words to store left channel of audio
- * @param loff Offset index in 'lout' for first sample
- * @param lincr Increment between samples stored to 'lout'
- * @param rout Array of 32 bit words to store right channel of audio
+ * @param left Array of float buffers to store left channel of planar audio (as many as \c synth.audio-channels buffers, each of \c len in size)
+ * @param right Array of float buffers to store right channel of planar audio (size: ditto)
+ * @param fx_left Since 1.1.7: If not \c NULL, array of float buffers to store left effect channels (as many as \c synth.effects-channels buffers, each of \c len in size)
+ * @param fx_right Since 1.1.7: If not \c NULL, array of float buffers to store right effect channels (size: ditto)
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * First effect channel used by reverb, second for chorus.
+ *
+ * @note Should only be called from synthesis thread.
+ *
+ * @deprecated fluid_synth_nwrite_float() is deprecated and will be removed in a future release.
+ * It may continue to work or it may return #FLUID_FAILED in the future. Consider using the more
+ * powerful and flexible fluid_synth_process().
+ *
+ * Usage example:
+ * @code{.cpp}
+    const int FramesToRender = 64;
+    int channels;
+    // retrieve number of stereo audio channels
+    fluid_settings_getint(settings, "synth.audio-channels", &channels);
+
+    // we need twice as many (mono-)buffers
+    channels *= 2;
+
+    // fluid_synth_nwrite_float renders planar audio, e.g. if synth.audio-channels==16:
+    // each midi channel gets rendered to its own stereo buffer, rather than having
+    // one buffer and interleaved PCM
+    float** mix_buf = new float*[channels];
+    for(int i = 0; i < channels; i++)
+    {
+        mix_buf[i] = new float[FramesToRender];
+    }
+
+    // retrieve number of (stereo) effect channels (internally hardcoded to reverb (first chan)
+    // and chrous (second chan))
+    fluid_settings_getint(settings, "synth.effects-channels", &channels);
+    channels *= 2;
+
+    float** fx_buf = new float*[channels];
+    for(int i = 0; i < channels; i++)
+    {
+        fx_buf[i] = new float[FramesToRender];
+    }
+
+    float** mix_buf_l = mix_buf;
+    float** mix_buf_r = &mix_buf[channels/2];
+
+    float** fx_buf_l = fx_buf;
+    float** fx_buf_r = &fx_buf[channels/2];
+
+    fluid_synth_nwrite_float(synth, FramesToRender, mix_buf_l, mix_buf_r, fx_buf_l, fx_buf_r)
+ * @endcode
+ */
+int
+fluid_synth_nwrite_float(fluid_synth_t *synth, int len,
+                         float **left, float **right,
+                         float **fx_left, float **fx_right)
+{
+    fluid_real_t *left_in, *fx_left_in;
+    fluid_real_t *right_in, *fx_right_in;
+    double time = fluid_utime();
+    int i, num, available, count;
+#ifdef WITH_FLOAT
+    int bytes;
+#endif
+    float cpu_load;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(left != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(right != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(len != 0, FLUID_OK); // to avoid raising FE_DIVBYZERO below
+
+    /* First, take what's still available in the buffer */
+    count = 0;
+    num = synth->cur;
+
+    if(synth->cur < FLUID_BUFSIZE)
+    {
+        available = FLUID_BUFSIZE - synth->cur;
+        fluid_synth_get_out_bufs(synth, &left_in, &right_in);
+        fluid_synth_get_out_fx_bufs(synth, &fx_left_in, &fx_right_in);
+
+        num = (available > len) ? len : available;
+#ifdef WITH_FLOAT
+        bytes = num * sizeof(float);
+#endif
+
+        for(i = 0; i < synth->audio_channels; i++)
+        {
+#ifdef WITH_FLOAT
+            FLUID_MEMCPY(left[i], &left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + synth->cur], bytes);
+            FLUID_MEMCPY(right[i], &right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + synth->cur], bytes);
+#else //WITH_FLOAT
+            int j;
+
+            for(j = 0; j < num; j++)
+            {
+                left[i][j] = (float) left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j + synth->cur];
+                right[i][j] = (float) right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j + synth->cur];
+            }
+
+#endif //WITH_FLOAT
+        }
+
+        for(i = 0; i < synth->effects_channels; i++)
+        {
+#ifdef WITH_FLOAT
+
+            if(fx_left != NULL)
+            {
+                FLUID_MEMCPY(fx_left[i], &fx_left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + synth->cur], bytes);
+            }
+
+            if(fx_right != NULL)
+            {
+                FLUID_MEMCPY(fx_right[i], &fx_right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + synth->cur], bytes);
+            }
+
+#else //WITH_FLOAT
+            int j;
+
+            if(fx_left != NULL)
+            {
+                for(j = 0; j < num; j++)
+                {
+                    fx_left[i][j] = (float) fx_left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j + synth->cur];
+                }
+            }
+
+            if(fx_right != NULL)
+            {
+                for(j = 0; j < num; j++)
+                {
+                    fx_right[i][j] = (float) fx_right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j + synth->cur];
+                }
+            }
+
+#endif //WITH_FLOAT
+        }
+
+        count += num;
+        num += synth->cur; /* if we're now done, num becomes the new synth->cur below */
+    }
+
+    /* Then, run one_block() and copy till we have 'len' samples  */
+    while(count < len)
+    {
+        fluid_rvoice_mixer_set_mix_fx(synth->eventhandler->mixer, 0);
+        fluid_synth_render_blocks(synth, 1); // TODO:
+        fluid_synth_get_out_bufs(synth, &left_in, &right_in);
+        fluid_synth_get_out_fx_bufs(synth, &fx_left_in, &fx_right_in);
+
+        num = (FLUID_BUFSIZE > len - count) ? len - count : FLUID_BUFSIZE;
+#ifdef WITH_FLOAT
+        bytes = num * sizeof(float);
+#endif
+
+        for(i = 0; i < synth->audio_channels; i++)
+        {
+#ifdef WITH_FLOAT
+            FLUID_MEMCPY(left[i] + count, &left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT], bytes);
+            FLUID_MEMCPY(right[i] + count, &right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT], bytes);
+#else //WITH_FLOAT
+            int j;
+
+            for(j = 0; j < num; j++)
+            {
+                left[i][j + count] = (float) left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j];
+                right[i][j + count] = (float) right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j];
+            }
+
+#endif //WITH_FLOAT
+        }
+
+        for(i = 0; i < synth->effects_channels; i++)
+        {
+#ifdef WITH_FLOAT
+
+            if(fx_left != NULL)
+            {
+                FLUID_MEMCPY(fx_left[i] + count, &fx_left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT], bytes);
+            }
+
+            if(fx_right != NULL)
+            {
+                FLUID_MEMCPY(fx_right[i] + count, &fx_right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT], bytes);
+            }
+
+#else //WITH_FLOAT
+            int j;
+
+            if(fx_left != NULL)
+            {
+                for(j = 0; j < num; j++)
+                {
+                    fx_left[i][j + count] = (float) fx_left_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j];
+                }
+            }
+
+            if(fx_right != NULL)
+            {
+                for(j = 0; j < num; j++)
+                {
+                    fx_right[i][j + count] = (float) fx_right_in[i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + j];
+                }
+            }
+
+#endif //WITH_FLOAT
+        }
+
+        count += num;
+    }
+
+    synth->cur = num;
+
+    time = fluid_utime() - time;
+    cpu_load = 0.5 * (fluid_atomic_float_get(&synth->cpu_load) + time * synth->output_rate / len / 10000.0);
+    fluid_atomic_float_set(&synth->cpu_load, cpu_load);
+
+    return FLUID_OK;
+}
+
+/**
+ * mixes the samples of the buffers \p in to \p out, in a single pass over \p out.
+ * Adds the buffers one after the other to every sample, which rounds the same as
+ * mixing them into \p out one at a time.
+ *
+ * @param out the output sample buffer to mix to
+ * @param in the rvoice_mixer input sample buffers to mix from
+ * @param count number of buffers in \p in
+ * @param num number of samples to mix
+ */
+static void fluid_synth_mix_buffers(float *FLUID_RESTRICT out,
+                                    const fluid_real_t *const *in,
+                                    int count,
+                                    int num)
+{
+    const fluid_real_t *a, *b, *c, *d;
+    int i, j;
+
+    for(i = 0; i + 4 <= count; i += 4)
+    {
+        a = in[i];
+        b = in[i + 1];
+        c = in[i + 2];
+        d = in[i + 3];
+
+        #pragma omp simd
+        for(j = 0; j < num; j++)
+        {
+            out[j] = (((out[j] + (float) a[j]) + (float) b[j]) + (float) c[j]) + (float) d[j];
+        }
+    }
+
+    switch(count - i)
+    {
+    case 3:
+        a = in[i];
+        b = in[i + 1];
+        c = in[i + 2];
+
+        #pragma omp simd
+        for(j = 0; j < num; j++)
+        {
+            out[j] = ((out[j] + (float) a[j]) + (float) b[j]) + (float) c[j];
+        }
+        break;
+
+    case 2:
+        a = in[i];
+        b = in[i + 1];
+
+        #pragma omp simd
+        for(j = 0; j < num; j++)
+        {
+            out[j] = (out[j] + (float) a[j]) + (float) b[j];
+        }
+        break;
+
+    case 1:
+        a = in[i];
+
+        #pragma omp simd
+        for(j = 0; j < num; j++)
+        {
+            out[j] += (float) a[j];
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+ * Groups the dry and fx buffers by the buffer of \p out and \p fx of fluid_synth_process()
+ * they are mixed into, wrapping around the \p nout and \p nfx output buffers. The buffers
+ * of each output keep the order of their channels.
+ */
+static void
+fluid_synth_update_mix_map(fluid_synth_t *synth, int nout, int nfx)
+{
+    int naudbufs = synth->audio_channels * 2;
+    int nfxbufs = synth->effects_channels * synth->effects_groups * 2;
+    int *first = synth->mix_first;
+    fluid_synth_mix_source_t *src;
+    int i, o;
+
+    FLUID_MEMSET(first, 0, (nout + nfx + 1) * sizeof(*first));
+
+    /* count the sources of every output, shifted by one */
+    for(i = 0; nout != 0 && i < naudbufs; i++)
+    {
+        first[i % nout + 1]++;
+    }
+
+    for(i = 0; nfx != 0 && i < nfxbufs; i++)
+    {
+        first[nout + i % nfx + 1]++;
+    }
+
+    for(o = 0; o < nout + nfx; o++)
+    {
+        first[o + 1] += first[o];
+    }
+
+    /* place the sources, using the start of every output as its cursor */
+    for(i = 0; nout != 0 && i < naudbufs; i++)
+    {
+        src = &synth->mix_sources[first[i % nout]++];
+        src->in = i % 2;
+        src->offset = (i / 2) * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+        src->live = i;
+    }
+
+    for(i = 0; nfx != 0 && i < nfxbufs; i++)
+    {
+        src = &synth->mix_sources[first[nout + i % nfx]++];
+        src->in = 2 + i % 2;
+        src->offset = (i / 2) * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT;
+        src->live = synth->audio_groups * 2 + i / 2;
+    }
+
+    /* every cursor is now the start of the next output */
+    for(o = nout + nfx; o > 0; o--)
+    {
+        first[o] = first[o - 1];
+    }
+
+    first[0] = 0;
+    synth->mix_nout = nout;
+    synth->mix_nfx = nfx;
+}
+
+/*
+ * Mixes \p num samples of the live dry and fx buffers at offset \p ioff to the buffers of
+ * \p out and \p fx of fluid_synth_process() at offset \p ooff, along the mix map.
+ */
+static void
+fluid_synth_mix_outputs(fluid_synth_t *synth, int nfx, float *fx[], int nout, float *out[],
+                        int ooff, int ioff, int num)
+{
+    const fluid_synth_mix_source_t *src;
+    const unsigned char *live;
+    fluid_real_t *in[4];
+    float *out_buf;
+    int o, s, count;
+
+    fluid_synth_get_out_bufs(synth, &in[0], &in[1]);
+    fluid_synth_get_out_fx_bufs(synth, &in[2], &in[3]);
+    /* the buffers no sound has been rendered to are skipped */
+    live = fluid_synth_get_out_live_bufs(synth);
+
+    for(o = 0; o < nout + nfx; o++)
+    {
+        out_buf = (o < nout) ? out[o] : fx[o - nout];
+
+        if(out_buf == NULL)
+        {
+            continue;
+        }
+
+        for(s = synth->mix_first[o], count = 0; s < synth->mix_first[o + 1]; s++)
+        {
+            src = &synth->mix_sources[s];
+
+            if(live[src->live])
+            {
+                synth->mix_bufs[count++] = in[src->in] + src->offset + ioff;
+            }
+        }
+
+        fluid_synth_mix_buffers(out_buf + ooff, synth->mix_bufs, count, num);
+    }
+}
+
+/**
+ * Synthesize floating point audio to stereo audio channels
+ * (implements the default interface #fluid_audio_func_t).
+ *
+ * @param synth FluidSynth instance
+ *
+ * @param len Count of audio frames to synthesize and store in every single buffer provided by \p out and \p fx.
+ * Zero value is permitted, the function does nothing and return FLUID_OK.
+ *
+ * @param nfx Count of arrays in \c fx. Must be a multiple of 2 (because of stereo)
+ * and in the range <code>0 <= nfx/2 <= (fluid_synth_count_effects_channels() * fluid_synth_count_effects_groups())</code>.
+ * Note that zero value is valid and allows to skip mixing effects in all fx output buffers.
+ *
+ * @param fx Array of buffers to store effects audio to. Buffers may
+ * alias with buffers of \c out. Individual NULL buffers are permitted and will cause to skip mixing any audio into that buffer.
+ *
+ * @param nout Count of arrays in \c out. Must be a multiple of 2
+ * (because of stereo) and in the range <code>0 <= nout/2 <= fluid_synth_count_audio_channels()</code>.
+ * Note that zero value is valid and allows to skip mixing dry audio in all out output buffers.
+ *
+ * @param out Array of buffers to store (dry) audio to. Buffers may
+ * alias with buffers of \c fx. Individual NULL buffers are permitted and will cause to skip mixing any audio into that buffer.
+ *
+ * @return #FLUID_OK on success,
+ * #FLUID_FAILED otherwise,
+ *  - <code>fx == NULL</code> while <code>nfx > 0</code>, or <code>out == NULL</code> while <code>nout > 0</code>.
+ *  - \c nfx or \c nout not multiple of 2.
+ *  - <code>len < 0</code>.
+ *  - \c nfx or \c nout exceed the range explained above.
+ *
+ * Synthesize and <strong>mix</strong> audio to a given number of planar audio buffers.
+ * Therefore pass <code>nout = N*2</code> float buffers to \p out in order to render
+ * the synthesized audio to \p N stereo channels. Each float buffer must be
+ * able to hold \p len elements.
+ *
+ * \p out contains an array of planar buffers for normal, dry, stereo
+ * audio (alternating left and right). Like:
+@code{.cpp}
+out[0]  = left_buffer_audio_channel_0
+out[1]  = right_buffer_audio_channel_0
+out[2]  = left_buffer_audio_channel_1
+out[3]  = right_buffer_audio_channel_1
+...
+out[ (i * 2 + 0) % nout ]  = left_buffer_audio_channel_i
+out[ (i * 2 + 1) % nout ]  = right_buffer_audio_channel_i
+@endcode
+ *
+ * for zero-based channel index \p i.
+ * The buffer layout of \p fx used for storing effects
+ * like reverb and chorus looks similar:
+@code{.cpp}
+fx[0]  = left_buffer_channel_of_reverb_unit_0
+fx[1]  = right_buffer_channel_of_reverb_unit_0
+fx[2]  = left_buffer_channel_of_chorus_unit_0
+fx[3]  = right_buffer_channel_of_chorus_unit_0
+fx[4]  = left_buffer_channel_of_reverb_unit_1
+fx[5]  = right_buffer_channel_of_reverb_unit_1
+fx[6]  = left_buffer_channel_of_chorus_unit_1
+fx[7]  = right_buffer_channel_of_chorus_unit_1
+fx[8]  = left_buffer_channel_of_reverb_unit_2
+...
+fx[ ((k * fluid_synth_count_effects_channels() + j) * 2 + 0) % nfx ]  = left_buffer_for_effect_channel_j_of_unit_k
+fx[ ((k * fluid_synth_count_effects_channels() + j) * 2 + 1) % nfx ]  = right_buffer_for_effect_channel_j_of_unit_k
+@endcode
+ * where <code>0 <= k < fluid_synth_count_effects_groups()</code> is a zero-based index denoting the effects unit and
+ * <code>0 <= j < fluid_synth_count_effects_channels()</code> is a zero-based index denoting the effect channel within
+ * unit \p k.
+ *
+ * Any playing voice is assigned to audio channels based on the MIDI channel it's playing on: Let \p chan be the
+ * zero-based MIDI channel index an arbitrary voice is playing on. To determine the audio channel and effects unit it is
+ * going to be rendered to use:
+ *
+ * <code>i = chan % fluid_synth_count_audio_groups()</code>
+ *
+ * <code>k = chan % fluid_synth_count_effects_groups()</code>
+ *
+ * @parblock
+ * @note The owner of the sample buffers must zero them out before calling this
+ * function, because any synthesized audio is mixed (i.e. added) to the buffers.
+ * E.g. if fluid_synth_process() is called from a custom audio driver process function
+ * (see new_fluid_audio_driver2()), the audio driver takes care of zeroing the buffers.
+ * @endparblock
+ *
+ * @parblock
+ * @note No matter how many buffers you pass in, fluid_synth_process()
+ * will always render all audio channels to the
+ * buffers in \c out and all effects channels to the
+ * buffers in \c fx, provided that <code>nout > 0</code> and <code>nfx > 0</code> respectively. If
+ * <code>nout/2 < fluid_synth_count_audio_channels()</code> it will wrap around. Same
+ * is true for effects audio if <code>nfx/2 < (fluid_synth_count_effects_channels() * fluid_synth_count_effects_groups())</code>.
+ * See usage examples below.
+ * @endparblock
+ *
+ * @parblock
+ * @note Should only be called from synthesis thread.
+ * @endparblock
+ */
+int
+fluid_synth_process(fluid_synth_t *synth, int len, int nfx, float *fx[],
+                    int nout, float *out[])
+{
+    return fluid_synth_process_LOCAL(synth, len, nfx, fx, nout, out, fluid_synth_render_blocks);
+}
+
+/* declared public (instead of static) for testing purpose */
+int
+fluid_synth_process_LOCAL(fluid_synth_t *synth, int len, int nfx, float *fx[],
+                    int nout, float *out[], int (*block_render_func)(fluid_synth_t *, int))
+{
+    int nfxchan, nfxunits, naudchan;
+
+    double time = fluid_utime();
+    int num, count, buffered_blocks;
+
+    float cpu_load;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+
+    /* fx NULL while nfx > 0 is invalid */
+    fluid_return_val_if_fail((fx != NULL) || (nfx == 0), FLUID_FAILED);
+    /* nfx must be multiple of 2. Note that 0 value is valid and
+       allows to skip mixing in fx output buffers
+    */
+    fluid_return_val_if_fail(nfx % 2 == 0, FLUID_FAILED);
+
+    /* out NULL while nout > 0 is invalid */
+    fluid_return_val_if_fail((out != NULL) || (nout == 0), FLUID_FAILED);
+    /* nout must be multiple of 2. Note that 0 value is valid and
+       allows to skip mixing in out output buffers
+    */
+    fluid_return_val_if_fail(nout % 2 == 0, FLUID_FAILED);
+
+    /* check len value. Note that 0 value is valid, the function does nothing and returns FLUID_OK.
+    */
+    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(len != 0, FLUID_OK); // to avoid raising FE_DIVBYZERO below
+
+    nfxchan = synth->effects_channels;
+    nfxunits = synth->effects_groups;
+    naudchan = synth->audio_channels;
+
+    fluid_return_val_if_fail(0 <= nfx / 2 && nfx / 2 <= nfxchan * nfxunits, FLUID_FAILED);
+    fluid_return_val_if_fail(0 <= nout / 2 && nout / 2 <= naudchan, FLUID_FAILED);
+
+    /* the mapping of the internal buffers to the output buffers only changes along with their count */
+    if(nout != synth->mix_nout || nfx != synth->mix_nfx)
+    {
+        fluid_synth_update_mix_map(synth, nout, nfx);
+    }
+
+    /* Conversely to fluid_synth_write_float(),fluid_synth_write_s16() (which handle only one
+       stereo output) we don't want rendered audio effect mixed in internal audio dry buffers.
+       FALSE instructs the mixer that internal audio effects will be mixed in respective internal
+       audio effects buffers.
+    */
+    fluid_rvoice_mixer_set_mix_fx(synth->eventhandler->mixer, FALSE);
+
+
+    /* First, take what's still available in the buffer */
+    count = 0;
+    /* synth->cur indicates if available samples are still in internal mixer buffer */
+    num = synth->cur;
+
+    buffered_blocks = (synth->cur + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
+    if(synth->cur < buffered_blocks * FLUID_BUFSIZE)
+    {
+        /* yes, available sample are in internal mixer buffer */
+        int available = (buffered_blocks * FLUID_BUFSIZE) - synth->cur;
+        num = (available > len) ? len : available;
+
+        /* mix num samples from the internal buffers at input offset synth->cur
+           to the output buffers at offset 0 */
+        fluid_synth_mix_outputs(synth, nfx, fx, nout, out, 0, synth->cur, num);
+
+        count += num;
+        num += synth->cur; /* if we're now done, num becomes the new synth->cur below */
+    }
+
+    /* Then, render blocks and copy till we have 'len' samples  */
+    while(count < len)
+    {
+        /* always render full block multiple of FLUID_BUFSIZE */
+        int blocksleft = (len - count + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
+        /* render audio (dry and effect) to respective internal dry and effect buffers */
+        int blockcount = block_render_func(synth, blocksleft);
+
+        num = (blockcount * FLUID_BUFSIZE > len - count) ? len - count : blockcount * FLUID_BUFSIZE;
+
+        /* mix num samples from the internal buffers at input offset 0
+           to the output buffers at offset count */
+        fluid_synth_mix_outputs(synth, nfx, fx, nout, out, count, 0, num);
+
+        count += num;
+    }
+
+    synth->cur = num;
+
+    time = fluid_utime() - time;
+    cpu_load = 0.5 * (fluid_atomic_float_get(&synth->cpu_load) + time * synth->output_rate / len / 10000.0);
+    fluid_atomic_float_set(&synth->cpu_load, cpu_load);
+
+    return FLUID_OK;
+}
+
+
+/**
+ * Synthesize a block of floating point audio samples to audio buffers.
+ * @param synth FluidSynth instance
+ * @param len Count of audio frames to synthesize
+ * @param lout Array of floats to store left channel of audio
+ * @param loff Offset index in 'lout' for first sample
+ * @param lincr Increment between samples stored to 'lout'
+ * @param rout Array of floats to store right channel of audio
+ * @param roff Offset index in 'rout' for first sample
+ * @param rincr Increment between samples stored to 'rout'
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * Useful for storing interleaved stereo (lout = rout, loff = 0, roff = 1,
+ * lincr = 2, rincr = 2).
+ *
+ * @note Should only be called from synthesis thread.
+ * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
+ */
+int
+fluid_synth_write_float(fluid_synth_t *synth, int len,
+                        void *lout, int loff, int lincr,
+                        void *rout, int roff, int rincr)
+{
+    void *channels_out[2] = {lout, rout};
+    int channels_off[2] = {loff, roff };
+    int channels_incr[2] = {lincr, rincr };
+
+    return fluid_synth_write_float_channels(synth, len, 2, channels_out,
+                                            channels_off, channels_incr);
+}
+
+/**
+ * Synthesize a block of float audio samples channels to audio buffers.
+ * The function is convenient for audio driver to render multiple stereo
+ * channels pairs on multi channels audio cards (i.e 2, 4, 6, 8,.. channels).
+ *
+ * @param synth FluidSynth instance.
+ * @param len Count of audio frames to synthesize.
+ * @param channels_count Count of channels in a frame.
+ *  must be multiple of 2 and  channel_count/2 must not exceed the number
+ *  of internal mixer buffers (synth->audio_groups)
+ * @param channels_out Array of channels_count pointers on 16-bit words to
+ *  store sample channels. Modified on return.
+ * @param channels_off Array of channels_count offset index to add to respective pointer
+ *  in channels_out for first sample.
+ * @param channels_incr Array of channels_count increment between consecutive
+ *  samples channels.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise.
+ *
+ * Useful for storing:
+ * - interleaved channels in a unique buffer.
+ * - non interleaved channels in an unique buffer (or in distinct buffers).
+ *
+ * Example for interleaved 4 channels (c1, c2, c3, c4) and n samples (s1, s2,..sn)
+ * in a unique buffer:
+ * { s1:c1, s1:c2, s1:c3, s1:c4,  s2:c1, s2:c2, s2:c3, s2:c4,...
+ *   sn:c1, sn:c2, sn:c3, sn:c4 }.
+ *
+ * @note Should only be called from synthesis thread.
+ * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
+ */
+int
+fluid_synth_write_float_channels(fluid_synth_t *synth, int len,
+                                 int channels_count,
+                                 void *channels_out[], int channels_off[],
+                                 int channels_incr[])
+{
+    return fluid_synth_write_float_channels_LOCAL(synth, len, channels_count,
+                                      channels_out, channels_off, channels_incr,
+                                      fluid_synth_render_blocks);
+}
+
+int
+fluid_synth_write_float_channels_LOCAL(fluid_synth_t *synth, int len,
+                                 int channels_count,
+                                 void *channels_out[], int channels_off[],
+                                 int channels_incr[],
+                                 int (*block_render_func)(fluid_synth_t *, int))
+{
+    float **chan_out = (float **)channels_out;
+    int n, cur, size;
+
+    /* pointers on first input mixer buffer */
+    fluid_real_t *left_in;
+    fluid_real_t *right_in;
+    int bufs_in_count; /* number of stereo input buffers */
+    int i;
+
+    /* start average cpu load probe */
+    double time = fluid_utime();
+    float cpu_load;
+
+    /* start profiling duration probe (if profiling is enabled) */
+    fluid_profile_ref_var(prof_ref);
+
+    /* check parameters */
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+
+    fluid_return_val_if_fail(len >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(len != 0, FLUID_OK); // to avoid raising FE_DIVBYZERO below
+
+    /* check for valid channel_count: must be multiple of 2 and
+       channel_count/2 must not exceed the number of internal mixer buffers
+       (synth->audio_groups)
+    */
+    fluid_return_val_if_fail(!(channels_count & 1)  /* must be multiple of 2 */
+                             && channels_count >= 2, FLUID_FAILED);
+
+    bufs_in_count = (unsigned int)channels_count >> 1; /* channels_count/2 */
+    fluid_return_val_if_fail(bufs_in_count <= synth->audio_groups, FLUID_FAILED);
+
+    fluid_return_val_if_fail(channels_out != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(channels_off != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(channels_incr != NULL, FLUID_FAILED);
+
+    /* initialize output channels buffers on first sample position */
+    i = channels_count;
+    do
+    {
+        i--;
+        chan_out[i] += channels_off[i];
+    }
+    while(i);
+
+    /* Conversely to fluid_synth_process(),
+       we want rendered audio effect mixed in internal audio dry buffers.
+       TRUE instructs the mixer that internal audio effects will be mixed in internal
+       audio dry buffers.
+    */
+    fluid_rvoice_mixer_set_mix_fx(synth->eventhandler->mixer, TRUE);
+
+    /* get first internal mixer audio dry buffer's pointer (left and right channel) */
+    fluid_synth_get_out_bufs(synth, &left_in, &right_in);
+
+    size = len;
+
+    /* synth->cur indicates if available samples are still in internal mixer buffer */
+    cur = synth->cur; /* get previous sample position in internal buffer (due to prvious call) */
+
+    do
+    {
+        /* fill up the buffers as needed */
+        if(cur >= synth->curmax)
+        {
+            /* render audio (dry and effect) to internal dry buffers */
+            /* always render full blocks multiple of FLUID_BUFSIZE */
+            int blocksleft = (size + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE;
+            synth->curmax = FLUID_BUFSIZE * block_render_func(synth, blocksleft);
+
+            /* get first internal mixer audio dry buffer's pointer (left and right channel) */
+            fluid_synth_get_out_bufs(synth, &left_in, &right_in);
+            cur = 0;
+        }
+
+        /* calculate amount of available samples */
+        n = synth->curmax - cur;
+
+        /* keep track of emitted samples */
+        if(n > size)
+        {
+            n = size;
+        }
+
+        size -= n;
+
+        /* update pointers to current position */
+        left_in  += cur + n;
+        right_in += cur + n;
+
+        /* set final cursor position */
+        cur += n;
+
+        /* reverse index */
+        n = 0 - n;
+
+        do
+        {
+            i = bufs_in_count;
+            do
+            {
+                /* input sample index in stereo buffer i */
+                int in_idx = --i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + n;
+                int c = i << 1; /* channel index c to write */
+
+                /* write left input sample to channel sample */
+                *chan_out[c] = (float) left_in[in_idx];
+
+                /* write right input sample to next channel sample */
+                *chan_out[c+1] = (float) right_in[in_idx];
+
+                /* advance output pointers */
+                chan_out[c]   += channels_incr[c];
+                chan_out[c+1] += channels_incr[c+1];
+            }
+            while(i);
+        }
+        while(++n < 0);
+    }
+    while(size);
+
+    synth->cur = cur; /* save current sample position. It will be used on next call */
+
+    /* save average cpu load, use by API for real time cpu load meter */
+    time = fluid_utime() - time;
+    cpu_load = 0.5 * (fluid_atomic_float_get(&synth->cpu_load) + time * synth->output_rate / len / 10000.0);
+    fluid_atomic_float_set(&synth->cpu_load, cpu_load);
+
+    /* stop duration probe and save performance measurement (if profiling is enabled) */
+    fluid_profile_write(FLUID_PROF_WRITE, prof_ref,
+                        fluid_rvoice_mixer_get_active_voices(synth->eventhandler->mixer),
+                        len);
+    return FLUID_OK;
+}
+
+/* for testing purpose */
+int
+fluid_synth_write_float_LOCAL(fluid_synth_t *synth, int len,
+                              void *lout, int loff, int lincr,
+                              void *rout, int roff, int rincr,
+                              int (*block_render_func)(fluid_synth_t *, int)
+                             )
+{
+    void *channels_out[2] = {lout, rout};
+    int channels_off[2] = {loff, roff };
+    int channels_incr[2] = {lincr, rincr };
+
+    return fluid_synth_write_float_channels_LOCAL(synth, len, 2, channels_out,
+                                            channels_off, channels_incr,
+                                            block_render_func);
+}
+
+/**
+ * Synthesize a block of 16 bit audio samples to audio buffers.
+ * @param synth FluidSynth instance
+ * @param len Count of audio frames to synthesize
+ * @param lout Array of 16 bit words to store left channel of audio
+ * @param loff Offset index in 'lout' for first sample
+ * @param lincr Increment between samples stored to 'lout'
+ * @param rout Array of 16 bit words to store right channel of audio
+ * @param roff Offset index in 'rout' for first sample
+ * @param rincr Increment between samples stored to 'rout'
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * Useful for storing interleaved stereo (lout = rout, loff = 0, roff = 1,
+ * lincr = 2, rincr = 2).
+ *
+ * @note Should only be called from synthesis thread.
+ * @note Reverb and Chorus are mixed to \c lout resp. \c rout.
+ * @note Dithering is performed when converting from internal floating point to
+ * 16 bit audio.
+ */
+int
+fluid_synth_write_s16(fluid_synth_t *synth, int len,
+                      void *lout, int loff, int lincr,
+                      void *rout, int roff, int rincr)
+{
+    return fluid_synth_write_s16_cpp(synth, len,
+                                     lout, loff, lincr,
+                                     rout, roff, rincr);
+}
+
+/**
+ * Synthesize a block of 24 bit audio samples to audio buffers.
+ * @param synth FluidSynth instance
+ * @param len Count of audio frames to synthesize
+ * @param lout Array of 32 bit words to store left channel of audio
+ * @param loff Offset index in 'lout' for first sample
+ * @param lincr Increment between samples stored to 'lout'
+ * @param rout Array of 32 bit words to store right channel of audio
  * @param roff Offset index in 'rout' for first sample
  * @param rincr Increment between samples stored to 'rout'
  * @return #FLUID_OK on success, #FLUID_FAILED otherwise
@@ -4991,10 +7177,112 @@ int fluid_synth_write_s32_channels(fluid_synth_t *synth, int len,
                                void *channels_out[], int channels_off[],
                                int channels_incr[])
 {
-    return fluid_synth_write_s32_channels_cpp(synth, len,
-                                              channels_count,
-                                              channels_out, channels_off,
-                                              channels_incr);
+    return fluid_synth_write_s32_channels_cpp(synth, len,
+                                              channels_count,
+                                              channels_out, channels_off,
+                                              channels_incr);
+}
+
+/**
+ * Synthesize a block of audio samples of any format straight into the buffers
+ * of the caller.
+ *
+ * The samples are converted from the internal mixer buffers into the
+ * destination as they are output, there is no need to render into a buffer of
+ * floats first and to convert or reorder it afterwards. Audio drivers may
+ * pass the buffers of the audio device, planar, interleaved or with any
+ * channel mapping.
+ *
+ * @param synth FluidSynth instance.
+ * @param len Count of audio frames to synthesize.
+ * @param format Format of the samples to store, see #fluid_sample_format.
+ * @param channels_count Count of channels in a frame.
+ *  must be multiple of 2 and channel_count/2 must not exceed the number
+ *  of internal mixer buffers (synth->audio_groups)
+ * @param channels_out Array of channels_count pointers on the buffers to store
+ *  the channels to, on floats, 16 bit words or 32 bit words depending on \c format.
+ *  The same buffer may be used for several channels. Modified on return.
+ * @param channels_off Array of channels_count offset index to add to respective pointer
+ *  in channels_out for first sample.
+ * @param channels_incr Array of channels_count increment between consecutive
+ *  samples channels.
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise.
+ *
+ * Example for the left and right channel of the second audio group swapped,
+ * interleaved in a unique buffer \c buf:
+ * @code{.cpp}
+ * void *out[4] = { buf, buf, buf, buf };
+ * int off[4] = { 0, 1, 3, 2 };
+ * int incr[4] = { 4, 4, 4, 4 };
+ * fluid_synth_write_channels(synth, len, FLUID_SAMPLE_FORMAT_S16, 4, out, off, incr);
+ * @endcode
+ *
+ * @note Should only be called from synthesis thread.
+ * @note Reverb and Chorus are mixed into the output channels.
+ * @since 2.6.0
+ */
+int fluid_synth_write_channels(fluid_synth_t *synth, int len,
+                               enum fluid_sample_format format, int channels_count,
+                               void *channels_out[], int channels_off[],
+                               int channels_incr[])
+{
+    switch(format)
+    {
+    case FLUID_SAMPLE_FORMAT_FLOAT:
+        return fluid_synth_write_float_channels(synth, len, channels_count,
+                                                channels_out, channels_off, channels_incr);
+
+    case FLUID_SAMPLE_FORMAT_S16:
+        return fluid_synth_write_s16_channels(synth, len, channels_count,
+                                              channels_out, channels_off, channels_incr);
+
+    case FLUID_SAMPLE_FORMAT_S24:
+        return fluid_synth_write_s24_channels(synth, len, channels_count,
+                                              channels_out, channels_off, channels_incr);
+
+    case FLUID_SAMPLE_FORMAT_S32:
+        return fluid_synth_write_s32_channels(synth, len, channels_count,
+                                              channels_out, channels_off, channels_incr);
+
+    default:
+        FLUID_LOG(FLUID_ERR, "Unknown sample format %d", (int)format);
+        return FLUID_FAILED;
+    }
+}
+
+/*
+ * Called by a voice that no longer uses a sample. Notifying the owner of the sample that
+ * it isn't used anymore may free its data, e.g. with dynamic sample loading, so the
+ * synthesis thread keeps the last reference to a sample until the next API call, see
+ * fluid_synth_notify_released_samples_LOCAL(). synth may be NULL, which releases it
+ * right away.
+ */
+void
+fluid_synth_release_sample_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample)
+{
+    if(synth != NULL && synth->defer_sample_release && sample->notify != NULL
+            && fluid_atomic_int_get(&sample->refcount) == 1
+            && synth->released_count < synth->released_size)
+    {
+        synth->released_samples[synth->released_count++] = sample;
+        return;
+    }
+
+    fluid_sample_decr_ref(sample);
+}
+
+/* Drops the references kept by fluid_synth_release_sample_LOCAL() */
+static void
+fluid_synth_notify_released_samples_LOCAL(fluid_synth_t *synth)
+{
+    int i;
+
+    for(i = 0; i < synth->released_count; i++)
+    {
+        fluid_sample_decr_ref(synth->released_samples[i]);
+    }
+
+    synth->released_count = 0;
 }
 
 static void
@@ -5005,10 +7293,16 @@ fluid_synth_check_finished_voices(fluid_synth_t *synth)
 
     while(NULL != (fv = fluid_rvoice_eventhandler_get_finished_voice(synth->eventhandler)))
     {
-        for(j = 0; j < synth->polyphony; j++)
+        /* also the voices above a lowered polyphony, which have been turned off */
+        for(j = 0; j < synth->nvoice; j++)
         {
             if(synth->voice[j]->rvoice == fv)
             {
+                if(!synth->voice[j]->stolen)
+                {
+                    fluid_synth_count_voice_LOCAL(synth, synth->voice[j]->chan, FLUID_VOICE_COUNT_FINISHED);
+                }
+
                 fluid_voice_unlock_rvoice(synth->voice[j]);
                 fluid_voice_stop(synth->voice[j]);
                 break;
@@ -5021,48 +7315,500 @@ fluid_synth_check_finished_voices(fluid_synth_t *synth)
                 */
                 fluid_voice_overflow_rvoice_finished(synth->voice[j]);
 
-                /* Decrement synth active voice count. Must not be incorporated
-                   in fluid_voice_overflow_rvoice_finished() because
-                   fluid_voice_overflow_rvoice_finished() is called also
-                   at synth destruction and in this case the variable should be
-                   accessed via voice->channel->synth->active_voice_count.
-                   And for certain voices which are not playing, the field
-                   voice->channel is NULL.
-                */
-                synth->active_voice_count--;
-                break;
-            }
+                /* Decrement synth active voice count. Must not be incorporated
+                   in fluid_voice_overflow_rvoice_finished() because
+                   fluid_voice_overflow_rvoice_finished() is called also
+                   at synth destruction and in this case the variable should be
+                   accessed via voice->channel->synth->active_voice_count.
+                   And for certain voices which are not playing, the field
+                   voice->channel is NULL.
+                */
+                synth->active_voice_count--;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Process all waiting events in the rvoice queue.
+ * Make sure no (other) rendering is running in parallel when
+ * you call this function!
+ */
+void fluid_synth_process_event_queue(fluid_synth_t *synth)
+{
+    fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
+}
+
+
+/*
+ * Returns TRUE if events queued by fluid_synth_queue_midi_events() are due
+ * in the block starting at the given tick. Never waits for the API lock: while
+ * another thread holds it, the events are considered due in a later block.
+ */
+static int fluid_synth_midi_queue_is_due(fluid_synth_t *synth, unsigned int ticks)
+{
+    int is_due;
+
+    if(fluid_atomic_int_get(&synth->midi_queue_count) == 0)
+    {
+        return FALSE;
+    }
+
+    if(!fluid_synth_api_try_enter(synth))
+    {
+        return FALSE;
+    }
+
+    is_due = (synth->midi_queue_head < synth->midi_queue_tail
+              && (int)(synth->midi_queue[synth->midi_queue_head].dtime - ticks) < FLUID_BUFSIZE);
+    fluid_synth_api_exit(synth);
+
+    return is_due;
+}
+
+/*
+ * Applies the events queued by fluid_synth_queue_midi_events() that are due in the
+ * block starting at the given tick. Takes the API lock once for all of them, or
+ * leaves them queued if another thread holds it.
+ */
+static void fluid_synth_process_midi_queue(fluid_synth_t *synth, unsigned int ticks)
+{
+    fluid_midi_event_t *event;
+
+    if(!fluid_synth_api_try_enter(synth))
+    {
+        return;
+    }
+
+    while(synth->midi_queue_head < synth->midi_queue_tail)
+    {
+        event = &synth->midi_queue[synth->midi_queue_head];
+
+        if((int)(event->dtime - ticks) >= FLUID_BUFSIZE)
+        {
+            break;
+        }
+
+        /* voices start and release at the offset of the event within the block */
+        if(synth->sample_accurate_events && (int)(event->dtime - ticks) > 0)
+        {
+            synth->event_offset = event->dtime - ticks;
+        }
+
+        fluid_synth_handle_midi_event(synth, event);
+        synth->event_offset = 0;
+
+        if(event->type == MIDI_SYSEX)
+        {
+            FLUID_FREE(event->paramptr);
+        }
+
+        synth->midi_queue_head++;
+    }
+
+    fluid_atomic_int_set(&synth->midi_queue_count, synth->midi_queue_tail - synth->midi_queue_head);
+    fluid_synth_api_exit(synth);
+}
+
+/*
+ * Limits the interpolation of the playing and new voices to linear, or lifts the limit.
+ */
+static void
+fluid_synth_governor_limit_interp_LOCAL(fluid_synth_t *synth, int limited)
+{
+    fluid_voice_t *voice;
+    int i, interp_method;
+
+    if(synth->governor.interp_limited == limited)
+    {
+        return;
+    }
+
+    synth->governor.interp_limited = limited;
+
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
+    {
+        voice = synth->voice[i];
+
+        if(!fluid_voice_is_playing(voice))
+        {
+            continue;
+        }
+
+        interp_method = fluid_channel_get_interp_method(voice->channel);
+
+        if(interp_method > FLUID_INTERP_LINEAR)
+        {
+            fluid_voice_set_interp_method(voice, limited ? FLUID_INTERP_LINEAR : interp_method);
+        }
+    }
+}
+
+/*
+ * Finds the playing voice to kill next by fluid_voice_get_overflow_prio(), ranked after the
+ * voice last with priority *prio, so that voices turned off before can be skipped. They
+ * keep their place in the overflow tree until they have finished, so the priorities are
+ * compared directly here.
+ * Returns the index of the voice and updates *prio, -1 if no voice can be killed.
+ */
+static int
+fluid_synth_governor_find_kill_LOCAL(fluid_synth_t *synth, float *prio, int last)
+{
+    unsigned int ticks = fluid_synth_get_ticks(synth);
+    float voice_prio, best_prio = OVERFLOW_PRIO_CANNOT_KILL;
+    int i, best = -1;
+
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
+    {
+        if(!fluid_voice_is_playing(synth->voice[i]))
+        {
+            continue;
+        }
+
+        voice_prio = fluid_voice_get_overflow_prio(synth->voice[i], &synth->overflow, ticks);
+
+        if(voice_prio < *prio || (voice_prio == *prio && i <= last))
+        {
+            continue;
+        }
+
+        if(voice_prio < best_prio)
+        {
+            best_prio = voice_prio;
+            best = i;
+        }
+    }
+
+    if(best >= 0)
+    {
+        *prio = best_prio;
+    }
+
+    return best;
+}
+
+/*
+ * Turns off count voices, lowest overflow priority first.
+ */
+static void
+fluid_synth_governor_shed_voices_LOCAL(fluid_synth_t *synth, int count)
+{
+    float prio = -OVERFLOW_PRIO_CANNOT_KILL;
+    int last = -1;
+
+    fluid_synth_apply_modulations_before_kill_LOCAL(synth);
+
+    for(; count > 0; count--)
+    {
+        last = fluid_synth_governor_find_kill_LOCAL(synth, &prio, last);
+
+        if(last < 0)
+        {
+            break;
+        }
+
+        fluid_voice_off(synth->voice[last]);
+    }
+}
+
+/*
+ * The load is too high: first lower the interpolation if allowed, then drop an eighth
+ * of the playing voices at a time.
+ */
+static void
+fluid_synth_governor_lower_LOCAL(fluid_synth_t *synth)
+{
+    fluid_synth_governor_t *governor = &synth->governor;
+    int limit = governor->polyphony ? governor->polyphony : synth->polyphony;
+
+    if(governor->interpolation && !governor->interp_limited)
+    {
+        FLUID_LOG(FLUID_DBG, "Governor: load %.2f, limiting interpolation", governor->load);
+        fluid_synth_governor_limit_interp_LOCAL(synth, TRUE);
+        return;
+    }
+
+    if(synth->active_voice_count < limit)
+    {
+        limit = synth->active_voice_count;
+    }
+
+    limit -= (limit / 8 > 0) ? limit / 8 : 1;
+
+    if(limit < governor->min_polyphony)
+    {
+        limit = governor->min_polyphony;
+    }
+
+    if(limit >= synth->polyphony || limit == governor->polyphony)
+    {
+        return;
+    }
+
+    FLUID_LOG(FLUID_DBG, "Governor: load %.2f, limiting polyphony to %d", governor->load, limit);
+    governor->polyphony = limit;
+
+    if(synth->active_voice_count > limit)
+    {
+        fluid_synth_governor_shed_voices_LOCAL(synth, synth->active_voice_count - limit);
+    }
+}
+
+/*
+ * The load has been low for a while: raise the polyphony in steps of a sixteenth of
+ * synth.polyphony, then lift the interpolation limit.
+ */
+static void
+fluid_synth_governor_raise_LOCAL(fluid_synth_t *synth)
+{
+    fluid_synth_governor_t *governor = &synth->governor;
+
+    if(governor->polyphony != 0)
+    {
+        governor->polyphony += (synth->polyphony / 16 > 0) ? synth->polyphony / 16 : 1;
+
+        if(governor->polyphony >= synth->polyphony)
+        {
+            governor->polyphony = 0;
+        }
+
+        FLUID_LOG(FLUID_DBG, "Governor: load %.2f, raising polyphony to %d", governor->load,
+                  governor->polyphony ? governor->polyphony : synth->polyphony);
+    }
+    else if(governor->interp_limited)
+    {
+        FLUID_LOG(FLUID_DBG, "Governor: load %.2f, restoring interpolation", governor->load);
+        fluid_synth_governor_limit_interp_LOCAL(synth, FALSE);
+    }
+}
+
+/*
+ * Adapts the polyphony to the time it took to render blockcount blocks, see
+ * synth.governor.active. Called by the rendering thread, which only takes the API lock if
+ * no other thread holds it.
+ *
+ * The load is smoothed over FLUID_GOVERNOR_SMOOTHING seconds. If it exceeds the target, or
+ * a single render call misses its deadline, the governor steps in and then holds off for
+ * FLUID_GOVERNOR_HOLD seconds to see the effect. Only once the load has stayed below
+ * FLUID_GOVERNOR_HYSTERESIS times the target for FLUID_GOVERNOR_CALM seconds, one step
+ * is taken back.
+ */
+void
+fluid_synth_govern(fluid_synth_t *synth, double usec, int blockcount)
+{
+    fluid_synth_governor_t *governor = &synth->governor;
+    double duration = blockcount * FLUID_BUFSIZE * 1000000.0 / synth->sample_rate;
+    double load, weight;
+    unsigned int ticks;
+
+    if(blockcount <= 0)
+    {
+        return;
+    }
+
+    load = usec / duration;
+    weight = duration / (FLUID_GOVERNOR_SMOOTHING * 1000000.0);
+    governor->load += (load - governor->load) * (weight < 1.0 ? weight : 1.0);
+
+    if(!fluid_synth_api_try_enter(synth))
+    {
+        return;
+    }
+
+    ticks = fluid_synth_get_ticks(synth);
+
+    if((int)(ticks - governor->hold_until) >= 0)
+    {
+        if(governor->load > governor->target_load || load > 1.0)
+        {
+            fluid_synth_governor_lower_LOCAL(synth);
+            governor->hold_until = ticks + (unsigned int)(FLUID_GOVERNOR_HOLD * synth->sample_rate);
+            governor->calm = FALSE;
+        }
+        else if(governor->load > governor->target_load * FLUID_GOVERNOR_HYSTERESIS
+                || (governor->polyphony == 0 && !governor->interp_limited))
+        {
+            governor->calm = FALSE;
+        }
+        else if(!governor->calm)
+        {
+            governor->calm = TRUE;
+            governor->calm_since = ticks;
+        }
+        else if(ticks - governor->calm_since >= (unsigned int)(FLUID_GOVERNOR_CALM * synth->sample_rate))
+        {
+            fluid_synth_governor_raise_LOCAL(synth);
+            governor->calm_since = ticks;
+        }
+    }
+
+    fluid_synth_api_exit(synth);
+}
+
+/**
+ * Process blocks (FLUID_BUFSIZE) of audio at the output rate.
+ * Must be called from renderer thread only!
+ * @return number of blocks rendered. Might (often) return less than requested
+ */
+int
+fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
+{
+    fluid_out_resampler_t *rs = synth->resampler;
+    fluid_real_t *left, *right, *fx_left, *fx_right;
+    int needed, blocks;
+
+    if(rs == NULL)
+    {
+        return fluid_synth_render_mixer_blocks(synth, blockcount);
+    }
+
+    fluid_clip(blockcount, 1, fluid_rvoice_mixer_get_bufcount(synth->eventhandler->mixer));
+
+    /* render at the internal rate until the resampler has the input for all blocks */
+    while((needed = fluid_out_resampler_get_needed(rs, blockcount * FLUID_BUFSIZE)) > 0)
+    {
+        blocks = fluid_synth_render_mixer_blocks(synth, (needed + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE);
+
+        fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, &left, &right);
+        fluid_rvoice_mixer_get_fx_bufs(synth->eventhandler->mixer, &fx_left, &fx_right);
+        fluid_out_resampler_push(rs, left, right, fx_left, fx_right,
+                                 fluid_rvoice_mixer_get_live_bufs(synth->eventhandler->mixer),
+                                 blocks * FLUID_BUFSIZE);
+    }
+
+    fluid_out_resampler_pull(rs, blockcount * FLUID_BUFSIZE);
+
+    return blockcount;
+}
+
+/* Like fluid_rvoice_mixer_get_bufs(), for the output of fluid_synth_render_blocks() */
+static void
+fluid_synth_get_out_bufs(fluid_synth_t *synth, fluid_real_t **left, fluid_real_t **right)
+{
+    if(synth->resampler != NULL)
+    {
+        fluid_out_resampler_get_bufs(synth->resampler, left, right);
+    }
+    else
+    {
+        fluid_rvoice_mixer_get_bufs(synth->eventhandler->mixer, left, right);
+    }
+}
+
+/* Like fluid_rvoice_mixer_get_fx_bufs(), for the output of fluid_synth_render_blocks() */
+static void
+fluid_synth_get_out_fx_bufs(fluid_synth_t *synth, fluid_real_t **fx_left, fluid_real_t **fx_right)
+{
+    if(synth->resampler != NULL)
+    {
+        fluid_out_resampler_get_fx_bufs(synth->resampler, fx_left, fx_right);
+    }
+    else
+    {
+        fluid_rvoice_mixer_get_fx_bufs(synth->eventhandler->mixer, fx_left, fx_right);
+    }
+}
+
+/* Like fluid_rvoice_mixer_get_live_bufs(), for the output of fluid_synth_render_blocks() */
+static const unsigned char *
+fluid_synth_get_out_live_bufs(fluid_synth_t *synth)
+{
+    if(synth->resampler != NULL)
+    {
+        return fluid_out_resampler_get_live_bufs(synth->resampler);
+    }
+
+    return fluid_rvoice_mixer_get_live_bufs(synth->eventhandler->mixer);
+}
+
+/*
+ * Creates the resampler from sample_rate to output_rate, or deletes it if both
+ * are the same. Must not be called while rendering.
+ */
+static int
+fluid_synth_update_resampler(fluid_synth_t *synth)
+{
+    fluid_out_resampler_t *rs = NULL;
+
+    if(synth->sample_rate != synth->output_rate)
+    {
+        rs = new_fluid_out_resampler(synth->sample_rate, synth->output_rate, synth->audio_groups,
+                                     synth->effects_channels * synth->effects_groups);
+
+        if(rs == NULL)
+        {
+            return FLUID_FAILED;
         }
     }
+
+    delete_fluid_out_resampler(synth->resampler);
+    synth->resampler = rs;
+    return FLUID_OK;
 }
 
-/**
- * Process all waiting events in the rvoice queue.
- * Make sure no (other) rendering is running in parallel when
- * you call this function!
+/*
+ * Records the latency of the notes whose first voice has just been rendered: the time since
+ * the MIDI driver received the note-on, the offset of the note in the blocks rendered since
+ * start_ticks and the output latency of the audio driver.
  */
-void fluid_synth_process_event_queue(fluid_synth_t *synth)
+static void
+fluid_synth_record_note_latency(fluid_synth_t *synth, unsigned int start_ticks)
 {
-    fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
-}
+    fluid_synth_note_ingress_t *note;
+    unsigned int end_ticks = fluid_synth_get_ticks(synth);
+    unsigned int now = fluid_midi_ingress_now();
+    double output_latency = fluid_atomic_int_get(&synth->output_latency);
+    double elapsed;
+    int offset;
 
+    while((note = fluid_ringbuffer_get_outptr(synth->note_latency_queue)) != NULL
+            && (int)(note->tick - end_ticks) < 0)
+    {
+        elapsed = (double)(now - note->ingress);
+        offset = (int)(note->tick - start_ticks);
 
-/**
- * Process blocks (FLUID_BUFSIZE) of audio.
+        /* events stamped by a driver that didn't clear them may carry any time */
+        if(elapsed < FLUID_NOTE_LATENCY_MAX)
+        {
+            fluid_perf_record(&synth->perf->note_latency, elapsed + output_latency
+                              + ((offset > 0) ? offset : 0) * 1000000.0 / synth->sample_rate);
+        }
+
+        fluid_ringbuffer_next_outptr(synth->note_latency_queue);
+    }
+}
+
+/*
+ * Process blocks (FLUID_BUFSIZE) of audio at the internal rate into the mixer buffers.
  * Must be called from renderer thread only!
  * @return number of blocks rendered. Might (often) return less than requested
  */
-int
-fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
+static int
+fluid_synth_render_mixer_blocks(fluid_synth_t *synth, int blockcount)
 {
     int i, maxblocks;
+    double perf_ref = fluid_perf_ref(synth->perf);
+    double trace_ref = fluid_trace_ref();
+    double governor_ref = fluid_atomic_int_get(&synth->governor.active) ? fluid_perf_now() : 0.0;
+    unsigned int fp_mode = 0;
+    unsigned int start_ticks = fluid_synth_get_ticks(synth);
     fluid_profile_ref_var(prof_ref);
 
     /* Assign ID of synthesis thread */
 //  synth->synth_thread_id = fluid_thread_get_id ();
 
+    fluid_rt_thread_enter();
+
+    if(synth->flush_denormals)
+    {
+        fp_mode = fluid_denormals_flush_enter();
+    }
+
     fluid_check_fpe("??? Just starting up ???");
 
+    fluid_synth_process_api_queue(synth);
+    fluid_synth_apply_modulations(synth);
     fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
 
     /* do not render more blocks than we can store internally */
@@ -5075,7 +7821,25 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
 
     for(i = 0; i < blockcount; i++)
     {
+        /* Queued MIDI events take effect in the block they are due in: stop before that
+         * block, unless it is the first one, whose events can still be dispatched now
+         */
+        if(fluid_synth_midi_queue_is_due(synth, fluid_synth_get_ticks(synth)))
+        {
+            if(i > 0)
+            {
+                blockcount = i;
+                break;
+            }
+
+            fluid_synth_process_midi_queue(synth, fluid_synth_get_ticks(synth));
+            fluid_synth_apply_modulations(synth);
+            fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
+        }
+
         fluid_sample_timer_process(synth);
+        fluid_synth_process_api_queue(synth);
+        fluid_synth_apply_modulations(synth);
         fluid_synth_add_ticks(synth, FLUID_BUFSIZE);
 
         /* If events have been queued waiting for fluid_rvoice_eventhandler_dispatch_all()
@@ -5093,6 +7857,11 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
 
     blockcount = fluid_rvoice_mixer_render(synth->eventhandler->mixer, blockcount);
 
+    if(fluid_ringbuffer_get_count(synth->note_latency_queue) > 0)
+    {
+        fluid_synth_record_note_latency(synth, start_ticks);
+    }
+
     /* Testcase, that provokes a denormal floating point error */
 #if 0
     {
@@ -5108,9 +7877,79 @@ fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount)
     fluid_profile(FLUID_PROF_ONE_BLOCK, prof_ref,
                   fluid_rvoice_mixer_get_active_voices(synth->eventhandler->mixer),
                   blockcount * FLUID_BUFSIZE);
+    fluid_perf_stage(synth->perf, FLUID_PERF_STAGE_RENDER, perf_ref);
+    fluid_trace_span("render_blocks", trace_ref);
+
+    if(governor_ref != 0.0)
+    {
+        fluid_synth_govern(synth, fluid_perf_now() - governor_ref, blockcount);
+    }
+
+    if(synth->flush_denormals)
+    {
+        fluid_denormals_flush_exit(fp_mode);
+    }
+
+    fluid_rt_thread_exit();
+
     return blockcount;
 }
 
+/*
+ * Advances the time of a silent synth by up to len frames without rendering, in whole
+ * blocks, for fluid_player_render() and fluid_sequencer_render(). The sample timers
+ * aren't called for the skipped blocks, the caller has to know they have nothing to do.
+ * Returns the number of frames skipped, 0 if voices are playing, samples are still
+ * buffered by fluid_synth_write_float(), queued MIDI events are due or the output is
+ * resampled, which keeps the tail of the last output in its filter.
+ */
+int
+fluid_synth_skip_silence(fluid_synth_t *synth, int len)
+{
+    int blocks = len / FLUID_BUFSIZE;
+    unsigned int ticks = fluid_synth_get_ticks(synth);
+    int due;
+
+    if(blocks <= 0 || synth->cur < synth->curmax || synth->resampler != NULL)
+    {
+        return 0;
+    }
+
+    fluid_synth_process_api_queue(synth);
+    fluid_synth_apply_modulations(synth);
+    fluid_rvoice_eventhandler_dispatch_all(synth->eventhandler);
+
+    if(synth->active_voice_count > 0)
+    {
+        return 0;
+    }
+
+    /* stop before the block the first queued MIDI event is due in */
+    if(fluid_atomic_int_get(&synth->midi_queue_count) > 0)
+    {
+        if(!fluid_synth_api_try_enter(synth))
+        {
+            return 0;
+        }
+
+        if(synth->midi_queue_head < synth->midi_queue_tail)
+        {
+            due = (int)(synth->midi_queue[synth->midi_queue_head].dtime - ticks) / FLUID_BUFSIZE;
+
+            if(due < blocks)
+            {
+                blocks = (due > 0) ? due : 0;
+            }
+        }
+
+        fluid_synth_api_exit(synth);
+    }
+
+    fluid_synth_add_ticks(synth, blocks * FLUID_BUFSIZE);
+
+    return blocks * FLUID_BUFSIZE;
+}
+
 /*
  * Handler for synth.reverb.* and synth.chorus.* double settings.
  */
@@ -5199,49 +8038,322 @@ static void fluid_synth_handle_overflow(void *data, const char *name, double val
     }
     else if(FLUID_STRCMP(name, "synth.overflow.age") == 0)
     {
-        synth->overflow.age = value;
+        synth->overflow.age = value;
+    }
+    else if(FLUID_STRCMP(name, "synth.overflow.important") == 0)
+    {
+        synth->overflow.important = value;
+    }
+
+    fluid_synth_invalidate_overflow_prio_LOCAL(synth);
+    fluid_synth_api_exit(synth);
+}
+
+/*
+ * Updates the overflow priority of a voice in the overflow tree. Must be called whenever
+ * the availability of the voice or a property used by fluid_voice_get_overflow_base_prio()
+ * changes.
+ */
+void
+fluid_synth_update_overflow_prio_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice)
+{
+    float prio;
+
+    if(synth->overflow_tree == NULL || synth->overflow_tree_outdated || voice->index >= synth->polyphony)
+    {
+        return;
+    }
+
+    if(_AVAILABLE(voice))
+    {
+        prio = FLUID_OVERFLOW_PRIO_AVAILABLE;
+    }
+    else
+    {
+        prio = fluid_voice_get_overflow_base_prio(voice, &synth->overflow);
+    }
+
+    fluid_overflow_tree_set(synth->overflow_tree, voice->index, prio, voice->start_time);
+}
+
+/*
+ * Marks the overflow priorities of all voices as outdated, e.g. because the overflow
+ * scores or the type of a channel have changed. The overflow tree is rebuilt lazily.
+ */
+void
+fluid_synth_invalidate_overflow_prio_LOCAL(fluid_synth_t *synth)
+{
+    synth->overflow_tree_outdated = TRUE;
+}
+
+static void
+fluid_synth_insert_voice(fluid_voice_t **head, fluid_voice_t *voice, int list)
+{
+    fluid_voice_t *prev = NULL;
+    fluid_voice_t *next = *head;
+
+    /* keep the list ordered like the voice array, which is the order of the voices scanned before */
+    while(next != NULL && next->index < voice->index)
+    {
+        prev = next;
+        next = next->list_next[list];
+    }
+
+    voice->list_prev[list] = prev;
+    voice->list_next[list] = next;
+
+    if(prev != NULL)
+    {
+        prev->list_next[list] = voice;
+    }
+    else
+    {
+        *head = voice;
+    }
+
+    if(next != NULL)
+    {
+        next->list_prev[list] = voice;
+    }
+}
+
+static void
+fluid_synth_remove_voice(fluid_voice_t **head, fluid_voice_t *voice, int list)
+{
+    if(voice->list_prev[list] != NULL)
+    {
+        voice->list_prev[list]->list_next[list] = voice->list_next[list];
+    }
+    else
+    {
+        *head = voice->list_next[list];
+    }
+
+    if(voice->list_next[list] != NULL)
+    {
+        voice->list_next[list]->list_prev[list] = voice->list_prev[list];
+    }
+
+    voice->list_prev[list] = voice->list_next[list] = NULL;
+}
+
+/*
+ * Adds the voice to the lists of voices playing its key on its channel and playing on its
+ * channel, which allow to find the voices of a note without scanning all voices. Must be
+ * called whenever the voice gets a channel or key, fluid_synth_unlink_voice_LOCAL() before
+ * they change.
+ *
+ * The lists are not restricted to playing voices, users still have to check the state of
+ * each voice. Keys are only expected from 0 to 127, voices with other keys are added to
+ * the list of the key with the same lower 7 bits.
+ */
+void
+fluid_synth_link_voice_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice)
+{
+    if(voice->index < 0 || voice->chan >= synth->midi_channels)
+    {
+        return;
+    }
+
+    fluid_synth_insert_voice(&FLUID_SYNTH_NOTE_VOICES(synth, voice->chan, voice->key), voice, FLUID_VOICE_LIST_NOTE);
+    fluid_synth_insert_voice(&FLUID_SYNTH_CHANNEL_VOICES(synth, voice->chan), voice, FLUID_VOICE_LIST_CHANNEL);
+    fluid_atomic_int_inc(&synth->voice_counters[voice->chan][FLUID_VOICE_COUNT_ACTIVE]);
+}
+
+void
+fluid_synth_unlink_voice_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice)
+{
+    if(voice->index < 0 || voice->chan >= synth->midi_channels)
+    {
+        return;
+    }
+
+    fluid_synth_remove_voice(&FLUID_SYNTH_NOTE_VOICES(synth, voice->chan, voice->key), voice, FLUID_VOICE_LIST_NOTE);
+    fluid_synth_remove_voice(&FLUID_SYNTH_CHANNEL_VOICES(synth, voice->chan), voice, FLUID_VOICE_LIST_CHANNEL);
+    fluid_atomic_int_add(&synth->voice_counters[voice->chan][FLUID_VOICE_COUNT_ACTIVE], -1);
+}
+
+/* Counts a voice event of a channel, for the channel and the whole synth */
+static void
+fluid_synth_count_voice_LOCAL(fluid_synth_t *synth, int chan, enum fluid_voice_counter counter)
+{
+    if(chan >= 0 && chan < synth->midi_channels)
+    {
+        fluid_atomic_int_inc(&synth->voice_counters[chan][counter]);
+    }
+
+    fluid_atomic_int_inc(&synth->voice_counters[synth->midi_channels][counter]);
+}
+
+/* Kills a voice to make room for a new one */
+static void
+fluid_synth_steal_voice_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice)
+{
+    fluid_voice_off(voice);
+    voice->stolen = TRUE;
+    fluid_synth_count_voice_LOCAL(synth, voice->chan, FLUID_VOICE_COUNT_STOLEN);
+}
+
+/* Records the voices now active on a channel and in the synth if they are the most so far */
+static void
+fluid_synth_update_voice_peak_LOCAL(fluid_synth_t *synth, int chan)
+{
+    fluid_atomic_int_t *counters = synth->voice_counters[synth->midi_channels];
+
+    if(synth->active_voice_count > fluid_atomic_int_get(&counters[FLUID_VOICE_COUNT_PEAK]))
+    {
+        fluid_atomic_int_set(&counters[FLUID_VOICE_COUNT_PEAK], synth->active_voice_count);
+    }
+
+    if(chan >= 0 && chan < synth->midi_channels)
+    {
+        counters = synth->voice_counters[chan];
+
+        if(fluid_atomic_int_get(&counters[FLUID_VOICE_COUNT_ACTIVE]) > fluid_atomic_int_get(&counters[FLUID_VOICE_COUNT_PEAK]))
+        {
+            fluid_atomic_int_set(&counters[FLUID_VOICE_COUNT_PEAK], fluid_atomic_int_get(&counters[FLUID_VOICE_COUNT_ACTIVE]));
+        }
+    }
+}
+
+static void
+fluid_synth_rebuild_overflow_tree_LOCAL(fluid_synth_t *synth)
+{
+    int i;
+
+    if(!synth->overflow_tree_outdated)
+    {
+        return;
+    }
+
+    synth->overflow_tree_outdated = FALSE;
+
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
+    {
+        fluid_synth_update_overflow_prio_LOCAL(synth, synth->voice[i]);
+    }
+}
+
+/*
+ * Finds the playing voice of a channel to kill next by fluid_voice_get_overflow_prio(),
+ * ranked after the voice last with priority *prio, like fluid_synth_governor_find_kill_LOCAL().
+ * The voices of the noteon being started are spared.
+ */
+static fluid_voice_t *
+fluid_synth_channel_find_kill_LOCAL(fluid_synth_t *synth, int chan, float *prio, int last)
+{
+    unsigned int ticks = fluid_synth_get_ticks(synth);
+    float voice_prio, best_prio = OVERFLOW_PRIO_CANNOT_KILL;
+    fluid_voice_t *voice, *best = NULL;
+
+    for(voice = FLUID_SYNTH_CHANNEL_VOICES(synth, chan);
+            voice != NULL && voice->index < synth->polyphony;
+            voice = voice->list_next[FLUID_VOICE_LIST_CHANNEL])
+    {
+        if(!fluid_voice_is_playing(voice) || fluid_voice_get_id(voice) == synth->storeid)
+        {
+            continue;
+        }
+
+        voice_prio = fluid_voice_get_overflow_prio(voice, &synth->overflow, ticks);
+
+        if(voice_prio < *prio || (voice_prio == *prio && voice->index <= last))
+        {
+            continue;
+        }
+
+        if(voice_prio < best_prio)
+        {
+            best_prio = voice_prio;
+            best = voice;
+        }
+    }
+
+    if(best != NULL)
+    {
+        *prio = best_prio;
+    }
+
+    return best;
+}
+
+/*
+ * Makes room for a voice costing cost within the polyphony and cost budget of a channel,
+ * by killing the voices of the channel with the lowest overflow priority. *voice is set to
+ * the last one killed, which can be used right away, NULL if none had to be.
+ * Returns FLUID_FAILED if the voices that may be killed don't make enough room.
+ */
+static int
+fluid_synth_limit_channel_LOCAL(fluid_synth_t *synth, int chan, int cost, fluid_voice_t **voice)
+{
+    fluid_channel_t *channel = synth->channel[chan];
+    fluid_voice_t *v;
+    float prio = -OVERFLOW_PRIO_CANNOT_KILL;
+    int count = 0, total = 0;
+
+    *voice = NULL;
+
+    if(channel->polyphony == 0 && channel->cost_budget == 0)
+    {
+        return FLUID_OK;
+    }
+
+    for(v = FLUID_SYNTH_CHANNEL_VOICES(synth, chan);
+            v != NULL && v->index < synth->polyphony;
+            v = v->list_next[FLUID_VOICE_LIST_CHANNEL])
+    {
+        if(fluid_voice_is_playing(v))
+        {
+            count++;
+            total += v->cost;
+        }
     }
-    else if(FLUID_STRCMP(name, "synth.overflow.important") == 0)
+
+    while((channel->polyphony != 0 && count >= channel->polyphony)
+            || (channel->cost_budget != 0 && total + cost > channel->cost_budget))
     {
-        synth->overflow.important = value;
+        fluid_synth_apply_modulations_before_kill_LOCAL(synth);
+        v = fluid_synth_channel_find_kill_LOCAL(synth, chan, &prio, (*voice != NULL) ? (*voice)->index : -1);
+
+        if(v == NULL)
+        {
+            return FLUID_FAILED;
+        }
+
+        FLUID_LOG(FLUID_DBG, "Channel %d limits exceeded, killing voice %d, index %d, key %d",
+                  chan, fluid_voice_get_id(v), v->index, fluid_voice_get_key(v));
+        fluid_synth_steal_voice_LOCAL(synth, v);
+
+        count--;
+        total -= v->cost;
+        *voice = v;
     }
 
-    fluid_synth_api_exit(synth);
+    return FLUID_OK;
 }
 
 /* Selects a voice for killing. */
 static fluid_voice_t *
 fluid_synth_free_voice_by_kill_LOCAL(fluid_synth_t *synth)
 {
-    int i;
-    float best_prio = OVERFLOW_PRIO_CANNOT_KILL - 1;
-    float this_voice_prio;
     fluid_voice_t *voice;
-    int best_voice_index = -1;
+    int best_voice_index;
     unsigned int ticks = fluid_synth_get_ticks(synth);
 
-    for(i = 0; i < synth->polyphony; i++)
-    {
-
-        voice = synth->voice[i];
-
-        /* safeguard against an available voice. */
-        if(_AVAILABLE(voice))
-        {
-            return voice;
-        }
+    fluid_synth_apply_modulations_before_kill_LOCAL(synth);
+    fluid_synth_rebuild_overflow_tree_LOCAL(synth);
 
-        this_voice_prio = fluid_voice_get_overflow_prio(voice, &synth->overflow,
-                          ticks);
+    /* safeguard against an available voice. */
+    best_voice_index = fluid_overflow_tree_find_available(synth->overflow_tree);
 
-        /* check if this voice has less priority than the previous candidate. */
-        if(this_voice_prio < best_prio)
-        {
-            best_voice_index = i;
-            best_prio = this_voice_prio;
-        }
+    if(best_voice_index >= 0)
+    {
+        return synth->voice[best_voice_index];
     }
 
+    best_voice_index = fluid_overflow_tree_find_kill(synth->overflow_tree, synth->voice, &synth->overflow,
+                       (fluid_real_t)synth->sample_rate, ticks);
+
     if(best_voice_index < 0)
     {
         return NULL;
@@ -5250,7 +8362,7 @@ fluid_synth_free_voice_by_kill_LOCAL(fluid_synth_t *synth)
     voice = synth->voice[best_voice_index];
     FLUID_LOG(FLUID_DBG, "Killing voice %d, index %d, chan %d, key %d ",
               fluid_voice_get_id(voice), best_voice_index, fluid_voice_get_channel(voice), fluid_voice_get_key(voice));
-    fluid_voice_off(voice);
+    fluid_synth_steal_voice_LOCAL(synth, voice);
 
     return voice;
 }
@@ -5278,28 +8390,78 @@ fluid_synth_alloc_voice(fluid_synth_t *synth, fluid_sample_t *sample,
 {
     fluid_voice_t *res;
     fluid_return_val_if_fail(sample != NULL, NULL);
-    fluid_return_val_if_fail(sample->data != NULL, NULL);
+    fluid_return_val_if_fail(sample->data != NULL || sample->data_compressed != NULL, NULL);
     FLUID_API_ENTRY_CHAN(NULL);
-    res = fluid_synth_alloc_voice_LOCAL(synth, sample, chan, key, vel, NULL);
+    res = fluid_synth_alloc_voice_LOCAL(synth, sample, chan, key, vel, NULL, TRUE);
     FLUID_API_RETURN(res);
 
 }
 
+/* Like fluid_synth_alloc_voice(), default_mods FALSE leaves adding the default modulators
+ * to the caller, see fluid_synth_get_default_mods_LOCAL() */
 fluid_voice_t *
-fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int chan, int key, int vel, fluid_zone_range_t *zone_range)
+fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int chan, int key, int vel,
+                              fluid_zone_range_t *zone_range, int default_mods)
 {
-    int i, k;
+    int i, k, interp, cost;
     fluid_voice_t *voice = NULL;
-    fluid_channel_t *channel = NULL;
+    fluid_channel_t *channel = synth->channel[chan];
     unsigned int ticks;
 
+    interp = fluid_channel_get_interp_method(channel);
+
+    if(synth->governor.interp_limited && interp > FLUID_INTERP_LINEAR)
+    {
+        interp = FLUID_INTERP_LINEAR;
+    }
+
+    /* the channel may have limits of its own, its voices are stolen first then */
+    cost = fluid_rvoice_interp_cost(interp);
+
+    if(fluid_synth_limit_channel_LOCAL(synth, chan, cost, &voice) != FLUID_OK)
+    {
+        FLUID_LOG(FLUID_WARN, "Channel polyphony or cost budget exceeded. (chan=%d,key=%d)", chan, key);
+        fluid_synth_count_voice_LOCAL(synth, chan, FLUID_VOICE_COUNT_DROPPED);
+        return NULL;
+    }
+
+    /* the governor may allow fewer voices than there are, see fluid_synth_govern() */
+    if(voice == NULL && synth->governor.polyphony != 0 && synth->active_voice_count >= synth->governor.polyphony)
+    {
+        float prio = -OVERFLOW_PRIO_CANNOT_KILL;
+
+        FLUID_LOG(FLUID_DBG, "Governed polyphony exceeded, trying to kill a voice");
+        fluid_synth_apply_modulations_before_kill_LOCAL(synth);
+        i = fluid_synth_governor_find_kill_LOCAL(synth, &prio, -1);
+
+        if(i >= 0)
+        {
+            voice = synth->voice[i];
+            fluid_synth_steal_voice_LOCAL(synth, voice);
+        }
+    }
+
     /* check if there's an available synthesis process */
-    for(i = 0; i < synth->polyphony; i++)
+    if(voice == NULL)
+    {
+        fluid_synth_rebuild_overflow_tree_LOCAL(synth);
+        i = fluid_overflow_tree_find_available(synth->overflow_tree);
+
+        if(i >= 0)
+        {
+            voice = synth->voice[i];
+        }
+    }
+
+    /* in low memory mode, create more voices before stopping one */
+    if(voice == NULL && synth->nvoice < synth->polyphony)
     {
-        if(_AVAILABLE(synth->voice[i]))
+        i = synth->nvoice;
+        fluid_synth_add_voices_LOCAL(synth, i + FLUID_SYNTH_VOICE_BLOCK);
+
+        if(synth->nvoice > i)
         {
             voice = synth->voice[i];
-            break;
         }
     }
 
@@ -5313,6 +8475,7 @@ fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int
     if(voice == NULL)
     {
         FLUID_LOG(FLUID_WARN, "Failed to allocate a synthesis process. (chan=%d,key=%d)", chan, key);
+        fluid_synth_count_voice_LOCAL(synth, chan, FLUID_VOICE_COUNT_DROPPED);
         return NULL;
     }
 
@@ -5322,7 +8485,7 @@ fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int
     {
         k = 0;
 
-        for(i = 0; i < synth->polyphony; i++)
+        for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
         {
             if(!_AVAILABLE(synth->voice[i]))
             {
@@ -5338,8 +8501,6 @@ fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int
                   k);
     }
 
-    channel = synth->channel[chan];
-
     if(fluid_voice_init(voice, sample, zone_range, channel, key, vel,
                         synth->storeid, ticks, synth->gain) != FLUID_OK)
     {
@@ -5347,11 +8508,33 @@ fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int
         return NULL;
     }
 
+    voice->cost = cost;
+
+    if(fluid_perf_accounting(synth->perf))
+    {
+        fluid_preset_t *preset = fluid_channel_get_preset(channel);
+        int slot = -1;
+
+        if(preset != NULL)
+        {
+            slot = fluid_perf_preset_slot(synth->perf, fluid_sfont_get_id(fluid_preset_get_sfont(preset)),
+                                          fluid_preset_get_banknum(preset), fluid_preset_get_num(preset));
+        }
+
+        fluid_voice_set_perf_slots(voice, slot);
+    }
+
+    if(interp != (int)fluid_channel_get_interp_method(channel))
+    {
+        fluid_voice_set_interp_method(voice, interp);
+    }
+
     /* add the default modulators to the synthesis process. */
     /* custom_breath2att_modulator is not a default modulator specified in SF
       it is intended to replace default_vel2att_mod for this channel on demand using
       API fluid_synth_set_breath_mode() or shell command setbreathmode for this channel.
     */
+    if(default_mods)
     {
         int mono = fluid_channel_is_playing_mono(channel);
         fluid_mod_t *default_mod;
@@ -5399,18 +8582,20 @@ fluid_synth_kill_by_exclusive_class_LOCAL(fluid_synth_t *synth,
         fluid_voice_t *new_voice)
 {
     int excl_class = fluid_voice_gen_value(new_voice, GEN_EXCLUSIVECLASS);
-    int i;
+    fluid_voice_t *existing_voice;
 
     /* Excl. class 0: No exclusive class */
-    if(excl_class == 0)
+    if(excl_class == 0 || new_voice->chan >= synth->midi_channels)
     {
         return;
     }
 
-    /* Kill all notes on the same channel with the same exclusive class */
-    for(i = 0; i < synth->polyphony; i++)
+    /* Kill all notes on the same channel with the same exclusive class. The exclusive class
+     * of a voice can change with NRPNs at any time, so all voices of the channel are checked. */
+    for(existing_voice = FLUID_SYNTH_CHANNEL_VOICES(synth, new_voice->chan);
+            existing_voice != NULL && existing_voice->index < synth->polyphony;
+            existing_voice = existing_voice->list_next[FLUID_VOICE_LIST_CHANNEL])
     {
-        fluid_voice_t *existing_voice = synth->voice[i];
 
         /* If voice is playing, on the same channel, has same exclusive
          * class and is not part of the same noteon event (voice group), then kill it */
@@ -5421,6 +8606,7 @@ fluid_synth_kill_by_exclusive_class_LOCAL(fluid_synth_t *synth,
                 && fluid_voice_get_id(existing_voice) != fluid_voice_get_id(new_voice))
         {
             fluid_voice_kill_excl(existing_voice);
+            fluid_synth_count_voice_LOCAL(synth, existing_voice->chan, FLUID_VOICE_COUNT_KILLED_EXCLUSIVE);
         }
     }
 }
@@ -5451,10 +8637,56 @@ fluid_synth_start_voice(fluid_synth_t *synth, fluid_voice_t *voice)
 
     fluid_voice_start(voice);     /* Start the new voice */
     fluid_voice_lock_rvoice(voice);
-    fluid_rvoice_eventhandler_add_rvoice(synth->eventhandler, voice->rvoice);
+    fluid_synth_count_voice_LOCAL(synth, voice->chan, FLUID_VOICE_COUNT_STARTED);
+    fluid_synth_update_voice_peak_LOCAL(synth, voice->chan);
+
+    /* the second voice of a stereo pair is rendered by the first one */
+    if(synth->stereo_candidate != NULL && synth->stereo_candidate != voice
+            && fluid_voice_is_on(synth->stereo_candidate)
+            && fluid_voice_is_stereo_pair(synth->stereo_candidate, voice))
+    {
+        fluid_rvoice_eventhandler_add_stereo_rvoice(synth->eventhandler, voice->rvoice,
+                synth->stereo_candidate->rvoice);
+        synth->stereo_candidate = NULL;
+    }
+    else
+    {
+        fluid_rvoice_eventhandler_add_rvoice(synth->eventhandler, voice->rvoice);
+        synth->stereo_candidate = synth->stereo_voices ? voice : NULL;
+    }
+
+    /* from now on, the rvoice must leave the voice cache before it's changed */
+    voice->rvoice_cached = (synth->voice_cache > 0);
+
+    /* the voice already uses the current controller values */
+    voice->modulate_stamp = synth->modulate_stamp;
+
+    /* the latency of a note is that of its first voice */
+    if(synth->note_ingress != 0)
+    {
+        fluid_synth_queue_note_latency_LOCAL(synth);
+    }
+
     fluid_synth_api_exit(synth);
 }
 
+/* Queues the note being started for fluid_synth_record_note_latency(), if perf stats are on */
+static void
+fluid_synth_queue_note_latency_LOCAL(fluid_synth_t *synth)
+{
+    fluid_synth_note_ingress_t *note;
+
+    if(fluid_atomic_int_get(&synth->perf->enabled)
+            && (note = fluid_ringbuffer_get_inptr(synth->note_latency_queue, 0)) != NULL)
+    {
+        note->ingress = synth->note_ingress;
+        note->tick = fluid_synth_get_ticks(synth) + synth->event_offset;
+        fluid_ringbuffer_next_inptr(synth->note_latency_queue, 1);
+    }
+
+    synth->note_ingress = 0;
+}
+
 /**
  * Add a SoundFont loader to the synth. This function takes ownership of \c loader
  * and frees it automatically upon \c synth destruction.
@@ -5485,6 +8717,37 @@ fluid_synth_add_sfloader(fluid_synth_t *synth, fluid_sfloader_t *loader)
     fluid_synth_api_exit(synth);
 }
 
+/* Loads a SoundFont with the first loader able to, or attaches to the one already loaded by
+ * another synth if shared is TRUE */
+static fluid_sfont_t *
+fluid_synth_load_sfont(fluid_synth_t *synth, const char *filename, int shared)
+{
+    fluid_sfont_t *sfont;
+    fluid_list_t *list;
+    fluid_sfloader_t *loader;
+
+    /* MT NOTE: Loaders list should not change. */
+
+    if(shared)
+    {
+        return fluid_sfregistry_load(synth->settings, synth->loaders, filename);
+    }
+
+    for(list = synth->loaders; list; list = fluid_list_next(list))
+    {
+        loader = (fluid_sfloader_t *) fluid_list_get(list);
+
+        sfont = fluid_sfloader_load(loader, filename);
+
+        if(sfont != NULL)
+        {
+            return sfont;
+        }
+    }
+
+    return NULL;
+}
+
 /**
  * Load a SoundFont file.
  *
@@ -5508,8 +8771,6 @@ int
 fluid_synth_sfload(fluid_synth_t *synth, const char *filename, int reset_presets)
 {
     fluid_sfont_t *sfont;
-    fluid_list_t *list;
-    fluid_sfloader_t *loader;
     int sfont_id;
 
     fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
@@ -5520,29 +8781,23 @@ fluid_synth_sfload(fluid_synth_t *synth, const char *filename, int reset_presets
 
     if(++sfont_id != FLUID_FAILED)
     {
-        /* MT NOTE: Loaders list should not change. */
+        sfont = fluid_synth_load_sfont(synth, filename, synth->shared_sfonts);
 
-        for(list = synth->loaders; list; list = fluid_list_next(list))
+        if(sfont != NULL)
         {
-            loader = (fluid_sfloader_t *) fluid_list_get(list);
+            sfont->refcount++;
+            synth->sfont_id = sfont->id = sfont_id;
 
-            sfont = fluid_sfloader_load(loader, filename);
+            synth->sfont = fluid_list_prepend(synth->sfont, sfont);   /* prepend to list */
+            fluid_synth_clear_preset_cache(synth);
 
-            if(sfont != NULL)
+            /* reset the presets for all channels if requested */
+            if(reset_presets)
             {
-                sfont->refcount++;
-                synth->sfont_id = sfont->id = sfont_id;
-
-                synth->sfont = fluid_list_prepend(synth->sfont, sfont);   /* prepend to list */
-
-                /* reset the presets for all channels if requested */
-                if(reset_presets)
-                {
-                    fluid_synth_program_reset(synth);
-                }
-
-                FLUID_API_RETURN(sfont_id);
+                fluid_synth_program_reset(synth);
             }
+
+            FLUID_API_RETURN(sfont_id);
         }
     }
 
@@ -5588,6 +8843,7 @@ fluid_synth_sfunload(fluid_synth_t *synth, int id, int reset_presets)
         if(fluid_sfont_get_id(sfont) == id)
         {
             synth->sfont = fluid_list_remove(synth->sfont, sfont);
+            fluid_synth_clear_preset_cache(synth);
             break;
         }
     }
@@ -5598,6 +8854,8 @@ fluid_synth_sfunload(fluid_synth_t *synth, int id, int reset_presets)
         FLUID_API_RETURN(FLUID_FAILED);
     }
 
+    fluid_synth_join_warmups(synth, sfont, FALSE);
+
     /* reset the presets for all channels (SoundFont will be freed when there are no more references) */
     if(reset_presets)
     {
@@ -5608,6 +8866,9 @@ fluid_synth_sfunload(fluid_synth_t *synth, int id, int reset_presets)
         fluid_synth_update_presets(synth);
     }
 
+    /* the addresses of its samples may be reused */
+    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_clear_voice_cache, 0, 0.0f);
+
     /* -- Remove synth->sfont list's reference to SoundFont */
     fluid_synth_sfont_unref(synth, sfont);
 
@@ -5665,7 +8926,6 @@ fluid_synth_sfreload(fluid_synth_t *synth, int id)
 {
     char *filename = NULL;
     fluid_sfont_t *sfont;
-    fluid_sfloader_t *loader;
     fluid_list_t *list;
     int index, ret = FLUID_FAILED;
 
@@ -5697,33 +8957,130 @@ fluid_synth_sfreload(fluid_synth_t *synth, int id)
         goto exit;
     }
 
-    /* MT Note: SoundFont loader list will not change */
+    sfont = fluid_synth_load_sfont(synth, filename, synth->shared_sfonts);
 
-    for(list = synth->loaders; list; list = fluid_list_next(list))
+    if(sfont != NULL)
     {
-        loader = (fluid_sfloader_t *) fluid_list_get(list);
+        sfont->id = id;
+        sfont->refcount++;
 
-        sfont = fluid_sfloader_load(loader, filename);
+        synth->sfont = fluid_list_insert_at(synth->sfont, index, sfont);  /* insert the sfont at the same index */
+        fluid_synth_clear_preset_cache(synth);
+
+        /* reset the presets for all channels */
+        fluid_synth_update_presets(synth);
+        ret = id;
+        goto exit;
+    }
+
+    FLUID_LOG(FLUID_ERR, "Failed to load SoundFont \"%s\"", filename);
+
+exit:
+    FLUID_FREE(filename);
+    FLUID_API_RETURN(ret);
+}
+
+/**
+ * Replace a SoundFont with a newly loaded one, without interrupting the synthesis.
+ *
+ * The new SoundFont is loaded completely before the synth is locked, so that the
+ * synthesis goes on meanwhile when this is called from another thread than the audio
+ * one, e.g. a background thread of the application. The new SoundFont then takes the
+ * ID and the index on the SoundFont stack of the old one at once, and the presets of
+ * the MIDI channels are looked up in it again. Voices still playing keep the samples of
+ * the old SoundFont, which is unloaded once they have finished like with
+ * fluid_synth_sfunload().
+ *
+ * The file is always loaded anew, even with \ref settings_synth_shared-soundfonts.
+ *
+ * @param synth FluidSynth instance
+ * @param id ID of the SoundFont to replace
+ * @param filename File to load, NULL to load the file of the SoundFont again
+ * @return @p id on success, #FLUID_FAILED on error, the old SoundFont stays loaded then
+ * @since 2.6.0
+ */
+int
+fluid_synth_sfswap(fluid_synth_t *synth, int id, const char *filename)
+{
+    fluid_sfont_t *sfont, *new_sfont;
+    fluid_list_t *list;
+    char *name = NULL;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+
+    if(filename == NULL)
+    {
+        fluid_synth_api_enter(synth);
+        sfont = fluid_synth_get_sfont_by_id(synth, id);
 
         if(sfont != NULL)
         {
-            sfont->id = id;
-            sfont->refcount++;
+            name = FLUID_STRDUP(fluid_sfont_get_name(sfont));
+        }
 
-            synth->sfont = fluid_list_insert_at(synth->sfont, index, sfont);  /* insert the sfont at the same index */
+        fluid_synth_api_exit(synth);
 
-            /* reset the presets for all channels */
-            fluid_synth_update_presets(synth);
-            ret = id;
-            goto exit;
+        if(sfont == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "No SoundFont with id = %d", id);
+            return FLUID_FAILED;
+        }
+
+        if(name == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
         }
+
+        filename = name;
     }
 
-    FLUID_LOG(FLUID_ERR, "Failed to load SoundFont \"%s\"", filename);
+    /* not locked, the loaders don't change once a SoundFont has been loaded */
+    new_sfont = fluid_synth_load_sfont(synth, filename, FALSE);
 
-exit:
-    FLUID_FREE(filename);
-    FLUID_API_RETURN(ret);
+    if(new_sfont == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to load SoundFont \"%s\"", filename);
+        FLUID_FREE(name);
+        return FLUID_FAILED;
+    }
+
+    FLUID_FREE(name);
+    fluid_synth_api_enter(synth);
+
+    for(list = synth->sfont; list; list = fluid_list_next(list))
+    {
+        if(fluid_sfont_get_id((fluid_sfont_t *)fluid_list_get(list)) == id)
+        {
+            break;
+        }
+    }
+
+    /* unloaded in the meantime */
+    if(!list)
+    {
+        FLUID_LOG(FLUID_ERR, "No SoundFont with id = %d", id);
+        fluid_sfont_delete_internal(new_sfont);
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    sfont = fluid_list_get(list);
+
+    new_sfont->id = id;
+    new_sfont->refcount++;
+    list->data = new_sfont;
+    fluid_synth_clear_preset_cache(synth);
+
+    fluid_synth_join_warmups(synth, sfont, FALSE);
+    fluid_synth_update_presets(synth);
+
+    /* the addresses of its samples may be reused */
+    fluid_synth_update_mixer(synth, fluid_rvoice_mixer_clear_voice_cache, 0, 0.0f);
+
+    /* -- Remove synth->sfont list's reference to the old SoundFont */
+    fluid_synth_sfont_unref(synth, sfont);
+
+    FLUID_API_RETURN(id);
 }
 
 /**
@@ -5747,6 +9104,7 @@ fluid_synth_add_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont)
     {
         synth->sfont_id = sfont->id = sfont_id;
         synth->sfont = fluid_list_prepend(synth->sfont, sfont);        /* prepend to list */
+        fluid_synth_clear_preset_cache(synth);
 
         /* reset the presets for all channels */
         fluid_synth_program_reset(synth);
@@ -5786,6 +9144,7 @@ fluid_synth_remove_sfont(fluid_synth_t *synth, fluid_sfont_t *sfont)
         if(sfont_tmp == sfont)
         {
             synth->sfont = fluid_list_remove(synth->sfont, sfont_tmp);
+            fluid_synth_clear_preset_cache(synth);
             ret = FLUID_OK;
             break;
         }
@@ -5948,7 +9307,7 @@ fluid_synth_get_voicelist(fluid_synth_t *synth, fluid_voice_t *buf[], int bufsiz
     fluid_return_if_fail(buf != NULL);
     fluid_synth_api_enter(synth);
 
-    for(i = 0; i < synth->polyphony && count < bufsize; i++)
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth) && count < bufsize; i++)
     {
         fluid_voice_t *voice = synth->voice[i];
 
@@ -6248,37 +9607,131 @@ fluid_synth_set_reverb_full(fluid_synth_t *synth, int fx_group, int set,
 {
     fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
 
-    /* if non of the flags is set, fail */
-    fluid_return_val_if_fail(set & FLUID_REVMODEL_SET_ALL, FLUID_FAILED);
+    /* if non of the flags is set, fail */
+    fluid_return_val_if_fail(set & FLUID_REVMODEL_SET_ALL, FLUID_FAILED);
+
+    /* fx group shadow values are set here so that they will be returned if queried */
+    fluid_rvoice_mixer_set_reverb_full(synth->eventhandler->mixer, fx_group, set,
+                                       values);
+
+    /* Synth shadow values are set here so that they will be returned if queried */
+    if (fx_group < 0)
+    {
+        int i;
+        for(i = 0; i < FLUID_REVERB_PARAM_LAST; i++)
+        {
+            if(set & FLUID_REVPARAM_TO_SETFLAG(i))
+            {
+                synth->reverb_param[i] = values[i];
+            }
+        }
+    }
+
+    param[0].i = fx_group;
+    param[1].i = set;
+    param[2].real = values[FLUID_REVERB_ROOMSIZE];
+    param[3].real = values[FLUID_REVERB_DAMP];
+    param[4].real = values[FLUID_REVERB_WIDTH];
+    param[5].real = values[FLUID_REVERB_LEVEL];
+    /* finally enqueue an rvoice event to the mixer to actual update reverb */
+    return fluid_rvoice_eventhandler_push(synth->eventhandler,
+                                         fluid_rvoice_mixer_set_reverb_params,
+                                         synth->eventhandler->mixer,
+                                         param);
+}
+
+/* Deletes the convolvers the mixer has stopped using */
+static void
+fluid_synth_delete_retired_convolvers(fluid_synth_t *synth)
+{
+    fluid_list_t *list, *next;
+    fluid_convolver_t *conv;
+
+    for(list = synth->convolvers; list; list = next)
+    {
+        next = fluid_list_next(list);
+        conv = fluid_list_get(list);
+
+        if(fluid_convolver_is_retired(conv))
+        {
+            synth->convolvers = fluid_list_remove(synth->convolvers, conv);
+            delete_fluid_convolver(conv);
+        }
+    }
+}
+
+/**
+ * Replace the reverb of one or all fx groups by the convolution with an impulse response.
+ * @param synth FluidSynth instance
+ * @param fx_group Index of the fx group.
+ *  Must be in the range <code>-1 to (fluid_synth_count_effects_groups()-1)</code>. If -1 the
+ *  impulse response will be used by all fx groups.
+ * @param left Left channel of the impulse response, NULL to return to the built-in reverb
+ * @param right Right channel of the impulse response, NULL to use \p left for both channels
+ * @param length Number of samples of each channel
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * The impulse response is expected at the sample rate of the synth and is applied as is,
+ * the reverb parameters have no effect on it while it is used. It is partitioned and
+ * transformed by the calling thread, the rendering thread only switches over to the
+ * convolution at the beginning of its next buffer. The cost of rendering grows with the
+ * length of the impulse response, but stays the same for every block of audio, and the
+ * convolution adds no latency. The samples are copied, the caller may free them afterwards.
+ *
+ * @since 2.6.0
+ */
+int
+fluid_synth_set_reverb_ir(fluid_synth_t *synth, int fx_group,
+                          const float *left, const float *right, int length)
+{
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+    fluid_convolver_t *conv = NULL;
+    int i, last, ret = FLUID_OK;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(left == NULL || length > 0, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    if(fx_group < -1 || fx_group >= synth->effects_groups)
+    {
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    fluid_synth_delete_retired_convolvers(synth);
 
-    /* fx group shadow values are set here so that they will be returned if queried */
-    fluid_rvoice_mixer_set_reverb_full(synth->eventhandler->mixer, fx_group, set,
-                                       values);
+    /* each fx group convolves its own input history */
+    last = (fx_group < 0) ? synth->effects_groups - 1 : fx_group;
 
-    /* Synth shadow values are set here so that they will be returned if queried */
-    if (fx_group < 0)
+    for(i = (fx_group < 0) ? 0 : fx_group; i <= last && ret == FLUID_OK; i++)
     {
-        int i;
-        for(i = 0; i < FLUID_REVERB_PARAM_LAST; i++)
+        if(left != NULL)
         {
-            if(set & FLUID_REVPARAM_TO_SETFLAG(i))
+            conv = new_fluid_convolver(left, right, length);
+
+            if(conv == NULL)
             {
-                synth->reverb_param[i] = values[i];
+                FLUID_API_RETURN(FLUID_FAILED);
             }
         }
+
+        param[0].i = i;
+        param[1].ptr = conv;
+        ret = fluid_rvoice_eventhandler_push(synth->eventhandler,
+                                             fluid_rvoice_mixer_set_convolver,
+                                             synth->eventhandler->mixer,
+                                             param);
+
+        if(ret == FLUID_OK && conv != NULL)
+        {
+            synth->convolvers = fluid_list_prepend(synth->convolvers, conv);
+        }
+        else
+        {
+            delete_fluid_convolver(conv);
+        }
     }
 
-    param[0].i = fx_group;
-    param[1].i = set;
-    param[2].real = values[FLUID_REVERB_ROOMSIZE];
-    param[3].real = values[FLUID_REVERB_DAMP];
-    param[4].real = values[FLUID_REVERB_WIDTH];
-    param[5].real = values[FLUID_REVERB_LEVEL];
-    /* finally enqueue an rvoice event to the mixer to actual update reverb */
-    return fluid_rvoice_eventhandler_push(synth->eventhandler,
-                                         fluid_rvoice_mixer_set_reverb_params,
-                                         synth->eventhandler->mixer,
-                                         param);
+    FLUID_API_RETURN(ret);
 }
 
 /**
@@ -6988,7 +10441,6 @@ void
 fluid_synth_release_voice_on_same_note_LOCAL(fluid_synth_t *synth, int chan,
         int key)
 {
-    int i;
     fluid_voice_t *voice;
 
     /* storeid is a parameter for fluid_voice_init() */
@@ -7001,10 +10453,10 @@ fluid_synth_release_voice_on_same_note_LOCAL(fluid_synth_t *synth, int chan,
         return;
     }
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = FLUID_SYNTH_NOTE_VOICES(synth, chan, key);
+            voice != NULL && voice->index < synth->polyphony;
+            voice = voice->list_next[FLUID_VOICE_LIST_NOTE])
     {
-        voice = synth->voice[i];
-
         if(fluid_voice_is_playing(voice)
                 && (fluid_voice_get_channel(voice) == chan)
                 && (fluid_voice_get_key(voice) == key)
@@ -7061,7 +10513,17 @@ fluid_synth_set_interp_method(fluid_synth_t *synth, int chan, int interp_method)
         FLUID_API_RETURN(FLUID_FAILED);
     }
 
-    for(i = 0; i < synth->midi_channels; i++)
+    if(chan < 0)
+    {
+        /* for the channels created later */
+        synth->interp_method = interp_method;
+    }
+    else if(synth->channel[chan] == NULL && fluid_synth_create_channel_LOCAL(synth, chan) != FLUID_OK)
+    {
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
+    for(i = fluid_synth_next_channel(synth, 0); i < synth->midi_channels; i = fluid_synth_next_channel(synth, i + 1))
     {
         if(chan < 0 || fluid_channel_get_num(synth->channel[i]) == chan)
         {
@@ -7088,6 +10550,70 @@ fluid_synth_count_midi_channels(fluid_synth_t *synth)
     FLUID_API_RETURN(result);
 }
 
+/*
+ * Creates a MIDI channel in its reset state, as part of the group of basic channel 0.
+ * With synth.sparse-channels, the channels are created on their first use: until then, a
+ * channel is considered to be in this state.
+ */
+int
+fluid_synth_create_channel_LOCAL(fluid_synth_t *synth, int chan)
+{
+    fluid_channel_t *channel = new_fluid_channel(synth, chan);
+
+    if(channel == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    fluid_synth_init_channel_LOCAL(synth, channel);
+    synth->active_channels[chan >> 5] |= (uint32_t)1 << (chan & 31);
+
+    /* FLUID_API_QUEUE_CHAN checks without the lock if the channel exists */
+    fluid_atomic_pointer_set(&synth->channel[chan], channel);
+    return FLUID_OK;
+}
+
+/* Sets the basic channel mode and the interpolation of a channel in its reset state */
+void
+fluid_synth_init_channel_LOCAL(fluid_synth_t *synth, fluid_channel_t *channel)
+{
+    int mode = FLUID_CHANNEL_MODE_OMNION_POLY | FLUID_CHANNEL_ENABLED;
+
+    if(fluid_channel_get_num(channel) == 0)
+    {
+        mode |= FLUID_CHANNEL_BASIC;
+        channel->mode_val = synth->midi_channels;
+    }
+    else
+    {
+        channel->mode_val = 0;
+    }
+
+    fluid_channel_set_basic_channel_info(channel, mode);
+
+    fluid_channel_set_interp_method(channel, synth->interp_method);
+}
+
+/*
+ * Creates all the channels that don't exist yet. Other basic channel setups than the
+ * default one apply to all channels.
+ */
+static int
+fluid_synth_create_channels_LOCAL(fluid_synth_t *synth)
+{
+    int i;
+
+    for(i = 0; i < synth->midi_channels; i++)
+    {
+        if(synth->channel[i] == NULL && fluid_synth_create_channel_LOCAL(synth, i) != FLUID_OK)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    return FLUID_OK;
+}
+
 /**
  * Get the total count of audio channels.
  * @param synth FluidSynth instance
@@ -7168,6 +10694,217 @@ fluid_synth_get_cpu_load(fluid_synth_t *synth)
     return fluid_atomic_float_get(&synth->cpu_load);
 }
 
+/**
+ * Get the count of sample data underruns of streamed samples.
+ *
+ * An underrun happens whenever a voice reaches sample data, that the streaming thread
+ * has not read from disk yet. The voice then waits for the data to be read, which
+ * likely causes an audible dropout. Underruns are only detected while \ref settings_synth_sample-streaming
+ * is enabled.
+ *
+ * @param synth FluidSynth instance
+ * @return Count of blocks rendered with data not read in time since the synth was created
+ * @since 2.6.0
+ */
+int
+fluid_synth_get_stream_underruns(fluid_synth_t *synth)
+{
+    fluid_return_val_if_fail(synth != NULL, 0);
+    return (synth->stream != NULL) ? fluid_rvoice_stream_get_underruns(synth->stream) : 0;
+}
+
+/**
+ * Get the most events that have been waiting for the audio rendering at once.
+ *
+ * Every call of the synth API queues events for the rendering, e.g. to start a voice or
+ * to update the voices of a channel, which are processed at the start of the next
+ * block. When more are queued than the queue of 64 events per voice of
+ * \setting{synth_polyphony} holds, e.g. when a sustain pedal releases hundreds of
+ * voices at once, they wait in additional memory allocated by the calling thread.
+ * A peak above the size of the queue hints that the polyphony is too small for the load.
+ *
+ * @param synth FluidSynth instance
+ * @return Most events queued at once since the synth was created
+ * @since 2.6.0
+ */
+int
+fluid_synth_get_event_queue_peak(fluid_synth_t *synth)
+{
+    int result;
+    fluid_return_val_if_fail(synth != NULL, 0);
+    fluid_synth_api_enter(synth);
+
+    result = synth->eventhandler->peak;
+    FLUID_API_RETURN(result);
+}
+
+/**
+ * Create a render pool that can be shared by several synthesizers.
+ *
+ * The pool owns a set of worker threads that render the voices of all synths attached
+ * to it via fluid_synth_set_render_pool(), instead of each synth using its own
+ * \setting{synth_cpu-cores} - 1 mixer threads. This avoids oversubscribing the CPU
+ * when many synth instances are rendering in the same process.
+ *
+ * @param settings The pool creates \setting{synth_cpu-cores} - 1 worker threads, using
+ * the scheduling priority given by \setting{audio_realtime-prio} (or
+ * \setting{audio_realtime-deadline}) and the CPUs given by \setting{synth_cpu-affinity}.
+ * @return New render pool or NULL on error (e.g. if fluidsynth was compiled without
+ * support for mixer threads)
+ * @since 2.6.0
+ */
+fluid_render_pool_t *
+new_fluid_render_pool(fluid_settings_t *settings)
+{
+#if ENABLE_MIXER_THREADS
+    int cores = 1, prio_level = 0;
+    int cpus[FLUID_MAX_CPU_AFFINITY], cpu_count;
+    int deadline_runtime, deadline_period;
+
+    fluid_return_val_if_fail(settings != NULL, NULL);
+
+    fluid_settings_getint(settings, "synth.cpu-cores", &cores);
+    fluid_settings_getint(settings, "audio.realtime-prio", &prio_level);
+    cpu_count = fluid_settings_get_cpu_list(settings, "synth.cpu-affinity", cpus, FLUID_N_ELEMENTS(cpus));
+    deadline_period = fluid_synth_get_deadline(settings, &deadline_runtime);
+
+    if(cores < 2)
+    {
+        FLUID_LOG(FLUID_ERR, "A render pool needs synth.cpu-cores to be greater than 1");
+        return NULL;
+    }
+
+    return new_fluid_rvoice_render_pool(cores - 1, prio_level, cpus, cpu_count,
+                                        deadline_runtime, deadline_period);
+#else
+    FLUID_LOG(FLUID_ERR, "fluidsynth has been compiled without support for mixer threads");
+    return NULL;
+#endif
+}
+
+/**
+ * Delete a render pool and terminate its worker threads.
+ *
+ * @param pool Render pool to delete
+ *
+ * @note All synths using the pool must have been deleted, or detached from it and
+ * rendered at least once, prior to deleting the pool. Otherwise the pool is not deleted.
+ * @since 2.6.0
+ */
+void
+delete_fluid_render_pool(fluid_render_pool_t *pool)
+{
+#if ENABLE_MIXER_THREADS
+    delete_fluid_rvoice_render_pool(pool);
+#endif
+}
+
+/**
+ * Let the worker threads of a render pool render the voices of this synth.
+ *
+ * While attached, the synth does not use its own mixer threads. The change takes
+ * effect the next time audio is rendered.
+ *
+ * @param synth FluidSynth instance
+ * @param pool Render pool created with new_fluid_render_pool(), or NULL to detach the
+ * synth and use its own \setting{synth_cpu-cores} - 1 mixer threads again
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ * @since 2.6.0
+ */
+int
+fluid_synth_set_render_pool(fluid_synth_t *synth, fluid_render_pool_t *pool)
+{
+    int result;
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_synth_api_enter(synth);
+
+    result = fluid_rvoice_mixer_push_render_pool(synth->eventhandler->mixer, pool);
+
+    FLUID_API_RETURN(result);
+}
+
+/* The arguments of fluid_render_pool_write_float(), shared by the items of its batch */
+typedef struct
+{
+    fluid_synth_t **synths;
+    int len;
+    float **left;
+    float **right;
+    fluid_atomic_int_t failed;
+} fluid_synth_batch_t;
+
+/* Renders the block of one synth of a fluid_render_pool_write_float() batch */
+static void
+fluid_synth_batch_write(void *data, int index)
+{
+    fluid_synth_batch_t *batch = data;
+
+    if(fluid_synth_write_float(batch->synths[index], batch->len, batch->left[index], 0, 1,
+                               batch->right[index], 0, 1) != FLUID_OK)
+    {
+        fluid_atomic_int_set(&batch->failed, TRUE);
+    }
+}
+
+/**
+ * Synthesize a block of audio of many synthesizers at once, using the worker threads of a
+ * render pool.
+ *
+ * This is meant for rendering lots of independent, short pieces offline, e.g. to generate a
+ * data set: while a synth with a few voices hardly gains from rendering them on several
+ * cores, a batch of such synths keeps all cores busy. The synths are spread over the idle
+ * workers of the pool and the calling thread, each rendering the block of whole synths, and
+ * the function returns once all blocks are done. Every synth produces the same audio as
+ * fluid_synth_write_float() would.
+ *
+ * @param pool Render pool created with new_fluid_render_pool(), or NULL to render the synths
+ *   one after another in the calling thread
+ * @param count Number of synths
+ * @param synths Array of @p count synths, each of which must appear only once, must not be
+ *   used by another thread during the call and should not be attached to a render pool
+ * @param len Count of audio frames to synthesize for each synth
+ * @param left Array of @p count buffers of @p len floats, receiving the left channel of the
+ *   synth with the same index
+ * @param right Array of @p count buffers of @p len floats, receiving the right channel
+ * @return #FLUID_OK on success, #FLUID_FAILED if any synth failed to render
+ *
+ * @note Reverb and Chorus are mixed to @p left resp. @p right.
+ * @since 2.6.0
+ */
+int
+fluid_render_pool_write_float(fluid_render_pool_t *pool, int count, fluid_synth_t **synths,
+                              int len, float **left, float **right)
+{
+    fluid_synth_batch_t batch;
+    int i;
+
+    fluid_return_val_if_fail(count >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(count == 0 || (synths != NULL && left != NULL && right != NULL), FLUID_FAILED);
+
+    batch.synths = synths;
+    batch.len = len;
+    batch.left = left;
+    batch.right = right;
+    fluid_atomic_int_set(&batch.failed, FALSE);
+
+#if ENABLE_MIXER_THREADS
+
+    if(pool != NULL)
+    {
+        fluid_rvoice_render_pool_run(pool, fluid_synth_batch_write, &batch, count);
+        return fluid_atomic_int_get(&batch.failed) ? FLUID_FAILED : FLUID_OK;
+    }
+
+#endif
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_synth_batch_write(&batch, i);
+    }
+
+    return fluid_atomic_int_get(&batch.failed) ? FLUID_FAILED : FLUID_OK;
+}
+
 /* Get tuning for a given bank:program */
 static fluid_tuning_t *
 fluid_synth_get_tuning(fluid_synth_t *synth, int bank, int prog)
@@ -7239,10 +10976,17 @@ fluid_synth_replace_tuning_LOCAL(fluid_synth_t *synth, fluid_tuning_t *old_tunin
                                  fluid_tuning_t *new_tuning, int apply, int unref_new)
 {
     fluid_channel_t *channel;
+    uint32_t changed[4];
     int old_tuning_unref = 0;
     int i;
 
-    for(i = 0; i < synth->midi_channels; i++)
+    /* the same keys change on all channels */
+    if(apply)
+    {
+        fluid_tuning_get_changed_keys(old_tuning, new_tuning, changed);
+    }
+
+    for(i = fluid_synth_next_channel(synth, 0); i < synth->midi_channels; i = fluid_synth_next_channel(synth, i + 1))
     {
         channel = synth->channel[i];
 
@@ -7255,46 +10999,151 @@ fluid_synth_replace_tuning_LOCAL(fluid_synth_t *synth, fluid_tuning_t *old_tunin
                 fluid_tuning_ref(new_tuning);    /* ++ ref new tuning for channel */
             }
 
-            fluid_channel_set_tuning(channel, new_tuning);
+            fluid_channel_set_tuning(channel, new_tuning);
+
+            if(apply)
+            {
+                fluid_synth_update_voice_tuning_LOCAL(synth, channel, changed);
+            }
+        }
+    }
+
+    /* Send unref old tuning event if any unrefs */
+    if(old_tuning && old_tuning_unref)
+    {
+        fluid_tuning_unref(old_tuning, old_tuning_unref);
+    }
+
+    if(!unref_new || !new_tuning)
+    {
+        return;
+    }
+
+    fluid_tuning_unref(new_tuning, 1);
+}
+
+/* Recalculates the pitch of a voice if its key or root key is marked in changed */
+static void
+fluid_synth_retune_voice_LOCAL(fluid_voice_t *voice, const uint32_t *changed)
+{
+    int key = fluid_voice_get_actual_key(voice);
+    int root_key = (int)(voice->root_pitch / 100.0f);
+
+    if((key >= 0 && key < 128 && fluid_tuning_key_changed(changed, key))
+            || root_key < 0 || root_key >= 128 || fluid_tuning_key_changed(changed, root_key))
+    {
+        fluid_voice_calculate_gen_pitch(voice);
+        fluid_voice_update_param(voice, GEN_PITCH);
+    }
+}
+
+/* Update voice tunings in realtime. Only the voices whose key or root key is marked in
+ * changed (see fluid_tuning_get_changed_keys()) are updated, so that retuning a few keys
+ * doesn't recalculate the pitch of every voice on the channel. */
+static void
+fluid_synth_update_voice_tuning_LOCAL(fluid_synth_t *synth, fluid_channel_t *channel,
+                                      const uint32_t *changed)
+{
+    fluid_voice_t *voice;
+    int i;
+
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
+    {
+        voice = synth->voice[i];
+
+        if(fluid_voice_is_on(voice) && voice->channel == channel)
+        {
+            fluid_synth_retune_voice_LOCAL(voice, changed);
+        }
+    }
+}
+
+/* Like fluid_synth_update_voice_tuning_LOCAL() for all channels using the tuning at once */
+static void
+fluid_synth_update_tuning_voices_LOCAL(fluid_synth_t *synth, const fluid_tuning_t *tuning,
+                                       const uint32_t *changed)
+{
+    fluid_voice_t *voice;
+    int i;
+
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
+    {
+        voice = synth->voice[i];
+
+        if(fluid_voice_is_on(voice) && fluid_channel_get_tuning(voice->channel) == tuning)
+        {
+            fluid_synth_retune_voice_LOCAL(voice, changed);
+        }
+    }
+}
+
+/*
+ * Sets the pitch of len keys of the tuning on bank:prog, which is created from the equal
+ * tempered scale if it doesn't exist. A tuning only referenced by the tuning table and
+ * the channels using it is changed in place without allocating anything, so repeated
+ * SYSEX tuning messages are cheap, and the voices of all these channels are retuned in
+ * one pass. A tuning referenced elsewhere is duplicated and replaced instead.
+ * The name is applied if not NULL. Synth mutex should already be locked by caller.
+ */
+static int
+fluid_synth_update_tuning_LOCAL(fluid_synth_t *synth, int bank, int prog, const char *name,
+                                int len, const int *keys, const double *pitch, int apply)
+{
+    fluid_tuning_t *tuning = fluid_synth_get_tuning(synth, bank, prog);
+    fluid_tuning_t *new_tuning;
+    uint32_t changed[4];
+    int i, refs = 1;
+
+    if(tuning != NULL)
+    {
+        for(i = fluid_synth_next_channel(synth, 0); i < synth->midi_channels; i = fluid_synth_next_channel(synth, i + 1))
+        {
+            refs += (fluid_channel_get_tuning(synth->channel[i]) == tuning);
+        }
+
+        if(fluid_atomic_int_get(&tuning->refcount) == refs)
+        {
+            if(name != NULL && (tuning->name == NULL || FLUID_STRCMP(tuning->name, name) != 0)
+                    && fluid_tuning_set_name(tuning, name) != FLUID_OK)
+            {
+                return FLUID_FAILED;
+            }
+
+            fluid_tuning_update_keys(tuning, len, keys, pitch, changed);
 
             if(apply)
             {
-                fluid_synth_update_voice_tuning_LOCAL(synth, channel);
+                fluid_synth_update_tuning_voices_LOCAL(synth, tuning, changed);
             }
+
+            return FLUID_OK;
         }
-    }
 
-    /* Send unref old tuning event if any unrefs */
-    if(old_tuning && old_tuning_unref)
+        new_tuning = fluid_tuning_duplicate(tuning);
+    }
+    else
     {
-        fluid_tuning_unref(old_tuning, old_tuning_unref);
+        new_tuning = new_fluid_tuning("Unnamed", bank, prog);
     }
 
-    if(!unref_new || !new_tuning)
+    if(new_tuning == NULL || (name != NULL && fluid_tuning_set_name(new_tuning, name) != FLUID_OK))
     {
-        return;
+        delete_fluid_tuning(new_tuning);
+        return FLUID_FAILED;
     }
 
-    fluid_tuning_unref(new_tuning, 1);
-}
-
-/* Update voice tunings in realtime */
-static void
-fluid_synth_update_voice_tuning_LOCAL(fluid_synth_t *synth, fluid_channel_t *channel)
-{
-    fluid_voice_t *voice;
-    int i;
-
-    for(i = 0; i < synth->polyphony; i++)
+    for(i = 0; i < len; i++)
     {
-        voice = synth->voice[i];
+        fluid_tuning_set_pitch(new_tuning, keys[i], pitch[i]);
+    }
 
-        if(fluid_voice_is_on(voice) && (voice->channel == channel))
-        {
-            fluid_voice_calculate_gen_pitch(voice);
-            fluid_voice_update_param(voice, GEN_PITCH);
-        }
+    if(fluid_synth_replace_tuning_LOCK(synth, new_tuning, bank, prog, apply) == FLUID_FAILED)
+    {
+        fluid_tuning_unref(new_tuning, 1);
+        return FLUID_FAILED;
     }
+
+    return FLUID_OK;
 }
 
 /**
@@ -7418,9 +11267,7 @@ int
 fluid_synth_tune_notes(fluid_synth_t *synth, int bank, int prog,
                        int len, const int *key, const double *pitch, int apply)
 {
-    fluid_tuning_t *old_tuning, *new_tuning;
-    int retval = FLUID_OK;
-    int i;
+    int retval;
 
     fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
     fluid_return_val_if_fail(bank >= 0 && bank < 128, FLUID_FAILED);
@@ -7430,37 +11277,7 @@ fluid_synth_tune_notes(fluid_synth_t *synth, int bank, int prog,
     fluid_return_val_if_fail(pitch != NULL, FLUID_FAILED);
 
     fluid_synth_api_enter(synth);
-
-    old_tuning = fluid_synth_get_tuning(synth, bank, prog);
-
-    if(old_tuning)
-    {
-        new_tuning = fluid_tuning_duplicate(old_tuning);
-    }
-    else
-    {
-        new_tuning = new_fluid_tuning("Unnamed", bank, prog);
-    }
-
-    if(new_tuning)
-    {
-        for(i = 0; i < len; i++)
-        {
-            fluid_tuning_set_pitch(new_tuning, key[i], pitch[i]);
-        }
-
-        retval = fluid_synth_replace_tuning_LOCK(synth, new_tuning, bank, prog, apply);
-
-        if(retval == FLUID_FAILED)
-        {
-            fluid_tuning_unref(new_tuning, 1);
-        }
-    }
-    else
-    {
-        retval = FLUID_FAILED;
-    }
-
+    retval = fluid_synth_update_tuning_LOCAL(synth, bank, prog, NULL, len, key, pitch, apply);
     FLUID_API_RETURN(retval);
 }
 
@@ -7530,6 +11347,7 @@ fluid_synth_set_tuning_LOCAL(fluid_synth_t *synth, int chan,
 {
     fluid_tuning_t *old_tuning;
     fluid_channel_t *channel;
+    uint32_t changed[4];
 
     channel = synth->channel[chan];
 
@@ -7538,7 +11356,8 @@ fluid_synth_set_tuning_LOCAL(fluid_synth_t *synth, int chan,
 
     if(apply)
     {
-        fluid_synth_update_voice_tuning_LOCAL(synth, channel);
+        fluid_tuning_get_changed_keys(old_tuning, tuning, changed);
+        fluid_synth_update_voice_tuning_LOCAL(synth, channel, changed);
     }
 
     /* Send unref old tuning event */
@@ -7731,7 +11550,7 @@ fluid_synth_set_gen_LOCAL(fluid_synth_t *synth, int chan, int param, float value
 
     fluid_channel_set_gen(synth->channel[chan], param, value);
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
     {
         voice = synth->voice[i];
 
@@ -7920,7 +11739,7 @@ static void fluid_synth_process_awe32_nrpn_LOCAL(fluid_synth_t *synth, int chan,
 
     fluid_channel_set_override_gen_default(synth->channel[chan], sf2_gen, converted_sf2_generator_value);
 
-    for (i = 0; is_realtime && i < synth->polyphony; i++)
+    for (i = 0; is_realtime && i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
     {
         fluid_voice_t* voice = synth->voice[i];
 
@@ -7971,9 +11790,10 @@ fluid_synth_handle_midi_event(void *data, fluid_midi_event_t *event)
     switch(type)
     {
     case NOTE_ON:
-        return fluid_synth_noteon(synth, chan,
-                                  fluid_midi_event_get_key(event),
-                                  fluid_midi_event_get_velocity(event));
+        return fluid_synth_noteon_ingress(synth, chan,
+                                          fluid_midi_event_get_key(event),
+                                          fluid_midi_event_get_velocity(event),
+                                          event->ingress);
 
     case NOTE_OFF:
         return fluid_synth_noteoff(synth, chan, fluid_midi_event_get_key(event));
@@ -8012,6 +11832,164 @@ fluid_synth_handle_midi_event(void *data, fluid_midi_event_t *event)
     return FLUID_FAILED;
 }
 
+/**
+ * Queue MIDI events to be applied by the synth while it renders the next blocks of audio.
+ *
+ * @param synth FluidSynth instance
+ * @param events Array of \a count MIDI events (will be copied into an internal queue)
+ * @param offsets Array of \a count offsets in audio samples, one for each event, relative to
+ *   the first sample of the next block rendered, i.e. to the current fluid_synth_get_ticks()
+ * @param count Number of events
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise, in which case none of the events has been queued
+ *
+ * Like calling fluid_synth_handle_midi_event() for each of the events at the right time, but takes the
+ * API lock only once for all of them, and once per block they are applied in. An event is applied right
+ * before rendering the block of @c FLUID_BUFSIZE (64) samples its offset falls into, the same timing
+ * resolution the MIDI player and sequencer use. With \setting{synth_sample-accurate-events}, the voices
+ * started by note-on events begin to sound at the exact sample offset within that block. Events with
+ * the same offset are applied in the order they are passed, also across several calls.
+ *
+ * Accepts the event types supported by fluid_synth_handle_midi_event(). The data of SYSEX events is
+ * copied as well.
+ *
+ * @since 2.6.0
+ */
+int
+fluid_synth_queue_midi_events(fluid_synth_t *synth, fluid_midi_event_t **events,
+                              const unsigned int *offsets, int count)
+{
+    fluid_midi_event_t *queue, event;
+    unsigned int ticks;
+    int i, j, size;
+
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(count >= 0, FLUID_FAILED);
+    fluid_return_val_if_fail(count == 0 || (events != NULL && offsets != NULL), FLUID_FAILED);
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_return_val_if_fail(events[i] != NULL, FLUID_FAILED);
+
+        switch(events[i]->type)
+        {
+        case NOTE_ON:
+        case NOTE_OFF:
+        case CONTROL_CHANGE:
+        case PROGRAM_CHANGE:
+        case CHANNEL_PRESSURE:
+        case KEY_PRESSURE:
+        case PITCH_BEND:
+        case MIDI_SYSTEM_RESET:
+        case MIDI_SYSEX:
+        case MIDI_TEXT:
+        case MIDI_LYRIC:
+        case MIDI_SET_TEMPO:
+            break;
+
+        default:
+            FLUID_LOG(FLUID_ERR, "Can't queue MIDI event of type 0x%x", events[i]->type);
+            return FLUID_FAILED;
+        }
+    }
+
+    fluid_synth_api_enter(synth);
+    ticks = fluid_synth_get_ticks(synth);
+
+    /* create the channels here rather than when the synthesis thread applies the events */
+    for(i = 0; i < count; i++)
+    {
+        j = fluid_midi_event_get_channel(events[i]);
+
+        if(events[i]->type >= NOTE_OFF && events[i]->type <= PITCH_BEND
+                && j >= 0 && j < synth->midi_channels && synth->channel[j] == NULL)
+        {
+            fluid_synth_create_channel_LOCAL(synth, j);
+        }
+    }
+
+    /* the events applied already make room at the front */
+    if(synth->midi_queue_head > 0)
+    {
+        FLUID_MEMMOVE(synth->midi_queue, &synth->midi_queue[synth->midi_queue_head],
+                      (synth->midi_queue_tail - synth->midi_queue_head) * sizeof(*synth->midi_queue));
+        synth->midi_queue_tail -= synth->midi_queue_head;
+        synth->midi_queue_head = 0;
+    }
+
+    if(count > synth->midi_queue_size - synth->midi_queue_tail)
+    {
+        size = 2 * synth->midi_queue_size;
+
+        if(size < synth->midi_queue_tail + count)
+        {
+            size = synth->midi_queue_tail + count;
+        }
+
+        queue = FLUID_REALLOC(synth->midi_queue, size * sizeof(*queue));
+
+        if(queue == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            FLUID_API_RETURN(FLUID_FAILED);
+        }
+
+        synth->midi_queue = queue;
+        synth->midi_queue_size = size;
+    }
+
+    queue = synth->midi_queue;
+
+    /* copy the events behind the queue first, so that nothing is queued if copying SYSEX data fails */
+    for(i = 0; i < count; i++)
+    {
+        event = *events[i];
+        event.next = NULL;
+        event.dtime = ticks + offsets[i];
+
+        if(event.type == MIDI_SYSEX)
+        {
+            event.paramptr = FLUID_MALLOC(event.param1 > 0 ? event.param1 : 1);
+
+            if(event.paramptr == NULL)
+            {
+                for(j = 0; j < i; j++)
+                {
+                    if(queue[synth->midi_queue_tail + j].type == MIDI_SYSEX)
+                    {
+                        FLUID_FREE(queue[synth->midi_queue_tail + j].paramptr);
+                    }
+                }
+
+                FLUID_LOG(FLUID_ERR, "Out of memory");
+                FLUID_API_RETURN(FLUID_FAILED);
+            }
+
+            FLUID_MEMCPY(event.paramptr, events[i]->paramptr, event.param1);
+            event.param2 = TRUE;
+        }
+
+        queue[synth->midi_queue_tail + i] = event;
+    }
+
+    /* then sort them in, events are usually passed in order, which takes linear time */
+    for(i = synth->midi_queue_tail; i < synth->midi_queue_tail + count; i++)
+    {
+        event = queue[i];
+
+        for(j = i; j > 0 && (int)(queue[j - 1].dtime - event.dtime) > 0; j--)
+        {
+            queue[j] = queue[j - 1];
+        }
+
+        queue[j] = event;
+    }
+
+    synth->midi_queue_tail += count;
+    fluid_atomic_int_set(&synth->midi_queue_count, synth->midi_queue_tail);
+
+    FLUID_API_RETURN(FLUID_OK);
+}
+
 /**
  * Create and start voices using an arbitrary preset and a MIDI note on event.
  *
@@ -8089,7 +12067,7 @@ fluid_synth_stop_LOCAL(fluid_synth_t *synth, unsigned int id)
     fluid_voice_t *voice;
     int i;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
     {
         voice = synth->voice[i];
 
@@ -8125,6 +12103,7 @@ fluid_synth_set_bank_offset(fluid_synth_t *synth, int sfont_id, int offset)
         if(fluid_sfont_get_id(sfont) == sfont_id)
         {
             sfont->bankofs = offset;
+            fluid_synth_clear_preset_cache(synth);
             break;
         }
     }
@@ -8184,10 +12163,46 @@ fluid_synth_api_enter(fluid_synth_t *synth)
 
     if(!synth->public_api_count)
     {
+        synth->defer_sample_release = FALSE;
+        fluid_synth_check_finished_voices(synth);
+        fluid_synth_notify_released_samples_LOCAL(synth);
+    }
+
+    synth->public_api_count++;
+
+    /* calls queued before by this thread must take effect before this one */
+    if(synth->public_api_count == 1)
+    {
+        fluid_synth_process_api_queue_LOCAL(synth, TRUE);
+    }
+}
+
+/*
+ * Like fluid_synth_api_enter(), but returns FALSE instead of waiting if another
+ * thread holds the API lock. For use by the synthesis thread, which must not block.
+ */
+static int
+fluid_synth_api_try_enter(fluid_synth_t *synth)
+{
+    if(synth->use_mutex && !fluid_rec_mutex_trylock(synth->mutex))
+    {
+        return FALSE;
+    }
+
+    if(!synth->public_api_count)
+    {
+        synth->defer_sample_release = TRUE;
         fluid_synth_check_finished_voices(synth);
     }
 
     synth->public_api_count++;
+
+    if(synth->public_api_count == 1)
+    {
+        fluid_synth_process_api_queue_LOCAL(synth, FALSE);
+    }
+
+    return TRUE;
 }
 
 void fluid_synth_api_exit(fluid_synth_t *synth)
@@ -8206,6 +12221,176 @@ void fluid_synth_api_exit(fluid_synth_t *synth)
 
 }
 
+/*
+ * Allocates the queue of synth.api-queue, rounding its size up to a power of two.
+ */
+static int
+fluid_synth_init_api_queue(fluid_synth_t *synth, int size)
+{
+    /* a single cell couldn't tell a written call from a free cell of the next position */
+    unsigned int i, count = 2;
+
+    while(count < (unsigned int)size)
+    {
+        count <<= 1;
+    }
+
+    synth->api_queue = FLUID_ARRAY(fluid_synth_api_call_t, count);
+
+    if(synth->api_queue == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        fluid_atomic_int_set(&synth->api_queue[i].seq, (int)i);
+    }
+
+    synth->api_queue_mask = count - 1;
+    fluid_atomic_int_set(&synth->api_queue_in, 0);
+    fluid_atomic_int_set(&synth->api_queue_count, 0);
+    synth->api_queue_out = 0;
+
+    return FLUID_OK;
+}
+
+/*
+ * Queues a public API call without taking the API lock, may be called by several
+ * threads at once. A cell whose seq equals the queue position is free: the calling
+ * thread claims the position by advancing api_queue_in, fills the cell and marks it
+ * as written by setting seq to the position plus one.
+ * Returns FALSE if the queue is full.
+ */
+static int
+fluid_synth_queue_api_call(fluid_synth_t *synth, enum fluid_synth_call type, int chan, int param1, int param2,
+                           unsigned int ingress)
+{
+    fluid_synth_api_call_t *call;
+    unsigned int pos = (unsigned int)fluid_atomic_int_get(&synth->api_queue_in);
+    int diff;
+
+    for(;;)
+    {
+        call = &synth->api_queue[pos & synth->api_queue_mask];
+        diff = (int)((unsigned int)fluid_atomic_int_get(&call->seq) - pos);
+
+        if(diff == 0)
+        {
+            if(fluid_atomic_int_compare_and_exchange(&synth->api_queue_in, (int)pos, (int)(pos + 1)))
+            {
+                break;
+            }
+        }
+        else if(diff < 0)
+        {
+            /* the call a full queue ago hasn't been applied yet */
+            return FALSE;
+        }
+
+        /* another thread claimed the position first */
+        pos = (unsigned int)fluid_atomic_int_get(&synth->api_queue_in);
+    }
+
+    call->type = type;
+    call->chan = chan;
+    call->param1 = param1;
+    call->param2 = param2;
+    call->ingress = ingress;
+    fluid_atomic_int_set(&call->seq, (int)(pos + 1));
+    fluid_atomic_int_inc(&synth->api_queue_count);
+
+    return TRUE;
+}
+
+/*
+ * Applies the queued API calls in the order they were queued. Must be called with the
+ * API lock held, which makes the holder the only thread taking calls from the queue.
+ *
+ * A thread may have claimed a cell without having written it yet. With wait set, this
+ * waits for such cells, so that no call queued before is left behind when the caller
+ * goes on with a call of its own. Otherwise the queue is only applied up to the first
+ * of them, which is what the synthesis thread does, as it must not wait.
+ */
+static void
+fluid_synth_process_api_queue_LOCAL(fluid_synth_t *synth, int wait)
+{
+    fluid_synth_api_call_t *call;
+    unsigned int pos, end;
+
+    if(synth->api_queue == NULL)
+    {
+        return;
+    }
+
+    end = (unsigned int)fluid_atomic_int_get(&synth->api_queue_in);
+
+    for(pos = synth->api_queue_out; pos != end; pos++)
+    {
+        call = &synth->api_queue[pos & synth->api_queue_mask];
+
+        while((unsigned int)fluid_atomic_int_get(&call->seq) != pos + 1)
+        {
+            if(!wait)
+            {
+                goto done;
+            }
+        }
+
+        switch(call->type)
+        {
+        case FLUID_SYNTH_CALL_NOTEON:
+            synth->note_ingress = call->ingress;
+            fluid_synth_noteon_enabled_LOCAL(synth, call->chan, call->param1, call->param2);
+            synth->note_ingress = 0;
+            break;
+
+        case FLUID_SYNTH_CALL_NOTEOFF:
+            fluid_synth_noteoff_enabled_LOCAL(synth, call->chan, call->param1);
+            break;
+
+        case FLUID_SYNTH_CALL_CC:
+            fluid_synth_cc_global_LOCAL(synth, call->chan, call->param1, call->param2);
+            break;
+
+        case FLUID_SYNTH_CALL_PITCH_BEND:
+            fluid_synth_pitch_bend_LOCAL(synth, call->chan, call->param1);
+            break;
+
+        case FLUID_SYNTH_CALL_PROGRAM_CHANGE:
+            fluid_synth_program_change_LOCAL(synth, call->chan, call->param1);
+            break;
+        }
+
+        /* free the cell for the position a full queue later */
+        fluid_atomic_int_set(&call->seq, (int)(pos + synth->api_queue_mask + 1));
+    }
+
+done:
+    fluid_atomic_int_add(&synth->api_queue_count, -(int)(pos - synth->api_queue_out));
+    synth->api_queue_out = pos;
+}
+
+/*
+ * Applies the queued API calls from the synthesis thread, unless another thread holds
+ * the API lock: that thread applies them then.
+ */
+static void
+fluid_synth_process_api_queue(fluid_synth_t *synth)
+{
+    if(synth->api_queue == NULL || fluid_atomic_int_get(&synth->api_queue_count) == 0)
+    {
+        return;
+    }
+
+    /* fluid_synth_api_try_enter() applies them */
+    if(fluid_synth_api_try_enter(synth))
+    {
+        fluid_synth_api_exit(synth);
+    }
+}
+
 /**
  * Set midi channel type
  * @param synth FluidSynth instance
@@ -8220,6 +12405,7 @@ int fluid_synth_set_channel_type(fluid_synth_t *synth, int chan, int type)
     FLUID_API_ENTRY_CHAN(FLUID_FAILED);
 
     synth->channel[chan]->channel_type = type;
+    fluid_synth_invalidate_overflow_prio_LOCAL(synth);
 
     FLUID_API_RETURN(FLUID_OK);
 }
@@ -8261,7 +12447,7 @@ int fluid_synth_set_custom_filter(fluid_synth_t *synth, int type, int flags)
     synth->custom_filter_type = type;
     synth->custom_filter_flags = flags;
 
-    for(i = 0; i < synth->polyphony; i++)
+    for(i = 0; i < FLUID_SYNTH_VOICE_COUNT(synth); i++)
     {
         voice = synth->voice[i];
 
@@ -8334,6 +12520,7 @@ static int fluid_synth_set_important_channels(fluid_synth_t *synth, const char *
     retval = FLUID_OK;
 
 exit:
+    fluid_synth_invalidate_overflow_prio_LOCAL(synth);
     FLUID_FREE(values);
     return retval;
 }
@@ -8615,6 +12802,11 @@ fluid_synth_reset_basic_channel_LOCAL(fluid_synth_t *synth, int chan, int nbr_ch
 
     for(i = chan; i < chan + nbr_chan; i++)
     {
+        if(synth->channel[i] == NULL)
+        {
+            continue;
+        }
+
         fluid_channel_reset_basic_channel_info(synth->channel[i]);
         synth->channel[i]->mode_val = 0;
     }
@@ -8664,6 +12856,12 @@ int fluid_synth_reset_basic_channel(fluid_synth_t *synth, int chan)
         nbr_chan = synth->channel[chan]->mode_val; /* nbr of channels in the group */
     }
 
+    /* the channels that don't exist yet assume the default setup */
+    if(fluid_synth_create_channels_LOCAL(synth) != FLUID_OK)
+    {
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
     /* resets the range of MIDI channels */
     fluid_synth_reset_basic_channel_LOCAL(synth, chan, nbr_chan);
     FLUID_API_RETURN(FLUID_OK);
@@ -8710,7 +12908,8 @@ fluid_synth_check_next_basic_channel(fluid_synth_t *synth, int basicchan, int mo
     /* checks if this basic channel group overlaps next basic channel group */
     for(i = basicchan + 1; i < basicchan + real_val; i++)
     {
-        if(synth->channel[i]->mode &  FLUID_CHANNEL_BASIC)
+        /* a channel that doesn't exist is in the group of basic channel 0 */
+        if(synth->channel[i] != NULL && (synth->channel[i]->mode &  FLUID_CHANNEL_BASIC))
         {
             /* A value of 0 for val means all possible channels from basicchan to
             to the next basic channel -1 (if any).
@@ -8772,6 +12971,13 @@ int fluid_synth_set_basic_channel(fluid_synth_t *synth, int chan, int mode, int
         FLUID_API_RETURN(FLUID_FAILED);
     }
 
+    /* other setups than the default one of fluid_synth_system_reset() need all channels */
+    if(!(chan == 0 && mode == FLUID_CHANNEL_MODE_OMNION_POLY && (val == 0 || val == synth->midi_channels))
+            && fluid_synth_create_channels_LOCAL(synth) != FLUID_OK)
+    {
+        FLUID_API_RETURN(FLUID_FAILED);
+    }
+
     /* Checks if there is an overlap with the next basic channel */
     val = fluid_synth_check_next_basic_channel(synth, chan, mode, val);
 
@@ -8806,6 +13012,13 @@ fluid_synth_set_basic_channel_LOCAL(fluid_synth_t *synth, int basicchan, int mod
     {
         int new_mode = mode; /* OMNI_OFF/ON, MONO/POLY ,others bits are zero */
         int new_val;
+
+        /* only for the default setup, which a channel gets when it's created */
+        if(synth->channel[i] == NULL)
+        {
+            continue;
+        }
+
         /* MIDI specs: when mode is changed, channel must receive ALL_NOTES_OFF */
         fluid_synth_all_notes_off_LOCAL(synth, i);
 
@@ -8839,7 +13052,7 @@ static int fluid_synth_get_previous_basic_channel(fluid_synth_t *synth, int chan
     for(; chan >= 0; chan--)
     {
         /* searches previous basic channel */
-        if(synth->channel[chan]->mode &  FLUID_CHANNEL_BASIC)
+        if(synth->channel[chan] != NULL && (synth->channel[chan]->mode &  FLUID_CHANNEL_BASIC))
         {
             /* chan is the previous basic channel */
             return chan;
@@ -31,11 +31,18 @@
 #include "fluid_list.h"
 #include "fluid_rev.h"
 #include "fluid_voice.h"
+#include "fluid_overflow_tree.h"
 #include "fluid_chorus.h"
+#include "fluid_convolver.h"
 #include "fluid_ladspa.h"
 #include "fluid_limiter.h"
 #include "fluid_midi_router.h"
 #include "fluid_rvoice_event.h"
+#include "fluid_perf.h"
+#include "fluid_voice_snapshot.h"
+#include "fluid_meter.h"
+#include "fluid_out_resampler.h"
+#include "fluid_trace.h"
 
 /***************************************************************
  *
@@ -46,6 +53,11 @@
 
 #define FLUID_UNSET_PROGRAM 128  /* Program number used to unset a preset */
 
+#define FLUID_SYNTH_VOICE_BLOCK 16  /* Number of voices created at once, see synth.low-memory */
+#define FLUID_SYNTH_PRESET_CACHE_SIZE 256  /* Number of presets cached by fluid_synth_find_preset(), a power of 2 */
+#define FLUID_NOTE_LATENCY_QUEUE_SIZE 256  /* Notes started per render call whose latency is measured, see synth.perf-stats */
+#define FLUID_NOTE_LATENCY_MAX 10000000.0  /* Note latencies in usec beyond which the MIDI ingress time is taken to be bogus */
+
 #define FLUID_REVERB_DEFAULT_DAMP 0.3f      /**< Default reverb damping */
 #define FLUID_REVERB_DEFAULT_LEVEL 0.7f     /**< Default reverb level */
 #define FLUID_REVERB_DEFAULT_ROOMSIZE 0.5f  /**< Default reverb room size */
@@ -70,6 +82,11 @@ extern "C" {
 #define FLUID_LIMITER_DEFAULT_SMOOTHING_STAGES 1     /**< Default number of smoothing stages (can be 1,2 or 3) */
 #define FLUID_LIMITER_DEFAULT_LINK_CHANNELS 0.5f     /**< Default "link channels" value (from 0.0 to 1.0) */
 
+#define FLUID_GOVERNOR_SMOOTHING 0.05   /**< Time constant of the smoothed load in seconds */
+#define FLUID_GOVERNOR_HOLD 0.1         /**< Seconds the governor waits after stepping in */
+#define FLUID_GOVERNOR_CALM 1.0         /**< Seconds of low load before a step is taken back */
+#define FLUID_GOVERNOR_HYSTERESIS 0.7   /**< Fraction of the target load that counts as low load */
+
 /***************************************************************
  *
  *                         ENUM
@@ -104,6 +121,90 @@ enum fluid_msgs_note_cut
 #define SYNTH_REVERB_CHANNEL 0
 #define SYNTH_CHORUS_CHANNEL 1
 
+/*
+ * A bank and program looked up by fluid_synth_find_preset(), with the preset found
+ */
+typedef struct _fluid_synth_preset_cache_t
+{
+    int banknum;
+    int prognum;                       /**< -1 if the entry is unused */
+    fluid_preset_t *preset;            /**< the preset found, NULL if there is none */
+} fluid_synth_preset_cache_t;
+
+/*
+ * CPU load governor, see synth.governor.active. The load is measured by the rendering
+ * thread, which adjusts the other fields while holding the API lock.
+ */
+typedef struct _fluid_synth_governor_t
+{
+    fluid_atomic_int_t active;         /**< Atomic: TRUE if the render load should be governed */
+    double target_load;                /**< Smoothed load above which the governor steps in */
+    int min_polyphony;                 /**< The governed polyphony doesn't go below this */
+    int interpolation;                 /**< TRUE if the interpolation may be lowered before voices are dropped */
+    double load;                       /**< Smoothed render time / audio time, rendering thread only */
+    int polyphony;                     /**< Governed polyphony, 0 if not limited */
+    int interp_limited;                /**< TRUE if voices are limited to linear interpolation */
+    unsigned int hold_until;           /**< Tick before which the governor doesn't act again */
+    unsigned int calm_since;           /**< Tick since which the load has been below the hysteresis threshold */
+    int calm;                          /**< TRUE if calm_since is valid */
+} fluid_synth_governor_t;
+
+/* The public API calls that can be queued, see synth.api-queue */
+enum fluid_synth_call
+{
+    FLUID_SYNTH_CALL_NOTEON,
+    FLUID_SYNTH_CALL_NOTEOFF,
+    FLUID_SYNTH_CALL_CC,
+    FLUID_SYNTH_CALL_PITCH_BEND,
+    FLUID_SYNTH_CALL_PROGRAM_CHANGE
+};
+
+/*
+ * A public API call queued by any thread without taking the API lock. The cells of the
+ * queue are claimed by the calling threads, the calls are applied by whichever thread
+ * holds the API lock next.
+ */
+typedef struct _fluid_synth_api_call_t
+{
+    fluid_atomic_int_t seq;            /**< Atomic: position the cell can be written at, or that position plus one once written */
+    enum fluid_synth_call type;
+    int chan;
+    int param1;
+    int param2;
+    unsigned int ingress;              /**< MIDI ingress time of a note-on, see fluid_midi_event_stamp(), 0 if unknown */
+} fluid_synth_api_call_t;
+
+/* A note started by an event received by a MIDI driver, queued by the synth thread until the
+ * block of its first voice has been rendered, see fluid_synth_get_note_latency_stats() */
+typedef struct _fluid_synth_note_ingress_t
+{
+    unsigned int ingress;              /**< Time the driver received the note-on, see fluid_midi_ingress_now() */
+    unsigned int tick;                 /**< Tick the first voice of the note starts at */
+} fluid_synth_note_ingress_t;
+
+/* Voice events counted per channel and for the whole synth, see fluid_synth_get_voice_counters() */
+enum fluid_voice_counter
+{
+    FLUID_VOICE_COUNT_STARTED,
+    FLUID_VOICE_COUNT_STOLEN,
+    FLUID_VOICE_COUNT_KILLED_EXCLUSIVE,
+    FLUID_VOICE_COUNT_FINISHED,
+    FLUID_VOICE_COUNT_DROPPED,
+    FLUID_VOICE_COUNT_PEAK,     /* not an event, the most voices active at once */
+    FLUID_VOICE_COUNT_ACTIVE,   /* not an event, the voices linked to the channel, see fluid_synth_link_voice_LOCAL() */
+    FLUID_VOICE_COUNT_LAST
+};
+
+typedef fluid_atomic_int_t fluid_synth_voice_counters_t[FLUID_VOICE_COUNT_LAST];
+
+/* A buffer of the output of fluid_synth_render_blocks() mixed into a buffer of fluid_synth_process() */
+typedef struct
+{
+    int in;                            /**< the dry left, dry right, fx left or fx right buffers, 0 to 3 */
+    int offset;                        /**< offset of the buffer in them */
+    int live;                          /**< index of the buffer in the live flags, see fluid_synth_get_out_live_bufs() */
+} fluid_synth_mix_source_t;
+
 /*
  * fluid_synth_t
  *
@@ -131,7 +232,8 @@ struct _fluid_synth_t
     int with_reverb;                   /**< Should the synth use the built-in reverb unit? */
     int with_chorus;                   /**< Should the synth use the built-in chorus unit? */
     int verbose;                       /**< Turn verbose mode on? */
-    double sample_rate;                /**< The sample rate */
+    double sample_rate;                /**< The sample rate the voices are rendered at */
+    double output_rate;                /**< The sample rate of the output, see synth.render-rate */
     int midi_channels;                 /**< the number of MIDI channels (>= 16) */
     int bank_select;                   /**< the style of Bank Select MIDI messages */
     int audio_channels;                /**< the number of audio channels (1 channel=left+right) */
@@ -146,17 +248,41 @@ struct _fluid_synth_t
     fluid_list_t *loaders;              /**< the SoundFont loaders */
     fluid_list_t *sfont;                /**< List of fluid_sfont_info_t for each loaded SoundFont (remains until SoundFont is unloaded) */
     int sfont_id;                       /**< Incrementing ID assigned to each loaded SoundFont */
+    fluid_synth_preset_cache_t preset_cache[FLUID_SYNTH_PRESET_CACHE_SIZE]; /**< the presets found by bank and program, see fluid_synth_clear_preset_cache() */
+    int preset_cache_bank_select;       /**< the bank select style the presets in preset_cache were found with */
     fluid_list_t *fonts_to_be_unloaded; /**< list of timers that try to unload a soundfont */
+    fluid_list_t *warmups;              /**< warm-ups running in the background, see fluid_synth_warm_preset() */
+    int shared_sfonts;                  /**< Attach to the SoundFonts loaded by other synths, see synth.shared-soundfonts */
 
     float gain;                        /**< master gain */
-    fluid_channel_t **channel;         /**< the channels */
+    fluid_real_t noise_floor;          /**< Amplitude below which voices are inaudible, see synth.noise-floor */
+    int voice_cache;                   /**< Number of notes in the voice cache, see synth.voice-cache */
+    fluid_channel_t **channel;         /**< the channels, NULL until first used with synth.sparse-channels */
+    uint32_t *active_channels;         /**< bit n is set if channel n exists, see fluid_synth_next_channel() */
+    int sparse_channels;               /**< Create the channels when they are first used, see synth.sparse-channels */
+    int interp_method;                 /**< Interpolation method of the channels created later, see fluid_synth_set_interp_method() */
     int nvoice;                        /**< the length of the synthesis process array (max polyphony allowed) */
+    int low_memory;                    /**< Create the voices when they are needed, see synth.low-memory */
     fluid_voice_t **voice;             /**< the synthesis voices */
+    fluid_overflow_tree_t *overflow_tree; /**< overflow priorities of the first polyphony voices */
+    int overflow_tree_outdated;        /**< TRUE if overflow_tree must be rebuilt before its next use */
+    fluid_voice_t **note_voices;       /**< per channel and key, the voices playing it ordered by index, see fluid_synth_link_voice_LOCAL() */
+    fluid_voice_t **channel_voices;    /**< per channel, the voices playing on it ordered by index */
     int active_voice_count;            /**< count of active voices */
+    fluid_synth_voice_counters_t *voice_counters; /**< Atomic: per channel, then for the whole synth, counters of voice events read without the API lock */
     unsigned int noteid;               /**< the id is incremented for every new note. it's used for noteoff's  */
     unsigned int storeid;
     int fromkey_portamento;            /**< fromkey portamento */
     fluid_rvoice_eventhandler_t *eventhandler;
+    fluid_perf_t *perf;                /**< Render stage statistics, timed while synth.perf-stats is on */
+    unsigned int note_ingress;         /**< MIDI ingress time of the note-on being applied, 0 if unknown or already queued */
+    fluid_ringbuffer_t *note_latency_queue; /**< fluid_synth_note_ingress_t of the notes whose latency is to be recorded */
+    fluid_atomic_int_t output_latency; /**< Atomic: output latency in usec of the audio driver of the synth, 0 if unknown */
+    fluid_voice_snapshot_t *voice_snapshot; /**< State of the voices, published while synth.voice-snapshot is on */
+    fluid_meter_t *meter;              /**< Level meters, metered while synth.metering is on */
+    fluid_out_resampler_t *resampler;  /**< Converts the output to output_rate, NULL if it's sample_rate */
+    fluid_rvoice_stream_t *stream;     /**< streams sample data ahead of the voices, NULL if synth.sample-streaming is off */
+    fluid_synth_governor_t governor;   /**< Adapts the polyphony to the CPU load */
 
     /**< Shadow of reverb parameter: roomsize, damping, width, level */
     double reverb_param[FLUID_REVERB_PARAM_LAST];
@@ -166,6 +292,11 @@ struct _fluid_synth_t
 
     int cur;                           /**< the current sample in the audio buffers to be output */
     int curmax;                        /**< current amount of samples present in the audio buffers */
+
+    int mix_nout, mix_nfx;             /**< the nout and nfx of fluid_synth_process() the mix map is built for, -1 if none */
+    fluid_synth_mix_source_t *mix_sources; /**< the buffers mixed by fluid_synth_process(), grouped by the output buffer they go to */
+    int *mix_first;                    /**< per output buffer (out, then fx), the index of its first source in mix_sources, plus the end */
+    const fluid_real_t **mix_bufs;     /**< the live sources of the output buffer being mixed */
     int dither_index;                  /**< current index in random dither value buffer: fluid_synth_(write_s16|dither_s16) */
 
     fluid_atomic_float_t cpu_load;     /**< CPU load in percent (CPU time required / audio synthesized time * 100) */
@@ -173,14 +304,44 @@ struct _fluid_synth_t
     fluid_tuning_t ***tuning;          /**< 128 banks of 128 programs for the tunings */
     fluid_private_t tuning_iter;       /**< Tuning iterators per each thread */
 
-    fluid_sample_timer_t *sample_timers; /**< List of timers triggered before a block is processed */
+    fluid_sample_timer_t *sample_timers; /**< Timers triggered before a block is processed, in the order they are due */
+    fluid_sample_timer_t *idle_sample_timers; /**< Timers finished or suspended */
+    fluid_atomic_int_t sample_timers_woken; /**< TRUE if fluid_sample_timer_wake() has been called for a timer since the latest block */
     unsigned int min_note_length_ticks;  /**< If note-offs are triggered just after a note-on, they will be delayed */
 
+    fluid_midi_event_t *midi_queue;      /**< Events queued by fluid_synth_queue_midi_events() in the order they are due, the dtime of each event is the tick it is due at */
+    int midi_queue_size;                 /**< Number of events allocated for midi_queue */
+    int midi_queue_head;                 /**< Index of the next queued event to apply */
+    int midi_queue_tail;                 /**< Index after the last queued event */
+    fluid_atomic_int_t midi_queue_count; /**< Number of queued events not yet applied, read by the rendering thread without the API lock */
+    int sample_accurate_events;          /**< TRUE if queued events take effect at their sample offset within the block, see synth.sample-accurate-events */
+    int stereo_voices;                 /**< Render the voices of a stereo pair as one, see synth.stereo-voices */
+    fluid_voice_t *stereo_candidate;   /**< The voice started last, if it may be the first of a stereo pair */
+    int event_offset;                    /**< Sample offset within the next block of the queued event being applied, 0 otherwise */
+
+    fluid_synth_api_call_t *api_queue;   /**< Calls queued by the lock-free API path, NULL if disabled, see synth.api-queue */
+    unsigned int api_queue_mask;         /**< Size of api_queue minus one, the size is a power of two */
+    fluid_atomic_int_t api_queue_in;     /**< Position of the next call to queue, shared by all calling threads */
+    unsigned int api_queue_out;          /**< Position of the next call to apply, only used with the API lock held */
+    fluid_atomic_int_t api_queue_count;  /**< Number of queued calls not yet applied, read by the rendering thread without the API lock */
+
+    fluid_sample_t **released_samples;   /**< Samples whose last voice finished on the synthesis thread, still referenced until the next API call notifies their owner */
+    int released_size;                   /**< Number of samples released_samples can hold, twice the number of voices */
+    int released_count;                  /**< Number of samples in released_samples */
+    int defer_sample_release;            /**< TRUE while the synthesis thread holds the API lock, see fluid_synth_release_sample_LOCAL() */
+    int rt_alloc_check;                  /**< TRUE if allocations on the synthesis thread are reported, see synth.rt-alloc-check */
+    int flush_denormals;                 /**< TRUE if denormal numbers are flushed to zero while rendering, see synth.flush-denormals */
+
+    unsigned int modulate_stamp;         /**< Incremented with every controller change waiting to be applied to the voices */
+    fluid_atomic_int_t modulate_pending; /**< TRUE if controller changes wait to be applied to the voices, read by the rendering thread without the API lock */
+
     int cores;                         /**< Number of CPU cores (1 by default) */
 
     fluid_mod_t *default_mod;          /**< the (dynamic) list of default modulators */
+    unsigned int default_mod_generation; /**< changes with default_mod, see fluid_synth_get_default_mods_LOCAL() */
 
     fluid_ladspa_fx_t *ladspa_fx;      /**< Effects unit for LADSPA support */
+    fluid_list_t *convolvers;          /**< List of fluid_convolver_t handed to the mixer, see fluid_synth_set_reverb_ir() */
     enum fluid_iir_filter_type custom_filter_type;   /**< filter type of the user-defined filter currently used for all voices */
     enum fluid_iir_filter_flags custom_filter_flags; /**< filter flags for the user-defined filter currently used for all voices */
     enum fluid_msgs_note_cut msgs_note_cut_mode;
@@ -189,7 +350,7 @@ struct _fluid_synth_t
     enum fluid_portamento_time_mode portamento_time_mode; /**< Global portamento time mode */
     int portamento_time_has_seen_lsb;                     /**< Flag to track if LSB has been seen (for auto mode) */
 
-    fluid_iir_sincos_t iir_sincos_table[SINCOS_TAB_SIZE]; /**< Table of sin/cos values for IIR filter */
+    fluid_iir_sincos_t *iir_sincos_table; /**< Table of sin/cos values for IIR filter, shared with other synths of the same rate */
 };
 
 extern fluid_mod_t default_vel2att_mod;
@@ -227,6 +388,8 @@ typedef int (*fluid_audio_channels_callback_t)(fluid_synth_t *synth, int len,
                                                void *channels_out[], int channels_off[],
                                                int channels_incr[]);
 
+void fluid_synth_govern(fluid_synth_t *synth, double usec, int blockcount);
+
 int
 fluid_synth_write_float_channels_LOCAL(fluid_synth_t *synth, int len,
                                        int channels_count,
@@ -261,6 +424,7 @@ fluid_synth_write_float_channels(fluid_synth_t *synth, int len,
 
 int fluid_synth_render_blocks(fluid_synth_t *synth, int blockcount);
 unsigned int fluid_synth_get_ticks(fluid_synth_t *synth);
+int fluid_synth_skip_silence(fluid_synth_t *synth, int len);
 
 fluid_preset_t *fluid_synth_find_preset(fluid_synth_t *synth,
                                         int banknum,
@@ -268,6 +432,9 @@ fluid_preset_t *fluid_synth_find_preset(fluid_synth_t *synth,
 
 void fluid_synth_sfont_unref(fluid_synth_t *synth, fluid_sfont_t *sfont);
 
+int fluid_synth_pin_program(fluid_synth_t *synth, int channel_type, int banknum, int prognum,
+                            int *sfont_id, int *pinned_bank, int *pinned_prog);
+
 int fluid_synth_reset_reverb(fluid_synth_t *synth);
 
 int fluid_synth_set_reverb_preset(fluid_synth_t *synth, unsigned int num);
@@ -292,9 +459,22 @@ fluid_sample_timer_t *new_fluid_sample_timer(fluid_synth_t *synth, fluid_timer_c
 void delete_fluid_sample_timer(fluid_synth_t *synth, fluid_sample_timer_t *timer);
 
 void fluid_sample_timer_reset(fluid_synth_t *synth, fluid_sample_timer_t *timer);
+unsigned int fluid_sample_timer_get_ticks(fluid_synth_t *synth, fluid_sample_timer_t *timer);
+void fluid_sample_timer_schedule(fluid_synth_t *synth, fluid_sample_timer_t *timer, unsigned int ticks);
+void fluid_sample_timer_suspend(fluid_synth_t *synth, fluid_sample_timer_t *timer);
+void fluid_sample_timer_wake(fluid_synth_t *synth, fluid_sample_timer_t *timer);
+int fluid_sample_timer_get_offset(fluid_sample_timer_t *timer);
+
+void fluid_synth_begin_event_offset(fluid_synth_t *synth, int offset);
+void fluid_synth_end_event_offset(fluid_synth_t *synth);
+void fluid_synth_api_hold(fluid_synth_t *synth);
+void fluid_synth_api_release(fluid_synth_t *synth);
 
 void fluid_synth_process_event_queue(fluid_synth_t *synth);
 
+int fluid_synth_snapshot_LOCAL(fluid_synth_t *synth, void *data, int size);
+int fluid_synth_restore_LOCAL(fluid_synth_t *synth, const void *data, int size);
+
 int
 fluid_synth_process_LOCAL(fluid_synth_t *synth, int len, int nfx, float *fx[],
                           int nout, float *out[], int (*block_render_func)(fluid_synth_t *, int));
@@ -309,6 +489,8 @@ fluid_synth_write_float_LOCAL(fluid_synth_t *synth, int len,
 void fluid_synth_settings(fluid_settings_t *settings);
 
 void fluid_synth_set_sample_rate_immediately(fluid_synth_t *synth, float sample_rate);
+void fluid_synth_set_workgroup(fluid_synth_t *synth, void *workgroup);
+void fluid_synth_set_output_latency(fluid_synth_t *synth, double usec);
 
 
 /* extern declared in fluid_synth_monopoly.c */
@@ -320,10 +502,62 @@ int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan, int fromk
 int fluid_synth_noteoff_monopoly(fluid_synth_t *synth, int chan, int key, char Mono);
 
 fluid_voice_t *
-fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int chan, int key, int vel, fluid_zone_range_t *zone_range);
+fluid_synth_alloc_voice_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample, int chan, int key, int vel,
+                              fluid_zone_range_t *zone_range, int default_mods);
+int fluid_synth_get_default_mods_LOCAL(fluid_synth_t *synth, const fluid_sample_t *sample, int chan,
+                                       fluid_mod_t **mods, unsigned int *generation);
 
 void fluid_synth_release_voice_on_same_note_LOCAL(fluid_synth_t *synth, int chan, int key);
 
+void fluid_synth_update_overflow_prio_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice);
+void fluid_synth_invalidate_overflow_prio_LOCAL(fluid_synth_t *synth);
+void fluid_synth_apply_modulations_before_kill_LOCAL(fluid_synth_t *synth);
+void fluid_synth_link_voice_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice);
+void fluid_synth_unlink_voice_LOCAL(fluid_synth_t *synth, fluid_voice_t *voice);
+void fluid_synth_release_sample_LOCAL(fluid_synth_t *synth, fluid_sample_t *sample);
+int fluid_synth_create_channel_LOCAL(fluid_synth_t *synth, int chan);
+void fluid_synth_init_channel_LOCAL(fluid_synth_t *synth, fluid_channel_t *channel);
+
+/* The first voice of the list of voices playing the key on the channel, the next ones follow
+ * in voice->list_next[FLUID_VOICE_LIST_NOTE]. Voices beyond the polyphony come last. */
+#define FLUID_SYNTH_NOTE_VOICES(synth, chan, key) ((synth)->note_voices[(chan) * 128 + ((key) & 0x7f)])
+/* The first voice of the list of voices playing on the channel, see FLUID_VOICE_LIST_CHANNEL */
+#define FLUID_SYNTH_CHANNEL_VOICES(synth, chan) ((synth)->channel_voices[(chan)])
+/* The number of voices that may play, less than the polyphony while synth.low-memory has not
+ * created all of them yet */
+#define FLUID_SYNTH_VOICE_COUNT(synth) (((synth)->nvoice < (synth)->polyphony) ? (synth)->nvoice : (synth)->polyphony)
+
+/* The first existing channel from chan on, or midi_channels if there is none. Iterate
+ * the channels with
+ * for(i = fluid_synth_next_channel(synth, 0); i < synth->midi_channels; i = fluid_synth_next_channel(synth, i + 1)) */
+static FLUID_INLINE int
+fluid_synth_next_channel(const fluid_synth_t *synth, int chan)
+{
+    uint32_t bits;
+
+    while(chan < synth->midi_channels)
+    {
+        bits = synth->active_channels[chan >> 5] >> (chan & 31);
+
+        if(bits == 0)
+        {
+            /* none in the rest of this word */
+            chan = (chan | 31) + 1;
+            continue;
+        }
+
+        while(!(bits & 1))
+        {
+            bits >>= 1;
+            chan++;
+        }
+
+        return chan;
+    }
+
+    return synth->midi_channels;
+}
+
 #ifdef __cplusplus
 }
 #endif
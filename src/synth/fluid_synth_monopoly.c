@@ -542,7 +542,6 @@ int fluid_synth_noteoff_monopoly(fluid_synth_t *synth, int chan, int key,
 {
     int status = FLUID_FAILED;
     fluid_voice_t *voice;
-    int i;
     fluid_channel_t *channel = synth->channel[chan];
 
     /* Key_sustained is prepared to return no note sustained (INVALID_NOTE) */
@@ -552,10 +551,10 @@ int fluid_synth_noteoff_monopoly(fluid_synth_t *synth, int chan, int key,
     }
 
     /* noteoff for all voices with same chan and same key */
-    for(i = 0; i < synth->polyphony; i++)
+    for(voice = FLUID_SYNTH_NOTE_VOICES(synth, chan, key);
+            voice != NULL && voice->index < synth->polyphony;
+            voice = voice->list_next[FLUID_VOICE_LIST_NOTE])
     {
-        voice = synth->voice[i];
-
         if(fluid_voice_is_on(voice) &&
                 fluid_voice_get_channel(voice) == chan &&
                 fluid_voice_get_key(voice) == key)
@@ -565,7 +564,7 @@ int fluid_synth_noteoff_monopoly(fluid_synth_t *synth, int chan, int key,
                 int used_voices = 0;
                 int k;
 
-                for(k = 0; k < synth->polyphony; k++)
+                for(k = 0; k < FLUID_SYNTH_VOICE_COUNT(synth); k++)
                 {
                     if(!_AVAILABLE(synth->voice[k]))
                     {
@@ -653,17 +652,19 @@ int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan,
 {
     fluid_channel_t *channel = synth->channel[chan];
     enum fluid_channel_legato_mode legatomode = channel->legatomode;
-    fluid_voice_t *voice;
-    int i ;
+    fluid_voice_t *voice, *next;
     /* Gets possible 'fromkey portamento' and possible 'fromkey legato' note  */
     fromkey = fluid_synth_get_fromkey_portamento_legato(channel, fromkey);
 
     if(fluid_channel_is_valid_note(fromkey))
     {
-        for(i = 0; i < synth->polyphony; i++)
+        /* voices playing tokey in legato manner move to another list, so get the next one first */
+        for(voice = FLUID_SYNTH_NOTE_VOICES(synth, chan, fromkey);
+                voice != NULL && voice->index < synth->polyphony;
+                voice = next)
         {
             /* searching fromkey voices: only those who don't have 'note off' */
-            voice = synth->voice[i];
+            next = voice->list_next[FLUID_VOICE_LIST_NOTE];
 
             if(fluid_voice_is_on(voice) &&
                     fluid_voice_get_channel(voice) == chan &&
@@ -700,6 +701,14 @@ int fluid_synth_noteon_monopoly_legato(fluid_synth_t *synth, int chan,
                         zone_range->ignore = TRUE;
                         break;
 
+                    case FLUID_CHANNEL_LEGATO_MODE_SINGLE_TRIGGER: /* mode 2 */
+                        /* Only moves the pitch, with portamento if enabled */
+                        fluid_voice_update_legato(voice, synth->fromkey_portamento, tokey);
+
+                        /* The voice is now used to play tokey in legato manner */
+                        zone_range->ignore = TRUE;
+                        break;
+
                     default: /* Invalid mode: this should never happen */
                         FLUID_LOG(FLUID_WARN, "Failed to execute legato mode: %d",
                                   legatomode);
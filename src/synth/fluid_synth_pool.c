@@ -0,0 +1,325 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_synth.h"
+
+
+/******************************************************************************
+  Pools of synths created in advance, leased out for a while and returned in
+  the state they were handed out in, see new_fluid_synth_pool().
+
+  The synths of a pool share their SoundFonts (see synth.shared-soundfonts), so
+  a SoundFont is imported once for the whole pool. When a synth is returned,
+  the snapshot taken after the latest fluid_synth_pool_sfload() is restored.
+*******************************************************************************/
+
+struct _fluid_synth_pool_t
+{
+    fluid_mutex_t mutex;        /* protects leased */
+    int size;
+    fluid_synth_t **synth;
+    char *leased;               /* TRUE for the synths handed out by fluid_synth_pool_lease() */
+    char *snapshot;             /* the state of an idle synth, see fluid_synth_snapshot() */
+    int snapshot_size;
+};
+
+static int
+fluid_synth_pool_take_snapshot(fluid_synth_pool_t *pool)
+{
+    char *snapshot;
+    int size = fluid_synth_snapshot(pool->synth[0], NULL, 0);
+
+    if(size == FLUID_FAILED)
+    {
+        return FLUID_FAILED;
+    }
+
+    snapshot = FLUID_ARRAY(char, size);
+
+    if(snapshot == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    if(fluid_synth_snapshot(pool->synth[0], snapshot, size) != size)
+    {
+        FLUID_FREE(snapshot);
+        return FLUID_FAILED;
+    }
+
+    FLUID_FREE(pool->snapshot);
+    pool->snapshot = snapshot;
+    pool->snapshot_size = size;
+
+    return FLUID_OK;
+}
+
+/**
+ * Create a pool of synthesizers to be leased out and returned.
+ *
+ * All synths of the pool are created right away with the given settings. They share
+ * the SoundFonts loaded with fluid_synth_pool_sfload(), as if \setting{synth_shared-soundfonts}
+ * was enabled, so that a SoundFont is only imported once for the whole pool.
+ *
+ * @param settings Configuration parameters for the synths
+ * @param size Number of synths in the pool
+ * @return New pool or NULL on error
+ * @since 2.6.0
+ */
+fluid_synth_pool_t *
+new_fluid_synth_pool(fluid_settings_t *settings, int size)
+{
+    fluid_synth_pool_t *pool;
+    int i, dynamic_samples = 0;
+
+    fluid_return_val_if_fail(settings != NULL, NULL);
+    fluid_return_val_if_fail(size > 0, NULL);
+
+    pool = FLUID_NEW(fluid_synth_pool_t);
+
+    if(pool == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(pool, 0, sizeof(*pool));
+    fluid_mutex_init(pool->mutex);
+    pool->synth = FLUID_ARRAY(fluid_synth_t *, size);
+    pool->leased = FLUID_ARRAY(char, size);
+
+    if(pool->synth == NULL || pool->leased == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    FLUID_MEMSET(pool->synth, 0, size * sizeof(*pool->synth));
+    FLUID_MEMSET(pool->leased, 0, size * sizeof(*pool->leased));
+    pool->size = size;
+
+    fluid_settings_getint(settings, "synth.dynamic-sample-loading", &dynamic_samples);
+
+    if(dynamic_samples)
+    {
+        FLUID_LOG(FLUID_WARN, "The synths of a pool don't share their SoundFonts with synth.dynamic-sample-loading");
+    }
+
+    for(i = 0; i < size; i++)
+    {
+        pool->synth[i] = new_fluid_synth(settings);
+
+        if(pool->synth[i] == NULL)
+        {
+            goto error_recovery;
+        }
+
+        pool->synth[i]->shared_sfonts = !dynamic_samples;
+    }
+
+    if(fluid_synth_pool_take_snapshot(pool) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    return pool;
+
+error_recovery:
+    delete_fluid_synth_pool(pool);
+    return NULL;
+}
+
+/**
+ * Delete a pool and all of its synths.
+ *
+ * @param pool Pool to delete
+ *
+ * @note Synths still leased are deleted as well, they must not be used anymore.
+ * @since 2.6.0
+ */
+void
+delete_fluid_synth_pool(fluid_synth_pool_t *pool)
+{
+    int i;
+
+    fluid_return_if_fail(pool != NULL);
+
+    for(i = 0; pool->synth != NULL && i < pool->size; i++)
+    {
+        delete_fluid_synth(pool->synth[i]);
+    }
+
+    FLUID_FREE(pool->synth);
+    FLUID_FREE(pool->leased);
+    FLUID_FREE(pool->snapshot);
+    fluid_mutex_destroy(pool->mutex);
+    FLUID_FREE(pool);
+}
+
+/**
+ * Load a SoundFont into all synths of a pool.
+ *
+ * The SoundFont is imported once and shared by the synths. Their presets are reset,
+ * and the resulting state becomes the one leased synths are returned to by
+ * fluid_synth_pool_release().
+ *
+ * @param pool Pool of synths
+ * @param filename File to load
+ * @return SoundFont ID, the same in all synths of the pool, or #FLUID_FAILED on error,
+ * also if a synth of the pool is leased
+ * @since 2.6.0
+ */
+int
+fluid_synth_pool_sfload(fluid_synth_pool_t *pool, const char *filename)
+{
+    int i, result, id = FLUID_FAILED;
+
+    fluid_return_val_if_fail(pool != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(filename != NULL, FLUID_FAILED);
+
+    fluid_mutex_lock(pool->mutex);
+
+    for(i = 0; i < pool->size; i++)
+    {
+        if(pool->leased[i])
+        {
+            FLUID_LOG(FLUID_ERR, "Can't load a SoundFont while synths of the pool are leased");
+            goto exit;
+        }
+    }
+
+    for(i = 0; i < pool->size; i++)
+    {
+        result = fluid_synth_sfload(pool->synth[i], filename, TRUE);
+
+        if(result == FLUID_FAILED)
+        {
+            break;
+        }
+
+        id = result;
+    }
+
+    if(i < pool->size || fluid_synth_pool_take_snapshot(pool) != FLUID_OK)
+    {
+        /* the synths before share the same ID */
+        while(--i >= 0)
+        {
+            fluid_synth_sfunload(pool->synth[i], id, TRUE);
+        }
+
+        id = FLUID_FAILED;
+    }
+
+exit:
+    fluid_mutex_unlock(pool->mutex);
+
+    return id;
+}
+
+/**
+ * Lease a synth of a pool.
+ *
+ * The synth may be used like any other synth until it is returned by
+ * fluid_synth_pool_release(), but must not be deleted.
+ *
+ * @param pool Pool of synths
+ * @return A synth not leased yet, or NULL if all synths of the pool are leased
+ * @since 2.6.0
+ */
+fluid_synth_t *
+fluid_synth_pool_lease(fluid_synth_pool_t *pool)
+{
+    fluid_synth_t *synth = NULL;
+    int i;
+
+    fluid_return_val_if_fail(pool != NULL, NULL);
+
+    fluid_mutex_lock(pool->mutex);
+
+    for(i = 0; i < pool->size; i++)
+    {
+        if(!pool->leased[i])
+        {
+            pool->leased[i] = TRUE;
+            synth = pool->synth[i];
+            break;
+        }
+    }
+
+    fluid_mutex_unlock(pool->mutex);
+
+    return synth;
+}
+
+/**
+ * Return a leased synth to its pool.
+ *
+ * All voices of the synth are stopped, its effects are cleared, and its channels,
+ * effects parameters and SoundFonts are restored to the state it was leased in.
+ *
+ * @param pool Pool of synths
+ * @param synth Synth leased from @p pool with fluid_synth_pool_lease()
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ *
+ * @note Tunings created while the synth was leased are kept, see fluid_synth_restore().
+ * @since 2.6.0
+ */
+int
+fluid_synth_pool_release(fluid_synth_pool_t *pool, fluid_synth_t *synth)
+{
+    int i, result;
+
+    fluid_return_val_if_fail(pool != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(synth != NULL, FLUID_FAILED);
+
+    fluid_mutex_lock(pool->mutex);
+
+    for(i = 0; i < pool->size; i++)
+    {
+        if(pool->synth[i] == synth)
+        {
+            break;
+        }
+    }
+
+    if(i == pool->size || !pool->leased[i])
+    {
+        fluid_mutex_unlock(pool->mutex);
+        FLUID_LOG(FLUID_ERR, "The synth isn't leased from this pool");
+        return FLUID_FAILED;
+    }
+
+    fluid_mutex_unlock(pool->mutex);
+
+    /* the snapshot doesn't change while a synth is leased */
+    result = fluid_synth_system_reset(synth);
+
+    if(result == FLUID_OK)
+    {
+        result = fluid_synth_restore(synth, pool->snapshot, pool->snapshot_size);
+    }
+
+    fluid_mutex_lock(pool->mutex);
+    pool->leased[i] = FALSE;
+    fluid_mutex_unlock(pool->mutex);
+
+    return result;
+}
@@ -0,0 +1,661 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_synth.h"
+#include "fluid_chan.h"
+#include "fluid_tuning.h"
+#include "fluid_sfont.h"
+#include "fluid_rev.h"
+#include "fluid_chorus.h"
+
+
+/******************************************************************************
+  Snapshots of the synth state, see fluid_synth_snapshot() and fluid_synth_restore().
+
+  A snapshot is a blob in the native byte order and layout of this build:
+
+     header
+     fx groups     effects_groups * fluid_fx_snapshot_t
+     channels      midi_channels * fluid_channel_snapshot_t
+     SoundFonts    sfont_count * (int id, int length, name + NUL), top of the stack first
+     tunings       tuning_count * (fluid_tuning_snapshot_t, name + NUL)
+
+  Restoring checks the whole blob before it changes anything. SoundFonts are
+  only reloaded if the synth doesn't have the same files loaded in the same
+  order, so that restoring a synth that already has them takes no file access.
+******************************************************************************/
+
+#define FLUID_SNAPSHOT_MAGIC    0x534E5346  /* "FSNS" */
+#define FLUID_SNAPSHOT_VERSION  2
+
+typedef struct
+{
+    int magic;
+    int version;
+    int size;                  /* total size of the snapshot in bytes */
+    int channel_size;          /* sizeof(fluid_channel_snapshot_t), guards against other builds */
+    int midi_channels;
+    int effects_groups;
+    int sfont_count;
+    int tuning_count;
+    float gain;
+    int with_reverb;
+    int with_chorus;
+    double reverb_param[FLUID_REVERB_PARAM_LAST];
+    double chorus_param[FLUID_CHORUS_PARAM_LAST];
+} fluid_snapshot_header_t;
+
+typedef struct
+{
+    double reverb[FLUID_REVERB_PARAM_LAST];
+    double chorus[FLUID_CHORUS_PARAM_LAST];
+} fluid_fx_snapshot_t;
+
+typedef struct
+{
+    int exists;                /* FALSE for a channel that synth.sparse-channels hasn't created yet */
+    int mode;
+    int mode_val;
+    int legatomode;
+    int portamentomode;
+    int channel_type;
+    int interp_method;
+    float pitch_wheel_sensitivity;
+    short pitch_bend;
+    unsigned char channel_pressure;
+    unsigned char previous_cc_breath;
+    unsigned char cc[128];
+    unsigned char key_pressure[128];
+    int has_tuning;
+    int active_tuning_bank;    /* of the tuning of the channel, if has_tuning */
+    int active_tuning_prog;
+    int tuning_bank;           /* selected by RPN, not necessarily active */
+    int tuning_prog;
+    int sfont_id;              /* fluid_channel_get_sfont_bank_prog() */
+    int bank;
+    int prog;
+    int preset_sfont_id;       /* -1 if the channel has no preset */
+    int preset_bank;
+    int preset_prog;
+    int nrpn_select;
+    int nrpn_active;
+    fluid_real_t gen[GEN_LAST];
+    int override_flags[GEN_LAST];
+    fluid_real_t override_val[GEN_LAST];
+} fluid_channel_snapshot_t;
+
+typedef struct
+{
+    int bank;
+    int prog;
+    int name_length;           /* including the terminating NUL */
+    double pitch[128];
+} fluid_tuning_snapshot_t;
+
+/* A snapshot being written or read. When writing with data == NULL, only the size is counted. */
+typedef struct
+{
+    unsigned char *data;
+    const unsigned char *in;
+    int size;
+    int pos;
+} fluid_snapshot_buf_t;
+
+static void fluid_snapshot_put(fluid_snapshot_buf_t *buf, const void *src, int len)
+{
+    if(buf->data != NULL && buf->pos + len <= buf->size)
+    {
+        FLUID_MEMCPY(buf->data + buf->pos, src, len);
+    }
+
+    buf->pos += len;
+}
+
+/* Copies the next len bytes to dst, or only skips them if dst is NULL */
+static int fluid_snapshot_get(fluid_snapshot_buf_t *buf, void *dst, int len)
+{
+    if(len < 0 || len > buf->size - buf->pos)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(dst != NULL)
+    {
+        FLUID_MEMCPY(dst, buf->in + buf->pos, len);
+    }
+
+    buf->pos += len;
+    return FLUID_OK;
+}
+
+/* Returns the NUL-terminated string of len bytes at the current position, NULL if there is none */
+static const char *fluid_snapshot_get_string(fluid_snapshot_buf_t *buf, int len)
+{
+    const char *str = (const char *)buf->in + buf->pos;
+
+    if(len < 1 || fluid_snapshot_get(buf, NULL, len) != FLUID_OK || str[len - 1] != '\0')
+    {
+        return NULL;
+    }
+
+    return str;
+}
+
+static void fluid_snapshot_put_channel(fluid_snapshot_buf_t *buf, fluid_channel_t *chan)
+{
+    fluid_channel_snapshot_t snap;
+    fluid_preset_t *preset;
+    int i;
+
+    FLUID_MEMSET(&snap, 0, sizeof(snap));
+
+    if(chan == NULL)
+    {
+        fluid_snapshot_put(buf, &snap, sizeof(snap));
+        return;
+    }
+
+    preset = fluid_channel_get_preset(chan);
+    snap.exists = TRUE;
+
+    snap.mode = chan->mode & ~FLUID_CHANNEL_LEGATO_PLAYING;
+    snap.mode_val = chan->mode_val;
+    snap.legatomode = chan->legatomode;
+    snap.portamentomode = chan->portamentomode;
+    snap.channel_type = chan->channel_type;
+    snap.interp_method = chan->interp_method;
+    snap.pitch_wheel_sensitivity = chan->pitch_wheel_sensitivity;
+    snap.pitch_bend = chan->pitch_bend;
+    snap.channel_pressure = chan->channel_pressure;
+    snap.previous_cc_breath = chan->previous_cc_breath;
+    FLUID_MEMCPY(snap.cc, chan->cc, sizeof(snap.cc));
+    FLUID_MEMCPY(snap.key_pressure, chan->key_pressure, sizeof(snap.key_pressure));
+
+    snap.has_tuning = fluid_channel_has_tuning(chan);
+
+    if(snap.has_tuning)
+    {
+        snap.active_tuning_bank = fluid_tuning_get_bank(fluid_channel_get_tuning(chan));
+        snap.active_tuning_prog = fluid_tuning_get_prog(fluid_channel_get_tuning(chan));
+    }
+
+    snap.tuning_bank = fluid_channel_get_tuning_bank(chan);
+    snap.tuning_prog = fluid_channel_get_tuning_prog(chan);
+
+    fluid_channel_get_sfont_bank_prog(chan, &snap.sfont_id, &snap.bank, &snap.prog);
+    snap.preset_sfont_id = -1;
+
+    if(preset != NULL)
+    {
+        snap.preset_sfont_id = fluid_sfont_get_id(fluid_preset_get_sfont(preset));
+        snap.preset_bank = fluid_preset_get_banknum(preset);
+        snap.preset_prog = fluid_preset_get_num(preset);
+    }
+
+    snap.nrpn_select = chan->nrpn_select;
+    snap.nrpn_active = chan->nrpn_active;
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        snap.gen[i] = chan->gen[i];
+        snap.override_flags[i] = chan->override_gen_default[i].flags;
+        snap.override_val[i] = chan->override_gen_default[i].val;
+    }
+
+    fluid_snapshot_put(buf, &snap, sizeof(snap));
+}
+
+/*
+ * Writes the snapshot of the synth to data, or only measures it if data is NULL.
+ * Returns the size of the snapshot, FLUID_FAILED if size is too small for it.
+ * Call with the API lock held.
+ */
+int fluid_synth_snapshot_LOCAL(fluid_synth_t *synth, void *data, int size)
+{
+    fluid_snapshot_buf_t buf;
+    fluid_snapshot_header_t header;
+    fluid_fx_snapshot_t fx;
+    fluid_tuning_snapshot_t tuning_snap;
+    fluid_tuning_t *tuning;
+    fluid_sfont_t *sfont;
+    fluid_list_t *list;
+    const char *name;
+    int i, bank, prog, value;
+
+    FLUID_MEMSET(&header, 0, sizeof(header));
+    header.magic = FLUID_SNAPSHOT_MAGIC;
+    header.version = FLUID_SNAPSHOT_VERSION;
+    header.channel_size = sizeof(fluid_channel_snapshot_t);
+    header.midi_channels = synth->midi_channels;
+    header.effects_groups = synth->effects_groups;
+    header.sfont_count = fluid_list_size(synth->sfont);
+    header.gain = synth->gain;
+    header.with_reverb = synth->with_reverb;
+    header.with_chorus = synth->with_chorus;
+    FLUID_MEMCPY(header.reverb_param, synth->reverb_param, sizeof(header.reverb_param));
+    FLUID_MEMCPY(header.chorus_param, synth->chorus_param, sizeof(header.chorus_param));
+
+    for(bank = 0; synth->tuning != NULL && bank < 128; bank++)
+    {
+        for(prog = 0; synth->tuning[bank] != NULL && prog < 128; prog++)
+        {
+            header.tuning_count += (synth->tuning[bank][prog] != NULL);
+        }
+    }
+
+    /* first only count the size, then write if the buffer is large enough */
+    buf.data = NULL;
+    buf.in = NULL;
+    buf.size = 0;
+    buf.pos = 0;
+
+    for(;;)
+    {
+        fluid_snapshot_put(&buf, &header, sizeof(header));
+
+        for(i = 0; i < synth->effects_groups; i++)
+        {
+            fluid_synth_get_reverb_group_roomsize(synth, i, &fx.reverb[FLUID_REVERB_ROOMSIZE]);
+            fluid_synth_get_reverb_group_damp(synth, i, &fx.reverb[FLUID_REVERB_DAMP]);
+            fluid_synth_get_reverb_group_width(synth, i, &fx.reverb[FLUID_REVERB_WIDTH]);
+            fluid_synth_get_reverb_group_level(synth, i, &fx.reverb[FLUID_REVERB_LEVEL]);
+            fluid_synth_get_chorus_group_nr(synth, i, &value);
+            fx.chorus[FLUID_CHORUS_NR] = value;
+            fluid_synth_get_chorus_group_level(synth, i, &fx.chorus[FLUID_CHORUS_LEVEL]);
+            fluid_synth_get_chorus_group_speed(synth, i, &fx.chorus[FLUID_CHORUS_SPEED]);
+            fluid_synth_get_chorus_group_depth(synth, i, &fx.chorus[FLUID_CHORUS_DEPTH]);
+            fluid_synth_get_chorus_group_type(synth, i, &value);
+            fx.chorus[FLUID_CHORUS_TYPE] = value;
+            fluid_snapshot_put(&buf, &fx, sizeof(fx));
+        }
+
+        for(i = 0; i < synth->midi_channels; i++)
+        {
+            fluid_snapshot_put_channel(&buf, synth->channel[i]);
+        }
+
+        for(list = synth->sfont; list; list = fluid_list_next(list))
+        {
+            sfont = fluid_list_get(list);
+            name = fluid_sfont_get_name(sfont);
+            name = (name != NULL) ? name : "";
+            value = fluid_sfont_get_id(sfont);
+            fluid_snapshot_put(&buf, &value, sizeof(value));
+            value = (int)FLUID_STRLEN(name) + 1;
+            fluid_snapshot_put(&buf, &value, sizeof(value));
+            fluid_snapshot_put(&buf, name, value);
+        }
+
+        for(bank = 0; synth->tuning != NULL && bank < 128; bank++)
+        {
+            for(prog = 0; synth->tuning[bank] != NULL && prog < 128; prog++)
+            {
+                tuning = synth->tuning[bank][prog];
+
+                if(tuning == NULL)
+                {
+                    continue;
+                }
+
+                name = fluid_tuning_get_name(tuning);
+                name = (name != NULL) ? name : "";
+                tuning_snap.bank = bank;
+                tuning_snap.prog = prog;
+                tuning_snap.name_length = (int)FLUID_STRLEN(name) + 1;
+                FLUID_MEMCPY(tuning_snap.pitch, tuning->pitch, sizeof(tuning_snap.pitch));
+                fluid_snapshot_put(&buf, &tuning_snap, sizeof(tuning_snap));
+                fluid_snapshot_put(&buf, name, tuning_snap.name_length);
+            }
+        }
+
+        if(buf.data != NULL || data == NULL)
+        {
+            return buf.pos;
+        }
+
+        if(size < buf.pos)
+        {
+            FLUID_LOG(FLUID_ERR, "Synth snapshot needs %d bytes, buffer has %d", buf.pos, size);
+            return FLUID_FAILED;
+        }
+
+        header.size = buf.pos;
+        buf.data = data;
+        buf.size = size;
+        buf.pos = 0;
+    }
+}
+
+/*
+ * Makes the synth have the SoundFonts of the snapshot loaded, in the same order, and
+ * stores the ID each of them has in this synth to ids[2 * i + 1]. ids[2 * i] holds the
+ * ID in the snapshot. If the synth doesn't have the same files loaded in the same order
+ * already, they are loaded again, and the SoundFonts loaded before are unloaded.
+ */
+static int fluid_synth_restore_sfonts(fluid_synth_t *synth, const char **names, int *ids, int count)
+{
+    fluid_list_t *list;
+    fluid_sfont_t *sfont;
+    int i;
+
+    for(i = 0, list = synth->sfont; i < count && list; i++, list = fluid_list_next(list))
+    {
+        sfont = fluid_list_get(list);
+
+        if(fluid_sfont_get_name(sfont) == NULL || FLUID_STRCMP(fluid_sfont_get_name(sfont), names[i]) != 0)
+        {
+            break;
+        }
+
+        ids[2 * i + 1] = fluid_sfont_get_id(sfont);
+    }
+
+    if(i == count && list == NULL)
+    {
+        return FLUID_OK;
+    }
+
+    /* load the bottom of the stack first, so that the order is kept */
+    for(i = count - 1; i >= 0; i--)
+    {
+        ids[2 * i + 1] = fluid_synth_sfload(synth, names[i], FALSE);
+
+        if(ids[2 * i + 1] == FLUID_FAILED)
+        {
+            FLUID_LOG(FLUID_ERR, "Failed to reload SoundFont '%s' of the snapshot", names[i]);
+
+            for(i++; i < count; i++)
+            {
+                fluid_synth_sfunload(synth, ids[2 * i + 1], FALSE);
+            }
+
+            return FLUID_FAILED;
+        }
+    }
+
+    while((list = fluid_list_nth(synth->sfont, count)) != NULL)
+    {
+        fluid_synth_sfunload(synth, fluid_sfont_get_id(fluid_list_get(list)), FALSE);
+    }
+
+    return FLUID_OK;
+}
+
+/* Returns the ID in this synth of the SoundFont with the given ID in the snapshot, -1 if there is none */
+static int fluid_synth_restore_sfont_id(const int *ids, int count, int id)
+{
+    int i;
+
+    for(i = 0; i < count; i++)
+    {
+        if(ids[2 * i] == id)
+        {
+            return ids[2 * i + 1];
+        }
+    }
+
+    return -1;
+}
+
+static fluid_preset_t *fluid_synth_restore_preset(fluid_synth_t *synth, int sfont_id, int bank, int prog)
+{
+    fluid_list_t *list;
+    fluid_sfont_t *sfont;
+
+    for(list = synth->sfont; list; list = fluid_list_next(list))
+    {
+        sfont = fluid_list_get(list);
+
+        if(fluid_sfont_get_id(sfont) == sfont_id)
+        {
+            return fluid_sfont_get_preset(sfont, bank, prog);
+        }
+    }
+
+    return NULL;
+}
+
+static void fluid_synth_restore_channel(fluid_synth_t *synth, int chan,
+                                        const fluid_channel_snapshot_t *snap,
+                                        const int *ids, int sfont_count)
+{
+    fluid_channel_t *channel = synth->channel[chan];
+    fluid_preset_t *preset = NULL;
+    int i, sfont_id;
+
+    if(!snap->exists)
+    {
+        /* back to the state in which it doesn't exist */
+        if(channel != NULL)
+        {
+            fluid_channel_reset(channel);
+            fluid_synth_init_channel_LOCAL(synth, channel);
+        }
+
+        return;
+    }
+
+    if(channel == NULL)
+    {
+        if(fluid_synth_create_channel_LOCAL(synth, chan) != FLUID_OK)
+        {
+            FLUID_LOG(FLUID_WARN, "Failed to restore channel %d of the snapshot", chan);
+            return;
+        }
+
+        channel = synth->channel[chan];
+    }
+
+    if(snap->preset_sfont_id != -1)
+    {
+        preset = fluid_synth_restore_preset(synth,
+                                            fluid_synth_restore_sfont_id(ids, sfont_count, snap->preset_sfont_id),
+                                            snap->preset_bank, snap->preset_prog);
+
+        if(preset == NULL)
+        {
+            FLUID_LOG(FLUID_WARN, "Preset %d-%d of the snapshot not found for channel %d",
+                      snap->preset_bank, snap->preset_prog, chan);
+        }
+    }
+
+    fluid_channel_set_preset(channel, preset);
+
+    /* the SoundFont ID of a channel may refer to a SoundFont unloaded meanwhile */
+    sfont_id = fluid_synth_restore_sfont_id(ids, sfont_count, snap->sfont_id);
+    fluid_channel_set_sfont_bank_prog(channel, (sfont_id != -1) ? sfont_id : snap->sfont_id,
+                                      snap->bank, snap->prog);
+
+    if(snap->has_tuning)
+    {
+        fluid_synth_activate_tuning(synth, chan, snap->active_tuning_bank, snap->active_tuning_prog, FALSE);
+    }
+    else
+    {
+        fluid_synth_deactivate_tuning(synth, chan, FALSE);
+    }
+
+    fluid_channel_set_tuning_bank(channel, snap->tuning_bank);
+    fluid_channel_set_tuning_prog(channel, snap->tuning_prog);
+
+    channel->mode = snap->mode;
+    channel->mode_val = snap->mode_val;
+    channel->legatomode = snap->legatomode;
+    channel->portamentomode = snap->portamentomode;
+    channel->channel_type = snap->channel_type;
+    channel->interp_method = snap->interp_method;
+    channel->pitch_wheel_sensitivity = snap->pitch_wheel_sensitivity;
+    channel->pitch_bend = snap->pitch_bend;
+    channel->channel_pressure = snap->channel_pressure;
+    channel->previous_cc_breath = snap->previous_cc_breath;
+    FLUID_MEMCPY(channel->cc, snap->cc, sizeof(channel->cc));
+    FLUID_MEMCPY(channel->key_pressure, snap->key_pressure, sizeof(channel->key_pressure));
+    channel->nrpn_select = snap->nrpn_select;
+    channel->nrpn_active = snap->nrpn_active;
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        channel->gen[i] = snap->gen[i];
+        channel->override_gen_default[i].flags = snap->override_flags[i];
+        channel->override_gen_default[i].val = snap->override_val[i];
+    }
+
+    /* no notes are playing after a restore */
+    fluid_channel_clear_monolist(channel);
+    fluid_channel_clear_prev_note(channel);
+    channel->key_mono_sustained = INVALID_NOTE;
+}
+
+/*
+ * Restores a snapshot written by fluid_synth_snapshot_LOCAL(). Leaves the synth
+ * unchanged if the snapshot is invalid. Call with the API lock held.
+ */
+int fluid_synth_restore_LOCAL(fluid_synth_t *synth, const void *data, int size)
+{
+    fluid_snapshot_buf_t buf;
+    fluid_snapshot_header_t header;
+    fluid_fx_snapshot_t fx;
+    fluid_channel_snapshot_t snap;
+    fluid_tuning_snapshot_t tuning_snap;
+    const char **names = NULL;
+    const char *name;
+    int *ids = NULL;
+    int i, fx_pos, channel_pos, tuning_pos, len, result = FLUID_FAILED;
+
+    buf.data = NULL;
+    buf.in = data;
+    buf.size = size;
+    buf.pos = 0;
+
+    if(fluid_snapshot_get(&buf, &header, sizeof(header)) != FLUID_OK
+            || header.magic != FLUID_SNAPSHOT_MAGIC
+            || header.version != FLUID_SNAPSHOT_VERSION
+            || header.channel_size != (int)sizeof(fluid_channel_snapshot_t)
+            || header.size != size)
+    {
+        FLUID_LOG(FLUID_ERR, "Invalid synth snapshot, or made by another build of FluidSynth");
+        return FLUID_FAILED;
+    }
+
+    if(header.midi_channels != synth->midi_channels || header.effects_groups != synth->effects_groups)
+    {
+        FLUID_LOG(FLUID_ERR, "Synth snapshot made with %d MIDI channels and %d effects groups",
+                  header.midi_channels, header.effects_groups);
+        return FLUID_FAILED;
+    }
+
+    names = FLUID_ARRAY(const char *, header.sfont_count + 1);
+    ids = FLUID_ARRAY(int, 2 * header.sfont_count + 2);
+
+    if(names == NULL || ids == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        goto error_recovery;
+    }
+
+    /* check everything before changing anything */
+    fx_pos = buf.pos;
+    channel_pos = fx_pos + header.effects_groups * (int)sizeof(fx);
+
+    if(fluid_snapshot_get(&buf, NULL, header.effects_groups * (int)sizeof(fx)) != FLUID_OK
+            || fluid_snapshot_get(&buf, NULL, header.midi_channels * (int)sizeof(snap)) != FLUID_OK)
+    {
+        goto invalid;
+    }
+
+    for(i = 0; i < header.sfont_count; i++)
+    {
+        if(fluid_snapshot_get(&buf, &ids[2 * i], sizeof(int)) != FLUID_OK
+                || fluid_snapshot_get(&buf, &len, sizeof(len)) != FLUID_OK
+                || (names[i] = fluid_snapshot_get_string(&buf, len)) == NULL)
+        {
+            goto invalid;
+        }
+    }
+
+    tuning_pos = buf.pos;
+
+    for(i = 0; i < header.tuning_count; i++)
+    {
+        if(fluid_snapshot_get(&buf, &tuning_snap, sizeof(tuning_snap)) != FLUID_OK
+                || tuning_snap.bank < 0 || tuning_snap.bank > 127
+                || tuning_snap.prog < 0 || tuning_snap.prog > 127
+                || fluid_snapshot_get_string(&buf, tuning_snap.name_length) == NULL)
+        {
+            goto invalid;
+        }
+    }
+
+    if(buf.pos != size)
+    {
+        goto invalid;
+    }
+
+    if(fluid_synth_restore_sfonts(synth, names, ids, header.sfont_count) != FLUID_OK)
+    {
+        goto error_recovery;
+    }
+
+    fluid_synth_all_sounds_off(synth, -1);
+
+    fluid_synth_set_gain(synth, header.gain);
+    fluid_synth_reverb_on(synth, -1, header.with_reverb);
+    fluid_synth_chorus_on(synth, -1, header.with_chorus);
+    FLUID_MEMCPY(synth->reverb_param, header.reverb_param, sizeof(synth->reverb_param));
+    FLUID_MEMCPY(synth->chorus_param, header.chorus_param, sizeof(synth->chorus_param));
+
+    buf.pos = fx_pos;
+
+    for(i = 0; i < header.effects_groups; i++)
+    {
+        fluid_snapshot_get(&buf, &fx, sizeof(fx));
+        fluid_synth_set_reverb_full(synth, i, FLUID_REVMODEL_SET_ALL, fx.reverb);
+        fluid_synth_set_chorus_full(synth, i, FLUID_CHORUS_SET_ALL, fx.chorus);
+    }
+
+    /* tunings before the channels, so that they find theirs */
+    buf.pos = tuning_pos;
+
+    for(i = 0; i < header.tuning_count; i++)
+    {
+        fluid_snapshot_get(&buf, &tuning_snap, sizeof(tuning_snap));
+        name = fluid_snapshot_get_string(&buf, tuning_snap.name_length);
+        fluid_synth_activate_key_tuning(synth, tuning_snap.bank, tuning_snap.prog, name,
+                                        tuning_snap.pitch, FALSE);
+    }
+
+    buf.pos = channel_pos;
+
+    for(i = 0; i < header.midi_channels; i++)
+    {
+        fluid_snapshot_get(&buf, &snap, sizeof(snap));
+        fluid_synth_restore_channel(synth, i, &snap, ids, header.sfont_count);
+    }
+
+    result = FLUID_OK;
+    goto error_recovery;
+
+invalid:
+    FLUID_LOG(FLUID_ERR, "Invalid synth snapshot");
+
+error_recovery:
+    FLUID_FREE(names);
+    FLUID_FREE(ids);
+    return result;
+}
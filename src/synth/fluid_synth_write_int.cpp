@@ -57,17 +57,23 @@ template<> struct int_write_traits<s16_tag>
 {
     typedef int16_t sample_t;
 
-    static FLUID_INLINE sample_t emit(fluid_real_t x, int ch, int di)
+    static FLUID_INLINE void convert(const fluid_real_t *in, sample_t *out, int count, int ch, int di)
     {
         /* Preserve exact arithmetic order:
          * (sample * 32766.0f) + rand_table[ch][di], then round_clip_to_i16().
          */
-        return round_clip_to<sample_t>((float)x * 32766.0f + rand_table[ch][di]);
+        fluid_audio_convert_s16(in, &rand_table[ch][di], out, count);
     }
 
-    static FLUID_INLINE void advance_di(int &di)
+    /* the dither of a chunk must be contiguous in the table */
+    static FLUID_INLINE int max_chunk(int di)
     {
-        if(++di >= DITHER_SIZE)
+        return DITHER_SIZE - di;
+    }
+
+    static FLUID_INLINE void advance_di(int &di, int count)
+    {
+        if((di += count) >= DITHER_SIZE)
         {
             di = 0;
         }
@@ -97,17 +103,21 @@ template<> struct int_write_traits<s24_tag>
 {
     typedef int32_t sample_t;
 
-    static FLUID_INLINE sample_t emit(fluid_real_t x, int /*ch*/, int /*di*/)
+    static FLUID_INLINE void convert(const fluid_real_t *in, sample_t *out, int count, int /*ch*/, int /*di*/)
     {
         /* 24 valid bits left-aligned in 32-bit container:
          * - Convert exactly like s32 (full 32-bit scale)
          * - Then clear the lowest 8 bits (transport truncation)
          */
-        sample_t s = round_clip_to<sample_t>(x * 2147483646.0f);
-        return (sample_t)(s & 0xFFFFFF00);
+        fluid_audio_convert_s32(in, out, count, ~(int32_t)0xFF);
+    }
+
+    static FLUID_INLINE int max_chunk(int /*di*/)
+    {
+        return FLUID_BUFSIZE;
     }
 
-    static FLUID_INLINE void advance_di(int & /*di*/)
+    static FLUID_INLINE void advance_di(int & /*di*/, int /*count*/)
     {
     }
 
@@ -126,16 +136,21 @@ template<> struct int_write_traits<s32_tag>
 {
     typedef int32_t sample_t;
 
-    static FLUID_INLINE sample_t emit(fluid_real_t x, int /*ch*/, int /*di*/)
+    static FLUID_INLINE void convert(const fluid_real_t *in, sample_t *out, int count, int /*ch*/, int /*di*/)
     {
         /* No dithering. Convert using round+clip only.
          * Keep scale convention parallel to s16's 32766.0f:
          * INT32_MAX-1 => 2147483646.0f
          */
-        return round_clip_to<sample_t>(x * 2147483646.0f);
+        fluid_audio_convert_s32(in, out, count, -1);
     }
 
-    static FLUID_INLINE void advance_di(int & /*di*/)
+    static FLUID_INLINE int max_chunk(int /*di*/)
+    {
+        return FLUID_BUFSIZE;
+    }
+
+    static FLUID_INLINE void advance_di(int & /*di*/, int /*count*/)
     {
         /* no-op: s32 has no dither index */
     }
@@ -151,6 +166,19 @@ template<> struct int_write_traits<s32_tag>
     }
 };
 
+/* stores count samples to an output channel and advances it */
+template<typename T>
+static FLUID_INLINE void fluid_synth_write_int_store(T *&out, int incr, const T *conv, int count)
+{
+    int k;
+
+    for(k = 0; k < count; k++)
+    {
+        *out = conv[k];
+        out += incr;
+    }
+}
+
 template<typename Tag>
 static int fluid_synth_write_int_channels_impl(fluid_synth_t *synth,
         int len,
@@ -259,8 +287,17 @@ static int fluid_synth_write_int_channels_impl(fluid_synth_t *synth,
         /* reverse index */
         n = 0 - n;
 
+        /* convert the samples of each channel in chunks, written to the output afterwards */
         do
         {
+            sample_t conv[FLUID_BUFSIZE];
+            int count = (-n < traits_t::max_chunk(di)) ? -n : traits_t::max_chunk(di);
+
+            if(count > FLUID_BUFSIZE)
+            {
+                count = FLUID_BUFSIZE;
+            }
+
             i = bufs_in_count;
 
             do
@@ -269,21 +306,20 @@ static int fluid_synth_write_int_channels_impl(fluid_synth_t *synth,
                 int in_idx = --i * FLUID_BUFSIZE * FLUID_MIXER_MAX_BUFFERS_DEFAULT + n;
                 int c = i << 1; /* channel index c to write */
 
-                /* write left input sample to channel sample */
-                *chan_out[c] = traits_t::emit(left_in[in_idx], 0, di);
-
-                /* write right input sample to next channel sample */
-                *chan_out[c + 1] = traits_t::emit(right_in[in_idx], 1, di);
+                /* write left input samples to channel samples */
+                traits_t::convert(&left_in[in_idx], conv, count, 0, di);
+                fluid_synth_write_int_store(chan_out[c], channels_incr[c], conv, count);
 
-                /* advance output pointers */
-                chan_out[c] += channels_incr[c];
-                chan_out[c + 1] += channels_incr[c + 1];
+                /* write right input samples to next channel samples */
+                traits_t::convert(&right_in[in_idx], conv, count, 1, di);
+                fluid_synth_write_int_store(chan_out[c + 1], channels_incr[c + 1], conv, count);
             }
             while(i);
 
-            traits_t::advance_di(di);
+            traits_t::advance_di(di, count);
+            n += count;
         }
-        while(++n < 0);
+        while(n < 0);
     }
     while(size);
 
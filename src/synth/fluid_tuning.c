@@ -187,3 +187,47 @@ void fluid_tuning_set_pitch(fluid_tuning_t *tuning, int key, double pitch)
         tuning->pitch[key] = pitch;
     }
 }
+
+/*
+ * Marks the keys whose pitch differs between two tunings in a bit set of 128 bits, i.e.
+ * 4 words. A NULL tuning is the equal tempered scale of a channel without tuning, which
+ * is calculated differently, so all keys are marked then.
+ */
+void fluid_tuning_get_changed_keys(const fluid_tuning_t *old_tuning, const fluid_tuning_t *new_tuning,
+                                   uint32_t *changed)
+{
+    int i;
+
+    FLUID_MEMSET(changed, 0, 4 * sizeof(uint32_t));
+
+    for(i = 0; i < 128; i++)
+    {
+        if(old_tuning == NULL || new_tuning == NULL || old_tuning->pitch[i] != new_tuning->pitch[i])
+        {
+            changed[i >> 5] |= (uint32_t)1 << (i & 31);
+        }
+    }
+}
+
+/*
+ * Sets the pitch of len keys in place. Only the keys whose pitch actually changes
+ * are marked in changed, see fluid_tuning_key_changed().
+ */
+void fluid_tuning_update_keys(fluid_tuning_t *tuning, int len, const int *keys, const double *pitch,
+                              uint32_t *changed)
+{
+    int i, key;
+
+    FLUID_MEMSET(changed, 0, 4 * sizeof(uint32_t));
+
+    for(i = 0; i < len; i++)
+    {
+        key = keys[i];
+
+        if(key >= 0 && key < 128 && tuning->pitch[key] != pitch[i])
+        {
+            tuning->pitch[key] = pitch[i];
+            changed[key >> 5] |= (uint32_t)1 << (key & 31);
+        }
+    }
+}
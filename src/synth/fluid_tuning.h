@@ -32,6 +32,7 @@
 #define _FLUID_TUNING_H
 
 #include "fluidsynth_priv.h"
+#include "fluid_sys.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -66,6 +67,12 @@ void fluid_tuning_set_octave(fluid_tuning_t *tuning, const double *pitch_deriv);
 void fluid_tuning_set_all(fluid_tuning_t *tuning, const double *pitch);
 #define fluid_tuning_get_all(_t) (&(_t)->pitch[0])
 
+void fluid_tuning_get_changed_keys(const fluid_tuning_t *old_tuning, const fluid_tuning_t *new_tuning,
+                                   uint32_t *changed);
+void fluid_tuning_update_keys(fluid_tuning_t *tuning, int len, const int *keys, const double *pitch,
+                              uint32_t *changed);
+#define fluid_tuning_key_changed(_changed, _key) (((_changed)[(_key) >> 5] >> ((_key) & 31)) & 1)
+
 #ifdef __cplusplus
 }
 #endif
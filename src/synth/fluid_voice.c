@@ -26,6 +26,7 @@
 #include "fluid_sys.h"
 #include "fluid_sfont.h"
 #include "fluid_rvoice_event.h"
+#include "fluid_rvoice_cache.h"
 #include "fluid_defsfont.h"
 
 /* used for filter turn off optimization - if filter cutoff is above the
@@ -45,40 +46,114 @@ static int calculate_hold_decay_buffers(fluid_voice_t *voice, int gen_base,
 static fluid_real_t
 fluid_voice_get_lower_boundary_for_attenuation(fluid_voice_t *voice);
 
+/* Tells the rvoice to stop using the voice cache before the first event changes it after it
+ * has been started, see fluid_rvoice_cache.h. The amplitudes of the buffers don't matter. */
+static FLUID_INLINE void
+fluid_voice_leave_cache(fluid_voice_t *voice, const void *obj)
+{
+    if(voice->rvoice_cached && obj != &voice->rvoice->buffers)
+    {
+        voice->rvoice_cached = FALSE;
+        fluid_rvoice_eventhandler_push_ptr(voice->eventhandler, fluid_rvoice_cache_leave, voice->rvoice, NULL);
+    }
+}
+
+/* Sends a parameter update to the rvoice. From fluid_voice_init() until the voice starts,
+ * the updates are collected in the param block of the rvoice, and
+ * fluid_voice_send_param_block() sends them as a single event. */
+static void
+fluid_voice_send_param_block(fluid_voice_t *voice)
+{
+    if(voice->param_block_count > 0)
+    {
+        fluid_rvoice_eventhandler_push_int_real(voice->eventhandler, fluid_rvoice_apply_param_block,
+                                                voice->rvoice, voice->param_block_count, 0.0f);
+    }
+
+    voice->param_block_count = -1;
+}
+
+static void
+fluid_voice_push(fluid_voice_t *voice, fluid_rvoice_function_t method, void *obj,
+                 fluid_rvoice_param_t param[MAX_EVENT_PARAMS])
+{
+    fluid_rvoice_event_t *event;
+
+    if(voice->param_block_count >= 0)
+    {
+        if(voice->param_block_count < FLUID_RVOICE_PARAM_BLOCK_SIZE)
+        {
+            event = &voice->rvoice->param_block[voice->param_block_count++];
+            event->method = method;
+            event->object = obj;
+            FLUID_MEMCPY(event->param, param, sizeof(event->param));
+            return;
+        }
+
+        /* the block is full, the remaining updates follow it as single events */
+        fluid_voice_send_param_block(voice);
+    }
+
+    fluid_rvoice_eventhandler_push(voice->eventhandler, method, obj, param);
+}
+
 #define UPDATE_RVOICE0(proc) \
   do { \
       fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
-      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, voice->rvoice, param); \
+      fluid_voice_leave_cache(voice, voice->rvoice); \
+      fluid_voice_push(voice, proc, voice->rvoice, param); \
   } while (0)
 
 #define UPDATE_RVOICE_GENERIC_R1(proc, obj, rarg) \
   do { \
       fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
+      fluid_voice_leave_cache(voice, obj); \
       param[0].real = rarg; \
-      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param); \
+      fluid_voice_push(voice, proc, obj, param); \
   } while (0)
 
 #define UPDATE_RVOICE_GENERIC_I1(proc, obj, iarg) \
   do { \
       fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
+      fluid_voice_leave_cache(voice, obj); \
       param[0].i = iarg; \
-      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param); \
+      fluid_voice_push(voice, proc, obj, param); \
   } while (0)
 
 #define UPDATE_RVOICE_GENERIC_I2(proc, obj, iarg1, iarg2) \
   do { \
       fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
+      fluid_voice_leave_cache(voice, obj); \
       param[0].i = iarg1; \
       param[1].i = iarg2; \
-      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param); \
+      fluid_voice_push(voice, proc, obj, param); \
+  } while (0)
+
+#define UPDATE_RVOICE_GENERIC_I3(proc, obj, iarg1, iarg2, iarg3) \
+  do { \
+      fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
+      fluid_voice_leave_cache(voice, obj); \
+      param[0].i = iarg1; \
+      param[1].i = iarg2; \
+      param[2].i = iarg3; \
+      fluid_voice_push(voice, proc, obj, param); \
+  } while (0)
+
+#define UPDATE_RVOICE_GENERIC_PTR(proc, obj, parg) \
+  do { \
+      fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
+      fluid_voice_leave_cache(voice, obj); \
+      param[0].ptr = parg; \
+      fluid_voice_push(voice, proc, obj, param); \
   } while (0)
 
 #define UPDATE_RVOICE_GENERIC_IR(proc, obj, iarg, rarg) \
   do { \
       fluid_rvoice_param_t param[MAX_EVENT_PARAMS]; \
+      fluid_voice_leave_cache(voice, obj); \
       param[0].i = iarg; \
       param[1].real = rarg; \
-      fluid_rvoice_eventhandler_push(voice->eventhandler, proc, obj, param); \
+      fluid_voice_push(voice, proc, obj, param); \
   } while (0)
 
 
@@ -110,10 +185,11 @@ fluid_voice_update_volenv(fluid_voice_t *voice,
 
     if(enqueue)
     {
-        fluid_rvoice_eventhandler_push(voice->eventhandler,
-                                       fluid_adsr_env_set_data,
-                                       &voice->rvoice->envlfo.volenv,
-                                       param);
+        fluid_voice_leave_cache(voice, voice->rvoice);
+        fluid_voice_push(voice,
+                         fluid_adsr_env_set_data,
+                         &voice->rvoice->envlfo.volenv,
+                         param);
     }
     else
     {
@@ -142,10 +218,11 @@ fluid_voice_update_modenv(fluid_voice_t *voice,
 
     if(enqueue)
     {
-        fluid_rvoice_eventhandler_push(voice->eventhandler,
-                                       fluid_adsr_env_set_data,
-                                       &voice->rvoice->envlfo.modenv,
-                                       param);
+        fluid_voice_leave_cache(voice, voice->rvoice);
+        fluid_voice_push(voice,
+                         fluid_adsr_env_set_data,
+                         &voice->rvoice->envlfo.modenv,
+                         param);
     }
     else
     {
@@ -153,15 +230,50 @@ fluid_voice_update_modenv(fluid_voice_t *voice,
     }
 }
 
-static FLUID_INLINE void fluid_voice_sample_unref(fluid_sample_t **sample)
+static FLUID_INLINE void fluid_voice_sample_unref(fluid_voice_t *voice, fluid_sample_t **sample)
 {
     if(*sample != NULL)
     {
-        fluid_sample_decr_ref(*sample);
+        fluid_synth_release_sample_LOCAL(voice->channel != NULL ? voice->channel->synth : NULL, *sample);
         *sample = NULL;
     }
 }
 
+/*
+ * Lets go of the shared modulators of the voice, which then may change. They are
+ * released along with the sample, whose SoundFont owns them.
+ */
+static FLUID_INLINE void fluid_voice_release_shared_mods(fluid_voice_t *voice)
+{
+    if(voice->shared_mods != NULL)
+    {
+        fluid_atomic_int_add(&voice->shared_mods->refcount, -1);
+        voice->shared_mods = NULL;
+    }
+}
+
+/*
+ * Tells the synth that the overflow priority of the voice might have changed
+ */
+static FLUID_INLINE void fluid_voice_update_overflow_prio(fluid_voice_t *voice)
+{
+    if(voice->channel != NULL)
+    {
+        fluid_synth_update_overflow_prio_LOCAL(voice->channel->synth, voice);
+    }
+}
+
+/*
+ * Removes the voice from the voice lists of the synth before its channel or key changes
+ */
+static FLUID_INLINE void fluid_voice_unlink(fluid_voice_t *voice)
+{
+    if(voice->chan != NO_CHANNEL)
+    {
+        fluid_synth_unlink_voice_LOCAL(voice->channel->synth, voice);
+    }
+}
+
 /*
  * Swaps the current rvoice with the current overflow_rvoice
  */
@@ -213,7 +325,8 @@ static void fluid_voice_initialize_rvoice(fluid_voice_t *voice, fluid_real_t out
  * new_fluid_voice
  */
 fluid_voice_t *
-new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate, fluid_iir_sincos_t *sincos_table)
+new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate, fluid_iir_sincos_t *sincos_table,
+                fluid_rvoice_stream_t *stream)
 {
     fluid_voice_t *voice;
     voice = FLUID_NEW(fluid_voice_t);
@@ -226,6 +339,10 @@ new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate,
 
     voice->can_access_rvoice = TRUE;
     voice->can_access_overflow_rvoice = TRUE;
+    voice->rvoice_cached = FALSE;
+    voice->stolen = FALSE;
+    voice->param_block_count = -1;
+    voice->index = -1;
 
     voice->rvoice = FLUID_NEW(fluid_rvoice_t);
     voice->overflow_rvoice = FLUID_NEW(fluid_rvoice_t);
@@ -246,12 +363,29 @@ new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate,
     voice->sample = NULL;
     voice->overflow_sample = NULL;
     voice->output_rate = output_rate;
+    voice->mod_count = 0;
+    voice->mod = NULL;
+    voice->shared_mods = NULL;
+    voice->own_mod = NULL;
 
     /* Initialize both the rvoice and overflow_rvoice */
     fluid_voice_initialize_rvoice(voice, output_rate, sincos_table);
     fluid_voice_swap_rvoice(voice);
     fluid_voice_initialize_rvoice(voice, output_rate, sincos_table);
 
+    /* Both rvoices may play a sample at the same time, so each one needs its own slot */
+    if(stream != NULL)
+    {
+        voice->rvoice->stream_slot = fluid_rvoice_stream_new_slot(stream);
+        voice->overflow_rvoice->stream_slot = fluid_rvoice_stream_new_slot(stream);
+
+        if(voice->rvoice->stream_slot == NULL || voice->overflow_rvoice->stream_slot == NULL)
+        {
+            delete_fluid_voice(voice);
+            return NULL;
+        }
+    }
+
     return voice;
 }
 
@@ -268,6 +402,7 @@ delete_fluid_voice(fluid_voice_t *voice)
         FLUID_LOG(FLUID_WARN, "Deleting voice %u which has locked rvoices!", voice->id);
     }
 
+    FLUID_FREE(voice->own_mod);
     FLUID_FREE(voice->overflow_rvoice);
     FLUID_FREE(voice->rvoice);
     FLUID_FREE(voice);
@@ -293,6 +428,9 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
      * of IIR filters, position in sample etc) is initialized. */
     int i;
 
+    /* the voice has been initialized before, but not started */
+    fluid_voice_send_param_block(voice);
+
     if(!voice->can_access_rvoice)
     {
         if(voice->can_access_overflow_rvoice)
@@ -313,16 +451,27 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
         fluid_voice_off(voice);
     }
 
+    fluid_voice_unlink(voice);
+
     voice->zone_range = inst_zone_range; /* Instrument zone range for legato */
     voice->id = id;
     voice->chan = fluid_channel_get_num(channel);
     voice->key = (unsigned char) key;
     voice->vel = (unsigned char) vel;
     voice->channel = channel;
+    fluid_synth_link_voice_LOCAL(channel->synth, voice);
+    fluid_voice_release_shared_mods(voice);
+    voice->mod = voice->own_mod;
     voice->mod_count = 0;
+    FLUID_MEMSET(voice->mod_dest_first, FLUID_NUM_MOD, sizeof(voice->mod_dest_first));
     voice->start_time = start_time;
     voice->has_noteoff = 0;
+    voice->rvoice_cached = FALSE;
+
+    /* until the voice starts, the rvoice receives the updates as one event */
+    voice->param_block_count = 0;
     UPDATE_RVOICE0(fluid_rvoice_reset);
+    UPDATE_RVOICE_GENERIC_I3(fluid_rvoice_set_note, voice->rvoice, voice->chan, key, vel);
 
     /*
        We increment the reference count of the sample to indicate that this
@@ -330,7 +479,7 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
        unloading of the soundfont while this rvoice is playing.
     */
     fluid_sample_incr_ref(sample);
-    fluid_rvoice_eventhandler_push_ptr(voice->eventhandler, fluid_rvoice_set_sample, voice->rvoice, sample);
+    UPDATE_RVOICE_GENERIC_PTR(fluid_rvoice_set_sample, voice->rvoice, sample);
     voice->sample = sample;
 
     i = fluid_channel_get_interp_method(channel);
@@ -353,6 +502,7 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
         voice->synth_gain = 0.0000001f;
     }
 
+    UPDATE_RVOICE_R1(fluid_rvoice_set_noise_floor, channel->synth->noise_floor);
     UPDATE_RVOICE_R1(fluid_rvoice_set_synth_gain, voice->synth_gain);
 
     /* Set up buffer mapping, should be done more flexible in the future. */
@@ -365,6 +515,9 @@ fluid_voice_init(fluid_voice_t *voice, fluid_sample_t *sample,
     UPDATE_RVOICE_GENERIC_I2(fluid_rvoice_buffers_set_mapping, &voice->rvoice->buffers, 0, i);
     UPDATE_RVOICE_GENERIC_I2(fluid_rvoice_buffers_set_mapping, &voice->rvoice->buffers, 1, i + 1);
 
+    /* the rvoices may have been swapped and the voice got a new start time */
+    fluid_voice_update_overflow_prio(voice);
+
     return FLUID_OK;
 }
 
@@ -450,14 +603,26 @@ void fluid_voice_start(fluid_voice_t *voice)
 
     fluid_voice_calculate_runtime_synthesis_parameters(voice);
 
+    /* start at the sample offset of the noteon within the block, see synth.sample-accurate-events */
+    if(voice->channel->synth->event_offset > 0)
+    {
+        UPDATE_RVOICE_I1(fluid_rvoice_set_start_delay, voice->channel->synth->event_offset);
+    }
+
+    /* everything since fluid_voice_init() */
+    fluid_voice_send_param_block(voice);
+
 #ifdef WITH_PROFILING
     voice->ref = fluid_profile_ref();
 #endif
 
     voice->status = FLUID_VOICE_ON;
+    voice->stolen = FALSE;
 
     /* Increment voice count */
     voice->channel->synth->active_voice_count++;
+
+    fluid_voice_update_overflow_prio(voice);
 }
 
 /**
@@ -788,6 +953,7 @@ fluid_voice_update_param(fluid_voice_t *voice, int gen)
          * OHPiano.SF2 sets initial attenuation to a whooping -96 dB */
         fluid_clip(voice->attenuation, 0.f, 1440.f);
         UPDATE_RVOICE_R1(fluid_rvoice_set_attenuation, voice->attenuation);
+        fluid_voice_update_overflow_prio(voice);
         break;
 
     /* The pitch is calculated from three different generators.
@@ -1221,14 +1387,11 @@ int fluid_voice_modulate(fluid_voice_t *voice, int cc, int ctrl)
             {
                 modval = 0.0;
 
-                /* step 2: for every attached modulator, calculate the modulation
-                 * value for the generator gen */
-                for(k = 0; k < voice->mod_count; k++)
+                /* step 2: for every modulator attached to the generator gen,
+                 * calculate the modulation value */
+                for(k = voice->mod_dest_first[gen]; k < FLUID_NUM_MOD; k = voice->mod_dest_next[k])
                 {
-                    if(fluid_mod_has_dest(&voice->mod[k], gen))
-                    {
-                        modval += fluid_mod_get_value(&voice->mod[k], voice);
-                    }
+                    modval += fluid_mod_get_value(&voice->mod[k], voice);
                 }
 
                 fluid_gen_set_mod(&voice->gen[gen], modval);
@@ -1259,33 +1422,49 @@ int fluid_voice_modulate_all(fluid_voice_t *voice)
 
 /* legato update functions --------------------------------------------------*/
 
-/* Updates voice portamento parameters
+/* Calculates voice portamento parameters
  *
  * @voice voice the synthesis voice
  * @fromkey the beginning pitch of portamento.
  * @tokey the ending pitch of portamento.
- *
- * The function calculates pitch offset and increment, then these parameters
- * are send to the dsp.
+ * @countinc returns the increment count number.
+ * @return the pitch offset to apply to the voice dsp.
 */
-void fluid_voice_update_portamento(fluid_voice_t *voice, int fromkey, int tokey)
-
+static fluid_real_t
+fluid_voice_calculate_portamento(fluid_voice_t *voice, int fromkey, int tokey,
+                                 unsigned int *countinc)
 {
     fluid_channel_t *channel = voice->channel;
 
     /* calculates pitch offset */
     fluid_real_t PitchBeg = fluid_voice_calculate_pitch(voice, fromkey);
     fluid_real_t PitchEnd = fluid_voice_calculate_pitch(voice, tokey);
-    fluid_real_t pitchoffset = PitchBeg - PitchEnd;
-    unsigned int countinc;
     enum fluid_portamento_time_mode tm = channel->synth->portamento_time_mode;
 
     /* Calculates increment countinc */
     /* Increment is function of PortamentoTime (ms)*/
     fluid_real_t ms = fluid_channel_portamentotime_with_mode(channel, tm, channel->synth->portamento_time_has_seen_lsb, fromkey, tokey);
 
-    countinc = (unsigned int)(((fluid_real_t)voice->output_rate * 0.001f * ms) /
-                                            (fluid_real_t)FLUID_BUFSIZE + 0.5f);
+    *countinc = (unsigned int)(((fluid_real_t)voice->output_rate * 0.001f * ms) /
+                               (fluid_real_t)FLUID_BUFSIZE + 0.5f);
+
+    return PitchBeg - PitchEnd;
+}
+
+/* Updates voice portamento parameters
+ *
+ * @voice voice the synthesis voice
+ * @fromkey the beginning pitch of portamento.
+ * @tokey the ending pitch of portamento.
+ *
+ * The function calculates pitch offset and increment, then these parameters
+ * are send to the dsp.
+*/
+void fluid_voice_update_portamento(fluid_voice_t *voice, int fromkey, int tokey)
+
+{
+    unsigned int countinc;
+    fluid_real_t pitchoffset = fluid_voice_calculate_portamento(voice, fromkey, tokey, &countinc);
 
     /* Send portamento parameters to the voice dsp */
     UPDATE_RVOICE_GENERIC_IR(fluid_rvoice_set_portamento, voice->rvoice, countinc, pitchoffset);
@@ -1304,7 +1483,9 @@ void fluid_voice_update_portamento(fluid_voice_t *voice, int fromkey, int tokey)
 void fluid_voice_update_multi_retrigger_attack(fluid_voice_t *voice,
         int tokey, int vel)
 {
+    fluid_voice_unlink(voice);
     voice->key = tokey;  /* new note */
+    fluid_synth_link_voice_LOCAL(voice->channel->synth, voice);
     voice->vel = vel; /* new velocity */
     /* Updates generators dependent of velocity */
     /* Modulates GEN_ATTENUATION (and others ) before calling
@@ -1324,6 +1505,44 @@ void fluid_voice_update_multi_retrigger_attack(fluid_voice_t *voice,
     /* updates adsr generator */
     UPDATE_RVOICE0(fluid_rvoice_multi_retrigger_attack);
 }
+
+/*---------------------------------------------------------------*/
+/*legato mode 2: single_trigger
+ *
+ * Moves the voice to the new key, leaving its envelopes and velocity as they
+ * are. Only the pitch and the portamento are sent to the dsp, in one event.
+ *
+ * @voice voice the synthesis voice
+ * @fromkey the beginning pitch of portamento, or an invalid key without portamento.
+ * @tokey the new key to be applied to this voice.
+ */
+void fluid_voice_update_legato(fluid_voice_t *voice, int fromkey, int tokey)
+{
+    fluid_rvoice_param_t param[MAX_EVENT_PARAMS];
+    unsigned int countinc = 0;
+    fluid_real_t pitchoffset = 0.0f;
+
+    fluid_voice_unlink(voice);
+    voice->key = tokey;  /* new note */
+    fluid_synth_link_voice_LOCAL(voice->channel->synth, voice);
+
+    /* Updates pitch generator, as fluid_voice_update_param(voice, GEN_PITCH) */
+    fluid_voice_calculate_gen_pitch(voice);
+    voice->pitch = (fluid_voice_gen_value(voice, GEN_PITCH)
+                    + 100.0f * fluid_voice_gen_value(voice, GEN_COARSETUNE)
+                    + fluid_voice_gen_value(voice, GEN_FINETUNE));
+
+    if(fluid_channel_is_valid_note(fromkey))
+    {
+        pitchoffset = fluid_voice_calculate_portamento(voice, fromkey, tokey, &countinc);
+    }
+
+    fluid_voice_leave_cache(voice, voice->rvoice);
+    param[0].real = voice->pitch;
+    param[1].i = countinc;
+    param[2].real = pitchoffset;
+    fluid_voice_push(voice, fluid_rvoice_legato, voice->rvoice, param);
+}
 /** end of legato update functions */
 
 /*
@@ -1337,8 +1556,9 @@ void
 fluid_voice_release(fluid_voice_t *voice)
 {
     unsigned int at_tick = fluid_channel_get_min_note_length_ticks(voice->channel);
-    UPDATE_RVOICE_I1(fluid_rvoice_noteoff, at_tick);
+    UPDATE_RVOICE_GENERIC_I2(fluid_rvoice_noteoff, voice->rvoice, at_tick, voice->channel->synth->event_offset);
     voice->has_noteoff = 1; // voice is marked as noteoff occurred
+    fluid_voice_update_overflow_prio(voice);
 }
 
 /*
@@ -1362,11 +1582,13 @@ fluid_voice_noteoff(fluid_voice_t *voice)
     {
         // Sostenuto depressed after note
         voice->status = FLUID_VOICE_HELD_BY_SOSTENUTO;
+        fluid_voice_update_overflow_prio(voice);
     }
     /* Or sustain a note under Sustain pedal */
     else if(fluid_channel_sustained(channel))
     {
         voice->status = FLUID_VOICE_SUSTAINED;
+        fluid_voice_update_overflow_prio(voice);
     }
     /* Or force the voice to release stage */
     else
@@ -1375,6 +1597,71 @@ fluid_voice_noteoff(fluid_voice_t *voice)
     }
 }
 
+/*
+ * Whether two voices started by the same noteon play the two samples of a stereo pair with the
+ * same generators and modulators, apart from the pan, so that a single rvoice can render both
+ * of them, see synth.stereo-voices. The samples must have the same length, loop, rate and
+ * pitch, and not be streamed.
+ */
+int
+fluid_voice_is_stereo_pair(const fluid_voice_t *voice, const fluid_voice_t *other)
+{
+    const fluid_sample_t *a = voice->sample;
+    const fluid_sample_t *b = other->sample;
+    int i;
+
+    if(voice->id != other->id || voice->chan != other->chan || voice->key != other->key
+            || voice->vel != other->vel || a == NULL || b == NULL || a == b)
+    {
+        return FALSE;
+    }
+
+    if(!((a->sampletype & FLUID_SAMPLETYPE_LEFT) && (b->sampletype & FLUID_SAMPLETYPE_RIGHT))
+            && !((a->sampletype & FLUID_SAMPLETYPE_RIGHT) && (b->sampletype & FLUID_SAMPLETYPE_LEFT)))
+    {
+        return FALSE;
+    }
+
+    if(a->end - a->start != b->end - b->start
+            || a->loopstart - a->start != b->loopstart - b->start
+            || a->loopend - a->start != b->loopend - b->start
+            || a->samplerate != b->samplerate || a->origpitch != b->origpitch
+            || a->pitchadj != b->pitchadj || a->stream_preload != 0 || b->stream_preload != 0)
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        if(i == GEN_PAN || i == GEN_SAMPLEID)
+        {
+            continue;
+        }
+
+        if(voice->gen[i].val != other->gen[i].val || voice->gen[i].mod != other->gen[i].mod
+                || voice->gen[i].nrpn != other->gen[i].nrpn)
+        {
+            return FALSE;
+        }
+    }
+
+    if(voice->mod_count != other->mod_count)
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < voice->mod_count; i++)
+    {
+        if(!fluid_mod_test_identity(&voice->mod[i], &other->mod[i])
+                || voice->mod[i].amount != other->mod[i].amount)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
 /*
  * fluid_voice_kill_excl
  *
@@ -1399,9 +1686,11 @@ fluid_voice_kill_excl(fluid_voice_t *voice)
     }
 
     /* Turn off the exclusive class information for this voice,
-       so that it doesn't get killed twice
+       so that it doesn't get killed twice, also when it was set by NRPN
     */
     fluid_voice_gen_set(voice, GEN_EXCLUSIVECLASS, 0);
+    voice->gen[GEN_EXCLUSIVECLASS].mod = 0;
+    voice->gen[GEN_EXCLUSIVECLASS].nrpn = 0;
 
     /* Speed up the volume envelope */
     /* The previously-used value of "-200" was found through listening tests
@@ -1411,7 +1700,7 @@ fluid_voice_kill_excl(fluid_voice_t *voice)
     fluid_voice_update_param(voice, GEN_VOLENVRELEASE);
 
     at_tick = fluid_channel_get_min_note_length_ticks(voice->channel);
-    UPDATE_RVOICE_I1(fluid_rvoice_noteoff, at_tick);
+    UPDATE_RVOICE_GENERIC_I2(fluid_rvoice_noteoff, voice->rvoice, at_tick, voice->channel->synth->event_offset);
 
 
     return FLUID_OK;
@@ -1431,7 +1720,9 @@ void fluid_voice_overflow_rvoice_finished(fluid_voice_t *voice)
 
     /* Decrement the reference count of the sample to indicate
        that this sample isn't owned by the rvoice anymore */
-    fluid_voice_sample_unref(&voice->overflow_sample);
+    fluid_voice_sample_unref(voice, &voice->overflow_sample);
+
+    fluid_voice_update_overflow_prio(voice);
 }
 
 /*
@@ -1457,18 +1748,22 @@ fluid_voice_stop(fluid_voice_t *voice)
 {
     fluid_profile(FLUID_PROF_VOICE_RELEASE, voice->ref, 0, 0);
 
+    fluid_voice_unlink(voice);
     voice->chan = NO_CHANNEL;
 
     /* Decrement the reference count of the sample, to indicate
        that this sample isn't owned by the rvoice anymore.
     */
-    fluid_voice_sample_unref(&voice->sample);
+    fluid_voice_sample_unref(voice, &voice->sample);
+    fluid_voice_release_shared_mods(voice);
 
     voice->status = FLUID_VOICE_OFF;
     voice->has_noteoff = 1;
 
     /* Decrement voice count */
     voice->channel->synth->active_voice_count--;
+
+    fluid_voice_update_overflow_prio(voice);
 }
 
 /**
@@ -1492,6 +1787,34 @@ fluid_voice_add_mod(fluid_voice_t *voice, fluid_mod_t *mod, int mode)
     }
 }
 
+/*
+ * Gives the voice modulators of its own, starting with a copy of the shared ones.
+ */
+static int
+fluid_voice_own_mods(fluid_voice_t *voice)
+{
+    if(voice->own_mod == NULL)
+    {
+        voice->own_mod = FLUID_ARRAY(fluid_mod_t, FLUID_NUM_MOD);
+
+        if(voice->own_mod == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+    }
+
+    if(voice->mod_count > 0)
+    {
+        FLUID_MEMCPY(voice->own_mod, voice->mod, voice->mod_count * sizeof(fluid_mod_t));
+    }
+
+    voice->mod = voice->own_mod;
+    fluid_voice_release_shared_mods(voice);
+
+    return FLUID_OK;
+}
+
 /**
  * Adds a modulator to the voice.
  * local version of fluid_voice_add_mod function. Called at noteon time.
@@ -1510,6 +1833,15 @@ fluid_voice_add_mod_local(fluid_voice_t *voice, fluid_mod_t *mod, int mode, int
 {
     int i;
 
+    /* the modulators are about to change, shared ones are copied first */
+    if(voice->mod != voice->own_mod || voice->own_mod == NULL)
+    {
+        if(fluid_voice_own_mods(voice) != FLUID_OK)
+        {
+            return;
+        }
+    }
+
     /* check_limit_count cannot be above voice->mod_count */
     if(check_limit_count > voice->mod_count)
     {
@@ -1551,6 +1883,16 @@ fluid_voice_add_mod_local(fluid_voice_t *voice, fluid_mod_t *mod, int mode, int
        checking, if the same modulator already exists. */
     if(voice->mod_count < FLUID_NUM_MOD)
     {
+        unsigned char *link = &voice->mod_dest_first[mod->dest];
+
+        /* append it to the modulators of its destination */
+        while(*link < FLUID_NUM_MOD)
+        {
+            link = &voice->mod_dest_next[*link];
+        }
+
+        *link = (unsigned char) voice->mod_count;
+        voice->mod_dest_next[voice->mod_count] = FLUID_NUM_MOD;
         fluid_mod_clone(&voice->mod[voice->mod_count++], mod);
     }
     else
@@ -1559,6 +1901,48 @@ fluid_voice_add_mod_local(fluid_voice_t *voice, fluid_mod_t *mod, int mode, int
     }
 }
 
+/*
+ * Sets the modulators of a voice that has none yet to mods, without copying them.
+ * The voice copies them once a modulator is added to it.
+ */
+void
+fluid_voice_set_shared_mods(fluid_voice_t *voice, fluid_voice_mods_t *mods)
+{
+    fluid_voice_release_shared_mods(voice);
+    fluid_atomic_int_inc(&mods->refcount);
+
+    voice->shared_mods = mods;
+    voice->mod = mods->mod;
+    voice->mod_count = mods->count;
+    FLUID_MEMCPY(voice->mod_dest_first, mods->dest_first, sizeof(voice->mod_dest_first));
+    FLUID_MEMCPY(voice->mod_dest_next, mods->dest_next, sizeof(voice->mod_dest_next));
+}
+
+/*
+ * Links the modulators of mods by destination, the way fluid_voice_add_mod_local()
+ * links those of a voice. mods->count mustn't be above FLUID_NUM_MOD.
+ */
+void
+fluid_voice_mods_link(fluid_voice_mods_t *mods)
+{
+    int i;
+
+    FLUID_MEMSET(mods->dest_first, FLUID_NUM_MOD, sizeof(mods->dest_first));
+
+    for(i = 0; i < mods->count; i++)
+    {
+        unsigned char *link = &mods->dest_first[mods->mod[i].dest];
+
+        while(*link < FLUID_NUM_MOD)
+        {
+            link = &mods->dest_next[*link];
+        }
+
+        *link = (unsigned char) i;
+        mods->dest_next[i] = FLUID_NUM_MOD;
+    }
+}
+
 /**
  * Get the unique ID of the noteon-event.
  *
@@ -1840,6 +2224,23 @@ int fluid_voice_set_param(fluid_voice_t *voice, int gen, fluid_real_t nrpn_value
     return FLUID_OK;
 }
 
+/**
+ * Change the interpolation method of a playing voice.
+ */
+void fluid_voice_set_interp_method(fluid_voice_t *voice, int interp_method)
+{
+    UPDATE_RVOICE_I1(fluid_rvoice_set_interp_method, interp_method);
+}
+
+/**
+ * Tell the rvoice the channel and preset slot its CPU time is accounted to, see synth.cpu-accounting.
+ * Must be called after fluid_voice_init(), which clears them.
+ */
+void fluid_voice_set_perf_slots(fluid_voice_t *voice, int preset_slot)
+{
+    UPDATE_RVOICE_GENERIC_I2(fluid_rvoice_set_perf_slots, voice->rvoice, voice->chan, preset_slot);
+}
+
 int fluid_voice_set_gain(fluid_voice_t *voice, fluid_real_t gain)
 {
     fluid_real_t left, right, reverb, chorus;
@@ -1906,7 +2307,8 @@ fluid_voice_optimize_sample(fluid_sample_t *s)
         /* Scan the loop */
         for(i = s->loopstart; i < s->loopend; i++)
         {
-            int32_t val = fluid_rvoice_get_sample(s->data, s->data24, i);
+            int32_t val = (s->data_compressed != NULL) ? fluid_rvoice_get_sample_compressed(s->data_compressed, i)
+                          : fluid_rvoice_get_sample(s->data, s->data24, i);
 
             if(val > peak_max)
             {
@@ -1956,10 +2358,14 @@ fluid_voice_optimize_sample(fluid_sample_t *s)
     return FLUID_OK;
 }
 
+/*
+ * The part of fluid_voice_get_overflow_prio() that doesn't change while the voice ages.
+ * The synth caches it to find the voice to kill quickly, so any change of the voice
+ * state used here must be followed by fluid_voice_update_overflow_prio().
+ */
 float
-fluid_voice_get_overflow_prio(fluid_voice_t *voice,
-                              fluid_overflow_prio_t *score,
-                              unsigned int cur_time)
+fluid_voice_get_overflow_base_prio(const fluid_voice_t *voice,
+                                   const fluid_overflow_prio_t *score)
 {
     float this_voice_prio = 0;
     int channel;
@@ -1994,21 +2400,6 @@ fluid_voice_get_overflow_prio(fluid_voice_t *voice,
         this_voice_prio += score->sustained;
     }
 
-    /* We are not enthusiastic about releasing voices, which have just been started.
-     * Otherwise hitting a chord may result in killing notes belonging to that very same
-     * chord. So give newer voices a higher score. */
-    if(score->age)
-    {
-        cur_time -= voice->start_time;
-
-        if(cur_time < 1)
-        {
-            cur_time = 1; // Avoid div by zero
-        }
-
-        this_voice_prio += (score->age * voice->output_rate) / cur_time;
-    }
-
     /* take a rough estimate of loudness into account. Louder voices are more important. */
     if(score->volume)
     {
@@ -2039,6 +2430,49 @@ fluid_voice_get_overflow_prio(fluid_voice_t *voice,
     return this_voice_prio;
 }
 
+/*
+ * The age score of a voice that has been playing for 'duration' ticks.
+ *
+ * We are not enthusiastic about releasing voices, which have just been started.
+ * Otherwise hitting a chord may result in killing notes belonging to that very same
+ * chord. So give newer voices a higher score.
+ */
+fluid_real_t
+fluid_voice_get_overflow_age_prio(const fluid_overflow_prio_t *score,
+                                  fluid_real_t output_rate,
+                                  unsigned int duration)
+{
+    if(duration < 1)
+    {
+        duration = 1; // Avoid div by zero
+    }
+
+    return (score->age * output_rate) / duration;
+}
+
+float
+fluid_voice_get_overflow_prio(fluid_voice_t *voice,
+                              fluid_overflow_prio_t *score,
+                              unsigned int cur_time)
+{
+    float this_voice_prio = fluid_voice_get_overflow_base_prio(voice, score);
+
+    if(!voice->can_access_overflow_rvoice)
+    {
+        return this_voice_prio;
+    }
+
+    /* The age score is added last, fluid_overflow_tree_find_kill() relies on the
+     * base priority being a lower bound for non-negative age scores. */
+    if(score->age)
+    {
+        this_voice_prio += fluid_voice_get_overflow_age_prio(score, voice->output_rate,
+                           cur_time - voice->start_time);
+    }
+
+    return this_voice_prio;
+}
+
 
 void fluid_voice_set_custom_filter(fluid_voice_t *voice, enum fluid_iir_filter_type type, enum fluid_iir_filter_flags flags)
 {
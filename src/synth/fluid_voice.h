@@ -32,6 +32,14 @@
 
 #define NO_CHANNEL             0xff
 
+/* Lists of the voices of a synth, see fluid_synth_link_voice_LOCAL() */
+enum fluid_voice_list
+{
+    FLUID_VOICE_LIST_NOTE,      /* voices playing the same key on the same channel */
+    FLUID_VOICE_LIST_CHANNEL,   /* voices playing on the same channel */
+    FLUID_VOICE_LIST_COUNT
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -60,6 +68,22 @@ enum fluid_voice_status
 };
 
 
+typedef struct _fluid_voice_mods_t fluid_voice_mods_t;
+
+/* Modulators merged once and shared by the voices that start with them, see
+ * fluid_voice_set_shared_mods(). Owned by the SoundFont loader, which mustn't change
+ * them while refcount is above 0. */
+struct _fluid_voice_mods_t
+{
+    fluid_atomic_int_t refcount;    /* number of voices using them */
+    int count;
+    int size;                       /* number of modulators mod can hold */
+    fluid_mod_t *mod;
+    unsigned char dest_first[GEN_LAST]; /* as mod_dest_first and mod_dest_next of a voice, */
+    unsigned char dest_next[FLUID_NUM_MOD]; /* see fluid_voice_mods_link() */
+    fluid_voice_mods_t *next;       /* for the loader to keep them in a list */
+};
+
 /*
  * fluid_voice_t
  */
@@ -79,7 +103,14 @@ struct _fluid_voice_t
 
     unsigned int start_time;
     int mod_count;
-    fluid_mod_t mod[FLUID_NUM_MOD];
+    fluid_mod_t *mod;               /* shared_mods->mod, or own_mod once the voice has modulators of its own */
+    fluid_voice_mods_t *shared_mods;
+    fluid_mod_t *own_mod;           /* FLUID_NUM_MOD modulators, allocated the first time they're needed */
+    /* the modulators of each destination generator, in the order of mod[]: mod_dest_first[gen]
+     * is the index of the first one, mod_dest_next[i] the one following mod[i], and
+     * FLUID_NUM_MOD ends the list */
+    unsigned char mod_dest_first[GEN_LAST];
+    unsigned char mod_dest_next[FLUID_NUM_MOD];
     fluid_gen_t gen[GEN_LAST];
 
     /* basic parameters */
@@ -111,6 +142,17 @@ struct _fluid_voice_t
     char can_access_rvoice; /* False if rvoice is being rendered in separate thread */
     char can_access_overflow_rvoice; /* False if overflow_rvoice is being rendered in separate thread */
     char has_noteoff; /* Flag set when noteoff has been sent */
+    char rvoice_cached; /* TRUE if rvoice may use the voice cache and hasn't been changed since it started */
+    char stolen; /* TRUE if the voice has been killed to make room for a new one since it started */
+    int param_block_count; /* number of updates collected in the param block of rvoice until the voice starts, -1 otherwise */
+    unsigned int modulate_stamp; /* modulate_stamp of the synth when the voice started, see fluid_synth_apply_modulations_LOCAL() */
+
+    int index; /* position in the voice array of the synth, see fluid_synth_update_overflow_prio_LOCAL() */
+    int cost; /* estimated cost of rendering a block, counted against the cost budget of the channel */
+
+    /* neighbours in the voice lists of the synth, linked while chan != NO_CHANNEL */
+    fluid_voice_t *list_prev[FLUID_VOICE_LIST_COUNT];
+    fluid_voice_t *list_next[FLUID_VOICE_LIST_COUNT];
 
 #ifdef WITH_PROFILING
     /* for debugging */
@@ -119,7 +161,8 @@ struct _fluid_voice_t
 };
 
 
-fluid_voice_t *new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate, fluid_iir_sincos_t *sincos_table);
+fluid_voice_t *new_fluid_voice(fluid_rvoice_eventhandler_t *handler, fluid_real_t output_rate, fluid_iir_sincos_t *sincos_table,
+                               fluid_rvoice_stream_t *stream);
 void delete_fluid_voice(fluid_voice_t *voice);
 
 void fluid_voice_start(fluid_voice_t *voice);
@@ -141,6 +184,8 @@ int fluid_voice_set_param(fluid_voice_t *voice, int gen, fluid_real_t value);
 int fluid_voice_set_gain(fluid_voice_t *voice, fluid_real_t gain);
 
 void fluid_voice_set_output_rate(fluid_voice_t *voice, fluid_real_t value);
+void fluid_voice_set_perf_slots(fluid_voice_t *voice, int preset_slot);
+void fluid_voice_set_interp_method(fluid_voice_t *voice, int interp_method);
 
 
 /** Update all the synthesis parameters, which depend on generator
@@ -154,6 +199,8 @@ void fluid_voice_update_param(fluid_voice_t *voice, int gen);
 void fluid_voice_update_multi_retrigger_attack(fluid_voice_t *voice, int tokey, int vel);
 /* Update portamento parameter */
 void fluid_voice_update_portamento(fluid_voice_t *voice, int fromkey, int tokey);
+/* moves the voice to another key for legato mode single_trigger: 2 */
+void fluid_voice_update_legato(fluid_voice_t *voice, int fromkey, int tokey);
 
 
 void fluid_voice_release(fluid_voice_t *voice);
@@ -161,12 +208,19 @@ void fluid_voice_noteoff(fluid_voice_t *voice);
 void fluid_voice_off(fluid_voice_t *voice);
 void fluid_voice_stop(fluid_voice_t *voice);
 void fluid_voice_add_mod_local(fluid_voice_t *voice, fluid_mod_t *mod, int mode, int check_limit_count);
+void fluid_voice_set_shared_mods(fluid_voice_t *voice, fluid_voice_mods_t *mods);
+void fluid_voice_mods_link(fluid_voice_mods_t *mods);
 void fluid_voice_overflow_rvoice_finished(fluid_voice_t *voice);
 
 int fluid_voice_kill_excl(fluid_voice_t *voice);
+int fluid_voice_is_stereo_pair(const fluid_voice_t *voice, const fluid_voice_t *other);
 float fluid_voice_get_overflow_prio(fluid_voice_t *voice,
                                     fluid_overflow_prio_t *score,
                                     unsigned int cur_time);
+float fluid_voice_get_overflow_base_prio(const fluid_voice_t *voice,
+        const fluid_overflow_prio_t *score);
+fluid_real_t fluid_voice_get_overflow_age_prio(const fluid_overflow_prio_t *score,
+        fluid_real_t output_rate, unsigned int duration);
 
 #define OVERFLOW_PRIO_CANNOT_KILL 999999.
 
@@ -0,0 +1,190 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_arena.h"
+
+/* Alignment of all allocations, enough for any of the structures allocated */
+#define FLUID_ARENA_ALIGN 16
+#define FLUID_ARENA_ROUND(_size) (((_size) + FLUID_ARENA_ALIGN - 1) & ~(size_t)(FLUID_ARENA_ALIGN - 1))
+
+typedef struct _fluid_arena_block_t fluid_arena_block_t;
+
+struct _fluid_arena_block_t
+{
+    fluid_arena_block_t *next;
+    size_t size;        /* usable size of the block */
+    size_t used;
+};
+
+/* the usable memory of a block follows its header */
+#define FLUID_ARENA_HEADER_SIZE FLUID_ARENA_ROUND(sizeof(fluid_arena_block_t))
+
+struct _fluid_arena_t
+{
+    fluid_mutex_t mutex;
+    size_t block_size;
+    fluid_arena_block_t *blocks;    /* the most recent block first, the one being filled */
+    size_t total;                   /* size of all blocks */
+};
+
+/*
+ * Creates an arena allocating blocks of the given size, allocations larger
+ * than a quarter of it get a block of their own.
+ */
+fluid_arena_t *new_fluid_arena(size_t block_size)
+{
+    fluid_arena_t *arena = FLUID_NEW(fluid_arena_t);
+
+    if(arena == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(arena, 0, sizeof(*arena));
+    arena->block_size = FLUID_ARENA_ROUND(block_size);
+    fluid_mutex_init(arena->mutex);
+
+    return arena;
+}
+
+void delete_fluid_arena(fluid_arena_t *arena)
+{
+    fluid_return_if_fail(arena != NULL);
+
+    fluid_arena_clear(arena);
+    fluid_mutex_destroy(arena->mutex);
+    FLUID_FREE(arena);
+}
+
+/*
+ * Frees everything allocated from the arena.
+ */
+void fluid_arena_clear(fluid_arena_t *arena)
+{
+    fluid_arena_block_t *block;
+
+    while(arena->blocks != NULL)
+    {
+        block = arena->blocks;
+        arena->blocks = block->next;
+        FLUID_FREE(block);
+    }
+
+    arena->total = 0;
+}
+
+/*
+ * Allocates zeroed memory living as long as the arena.
+ * @return NULL if out of memory
+ */
+void *fluid_arena_alloc(fluid_arena_t *arena, size_t size)
+{
+    fluid_arena_block_t *block;
+    size_t block_size;
+    void *ptr;
+
+    size = FLUID_ARENA_ROUND(size > 0 ? size : 1);
+
+    fluid_mutex_lock(arena->mutex);
+    block = arena->blocks;
+
+    if(block == NULL || block->size - block->used < size)
+    {
+        block_size = (size > arena->block_size / 4) ? size : arena->block_size;
+        block = FLUID_MALLOC(FLUID_ARENA_HEADER_SIZE + block_size);
+
+        if(block == NULL)
+        {
+            fluid_mutex_unlock(arena->mutex);
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return NULL;
+        }
+
+        block->size = block_size;
+        block->used = 0;
+        arena->total += block_size;
+
+        /* a block of its own for a large allocation doesn't replace the block being filled */
+        if(block_size == size && arena->blocks != NULL)
+        {
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        }
+        else
+        {
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+    }
+
+    ptr = (char *)block + FLUID_ARENA_HEADER_SIZE + block->used;
+    block->used += size;
+    fluid_mutex_unlock(arena->mutex);
+
+    FLUID_MEMSET(ptr, 0, size);
+    return ptr;
+}
+
+char *fluid_arena_strdup(fluid_arena_t *arena, const char *str)
+{
+    size_t size = FLUID_STRLEN(str) + 1;
+    char *copy = fluid_arena_alloc(arena, size);
+
+    if(copy != NULL)
+    {
+        FLUID_MEMCPY(copy, str, size);
+    }
+
+    return copy;
+}
+
+/*
+ * Like fluid_list_prepend(), with the new list node allocated from the arena.
+ * Such nodes must never be freed by delete_fluid_list() or fluid_list_remove(),
+ * use fluid_list_remove_link() to unlink them.
+ * @return the new list, NULL if out of memory
+ */
+fluid_list_t *fluid_arena_list_prepend(fluid_arena_t *arena, fluid_list_t *list, void *data)
+{
+    fluid_list_t *node = FLUID_ARENA_NEW(arena, fluid_list_t);
+
+    if(node == NULL)
+    {
+        return NULL;
+    }
+
+    node->data = data;
+    node->next = list;
+    return node;
+}
+
+/*
+ * Returns the memory allocated by the arena in bytes.
+ */
+size_t fluid_arena_get_size(fluid_arena_t *arena)
+{
+    size_t total;
+
+    fluid_mutex_lock(arena->mutex);
+    total = arena->total;
+    fluid_mutex_unlock(arena->mutex);
+
+    return total;
+}
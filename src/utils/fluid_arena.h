@@ -0,0 +1,56 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLUID_ARENA_H
+#define _FLUID_ARENA_H
+
+#include "fluid_sys.h"
+#include "fluid_list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Arena allocator.
+ *
+ * Hands out memory from large blocks, which are only freed all at once when
+ * the arena is deleted or cleared. Used for the many small structures that
+ * live exactly as long as the SoundFont they have been loaded from. Memory
+ * returned by the arena is zeroed and must never be passed to FLUID_FREE().
+ * Allocating is thread safe.
+ */
+typedef struct _fluid_arena_t fluid_arena_t;
+
+fluid_arena_t *new_fluid_arena(size_t block_size);
+void delete_fluid_arena(fluid_arena_t *arena);
+void fluid_arena_clear(fluid_arena_t *arena);
+
+void *fluid_arena_alloc(fluid_arena_t *arena, size_t size);
+char *fluid_arena_strdup(fluid_arena_t *arena, const char *str);
+fluid_list_t *fluid_arena_list_prepend(fluid_arena_t *arena, fluid_list_t *list, void *data);
+size_t fluid_arena_get_size(fluid_arena_t *arena);
+
+#define FLUID_ARENA_NEW(_arena, _t)  ((_t *)fluid_arena_alloc(_arena, sizeof(_t)))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_ARENA_H */
@@ -24,6 +24,9 @@
  *
  * Adapted for FluidSynth use by Josh Green <jgreen@users.sourceforge.net>
  * September 8, 2009 from glib 2.18.4
+ *
+ * The chained nodes have since been replaced by open addressing with
+ * Robin Hood hashing, the interface is unchanged.
  */
 
 /*
@@ -35,119 +38,63 @@
 #include "fluid_list.h"
 
 
-#define HASH_TABLE_MIN_SIZE 11
-#define HASH_TABLE_MAX_SIZE 13845163
+#define HASH_TABLE_MIN_BITS 4
+#define HASH_TABLE_MIN_SIZE (1 << HASH_TABLE_MIN_BITS)
+#define HASH_TABLE_MAX_SIZE (1 << 24)
 
 
 typedef struct
 {
     fluid_hashtable_t *hashtable;
-    fluid_hashnode_t *prev_node;
-    fluid_hashnode_t *node;
-    int position;
+    int start;          /* empty slot the iteration starts after */
+    int position;       /* slots visited after start */
     int pre_advanced;	// Boolean
-    int version;
 } RealIter;
 
 
-/* Excerpt from glib gprimes.c */
-
-static const unsigned int primes[] =
-{
-    11,
-    19,
-    37,
-    73,
-    109,
-    163,
-    251,
-    367,
-    557,
-    823,
-    1237,
-    1861,
-    2777,
-    4177,
-    6247,
-    9371,
-    14057,
-    21089,
-    31627,
-    47431,
-    71143,
-    106721,
-    160073,
-    240101,
-    360163,
-    540217,
-    810343,
-    1215497,
-    1823231,
-    2734867,
-    4102283,
-    6153409,
-    9230113,
-    13845163,
-};
-
-static const unsigned int nprimes = FLUID_N_ELEMENTS(primes);
-
-static unsigned int
-spaced_primes_closest(unsigned int num)
+/*
+ * Returns the slot a key hash is ideally stored at. The multiplication (Fibonacci hashing)
+ * spreads hashes that only differ in their high bits, like aligned pointers, over all slots.
+ */
+static FLUID_INLINE int
+fluid_hashtable_home(const fluid_hashtable_t *hashtable, unsigned int key_hash)
 {
-    unsigned int i;
-
-    for(i = 0; i < nprimes; i++)
-    {
-        if(primes[i] > num)
-        {
-            return primes[i];
-        }
-    }
-
-    return primes[nprimes - 1];
+    return (int)(((uint32_t)key_hash * 2654435769u) >> hashtable->shift);
 }
 
-/* End excerpt from glib gprimes.c */
-
 
 /*
  * @hashtable: our #fluid_hashtable_t
  * @key: the key to lookup against
  * @hash_return: optional key hash return location
- * Return value: a pointer to the described #fluid_hashnode_t pointer
+ * Return value: the slot holding @key, or %NULL if it isn't in the table
  *
  * Performs a lookup in the hash table.  Virtually all hash operations
  * will use this function internally.
  *
- * This function first computes the hash value of the key using the
- * user's hash function.
- *
- * If an entry in the table matching @key is found then this function
- * returns a pointer to the pointer to that entry in the table.  In
- * the case that the entry is at the head of a chain, this pointer
- * will be an item in the nodes[] array.  In the case that the entry
- * is not at the head of a chain, this pointer will be the ->next
- * pointer on the node that precedes it.
- *
- * In the case that no matching entry exists in the table, a pointer
- * to a %NULL pointer will be returned.  To insert a item, this %NULL
- * pointer should be updated to point to the new #fluid_hashnode_t.
- *
- * If @hash_return is a pass-by-reference parameter.  If it is
- * non-%NULL then the computed hash value is returned.  This is to
- * save insertions from having to compute the hash record again for
- * the new record.
+ * The table is a single array of slots, keys colliding with others are
+ * stored in the following slots (linear probing).  Every slot knows how
+ * far its entry is from the home slot of its key (dist is 1 in the home
+ * slot, 0 marks an empty slot).  Insertions keep the entries of a run of
+ * slots ordered by their home slot (Robin Hood hashing), so a lookup can
+ * stop at the first slot whose entry is nearer to its home than @key
+ * would be.  There is always at least one empty slot.
+ *
+ * If @hash_return is non-%NULL then the computed hash value is returned.
+ * This is to save insertions from having to compute the hash record
+ * again for the new record.
  */
-static FLUID_INLINE fluid_hashnode_t **
+static FLUID_INLINE fluid_hashnode_t *
 fluid_hashtable_lookup_node(fluid_hashtable_t *hashtable, const void *key,
                             unsigned int *hash_return)
 {
-    fluid_hashnode_t **node_ptr, *node;
-    unsigned int hash_value;
+    fluid_hashnode_t *node;
+    unsigned int hash_value, dist;
+    int mask = hashtable->size - 1;
+    int i;
 
     hash_value = (* hashtable->hash_func)(key);
-    node_ptr = &hashtable->nodes[hash_value % hashtable->size];
+    i = fluid_hashtable_home(hashtable, hash_value);
 
     if(hash_return)
     {
@@ -165,86 +112,92 @@ fluid_hashtable_lookup_node(fluid_hashtable_t *hashtable, const void *key,
      */
     if(hashtable->key_equal_func)
     {
-        while((node = *node_ptr))
+        for(dist = 1;; dist++, i = (i + 1) & mask)
         {
+            node = &hashtable->nodes[i];
+
+            if(node->dist < dist)
+            {
+                return NULL;
+            }
+
             if(node->key_hash == hash_value &&
                     hashtable->key_equal_func(node->key, key))
             {
-                break;
+                return node;
             }
-
-            node_ptr = &(*node_ptr)->next;
         }
     }
     else
     {
-        while((node = *node_ptr))
+        for(dist = 1;; dist++, i = (i + 1) & mask)
         {
-            if(node->key == key)
+            node = &hashtable->nodes[i];
+
+            if(node->dist < dist)
             {
-                break;
+                return NULL;
             }
 
-            node_ptr = &(*node_ptr)->next;
+            if(node->key == key)
+            {
+                return node;
+            }
         }
     }
-
-    return node_ptr;
 }
 
 /*
  * @hashtable: our #fluid_hashtable_t
- * @node_ptr_ptr: a pointer to the return value from
- *   fluid_hashtable_lookup_node()
+ * @node: the slot to empty
  * @notify: %TRUE if the destroy notify handlers are to be called
  *
- * Removes a node from the hash table and updates the node count.  The
- * node is freed.  No table resize is performed.
+ * Removes the entry of a slot from the hash table and updates the node
+ * count.  No table resize is performed.
  *
- * If @notify is %TRUE then the destroy notify functions are called
- * for the key and value of the hash node.
+ * The entries following in the run that aren't in their home slot are
+ * moved back by one slot (backward shift deletion), so that lookups
+ * never have to skip deleted slots.  Afterwards, @node holds the next
+ * entry of the run or is empty, which makes this function convenient to
+ * use from functions that iterate over the table.
  *
- * @node_ptr_ptr is a pass-by-reference in/out parameter.  When the
- * function is called, it should point to the pointer to the node to
- * remove.  This level of indirection is required so that the pointer
- * may be updated appropriately once the node has been removed.
- *
- * Before the function returns, the pointer at @node_ptr_ptr will be
- * updated to point to the position in the table that contains the
- * pointer to the "next" node in the chain.  This makes this function
- * convenient to use from functions that iterate over the entire
- * table.  If there is no further item in the chain then the
- * #fluid_hashnode_t pointer will be %NULL (ie: **node_ptr_ptr == %NULL).
- *
- * Since the pointer in the table to the removed node is replaced with
- * either a pointer to the next node or a %NULL pointer as
- * appropriate, the pointer at the end of @node_ptr_ptr will never be
- * modified at all.  Stay tuned. :)
+ * If @notify is %TRUE then the destroy notify functions are called
+ * for the key and value of the entry, once it has been removed.
  */
 static void
 fluid_hashtable_remove_node(fluid_hashtable_t *hashtable,
-                            fluid_hashnode_t  ***node_ptr_ptr, int notify)
+                            fluid_hashnode_t *node, int notify)
 {
-    fluid_hashnode_t **node_ptr, *node;
+    fluid_hashnode_t *next, *end = hashtable->nodes + hashtable->size;
+    void *key = node->key;
+    void *value = node->value;
+
+    for(;;)
+    {
+        next = (node + 1 == end) ? hashtable->nodes : node + 1;
+
+        if(next->dist <= 1)
+        {
+            break;
+        }
 
-    node_ptr = *node_ptr_ptr;
-    node = *node_ptr;
+        *node = *next;
+        node->dist--;
+        node = next;
+    }
 
-    *node_ptr = node->next;
+    node->dist = 0;
+    hashtable->nnodes--;
 
     if(notify && hashtable->key_destroy_func)
     {
-        hashtable->key_destroy_func(node->key);
+        hashtable->key_destroy_func(key);
     }
 
     if(notify && hashtable->value_destroy_func)
     {
-        hashtable->value_destroy_func(node->value);
+        hashtable->value_destroy_func(value);
     }
-
-    FLUID_FREE(node);
-
-    hashtable->nnodes--;
 }
 
 /*
@@ -261,44 +214,99 @@ fluid_hashtable_remove_node(fluid_hashtable_t *hashtable,
 static void
 fluid_hashtable_remove_all_nodes(fluid_hashtable_t *hashtable, int notify)
 {
-    fluid_hashnode_t **node_ptr;
+    fluid_hashnode_t *node;
     int i;
 
     for(i = 0; i < hashtable->size; i++)
     {
-        for(node_ptr = &hashtable->nodes[i]; *node_ptr != NULL;)
+        node = &hashtable->nodes[i];
+
+        if(node->dist == 0)
         {
-            fluid_hashtable_remove_node(hashtable, &node_ptr, notify);
+            continue;
+        }
+
+        node->dist = 0;
+
+        if(notify && hashtable->key_destroy_func)
+        {
+            hashtable->key_destroy_func(node->key);
+        }
+
+        if(notify && hashtable->value_destroy_func)
+        {
+            hashtable->value_destroy_func(node->value);
         }
     }
 
     hashtable->nnodes = 0;
 }
 
+/*
+ * @hashtable: our #fluid_hashtable_t
+ * @entry: the entry to store, its key must not be in the table yet
+ *
+ * Stores an entry in a table with at least one more free slot.  Walking
+ * from the home slot of its key, the entry takes the slot of the first
+ * entry that is nearer to its own home slot, which then continues the
+ * walk in its place.
+ */
+static void
+fluid_hashtable_place_node(fluid_hashtable_t *hashtable, fluid_hashnode_t entry)
+{
+    fluid_hashnode_t *node, tmp;
+    int mask = hashtable->size - 1;
+    int i = fluid_hashtable_home(hashtable, entry.key_hash);
+
+    for(entry.dist = 1;; entry.dist++, i = (i + 1) & mask)
+    {
+        node = &hashtable->nodes[i];
+
+        if(node->dist == 0)
+        {
+            *node = entry;
+            return;
+        }
+
+        if(node->dist < entry.dist)
+        {
+            tmp = *node;
+            *node = entry;
+            entry = tmp;
+        }
+    }
+}
+
 /*
  * fluid_hashtable_resize:
  * @hashtable: our #fluid_hashtable_t
  *
  * Resizes the hash table to the optimal size based on the number of
- * nodes currently held.  If you call this function then a resize will
- * occur, even if one does not need to occur.  Use
+ * nodes currently held, which leaves it at most half full.  Use
  * fluid_hashtable_maybe_resize() instead.
  */
 static void
 fluid_hashtable_resize(fluid_hashtable_t *hashtable)
 {
-    fluid_hashnode_t **new_nodes;
-    fluid_hashnode_t *node;
-    fluid_hashnode_t *next;
-    unsigned int hash_val;
-    int new_size;
+    fluid_hashnode_t *old_nodes = hashtable->nodes;
+    fluid_hashnode_t *new_nodes;
+    int old_size = hashtable->size;
+    int new_size = HASH_TABLE_MIN_SIZE;
+    int new_shift = 32 - HASH_TABLE_MIN_BITS;
     int i;
 
-    new_size = spaced_primes_closest(hashtable->nnodes);
-    new_size = (new_size < HASH_TABLE_MIN_SIZE) ? HASH_TABLE_MIN_SIZE :
-               ((new_size > HASH_TABLE_MAX_SIZE) ? HASH_TABLE_MAX_SIZE : new_size);
+    while(new_size < 2 * hashtable->nnodes && new_size < HASH_TABLE_MAX_SIZE)
+    {
+        new_size <<= 1;
+        new_shift--;
+    }
+
+    if(new_size == old_size)
+    {
+        return;
+    }
 
-    new_nodes = FLUID_ARRAY(fluid_hashnode_t *, new_size);
+    new_nodes = FLUID_ARRAY(fluid_hashnode_t, new_size);
 
     if(!new_nodes)
     {
@@ -306,24 +314,21 @@ fluid_hashtable_resize(fluid_hashtable_t *hashtable)
         return;
     }
 
-    FLUID_MEMSET(new_nodes, 0, new_size * sizeof(fluid_hashnode_t *));
+    FLUID_MEMSET(new_nodes, 0, new_size * sizeof(fluid_hashnode_t));
 
-    for(i = 0; i < hashtable->size; i++)
+    hashtable->nodes = new_nodes;
+    hashtable->size = new_size;
+    hashtable->shift = new_shift;
+
+    for(i = 0; i < old_size; i++)
     {
-        for(node = hashtable->nodes[i]; node; node = next)
+        if(old_nodes[i].dist != 0)
         {
-            next = node->next;
-
-            hash_val = node->key_hash % new_size;
-
-            node->next = new_nodes[hash_val];
-            new_nodes[hash_val] = node;
+            fluid_hashtable_place_node(hashtable, old_nodes[i]);
         }
     }
 
-    FLUID_FREE(hashtable->nodes);
-    hashtable->nodes = new_nodes;
-    hashtable->size = new_size;
+    FLUID_FREE(old_nodes);
 }
 
 /*
@@ -332,8 +337,9 @@ fluid_hashtable_resize(fluid_hashtable_t *hashtable)
  *
  * Resizes the hash table, if needed.
  *
- * Essentially, calls fluid_hashtable_resize() if the table has strayed
- * too far from its ideal size for its number of nodes.
+ * Essentially, calls fluid_hashtable_resize() if the table is more than
+ * three quarters or less than an eighth full.  Runs of slots get long
+ * quickly beyond three quarters.
  */
 static FLUID_INLINE void
 fluid_hashtable_maybe_resize(fluid_hashtable_t *hashtable)
@@ -341,13 +347,32 @@ fluid_hashtable_maybe_resize(fluid_hashtable_t *hashtable)
     int nnodes = hashtable->nnodes;
     int size = hashtable->size;
 
-    if((size >= 3 * nnodes && size > HASH_TABLE_MIN_SIZE) ||
-            (3 * size <= nnodes && size < HASH_TABLE_MAX_SIZE))
+    if((8 * nnodes < size && size > HASH_TABLE_MIN_SIZE) ||
+            (4 * nnodes > 3 * size && size < HASH_TABLE_MAX_SIZE))
     {
         fluid_hashtable_resize(hashtable);
     }
 }
 
+/*
+ * Returns an empty slot of the table.  Entries are only ever moved back
+ * to the previous slot by a removal, and never across an empty slot, so
+ * iterations starting after an empty slot never miss or repeat an entry
+ * when entries are removed on the way.
+ */
+static int
+fluid_hashtable_first_empty(const fluid_hashtable_t *hashtable)
+{
+    int i = 0;
+
+    while(hashtable->nodes[i].dist != 0)
+    {
+        i++;
+    }
+
+    return i;
+}
+
 /**
  * new_fluid_hashtable:
  * @hash_func: a function to create a hash value from a key.
@@ -407,16 +432,17 @@ new_fluid_hashtable_full(fluid_hash_func_t hash_func,
     }
 
     hashtable->size               = HASH_TABLE_MIN_SIZE;
+    hashtable->shift              = 32 - HASH_TABLE_MIN_BITS;
     hashtable->nnodes             = 0;
     hashtable->hash_func          = hash_func ? hash_func : fluid_direct_hash;
     hashtable->key_equal_func     = key_equal_func;
     fluid_atomic_int_set(&hashtable->ref_count, 1);
     hashtable->key_destroy_func   = key_destroy_func;
     hashtable->value_destroy_func = value_destroy_func;
-    hashtable->nodes              = FLUID_ARRAY(fluid_hashnode_t *, hashtable->size);
+    hashtable->nodes              = FLUID_ARRAY(fluid_hashnode_t, hashtable->size);
     if(hashtable->nodes == NULL)
     {
-        delete_fluid_hashtable(hashtable);
+        FLUID_FREE(hashtable);
         FLUID_LOG(FLUID_ERR, "Out of memory");
         return NULL;
     }
@@ -456,9 +482,8 @@ fluid_hashtable_iter_init(fluid_hashtable_iter_t *iter,
     fluid_return_if_fail(hashtable != NULL);
 
     ri->hashtable = hashtable;
-    ri->prev_node = NULL;
-    ri->node = NULL;
-    ri->position = -1;
+    ri->start = fluid_hashtable_first_empty(hashtable);
+    ri->position = 0;
     ri->pre_advanced = FALSE;
 }
 
@@ -481,48 +506,44 @@ fluid_hashtable_iter_next(fluid_hashtable_iter_t *iter, void **key,
                           void **value)
 {
     RealIter *ri = (RealIter *) iter;
+    fluid_hashtable_t *hashtable;
+    fluid_hashnode_t *node = NULL;
 
     fluid_return_val_if_fail(iter != NULL, FALSE);
 
-    if(ri->pre_advanced)
-    {
-        ri->pre_advanced = FALSE;
+    hashtable = ri->hashtable;
 
-        if(ri->node == NULL)
-        {
-            return FALSE;
-        }
-    }
-    else
+    /* after a removal, the slot holds the next entry of the run */
+    if(!ri->pre_advanced)
     {
-        if(ri->node != NULL)
-        {
-            ri->prev_node = ri->node;
-            ri->node = ri->node->next;
-        }
+        ri->position++;
+    }
 
-        while(ri->node == NULL)
-        {
-            ri->position++;
+    ri->pre_advanced = FALSE;
 
-            if(ri->position >= ri->hashtable->size)
-            {
-                return FALSE;
-            }
+    for(; ri->position < hashtable->size; ri->position++)
+    {
+        node = &hashtable->nodes[(ri->start + ri->position) & (hashtable->size - 1)];
 
-            ri->prev_node = NULL;
-            ri->node = ri->hashtable->nodes[ri->position];
+        if(node->dist != 0)
+        {
+            break;
         }
     }
 
+    if(ri->position >= hashtable->size)
+    {
+        return FALSE;
+    }
+
     if(key != NULL)
     {
-        *key = ri->node->key;
+        *key = node->key;
     }
 
     if(value != NULL)
     {
-        *value = ri->node->value;
+        *value = node->value;
     }
 
     return TRUE;
@@ -549,64 +570,19 @@ fluid_hashtable_iter_get_hash_table(fluid_hashtable_iter_t *iter)
 static void
 iter_remove_or_steal(RealIter *ri, int notify)
 {
-    fluid_hashnode_t *prev;
-    fluid_hashnode_t *node;
-    int position;
+    fluid_hashtable_t *hashtable;
 
     fluid_return_if_fail(ri != NULL);
-    fluid_return_if_fail(ri->node != NULL);
-
-    prev = ri->prev_node;
-    node = ri->node;
-    position = ri->position;
-
-    /* pre-advance the iterator since we will remove the node */
-
-    ri->node = ri->node->next;
-    /* ri->prev_node is still the correct previous node */
-
-    while(ri->node == NULL)
-    {
-        ri->position++;
+    fluid_return_if_fail(!ri->pre_advanced);
+    fluid_return_if_fail(ri->position > 0 && ri->position < ri->hashtable->size);
 
-        if(ri->position >= ri->hashtable->size)
-        {
-            break;
-        }
+    hashtable = ri->hashtable;
 
-        ri->prev_node = NULL;
-        ri->node = ri->hashtable->nodes[ri->position];
-    }
+    fluid_hashtable_remove_node(hashtable,
+                                &hashtable->nodes[(ri->start + ri->position) & (hashtable->size - 1)],
+                                notify);
 
     ri->pre_advanced = TRUE;
-
-    /* remove the node */
-
-    if(prev != NULL)
-    {
-        prev->next = node->next;
-    }
-    else
-    {
-        ri->hashtable->nodes[position] = node->next;
-    }
-
-    if(notify)
-    {
-        if(ri->hashtable->key_destroy_func)
-        {
-            ri->hashtable->key_destroy_func(node->key);
-        }
-
-        if(ri->hashtable->value_destroy_func)
-        {
-            ri->hashtable->value_destroy_func(node->value);
-        }
-    }
-
-    FLUID_FREE(node);
-
-    ri->hashtable->nnodes--;
 }
 
 /**
@@ -736,7 +712,7 @@ fluid_hashtable_lookup(fluid_hashtable_t *hashtable, const void *key)
 
     fluid_return_val_if_fail(hashtable != NULL, NULL);
 
-    node = *fluid_hashtable_lookup_node(hashtable, key, NULL);
+    node = fluid_hashtable_lookup_node(hashtable, key, NULL);
 
     return node ? node->value : NULL;
 }
@@ -764,7 +740,7 @@ fluid_hashtable_lookup_extended(fluid_hashtable_t *hashtable,
 
     fluid_return_val_if_fail(hashtable != NULL, FALSE);
 
-    node = *fluid_hashtable_lookup_node(hashtable, lookup_key, NULL);
+    node = fluid_hashtable_lookup_node(hashtable, lookup_key, NULL);
 
     if(node == NULL)
     {
@@ -797,22 +773,22 @@ fluid_hashtable_lookup_extended(fluid_hashtable_t *hashtable,
  * fluid_hashtable_replace() functions.
  *
  * Do a lookup of @key.  If it is found, replace it with the new
- * @value (and perhaps the new @key).  If it is not found, create a
- * new node.
+ * @value (and perhaps the new @key).  If it is not found, store it in
+ * a free slot.
  */
 static void
 fluid_hashtable_insert_internal(fluid_hashtable_t *hashtable, void *key,
                                 void *value, int keep_new_key)
 {
-    fluid_hashnode_t **node_ptr, *node;
+    fluid_hashnode_t *node, entry;
     unsigned int key_hash;
 
     fluid_return_if_fail(hashtable != NULL);
     fluid_return_if_fail(fluid_atomic_int_get(&hashtable->ref_count) > 0);
 
-    node_ptr = fluid_hashtable_lookup_node(hashtable, key, &key_hash);
+    node = fluid_hashtable_lookup_node(hashtable, key, &key_hash);
 
-    if((node = *node_ptr))
+    if(node)
     {
         if(keep_new_key)
         {
@@ -840,22 +816,21 @@ fluid_hashtable_insert_internal(fluid_hashtable_t *hashtable, void *key,
     }
     else
     {
-        node = FLUID_NEW(fluid_hashnode_t);
+        hashtable->nnodes++;
+        fluid_hashtable_maybe_resize(hashtable);
 
-        if(!node)
+        /* one slot must stay empty for the lookups to end */
+        if(hashtable->nnodes >= hashtable->size)
         {
+            hashtable->nnodes--;
             FLUID_LOG(FLUID_ERR, "Out of memory");
             return;
         }
 
-        node->key = key;
-        node->value = value;
-        node->key_hash = key_hash;
-        node->next = NULL;
-
-        *node_ptr = node;
-        hashtable->nnodes++;
-        fluid_hashtable_maybe_resize(hashtable);
+        entry.key = key;
+        entry.value = value;
+        entry.key_hash = key_hash;
+        fluid_hashtable_place_node(hashtable, entry);
     }
 }
 
@@ -915,18 +890,18 @@ static int
 fluid_hashtable_remove_internal(fluid_hashtable_t *hashtable, const void *key,
                                 int notify)
 {
-    fluid_hashnode_t **node_ptr;
+    fluid_hashnode_t *node;
 
     fluid_return_val_if_fail(hashtable != NULL, FALSE);
 
-    node_ptr = fluid_hashtable_lookup_node(hashtable, key, NULL);
+    node = fluid_hashtable_lookup_node(hashtable, key, NULL);
 
-    if(*node_ptr == NULL)
+    if(node == NULL)
     {
         return FALSE;
     }
 
-    fluid_hashtable_remove_node(hashtable, &node_ptr, notify);
+    fluid_hashtable_remove_node(hashtable, node, notify);
     fluid_hashtable_maybe_resize(hashtable);
 
     return TRUE;
@@ -1030,23 +1005,20 @@ fluid_hashtable_foreach_remove_or_steal(fluid_hashtable_t *hashtable,
                                         fluid_hr_func_t func, void *user_data,
                                         int notify)
 {
-    fluid_hashnode_t *node, **node_ptr;
+    fluid_hashnode_t *node;
     unsigned int deleted = 0;
+    int start = fluid_hashtable_first_empty(hashtable);
     int i;
 
-    for(i = 0; i < hashtable->size; i++)
+    for(i = 1; i < hashtable->size; i++)
     {
-        for(node_ptr = &hashtable->nodes[i]; (node = *node_ptr) != NULL;)
+        node = &hashtable->nodes[(start + i) & (hashtable->size - 1)];
+
+        /* a removal moves the next entry of the run into the slot */
+        while(node->dist != 0 && (* func)(node->key, node->value, user_data))
         {
-            if((* func)(node->key, node->value, user_data))
-            {
-                fluid_hashtable_remove_node(hashtable, &node_ptr, notify);
-                deleted++;
-            }
-            else
-            {
-                node_ptr = &node->next;
-            }
+            fluid_hashtable_remove_node(hashtable, node, notify);
+            deleted++;
         }
     }
 
@@ -1137,7 +1109,9 @@ fluid_hashtable_foreach(fluid_hashtable_t *hashtable, fluid_hr_func_t func,
 
     for(i = 0; i < hashtable->size; i++)
     {
-        for(node = hashtable->nodes[i]; node; node = node->next)
+        node = &hashtable->nodes[i];
+
+        if(node->dist != 0)
         {
             (* func)(node->key, node->value, user_data);
         }
@@ -1182,7 +1156,9 @@ fluid_hashtable_find(fluid_hashtable_t *hashtable, fluid_hr_func_t predicate,
 
     for(i = 0; i < hashtable->size; i++)
     {
-        for(node = hashtable->nodes[i]; node; node = node->next)
+        node = &hashtable->nodes[i];
+
+        if(node->dist != 0)
         {
             if(predicate(node->key, node->value, user_data))
             {
@@ -1237,7 +1213,9 @@ fluid_hashtable_get_keys(fluid_hashtable_t *hashtable)
 
     for(i = 0; i < hashtable->size; i++)
     {
-        for(node = hashtable->nodes[i]; node; node = node->next)
+        node = &hashtable->nodes[i];
+
+        if(node->dist != 0)
         {
             retval = fluid_list_prepend(retval, node->key);
         }
@@ -1273,7 +1251,9 @@ fluid_hashtable_get_values(fluid_hashtable_t *hashtable)
 
     for(i = 0; i < hashtable->size; i++)
     {
-        for(node = hashtable->nodes[i]; node; node = node->next)
+        node = &hashtable->nodes[i];
+
+        if(node->dist != 0)
         {
             retval = fluid_list_prepend(retval, node->value);
         }
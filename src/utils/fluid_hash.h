@@ -29,6 +29,7 @@
  *
  * - Self contained (no dependencies on glib)
  * - changed names to fluid_hashtable_...
+ * - open addressing with Robin Hood hashing instead of chained nodes
  */
 
 #ifndef _FLUID_HASH_H
@@ -49,25 +50,28 @@ typedef struct _fluid_hashtable_iter_t fluid_hashtable_iter_t;
 
 typedef struct _fluid_hashnode_t      fluid_hashnode_t;
 
+/* A slot of the table */
 struct _fluid_hashnode_t
 {
     void *key;
     void *value;
-    fluid_hashnode_t *next;
     unsigned int key_hash;
+    unsigned int dist;      /* 1 + distance from the home slot of the key, 0 if empty */
 };
 
 struct _fluid_hashtable_t
 {
-    int size;
+    int size;               /* number of slots, a power of two */
     int nnodes;
-    fluid_hashnode_t **nodes;
+    int shift;              /* 32 - log2(size) */
+    fluid_hashnode_t *nodes;
     fluid_hash_func_t hash_func;
     fluid_equal_func_t key_equal_func;
     fluid_atomic_int_t ref_count;
     fluid_destroy_notify_t key_destroy_func;
     fluid_destroy_notify_t value_destroy_func;
     fluid_rec_mutex_t mutex;          // Optionally used in other modules (fluid_settings.c for example)
+    fluid_hashtable_t *defaults;      // fluid_settings.c: the default settings looked up next
 };
 
 struct _fluid_hashtable_iter_t
@@ -0,0 +1,199 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_meter.h"
+
+/**
+ * Create the level meters of a synth, initially disabled.
+ * @param channels Number of MIDI channels
+ * @param groups Number of audio groups
+ * @param fx_channels Number of effects buffers
+ * @return New meters or NULL if out of memory (error message logged)
+ */
+fluid_meter_t *
+new_fluid_meter(int channels, int groups, int fx_channels)
+{
+    fluid_meter_t *meter = FLUID_NEW(fluid_meter_t);
+
+    if(meter == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(meter, 0, sizeof(*meter));
+    meter->channels = channels;
+    meter->groups = groups;
+    meter->fx_channels = fx_channels;
+
+    return meter;
+}
+
+void
+delete_fluid_meter(fluid_meter_t *meter)
+{
+    fluid_return_if_fail(meter != NULL);
+
+    FLUID_FREE(meter->rows);
+    FLUID_FREE(meter->levels);
+    FLUID_FREE(meter);
+}
+
+/**
+ * Enable or disable the metering. The levels are allocated when it's enabled for the
+ * first time and kept until the meters are deleted, since the render threads may still
+ * be metering while it gets disabled.
+ * @return #FLUID_OK on success, #FLUID_FAILED if out of memory (error message logged)
+ */
+int
+fluid_meter_set_enabled(fluid_meter_t *meter, int enabled)
+{
+    int rows = FLUID_METER_MAX_THREADS * meter->channels;
+    int levels = meter->channels + meter->groups + meter->fx_channels;
+
+    if(enabled && meter->levels == NULL)
+    {
+        meter->rows = FLUID_ARRAY(fluid_meter_acc_t, rows);
+        meter->levels = FLUID_ARRAY(fluid_meter_level_t, levels);
+
+        if(meter->rows == NULL || meter->levels == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            FLUID_FREE(meter->rows);
+            FLUID_FREE(meter->levels);
+            meter->rows = NULL;
+            meter->levels = NULL;
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMSET(meter->rows, 0, rows * sizeof(*meter->rows));
+        FLUID_MEMSET(meter->levels, 0, levels * sizeof(*meter->levels));
+    }
+
+    fluid_atomic_int_set(&meter->enabled, enabled);
+    return FLUID_OK;
+}
+
+/**
+ * Get the largest absolute value and the sum of the squares of count samples.
+ */
+void
+fluid_meter_measure(const fluid_real_t *buf, int count, fluid_real_t *peak, double *sumsq)
+{
+    fluid_real_t max_val = 0.0f;
+    fluid_real_t sum = 0.0f;
+    int i;
+
+    #pragma omp simd reduction(max:max_val) reduction(+:sum)
+    for(i = 0; i < count; i++)
+    {
+        fluid_real_t val = FLUID_FABS(buf[i]);
+
+        max_val = (val > max_val) ? val : max_val;
+        sum += buf[i] * buf[i];
+    }
+
+    *peak = max_val;
+    *sumsq = sum;
+}
+
+/**
+ * Add the levels of samples samples to a level, must only be called by the main render thread.
+ * @param level Index of the level: a channel, channels + an audio group or
+ *   channels + groups + an effects buffer
+ */
+void
+fluid_meter_record(fluid_meter_t *meter, int level, const fluid_meter_acc_t *acc, int samples)
+{
+    fluid_meter_level_t *dest = &meter->levels[level];
+    int i;
+
+    if(fluid_atomic_int_get(&dest->reset))
+    {
+        FLUID_MEMSET(&dest->acc, 0, sizeof(dest->acc));
+        dest->samples = 0.0;
+        fluid_atomic_int_set(&dest->reset, FALSE);
+    }
+
+    for(i = 0; i < 2; i++)
+    {
+        if(acc->peak[i] > dest->acc.peak[i])
+        {
+            dest->acc.peak[i] = acc->peak[i];
+        }
+
+        dest->acc.sumsq[i] += acc->sumsq[i];
+    }
+
+    dest->samples += samples;
+}
+
+/**
+ * Fold the rows of the first participants render participants into the levels of the
+ * channels and clear them for the next render call. Must only be called by the main render
+ * thread, once all voices have been mixed down.
+ */
+void
+fluid_meter_record_channels(fluid_meter_t *meter, int participants, int samples)
+{
+    int chan, t;
+
+    fluid_clip(participants, 1, FLUID_METER_MAX_THREADS);
+
+    for(chan = 0; chan < meter->channels; chan++)
+    {
+        fluid_meter_acc_t sum = meter->rows[chan];
+
+        for(t = 1; t < participants; t++)
+        {
+            fluid_meter_acc_t *row = &meter->rows[t * meter->channels + chan];
+
+            sum.peak[0] = (row->peak[0] > sum.peak[0]) ? row->peak[0] : sum.peak[0];
+            sum.peak[1] = (row->peak[1] > sum.peak[1]) ? row->peak[1] : sum.peak[1];
+            sum.sumsq[0] += row->sumsq[0];
+            sum.sumsq[1] += row->sumsq[1];
+            FLUID_MEMSET(row, 0, sizeof(*row));
+        }
+
+        FLUID_MEMSET(&meter->rows[chan], 0, sizeof(meter->rows[chan]));
+        fluid_meter_record(meter, chan, &sum, samples);
+    }
+}
+
+/**
+ * Get the peak and RMS levels of a level since it has been read last, and start over.
+ */
+void
+fluid_meter_get(fluid_meter_t *meter, int level, fluid_meter_stats_t *stats)
+{
+    fluid_meter_level_t *src = &meter->levels[level];
+    double samples = src->samples;
+
+    FLUID_MEMSET(stats, 0, sizeof(*stats));
+
+    if(!fluid_atomic_int_get(&src->reset) && samples > 0.0)
+    {
+        stats->peak_left = (float)src->acc.peak[0];
+        stats->peak_right = (float)src->acc.peak[1];
+        stats->rms_left = (float)sqrt(src->acc.sumsq[0] / samples);
+        stats->rms_right = (float)sqrt(src->acc.sumsq[1] / samples);
+    }
+
+    fluid_atomic_int_set(&src->reset, TRUE);
+}
@@ -0,0 +1,97 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLUID_METER_H
+#define _FLUID_METER_H
+
+#include "fluid_sys.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Level meters of the MIDI channels, audio groups and effects buffers, see synth.metering.
+ * The channels are metered while their voices are mixed down: every render participant adds
+ * the levels of the voices it mixes to its own row, which the main render thread folds into
+ * the levels once all voices are rendered. The audio groups and effects buffers are metered
+ * after the mixdown. The levels are read without locks, like the render stage statistics.
+ */
+
+/* Render participants metering the channels, voices of further participants aren't metered */
+#define FLUID_METER_MAX_THREADS 32
+
+/* Levels of a stereo signal, 0 is left and 1 is right */
+typedef struct _fluid_meter_acc_t
+{
+    fluid_real_t peak[2];       /**< Largest absolute sample value */
+    double sumsq[2];            /**< Sum of the squared sample values */
+} fluid_meter_acc_t;
+
+typedef struct _fluid_meter_level_t
+{
+    fluid_atomic_int_t reset;   /**< Atomic: set by readers, the writer clears the level before its next record */
+    fluid_meter_acc_t acc;      /**< Written by the main render thread only */
+    double samples;             /**< Number of samples in acc */
+} fluid_meter_level_t;
+
+typedef struct _fluid_meter_t
+{
+    fluid_atomic_int_t enabled; /**< Atomic: TRUE if the levels should be metered, only set once they are allocated */
+    int channels;               /**< Number of MIDI channels */
+    int groups;                 /**< Number of audio groups */
+    int fx_channels;            /**< Number of effects buffers */
+    fluid_meter_acc_t *rows;    /**< FLUID_METER_MAX_THREADS rows of channels, NULL until enabled */
+    fluid_meter_level_t *levels; /**< The channels, followed by the audio groups and the effects buffers */
+} fluid_meter_t;
+
+fluid_meter_t *new_fluid_meter(int channels, int groups, int fx_channels);
+void delete_fluid_meter(fluid_meter_t *meter);
+
+int fluid_meter_set_enabled(fluid_meter_t *meter, int enabled);
+void fluid_meter_measure(const fluid_real_t *buf, int count, fluid_real_t *peak, double *sumsq);
+void fluid_meter_record(fluid_meter_t *meter, int level, const fluid_meter_acc_t *acc, int samples);
+void fluid_meter_record_channels(fluid_meter_t *meter, int participants, int samples);
+void fluid_meter_get(fluid_meter_t *meter, int level, fluid_meter_stats_t *stats);
+
+/* Returns TRUE if the levels should be metered. NULL safe. */
+static FLUID_INLINE int
+fluid_meter_enabled(fluid_meter_t *meter)
+{
+    return meter != NULL && fluid_atomic_int_get(&meter->enabled);
+}
+
+/* Returns the levels a render participant adds the voices of a channel to, NULL if not metered */
+static FLUID_INLINE fluid_meter_acc_t *
+fluid_meter_row(fluid_meter_t *meter, int thread_idx, int chan)
+{
+    if(!fluid_meter_enabled(meter) || thread_idx >= FLUID_METER_MAX_THREADS
+            || chan < 0 || chan >= meter->channels)
+    {
+        return NULL;
+    }
+
+    return &meter->rows[thread_idx * meter->channels + chan];
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_METER_H */
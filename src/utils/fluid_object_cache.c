@@ -0,0 +1,75 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_object_cache.h"
+
+/*
+ * Taking an object only empties its slot if the slot still holds it. Unlike popping a
+ * linked free list, this doesn't read anything from the object, so an object taken and
+ * put back meanwhile by other threads doesn't do any harm.
+ */
+
+/**
+ * Take an object out of the cache.
+ * @return A freed object or NULL if the cache is empty
+ */
+void *
+fluid_object_cache_take(fluid_object_cache_t *cache)
+{
+    int i, slot, start = fluid_atomic_int_get(&cache->hint);
+    void *obj;
+
+    /* start at the slot filled last, its object is likely still in the CPU cache */
+    for(i = 0; i < FLUID_OBJECT_CACHE_SLOTS; i++)
+    {
+        slot = (start - i) & (FLUID_OBJECT_CACHE_SLOTS - 1);
+        obj = fluid_atomic_pointer_get(&cache->slots[slot]);
+
+        if(obj != NULL && fluid_atomic_pointer_compare_and_exchange(&cache->slots[slot], obj, NULL))
+        {
+            return obj;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Put a freed object into the cache.
+ * @return TRUE if the cache took it, FALSE if it is full and the caller has to free it
+ */
+int
+fluid_object_cache_put(fluid_object_cache_t *cache, void *obj)
+{
+    int i, slot, start = fluid_atomic_int_get(&cache->hint);
+
+    for(i = 0; i < FLUID_OBJECT_CACHE_SLOTS; i++)
+    {
+        slot = (start + i) & (FLUID_OBJECT_CACHE_SLOTS - 1);
+
+        if(fluid_atomic_pointer_get(&cache->slots[slot]) == NULL
+                && fluid_atomic_pointer_compare_and_exchange(&cache->slots[slot], NULL, obj))
+        {
+            fluid_atomic_int_set(&cache->hint, slot);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
@@ -0,0 +1,54 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLUID_OBJECT_CACHE_H
+#define _FLUID_OBJECT_CACHE_H
+
+#include "fluid_sys.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of freed objects a cache keeps at most */
+#define FLUID_OBJECT_CACHE_SLOTS 32
+
+/*
+ * Lock-free cache of freed objects of the same size, so that objects created and deleted
+ * at a high rate, like the MIDI events of an application, are reused instead of going
+ * through malloc and free every time. Any thread may put objects in and take them out.
+ * A cache is meant to be static and lives as long as the process, the objects still in
+ * it when the process exits are not freed.
+ */
+typedef struct
+{
+    void *slots[FLUID_OBJECT_CACHE_SLOTS]; /**< Atomic: cached objects, NULL if empty */
+    fluid_atomic_int_t hint;    /**< Atomic: slot an object has been put into last */
+} fluid_object_cache_t;
+
+#define FLUID_OBJECT_CACHE_INIT { { NULL }, 0 }
+
+void *fluid_object_cache_take(fluid_object_cache_t *cache);
+int fluid_object_cache_put(fluid_object_cache_t *cache, void *obj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_OBJECT_CACHE_H */
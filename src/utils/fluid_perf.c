@@ -0,0 +1,407 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_perf.h"
+
+#if !defined(_WIN32)
+#include <time.h>
+#endif
+
+/**
+ * Create the render stage statistics of a synth, initially disabled.
+ * @param channels Number of MIDI channels the voices are accounted to
+ * @return New statistics or NULL if out of memory (error message logged)
+ */
+fluid_perf_t *
+new_fluid_perf(int channels)
+{
+    fluid_perf_t *perf = FLUID_NEW(fluid_perf_t);
+    int i;
+
+    if(perf == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(perf, 0, sizeof(*perf));
+    perf->channels = channels;
+
+    for(i = 0; i < FLUID_PERF_STAGE_LAST; i++)
+    {
+        perf->stages[i].min = 1e10;
+    }
+
+    for(i = 0; i < FLUID_PERF_MAX_THREADS; i++)
+    {
+        perf->threads[i].min = 1e10;
+    }
+
+    perf->note_latency.min = 1e10;
+
+    return perf;
+}
+
+void
+delete_fluid_perf(fluid_perf_t *perf)
+{
+    fluid_return_if_fail(perf != NULL);
+
+    FLUID_FREE(perf->slots);
+    FLUID_FREE(perf);
+}
+
+/**
+ * Get a timestamp in usec with sub-microsecond resolution.
+ *
+ * The monotonic clock is read via the vDSO on Linux and the performance counter
+ * on Windows, both cost a few dozen nanoseconds. The raw TSC isn't used, since it
+ * isn't guaranteed to be in sync across cores or to tick at a constant rate.
+ */
+double
+fluid_perf_now(void)
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER freq = {0, 0};
+    LARGE_INTEGER now;
+
+    if(freq.QuadPart == 0)
+    {
+        QueryPerformanceFrequency(&freq);
+    }
+
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000000.0 / (double)freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+#else
+    return fluid_utime();
+#endif
+}
+
+/* Histogram bin of a duration */
+static int
+fluid_perf_bin(double usec)
+{
+    int exp, bin;
+    double mant;
+
+    if(usec <= 0.0)
+    {
+        return 0;
+    }
+
+    /* usec = mant * 2^exp with mant in [0.5, 1), split into four bins per octave */
+    mant = frexp(usec, &exp);
+    bin = (exp - FLUID_PERF_MIN_EXP) * 4 + (int)((mant - 0.5) * 8.0);
+
+    if(bin < 0)
+    {
+        return 0;
+    }
+
+    return (bin < FLUID_PERF_BINS) ? bin : FLUID_PERF_BINS - 1;
+}
+
+/* Upper bound of the durations in a histogram bin */
+static double
+fluid_perf_bin_limit(int bin)
+{
+    return ldexp(0.5 + ((bin % 4) + 1) * 0.125, bin / 4 + FLUID_PERF_MIN_EXP);
+}
+
+/**
+ * Record a duration. Must only be called by the single writer of the counter.
+ */
+void
+fluid_perf_record(fluid_perf_counter_t *counter, double usec)
+{
+    int i;
+
+    if(fluid_atomic_int_get(&counter->reset))
+    {
+        for(i = 0; i < FLUID_PERF_BINS; i++)
+        {
+            fluid_atomic_int_set(&counter->bins[i], 0);
+        }
+
+        counter->total = 0.0;
+        counter->min = 1e10;
+        counter->max = 0.0;
+        fluid_atomic_int_set(&counter->count, 0);
+        fluid_atomic_int_set(&counter->reset, FALSE);
+    }
+
+    counter->total += usec;
+    counter->min = (usec < counter->min) ? usec : counter->min;
+    counter->max = (usec > counter->max) ? usec : counter->max;
+    fluid_atomic_int_inc(&counter->bins[fluid_perf_bin(usec)]);
+    fluid_atomic_int_inc(&counter->count);
+}
+
+/**
+ * Take a snapshot of a counter. The values may be slightly inconsistent with each
+ * other if the writer records a duration at the same time.
+ */
+void
+fluid_perf_get_stats(fluid_perf_counter_t *counter, fluid_perf_stats_t *stats)
+{
+    int count = fluid_atomic_int_get(&counter->count);
+    int i, seen = 0, p99;
+
+    FLUID_MEMSET(stats, 0, sizeof(*stats));
+
+    if(count == 0 || fluid_atomic_int_get(&counter->reset))
+    {
+        return;
+    }
+
+    stats->count = count;
+    stats->min = counter->min;
+    stats->max = counter->max;
+    stats->avg = counter->total / count;
+
+    /* rank of the 99th percentile, rounded up */
+    p99 = count - count / 100;
+
+    for(i = 0; i < FLUID_PERF_BINS; i++)
+    {
+        seen += fluid_atomic_int_get(&counter->bins[i]);
+
+        if(seen >= p99)
+        {
+            break;
+        }
+    }
+
+    stats->p99 = (i < FLUID_PERF_BINS) ? fluid_perf_bin_limit(i) : stats->max;
+
+    /* the bin is a range, the percentile can't lie beyond the largest duration */
+    if(stats->p99 > stats->max)
+    {
+        stats->p99 = stats->max;
+    }
+}
+
+/**
+ * Take a snapshot of the histogram of a counter, as racy as fluid_perf_get_stats().
+ * @param counts Array receiving the number of durations of each bin
+ * @param limits Array receiving the upper bound in usec of each bin
+ * @param size Number of elements of counts and limits, the first size bins are returned
+ * @return Number of bins of the histogram, #FLUID_PERF_BINS
+ */
+int
+fluid_perf_get_histogram(fluid_perf_counter_t *counter, unsigned int *counts, double *limits, int size)
+{
+    int i, reset = fluid_atomic_int_get(&counter->reset);
+
+    for(i = 0; i < size && i < FLUID_PERF_BINS; i++)
+    {
+        counts[i] = reset ? 0 : (unsigned int)fluid_atomic_int_get(&counter->bins[i]);
+        limits[i] = fluid_perf_bin_limit(i);
+    }
+
+    return FLUID_PERF_BINS;
+}
+
+/**
+ * Ask the writers to clear all counters before they record the next duration.
+ */
+void
+fluid_perf_reset(fluid_perf_t *perf)
+{
+    int i;
+
+    for(i = 0; i < FLUID_PERF_STAGE_LAST; i++)
+    {
+        fluid_atomic_int_set(&perf->stages[i].reset, TRUE);
+    }
+
+    for(i = 0; i < FLUID_PERF_MAX_THREADS; i++)
+    {
+        fluid_atomic_int_set(&perf->threads[i].reset, TRUE);
+        fluid_atomic_int_set(&perf->slots_reset[i], TRUE);
+        fluid_atomic_int_set(&perf->waits_reset[i], TRUE);
+    }
+
+    fluid_atomic_int_set(&perf->note_latency.reset, TRUE);
+    fluid_atomic_int_set(&perf->blocks_reset, TRUE);
+}
+
+/**
+ * Enable or disable the CPU accounting of the voices. The slots are allocated when it's
+ * enabled for the first time and kept until the statistics are deleted, since the render
+ * threads may still be accounting a voice while it gets disabled.
+ * @return #FLUID_OK on success, #FLUID_FAILED if out of memory (error message logged)
+ */
+int
+fluid_perf_set_accounting(fluid_perf_t *perf, int enabled)
+{
+    int n = FLUID_PERF_MAX_THREADS * (perf->channels + FLUID_PERF_MAX_PRESETS);
+
+    if(enabled && perf->slots == NULL)
+    {
+        perf->slots = FLUID_ARRAY(fluid_perf_slot_t, n);
+
+        if(perf->slots == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
+
+        FLUID_MEMSET(perf->slots, 0, n * sizeof(*perf->slots));
+    }
+
+    fluid_atomic_int_set(&perf->accounting, enabled);
+    return FLUID_OK;
+}
+
+/**
+ * Get the slot a preset is accounted to, adding one for a preset seen for the first time.
+ * Must only be called by the synth thread.
+ * @return Slot index or -1 if all slots are taken
+ */
+int
+fluid_perf_preset_slot(fluid_perf_t *perf, int sfont_id, int bank, int prog)
+{
+    int count = fluid_atomic_int_get(&perf->preset_count);
+    int i;
+
+    for(i = 0; i < count; i++)
+    {
+        if(perf->presets[i].prog == prog && perf->presets[i].bank == bank
+                && perf->presets[i].sfont_id == sfont_id)
+        {
+            return i;
+        }
+    }
+
+    if(count == FLUID_PERF_MAX_PRESETS)
+    {
+        return -1;
+    }
+
+    perf->presets[count].sfont_id = sfont_id;
+    perf->presets[count].bank = bank;
+    perf->presets[count].prog = prog;
+    fluid_atomic_int_set(&perf->preset_count, count + 1);
+
+    return count;
+}
+
+/**
+ * Account the time a render participant spent on a voice to the voice's channel and preset.
+ * Must only be called by the participant while accounting is enabled.
+ * @param chan Channel of the voice, -1 if unknown
+ * @param preset Preset slot of the voice, -1 if unknown
+ * @param blocks Number of blocks rendered of the voice
+ */
+void
+fluid_perf_account(fluid_perf_t *perf, int thread_idx, int chan, int preset, double usec, int blocks)
+{
+    int len = perf->channels + FLUID_PERF_MAX_PRESETS;
+    fluid_perf_slot_t *row;
+
+    if(thread_idx >= FLUID_PERF_MAX_THREADS)
+    {
+        return;
+    }
+
+    row = &perf->slots[thread_idx * len];
+
+    if(fluid_atomic_int_get(&perf->slots_reset[thread_idx]))
+    {
+        FLUID_MEMSET(row, 0, len * sizeof(*row));
+        fluid_atomic_int_set(&perf->slots_reset[thread_idx], FALSE);
+    }
+
+    if(chan >= 0 && chan < perf->channels)
+    {
+        row[chan].usec += usec;
+        row[chan].blocks += blocks;
+    }
+
+    if(preset >= 0 && preset < FLUID_PERF_MAX_PRESETS)
+    {
+        row[perf->channels + preset].usec += usec;
+        row[perf->channels + preset].blocks += blocks;
+    }
+}
+
+/**
+ * Count the blocks rendered while accounting, the reference for the accounted voice blocks.
+ * Must only be called by the main render thread.
+ */
+void
+fluid_perf_account_blocks(fluid_perf_t *perf, int blocks)
+{
+    if(fluid_atomic_int_get(&perf->blocks_reset))
+    {
+        perf->blocks = 0.0;
+        fluid_atomic_int_set(&perf->blocks_reset, FALSE);
+    }
+
+    perf->blocks += blocks;
+}
+
+/**
+ * Sum up a slot of all render participants, 0 up to channels - 1 are the channels, the
+ * presets follow. A racy snapshot like fluid_perf_get_stats().
+ */
+void
+fluid_perf_get_slot(fluid_perf_t *perf, int slot, fluid_perf_slot_t *sum)
+{
+    int len = perf->channels + FLUID_PERF_MAX_PRESETS;
+    int i;
+
+    FLUID_MEMSET(sum, 0, sizeof(*sum));
+
+    if(perf->slots == NULL)
+    {
+        return;
+    }
+
+    for(i = 0; i < FLUID_PERF_MAX_THREADS; i++)
+    {
+        if(!fluid_atomic_int_get(&perf->slots_reset[i]))
+        {
+            sum->usec += perf->slots[i * len + slot].usec;
+            sum->blocks += perf->slots[i * len + slot].blocks;
+        }
+    }
+}
+
+/**
+ * Get the waits of a render participant, zero if they are about to be cleared.
+ * A racy snapshot like fluid_perf_get_stats().
+ */
+void
+fluid_perf_get_waits(fluid_perf_t *perf, int thread_idx, fluid_perf_waits_t *waits)
+{
+    if(fluid_atomic_int_get(&perf->waits_reset[thread_idx]))
+    {
+        FLUID_MEMSET(waits, 0, sizeof(*waits));
+        return;
+    }
+
+    *waits = perf->waits[thread_idx];
+}
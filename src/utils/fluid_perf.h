@@ -0,0 +1,182 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLUID_PERF_H
+#define _FLUID_PERF_H
+
+#include "fluid_sys.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Render stage statistics, available in every build and switched on and off at runtime
+ * by synth.perf-stats. Unlike the probes of WITH_PROFILING, the counters belong to a
+ * synth instance and are written without locks: every counter has exactly one writer,
+ * the thread rendering the stage, while readers only take racy snapshots.
+ */
+
+/* Histogram of the durations for the percentiles: four bins per octave, the first one
+ * starting at 2^FLUID_PERF_MIN_EXP / 2 usec, i.e. 0.125 usec up to about 130 msec */
+#define FLUID_PERF_BINS 80
+#define FLUID_PERF_MIN_EXP (-2)
+
+/* Render participants of the voices stage whose time is kept separately, participants
+ * beyond that are only part of the stage total */
+#define FLUID_PERF_MAX_THREADS 32
+
+/* Presets whose voices are accounted, voices of further presets are only accounted to their channel */
+#define FLUID_PERF_MAX_PRESETS 128
+
+typedef struct _fluid_perf_counter_t
+{
+    fluid_atomic_int_t count;   /**< Atomic: number of recorded durations */
+    fluid_atomic_int_t reset;   /**< Atomic: set by readers, the writer clears the counter before its next record */
+    double total, min, max;     /**< Durations in usec, written by the writer only */
+    fluid_atomic_int_t bins[FLUID_PERF_BINS]; /**< Atomic: histogram of the durations */
+} fluid_perf_counter_t;
+
+/* Time spent on the voices of a channel or preset */
+typedef struct _fluid_perf_slot_t
+{
+    double usec;                /**< Time spent rendering and mixing the voices */
+    double blocks;              /**< Number of voice blocks rendered */
+} fluid_perf_slot_t;
+
+/* How often a render participant waited for the others, see synth.mixer-thread-wait */
+typedef struct _fluid_perf_waits_t
+{
+    unsigned int spin;          /**< Waits satisfied by polling */
+    unsigned int block;         /**< Waits that fell back to blocking on a condition variable */
+} fluid_perf_waits_t;
+
+typedef struct _fluid_perf_preset_t
+{
+    int sfont_id, bank, prog;
+} fluid_perf_preset_t;
+
+typedef struct _fluid_perf_t
+{
+    fluid_atomic_int_t enabled; /**< Atomic: TRUE if the stages should be timed */
+    fluid_perf_counter_t stages[FLUID_PERF_STAGE_LAST];
+    fluid_perf_counter_t threads[FLUID_PERF_MAX_THREADS]; /**< Voices stage time of each render participant, 0 is the main thread */
+    fluid_perf_counter_t note_latency; /**< Time from the MIDI ingress of a note-on to its first sample being heard, written by the main render thread */
+    fluid_perf_waits_t waits[FLUID_PERF_MAX_THREADS]; /**< Waits of each render participant, written by that participant only */
+    fluid_atomic_int_t waits_reset[FLUID_PERF_MAX_THREADS]; /**< Atomic: set by readers, the participant clears its waits before the next one */
+
+    /* CPU accounting of the voices, see synth.cpu-accounting. Every render participant adds up
+     * the time of the voices it renders in its own row of slots, readers sum up the rows. */
+    fluid_atomic_int_t accounting; /**< Atomic: TRUE if voices should be accounted, only set once slots is allocated */
+    int channels;               /**< Number of MIDI channels */
+    fluid_perf_slot_t *slots;   /**< FLUID_PERF_MAX_THREADS rows of channels + FLUID_PERF_MAX_PRESETS slots, NULL until accounting is enabled */
+    fluid_atomic_int_t slots_reset[FLUID_PERF_MAX_THREADS]; /**< Atomic: set by readers, the participant clears its row before the next accounting */
+    double blocks;              /**< Blocks rendered while accounting, written by the main render thread only */
+    fluid_atomic_int_t blocks_reset; /**< Atomic: set by readers, the main render thread clears blocks */
+    fluid_perf_preset_t presets[FLUID_PERF_MAX_PRESETS]; /**< Presets of the preset slots, written by the synth thread only */
+    fluid_atomic_int_t preset_count; /**< Atomic: number of valid entries in presets */
+} fluid_perf_t;
+
+fluid_perf_t *new_fluid_perf(int channels);
+void delete_fluid_perf(fluid_perf_t *perf);
+
+double fluid_perf_now(void);
+void fluid_perf_record(fluid_perf_counter_t *counter, double usec);
+void fluid_perf_get_stats(fluid_perf_counter_t *counter, fluid_perf_stats_t *stats);
+int fluid_perf_get_histogram(fluid_perf_counter_t *counter, unsigned int *counts, double *limits, int size);
+void fluid_perf_reset(fluid_perf_t *perf);
+
+int fluid_perf_set_accounting(fluid_perf_t *perf, int enabled);
+int fluid_perf_preset_slot(fluid_perf_t *perf, int sfont_id, int bank, int prog);
+void fluid_perf_account(fluid_perf_t *perf, int thread_idx, int chan, int preset, double usec, int blocks);
+void fluid_perf_account_blocks(fluid_perf_t *perf, int blocks);
+void fluid_perf_get_slot(fluid_perf_t *perf, int slot, fluid_perf_slot_t *sum);
+void fluid_perf_get_waits(fluid_perf_t *perf, int thread_idx, fluid_perf_waits_t *waits);
+
+/* Returns the start time of a stage, 0 if the stages aren't timed. NULL safe, so that
+ * the probes cost a single load when disabled. */
+static FLUID_INLINE double
+fluid_perf_ref(fluid_perf_t *perf)
+{
+    return (perf != NULL && fluid_atomic_int_get(&perf->enabled)) ? fluid_perf_now() : 0.0;
+}
+
+/* Records the duration of a stage started at ref, unless it wasn't timed */
+static FLUID_INLINE void
+fluid_perf_stage(fluid_perf_t *perf, int stage, double ref)
+{
+    if(ref != 0.0)
+    {
+        fluid_perf_record(&perf->stages[stage], fluid_perf_now() - ref);
+    }
+}
+
+/* Records the time a render participant spent rendering voices, if its ref was timed */
+static FLUID_INLINE void
+fluid_perf_thread(fluid_perf_t *perf, int thread_idx, double ref, double usec)
+{
+    if(ref != 0.0 && thread_idx < FLUID_PERF_MAX_THREADS)
+    {
+        fluid_perf_record(&perf->threads[thread_idx], usec);
+    }
+}
+
+/* Counts a wait of a render participant for the others, whether it had to block or not.
+ * Counted regardless of synth.perf-stats, as it costs no more than the increment. NULL safe. */
+static FLUID_INLINE void
+fluid_perf_wait(fluid_perf_t *perf, int thread_idx, int blocked)
+{
+    fluid_perf_waits_t *waits;
+
+    if(perf == NULL || thread_idx >= FLUID_PERF_MAX_THREADS)
+    {
+        return;
+    }
+
+    waits = &perf->waits[thread_idx];
+
+    if(fluid_atomic_int_get(&perf->waits_reset[thread_idx]))
+    {
+        waits->spin = 0;
+        waits->block = 0;
+        fluid_atomic_int_set(&perf->waits_reset[thread_idx], FALSE);
+    }
+
+    if(blocked)
+    {
+        waits->block++;
+    }
+    else
+    {
+        waits->spin++;
+    }
+}
+
+/* Returns TRUE if the voices should be accounted to their channel and preset. NULL safe. */
+static FLUID_INLINE int
+fluid_perf_accounting(fluid_perf_t *perf)
+{
+    return perf != NULL && fluid_atomic_int_get(&perf->accounting);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_PERF_H */
@@ -26,6 +26,9 @@
 extern "C" {
 #endif
 
+/* Padding between the fields written by different threads, so that they don't share a cache line */
+#define FLUID_RINGBUFFER_PADDING 64
+
 /*
  * Lockless event queue instance.
  */
@@ -33,11 +36,18 @@ struct _fluid_ringbuffer_t
 {
     char *array;  /**< Queue array of arbitrary size elements */
     int totalcount;       /**< Total count of elements in array */
-    fluid_atomic_int_t count;            /**< Current count of elements */
-    int in;               /**< Index in queue to store next pushed element */
-    int out;              /**< Index in queue of next popped element */
     size_t elementsize;          /**< Size of each element */
     void *userdata;
+
+    char pad_count[FLUID_RINGBUFFER_PADDING];
+    fluid_atomic_int_t count;            /**< Current count of elements, written by both threads */
+
+    char pad_in[FLUID_RINGBUFFER_PADDING];
+    int in;               /**< Index in queue to store next pushed element, producer only */
+
+    char pad_out[FLUID_RINGBUFFER_PADDING];
+    int out;              /**< Index in queue of next popped element, consumer only */
+    char pad_end[FLUID_RINGBUFFER_PADDING];
 };
 
 typedef struct _fluid_ringbuffer_t fluid_ringbuffer_t;
@@ -65,6 +75,39 @@ fluid_ringbuffer_get_inptr(fluid_ringbuffer_t *queue, int offset)
            : queue->array + queue->elementsize * ((queue->in + offset) % queue->totalcount);
 }
 
+/**
+ * Get the number of elements that can be pushed, reading the consumer's progress once.
+ * @param queue Lockless queue instance
+ * @return Number of free elements, which can only grow until the producer pushes
+ *
+ * Together with fluid_ringbuffer_get_inptr_at() and fluid_ringbuffer_next_inptr()
+ * this forms a bulk "push": reserve, fill the elements, commit them all at once.
+ */
+static FLUID_INLINE int
+fluid_ringbuffer_get_space(fluid_ringbuffer_t *queue)
+{
+    return queue->totalcount - fluid_atomic_int_get(&queue->count);
+}
+
+/**
+ * Get pointer to an input array element without checking the free space.
+ * @param queue Lockless queue instance
+ * @param offset Below the value of fluid_ringbuffer_get_space()
+ * @return Pointer to array element in queue to store data to
+ */
+static FLUID_INLINE void *
+fluid_ringbuffer_get_inptr_at(fluid_ringbuffer_t *queue, int offset)
+{
+    int index = queue->in + offset;
+
+    if(index >= queue->totalcount)
+    {
+        index -= queue->totalcount;
+    }
+
+    return queue->array + queue->elementsize * index;
+}
+
 /**
  * Advance the input queue index to complete a "push" operation.
  * @param queue Lockless queue instance
@@ -133,6 +176,49 @@ fluid_ringbuffer_next_outptr(fluid_ringbuffer_t *queue)
     }
 }
 
+/**
+ * Get the elements that can be popped at once.
+ * @param queue Lockless queue instance
+ * @param outptr Receives the pointer to the first element
+ * @return Number of elements stored one after another from *outptr, 0 if empty.
+ *   Elements after the end of the array are returned by the next call.
+ *
+ * This function along with fluid_ringbuffer_next_outptrs() form a bulk "pop",
+ * which only updates the shared count once for all the elements.
+ */
+static FLUID_INLINE int
+fluid_ringbuffer_get_outptrs(fluid_ringbuffer_t *queue, void **outptr)
+{
+    int count = fluid_ringbuffer_get_count(queue);
+
+    if(count > queue->totalcount - queue->out)
+    {
+        count = queue->totalcount - queue->out;
+    }
+
+    *outptr = queue->array + queue->elementsize * queue->out;
+    return count;
+}
+
+/**
+ * Advance the output queue index to complete a bulk "pop" operation.
+ * @param queue Lockless queue instance
+ * @param count Number of elements consumed, at most the value returned by
+ *   fluid_ringbuffer_get_outptrs()
+ */
+static FLUID_INLINE void
+fluid_ringbuffer_next_outptrs(fluid_ringbuffer_t *queue, int count)
+{
+    fluid_atomic_int_add(&queue->count, -count);
+
+    queue->out += count;
+
+    if(queue->out >= queue->totalcount)
+    {
+        queue->out -= queue->totalcount;
+    }
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -42,6 +42,7 @@ typedef struct
     char *def;
     int hints;
     fluid_list_t *options;
+    fluid_str_options_t fill_options; /* adds the options once they are asked for */
     fluid_str_update_t update;
     void *data;
 } fluid_str_setting_t;
@@ -59,7 +60,7 @@ typedef struct
 
 typedef struct
 {
-    int value;
+    fluid_atomic_int_t value; /* atomic for fluid_settings_handle_getint() */
     int def;
     int min;
     int max;
@@ -86,6 +87,27 @@ typedef struct
     };
 } fluid_setting_node_t;
 
+/* A setting name resolved by new_fluid_settings_handle() */
+struct _fluid_settings_handle_t
+{
+    fluid_settings_t *settings;
+    fluid_setting_node_t *node;
+    char *name;             /* passed to the update callback */
+};
+
+static int fluid_settings_node_setnum(fluid_settings_t *settings, fluid_setting_node_t *node,
+                                      const char *name, double val);
+static int fluid_settings_node_setint(fluid_settings_t *settings, fluid_setting_node_t *node,
+                                      const char *name, int val);
+static void fluid_settings_fill_options(fluid_settings_t *settings, const char *name,
+                                        fluid_setting_node_t **node);
+
+/* The settings registered by fluid_settings_init(), built by the first new_fluid_settings() and
+ * shared by all settings objects, which only get nodes of their own for the settings changed in
+ * them, see fluid_settings_get_own(). Never changed once built, so it's read without locking. */
+static fluid_mutex_t fluid_settings_defaults_mutex = FLUID_MUTEX_INIT;
+static fluid_settings_t *fluid_settings_defaults = NULL;
+
 static fluid_setting_node_t *
 new_fluid_str_setting(const char *value, const char *def, int hints)
 {
@@ -107,6 +129,7 @@ new_fluid_str_setting(const char *value, const char *def, int hints)
     str->def = def ? FLUID_STRDUP(def) : NULL;
     str->hints = hints;
     str->options = NULL;
+    str->fill_options = NULL;
     str->update = NULL;
     str->data = NULL;
     return node;
@@ -193,7 +216,7 @@ new_fluid_int_setting(int min, int max, int def, int hints)
     node->type = FLUID_INT_TYPE;
 
     i = &node->i;
-    i->value = def;
+    fluid_atomic_int_set(&i->value, def);
     i->def = def;
     i->min = min;
     i->max = max;
@@ -252,9 +275,80 @@ delete_fluid_set_setting(fluid_setting_node_t *node)
     FLUID_FREE(node);
 }
 
+/* Copies a string, numeric or integer setting, without its update callback */
+static fluid_setting_node_t *
+fluid_settings_copy_node(fluid_setting_node_t *node)
+{
+    fluid_setting_node_t *copy = NULL;
+    fluid_list_t *list;
+
+    switch(node->type)
+    {
+    case FLUID_STR_TYPE:
+        copy = new_fluid_str_setting(node->str.value, node->str.def, node->str.hints);
+
+        if(copy)
+        {
+            copy->str.fill_options = node->str.fill_options;
+        }
+
+        for(list = node->str.options; copy && list; list = fluid_list_next(list))
+        {
+            copy->str.options = fluid_list_append(copy->str.options,
+                                                  FLUID_STRDUP(list->data));
+        }
+
+        break;
+
+    case FLUID_NUM_TYPE:
+        copy = new_fluid_num_setting(node->num.min, node->num.max, node->num.def, node->num.hints);
+
+        if(copy)
+        {
+            copy->num.value = node->num.value;
+        }
+
+        break;
+
+    case FLUID_INT_TYPE:
+        copy = new_fluid_int_setting(node->i.min, node->i.max, node->i.def, node->i.hints);
+
+        if(copy)
+        {
+            fluid_atomic_int_set(&copy->i.value, fluid_atomic_int_get(&node->i.value));
+        }
+
+        break;
+    }
+
+    return copy;
+}
+
+static fluid_settings_t *
+new_fluid_settings_table(void)
+{
+    fluid_settings_t *settings;
+
+    settings = new_fluid_hashtable_full(fluid_str_hash, fluid_str_equal,
+                                        fluid_settings_key_destroy_func,
+                                        fluid_settings_value_destroy_func);
+
+    if(settings == NULL)
+    {
+        return NULL;
+    }
+
+    fluid_rec_mutex_init(settings->mutex);
+    settings->defaults = NULL;
+    return settings;
+}
+
 /**
  * Create a new settings object
  *
+ * The settings of fluidsynth and its drivers are registered once per process, by the first call,
+ * and the settings object only keeps copies of those changed in it.
+ *
  * @return the pointer to the settings object
  */
 fluid_settings_t *
@@ -262,20 +356,53 @@ new_fluid_settings(void)
 {
     fluid_settings_t *settings;
 
-    settings = new_fluid_hashtable_full(fluid_str_hash, fluid_str_equal,
-                                        fluid_settings_key_destroy_func,
-                                        fluid_settings_value_destroy_func);
+    settings = new_fluid_settings_table();
 
     if(settings == NULL)
     {
         return NULL;
     }
 
-    fluid_rec_mutex_init(settings->mutex);
-    fluid_settings_init(settings);
+    fluid_mutex_lock(fluid_settings_defaults_mutex);
+
+    if(fluid_settings_defaults == NULL)
+    {
+        fluid_settings_defaults = new_fluid_settings_table();
+
+        if(fluid_settings_defaults != NULL)
+        {
+            fluid_settings_init(fluid_settings_defaults);
+        }
+    }
+
+    settings->defaults = fluid_settings_defaults;
+    fluid_mutex_unlock(fluid_settings_defaults_mutex);
+
+    if(settings->defaults == NULL)
+    {
+        delete_fluid_settings(settings);
+        return NULL;
+    }
+
     return settings;
 }
 
+/* Drops the default settings, so that the next new_fluid_settings() registers them again.
+ * Must not be called while any settings object is alive. */
+void
+fluid_settings_reset_defaults(void)
+{
+    fluid_mutex_lock(fluid_settings_defaults_mutex);
+
+    if(fluid_settings_defaults != NULL)
+    {
+        delete_fluid_settings(fluid_settings_defaults);
+        fluid_settings_defaults = NULL;
+    }
+
+    fluid_mutex_unlock(fluid_settings_defaults_mutex);
+}
+
 /**
  * Delete the provided settings object
  *
@@ -369,27 +496,15 @@ fluid_settings_tokenize(const char *s, char *buf, char **ptr)
     return n;
 }
 
-/**
- * Get a setting name, value and type
- *
- * @param settings a settings object
- * @param name Settings name
- * @param value Location to store setting node if found
- * @return #FLUID_OK if the node exists, #FLUID_FAILED otherwise
- */
+/* Looks up the node of a tokenized setting name in a single settings tree */
 static int
-fluid_settings_get(fluid_settings_t *settings, const char *name,
-                   fluid_setting_node_t **value)
+fluid_settings_lookup(fluid_settings_t *settings, char **tokens, int ntokens,
+                      fluid_setting_node_t **value)
 {
     fluid_hashtable_t *table = settings;
     fluid_setting_node_t *node = NULL;
-    char *tokens[MAX_SETTINGS_TOKENS];
-    char buf[MAX_SETTINGS_LABEL + 1];
-    int ntokens;
     int n;
 
-    ntokens = fluid_settings_tokenize(name, buf, tokens);
-
     if(table == NULL || ntokens <= 0)
     {
         return FLUID_FAILED;
@@ -416,6 +531,34 @@ fluid_settings_get(fluid_settings_t *settings, const char *name,
     return FLUID_OK;
 }
 
+/**
+ * Get a setting name, value and type
+ *
+ * The node returned may be the one of the default settings, which must not be changed.
+ *
+ * @param settings a settings object
+ * @param name Settings name
+ * @param value Location to store setting node if found
+ * @return #FLUID_OK if the node exists, #FLUID_FAILED otherwise
+ */
+static int
+fluid_settings_get(fluid_settings_t *settings, const char *name,
+                   fluid_setting_node_t **value)
+{
+    char *tokens[MAX_SETTINGS_TOKENS];
+    char buf[MAX_SETTINGS_LABEL + 1];
+    int ntokens;
+
+    ntokens = fluid_settings_tokenize(name, buf, tokens);
+
+    if(fluid_settings_lookup(settings, tokens, ntokens, value) == FLUID_OK)
+    {
+        return FLUID_OK;
+    }
+
+    return fluid_settings_lookup(settings->defaults, tokens, ntokens, value);
+}
+
 /**
  * Set a setting name, value and type, replacing it if already exists
  *
@@ -508,6 +651,59 @@ fluid_settings_set(fluid_settings_t *settings, const char *name, fluid_setting_n
     return FLUID_OK;
 }
 
+/**
+ * Get a setting node to change, copying the default setting into the settings object first.
+ *
+ * @param settings a settings object
+ * @param name Settings name
+ * @param value Location to store setting node if found
+ * @return #FLUID_OK if the node exists, #FLUID_FAILED otherwise
+ */
+static int
+fluid_settings_get_own(fluid_settings_t *settings, const char *name,
+                       fluid_setting_node_t **value)
+{
+    fluid_setting_node_t *node, *copy;
+    char *tokens[MAX_SETTINGS_TOKENS];
+    char buf[MAX_SETTINGS_LABEL + 1];
+    int ntokens;
+
+    ntokens = fluid_settings_tokenize(name, buf, tokens);
+
+    if(fluid_settings_lookup(settings, tokens, ntokens, value) == FLUID_OK)
+    {
+        return FLUID_OK;
+    }
+
+    if(fluid_settings_lookup(settings->defaults, tokens, ntokens, &node) != FLUID_OK)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* there is nothing to change in a set node */
+    if(node->type == FLUID_SET_TYPE)
+    {
+        *value = node;
+        return FLUID_OK;
+    }
+
+    copy = fluid_settings_copy_node(node);
+
+    if(copy == NULL)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(fluid_settings_set(settings, name, copy) != FLUID_OK)
+    {
+        fluid_settings_value_destroy_func(copy);
+        return FLUID_FAILED;
+    }
+
+    *value = copy;
+    return FLUID_OK;
+}
+
 /**
  * Registers a new string value for the specified setting.
  *
@@ -529,7 +725,7 @@ fluid_settings_register_str(fluid_settings_t *settings, const char *name, const
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if(fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if(fluid_settings_get_own(settings, name, &node) != FLUID_OK)
     {
         node = new_fluid_str_setting(def, def, hints);
         retval = fluid_settings_set(settings, name, node);
@@ -588,7 +784,7 @@ fluid_settings_register_num(fluid_settings_t *settings, const char *name, double
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if(fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if(fluid_settings_get_own(settings, name, &node) != FLUID_OK)
     {
         /* insert a new setting */
         node = new_fluid_num_setting(min, max, def, hints);
@@ -650,7 +846,7 @@ fluid_settings_register_int(fluid_settings_t *settings, const char *name, int de
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if(fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if(fluid_settings_get_own(settings, name, &node) != FLUID_OK)
     {
         /* insert a new setting */
         node = new_fluid_int_setting(min, max, def, hints);
@@ -706,7 +902,7 @@ int fluid_settings_callback_str(fluid_settings_t *settings, const char *name,
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_own(settings, name, &node) != FLUID_OK)
             || node->type != FLUID_STR_TYPE)
     {
         fluid_rec_mutex_unlock(settings->mutex);
@@ -742,7 +938,7 @@ int fluid_settings_callback_num(fluid_settings_t *settings, const char *name,
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_own(settings, name, &node) != FLUID_OK)
             || node->type != FLUID_NUM_TYPE)
     {
         fluid_rec_mutex_unlock(settings->mutex);
@@ -778,7 +974,7 @@ int fluid_settings_callback_int(fluid_settings_t *settings, const char *name,
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_own(settings, name, &node) != FLUID_OK)
             || node->type != FLUID_INT_TYPE)
     {
         fluid_rec_mutex_unlock(settings->mutex);
@@ -973,7 +1169,7 @@ fluid_settings_setstr(fluid_settings_t *settings, const char *name, const char *
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_own(settings, name, &node) != FLUID_OK)
             || (node->type != FLUID_STR_TYPE))
     {
         FLUID_LOG(FLUID_ERR, "Unknown string setting '%s'", name);
@@ -1069,7 +1265,7 @@ fluid_settings_copystr(fluid_settings_t *settings, const char *name,
 
             if(setting->hints & FLUID_HINT_TOGGLED)
             {
-                FLUID_STRNCPY(str, setting->value ? "yes" : "no", len);
+                FLUID_STRNCPY(str, fluid_atomic_int_get(&setting->value) ? "yes" : "no", len);
 
                 retval = FLUID_OK;
             }
@@ -1134,7 +1330,7 @@ fluid_settings_dupstr(fluid_settings_t *settings, const char *name, char **str)
 
             if(setting->hints & FLUID_HINT_TOGGLED)
             {
-                *str = FLUID_STRDUP(setting->value ? "yes" : "no");
+                *str = FLUID_STRDUP(fluid_atomic_int_get(&setting->value) ? "yes" : "no");
 
                 if(!*str)
                 {
@@ -1193,7 +1389,7 @@ fluid_settings_str_equal(fluid_settings_t *settings, const char *name, const cha
 
             if(setting->hints & FLUID_HINT_TOGGLED)
             {
-                retval = FLUID_STRCMP(setting->value ? "yes" : "no", s) == 0;
+                retval = FLUID_STRCMP(fluid_atomic_int_get(&setting->value) ? "yes" : "no", s) == 0;
             }
         }
     }
@@ -1272,7 +1468,7 @@ fluid_settings_add_option(fluid_settings_t *settings, const char *name, const ch
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if(fluid_settings_get(settings, name, &node) == FLUID_OK
+    if(fluid_settings_get_own(settings, name, &node) == FLUID_OK
             && (node->type == FLUID_STR_TYPE))
     {
         fluid_str_setting_t *setting = &node->str;
@@ -1308,12 +1504,15 @@ fluid_settings_remove_option(fluid_settings_t *settings, const char *name, const
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if(fluid_settings_get(settings, name, &node) == FLUID_OK
+    if(fluid_settings_get_own(settings, name, &node) == FLUID_OK
             && (node->type == FLUID_STR_TYPE))
     {
+        fluid_str_setting_t *setting;
+        fluid_list_t *list;
 
-        fluid_str_setting_t *setting = &node->str;
-        fluid_list_t *list = setting->options;
+        fluid_settings_fill_options(settings, name, &node);
+        setting = &node->str;
+        list = setting->options;
 
         while(list)
         {
@@ -1336,6 +1535,61 @@ fluid_settings_remove_option(fluid_settings_t *settings, const char *name, const
     return retval;
 }
 
+/**
+ * Leave the options of a string setting to a function called when they are first asked for,
+ * instead of adding them at once, e.g. for the devices found by an audio driver.
+ *
+ * The function adds the options with fluid_settings_add_option(), it is called once per
+ * settings object by fluid_settings_foreach_option(), fluid_settings_option_count() and
+ * fluid_settings_option_concat().
+ *
+ * @param settings a settings object
+ * @param name a setting's name
+ * @param fill function adding the options
+ * @return #FLUID_OK if the setting exists and is a string setting, #FLUID_FAILED otherwise
+ */
+int
+fluid_settings_lazy_options(fluid_settings_t *settings, const char *name, fluid_str_options_t fill)
+{
+    fluid_setting_node_t *node;
+    int retval = FLUID_FAILED;
+
+    fluid_return_val_if_fail(settings != NULL, retval);
+    fluid_return_val_if_fail(name != NULL, retval);
+    fluid_return_val_if_fail(name[0] != '\0', retval);
+
+    fluid_rec_mutex_lock(settings->mutex);
+
+    if(fluid_settings_get_own(settings, name, &node) == FLUID_OK
+            && (node->type == FLUID_STR_TYPE))
+    {
+        node->str.fill_options = fill;
+        node->str.hints |= FLUID_HINT_OPTIONLIST;
+        retval = FLUID_OK;
+    }
+
+    fluid_rec_mutex_unlock(settings->mutex);
+
+    return retval;
+}
+
+/* Adds the options left to fluid_settings_lazy_options() to the string setting of node,
+ * which is then replaced by the node of the settings object */
+static void
+fluid_settings_fill_options(fluid_settings_t *settings, const char *name,
+                            fluid_setting_node_t **node)
+{
+    fluid_str_options_t fill = (*node)->str.fill_options;
+
+    if(fill == NULL || fluid_settings_get_own(settings, name, node) != FLUID_OK)
+    {
+        return;
+    }
+
+    (*node)->str.fill_options = NULL;
+    (*fill)(settings, name);
+}
+
 /**
  * Set a numeric value for a named setting.
  *
@@ -1348,9 +1602,6 @@ int
 fluid_settings_setnum(fluid_settings_t *settings, const char *name, double val)
 {
     fluid_setting_node_t *node;
-    fluid_num_setting_t *setting;
-    fluid_num_update_t callback = NULL;
-    void *data = NULL;
 
     fluid_return_val_if_fail(settings != NULL, FLUID_FAILED);
     fluid_return_val_if_fail(name != NULL, FLUID_FAILED);
@@ -1358,19 +1609,37 @@ fluid_settings_setnum(fluid_settings_t *settings, const char *name, double val)
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_own(settings, name, &node) != FLUID_OK)
             || (node->type != FLUID_NUM_TYPE))
     {
         FLUID_LOG(FLUID_ERR, "Unknown numeric setting '%s'", name);
         goto error_recovery;
     }
 
-    setting = &node->num;
+    return fluid_settings_node_setnum(settings, node, name, val);
+
+error_recovery:
+    fluid_rec_mutex_unlock(settings->mutex);
+    return FLUID_FAILED;
+}
+
+/*
+ * Sets the value of a numeric setting node and calls its update callback.
+ * Must be called with the settings mutex locked, which it releases.
+ */
+static int
+fluid_settings_node_setnum(fluid_settings_t *settings, fluid_setting_node_t *node,
+                           const char *name, double val)
+{
+    fluid_num_setting_t *setting = &node->num;
+    fluid_num_update_t callback;
+    void *data;
 
     if(val < setting->min || val > setting->max)
     {
         FLUID_LOG(FLUID_ERR, "requested set value for '%s' out of range", name);
-        goto error_recovery;
+        fluid_rec_mutex_unlock(settings->mutex);
+        return FLUID_FAILED;
     }
 
     setting->value = val;
@@ -1388,10 +1657,6 @@ fluid_settings_setnum(fluid_settings_t *settings, const char *name, double val)
     }
 
     return FLUID_OK;
-
-error_recovery:
-    fluid_rec_mutex_unlock(settings->mutex);
-    return FLUID_FAILED;
 }
 
 /**
@@ -1533,9 +1798,6 @@ int
 fluid_settings_setint(fluid_settings_t *settings, const char *name, int val)
 {
     fluid_setting_node_t *node;
-    fluid_int_setting_t *setting;
-    fluid_int_update_t callback = NULL;
-    void *data = NULL;
 
     fluid_return_val_if_fail(settings != NULL, FLUID_FAILED);
     fluid_return_val_if_fail(name != NULL, FLUID_FAILED);
@@ -1543,22 +1805,40 @@ fluid_settings_setint(fluid_settings_t *settings, const char *name, int val)
 
     fluid_rec_mutex_lock(settings->mutex);
 
-    if((fluid_settings_get(settings, name, &node) != FLUID_OK)
+    if((fluid_settings_get_own(settings, name, &node) != FLUID_OK)
             || (node->type != FLUID_INT_TYPE))
     {
         FLUID_LOG(FLUID_ERR, "Unknown integer parameter '%s'", name);
         goto error_recovery;
     }
 
-    setting = &node->i;
+    return fluid_settings_node_setint(settings, node, name, val);
+
+error_recovery:
+    fluid_rec_mutex_unlock(settings->mutex);
+    return FLUID_FAILED;
+}
+
+/*
+ * Sets the value of an integer setting node and calls its update callback.
+ * Must be called with the settings mutex locked, which it releases.
+ */
+static int
+fluid_settings_node_setint(fluid_settings_t *settings, fluid_setting_node_t *node,
+                           const char *name, int val)
+{
+    fluid_int_setting_t *setting = &node->i;
+    fluid_int_update_t callback;
+    void *data;
 
     if(val < setting->min || val > setting->max)
     {
         FLUID_LOG(FLUID_ERR, "requested set value for setting '%s' out of range", name);
-        goto error_recovery;
+        fluid_rec_mutex_unlock(settings->mutex);
+        return FLUID_FAILED;
     }
 
-    setting->value = val;
+    fluid_atomic_int_set(&setting->value, val);
 
     callback = setting->update;
     data = setting->data;
@@ -1573,10 +1853,6 @@ fluid_settings_setint(fluid_settings_t *settings, const char *name, int val)
     }
 
     return FLUID_OK;
-
-error_recovery:
-    fluid_rec_mutex_unlock(settings->mutex);
-    return FLUID_FAILED;
 }
 
 /**
@@ -1604,7 +1880,7 @@ fluid_settings_getint(fluid_settings_t *settings, const char *name, int *val)
             && (node->type == FLUID_INT_TYPE))
     {
         fluid_int_setting_t *setting = &node->i;
-        *val = setting->value;
+        *val = fluid_atomic_int_get(&setting->value);
         retval = FLUID_OK;
     }
 
@@ -1684,6 +1960,176 @@ int fluid_settings_getint_default(fluid_settings_t *settings, const char *name,
     return retval;
 }
 
+/**
+ * Resolve the name of a numeric or integer setting once, for repeated access.
+ *
+ * Getting and setting a value by its handle skips parsing the name and looking
+ * it up. Integer values are read without taking the settings lock. Values set
+ * by handle are range checked and call the update callback of the setting, as
+ * if they had been set by name.
+ *
+ * @param settings a settings object
+ * @param name a setting's name
+ * @return a new handle, or NULL if the setting doesn't exist or is neither of
+ * type #FLUID_NUM_TYPE nor #FLUID_INT_TYPE
+ *
+ * @note The handle must be deleted before \p settings.
+ * @since 2.6.0
+ */
+fluid_settings_handle_t *
+new_fluid_settings_handle(fluid_settings_t *settings, const char *name)
+{
+    fluid_settings_handle_t *handle;
+    fluid_setting_node_t *node;
+
+    fluid_return_val_if_fail(settings != NULL, NULL);
+    fluid_return_val_if_fail(name != NULL, NULL);
+    fluid_return_val_if_fail(name[0] != '\0', NULL);
+
+    fluid_rec_mutex_lock(settings->mutex);
+
+    if(fluid_settings_get_own(settings, name, &node) != FLUID_OK
+            || (node->type != FLUID_NUM_TYPE && node->type != FLUID_INT_TYPE))
+    {
+        fluid_rec_mutex_unlock(settings->mutex);
+        FLUID_LOG(FLUID_ERR, "Unknown numeric or integer setting '%s'", name);
+        return NULL;
+    }
+
+    fluid_rec_mutex_unlock(settings->mutex);
+
+    handle = FLUID_NEW(fluid_settings_handle_t);
+
+    if(handle == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    handle->settings = settings;
+    handle->node = node;
+    handle->name = FLUID_STRDUP(name);
+
+    if(handle->name == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        FLUID_FREE(handle);
+        return NULL;
+    }
+
+    return handle;
+}
+
+/**
+ * Delete a setting handle
+ *
+ * @param handle a handle returned by new_fluid_settings_handle()
+ * @since 2.6.0
+ */
+void
+delete_fluid_settings_handle(fluid_settings_handle_t *handle)
+{
+    fluid_return_if_fail(handle != NULL);
+
+    FLUID_FREE(handle->name);
+    FLUID_FREE(handle);
+}
+
+/**
+ * Get the type of the setting of a handle
+ *
+ * @param handle a setting handle
+ * @return #FLUID_NUM_TYPE or #FLUID_INT_TYPE
+ * @since 2.6.0
+ */
+int
+fluid_settings_handle_get_type(fluid_settings_handle_t *handle)
+{
+    fluid_return_val_if_fail(handle != NULL, FLUID_NO_TYPE);
+
+    /* the type of a node never changes */
+    return handle->node->type;
+}
+
+/**
+ * Set the value of a numeric setting by its handle
+ *
+ * @param handle a handle of a numeric setting
+ * @param val new setting's value
+ * @return #FLUID_OK if the value has been set, #FLUID_FAILED otherwise
+ * @since 2.6.0
+ */
+int
+fluid_settings_handle_setnum(fluid_settings_handle_t *handle, double val)
+{
+    fluid_return_val_if_fail(handle != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(handle->node->type == FLUID_NUM_TYPE, FLUID_FAILED);
+
+    fluid_rec_mutex_lock(handle->settings->mutex);
+    return fluid_settings_node_setnum(handle->settings, handle->node, handle->name, val);
+}
+
+/**
+ * Get the value of a numeric setting by its handle
+ *
+ * @param handle a handle of a numeric setting
+ * @param val variable pointer to receive the setting's numeric value
+ * @return #FLUID_OK if the value exists, #FLUID_FAILED otherwise
+ * @since 2.6.0
+ */
+int
+fluid_settings_handle_getnum(fluid_settings_handle_t *handle, double *val)
+{
+    fluid_return_val_if_fail(handle != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(handle->node->type == FLUID_NUM_TYPE, FLUID_FAILED);
+    fluid_return_val_if_fail(val != NULL, FLUID_FAILED);
+
+    /* a double can't be read atomically on every platform */
+    fluid_rec_mutex_lock(handle->settings->mutex);
+    *val = handle->node->num.value;
+    fluid_rec_mutex_unlock(handle->settings->mutex);
+
+    return FLUID_OK;
+}
+
+/**
+ * Set the value of an integer setting by its handle
+ *
+ * @param handle a handle of an integer setting
+ * @param val new setting's integer value
+ * @return #FLUID_OK if the value has been set, #FLUID_FAILED otherwise
+ * @since 2.6.0
+ */
+int
+fluid_settings_handle_setint(fluid_settings_handle_t *handle, int val)
+{
+    fluid_return_val_if_fail(handle != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(handle->node->type == FLUID_INT_TYPE, FLUID_FAILED);
+
+    fluid_rec_mutex_lock(handle->settings->mutex);
+    return fluid_settings_node_setint(handle->settings, handle->node, handle->name, val);
+}
+
+/**
+ * Get the value of an integer setting by its handle, without locking
+ *
+ * @param handle a handle of an integer setting
+ * @param val pointer to a variable to receive the setting's integer value
+ * @return #FLUID_OK if the value exists, #FLUID_FAILED otherwise
+ * @since 2.6.0
+ */
+int
+fluid_settings_handle_getint(fluid_settings_handle_t *handle, int *val)
+{
+    fluid_return_val_if_fail(handle != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(handle->node->type == FLUID_INT_TYPE, FLUID_FAILED);
+    fluid_return_val_if_fail(val != NULL, FLUID_FAILED);
+
+    *val = fluid_atomic_int_get(&handle->node->i.value);
+
+    return FLUID_OK;
+}
+
 /**
  * Iterate the available options for a named string setting, calling the provided
  * callback function for each existing option.
@@ -1718,6 +2164,7 @@ fluid_settings_foreach_option(fluid_settings_t *settings, const char *name,
         return;
     }
 
+    fluid_settings_fill_options(settings, name, &node);
     setting = &node->str;
 
     /* Duplicate option list */
@@ -1764,6 +2211,7 @@ fluid_settings_option_count(fluid_settings_t *settings, const char *name)
     if(fluid_settings_get(settings, name, &node) == FLUID_OK
             && node->type == FLUID_STR_TYPE)
     {
+        fluid_settings_fill_options(settings, name, &node);
         count = fluid_list_size(node->str.options);
     }
 
@@ -1810,6 +2258,8 @@ fluid_settings_option_concat(fluid_settings_t *settings, const char *name,
         return (NULL);
     }
 
+    fluid_settings_fill_options(settings, name, &node);
+
     /* Duplicate option list, count options and get total string length */
     for(p = node->str.options, count = 0, len = 0; p; p = p->next)
     {
@@ -1914,6 +2364,38 @@ fluid_settings_foreach_iter(void *key, void *value, void *data)
     return 0;
 }
 
+/* Copies all default settings into the settings object, which then doesn't need them anymore */
+static void
+fluid_settings_materialize(fluid_settings_t *settings)
+{
+    fluid_settings_foreach_bag_t bag;
+    fluid_setting_node_t *node;
+    fluid_list_t *p;
+    int retval = FLUID_OK;
+
+    bag.path[0] = 0;
+    bag.names = NULL;
+
+    fluid_hashtable_foreach(settings->defaults, fluid_settings_foreach_iter, &bag);
+
+    for(p = bag.names; p; p = p->next)
+    {
+        if(fluid_settings_get_own(settings, (const char *)(p->data), &node) != FLUID_OK)
+        {
+            retval = FLUID_FAILED;
+        }
+
+        FLUID_FREE(p->data);
+    }
+
+    delete_fluid_list(bag.names);
+
+    if(retval == FLUID_OK)
+    {
+        settings->defaults = NULL;
+    }
+}
+
 /**
  * Iterate the existing settings defined in a settings object, calling the
  * provided callback function for each setting.
@@ -1941,6 +2423,11 @@ fluid_settings_foreach(fluid_settings_t *settings, void *data,
 
     fluid_rec_mutex_lock(settings->mutex);
 
+    if(settings->defaults != NULL)
+    {
+        fluid_settings_materialize(settings);
+    }
+
     /* Add all node names to the bag.names list */
     fluid_hashtable_foreach(settings, fluid_settings_foreach_iter, &bag);
 
@@ -1997,3 +2484,88 @@ int fluid_settings_split_csv(const char *str, int *buf, int buf_len)
 
     return n;
 }
+
+/**
+ * Split a comma-separated list of CPU numbers and CPU ranges (e.g. "0-3,8")
+ * and fill the passed in buffer with the CPU numbers.
+ *
+ * @param str the CPU list to split
+ * @param buf user-supplied buffer to hold the CPU numbers
+ * @param buf_len length of user-supplied buffer
+ * @return number of CPUs or -1 if the list is malformed
+ */
+int fluid_settings_split_cpu_list(const char *str, int *buf, int buf_len)
+{
+    char *s;
+    char *tok;
+    char *tokstr;
+    int n = 0;
+
+    s = tokstr = FLUID_STRDUP(str);
+
+    if(s == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return -1;
+    }
+
+    while((tok = fluid_strtok(&tokstr, ",")) && n < buf_len)
+    {
+        char *end;
+        long first, last;
+
+        first = last = strtol(tok, &end, 10);
+
+        if(end != tok && *end == '-')
+        {
+            tok = end + 1;
+            last = strtol(tok, &end, 10);
+        }
+
+        if(end == tok || *end != '\0' || first < 0 || last < first)
+        {
+            FLUID_LOG(FLUID_ERR, "Invalid CPU list '%s'", str);
+            n = -1;
+            break;
+        }
+
+        for(; first <= last && n < buf_len; first++)
+        {
+            buf[n++] = (int)first;
+        }
+    }
+
+    FLUID_FREE(s);
+
+    return n;
+}
+
+/**
+ * Get the CPUs listed by a string setting, see fluid_settings_split_cpu_list().
+ *
+ * @param settings a settings object
+ * @param name a setting's name
+ * @param buf user-supplied buffer to hold the CPU numbers
+ * @param buf_len length of user-supplied buffer
+ * @return number of CPUs, 0 if the setting is empty or malformed
+ */
+int fluid_settings_get_cpu_list(fluid_settings_t *settings, const char *name, int *buf, int buf_len)
+{
+    char *list = NULL;
+    int n = 0;
+
+    if(fluid_settings_dupstr(settings, name, &list) == FLUID_OK && list != NULL && list[0] != '\0')
+    {
+        n = fluid_settings_split_cpu_list(list, buf, buf_len);
+
+        if(n < 0)
+        {
+            FLUID_LOG(FLUID_WARN, "Ignoring setting '%s'", name);
+            n = 0;
+        }
+    }
+
+    FLUID_FREE(list);
+
+    return n;
+}
@@ -28,6 +28,9 @@ extern "C" {
 int fluid_settings_add_option(fluid_settings_t *settings, const char *name, const char *s);
 int fluid_settings_remove_option(fluid_settings_t *settings, const char *name, const char *s);
 
+typedef void (*fluid_str_options_t)(fluid_settings_t *settings, const char *name);
+int fluid_settings_lazy_options(fluid_settings_t *settings, const char *name, fluid_str_options_t fill);
+
 
 typedef void (*fluid_str_update_t)(void *data, const char *name, const char *value);
 
@@ -54,9 +57,13 @@ int fluid_settings_callback_int(fluid_settings_t *settings, const char *name,
                                 fluid_int_update_t fun, void *data);
 
 int fluid_settings_split_csv(const char *str, int *buf, int buf_len);
+int fluid_settings_split_cpu_list(const char *str, int *buf, int buf_len);
+int fluid_settings_get_cpu_list(fluid_settings_t *settings, const char *name, int *buf, int buf_len);
 
 void* fluid_settings_get_user_data(fluid_settings_t * settings, const char *name);
 
+void fluid_settings_reset_defaults(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -17,6 +17,10 @@
  * <https://www.gnu.org/licenses/>.
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* CPU_SET() and sched_setaffinity() */
+#endif
+
 #include "fluid_sys.h"
 
 
@@ -39,6 +43,37 @@
 #include <android/log.h>
 #endif
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#if HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
+
+#if HAVE_OS_WORKGROUP_H
+#include <os/workgroup.h>
+#endif
+
+#if FLUID_HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+#if HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
+
+#if HAVE_CLOCK_NANOSLEEP
+#include <time.h>
+#endif
+
+#include "fluid_perf.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FLUID_HAVE_MXCSR 1
+#endif
+
 /* WIN32 HACK - Flag used to differentiate between a file descriptor and a socket.
  * Should work, so long as no SOCKET or file descriptor ends up with this bit set. - JG */
 #ifdef _WIN32
@@ -56,6 +91,7 @@
 struct _fluid_timer_t
 {
     long msec;
+    long usec;                    /* the interval in microseconds, msec * 1000 unless created by new_fluid_timer_us() */
 
     // Pointer to a function to be executed by the timer.
     // This field is set to NULL once the timer is finished to indicate completion.
@@ -76,6 +112,43 @@ struct _fluid_server_socket_t
     void *data;
 };
 
+/* Number of clients a poll server socket serves at the same time */
+#define FLUID_POLL_SERVER_MAX_CLIENTS   32
+
+/* Size of the receive buffer of each client of a poll server socket */
+#define FLUID_POLL_SERVER_BUFSIZE       65536
+
+/* Time in ms a poll server socket waits for data before checking whether to quit */
+#define FLUID_POLL_SERVER_TIMEOUT       100
+
+typedef struct
+{
+    fluid_socket_t socket;
+    unsigned char *buf;     /* received data not consumed yet */
+    int fill;               /* number of bytes in buf */
+} fluid_poll_client_t;
+
+struct _fluid_poll_server_socket_t
+{
+    fluid_socket_t socket;
+    fluid_thread_t *thread;
+    int cont;
+    fluid_server_recv_func_t func;
+    void *data;
+    fluid_poll_client_t clients[FLUID_POLL_SERVER_MAX_CLIENTS];
+    int client_count;
+};
+
+struct _fluid_udp_server_socket_t
+{
+    fluid_socket_t socket;
+    fluid_thread_t *thread;
+    int cont;
+    fluid_udp_recv_func_t func;
+    void *data;
+    unsigned char buf[FLUID_POLL_SERVER_BUFSIZE];   /* the datagram received last */
+};
+
 
 static int fluid_istream_gets(fluid_istream_t in, char *buf, int len);
 
@@ -224,9 +297,109 @@ fluid_log(int level, const char *fmt, ...)
     return FLUID_FAILED;
 }
 
+/* Number of synths with synth.rt-alloc-check enabled, allocations are only checked if not 0 */
+static fluid_atomic_int_t rt_alloc_check_users;
+
+/* Number of allocations and frees caught on audio threads, see fluid_rt_alloc_count() */
+static fluid_atomic_int_t rt_alloc_count;
+
+#if defined(_MSC_VER)
+#define FLUID_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define FLUID_THREAD_LOCAL __thread
+#endif
+
+#ifdef FLUID_THREAD_LOCAL
+/* Greater than 0 while the calling thread renders audio, see fluid_rt_thread_enter() */
+static FLUID_THREAD_LOCAL int rt_thread_depth;
+
+/* Set while reporting an allocation, the report itself may allocate */
+static FLUID_THREAD_LOCAL int rt_reporting;
+#endif
+
+/*
+ * Enables (or disables again) the reporting of allocations and frees on the threads
+ * marked by fluid_rt_thread_enter(), see synth.rt-alloc-check. Calls are counted, the
+ * check stays enabled until it has been disabled as often as enabled.
+ */
+void fluid_rt_alloc_check_enable(int enable)
+{
+    fluid_atomic_int_add(&rt_alloc_check_users, enable ? 1 : -1);
+}
+
+/*
+ * Marks the calling thread as rendering audio until the matching fluid_rt_thread_exit().
+ * Calls may be nested.
+ */
+void fluid_rt_thread_enter(void)
+{
+#ifdef FLUID_THREAD_LOCAL
+    rt_thread_depth++;
+#endif
+}
+
+void fluid_rt_thread_exit(void)
+{
+#ifdef FLUID_THREAD_LOCAL
+    rt_thread_depth--;
+#endif
+}
+
+/*
+ * Returns the number of allocations and frees on audio threads reported since the
+ * start of the process.
+ */
+int fluid_rt_alloc_count(void)
+{
+    return fluid_atomic_int_get(&rt_alloc_count);
+}
+
+/* Reports an allocation or free of the calling thread if it renders audio */
+static void fluid_rt_alloc_check(const char *what, size_t len)
+{
+#ifdef FLUID_THREAD_LOCAL
+#if HAVE_EXECINFO_H
+    void *frames[32];
+    int count;
+#endif
+
+    if(rt_thread_depth <= 0 || rt_reporting)
+    {
+        return;
+    }
+
+    rt_reporting = TRUE;
+    fluid_atomic_int_inc(&rt_alloc_count);
+
+    if(len > 0)
+    {
+        FLUID_LOG(FLUID_WARN, "%s of %lu bytes on the audio thread", what, (unsigned long)len);
+    }
+    else
+    {
+        FLUID_LOG(FLUID_WARN, "%s on the audio thread", what);
+    }
+
+#if HAVE_EXECINFO_H
+    /* backtrace_symbols_fd() doesn't allocate, unlike backtrace_symbols() */
+    count = backtrace(frames, sizeof(frames) / sizeof(frames[0]));
+    backtrace_symbols_fd(frames, count, 2);
+#endif
+
+    rt_reporting = FALSE;
+#endif
+}
+
 void* fluid_alloc(size_t len)
 {
-    void* ptr = malloc(len);
+    void* ptr;
+
+    if(fluid_atomic_int_get(&rt_alloc_check_users) > 0)
+    {
+        fluid_rt_alloc_check("Allocation", len);
+    }
+
+    ptr = malloc(len);
 
 #if defined(DEBUG) && !defined(_MSC_VER)
     // garbage initialize allocated memory for debug builds to ease reproducing
@@ -319,9 +492,24 @@ error_recovery:
  */
 void fluid_free(void* ptr)
 {
+    if(ptr != NULL && fluid_atomic_int_get(&rt_alloc_check_users) > 0)
+    {
+        fluid_rt_alloc_check("Free", 0);
+    }
+
     free(ptr);
 }
 
+void* fluid_realloc(void *ptr, size_t len)
+{
+    if(fluid_atomic_int_get(&rt_alloc_check_users) > 0)
+    {
+        fluid_rt_alloc_check("Reallocation", len);
+    }
+
+    return realloc(ptr, len);
+}
+
 /**
  * An improved strtok, still trashes the input string, but is portable and
  * thread safe.  Also skips token chars at beginning of token string and never
@@ -418,7 +606,7 @@ unsigned int fluid_curtime(void)
 }
 
 
-#if !OSAL_embedded
+#if !OSAL_embedded && !OSAL_freertos
 
 #if defined(_WIN32)      /* Windoze specific stuff */
 
@@ -431,6 +619,29 @@ fluid_thread_self_set_prio(int prio_level)
     }
 }
 
+int
+fluid_thread_self_set_affinity(const int *cpus, int cpu_count)
+{
+    DWORD_PTR mask = 0;
+    int i;
+
+    for(i = 0; i < cpu_count; i++)
+    {
+        if(cpus[i] < (int)(sizeof(mask) * 8))
+        {
+            mask |= (DWORD_PTR)1 << cpus[i];
+        }
+    }
+
+    if(mask == 0 || SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+    {
+        FLUID_LOG(FLUID_WARN, "Failed to set thread affinity");
+        return FLUID_FAILED;
+    }
+
+    return FLUID_OK;
+}
+
 
 #elif defined(__OS2__)  /* OS/2 specific stuff */
 
@@ -443,6 +654,13 @@ fluid_thread_self_set_prio(int prio_level)
     }
 }
 
+int
+fluid_thread_self_set_affinity(const int *cpus, int cpu_count)
+{
+    FLUID_LOG(FLUID_WARN, "Setting the thread affinity is not supported on this platform");
+    return FLUID_FAILED;
+}
+
 #else /* POSIX stuff..  Nice POSIX..  Good POSIX. */
 
 void
@@ -474,98 +692,436 @@ fluid_thread_self_set_prio(int prio_level)
     }
 }
 
+/**
+ * Restrict the calling thread to the given CPUs.
+ * @param cpus CPU numbers the thread may run on
+ * @param cpu_count number of elements in \c cpus
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int
+fluid_thread_self_set_affinity(const int *cpus, int cpu_count)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    int i;
+
+    CPU_ZERO(&set);
+
+    for(i = 0; i < cpu_count; i++)
+    {
+        if(cpus[i] < CPU_SETSIZE)
+        {
+            CPU_SET(cpus[i], &set);
+        }
+    }
+
+    /* pid 0 refers to the calling thread */
+    if(CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0)
+    {
+        return FLUID_OK;
+    }
+
+    FLUID_LOG(FLUID_WARN, "Failed to set thread affinity");
+#else
+    FLUID_LOG(FLUID_WARN, "Setting the thread affinity is not supported on this platform");
+#endif
+    return FLUID_FAILED;
+}
+
 
 #endif	// #else    (its POSIX)
 
-#endif	// #if !OSAL_embedded
+#endif	// #if !OSAL_embedded && !OSAL_freertos
 
+#if HAVE_OS_WORKGROUP_H
 
-#if defined(FPE_CHECK) && !defined(_WIN32) && !defined(__OS2__)
+/* The membership of a thread in a workgroup, keeps a reference to the workgroup */
+typedef struct
+{
+    os_workgroup_t workgroup;
+    os_workgroup_join_token_s token;
+} fluid_workgroup_membership_t;
 
-/***************************************************************
- *
- *               Floating point exceptions
- *
- *  The floating point exception functions were taken from Ircam's
- *  jMax source code. https://www.ircam.fr/jmax
- *
- *  FIXME: check in config for i386 machine
- *
- *  Currently not used. I leave the code here in case we want to pick
- *  this up again some time later.
+/**
+ * Make the calling thread a member of the given workgroup, so that it's scheduled like
+ * the real-time thread owning the workgroup, e.g. the IO thread of an audio device.
+ * @param workgroup the os_workgroup_t to join
+ * @param membership returns the membership to pass to fluid_thread_self_leave_workgroup()
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
  */
+int
+fluid_thread_self_join_workgroup(void *workgroup, void **membership)
+{
+    if(__builtin_available(macOS 11.0, iOS 14.0, tvOS 14.0, *))
+    {
+        fluid_workgroup_membership_t *m = FLUID_NEW(fluid_workgroup_membership_t);
 
-/* Exception flags */
-#define _FPU_STATUS_IE    0x001  /* Invalid Operation */
-#define _FPU_STATUS_DE    0x002  /* Denormalized Operand */
-#define _FPU_STATUS_ZE    0x004  /* Zero Divide */
-#define _FPU_STATUS_OE    0x008  /* Overflow */
-#define _FPU_STATUS_UE    0x010  /* Underflow */
-#define _FPU_STATUS_PE    0x020  /* Precision */
-#define _FPU_STATUS_SF    0x040  /* Stack Fault */
-#define _FPU_STATUS_ES    0x080  /* Error Summary Status */
+        if(m == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return FLUID_FAILED;
+        }
 
-/* Macros for accessing the FPU status word.  */
+        m->workgroup = workgroup;
+        os_retain(m->workgroup);
 
-/* get the FPU status */
-#define _FPU_GET_SW(sw) __asm__ ("fnstsw %0" : "=m" (*&sw))
+        if(os_workgroup_join(m->workgroup, &m->token) == 0)
+        {
+            *membership = m;
+            return FLUID_OK;
+        }
 
-/* clear the FPU status */
-#define _FPU_CLR_SW() __asm__ ("fnclex" : : )
+        os_release(m->workgroup);
+        FLUID_FREE(m);
+    }
 
-/* Purpose:
- * Checks, if the floating point unit has produced an exception, print a message
- * if so and clear the exception.
+    FLUID_LOG(FLUID_WARN, "Failed to join the audio workgroup");
+    return FLUID_FAILED;
+}
+
+/**
+ * Leave a workgroup joined by fluid_thread_self_join_workgroup() from the same thread.
+ * @param membership the membership returned when joining
  */
-unsigned int fluid_check_fpe_i386(char *explanation)
+void
+fluid_thread_self_leave_workgroup(void *membership)
 {
-    unsigned int s;
+    fluid_workgroup_membership_t *m = membership;
 
-    _FPU_GET_SW(s);
-    _FPU_CLR_SW();
+    if(__builtin_available(macOS 11.0, iOS 14.0, tvOS 14.0, *))
+    {
+        os_workgroup_leave(m->workgroup, &m->token);
+        os_release(m->workgroup);
+    }
 
-    s &= _FPU_STATUS_IE | _FPU_STATUS_DE | _FPU_STATUS_ZE | _FPU_STATUS_OE | _FPU_STATUS_UE;
+    FLUID_FREE(m);
+}
 
-    if(s)
+/**
+ * Drop a reference to a workgroup, e.g. one handed over to fluid_synth_set_workgroup().
+ * @param workgroup the os_workgroup_t
+ */
+void
+fluid_workgroup_release(void *workgroup)
+{
+    os_release((os_workgroup_t)workgroup);
+}
+
+#else
+
+int
+fluid_thread_self_join_workgroup(void *workgroup, void **membership)
+{
+    FLUID_LOG(FLUID_WARN, "Audio workgroups are not supported on this platform");
+    return FLUID_FAILED;
+}
+
+void
+fluid_thread_self_leave_workgroup(void *membership)
+{
+}
+
+void
+fluid_workgroup_release(void *workgroup)
+{
+}
+
+#endif	// #if HAVE_OS_WORKGROUP_H
+
+#if defined(__linux__) && defined(SYS_sched_setattr) && !OSAL_embedded && !OSAL_freertos
+
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6
+#endif
+
+/* Layout of struct sched_attr of the kernel, glibc doesn't provide it */
+typedef struct
+{
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+} fluid_sched_attr_t;
+
+/**
+ * Switch the calling thread to the SCHED_DEADLINE policy, which guarantees it
+ * \c runtime_us of CPU time within every \c period_us, its deadline being the end
+ * of the period. rtkit cannot grant this policy, so it requires CAP_SYS_NICE.
+ * Furthermore the kernel refuses it to threads restricted to a subset of the CPUs.
+ * On failure the scheduling of the thread is unchanged.
+ * @param runtime_us CPU time reserved per period in microseconds
+ * @param period_us period in microseconds
+ * @return #FLUID_OK on success, #FLUID_FAILED otherwise
+ */
+int
+fluid_thread_self_set_deadline(int runtime_us, int period_us)
+{
+    fluid_sched_attr_t attr;
+
+    fluid_return_val_if_fail(runtime_us > 0 && runtime_us <= period_us, FLUID_FAILED);
+
+    FLUID_MEMSET(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    attr.sched_runtime = (uint64_t)runtime_us * 1000;
+    attr.sched_deadline = attr.sched_period = (uint64_t)period_us * 1000;
+
+    /* pid 0 refers to the calling thread */
+    if(syscall(SYS_sched_setattr, 0, &attr, 0) == 0)
     {
-        FLUID_LOG(FLUID_WARN, "FPE exception (before or in %s): %s%s%s%s%s", explanation,
-                  (s & _FPU_STATUS_IE) ? "Invalid operation " : "",
-                  (s & _FPU_STATUS_DE) ? "Denormal number " : "",
-                  (s & _FPU_STATUS_ZE) ? "Zero divide " : "",
-                  (s & _FPU_STATUS_OE) ? "Overflow " : "",
-                  (s & _FPU_STATUS_UE) ? "Underflow " : "");
+        return FLUID_OK;
     }
 
-    return s;
+    FLUID_LOG(FLUID_WARN, "Failed to set thread to deadline scheduling: %s", strerror(errno));
+    return FLUID_FAILED;
 }
 
-/* Purpose:
- * Clear floating point exception.
- */
-void fluid_clear_fpe_i386(void)
+#else
+
+int
+fluid_thread_self_set_deadline(int runtime_us, int period_us)
 {
-    _FPU_CLR_SW();
+    FLUID_LOG(FLUID_WARN, "Deadline scheduling is not supported on this platform");
+    return FLUID_FAILED;
 }
 
-#endif	// #if defined(FPE_CHECK) && !defined(_WIN32) && !defined(__OS2__)
+#endif
 
 
 /***************************************************************
  *
- *               Profiling (Linux, i586 only)
- *
+ *               Denormal numbers
  */
 
-#if WITH_PROFILING
-/* Profiling interface between profiling command shell and audio rendering API
-  (FluidProfile_0004.pdf- 3.2.2).
-  Macros are in defined in fluid_sys.h.
-*/
+#if FLUID_HAVE_MXCSR
+/* FTZ (flush to zero) and, where every processor has it, DAZ (denormals are zero) */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLUID_FLUSH_DENORMALS_BITS 0x8040
+#else
+#define FLUID_FLUSH_DENORMALS_BITS 0x8000
+#endif
+#elif (defined(__aarch64__) || (defined(__arm__) && defined(__ARM_FP))) && defined(__GNUC__)
+/* FZ (flush to zero) of FPCR, or FPSCR on 32 bit ARM */
+#define FLUID_FLUSH_DENORMALS_BITS (1u << 24)
+#endif
 
 /*
-  -----------------------------------------------------------------------------
-  Shell task side |    Profiling interface               |  Audio task side
-  -----------------------------------------------------------------------------
+ * Makes the floating point unit of the calling thread flush denormal numbers to zero.
+ * @return the previous mode, for fluid_denormals_flush_exit()
+ */
+unsigned int fluid_denormals_flush_enter(void)
+{
+    unsigned int mode = 0;
+
+#if FLUID_HAVE_MXCSR
+    mode = _mm_getcsr();
+
+    if((mode & FLUID_FLUSH_DENORMALS_BITS) != FLUID_FLUSH_DENORMALS_BITS)
+    {
+        _mm_setcsr(mode | FLUID_FLUSH_DENORMALS_BITS);
+    }
+
+#elif defined(__aarch64__) && defined(FLUID_FLUSH_DENORMALS_BITS)
+    unsigned long fpcr;
+
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    mode = (unsigned int)fpcr;
+
+    if((mode & FLUID_FLUSH_DENORMALS_BITS) == 0)
+    {
+        fpcr |= FLUID_FLUSH_DENORMALS_BITS;
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+    }
+
+#elif defined(FLUID_FLUSH_DENORMALS_BITS)
+    __asm__ __volatile__("vmrs %0, fpscr" : "=r"(mode));
+
+    if((mode & FLUID_FLUSH_DENORMALS_BITS) == 0)
+    {
+        __asm__ __volatile__("vmsr fpscr, %0" : : "r"(mode | FLUID_FLUSH_DENORMALS_BITS));
+    }
+
+#endif
+
+    return mode;
+}
+
+/*
+ * Restores the mode of the floating point unit fluid_denormals_flush_enter() returned.
+ */
+void fluid_denormals_flush_exit(unsigned int mode)
+{
+#if FLUID_HAVE_MXCSR
+
+    if((mode & FLUID_FLUSH_DENORMALS_BITS) != FLUID_FLUSH_DENORMALS_BITS)
+    {
+        /* keep the exception flags raised meanwhile, fluid_check_fpe() looks at them */
+        _mm_setcsr((mode & ~0x3fu) | (_mm_getcsr() & 0x3fu));
+    }
+
+#elif defined(__aarch64__) && defined(FLUID_FLUSH_DENORMALS_BITS)
+
+    if((mode & FLUID_FLUSH_DENORMALS_BITS) == 0)
+    {
+        unsigned long fpcr;
+
+        __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+        fpcr &= ~(unsigned long)FLUID_FLUSH_DENORMALS_BITS;
+        __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr));
+    }
+
+#elif defined(FLUID_FLUSH_DENORMALS_BITS)
+
+    if((mode & FLUID_FLUSH_DENORMALS_BITS) == 0)
+    {
+        unsigned int fpscr;
+
+        __asm__ __volatile__("vmrs %0, fpscr" : "=r"(fpscr));
+        __asm__ __volatile__("vmsr fpscr, %0" : : "r"(fpscr & ~FLUID_FLUSH_DENORMALS_BITS));
+    }
+
+#endif
+}
+
+/***************************************************************
+ *
+ *               Spin-waiting
+ */
+
+void fluid_cpu_pause(void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    YieldProcessor();
+#elif defined(__GNUC__) && (defined(__aarch64__) || (defined(__arm__) && defined(__ARM_ARCH) && __ARM_ARCH >= 7))
+    __asm__ __volatile__("yield");
+#endif
+}
+
+
+#if defined(FPE_CHECK) && !defined(_WIN32) && !defined(__OS2__)
+
+/***************************************************************
+ *
+ *               Floating point exceptions
+ *
+ *  The floating point exception functions were taken from Ircam's
+ *  jMax source code. https://www.ircam.fr/jmax
+ *
+ *  FIXME: check in config for i386 machine
+ *
+ *  Currently not used. I leave the code here in case we want to pick
+ *  this up again some time later.
+ */
+
+/* Exception flags */
+#define _FPU_STATUS_IE    0x001  /* Invalid Operation */
+#define _FPU_STATUS_DE    0x002  /* Denormalized Operand */
+#define _FPU_STATUS_ZE    0x004  /* Zero Divide */
+#define _FPU_STATUS_OE    0x008  /* Overflow */
+#define _FPU_STATUS_UE    0x010  /* Underflow */
+#define _FPU_STATUS_PE    0x020  /* Precision */
+#define _FPU_STATUS_SF    0x040  /* Stack Fault */
+#define _FPU_STATUS_ES    0x080  /* Error Summary Status */
+
+/* Macros for accessing the FPU status word.  */
+
+/* get the FPU status */
+#define _FPU_GET_SW(sw) __asm__ ("fnstsw %0" : "=m" (*&sw))
+
+/* clear the FPU status */
+#define _FPU_CLR_SW() __asm__ ("fnclex" : : )
+
+/* Number of checks after which the rate of denormal numbers is logged */
+#define FLUID_FPE_RATE_CHECKS 100000
+
+/* Checks done and checks that found denormal numbers since the rate was logged last */
+static fluid_atomic_int_t fpe_check_count = {0};
+static fluid_atomic_int_t fpe_denormal_count = {0};
+
+/* Purpose:
+ * Checks, if the floating point unit has produced an exception, print a message
+ * if so and clear the exception.
+ */
+unsigned int fluid_check_fpe_i386(char *explanation)
+{
+    unsigned int s;
+    int checks;
+
+    _FPU_GET_SW(s);
+    _FPU_CLR_SW();
+
+#if FLUID_HAVE_MXCSR
+    /* the SSE unit does most of the math, its flags are laid out like those of the FPU */
+    s |= _mm_getcsr() & 0x3f;
+    _mm_setcsr(_mm_getcsr() & ~0x3fu);
+#endif
+
+    s &= _FPU_STATUS_IE | _FPU_STATUS_DE | _FPU_STATUS_ZE | _FPU_STATUS_OE | _FPU_STATUS_UE;
+
+    /* an underflow is where a denormal number comes out, or a zero if they are flushed */
+    if(s & (_FPU_STATUS_DE | _FPU_STATUS_UE))
+    {
+        fluid_atomic_int_inc(&fpe_denormal_count);
+    }
+
+    checks = fluid_atomic_int_exchange_and_add(&fpe_check_count, 1) + 1;
+
+    if(checks == FLUID_FPE_RATE_CHECKS)
+    {
+        int denormals = fluid_atomic_int_exchange_and_add(&fpe_denormal_count, 0);
+
+        fluid_atomic_int_add(&fpe_denormal_count, -denormals);
+        fluid_atomic_int_add(&fpe_check_count, -checks);
+        FLUID_LOG(FLUID_INFO, "FPE check: denormal numbers or underflows in %d of the last %d checks (%.2f%%)",
+                  denormals, checks, 100.0 * denormals / checks);
+    }
+
+    if(s)
+    {
+        FLUID_LOG(FLUID_WARN, "FPE exception (before or in %s): %s%s%s%s%s", explanation,
+                  (s & _FPU_STATUS_IE) ? "Invalid operation " : "",
+                  (s & _FPU_STATUS_DE) ? "Denormal number " : "",
+                  (s & _FPU_STATUS_ZE) ? "Zero divide " : "",
+                  (s & _FPU_STATUS_OE) ? "Overflow " : "",
+                  (s & _FPU_STATUS_UE) ? "Underflow " : "");
+    }
+
+    return s;
+}
+
+/* Purpose:
+ * Clear floating point exception.
+ */
+void fluid_clear_fpe_i386(void)
+{
+    _FPU_CLR_SW();
+}
+
+#endif	// #if defined(FPE_CHECK) && !defined(_WIN32) && !defined(__OS2__)
+
+
+/***************************************************************
+ *
+ *               Profiling (Linux, i586 only)
+ *
+ */
+
+#if WITH_PROFILING
+/* Profiling interface between profiling command shell and audio rendering API
+  (FluidProfile_0004.pdf- 3.2.2).
+  Macros are in defined in fluid_sys.h.
+*/
+
+/*
+  -----------------------------------------------------------------------------
+  Shell task side |    Profiling interface               |  Audio task side
+  -----------------------------------------------------------------------------
   profiling       |    Internal     |      |             |      Audio
   command   <---> |<-- profiling -->| Data |<--macros -->| <--> rendering
   shell           |    API          |      |             |      API
@@ -983,23 +1539,85 @@ fluid_thread_high_prio(fluid_pointer_t data)
 }
 
 
+/*
+ * Sleeps until the given time of fluid_perf_now(). The deadline is absolute, so
+ * the time spent in the callback and the latency of waking up don't add up over
+ * the periods of a timer.
+ */
+static void
+fluid_timer_sleep_until(void *waitable, double deadline)
+{
+#if HAVE_CLOCK_NANOSLEEP
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(deadline / 1000000.0);
+    ts.tv_nsec = (long)((deadline - ts.tv_sec * 1000000.0) * 1000.0);
+
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+
+#else
+    double delay = deadline - fluid_perf_now();
+
+    if(delay <= 0.0)
+    {
+        return;
+    }
+
+#if defined(_WIN32)
+
+    if(waitable != NULL)
+    {
+        LARGE_INTEGER due;
+
+        /* relative, in units of 100 ns */
+        due.QuadPart = -(LONGLONG)(delay * 10.0);
+
+        if(SetWaitableTimer(waitable, &due, 0, NULL, NULL, FALSE))
+        {
+            WaitForSingleObject(waitable, INFINITE);
+            return;
+        }
+    }
+
+#endif
+    fluid_msleep((unsigned int)((delay + 999.0) / 1000.0));
+#endif
+}
+
 static fluid_thread_return_t
 fluid_timer_run(void *data)
 {
     fluid_timer_t *timer;
-    int count = 0;
+    void *waitable = NULL;
+    long long count = 0;
     int cont;
-    long start;
-    long delay;
+    double start;
+    double now;
+    double deadline;
 
     timer = (fluid_timer_t *)data;
 
+#if defined(_WIN32)
+    /* the default timer resolution of Windows is about 15 ms */
+#ifdef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+    waitable = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+
+    if(waitable == NULL)
+    {
+        waitable = CreateWaitableTimerW(NULL, FALSE, NULL);
+    }
+
+#endif
+
     /* keep track of the start time for absolute positioning */
-    start = fluid_curtime();
+    start = fluid_perf_now();
 
     while(timer->cont)
     {
-        cont = (*timer->callback)(timer->data, fluid_curtime() - start);
+        cont = (*timer->callback)(timer->data, (unsigned int)((fluid_perf_now() - start) / 1000.0));
 
         count++;
 
@@ -1008,17 +1626,34 @@ fluid_timer_run(void *data)
             break;
         }
 
-        /* to avoid incremental time errors, calculate the delay between
-           two callbacks bringing in the "absolute" time (count *
-           timer->msec) */
-        delay = (count * timer->msec) - (fluid_curtime() - start);
+        /* to avoid incremental time errors, sleep until the "absolute" time
+           of the next callback (count * timer->usec) */
+        deadline = start + (double)count * timer->usec;
+        now = fluid_perf_now();
 
-        if(delay > 0)
+        /* after a stall longer than a period skip the callbacks missed, rather
+           than calling back in a burst */
+        if(timer->usec > 0 && now > deadline + timer->usec)
         {
-            fluid_msleep(delay);
+            count = (long long)((now - start) / timer->usec);
+            deadline = start + (double)count * timer->usec;
         }
+
+        if(deadline > now)
+        {
+            fluid_timer_sleep_until(waitable, deadline);
+        }
+    }
+
+#if defined(_WIN32)
+
+    if(waitable != NULL)
+    {
+        CloseHandle(waitable);
     }
 
+#endif
+
     FLUID_LOG(FLUID_DBG, "Timer thread finished");
     timer->callback = NULL;
 
@@ -1033,9 +1668,22 @@ fluid_timer_run(void *data)
 fluid_timer_t *
 new_fluid_timer(int msec, fluid_timer_callback_t callback, void *data,
                 int new_thread, int auto_destroy, int high_priority)
+{
+    return new_fluid_timer_us(msec * 1000, callback, data, new_thread, auto_destroy, high_priority);
+}
+
+/*
+ * Like new_fluid_timer(), with the interval given in microseconds. The callback
+ * still receives the time since the start in milliseconds.
+ */
+fluid_timer_t *
+new_fluid_timer_us(int usec, fluid_timer_callback_t callback, void *data,
+                   int new_thread, int auto_destroy, int high_priority)
 {
     fluid_timer_t *timer;
 
+    fluid_return_val_if_fail(usec >= 0, NULL);
+
     timer = FLUID_NEW(fluid_timer_t);
 
     if(timer == NULL)
@@ -1044,7 +1692,8 @@ new_fluid_timer(int msec, fluid_timer_callback_t callback, void *data,
         return NULL;
     }
 
-    timer->msec = msec;
+    timer->msec = usec / 1000;
+    timer->usec = usec;
     timer->callback = callback;
     timer->data = data;
     timer->cont = TRUE ;
@@ -1458,10 +2107,15 @@ static fluid_thread_return_t fluid_server_socket_run(void *data)
     return FLUID_THREAD_RETURN_VALUE;
 }
 
-fluid_server_socket_t *
-new_fluid_server_socket(int port, fluid_server_func_t func, void *data)
+/*
+ * Creates a socket of the given type (SOCK_STREAM or SOCK_DGRAM) bound to the given port
+ * of all interfaces, over IPv6 if possible. Returns INVALID_SOCKET on error.
+ */
+static fluid_socket_t fluid_server_socket_bind(int port, int type)
 {
-    fluid_server_socket_t *server_socket;
+#ifndef _WIN32
+    int reuse = 1;
+#endif
     struct sockaddr_in addr4;
 #ifdef IPV6_SUPPORT
     struct sockaddr_in6 addr6;
@@ -1470,13 +2124,6 @@ new_fluid_server_socket(int port, fluid_server_func_t func, void *data)
     size_t addr_size;
     fluid_socket_t sock;
 
-    fluid_return_val_if_fail(func != NULL, NULL);
-
-    if(fluid_socket_init() != FLUID_OK)
-    {
-        return NULL;
-    }
-
     FLUID_MEMSET(&addr4, 0, sizeof(addr4));
     addr4.sin_family = AF_INET;
     addr4.sin_port = htons((uint16_t)port);
@@ -1490,7 +2137,7 @@ new_fluid_server_socket(int port, fluid_server_func_t func, void *data)
 #endif
 
 #ifdef IPV6_SUPPORT
-    sock = socket(AF_INET6, SOCK_STREAM, 0);
+    sock = socket(AF_INET6, type, 0);
     addr = (const struct sockaddr *) &addr6;
     addr_size = sizeof(addr6);
 
@@ -1498,13 +2145,13 @@ new_fluid_server_socket(int port, fluid_server_func_t func, void *data)
     {
         FLUID_LOG(FLUID_WARN, "Got error %d while trying to create IPv6 server socket (will try with IPv4)", fluid_socket_get_error());
 
-        sock = socket(AF_INET, SOCK_STREAM, 0);
+        sock = socket(AF_INET, type, 0);
         addr = (const struct sockaddr *) &addr4;
         addr_size = sizeof(addr4);
     }
 
 #else
-    sock = socket(AF_INET, SOCK_STREAM, 0);
+    sock = socket(AF_INET, type, 0);
     addr = (const struct sockaddr *) &addr4;
     addr_size = sizeof(addr4);
 #endif
@@ -1512,22 +2159,67 @@ new_fluid_server_socket(int port, fluid_server_func_t func, void *data)
     if(sock == INVALID_SOCKET)
     {
         FLUID_LOG(FLUID_ERR, "Got error %d while trying to create server socket", fluid_socket_get_error());
-        fluid_socket_cleanup();
-        return NULL;
+        return INVALID_SOCKET;
     }
-    
+
+#ifndef _WIN32
+    /* allow restarting the server while connections of the previous one are in TIME_WAIT */
+    if(type == SOCK_STREAM)
+    {
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const void *)&reuse, sizeof(reuse));
+    }
+#endif
+
     if(bind(sock, addr, (int) addr_size) == SOCKET_ERROR)
     {
         FLUID_LOG(FLUID_ERR, "Got error %d while trying to bind server socket", fluid_socket_get_error());
         fluid_socket_close(sock);
-        fluid_socket_cleanup();
-        return NULL;
+        return INVALID_SOCKET;
+    }
+
+    return sock;
+}
+
+/*
+ * Creates a TCP socket listening on the given port of all interfaces, over IPv6 if
+ * possible. Returns INVALID_SOCKET on error.
+ */
+static fluid_socket_t fluid_server_socket_listen(int port)
+{
+    fluid_socket_t sock = fluid_server_socket_bind(port, SOCK_STREAM);
+
+    if(sock == INVALID_SOCKET)
+    {
+        return INVALID_SOCKET;
     }
 
     if(listen(sock, SOMAXCONN) == SOCKET_ERROR)
     {
         FLUID_LOG(FLUID_ERR, "Got error %d while trying to listen on server socket", fluid_socket_get_error());
         fluid_socket_close(sock);
+        return INVALID_SOCKET;
+    }
+
+    return sock;
+}
+
+fluid_server_socket_t *
+new_fluid_server_socket(int port, fluid_server_func_t func, void *data)
+{
+    fluid_server_socket_t *server_socket;
+    fluid_socket_t sock;
+
+    fluid_return_val_if_fail(func != NULL, NULL);
+
+    if(fluid_socket_init() != FLUID_OK)
+    {
+        return NULL;
+    }
+
+    sock = fluid_server_socket_listen(port);
+
+    if(sock == INVALID_SOCKET)
+    {
         fluid_socket_cleanup();
         return NULL;
     }
@@ -1569,6 +2261,10 @@ void delete_fluid_server_socket(fluid_server_socket_t *server_socket)
 
     if(server_socket->socket != INVALID_SOCKET)
     {
+#ifndef _WIN32
+        /* closing alone doesn't wake up a thread blocked in accept() on Linux */
+        shutdown(server_socket->socket, SHUT_RDWR);
+#endif
         fluid_socket_close(server_socket->socket);
     }
 
@@ -1584,6 +2280,371 @@ void delete_fluid_server_socket(fluid_server_socket_t *server_socket)
     fluid_socket_cleanup();
 }
 
+#if defined(_WIN32)
+#define fluid_poll(_fds, _nfds, _timeout)   WSAPoll(_fds, _nfds, _timeout)
+#elif HAVE_POLL_H
+#define fluid_poll(_fds, _nfds, _timeout)   poll(_fds, _nfds, _timeout)
+#endif
+
+#ifdef fluid_poll
+
+/* Closes the connection to a client, the last client takes its place */
+static void fluid_poll_server_socket_drop(fluid_poll_server_socket_t *server_socket, int i)
+{
+    fluid_poll_client_t *client = &server_socket->clients[i];
+
+    FLUID_LOG(FLUID_DBG, "Closing client connection");
+
+    fluid_socket_close(client->socket);
+    FLUID_FREE(client->buf);
+
+    *client = server_socket->clients[--server_socket->client_count];
+}
+
+static void fluid_poll_server_socket_accept(fluid_poll_server_socket_t *server_socket)
+{
+    fluid_poll_client_t *client;
+    fluid_socket_t client_socket;
+    unsigned char *buf;
+
+    client_socket = accept(server_socket->socket, NULL, NULL);
+
+    if(client_socket == INVALID_SOCKET)
+    {
+        FLUID_LOG(FLUID_WARN, "Got error %d while trying to accept connection", fluid_socket_get_error());
+        return;
+    }
+
+    if(server_socket->client_count == FLUID_POLL_SERVER_MAX_CLIENTS)
+    {
+        FLUID_LOG(FLUID_WARN, "Refusing client connection, already serving %d clients", FLUID_POLL_SERVER_MAX_CLIENTS);
+        fluid_socket_close(client_socket);
+        return;
+    }
+
+    buf = FLUID_ARRAY(unsigned char, FLUID_POLL_SERVER_BUFSIZE);
+
+    if(buf == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        fluid_socket_close(client_socket);
+        return;
+    }
+
+    FLUID_LOG(FLUID_DBG, "New client connection");
+
+    client = &server_socket->clients[server_socket->client_count++];
+    client->socket = client_socket;
+    client->buf = buf;
+    client->fill = 0;
+}
+
+/*
+ * Receives the data available from a client and passes everything not consumed
+ * yet to the receive function. Returns FLUID_FAILED if the connection is to be closed.
+ */
+static int fluid_poll_server_socket_recv(fluid_poll_server_socket_t *server_socket,
+                                         fluid_poll_client_t *client)
+{
+    int n;
+
+    n = recv(client->socket, (char *)client->buf + client->fill,
+             FLUID_POLL_SERVER_BUFSIZE - client->fill, 0);
+
+    if(n == SOCKET_ERROR || n == 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    client->fill += n;
+    n = server_socket->func(server_socket->data, client->socket, client->buf, client->fill);
+
+    if(n < 0 || n > client->fill)
+    {
+        return FLUID_FAILED;
+    }
+
+    if(n == 0 && client->fill == FLUID_POLL_SERVER_BUFSIZE)
+    {
+        FLUID_LOG(FLUID_WARN, "Client sent a message larger than %d bytes", FLUID_POLL_SERVER_BUFSIZE);
+        return FLUID_FAILED;
+    }
+
+    client->fill -= n;
+    FLUID_MEMMOVE(client->buf, client->buf + n, client->fill);
+
+    return FLUID_OK;
+}
+
+static fluid_thread_return_t fluid_poll_server_socket_run(void *data)
+{
+    fluid_poll_server_socket_t *server_socket = (fluid_poll_server_socket_t *)data;
+    struct pollfd fds[1 + FLUID_POLL_SERVER_MAX_CLIENTS];
+    int i, n;
+
+    FLUID_LOG(FLUID_DBG, "Server polling for connections");
+
+    while(server_socket->cont)
+    {
+        fds[0].fd = server_socket->socket;
+        fds[0].events = POLLIN;
+
+        for(i = 0; i < server_socket->client_count; i++)
+        {
+            fds[1 + i].fd = server_socket->clients[i].socket;
+            fds[1 + i].events = POLLIN;
+        }
+
+        n = fluid_poll(fds, 1 + server_socket->client_count, FLUID_POLL_SERVER_TIMEOUT);
+
+        if(n == SOCKET_ERROR)
+        {
+#ifndef _WIN32
+            if(errno == EINTR)
+            {
+                continue;
+            }
+#endif
+            FLUID_LOG(FLUID_ERR, "Got error %d while polling server sockets", fluid_socket_get_error());
+            break;
+        }
+
+        /* backwards, so that only clients done already take the place of a dropped one */
+        for(i = server_socket->client_count - 1; i >= 0; i--)
+        {
+            if(fds[1 + i].revents != 0
+                    && fluid_poll_server_socket_recv(server_socket, &server_socket->clients[i]) != FLUID_OK)
+            {
+                fluid_poll_server_socket_drop(server_socket, i);
+            }
+        }
+
+        if(fds[0].revents & POLLIN)
+        {
+            fluid_poll_server_socket_accept(server_socket);
+        }
+    }
+
+    while(server_socket->client_count > 0)
+    {
+        fluid_poll_server_socket_drop(server_socket, server_socket->client_count - 1);
+    }
+
+    FLUID_LOG(FLUID_DBG, "Server closing");
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+#endif /* fluid_poll */
+
+/*
+ * Creates a server socket serving all its clients from a single thread, which waits
+ * for data from any of them with poll(). The data received from a client is passed to
+ * func, together with the data received before and not consumed yet.
+ */
+fluid_poll_server_socket_t *
+new_fluid_poll_server_socket(int port, fluid_server_recv_func_t func, void *data)
+{
+#ifdef fluid_poll
+    fluid_poll_server_socket_t *server_socket;
+    fluid_socket_t sock;
+
+    fluid_return_val_if_fail(func != NULL, NULL);
+
+    if(fluid_socket_init() != FLUID_OK)
+    {
+        return NULL;
+    }
+
+    sock = fluid_server_socket_listen(port);
+
+    if(sock == INVALID_SOCKET)
+    {
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    server_socket = FLUID_NEW(fluid_poll_server_socket_t);
+
+    if(server_socket == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        fluid_socket_close(sock);
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    server_socket->socket = sock;
+    server_socket->func = func;
+    server_socket->data = data;
+    server_socket->cont = 1;
+    server_socket->client_count = 0;
+
+    server_socket->thread = new_fluid_thread("pollserver", fluid_poll_server_socket_run, server_socket,
+                            0, FALSE);
+
+    if(server_socket->thread == NULL)
+    {
+        FLUID_FREE(server_socket);
+        fluid_socket_close(sock);
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    return server_socket;
+#else
+    FLUID_LOG(FLUID_ERR, "poll() is not available on this platform");
+    return NULL;
+#endif
+}
+
+void delete_fluid_poll_server_socket(fluid_poll_server_socket_t *server_socket)
+{
+    fluid_return_if_fail(server_socket != NULL);
+
+    /* the thread notices within FLUID_POLL_SERVER_TIMEOUT and closes the clients */
+    server_socket->cont = 0;
+    fluid_thread_join(server_socket->thread);
+    delete_fluid_thread(server_socket->thread);
+
+    fluid_socket_close(server_socket->socket);
+    FLUID_FREE(server_socket);
+
+    fluid_socket_cleanup();
+}
+
+#ifdef fluid_poll
+
+static fluid_thread_return_t fluid_udp_server_socket_run(void *data)
+{
+    fluid_udp_server_socket_t *server_socket = (fluid_udp_server_socket_t *)data;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    struct pollfd fds;
+    int n;
+
+    FLUID_LOG(FLUID_DBG, "Server waiting for datagrams");
+
+    while(server_socket->cont)
+    {
+        fds.fd = server_socket->socket;
+        fds.events = POLLIN;
+        fds.revents = 0;
+
+        n = fluid_poll(&fds, 1, FLUID_POLL_SERVER_TIMEOUT);
+
+        if(n == SOCKET_ERROR)
+        {
+#ifndef _WIN32
+            if(errno == EINTR)
+            {
+                continue;
+            }
+#endif
+            FLUID_LOG(FLUID_ERR, "Got error %d while polling server socket", fluid_socket_get_error());
+            break;
+        }
+
+        if(n == 0)
+        {
+            continue;
+        }
+
+        addr_len = sizeof(addr);
+        n = recvfrom(server_socket->socket, (char *)server_socket->buf, FLUID_POLL_SERVER_BUFSIZE, 0,
+                     (struct sockaddr *)&addr, &addr_len);
+
+        if(n == SOCKET_ERROR)
+        {
+            /* e.g. the ICMP error of a datagram sent before, the socket keeps working */
+            FLUID_LOG(FLUID_DBG, "Got error %d while receiving a datagram", fluid_socket_get_error());
+            continue;
+        }
+
+        server_socket->func(server_socket->data, server_socket->buf, n, &addr, (int)addr_len);
+    }
+
+    FLUID_LOG(FLUID_DBG, "Server closing");
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+#endif /* fluid_poll */
+
+/*
+ * Creates a UDP socket bound to the given port, whose datagrams are passed to func one
+ * by one, together with the address of their sender, from a thread of the socket.
+ */
+fluid_udp_server_socket_t *
+new_fluid_udp_server_socket(int port, fluid_udp_recv_func_t func, void *data, int prio_level)
+{
+#ifdef fluid_poll
+    fluid_udp_server_socket_t *server_socket;
+    fluid_socket_t sock;
+
+    fluid_return_val_if_fail(func != NULL, NULL);
+
+    if(fluid_socket_init() != FLUID_OK)
+    {
+        return NULL;
+    }
+
+    sock = fluid_server_socket_bind(port, SOCK_DGRAM);
+
+    if(sock == INVALID_SOCKET)
+    {
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    server_socket = FLUID_NEW(fluid_udp_server_socket_t);
+
+    if(server_socket == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        fluid_socket_close(sock);
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    server_socket->socket = sock;
+    server_socket->func = func;
+    server_socket->data = data;
+    server_socket->cont = 1;
+
+    server_socket->thread = new_fluid_thread("udpserver", fluid_udp_server_socket_run, server_socket,
+                            prio_level, FALSE);
+
+    if(server_socket->thread == NULL)
+    {
+        FLUID_FREE(server_socket);
+        fluid_socket_close(sock);
+        fluid_socket_cleanup();
+        return NULL;
+    }
+
+    return server_socket;
+#else
+    FLUID_LOG(FLUID_ERR, "poll() is not available on this platform");
+    return NULL;
+#endif
+}
+
+void delete_fluid_udp_server_socket(fluid_udp_server_socket_t *server_socket)
+{
+    fluid_return_if_fail(server_socket != NULL);
+
+    /* the thread notices within FLUID_POLL_SERVER_TIMEOUT */
+    server_socket->cont = 0;
+    fluid_thread_join(server_socket->thread);
+    delete_fluid_thread(server_socket->thread);
+
+    fluid_socket_close(server_socket->socket);
+    FLUID_FREE(server_socket);
+
+    fluid_socket_cleanup();
+}
+
 #endif // NETWORK_SUPPORT
 
 FILE* fluid_file_open(const char* path, const char** errMsg)
@@ -1697,6 +2758,480 @@ int fluid_file_seek(FILE *fd, fluid_long_long_t ofs, int whence)
     return FLUID_OK;
 }
 
+/*
+ * Maps size bytes of the file starting at offset read-only into memory. The pages are
+ * shared with the page cache, and so with all processes mapping the same file. The
+ * mapping stays valid after closing the file, until it is released with fluid_file_unmap().
+ *
+ * @return A pointer to the data at offset, or NULL if the file cannot be mapped, which is
+ *   always the case on platforms without mmap()
+ */
+void *fluid_file_map(FILE *fd, fluid_long_long_t offset, fluid_long_long_t size, fluid_file_map_t *map)
+{
+#if FLUID_HAVE_FILE_MAP
+    long page_size = sysconf(_SC_PAGESIZE);
+    fluid_long_long_t start, length;
+    struct stat buf;
+    void *addr;
+
+    map->addr = NULL;
+    map->length = 0;
+
+    if(page_size <= 0 || offset < 0 || size <= 0)
+    {
+        return NULL;
+    }
+
+    /* mmap() only accepts offsets at page boundaries */
+    start = offset - offset % page_size;
+    length = offset - start + size;
+
+    /* touching a mapped page beyond the end of the file would raise SIGBUS */
+    if(fstat(fileno(fd), &buf) != 0 || offset + size > (fluid_long_long_t)buf.st_size
+            || (fluid_long_long_t)(off_t)start != start || (fluid_long_long_t)(size_t)length != length)
+    {
+        return NULL;
+    }
+
+    addr = mmap(NULL, (size_t)length, PROT_READ, MAP_SHARED, fileno(fd), (off_t)start);
+
+    if(addr == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    map->addr = addr;
+    map->length = (size_t)length;
+
+    return (char *)addr + (offset - start);
+#else
+    map->addr = NULL;
+    map->length = 0;
+
+    return NULL;
+#endif
+}
+
+/*
+ * Releases a mapping created by fluid_file_map(), does nothing if nothing is mapped.
+ */
+void fluid_file_unmap(fluid_file_map_t *map)
+{
+#if FLUID_HAVE_FILE_MAP
+
+    if(map->addr != NULL)
+    {
+        munmap(map->addr, map->length);
+    }
+
+#endif
+    map->addr = NULL;
+    map->length = 0;
+}
+
+/*
+ * Reads the pages of a mapping created by fluid_file_map() from the file, so that accessing
+ * length bytes at addr later doesn't block. Where the pages cannot be read synchronously,
+ * the operating system is only asked to read them in the background.
+ *
+ * This never accesses the memory itself, so addr may even point to memory that has been
+ * unmapped in the meantime.
+ *
+ * @return FLUID_OK if the pages have been read or the request has been made, FLUID_FAILED
+ *   otherwise, which is always the case on platforms without mmap()
+ */
+int fluid_file_map_prefetch(const void *addr, size_t length)
+{
+#if FLUID_HAVE_FILE_MAP
+    long page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t start;
+
+    if(page_size <= 0 || length == 0)
+    {
+        return FLUID_FAILED;
+    }
+
+    /* madvise() only accepts addresses at page boundaries */
+    start = (uintptr_t)addr - (uintptr_t)addr % (uintptr_t)page_size;
+    length += (uintptr_t)addr - start;
+
+#ifdef MADV_POPULATE_READ
+
+    if(madvise((void *)start, length, MADV_POPULATE_READ) == 0)
+    {
+        return FLUID_OK;
+    }
+
+    /* older kernels don't know MADV_POPULATE_READ */
+    if(errno != EINVAL)
+    {
+        return FLUID_FAILED;
+    }
+
+#endif
+
+    return (madvise((void *)start, length, MADV_WILLNEED) == 0) ? FLUID_OK : FLUID_FAILED;
+#else
+    return FLUID_FAILED;
+#endif
+}
+
+#if FLUID_HAVE_IO_URING && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+
+/* The number of reads fluid_file_uring_read() keeps in flight */
+#define FLUID_FILE_URING_ENTRIES 32
+
+/* Prepares the read of the part of range from done on */
+static void fluid_file_uring_queue(struct io_uring_sqe *sqe, int fd, const fluid_file_range_t *range,
+                                   struct iovec *iov, size_t done, int index)
+{
+    iov->iov_base = (char *)range->buf + done;
+    iov->iov_len = range->length - done;
+
+    FLUID_MEMSET(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->off = (uint64_t)(range->offset + (fluid_long_long_t)done);
+    sqe->addr = (uintptr_t)iov;
+    sqe->len = 1;
+    sqe->user_data = (uint64_t)index;
+}
+
+/*
+ * Reads the ranges through an io_uring created for this call, with up to
+ * FLUID_FILE_URING_ENTRIES reads in flight. Short reads are continued until the range is
+ * complete. The rings are mapped by hand, so that this doesn't need liburing.
+ *
+ * @return FLUID_OK if all ranges have been read, FLUID_FAILED if the kernel doesn't support
+ *   io_uring (or forbids it) or a read failed
+ */
+static int fluid_file_uring_read(int fd, const fluid_file_range_t *ranges, int count)
+{
+    struct io_uring_params params;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    struct iovec *iov = NULL;
+    size_t *done = NULL;
+    void *sq_ring = MAP_FAILED, *cq_ring = MAP_FAILED, *sqe_ring = MAP_FAILED;
+    size_t sq_size, cq_size;
+    unsigned int *sq_tail, *sq_array, *cq_head, *cq_tail;
+    unsigned int sq_mask, cq_mask, tail, head, inflight = 0, to_submit = 0;
+    int ring, next = 0, completed = 0, failed = FALSE, result = FLUID_FAILED;
+
+    FLUID_MEMSET(&params, 0, sizeof(params));
+    ring = (int)syscall(__NR_io_uring_setup, FLUID_FILE_URING_ENTRIES, &params);
+
+    if(ring < 0)
+    {
+        FLUID_LOG(FLUID_DBG, "io_uring is not available: %s", strerror(errno));
+        return FLUID_FAILED;
+    }
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    sq_ring = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+    cq_ring = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+    sqe_ring = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+
+    iov = FLUID_ARRAY(struct iovec, count);
+    done = FLUID_ARRAY(size_t, count);
+
+    if(sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqe_ring == MAP_FAILED || iov == NULL || done == NULL)
+    {
+        goto exit;
+    }
+
+    FLUID_MEMSET(done, 0, count * sizeof(size_t));
+
+    sqes = sqe_ring;
+    sq_tail = (unsigned int *)((char *)sq_ring + params.sq_off.tail);
+    sq_array = (unsigned int *)((char *)sq_ring + params.sq_off.array);
+    sq_mask = *(unsigned int *)((char *)sq_ring + params.sq_off.ring_mask);
+    cq_head = (unsigned int *)((char *)cq_ring + params.cq_off.head);
+    cq_tail = (unsigned int *)((char *)cq_ring + params.cq_off.tail);
+    cq_mask = *(unsigned int *)((char *)cq_ring + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *)((char *)cq_ring + params.cq_off.cqes);
+
+    /* only this thread submits, so the tail it wrote last is still current */
+    tail = *sq_tail;
+
+    /* after a failed read, the reads in flight are still waited for, they write to the buffers */
+    while(inflight > 0 || (!failed && completed < count))
+    {
+        int i;
+
+        /* queue the ranges not started yet, as long as there is room */
+        while(!failed && next < count && inflight < params.sq_entries)
+        {
+            fluid_file_uring_queue(&sqes[tail & sq_mask], fd, &ranges[next], &iov[next], 0, next);
+            sq_array[tail & sq_mask] = tail & sq_mask;
+
+            tail++;
+            next++;
+            inflight++;
+            to_submit++;
+        }
+
+        __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+        i = (int)syscall(__NR_io_uring_enter, ring, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+        if(i < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            FLUID_LOG(FLUID_ERR, "Failed to submit the reads to io_uring: %s", strerror(errno));
+            goto exit;
+        }
+
+        to_submit -= (unsigned int)i;
+
+        /* reap the completions, continuing the short reads in place of the finished ones */
+        head = *cq_head;
+
+        while(head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+        {
+            struct io_uring_cqe *cqe = &cqes[head & cq_mask];
+
+            i = (int)cqe->user_data;
+            inflight--;
+            head++;
+
+            if(cqe->res == -EINTR || cqe->res == -EAGAIN)
+            {
+                /* retried below */
+            }
+            else if(cqe->res <= 0)
+            {
+                /* an error, or the end of the file before the end of the range */
+                failed = TRUE;
+                continue;
+            }
+            else if((done[i] += (size_t)cqe->res) == ranges[i].length)
+            {
+                completed++;
+                continue;
+            }
+
+            if(!failed)
+            {
+                fluid_file_uring_queue(&sqes[tail & sq_mask], fd, &ranges[i], &iov[i], done[i], i);
+                sq_array[tail & sq_mask] = tail & sq_mask;
+
+                tail++;
+                inflight++;
+                to_submit++;
+            }
+        }
+
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    if(!failed)
+    {
+        result = FLUID_OK;
+    }
+
+exit:
+    close(ring);
+
+    if(sqe_ring != MAP_FAILED)
+    {
+        munmap(sqe_ring, params.sq_entries * sizeof(struct io_uring_sqe));
+    }
+
+    if(cq_ring != MAP_FAILED)
+    {
+        munmap(cq_ring, cq_size);
+    }
+
+    if(sq_ring != MAP_FAILED)
+    {
+        munmap(sq_ring, sq_size);
+    }
+
+    FLUID_FREE(iov);
+    FLUID_FREE(done);
+
+    return result;
+}
+
+#endif
+
+#if FLUID_HAVE_FILE_PREAD
+
+/* The number of threads fluid_file_pread_ranges() reads with, including the calling one */
+#define FLUID_FILE_READ_THREADS 4
+
+typedef struct
+{
+    int fd;
+    const fluid_file_range_t *ranges;
+    int count;
+    fluid_atomic_int_t next;        /* the next range to read */
+    fluid_atomic_int_t failed;      /* TRUE once a read failed */
+} fluid_file_pread_t;
+
+static fluid_thread_return_t fluid_file_pread_thread(void *data)
+{
+    fluid_file_pread_t *job = data;
+    int i;
+
+    while((i = fluid_atomic_int_exchange_and_add(&job->next, 1)) < job->count
+            && !fluid_atomic_int_get(&job->failed))
+    {
+        char *buf = job->ranges[i].buf;
+        size_t done = 0;
+        ssize_t n;
+
+        while(done < job->ranges[i].length)
+        {
+            n = pread(job->fd, buf + done, job->ranges[i].length - done,
+                      (off_t)(job->ranges[i].offset + (fluid_long_long_t)done));
+
+            if(n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if(n <= 0)
+            {
+                fluid_atomic_int_set(&job->failed, TRUE);
+                return FLUID_THREAD_RETURN_VALUE;
+            }
+
+            done += (size_t)n;
+        }
+    }
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+/*
+ * Reads the ranges with pread() from FLUID_FILE_READ_THREADS threads, which take the next
+ * range to read from a shared counter.
+ */
+static int fluid_file_pread_ranges(int fd, const fluid_file_range_t *ranges, int count)
+{
+    fluid_thread_t *threads[FLUID_FILE_READ_THREADS - 1];
+    fluid_file_pread_t job;
+    int i, num_threads = 0;
+
+    job.fd = fd;
+    job.ranges = ranges;
+    job.count = count;
+    fluid_atomic_int_set(&job.next, 0);
+    fluid_atomic_int_set(&job.failed, FALSE);
+
+    for(i = 0; i < FLUID_FILE_READ_THREADS - 1 && i < count - 1; i++)
+    {
+        threads[num_threads] = new_fluid_thread("file-read", fluid_file_pread_thread, &job, 0, FALSE);
+
+        /* the ranges are read by fewer threads then */
+        if(threads[num_threads] != NULL)
+        {
+            num_threads++;
+        }
+    }
+
+    fluid_file_pread_thread(&job);
+
+    for(i = 0; i < num_threads; i++)
+    {
+        fluid_thread_join(threads[i]);
+        delete_fluid_thread(threads[i]);
+    }
+
+    return fluid_atomic_int_get(&job.failed) ? FLUID_FAILED : FLUID_OK;
+}
+
+#endif
+
+/*
+ * Reads count ranges of a file into memory, with many reads in flight at the same time: on
+ * Linux they are submitted to an io_uring, elsewhere, or if the kernel doesn't offer io_uring,
+ * they are read by a few threads. The position of the file is not used nor changed, so this
+ * may run while other threads read the file by fluid_file_read().
+ *
+ * Each range must lie within the file.
+ *
+ * @return FLUID_OK if all ranges have been read, FLUID_FAILED otherwise, in which case the
+ *   contents of the buffers are undefined. Always FLUID_FAILED on platforms without pread(),
+ *   so that the caller falls back to reading the ranges one by one.
+ */
+int fluid_file_read_ranges(FILE *fd, const fluid_file_range_t *ranges, int count)
+{
+#if FLUID_HAVE_FILE_PREAD
+    int i;
+
+    fluid_return_val_if_fail(fd != NULL, FLUID_FAILED);
+    fluid_return_val_if_fail(ranges != NULL || count == 0, FLUID_FAILED);
+
+    for(i = 0; i < count; i++)
+    {
+        if(ranges[i].offset < 0 || (fluid_long_long_t)(off_t)ranges[i].offset != ranges[i].offset)
+        {
+            return FLUID_FAILED;
+        }
+    }
+
+    if(count == 0)
+    {
+        return FLUID_OK;
+    }
+
+#if FLUID_HAVE_IO_URING && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+
+    if(fluid_file_uring_read(fileno(fd), ranges, count) == FLUID_OK)
+    {
+        return FLUID_OK;
+    }
+
+#endif
+
+    return fluid_file_pread_ranges(fileno(fd), ranges, count);
+#else
+    return FLUID_FAILED;
+#endif
+}
+
+/*
+ * Allocates len bytes like FLUID_MALLOC(). If huge_pages is set and there is at least one huge
+ * page to fill, the memory starts at a huge page boundary and the operating system is asked to
+ * back it by transparent huge pages when it is first touched. Otherwise, or if that isn't
+ * possible, it's allocated by FLUID_MALLOC().
+ *
+ * Either way, the memory is freed by FLUID_FREE() and can be locked by fluid_mlock().
+ *
+ * @return the memory, NULL if out of memory
+ */
+void *fluid_alloc_huge(size_t len, int huge_pages)
+{
+#if FLUID_HAVE_HUGE_PAGES
+    void *ptr;
+
+    if(huge_pages && len >= FLUID_HUGE_PAGE_SIZE
+            && posix_memalign(&ptr, FLUID_HUGE_PAGE_SIZE, len) == 0)
+    {
+        /* it's okay if this fails, the memory is backed by normal pages then */
+        if(madvise(ptr, len, MADV_HUGEPAGE) != 0)
+        {
+            FLUID_LOG(FLUID_DBG, "Transparent huge pages are not available");
+        }
+
+        return ptr;
+    }
+
+#endif
+
+    return FLUID_MALLOC(len);
+}
+
 #undef FLUID_PRIi64
 
 #if defined(_WIN32) || defined(__CYGWIN__)
@@ -92,6 +92,10 @@
 #include <arpa/inet.h>
 #endif
 
+#if HAVE_POLL_H
+#include <poll.h>
+#endif
+
 #if HAVE_LIMITS_H
 #include <limits.h>
 #endif
@@ -120,6 +124,8 @@
 #include "fluid_sys_embedded.h"
 #elif OSAL_cpp11
 #include "fluid_sys_cpp11.h"
+#elif OSAL_freertos
+#include "fluid_sys_freertos.h"
 #else
 #error "no OS abstraction configured"
 #endif
@@ -237,6 +243,9 @@ typedef struct _fluid_timer_t fluid_timer_t;
 fluid_timer_t *new_fluid_timer(int msec, fluid_timer_callback_t callback,
                                void *data, int new_thread, int auto_destroy,
                                int high_priority);
+fluid_timer_t *new_fluid_timer_us(int usec, fluid_timer_callback_t callback,
+                                  void *data, int new_thread, int auto_destroy,
+                                  int high_priority);
 
 void delete_fluid_timer(fluid_timer_t *timer);
 int fluid_timer_join(fluid_timer_t *timer);
@@ -279,6 +288,16 @@ fluid_thread_t *new_fluid_thread(const char *name, fluid_thread_func_t func, voi
                                  int prio_level, int detach);
 void delete_fluid_thread(fluid_thread_t *thread);
 void fluid_thread_self_set_prio(int prio_level);
+int fluid_thread_self_set_affinity(const int *cpus, int cpu_count);
+int fluid_thread_self_set_deadline(int runtime_us, int period_us);
+
+/* Audio workgroups (os_workgroup_t) on Apple platforms, stubs elsewhere */
+int fluid_thread_self_join_workgroup(void *workgroup, void **membership);
+void fluid_thread_self_leave_workgroup(void *membership);
+void fluid_workgroup_release(void *workgroup);
+
+/* Maximum number of CPUs that can be given in a CPU affinity list */
+#define FLUID_MAX_CPU_AFFINITY 256
 
 int fluid_thread_join(fluid_thread_t *thread);
 
@@ -302,6 +321,26 @@ typedef int (*fluid_server_func_t)(void *data, fluid_socket_t client_socket, cha
 fluid_server_socket_t *new_fluid_server_socket(int port, fluid_server_func_t func, void *data);
 void delete_fluid_server_socket(fluid_server_socket_t *sock);
 int fluid_server_socket_join(fluid_server_socket_t *sock);
+/* Called with the data received from a client of a poll server socket, including the
+   data received before that hasn't been consumed yet. The function should return the
+   number of bytes it consumed from the beginning of buf, the rest is passed again with
+   the next data received. If it returns -1, the connection to the client is closed.
+   client_socket may be used to reply. */
+typedef int (*fluid_server_recv_func_t)(void *data, fluid_socket_t client_socket,
+                                        const unsigned char *buf, int len);
+
+fluid_poll_server_socket_t *new_fluid_poll_server_socket(int port, fluid_server_recv_func_t func, void *data);
+void delete_fluid_poll_server_socket(fluid_poll_server_socket_t *sock);
+
+/* Called with each datagram received by a UDP server socket, addr holds the address of
+   its sender, addr_len bytes long. */
+typedef void (*fluid_udp_recv_func_t)(void *data, const unsigned char *buf, int len,
+                                      const void *addr, int addr_len);
+
+fluid_udp_server_socket_t *new_fluid_udp_server_socket(int port, fluid_udp_recv_func_t func, void *data,
+        int prio_level);
+void delete_fluid_udp_server_socket(fluid_udp_server_socket_t *sock);
+
 void fluid_socket_close(fluid_socket_t sock);
 fluid_istream_t fluid_socket_get_istream(fluid_socket_t sock);
 fluid_ostream_t fluid_socket_get_ostream(fluid_socket_t sock);
@@ -312,6 +351,49 @@ fluid_long_long_t fluid_file_tell(FILE* f);
 int fluid_file_read(void *buf, fluid_long_long_t count, FILE *fd);
 int fluid_file_seek(FILE *fd, fluid_long_long_t ofs, int whence);
 
+/* Whether fluid_file_map() is able to map files on this platform */
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_UNISTD_H) && defined(HAVE_SYS_STAT_H) && !defined(__OS2__)
+#define FLUID_HAVE_FILE_MAP 1
+#else
+#define FLUID_HAVE_FILE_MAP 0
+#endif
+
+/* A read-only memory mapping of a part of a file, see fluid_file_map() */
+typedef struct
+{
+    void *addr;     /* start of the mapping, NULL if nothing is mapped */
+    size_t length;  /* length of the mapping in bytes */
+} fluid_file_map_t;
+
+void *fluid_file_map(FILE *fd, fluid_long_long_t offset, fluid_long_long_t size, fluid_file_map_t *map);
+void fluid_file_unmap(fluid_file_map_t *map);
+int fluid_file_map_prefetch(const void *addr, size_t length);
+
+/* Whether fluid_file_read_ranges() is able to read files in parallel on this platform */
+#if defined(HAVE_UNISTD_H) && !defined(_WIN32) && !defined(__OS2__)
+#define FLUID_HAVE_FILE_PREAD 1
+#else
+#define FLUID_HAVE_FILE_PREAD 0
+#endif
+
+/* Whether fluid_file_read_ranges() submits the reads to an io_uring first */
+#if FLUID_HAVE_FILE_PREAD && FLUID_HAVE_FILE_MAP && defined(HAVE_LINUX_IO_URING_H) \
+    && defined(HAVE_SYS_SYSCALL_H) && defined(__GNUC__)
+#define FLUID_HAVE_IO_URING 1
+#else
+#define FLUID_HAVE_IO_URING 0
+#endif
+
+/* A range of a file to read by fluid_file_read_ranges() */
+typedef struct
+{
+    fluid_long_long_t offset;   /* position of the range within the file */
+    void *buf;                  /* where to store it */
+    size_t length;              /* length of the range in bytes */
+} fluid_file_range_t;
+
+int fluid_file_read_ranges(FILE *fd, const fluid_file_range_t *ranges, int count);
+
 
 /* Profiling */
 #if WITH_PROFILING
@@ -521,13 +603,75 @@ enum
 #define fluid_munlock(_p,_n)
 #endif
 
+/**
+
+    Huge pages
+
+    Large blocks of sample data can be backed by huge pages to save TLB
+    misses while they are played, see synth.huge-pages.
+ */
+
+#if defined(HAVE_SYS_MMAN_H) && defined(MADV_HUGEPAGE)
+#define FLUID_HAVE_HUGE_PAGES 1
+#else
+#define FLUID_HAVE_HUGE_PAGES 0
+#endif
+
+/* The size of the transparent huge pages on common platforms */
+#define FLUID_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+void *fluid_alloc_huge(size_t len, int huge_pages);
+
+/**
+
+    Allocations on audio threads
+
+    Rendering audio must neither allocate nor free memory, as the allocator
+    may block. With synth.rt-alloc-check, allocations and frees on the threads
+    marked by fluid_rt_thread_enter() are reported with their call stack.
+ */
+
+void fluid_rt_alloc_check_enable(int enable);
+void fluid_rt_thread_enter(void);
+void fluid_rt_thread_exit(void);
+int fluid_rt_alloc_count(void);
+
+
+/**
+
+    Denormal numbers
+
+    Decaying filters, reverb and release tails end up in denormal numbers,
+    which are very slow to compute with on many processors. While rendering,
+    fluid_denormals_flush_enter() makes the floating point unit of the calling
+    thread flush them to zero (FTZ and DAZ on x86, FZ on ARM), see
+    synth.flush-denormals. It returns the previous mode of the thread, which
+    fluid_denormals_flush_exit() restores.
+ */
+
+unsigned int fluid_denormals_flush_enter(void);
+void fluid_denormals_flush_exit(unsigned int mode);
+
+
+/**
+
+    Spin-waiting
+
+    fluid_cpu_pause() tells the processor that the calling thread polls a flag
+    set by another thread. It saves power and leaves the execution units to a
+    sibling hyperthread, which may be the very thread that is waited for.
+ */
+
+void fluid_cpu_pause(void);
+
 
 /**
 
     Floating point exceptions
 
     fluid_check_fpe() checks for "unnormalized numbers" and other
-    exceptions of the floating point processor.
+    exceptions of the floating point processor. It also counts how many
+    checks found denormal numbers and logs that rate now and then.
 */
 #ifdef FPE_CHECK
 #define fluid_check_fpe(expl) fluid_check_fpe_i386(expl)
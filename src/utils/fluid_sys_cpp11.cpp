@@ -190,6 +190,11 @@ void fluid_rec_mutex_unlock(fluid_rec_mutex_t mutex)
     static_cast<std::recursive_mutex *>(mutex)->unlock();
 }
 
+int fluid_rec_mutex_trylock(fluid_rec_mutex_t mutex)
+{
+    return static_cast<std::recursive_mutex *>(mutex)->try_lock() ? TRUE : FALSE;
+}
+
 void fluid_cond_mutex_lock(fluid_cond_mutex_t *mutex)
 {
     ensure_lock_mutex(static_cast<std::mutex *>(mutex));
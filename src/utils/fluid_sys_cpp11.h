@@ -88,6 +88,7 @@ void _fluid_rec_mutex_init(fluid_rec_mutex_t *mutex);
 void fluid_rec_mutex_destroy(fluid_rec_mutex_t mutex);
 void fluid_rec_mutex_lock(fluid_rec_mutex_t mutex);
 void fluid_rec_mutex_unlock(fluid_rec_mutex_t mutex);
+int fluid_rec_mutex_trylock(fluid_rec_mutex_t mutex);
 
 /* Dynamically allocated mutex suitable for fluid_cond_t use */
 typedef void fluid_cond_mutex_t;
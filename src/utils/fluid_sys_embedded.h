@@ -94,6 +94,7 @@ typedef int fluid_rec_mutex_t;
 #define fluid_rec_mutex_destroy(_m)   (_m = 0)
 #define fluid_rec_mutex_lock(_m)      (_m++)
 #define fluid_rec_mutex_unlock(_m)    (_m--)
+#define fluid_rec_mutex_trylock(_m)   (_m++, TRUE)
 
 /* Dynamically allocated mutex suitable for fluid_cond_t use */
 typedef bool fluid_cond_mutex_t;
@@ -221,6 +222,7 @@ STUB_FUNCTION(new_fluid_thread, fluid_thread_t *, NULL, (const char *name, fluid
 STUB_FUNCTION_VOID_SILENT(delete_fluid_thread, (fluid_thread_t *thread))
 STUB_FUNCTION_SILENT(fluid_thread_join, int, FLUID_OK, (fluid_thread_t *thread))
 STUB_FUNCTION_VOID_SILENT(fluid_thread_self_set_prio, (int prio_level))
+STUB_FUNCTION(fluid_thread_self_set_affinity, int, FLUID_FAILED, (const int *cpus, int cpu_count))
 
 
 /* File access */
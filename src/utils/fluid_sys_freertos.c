@@ -0,0 +1,489 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_sys.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#endif
+
+#if configNUM_THREAD_LOCAL_STORAGE_POINTERS < 1
+#error "The FreeRTOS OS abstraction needs a thread local storage pointer for fluid_private_t"
+#endif
+
+/* A task waiting on a condition */
+typedef struct _fluid_cond_waiter_t fluid_cond_waiter_t;
+
+struct _fluid_cond_waiter_t
+{
+    SemaphoreHandle_t sem;      /* given to wake up the task */
+    fluid_cond_waiter_t *next;
+};
+
+struct _fluid_cond_t
+{
+    SemaphoreHandle_t lock;     /* protects the lists, signals may be sent without the mutex */
+    fluid_cond_waiter_t *head;  /* tasks waiting, in the order they started to wait */
+    fluid_cond_waiter_t *tail;
+    fluid_cond_waiter_t *unused; /* waiters of tasks done waiting, kept for reuse */
+};
+
+struct _fluid_thread_t
+{
+    TaskHandle_t task;
+    SemaphoreHandle_t done;     /* given when func returned, NULL if detached */
+    fluid_thread_func_t func;
+    void *data;
+};
+
+/* number of fluid_private_t variables handed out */
+static fluid_atomic_int_t private_count = 0;
+
+
+void fluid_msleep(unsigned int msecs)
+{
+    vTaskDelay(pdMS_TO_TICKS(msecs));
+}
+
+double fluid_utime(void)
+{
+#ifdef ESP_PLATFORM
+    int64_t usec = esp_timer_get_time();
+
+    return usec;
+#else
+    /* only as precise as the tick rate */
+    TickType_t ticks = xTaskGetTickCount();
+
+    return ticks * (1000000.0 / configTICK_RATE_HZ);
+#endif
+}
+
+void _fluid_mutex_init(fluid_mutex_t *mutex)
+{
+    *mutex = xSemaphoreCreateMutex();
+
+    if(*mutex == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory on mutex allocation");
+    }
+}
+
+void fluid_mutex_destroy(fluid_mutex_t mutex)
+{
+    if(mutex != NULL)
+    {
+        vSemaphoreDelete(mutex);
+    }
+}
+
+void _fluid_mutex_lock(fluid_mutex_t *mutex)
+{
+    if(fluid_atomic_pointer_get(mutex) == NULL)
+    {
+        /* First use of a statically initialized mutex. If two tasks get here at
+         * once, the one losing the race deletes its mutex again. */
+        fluid_mutex_t created = xSemaphoreCreateMutex();
+
+        if(created == NULL)
+        {
+            FLUID_LOG(FLUID_PANIC, "Out of memory on mutex allocation");
+            return;
+        }
+
+        if(!fluid_atomic_pointer_compare_and_exchange(mutex, NULL, created))
+        {
+            vSemaphoreDelete(created);
+        }
+    }
+
+    xSemaphoreTake(*mutex, portMAX_DELAY);
+}
+
+void _fluid_rec_mutex_init(fluid_rec_mutex_t *mutex)
+{
+    *mutex = xSemaphoreCreateRecursiveMutex();
+
+    if(*mutex == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory on recursive mutex allocation");
+    }
+}
+
+fluid_cond_mutex_t *new_fluid_cond_mutex(void)
+{
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+
+    if(mutex == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory on condition mutex allocation");
+    }
+
+    return mutex;
+}
+
+void delete_fluid_cond_mutex(fluid_cond_mutex_t *mutex)
+{
+    fluid_return_if_fail(mutex != NULL);
+    vSemaphoreDelete((SemaphoreHandle_t)mutex);
+}
+
+/* Wakes up one waiting task, if there is any */
+void fluid_cond_signal(fluid_cond_t *cond)
+{
+    fluid_cond_waiter_t *waiter;
+
+    xSemaphoreTake(cond->lock, portMAX_DELAY);
+    waiter = cond->head;
+
+    if(waiter != NULL)
+    {
+        cond->head = waiter->next;
+
+        if(cond->head == NULL)
+        {
+            cond->tail = NULL;
+        }
+
+        xSemaphoreGive(waiter->sem);
+    }
+
+    xSemaphoreGive(cond->lock);
+}
+
+/* Wakes up the tasks waiting at the time of the call, tasks waiting after it are not affected */
+void fluid_cond_broadcast(fluid_cond_t *cond)
+{
+    fluid_cond_waiter_t *waiter;
+
+    xSemaphoreTake(cond->lock, portMAX_DELAY);
+
+    for(waiter = cond->head; waiter != NULL; waiter = waiter->next)
+    {
+        xSemaphoreGive(waiter->sem);
+    }
+
+    cond->head = NULL;
+    cond->tail = NULL;
+    xSemaphoreGive(cond->lock);
+}
+
+/* Every waiting task blocks on a semaphore of its own, which is queued before the mutex is
+ * released: a signal sent before the task blocks leaves the semaphore given and isn't lost,
+ * and a task starting to wait after a signal can't take the wakeup meant for another one.
+ * The semaphores are reused, so only the first waits of as many tasks at once allocate. */
+void fluid_cond_wait(fluid_cond_t *cond, fluid_cond_mutex_t *mutex)
+{
+    fluid_cond_waiter_t *waiter;
+
+    xSemaphoreTake(cond->lock, portMAX_DELAY);
+    waiter = cond->unused;
+
+    if(waiter != NULL)
+    {
+        cond->unused = waiter->next;
+    }
+    else
+    {
+        waiter = FLUID_NEW(fluid_cond_waiter_t);
+
+        if(waiter != NULL)
+        {
+            waiter->sem = xSemaphoreCreateBinary();
+
+            if(waiter->sem == NULL)
+            {
+                FLUID_FREE(waiter);
+                waiter = NULL;
+            }
+        }
+
+        if(waiter == NULL)
+        {
+            /* a spurious wakeup is the best that can be done */
+            xSemaphoreGive(cond->lock);
+            FLUID_LOG(FLUID_PANIC, "Out of memory on condition wait");
+            xSemaphoreGive((SemaphoreHandle_t)mutex);
+            vTaskDelay(1);
+            xSemaphoreTake((SemaphoreHandle_t)mutex, portMAX_DELAY);
+            return;
+        }
+    }
+
+    waiter->next = NULL;
+
+    if(cond->tail != NULL)
+    {
+        cond->tail->next = waiter;
+    }
+    else
+    {
+        cond->head = waiter;
+    }
+
+    cond->tail = waiter;
+    xSemaphoreGive(cond->lock);
+
+    xSemaphoreGive((SemaphoreHandle_t)mutex);
+    xSemaphoreTake(waiter->sem, portMAX_DELAY);
+
+    /* the waker has dequeued it */
+    xSemaphoreTake(cond->lock, portMAX_DELAY);
+    waiter->next = cond->unused;
+    cond->unused = waiter;
+    xSemaphoreGive(cond->lock);
+
+    xSemaphoreTake((SemaphoreHandle_t)mutex, portMAX_DELAY);
+}
+
+fluid_cond_t *new_fluid_cond(void)
+{
+    fluid_cond_t *cond = FLUID_NEW(fluid_cond_t);
+
+    if(cond == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory on condition variable allocation");
+        return NULL;
+    }
+
+    FLUID_MEMSET(cond, 0, sizeof(*cond));
+    cond->lock = xSemaphoreCreateMutex();
+
+    if(cond->lock == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory on condition variable allocation");
+        FLUID_FREE(cond);
+        return NULL;
+    }
+
+    return cond;
+}
+
+void delete_fluid_cond(fluid_cond_t *cond)
+{
+    fluid_cond_waiter_t *waiter;
+
+    fluid_return_if_fail(cond != NULL);
+
+    while(cond->unused != NULL)
+    {
+        waiter = cond->unused;
+        cond->unused = waiter->next;
+        vSemaphoreDelete(waiter->sem);
+        FLUID_FREE(waiter);
+    }
+
+    vSemaphoreDelete(cond->lock);
+    FLUID_FREE(cond);
+}
+
+/* The fluid_private_t values of the calling task, allocated on first use */
+static void **
+fluid_private_values(int create)
+{
+    void **values = pvTaskGetThreadLocalStoragePointer(NULL, FLUID_FREERTOS_TLS_INDEX);
+
+    if(values == NULL && create)
+    {
+        values = FLUID_ARRAY(void *, FLUID_FREERTOS_MAX_PRIVATE);
+
+        if(values == NULL)
+        {
+            FLUID_LOG(FLUID_ERR, "Out of memory");
+            return NULL;
+        }
+
+        FLUID_MEMSET(values, 0, FLUID_FREERTOS_MAX_PRIVATE * sizeof(void *));
+        vTaskSetThreadLocalStoragePointer(NULL, FLUID_FREERTOS_TLS_INDEX, values);
+    }
+
+    return values;
+}
+
+/* Index + 1 of the variable in the values of a task, assigned on first use */
+static int
+fluid_private_index(fluid_private_t *priv)
+{
+    int idx = fluid_atomic_int_get(priv);
+
+    if(idx == 0)
+    {
+        int next = fluid_atomic_int_add(&private_count, 1) + 1;
+
+        if(next > FLUID_FREERTOS_MAX_PRIVATE)
+        {
+            FLUID_LOG(FLUID_ERR, "Too many thread private variables, increase FLUID_FREERTOS_MAX_PRIVATE");
+            return 0;
+        }
+
+        /* another task may have been faster, its index wins */
+        idx = fluid_atomic_int_compare_and_exchange(priv, 0, next) ? next : fluid_atomic_int_get(priv);
+    }
+
+    return idx;
+}
+
+void *_fluid_private_get(fluid_private_t *priv)
+{
+    int idx = fluid_private_index(priv);
+    void **values = fluid_private_values(FALSE);
+
+    return (idx > 0 && values != NULL) ? values[idx - 1] : NULL;
+}
+
+void _fluid_private_set(fluid_private_t *priv, void *value)
+{
+    int idx = fluid_private_index(priv);
+    void **values = fluid_private_values(TRUE);
+
+    if(idx > 0 && values != NULL)
+    {
+        values[idx - 1] = value;
+    }
+}
+
+/* Entry point of all tasks created by new_fluid_thread() */
+static void
+fluid_thread_task(void *data)
+{
+    fluid_thread_t *thread = data;
+    void **values;
+
+    thread->func(thread->data);
+
+    /* a task doesn't free its thread local storage when deleted */
+    values = fluid_private_values(FALSE);
+    FLUID_FREE(values);
+
+    if(thread->done != NULL)
+    {
+        xSemaphoreGive(thread->done);
+    }
+    else
+    {
+        FLUID_FREE(thread);
+    }
+
+    vTaskDelete(NULL);
+}
+
+fluid_thread_t *
+new_fluid_thread(const char *name, fluid_thread_func_t func, void *data, int prio_level, int detach)
+{
+    fluid_thread_t *thread;
+    UBaseType_t prio = (prio_level > 0) ? FLUID_FREERTOS_HIGH_PRIO : FLUID_FREERTOS_PRIO;
+
+    fluid_return_val_if_fail(func != NULL, NULL);
+
+    thread = FLUID_NEW(fluid_thread_t);
+
+    if(thread == NULL)
+    {
+        FLUID_LOG(FLUID_PANIC, "Out of memory on thread allocation");
+        return NULL;
+    }
+
+    FLUID_MEMSET(thread, 0, sizeof(*thread));
+    thread->func = func;
+    thread->data = data;
+
+    if(!detach)
+    {
+        thread->done = xSemaphoreCreateBinary();
+
+        if(thread->done == NULL)
+        {
+            FLUID_LOG(FLUID_PANIC, "Out of memory on thread allocation");
+            FLUID_FREE(thread);
+            return NULL;
+        }
+    }
+
+    if(xTaskCreate(fluid_thread_task, name ? name : "fluidsynth", FLUID_FREERTOS_STACK_SIZE,
+                   thread, prio, &thread->task) != pdPASS)
+    {
+        FLUID_LOG(FLUID_ERR, "Failed to create the thread");
+
+        if(thread->done != NULL)
+        {
+            vSemaphoreDelete(thread->done);
+        }
+
+        FLUID_FREE(thread);
+        return NULL;
+    }
+
+    /* like with glib, a detached thread may be gone already when this returns */
+    return thread;
+}
+
+void delete_fluid_thread(fluid_thread_t *thread)
+{
+    fluid_return_if_fail(thread != NULL);
+
+    if(thread->done != NULL)
+    {
+        vSemaphoreDelete(thread->done);
+    }
+
+    FLUID_FREE(thread);
+}
+
+int fluid_thread_join(fluid_thread_t *thread)
+{
+    fluid_return_val_if_fail(thread != NULL && thread->done != NULL, FLUID_FAILED);
+
+    xSemaphoreTake(thread->done, portMAX_DELAY);
+    return FLUID_OK;
+}
+
+void fluid_thread_self_set_prio(int prio_level)
+{
+    if(prio_level > 0)
+    {
+        vTaskPrioritySet(NULL, FLUID_FREERTOS_HIGH_PRIO);
+    }
+}
+
+int fluid_thread_self_set_affinity(const int *cpus, int cpu_count)
+{
+#if configUSE_CORE_AFFINITY && (configNUMBER_OF_CORES > 1)
+    UBaseType_t mask = 0;
+    int i;
+
+    for(i = 0; i < cpu_count; i++)
+    {
+        if(cpus[i] >= 0 && cpus[i] < configNUMBER_OF_CORES)
+        {
+            mask |= (UBaseType_t)1 << cpus[i];
+        }
+    }
+
+    if(mask != 0)
+    {
+        vTaskCoreAffinitySet(NULL, mask);
+        return FLUID_OK;
+    }
+
+    FLUID_LOG(FLUID_WARN, "Failed to set thread affinity");
+#else
+    FLUID_LOG(FLUID_WARN, "Setting the thread affinity requires configUSE_CORE_AFFINITY");
+#endif
+    return FLUID_FAILED;
+}
@@ -0,0 +1,240 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * @file fluid_sys_freertos.h
+ *
+ * This header contains the FreeRTOS based OS abstraction for embedded targets.
+ * Unlike the embedded abstraction it provides threads, muteces and condition
+ * variables, so the mixer can render on all cores of e.g. an ESP32-S3 or a
+ * RP2040 running the SMP kernel. File access is stubbed like in the embedded
+ * abstraction.
+ */
+
+#ifndef _FLUID_SYS_FREERTOS_H
+#define _FLUID_SYS_FREERTOS_H
+
+#include "fluidsynth_priv.h"
+#include "fluid_stub_functions.h"
+#include "fluid_file.h"
+
+#include <assert.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#else
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#endif
+
+#define FALSE (0)
+#define TRUE (!FALSE)
+
+#ifdef LADSPA
+#error "LADSPA is not supported with the FreeRTOS OS abstraction"
+#endif
+
+/* Stack depth in words of the threads created by fluidsynth. The mixer threads
+ * render voices on it, so it must not be too small. */
+#ifndef FLUID_FREERTOS_STACK_SIZE
+#define FLUID_FREERTOS_STACK_SIZE 4096
+#endif
+
+/* FreeRTOS priority of threads requesting a high priority, i.e. the mixer threads */
+#ifndef FLUID_FREERTOS_HIGH_PRIO
+#define FLUID_FREERTOS_HIGH_PRIO (configMAX_PRIORITIES - 2)
+#endif
+
+/* FreeRTOS priority of all other threads */
+#ifndef FLUID_FREERTOS_PRIO
+#define FLUID_FREERTOS_PRIO (tskIDLE_PRIORITY + 1)
+#endif
+
+/* Thread local storage slot holding the fluid_private_t values of a task */
+#ifndef FLUID_FREERTOS_TLS_INDEX
+#define FLUID_FREERTOS_TLS_INDEX (configNUM_THREAD_LOCAL_STORAGE_POINTERS - 1)
+#endif
+
+/* Maximum number of fluid_private_t variables */
+#define FLUID_FREERTOS_MAX_PRIVATE 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void *fluid_pointer_t;
+
+/* Endian detection */
+#ifdef WORDS_BIGENDIAN
+#define FLUID_IS_BIG_ENDIAN       true
+
+#define FLUID_LE32TOH(x)          (((0xFF000000 & (x)) >> 24) | ((0x00FF0000 & (x)) >> 8) | ((0x0000FF00 & (x)) << 8) | ((0x000000FF & (x)) << 24));
+#define FLUID_LE16TOH(x)          (((0xFF00 & (x)) >> 8) | ((0x00FF & (x)) << 8))
+#else
+#define FLUID_IS_BIG_ENDIAN       false
+
+#define FLUID_LE32TOH(x)          (x)
+#define FLUID_LE16TOH(x)          (x)
+#endif
+
+/*
+ * Utility functions
+ */
+
+#define fluid_shell_parse_argv  fluid_shell_parse_argv_internal
+#define fluid_strfreev          fluid_strfreev_internal
+
+STUB_FUNCTION(fluid_strerror, const char *, "stub", (int error))
+STUB_FUNCTION(fluid_setenv, int, -1, (const char *name, const char *value, int overwrite))
+
+
+/* Time functions */
+
+void fluid_msleep(unsigned int msecs);
+double fluid_utime(void);
+
+
+/* Muteces */
+
+/* NULL until first used, so that FLUID_MUTEX_INIT works for static muteces */
+typedef SemaphoreHandle_t fluid_mutex_t;
+
+#define FLUID_MUTEX_INIT        NULL
+#define fluid_mutex_init(mutex) _fluid_mutex_init(&(mutex))
+void _fluid_mutex_init(fluid_mutex_t *mutex);
+void fluid_mutex_destroy(fluid_mutex_t mutex);
+#define fluid_mutex_lock(mutex) _fluid_mutex_lock(&(mutex))
+void _fluid_mutex_lock(fluid_mutex_t *mutex);
+#define fluid_mutex_unlock(mutex) xSemaphoreGive(mutex)
+
+/* Recursive lock capable mutex */
+typedef SemaphoreHandle_t fluid_rec_mutex_t;
+
+#define fluid_rec_mutex_init(mutex) _fluid_rec_mutex_init(&(mutex))
+void _fluid_rec_mutex_init(fluid_rec_mutex_t *mutex);
+#define fluid_rec_mutex_destroy(mutex)  vSemaphoreDelete(mutex)
+#define fluid_rec_mutex_lock(mutex)     xSemaphoreTakeRecursive(mutex, portMAX_DELAY)
+#define fluid_rec_mutex_unlock(mutex)   xSemaphoreGiveRecursive(mutex)
+#define fluid_rec_mutex_trylock(mutex)  (xSemaphoreTakeRecursive(mutex, 0) == pdTRUE)
+
+/* Dynamically allocated mutex suitable for fluid_cond_t use */
+typedef void fluid_cond_mutex_t;
+
+#define fluid_cond_mutex_lock(mutex)    xSemaphoreTake((SemaphoreHandle_t)(mutex), portMAX_DELAY)
+#define fluid_cond_mutex_unlock(mutex)  xSemaphoreGive((SemaphoreHandle_t)(mutex))
+fluid_cond_mutex_t *new_fluid_cond_mutex(void);
+void delete_fluid_cond_mutex(fluid_cond_mutex_t *mutex);
+
+/* Thread condition signaling, FreeRTOS has no condition variables. They are
+ * emulated by a queue of the waiting tasks, each blocking on a semaphore of its own. */
+typedef struct _fluid_cond_t fluid_cond_t;
+
+void fluid_cond_signal(fluid_cond_t *cond);
+void fluid_cond_broadcast(fluid_cond_t *cond);
+void fluid_cond_wait(fluid_cond_t *cond, fluid_cond_mutex_t *mutex);
+fluid_cond_t *new_fluid_cond(void);
+void delete_fluid_cond(fluid_cond_t *cond);
+
+/* Thread private data, 0 until first used */
+typedef int fluid_private_t;
+
+#define fluid_private_init(priv)        ((priv) = 0)
+#define fluid_private_free(priv)
+#define fluid_private_get(priv)         _fluid_private_get(&(priv))
+#define fluid_private_set(priv, value)  _fluid_private_set(&(priv), value)
+void *_fluid_private_get(fluid_private_t *priv);
+void _fluid_private_set(fluid_private_t *priv, void *value);
+
+
+/* Atomic operations, provided by the compiler. On cores without atomic
+ * instructions (Cortex-M0) the toolchain's __atomic_* helpers are used. */
+
+#define fluid_atomic_int_inc(_pi) \
+    __atomic_add_fetch((fluid_atomic_int_t *)(_pi), 1, __ATOMIC_SEQ_CST)
+#define fluid_atomic_int_get(_pi) \
+    __atomic_load_n((fluid_atomic_int_t *)(_pi), __ATOMIC_SEQ_CST)
+#define fluid_atomic_int_set(_pi, _val) \
+    __atomic_store_n((fluid_atomic_int_t *)(_pi), _val, __ATOMIC_SEQ_CST)
+#define fluid_atomic_int_dec_and_test(_pi) \
+    (__atomic_sub_fetch((fluid_atomic_int_t *)(_pi), 1, __ATOMIC_SEQ_CST) == 0)
+#define fluid_atomic_int_compare_and_exchange(_pi, _old, _new) \
+    _fluid_atomic_int_compare_and_exchange((fluid_atomic_int_t *)(_pi), _old, _new)
+#define fluid_atomic_int_add(_pi, _add) \
+    __atomic_fetch_add((fluid_atomic_int_t *)(_pi), _add, __ATOMIC_SEQ_CST)
+#define fluid_atomic_int_exchange_and_add fluid_atomic_int_add
+
+#define fluid_atomic_pointer_get(_pp) \
+    __atomic_load_n((void **)(_pp), __ATOMIC_SEQ_CST)
+#define fluid_atomic_pointer_set(_pp, val) \
+    __atomic_store_n((void **)(_pp), val, __ATOMIC_SEQ_CST)
+
+static FLUID_INLINE bool
+_fluid_atomic_int_compare_and_exchange(fluid_atomic_int_t *pi, int old, int _new)
+{
+    return __atomic_compare_exchange_n(pi, &old, _new, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static FLUID_INLINE bool
+fluid_atomic_pointer_compare_and_exchange(void *pp, void *old, void *_new)
+{
+    return __atomic_compare_exchange_n((void **)pp, &old, _new, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+
+/* Threads */
+
+/* other thread implementations might change this for their needs */
+typedef void *fluid_thread_return_t;
+typedef fluid_thread_return_t (*fluid_thread_func_t)(void *data);
+
+/* static return value for thread functions which requires a return value */
+#define FLUID_THREAD_RETURN_VALUE (NULL)
+
+typedef struct _fluid_thread_t fluid_thread_t;
+
+#define FLUID_THREAD_ID_NULL            NULL                    /* A NULL "ID" value */
+#define fluid_thread_id_t               TaskHandle_t            /* Data type for a thread ID */
+#define fluid_thread_get_id()           xTaskGetCurrentTaskHandle() /* Get unique "ID" for current thread */
+
+/* whether or not the implementation can be thread safe at all */
+#define FLUID_THREAD_SAFE_CAPABLE 1
+
+
+/* File access */
+typedef struct {
+    #undef st_mtime
+    int st_mtime;
+} fluid_stat_buf_t;
+
+STUB_FUNCTION(fluid_file_test, bool, true, (const char *path, int flags))
+STUB_FUNCTION(fluid_stat, int, -1, (const char *path, fluid_stat_buf_t *buffer))
+
+
+/* Debug functions */
+#define fluid_assert assert
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _FLUID_SYS_FREERTOS_H */
@@ -0,0 +1,318 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_trace.h"
+
+typedef struct _fluid_trace_event_t
+{
+    const char *name;           /**< Name of the span, a string literal */
+    double ts;                  /**< Start in usec since the recording started */
+    double dur;                 /**< Duration in usec */
+} fluid_trace_event_t;
+
+/* Spans of a single thread, written by that thread only */
+typedef struct _fluid_trace_buffer_t
+{
+    fluid_atomic_int_t writing; /**< Atomic: TRUE while the thread records a span */
+    fluid_atomic_int_t count;   /**< Atomic: number of recorded spans */
+    fluid_atomic_int_t dropped; /**< Atomic: number of spans that didn't fit */
+    fluid_trace_event_t *events;
+} fluid_trace_buffer_t;
+
+fluid_atomic_int_t _fluid_trace_active = FALSE;
+
+static fluid_atomic_int_t fluid_trace_session = 0;  /* incremented by every fluid_trace_start() */
+static fluid_atomic_int_t fluid_trace_threads = 0;  /* buffers claimed by threads */
+static fluid_trace_buffer_t fluid_trace_buffers[FLUID_TRACE_MAX_THREADS];
+static fluid_trace_event_t *fluid_trace_events = NULL;
+static int fluid_trace_size = 0;                    /* capacity of a buffer */
+static double fluid_trace_start_time = 0.0;
+
+/* Per thread: session << 8 | buffer index + 1 of the buffer the thread has claimed */
+static fluid_private_t fluid_trace_thread;
+static int fluid_trace_thread_initialized = FALSE;
+
+/* Get the buffer of the calling thread, claiming a new one when it records its first span
+ * of a session. NULL if all buffers are taken. */
+static fluid_trace_buffer_t *
+fluid_trace_get_buffer(void)
+{
+    int session = fluid_atomic_int_get(&fluid_trace_session);
+    void *thread = fluid_private_get(fluid_trace_thread);
+    int value = FLUID_POINTER_TO_INT(thread);
+    int idx;
+
+    if((value >> 8) == session && (value & 0xff) != 0)
+    {
+        return &fluid_trace_buffers[(value & 0xff) - 1];
+    }
+
+    idx = fluid_atomic_int_exchange_and_add(&fluid_trace_threads, 1);
+
+    if(idx >= FLUID_TRACE_MAX_THREADS)
+    {
+        /* remember that there's no buffer for this thread */
+        fluid_private_set(fluid_trace_thread, FLUID_INT_TO_POINTER(session << 8));
+        return NULL;
+    }
+
+    fluid_private_set(fluid_trace_thread, FLUID_INT_TO_POINTER((session << 8) | (idx + 1)));
+    return &fluid_trace_buffers[idx];
+}
+
+/**
+ * Record a span that started at ref and ends now into the buffer of the calling thread.
+ */
+void
+fluid_trace_record(const char *name, double ref)
+{
+    double now = fluid_perf_now();
+    fluid_trace_buffer_t *buffer;
+    fluid_trace_event_t *event;
+    int count;
+
+    buffer = fluid_trace_get_buffer();
+
+    if(buffer == NULL)
+    {
+        return;
+    }
+
+    /* fluid_trace_stop() clears active before it waits for writing to be cleared, so a
+     * span is either recorded entirely before the buffers are read or not at all */
+    fluid_atomic_int_set(&buffer->writing, TRUE);
+
+    if(fluid_atomic_int_get(&_fluid_trace_active))
+    {
+        count = fluid_atomic_int_get(&buffer->count);
+
+        if(count < fluid_trace_size)
+        {
+            event = &buffer->events[count];
+            event->name = name;
+            event->ts = ref - fluid_trace_start_time;
+            event->dur = now - ref;
+            fluid_atomic_int_set(&buffer->count, count + 1);
+        }
+        else
+        {
+            fluid_atomic_int_inc(&buffer->dropped);
+        }
+    }
+
+    fluid_atomic_int_set(&buffer->writing, FALSE);
+}
+
+/**
+ * Start recording trace events of the render, SoundFont loading and sequencer stages.
+ *
+ * @param events Number of spans recorded per thread, <= 0 for a default of 32768. At most
+ *   16 threads are recorded.
+ * @return #FLUID_OK on success, #FLUID_FAILED if out of memory
+ *
+ * The spans of a previous recording are discarded. Spans are recorded process wide for all
+ * synths into a buffer per thread without taking locks, recording costs two clock reads per
+ * span and nothing while stopped. Use fluid_trace_dump() to write them to a file.
+ *
+ * @note fluid_trace_start(), fluid_trace_stop() and fluid_trace_dump() must not be called
+ * concurrently with each other.
+ * @since 2.6.0
+ */
+int
+fluid_trace_start(int events)
+{
+    int i;
+
+    fluid_trace_stop();
+
+    if(events <= 0)
+    {
+        events = FLUID_TRACE_DEFAULT_EVENTS;
+    }
+
+    if(!fluid_trace_thread_initialized)
+    {
+        fluid_private_init(fluid_trace_thread);
+        fluid_trace_thread_initialized = TRUE;
+    }
+
+    /* no thread is recording anymore, the old buffers can be dropped */
+    FLUID_FREE(fluid_trace_events);
+    fluid_trace_events = FLUID_ARRAY(fluid_trace_event_t, FLUID_TRACE_MAX_THREADS * events);
+    fluid_trace_size = 0;
+
+    if(fluid_trace_events == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return FLUID_FAILED;
+    }
+
+    for(i = 0; i < FLUID_TRACE_MAX_THREADS; i++)
+    {
+        fluid_atomic_int_set(&fluid_trace_buffers[i].count, 0);
+        fluid_atomic_int_set(&fluid_trace_buffers[i].dropped, 0);
+        fluid_trace_buffers[i].events = &fluid_trace_events[i * events];
+    }
+
+    fluid_trace_size = events;
+    fluid_trace_start_time = fluid_perf_now();
+    fluid_atomic_int_set(&fluid_trace_threads, 0);
+    fluid_atomic_int_inc(&fluid_trace_session);
+    fluid_atomic_int_set(&_fluid_trace_active, TRUE);
+
+    return FLUID_OK;
+}
+
+/**
+ * Stop recording trace events, keeping the spans recorded so far for fluid_trace_dump().
+ *
+ * Returns once no thread is recording a span anymore.
+ * @since 2.6.0
+ */
+void
+fluid_trace_stop(void)
+{
+    int i;
+
+    fluid_atomic_int_set(&_fluid_trace_active, FALSE);
+
+    for(i = 0; i < FLUID_TRACE_MAX_THREADS; i++)
+    {
+        while(fluid_atomic_int_get(&fluid_trace_buffers[i].writing))
+        {
+            fluid_msleep(1);
+        }
+    }
+}
+
+/**
+ * Stop recording and write the recorded spans to a file in the Chrome trace event format.
+ *
+ * @param filename Name of the JSON file to write
+ * @return #FLUID_OK on success, #FLUID_FAILED if nothing has been recorded or the file
+ *   can't be written
+ *
+ * The file can be opened with https://ui.perfetto.dev or chrome://tracing. Each thread that
+ * recorded spans is shown as a track of its own. The spans stay available for another dump
+ * until the next fluid_trace_start().
+ * @since 2.6.0
+ */
+int
+fluid_trace_dump(const char *filename)
+{
+    FILE *file;
+    fluid_trace_buffer_t *buffer;
+    fluid_trace_event_t *event;
+    int i, j, count, threads, first = TRUE;
+    int dropped = 0;
+
+    fluid_return_val_if_fail(filename != NULL, FLUID_FAILED);
+
+    if(fluid_trace_events == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "No trace has been recorded");
+        return FLUID_FAILED;
+    }
+
+    fluid_trace_stop();
+
+    file = FLUID_FOPEN(filename, "w");
+
+    if(file == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Unable to open trace file '%s'", filename);
+        return FLUID_FAILED;
+    }
+
+    threads = fluid_atomic_int_get(&fluid_trace_threads);
+    threads = (threads < FLUID_TRACE_MAX_THREADS) ? threads : FLUID_TRACE_MAX_THREADS;
+
+    FLUID_FPRINTF(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for(i = 0; i < threads; i++)
+    {
+        buffer = &fluid_trace_buffers[i];
+        count = fluid_atomic_int_get(&buffer->count);
+        dropped += fluid_atomic_int_get(&buffer->dropped);
+
+        FLUID_FPRINTF(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                      "\"args\":{\"name\":\"fluidsynth thread %d\"}}", first ? "" : ",\n", i + 1, i + 1);
+        first = FALSE;
+
+        for(j = 0; j < count; j++)
+        {
+            event = &buffer->events[j];
+            FLUID_FPRINTF(file, ",\n{\"name\":\"%s\",\"cat\":\"fluidsynth\",\"ph\":\"X\",\"pid\":1,"
+                          "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", event->name, i + 1, event->ts, event->dur);
+        }
+    }
+
+    FLUID_FPRINTF(file, "\n]}\n");
+
+    if(FLUID_FCLOSE(file) != 0)
+    {
+        FLUID_LOG(FLUID_ERR, "Unable to write trace file '%s'", filename);
+        return FLUID_FAILED;
+    }
+
+    if(dropped > 0)
+    {
+        FLUID_LOG(FLUID_WARN, "%d trace spans were dropped, the trace buffers were full", dropped);
+    }
+
+    return FLUID_OK;
+}
+
+/*
+ * Sum up the durations in usec of the recorded spans of a name, stopping the recording.
+ * count receives the number of those spans if not NULL. Used by the benchmarks.
+ */
+double
+fluid_trace_get_total(const char *name, int *count)
+{
+    fluid_trace_buffer_t *buffer;
+    double total = 0.0;
+    int i, j, threads, spans = 0;
+
+    fluid_trace_stop();
+
+    threads = fluid_atomic_int_get(&fluid_trace_threads);
+    threads = (threads < FLUID_TRACE_MAX_THREADS) ? threads : FLUID_TRACE_MAX_THREADS;
+
+    for(i = 0; i < threads && fluid_trace_events != NULL; i++)
+    {
+        buffer = &fluid_trace_buffers[i];
+
+        for(j = 0; j < fluid_atomic_int_get(&buffer->count); j++)
+        {
+            if(FLUID_STRCMP(buffer->events[j].name, name) == 0)
+            {
+                total += buffer->events[j].dur;
+                spans++;
+            }
+        }
+    }
+
+    if(count != NULL)
+    {
+        *count = spans;
+    }
+
+    return total;
+}
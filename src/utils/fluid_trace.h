@@ -0,0 +1,69 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLUID_TRACE_H
+#define _FLUID_TRACE_H
+
+#include "fluid_sys.h"
+#include "fluid_perf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Trace recording, see fluid_trace_start(). Spans are recorded process wide, since loading
+ * SoundFonts and sequencing don't belong to a synth. Every thread writes to its own buffer
+ * without locks, the buffers are only read once recording has stopped.
+ */
+
+/* Threads whose spans are recorded, spans of further threads are dropped */
+#define FLUID_TRACE_MAX_THREADS 16
+
+/* Spans per thread recorded if fluid_trace_start() isn't told otherwise */
+#define FLUID_TRACE_DEFAULT_EVENTS 32768
+
+extern fluid_atomic_int_t _fluid_trace_active;
+
+void fluid_trace_record(const char *name, double ref);
+double fluid_trace_get_total(const char *name, int *count);
+
+/* Returns the start time of a span, 0 if nothing is being recorded */
+static FLUID_INLINE double
+fluid_trace_ref(void)
+{
+    return fluid_atomic_int_get(&_fluid_trace_active) ? fluid_perf_now() : 0.0;
+}
+
+/* Records a span started at ref, unless recording was off at its start. name must be a
+ * string literal, only the pointer is kept. */
+static FLUID_INLINE void
+fluid_trace_span(const char *name, double ref)
+{
+    if(ref != 0.0)
+    {
+        fluid_trace_record(name, ref);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_TRACE_H */
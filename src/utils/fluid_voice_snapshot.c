@@ -0,0 +1,217 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "fluid_voice_snapshot.h"
+
+/**
+ * Create the voice snapshot of a synth, initially disabled.
+ * @param channels Number of MIDI channels
+ * @return New snapshot or NULL if out of memory (error message logged)
+ */
+fluid_voice_snapshot_t *
+new_fluid_voice_snapshot(int channels)
+{
+    fluid_voice_snapshot_t *snap = FLUID_NEW(fluid_voice_snapshot_t);
+
+    if(snap == NULL)
+    {
+        FLUID_LOG(FLUID_ERR, "Out of memory");
+        return NULL;
+    }
+
+    FLUID_MEMSET(snap, 0, sizeof(*snap));
+    snap->channels = channels;
+    snap->latest = -1;
+
+    return snap;
+}
+
+void
+delete_fluid_voice_snapshot(fluid_voice_snapshot_t *snap)
+{
+    int i;
+
+    fluid_return_if_fail(snap != NULL);
+
+    for(i = 0; i < FLUID_VOICE_SNAPSHOT_BUFS; i++)
+    {
+        FLUID_FREE(snap->bufs[i].voices);
+        FLUID_FREE(snap->bufs[i].channels);
+    }
+
+    FLUID_FREE(snap);
+}
+
+/**
+ * Enable or disable the snapshots. The buffers are allocated when they are enabled for
+ * the first time and kept until the snapshot is deleted, since the render thread may still
+ * be writing one while they get disabled.
+ * @param capacity Number of voices a buffer holds, only used when allocating the buffers
+ * @return #FLUID_OK on success, #FLUID_FAILED if out of memory (error message logged)
+ */
+int
+fluid_voice_snapshot_set_enabled(fluid_voice_snapshot_t *snap, int enabled, int capacity)
+{
+    int i;
+
+    if(enabled && snap->bufs[0].channels == NULL)
+    {
+        for(i = 0; i < FLUID_VOICE_SNAPSHOT_BUFS; i++)
+        {
+            snap->bufs[i].voices = FLUID_ARRAY(fluid_voice_state_t, capacity);
+            snap->bufs[i].channels = FLUID_ARRAY(fluid_channel_activity_t, snap->channels);
+
+            if(snap->bufs[i].voices == NULL || snap->bufs[i].channels == NULL)
+            {
+                FLUID_LOG(FLUID_ERR, "Out of memory");
+                break;
+            }
+        }
+
+        if(i < FLUID_VOICE_SNAPSHOT_BUFS)
+        {
+            for(i = 0; i < FLUID_VOICE_SNAPSHOT_BUFS; i++)
+            {
+                FLUID_FREE(snap->bufs[i].voices);
+                FLUID_FREE(snap->bufs[i].channels);
+                snap->bufs[i].voices = NULL;
+                snap->bufs[i].channels = NULL;
+            }
+
+            return FLUID_FAILED;
+        }
+
+        snap->capacity = capacity;
+    }
+
+    if(!enabled)
+    {
+        /* readers don't get a stale snapshot once enabled again */
+        fluid_atomic_int_set(&snap->latest, -1);
+    }
+
+    fluid_atomic_int_set(&snap->enabled, enabled);
+    return FLUID_OK;
+}
+
+/**
+ * Start writing the next snapshot, must only be called by the render thread.
+ * @return The buffer to add the voices to, NULL if snapshots are disabled. NULL safe.
+ */
+fluid_voice_snapshot_buf_t *
+fluid_voice_snapshot_begin(fluid_voice_snapshot_t *snap)
+{
+    fluid_voice_snapshot_buf_t *buf;
+    int latest;
+
+    if(snap == NULL || !fluid_atomic_int_get(&snap->enabled))
+    {
+        return NULL;
+    }
+
+    /* never the buffer published last, readers may be copying that one */
+    latest = fluid_atomic_int_get(&snap->latest);
+    buf = &snap->bufs[(latest + 1) % FLUID_VOICE_SNAPSHOT_BUFS];
+
+    fluid_atomic_int_inc(&buf->seq);
+    buf->voice_count = 0;
+    FLUID_MEMSET(buf->channels, 0, snap->channels * sizeof(*buf->channels));
+
+    return buf;
+}
+
+/**
+ * Publish a buffer returned by fluid_voice_snapshot_begin() once all voices have been added.
+ */
+void
+fluid_voice_snapshot_commit(fluid_voice_snapshot_t *snap, fluid_voice_snapshot_buf_t *buf)
+{
+    fluid_atomic_int_inc(&buf->seq);
+    fluid_atomic_int_set(&snap->latest, (int)(buf - snap->bufs));
+}
+
+/**
+ * Copy the latest snapshot, may be called by any thread.
+ * @return Number of active voices or #FLUID_FAILED if snapshots are disabled
+ */
+int
+fluid_voice_snapshot_read(fluid_voice_snapshot_t *snap, fluid_voice_state_t *voices, int size,
+                    fluid_channel_activity_t *channels, int channel_count)
+{
+    fluid_voice_snapshot_buf_t *buf;
+    int latest, seq, count, n;
+
+    if(!fluid_atomic_int_get(&snap->enabled))
+    {
+        return FLUID_FAILED;
+    }
+
+    if(channel_count > snap->channels)
+    {
+        FLUID_MEMSET(&channels[snap->channels], 0, (channel_count - snap->channels) * sizeof(*channels));
+        channel_count = snap->channels;
+    }
+
+    /* The writer only touches the latest buffer after publishing the next one, so this
+     * only loops while the render thread makes progress. */
+    for(;;)
+    {
+        latest = fluid_atomic_int_get(&snap->latest);
+
+        if(latest < 0)
+        {
+            /* nothing rendered since the snapshots have been enabled */
+            if(channel_count > 0)
+            {
+                FLUID_MEMSET(channels, 0, channel_count * sizeof(*channels));
+            }
+
+            return 0;
+        }
+
+        buf = &snap->bufs[latest];
+        seq = fluid_atomic_int_get(&buf->seq);
+
+        if(seq & 1)
+        {
+            continue;
+        }
+
+        count = buf->voice_count;
+        n = (size < count) ? size : count;
+        n = (n < snap->capacity) ? n : snap->capacity;
+
+        if(n > 0)
+        {
+            FLUID_MEMCPY(voices, buf->voices, n * sizeof(*voices));
+        }
+
+        if(channel_count > 0)
+        {
+            FLUID_MEMCPY(channels, buf->channels, channel_count * sizeof(*channels));
+        }
+
+        if(fluid_atomic_int_get(&buf->seq) == seq)
+        {
+            break;
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,97 @@
+/* FluidSynth - A Software Synthesizer
+ *
+ * Copyright (C) 2003  Peter Hanappe and others.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLUID_VOICE_SNAPSHOT_H
+#define _FLUID_VOICE_SNAPSHOT_H
+
+#include "fluid_sys.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Voice snapshot, see synth.voice-snapshot. The render thread publishes the state of its
+ * voices once per render call into one of three buffers, readers copy the latest one without
+ * locks. Every buffer has a sequence number, odd while the buffer is written: a reader
+ * retries if it changed during the copy, which only happens if the writer lapped it twice.
+ */
+
+#define FLUID_VOICE_SNAPSHOT_BUFS 3
+
+typedef struct _fluid_voice_snapshot_buf_t
+{
+    fluid_atomic_int_t seq;     /**< Atomic: odd while the buffer is written */
+    int voice_count;            /**< Number of active voices, may exceed the capacity */
+    fluid_voice_state_t *voices; /**< The first capacity voices */
+    fluid_channel_activity_t *channels; /**< Activity of each MIDI channel */
+} fluid_voice_snapshot_buf_t;
+
+typedef struct _fluid_voice_snapshot_t
+{
+    fluid_atomic_int_t enabled; /**< Atomic: TRUE if snapshots should be taken, only set once the buffers are allocated */
+    fluid_atomic_int_t latest;  /**< Atomic: index of the buffer published last, -1 if none yet */
+    int capacity;               /**< Number of voices a buffer holds */
+    int channels;               /**< Number of MIDI channels */
+    fluid_voice_snapshot_buf_t bufs[FLUID_VOICE_SNAPSHOT_BUFS];
+} fluid_voice_snapshot_t;
+
+fluid_voice_snapshot_t *new_fluid_voice_snapshot(int channels);
+void delete_fluid_voice_snapshot(fluid_voice_snapshot_t *snap);
+
+int fluid_voice_snapshot_set_enabled(fluid_voice_snapshot_t *snap, int enabled, int capacity);
+fluid_voice_snapshot_buf_t *fluid_voice_snapshot_begin(fluid_voice_snapshot_t *snap);
+void fluid_voice_snapshot_commit(fluid_voice_snapshot_t *snap, fluid_voice_snapshot_buf_t *buf);
+int fluid_voice_snapshot_read(fluid_voice_snapshot_t *snap, fluid_voice_state_t *voices, int size,
+                        fluid_channel_activity_t *channels, int channel_count);
+
+/* Adds a voice to a buffer returned by fluid_voice_snapshot_begin() */
+static FLUID_INLINE void
+fluid_voice_snapshot_add_voice(fluid_voice_snapshot_t *snap, fluid_voice_snapshot_buf_t *buf,
+                         int chan, int key, int vel, int stage, float amp)
+{
+    if(buf->voice_count < snap->capacity)
+    {
+        fluid_voice_state_t *state = &buf->voices[buf->voice_count];
+
+        state->chan = chan;
+        state->key = key;
+        state->vel = vel;
+        state->stage = (enum fluid_voice_stage)stage;
+        state->amp = amp;
+    }
+
+    buf->voice_count++;
+
+    if(chan >= 0 && chan < snap->channels)
+    {
+        buf->channels[chan].voices++;
+
+        if(amp > buf->channels[chan].amp)
+        {
+            buf->channels[chan].amp = amp;
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FLUID_VOICE_SNAPSHOT_H */
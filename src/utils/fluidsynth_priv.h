@@ -99,6 +99,8 @@ typedef struct _fluid_tuning_t fluid_tuning_t;
 typedef struct _fluid_hashtable_t fluid_hashtable_t;
 typedef struct _fluid_client_t fluid_client_t;
 typedef struct _fluid_server_socket_t fluid_server_socket_t;
+typedef struct _fluid_poll_server_socket_t fluid_poll_server_socket_t;
+typedef struct _fluid_udp_server_socket_t fluid_udp_server_socket_t;
 typedef struct _fluid_sample_timer_t fluid_sample_timer_t;
 typedef struct _fluid_zone_range_t fluid_zone_range_t;
 typedef struct _fluid_rvoice_eventhandler_t fluid_rvoice_eventhandler_t;
@@ -125,8 +127,13 @@ typedef void (*fluid_rvoice_function_t)(void *obj, const fluid_rvoice_param_t pa
  *                      CONSTANTS
  */
 
-#define FLUID_BUFSIZE                64         /**< FluidSynth internal buffer size (in samples) */
-#define FLUID_MIXER_MAX_BUFFERS_DEFAULT (8192/FLUID_BUFSIZE) /**< Number of buffers that can be processed in one rendering run */
+#ifndef FLUID_BUFSIZE
+#define FLUID_BUFSIZE                64         /**< FluidSynth internal buffer size (in samples), see the fluid-bufsize CMake option */
+#endif
+#ifndef FLUID_MIXER_FRAMES
+#define FLUID_MIXER_FRAMES           8192       /**< Frames the mixer renders at most in one run, see the fluid-mixer-frames CMake option */
+#endif
+#define FLUID_MIXER_MAX_BUFFERS_DEFAULT (FLUID_MIXER_FRAMES/FLUID_BUFSIZE) /**< Number of buffers that can be processed in one rendering run */
 #define FLUID_MAX_EVENTS_PER_BUFSIZE 1024       /**< Maximum queued MIDI events per #FLUID_BUFSIZE */
 #define FLUID_MAX_RETURN_EVENTS      1024       /**< Maximum queued synthesis thread return events */
 #define FLUID_MAX_EVENT_QUEUES       16         /**< Maximum number of unique threads queuing events */
@@ -195,13 +202,14 @@ typedef void (*fluid_rvoice_function_t)(void *obj, const fluid_rvoice_param_t pa
 
 /* Memory allocation */
 #define FLUID_MALLOC(_n)             fluid_alloc(_n)
-#define FLUID_REALLOC(_p,_n)         realloc(_p,_n)
+#define FLUID_REALLOC(_p,_n)         fluid_realloc(_p,_n)
 #define FLUID_FREE(_p)               fluid_free(_p)
 #define FLUID_NEW(_t)                (_t*)FLUID_MALLOC(sizeof(_t))
 #define FLUID_ARRAY_ALIGNED(_t,_n,_a) (_t*)FLUID_MALLOC((_n)*sizeof(_t) + ((unsigned int)_a - 1u))
 #define FLUID_ARRAY(_t,_n)           FLUID_ARRAY_ALIGNED(_t,_n,1u)
 
 void* fluid_alloc(size_t len);
+void* fluid_realloc(void *ptr, size_t len);
 
 /* File access */
 #define FLUID_FOPEN(_f,_m)           fluid_fopen(_f,_m)
@@ -214,6 +222,7 @@ FILE *fluid_fopen(const char *filename, const char *mode);
 
 /* Memory functions */
 #define FLUID_MEMCPY(_dst,_src,_n)   memcpy(_dst,_src,_n)
+#define FLUID_MEMMOVE(_dst,_src,_n)  memmove(_dst,_src,_n)
 #define FLUID_MEMSET(_s,_c,_n)       memset(_s,_c,_n)
 
 /* String functions */
@@ -356,6 +365,13 @@ _fluid_snprintf(char *buffer, size_t count, const char *format, ...)
 #define FLUID_RESTRICT
 #endif
 
+/* Hints the processor to load the cache line holding an address, without faulting */
+#if defined(__clang__) || defined(__GNUC__) || defined(__GNUG__)
+#define FLUID_PREFETCH(_addr) __builtin_prefetch(_addr)
+#else
+#define FLUID_PREFETCH(_addr) ((void)(_addr))
+#endif
+
 #define FLUID_N_ELEMENTS(struct)  (sizeof (struct) / sizeof (struct[0]))
 #define FLUID_MEMBER_SIZE(struct, member)  ( sizeof (((struct *)0)->member) )
 
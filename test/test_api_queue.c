@@ -0,0 +1,94 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the calls sent through synth.api-queue by several threads while the
+// synth renders are all applied, in the order each thread has sent them, also when the queue overflows
+
+#define THREAD_COUNT 8
+#define CALL_COUNT 20000
+#define FRAMES 64
+
+static fluid_synth_t *synth;
+static int sending;
+
+static fluid_thread_return_t send_calls(void *data)
+{
+    int i, chan = FLUID_POINTER_TO_INT(data);
+
+    for(i = 0; i < CALL_COUNT; i++)
+    {
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 1, i % 128));
+        TEST_SUCCESS(fluid_synth_pitch_bend(synth, chan, i % 16384));
+    }
+
+    fluid_atomic_int_add(&sending, -1);
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+int main(void)
+{
+    static float left[FRAMES], right[FRAMES];
+    fluid_thread_t *threads[THREAD_COUNT];
+    fluid_settings_t *settings = new_fluid_settings();
+    int i, value;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.api-queue", 16));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* invalid channels are still refused right away */
+    TEST_ASSERT(fluid_synth_noteon(synth, 16, 60, 100) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_cc(synth, -1, 1, 0) == FLUID_FAILED);
+
+    /* more calls than the queue holds, the last ones take the lock */
+    for(i = 0; i < 100; i++)
+    {
+        TEST_SUCCESS(fluid_synth_cc(synth, 0, 7, i));
+    }
+
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 0, 7, &value));
+    TEST_ASSERT(value == 99);
+
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    sending = THREAD_COUNT;
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        threads[i] = new_fluid_thread("send", send_calls, FLUID_INT_TO_POINTER(i), 0, FALSE);
+        TEST_ASSERT(threads[i] != NULL);
+    }
+
+    // render while the calls are being sent
+    while(fluid_atomic_int_get(&sending) > 0)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+    }
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        fluid_thread_join(threads[i]);
+        delete_fluid_thread(threads[i]);
+    }
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        TEST_SUCCESS(fluid_synth_get_cc(synth, i, 1, &value));
+        TEST_ASSERT(value == (CALL_COUNT - 1) % 128);
+        TEST_SUCCESS(fluid_synth_get_pitch_bend(synth, i, &value));
+        TEST_ASSERT(value == (CALL_COUNT - 1) % 16384);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
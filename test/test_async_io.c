@@ -0,0 +1,122 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_list.h"
+
+// this test makes sure that fluid_file_read_ranges() reads the same data as reading the ranges
+// one by one, and that SoundFonts loaded with synth.async-io have the same sample data
+
+#define NUM_RANGES 100
+
+static fluid_defsfont_t *load(fluid_synth_t *synth)
+{
+    int id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 0);
+    fluid_sfont_t *sfont;
+
+    TEST_ASSERT(id != FLUID_FAILED);
+    sfont = fluid_synth_get_sfont_by_id(synth, id);
+    TEST_ASSERT(sfont != NULL);
+
+    return fluid_sfont_get_data(sfont);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth, *async_synth;
+    fluid_defsfont_t *defsfont, *async_defsfont;
+    fluid_list_t *list, *async_list;
+    fluid_file_range_t ranges[NUM_RANGES];
+    char *expected, *data;
+    fluid_long_long_t size;
+    const char *err;
+    FILE *file;
+    int i;
+
+    /* read ranges of different lengths, some overlapping, from all over the file */
+    file = fluid_file_open(TEST_SOUNDFONT, &err);
+    TEST_ASSERT(file != NULL);
+    TEST_SUCCESS(fluid_file_seek(file, 0, SEEK_END));
+    size = fluid_file_tell(file);
+    TEST_ASSERT(size > NUM_RANGES * 1000);
+
+    expected = malloc(size);
+    data = malloc(size);
+    TEST_ASSERT(expected != NULL && data != NULL);
+    TEST_SUCCESS(fluid_file_seek(file, 0, SEEK_SET));
+    TEST_SUCCESS(fluid_file_read(expected, size, file));
+
+    for(i = 0; i < NUM_RANGES; i++)
+    {
+        ranges[i].offset = (size / NUM_RANGES) * i + i % 7;
+        ranges[i].length = (size / NUM_RANGES) / (1 + i % 3) + 13;
+        ranges[i].buf = data + ranges[i].offset;
+
+        if(ranges[i].offset + (fluid_long_long_t)ranges[i].length > size)
+        {
+            ranges[i].length = (size_t)(size - ranges[i].offset);
+        }
+    }
+
+    FLUID_MEMSET(data, 0, size);
+    TEST_SUCCESS(fluid_file_seek(file, 42, SEEK_SET));
+
+    if(FLUID_HAVE_FILE_PREAD)
+    {
+        TEST_SUCCESS(fluid_file_read_ranges(file, ranges, NUM_RANGES));
+
+        for(i = 0; i < NUM_RANGES; i++)
+        {
+            TEST_ASSERT(memcmp(data + ranges[i].offset, expected + ranges[i].offset, ranges[i].length) == 0);
+        }
+
+        /* the position of the file is unchanged */
+        TEST_ASSERT(fluid_file_tell(file) == 42);
+
+        /* a range beyond the end of the file fails */
+        ranges[NUM_RANGES / 2].offset = size - 10;
+        ranges[NUM_RANGES / 2].length = 20;
+        TEST_ASSERT(fluid_file_read_ranges(file, ranges, NUM_RANGES) == FLUID_FAILED);
+    }
+    else
+    {
+        TEST_ASSERT(fluid_file_read_ranges(file, ranges, NUM_RANGES) == FLUID_FAILED);
+    }
+
+    FLUID_FCLOSE(file);
+    free(expected);
+    free(data);
+
+    /* the sample data loaded with and without synth.async-io is the same */
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    defsfont = load(synth);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.async-io", 1));
+    async_synth = new_fluid_synth(settings);
+    TEST_ASSERT(async_synth != NULL);
+    async_defsfont = load(async_synth);
+    TEST_ASSERT(async_defsfont->async_io);
+
+    for(list = defsfont->sample, async_list = async_defsfont->sample; list && async_list;
+            list = fluid_list_next(list), async_list = fluid_list_next(async_list))
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+        fluid_sample_t *async_sample = fluid_list_get(async_list);
+
+        TEST_ASSERT(sample->end == async_sample->end);
+        TEST_ASSERT(memcmp(sample->data + sample->start, async_sample->data + async_sample->start,
+                                 (sample->end - sample->start + 1) * sizeof(short)) == 0);
+    }
+
+    TEST_ASSERT(list == NULL && async_list == NULL);
+
+    delete_fluid_synth(async_synth);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that samples loaded in the background by dynamic sample loading
+// become ready for presets selected and pinned, and that they render the same audio
+
+#define FRAMES 4096
+
+static void wait_loaded(fluid_synth_t *synth, int sfont_id, int prog)
+{
+    int waited = 0;
+
+    while(fluid_synth_is_preset_loaded(synth, sfont_id, 0, prog) != TRUE)
+    {
+        TEST_ASSERT(waited++ < 10000);
+        fluid_msleep(1);
+    }
+}
+
+static void render(int async, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int id, chan;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading-async", async));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id != -1);
+
+    TEST_ASSERT(fluid_synth_is_preset_loaded(synth, id + 1, 0, 0) == FLUID_FAILED);
+
+    /* a pinned preset is loaded when pinning returns */
+    TEST_SUCCESS(fluid_synth_pin_preset(synth, id, 0, 40));
+    TEST_ASSERT(fluid_synth_is_preset_loaded(synth, id, 0, 40) == TRUE);
+
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 5));
+    }
+
+    for(chan = 0; chan < 8; chan++)
+    {
+        wait_loaded(synth, id, chan * 5);
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 48 + chan * 3, 100));
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    /* switching presets while loading leaves nothing behind, and notes of samples
+     * that are still being loaded may be dropped */
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 5 + 1));
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 60, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_unpin_preset(synth, id, 0, 40));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+}
+
+int main(void)
+{
+    static float ref[2 * FRAMES], async[2 * FRAMES];
+    int i;
+    float energy = 0;
+
+    render(0, ref);
+    render(1, async);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        energy += FLUID_FABS(ref[i]);
+        TEST_ASSERT(ref[i] == async[i]);
+    }
+
+    TEST_ASSERT(energy > 0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+/*
+ * FluidSynth - A Software Synthesizer
+ *
+ * Block conversion kernel identity test.
+ *
+ * Verifies that the (possibly vectorized) s16/s24/s32 block conversion kernels
+ * give exactly the results of the scalar round_clip_to<T>() expressions they
+ * replace, for float and double input, with and without dither, at rounding
+ * and saturation boundaries, and for lengths that leave a scalar tail.
+ */
+
+#include "test.h"
+#include "fluid_audio_convert.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+#define COUNT 1000
+
+static const float edges[] =
+{
+    0.0f, -0.0f, 0.5f, -0.5f, 1.5f, -1.5f, 2.5f, -2.5f, 0.49999997f, -0.49999997f,
+    32766.5f, 32767.0f, 32767.5f, 32768.0f, 40000.0f, -32767.5f, -32768.0f, -32768.5f, -40000.0f,
+    2147483520.0f, 2147483648.0f, 4294967296.0f, -2147483520.0f, -2147483648.0f, -4294967296.0f,
+    1e30f, -1e30f
+};
+
+template<typename In>
+static void fill(In *in, float scale)
+{
+    int i, e;
+
+    for(i = 0; i < COUNT; i++)
+    {
+        in[i] = (In)((rand() / (double)RAND_MAX * 2.4 - 1.2));
+    }
+
+    /* edge values, scaled back so that they hit the boundaries after the scaling of the kernel */
+    for(e = 0; e < (int)(sizeof(edges) / sizeof(edges[0])); e++)
+    {
+        in[e * 3 + 1] = (In)(edges[e] / scale);
+        in[e * 3 + 2] = edges[e];
+    }
+
+    in[COUNT - 3] = (In)std::numeric_limits<float>::infinity();
+    in[COUNT - 2] = (In) - std::numeric_limits<float>::infinity();
+    in[COUNT - 1] = (In)std::numeric_limits<float>::quiet_NaN();
+}
+
+template<typename In>
+static void test_kernels()
+{
+    static In in[COUNT];
+    static float dither[COUNT];
+    static int16_t out16[COUNT];
+    static int32_t out32[COUNT];
+    int i, len;
+
+    for(i = 0; i < COUNT; i++)
+    {
+        dither[i] = rand() / (float)RAND_MAX - 0.5f;
+    }
+
+    fill(in, 32766.0f);
+
+    /* lengths covering every possible scalar tail */
+    for(len = COUNT - 16; len <= COUNT; len++)
+    {
+        fluid_audio_convert_s16(in, dither, out16, len);
+
+        for(i = 0; i < len; i++)
+        {
+            TEST_ASSERT(out16[i] == round_clip_to<int16_t>((float)in[i] * 32766.0f + dither[i]));
+        }
+
+        fluid_audio_convert_s16(in, NULL, out16, len);
+
+        for(i = 0; i < len; i++)
+        {
+            TEST_ASSERT(out16[i] == round_clip_to<int16_t>((float)in[i] * 32766.0f));
+        }
+    }
+
+    fill(in, 2147483646.0f);
+
+    for(len = COUNT - 16; len <= COUNT; len++)
+    {
+        fluid_audio_convert_s32(in, out32, len, -1);
+
+        for(i = 0; i < len; i++)
+        {
+            TEST_ASSERT(out32[i] == round_clip_to<int32_t>(in[i] * 2147483646.0f));
+        }
+
+        fluid_audio_convert_s32(in, out32, len, ~(int32_t)0xFF);
+
+        for(i = 0; i < len; i++)
+        {
+            TEST_ASSERT(out32[i] == (int32_t)(round_clip_to<int32_t>(in[i] * 2147483646.0f) & ~(int32_t)0xFF));
+        }
+    }
+}
+
+int main(void)
+{
+    test_kernels<float>();
+    test_kernels<double>();
+
+    return EXIT_SUCCESS;
+}
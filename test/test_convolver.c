@@ -0,0 +1,137 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_convolver.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the partitioned convolution gives the same result as
+// a direct convolution, and that the synth can switch between reverb and convolution
+
+#define IR_LENGTH 300
+#define BLOCKS 20
+#define FRAMES 4096
+
+static float ir_left[IR_LENGTH], ir_right[IR_LENGTH];
+static fluid_real_t input[BLOCKS * FLUID_BUFSIZE];
+
+static fluid_real_t direct(const float *ir, int n)
+{
+    fluid_real_t sum = 0;
+    int i;
+
+    for(i = 0; i < IR_LENGTH && i <= n; i++)
+    {
+        sum += ir[i] * input[n - i];
+    }
+
+    return sum;
+}
+
+static void test_convolution(void)
+{
+    static fluid_real_t left[BLOCKS * FLUID_BUFSIZE], right[BLOCKS * FLUID_BUFSIZE];
+    fluid_convolver_t *conv = new_fluid_convolver(ir_left, ir_right, IR_LENGTH);
+    int i, b;
+
+    TEST_ASSERT(conv != NULL);
+    TEST_ASSERT(fluid_convolver_get_partitions(conv) == (IR_LENGTH + FLUID_BUFSIZE - 1) / FLUID_BUFSIZE);
+
+    for(b = 0; b < BLOCKS; b++)
+    {
+        fluid_convolver_processreplace(conv, &input[b * FLUID_BUFSIZE],
+                                       &left[b * FLUID_BUFSIZE], &right[b * FLUID_BUFSIZE]);
+    }
+
+    for(i = 0; i < BLOCKS * FLUID_BUFSIZE; i++)
+    {
+        TEST_ASSERT(FLUID_FABS(left[i] - direct(ir_left, i)) < 1e-5);
+        TEST_ASSERT(FLUID_FABS(right[i] - direct(ir_right, i)) < 1e-5);
+    }
+
+    // after a reset, the convolver starts over, and processmix adds to the output
+    fluid_convolver_reset(conv);
+
+    for(b = 0; b < BLOCKS; b++)
+    {
+        fluid_convolver_processmix(conv, &input[b * FLUID_BUFSIZE],
+                                   &left[b * FLUID_BUFSIZE], &right[b * FLUID_BUFSIZE]);
+    }
+
+    for(i = 0; i < BLOCKS * FLUID_BUFSIZE; i++)
+    {
+        TEST_ASSERT(FLUID_FABS(left[i] - 2 * direct(ir_left, i)) < 1e-5);
+        TEST_ASSERT(FLUID_FABS(right[i] - 2 * direct(ir_right, i)) < 1e-5);
+    }
+
+    delete_fluid_convolver(conv);
+}
+
+static float render(fluid_synth_t *synth)
+{
+    static float buf[2 * FRAMES];
+    float energy = 0;
+    int i;
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        energy += FLUID_FABS(buf[i]);
+    }
+
+    return energy;
+}
+
+static void test_synth(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    float dry, wet;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_ASSERT(fluid_synth_set_reverb_ir(synth, 1, ir_left, ir_right, IR_LENGTH) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_set_reverb_ir(synth, -1, ir_left, ir_right, 0) == FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 91, 0));
+    dry = render(synth);
+
+    // replacing the impulse response several times before rendering retires the older ones
+    TEST_SUCCESS(fluid_synth_set_reverb_ir(synth, -1, ir_left, NULL, IR_LENGTH));
+    TEST_SUCCESS(fluid_synth_set_reverb_ir(synth, 0, ir_left, ir_right, IR_LENGTH));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 91, 127));
+    wet = render(synth);
+    TEST_ASSERT(wet != dry);
+
+    TEST_SUCCESS(fluid_synth_set_reverb_ir(synth, -1, NULL, NULL, 0));
+    TEST_ASSERT(render(synth) > 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    int i;
+
+    for(i = 0; i < IR_LENGTH; i++)
+    {
+        // a decaying noise burst, different on both channels
+        ir_left[i] = (float)(((i * 7919) % 201) - 100) / 100 * exp(-i / 100.0);
+        ir_right[i] = (float)(((i * 104729) % 199) - 99) / 99 * exp(-i / 80.0);
+    }
+
+    for(i = 0; i < BLOCKS * FLUID_BUFSIZE; i++)
+    {
+        input[i] = (fluid_real_t)(((i * 31337) % 1001) - 500) / 500;
+    }
+
+    test_convolution();
+    test_synth();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+
+// this test makes sure that the default modulators merged into the voice zones of a
+// SoundFont follow fluid_synth_add_default_mod() and fluid_synth_remove_default_mod(),
+// and that the voices sharing them keep the modulators they started with
+
+#define MAX_VOICES 64
+
+static fluid_voice_t *last_voice;
+
+/* plays a note and copies the modulators of one of its voices, last_voice */
+static int play(fluid_synth_t *synth, int chan, fluid_mod_t *mods)
+{
+    fluid_voice_t *voices[MAX_VOICES];
+    unsigned int id;
+    int i, count = -1;
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, chan, 60, 100));
+    id = synth->storeid;
+
+    fluid_synth_get_voicelist(synth, voices, MAX_VOICES, -1);
+
+    for(i = 0; i < MAX_VOICES && voices[i] != NULL; i++)
+    {
+        if(fluid_voice_get_id(voices[i]) == id)
+        {
+            last_voice = voices[i];
+            count = voices[i]->mod_count;
+            FLUID_MEMCPY(mods, voices[i]->mod, count * sizeof(fluid_mod_t));
+        }
+    }
+
+    TEST_ASSERT(count > 0);
+    return count;
+}
+
+/* returns the modulator of the voice identical to mod */
+static fluid_mod_t *find(fluid_mod_t *mods, int count, const fluid_mod_t *mod)
+{
+    int i;
+
+    for(i = 0; i < count; i++)
+    {
+        if(fluid_mod_test_identity(&mods[i], mod))
+        {
+            return &mods[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* compares the modulators of two voices */
+static int same_mods(fluid_mod_t *mods, fluid_mod_t *mods2, int count)
+{
+    int i;
+
+    for(i = 0; i < count; i++)
+    {
+        if(!fluid_mod_test_identity(&mods[i], &mods2[i]) || mods[i].amount != mods2[i].amount)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+int main(void)
+{
+    static fluid_mod_t mods[FLUID_NUM_MOD], mods2[FLUID_NUM_MOD];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_mod_t *mod = new_fluid_mod();
+    fluid_voice_t *first_voice;
+    int count, count2;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(mod != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* the modulators merged at the first noteon are shared with the next one */
+    count = play(synth, 0, mods);
+    TEST_ASSERT(count > 0);
+    first_voice = last_voice;
+    count2 = play(synth, 0, mods2);
+    TEST_ASSERT(count2 == count);
+    TEST_ASSERT(same_mods(mods, mods2, count));
+    TEST_ASSERT(last_voice->mod == first_voice->mod);
+
+    /* a new default modulator shows up at the next noteon */
+    fluid_mod_set_source1(mod, 21, FLUID_MOD_CC | FLUID_MOD_UNIPOLAR | FLUID_MOD_LINEAR | FLUID_MOD_POSITIVE);
+    fluid_mod_set_source2(mod, FLUID_MOD_NONE, 0);
+    fluid_mod_set_dest(mod, GEN_FILTERFC);
+    fluid_mod_set_amount(mod, 1200.0);
+    TEST_SUCCESS(fluid_synth_add_default_mod(synth, mod, FLUID_SYNTH_ADD));
+
+    count2 = play(synth, 0, mods2);
+    TEST_ASSERT(count2 == count + 1);
+    TEST_ASSERT(find(mods2, count2, mod) != NULL);
+    TEST_ASSERT(find(mods2, count2, mod)->amount == 1200.0);
+
+    /* while the voice started before keeps its modulators */
+    TEST_ASSERT(first_voice->mod_count == count);
+    TEST_ASSERT(same_mods(mods, first_voice->mod, count));
+
+    /* and gets its own copy once one is added to it */
+    fluid_voice_add_mod(first_voice, mod, FLUID_VOICE_ADD);
+    TEST_ASSERT(first_voice->mod != last_voice->mod);
+    TEST_ASSERT(first_voice->mod_count == count + 1);
+    TEST_ASSERT(same_mods(mods, first_voice->mod, count));
+    TEST_ASSERT(find(last_voice->mod, last_voice->mod_count, mod)->amount == 1200.0);
+
+    /* so does a changed amount */
+    fluid_mod_set_amount(mod, 600.0);
+    TEST_SUCCESS(fluid_synth_add_default_mod(synth, mod, FLUID_SYNTH_OVERWRITE));
+
+    count2 = play(synth, 0, mods2);
+    TEST_ASSERT(count2 == count + 1);
+    TEST_ASSERT(find(mods2, count2, mod)->amount == 600.0);
+
+    /* the cache doesn't get in the way of the channels with a breath mode */
+    TEST_SUCCESS(fluid_synth_set_breath_mode(synth, 1, FLUID_CHANNEL_BREATH_POLY));
+    count2 = play(synth, 1, mods2);
+    TEST_ASSERT(count2 >= count + 1);
+    TEST_ASSERT(find(mods2, count2, mod)->amount == 600.0);
+
+    /* and removing it gets back the modulators from before */
+    TEST_SUCCESS(fluid_synth_remove_default_mod(synth, mod));
+
+    count2 = play(synth, 0, mods2);
+    TEST_ASSERT(count2 == count);
+    TEST_ASSERT(same_mods(mods, mods2, count));
+
+    delete_fluid_mod(mod);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
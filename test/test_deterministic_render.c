@@ -0,0 +1,89 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include <string.h>
+
+// this test makes sure that with synth.deterministic-render, rendering with additional
+// mixer threads produces exactly the same audio as rendering with a single thread, also
+// while voices start and finish
+
+#define BLOCK 512
+#define BLOCKS 96
+#define SAMPLES (BLOCK * BLOCKS)
+
+static void render(int cores, float *left, float *right)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int chan, key, i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.deterministic-render", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", cores));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.mixer-thread-wait", "hybrid"));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 3));
+    }
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        /* silence every other channel in the middle of the run, so that voices finish
+         * between the others and new ones take their places */
+        if(i == BLOCKS / 2)
+        {
+            for(chan = 0; chan < 8; chan += 2)
+            {
+                TEST_SUCCESS(fluid_synth_all_sounds_off(synth, chan));
+            }
+        }
+
+        if(i < BLOCKS * 3 / 4)
+        {
+            chan = i % 8;
+            key = 36 + (i * 7) % 48;
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 60 + i % 40));
+            TEST_SUCCESS(fluid_synth_noteon(synth, (chan + 3) % 8, key + 2, 90));
+
+            if(i >= 8)
+            {
+                fluid_synth_noteoff(synth, (i - 8) % 8, 36 + ((i - 8) * 7) % 48);
+            }
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, BLOCK, left, i * BLOCK, 1, right, i * BLOCK, 1));
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static float ref_l[SAMPLES], ref_r[SAMPLES];
+    static float mt_l[SAMPLES], mt_r[SAMPLES];
+    int i, cores;
+    float energy;
+
+    render(1, ref_l, ref_r);
+
+    for(i = 0, energy = 0; i < SAMPLES; i++)
+    {
+        energy += ref_l[i] * ref_l[i] + ref_r[i] * ref_r[i];
+    }
+
+    TEST_ASSERT(energy > 0);
+
+    for(cores = 2; cores <= 8; cores += 3)
+    {
+        render(cores, mt_l, mt_r);
+        TEST_ASSERT(memcmp(ref_l, mt_l, sizeof(ref_l)) == 0);
+        TEST_ASSERT(memcmp(ref_r, mt_r, sizeof(ref_r)) == 0);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the waves of a DLS file loaded by several synths are converted
+// only once and shared through the sample cache, and that converting them from the mapped
+// file gives the same result as reading them through custom file callbacks
+
+#define FRAMES 4096
+
+#ifdef ENABLE_NATIVE_DLS
+static int wrapped_fread(void *buf, fluid_long_long_t count, void *handle)
+{
+    return safe_fread(buf, count, handle);
+}
+
+static int wrapped_fseek(void *handle, fluid_long_long_t offset, int origin)
+{
+    return safe_fseek(handle, offset, origin);
+}
+
+static fluid_synth_t *load(fluid_settings_t *settings, int wrap_callbacks, int *id)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    fluid_list_t *list;
+
+    TEST_ASSERT(synth != NULL);
+
+    // the waves can only be mapped when the default file callbacks are used
+    for(list = synth->loaders; wrap_callbacks && list; list = fluid_list_next(list))
+    {
+        TEST_SUCCESS(fluid_sfloader_set_callbacks(fluid_list_get(list), default_fopen, wrapped_fread,
+                     wrapped_fseek, default_ftell, default_fclose));
+    }
+
+    *id = fluid_synth_sfload(synth, TEST_DLS, 1);
+    TEST_ASSERT(*id != FLUID_FAILED);
+    return synth;
+}
+
+static void render(fluid_synth_t *synth, int id, float *buf)
+{
+    fluid_sfont_t *sfont = fluid_synth_get_sfont_by_id(synth, id);
+    fluid_preset_t *preset;
+    int chan = 0;
+    int i;
+    float energy = 0;
+
+    TEST_ASSERT(sfont != NULL);
+    fluid_sfont_iteration_start(sfont);
+
+    while(chan < 8 && (preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        TEST_SUCCESS(fluid_synth_program_select(synth, chan, id, fluid_preset_get_banknum(preset),
+                                                fluid_preset_get_num(preset)));
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 48 + chan * 3, 100));
+        chan++;
+    }
+
+    TEST_ASSERT(chan > 0);
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        energy += FLUID_FABS(buf[i]);
+    }
+
+    TEST_ASSERT(energy > 0);
+}
+#endif
+
+int main(void)
+{
+#ifdef ENABLE_NATIVE_DLS
+    static float mapped[2 * FRAMES], shared[2 * FRAMES], read[2 * FRAMES];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth1, *synth2;
+    int id1, id2, i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    // both synths use the waves converted by the first one
+    synth1 = load(settings, FALSE, &id1);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 1);
+    synth2 = load(settings, FALSE, &id2);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 1);
+
+    render(synth1, id1, mapped);
+    render(synth2, id2, shared);
+
+    delete_fluid_synth(synth1);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 1);
+    delete_fluid_synth(synth2);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    // without the cache entry, the waves are read through the file callbacks
+    synth1 = load(settings, TRUE, &id1);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 1);
+    render(synth1, id1, read);
+    delete_fluid_synth(synth1);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(mapped[i] == shared[i]);
+        TEST_ASSERT(mapped[i] == read[i]);
+    }
+
+    delete_fluid_settings(settings);
+#endif
+
+    return EXIT_SUCCESS;
+}
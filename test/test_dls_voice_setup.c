@@ -0,0 +1,156 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+
+// this test makes sure that the voices of DLS regions get the same generators and modulators
+// from the setup flattened at load, as from adding the articulation modulators one by one,
+// which is still done on channels replacing default modulators by the breath modulator
+
+#define MAX_VOICES 64
+
+#ifdef ENABLE_NATIVE_DLS
+/* plays a note and returns its voices */
+static int play(fluid_synth_t *synth, int chan, fluid_voice_t **voices)
+{
+    fluid_voice_t *list[MAX_VOICES];
+    unsigned int id;
+    int i, count = 0;
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, chan, 60, 100));
+    id = synth->storeid;
+
+    fluid_synth_get_voicelist(synth, list, MAX_VOICES, -1);
+
+    for(i = 0; i < MAX_VOICES && list[i] != NULL; i++)
+    {
+        if(fluid_voice_get_id(list[i]) == id && fluid_voice_get_channel(list[i]) == chan)
+        {
+            voices[count++] = list[i];
+        }
+    }
+
+    return count;
+}
+
+/* returns TRUE if the voice has a modulator identical to mod, with the same amount */
+static int has_mod(const fluid_voice_t *voice, const fluid_mod_t *mod)
+{
+    int i;
+
+    for(i = 0; i < voice->mod_count; i++)
+    {
+        if(fluid_mod_test_identity(&voice->mod[i], mod))
+        {
+            return voice->mod[i].amount == mod->amount;
+        }
+    }
+
+    return FALSE;
+}
+
+/* returns TRUE if each modulator of voice, except those depending on velocity or breath, is one of voice2 */
+static int has_mods_of(const fluid_voice_t *voice, const fluid_voice_t *voice2)
+{
+    int i;
+
+    for(i = 0; i < voice->mod_count; i++)
+    {
+        const fluid_mod_t *mod = &voice->mod[i];
+
+        if(((mod->flags1 & FLUID_MOD_CC) == 0 && mod->src1 == FLUID_MOD_VELOCITY)
+                || ((mod->flags1 & FLUID_MOD_CC) != 0 && mod->src1 == BREATH_MSB))
+        {
+            continue;
+        }
+
+        if(!has_mod(voice2, mod))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+#endif
+
+int main(void)
+{
+#ifdef ENABLE_NATIVE_DLS
+    static float buf[2 * 64];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sfont_t *sfont;
+    fluid_preset_t *preset;
+    fluid_voice_t *voices[MAX_VOICES], *voices2[MAX_VOICES];
+    int id, i, g, gen, count, count2, presets = 0;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    id = fluid_synth_sfload(synth, TEST_DLS, 1);
+    TEST_ASSERT(id != FLUID_FAILED);
+    sfont = fluid_synth_get_sfont_by_id(synth, id);
+    TEST_ASSERT(sfont != NULL);
+
+    // channel 1 takes the path adding the modulators one by one
+    TEST_SUCCESS(fluid_synth_set_breath_mode(synth, 1, FLUID_CHANNEL_BREATH_POLY));
+
+    fluid_sfont_iteration_start(sfont);
+
+    while((preset = fluid_sfont_iteration_next(sfont)) != NULL)
+    {
+        TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, fluid_preset_get_banknum(preset),
+                                                fluid_preset_get_num(preset)));
+        TEST_SUCCESS(fluid_synth_program_select(synth, 1, id, fluid_preset_get_banknum(preset),
+                                                fluid_preset_get_num(preset)));
+
+        count = play(synth, 0, voices);
+        count2 = play(synth, 1, voices2);
+        TEST_ASSERT(count == count2);
+
+        for(i = 0; i < count; i++)
+        {
+            /* the voice of the same region on the other channel */
+            for(g = 0; g < count2; g++)
+            {
+                if(voices2[g] != NULL && voices2[g]->sample == voices[i]->sample)
+                {
+                    break;
+                }
+            }
+
+            TEST_ASSERT(g < count2);
+
+            TEST_ASSERT(has_mod(voices[i], &default_vel2att_mod));
+            TEST_ASSERT(!has_mod(voices2[g], &default_vel2att_mod));
+            TEST_ASSERT(has_mods_of(voices[i], voices2[g]));
+            TEST_ASSERT(has_mods_of(voices2[g], voices[i]));
+
+            for(gen = 0; gen < GEN_LAST; gen++)
+            {
+                TEST_ASSERT(voices[i]->gen[gen].val == voices2[g]->gen[gen].val);
+                TEST_ASSERT(voices[i]->gen[gen].flags == voices2[g]->gen[gen].flags);
+            }
+
+            TEST_ASSERT(voices[i]->gen[GEN_EXCLUSIVECLASS].flags == GEN_SET);
+            TEST_ASSERT(voices[i]->gen[GEN_SAMPLEMODE].flags == GEN_SET);
+            voices2[g] = NULL;
+        }
+
+        /* frees the voices for the next preset */
+        fluid_synth_all_sounds_off(synth, -1);
+        TEST_SUCCESS(fluid_synth_write_float(synth, 64, buf, 0, 2, buf, 1, 2));
+        presets++;
+    }
+
+    TEST_ASSERT(presets > 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+#endif
+
+    return EXIT_SUCCESS;
+}
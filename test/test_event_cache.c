@@ -0,0 +1,85 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "utils/fluid_object_cache.h"
+
+// this test makes sure that MIDI and sequencer events reused from the cache of deleted
+// events are as fresh as newly allocated ones, and that the cache neither loses nor
+// hands out an object twice
+
+#define EVENTS (2 * FLUID_OBJECT_CACHE_SLOTS)
+
+int main(void)
+{
+    static fluid_object_cache_t cache = FLUID_OBJECT_CACHE_INIT;
+    static int objects[EVENTS];
+    fluid_midi_event_t *midi[EVENTS];
+    fluid_event_t *seq[EVENTS];
+    int i, j;
+
+    for(i = 0; i < EVENTS; i++)
+    {
+        midi[i] = new_fluid_midi_event();
+        TEST_ASSERT(midi[i] != NULL);
+        TEST_SUCCESS(fluid_midi_event_set_type(midi[i], 0x90));
+        TEST_SUCCESS(fluid_midi_event_set_channel(midi[i], 3));
+        TEST_SUCCESS(fluid_midi_event_set_key(midi[i], 60));
+        TEST_SUCCESS(fluid_midi_event_set_sysex(midi[i], FLUID_MALLOC(4), 4, TRUE));
+
+        seq[i] = new_fluid_event();
+        TEST_ASSERT(seq[i] != NULL);
+        fluid_event_set_source(seq[i], 1);
+        fluid_event_set_dest(seq[i], 2);
+        fluid_event_noteon(seq[i], 3, 60, 100);
+    }
+
+    for(i = 0; i < EVENTS; i++)
+    {
+        delete_fluid_midi_event(midi[i]);
+        delete_fluid_event(seq[i]);
+    }
+
+    for(i = 0; i < EVENTS; i++)
+    {
+        midi[i] = new_fluid_midi_event();
+        TEST_ASSERT(midi[i] != NULL);
+        TEST_ASSERT(fluid_midi_event_get_type(midi[i]) == 0);
+        TEST_ASSERT(fluid_midi_event_get_channel(midi[i]) == 0);
+        TEST_ASSERT(fluid_midi_event_get_key(midi[i]) == 0);
+
+        seq[i] = new_fluid_event();
+        TEST_ASSERT(seq[i] != NULL);
+        TEST_ASSERT(fluid_event_get_type(seq[i]) == -1);
+        TEST_ASSERT(fluid_event_get_source(seq[i]) == -1);
+        TEST_ASSERT(fluid_event_get_dest(seq[i]) == -1);
+    }
+
+    for(i = 0; i < EVENTS; i++)
+    {
+        delete_fluid_midi_event(midi[i]);
+        delete_fluid_event(seq[i]);
+    }
+
+    /* the cache keeps a limited number of objects, each of them once */
+    for(i = 0; i < EVENTS; i++)
+    {
+        TEST_ASSERT(fluid_object_cache_put(&cache, &objects[i]) == (i < FLUID_OBJECT_CACHE_SLOTS));
+    }
+
+    for(i = 0; i < FLUID_OBJECT_CACHE_SLOTS; i++)
+    {
+        int *obj = fluid_object_cache_take(&cache);
+
+        TEST_ASSERT(obj != NULL && obj >= objects && obj < objects + FLUID_OBJECT_CACHE_SLOTS);
+        TEST_ASSERT(*obj == 0);
+        *obj = 1;
+    }
+
+    TEST_ASSERT(fluid_object_cache_take(&cache) == NULL);
+
+    for(j = 0; j < FLUID_OBJECT_CACHE_SLOTS; j++)
+    {
+        TEST_ASSERT(objects[j] == 1);
+    }
+
+    return EXIT_SUCCESS;
+}
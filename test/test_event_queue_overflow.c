@@ -0,0 +1,84 @@
+#include "test.h"
+#include "fluidsynth.h"
+
+#include <string.h>
+
+// this test makes sure that no events for the mixer are lost when more of them are
+// queued between two render calls than the event queue can hold
+
+#define FRAMES 64
+#define BLOCKS 20
+#define POLYPHONY 4
+#define NOTES 2 /* the test SoundFont plays each note with two voices */
+#define UPDATES 1000
+
+static fluid_synth_t *create(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    int i;
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    for(i = 0; i < NOTES; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60 + i, 100));
+    }
+
+    return synth;
+}
+
+static void render(fluid_synth_t *synth, float *out)
+{
+    int i;
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, out, 0, 2, out, 1, 2));
+        out += 2 * FRAMES;
+    }
+}
+
+int main(void)
+{
+    static float ref[2 * FRAMES * BLOCKS], out[2 * FRAMES * BLOCKS];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int i, queue_size;
+
+    /* the queue holds 64 events per voice */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    queue_size = POLYPHONY * 64;
+
+    /* only the last update sets the filter cutoff of the voices */
+    synth = create(settings);
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_FILTERFC, 3000.0f));
+    render(synth, ref);
+    TEST_ASSERT(fluid_synth_get_event_queue_peak(synth) < queue_size);
+    delete_fluid_synth(synth);
+
+    /* every update is queued for each voice, which are too many events for the queue */
+    synth = create(settings);
+
+    for(i = 0; i < UPDATES; i++)
+    {
+        TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_FILTERFC, 5000.0f + i));
+    }
+
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_FILTERFC, 3000.0f));
+    TEST_ASSERT(fluid_synth_get_event_queue_peak(synth) > queue_size);
+    render(synth, out);
+    TEST_ASSERT(memcmp(ref, out, sizeof(ref)) == 0);
+
+    /* once dispatched, events go through the queue again */
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_FILTERFC, 4000.0f));
+    render(synth, out);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == POLYPHONY);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
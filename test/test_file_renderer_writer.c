@@ -0,0 +1,92 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the file renderer writes the same file, no matter whether a writer
+// thread writes the audio in large chunks or the audio is written synchronously
+
+#define PERIODS 1500
+
+static long render(fluid_settings_t *settings, const char *filename, int buffers)
+{
+    fluid_synth_t *synth;
+    fluid_file_renderer_t *renderer;
+    FILE *file;
+    long size;
+    int i;
+
+    TEST_SUCCESS(fluid_settings_setstr(settings, "audio.file.name", filename));
+    TEST_SUCCESS(fluid_settings_setint(settings, "audio.file.buffers", buffers));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    renderer = new_fluid_file_renderer(synth);
+    TEST_ASSERT(renderer != NULL);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 9, 38, 100));
+
+    for(i = 0; i < PERIODS; i++)
+    {
+        TEST_SUCCESS(fluid_file_renderer_process_block(renderer));
+    }
+
+    /* writes what is still buffered */
+    delete_fluid_file_renderer(renderer);
+    delete_fluid_synth(synth);
+
+    file = FLUID_FOPEN(filename, "rb");
+    TEST_ASSERT(file != NULL);
+    TEST_ASSERT(fseek(file, 0, SEEK_END) == 0);
+    size = ftell(file);
+    TEST_ASSERT(FLUID_FCLOSE(file) == 0);
+
+    return size;
+}
+
+static void compare(const char *filename1, const char *filename2, long size)
+{
+    FILE *file1 = FLUID_FOPEN(filename1, "rb");
+    FILE *file2 = FLUID_FOPEN(filename2, "rb");
+    long i;
+
+    TEST_ASSERT(file1 != NULL && file2 != NULL);
+
+    for(i = 0; i < size; i++)
+    {
+        TEST_ASSERT(fgetc(file1) == fgetc(file2));
+    }
+
+    FLUID_FCLOSE(file1);
+    FLUID_FCLOSE(file2);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    int period_size;
+    long size;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "audio.file.type", "raw"));
+    TEST_SUCCESS(fluid_settings_getint(settings, "audio.period-size", &period_size));
+
+    /* the whole audio, also the part not filling a buffer of the writer thread */
+    size = render(settings, "test_file_renderer_writer_sync.raw", 1);
+    TEST_ASSERT(size == 2L * 2 * period_size * PERIODS);
+    TEST_ASSERT(render(settings, "test_file_renderer_writer_async.raw", 4) == size);
+    compare("test_file_renderer_writer_sync.raw", "test_file_renderer_writer_async.raw", size);
+
+    /* a writer thread with just two buffers, alternating */
+    TEST_ASSERT(render(settings, "test_file_renderer_writer_async.raw", 2) == size);
+    compare("test_file_renderer_writer_sync.raw", "test_file_renderer_writer_async.raw", size);
+
+    remove("test_file_renderer_writer_sync.raw");
+    remove("test_file_renderer_writer_async.raw");
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
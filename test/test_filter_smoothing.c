@@ -0,0 +1,98 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include <math.h>
+
+// this test makes sure that interpolating the filter coefficients block-wise follows the
+// per-sample coefficient updates closely
+
+#define SAMPLES 8192
+#define CHUNKS 8
+#define MAX_ABS_DELTA_BLOCK 2.5e-2f
+
+static void render(fluid_settings_t *settings, const char *smoothing, int custom, float *left, float *right)
+{
+    fluid_synth_t *synth;
+    int chan, key, chunk;
+
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.filter-smoothing", smoothing));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+
+    if(custom)
+    {
+        TEST_SUCCESS(fluid_synth_set_custom_filter(synth, FLUID_IIR_HIGHPASS, 0));
+    }
+
+    for(chan = 0; chan < 12; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, (chan % 3) * 11));
+        TEST_SUCCESS(fluid_synth_set_gen(synth, chan, GEN_CUSTOM_FILTERFC, 4000));
+        TEST_SUCCESS(fluid_synth_set_gen(synth, chan, GEN_CUSTOM_FILTERQ, 60));
+
+        for(key = 36; key < 96; key += 12)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 90));
+        }
+    }
+
+    /* sweep the filters of all voices, so that their coefficients keep changing */
+    for(chunk = 0; chunk < CHUNKS; chunk++)
+    {
+        int offset = chunk * (SAMPLES / CHUNKS);
+
+        for(chan = 0; chan < 12; chan++)
+        {
+            TEST_SUCCESS(fluid_synth_set_gen(synth, chan, GEN_FILTERFC, 6000 + ((chunk + chan) % 4) * 1500));
+            TEST_SUCCESS(fluid_synth_set_gen(synth, chan, GEN_FILTERQ, (chunk % 3) * 30));
+        }
+
+        if(chunk == CHUNKS / 2)
+        {
+            /* let some voices finish in the middle of the sweep */
+            for(chan = 0; chan < 12; chan += 2)
+            {
+                TEST_SUCCESS(fluid_synth_noteoff(synth, chan, 48));
+            }
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES / CHUNKS, left + offset, 0, 1, right + offset, 0, 1));
+    }
+
+    delete_fluid_synth(synth);
+}
+
+int main(void)
+{
+    static float ref_l[SAMPLES], ref_r[SAMPLES];
+    static float block_l[SAMPLES], block_r[SAMPLES];
+    fluid_settings_t *settings;
+    int custom, i;
+    float energy = 0;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    for(custom = 0; custom <= 1; custom++)
+    {
+        render(settings, "sample", custom, ref_l, ref_r);
+        render(settings, "block", custom, block_l, block_r);
+
+        for(i = 0; i < SAMPLES; i++)
+        {
+            energy += fabsf(ref_l[i]) + fabsf(ref_r[i]);
+
+            TEST_ASSERT(fabsf(ref_l[i] - block_l[i]) < MAX_ABS_DELTA_BLOCK);
+            TEST_ASSERT(fabsf(ref_r[i] - block_r[i]) < MAX_ABS_DELTA_BLOCK);
+        }
+    }
+
+    TEST_ASSERT(energy > 0);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
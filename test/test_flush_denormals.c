@@ -0,0 +1,69 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+#include <float.h>
+
+// this test makes sure that denormal numbers are flushed to zero while rendering only
+
+#define FRAMES 4096
+
+/* halves the smallest normal number, which is a denormal number unless flushed */
+static float make_denormal(void)
+{
+    volatile float f = FLT_MIN;
+
+    f *= 0.5f;
+    return f;
+}
+
+static void render(int flush, float *left, float *right)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.flush-denormals", flush));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+
+    /* the mode of the calling thread is restored */
+    TEST_ASSERT(make_denormal() != 0.0f);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static float left[FRAMES], right[FRAMES], left2[FRAMES], right2[FRAMES];
+    unsigned int mode;
+    int i;
+
+    TEST_ASSERT(make_denormal() != 0.0f);
+
+    mode = fluid_denormals_flush_enter();
+#if defined(__SSE2__) || defined(_M_X64) || defined(__aarch64__)
+    TEST_ASSERT(make_denormal() == 0.0f);
+#endif
+    fluid_denormals_flush_exit(mode);
+
+    TEST_ASSERT(make_denormal() != 0.0f);
+
+    /* flushing only changes what is far below audible */
+    render(TRUE, left, right);
+    render(FALSE, left2, right2);
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(FLUID_FABS(left[i] - left2[i]) < 1e-6);
+        TEST_ASSERT(FLUID_FABS(right[i] - right2[i]) < 1e-6);
+    }
+
+    return EXIT_SUCCESS;
+}
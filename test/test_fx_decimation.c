@@ -0,0 +1,173 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_fx_resampler.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the effects decimation passes the audible band, suppresses
+// what the reduced rate can't represent, and doesn't change the dry output of the synth
+
+#define BLOCKS 64
+#define FRAMES 256
+#define CHUNKS 64
+
+/* Returns the RMS of the difference between a sine and its decimated and interpolated
+ * copy, or of the copy alone if compare is FALSE */
+static double resample_sine(int factor, double freq, int compare)
+{
+    static fluid_real_t in[BLOCKS * FLUID_BUFSIZE], left[BLOCKS * FLUID_BUFSIZE], right[BLOCKS * FLUID_BUFSIZE];
+    fluid_fx_resampler_t *rs = new_fluid_fx_resampler();
+    const fluid_real_t *low_in;
+    fluid_real_t *low_l, *low_r;
+    int delay = factor * FLUID_BUFSIZE + ((factor > 1) ? 15 * factor : 0); /* block and filters */
+    double sum = 0, d;
+    int i, b;
+
+    TEST_ASSERT(rs != NULL);
+    fluid_fx_resampler_set_factor(rs, factor);
+    TEST_ASSERT(fluid_fx_resampler_get_factor(rs) == factor);
+
+    for(i = 0; i < BLOCKS * FLUID_BUFSIZE; i++)
+    {
+        in[i] = (fluid_real_t)sin(2 * M_PI * freq * i);
+    }
+
+    for(b = 0; b < BLOCKS; b++)
+    {
+        TEST_ASSERT(fluid_fx_resampler_is_between_blocks(rs) == (b % factor == 0));
+        low_in = fluid_fx_resampler_push(rs, &in[b * FLUID_BUFSIZE]);
+        fluid_fx_resampler_pull(rs, &left[b * FLUID_BUFSIZE], &right[b * FLUID_BUFSIZE], FALSE);
+        TEST_ASSERT((low_in != NULL) == (b % factor == factor - 1));
+
+        if(low_in != NULL)
+        {
+            /* the unit copies its input to the left channel and inverts it on the right one */
+            fluid_fx_resampler_get_output(rs, &low_l, &low_r);
+
+            for(i = 0; i < FLUID_BUFSIZE; i++)
+            {
+                low_l[i] = low_in[i];
+                low_r[i] = -low_in[i];
+            }
+
+            fluid_fx_resampler_commit(rs);
+        }
+    }
+
+    /* skip the time the filters take to settle */
+    for(i = 4 * delay; i < BLOCKS * FLUID_BUFSIZE; i++)
+    {
+        TEST_ASSERT(left[i] == -right[i]);
+        d = compare ? left[i] - in[i - delay] : left[i];
+        sum += d * d;
+    }
+
+    delete_fluid_fx_resampler(rs);
+    return sqrt(sum / (BLOCKS * FLUID_BUFSIZE - 4 * delay));
+}
+
+static void test_resampler(void)
+{
+    int factor;
+
+    for(factor = 1; factor <= FLUID_FX_RESAMPLER_MAX_FACTOR; factor *= 2)
+    {
+        /* 1 kHz and 15 kHz at 96 kHz times half the factor go through, delayed */
+        TEST_ASSERT(resample_sine(factor, 1000.0 / (48000 * factor), TRUE) < 1e-3);
+        TEST_ASSERT(resample_sine(factor, 15000.0 / (48000 * factor), TRUE) < 1e-3);
+
+        if(factor > 1)
+        {
+            /* well above the reduced Nyquist frequency, only the aliases are left */
+            TEST_ASSERT(resample_sine(factor, 0.8 / factor, FALSE) < 1e-3);
+        }
+    }
+}
+
+/* Renders a note with reverb and chorus, the effects into separate buffers */
+static void render(int sample_rate, int decimation, float *dry, float *fx)
+{
+    static float left[FRAMES], right[FRAMES], rev_l[FRAMES], rev_r[FRAMES], ch_l[FRAMES], ch_r[FRAMES];
+    float *out_bufs[2] = { left, right };
+    float *fx_bufs[4] = { rev_l, rev_r, ch_l, ch_r };
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int c, k;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", sample_rate));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.fx-decimation", decimation));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 91, 127));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 93, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 120));
+
+    for(c = 0; c < CHUNKS; c++)
+    {
+        if(c == CHUNKS / 2)
+        {
+            TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+        }
+
+        FLUID_MEMSET(left, 0, sizeof(left));
+        FLUID_MEMSET(right, 0, sizeof(right));
+        FLUID_MEMSET(rev_l, 0, sizeof(rev_l));
+        FLUID_MEMSET(rev_r, 0, sizeof(rev_r));
+        FLUID_MEMSET(ch_l, 0, sizeof(ch_l));
+        FLUID_MEMSET(ch_r, 0, sizeof(ch_r));
+        TEST_SUCCESS(fluid_synth_process(synth, FRAMES, 4, fx_bufs, 2, out_bufs));
+
+        for(k = 0; k < FRAMES; k++)
+        {
+            dry[(c * FRAMES + k) * 2] = left[k];
+            dry[(c * FRAMES + k) * 2 + 1] = right[k];
+            fx[(c * FRAMES + k) * 2] = rev_l[k] + ch_l[k];
+            fx[(c * FRAMES + k) * 2 + 1] = rev_r[k] + ch_r[k];
+        }
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+static void test_synth(void)
+{
+    enum { SAMPLES = 2 * FRAMES * CHUNKS };
+    static float dry_full[SAMPLES], fx_full[SAMPLES], dry_reduced[SAMPLES], fx_reduced[SAMPLES];
+    double full_energy = 0, reduced_energy = 0;
+    int i;
+
+    /* at 96 kHz, the effects run at 48 kHz and sound about the same */
+    render(96000, 1, dry_full, fx_full);
+    render(96000, 2, dry_reduced, fx_reduced);
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        TEST_ASSERT(dry_full[i] == dry_reduced[i]);
+        full_energy += fx_full[i] * fx_full[i];
+        reduced_energy += fx_reduced[i] * fx_reduced[i];
+    }
+
+    TEST_ASSERT(full_energy > 0);
+    TEST_ASSERT(reduced_energy > 0.5 * full_energy && reduced_energy < 2 * full_energy);
+
+    /* at 48 kHz, the rate is never reduced */
+    render(48000, 1, dry_full, fx_full);
+    render(48000, 4, dry_reduced, fx_reduced);
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        TEST_ASSERT(dry_full[i] == dry_reduced[i]);
+        TEST_ASSERT(fx_full[i] == fx_reduced[i]);
+    }
+}
+
+int main(void)
+{
+    test_resampler();
+    test_synth();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_hash.h"
+
+// this test makes sure that the hash table finds every key it holds, also after keys have been
+// removed by key, by iterator and by fluid_hashtable_foreach_steal(), and that it calls the destroy
+// functions exactly once for every key and value it drops
+
+#define KEYS 5000
+
+static int keys_destroyed, values_destroyed;
+
+static void destroy_key(void *key)
+{
+    keys_destroyed++;
+    FLUID_FREE(key);
+}
+
+static void destroy_value(void *value)
+{
+    values_destroyed++;
+}
+
+static int is_multiple_of_8(void *key, void *value, void *data)
+{
+    (*(int *)data)++;
+
+    if((FLUID_POINTER_TO_INT(value) - 1) % 8 != 0)
+    {
+        return FALSE;
+    }
+
+    /* stolen keys are owned by the caller, the table doesn't look at them anymore */
+    FLUID_FREE(key);
+    return TRUE;
+}
+
+static char *make_key(int i)
+{
+    char *key = FLUID_MALLOC(16);
+    TEST_ASSERT(key != NULL);
+    FLUID_SNPRINTF(key, 16, "key%d", i);
+    return key;
+}
+
+static void check_keys(fluid_hashtable_t *table, int step, int count)
+{
+    char key[16];
+    int i;
+
+    TEST_ASSERT(fluid_hashtable_size(table) == (unsigned int)count);
+
+    for(i = 0; i < KEYS; i++)
+    {
+        FLUID_SNPRINTF(key, sizeof(key), "key%d", i);
+        TEST_ASSERT((fluid_hashtable_lookup(table, key) != NULL) == (i % step == 0));
+    }
+}
+
+int main(void)
+{
+    fluid_hashtable_t *table;
+    fluid_hashtable_iter_t iter;
+    void *key, *value;
+    char lookup[16];
+    int i, visited, count;
+
+    table = new_fluid_hashtable_full(fluid_str_hash, fluid_str_equal, destroy_key, destroy_value);
+    TEST_ASSERT(table != NULL);
+
+    for(i = 0; i < KEYS; i++)
+    {
+        /* values are i + 1, so that none of them is NULL */
+        fluid_hashtable_insert(table, make_key(i), FLUID_INT_TO_POINTER(i + 1));
+    }
+
+    check_keys(table, 1, KEYS);
+    TEST_ASSERT(keys_destroyed == 0 && values_destroyed == 0);
+
+    /* inserting an existing key drops the new key and the old value */
+    fluid_hashtable_insert(table, make_key(7), FLUID_INT_TO_POINTER(8));
+    TEST_ASSERT(keys_destroyed == 1 && values_destroyed == 1);
+    TEST_ASSERT(fluid_hashtable_size(table) == KEYS);
+
+    /* remove the odd keys, the table shrinks on the way */
+    for(i = 1; i < KEYS; i += 2)
+    {
+        FLUID_SNPRINTF(lookup, sizeof(lookup), "key%d", i);
+        TEST_ASSERT(fluid_hashtable_remove(table, lookup));
+        TEST_ASSERT(!fluid_hashtable_remove(table, lookup));
+    }
+
+    check_keys(table, 2, KEYS / 2);
+    TEST_ASSERT(keys_destroyed == 1 + KEYS / 2 && values_destroyed == 1 + KEYS / 2);
+
+    /* remove the keys that aren't multiples of 4 while iterating */
+    visited = 0;
+    fluid_hashtable_iter_init(&iter, table);
+
+    while(fluid_hashtable_iter_next(&iter, &key, &value))
+    {
+        visited++;
+
+        if((FLUID_POINTER_TO_INT(value) - 1) % 4 != 0)
+        {
+            fluid_hashtable_iter_remove(&iter);
+        }
+    }
+
+    TEST_ASSERT(visited == KEYS / 2);
+    check_keys(table, 4, KEYS / 4);
+
+    /* steal the keys that are multiples of 8 */
+    visited = 0;
+    count = fluid_hashtable_foreach_steal(table, is_multiple_of_8, &visited);
+    TEST_ASSERT(visited == KEYS / 4);
+    TEST_ASSERT(count == (KEYS + 7) / 8);
+
+    for(i = 0; i < KEYS; i += 4)
+    {
+        FLUID_SNPRINTF(lookup, sizeof(lookup), "key%d", i);
+        TEST_ASSERT((fluid_hashtable_lookup(table, lookup) == NULL) == (i % 8 == 0));
+    }
+
+    count = keys_destroyed;
+    delete_fluid_hashtable(table);
+    TEST_ASSERT(keys_destroyed == count + KEYS / 4 - (KEYS + 7) / 8);
+
+    /* pointer keys, with their low bits clear */
+    table = new_fluid_hashtable(NULL, NULL);
+    TEST_ASSERT(table != NULL);
+
+    for(i = 1; i <= KEYS; i++)
+    {
+        fluid_hashtable_insert(table, FLUID_INT_TO_POINTER(i * 64), FLUID_INT_TO_POINTER(i));
+    }
+
+    for(i = 1; i <= KEYS; i++)
+    {
+        TEST_ASSERT(fluid_hashtable_lookup(table, FLUID_INT_TO_POINTER(i * 64)) == FLUID_INT_TO_POINTER(i));
+        TEST_ASSERT(fluid_hashtable_lookup(table, FLUID_INT_TO_POINTER(i * 64 + 1)) == NULL);
+    }
+
+    fluid_hashtable_remove_all(table);
+    TEST_ASSERT(fluid_hashtable_size(table) == 0);
+    TEST_ASSERT(fluid_hashtable_lookup(table, FLUID_INT_TO_POINTER(64)) == NULL);
+    delete_fluid_hashtable(table);
+
+    return EXIT_SUCCESS;
+}
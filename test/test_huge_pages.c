@@ -0,0 +1,74 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that memory allocated for huge pages is usable and aligned to them,
+// and that a synth with synth.huge-pages enabled sounds like any other synth
+
+#define FRAMES 4096
+
+static void render(fluid_settings_t *settings, int huge_pages, float *buf)
+{
+    fluid_synth_t *synth;
+    int chan;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.huge-pages", huge_pages));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 7));
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 40 + chan * 5, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    delete_fluid_synth(synth);
+}
+
+int main(void)
+{
+    static float ref[2 * FRAMES], out[2 * FRAMES];
+    fluid_settings_t *settings;
+    char *mem;
+    int i;
+
+    mem = fluid_alloc_huge(2 * FLUID_HUGE_PAGE_SIZE, TRUE);
+    TEST_ASSERT(mem != NULL);
+#if FLUID_HAVE_HUGE_PAGES
+    TEST_ASSERT((uintptr_t)mem % FLUID_HUGE_PAGE_SIZE == 0);
+#endif
+    FLUID_MEMSET(mem, 1, 2 * FLUID_HUGE_PAGE_SIZE);
+
+    /* it's okay if locking isn't permitted */
+    if(fluid_mlock(mem, 2 * FLUID_HUGE_PAGE_SIZE) == 0)
+    {
+        fluid_munlock(mem, 2 * FLUID_HUGE_PAGE_SIZE);
+    }
+
+    FLUID_FREE(mem);
+
+    /* smaller blocks are allocated as usual */
+    mem = fluid_alloc_huge(100, TRUE);
+    TEST_ASSERT(mem != NULL);
+    FLUID_MEMSET(mem, 1, 100);
+    FLUID_FREE(mem);
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    render(settings, 0, ref);
+    render(settings, 1, out);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(ref[i] == out[i]);
+    }
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
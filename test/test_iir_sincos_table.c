@@ -0,0 +1,57 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "rvoice/fluid_iir_filter.h"
+
+// this test makes sure that synths of the same sample rate share the table of the IIR filters,
+// while other rates get their own one
+
+static fluid_synth_t *create(fluid_settings_t *settings, double sample_rate)
+{
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", sample_rate));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    return synth;
+}
+
+int main(void)
+{
+    fluid_iir_sincos_t expected[SINCOS_TAB_SIZE];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *a, *b, *c;
+    fluid_iir_sincos_t *table;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+
+    a = create(settings, 44100.0);
+    b = create(settings, 44100.0);
+    c = create(settings, 48000.0);
+
+    TEST_ASSERT(a->iir_sincos_table == b->iir_sincos_table);
+    TEST_ASSERT(a->iir_sincos_table != c->iir_sincos_table);
+
+    fluid_iir_filter_init_table(expected, 48000.0f);
+
+    for(i = 0; i < SINCOS_TAB_SIZE; i++)
+    {
+        TEST_ASSERT(c->iir_sincos_table[i].sin == expected[i].sin);
+        TEST_ASSERT(c->iir_sincos_table[i].cos == expected[i].cos);
+    }
+
+    /* the table lives as long as one of its synths */
+    delete_fluid_synth(a);
+    table = fluid_iir_filter_acquire_table(44100.0f);
+    TEST_ASSERT(table == b->iir_sincos_table);
+    fluid_iir_filter_release_table(table);
+
+    delete_fluid_synth(b);
+    delete_fluid_synth(c);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "rvoice/fluid_rvoice_dsp_tables.h"
+
+// this test makes sure that the compile time table of the 16 point sinc interpolation passes
+// the sample points through unchanged and has unity gain at every phase, and that voices
+// interpolated with it sound like voices interpolated with the 7th order sinc
+
+#define SAMPLES 8192
+
+extern const fluid_real_t *const sinc_table16;
+
+static void render(int interp, float *left, float *right)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int key;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, -1, interp));
+    TEST_SUCCESS(fluid_synth_pitch_bend(synth, 0, 8192 + 1500));
+
+    for(key = 36; key < 96; key += 7)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, key, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES, left, 0, 1, right, 0, 1));
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static float ref_l[SAMPLES], ref_r[SAMPLES];
+    static float out_l[SAMPLES], out_r[SAMPLES];
+    double sum, diff = 0.0, energy = 0.0;
+    int i, k;
+
+    /* no fractional phase: only the point at the phase index contributes */
+    for(k = 0; k < SINC16_INTERP_ORDER; k++)
+    {
+        TEST_ASSERT(fabs(sinc_table16[k] - ((k == 7) ? 1.0f : 0.0f)) < 1e-6f);
+    }
+
+    for(i = 0; i < FLUID_INTERP_MAX; i++)
+    {
+        sum = 0.0;
+
+        for(k = 0; k < SINC16_INTERP_ORDER; k++)
+        {
+            sum += sinc_table16[i * SINC16_INTERP_ORDER + k];
+        }
+
+        TEST_ASSERT(fabs(sum - 1.0) < 0.01);
+    }
+
+    /* the taps of a phase are the taps of the mirrored phase in reverse order */
+    for(i = 1; i < FLUID_INTERP_MAX; i++)
+    {
+        for(k = 0; k < SINC16_INTERP_ORDER; k++)
+        {
+            TEST_ASSERT(fabs(sinc_table16[i * SINC16_INTERP_ORDER + k]
+                             - sinc_table16[(FLUID_INTERP_MAX - i) * SINC16_INTERP_ORDER + SINC16_INTERP_ORDER - 1 - k]) < 1e-6f);
+        }
+    }
+
+    render(FLUID_INTERP_7THORDER, ref_l, ref_r);
+    render(FLUID_INTERP_16THORDER, out_l, out_r);
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        diff += (out_l[i] - ref_l[i]) * (out_l[i] - ref_l[i]) + (out_r[i] - ref_r[i]) * (out_r[i] - ref_r[i]);
+        energy += ref_l[i] * ref_l[i] + ref_r[i] * ref_r[i];
+    }
+
+    /* both approximate the same band limited signal, they only differ in the highest frequencies */
+    TEST_ASSERT(energy > 0.0);
+    TEST_ASSERT(diff < 0.01 * energy);
+
+    return EXIT_SUCCESS;
+}
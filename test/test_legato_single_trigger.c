@@ -0,0 +1,85 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "rvoice/fluid_rvoice.h"
+
+// this test makes sure that legato mode single-trigger plays contiguous notes with the voices
+// of the previous note, without restarting their envelopes, and glides to the new pitch with
+// portamento
+
+#define BLOCK 64
+#define MAX_VOICES 16
+
+static int get_voices(fluid_synth_t *synth, fluid_voice_t **voices)
+{
+    int n;
+
+    fluid_synth_get_voicelist(synth, voices, MAX_VOICES, -1);
+
+    for(n = 0; n < MAX_VOICES && voices[n] != NULL; n++)
+    {
+    }
+
+    return n;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_voice_t *voices[MAX_VOICES], *legato[MAX_VOICES];
+    unsigned int ids[MAX_VOICES];
+    unsigned int ticks[MAX_VOICES];
+    float left[BLOCK], right[BLOCK];
+    int i, n;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_set_legato_mode(synth, 0, FLUID_CHANNEL_LEGATO_MODE_SINGLE_TRIGGER));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, LEGATO_SWITCH, 127));
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+
+    for(i = 0; i < 10; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, BLOCK, left, 0, 1, right, 0, 1));
+    }
+
+    n = get_voices(synth, voices);
+    TEST_ASSERT(n > 0);
+
+    for(i = 0; i < n; i++)
+    {
+        ids[i] = fluid_voice_get_id(voices[i]);
+        ticks[i] = voices[i]->rvoice->envlfo.ticks;
+    }
+
+    /* the contiguous note moves the voices to its key, their envelopes and velocity keep running */
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, PORTAMENTO_TIME_MSB, 10));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, PORTAMENTO_SWITCH, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 62, 50));
+    TEST_SUCCESS(fluid_synth_write_float(synth, BLOCK, left, 0, 1, right, 0, 1));
+
+    TEST_ASSERT(get_voices(synth, legato) == n);
+
+    for(i = 0; i < n; i++)
+    {
+        TEST_ASSERT(fluid_voice_get_id(legato[i]) == ids[i]);
+        TEST_ASSERT(fluid_voice_get_key(legato[i]) == 62);
+        TEST_ASSERT(fluid_voice_get_actual_velocity(legato[i]) == 100);
+        TEST_ASSERT(legato[i]->rvoice->envlfo.ticks > ticks[i]);
+        TEST_ASSERT(legato[i]->rvoice->envlfo.volenv.section > FLUID_VOICE_ENVDELAY);
+        TEST_ASSERT(legato[i]->rvoice->dsp.pitch == legato[i]->pitch);
+        /* portamento glides from the previous note */
+        TEST_ASSERT(legato[i]->rvoice->dsp.pitchoffset < 0.0f);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that a synth in low memory mode sounds like any other synth, while it
+// creates its voices only when they are needed and sizes the reverb for its sample rate
+
+#define FRAMES 64
+#define BLOCKS 100
+#define NOTES 40
+
+static fluid_synth_t *create(fluid_settings_t *settings, int low_memory)
+{
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.low-memory", low_memory));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    return synth;
+}
+
+static void play(fluid_synth_t *synth, float *out)
+{
+    int i;
+
+    for(i = 0; i < NOTES; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, i % 8, 40 + i, 100));
+    }
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, out, 0, 2, out, 1, 2));
+        out += 2 * FRAMES;
+    }
+}
+
+/* more notes than the polyphony, each started before the next one so that it can be stolen */
+static void overflow(fluid_synth_t *synth, float *out)
+{
+    int i;
+
+    for(i = 0; i < NOTES; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, i % 8, 40 + i, 100));
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, out, 0, 2, out, 1, 2));
+    }
+}
+
+int main(void)
+{
+    static float ref[2 * FRAMES * BLOCKS], out[2 * FRAMES * BLOCKS];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_synth_memory_t ref_usage, before, after;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", 44100));
+
+    /* the shorter delay lines of the reverb modulate a bit differently */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+
+    /* the reference, with all voices created up front */
+    synth = create(settings, 0);
+    TEST_SUCCESS(fluid_synth_get_memory_usage(synth, &ref_usage));
+    TEST_ASSERT(ref_usage.voices > 0 && ref_usage.mixer > 0 && ref_usage.effects > 0 && ref_usage.events > 0);
+    TEST_ASSERT(ref_usage.voice_cache == 0);
+    TEST_ASSERT(ref_usage.total == ref_usage.voices + ref_usage.mixer + ref_usage.effects
+                + ref_usage.events + ref_usage.voice_cache + ref_usage.other);
+    play(synth, ref);
+    TEST_SUCCESS(fluid_synth_get_memory_usage(synth, &after));
+    TEST_ASSERT(after.voices == ref_usage.voices);
+    delete_fluid_synth(synth);
+
+    synth = create(settings, 1);
+    TEST_SUCCESS(fluid_synth_get_memory_usage(synth, &before));
+    TEST_ASSERT(before.voices < ref_usage.voices);
+    TEST_ASSERT(before.effects < ref_usage.effects);
+    TEST_ASSERT(before.total < ref_usage.total);
+
+    /* more voices are created once the first ones are used up */
+    play(synth, out);
+    TEST_SUCCESS(fluid_synth_get_memory_usage(synth, &after));
+    TEST_ASSERT(after.voices > before.voices && after.voices < ref_usage.voices);
+    TEST_ASSERT(after.mixer == before.mixer && after.effects == before.effects);
+
+    for(i = 0; i < 2 * FRAMES * BLOCKS; i++)
+    {
+        TEST_ASSERT(ref[i] == out[i]);
+    }
+
+    delete_fluid_synth(synth);
+
+    /* voices are still stolen at the polyphony limit, also after lowering it */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 24));
+    synth = create(settings, 1);
+    overflow(synth, out);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 24);
+
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, 8));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, out, 0, 2, out, 1, 2));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, out, 0, 2, out, 1, 2));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) <= 8);
+
+    /* raising it creates the voices once they are needed */
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, 64));
+    TEST_SUCCESS(fluid_synth_get_memory_usage(synth, &before));
+    overflow(synth, out);
+    TEST_SUCCESS(fluid_synth_get_memory_usage(synth, &after));
+    TEST_ASSERT(after.voices > before.voices);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) >= NOTES);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+
+#include <math.h>
+
+// this test makes sure that the meters measure the levels of the channels and audio groups
+
+#define FRAMES 256
+#define BLOCKS 40
+
+int main(void)
+{
+    static float left[FRAMES * BLOCKS], right[FRAMES * BLOCKS];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_meter_stats_t stats, group;
+    fluid_synth_t *synth;
+    float peak = 0.0f;
+    double sumsq = 0.0;
+    int i;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* disabled by default */
+    TEST_ASSERT(fluid_synth_get_meter(synth, FLUID_METER_GROUP, 0, &stats) == FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.metering", 1));
+    TEST_ASSERT(fluid_synth_get_meter(synth, FLUID_METER_CHANNEL, 16, &stats) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_meter(synth, FLUID_METER_GROUP, 1, &stats) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_meter(synth, FLUID_METER_FX, 2, &stats) == FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 2, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 2, 64, 100));
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, &left[i * FRAMES], 0, 1, &right[i * FRAMES], 0, 1));
+    }
+
+    for(i = 0; i < FRAMES * BLOCKS; i++)
+    {
+        peak = fabsf(left[i]) > peak ? fabsf(left[i]) : peak;
+        sumsq += left[i] * left[i];
+    }
+
+    TEST_ASSERT(peak > 0.0f);
+
+    /* the audio group is the output itself */
+    TEST_SUCCESS(fluid_synth_get_meter(synth, FLUID_METER_GROUP, 0, &group));
+    TEST_ASSERT(fabsf(group.peak_left - peak) < 1e-6f);
+    TEST_ASSERT(fabs(group.rms_left - sqrt(sumsq / (FRAMES * BLOCKS))) < 1e-6);
+
+    /* the voices of the channel are metered one by one */
+    TEST_SUCCESS(fluid_synth_get_meter(synth, FLUID_METER_CHANNEL, 2, &stats));
+    TEST_ASSERT(stats.peak_left > 0.0f && stats.peak_left <= group.peak_left * 1.001f);
+    TEST_ASSERT(stats.rms_left > 0.0f && stats.rms_left <= stats.peak_left);
+    TEST_ASSERT(stats.peak_right > 0.0f && stats.rms_right > 0.0f);
+
+    TEST_SUCCESS(fluid_synth_get_meter(synth, FLUID_METER_CHANNEL, 0, &stats));
+    TEST_ASSERT(stats.peak_left == 0.0f && stats.rms_left == 0.0f);
+
+    /* reading starts over */
+    TEST_SUCCESS(fluid_synth_get_meter(synth, FLUID_METER_GROUP, 0, &group));
+    TEST_ASSERT(group.peak_left == 0.0f && group.rms_left == 0.0f);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.metering", 0));
+    TEST_ASSERT(fluid_synth_get_meter(synth, FLUID_METER_GROUP, 0, &stats) == FLUID_FAILED);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
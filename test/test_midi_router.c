@@ -0,0 +1,143 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the MIDI router applies its rules to the events of every
+// channel, including channels beyond synth.midi-channels, and that rules removed while
+// notes are held still let their note off events through
+
+#define MAX_EVENTS 256
+
+typedef struct
+{
+    int type;
+    int chan;
+    int par1;
+    int par2;
+} test_event_t;
+
+static test_event_t events[MAX_EVENTS];
+static int count = 0;
+
+static int handler(void *data, fluid_midi_event_t *event)
+{
+    TEST_ASSERT(count < MAX_EVENTS);
+    events[count].type = fluid_midi_event_get_type(event);
+    events[count].chan = fluid_midi_event_get_channel(event);
+    events[count].par1 = fluid_midi_event_get_key(event);
+    events[count].par2 = fluid_midi_event_get_velocity(event);
+    count++;
+    return FLUID_OK;
+}
+
+static int send_event(fluid_midi_router_t *router, int type, int chan, int par1, int par2)
+{
+    fluid_midi_event_t *event = new_fluid_midi_event();
+    int ret;
+
+    TEST_ASSERT(event != NULL);
+    fluid_midi_event_set_type(event, type);
+    fluid_midi_event_set_channel(event, chan);
+    fluid_midi_event_set_key(event, par1);
+    fluid_midi_event_set_velocity(event, par2);
+
+    count = 0;
+    ret = fluid_midi_router_handle_midi_event(router, event);
+    delete_fluid_midi_event(event);
+
+    return ret;
+}
+
+static void add_rule(fluid_midi_router_t *router, int type, int chan_min, int chan_max, float chan_mul, int chan_add,
+                     int par1_min, int par1_max)
+{
+    fluid_midi_router_rule_t *rule = new_fluid_midi_router_rule();
+
+    TEST_ASSERT(rule != NULL);
+    fluid_midi_router_rule_set_chan(rule, chan_min, chan_max, chan_mul, chan_add);
+    fluid_midi_router_rule_set_param1(rule, par1_min, par1_max, 1.0, 0);
+    TEST_SUCCESS(fluid_midi_router_add_rule(router, rule, type));
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_midi_router_t *router;
+    int chan, key, i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.midi-channels", 16));
+
+    router = new_fluid_midi_router(settings, handler, NULL);
+    TEST_ASSERT(router != NULL);
+
+    // the default rules pass all events unmodified
+    TEST_SUCCESS(send_event(router, NOTE_ON, 3, 60, 100));
+    TEST_ASSERT(count == 1 && events[0].type == NOTE_ON && events[0].chan == 3);
+    TEST_ASSERT(events[0].par1 == 60 && events[0].par2 == 100);
+    TEST_SUCCESS(send_event(router, CONTROL_CHANGE, 15, 7, 90));
+    TEST_ASSERT(count == 1 && events[0].type == CONTROL_CHANGE && events[0].chan == 15);
+
+    // without rules, only the note off of the note held before is let through
+    TEST_SUCCESS(fluid_midi_router_clear_rules(router));
+    TEST_SUCCESS(send_event(router, NOTE_ON, 3, 62, 100));
+    TEST_ASSERT(count == 0);
+    TEST_SUCCESS(send_event(router, NOTE_OFF, 3, 62, 0));
+    TEST_ASSERT(count == 0);
+    TEST_SUCCESS(send_event(router, NOTE_OFF, 3, 60, 0));
+    TEST_ASSERT(count == 1 && events[0].type == NOTE_OFF && events[0].chan == 3 && events[0].par1 == 60);
+    TEST_SUCCESS(send_event(router, NOTE_OFF, 3, 60, 0));
+    TEST_ASSERT(count == 0);
+    TEST_SUCCESS(send_event(router, CONTROL_CHANGE, 15, 7, 90));
+    TEST_ASSERT(count == 0);
+
+    // one rule per channel and key, moving the notes to the next channel
+    for(i = 0; i < 128; i++)
+    {
+        add_rule(router, FLUID_MIDI_ROUTER_RULE_NOTE, i % 16, i % 16, 0.0, (i + 1) % 16, i, i);
+    }
+
+    for(chan = 0; chan < 16; chan++)
+    {
+        for(key = 0; key < 128; key++)
+        {
+            TEST_SUCCESS(send_event(router, NOTE_ON, chan, key, 100));
+            TEST_ASSERT(count == (key % 16 == chan));
+            TEST_ASSERT(count == 0 || (events[0].chan == (chan + 1) % 16 && events[0].par1 == key));
+        }
+    }
+
+    // an inverted channel window matches everything but the channels between max and min
+    add_rule(router, FLUID_MIDI_ROUTER_RULE_PROG_CHANGE, 10, 5, 1.0, 0, 0, 127);
+
+    for(chan = 0; chan < 16; chan++)
+    {
+        TEST_SUCCESS(send_event(router, PROGRAM_CHANGE, chan, 5, 0));
+        TEST_ASSERT(count == (chan <= 5 || chan >= 10));
+    }
+
+    // channels beyond synth.midi-channels are mapped by the rules, or ignored if out of range
+    add_rule(router, FLUID_MIDI_ROUTER_RULE_CC, 0, 999999, 0.0, 4, 0, 127);
+    add_rule(router, FLUID_MIDI_ROUTER_RULE_CC, 100, 200, 1.0, 0, 0, 127);
+    TEST_ASSERT(send_event(router, CONTROL_CHANGE, 150, 7, 90) == FLUID_FAILED);
+    TEST_ASSERT(count == 1 && events[0].chan == 4);
+    TEST_SUCCESS(send_event(router, CONTROL_CHANGE, 12, 7, 90));
+    TEST_ASSERT(count == 1 && events[0].chan == 4);
+
+    // the replaced rules only let through the note offs of the notes they are still holding
+    TEST_SUCCESS(fluid_midi_router_set_default_rules(router));
+    TEST_SUCCESS(send_event(router, NOTE_ON, 0, 16, 100));
+    TEST_ASSERT(count == 1 && events[0].chan == 0);
+    TEST_SUCCESS(send_event(router, NOTE_OFF, 0, 16, 0));
+    TEST_ASSERT(count == 2 && events[0].chan + events[1].chan == 1);
+    TEST_SUCCESS(send_event(router, NOTE_OFF, 0, 16, 0));
+    TEST_ASSERT(count == 1 && events[0].chan == 0);
+    TEST_SUCCESS(send_event(router, PROGRAM_CHANGE, 7, 5, 0));
+    TEST_ASSERT(count == 1 && events[0].chan == 7);
+
+    delete_fluid_midi_router(router);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that released voices end earlier with a higher synth.noise-floor and that
+// a held voice turned down below the noise floor is silent but comes back when turned up again,
+// without a transient
+
+#define FRAMES 64
+#define MAX_ABS_DELTA 1e-5f
+
+static float left[FRAMES], right[FRAMES], ref_left[FRAMES];
+
+static int render(fluid_synth_t *synth)
+{
+    int i, audible = FALSE;
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        audible |= (left[i] != 0.0f || right[i] != 0.0f);
+    }
+
+    return audible;
+}
+
+static fluid_synth_t *create(fluid_settings_t *settings, double noise_floor)
+{
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.noise-floor", noise_floor));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    return synth;
+}
+
+// number of render calls until a released note has ended
+static int release_length(fluid_synth_t *synth)
+{
+    int calls = 0;
+
+    /* about eight times the release of the preset */
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_VOLENVRELEASE, 3600.0f));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    render(synth);
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+
+    while(fluid_synth_get_active_voice_count(synth) > 0)
+    {
+        render(synth);
+        calls++;
+        TEST_ASSERT(calls < 100000);
+    }
+
+    return calls;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth, *loud;
+    int i, j, voices;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    loud = create(settings, -134.0);
+    synth = create(settings, -60.0);
+
+    TEST_ASSERT(release_length(synth) < release_length(loud));
+
+    /* CC 7 can still raise the volume, the voice is skipped but must keep playing */
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_ASSERT(render(synth));
+    voices = fluid_synth_get_active_voice_count(synth);
+    TEST_ASSERT(voices > 0);
+
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 7, 0));
+    render(synth);
+
+    for(i = 0; i < 100; i++)
+    {
+        TEST_ASSERT(!render(synth));
+    }
+
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == voices);
+
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 7, 127));
+    TEST_ASSERT(render(synth));
+
+    /* the same voice is audible with the default noise floor */
+    TEST_SUCCESS(fluid_synth_noteon(loud, 0, 60, 100));
+    render(loud);
+    TEST_SUCCESS(fluid_synth_cc(loud, 0, 7, 0));
+    render(loud);
+    TEST_ASSERT(render(loud));
+
+    delete_fluid_synth(synth);
+    delete_fluid_synth(loud);
+
+    /* a voice coming back plays on like one that has never been skipped, even through a
+     * resonant filter, whose history would otherwise ring out as a transient */
+    loud = create(settings, -134.0);
+    synth = create(settings, -60.0);
+
+    for(i = 0; i < 2; i++)
+    {
+        fluid_synth_t *s = (i == 0) ? synth : loud;
+
+        TEST_SUCCESS(fluid_synth_set_gen(s, 0, GEN_FILTERFC, 6000.0f));
+        TEST_SUCCESS(fluid_synth_set_gen(s, 0, GEN_FILTERQ, 200.0f));
+        TEST_SUCCESS(fluid_synth_noteon(s, 0, 60, 100));
+    }
+
+    for(i = 0; i < 120; i++)
+    {
+        if(i == 10 || i == 110)
+        {
+            TEST_SUCCESS(fluid_synth_cc(synth, 0, 7, (i == 10) ? 0 : 127));
+            TEST_SUCCESS(fluid_synth_cc(loud, 0, 7, (i == 10) ? 0 : 127));
+        }
+
+        render(loud);
+        FLUID_MEMCPY(ref_left, left, sizeof(left));
+        TEST_ASSERT(render(synth) == (i < 11 || i >= 110));
+
+        for(j = 0; j < FRAMES; j++)
+        {
+            TEST_ASSERT(FLUID_FABS(left[j] - ref_left[j]) < MAX_ABS_DELTA);
+        }
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_synth(loud);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
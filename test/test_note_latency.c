@@ -0,0 +1,128 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_synth.h"
+
+// this test makes sure that the latency of the notes received by a MIDI driver is measured
+// from the time stamped at ingress, once per note and including the output latency, while
+// notes played through the API and events without a stamp aren't measured
+
+#define FRAMES 64
+#define OUTPUT_LATENCY 5000.0
+
+static void render(fluid_synth_t *synth)
+{
+    static float left[FRAMES], right[FRAMES];
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+}
+
+static void play(fluid_synth_t *synth, int key, int stamp)
+{
+    fluid_midi_event_t *event = new_fluid_midi_event();
+
+    TEST_ASSERT(event != NULL);
+    TEST_SUCCESS(fluid_midi_event_set_type(event, NOTE_ON));
+    TEST_SUCCESS(fluid_midi_event_set_key(event, key));
+    TEST_SUCCESS(fluid_midi_event_set_velocity(event, 100));
+
+    if(stamp)
+    {
+        fluid_midi_event_stamp(event);
+    }
+
+    TEST_SUCCESS(fluid_synth_handle_midi_event(synth, event));
+    delete_fluid_midi_event(event);
+}
+
+static unsigned int count_notes(fluid_synth_t *synth)
+{
+    unsigned int counts[128];
+    double limits[128];
+    unsigned int sum = 0;
+    int i, bins;
+
+    bins = fluid_synth_get_note_latency_histogram(synth, counts, limits, 128);
+    TEST_ASSERT(bins > 0 && bins <= 128);
+
+    for(i = 0; i < bins; i++)
+    {
+        TEST_ASSERT(i == 0 || limits[i] > limits[i - 1]);
+        sum += counts[i];
+    }
+
+    return sum;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_perf_stats_t stats;
+
+    TEST_ASSERT(settings != NULL);
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* not measured while synth.perf-stats is off */
+    play(synth, 60, TRUE);
+    render(synth);
+    TEST_SUCCESS(fluid_synth_get_note_latency_stats(synth, &stats));
+    TEST_ASSERT(stats.count == 0);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.perf-stats", 1));
+
+    /* a note with several voices is measured once, when its block has been rendered */
+    play(synth, 61, TRUE);
+    TEST_SUCCESS(fluid_synth_get_note_latency_stats(synth, &stats));
+    TEST_ASSERT(stats.count == 0);
+
+    render(synth);
+    TEST_SUCCESS(fluid_synth_get_note_latency_stats(synth, &stats));
+    TEST_ASSERT(stats.count == 1);
+    TEST_ASSERT(stats.min > 0 && stats.min < OUTPUT_LATENCY);
+    TEST_ASSERT(count_notes(synth) == 1);
+
+    /* notes of the API and events without a stamp aren't measured */
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 62, 100));
+    play(synth, 63, FALSE);
+    render(synth);
+    TEST_SUCCESS(fluid_synth_get_note_latency_stats(synth, &stats));
+    TEST_ASSERT(stats.count == 1);
+
+    /* the output latency of the audio driver is part of the note latency */
+    fluid_synth_set_output_latency(synth, OUTPUT_LATENCY);
+    play(synth, 64, TRUE);
+    render(synth);
+    TEST_SUCCESS(fluid_synth_get_note_latency_stats(synth, &stats));
+    TEST_ASSERT(stats.count == 2);
+    TEST_ASSERT(stats.max >= OUTPUT_LATENCY);
+    TEST_ASSERT(stats.min < OUTPUT_LATENCY);
+    TEST_ASSERT(count_notes(synth) == 2);
+
+    fluid_synth_reset_perf_stats(synth);
+    TEST_SUCCESS(fluid_synth_get_note_latency_stats(synth, &stats));
+    TEST_ASSERT(stats.count == 0);
+    TEST_ASSERT(count_notes(synth) == 0);
+
+    delete_fluid_synth(synth);
+
+    /* the stamp is queued along with note-ons queued by synth.api-queue */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.api-queue", 16));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    render(synth);
+
+    play(synth, 60, TRUE);
+    render(synth);
+    TEST_SUCCESS(fluid_synth_get_note_latency_stats(synth, &stats));
+    TEST_ASSERT(stats.count == 1);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that rendering a player or a sequencer offline sounds like rendering it
+// block by block, while the silence before and between the notes is skipped
+
+#define SAMPLE_RATE 44100
+#define MAX_FRAMES (30 * SAMPLE_RATE)
+#define BLOCK_SIZE 4000
+
+/* two short notes, each after 10 seconds of silence, at 480 ticks per quarter and 120 bpm */
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xe0,
+    'M', 'T', 'r', 'k', 0, 0, 0, 24,
+    0xcb, 0x00, 0x90, 60, 100,
+    0x81, 0x70, 0x80, 60, 0,
+    0xcb, 0x00, 0x90, 64, 100,
+    0x81, 0x70, 0x80, 64, 0,
+    0x00, 0xff, 0x2f, 0x00
+};
+
+typedef struct
+{
+    float *left, *right;
+    int frames;
+    int skipped;
+    double progress;
+} test_output_t;
+
+static float ref_left[MAX_FRAMES], ref_right[MAX_FRAMES];
+static float out_left[MAX_FRAMES], out_right[MAX_FRAMES];
+
+static int collect(void *data, int len, const float *left, const float *right, double progress)
+{
+    test_output_t *out = data;
+
+    TEST_ASSERT(len > 0 && out->frames + len <= MAX_FRAMES);
+    TEST_ASSERT(progress >= out->progress && progress <= 1.0);
+    TEST_ASSERT((left == NULL) == (right == NULL));
+
+    if(left == NULL)
+    {
+        FLUID_MEMSET(out->left + out->frames, 0, len * sizeof(float));
+        FLUID_MEMSET(out->right + out->frames, 0, len * sizeof(float));
+        out->skipped += len;
+    }
+    else
+    {
+        FLUID_MEMCPY(out->left + out->frames, left, len * sizeof(float));
+        FLUID_MEMCPY(out->right + out->frames, right, len * sizeof(float));
+    }
+
+    out->frames += len;
+    out->progress = progress;
+
+    return FLUID_OK;
+}
+
+static int abort_render(void *data, int len, const float *left, const float *right, double progress)
+{
+    return FLUID_FAILED;
+}
+
+static fluid_synth_t *create(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    return synth;
+}
+
+static fluid_player_t *create_player(fluid_synth_t *synth)
+{
+    fluid_player_t *player = new_fluid_player(synth);
+
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, sizeof(midi_file)));
+
+    return player;
+}
+
+static fluid_sequencer_t *create_sequencer(fluid_synth_t *synth)
+{
+    fluid_sequencer_t *seq = new_fluid_sequencer2(FALSE);
+    fluid_event_t *evt = new_fluid_event();
+    fluid_seq_id_t id;
+
+    TEST_ASSERT(seq != NULL && evt != NULL);
+    id = fluid_sequencer_register_fluidsynth(seq, synth);
+    TEST_ASSERT(id != FLUID_FAILED);
+
+    fluid_event_set_source(evt, -1);
+    fluid_event_set_dest(evt, id);
+    fluid_event_noteon(evt, 0, 60, 100);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, 3000, FALSE));
+    fluid_event_noteoff(evt, 0, 60);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, 3250, FALSE));
+    delete_fluid_event(evt);
+
+    return seq;
+}
+
+static void compare(const test_output_t *out, int ref_frames)
+{
+    int i, audible = FALSE;
+
+    for(i = 0; i < out->frames; i++)
+    {
+        TEST_ASSERT(out_left[i] == ((i < ref_frames) ? ref_left[i] : 0.0f));
+        TEST_ASSERT(out_right[i] == ((i < ref_frames) ? ref_right[i] : 0.0f));
+        audible |= (out_left[i] != 0.0f);
+    }
+
+    for(; i < ref_frames; i++)
+    {
+        TEST_ASSERT(ref_left[i] == 0.0f && ref_right[i] == 0.0f);
+    }
+
+    TEST_ASSERT(audible);
+    TEST_ASSERT(out->progress == 1.0);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    fluid_sequencer_t *seq;
+    test_output_t out = { out_left, out_right, 0, 0, 0.0 };
+    int frames, len;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", SAMPLE_RATE));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "player.timing-source", "sample"));
+
+    /* the reference, the player rendered block by block */
+    synth = create(settings);
+    player = create_player(synth);
+    TEST_SUCCESS(fluid_player_play(player));
+
+    for(frames = 0; fluid_player_get_status(player) == FLUID_PLAYER_PLAYING; frames += 64)
+    {
+        TEST_ASSERT(frames + 64 <= MAX_FRAMES);
+        TEST_SUCCESS(fluid_synth_write_float(synth, 64, ref_left, frames, 1, ref_right, frames, 1));
+    }
+
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+
+    synth = create(settings);
+    player = create_player(synth);
+    TEST_SUCCESS(fluid_player_render(player, BLOCK_SIZE, collect, &out));
+    TEST_ASSERT(fluid_player_get_status(player) == FLUID_PLAYER_DONE);
+    compare(&out, frames);
+
+    /* the synth renders large blocks at once, the player may notice a bit later that no voice
+     * plays anymore and wait a bit longer before it stops */
+    TEST_ASSERT(out.frames > frames - BLOCK_SIZE && out.frames < frames + 2 * BLOCK_SIZE);
+
+    /* the intro, the gap between the notes and the grace period at the end */
+    TEST_ASSERT(out.skipped > 15 * SAMPLE_RATE);
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+
+    /* the reference of the sequencer */
+    synth = create(settings);
+    seq = create_sequencer(synth);
+
+    for(frames = 0; frames < 5 * SAMPLE_RATE; frames += len)
+    {
+        len = (5 * SAMPLE_RATE - frames < 64) ? 5 * SAMPLE_RATE - frames : 64;
+        TEST_SUCCESS(fluid_synth_write_float(synth, len, ref_left, frames, 1, ref_right, frames, 1));
+    }
+
+    delete_fluid_sequencer(seq);
+    delete_fluid_synth(synth);
+
+    synth = create(settings);
+    seq = create_sequencer(synth);
+    FLUID_MEMSET(&out, 0, sizeof(out));
+    out.left = out_left;
+    out.right = out_right;
+    TEST_SUCCESS(fluid_sequencer_render(seq, synth, 5000, BLOCK_SIZE, collect, &out));
+    TEST_ASSERT(out.frames == frames);
+    compare(&out, frames);
+    TEST_ASSERT(out.skipped > 2 * SAMPLE_RATE);
+
+    /* the callback may abort */
+    TEST_ASSERT(fluid_sequencer_render(seq, synth, 5000, BLOCK_SIZE, abort_render, NULL) == FLUID_FAILED);
+
+    delete_fluid_sequencer(seq);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that rendering a MIDI file in chunks with several threads sounds like
+// rendering it as a whole, also where the notes of a chunk ring on into the next ones
+
+#define SAMPLE_RATE 44100
+#define MAX_FRAMES (30 * SAMPLE_RATE)
+#define BLOCK_SIZE 1024
+#define THREADS 4
+
+/* four notes of half a second, one every 1.5 seconds, with controllers and pitch bends changing
+ * while they are released, at 480 ticks per quarter and 120 bpm */
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xe0,
+    'M', 'T', 'r', 'k', 0, 0, 0, 60,
+    0x00, 0xc0, 0x00,
+    0x00, 0x90, 60, 100,
+    0x83, 0x60, 0x80, 60, 0,
+    0x00, 0xb0, 7, 80,
+    0x87, 0x40, 0x90, 62, 100,
+    0x83, 0x60, 0x80, 62, 0,
+    0x81, 0x70, 0xe0, 0x00, 0x50,
+    0x83, 0x60, 0xb0, 10, 20,
+    0x81, 0x70, 0x90, 64, 100,
+    0x83, 0x60, 0x80, 64, 0,
+    0x87, 0x40, 0x90, 65, 100,
+    0x83, 0x60, 0x80, 65, 0,
+    0x00, 0xff, 0x2f, 0x00
+};
+
+typedef struct
+{
+    float *left, *right;
+    int frames;
+    double progress;
+} test_output_t;
+
+static float ref_left[MAX_FRAMES], ref_right[MAX_FRAMES];
+static float out_left[MAX_FRAMES], out_right[MAX_FRAMES];
+
+static int collect(void *data, int len, const float *left, const float *right, double progress)
+{
+    test_output_t *out = data;
+
+    TEST_ASSERT(len > 0 && out->frames + len <= MAX_FRAMES);
+    TEST_ASSERT(left == NULL || len <= BLOCK_SIZE);
+    TEST_ASSERT(progress >= out->progress && progress <= 1.0);
+    TEST_ASSERT((left == NULL) == (right == NULL));
+
+    if(left == NULL)
+    {
+        FLUID_MEMSET(out->left + out->frames, 0, len * sizeof(float));
+        FLUID_MEMSET(out->right + out->frames, 0, len * sizeof(float));
+    }
+    else
+    {
+        FLUID_MEMCPY(out->left + out->frames, left, len * sizeof(float));
+        FLUID_MEMCPY(out->right + out->frames, right, len * sizeof(float));
+    }
+
+    out->frames += len;
+    out->progress = progress;
+
+    return FLUID_OK;
+}
+
+static int abort_render(void *data, int len, const float *left, const float *right, double progress)
+{
+    return FLUID_FAILED;
+}
+
+static fluid_player_t *create_player(fluid_settings_t *settings, fluid_synth_t **synth)
+{
+    fluid_player_t *player;
+
+    *synth = new_fluid_synth(settings);
+    TEST_ASSERT(*synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(*synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    player = new_fluid_player(*synth);
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, sizeof(midi_file)));
+
+    return player;
+}
+
+static void compare(const test_output_t *out, int ref_frames)
+{
+    int i;
+
+    /* the overlapping chunks are added up, which may round differently, and the tails
+     * are cut once they are silent */
+    for(i = 0; i < out->frames; i++)
+    {
+        TEST_ASSERT(FLUID_FABS(out_left[i] - ((i < ref_frames) ? ref_left[i] : 0.0f)) < 1e-6f);
+        TEST_ASSERT(FLUID_FABS(out_right[i] - ((i < ref_frames) ? ref_right[i] : 0.0f)) < 1e-6f);
+    }
+
+    for(; i < ref_frames; i++)
+    {
+        TEST_ASSERT(FLUID_FABS(ref_left[i]) < 1e-6f && FLUID_FABS(ref_right[i]) < 1e-6f);
+    }
+
+    TEST_ASSERT(out->frames > ref_frames - SAMPLE_RATE / 2 && out->frames < ref_frames + SAMPLE_RATE / 2);
+    TEST_ASSERT(out->progress == 1.0);
+}
+
+/* Renders the reference, the player rendered block by block, and returns its length */
+static int render_reference(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    int frames;
+
+    player = create_player(settings, &synth);
+    TEST_SUCCESS(fluid_player_play(player));
+
+    for(frames = 0; fluid_player_get_status(player) == FLUID_PLAYER_PLAYING; frames += 64)
+    {
+        TEST_ASSERT(frames + 64 <= MAX_FRAMES);
+        TEST_SUCCESS(fluid_synth_write_float(synth, 64, ref_left, frames, 1, ref_right, frames, 1));
+    }
+
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+
+    return frames;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    test_output_t out;
+    int i, frames, tail_split = FALSE;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", SAMPLE_RATE));
+
+    /* the modulation of the effects starts over with every chunk */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "player.timing-source", "sample"));
+
+    frames = render_reference(settings);
+
+    /* a note still rings when the next one starts, across the split between the chunks */
+    for(i = 1; i <= 3; i++)
+    {
+        tail_split |= (ref_left[i * 3 * SAMPLE_RATE / 2 - 1] != 0.0f);
+    }
+
+    TEST_ASSERT(tail_split);
+
+    FLUID_MEMSET(&out, 0, sizeof(out));
+    out.left = out_left;
+    out.right = out_right;
+    player = create_player(settings, &synth);
+    TEST_SUCCESS(fluid_player_render_parallel(player, THREADS, BLOCK_SIZE, collect, &out));
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    compare(&out, frames);
+
+    /* a single thread renders like fluid_player_render() */
+    FLUID_MEMSET(&out, 0, sizeof(out));
+    out.left = out_left;
+    out.right = out_right;
+    player = create_player(settings, &synth);
+    TEST_SUCCESS(fluid_player_render_parallel(player, 1, BLOCK_SIZE, collect, &out));
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    compare(&out, frames);
+
+    /* the callback may abort */
+    player = create_player(settings, &synth);
+    TEST_ASSERT(fluid_player_render_parallel(player, THREADS, BLOCK_SIZE, abort_render, NULL) == FLUID_FAILED);
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+
+    /* the limited chunks can't be added up, the file is rendered as a whole */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.limiter.active", 1));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.limiter.output-limit", 0.1));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.gain", 1.0));
+    frames = render_reference(settings);
+
+    FLUID_MEMSET(&out, 0, sizeof(out));
+    out.left = out_left;
+    out.right = out_right;
+    player = create_player(settings, &synth);
+    TEST_SUCCESS(fluid_player_render_parallel(player, THREADS, BLOCK_SIZE, collect, &out));
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    compare(&out, frames);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
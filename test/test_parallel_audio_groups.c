@@ -0,0 +1,94 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that rendering each audio group end-to-end on a thread of its own,
+// including its reverb, chorus and limiter, produces the same stems as rendering all
+// groups on a single thread
+
+#define FRAMES 8192
+#define GROUPS 4
+#define MAX_ABS_DELTA 1e-6f
+
+static void render(int cores, int parallel, float out[2 * GROUPS][FRAMES])
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    float *bufs[2 * GROUPS];
+    int i, chan;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.audio-groups", GROUPS));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.audio-channels", GROUPS));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.effects-groups", GROUPS));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", cores));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.parallel-audio-groups", parallel));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.limiter.active", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.limiter.look-ahead", 0));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.limiter.output-limit", 0.25));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.gain", 1.0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* channel n plays into audio group n % GROUPS, with reverb and chorus */
+    for(chan = 0; chan < 2 * GROUPS; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 5));
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 91, 100));
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 93, 100));
+
+        for(i = 0; i < 4; i++)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, 40 + chan * 3 + i * 7, 127));
+        }
+    }
+
+    for(i = 0; i < 2 * GROUPS; i++)
+    {
+        bufs[i] = out[i];
+        FLUID_MEMSET(out[i], 0, FRAMES * sizeof(float));
+    }
+
+    TEST_SUCCESS(fluid_synth_process(synth, FRAMES, 0, NULL, 2 * GROUPS, bufs));
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    static float ref[2 * GROUPS][FRAMES], out[2 * GROUPS][FRAMES];
+    int i, k, cores;
+
+    render(1, 0, ref);
+
+    for(i = 0; i < 2 * GROUPS; i++)
+    {
+        float energy = 0;
+
+        for(k = 0; k < FRAMES; k++)
+        {
+            energy += FLUID_FABS(ref[i][k]);
+        }
+
+        /* every group has its own stem */
+        TEST_ASSERT(energy > 0);
+    }
+
+    /* fewer threads than groups take several groups each */
+    for(cores = 2; cores <= GROUPS; cores += 2)
+    {
+        render(cores, 1, out);
+
+        for(i = 0; i < 2 * GROUPS; i++)
+        {
+            for(k = 0; k < FRAMES; k++)
+            {
+                TEST_ASSERT(FLUID_FABS(ref[i][k] - out[i][k]) <= MAX_ABS_DELTA);
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
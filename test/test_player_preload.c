@@ -0,0 +1,127 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the player switches to the next file of its playlist without
+// loading it itself, as it has been loaded in the background, and that with player.gapless
+// the next file starts exactly where the previous one ended
+
+#define SAMPLE_RATE 44100
+#define NUM_FILES 3
+#define NOTES_PER_FILE 4
+#define BLOCK 64
+
+/* four notes a quarter note apart at 120 bpm, the last of which is followed by the end of
+   the track a quarter note later: each file lasts 2 seconds */
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96,
+    'M', 'T', 'r', 'k', 0, 0, 0, 23,
+    0, 0x90, 60, 100,
+    96, 0x90, 62, 100,
+    96, 0x90, 64, 100,
+    96, 0x90, 65, 100,
+    96, 0xff, 0x2f, 0
+};
+
+typedef struct
+{
+    fluid_synth_t *synth;
+    fluid_player_t *player;
+    unsigned int start;
+    int count;
+    double time[NUM_FILES * NOTES_PER_FILE];
+    int preloaded;
+} test_record_t;
+
+static int record(void *data, fluid_midi_event_t *event)
+{
+    test_record_t *rec = data;
+
+    if(fluid_midi_event_get_type(event) == NOTE_ON)
+    {
+        TEST_ASSERT(rec->count < NUM_FILES * NOTES_PER_FILE);
+        rec->time[rec->count++] = fluid_synth_get_ticks(rec->synth) - rec->start + rec->synth->event_offset;
+
+        /* the switch left the previous file in the preloading player */
+        if(rec->count > NOTES_PER_FILE && rec->count % NOTES_PER_FILE == 1)
+        {
+            rec->preloaded += (rec->player->preload->nevents == NOTES_PER_FILE + 1);
+        }
+    }
+
+    return FLUID_OK;
+}
+
+static void play(fluid_settings_t *settings, int gapless)
+{
+    static float left[BLOCK], right[BLOCK];
+    test_record_t rec;
+    double file_len = 2.0 * SAMPLE_RATE;
+    int i;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "player.gapless", gapless));
+    rec.synth = new_fluid_synth(settings);
+    TEST_ASSERT(rec.synth != NULL);
+    rec.count = 0;
+    rec.preloaded = 0;
+
+    rec.player = new_fluid_player(rec.synth);
+    TEST_ASSERT(rec.player != NULL);
+    TEST_ASSERT(rec.player->preload_thread != NULL);
+    fluid_player_set_playback_callback(rec.player, record, &rec);
+
+    for(i = 0; i < NUM_FILES; i++)
+    {
+        TEST_SUCCESS(fluid_player_add_mem(rec.player, midi_file, sizeof(midi_file)));
+    }
+
+    TEST_SUCCESS(fluid_player_play(rec.player));
+    rec.start = fluid_synth_get_ticks(rec.synth);
+
+    while(fluid_player_get_status(rec.player) == FLUID_PLAYER_PLAYING)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(rec.synth, BLOCK, left, 0, 1, right, 0, 1));
+    }
+
+    TEST_ASSERT(rec.count == NUM_FILES * NOTES_PER_FILE);
+    TEST_ASSERT(rec.preloaded == NUM_FILES - 1);
+
+    for(i = 0; i < NUM_FILES * NOTES_PER_FILE; i++)
+    {
+        double due = (i / NOTES_PER_FILE) * file_len + (i % NOTES_PER_FILE) * file_len / 4;
+
+        if(gapless)
+        {
+            /* sent at its offset in the block it is due in */
+            TEST_ASSERT(fabs(rec.time[i] - due) <= 1.0);
+        }
+        else
+        {
+            /* a file starts at the block the previous one ended in */
+            TEST_ASSERT(fabs(rec.time[i] - due) < (i / NOTES_PER_FILE + 1) * BLOCK);
+        }
+    }
+
+    delete_fluid_player(rec.player);
+    delete_fluid_synth(rec.synth);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", SAMPLE_RATE));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-accurate-events", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "player.reset-synth", 0));
+
+    play(settings, FALSE);
+    play(settings, TRUE);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
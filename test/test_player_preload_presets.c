@@ -0,0 +1,147 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that with player.preload-presets the presets selected by the program
+// changes of a file are pinned before it is played, and that they are unpinned when the file
+// is done with, unless the other file kept by the player uses them as well
+
+#define BLOCK 64
+
+/* a program change on the given channel a second after the start, at 120 bpm, and the end of the
+   track a quarter of a second later */
+#define MIDI_FILE(chan, prog) \
+    { \
+        'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96, \
+        'M', 'T', 'r', 'k', 0, 0, 0, 8, \
+        0x81, 0x40, 0xc0 | (chan), (prog), \
+        48, 0xff, 0x2f, 0 \
+    }
+
+static const unsigned char file_42[] = MIDI_FILE(0, 42);
+static const unsigned char file_40[] = MIDI_FILE(1, 40);
+static const unsigned char file_40_again[] = MIDI_FILE(2, 40);
+static const unsigned char file_41[] = MIDI_FILE(3, 41);
+
+typedef struct
+{
+    fluid_synth_t *synth;
+    int sfont_id;
+    int count;
+    int pinned[4][3];   /* whether presets 40, 41 and 42 were pinned at the program changes */
+} test_record_t;
+
+static int is_pinned(fluid_synth_t *synth, int sfont_id, int prog)
+{
+    fluid_sfont_t *sfont = fluid_synth_get_sfont_by_id(synth, sfont_id);
+    fluid_preset_t *preset;
+
+    TEST_ASSERT(sfont != NULL);
+    preset = fluid_sfont_get_preset(sfont, 0, prog);
+    TEST_ASSERT(preset != NULL);
+
+    return ((fluid_defpreset_t *)fluid_preset_get_data(preset))->pinned;
+}
+
+static int record(void *data, fluid_midi_event_t *event)
+{
+    test_record_t *rec = data;
+
+    if(fluid_midi_event_get_type(event) == PROGRAM_CHANGE)
+    {
+        TEST_ASSERT(rec->count < 4);
+        TEST_ASSERT(fluid_midi_event_get_channel(event) == rec->count);
+        rec->pinned[rec->count][0] = is_pinned(rec->synth, rec->sfont_id, 40);
+        rec->pinned[rec->count][1] = is_pinned(rec->synth, rec->sfont_id, 41);
+        rec->pinned[rec->count][2] = is_pinned(rec->synth, rec->sfont_id, 42);
+        rec->count++;
+    }
+
+    return fluid_synth_handle_midi_event(rec->synth, event);
+}
+
+static void play(fluid_settings_t *settings, int preload_presets)
+{
+    static float left[BLOCK], right[BLOCK];
+    fluid_player_t *player;
+    test_record_t rec;
+    int i;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "player.preload-presets", preload_presets));
+    rec.synth = new_fluid_synth(settings);
+    TEST_ASSERT(rec.synth != NULL);
+    rec.sfont_id = fluid_synth_sfload(rec.synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(rec.sfont_id != FLUID_FAILED);
+    rec.count = 0;
+
+    player = new_fluid_player(rec.synth);
+    TEST_ASSERT(player != NULL);
+    fluid_player_set_playback_callback(player, record, &rec);
+
+    TEST_SUCCESS(fluid_player_add_mem(player, file_42, sizeof(file_42)));
+    TEST_SUCCESS(fluid_player_add_mem(player, file_40, sizeof(file_40)));
+    TEST_SUCCESS(fluid_player_add_mem(player, file_40_again, sizeof(file_40_again)));
+    TEST_SUCCESS(fluid_player_add_mem(player, file_41, sizeof(file_41)));
+
+    TEST_SUCCESS(fluid_player_play(player));
+    TEST_SUCCESS(fluid_synth_write_float(rec.synth, BLOCK, left, 0, 1, right, 0, 1));
+
+    /* the first file is loaded, its program change is still to come */
+    TEST_ASSERT(rec.count == 0);
+    TEST_ASSERT(is_pinned(rec.synth, rec.sfont_id, 42) == preload_presets);
+
+    while(fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(rec.synth, BLOCK, left, 0, 1, right, 0, 1));
+    }
+
+    TEST_ASSERT(rec.count == 4);
+
+    /* the next file is preloaded in the background while a file is played, which makes only
+       some of the presets pinned at a program change certain */
+    if(preload_presets)
+    {
+        TEST_ASSERT(rec.pinned[0][2]);
+        TEST_ASSERT(rec.pinned[1][0]);
+
+        /* the first file has been done with when the third one was preloaded */
+        TEST_ASSERT(rec.pinned[2][0] && !rec.pinned[2][2]);
+
+        /* the second file has been done with when the fourth one was preloaded, but not the
+           preset it shares with the third one */
+        TEST_ASSERT(rec.pinned[3][0] && rec.pinned[3][1] && !rec.pinned[3][2]);
+    }
+    else
+    {
+        for(i = 0; i < 4; i++)
+        {
+            TEST_ASSERT(!rec.pinned[i][0] && !rec.pinned[i][1] && !rec.pinned[i][2]);
+        }
+    }
+
+    delete_fluid_player(player);
+    TEST_ASSERT(!is_pinned(rec.synth, rec.sfont_id, 40));
+    TEST_ASSERT(!is_pinned(rec.synth, rec.sfont_id, 41));
+    TEST_ASSERT(!is_pinned(rec.synth, rec.sfont_id, 42));
+
+    delete_fluid_synth(rec.synth);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "player.reset-synth", 0));
+
+    play(settings, 1);
+    play(settings, 0);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,292 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that seeking with the player restores the same state of the channels
+// as replaying all events before the seek position, no matter which keyframe it starts from
+
+#define NUM_EVENTS 20000
+#define MAX_FILE_SIZE (NUM_EVENTS * 8 + 1024)
+
+typedef struct
+{
+    unsigned int ticks;
+    int type;
+    int chan;
+    int param1;
+    int param2;
+} test_event_t;
+
+static test_event_t events[NUM_EVENTS];
+static unsigned char midi_file[MAX_FILE_SIZE];
+
+static unsigned int seed = 4711;
+static unsigned int rnd(unsigned int n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+static int put_varlen(unsigned char *p, unsigned int value)
+{
+    unsigned char buf[4];
+    int i, n = 0;
+
+    do
+    {
+        buf[n++] = value & 0x7f;
+        value >>= 7;
+    }
+    while(value);
+
+    for(i = n - 1; i >= 0; i--)
+    {
+        p[n - 1 - i] = buf[i] | (i > 0 ? 0x80 : 0);
+    }
+
+    return n;
+}
+
+static void put_be32(unsigned char *p, unsigned int value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+/* Creates random controller, program, pitch bend and note events in two tracks */
+static int create_file(void)
+{
+    static const int ccs[] = { BANK_SELECT_MSB, BANK_SELECT_LSB, MODULATION_MSB, VOLUME_MSB, PAN_MSB, EXPRESSION_MSB, SUSTAIN_SWITCH, EFFECTS_DEPTH1 };
+    unsigned int ticks = 0;
+    int i, track, size = 14;
+
+    for(i = 0; i < NUM_EVENTS; i++)
+    {
+        test_event_t *e = &events[i];
+        int kind = rnd(10);
+
+        ticks += rnd(3);
+        e->ticks = ticks;
+        e->chan = rnd(16);
+        e->param1 = rnd(128);
+        e->param2 = rnd(128);
+
+        if(kind < 4)
+        {
+            e->type = NOTE_ON;
+        }
+        else if(kind < 6)
+        {
+            e->type = CONTROL_CHANGE;
+            e->param1 = ccs[rnd(FLUID_N_ELEMENTS(ccs))];
+        }
+        else if(kind < 7)
+        {
+            e->type = PROGRAM_CHANGE;
+        }
+        else if(kind < 8)
+        {
+            e->type = PITCH_BEND;
+            e->param1 = rnd(16384);
+        }
+        else if(kind < 9 && i + 3 < NUM_EVENTS)
+        {
+            // set the pitch wheel sensitivity with an RPN, at the same tick
+            e->type = CONTROL_CHANGE;
+            e->param1 = RPN_MSB;
+            e->param2 = 0;
+            e[1] = e[0];
+            e[1].param1 = RPN_LSB;
+            e[2] = e[0];
+            e[2].param1 = DATA_ENTRY_MSB;
+            e[2].param2 = rnd(24);
+            i += 2;
+        }
+        else
+        {
+            e->type = NOTE_OFF;
+        }
+    }
+
+    FLUID_MEMCPY(midi_file, "MThd\0\0\0\6\0\1\0\2\0\140", 14);
+
+    // the first 8 channels in the first track, the other ones in the second one, so that
+    // the events of each channel keep their order at the same tick
+    for(track = 0; track < 2; track++)
+    {
+        int start = size;
+        ticks = 0;
+        FLUID_MEMCPY(midi_file + size, "MTrk", 4);
+        size += 8;
+
+        for(i = 0; i < NUM_EVENTS; i++)
+        {
+            test_event_t *e = &events[i];
+
+            if(e->chan / 8 != track)
+            {
+                continue;
+            }
+
+            size += put_varlen(midi_file + size, e->ticks - ticks);
+            ticks = e->ticks;
+            midi_file[size++] = e->type | e->chan;
+
+            if(e->type == PITCH_BEND)
+            {
+                midi_file[size++] = e->param1 & 0x7f;
+                midi_file[size++] = e->param1 >> 7;
+            }
+            else if(e->type == PROGRAM_CHANGE)
+            {
+                midi_file[size++] = e->param1;
+            }
+            else
+            {
+                midi_file[size++] = e->param1;
+                midi_file[size++] = e->param2;
+            }
+        }
+
+        FLUID_MEMCPY(midi_file + size, "\0\377\57\0", 4);
+        size += 4;
+        put_be32(midi_file + start + 4, size - start - 8);
+    }
+
+    TEST_ASSERT(size <= MAX_FILE_SIZE);
+    return size;
+}
+
+/* Replays all events but notes up to the tick into the synth */
+static void replay(fluid_synth_t *synth, unsigned int ticks)
+{
+    fluid_midi_event_t *evt = new_fluid_midi_event();
+    int i;
+
+    TEST_ASSERT(evt != NULL);
+
+    for(i = 0; i < NUM_EVENTS && events[i].ticks <= ticks; i++)
+    {
+        const test_event_t *e = &events[i];
+
+        if((e->type == NOTE_ON || e->type == NOTE_OFF) && e->ticks != ticks)
+        {
+            continue;
+        }
+
+        fluid_midi_event_set_type(evt, e->type);
+        fluid_midi_event_set_channel(evt, e->chan);
+
+        if(e->type == PITCH_BEND)
+        {
+            fluid_midi_event_set_pitch(evt, e->param1);
+        }
+        else if(e->type == PROGRAM_CHANGE)
+        {
+            fluid_midi_event_set_program(evt, e->param1);
+        }
+        else
+        {
+            fluid_midi_event_set_control(evt, e->param1);
+            fluid_midi_event_set_value(evt, e->param2);
+        }
+
+        fluid_synth_handle_midi_event(synth, evt);
+    }
+
+    delete_fluid_midi_event(evt);
+}
+
+static void compare_synths(fluid_synth_t *synth1, fluid_synth_t *synth2)
+{
+    int chan, i, val1, val2, sfont1, sfont2, bank1, bank2, preset1, preset2;
+
+    for(chan = 0; chan < 16; chan++)
+    {
+        for(i = 0; i < 128; i++)
+        {
+            TEST_SUCCESS(fluid_synth_get_cc(synth1, chan, i, &val1));
+            TEST_SUCCESS(fluid_synth_get_cc(synth2, chan, i, &val2));
+            TEST_ASSERT(val1 == val2);
+        }
+
+        TEST_SUCCESS(fluid_synth_get_pitch_bend(synth1, chan, &val1));
+        TEST_SUCCESS(fluid_synth_get_pitch_bend(synth2, chan, &val2));
+        TEST_ASSERT(val1 == val2);
+
+        TEST_SUCCESS(fluid_synth_get_pitch_wheel_sens(synth1, chan, &val1));
+        TEST_SUCCESS(fluid_synth_get_pitch_wheel_sens(synth2, chan, &val2));
+        TEST_ASSERT(val1 == val2);
+
+        fluid_synth_get_program(synth1, chan, &sfont1, &bank1, &preset1);
+        fluid_synth_get_program(synth2, chan, &sfont2, &bank2, &preset2);
+        TEST_ASSERT(bank1 == bank2 && preset1 == preset2);
+    }
+}
+
+static void render(fluid_synth_t *synth)
+{
+    static float buf[2 * 64];
+    TEST_SUCCESS(fluid_synth_write_float(synth, 64, buf, 0, 2, buf, 1, 2));
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth, *reference;
+    fluid_player_t *player;
+    unsigned int total;
+    int size;
+
+    TEST_ASSERT(settings != NULL);
+    // no need to play the notes
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "player.reset-synth", 0));
+
+    synth = new_fluid_synth(settings);
+    reference = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL && reference != NULL);
+
+    size = create_file();
+    total = events[NUM_EVENTS - 1].ticks;
+
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, size));
+
+    // seek forward before playing, past the second keyframe
+    TEST_SUCCESS(fluid_player_seek(player, total * 2 / 3));
+    TEST_SUCCESS(fluid_player_play(player));
+    render(synth);
+    TEST_ASSERT(fluid_player_get_current_tick(player) == (int)(total * 2 / 3));
+    TEST_ASSERT(fluid_player_get_total_ticks(player) == (int)total);
+
+    replay(reference, total * 2 / 3);
+    compare_synths(synth, reference);
+
+    // seek backward, the state of controllers not set before that position is kept
+    TEST_SUCCESS(fluid_player_seek(player, total / 5));
+    render(synth);
+    TEST_ASSERT(fluid_player_get_current_tick(player) == (int)(total / 5));
+
+    replay(reference, total / 5);
+    compare_synths(synth, reference);
+
+    // seek forward a little, from the current position
+    TEST_SUCCESS(fluid_player_seek(player, total / 5 + 100));
+    render(synth);
+
+    replay(reference, total / 5 + 100);
+    compare_synths(synth, reference);
+
+    fluid_player_stop(player);
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+    delete_fluid_synth(reference);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
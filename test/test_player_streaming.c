@@ -0,0 +1,300 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that a file played with player.streaming sends the same events at the
+// same times as when it is loaded at once, across tempo changes, the windows of the timeline
+// and seeking backwards, while only keeping a window of the timeline in memory
+
+#define TEST_FILE "test_player_streaming.mid"
+#define NUM_EVENTS (4 * FLUID_PLAYER_STREAM_WINDOW)
+#define MAX_FILE_SIZE (NUM_EVENTS * 8 + 1024)
+#define MAX_RECORDS (2 * NUM_EVENTS)
+#define BLOCK 64
+
+typedef struct
+{
+    int type;
+    int chan;
+    int param1;
+    int param2;
+    double time;
+} test_record_t;
+
+typedef struct
+{
+    fluid_synth_t *synth;
+    unsigned int start;
+    int count;
+    test_record_t rec[MAX_RECORDS];
+} test_recording_t;
+
+static unsigned char midi_file[MAX_FILE_SIZE];
+static test_recording_t loaded, streamed;
+
+static unsigned int seed = 4711;
+static unsigned int rnd(unsigned int n)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % n;
+}
+
+static int put_varlen(unsigned char *p, unsigned int value)
+{
+    unsigned char buf[4];
+    int i, n = 0;
+
+    do
+    {
+        buf[n++] = value & 0x7f;
+        value >>= 7;
+    }
+    while(value);
+
+    for(i = n - 1; i >= 0; i--)
+    {
+        p[n - 1 - i] = buf[i] | (i > 0 ? 0x80 : 0);
+    }
+
+    return n;
+}
+
+static void put_be32(unsigned char *p, unsigned int value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+/* Creates random notes, controllers and pitch bends in two tracks, the first of which also
+   has a name and tempo changes, the second one text and SYSEX events */
+static int create_file(void)
+{
+    int i, track, size = 14;
+
+    FLUID_MEMCPY(midi_file, "MThd\0\0\0\6\0\1\0\2\0\140", 14);
+
+    for(track = 0; track < 2; track++)
+    {
+        int start = size;
+        FLUID_MEMCPY(midi_file + size, "MTrk", 4);
+        size += 8;
+
+        if(track == 0)
+        {
+            FLUID_MEMCPY(midi_file + size, "\0\377\3\4test", 8);
+            size += 8;
+        }
+
+        for(i = 0; i < NUM_EVENTS / 2; i++)
+        {
+            int kind = rnd(20);
+            int chan = track * 8 + rnd(8);
+
+            size += put_varlen(midi_file + size, rnd(4));
+
+            if(kind == 0 && track == 0)
+            {
+                unsigned int tempo = 300000 + rnd(400000);
+                midi_file[size++] = 0xff;
+                midi_file[size++] = 0x51;
+                midi_file[size++] = 3;
+                midi_file[size++] = tempo >> 16;
+                midi_file[size++] = tempo >> 8;
+                midi_file[size++] = tempo;
+            }
+            else if(kind == 0)
+            {
+                FLUID_MEMCPY(midi_file + size, "\377\1\4text", 7);
+                size += 7;
+            }
+            else if(kind == 1 && track == 1)
+            {
+                /* a SYSEX not meant for the synth */
+                FLUID_MEMCPY(midi_file + size, "\360\4\175\1\2\367", 6);
+                size += 6;
+            }
+            else if(kind < 10)
+            {
+                midi_file[size++] = ((kind & 1) ? NOTE_ON : NOTE_OFF) | chan;
+                midi_file[size++] = rnd(128);
+                midi_file[size++] = rnd(128);
+            }
+            else if(kind < 16)
+            {
+                midi_file[size++] = CONTROL_CHANGE | chan;
+                midi_file[size++] = (kind & 1) ? VOLUME_MSB : PAN_MSB;
+                midi_file[size++] = rnd(128);
+            }
+            else
+            {
+                midi_file[size++] = PITCH_BEND | chan;
+                midi_file[size++] = rnd(128);
+                midi_file[size++] = rnd(128);
+            }
+        }
+
+        FLUID_MEMCPY(midi_file + size, "\0\377\57\0", 4);
+        size += 4;
+        put_be32(midi_file + start + 4, size - start - 8);
+    }
+
+    TEST_ASSERT(size <= MAX_FILE_SIZE);
+    return size;
+}
+
+static int record(void *data, fluid_midi_event_t *event)
+{
+    test_recording_t *recording = data;
+    test_record_t *rec;
+    int type = fluid_midi_event_get_type(event);
+
+    /* seeking replays the controllers the same way, but not the same events */
+    if(type != NOTE_ON && type != NOTE_OFF && type != MIDI_TEXT && type != MIDI_SYSEX)
+    {
+        return fluid_synth_handle_midi_event(recording->synth, event);
+    }
+
+    TEST_ASSERT(recording->count < MAX_RECORDS);
+    rec = &recording->rec[recording->count++];
+    rec->type = type;
+    rec->chan = fluid_midi_event_get_channel(event);
+    rec->param1 = fluid_midi_event_get_key(event);
+    rec->param2 = fluid_midi_event_get_velocity(event);
+    rec->time = fluid_synth_get_ticks(recording->synth) - recording->start + recording->synth->event_offset;
+
+    if(type == MIDI_TEXT || type == MIDI_SYSEX)
+    {
+        void *data;
+        int size;
+
+        if(type == MIDI_TEXT)
+        {
+            TEST_SUCCESS(fluid_midi_event_get_text(event, &data, &size));
+            TEST_ASSERT(size == 5 && memcmp(data, "text", 5) == 0);
+        }
+        else
+        {
+            data = event->paramptr;
+            size = event->param1;
+            TEST_ASSERT(size == 3 && memcmp(data, "\175\1\2", 3) == 0);
+        }
+
+        rec->param1 = size;
+    }
+
+    return FLUID_OK;
+}
+
+static void play(fluid_settings_t *settings, test_recording_t *recording, int streaming, int size)
+{
+    static float left[BLOCK], right[BLOCK];
+    fluid_player_t *player;
+    int i, total;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "player.streaming", streaming));
+    recording->synth = new_fluid_synth(settings);
+    TEST_ASSERT(recording->synth != NULL);
+    recording->count = 0;
+
+    player = new_fluid_player(recording->synth);
+    TEST_ASSERT(player != NULL);
+    fluid_player_set_playback_callback(player, record, recording);
+
+    if(streaming)
+    {
+        /* the stream maps the file */
+        FILE *file = FLUID_FOPEN(TEST_FILE, "wb");
+        TEST_ASSERT(file != NULL);
+        TEST_ASSERT(fwrite(midi_file, 1, size, file) == (size_t)size);
+        FLUID_FCLOSE(file);
+        TEST_SUCCESS(fluid_player_add(player, TEST_FILE));
+    }
+    else
+    {
+        TEST_SUCCESS(fluid_player_add_mem(player, midi_file, size));
+    }
+
+    TEST_SUCCESS(fluid_player_play(player));
+    recording->start = fluid_synth_get_ticks(recording->synth);
+
+    /* past the first windows of the timeline */
+    for(i = 0; i < 4000; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(recording->synth, BLOCK, left, 0, 1, right, 0, 1));
+    }
+
+    TEST_ASSERT((player->stream != NULL) == streaming);
+    TEST_ASSERT(!streaming || (player->nevents <= FLUID_PLAYER_STREAM_WINDOW && player->stream->window_pos > 0));
+
+    total = fluid_player_get_total_ticks(player);
+    TEST_ASSERT(total > 0);
+    TEST_ASSERT(fluid_player_get_current_tick(player) > total / 4);
+    TEST_SUCCESS(fluid_player_seek(player, total / 4));
+
+    while(fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(recording->synth, BLOCK, left, 0, 1, right, 0, 1));
+    }
+
+    TEST_ASSERT(fluid_player_get_total_ticks(player) == total);
+    delete_fluid_player(player);
+
+    if(streaming)
+    {
+        remove(TEST_FILE);
+    }
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    int i, chan, ctrl, val1, val2, size;
+
+    TEST_ASSERT(settings != NULL);
+    // no need to play the notes
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-accurate-events", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "player.reset-synth", 0));
+
+    size = create_file();
+
+    play(settings, &loaded, FALSE, size);
+    play(settings, &streamed, TRUE, size);
+
+    TEST_ASSERT(loaded.count > NUM_EVENTS / 2);
+    TEST_ASSERT(streamed.count == loaded.count);
+
+    for(i = 0; i < loaded.count; i++)
+    {
+        TEST_ASSERT(streamed.rec[i].type == loaded.rec[i].type);
+        TEST_ASSERT(streamed.rec[i].chan == loaded.rec[i].chan);
+        TEST_ASSERT(streamed.rec[i].param1 == loaded.rec[i].param1);
+        TEST_ASSERT(streamed.rec[i].param2 == loaded.rec[i].param2);
+        TEST_ASSERT(streamed.rec[i].time == loaded.rec[i].time);
+    }
+
+    /* the controllers end up the same */
+    for(chan = 0; chan < 16; chan++)
+    {
+        for(ctrl = 0; ctrl < 128; ctrl++)
+        {
+            TEST_SUCCESS(fluid_synth_get_cc(loaded.synth, chan, ctrl, &val1));
+            TEST_SUCCESS(fluid_synth_get_cc(streamed.synth, chan, ctrl, &val2));
+            TEST_ASSERT(val1 == val2);
+        }
+
+        TEST_SUCCESS(fluid_synth_get_pitch_bend(loaded.synth, chan, &val1));
+        TEST_SUCCESS(fluid_synth_get_pitch_bend(streamed.synth, chan, &val2));
+        TEST_ASSERT(val1 == val2);
+    }
+
+    delete_fluid_synth(loaded.synth);
+    delete_fluid_synth(streamed.synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the player plays the events at their exact time, however many
+// tempo changes there are before them: an event reaches the synth in the block it is due in,
+// and with synth.sample-accurate-events at its offset within that block
+
+#define SAMPLE_RATE 44100
+#define DIVISION 96
+#define NUM_NOTES 200
+#define MAX_FILE_SIZE (NUM_NOTES * 16 + 64)
+
+static unsigned char midi_file[MAX_FILE_SIZE];
+static double note_time[NUM_NOTES];     /* in samples, at the tempos of the file */
+
+typedef struct
+{
+    fluid_synth_t *synth;
+    unsigned int start;
+    int count;
+    unsigned int tick[NUM_NOTES];
+    int offset[NUM_NOTES];
+} test_record_t;
+
+static int put_varlen(unsigned char *p, unsigned int value)
+{
+    unsigned char buf[4];
+    int i, n = 0;
+
+    do
+    {
+        buf[n++] = value & 0x7f;
+        value >>= 7;
+    }
+    while(value);
+
+    for(i = n - 1; i >= 0; i--)
+    {
+        p[n - 1 - i] = buf[i] | (i > 0 ? 0x80 : 0);
+    }
+
+    return n;
+}
+
+/* A note every few ticks, with a tempo change between each of them */
+static int create_file(void)
+{
+    int i, size = 22;
+    int tempo = 500000;
+    double usec = 0.0;
+
+    FLUID_MEMCPY(midi_file, "MThd\0\0\0\6\0\0\0\1\0\140MTrk", 18);
+
+    for(i = 0; i < NUM_NOTES; i++)
+    {
+        /* a tempo change 3 ticks before the note */
+        usec += 4.0 * tempo / DIVISION;
+        size += put_varlen(midi_file + size, 4);
+        tempo = 300000 + (i * 7919) % 400000;
+        midi_file[size++] = 0xff;
+        midi_file[size++] = 0x51;
+        midi_file[size++] = 3;
+        midi_file[size++] = tempo >> 16;
+        midi_file[size++] = tempo >> 8;
+        midi_file[size++] = tempo;
+
+        usec += 3.0 * tempo / DIVISION;
+        size += put_varlen(midi_file + size, 3);
+        midi_file[size++] = 0x90;
+        midi_file[size++] = 60;
+        midi_file[size++] = 100;
+        note_time[i] = usec * SAMPLE_RATE / 1000000.0;
+    }
+
+    FLUID_MEMCPY(midi_file + size, "\0\377\57\0", 4);
+    size += 4;
+
+    midi_file[18] = (size - 22) >> 24;
+    midi_file[19] = (size - 22) >> 16;
+    midi_file[20] = (size - 22) >> 8;
+    midi_file[21] = size - 22;
+
+    TEST_ASSERT(size <= MAX_FILE_SIZE);
+    return size;
+}
+
+static int record(void *data, fluid_midi_event_t *event)
+{
+    test_record_t *rec = data;
+
+    if(fluid_midi_event_get_type(event) == NOTE_ON)
+    {
+        TEST_ASSERT(rec->count < NUM_NOTES);
+        rec->tick[rec->count] = fluid_synth_get_ticks(rec->synth) - rec->start;
+        rec->offset[rec->count] = rec->synth->event_offset;
+        rec->count++;
+    }
+
+    return FLUID_OK;
+}
+
+static void play(fluid_settings_t *settings, int size, int sample_accurate, double multiplier)
+{
+    static float left[64], right[64];
+    fluid_player_t *player;
+    test_record_t rec;
+    double due;
+    int i;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-accurate-events", sample_accurate));
+    rec.synth = new_fluid_synth(settings);
+    TEST_ASSERT(rec.synth != NULL);
+    rec.count = 0;
+
+    player = new_fluid_player(rec.synth);
+    TEST_ASSERT(player != NULL);
+    fluid_player_set_playback_callback(player, record, &rec);
+    TEST_SUCCESS(fluid_player_add_mem(player, midi_file, size));
+    TEST_SUCCESS(fluid_player_set_tempo(player, FLUID_PLAYER_TEMPO_INTERNAL, multiplier));
+
+    TEST_SUCCESS(fluid_player_play(player));
+    rec.start = fluid_synth_get_ticks(rec.synth);
+
+    while(fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(rec.synth, 64, left, 0, 1, right, 0, 1));
+    }
+
+    TEST_ASSERT(rec.count == NUM_NOTES);
+
+    for(i = 0; i < NUM_NOTES; i++)
+    {
+        due = note_time[i] / multiplier;
+
+        if(sample_accurate)
+        {
+            /* sent at the start of the block it is due in, at its offset */
+            TEST_ASSERT(rec.tick[i] <= due && due < rec.tick[i] + 64);
+            TEST_ASSERT(fabs(rec.tick[i] + rec.offset[i] - due) <= 1.0);
+        }
+        else
+        {
+            /* sent at the start of the first block after it */
+            TEST_ASSERT(rec.tick[i] >= due - 0.01 && rec.tick[i] < due + 64);
+            TEST_ASSERT(rec.offset[i] == 0);
+        }
+    }
+
+    delete_fluid_player(player);
+    delete_fluid_synth(rec.synth);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    int size;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", SAMPLE_RATE));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "player.timing-source", "sample"));
+
+    size = create_file();
+
+    play(settings, size, FALSE, 1.0);
+    play(settings, size, TRUE, 1.0);
+    play(settings, size, FALSE, 1.7);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the player dispatches all events of the tracks of a MIDI file
+// in the right order, including the data of SYSEX and text events, whether it is loaded
+// from memory or from a file
+
+#define TEST_FILE "test_player_tracks.mid"
+
+static const unsigned char midi_file[] =
+{
+    'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 2, 0, 96,
+
+    'M', 'T', 'r', 'k', 0, 0, 0, 28,
+    0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20,           // tempo 500000
+    0x00, 0xff, 0x01, 0x05, 'h', 'e', 'l', 'l', 'o',    // text
+    0x00, 0xf0, 0x05, 0x7e, 0x7f, 0x09, 0x01, 0xf7,     // GM on
+    0x60, 0xff, 0x2f, 0x00,                             // end of track at tick 96
+
+    'X', 'F', 'I', 'H', 0, 0, 0, 2, 0x00, 0x00,         // unknown chunk, skipped
+
+    'M', 'T', 'r', 'k', 0, 0, 0, 18,
+    0x00, 0x90, 0x3c, 0x64,                             // note on
+    0x30, 0x3c, 0x00,                                   // running status, note off at tick 48
+    0x00, 0xc0, 0x05,                                   // program change
+    0x10, 0x80, 0x3e, 0x40,                             // note off at tick 64
+    0x00, 0xff, 0x2f, 0x00
+};
+
+typedef struct
+{
+    int type;
+    int param1;
+    int param2;
+    const char *data;
+    int size;
+} expected_event_t;
+
+static const expected_event_t expected[] =
+{
+    { MIDI_SET_TEMPO, 500000, 0, NULL, 0 },
+    { MIDI_TEXT, 0, 0, "hello", 6 },
+    { MIDI_SYSEX, 0, 0, "\x7e\x7f\x09\x01", 4 },
+    { NOTE_ON, 60, 100, NULL, 0 },
+    { NOTE_ON, 60, 0, NULL, 0 },
+    { PROGRAM_CHANGE, 5, 0, NULL, 0 },
+    { NOTE_OFF, 62, 64, NULL, 0 },
+};
+
+static int count = 0;
+static fluid_player_t *player = NULL;
+
+static int playback_callback(void *data, fluid_midi_event_t *event)
+{
+    const expected_event_t *e;
+    void *sysex;
+    int size;
+
+    TEST_ASSERT(count < (int)FLUID_N_ELEMENTS(expected));
+    e = &expected[count++];
+
+    TEST_ASSERT(fluid_midi_event_get_type(event) == e->type);
+
+    if(e->data != NULL)
+    {
+        if(e->type == MIDI_TEXT)
+        {
+            TEST_SUCCESS(fluid_midi_event_get_text(event, &sysex, &size));
+        }
+        else
+        {
+            const fluid_playlist_item *item = fluid_list_get(player->currentfile);
+
+            sysex = event->paramptr;
+            size = event->param1;
+
+            // the data of SYSEX events points into the buffer given to fluid_player_add_mem()
+            TEST_ASSERT(item->buffer == NULL || ((char *)sysex >= (char *)item->buffer
+                        && (char *)sysex + size <= (char *)item->buffer + item->buffer_len));
+        }
+
+        TEST_ASSERT(size == e->size);
+        TEST_ASSERT(memcmp(sysex, e->data, size) == 0);
+    }
+    else if(e->type == MIDI_SET_TEMPO)
+    {
+        TEST_ASSERT(event->param1 == (unsigned int)e->param1);
+    }
+    else
+    {
+        TEST_ASSERT(fluid_midi_event_get_key(event) == e->param1);
+
+        if(e->type != PROGRAM_CHANGE)
+        {
+            TEST_ASSERT(fluid_midi_event_get_velocity(event) == e->param2);
+        }
+    }
+
+    return fluid_synth_handle_midi_event(data, event);
+}
+
+static void play(fluid_synth_t *synth, int from_file)
+{
+    static float buf[2 * 64];
+
+    count = 0;
+    player = new_fluid_player(synth);
+    TEST_ASSERT(player != NULL);
+    TEST_SUCCESS(fluid_player_set_playback_callback(player, playback_callback, synth));
+
+    if(from_file)
+    {
+        TEST_SUCCESS(fluid_player_add(player, TEST_FILE));
+    }
+    else
+    {
+        TEST_SUCCESS(fluid_player_add_mem(player, midi_file, sizeof(midi_file)));
+    }
+
+    TEST_SUCCESS(fluid_player_play(player));
+
+    while(fluid_player_get_status(player) == FLUID_PLAYER_PLAYING)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, 64, buf, 0, 2, buf, 1, 2));
+    }
+
+    TEST_ASSERT(count == FLUID_N_ELEMENTS(expected));
+    TEST_ASSERT(fluid_player_get_total_ticks(player) == 96);
+
+    delete_fluid_player(player);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    FILE *file;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    play(synth, FALSE);
+
+    file = FLUID_FOPEN(TEST_FILE, "wb");
+    TEST_ASSERT(file != NULL);
+    TEST_ASSERT(fwrite(midi_file, 1, sizeof(midi_file), file) == sizeof(midi_file));
+    FLUID_FCLOSE(file);
+
+    play(synth, TRUE);
+    remove(TEST_FILE);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
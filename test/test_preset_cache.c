@@ -0,0 +1,281 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// this test makes sure that the presets cached in synth.preset-cache-dir by loading a SoundFont
+// are restored by loading it again, exactly as if they had been imported from the SoundFont
+
+#define FRAMES 4096
+#define CACHE_DIR "test_preset_cache.d"
+
+#ifndef _WIN32
+/* Counts the cache files, and removes them if remove_files is TRUE or truncates them if truncate is TRUE */
+static int clear_cache_dir(int truncate, int remove_files)
+{
+    char path[1024];
+    struct dirent *file;
+    DIR *dir = opendir(CACHE_DIR);
+    FILE *f;
+    int count = 0;
+
+    TEST_ASSERT(dir != NULL);
+
+    while((file = readdir(dir)) != NULL)
+    {
+        if(FLUID_STRNCMP(file->d_name, "fluidsynth-", 11) == 0)
+        {
+            FLUID_SNPRINTF(path, sizeof(path), "%s/%s", CACHE_DIR, file->d_name);
+
+            if(truncate)
+            {
+                f = FLUID_FOPEN(path, "r+b");
+                TEST_ASSERT(f != NULL);
+                TEST_ASSERT(ftruncate(fileno(f), 1000) == 0);
+                FLUID_FCLOSE(f);
+            }
+            else if(remove_files)
+            {
+                TEST_ASSERT(remove(path) == 0);
+            }
+
+            count++;
+        }
+    }
+
+    closedir(dir);
+    return count;
+}
+
+static int list_index(fluid_list_t *list, void *data)
+{
+    int i;
+
+    for(i = 0; list; i++, list = fluid_list_next(list))
+    {
+        if(fluid_list_get(list) == data)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int sample_index(fluid_defsfont_t *defsfont, fluid_sample_t *sample)
+{
+    return (sample != NULL) ? list_index(defsfont->sample, sample) : -1;
+}
+
+static void compare_zone(const fluid_gen_t *gen1, const fluid_gen_t *gen2, const fluid_mod_t *mod1, const fluid_mod_t *mod2,
+                         const fluid_zone_range_t *range1, const fluid_zone_range_t *range2)
+{
+    int i;
+
+    TEST_ASSERT(range1->keylo == range2->keylo && range1->keyhi == range2->keyhi);
+    TEST_ASSERT(range1->vello == range2->vello && range1->velhi == range2->velhi);
+
+    for(i = 0; i < GEN_LAST; i++)
+    {
+        /* the values of unused generators are never looked at */
+        TEST_ASSERT(gen1[i].flags == gen2[i].flags);
+        TEST_ASSERT(gen1[i].flags == GEN_UNUSED || gen1[i].val == gen2[i].val);
+    }
+
+    for(; mod1 != NULL && mod2 != NULL; mod1 = mod1->next, mod2 = mod2->next)
+    {
+        TEST_ASSERT(fluid_mod_test_identity(mod1, mod2));
+        TEST_ASSERT(mod1->amount == mod2->amount);
+    }
+
+    TEST_ASSERT(mod1 == NULL && mod2 == NULL);
+}
+
+static void compare_inst(fluid_defsfont_t *sfont1, fluid_inst_t *inst1, fluid_defsfont_t *sfont2, fluid_inst_t *inst2)
+{
+    fluid_inst_zone_t *zone1, *zone2;
+
+    TEST_ASSERT(FLUID_STRCMP(inst1->name, inst2->name) == 0);
+    TEST_ASSERT(inst1->source_idx == inst2->source_idx);
+    TEST_ASSERT((inst1->global_zone == NULL) == (inst2->global_zone == NULL));
+
+    if(inst1->global_zone != NULL)
+    {
+        zone1 = inst1->global_zone;
+        zone2 = inst2->global_zone;
+        TEST_ASSERT(FLUID_STRCMP(zone1->name, zone2->name) == 0);
+        compare_zone(zone1->gen, zone2->gen, zone1->mod, zone2->mod, &zone1->range, &zone2->range);
+    }
+
+    for(zone1 = inst1->zone, zone2 = inst2->zone; zone1 && zone2; zone1 = zone1->next, zone2 = zone2->next)
+    {
+        TEST_ASSERT(FLUID_STRCMP(zone1->name, zone2->name) == 0);
+        TEST_ASSERT(sample_index(sfont1, zone1->sample) == sample_index(sfont2, zone2->sample));
+        compare_zone(zone1->gen, zone2->gen, zone1->mod, zone2->mod, &zone1->range, &zone2->range);
+    }
+
+    TEST_ASSERT(zone1 == NULL && zone2 == NULL);
+}
+
+/* Compares everything a SoundFont has imported, before dynamic sample loading changes the samples */
+static void compare_sfonts(fluid_defsfont_t *sfont1, fluid_defsfont_t *sfont2)
+{
+    fluid_list_t *list1, *list2;
+    fluid_defpreset_t *preset1, *preset2;
+    fluid_preset_zone_t *zone1, *zone2;
+    fluid_sample_t *sample1, *sample2;
+    const fluid_mod_t *mod1, *mod2;
+
+    TEST_ASSERT(fluid_list_size(sfont1->preset) > 0);
+    TEST_ASSERT(fluid_list_size(sfont1->preset) == fluid_list_size(sfont2->preset));
+    TEST_ASSERT(fluid_list_size(sfont1->inst) == fluid_list_size(sfont2->inst));
+    TEST_ASSERT(fluid_list_size(sfont1->sample) == fluid_list_size(sfont2->sample));
+
+    for(mod1 = sfont1->sfont->default_mod_list, mod2 = sfont2->sfont->default_mod_list;
+            mod1 && mod2; mod1 = mod1->next, mod2 = mod2->next)
+    {
+        TEST_ASSERT(fluid_mod_test_identity(mod1, mod2) && mod1->amount == mod2->amount);
+    }
+
+    TEST_ASSERT(mod1 == NULL && mod2 == NULL);
+
+    for(list1 = sfont1->sample, list2 = sfont2->sample; list1; list1 = list1->next, list2 = list2->next)
+    {
+        sample1 = fluid_list_get(list1);
+        sample2 = fluid_list_get(list2);
+        TEST_ASSERT(FLUID_STRCMP(sample1->name, sample2->name) == 0);
+        TEST_ASSERT(sample1->start == sample2->start && sample1->end == sample2->end);
+        TEST_ASSERT(sample1->loopstart == sample2->loopstart && sample1->loopend == sample2->loopend);
+        TEST_ASSERT(sample1->samplerate == sample2->samplerate && sample1->sampletype == sample2->sampletype);
+        TEST_ASSERT(sample1->origpitch == sample2->origpitch && sample1->pitchadj == sample2->pitchadj);
+    }
+
+    for(list1 = sfont1->inst, list2 = sfont2->inst; list1; list1 = list1->next, list2 = list2->next)
+    {
+        compare_inst(sfont1, fluid_list_get(list1), sfont2, fluid_list_get(list2));
+    }
+
+    for(list1 = sfont1->preset, list2 = sfont2->preset; list1; list1 = list1->next, list2 = list2->next)
+    {
+        preset1 = fluid_preset_get_data((fluid_preset_t *)fluid_list_get(list1));
+        preset2 = fluid_preset_get_data((fluid_preset_t *)fluid_list_get(list2));
+
+        TEST_ASSERT(FLUID_STRCMP(preset1->name, preset2->name) == 0);
+        TEST_ASSERT(preset1->bank == preset2->bank && preset1->num == preset2->num);
+        TEST_ASSERT((preset1->global_zone == NULL) == (preset2->global_zone == NULL));
+
+        if(preset1->global_zone != NULL)
+        {
+            zone1 = preset1->global_zone;
+            zone2 = preset2->global_zone;
+            compare_zone(zone1->gen, zone2->gen, zone1->mod, zone2->mod, &zone1->range, &zone2->range);
+        }
+
+        for(zone1 = preset1->zone, zone2 = preset2->zone; zone1 && zone2; zone1 = zone1->next, zone2 = zone2->next)
+        {
+            TEST_ASSERT(FLUID_STRCMP(zone1->name, zone2->name) == 0);
+            TEST_ASSERT(list_index(sfont1->inst, zone1->inst) == list_index(sfont2->inst, zone2->inst));
+            TEST_ASSERT(fluid_list_size(zone1->voice_zone) == fluid_list_size(zone2->voice_zone));
+            compare_zone(zone1->gen, zone2->gen, zone1->mod, zone2->mod, &zone1->range, &zone2->range);
+        }
+
+        TEST_ASSERT(zone1 == NULL && zone2 == NULL);
+    }
+}
+
+static fluid_synth_t *load(fluid_settings_t *settings, fluid_defsfont_t **defsfont)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    int id;
+
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id != -1);
+
+    *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont_by_id(synth, id));
+    return synth;
+}
+
+static void render(fluid_synth_t *synth, float *buf)
+{
+    int chan;
+
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 5));
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 48 + chan * 3, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+}
+
+static void test_cache(int dynamic)
+{
+    static float imported[2 * FRAMES], cached[2 * FRAMES];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth1, *synth2, *synth3;
+    fluid_defsfont_t *sfont1, *sfont2, *sfont3;
+    int i;
+    float energy = 0;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.preset-cache-dir", CACHE_DIR));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", dynamic));
+
+    /* the first synth imports the presets and stores them, the second one restores them */
+    synth1 = load(settings, &sfont1);
+    TEST_ASSERT(clear_cache_dir(FALSE, FALSE) == 1);
+    synth2 = load(settings, &sfont2);
+    compare_sfonts(sfont1, sfont2);
+
+    /* a broken cache file is ignored and replaced */
+    TEST_ASSERT(clear_cache_dir(TRUE, FALSE) == 1);
+    synth3 = load(settings, &sfont3);
+    compare_sfonts(sfont1, sfont3);
+
+    render(synth1, imported);
+    render(synth2, cached);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        energy += FLUID_FABS(imported[i]);
+        TEST_ASSERT(imported[i] == cached[i]);
+    }
+
+    TEST_ASSERT(energy > 0);
+
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+    delete_fluid_synth(synth3);
+    delete_fluid_settings(settings);
+
+    TEST_ASSERT(clear_cache_dir(FALSE, TRUE) == 1);
+}
+#endif
+
+int main(void)
+{
+#ifndef _WIN32
+    int dynamic;
+
+    TEST_ASSERT(mkdir(CACHE_DIR, 0700) == 0 || errno == EEXIST);
+    clear_cache_dir(FALSE, TRUE);
+
+    for(dynamic = 0; dynamic <= 1; dynamic++)
+    {
+        test_cache(dynamic);
+    }
+
+    remove(CACHE_DIR);
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_list.h"
+
+// this test makes sure that a SoundFont finds its presets by bank and program through its index
+// as it would by walking the list of presets, and that the presets found by the synth are
+// looked up again once the SoundFonts or their bank offsets change
+
+static fluid_preset_t *find_in_list(fluid_defsfont_t *defsfont, int bank, int prog)
+{
+    fluid_list_t *list;
+    fluid_preset_t *preset;
+
+    for(list = defsfont->preset; list != NULL; list = fluid_list_next(list))
+    {
+        preset = fluid_list_get(list);
+
+        if(fluid_preset_get_banknum(preset) == bank && fluid_preset_get_num(preset) == prog)
+        {
+            return preset;
+        }
+    }
+
+    return NULL;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sfont_t *sfont;
+    fluid_defsfont_t *defsfont;
+    fluid_preset_t *preset;
+    int id, id2, bank, prog, found = 0;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id != FLUID_FAILED);
+    sfont = fluid_synth_get_sfont_by_id(synth, id);
+    TEST_ASSERT(sfont != NULL);
+    defsfont = fluid_sfont_get_data(sfont);
+    TEST_ASSERT(defsfont->preset_index != NULL);
+
+    for(bank = 0; bank <= 129; bank++)
+    {
+        for(prog = 0; prog < 128; prog++)
+        {
+            preset = find_in_list(defsfont, bank, prog);
+            TEST_ASSERT(fluid_sfont_get_preset(sfont, bank, prog) == preset);
+            found += (preset != NULL);
+        }
+    }
+
+    TEST_ASSERT(found == defsfont->preset_index_count);
+
+    /* the synth finds the presets of the SoundFont loaded last first */
+    preset = fluid_synth_get_channel_preset(synth, 0);
+    TEST_ASSERT(preset != NULL && fluid_preset_get_sfont(preset) == sfont);
+
+    id2 = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id2 != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    preset = fluid_synth_get_channel_preset(synth, 0);
+    TEST_ASSERT(preset != NULL && fluid_sfont_get_id(fluid_preset_get_sfont(preset)) == id2);
+
+    /* with an offset, its presets move to another bank */
+    TEST_SUCCESS(fluid_synth_set_bank_offset(synth, id2, 10));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    preset = fluid_synth_get_channel_preset(synth, 0);
+    TEST_ASSERT(preset != NULL && fluid_sfont_get_id(fluid_preset_get_sfont(preset)) == id);
+
+    TEST_SUCCESS(fluid_synth_bank_select(synth, 0, 10));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    preset = fluid_synth_get_channel_preset(synth, 0);
+    TEST_ASSERT(preset != NULL && fluid_sfont_get_id(fluid_preset_get_sfont(preset)) == id2);
+
+    /* a bank that was not found is found once it is loaded, until then bank 0 stands in */
+    TEST_SUCCESS(fluid_synth_sfunload(synth, id2, 1));
+    TEST_SUCCESS(fluid_synth_bank_select(synth, 0, 10));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    preset = fluid_synth_get_channel_preset(synth, 0);
+    TEST_ASSERT(preset != NULL && fluid_sfont_get_id(fluid_preset_get_sfont(preset)) == id);
+    id2 = fluid_synth_sfload(synth, TEST_SOUNDFONT, 0);
+    TEST_ASSERT(id2 != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_set_bank_offset(synth, id2, 10));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    preset = fluid_synth_get_channel_preset(synth, 0);
+    TEST_ASSERT(preset != NULL && fluid_sfont_get_id(fluid_preset_get_sfont(preset)) == id2);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
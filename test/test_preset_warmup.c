@@ -0,0 +1,132 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that presets are warmed up in the background, that the callback
+// reports the result, and that unpinned presets of dynamically loaded SoundFonts are refused
+
+#define FRAMES 4096
+
+typedef struct
+{
+    fluid_atomic_int_t calls;
+    int sfont_id;
+    int bank_num;
+    int preset_num;
+    int status;
+} warmup_result_t;
+
+static void on_warm(void *data, int sfont_id, int bank_num, int preset_num, int status)
+{
+    warmup_result_t *result = data;
+
+    result->sfont_id = sfont_id;
+    result->bank_num = bank_num;
+    result->preset_num = preset_num;
+    result->status = status;
+    fluid_atomic_int_inc(&result->calls);
+}
+
+static void wait_for(warmup_result_t *result, int calls)
+{
+    while(fluid_atomic_int_get(&result->calls) < calls)
+    {
+        fluid_msleep(1);
+    }
+}
+
+static void render(fluid_synth_t *synth, float *buf)
+{
+    int chan;
+
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 7));
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 40 + chan * 5, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+}
+
+int main(void)
+{
+    static float ref[2 * FRAMES], out[2 * FRAMES];
+    warmup_result_t result;
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int id, i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    FLUID_MEMSET(&result, 0, sizeof(result));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id != FLUID_FAILED);
+    render(synth, ref);
+    delete_fluid_synth(synth);
+
+    /* mapped samples are read from the file by the warm-up */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-mmap", 1));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id != FLUID_FAILED);
+
+    TEST_ASSERT(fluid_synth_warm_preset(synth, id + 1, 0, 0, on_warm, &result) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_warm_preset(synth, id, 42, 42, on_warm, &result) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_warm_preset(synth, id, -1, 0, on_warm, &result) == FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_warm_preset(synth, id, 0, 7, on_warm, &result));
+    wait_for(&result, 1);
+    TEST_ASSERT(result.sfont_id == id && result.bank_num == 0 && result.preset_num == 7);
+    TEST_SUCCESS(result.status);
+
+    TEST_SUCCESS(fluid_synth_warm_preset(synth, id, -1, -1, on_warm, &result));
+    wait_for(&result, 2);
+    TEST_ASSERT(result.bank_num == -1 && result.preset_num == -1);
+    TEST_SUCCESS(result.status);
+
+    TEST_SUCCESS(fluid_sfont_warm(fluid_synth_get_sfont_by_id(synth, id)));
+
+    render(synth, out);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(ref[i] == out[i]);
+    }
+
+    /* a warm-up still running is waited for when unloading */
+    TEST_SUCCESS(fluid_synth_warm_preset(synth, id, -1, -1, NULL, NULL));
+    TEST_SUCCESS(fluid_synth_sfunload(synth, id, 1));
+    delete_fluid_synth(synth);
+
+    /* only pinned presets of dynamically loaded SoundFonts */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-mmap", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 0);
+    TEST_ASSERT(id != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_warm_preset(synth, id, 0, 7, on_warm, &result));
+    wait_for(&result, 3);
+    TEST_ASSERT(result.status == FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_pin_preset(synth, id, 0, 7));
+    TEST_SUCCESS(fluid_synth_warm_preset(synth, id, 0, 7, on_warm, &result));
+    wait_for(&result, 4);
+    TEST_SUCCESS(result.status);
+    TEST_SUCCESS(fluid_synth_unpin_preset(synth, id, 0, 7));
+
+    /* left running when deleting the synth */
+    TEST_SUCCESS(fluid_synth_pin_preset(synth, id, 0, 7));
+    TEST_SUCCESS(fluid_synth_warm_preset(synth, id, 0, 7, NULL, NULL));
+    delete_fluid_synth(synth);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_synth.h"
+#include "drivers/fluid_render_ahead.h"
+
+// this test makes sure that the audio rendered ahead of a driver is rendered before the driver
+// asks for it, and that the driver gets exactly the audio the synth renders without rendering ahead
+
+#define SAMPLE_RATE 44100
+#define BLOCK 64
+#define AHEAD 4410
+#define PERIOD 100
+#define PERIODS 100
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 67, 80));
+
+    return synth;
+}
+
+int main(void)
+{
+    static float left[PERIOD], right[PERIOD], ref_left[PERIOD], ref_right[PERIOD];
+    float *out[2] = { left, right };
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth, *ref;
+    fluid_render_ahead_t *ahead;
+    int i, j;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", SAMPLE_RATE));
+
+    synth = create_synth(settings);
+    ref = create_synth(settings);
+
+    /* the ring is rendered full, in whole blocks, before the driver starts */
+    ahead = new_fluid_render_ahead(synth, AHEAD, BLOCK, SAMPLE_RATE);
+    TEST_ASSERT(ahead != NULL);
+    TEST_ASSERT(ahead->ring->totalcount == (AHEAD + BLOCK - 1) / BLOCK * BLOCK);
+    TEST_ASSERT(fluid_synth_get_ticks(synth) >= (unsigned int)AHEAD);
+
+    for(i = 0; i < PERIODS; i++)
+    {
+        /* the ring is kept full: no period runs short while the thread catches up */
+        while(fluid_ringbuffer_get_count(ahead->ring) < PERIOD)
+        {
+            fluid_msleep(1);
+        }
+
+        TEST_SUCCESS(fluid_render_ahead_process(ahead, PERIOD, 0, NULL, 2, out));
+        TEST_SUCCESS(fluid_synth_write_float(ref, PERIOD, ref_left, 0, 1, ref_right, 0, 1));
+
+        for(j = 0; j < PERIOD; j++)
+        {
+            TEST_ASSERT(left[j] == ref_left[j]);
+            TEST_ASSERT(right[j] == ref_right[j]);
+        }
+    }
+
+    /* the audio is rendered ahead of the periods taken */
+    TEST_ASSERT(fluid_synth_get_ticks(synth) >= (unsigned int)(PERIODS * PERIOD));
+
+    delete_fluid_render_ahead(ahead);
+    delete_fluid_synth(ref);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include <string.h>
+
+// this test makes sure that rendering a batch of synths on a render pool produces the same
+// audio as rendering every synth on its own
+
+#define BLOCK 256
+#define BLOCKS 8
+#define SYNTHS 24
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings, int n)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* a short piece of its own for every synth */
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, n % 8));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 40 + n, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 47 + n, 80));
+
+    return synth;
+}
+
+static void render(fluid_render_pool_t *pool, fluid_settings_t *settings,
+                   float (*left)[BLOCKS * BLOCK], float (*right)[BLOCKS * BLOCK])
+{
+    fluid_synth_t *synths[SYNTHS];
+    float *l[SYNTHS], *r[SYNTHS];
+    int i, block;
+
+    for(i = 0; i < SYNTHS; i++)
+    {
+        synths[i] = create_synth(settings, i);
+    }
+
+    for(block = 0; block < BLOCKS; block++)
+    {
+        for(i = 0; i < SYNTHS; i++)
+        {
+            l[i] = &left[i][block * BLOCK];
+            r[i] = &right[i][block * BLOCK];
+
+            if(block == BLOCKS / 2)
+            {
+                TEST_SUCCESS(fluid_synth_noteoff(synths[i], 0, 40 + i));
+            }
+        }
+
+        TEST_SUCCESS(fluid_render_pool_write_float(pool, SYNTHS, synths, BLOCK, l, r));
+    }
+
+    for(i = 0; i < SYNTHS; i++)
+    {
+        delete_fluid_synth(synths[i]);
+    }
+}
+
+int main(void)
+{
+    static float ref_l[SYNTHS][BLOCKS * BLOCK], ref_r[SYNTHS][BLOCKS * BLOCK];
+    static float l[SYNTHS][BLOCKS * BLOCK], r[SYNTHS][BLOCKS * BLOCK];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_render_pool_t *pool;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+
+    /* without a pool, the synths are rendered one after another */
+    render(NULL, settings, ref_l, ref_r);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", 4));
+    pool = new_fluid_render_pool(settings);
+    TEST_ASSERT(pool != NULL);
+
+    /* the synths of the batch render on a single core each */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", 1));
+    render(pool, settings, l, r);
+
+    for(i = 0; i < SYNTHS; i++)
+    {
+        TEST_ASSERT(memcmp(ref_l[i], l[i], sizeof(l[i])) == 0);
+        TEST_ASSERT(memcmp(ref_r[i], r[i], sizeof(r[i])) == 0);
+    }
+
+    /* an empty batch */
+    TEST_SUCCESS(fluid_render_pool_write_float(pool, 0, NULL, BLOCK, NULL, NULL));
+
+    delete_fluid_render_pool(pool);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+#include "test.h"
+#include "fluidsynth.h"
+
+#include <math.h>
+#include <string.h>
+
+// this test makes sure that the output is resampled from synth.render-rate to synth.sample-rate
+
+#define FRAMES 22050
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings, double render_rate)
+{
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.render-rate", render_rate));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+
+    return synth;
+}
+
+/* renders FRAMES frames in chunks of the given size */
+static void render(fluid_synth_t *synth, int chunk, float *left, float *right)
+{
+    int i, n;
+
+    for(i = 0; i < FRAMES; i += n)
+    {
+        n = (FRAMES - i < chunk) ? FRAMES - i : chunk;
+        TEST_SUCCESS(fluid_synth_write_float(synth, n, left, i, 1, right, i, 1));
+    }
+}
+
+static double rms(const float *buf, int start, int count)
+{
+    double sum = 0.0;
+    int i;
+
+    for(i = start; i < start + count; i++)
+    {
+        sum += buf[i] * buf[i];
+    }
+
+    return sqrt(sum / count);
+}
+
+int main(void)
+{
+    static float ref_left[FRAMES], ref_right[FRAMES];
+    static float left[FRAMES], right[FRAMES];
+    static float left2[FRAMES], right2[FRAMES];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    double ref_rms, out_rms;
+    int i;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", 44100.0));
+
+    synth = create_synth(settings, 0.0);
+    render(synth, 512, ref_left, ref_right);
+    delete_fluid_synth(synth);
+
+    /* a render rate equal to the sample rate doesn't resample */
+    synth = create_synth(settings, 44100.0);
+    render(synth, 512, left, right);
+    delete_fluid_synth(synth);
+
+    TEST_ASSERT(memcmp(ref_left, left, sizeof(left)) == 0);
+    TEST_ASSERT(memcmp(ref_right, right, sizeof(right)) == 0);
+
+    /* the voices run at half the rate, the level of the output stays about the same */
+    synth = create_synth(settings, 22050.0);
+    render(synth, 512, left, right);
+    delete_fluid_synth(synth);
+
+    ref_rms = rms(ref_left, FRAMES / 2, FRAMES / 2);
+    out_rms = rms(left, FRAMES / 2, FRAMES / 2);
+    TEST_ASSERT(ref_rms > 0.0);
+    TEST_ASSERT(fabs(out_rms - ref_rms) < 0.1 * ref_rms);
+
+    /* the resampled output doesn't depend on how it's requested */
+    synth = create_synth(settings, 22050.0);
+    render(synth, 100, left2, right2);
+    delete_fluid_synth(synth);
+
+    TEST_ASSERT(memcmp(left, left2, sizeof(left)) == 0);
+    TEST_ASSERT(memcmp(right, right2, sizeof(right)) == 0);
+
+    /* neither does a ratio without exact phases */
+    synth = create_synth(settings, 47000.0);
+    render(synth, 512, left, right);
+    delete_fluid_synth(synth);
+
+    synth = create_synth(settings, 47000.0);
+    render(synth, 333, left2, right2);
+    delete_fluid_synth(synth);
+
+    TEST_ASSERT(memcmp(left, left2, sizeof(left)) == 0);
+    out_rms = rms(left, FRAMES / 2, FRAMES / 2);
+    TEST_ASSERT(fabs(out_rms - ref_rms) < 0.1 * ref_rms);
+
+    /* fluid_synth_process() outputs the same */
+    synth = create_synth(settings, 47000.0);
+    memset(left2, 0, sizeof(left2));
+    memset(right2, 0, sizeof(right2));
+
+    for(i = 0; i < FRAMES; i += 490)
+    {
+        float *out[2];
+        int n = (FRAMES - i < 490) ? FRAMES - i : 490;
+
+        out[0] = &left2[i];
+        out[1] = &right2[i];
+        TEST_SUCCESS(fluid_synth_process(synth, n, 0, NULL, 2, out));
+    }
+
+    TEST_ASSERT(memcmp(left, left2, sizeof(left)) == 0);
+    TEST_ASSERT(memcmp(right, right2, sizeof(right)) == 0);
+
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+
+    for(i = 0; i < 20; i++)
+    {
+        render(synth, 512, left, right);
+    }
+
+    /* and a silent synth outputs silence */
+    for(i = 0; i < FRAMES; i++)
+    {
+        TEST_ASSERT(left[i] == 0.0f && right[i] == 0.0f);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the clients of a render server each get a synth of the pool
+// of their own, which plays the MIDI messages sent at the frames they are due at, the same
+// as a synth playing them itself, and that detached synths return to the pool reset
+
+#define TEST_FILE "test_render_server.shm"
+#define PERIOD 64
+#define POOL_SIZE 2
+#define CLIENTS 3
+#define NOTE_FRAME (PERIOD + 10)
+
+static const unsigned char noteon[] = { 0x90, 60, 100 };
+static const unsigned char bend[] = { 0xe0, 0x00, 0x50 };
+
+/* The interpolation of a voice starting within a block rings slightly ahead of it */
+static int is_silent(const float *buf, int start, int end)
+{
+    int i;
+
+    for(i = start; i < end; i++)
+    {
+        if(fabsf(buf[i]) > 1e-6f)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Renders what a client has been sent with a synth of its own */
+static void render_reference(fluid_settings_t *settings, float *left, float *right)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    fluid_midi_event_t *events[2];
+    unsigned int offsets[2] = { NOTE_FRAME - PERIOD, NOTE_FRAME - PERIOD + 20 };
+    int i;
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    events[0] = new_fluid_midi_event();
+    events[1] = new_fluid_midi_event();
+    TEST_ASSERT(events[0] != NULL && events[1] != NULL);
+    fluid_midi_event_set_type(events[0], 0x90);
+    fluid_midi_event_set_key(events[0], 60);
+    fluid_midi_event_set_velocity(events[0], 100);
+    fluid_midi_event_set_type(events[1], 0xe0);
+    fluid_midi_event_set_pitch(events[1], 0x50 << 7);
+
+    for(i = 0; i < 2; i++)
+    {
+        if(i == 1)
+        {
+            TEST_SUCCESS(fluid_synth_queue_midi_events(synth, events, offsets, 2));
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, PERIOD, left, i * PERIOD, 1, right, i * PERIOD, 1));
+    }
+
+    delete_fluid_midi_event(events[0]);
+    delete_fluid_midi_event(events[1]);
+    delete_fluid_synth(synth);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_pool_t *pool;
+    fluid_render_server_t *server;
+    fluid_render_client_t *client[CLIENTS];
+    const float *left, *right;
+    static float ref_left[2 * PERIOD], ref_right[2 * PERIOD];
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "audio.period-size", PERIOD));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-accurate-events", 1));
+
+    pool = new_fluid_synth_pool(settings, POOL_SIZE);
+    TEST_ASSERT(pool != NULL);
+    TEST_ASSERT(fluid_synth_pool_sfload(pool, TEST_SOUNDFONT) != FLUID_FAILED);
+
+    server = new_fluid_render_server(settings, pool, TEST_FILE, CLIENTS);
+    TEST_ASSERT(server != NULL);
+
+    client[0] = new_fluid_render_client(TEST_FILE);
+    TEST_ASSERT(client[0] != NULL);
+    TEST_ASSERT(fluid_render_client_get_period_size(client[0]) == PERIOD);
+    TEST_ASSERT(fluid_render_client_get_sample_rate(client[0]) == 44100.0);
+    TEST_ASSERT(fluid_render_client_get_frame(client[0]) == 0);
+
+    /* silent until the note starts */
+    TEST_ASSERT(fluid_render_client_render(client[0], &left, &right) == PERIOD);
+    TEST_ASSERT(is_silent(left, 0, PERIOD) && is_silent(right, 0, PERIOD));
+    TEST_ASSERT(fluid_render_client_get_frame(client[0]) == PERIOD);
+
+    TEST_SUCCESS(fluid_render_client_send(client[0], NOTE_FRAME, noteon, sizeof(noteon)));
+    TEST_SUCCESS(fluid_render_client_send(client[0], NOTE_FRAME + 20, bend, sizeof(bend)));
+    TEST_ASSERT(fluid_render_client_send(client[0], 0, noteon, 4) == FLUID_FAILED);
+
+    /* the second client plays a synth of its own */
+    client[1] = new_fluid_render_client(TEST_FILE);
+    TEST_ASSERT(client[1] != NULL);
+
+    /* plays the same as a synth given the events itself */
+    render_reference(settings, ref_left, ref_right);
+    TEST_ASSERT(fluid_render_client_render(client[0], &left, &right) == PERIOD);
+    TEST_ASSERT(is_silent(left, 0, NOTE_FRAME - PERIOD));
+    TEST_ASSERT(!is_silent(left, 0, PERIOD));
+    TEST_ASSERT(memcmp(left, ref_left + PERIOD, PERIOD * sizeof(float)) == 0);
+    TEST_ASSERT(memcmp(right, ref_right + PERIOD, PERIOD * sizeof(float)) == 0);
+
+    TEST_ASSERT(fluid_render_client_render(client[1], &left, &right) == PERIOD);
+    TEST_ASSERT(is_silent(left, 0, PERIOD) && is_silent(right, 0, PERIOD));
+
+    /* no synth left in the pool */
+    client[2] = new_fluid_render_client(TEST_FILE);
+    TEST_ASSERT(client[2] == NULL);
+
+    /* a synth returned to the pool is reset for the next client */
+    delete_fluid_render_client(client[0]);
+    client[2] = new_fluid_render_client(TEST_FILE);
+    TEST_ASSERT(client[2] != NULL);
+    TEST_ASSERT(fluid_render_client_get_frame(client[2]) == 0);
+
+    for(i = 0; i < 4; i++)
+    {
+        TEST_ASSERT(fluid_render_client_render(client[2], &left, &right) == PERIOD);
+        TEST_ASSERT(is_silent(left, 0, PERIOD) && is_silent(right, 0, PERIOD));
+    }
+
+    /* the messages waiting to be played are limited */
+    for(i = 0; fluid_render_client_send(client[2], 1000000, noteon, sizeof(noteon)) == FLUID_OK; i++)
+    {
+        TEST_ASSERT(i < 100000);
+    }
+
+    TEST_ASSERT(i > 0);
+
+    /* the clients fail once the server is gone */
+    delete_fluid_render_server(server);
+    TEST_ASSERT(fluid_render_client_render(client[1], &left, &right) == FLUID_FAILED);
+
+    delete_fluid_render_client(client[1]);
+    delete_fluid_render_client(client[2]);
+    delete_fluid_synth_pool(pool);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+
+#include "test.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_ringbuffer.h"
+
+// this test makes sure that bulk pushes and pops keep the order of the elements,
+// also when they wrap around the end of the array
+
+#define SIZE 7
+
+int main(void)
+{
+    fluid_ringbuffer_t *queue = new_fluid_ringbuffer(SIZE, sizeof(int));
+    int round, i, count, pushed = 0, popped = 0;
+    void *ptr;
+
+    TEST_ASSERT(queue != NULL);
+    TEST_ASSERT(fluid_ringbuffer_get_space(queue) == SIZE);
+    TEST_ASSERT(fluid_ringbuffer_get_outptrs(queue, &ptr) == 0);
+
+    for(round = 0; round < 50; round++)
+    {
+        /* push a varying number of elements at once */
+        count = 1 + round % 5;
+
+        if(count > fluid_ringbuffer_get_space(queue))
+        {
+            count = fluid_ringbuffer_get_space(queue);
+        }
+
+        for(i = 0; i < count; i++)
+        {
+            *(int *)fluid_ringbuffer_get_inptr_at(queue, i) = pushed++;
+        }
+
+        /* nothing is visible before the commit */
+        TEST_ASSERT(fluid_ringbuffer_get_count(queue) == pushed - count - popped);
+        fluid_ringbuffer_next_inptr(queue, count);
+        TEST_ASSERT(fluid_ringbuffer_get_space(queue) == SIZE - (pushed - popped));
+
+        /* pop all but one element, a batch never crosses the end of the array */
+        while(pushed - popped > 1)
+        {
+            count = fluid_ringbuffer_get_outptrs(queue, &ptr);
+            TEST_ASSERT(count > 0 && count <= pushed - popped);
+
+            if(count > pushed - popped - 1)
+            {
+                count = pushed - popped - 1;
+            }
+
+            for(i = 0; i < count; i++)
+            {
+                TEST_ASSERT(((int *)ptr)[i] == popped++);
+            }
+
+            fluid_ringbuffer_next_outptrs(queue, count);
+        }
+    }
+
+    /* the single pop sees the same elements */
+    TEST_ASSERT(*(int *)fluid_ringbuffer_get_outptr(queue) == popped);
+    fluid_ringbuffer_next_outptr(queue);
+    TEST_ASSERT(fluid_ringbuffer_get_outptrs(queue, &ptr) == 0);
+
+    delete_fluid_ringbuffer(queue);
+
+    return EXIT_SUCCESS;
+}
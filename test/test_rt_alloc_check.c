@@ -0,0 +1,91 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_list.h"
+
+// this test makes sure that with synth.rt-alloc-check, the synthesis thread doesn't allocate
+// or free memory while the voices of an unselected preset finish: with dynamic sample loading,
+// their samples are only unloaded by the next API call
+
+/* preset 42 (Lead Synth 2) consists of 4 samples, preset 40 (Aluminum Plate) of 1 sample */
+
+#define BLOCK 64
+
+/* doesn't enter the API of the synth, which would unload the released samples */
+static int count_loaded_samples(fluid_defsfont_t *defsfont)
+{
+    fluid_list_t *list;
+    int count = 0;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        if(((fluid_sample_t *)fluid_list_get(list))->data != NULL)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sfont_t *sfont;
+    fluid_defsfont_t *defsfont;
+    float left[BLOCK], right[BLOCK];
+    int id, i, count, loaded;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.rt-alloc-check", 1));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    /* noteon, noteoff and cc are applied by the synthesis thread */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.api-queue", 64));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 0);
+    TEST_ASSERT(id != FLUID_FAILED);
+    sfont = fluid_synth_get_sfont_by_id(synth, id);
+    TEST_ASSERT(sfont != NULL);
+    defsfont = fluid_sfont_get_data(sfont);
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 42));
+
+    count = fluid_rt_alloc_count();
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+
+    for(i = 0; i < 10; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, BLOCK, left, 0, 1, right, 0, 1));
+    }
+
+    /* the samples of preset 42 played by the voices stay loaded */
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 40));
+    loaded = count_loaded_samples(defsfont);
+    TEST_ASSERT(loaded > 1);
+
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+
+    for(i = 0; i < 2000; i++)
+    {
+        /* makes the synthesis thread take the API lock and collect the finished voices */
+        TEST_SUCCESS(fluid_synth_cc(synth, 1, 7, 100));
+        TEST_SUCCESS(fluid_synth_write_float(synth, BLOCK, left, 0, 1, right, 0, 1));
+    }
+
+    TEST_ASSERT(fluid_rt_alloc_count() == count);
+    TEST_ASSERT(count_loaded_samples(defsfont) == loaded);
+
+    /* the next API call unloads them */
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+    TEST_ASSERT(count_loaded_samples(defsfont) == 1);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
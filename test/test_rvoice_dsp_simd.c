@@ -0,0 +1,79 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_rvoice.h"
+#include <math.h>
+
+// this test makes sure that the SIMD interpolation kernels selected for the current CPU
+// produce the same audio as the scalar implementation, also when they compute in single
+// precision with synth.float-interpolation
+
+#define SAMPLES 8192
+#define MAX_ABS_DELTA 1e-5f
+
+static void render(fluid_settings_t *settings, int interp, int simd, int single, float *left, float *right)
+{
+    fluid_synth_t *synth;
+    int chan, key;
+
+    fluid_rvoice_dsp_set_simd_enabled(simd);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.float-interpolation", single));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, -1, interp));
+
+    for(chan = 0; chan < 4; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 7));
+        /* detune the channels to get fractional phase increments below and above 1 */
+        TEST_SUCCESS(fluid_synth_pitch_bend(synth, chan, 8192 + (chan - 2) * 1500));
+
+        for(key = 24; key < 108; key += 7)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 100));
+        }
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES, left, 0, 1, right, 0, 1));
+    delete_fluid_synth(synth);
+}
+
+int main(void)
+{
+    static float ref_l[SAMPLES], ref_r[SAMPLES];
+    static float simd_l[SAMPLES], simd_r[SAMPLES];
+    static const int methods[] = { FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER };
+    fluid_settings_t *settings;
+    unsigned int m;
+    int i;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    for(m = 0; m < sizeof(methods) / sizeof(methods[0]); m++)
+    {
+        render(settings, methods[m], 0, 0, ref_l, ref_r);
+        render(settings, methods[m], 1, 0, simd_l, simd_r);
+
+        for(i = 0; i < SAMPLES; i++)
+        {
+            TEST_ASSERT(fabsf(ref_l[i] - simd_l[i]) < MAX_ABS_DELTA);
+            TEST_ASSERT(fabsf(ref_r[i] - simd_r[i]) < MAX_ABS_DELTA);
+        }
+
+        render(settings, methods[m], 1, 1, simd_l, simd_r);
+
+        for(i = 0; i < SAMPLES; i++)
+        {
+            TEST_ASSERT(fabsf(ref_l[i] - simd_l[i]) < MAX_ABS_DELTA);
+            TEST_ASSERT(fabsf(ref_r[i] - simd_r[i]) < MAX_ABS_DELTA);
+        }
+    }
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "rvoice/fluid_rvoice.h"
+
+// this test makes sure that a voice only evaluates the modulation paths it uses, that they
+// follow generator changes while the voice plays, and that an unmodulated filter settles
+
+#define FRAMES 44100
+#define BLOCK 64
+
+static short data[FRAMES];
+
+static void render(fluid_synth_t *synth, int blocks)
+{
+    float left[BLOCK], right[BLOCK];
+    int i;
+
+    for(i = 0; i < blocks; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, BLOCK, left, 0, 1, right, 0, 1));
+    }
+}
+
+static void set_gen(fluid_synth_t *synth, fluid_voice_t *voice, int gen, float value)
+{
+    fluid_voice_gen_set(voice, gen, value);
+    fluid_voice_update_param(voice, gen);
+    /* sends the update to the rvoice, like the end of any other call of the API */
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 1);
+    render(synth, 1);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sample_t *sample;
+    fluid_voice_t *voice;
+    fluid_rvoice_t *rvoice;
+    int i;
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        data[i] = (short)(i * 37);
+    }
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    sample = new_fluid_sample();
+    TEST_ASSERT(sample != NULL);
+    TEST_SUCCESS(fluid_sample_set_sound_data(sample, data, NULL, FRAMES, 44100, TRUE));
+    TEST_SUCCESS(fluid_sample_set_pitch(sample, 60, 0));
+
+    voice = fluid_synth_alloc_voice(synth, sample, 0, 60, 100);
+    TEST_ASSERT(voice != NULL);
+    fluid_synth_start_voice(synth, voice);
+    rvoice = voice->rvoice;
+    render(synth, 2);
+
+    /* nothing is modulated without the mod wheel */
+    TEST_ASSERT(rvoice->envlfo.features == 0);
+    TEST_ASSERT(rvoice->resonant_filter.settled);
+
+    /* the default modulator of the mod wheel adds the vibrato */
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, MODULATION_MSB, 127));
+    render(synth, 1);
+    TEST_ASSERT(rvoice->envlfo.features == FLUID_RVOICE_PITCH_MOD);
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, MODULATION_MSB, 0));
+    render(synth, 1);
+    TEST_ASSERT(rvoice->envlfo.features == 0);
+
+    set_gen(synth, voice, GEN_MODLFOTOVOL, 30);
+    TEST_ASSERT(rvoice->envlfo.features == FLUID_RVOICE_VOL_MOD);
+
+    set_gen(synth, voice, GEN_MODENVTOFILTERFC, 1200);
+    TEST_ASSERT(rvoice->envlfo.features == (FLUID_RVOICE_VOL_MOD | FLUID_RVOICE_FC_MOD));
+
+    set_gen(synth, voice, GEN_MODLFOTOVOL, 0);
+    set_gen(synth, voice, GEN_MODENVTOFILTERFC, 0);
+    TEST_ASSERT(rvoice->envlfo.features == 0);
+
+    /* a new cutoff is smoothed, then the filter settles again */
+    set_gen(synth, voice, GEN_FILTERFC, 6000);
+    TEST_ASSERT(!rvoice->resonant_filter.settled);
+    render(synth, 8);
+    TEST_ASSERT(rvoice->resonant_filter.settled);
+    TEST_ASSERT(rvoice->resonant_filter.fres_incr_count == 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_sample(sample);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
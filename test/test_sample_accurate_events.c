@@ -0,0 +1,111 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that with synth.sample-accurate-events, a note queued at an offset within a block
+// sounds exactly like the same note queued at the start of a block, delayed by that offset
+
+#define BLOCKS 200
+#define FRAMES (BLOCKS * FLUID_BUFSIZE)
+#define DELAY 17
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    return synth;
+}
+
+static void queue_note(fluid_synth_t *synth, unsigned int on, unsigned int off)
+{
+    fluid_midi_event_t *events[2];
+    unsigned int offsets[2];
+    int i;
+
+    for(i = 0; i < 2; i++)
+    {
+        events[i] = new_fluid_midi_event();
+        TEST_ASSERT(events[i] != NULL);
+        TEST_SUCCESS(fluid_midi_event_set_type(events[i], i ? NOTE_OFF : NOTE_ON));
+        TEST_SUCCESS(fluid_midi_event_set_channel(events[i], 0));
+        TEST_SUCCESS(fluid_midi_event_set_key(events[i], 60));
+        TEST_SUCCESS(fluid_midi_event_set_velocity(events[i], 100));
+    }
+
+    offsets[0] = on;
+    offsets[1] = off;
+    TEST_SUCCESS(fluid_synth_queue_midi_events(synth, events, offsets, 2));
+
+    for(i = 0; i < 2; i++)
+    {
+        delete_fluid_midi_event(events[i]);
+    }
+}
+
+static void render(fluid_synth_t *synth, float *left, float *right)
+{
+    float *out[2];
+    int i;
+
+    for(i = 0; i < FRAMES; i += 1000)
+    {
+        out[0] = &left[i];
+        out[1] = &right[i];
+        TEST_SUCCESS(fluid_synth_process(synth, (FRAMES - i < 1000) ? FRAMES - i : 1000, 0, NULL, 2, out));
+    }
+}
+
+int main(void)
+{
+    static float left1[FRAMES], right1[FRAMES], left2[FRAMES], right2[FRAMES];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth1, *synth2;
+    int i;
+    float energy;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-accurate-events", 1));
+
+    synth1 = create_synth(settings);
+    synth2 = create_synth(settings);
+
+    // the note-off of the delayed note is rounded to the next block of the voice
+    queue_note(synth1, 0, 21 * FLUID_BUFSIZE);
+    queue_note(synth2, DELAY, 20 * FLUID_BUFSIZE + DELAY + 40);
+
+    FLUID_MEMSET(left1, 0, sizeof(left1));
+    FLUID_MEMSET(right1, 0, sizeof(right1));
+    FLUID_MEMSET(left2, 0, sizeof(left2));
+    FLUID_MEMSET(right2, 0, sizeof(right2));
+    render(synth1, left1, right1);
+    render(synth2, left2, right2);
+
+    for(i = 0; i < DELAY; i++)
+    {
+        TEST_ASSERT(left2[i] == 0 && right2[i] == 0);
+    }
+
+    // the first block differs by the fade-in of the mixer, which isn't delayed
+    energy = 0;
+
+    for(i = FLUID_BUFSIZE + DELAY; i < FRAMES; i++)
+    {
+        energy += FLUID_FABS(left2[i]) + FLUID_FABS(right2[i]);
+        TEST_ASSERT(left2[i] == left1[i - DELAY]);
+        TEST_ASSERT(right2[i] == right1[i - DELAY]);
+    }
+
+    TEST_ASSERT(energy > 0);
+
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_list.h"
+
+// this test makes sure that dynamic sample loading keeps the samples of unselected presets
+// within synth.dynamic-sample-loading-budget, unloading the ones used least recently first
+
+/* preset 42 (Lead Synth 2) consists of 4 samples, preset 40 (Aluminum Plate) of 1 sample */
+
+static fluid_defsfont_t *get_defsfont(fluid_synth_t *synth, int id)
+{
+    fluid_sfont_t *sfont = fluid_synth_get_sfont_by_id(synth, id);
+
+    TEST_ASSERT(sfont != NULL);
+    return fluid_sfont_get_data(sfont);
+}
+
+static int count_loaded_samples(fluid_defsfont_t *defsfont)
+{
+    fluid_list_t *list;
+    int count = 0;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        if(((fluid_sample_t *)fluid_list_get(list))->data != NULL)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* the size of 16 bit sample data, as the samples have neither 24 bit data nor mipmaps */
+static size_t data_size(const fluid_sample_t *sample)
+{
+    TEST_ASSERT(sample->data24 == NULL && sample->data_float == NULL && sample->mipmap == NULL);
+    return (sample->end - sample->start + 1) * sizeof(short);
+}
+
+/* the only sample of the selected preset */
+static fluid_sample_t *find_selected_sample(fluid_defsfont_t *defsfont)
+{
+    fluid_list_t *list;
+    fluid_sample_t *sample, *found = NULL;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        sample = fluid_list_get(list);
+
+        if(sample->data != NULL && !sample->kept_unused)
+        {
+            TEST_ASSERT(found == NULL);
+            found = sample;
+        }
+    }
+
+    TEST_ASSERT(found != NULL);
+    return found;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_sample_residency_stats_t before, after;
+    fluid_defsfont_t *defsfont;
+    fluid_sample_t *oldest, *newest;
+    fluid_synth_t *synth;
+    int id;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+
+    /* without a budget, the samples are loaded again */
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 0);
+    TEST_ASSERT(id != FLUID_FAILED);
+    defsfont = get_defsfont(synth, id);
+
+    TEST_SUCCESS(fluid_sample_get_residency_stats(&before));
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 42));
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 40));
+    TEST_ASSERT(count_loaded_samples(defsfont) == 1);
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 42));
+    TEST_SUCCESS(fluid_sample_get_residency_stats(&after));
+    TEST_ASSERT(after.misses - before.misses == 9);
+    TEST_ASSERT(after.hits == before.hits);
+    TEST_ASSERT(after.unused_samples == 0 && after.unused_bytes == 0);
+    delete_fluid_synth(synth);
+
+    /* with it, they are kept */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading-budget", 1));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 0);
+    TEST_ASSERT(id != FLUID_FAILED);
+    defsfont = get_defsfont(synth, id);
+    TEST_ASSERT(defsfont->sample_budget == 1024 * 1024);
+
+    TEST_SUCCESS(fluid_sample_get_residency_stats(&before));
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 42));
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 40));
+    TEST_ASSERT(count_loaded_samples(defsfont) == 5);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 5);
+
+    TEST_SUCCESS(fluid_sample_get_residency_stats(&after));
+    TEST_ASSERT(after.unused_samples == 4 && after.unused_bytes == defsfont->kept_bytes);
+    TEST_ASSERT(after.unused_bytes > 0);
+
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 42));
+    TEST_SUCCESS(fluid_sample_get_residency_stats(&after));
+    TEST_ASSERT(after.misses - before.misses == 5);
+    TEST_ASSERT(after.hits - before.hits == 4);
+    TEST_ASSERT(after.unused_samples == 1);
+
+    /* once the budget is exceeded, the sample used longest ago is unloaded */
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 40));
+    oldest = fluid_list_get(defsfont->kept_samples);
+    newest = find_selected_sample(defsfont);
+    defsfont->sample_budget = defsfont->kept_bytes - data_size(oldest) + data_size(newest);
+
+    TEST_SUCCESS(fluid_sample_get_residency_stats(&before));
+    TEST_SUCCESS(fluid_synth_program_select(synth, 0, id, 0, 0));
+    TEST_SUCCESS(fluid_sample_get_residency_stats(&after));
+    TEST_ASSERT(after.evictions - before.evictions == 1);
+    TEST_ASSERT(oldest->data == NULL && !oldest->kept_unused);
+    TEST_ASSERT(newest->data != NULL && newest->kept_unused);
+    TEST_ASSERT(defsfont->kept_bytes <= defsfont->sample_budget);
+
+    /* the kept samples are unloaded with the SoundFont */
+    TEST_SUCCESS(fluid_synth_sfunload(synth, id, 0));
+    TEST_SUCCESS(fluid_sample_get_residency_stats(&after));
+    TEST_ASSERT(after.unused_samples == 0 && after.unused_bytes == 0);
+    delete_fluid_synth(synth);
+
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
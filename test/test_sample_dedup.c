@@ -0,0 +1,124 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that synth.sample-dedup stores the samples of a SoundFont only once,
+// when the same samples are loaded again from a copy of it, and that they still sound the same
+
+#define FRAMES 4096
+#define COPY "test_sample_dedup.sf2"
+
+static void copy_file(const char *from, const char *to)
+{
+    char buf[4096];
+    size_t len;
+    FILE *in = FLUID_FOPEN(from, "rb");
+    FILE *out = FLUID_FOPEN(to, "wb");
+
+    TEST_ASSERT(in != NULL && out != NULL);
+
+    while((len = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+        TEST_ASSERT(fwrite(buf, 1, len, out) == len);
+    }
+
+    FLUID_FCLOSE(in);
+    TEST_ASSERT(FLUID_FCLOSE(out) == 0);
+}
+
+static void render(fluid_synth_t *synth, int sfont_id, float *buf)
+{
+    int chan;
+
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_select(synth, chan, sfont_id, 0, chan * 5));
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 48 + chan * 3, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+}
+
+static void compare(const float *ref, const float *out)
+{
+    int i;
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(ref[i] == out[i]);
+    }
+}
+
+int main(void)
+{
+    static float ref[2 * FRAMES], out[2 * FRAMES];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_sample_dedup_stats_t first, both;
+    fluid_synth_t *synth;
+    int id, copy_id;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    copy_file(TEST_SOUNDFONT, COPY);
+
+    /* the reference, without deduplication */
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id != FLUID_FAILED);
+    TEST_SUCCESS(fluid_sample_get_dedup_stats(&first));
+    TEST_ASSERT(first.samples == 0 && first.unique_samples == 0);
+    render(synth, id, ref);
+    delete_fluid_synth(synth);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-dedup", 1));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id != FLUID_FAILED);
+    TEST_SUCCESS(fluid_sample_get_dedup_stats(&first));
+    TEST_ASSERT(first.unique_samples > 0 && first.bytes_stored > 0);
+    TEST_ASSERT(first.unique_samples == fluid_samplecache_count_entries());
+    render(synth, id, out);
+    compare(ref, out);
+    delete_fluid_synth(synth);
+
+    /* all samples of the copy are found */
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    copy_id = fluid_synth_sfload(synth, COPY, 0);
+    TEST_ASSERT(copy_id != FLUID_FAILED);
+    TEST_SUCCESS(fluid_sample_get_dedup_stats(&both));
+    TEST_ASSERT(both.unique_samples == first.unique_samples && both.bytes_stored == first.bytes_stored);
+    TEST_ASSERT(both.samples == first.samples + first.unique_samples);
+    TEST_ASSERT(both.bytes_saved == first.bytes_saved + first.bytes_stored);
+    TEST_ASSERT(fluid_samplecache_count_entries() == first.unique_samples);
+    render(synth, copy_id, out);
+    compare(ref, out);
+    delete_fluid_synth(synth);
+
+    /* the samples stay while the copy uses them */
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id != FLUID_FAILED);
+    copy_id = fluid_synth_sfload(synth, COPY, 0);
+    TEST_ASSERT(copy_id != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_sfunload(synth, id, 0));
+    TEST_ASSERT(fluid_samplecache_count_entries() == first.unique_samples);
+    render(synth, copy_id, out);
+    compare(ref, out);
+    delete_fluid_synth(synth);
+
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+    TEST_SUCCESS(fluid_sample_get_dedup_stats(&both));
+    TEST_ASSERT(both.samples == 0 && both.unique_samples == 0);
+
+    remove(COPY);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "rvoice/fluid_rvoice.h"
+
+// this test makes sure that rendering from compressed sample data sounds like rendering from
+// the integer sample data, apart from the quantization noise well below the signal
+
+#define SAMPLES 4096
+
+static void render(fluid_settings_t *settings, const char *format, int interp, float *left, float *right)
+{
+    fluid_synth_t *synth;
+    int chan, key;
+
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.sample-format", format));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, -1, interp));
+
+    for(chan = 0; chan < 4; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 9));
+        TEST_SUCCESS(fluid_synth_pitch_bend(synth, chan, 8192 + (chan - 2) * 1500));
+
+        for(key = 30; key < 100; key += 9)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 100));
+        }
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES, left, 0, 1, right, 0, 1));
+    delete_fluid_synth(synth);
+}
+
+int main(void)
+{
+    static float int_l[SAMPLES], int_r[SAMPLES];
+    static float comp_l[SAMPLES], comp_r[SAMPLES];
+    static const int methods[] =
+    {
+        FLUID_INTERP_NONE, FLUID_INTERP_LINEAR, FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER,
+        FLUID_INTERP_16THORDER
+    };
+    /* a block of two points, the largest needing an exponent of 2 */
+    static const signed char block[FLUID_SAMPLE_BLOCK_SIZE] = { 2, -127, 64 };
+    fluid_settings_t *settings;
+    unsigned int m;
+    int i;
+
+    TEST_ASSERT(fluid_rvoice_get_sample_compressed(block, 0) == -508);
+    TEST_ASSERT(fluid_rvoice_get_sample_compressed(block, 1) == 256);
+    TEST_ASSERT(FLUID_SAMPLE_COMPRESSED_SIZE(1) == FLUID_SAMPLE_BLOCK_SIZE);
+    TEST_ASSERT(FLUID_SAMPLE_COMPRESSED_SIZE(FLUID_SAMPLE_BLOCK_POINTS + 1) == 2 * FLUID_SAMPLE_BLOCK_SIZE);
+
+    /* the SIMD kernels only handle integer data, compare the scalar code paths */
+    fluid_rvoice_dsp_set_simd_enabled(0);
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    for(m = 0; m < sizeof(methods) / sizeof(methods[0]); m++)
+    {
+        double signal = 0.0, noise = 0.0;
+
+        render(settings, "int", methods[m], int_l, int_r);
+        render(settings, "compressed", methods[m], comp_l, comp_r);
+
+        for(i = 0; i < SAMPLES; i++)
+        {
+            signal += (double)int_l[i] * int_l[i] + (double)int_r[i] * int_r[i];
+            noise += (double)(comp_l[i] - int_l[i]) * (comp_l[i] - int_l[i])
+                     + (double)(comp_r[i] - int_r[i]) * (comp_r[i] - int_r[i]);
+        }
+
+        /* at least 30 dB signal to noise ratio */
+        TEST_ASSERT(signal > 0.0);
+        TEST_ASSERT(noise > 0.0 && noise * 1000.0 < signal);
+    }
+
+    /* dynamically loaded samples stay uncompressed */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1));
+    render(settings, "int", FLUID_INTERP_DEFAULT, int_l, int_r);
+    render(settings, "compressed", FLUID_INTERP_DEFAULT, comp_l, comp_r);
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        TEST_ASSERT(int_l[i] == comp_l[i]);
+        TEST_ASSERT(int_r[i] == comp_r[i]);
+    }
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "rvoice/fluid_rvoice.h"
+
+// this test makes sure that rendering from pre-converted floating point sample data
+// produces exactly the same audio as rendering from the integer sample data
+
+#define SAMPLES 4096
+
+static void render(fluid_settings_t *settings, const char *format, int interp, float *left, float *right)
+{
+    fluid_synth_t *synth;
+    int chan, key;
+
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.sample-format", format));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, -1, interp));
+
+    for(chan = 0; chan < 4; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 9));
+        TEST_SUCCESS(fluid_synth_pitch_bend(synth, chan, 8192 + (chan - 2) * 1500));
+
+        for(key = 30; key < 100; key += 9)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 100));
+        }
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES, left, 0, 1, right, 0, 1));
+    delete_fluid_synth(synth);
+}
+
+int main(void)
+{
+    static float int_l[SAMPLES], int_r[SAMPLES];
+    static float float_l[SAMPLES], float_r[SAMPLES];
+    static const int methods[] =
+    {
+        FLUID_INTERP_NONE, FLUID_INTERP_LINEAR, FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER,
+        FLUID_INTERP_16THORDER
+    };
+    fluid_settings_t *settings;
+    unsigned int m;
+    int dynamic, i;
+
+    /* the SIMD kernels only handle integer data, compare the scalar code paths */
+    fluid_rvoice_dsp_set_simd_enabled(0);
+
+    for(dynamic = 0; dynamic <= 1; dynamic++)
+    {
+        settings = new_fluid_settings();
+        TEST_ASSERT(settings != NULL);
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", dynamic));
+
+        for(m = 0; m < sizeof(methods) / sizeof(methods[0]); m++)
+        {
+            render(settings, "int", methods[m], int_l, int_r);
+            render(settings, "float", methods[m], float_l, float_r);
+
+            for(i = 0; i < SAMPLES; i++)
+            {
+                TEST_ASSERT(int_l[i] == float_l[i]);
+                TEST_ASSERT(int_r[i] == float_r[i]);
+            }
+        }
+
+        delete_fluid_settings(settings);
+    }
+
+    return EXIT_SUCCESS;
+}
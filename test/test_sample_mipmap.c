@@ -0,0 +1,123 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "sfloader/fluid_sfont.h"
+#include <math.h>
+
+// this test makes sure that the mipmap levels of a sample keep the low frequencies and remove
+// the high ones, and that only voices transposed up by an octave or more read from them
+
+#define FRAMES 4096
+#define SAMPLES 4096
+#define AMPLITUDE 10000
+
+/* largest magnitude of a level, away from its edges, relative to the amplitude of the sample */
+static double level_peak(const fluid_sample_t *sample, int level, int count)
+{
+    const fluid_real_t *points = &sample->mipmap[sample->mip_offset[level - 1]];
+    double peak = 0.0;
+    int i;
+
+    for(i = 64; i < count - 64; i++)
+    {
+        peak = (fabs(points[i]) > peak) ? fabs(points[i]) : peak;
+    }
+
+    return peak / (AMPLITUDE * 256.0);
+}
+
+static void test_levels(double cycles_per_point, double min_peak, double max_peak)
+{
+    static short data[FRAMES];
+    fluid_sample_t *sample = new_fluid_sample();
+    int i;
+
+    TEST_ASSERT(sample != NULL);
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        data[i] = (short)(AMPLITUDE * sin(2 * M_PI * cycles_per_point * i));
+    }
+
+    TEST_SUCCESS(fluid_sample_set_sound_data(sample, data, NULL, FRAMES, 44100, TRUE));
+    TEST_SUCCESS(fluid_sample_build_mipmap(sample, FLUID_SAMPLE_MIP_LEVELS + 2));
+    TEST_ASSERT(sample->mip_levels == FLUID_SAMPLE_MIP_LEVELS);
+    TEST_ASSERT(sample->mip_offset[0] == 0);
+    TEST_ASSERT(sample->mip_offset[1] == FRAMES / 2);
+
+    /* the first level has half of the points and half of the bandwidth */
+    TEST_ASSERT(level_peak(sample, 1, FRAMES / 2) >= min_peak);
+    TEST_ASSERT(level_peak(sample, 1, FRAMES / 2) <= max_peak);
+
+    TEST_SUCCESS(fluid_sample_build_mipmap(sample, 0));
+    TEST_ASSERT(sample->mipmap == NULL && sample->mip_levels == 0);
+
+    delete_fluid_sample(sample);
+}
+
+static void render(fluid_settings_t *settings, int levels, int key, int bend, float *left, float *right)
+{
+    fluid_synth_t *synth;
+    int chan;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-mipmap-levels", levels));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+
+    for(chan = 0; chan < 4; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 9));
+        TEST_SUCCESS(fluid_synth_pitch_bend(synth, chan, bend));
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES, left, 0, 1, right, 0, 1));
+    delete_fluid_synth(synth);
+}
+
+int main(void)
+{
+    static float ref_l[SAMPLES], ref_r[SAMPLES];
+    static float mip_l[SAMPLES], mip_r[SAMPLES];
+    fluid_settings_t *settings;
+    int i, differs = FALSE, audible = FALSE;
+
+    /* a tenth of the new Nyquist frequency passes, 90% of the old one is removed */
+    test_levels(0.025, 0.99, 1.01);
+    test_levels(0.45, 0.0, 0.01);
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    /* played below the pitch of the samples, nothing changes */
+    render(settings, 0, 12, 0, ref_l, ref_r);
+    render(settings, FLUID_SAMPLE_MIP_LEVELS, 12, 0, mip_l, mip_r);
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        TEST_ASSERT(ref_l[i] == mip_l[i]);
+        TEST_ASSERT(ref_r[i] == mip_r[i]);
+    }
+
+    /* played octaves above, the band-limited levels are read where a block stays inside the loop */
+    render(settings, 0, 96, 0, ref_l, ref_r);
+    render(settings, FLUID_SAMPLE_MIP_LEVELS, 96, 0, mip_l, mip_r);
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        TEST_ASSERT(isfinite(mip_l[i]) && isfinite(mip_r[i]));
+        differs |= (ref_l[i] != mip_l[i]);
+        audible |= (mip_l[i] != 0.0f);
+    }
+
+    TEST_ASSERT(differs);
+    TEST_ASSERT(audible);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
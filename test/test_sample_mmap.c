@@ -0,0 +1,111 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_sffile.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that mapping the sample data of a SoundFont gives the same data as
+// reading it, and that synths using mapped sample data render the same audio
+
+#define FRAMES 4096
+
+static void check_mapped_data(void)
+{
+    /* the default file callbacks, which operate on FILE handles */
+    static const fluid_file_callbacks_t fcbs = { default_fopen, safe_fread, safe_fseek, default_fclose, default_ftell };
+    fluid_file_map_t map, map24;
+    SFData *sf;
+    short *data, *mapped;
+    char *data24, *mapped24;
+    int count, mapped_count;
+
+    sf = fluid_sffile_open(TEST_SOUNDFONT, &fcbs);
+    TEST_ASSERT(sf != NULL);
+
+    count = fluid_sffile_read_sample_data(sf, 100, 20000, 0, &data, &data24);
+    TEST_ASSERT(count == 19901);
+
+    mapped_count = fluid_sffile_map_sample_data(sf, 100, 20000, 0, &mapped, &mapped24, &map, &map24);
+
+#if FLUID_HAVE_FILE_MAP
+    TEST_ASSERT(FLUID_IS_BIG_ENDIAN || mapped_count == count);
+#endif
+
+    if(mapped_count >= 0)
+    {
+        TEST_ASSERT(mapped_count == count);
+        TEST_ASSERT(memcmp(data, mapped, count * sizeof(short)) == 0);
+        TEST_ASSERT((data24 == NULL) == (mapped24 == NULL));
+
+        if(data24 != NULL)
+        {
+            TEST_ASSERT(memcmp(data24, mapped24, count) == 0);
+        }
+
+        fluid_file_unmap(&map);
+        fluid_file_unmap(&map24);
+        TEST_ASSERT(map.addr == NULL);
+    }
+
+    /* compressed samples are never mapped */
+    TEST_ASSERT(fluid_sffile_map_sample_data(sf, 100, 20000, FLUID_SAMPLETYPE_OGG_VORBIS, &mapped, &mapped24, &map, &map24) == -1);
+
+    FLUID_FREE(data);
+    FLUID_FREE(data24);
+    fluid_sffile_close(sf);
+}
+
+static void render(int map_samples, int dynamic, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int chan;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-mmap", map_samples));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", dynamic));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 5));
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 48 + chan * 3, 100));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    /* the sample cache may not keep, and so share, data between the renderings */
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+}
+
+int main(void)
+{
+    static float ref[2 * FRAMES], mapped[2 * FRAMES];
+    int dynamic, i;
+    float energy = 0;
+
+    check_mapped_data();
+
+    for(dynamic = 0; dynamic <= 1; dynamic++)
+    {
+        render(0, dynamic, ref);
+        render(1, dynamic, mapped);
+
+        for(i = 0; i < 2 * FRAMES; i++)
+        {
+            energy += FLUID_FABS(ref[i]);
+            TEST_ASSERT(ref[i] == mapped[i]);
+        }
+    }
+
+    TEST_ASSERT(energy > 0);
+
+    return EXIT_SUCCESS;
+}
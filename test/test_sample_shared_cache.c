@@ -0,0 +1,105 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+
+#if FLUID_HAVE_FILE_MAP
+#include <dirent.h>
+#include <errno.h>
+#endif
+
+// this test makes sure that samples decoded by one synth are shared through synth.sample-cache-dir,
+// so that synths loading the same SoundFont later attach to them and render the same audio
+
+#define FRAMES 4096
+#define CACHE_DIR "test_sample_shared_cache.d"
+
+static int clear_cache_dir(void)
+{
+    int count = 0;
+#if FLUID_HAVE_FILE_MAP
+    char path[1024];
+    struct dirent *file;
+    DIR *dir = opendir(CACHE_DIR);
+
+    TEST_ASSERT(dir != NULL);
+
+    while((file = readdir(dir)) != NULL)
+    {
+        if(FLUID_STRNCMP(file->d_name, "fluidsynth-", 11) == 0)
+        {
+            FLUID_SNPRINTF(path, sizeof(path), "%s/%s", CACHE_DIR, file->d_name);
+            TEST_ASSERT(remove(path) == 0);
+            count++;
+        }
+    }
+
+    closedir(dir);
+#endif
+    return count;
+}
+
+static void render(int dynamic, int expect_mapped, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int chan;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.sample-cache-dir", CACHE_DIR));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", dynamic));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT_SF3, 1) != -1);
+
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 5));
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 48 + chan * 3, 100));
+    }
+
+    /* either all samples have been decoded, or all have been found in the shared cache */
+    TEST_ASSERT(fluid_samplecache_count_entries() > 0);
+    TEST_ASSERT(fluid_samplecache_count_mapped_entries()
+                == (expect_mapped ? fluid_samplecache_count_entries() : 0));
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    /* the next synth may only find the samples in the shared cache */
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+}
+
+int main(void)
+{
+#if FLUID_HAVE_FILE_MAP
+    static float decoded[2 * FRAMES], shared[2 * FRAMES];
+    int dynamic, i;
+    float energy = 0;
+
+    TEST_ASSERT(mkdir(CACHE_DIR, 0700) == 0 || errno == EEXIST);
+    clear_cache_dir();
+
+    for(dynamic = 0; dynamic <= 1; dynamic++)
+    {
+        render(dynamic, FALSE, decoded);
+        render(dynamic, TRUE, shared);
+
+        for(i = 0; i < 2 * FRAMES; i++)
+        {
+            energy += FLUID_FABS(decoded[i]);
+            TEST_ASSERT(decoded[i] == shared[i]);
+        }
+
+        TEST_ASSERT(clear_cache_dir() > 0);
+    }
+
+    TEST_ASSERT(energy > 0);
+    remove(CACHE_DIR);
+#endif
+
+    return EXIT_SUCCESS;
+}
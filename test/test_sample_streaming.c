@@ -0,0 +1,162 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_defsfont.h"
+#include "sfloader/fluid_samplecache.h"
+#include "rvoice/fluid_rvoice_stream.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the streaming thread reads ahead of the voices, that voices reaching
+// data not read yet are counted as underruns, and that streamed samples render the same audio
+
+#define FRAMES 4096
+#define PRELOAD 1024
+#define DATA_SIZE 100000
+
+static void check_slot(void)
+{
+    static short data[DATA_SIZE];
+    fluid_rvoice_stream_t *stream;
+    fluid_rvoice_stream_slot_t *slot;
+    fluid_sample_t *sample;
+    int i, position = 0, waited = 0;
+
+    stream = new_fluid_rvoice_stream(4 * PRELOAD);
+
+    if(stream == NULL)
+    {
+        TEST_ASSERT(!FLUID_HAVE_FILE_MAP);
+        return;
+    }
+
+    slot = fluid_rvoice_stream_new_slot(stream);
+    TEST_ASSERT(slot != NULL);
+
+    sample = new_fluid_sample();
+    TEST_ASSERT(sample != NULL);
+    sample->data = data;
+    sample->end = DATA_SIZE - 1;
+    sample->stream_preload = PRELOAD / 4;
+
+    /* the start of the sample has been read when loading */
+    fluid_rvoice_stream_slot_start(slot, sample);
+
+    for(i = 0; i < 3; i++, position += FLUID_BUFSIZE)
+    {
+        fluid_rvoice_stream_slot_advance(slot, position, 1.0, TRUE);
+    }
+
+    TEST_ASSERT(fluid_rvoice_stream_get_underruns(stream) == 0);
+
+    /* wait for the streaming thread to read ahead of the current position */
+    while((int)((unsigned int)fluid_atomic_int_get(&slot->ready) - slot->mixer_played) < 2 * PRELOAD)
+    {
+        TEST_ASSERT(waited++ < 5000);
+        fluid_msleep(1);
+    }
+
+    for(i = 0; i < PRELOAD / FLUID_BUFSIZE; i++, position += FLUID_BUFSIZE)
+    {
+        fluid_rvoice_stream_slot_advance(slot, position, 1.0, TRUE);
+    }
+
+    TEST_ASSERT(fluid_rvoice_stream_get_underruns(stream) == 0);
+
+    /* silent blocks don't access the data */
+    fluid_rvoice_stream_slot_advance(slot, position, 1000.0, FALSE);
+    TEST_ASSERT(fluid_rvoice_stream_get_underruns(stream) == 0);
+
+    /* no read ahead covers this */
+    fluid_rvoice_stream_slot_advance(slot, position, 1000.0, TRUE);
+    TEST_ASSERT(fluid_rvoice_stream_get_underruns(stream) == 1);
+
+    fluid_rvoice_stream_slot_stop(slot);
+    delete_fluid_rvoice_stream(stream);
+    delete_fluid_sample(sample);
+}
+
+static int count_streamed_samples(fluid_synth_t *synth)
+{
+    fluid_defsfont_t *defsfont = fluid_sfont_get_data(fluid_synth_get_sfont(synth, 0));
+    fluid_list_t *list;
+    int count = 0;
+
+    for(list = defsfont->sample; list; list = fluid_list_next(list))
+    {
+        fluid_sample_t *sample = fluid_list_get(list);
+
+        if(sample->stream_preload != 0)
+        {
+            TEST_ASSERT(sample->stream_preload == PRELOAD);
+            TEST_ASSERT(sample->end - sample->start + 1 > PRELOAD);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static void render(int streaming, int dynamic, float *buf)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int chan;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-streaming", streaming));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-streaming-preload", PRELOAD));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.dynamic-sample-loading", dynamic));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 5));
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 48 + chan * 3, 100));
+    }
+
+    if(streaming && FLUID_HAVE_FILE_MAP && !FLUID_IS_BIG_ENDIAN)
+    {
+        TEST_ASSERT(count_streamed_samples(synth) > 0);
+    }
+    else
+    {
+        TEST_ASSERT(count_streamed_samples(synth) == 0);
+        TEST_ASSERT(fluid_synth_get_stream_underruns(synth) == 0);
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    TEST_ASSERT(fluid_synth_get_stream_underruns(synth) >= 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+}
+
+int main(void)
+{
+    static float ref[2 * FRAMES], streamed[2 * FRAMES];
+    int dynamic, i;
+    float energy = 0;
+
+    check_slot();
+
+    for(dynamic = 0; dynamic <= 1; dynamic++)
+    {
+        render(0, dynamic, ref);
+        render(1, dynamic, streamed);
+
+        for(i = 0; i < 2 * FRAMES; i++)
+        {
+            energy += FLUID_FABS(ref[i]);
+            TEST_ASSERT(ref[i] == streamed[i]);
+        }
+    }
+
+    TEST_ASSERT(energy > 0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that sample timers are only called for the blocks they are due in:
+// once per block by default, at the block of the tick they have been scheduled for, with its
+// offset, and not at all while suspended or finished, until they are woken or reset
+
+#define BLOCKS 10
+
+typedef struct
+{
+    fluid_synth_t *synth;
+    fluid_sample_timer_t *timer;
+    int calls;
+    unsigned int ticks[BLOCKS];
+    int offsets[BLOCKS];
+    int action;
+} test_timer_t;
+
+enum
+{
+    EACH_BLOCK,
+    SCHEDULE,
+    SUSPEND,
+    FINISH
+};
+
+static int order[3 * BLOCKS];
+static int order_count;
+
+static int callback(void *data, unsigned int msec)
+{
+    test_timer_t *t = data;
+    unsigned int now = fluid_synth_get_ticks(t->synth);
+
+    TEST_ASSERT(t->calls < BLOCKS);
+    t->ticks[t->calls] = now;
+    t->offsets[t->calls] = fluid_sample_timer_get_offset(t->timer);
+    t->calls++;
+
+    TEST_ASSERT(order_count < 3 * BLOCKS);
+    order[order_count++] = t->action;
+
+    switch(t->action)
+    {
+    case SCHEDULE:
+        /* in the middle of the block after the next one */
+        fluid_sample_timer_schedule(t->synth, t->timer, now + 2 * FLUID_BUFSIZE + FLUID_BUFSIZE / 2);
+        break;
+
+    case SUSPEND:
+        fluid_sample_timer_suspend(t->synth, t->timer);
+        break;
+
+    case FINISH:
+        return 0;
+    }
+
+    return 1;
+}
+
+static void render(fluid_synth_t *synth, int blocks)
+{
+    static float left[FLUID_BUFSIZE], right[FLUID_BUFSIZE];
+    int i;
+
+    for(i = 0; i < blocks; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FLUID_BUFSIZE, left, 0, 1, right, 0, 1));
+    }
+}
+
+static void init_timer(test_timer_t *t, fluid_synth_t *synth, int action)
+{
+    FLUID_MEMSET(t, 0, sizeof(*t));
+    t->synth = synth;
+    t->action = action;
+    t->timer = new_fluid_sample_timer(synth, callback, t);
+    TEST_ASSERT(t->timer != NULL);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    test_timer_t timers[4];
+    unsigned int start;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    /* created in reverse, the timers created last are called first */
+    for(i = FINISH; i >= EACH_BLOCK; i--)
+    {
+        init_timer(&timers[i], synth, i);
+    }
+
+    start = fluid_synth_get_ticks(synth);
+    render(synth, 7);
+
+    /* called in the order of their creation within a block */
+    TEST_ASSERT(order[0] == EACH_BLOCK);
+    TEST_ASSERT(order[1] == SCHEDULE);
+    TEST_ASSERT(order[2] == SUSPEND);
+    TEST_ASSERT(order[3] == FINISH);
+
+    TEST_ASSERT(timers[EACH_BLOCK].calls == 7);
+
+    for(i = 0; i < 7; i++)
+    {
+        TEST_ASSERT(timers[EACH_BLOCK].ticks[i] == start + i * FLUID_BUFSIZE);
+        TEST_ASSERT(timers[EACH_BLOCK].offsets[i] == 0);
+    }
+
+    /* blocks 0, 2, 4 and 6, in the middle of the block */
+    TEST_ASSERT(timers[SCHEDULE].calls == 4);
+
+    for(i = 0; i < 4; i++)
+    {
+        TEST_ASSERT(timers[SCHEDULE].ticks[i] == start + 2 * i * FLUID_BUFSIZE);
+        TEST_ASSERT(timers[SCHEDULE].offsets[i] == ((i > 0) ? FLUID_BUFSIZE / 2 : 0));
+    }
+
+    TEST_ASSERT(timers[SUSPEND].calls == 1);
+    TEST_ASSERT(timers[FINISH].calls == 1);
+
+    /* woken and reset timers are called from the next block on */
+    fluid_sample_timer_wake(synth, timers[SUSPEND].timer);
+    fluid_sample_timer_reset(synth, timers[FINISH].timer);
+    render(synth, 2);
+
+    TEST_ASSERT(timers[SUSPEND].calls == 2);
+    TEST_ASSERT(timers[SUSPEND].ticks[1] == start + 7 * FLUID_BUFSIZE);
+    TEST_ASSERT(timers[FINISH].calls == 2);
+    TEST_ASSERT(timers[FINISH].ticks[1] == start + 7 * FLUID_BUFSIZE);
+
+    /* waking a timer that isn't suspended doesn't call it twice */
+    fluid_sample_timer_wake(synth, timers[EACH_BLOCK].timer);
+    render(synth, 1);
+    TEST_ASSERT(timers[EACH_BLOCK].calls == 10);
+
+    /* suspended, finished and scheduled timers can be deleted */
+    for(i = EACH_BLOCK; i <= FINISH; i++)
+    {
+        delete_fluid_sample_timer(synth, timers[i].timer);
+    }
+
+    render(synth, 1);
+    TEST_ASSERT(timers[EACH_BLOCK].calls == 10);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_samplecache.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that synths loading the same SoundFont at the same time share the
+// entries of the sample cache, rather than each loading samples the others load as well
+
+#define THREAD_COUNT 8
+
+static fluid_settings_t *settings;
+static fluid_synth_t *synths[THREAD_COUNT];
+
+static fluid_thread_return_t load(void *data)
+{
+    fluid_synth_t **synth = (fluid_synth_t **)data;
+
+    *synth = new_fluid_synth(settings);
+    TEST_ASSERT(*synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(*synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+int main(void)
+{
+    fluid_thread_t *threads[THREAD_COUNT];
+    fluid_synth_t *synth;
+    int i, entries;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+
+    /* loads the samples one by one */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sample-dedup", 1));
+
+    load(&synth);
+    entries = fluid_samplecache_count_entries();
+    TEST_ASSERT(entries > 1);
+    delete_fluid_synth(synth);
+    TEST_ASSERT(fluid_samplecache_count_entries() == 0);
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        threads[i] = new_fluid_thread("load", load, &synths[i], 0, FALSE);
+        TEST_ASSERT(threads[i] != NULL);
+    }
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        TEST_SUCCESS(fluid_thread_join(threads[i]));
+        delete_fluid_thread(threads[i]);
+    }
+
+    TEST_ASSERT(fluid_samplecache_count_entries() == entries);
+
+    /* the entries stay until the last synth using them is gone */
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        delete_fluid_synth(synths[i]);
+        TEST_ASSERT(fluid_samplecache_count_entries() == ((i < THREAD_COUNT - 1) ? entries : 0));
+    }
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,214 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+
+// this test makes sure that the events a client with a batch callback receives one after the other
+// are passed at once, in order, and that batches end where handling an event may change the queue
+
+#define MANY 100
+
+static int batches[16];
+static int batch_count = 0;
+static int values[2 * MANY];
+static int value_count = 0;
+static int single_count = 0;
+static int unregistered = 0;
+
+static void callback_single(unsigned int time, fluid_event_t *event, fluid_sequencer_t *seq, void *data)
+{
+    if(fluid_event_get_type(event) == FLUID_SEQ_UNREGISTERING)
+    {
+        unregistered++;
+        return;
+    }
+
+    single_count++;
+    values[value_count++] = fluid_event_get_value(event);
+}
+
+static void callback_batch(unsigned int time, fluid_event_t **events, int count, fluid_sequencer_t *seq, void *data)
+{
+    int i;
+
+    TEST_ASSERT(data == &batches);
+    TEST_ASSERT(batch_count < 16);
+    batches[batch_count++] = count;
+
+    for(i = 0; i < count; i++)
+    {
+        TEST_ASSERT(fluid_event_get_type(events[i]) != FLUID_SEQ_UNREGISTERING);
+        values[value_count++] = (fluid_event_get_type(events[i]) == FLUID_SEQ_NOTE) ? -1 : fluid_event_get_value(events[i]);
+    }
+}
+
+static void send_cc(fluid_sequencer_t *seq, fluid_seq_id_t dest, int value, unsigned int time)
+{
+    fluid_event_t *evt = new_fluid_event();
+
+    fluid_event_set_source(evt, -1);
+    fluid_event_set_dest(evt, dest);
+    fluid_event_control_change(evt, 0, 1, value);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, time, 1));
+    delete_fluid_event(evt);
+}
+
+static void send_note(fluid_sequencer_t *seq, fluid_seq_id_t dest, int key, unsigned int dur, unsigned int time)
+{
+    fluid_event_t *evt = new_fluid_event();
+
+    fluid_event_set_source(evt, -1);
+    fluid_event_set_dest(evt, dest);
+    fluid_event_note(evt, 0, key, 100, dur);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, time, 1));
+    delete_fluid_event(evt);
+}
+
+/* returns whether a voice of the key is playing and not released */
+static int key_is_on(fluid_synth_t *synth, int key)
+{
+    fluid_voice_t *voices[64];
+    int i;
+
+    fluid_synth_get_voicelist(synth, voices, 64, -1);
+
+    for(i = 0; i < 64 && voices[i] != NULL; i++)
+    {
+        if(fluid_voice_get_key(voices[i]) == key && fluid_voice_is_on(voices[i]))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void test_batches(void)
+{
+    fluid_sequencer_t *seq = new_fluid_sequencer2(0);
+    fluid_seq_id_t batched, single, source;
+    fluid_event_t *evt;
+    int i;
+
+    TEST_ASSERT(seq != NULL);
+    batched = fluid_sequencer_register_client(seq, "batched", callback_single, &batches);
+    single = fluid_sequencer_register_client(seq, "single", callback_single, NULL);
+    source = fluid_sequencer_register_client(seq, "source", NULL, NULL);
+    TEST_SUCCESS(batched);
+    TEST_SUCCESS(single);
+    TEST_SUCCESS(source);
+
+    TEST_ASSERT(fluid_sequencer_set_client_batch_callback(seq, source, callback_batch) == FLUID_FAILED);
+    TEST_ASSERT(fluid_sequencer_set_client_batch_callback(seq, 1000, callback_batch) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_sequencer_set_client_batch_callback(seq, batched, callback_batch));
+
+    // the events of another client split the batches
+    send_cc(seq, batched, 0, 1);
+    send_cc(seq, batched, 1, 1);
+    send_cc(seq, batched, 2, 1);
+    send_cc(seq, single, 3, 1);
+    send_cc(seq, batched, 4, 1);
+
+    // a note ends a batch
+    send_note(seq, batched, 60, 1000, 2);
+    send_cc(seq, batched, 5, 3);
+
+    fluid_sequencer_process(seq, 4);
+
+    TEST_ASSERT(batch_count == 3);
+    TEST_ASSERT(batches[0] == 3);
+    TEST_ASSERT(batches[1] == 2);
+    TEST_ASSERT(batches[2] == 1);
+    TEST_ASSERT(single_count == 1);
+    TEST_ASSERT(value_count == 7);
+
+    for(i = 0; i < 5; i++)
+    {
+        TEST_ASSERT(values[i] == i);
+    }
+
+    TEST_ASSERT(values[5] == -1);
+    TEST_ASSERT(values[6] == 5);
+
+    // events sent now still go to the callback of the client
+    evt = new_fluid_event();
+    fluid_event_set_source(evt, -1);
+    fluid_event_set_dest(evt, batched);
+    fluid_event_control_change(evt, 0, 1, 6);
+    fluid_sequencer_send_now(seq, evt);
+    delete_fluid_event(evt);
+    TEST_ASSERT(single_count == 2);
+
+    // batches are limited in size, the unregistering event is never part of one
+    batch_count = value_count = 0;
+
+    for(i = 0; i < MANY; i++)
+    {
+        send_cc(seq, batched, i, 10);
+    }
+
+    evt = new_fluid_event();
+    fluid_event_set_source(evt, -1);
+    fluid_event_set_dest(evt, batched);
+    fluid_event_unregistering(evt);
+    TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, 11, 1));
+    delete_fluid_event(evt);
+
+    fluid_sequencer_process(seq, 20);
+
+    TEST_ASSERT(batch_count >= 2);
+    TEST_ASSERT(value_count == MANY);
+    TEST_ASSERT(unregistered == 1);
+
+    for(i = 0; i < MANY; i++)
+    {
+        TEST_ASSERT(values[i] == i);
+    }
+
+    fluid_sequencer_unregister_client(seq, single);
+    fluid_sequencer_unregister_client(seq, source);
+    delete_fluid_sequencer(seq);
+}
+
+/* a note played again before its end must not be ended by the note-off of the first one */
+static void test_seqbind(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sequencer_t *seq;
+    fluid_seq_id_t dest;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    seq = new_fluid_sequencer2(0);
+    TEST_ASSERT(seq != NULL);
+    dest = fluid_sequencer_register_fluidsynth(seq, synth);
+    TEST_SUCCESS(dest);
+
+    // the note-off of the first note is queued at tick 6
+    send_note(seq, dest, 60, 5, 0);
+    fluid_sequencer_process(seq, 1);
+    TEST_ASSERT(key_is_on(synth, 60));
+
+    // the second note is due along with that note-off
+    send_note(seq, dest, 60, 20, 3);
+    fluid_sequencer_process(seq, 10);
+    TEST_ASSERT(key_is_on(synth, 60));
+
+    fluid_sequencer_process(seq, 40);
+    TEST_ASSERT(!key_is_on(synth, 60));
+
+    fluid_sequencer_unregister_client(seq, dest);
+    delete_fluid_sequencer(seq);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+int main(void)
+{
+    test_batches();
+    test_seqbind();
+
+    return EXIT_SUCCESS;
+}
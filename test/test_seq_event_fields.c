@@ -0,0 +1,75 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_event.h"
+
+// this test makes sure that the accessors of a sequencer event return the fields of its
+// type, even though event types share the storage of the fields they don't use together
+
+int main(void)
+{
+    fluid_event_t *evt = new_fluid_event();
+    int data;
+
+    TEST_ASSERT(evt != NULL);
+
+    /* the fields of a cleared event */
+    TEST_ASSERT(fluid_event_get_type(evt) == -1);
+    TEST_ASSERT(fluid_event_get_source(evt) == -1);
+    TEST_ASSERT(fluid_event_get_dest(evt) == -1);
+    TEST_ASSERT(fluid_event_get_id(evt) == -1);
+    TEST_ASSERT(fluid_event_get_value(evt) == 0);
+    TEST_ASSERT(fluid_event_get_data(evt) == NULL);
+
+    fluid_event_note(evt, 3, 60, 100, 500);
+    TEST_ASSERT(fluid_event_get_channel(evt) == 3);
+    TEST_ASSERT(fluid_event_get_key(evt) == 60);
+    TEST_ASSERT(fluid_event_get_velocity(evt) == 100);
+    TEST_ASSERT(fluid_event_get_duration(evt) == 500);
+    TEST_ASSERT(fluid_event_get_id(evt) == -1);
+    TEST_ASSERT(fluid_event_get_control(evt) == 0);
+    TEST_ASSERT(fluid_event_get_value(evt) == 0);
+    TEST_ASSERT(fluid_event_get_scale(evt) == 0.0);
+
+    /* a note is turned into its noteoff by the synth client */
+    fluid_event_noteoff(evt, 3, 60);
+    fluid_event_set_id(evt, 1234);
+    TEST_ASSERT(fluid_event_get_type(evt) == FLUID_SEQ_NOTEOFF);
+    TEST_ASSERT(fluid_event_get_id(evt) == 1234);
+    TEST_ASSERT(fluid_event_get_value(evt) == 0);
+    TEST_ASSERT(fluid_event_get_duration(evt) == 0);
+
+    /* reusing the event doesn't keep the id */
+    fluid_event_control_change(evt, 4, 7, 90);
+    TEST_ASSERT(fluid_event_get_control(evt) == 7);
+    TEST_ASSERT(fluid_event_get_value(evt) == 90);
+    TEST_ASSERT(fluid_event_get_velocity(evt) == 0);
+    TEST_ASSERT(fluid_event_get_id(evt) == -1);
+
+    fluid_event_noteon(evt, 4, 61, 80);
+    TEST_ASSERT(fluid_event_get_velocity(evt) == 80);
+    TEST_ASSERT(fluid_event_get_id(evt) == -1);
+
+    fluid_event_pitch_bend(evt, 5, 10000);
+    TEST_ASSERT(fluid_event_get_pitch(evt) == 10000);
+    TEST_ASSERT(fluid_event_get_value(evt) == 0);
+
+    fluid_event_program_select(evt, 6, 2, 128, 12);
+    TEST_ASSERT(fluid_event_get_sfont_id(evt) == 2);
+    TEST_ASSERT(fluid_event_get_bank(evt) == 128);
+    TEST_ASSERT(fluid_event_get_program(evt) == 12);
+    TEST_ASSERT(fluid_event_get_pitch(evt) == 0);
+
+    fluid_event_timer(evt, &data);
+    TEST_ASSERT(fluid_event_get_data(evt) == &data);
+    TEST_ASSERT(fluid_event_get_duration(evt) == 0);
+    TEST_ASSERT(fluid_event_get_scale(evt) == 0.0);
+
+    fluid_event_scale(evt, 480.0);
+    TEST_ASSERT(fluid_event_get_scale(evt) == 480.0);
+    TEST_ASSERT(fluid_event_get_data(evt) == NULL);
+
+    delete_fluid_event(evt);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "fluid_event.h"
+#include "fluid_sys.h"
+
+// this test makes sure that the events are dispatched in order, no matter how far ahead they have been
+// scheduled, and that removing the events of one source doesn't touch the events of other sources
+
+#define NUM_EVENTS 20000
+#define SOURCE_KEPT 1
+#define SOURCE_REMOVED 2
+
+static unsigned int prev_time, prev_value, count;
+void callback_order(unsigned int time, fluid_event_t *event, fluid_sequencer_t *seq, void *data)
+{
+    unsigned int evt_time = fluid_event_get_time(event);
+
+    if(fluid_event_get_type(event) == FLUID_SEQ_UNREGISTERING)
+    {
+        return;
+    }
+
+    TEST_ASSERT(fluid_event_get_source(event) == SOURCE_KEPT);
+    TEST_ASSERT(evt_time <= time);
+    TEST_ASSERT(prev_time <= evt_time);
+
+    // events of the same type at the same tick are dispatched in the order they have been sent
+    TEST_ASSERT(prev_time != evt_time || prev_value < (unsigned int)fluid_event_get_value(event));
+
+    prev_time = evt_time;
+    prev_value = fluid_event_get_value(event);
+    count++;
+}
+
+static unsigned int test_time(unsigned int i)
+{
+    // cover every level of the wheel, many events share a tick
+    static const unsigned int ranges[] = { 300, 20000, 1500000, 100000000, 0x7fffffff };
+    static unsigned int seed = 12345;
+
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 1) % ranges[i % FLUID_N_ELEMENTS(ranges)];
+}
+
+void test_wheel(fluid_sequencer_t *seq, fluid_event_t *evt)
+{
+    unsigned int i, t, kept = 0;
+    int seqid = fluid_sequencer_register_client(seq, "wheel test", callback_order, NULL);
+    TEST_SUCCESS(seqid);
+
+    fluid_event_set_dest(evt, seqid);
+
+    for(i = 0; i < NUM_EVENTS; i++)
+    {
+        t = test_time(i);
+
+        // use the value to check the order of events at the same tick
+        fluid_event_set_source(evt, (i % 3 == 0) ? SOURCE_REMOVED : SOURCE_KEPT);
+        fluid_event_control_change(evt, 0, 1, i);
+        TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, t, 1));
+        kept += (i % 3 != 0);
+    }
+
+    fluid_sequencer_remove_events(seq, SOURCE_REMOVED, -1, -1);
+
+    // advance in steps of varying size, sending events at and behind the current tick in between
+    for(t = 0; t < 0x7fffffff; t += t / 2 + 1)
+    {
+        fluid_sequencer_process(seq, t);
+        TEST_ASSERT(prev_time <= t);
+
+        fluid_event_set_source(evt, SOURCE_KEPT);
+        fluid_event_control_change(evt, 0, 1, NUM_EVENTS + count);
+        TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, t + 1, 1));
+        kept++;
+    }
+
+    fluid_sequencer_process(seq, 0xffffffff);
+    TEST_ASSERT(count == kept);
+
+    fluid_sequencer_unregister_client(seq, seqid);
+}
+
+int main(void)
+{
+    fluid_event_t *evt;
+    fluid_sequencer_t *seq = new_fluid_sequencer2(0 /*i.e. use sample timer*/);
+    TEST_ASSERT(seq != NULL);
+
+    // one tick per millisecond, to reach any tick
+    fluid_sequencer_set_time_scale(seq, 1000);
+    evt = new_fluid_event();
+    TEST_ASSERT(evt != NULL);
+
+    test_wheel(seq, evt);
+
+    delete_fluid_event(evt);
+    delete_fluid_sequencer(seq);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "fluid_event.h"
+#include "fluid_sys.h"
+
+// this test makes sure that events sent by fluid_sequencer_send_batch() are dispatched like
+// events sent one by one with fluid_sequencer_send_at()
+
+#define BATCH_SIZE 1000
+
+static unsigned int dispatched[2 * BATCH_SIZE];
+static int count = 0;
+
+void callback_record(unsigned int time, fluid_event_t *event, fluid_sequencer_t *seq, void *data)
+{
+    if(fluid_event_get_type(event) == FLUID_SEQ_UNREGISTERING)
+    {
+        return;
+    }
+
+    TEST_ASSERT(count < 2 * BATCH_SIZE);
+
+    // the tick in the upper bits, the type and index in the lower ones to check the order at the same tick
+    dispatched[count++] = (fluid_event_get_time(event) << 16) | (fluid_event_get_type(event) << 12) | fluid_event_get_value(event);
+}
+
+static void record(fluid_sequencer_t *seq, fluid_event_t **evts, const unsigned int *times, int batch)
+{
+    int i;
+
+    for(i = 0; i < BATCH_SIZE; i++)
+    {
+        // events at the same tick
+        if(i % 2)
+        {
+            fluid_event_noteon(evts[i], 0, 60, 100);
+        }
+        else
+        {
+            fluid_event_control_change(evts[i], 0, 1, i);
+        }
+
+        if(!batch)
+        {
+            TEST_SUCCESS(fluid_sequencer_send_at(seq, evts[i], times[i], 0));
+        }
+    }
+
+    if(batch)
+    {
+        TEST_SUCCESS(fluid_sequencer_send_batch(seq, evts, times, BATCH_SIZE, 0));
+    }
+
+    fluid_sequencer_process(seq, fluid_sequencer_get_tick(seq) + 100);
+}
+
+int main(void)
+{
+    fluid_event_t *evts[BATCH_SIZE];
+    unsigned int times[BATCH_SIZE];
+    int i, seqid;
+    fluid_sequencer_t *seq = new_fluid_sequencer2(0 /*i.e. use sample timer*/);
+    TEST_ASSERT(seq != NULL);
+
+    seqid = fluid_sequencer_register_client(seq, "batch test", callback_record, NULL);
+    TEST_SUCCESS(seqid);
+
+    for(i = 0; i < BATCH_SIZE; i++)
+    {
+        evts[i] = new_fluid_event();
+        TEST_ASSERT(evts[i] != NULL);
+        fluid_event_set_source(evts[i], -1);
+        fluid_event_set_dest(evts[i], seqid);
+        times[i] = (BATCH_SIZE - i) % 37;
+    }
+
+    TEST_ASSERT(fluid_sequencer_send_batch(seq, evts, NULL, BATCH_SIZE, 0) == FLUID_FAILED);
+    TEST_ASSERT(fluid_sequencer_send_batch(seq, evts, times, -1, 0) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_sequencer_send_batch(seq, NULL, NULL, 0, 0));
+
+    record(seq, evts, times, FALSE);
+    record(seq, evts, times, TRUE);
+    TEST_ASSERT(count == 2 * BATCH_SIZE);
+
+    // same order, 100 ticks later
+    for(i = 0; i < BATCH_SIZE; i++)
+    {
+        TEST_ASSERT(dispatched[i] + (100 << 16) == dispatched[BATCH_SIZE + i]);
+    }
+
+    fluid_sequencer_unregister_client(seq, seqid);
+
+    for(i = 0; i < BATCH_SIZE; i++)
+    {
+        delete_fluid_event(evts[i]);
+    }
+
+    delete_fluid_sequencer(seq);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "fluid_event.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that events sent by several threads while the sequencer is being processed
+// are all dispatched, and that the events of each thread are dispatched in the order they have been sent
+
+#define THREAD_COUNT 8
+#define EVENT_COUNT 20000
+
+static fluid_sequencer_t *seq;
+static int seqid;
+static int next_value[THREAD_COUNT];
+static int sending;
+
+void callback_count(unsigned int time, fluid_event_t *event, fluid_sequencer_t *s, void *data)
+{
+    int source;
+
+    if(fluid_event_get_type(event) == FLUID_SEQ_UNREGISTERING)
+    {
+        return;
+    }
+
+    source = fluid_event_get_source(event);
+    TEST_ASSERT(source >= 0 && source < THREAD_COUNT);
+    TEST_ASSERT(fluid_event_get_value(event) == next_value[source]);
+    next_value[source]++;
+}
+
+static fluid_thread_return_t send_events(void *data)
+{
+    int i, source = FLUID_POINTER_TO_INT(data);
+    fluid_event_t *evt = new_fluid_event();
+
+    TEST_ASSERT(evt != NULL);
+    fluid_event_set_source(evt, source);
+    fluid_event_set_dest(evt, seqid);
+
+    for(i = 0; i < EVENT_COUNT; i++)
+    {
+        fluid_event_control_change(evt, 0, 1, i);
+        TEST_SUCCESS(fluid_sequencer_send_at(seq, evt, i / 10, 1));
+    }
+
+    delete_fluid_event(evt);
+    fluid_atomic_int_add(&sending, -1);
+    return FLUID_THREAD_RETURN_VALUE;
+}
+
+int main(void)
+{
+    fluid_thread_t *threads[THREAD_COUNT];
+    unsigned int msec = 0;
+    int i;
+
+    seq = new_fluid_sequencer2(0 /*i.e. use sample timer*/);
+    TEST_ASSERT(seq != NULL);
+
+    seqid = fluid_sequencer_register_client(seq, "send threads test", callback_count, NULL);
+    TEST_SUCCESS(seqid);
+
+    sending = THREAD_COUNT;
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        threads[i] = new_fluid_thread("send", send_events, FLUID_INT_TO_POINTER(i), 0, FALSE);
+        TEST_ASSERT(threads[i] != NULL);
+    }
+
+    // dispatch the events while they are being sent
+    while(fluid_atomic_int_get(&sending) > 0)
+    {
+        fluid_sequencer_process(seq, msec++);
+    }
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        fluid_thread_join(threads[i]);
+        delete_fluid_thread(threads[i]);
+    }
+
+    fluid_sequencer_process(seq, msec + EVENT_COUNT);
+
+    for(i = 0; i < THREAD_COUNT; i++)
+    {
+        TEST_ASSERT(next_value[i] == EVENT_COUNT);
+    }
+
+    fluid_sequencer_unregister_client(seq, seqid);
+    delete_fluid_sequencer(seq);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,53 @@
+#include "test.h"
+#include "fluidsynth.h" // use local fluidsynth header
+#include "midi/fluid_seqbind_notes.h"
+
+// this test makes sure that the note container of the synth's sequencer client keeps track of
+// every note on every channel, and ignores notes the synth cannot play
+
+#define CHANNELS 32
+
+int main(void)
+{
+    int chan, key;
+    void *cont = new_fluid_note_container(CHANNELS);
+    TEST_ASSERT(cont != NULL);
+
+    for(chan = 0; chan < CHANNELS; chan++)
+    {
+        for(key = 0; key < 128; key += 7)
+        {
+            TEST_ASSERT(fluid_note_container_insert(cont, fluid_note_compute_id(chan, key)) == 0);
+        }
+    }
+
+    for(chan = 0; chan < CHANNELS; chan++)
+    {
+        for(key = 0; key < 128; key++)
+        {
+            // the notes inserted above are playing, the others are inserted now
+            TEST_ASSERT(fluid_note_container_insert(cont, fluid_note_compute_id(chan, key)) == (key % 7 == 0));
+        }
+    }
+
+    fluid_note_container_remove(cont, fluid_note_compute_id(3, 60));
+    TEST_ASSERT(fluid_note_container_insert(cont, fluid_note_compute_id(3, 60)) == 0);
+    TEST_ASSERT(fluid_note_container_insert(cont, fluid_note_compute_id(3, 60)) == 1);
+
+    // out of range IDs are never playing
+    TEST_ASSERT(fluid_note_container_insert(cont, fluid_note_compute_id(CHANNELS, 0)) == 0);
+    TEST_ASSERT(fluid_note_container_insert(cont, fluid_note_compute_id(CHANNELS, 0)) == 0);
+    TEST_ASSERT(fluid_note_container_insert(cont, -1) == 0);
+    fluid_note_container_remove(cont, fluid_note_compute_id(CHANNELS, 0));
+
+    fluid_note_container_clear(cont);
+
+    for(key = 0; key < 128; key++)
+    {
+        TEST_ASSERT(fluid_note_container_insert(cont, fluid_note_compute_id(CHANNELS - 1, key)) == 0);
+    }
+
+    delete_fluid_note_container(cont);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that MIDI events sent to the event port of the shell server are applied,
+// also when a frame arrives in pieces, and that the connection is closed on an invalid frame
+
+#define SHELL_PORT 9873
+#define EVENT_PORT 9874
+#define FRAMES 64
+
+static fluid_socket_t connect_event_port(void)
+{
+#ifdef IPV6_SUPPORT
+    struct sockaddr_in6 addr;
+    fluid_socket_t sock = socket(AF_INET6, SOCK_STREAM, 0);
+
+    FLUID_MEMSET(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(EVENT_PORT);
+    addr.sin6_addr = in6addr_loopback;
+#else
+    struct sockaddr_in addr;
+    fluid_socket_t sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    FLUID_MEMSET(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(EVENT_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+#endif
+
+    TEST_ASSERT(connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    return sock;
+}
+
+static void put_event(unsigned char *buf, unsigned int offset, int status, int data1, int data2, int port)
+{
+    buf[0] = offset >> 24;
+    buf[1] = (offset >> 16) & 0xFF;
+    buf[2] = (offset >> 8) & 0xFF;
+    buf[3] = offset & 0xFF;
+    buf[4] = status;
+    buf[5] = data1;
+    buf[6] = data2;
+    buf[7] = port;
+}
+
+/* renders until the pitch bend of the channel has the value, or fails after a while */
+static void wait_for_pitch_bend(fluid_synth_t *synth, int chan, int value)
+{
+    static float left[FRAMES], right[FRAMES];
+    int i, bend = -1;
+
+    for(i = 0; i < 5000 && bend != value; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+        TEST_SUCCESS(fluid_synth_get_pitch_bend(synth, chan, &bend));
+        fluid_msleep(1);
+    }
+
+    TEST_ASSERT(bend == value);
+}
+
+int main(void)
+{
+    unsigned char frame[2 + 4 * 8];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_server_t *server;
+    fluid_socket_t sock;
+    char c;
+    int value;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.midi-channels", 32));
+    TEST_SUCCESS(fluid_settings_setint(settings, "shell.port", SHELL_PORT));
+    TEST_SUCCESS(fluid_settings_setint(settings, "shell.event-port", EVENT_PORT));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    server = new_fluid_server(settings, synth, NULL);
+    TEST_ASSERT(server != NULL);
+
+    sock = connect_event_port();
+
+    /* a volume change, an unsupported clock event, a note and a pitch bend on port 1 */
+    frame[0] = 0;
+    frame[1] = 4;
+    put_event(&frame[2], 0, 0xB3, 7, 33, 0);
+    put_event(&frame[10], 0, 0xF8, 0, 0, 0);
+    put_event(&frame[18], 128, 0x93, 60, 100, 0);
+    put_event(&frame[26], 640, 0xE2, 0x34, 0x24, 1);
+
+    /* in two pieces, split inside an event */
+    TEST_ASSERT(send(sock, (const char *)frame, 13, 0) == 13);
+    fluid_msleep(10);
+    TEST_ASSERT(send(sock, (const char *)&frame[13], sizeof(frame) - 13, 0) == sizeof(frame) - 13);
+
+    wait_for_pitch_bend(synth, 18, (0x24 << 7) | 0x34);
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 3, 7, &value));
+    TEST_ASSERT(value == 33);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+
+    /* more events than a frame may hold, the server hangs up */
+    frame[0] = 0xFF;
+    frame[1] = 0xFF;
+    TEST_ASSERT(send(sock, (const char *)frame, 2, 0) == 2);
+    TEST_ASSERT(recv(sock, &c, 1, 0) <= 0);
+    fluid_socket_close(sock);
+
+    /* other clients are still served */
+    sock = connect_event_port();
+    frame[0] = 0;
+    frame[1] = 1;
+    put_event(&frame[2], 0, 0xE2, 0, 0x40, 1);
+    TEST_ASSERT(send(sock, (const char *)frame, 10, 0) == 10);
+    wait_for_pitch_bend(synth, 18, 8192);
+    fluid_socket_close(sock);
+
+    delete_fluid_server(server);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the metrics port of the shell server answers requests for
+// /metrics with the counters of the synth, in the text format of Prometheus
+
+#define SHELL_PORT 9876
+#define METRICS_PORT 9877
+#define FRAMES 64
+#define POLYPHONY 8
+
+static fluid_socket_t connect_metrics_port(void)
+{
+#ifdef IPV6_SUPPORT
+    struct sockaddr_in6 addr;
+    fluid_socket_t sock = socket(AF_INET6, SOCK_STREAM, 0);
+
+    FLUID_MEMSET(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(METRICS_PORT);
+    addr.sin6_addr = in6addr_loopback;
+#else
+    struct sockaddr_in addr;
+    fluid_socket_t sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    FLUID_MEMSET(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(METRICS_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+#endif
+
+    TEST_ASSERT(connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    return sock;
+}
+
+/* sends a request and receives the response until the server hangs up */
+static void request(const char *req, char *response, int size)
+{
+    fluid_socket_t sock = connect_metrics_port();
+    int n, len = 0;
+
+    /* the header in two pieces */
+    TEST_ASSERT(send(sock, req, 5, 0) == 5);
+    fluid_msleep(10);
+    TEST_ASSERT(send(sock, req + 5, (int)FLUID_STRLEN(req) - 5, 0) == (int)FLUID_STRLEN(req) - 5);
+
+    while((n = recv(sock, response + len, size - 1 - len, 0)) > 0)
+    {
+        len += n;
+    }
+
+    response[len] = '\0';
+    fluid_socket_close(sock);
+}
+
+/* returns the value of a sample of the response, or fails if it is missing */
+static double get_value(const char *response, const char *sample)
+{
+    char line[128];
+    const char *pos;
+
+    FLUID_SNPRINTF(line, sizeof(line), "\n%s ", sample);
+    pos = strstr(response, line);
+    TEST_ASSERT(pos != NULL);
+
+    return atof(pos + FLUID_STRLEN(line));
+}
+
+int main(void)
+{
+    static char response[16384];
+    static float left[FRAMES], right[FRAMES];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_server_t *server;
+    const char *body;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "shell.port", SHELL_PORT));
+    TEST_SUCCESS(fluid_settings_setint(settings, "shell.metrics-port", METRICS_PORT));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.perf-stats", 1));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    server = new_fluid_server(settings, synth, NULL);
+    TEST_ASSERT(server != NULL);
+
+    /* more notes than the polyphony, one per block so that the older ones can be stolen */
+    for(i = 0; i < 2 * POLYPHONY; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 40 + i, 100));
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+    }
+
+    request("GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n", response, sizeof(response));
+
+    TEST_ASSERT(FLUID_STRNCMP(response, "HTTP/1.0 200 OK\r\n", 17) == 0);
+    TEST_ASSERT(strstr(response, "Content-Type: text/plain; version=0.0.4") != NULL);
+    body = strstr(response, "\r\n\r\n");
+    TEST_ASSERT(body != NULL);
+    TEST_ASSERT(atoi(strstr(response, "Content-Length: ") + 16) == (int)FLUID_STRLEN(body + 4));
+
+    TEST_ASSERT(strstr(body, "\n# TYPE fluidsynth_render_seconds summary\n") != NULL);
+    TEST_ASSERT(get_value(body, "fluidsynth_render_seconds_count{stage=\"render\"}") == 2 * POLYPHONY);
+    TEST_ASSERT(get_value(body, "fluidsynth_render_max_seconds{stage=\"render\"}") > 0);
+    TEST_ASSERT(get_value(body, "fluidsynth_note_latency_seconds_count") == 0);
+    TEST_ASSERT(get_value(body, "fluidsynth_active_voices") > 0);
+    TEST_ASSERT(get_value(body, "fluidsynth_voices_stolen_total") >= POLYPHONY);
+    TEST_ASSERT(get_value(body, "fluidsynth_event_queue_peak") > 0);
+    TEST_ASSERT(get_value(body, "fluidsynth_sample_memory_bytes") > 0);
+
+    /* no audio driver was given */
+    TEST_ASSERT(strstr(body, "fluidsynth_audio_xruns_total") == NULL);
+
+    /* other paths don't exist */
+    request("GET /other HTTP/1.1\r\n\r\n", response, sizeof(response));
+    TEST_ASSERT(FLUID_STRNCMP(response, "HTTP/1.0 404 Not Found\r\n", 24) == 0);
+
+    delete_fluid_server(server);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
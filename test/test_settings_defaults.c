@@ -0,0 +1,115 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_settings.h"
+
+// this test makes sure that settings objects sharing the default settings don't see each
+// other's changes, and enumerate and change the same settings as if they had their own
+
+static int count;
+
+static void count_func(void *data, const char *name, int type)
+{
+    count++;
+}
+
+static int count_settings(fluid_settings_t *settings)
+{
+    count = 0;
+    fluid_settings_foreach(settings, NULL, count_func);
+    return count;
+}
+
+static int num_fills;
+
+static void fill_options(fluid_settings_t *settings, const char *name)
+{
+    num_fills++;
+    TEST_SUCCESS(fluid_settings_add_option(settings, name, "lazy"));
+}
+
+static int num_updates;
+
+static void update_func(void *data, const char *name, int value)
+{
+    num_updates++;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings1, *settings2;
+    char buf[64];
+    double num;
+    int i, total;
+
+    settings1 = new_fluid_settings();
+    settings2 = new_fluid_settings();
+    TEST_ASSERT(settings1 != NULL && settings2 != NULL);
+
+    // changes stay within a settings object
+    TEST_SUCCESS(fluid_settings_setint(settings1, "synth.polyphony", 77));
+    TEST_SUCCESS(fluid_settings_setnum(settings1, "synth.gain", 0.5));
+    TEST_SUCCESS(fluid_settings_setstr(settings1, "audio.sample-format", "float"));
+    TEST_SUCCESS(fluid_settings_add_option(settings1, "audio.sample-format", "test"));
+
+    TEST_SUCCESS(fluid_settings_getint(settings1, "synth.polyphony", &i));
+    TEST_ASSERT(i == 77);
+    TEST_SUCCESS(fluid_settings_getint(settings2, "synth.polyphony", &i));
+    TEST_ASSERT(i == 256);
+    TEST_SUCCESS(fluid_settings_getnum(settings2, "synth.gain", &num));
+    TEST_ASSERT(num == 0.2);
+    TEST_SUCCESS(fluid_settings_copystr(settings2, "audio.sample-format", buf, sizeof(buf)));
+    TEST_ASSERT(FLUID_STRCMP(buf, "16bits") == 0);
+    TEST_ASSERT(fluid_settings_option_count(settings1, "audio.sample-format") == 5);
+    TEST_ASSERT(fluid_settings_option_count(settings2, "audio.sample-format") == 4);
+
+    // so do settings registered later and update callbacks
+    TEST_SUCCESS(fluid_settings_register_int(settings1, "test.setting", 1, 0, 2, 0));
+    TEST_ASSERT(fluid_settings_get_type(settings1, "test.setting") == FLUID_INT_TYPE);
+    TEST_ASSERT(fluid_settings_get_type(settings2, "test.setting") == FLUID_NO_TYPE);
+    TEST_SUCCESS(fluid_settings_callback_int(settings2, "synth.polyphony", update_func, NULL));
+    TEST_SUCCESS(fluid_settings_setint(settings1, "synth.polyphony", 78));
+    TEST_ASSERT(num_updates == 0);
+    TEST_SUCCESS(fluid_settings_setint(settings2, "synth.polyphony", 78));
+    TEST_ASSERT(num_updates == 1);
+
+    // all settings are enumerated, whether they have been changed or not
+    total = count_settings(settings2);
+    TEST_ASSERT(total > 100);
+    TEST_ASSERT(count_settings(settings1) == total + 1);
+    TEST_ASSERT(count_settings(settings2) == total);
+
+    // and keep their values once enumerated
+    TEST_SUCCESS(fluid_settings_getint(settings1, "synth.polyphony", &i));
+    TEST_ASSERT(i == 78);
+    TEST_SUCCESS(fluid_settings_getnum(settings1, "synth.gain", &num));
+    TEST_ASSERT(num == 0.5);
+    TEST_SUCCESS(fluid_settings_getint(settings1, "synth.midi-channels", &i));
+    TEST_ASSERT(i == 16);
+    TEST_SUCCESS(fluid_settings_setint(settings2, "synth.polyphony", 79));
+    TEST_ASSERT(num_updates == 2);
+
+    // options left to a function are added once they are asked for, once per settings object
+    TEST_SUCCESS(fluid_settings_register_str(settings1, "test.device", "default", 0));
+    TEST_SUCCESS(fluid_settings_add_option(settings1, "test.device", "default"));
+    TEST_SUCCESS(fluid_settings_lazy_options(settings1, "test.device", fill_options));
+    TEST_ASSERT(fluid_settings_lazy_options(settings1, "synth.polyphony", fill_options) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_settings_get_hints(settings1, "test.device", &i));
+    TEST_ASSERT(i & FLUID_HINT_OPTIONLIST);
+    TEST_ASSERT(num_fills == 0);
+    TEST_ASSERT(fluid_settings_option_count(settings1, "test.device") == 2);
+    TEST_ASSERT(fluid_settings_option_count(settings1, "test.device") == 2);
+    TEST_ASSERT(num_fills == 1);
+
+    delete_fluid_settings(settings1);
+    delete_fluid_settings(settings2);
+
+    // the default settings are registered again for the audio drivers registered
+    TEST_SUCCESS(fluid_audio_driver_register(NULL));
+    settings1 = new_fluid_settings();
+    TEST_ASSERT(settings1 != NULL);
+    TEST_ASSERT(count_settings(settings1) == total);
+    delete_fluid_settings(settings1);
+
+    return EXIT_SUCCESS;
+}
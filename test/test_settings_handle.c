@@ -0,0 +1,89 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "fluidsynth_priv.h"
+#include "utils/fluid_settings.h"
+
+// this test makes sure that settings read and written by handle are the same as by name,
+// that the update callbacks are called and that values out of range are refused
+
+static int last_int;
+static double last_num;
+static int calls;
+
+static void int_update(void *data, const char *name, int value)
+{
+    TEST_ASSERT(FLUID_STRCMP(name, "synth.polyphony") == 0);
+    TEST_ASSERT(data == &last_int);
+    last_int = value;
+    calls++;
+}
+
+static void num_update(void *data, const char *name, double value)
+{
+    TEST_ASSERT(FLUID_STRCMP(name, "synth.gain") == 0);
+    TEST_ASSERT(data == &last_num);
+    last_num = value;
+    calls++;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_settings_handle_t *poly, *gain;
+    double num;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+
+    /* only numeric and integer settings can be resolved */
+    TEST_ASSERT(new_fluid_settings_handle(settings, "synth.no-such-setting") == NULL);
+    TEST_ASSERT(new_fluid_settings_handle(settings, "synth") == NULL);
+    TEST_ASSERT(new_fluid_settings_handle(settings, "audio.driver") == NULL);
+
+    poly = new_fluid_settings_handle(settings, "synth.polyphony");
+    gain = new_fluid_settings_handle(settings, "synth.gain");
+    TEST_ASSERT(poly != NULL && gain != NULL);
+    TEST_ASSERT(fluid_settings_handle_get_type(poly) == FLUID_INT_TYPE);
+    TEST_ASSERT(fluid_settings_handle_get_type(gain) == FLUID_NUM_TYPE);
+
+    /* types don't mix */
+    TEST_ASSERT(fluid_settings_handle_getnum(poly, &num) == FLUID_FAILED);
+    TEST_ASSERT(fluid_settings_handle_setint(gain, 1) == FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_settings_handle_getint(poly, &i));
+    TEST_ASSERT(i == 256);
+
+    TEST_SUCCESS(fluid_settings_callback_int(settings, "synth.polyphony", int_update, &last_int));
+    TEST_SUCCESS(fluid_settings_callback_num(settings, "synth.gain", num_update, &last_num));
+
+    /* written by handle, read by name and the other way around */
+    TEST_SUCCESS(fluid_settings_handle_setint(poly, 100));
+    TEST_SUCCESS(fluid_settings_getint(settings, "synth.polyphony", &i));
+    TEST_ASSERT(i == 100 && last_int == 100 && calls == 1);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 50));
+    TEST_SUCCESS(fluid_settings_handle_getint(poly, &i));
+    TEST_ASSERT(i == 50 && last_int == 50 && calls == 2);
+
+    TEST_SUCCESS(fluid_settings_handle_setnum(gain, 0.5));
+    TEST_SUCCESS(fluid_settings_getnum(settings, "synth.gain", &num));
+    TEST_ASSERT(num == 0.5 && last_num == 0.5 && calls == 3);
+
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.gain", 1.5));
+    TEST_SUCCESS(fluid_settings_handle_getnum(gain, &num));
+    TEST_ASSERT(num == 1.5 && calls == 4);
+
+    /* out of range, nothing changes */
+    TEST_ASSERT(fluid_settings_handle_setint(poly, 0) == FLUID_FAILED);
+    TEST_ASSERT(fluid_settings_handle_setnum(gain, 1000.0) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_settings_handle_getint(poly, &i));
+    TEST_SUCCESS(fluid_settings_handle_getnum(gain, &num));
+    TEST_ASSERT(i == 50 && num == 1.5 && calls == 4);
+
+    delete_fluid_settings_handle(poly);
+    delete_fluid_settings_handle(gain);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
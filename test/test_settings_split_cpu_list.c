@@ -0,0 +1,42 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_settings.h"
+
+// this test checks the parsing of CPU lists used by the cpu-affinity settings
+
+int main(void)
+{
+    int cpus[8];
+    fluid_settings_t *settings;
+
+    TEST_ASSERT(fluid_settings_split_cpu_list("3", cpus, 8) == 1);
+    TEST_ASSERT(cpus[0] == 3);
+
+    TEST_ASSERT(fluid_settings_split_cpu_list("0-2,7", cpus, 8) == 4);
+    TEST_ASSERT(cpus[0] == 0 && cpus[1] == 1 && cpus[2] == 2 && cpus[3] == 7);
+
+    // the buffer length limits the result
+    TEST_ASSERT(fluid_settings_split_cpu_list("0-15", cpus, 8) == 8);
+    TEST_ASSERT(cpus[7] == 7);
+
+    TEST_ASSERT(fluid_settings_split_cpu_list("", cpus, 8) == 0);
+    TEST_ASSERT(fluid_settings_split_cpu_list("a", cpus, 8) == -1);
+    TEST_ASSERT(fluid_settings_split_cpu_list("1-", cpus, 8) == -1);
+    TEST_ASSERT(fluid_settings_split_cpu_list("4-2", cpus, 8) == -1);
+    TEST_ASSERT(fluid_settings_split_cpu_list("-1", cpus, 8) == -1);
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+
+    // empty and malformed settings leave the threads unpinned
+    TEST_ASSERT(fluid_settings_get_cpu_list(settings, "synth.cpu-affinity", cpus, 8) == 0);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.cpu-affinity", "1,x"));
+    TEST_ASSERT(fluid_settings_get_cpu_list(settings, "synth.cpu-affinity", cpus, 8) == 0);
+    TEST_SUCCESS(fluid_settings_setstr(settings, "audio.cpu-affinity", "2-3"));
+    TEST_ASSERT(fluid_settings_get_cpu_list(settings, "audio.cpu-affinity", cpus, 8) == 2);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,41 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "sfloader/fluid_sfont.h"
+#include "sfloader/fluid_sffile.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_list.h"
+
+// this test makes sure that the HYDRA chunk of a SoundFont is read with a single
+// call of the file callbacks, and parsed completely from memory
+
+static int read_count;
+
+static int counting_fread(void *buf, fluid_long_long_t count, void *handle)
+{
+    read_count++;
+    return safe_fread(buf, count, handle);
+}
+
+int main(void)
+{
+    static const fluid_file_callbacks_t fcbs = { default_fopen, counting_fread, safe_fseek, default_fclose, default_ftell };
+    SFData *sf;
+    int before;
+
+    sf = fluid_sffile_open(TEST_SOUNDFONT, &fcbs);
+    TEST_ASSERT(sf != NULL);
+    TEST_ASSERT(sf->hydra == NULL);
+
+    before = read_count;
+    TEST_SUCCESS(fluid_sffile_parse_presets(sf));
+    TEST_ASSERT(read_count - before == 1);
+    TEST_ASSERT(sf->hydra == NULL);
+
+    TEST_ASSERT(fluid_list_size(sf->preset) > 0);
+    TEST_ASSERT(fluid_list_size(sf->inst) > 0);
+    TEST_ASSERT(fluid_list_size(sf->sample) > 0);
+
+    fluid_sffile_close(sf);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#include "test.h"
+#include "fluidsynth.h"
+
+// this test makes sure that the memory of a SoundFont is accounted, with the sample data
+// shared by synths loading the same file counted as shared and held once by the cache
+
+static fluid_synth_t *load(fluid_settings_t *settings, int *id)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    *id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(*id != FLUID_FAILED);
+
+    return synth;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth1, *synth2;
+    fluid_sfont_memory_t usage1, usage2;
+    fluid_sample_cache_memory_t cache1, cache2;
+    int id1, id2;
+
+    TEST_ASSERT(settings != NULL);
+
+    synth1 = load(settings, &id1);
+    TEST_SUCCESS(fluid_synth_get_sfont_memory_usage(synth1, id1, &usage1));
+    TEST_ASSERT(usage1.samples > 0);
+    TEST_ASSERT(usage1.metadata > 0);
+    TEST_ASSERT(usage1.samples_shared == 0);
+    TEST_ASSERT(usage1.total == usage1.samples + usage1.samples_mapped + usage1.metadata);
+
+    TEST_SUCCESS(fluid_sample_get_cache_memory(&cache1));
+    TEST_ASSERT(cache1.entries > 0);
+    TEST_ASSERT(cache1.in_memory + cache1.mapped >= usage1.samples + usage1.samples_mapped);
+    TEST_ASSERT(cache1.shared == 0);
+
+    /* a second synth loading the same file shares the sample data, held once by the cache */
+    synth2 = load(settings, &id2);
+    TEST_SUCCESS(fluid_synth_get_sfont_memory_usage(synth2, id2, &usage2));
+    TEST_ASSERT(usage2.samples == usage1.samples);
+    TEST_ASSERT(usage2.samples_shared == usage2.samples + usage2.samples_mapped);
+
+    TEST_SUCCESS(fluid_synth_get_sfont_memory_usage(synth1, id1, &usage1));
+    TEST_ASSERT(usage1.samples_shared == usage2.samples_shared);
+
+    TEST_SUCCESS(fluid_sample_get_cache_memory(&cache2));
+    TEST_ASSERT(cache2.entries == cache1.entries);
+    TEST_ASSERT(cache2.in_memory == cache1.in_memory);
+    TEST_ASSERT(cache2.shared == cache2.in_memory + cache2.mapped);
+
+    delete_fluid_synth(synth2);
+    TEST_SUCCESS(fluid_synth_get_sfont_memory_usage(synth1, id1, &usage1));
+    TEST_ASSERT(usage1.samples_shared == 0);
+
+    /* no such SoundFont */
+    TEST_ASSERT(fluid_synth_get_sfont_memory_usage(synth1, id1 + 1, &usage1) == FLUID_FAILED);
+
+    delete_fluid_synth(synth1);
+
+    TEST_SUCCESS(fluid_sample_get_cache_memory(&cache1));
+    TEST_ASSERT(cache1.entries == 0);
+    TEST_ASSERT(cache1.in_memory == 0);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
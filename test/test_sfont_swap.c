@@ -0,0 +1,81 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that swapping a SoundFont keeps its ID and place on the stack,
+// hands the new SoundFont to the channels while the voices playing go on with the old
+// one, and leaves the old SoundFont in place when the new one fails to load
+
+#define FRAMES 64
+
+static void render(fluid_synth_t *synth, int blocks)
+{
+    static float buf[2 * FRAMES];
+
+    while(blocks--)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    }
+}
+
+int main(void)
+{
+    int id, id2, voices;
+    fluid_sfont_t *sfont, *swapped;
+    fluid_preset_t *preset;
+
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    TEST_SUCCESS(id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1));
+    TEST_SUCCESS(id2 = fluid_synth_sfload(synth, TEST_SOUNDFONT, 0));
+    TEST_ASSERT((sfont = fluid_synth_get_sfont_by_id(synth, id)) != NULL);
+    TEST_ASSERT(fluid_synth_get_sfont(synth, 1) == sfont);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    render(synth, 1);
+    voices = fluid_synth_get_active_voice_count(synth);
+    TEST_ASSERT(voices > 0);
+
+    // reload the file of the SoundFont
+    TEST_ASSERT(fluid_synth_sfswap(synth, id, NULL) == id);
+    TEST_ASSERT(fluid_synth_sfcount(synth) == 2);
+    TEST_ASSERT((swapped = fluid_synth_get_sfont_by_id(synth, id)) != NULL);
+    TEST_ASSERT(swapped != sfont);
+    TEST_ASSERT(fluid_synth_get_sfont(synth, 1) == swapped);
+    TEST_ASSERT(fluid_sfont_get_id(swapped) == id);
+    TEST_ASSERT(FLUID_STRCMP(TEST_SOUNDFONT, fluid_sfont_get_name(swapped)) == 0);
+
+    // the channels use the new SoundFont, the note goes on
+    TEST_ASSERT((preset = fluid_synth_get_channel_preset(synth, 0)) != NULL);
+    TEST_ASSERT(fluid_preset_get_sfont(preset) == swapped);
+    render(synth, 1);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == voices);
+
+    // new notes play from the new SoundFont
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 64, 100));
+    render(synth, 100);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+    fluid_synth_all_sounds_off(synth, -1);
+    render(synth, 1);
+
+    // a file given explicitly
+    TEST_ASSERT(fluid_synth_sfswap(synth, id2, TEST_SOUNDFONT) == id2);
+    TEST_ASSERT(fluid_synth_get_sfont(synth, 0) == fluid_synth_get_sfont_by_id(synth, id2));
+
+    // failures keep the old SoundFont
+    TEST_ASSERT(fluid_synth_sfswap(synth, id, "does_not_exist.sf2") == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_sfont_by_id(synth, id) == swapped);
+    TEST_ASSERT(fluid_synth_sfswap(synth, id2 + 1, NULL) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_sfcount(synth) == 2);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -66,21 +66,29 @@ static const fluid_file_callbacks_t fcb =
     NULL, &test_reader, &test_seek, NULL, NULL
 };
 
+// the zones and generators are allocated from this arena, like fluid_sffile_open() does
+static fluid_arena_t *test_arena = NULL;
+
 static SFZone* new_test_zone(fluid_list_t** parent_list, int gen_count)
 {
     int i;
-    SFZone *zone = FLUID_NEW(SFZone);
+    fluid_list_t **last;
+    SFZone *zone = FLUID_ARENA_NEW(test_arena, SFZone);
     TEST_ASSERT(zone != NULL);
-    FLUID_MEMSET(zone, 0, sizeof(*zone));
     
     for (i = 0; i < gen_count; i++)
     {
-        zone->gen = fluid_list_prepend(zone->gen, NULL);
+        zone->gen = fluid_arena_list_prepend(test_arena, zone->gen, NULL);
     }
     
     if(parent_list != NULL)
     {
-        *parent_list = fluid_list_append(*parent_list, zone);
+        // like the loader, allocate the list nodes from the arena of the SFData
+        for (last = parent_list; *last != NULL; last = &(*last)->next)
+        {
+        }
+        *last = fluid_arena_list_prepend(test_arena, NULL, zone);
+        TEST_ASSERT(*last != NULL);
     }
     
     return zone;
@@ -169,7 +177,7 @@ static void bad_test_too_short_gen_buffer(int (*load_func)(SFData *sf, int size)
         TEST_ASSERT(load_func(sf, 8) == FALSE);
         gen = fluid_list_get(fluid_list_nth(zone->gen, 0));
         TEST_ASSERT(gen != NULL);
-        FLUID_FREE(gen);
+        // drop this generator, it is freed with the arena
         zone->gen->data = NULL;
         gen = fluid_list_get(fluid_list_nth(zone->gen, 1));
         TEST_ASSERT(gen == NULL);
@@ -411,8 +419,7 @@ static void bad_test_additional_gens_after_final_gen(int (*load_func)(SFData *sf
         TEST_ASSERT(gen->amount.range.lo == 60);
         TEST_ASSERT(gen->amount.range.hi == 127);
 
-        // delete this generator
-        FLUID_FREE(gen);
+        // drop this generator, it is freed with the arena
         zone1->gen->data = NULL;
 
         gen = fluid_list_get(fluid_list_nth(zone1->gen, 1));
@@ -426,8 +433,7 @@ static void bad_test_additional_gens_after_final_gen(int (*load_func)(SFData *sf
             TEST_ASSERT(gen->id == GEN_INSTRUMENT);
         }
         TEST_ASSERT(gen->amount.uword == 0xDDDDu);
-        // delete this generator
-        FLUID_FREE(gen);
+        // drop this generator, it is freed with the arena
         zone1->gen->data = NULL;
 
         gen = fluid_list_get(fluid_list_nth(zone1->gen, 2));
@@ -443,13 +449,12 @@ static void bad_test_additional_gens_after_final_gen(int (*load_func)(SFData *sf
         UNSET_BUF;
 
         // The test cases above expect zone1 to be pre-populated with 5 generators
-        delete_fluid_list(zone1->gen);
         zone1->gen = NULL;
-        zone1->gen = fluid_list_prepend(zone1->gen, NULL);
-        zone1->gen = fluid_list_prepend(zone1->gen, NULL);
-        zone1->gen = fluid_list_prepend(zone1->gen, NULL);
-        zone1->gen = fluid_list_prepend(zone1->gen, NULL);
-        zone1->gen = fluid_list_prepend(zone1->gen, NULL);
+        zone1->gen = fluid_arena_list_prepend(test_arena, zone1->gen, NULL);
+        zone1->gen = fluid_arena_list_prepend(test_arena, zone1->gen, NULL);
+        zone1->gen = fluid_arena_list_prepend(test_arena, zone1->gen, NULL);
+        zone1->gen = fluid_arena_list_prepend(test_arena, zone1->gen, NULL);
+        zone1->gen = fluid_arena_list_prepend(test_arena, zone1->gen, NULL);
     }
 }
 
@@ -459,15 +464,17 @@ int main(void)
 
     SFZone *zone1, *zone2;
     SFData *sf = FLUID_NEW(SFData);
-    SFPreset *preset = FLUID_NEW(SFPreset);
-    SFInst *inst = FLUID_NEW(SFInst);
+    SFPreset *preset;
+    SFInst *inst;
 
     TEST_ASSERT(sf != NULL);
     FLUID_MEMSET(sf, 0, sizeof(*sf));
+    test_arena = sf->arena = new_fluid_arena(FLUID_SFFILE_ARENA_BLOCK_SIZE);
+    TEST_ASSERT(sf->arena != NULL);
+    preset = FLUID_ARENA_NEW(sf->arena, SFPreset);
     TEST_ASSERT(preset != NULL);
-    FLUID_MEMSET(preset, 0, sizeof(*preset));
+    inst = FLUID_ARENA_NEW(sf->arena, SFInst);
     TEST_ASSERT(inst != NULL);
-    FLUID_MEMSET(inst, 0, sizeof(*inst));
 
     sf->fcbs = &fcb;
     sf->preset = fluid_list_append(sf->preset, preset);
@@ -479,14 +486,10 @@ int main(void)
     {                                                    \
         zone1 = new_test_zone(&preset->zone, GEN_COUNT); \
         TEST_FUNC(&load_pgen, sf, zone1);                \
-        delete_zone(zone1);                              \
-        delete_fluid_list(preset->zone);                 \
         preset->zone = NULL;                             \
                                                          \
         zone1 = new_test_zone(&inst->zone, GEN_COUNT);   \
         TEST_FUNC(&load_igen, sf, zone1);                \
-        delete_zone(zone1);                              \
-        delete_fluid_list(inst->zone);                   \
         inst->zone = NULL;                               \
     } while (0)
 
@@ -506,9 +509,6 @@ int main(void)
     bad_test_issue_808(&load_pgen, sf, zone1);
     // zone 2 was dropped
     TEST_ASSERT(preset->zone->next == NULL);
-    delete_zone(zone1);
-    // zone2 already deleted
-    delete_fluid_list(preset->zone);
     preset->zone = NULL;
 
     zone1 = new_test_zone(&inst->zone, 2);
@@ -516,9 +516,6 @@ int main(void)
     bad_test_issue_808(&load_igen, sf, zone1);
     // zone 2 was dropped
     TEST_ASSERT(inst->zone->next == NULL);
-    delete_zone(zone1);
-    // zone2 already deleted
-    delete_fluid_list(inst->zone);
     inst->zone = NULL;
 
 
@@ -530,16 +527,13 @@ int main(void)
     
     TEST_ASSERT(inst->zone->data == zone1);
     TEST_ASSERT(inst->zone->next->data == zone2);
-    delete_zone(zone2);
-    delete_zone(zone1);
-    delete_fluid_list(inst->zone);
     inst->zone = NULL;
 
 
-    delete_inst(inst);
-    delete_preset(preset);
     delete_fluid_list(sf->inst);
     delete_fluid_list(sf->preset);
+    // the zones, generators, preset and instrument
+    delete_fluid_arena(sf->arena);
     // we cannot call fluid_sffile_close here, because it would destroy the mutex which is not initialized
     FLUID_FREE(sf);
     return EXIT_SUCCESS;
@@ -0,0 +1,130 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_chan.h"
+
+// this test makes sure that with synth.sparse-channels, a channel is only created when it's
+// first used, in the state it would have had otherwise, and that the memory of the synth grows
+// with the channels used
+
+#define CHANNELS 256
+#define BLOCK 64
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings, int sparse)
+{
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.sparse-channels", sparse));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    return synth;
+}
+
+static int memory_other(fluid_synth_t *synth)
+{
+    fluid_synth_memory_t usage;
+
+    TEST_SUCCESS(fluid_synth_get_memory_usage(synth, &usage));
+    return (int)usage.other;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth, *dense, *restored;
+    float left[BLOCK], right[BLOCK];
+    int i, other, val, basic, mode, size;
+    int sfont_id, bank, prog, dense_sfont_id, dense_bank, dense_prog;
+    void *snapshot;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.midi-channels", CHANNELS));
+
+    dense = create_synth(settings, 0);
+    synth = create_synth(settings, 1);
+
+    /* only basic channel 0 exists */
+    TEST_ASSERT(synth->channel[0] != NULL);
+
+    for(i = 1; i < CHANNELS; i++)
+    {
+        TEST_ASSERT(synth->channel[i] == NULL);
+    }
+
+    other = memory_other(synth);
+    TEST_ASSERT(other + (CHANNELS - 1) * (int)sizeof(fluid_channel_t) == memory_other(dense));
+
+    /* players release and reset all channels without creating them */
+    for(i = 0; i < CHANNELS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_cc(synth, i, SUSTAIN_SWITCH, 0));
+        TEST_SUCCESS(fluid_synth_cc(synth, i, ALL_NOTES_OFF, 0));
+        TEST_SUCCESS(fluid_synth_all_sounds_off(synth, i));
+    }
+
+    TEST_SUCCESS(fluid_synth_system_reset(synth));
+    TEST_ASSERT(memory_other(synth) == other);
+
+    /* the first note creates the channel */
+    TEST_SUCCESS(fluid_synth_noteon(synth, 200, 60, 100));
+    TEST_ASSERT(synth->channel[200] != NULL);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) > 0);
+    TEST_ASSERT(memory_other(synth) == other + (int)sizeof(fluid_channel_t));
+    TEST_SUCCESS(fluid_synth_write_float(synth, BLOCK, left, 0, 1, right, 0, 1));
+
+    /* so do queries, which find the reset state */
+    TEST_SUCCESS(fluid_synth_get_cc(synth, 150, EXPRESSION_MSB, &val));
+    TEST_ASSERT(val == 127);
+    TEST_SUCCESS(fluid_synth_get_pitch_bend(synth, 150, &val));
+    TEST_ASSERT(val == 8192);
+    TEST_SUCCESS(fluid_synth_get_basic_channel(synth, 150, &basic, &mode, &val));
+    TEST_ASSERT(basic == 0 && mode == FLUID_CHANNEL_MODE_OMNION_POLY && val == CHANNELS);
+
+    for(i = 9; i <= 150; i += 141)
+    {
+        TEST_SUCCESS(fluid_synth_get_program(synth, i, &sfont_id, &bank, &prog));
+        TEST_SUCCESS(fluid_synth_get_program(dense, i, &dense_sfont_id, &dense_bank, &dense_prog));
+        TEST_ASSERT(bank == dense_bank && prog == dense_prog);
+        TEST_ASSERT(fluid_preset_get_num(fluid_synth_get_channel_preset(synth, i))
+                    == fluid_preset_get_num(fluid_synth_get_channel_preset(dense, i)));
+    }
+
+    /* the interpolation set for all channels applies to the channels created later */
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, -1, FLUID_INTERP_NONE));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 100, 60, 100));
+    TEST_ASSERT(fluid_channel_get_interp_method(synth->channel[100]) == FLUID_INTERP_NONE);
+
+    /* a snapshot only creates the channels that exist */
+    TEST_SUCCESS(fluid_synth_cc(synth, 200, VOLUME_MSB, 42));
+    size = fluid_synth_snapshot(synth, NULL, 0);
+    TEST_ASSERT(size > 0);
+    snapshot = malloc(size);
+    TEST_ASSERT(snapshot != NULL);
+    TEST_ASSERT(fluid_synth_snapshot(synth, snapshot, size) == size);
+
+    restored = create_synth(settings, 1);
+    TEST_SUCCESS(fluid_synth_noteon(restored, 50, 60, 100));
+    TEST_SUCCESS(fluid_synth_cc(restored, 50, VOLUME_MSB, 10));
+    TEST_SUCCESS(fluid_synth_restore(restored, snapshot, size));
+    TEST_ASSERT(restored->channel[10] == NULL);
+    TEST_SUCCESS(fluid_synth_get_cc(restored, 200, VOLUME_MSB, &val));
+    TEST_ASSERT(val == 42);
+    TEST_SUCCESS(fluid_synth_get_cc(restored, 50, VOLUME_MSB, &val));
+    TEST_ASSERT(val == 100);
+    free(snapshot);
+
+    /* other basic channel setups create all channels */
+    TEST_SUCCESS(fluid_synth_reset_basic_channel(synth, -1));
+    TEST_SUCCESS(fluid_synth_set_basic_channel(synth, 16, FLUID_CHANNEL_MODE_OMNIOFF_POLY, 0));
+    TEST_ASSERT(memory_other(synth) == memory_other(dense));
+    TEST_ASSERT(fluid_synth_noteon(synth, 17, 60, 100) == FLUID_FAILED);
+
+    delete_fluid_synth(restored);
+    delete_fluid_synth(synth);
+    delete_fluid_synth(dense);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "synth/fluid_voice.h"
+#include "rvoice/fluid_rvoice.h"
+#include <math.h>
+
+// this test makes sure that with synth.stereo-voices, the two voices of a stereo pair are
+// rendered by a single rvoice, and that this sounds exactly like rendering them one by one
+
+#define FRAMES 6000
+#define SAMPLES 8192
+
+static short data_l[FRAMES], data_r[FRAMES];
+
+static fluid_sample_t *create_sample(short *data, int type)
+{
+    fluid_sample_t *sample = new_fluid_sample();
+
+    TEST_ASSERT(sample != NULL);
+    TEST_SUCCESS(fluid_sample_set_sound_data(sample, data, NULL, FRAMES, 44100, TRUE));
+    TEST_SUCCESS(fluid_sample_set_pitch(sample, 60, 0));
+    sample->sampletype = type;
+
+    return sample;
+}
+
+static fluid_voice_t *start_voice(fluid_synth_t *synth, fluid_sample_t *sample, float pan, float attenuation)
+{
+    fluid_voice_t *voice = fluid_synth_alloc_voice(synth, sample, 0, 60, 100);
+
+    TEST_ASSERT(voice != NULL);
+    fluid_voice_gen_set(voice, GEN_PAN, pan);
+    fluid_voice_gen_set(voice, GEN_ATTENUATION, attenuation);
+    fluid_voice_gen_set(voice, GEN_VOLENVRELEASE, -2000);
+    fluid_synth_start_voice(synth, voice);
+
+    return voice;
+}
+
+static void render(fluid_settings_t *settings, int stereo, float attenuation_r,
+                   fluid_sample_t *left, fluid_sample_t *right, float *out_l, float *out_r)
+{
+    fluid_synth_t *synth;
+    fluid_voice_t *voice_l, *voice_r;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.stereo-voices", stereo));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    voice_l = start_voice(synth, left, -500, 0);
+    voice_r = start_voice(synth, right, 500, attenuation_r);
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES / 2, out_l, 0, 1, out_r, 0, 1));
+
+    /* the voices only differing by their pan are paired */
+    TEST_ASSERT((voice_l->rvoice->stereo == voice_r->rvoice) == (stereo && attenuation_r == 0));
+    TEST_ASSERT(voice_r->rvoice->stereo == NULL);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 2);
+
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES / 2, out_l, SAMPLES / 2, 1, out_r, SAMPLES / 2, 1));
+
+    /* both have finished and been handed back */
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+
+    delete_fluid_synth(synth);
+}
+
+int main(void)
+{
+    static float ref_l[SAMPLES], ref_r[SAMPLES], out_l[SAMPLES], out_r[SAMPLES];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_sample_t *left, *right;
+    int i, audible = FALSE;
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        data_l[i] = (short)(10000 * sin(i * 0.05));
+        data_r[i] = (short)(8000 * sin(i * 0.031 + 1.0));
+    }
+
+    left = create_sample(data_l, FLUID_SAMPLETYPE_LEFT);
+    right = create_sample(data_r, FLUID_SAMPLETYPE_RIGHT);
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    render(settings, FALSE, 0, left, right, ref_l, ref_r);
+    render(settings, TRUE, 0, left, right, out_l, out_r);
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        TEST_ASSERT(out_l[i] == ref_l[i]);
+        TEST_ASSERT(out_r[i] == ref_r[i]);
+        audible |= (out_l[i] != 0.0f && out_r[i] != 0.0f);
+    }
+
+    TEST_ASSERT(audible);
+
+    /* voices with other generators play by themselves */
+    render(settings, TRUE, 60, left, right, out_l, out_r);
+
+    delete_fluid_settings(settings);
+    delete_fluid_sample(left);
+    delete_fluid_sample(right);
+
+    return EXIT_SUCCESS;
+}
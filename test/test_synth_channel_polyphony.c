@@ -0,0 +1,132 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_synth.h"
+
+// this test makes sure that a channel with a polyphony or a cost budget of its own steals
+// its own voices when reaching them, leaving the voices of the other channels alone
+
+#define MAX_VOICES 256
+#define FRAMES 64
+
+static void render(fluid_synth_t *synth)
+{
+    static float buf[2 * FRAMES];
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+}
+
+/* Returns the number of voices playing on chan */
+static int count_voices(fluid_synth_t *synth, int chan)
+{
+    fluid_voice_t *list[MAX_VOICES];
+    int i, count = 0;
+
+    /* the voices stolen have finished once a block has been rendered */
+    render(synth);
+    fluid_synth_get_voicelist(synth, list, MAX_VOICES, -1);
+
+    for(i = 0; i < MAX_VOICES && list[i] != NULL; i++)
+    {
+        if(fluid_voice_get_channel(list[i]) == chan)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* Plays notes on chan, one per block, and returns the number of voices of the last one */
+static int play(fluid_synth_t *synth, int chan, int notes)
+{
+    fluid_voice_t *list[MAX_VOICES];
+    int i, count = 0;
+
+    /* voices started in the same block can't be stolen, like with synth.polyphony */
+    for(i = 0; i < notes; i++)
+    {
+        render(synth);
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 40 + i, 100));
+    }
+
+    fluid_synth_get_voicelist(synth, list, MAX_VOICES, synth->storeid);
+
+    while(count < MAX_VOICES && list[count] != NULL)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    double budget;
+    int per_note, polyphony;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", MAX_VOICES));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* no limits by default */
+    TEST_SUCCESS(fluid_synth_get_channel_polyphony(synth, 0, &polyphony, &budget));
+    TEST_ASSERT(polyphony == 0 && budget == 0);
+    TEST_ASSERT(fluid_synth_set_channel_polyphony(synth, 0, -1, 0) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_set_channel_polyphony(synth, 16, 4, 0) == FLUID_FAILED);
+
+    per_note = play(synth, 0, 1);
+    TEST_ASSERT(per_note > 0);
+    fluid_synth_all_sounds_off(synth, -1);
+
+    /* the polyphony of a channel */
+    TEST_SUCCESS(fluid_synth_set_channel_polyphony(synth, 0, 4 * per_note, 0));
+    TEST_SUCCESS(fluid_synth_get_channel_polyphony(synth, 0, &polyphony, &budget));
+    TEST_ASSERT(polyphony == 4 * per_note && budget == 0);
+
+    TEST_ASSERT(play(synth, 0, 12) == per_note);
+    TEST_ASSERT(count_voices(synth, 0) == 4 * per_note);
+
+    /* doesn't limit the other channels */
+    play(synth, 1, 12);
+    TEST_ASSERT(count_voices(synth, 1) == 12 * per_note);
+    TEST_ASSERT(count_voices(synth, 0) == 4 * per_note);
+
+    /* and is kept across resets */
+    TEST_SUCCESS(fluid_synth_system_reset(synth));
+    TEST_SUCCESS(fluid_synth_get_channel_polyphony(synth, 0, &polyphony, &budget));
+    TEST_ASSERT(polyphony == 4 * per_note);
+
+    /* the cost budget, a 4th order voice costs 1, a 7th order one 1.8 */
+    TEST_SUCCESS(fluid_synth_set_channel_polyphony(synth, 2, 0, 3.6 * per_note));
+    TEST_SUCCESS(fluid_synth_get_channel_polyphony(synth, 2, &polyphony, &budget));
+    TEST_ASSERT(polyphony == 0 && budget == 3.6 * per_note);
+
+    play(synth, 2, 12);
+    TEST_ASSERT(count_voices(synth, 2) == (int)(3.6 * per_note));
+
+    fluid_synth_all_sounds_off(synth, 2);
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, 2, FLUID_INTERP_7THORDER));
+    play(synth, 2, 12);
+    TEST_ASSERT(count_voices(synth, 2) == 2 * per_note);
+
+    /* the voices of the noteon being started are never stolen */
+    fluid_synth_all_sounds_off(synth, -1);
+    TEST_SUCCESS(fluid_synth_set_channel_polyphony(synth, 3, per_note, 0));
+    TEST_ASSERT(play(synth, 3, 3) == per_note);
+    TEST_ASSERT(count_voices(synth, 3) == per_note);
+
+    /* no more limits */
+    TEST_SUCCESS(fluid_synth_set_channel_polyphony(synth, 0, 0, 0));
+    play(synth, 0, 12);
+    TEST_ASSERT(count_voices(synth, 0) == 12 * per_note);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
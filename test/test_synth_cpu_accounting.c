@@ -0,0 +1,93 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that voices are only accounted while synth.cpu-accounting is on,
+// that their time ends up at the channel and preset playing them and that it can be reset
+
+#define FRAMES 1024
+#define CALLS 50
+
+static void render(fluid_synth_t *synth)
+{
+    static float buf[2 * FRAMES];
+    int i;
+
+    for(i = 0; i < CALLS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    }
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_cpu_stats_t stats, other;
+    int i, id, sfont_id, bank, prog;
+
+    TEST_ASSERT(settings != NULL);
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    id = fluid_synth_sfload(synth, TEST_SOUNDFONT, 1);
+    TEST_ASSERT(id != FLUID_FAILED);
+
+    /* off by default, voices started now are never accounted */
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 60, 100));
+    render(synth);
+    TEST_SUCCESS(fluid_synth_get_channel_cpu_stats(synth, 1, &stats));
+    TEST_ASSERT(stats.usec == 0 && stats.voices == 0);
+    TEST_ASSERT(fluid_synth_get_preset_cpu_stats(synth, 0, NULL, NULL, NULL, &stats) == FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-accounting", 1));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 5));
+
+    for(i = 0; i < 8; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 48 + i, 100));
+    }
+
+    render(synth);
+
+    TEST_SUCCESS(fluid_synth_get_channel_cpu_stats(synth, 0, &stats));
+    TEST_ASSERT(stats.usec > 0);
+    TEST_ASSERT(stats.load > 0);
+    TEST_ASSERT(stats.voices > 0 && stats.voices <= fluid_synth_get_polyphony(synth));
+
+    /* the voice started before is still playing but not accounted */
+    TEST_SUCCESS(fluid_synth_get_channel_cpu_stats(synth, 1, &other));
+    TEST_ASSERT(other.usec == 0);
+
+    /* the only preset played while accounting */
+    TEST_SUCCESS(fluid_synth_get_preset_cpu_stats(synth, 0, &sfont_id, &bank, &prog, &other));
+    TEST_ASSERT(sfont_id == id && bank == 0 && prog == 5);
+    TEST_ASSERT(other.usec == stats.usec);
+    TEST_ASSERT(other.voices == stats.voices);
+    TEST_ASSERT(fluid_synth_get_preset_cpu_stats(synth, 1, NULL, NULL, NULL, &other) == FLUID_FAILED);
+
+    TEST_ASSERT(fluid_synth_get_channel_cpu_stats(synth, fluid_synth_count_midi_channels(synth), &stats) == FLUID_FAILED);
+
+    /* a reset takes effect immediately for readers, the presets stay known */
+    fluid_synth_reset_perf_stats(synth);
+    TEST_SUCCESS(fluid_synth_get_channel_cpu_stats(synth, 0, &stats));
+    TEST_ASSERT(stats.usec == 0 && stats.voices == 0);
+    TEST_SUCCESS(fluid_synth_get_preset_cpu_stats(synth, 0, NULL, NULL, NULL, &stats));
+    TEST_ASSERT(stats.usec == 0);
+
+    render(synth);
+    TEST_SUCCESS(fluid_synth_get_channel_cpu_stats(synth, 0, &stats));
+    TEST_ASSERT(stats.usec > 0);
+
+    /* switching it off keeps the statistics */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-accounting", 0));
+    render(synth);
+    TEST_SUCCESS(fluid_synth_get_channel_cpu_stats(synth, 0, &other));
+    TEST_ASSERT(other.usec == stats.usec);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that with synth.fx-pipeline the output is exactly the same
+// as without it, only delayed by the amount of audio rendered by one call
+
+#define CHUNK 256
+#define CHUNKS 64
+
+static void render(fluid_synth_t *synth, float *buf)
+{
+    int i;
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 67, 80));
+
+    for(i = 0; i < CHUNKS; i++)
+    {
+        if(i == CHUNKS / 2)
+        {
+            TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+            TEST_SUCCESS(fluid_synth_noteoff(synth, 1, 67));
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, CHUNK, &buf[2 * i * CHUNK], 0, 2,
+                                             &buf[2 * i * CHUNK], 1, 2));
+    }
+}
+
+static fluid_synth_t *create(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    int chan;
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* send to both effects */
+    for(chan = 0; chan < 2; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 91, 127));
+        TEST_SUCCESS(fluid_synth_cc(synth, chan, 93, 127));
+    }
+
+    return synth;
+}
+
+int main(void)
+{
+    static float direct[2 * CHUNK * CHUNKS], pipelined[2 * CHUNK * CHUNKS];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth1, *synth2;
+    int i;
+    float energy = 0;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.reverb.level", 1.0));
+    synth1 = create(settings);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.fx-pipeline", 1));
+    synth2 = create(settings);
+
+    render(synth1, direct);
+    render(synth2, pipelined);
+
+    /* the first call only fills the pipeline */
+    for(i = 0; i < 2 * CHUNK; i++)
+    {
+        TEST_ASSERT(pipelined[i] == 0.0f);
+    }
+
+    for(i = 0; i < 2 * CHUNK * (CHUNKS - 1); i++)
+    {
+        energy += FLUID_FABS(direct[i]);
+        TEST_ASSERT(direct[i] == pipelined[i + 2 * CHUNK]);
+    }
+
+    TEST_ASSERT(energy > 0);
+
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
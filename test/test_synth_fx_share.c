@@ -0,0 +1,114 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that effects groups with identical reverb and chorus parameters
+// sound the same when they share a single reverb and chorus unit, and that groups whose
+// parameters differ keep their own units
+
+#define FX_GROUPS 4
+#define FRAMES 64
+#define BLOCKS 400
+
+static float left[2][BLOCKS * FRAMES], right[2][BLOCKS * FRAMES];
+
+static void render(fluid_synth_t *synth, int share)
+{
+    int i, chan;
+
+    for(chan = 0; chan < FX_GROUPS; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 48 + 7 * chan, 100));
+    }
+
+    for(i = 0; i < BLOCKS; i++)
+    {
+        if(i == BLOCKS / 4)
+        {
+            for(chan = 0; chan < FX_GROUPS; chan++)
+            {
+                TEST_SUCCESS(fluid_synth_noteoff(synth, chan, 48 + 7 * chan));
+            }
+        }
+
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left[share], i * FRAMES, 1,
+                                             right[share], i * FRAMES, 1));
+    }
+}
+
+/* Returns the largest difference between the outputs rendered without and with sharing */
+static float compare(float *peak)
+{
+    float diff = 0;
+    int i, channel;
+
+    *peak = 0;
+
+    for(i = 0; i < BLOCKS * FRAMES; i++)
+    {
+        for(channel = 0; channel < 2; channel++)
+        {
+            float *out = channel ? right[0] : left[0];
+            float *shared = channel ? right[1] : left[1];
+
+            if(fabsf(out[i]) > *peak)
+            {
+                *peak = fabsf(out[i]);
+            }
+
+            if(fabsf(out[i] - shared[i]) > diff)
+            {
+                diff = fabsf(out[i] - shared[i]);
+            }
+        }
+    }
+
+    return diff;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    float diff, peak;
+    int share, differ;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.effects-groups", FX_GROUPS));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.audio-groups", 1));
+
+    /* first all groups share the units of the first one, then the second group has
+     * a reverb and the third one a chorus of their own, and the fourth no reverb */
+    for(differ = 0; differ < 2; differ++)
+    {
+        for(share = 0; share < 2; share++)
+        {
+            TEST_SUCCESS(fluid_settings_setint(settings, "synth.fx-share", share));
+            synth = new_fluid_synth(settings);
+            TEST_ASSERT(synth != NULL);
+            TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+            /* loud enough effects to tell them apart */
+            TEST_SUCCESS(fluid_synth_set_reverb_group_level(synth, -1, 1.0));
+            TEST_SUCCESS(fluid_synth_set_chorus_group_level(synth, -1, 4.0));
+
+            if(differ)
+            {
+                TEST_SUCCESS(fluid_synth_set_reverb_group_roomsize(synth, 1, 0.9));
+                TEST_SUCCESS(fluid_synth_set_chorus_group_depth(synth, 2, 20.0));
+                TEST_SUCCESS(fluid_synth_reverb_on(synth, 3, FALSE));
+            }
+
+            render(synth, share);
+            delete_fluid_synth(synth);
+        }
+
+        diff = compare(&peak);
+        TEST_ASSERT(peak > 0.01f);
+        TEST_ASSERT(diff < peak * 1e-4f);
+    }
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
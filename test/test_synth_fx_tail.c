@@ -0,0 +1,105 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that reverb and chorus units are bypassed once their tail has died out,
+// and that they resume from the same clean state as soon as input arrives again, no matter
+// how long they have been bypassed
+
+#define FRAMES 8192
+#define CHUNK 4096
+#define MAX_CHUNKS 1000
+
+static void play_note(fluid_synth_t *synth, float *buf)
+{
+    int i;
+    float energy = 0;
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60));
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        energy += FLUID_FABS(buf[i]);
+    }
+
+    TEST_ASSERT(energy > 0);
+}
+
+/* Renders until the output is exactly silent, returns the number of chunks rendered */
+static int render_tail(fluid_synth_t *synth)
+{
+    static float buf[2 * CHUNK];
+    int chunks, i, silent = FALSE;
+
+    for(chunks = 0; chunks < MAX_CHUNKS && !silent; chunks++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, CHUNK, buf, 0, 2, buf, 1, 2));
+
+        for(i = 0, silent = TRUE; i < 2 * CHUNK && silent; i++)
+        {
+            silent = (buf[i] == 0.0f);
+        }
+    }
+
+    TEST_ASSERT(silent);
+    return chunks;
+}
+
+static fluid_synth_t *create(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* send to both effects */
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 91, 127));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 93, 127));
+    return synth;
+}
+
+int main(void)
+{
+    static float first[2 * FRAMES], again[2 * FRAMES], buf[2 * CHUNK];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth1, *synth2;
+    int i, chunks;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.reverb.room-size", 0.9));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.reverb.level", 1.0));
+
+    synth1 = create(settings);
+    synth2 = create(settings);
+
+    play_note(synth1, first);
+    play_note(synth2, again);
+
+    /* the tail of the effects lasts longer than the note */
+    chunks = render_tail(synth1);
+    TEST_ASSERT(chunks > 2);
+    TEST_ASSERT(render_tail(synth2) == chunks);
+
+    /* effects still running on silence would continue differently after a longer pause */
+    for(i = 0; i < 7; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth2, CHUNK, buf, 0, 2, buf, 1, 2));
+    }
+
+    play_note(synth1, first);
+    play_note(synth2, again);
+
+    for(i = 0; i < 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(first[i] == again[i]);
+    }
+
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
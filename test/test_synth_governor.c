@@ -0,0 +1,130 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_synth.h"
+
+// this test makes sure that the load governor first lowers the interpolation, then the
+// polyphony, and that it takes back one step at a time once the load has been low for a while
+
+#define FRAMES 1024
+
+/* Renders the given number of seconds while the governor is inactive */
+static void render(fluid_synth_t *synth, double seconds)
+{
+    static float buf[2 * FRAMES];
+    int i;
+
+    for(i = 0; i < seconds * 44100 / FRAMES + 1; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    }
+}
+
+/* Reports a render call of 64 blocks with the given load */
+static void govern(fluid_synth_t *synth, double load)
+{
+    fluid_synth_govern(synth, load * 64 * FLUID_BUFSIZE * 1000000.0 / 44100, 64);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int i, limit, steps;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 64));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.governor.min-polyphony", 8));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.governor.interpolation", 1));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    for(i = 0; i < 24; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 40 + i, 100));
+    }
+
+    render(synth, 0.1);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) >= 24);
+
+    /* the interpolation is lowered first */
+    govern(synth, 2.0);
+    TEST_ASSERT(synth->governor.interp_limited);
+    TEST_ASSERT(synth->governor.polyphony == 0);
+
+    /* nothing happens while the governor holds off */
+    govern(synth, 2.0);
+    TEST_ASSERT(synth->governor.polyphony == 0);
+
+    /* then an eighth of the voices is dropped, lowest priority first */
+    render(synth, 0.2);
+    i = fluid_synth_get_active_voice_count(synth);
+    govern(synth, 2.0);
+    limit = synth->governor.polyphony;
+    TEST_ASSERT(limit == i - i / 8);
+
+    render(synth, 0.2);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) <= limit);
+
+    /* new notes don't exceed the governed polyphony */
+    for(i = 0; i < 20; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 1, 40 + i, 100));
+    }
+
+    render(synth, 0.01);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) <= limit);
+
+    /* it never goes below synth.governor.min-polyphony */
+    for(i = 0; i < 30; i++)
+    {
+        render(synth, 0.2);
+        govern(synth, 2.0);
+    }
+
+    TEST_ASSERT(synth->governor.polyphony == 8);
+
+    /* a load between the hysteresis threshold and the target changes nothing */
+    for(i = 0; i < 3; i++)
+    {
+        render(synth, 1.1);
+        govern(synth, 0.75);
+    }
+
+    TEST_ASSERT(synth->governor.polyphony == 8);
+
+    /* a low load takes back one step per second, the polyphony first */
+    govern(synth, 0.1);
+
+    for(steps = 0; synth->governor.polyphony != 0 && steps < 100; steps++)
+    {
+        render(synth, 1.1);
+        govern(synth, 0.1);
+    }
+
+    TEST_ASSERT(steps == (64 - 8 + 3) / 4);
+    TEST_ASSERT(synth->governor.interp_limited);
+
+    render(synth, 1.1);
+    govern(synth, 0.1);
+    TEST_ASSERT(!synth->governor.interp_limited);
+
+    /* switching it off gives back everything */
+    for(i = 0; i < 30; i++)
+    {
+        render(synth, 0.2);
+        govern(synth, 2.0);
+    }
+
+    TEST_ASSERT(synth->governor.polyphony != 0 && synth->governor.interp_limited);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.governor.active", 0));
+    TEST_ASSERT(synth->governor.polyphony == 0 && !synth->governor.interp_limited);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the look-ahead-free limiter keeps the output of every
+// audio group below synth.limiter.output-limit, and leaves quiet audio untouched
+
+#define FRAMES 8192
+#define GROUPS 2
+
+static void render(fluid_settings_t *settings, float out[2 * GROUPS][FRAMES])
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+    float *bufs[2 * GROUPS];
+    int i;
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* channel 0 plays into the first audio group, channel 1 into the second one */
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 64, 127));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 48, 127));
+
+    for(i = 0; i < 2 * GROUPS; i++)
+    {
+        bufs[i] = out[i];
+        FLUID_MEMSET(out[i], 0, FRAMES * sizeof(float));
+    }
+
+    TEST_SUCCESS(fluid_synth_process(synth, FRAMES, 0, NULL, 2 * GROUPS, bufs));
+    delete_fluid_synth(synth);
+}
+
+static float peak(const float *buf)
+{
+    float max = 0;
+    int i;
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        max = (FLUID_FABS(buf[i]) > max) ? FLUID_FABS(buf[i]) : max;
+    }
+
+    return max;
+}
+
+int main(void)
+{
+    static float limited[2 * GROUPS][FRAMES], unlimited[2 * GROUPS][FRAMES];
+    fluid_settings_t *settings = new_fluid_settings();
+    int i, k;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.audio-groups", GROUPS));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.audio-channels", GROUPS));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.limiter.look-ahead", 0));
+
+    /* loud notes are limited in each group */
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.gain", 2.0));
+    render(settings, unlimited);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.limiter.active", 1));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.limiter.output-limit", 0.25));
+    render(settings, limited);
+
+    for(i = 0; i < 2 * GROUPS; i++)
+    {
+        TEST_ASSERT(peak(unlimited[i]) > 0.5f);
+        TEST_ASSERT(peak(limited[i]) <= 0.25f + 1e-6f);
+        TEST_ASSERT(peak(limited[i]) > 0.2f);
+    }
+
+    /* quiet notes aren't changed at all */
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.gain", 0.05));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.limiter.output-limit", 1.0));
+    render(settings, limited);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.limiter.active", 0));
+    render(settings, unlimited);
+
+    for(i = 0; i < 2 * GROUPS; i++)
+    {
+        TEST_ASSERT(peak(unlimited[i]) > 0);
+
+        for(k = 0; k < FRAMES; k++)
+        {
+            TEST_ASSERT(limited[i][k] == unlimited[i][k]);
+        }
+    }
+
+    delete_fluid_settings(settings);
+    return EXIT_SUCCESS;
+}
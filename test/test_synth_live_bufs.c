@@ -0,0 +1,119 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "rvoice/fluid_rvoice_mixer.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that only the buffers of the audio groups and effects channels
+// voices play into are processed, and that the sound of a group doesn't depend on how
+// many other, silent groups there are
+
+#define FRAMES 256
+#define CHUNKS 64
+#define GROUPS 16
+#define CHAN 5
+
+static fluid_synth_t *create(fluid_settings_t *settings, int groups)
+{
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.audio-groups", groups));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.audio-channels", groups));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.effects-groups", groups));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_cc(synth, CHAN, 91, 127));
+    TEST_SUCCESS(fluid_synth_cc(synth, CHAN, 93, 127));
+
+    return synth;
+}
+
+/* Renders CHUNKS * FRAMES frames of the group playing CHAN */
+static void render(fluid_synth_t *synth, int groups, float *dry, float *fx)
+{
+    static float out[2 * GROUPS][FRAMES], fx_out[4 * GROUPS][FRAMES];
+    float *out_bufs[2 * GROUPS], *fx_bufs[4 * GROUPS];
+    const unsigned char *live = fluid_rvoice_mixer_get_live_bufs(synth->eventhandler->mixer);
+    int group = CHAN % groups;
+    int i, k, c;
+
+    for(i = 0; i < 2 * groups; i++)
+    {
+        out_bufs[i] = out[i];
+    }
+
+    for(i = 0; i < 4 * groups; i++)
+    {
+        fx_bufs[i] = fx_out[i];
+    }
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, CHAN, 60, 120));
+
+    for(c = 0; c < CHUNKS; c++)
+    {
+        if(c == 8)
+        {
+            TEST_SUCCESS(fluid_synth_noteoff(synth, CHAN, 60));
+        }
+
+        FLUID_MEMSET(out, 0, sizeof(out));
+        FLUID_MEMSET(fx_out, 0, sizeof(fx_out));
+        TEST_SUCCESS(fluid_synth_process(synth, FRAMES, 4 * groups, fx_bufs, 2 * groups, out_bufs));
+
+        for(i = 0; i < groups; i++)
+        {
+            /* the other groups and their effects are never processed */
+            TEST_ASSERT(i == group || (!live[i * 2] && !live[i * 2 + 1]));
+            TEST_ASSERT(i == group || (!live[2 * groups + i * 2] && !live[2 * groups + i * 2 + 1]));
+
+            for(k = 0; k < FRAMES; k++)
+            {
+                TEST_ASSERT(i == group || (out[i * 2][k] == 0 && out[i * 2 + 1][k] == 0));
+            }
+        }
+
+        for(k = 0; k < FRAMES; k++)
+        {
+            dry[(c * FRAMES + k) * 2] = out[group * 2][k];
+            dry[(c * FRAMES + k) * 2 + 1] = out[group * 2 + 1][k];
+            fx[(c * FRAMES + k) * 2] = fx_out[group * 4][k];
+            fx[(c * FRAMES + k) * 2 + 1] = fx_out[group * 4 + 3][k];
+        }
+    }
+}
+
+int main(void)
+{
+    static float dry_single[2 * FRAMES * CHUNKS], fx_single[2 * FRAMES * CHUNKS];
+    static float dry_sparse[2 * FRAMES * CHUNKS], fx_sparse[2 * FRAMES * CHUNKS];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    float dry_energy = 0, fx_energy = 0;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+
+    synth = create(settings, 1);
+    render(synth, 1, dry_single, fx_single);
+    delete_fluid_synth(synth);
+
+    synth = create(settings, GROUPS);
+    render(synth, GROUPS, dry_sparse, fx_sparse);
+    delete_fluid_synth(synth);
+
+    for(i = 0; i < 2 * FRAMES * CHUNKS; i++)
+    {
+        TEST_ASSERT(dry_single[i] == dry_sparse[i]);
+        TEST_ASSERT(fx_single[i] == fx_sparse[i]);
+        dry_energy += FLUID_FABS(dry_sparse[i]);
+        fx_energy += FLUID_FABS(fx_sparse[i]);
+    }
+
+    TEST_ASSERT(dry_energy > 0);
+    TEST_ASSERT(fx_energy > 0);
+
+    delete_fluid_settings(settings);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "midi/fluid_midi.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that MIDI events queued by fluid_synth_queue_midi_events() sound exactly like
+// the same events passed to fluid_synth_handle_midi_event() right before rendering the block they are due in
+
+#define EVENTS 2000
+#define BLOCKS 400
+#define FRAMES (BLOCKS * FLUID_BUFSIZE)
+
+static char gm_system_on[] = { 0x7E, 0x7F, 0x09, 0x01 };
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    return synth;
+}
+
+static void create_events(fluid_midi_event_t **events, unsigned int *offsets)
+{
+    int i, chan;
+
+    for(i = 0; i < EVENTS; i++)
+    {
+        events[i] = new_fluid_midi_event();
+        TEST_ASSERT(events[i] != NULL);
+
+        chan = rand() % 16;
+        offsets[i] = rand() % FRAMES;
+
+        switch(rand() % 6)
+        {
+        case 0:
+        case 1:
+            TEST_SUCCESS(fluid_midi_event_set_type(events[i], NOTE_ON));
+            TEST_SUCCESS(fluid_midi_event_set_key(events[i], 36 + rand() % 48));
+            TEST_SUCCESS(fluid_midi_event_set_velocity(events[i], 1 + rand() % 127));
+            break;
+
+        case 2:
+            TEST_SUCCESS(fluid_midi_event_set_type(events[i], NOTE_OFF));
+            TEST_SUCCESS(fluid_midi_event_set_key(events[i], 36 + rand() % 48));
+            break;
+
+        case 3:
+            TEST_SUCCESS(fluid_midi_event_set_type(events[i], CONTROL_CHANGE));
+            TEST_SUCCESS(fluid_midi_event_set_control(events[i], (rand() % 2) ? 7 : 10));
+            TEST_SUCCESS(fluid_midi_event_set_value(events[i], rand() % 128));
+            break;
+
+        case 4:
+            TEST_SUCCESS(fluid_midi_event_set_type(events[i], PITCH_BEND));
+            TEST_SUCCESS(fluid_midi_event_set_pitch(events[i], rand() % 16384));
+            break;
+
+        default:
+            TEST_SUCCESS(fluid_midi_event_set_type(events[i], PROGRAM_CHANGE));
+            TEST_SUCCESS(fluid_midi_event_set_program(events[i], rand() % 128));
+            break;
+        }
+
+        TEST_SUCCESS(fluid_midi_event_set_channel(events[i], chan));
+    }
+
+    // a SYSEX event whose data must be copied, the original is deleted right after queueing it
+    TEST_SUCCESS(fluid_midi_event_set_sysex(events[EVENTS - 1], gm_system_on, sizeof(gm_system_on), FALSE));
+}
+
+static void render(fluid_synth_t *synth, float *left, float *right, int len)
+{
+    float *out[2];
+
+    out[0] = left;
+    out[1] = right;
+    TEST_SUCCESS(fluid_synth_process(synth, len, 0, NULL, 2, out));
+}
+
+int main(void)
+{
+    static float left1[FRAMES], right1[FRAMES], left2[FRAMES], right2[FRAMES];
+    fluid_midi_event_t *events[EVENTS], *event;
+    unsigned int offsets[EVENTS], offset;
+    int order[EVENTS];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth1, *synth2;
+    int i, j, k, len;
+    float energy = 0;
+
+    TEST_ASSERT(settings != NULL);
+    srand(4711);
+    create_events(events, offsets);
+
+    synth1 = create_synth(settings);
+    synth2 = create_synth(settings);
+
+    // unsupported events are refused, nothing is queued then
+    event = new_fluid_midi_event();
+    TEST_ASSERT(event != NULL);
+    TEST_SUCCESS(fluid_midi_event_set_type(event, MIDI_TIME_CODE));
+    TEST_ASSERT(fluid_synth_queue_midi_events(synth2, &event, offsets, 1) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_queue_midi_events(synth2, events, NULL, EVENTS) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_queue_midi_events(synth2, NULL, NULL, 0));
+    delete_fluid_midi_event(event);
+
+    // the reference applies the events in the order of their offsets, those with the same offset in the order passed
+    for(i = 0; i < EVENTS; i++)
+    {
+        for(j = i; j > 0 && offsets[order[j - 1]] > offsets[i]; j--)
+        {
+            order[j] = order[j - 1];
+        }
+
+        order[j] = i;
+    }
+
+    for(i = 0, k = 0; k < BLOCKS; k++)
+    {
+        for(; i < EVENTS && offsets[order[i]] < (unsigned int)(k + 1) * FLUID_BUFSIZE; i++)
+        {
+            // note offs of notes not playing fail, which is fine here
+            fluid_synth_handle_midi_event(synth1, events[order[i]]);
+        }
+
+        render(synth1, &left1[k * FLUID_BUFSIZE], &right1[k * FLUID_BUFSIZE], FLUID_BUFSIZE);
+    }
+
+    // the queued events, in two calls and rendered in chunks not aligned to the blocks
+    TEST_SUCCESS(fluid_synth_queue_midi_events(synth2, events, offsets, EVENTS / 2));
+    TEST_SUCCESS(fluid_synth_queue_midi_events(synth2, &events[EVENTS / 2], &offsets[EVENTS / 2], EVENTS - EVENTS / 2));
+
+    for(i = 0; i < EVENTS; i++)
+    {
+        delete_fluid_midi_event(events[i]);
+    }
+
+    for(i = 0; i < FRAMES; i += len)
+    {
+        len = (FRAMES - i < 1000) ? FRAMES - i : 1000;
+        render(synth2, &left2[i], &right2[i], len);
+    }
+
+    for(i = 0; i < FRAMES; i++)
+    {
+        energy += FLUID_FABS(left1[i]) + FLUID_FABS(right1[i]);
+        TEST_ASSERT(left1[i] == left2[i]);
+        TEST_ASSERT(right1[i] == right2[i]);
+    }
+
+    TEST_ASSERT(energy > 0);
+
+    // events queued in the middle of a render period are due relative to the next block rendered
+    render(synth1, left1, right1, 1000);
+    render(synth2, left2, right2, 1000);
+
+    offset = 0;
+    event = new_fluid_midi_event();
+    TEST_ASSERT(event != NULL);
+    TEST_SUCCESS(fluid_midi_event_set_type(event, NOTE_ON));
+    TEST_SUCCESS(fluid_midi_event_set_channel(event, 0));
+    TEST_SUCCESS(fluid_midi_event_set_key(event, 60));
+    TEST_SUCCESS(fluid_midi_event_set_velocity(event, 127));
+    TEST_SUCCESS(fluid_synth_handle_midi_event(synth1, event));
+    TEST_SUCCESS(fluid_synth_queue_midi_events(synth2, &event, &offset, 1));
+    delete_fluid_midi_event(event);
+
+    FLUID_MEMSET(left1, 0, sizeof(left1));
+    FLUID_MEMSET(right1, 0, sizeof(right1));
+    FLUID_MEMSET(left2, 0, sizeof(left2));
+    FLUID_MEMSET(right2, 0, sizeof(right2));
+    render(synth1, left1, right1, 1000);
+    render(synth2, left2, right2, 1000);
+
+    for(i = 0; i < 1000; i++)
+    {
+        TEST_ASSERT(left1[i] == left2[i]);
+        TEST_ASSERT(right1[i] == right2[i]);
+    }
+
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
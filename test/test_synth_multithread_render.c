@@ -0,0 +1,90 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include <math.h>
+
+// this test makes sure that rendering with additional mixer threads produces the same
+// audio as rendering with a single thread, no matter how the voices are distributed
+// and how the threads wait for each other
+
+#define SAMPLES 4096
+#define MAX_ABS_DELTA 1e-4f
+
+/* "spin" is left out, it needs an idle CPU core per thread to make reasonable progress */
+static const char *const wait_modes[] = { "block", "hybrid" };
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings, int cores, const char *wait_mode)
+{
+    fluid_synth_t *synth;
+    int chan, key;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", cores));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.mixer-thread-wait", wait_mode));
+    /* pinning all threads to the first CPU must not change the result */
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.cpu-affinity", (cores == 5) ? "0" : ""));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+
+    /* enough voices to wake up all mixer threads */
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 3));
+
+        for(key = 36; key < 84; key += 5)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 40 + key));
+        }
+    }
+
+    return synth;
+}
+
+int main(void)
+{
+    static float ref_l[SAMPLES], ref_r[SAMPLES];
+    static float mt_l[SAMPLES], mt_r[SAMPLES];
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    int i, cores;
+    unsigned int mode;
+    float energy = 0;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    synth = create_synth(settings, 1, wait_modes[0]);
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES, ref_l, 0, 1, ref_r, 0, 1));
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        energy += fabsf(ref_l[i]) + fabsf(ref_r[i]);
+    }
+
+    TEST_ASSERT(energy > 0);
+
+    for(mode = 0; mode < sizeof(wait_modes) / sizeof(wait_modes[0]); mode++)
+    {
+        for(cores = 2; cores <= 8; cores += 3)
+        {
+            settings = new_fluid_settings();
+            TEST_ASSERT(settings != NULL);
+            synth = create_synth(settings, cores, wait_modes[mode]);
+            TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES, mt_l, 0, 1, mt_r, 0, 1));
+
+            for(i = 0; i < SAMPLES; i++)
+            {
+                TEST_ASSERT(fabsf(ref_l[i] - mt_l[i]) < MAX_ABS_DELTA);
+                TEST_ASSERT(fabsf(ref_r[i] - mt_r[i]) < MAX_ABS_DELTA);
+            }
+
+            delete_fluid_synth(synth);
+            delete_fluid_settings(settings);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "fluidsynth_priv.h"
+#include "fluid_synth.h"
+#include "fluid_midi.h"
+#include <math.h>
+
+// this test makes sure that allocating voices picks the same voice as scanning all voices
+// for an available one or, if there is none, for the one with the lowest overflow priority,
+// no matter how the state of the voices changes in between
+
+#define ITERATIONS 6000
+#define SAMPLE_FRAMES 8000
+
+static unsigned int seed = 1;
+
+static int next_random(int range)
+{
+    seed = seed * 1103515245 + 12345;
+    return (int)((seed >> 16) % (unsigned int)range);
+}
+
+/* the voice selection of fluid_synth_alloc_voice() before it used the overflow tree */
+static fluid_voice_t *expected_voice(fluid_synth_t *synth)
+{
+    int i, best_index = -1;
+    float prio, best_prio = OVERFLOW_PRIO_CANNOT_KILL - 1;
+    unsigned int ticks;
+
+    /* entering the API frees the voices that have finished in the meantime, as the allocation will */
+    TEST_ASSERT(fluid_synth_get_polyphony(synth) == synth->polyphony);
+    ticks = fluid_synth_get_ticks(synth);
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        if(_AVAILABLE(synth->voice[i]))
+        {
+            return synth->voice[i];
+        }
+    }
+
+    /* the voices are ranked with the controller changes not applied to them yet */
+    fluid_synth_apply_modulations_before_kill_LOCAL(synth);
+
+    for(i = 0; i < synth->polyphony; i++)
+    {
+        prio = fluid_voice_get_overflow_prio(synth->voice[i], &synth->overflow, ticks);
+
+        if(prio < best_prio)
+        {
+            best_index = i;
+            best_prio = prio;
+        }
+    }
+
+    return (best_index < 0) ? NULL : synth->voice[best_index];
+}
+
+static void set_overflow_scores(fluid_settings_t *settings)
+{
+    static const char *const important[] = { "", "1,3", "2,10,16" };
+    int r = next_random(8);
+
+    switch(r)
+    {
+    case 0:
+        TEST_SUCCESS(fluid_settings_setnum(settings, "synth.overflow.age", 0));
+        break;
+
+    case 1:
+        TEST_SUCCESS(fluid_settings_setnum(settings, "synth.overflow.age", next_random(2000) - 500));
+        break;
+
+    case 2:
+        TEST_SUCCESS(fluid_settings_setnum(settings, "synth.overflow.volume", next_random(1000)));
+        break;
+
+    case 3:
+        TEST_SUCCESS(fluid_settings_setnum(settings, "synth.overflow.released", -next_random(3000)));
+        break;
+
+    case 4:
+        TEST_SUCCESS(fluid_settings_setnum(settings, "synth.overflow.sustained", -next_random(2000)));
+        break;
+
+    case 5:
+        TEST_SUCCESS(fluid_settings_setnum(settings, "synth.overflow.percussion", next_random(5000)));
+        break;
+
+    default:
+        TEST_SUCCESS(fluid_settings_setstr(settings, "synth.overflow.important-channels", important[r % 3]));
+        break;
+    }
+}
+
+int main(void)
+{
+    static short data[SAMPLE_FRAMES];
+    static float out[2][512];
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    fluid_sample_t *sample;
+    fluid_voice_t *voice;
+    int i, chan, allocated = 0, killed = 0;
+
+    for(i = 0; i < SAMPLE_FRAMES; i++)
+    {
+        data[i] = (short)(10000 * sin(i * 0.05));
+    }
+
+    sample = new_fluid_sample();
+    TEST_ASSERT(sample != NULL);
+    TEST_SUCCESS(fluid_sample_set_sound_data(sample, data, NULL, SAMPLE_FRAMES, 44100, TRUE));
+    TEST_SUCCESS(fluid_sample_set_pitch(sample, 60, 0));
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 24));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    for(i = 0; i < ITERATIONS; i++)
+    {
+        int r = next_random(100);
+        chan = next_random(16);
+
+        if(r < 40)
+        {
+            fluid_voice_t *expected = expected_voice(synth);
+
+            killed += (expected != NULL && !_AVAILABLE(expected));
+            voice = fluid_synth_alloc_voice(synth, sample, chan, 40 + next_random(40), 1 + next_random(127));
+            TEST_ASSERT(voice == expected);
+
+            if(voice != NULL)
+            {
+                fluid_synth_start_voice(synth, voice);
+                allocated++;
+            }
+        }
+        else if(r < 55)
+        {
+            /* fails if there is no such note, which is fine */
+            fluid_synth_noteoff(synth, chan, 40 + next_random(40));
+        }
+        else if(r < 65)
+        {
+            TEST_SUCCESS(fluid_synth_cc(synth, chan, (next_random(2) ? SUSTAIN_SWITCH : SOSTENUTO_SWITCH), next_random(2) * 127));
+        }
+        else if(r < 75)
+        {
+            TEST_SUCCESS(fluid_synth_cc(synth, chan, VOLUME_MSB, next_random(128)));
+        }
+        else if(r < 92)
+        {
+            TEST_SUCCESS(fluid_synth_write_float(synth, 64 * (1 + next_random(8)), out[0], 0, 1, out[1], 0, 1));
+        }
+        else if(r < 95)
+        {
+            TEST_SUCCESS(fluid_synth_set_channel_type(synth, chan, next_random(2) ? CHANNEL_TYPE_DRUM : CHANNEL_TYPE_MELODIC));
+        }
+        else if(r < 99)
+        {
+            set_overflow_scores(settings);
+        }
+        else
+        {
+            TEST_SUCCESS(fluid_synth_set_polyphony(synth, 8 + next_random(32)));
+        }
+    }
+
+    /* make sure the interesting paths have actually been taken */
+    TEST_ASSERT(allocated > ITERATIONS / 4);
+    TEST_ASSERT(killed > ITERATIONS / 10);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+    delete_fluid_sample(sample);
+
+    return EXIT_SUCCESS;
+}
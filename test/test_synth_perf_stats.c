@@ -0,0 +1,91 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that the render stages are only timed while synth.perf-stats is on,
+// that the statistics are consistent with each other and that they can be reset
+
+#define FRAMES 1024
+#define CALLS 200
+
+static void render(fluid_synth_t *synth)
+{
+    static float buf[2 * FRAMES];
+    int i;
+
+    for(i = 0; i < CALLS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    }
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_perf_stats_t stats, voices;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    for(i = 0; i < 16; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 48 + i, 100));
+    }
+
+    /* off by default */
+    render(synth);
+    TEST_SUCCESS(fluid_synth_get_perf_stats(synth, FLUID_PERF_STAGE_RENDER, -1, &stats));
+    TEST_ASSERT(stats.count == 0);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.perf-stats", 1));
+    render(synth);
+
+    TEST_SUCCESS(fluid_synth_get_perf_stats(synth, FLUID_PERF_STAGE_RENDER, -1, &stats));
+    TEST_ASSERT(stats.count > 0);
+    TEST_ASSERT(stats.min > 0);
+    TEST_ASSERT(stats.min <= stats.avg);
+    TEST_ASSERT(stats.avg <= stats.max);
+    TEST_ASSERT(stats.p99 >= stats.min);
+    TEST_ASSERT(stats.p99 <= stats.max);
+
+    /* the voices stage is part of every render call */
+    TEST_SUCCESS(fluid_synth_get_perf_stats(synth, FLUID_PERF_STAGE_VOICES, -1, &voices));
+    TEST_ASSERT(voices.count == stats.count);
+    TEST_ASSERT(voices.avg <= stats.avg);
+
+    /* a single core synth renders all voices on the calling thread */
+    TEST_SUCCESS(fluid_synth_get_perf_stats(synth, FLUID_PERF_STAGE_VOICES, 0, &voices));
+    TEST_ASSERT(voices.count == stats.count);
+    TEST_SUCCESS(fluid_synth_get_perf_stats(synth, FLUID_PERF_STAGE_VOICES, 1, &voices));
+    TEST_ASSERT(voices.count == 0);
+
+    /* only the voices stage is split by thread */
+    TEST_ASSERT(fluid_synth_get_perf_stats(synth, FLUID_PERF_STAGE_REVERB, 0, &stats) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_perf_stats(synth, FLUID_PERF_STAGE_LAST, -1, &stats) == FLUID_FAILED);
+
+    /* a reset takes effect immediately for readers */
+    fluid_synth_reset_perf_stats(synth);
+    TEST_SUCCESS(fluid_synth_get_perf_stats(synth, FLUID_PERF_STAGE_RENDER, -1, &stats));
+    TEST_ASSERT(stats.count == 0);
+
+    render(synth);
+    TEST_SUCCESS(fluid_synth_get_perf_stats(synth, FLUID_PERF_STAGE_RENDER, -1, &stats));
+    TEST_ASSERT(stats.count > 0 && stats.count <= (unsigned int)(CALLS * FRAMES / fluid_synth_get_internal_bufsize(synth)));
+
+    /* switching it off keeps the statistics */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.perf-stats", 0));
+    render(synth);
+    TEST_SUCCESS(fluid_synth_get_perf_stats(synth, FLUID_PERF_STAGE_RENDER, -1, &voices));
+    TEST_ASSERT(voices.count == stats.count);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
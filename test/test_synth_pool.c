@@ -0,0 +1,147 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "sfloader/fluid_sfregistry.h"
+
+// this test makes sure that synths sharing a SoundFont sound like a synth importing it on its own,
+// that the SoundFont lives as long as one of them uses it, and that leased synths of a pool
+// are returned in the state they were leased in
+
+#define FRAMES 64
+#define BLOCKS 50
+
+static void play(fluid_synth_t *synth, float *out)
+{
+    int block;
+
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 1));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 9, 38, 100));
+
+    for(block = 0; block < BLOCKS; block++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, out, 0, 2, out, 1, 2));
+        out += 2 * FRAMES;
+    }
+}
+
+static int count_presets(fluid_sfont_t *sfont)
+{
+    int count = 0;
+
+    fluid_sfont_iteration_start(sfont);
+
+    while(fluid_sfont_iteration_next(sfont) != NULL)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+int main(void)
+{
+    static float ref[2 * FRAMES * BLOCKS], out[2 * FRAMES * BLOCKS];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth1, *synth2, *synth3;
+    fluid_synth_pool_t *pool;
+    fluid_sfont_t *sfont1, *sfont2;
+    fluid_preset_t *preset;
+    int i, value, sfont_id, bank, prog;
+
+    TEST_ASSERT(settings != NULL);
+
+    /* the reference, importing the SoundFont on its own */
+    synth1 = new_fluid_synth(settings);
+    TEST_ASSERT(synth1 != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth1, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_ASSERT(fluid_sfregistry_count_entries() == 0);
+    play(synth1, ref);
+    delete_fluid_synth(synth1);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.shared-soundfonts", 1));
+    synth1 = new_fluid_synth(settings);
+    synth2 = new_fluid_synth(settings);
+    synth3 = new_fluid_synth(settings);
+    TEST_ASSERT(synth1 != NULL && synth2 != NULL && synth3 != NULL);
+
+    TEST_ASSERT(fluid_synth_sfload(synth1, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_sfload(synth2, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_ASSERT(fluid_sfregistry_count_entries() == 1);
+
+    /* every synth has its own SoundFont object, with the same presets */
+    sfont1 = fluid_synth_get_sfont(synth1, 0);
+    sfont2 = fluid_synth_get_sfont(synth2, 0);
+    TEST_ASSERT(sfont1 != sfont2);
+    TEST_ASSERT(FLUID_STRCMP(fluid_sfont_get_name(sfont1), fluid_sfont_get_name(sfont2)) == 0);
+    TEST_ASSERT(count_presets(sfont1) > 0);
+    TEST_ASSERT(count_presets(sfont1) == count_presets(sfont2));
+    preset = fluid_sfont_get_preset(sfont2, 0, 1);
+    TEST_ASSERT(preset != NULL && fluid_preset_get_sfont(preset) == sfont2);
+    TEST_ASSERT(fluid_preset_get_banknum(preset) == 0 && fluid_preset_get_num(preset) == 1);
+    TEST_ASSERT(fluid_sfont_get_preset(sfont2, 100, 100) == NULL);
+
+    play(synth2, out);
+
+    for(i = 0; i < 2 * FRAMES * BLOCKS; i++)
+    {
+        TEST_ASSERT(ref[i] == out[i]);
+    }
+
+    /* the SoundFont stays while synth2 still plays it */
+    delete_fluid_synth(synth1);
+    TEST_ASSERT(fluid_sfregistry_count_entries() == 1);
+    TEST_SUCCESS(fluid_synth_write_float(synth2, FRAMES, out, 0, 2, out, 1, 2));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth2) > 0);
+
+    /* unloaded by the last synth, its voices delay freeing it, but others can't attach anymore */
+    TEST_SUCCESS(fluid_synth_sfunload(synth2, fluid_sfont_get_id(sfont2), TRUE));
+    TEST_ASSERT(fluid_sfregistry_count_entries() == 0);
+    delete_fluid_synth(synth2);
+
+    /* loading failures don't leave an entry behind */
+    TEST_ASSERT(fluid_synth_sfload(synth3, "no-such-file.sf2", 1) == FLUID_FAILED);
+    TEST_ASSERT(fluid_sfregistry_count_entries() == 0);
+    delete_fluid_synth(synth3);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.shared-soundfonts", 0));
+
+    pool = new_fluid_synth_pool(settings, 2);
+    TEST_ASSERT(pool != NULL);
+    TEST_ASSERT(fluid_synth_pool_sfload(pool, TEST_SOUNDFONT) != FLUID_FAILED);
+    TEST_ASSERT(fluid_sfregistry_count_entries() == 1);
+
+    synth1 = fluid_synth_pool_lease(pool);
+    synth2 = fluid_synth_pool_lease(pool);
+    TEST_ASSERT(synth1 != NULL && synth2 != NULL && synth1 != synth2);
+    TEST_ASSERT(fluid_synth_pool_lease(pool) == NULL);
+    TEST_ASSERT(fluid_synth_pool_sfload(pool, TEST_SOUNDFONT) == FLUID_FAILED);
+
+    play(synth1, out);
+    TEST_SUCCESS(fluid_synth_cc(synth1, 0, 7, 10));
+    fluid_synth_set_gain(synth1, 0.1f);
+
+    TEST_SUCCESS(fluid_synth_pool_release(pool, synth1));
+    TEST_ASSERT(fluid_synth_pool_release(pool, synth1) == FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_write_float(synth1, FRAMES, out, 0, 2, out, 1, 2));
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth1) == 0);
+
+    /* returned as leased */
+    TEST_ASSERT(fluid_synth_pool_lease(pool) == synth1);
+    TEST_SUCCESS(fluid_synth_get_cc(synth1, 0, 7, &value));
+    TEST_ASSERT(value == 100);
+    TEST_SUCCESS(fluid_synth_get_program(synth1, 0, &sfont_id, &bank, &prog));
+    TEST_ASSERT(prog == 0);
+    TEST_ASSERT(fluid_synth_get_gain(synth1) == fluid_synth_get_gain(synth2));
+    TEST_ASSERT(fluid_synth_sfcount(synth1) == 1);
+
+    TEST_SUCCESS(fluid_synth_pool_release(pool, synth1));
+    TEST_SUCCESS(fluid_synth_pool_release(pool, synth2));
+
+    delete_fluid_synth_pool(pool);
+    TEST_ASSERT(fluid_sfregistry_count_entries() == 0);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
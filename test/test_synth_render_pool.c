@@ -0,0 +1,98 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include <math.h>
+
+// this test makes sure that several synths sharing the threads of a render pool
+// produce the same audio as a synth rendering on a single thread
+
+#define SAMPLES 4096
+#define SYNTHS 3
+#define MAX_ABS_DELTA 1e-4f
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth;
+    int chan, key;
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+
+    /* enough voices to make use of all workers */
+    for(chan = 0; chan < 8; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, chan * 3));
+
+        for(key = 36; key < 84; key += 5)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 40 + key));
+        }
+    }
+
+    return synth;
+}
+
+static void compare(const float *ref_l, const float *ref_r, fluid_synth_t *synth)
+{
+    static float l[SAMPLES], r[SAMPLES];
+    int i;
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES, l, 0, 1, r, 0, 1));
+
+    for(i = 0; i < SAMPLES; i++)
+    {
+        TEST_ASSERT(fabsf(ref_l[i] - l[i]) < MAX_ABS_DELTA);
+        TEST_ASSERT(fabsf(ref_r[i] - r[i]) < MAX_ABS_DELTA);
+    }
+}
+
+int main(void)
+{
+    static float ref_l[2][SAMPLES], ref_r[2][SAMPLES];
+    fluid_settings_t *settings;
+    fluid_render_pool_t *pool;
+    fluid_synth_t *synth[SYNTHS];
+    int i;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    // a pool needs more than one core
+    TEST_ASSERT(new_fluid_render_pool(settings) == NULL);
+
+    synth[0] = create_synth(settings);
+    TEST_SUCCESS(fluid_synth_write_float(synth[0], SAMPLES, ref_l[0], 0, 1, ref_r[0], 0, 1));
+    TEST_SUCCESS(fluid_synth_write_float(synth[0], SAMPLES, ref_l[1], 0, 1, ref_r[1], 0, 1));
+    delete_fluid_synth(synth[0]);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", 4));
+    pool = new_fluid_render_pool(settings);
+    TEST_ASSERT(pool != NULL);
+
+    // synths with and without own mixer threads may share the pool
+    for(i = 0; i < SYNTHS; i++)
+    {
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", 1 + i));
+        synth[i] = create_synth(settings);
+        TEST_SUCCESS(fluid_synth_set_render_pool(synth[i], pool));
+        compare(ref_l[0], ref_r[0], synth[i]);
+    }
+
+    // a pool still in use must not go away
+    delete_fluid_render_pool(pool);
+
+    // detached synths fall back to their own threads
+    for(i = 0; i < SYNTHS; i++)
+    {
+        TEST_SUCCESS(fluid_synth_set_render_pool(synth[i], NULL));
+        compare(ref_l[1], ref_r[1], synth[i]);
+        delete_fluid_synth(synth[i]);
+    }
+
+    delete_fluid_render_pool(pool);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that a synth restored from a snapshot sounds like the synth the snapshot
+// was taken from, also when another synth restores it and has to load the SoundFont first
+
+#define FRAMES 64
+#define BLOCKS 100
+
+static void setup(fluid_synth_t *synth)
+{
+    static const double pitch[128] = { 0 };
+
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+    TEST_SUCCESS(fluid_synth_cc(synth, 0, 7, 60));
+    TEST_SUCCESS(fluid_synth_pitch_bend(synth, 0, 11000));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 1, 1));
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 1, GEN_FILTERFC, -2000.0f));
+    TEST_SUCCESS(fluid_synth_cc(synth, 1, 10, 20));
+    TEST_SUCCESS(fluid_synth_set_channel_type(synth, 2, CHANNEL_TYPE_DRUM));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 2, 0));
+
+    /* every key plays the lowest C */
+    TEST_SUCCESS(fluid_synth_activate_key_tuning(synth, 1, 2, "flat", pitch, FALSE));
+    TEST_SUCCESS(fluid_synth_activate_tuning(synth, 3, 1, 2, FALSE));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 3, 2));
+
+    TEST_SUCCESS(fluid_synth_set_reverb_group_roomsize(synth, 0, 0.7));
+    fluid_synth_set_gain(synth, 0.5f);
+}
+
+static void mess_up(fluid_synth_t *synth)
+{
+    TEST_SUCCESS(fluid_synth_system_reset(synth));
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 3));
+    TEST_SUCCESS(fluid_synth_cc(synth, 1, 7, 10));
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 0, GEN_FILTERQ, 100.0f));
+    TEST_SUCCESS(fluid_synth_set_reverb_group_roomsize(synth, 0, 0.1));
+    fluid_synth_set_gain(synth, 1.0f);
+}
+
+static void play(fluid_synth_t *synth, float *out)
+{
+    int chan, block;
+
+    for(chan = 0; chan < 4; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, chan, 50 + chan * 5, 100));
+    }
+
+    for(block = 0; block < BLOCKS; block++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, out, 0, 2, out, 1, 2));
+        out += 2 * FRAMES;
+    }
+
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+}
+
+static void compare(const float *ref, const float *out)
+{
+    int i, audible = FALSE;
+
+    for(i = 0; i < 2 * FRAMES * BLOCKS; i++)
+    {
+        TEST_ASSERT(ref[i] == out[i]);
+        audible |= (ref[i] != 0.0f);
+    }
+
+    TEST_ASSERT(audible);
+}
+
+static fluid_synth_t *create(fluid_settings_t *settings, int load)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+
+    if(load)
+    {
+        TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    }
+
+    return synth;
+}
+
+int main(void)
+{
+    static float ref[2 * FRAMES * BLOCKS], out[2 * FRAMES * BLOCKS];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    char name[32];
+    double roomsize, pitch[128];
+    int size;
+    char *snapshot;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    /* each synth plays only once, so that they all start out alike */
+    synth = create(settings, TRUE);
+    setup(synth);
+    play(synth, ref);
+    delete_fluid_synth(synth);
+
+    synth = create(settings, TRUE);
+    setup(synth);
+
+    size = fluid_synth_snapshot(synth, NULL, 0);
+    TEST_ASSERT(size > 0);
+    snapshot = malloc(size);
+    TEST_ASSERT(snapshot != NULL);
+    TEST_ASSERT(fluid_synth_snapshot(synth, snapshot, size - 1) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_snapshot(synth, snapshot, size) == size);
+
+    /* the same synth, with its SoundFont still loaded */
+    mess_up(synth);
+    TEST_SUCCESS(fluid_synth_restore(synth, snapshot, size));
+    TEST_ASSERT(fluid_synth_sfcount(synth) == 1);
+    TEST_ASSERT(fluid_synth_get_gain(synth) == 0.5f);
+    TEST_SUCCESS(fluid_synth_get_reverb_group_roomsize(synth, 0, &roomsize));
+    TEST_ASSERT(roomsize > 0.69 && roomsize < 0.71);
+    play(synth, out);
+    compare(ref, out);
+
+    /* invalid snapshots leave the synth as it is */
+    mess_up(synth);
+    TEST_ASSERT(fluid_synth_restore(synth, snapshot, size - 1) == FLUID_FAILED);
+    snapshot[0] ^= 1;
+    TEST_ASSERT(fluid_synth_restore(synth, snapshot, size) == FLUID_FAILED);
+    snapshot[0] ^= 1;
+    TEST_ASSERT(fluid_synth_get_gain(synth) == 1.0f);
+    delete_fluid_synth(synth);
+
+    /* a fresh synth loads the SoundFont of the snapshot */
+    synth = create(settings, FALSE);
+    TEST_SUCCESS(fluid_synth_restore(synth, snapshot, size));
+    TEST_ASSERT(fluid_synth_sfcount(synth) == 1);
+    TEST_SUCCESS(fluid_synth_tuning_dump(synth, 1, 2, name, sizeof(name), pitch));
+    TEST_ASSERT(FLUID_STRCMP(name, "flat") == 0 && pitch[127] == 0.0);
+    play(synth, out);
+    compare(ref, out);
+    delete_fluid_synth(synth);
+
+    /* not made with the same number of channels */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.midi-channels", 32));
+    synth = create(settings, FALSE);
+    TEST_ASSERT(fluid_synth_restore(synth, snapshot, size) == FLUID_FAILED);
+    delete_fluid_synth(synth);
+
+    free(snapshot);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
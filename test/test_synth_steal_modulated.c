@@ -0,0 +1,76 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+
+// this test makes sure that a noteon stealing a voice ranks the voices by the controller
+// values set before it, even though controller changes are applied to the voices only
+// before the next block
+
+#define MAX_VOICES 64
+#define FRAMES 64
+
+static void render(fluid_synth_t *synth)
+{
+    static float buf[2 * FRAMES];
+    TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+}
+
+/* Returns the number of voices playing on chan */
+static int count_voices(fluid_synth_t *synth, int chan)
+{
+    fluid_voice_t *list[MAX_VOICES];
+    int i, count = 0;
+
+    fluid_synth_get_voicelist(synth, list, MAX_VOICES, -1);
+
+    for(i = 0; i < MAX_VOICES && list[i] != NULL; i++)
+    {
+        if(fluid_voice_get_channel(list[i]) == chan)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int per_note;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", MAX_VOICES));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.overflow.age", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 60));
+    render(synth);
+    per_note = count_voices(synth, 0);
+    TEST_ASSERT(per_note > 0);
+
+    /* room for two notes, the second one is louder and thus more important */
+    TEST_SUCCESS(fluid_synth_set_polyphony(synth, 2 * per_note));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 60, 127));
+    render(synth);
+    TEST_ASSERT(count_voices(synth, 1) == per_note);
+
+    /* turned down within the same block, the second note is the one to steal */
+    TEST_SUCCESS(fluid_synth_cc(synth, 1, 7, 0));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 2, 60, 100));
+
+    TEST_ASSERT(count_voices(synth, 0) == per_note);
+    TEST_ASSERT(count_voices(synth, 1) == 0);
+    TEST_ASSERT(count_voices(synth, 2) == per_note);
+
+    render(synth);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+#include "test.h"
+#include "fluidsynth.h"
+
+// this test makes sure that the waits of the mixer threads are counted by how they were
+// satisfied, that the counters are cleared by fluid_synth_reset_perf_stats() and that
+// fluid_synth_get_thread_wait_stats() checks its arguments
+
+#define CORES 3
+#define SAMPLES 4096
+
+static fluid_synth_t *create_synth(fluid_settings_t *settings, const char *wait_mode)
+{
+    fluid_synth_t *synth;
+    int chan, key;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", CORES));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "synth.mixer-thread-wait", wait_mode));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* enough voices to wake up all mixer threads */
+    for(chan = 0; chan < 8; chan++)
+    {
+        for(key = 36; key < 84; key += 5)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 100));
+        }
+    }
+
+    return synth;
+}
+
+static void render(fluid_synth_t *synth)
+{
+    static float left[SAMPLES], right[SAMPLES];
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES, left, 0, 1, right, 0, 1));
+}
+
+/* Sums up the waits of all render participants */
+static void count_waits(fluid_synth_t *synth, unsigned int *spins, unsigned int *blocks)
+{
+    unsigned int s, b;
+    int i;
+
+    *spins = *blocks = 0;
+
+    for(i = 0; i < CORES; i++)
+    {
+        TEST_SUCCESS(fluid_synth_get_thread_wait_stats(synth, i, &s, &b));
+        *spins += s;
+        *blocks += b;
+    }
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    unsigned int spins, blocks;
+
+    TEST_ASSERT(settings != NULL);
+
+    /* blocking right away never spins, every mixer thread has waited for its work */
+    synth = create_synth(settings, "block");
+    render(synth);
+    count_waits(synth, &spins, &blocks);
+    TEST_ASSERT(spins == 0);
+    TEST_ASSERT(blocks > 0);
+
+    TEST_SUCCESS(fluid_synth_get_thread_wait_stats(synth, 1, NULL, &blocks));
+    TEST_SUCCESS(fluid_synth_get_thread_wait_stats(synth, 1, &spins, NULL));
+    TEST_ASSERT(fluid_synth_get_thread_wait_stats(synth, -1, &spins, &blocks) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_thread_wait_stats(synth, 1 << 16, &spins, &blocks) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_thread_wait_stats(NULL, 0, &spins, &blocks) == FLUID_FAILED);
+
+    /* cleared, and counted again from the next wait */
+    fluid_synth_reset_perf_stats(synth);
+    count_waits(synth, &spins, &blocks);
+    TEST_ASSERT(spins == 0 && blocks == 0);
+
+    render(synth);
+    count_waits(synth, &spins, &blocks);
+    TEST_ASSERT(spins == 0);
+    TEST_ASSERT(blocks > 0);
+    delete_fluid_synth(synth);
+
+    /* a hybrid wait is counted once, whether it ends up blocking or not */
+    synth = create_synth(settings, "hybrid");
+    render(synth);
+    count_waits(synth, &spins, &blocks);
+    TEST_ASSERT(spins + blocks > 0);
+    delete_fluid_synth(synth);
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
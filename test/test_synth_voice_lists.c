@@ -0,0 +1,130 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "fluidsynth_priv.h"
+#include "fluid_synth.h"
+#include "fluid_midi.h"
+
+// this test makes sure that the lists of voices per note and per channel always hold exactly
+// the voices of the voice array playing that note or channel, in the order of the voice array,
+// while notes are played poly, mono and legato and the polyphony changes
+
+#define ITERATIONS 4000
+#define CHANNELS 4
+
+static unsigned int seed = 1;
+
+static int next_random(int range)
+{
+    seed = seed * 1103515245 + 12345;
+    return (int)((seed >> 16) % (unsigned int)range);
+}
+
+static void check_list(fluid_synth_t *synth, fluid_voice_t *head, int list, int chan, int key)
+{
+    fluid_voice_t *voice = head;
+    fluid_voice_t *prev = NULL;
+    int i;
+
+    for(i = 0; i < synth->nvoice; i++)
+    {
+        fluid_voice_t *expected = synth->voice[i];
+
+        if(expected->chan != chan || (key >= 0 && expected->key != key))
+        {
+            continue;
+        }
+
+        TEST_ASSERT(voice == expected);
+        TEST_ASSERT(voice->list_prev[list] == prev);
+        prev = voice;
+        voice = voice->list_next[list];
+    }
+
+    TEST_ASSERT(voice == NULL);
+}
+
+static void check_lists(fluid_synth_t *synth)
+{
+    int chan, key;
+
+    for(chan = 0; chan < synth->midi_channels; chan++)
+    {
+        check_list(synth, FLUID_SYNTH_CHANNEL_VOICES(synth, chan), FLUID_VOICE_LIST_CHANNEL, chan, -1);
+
+        for(key = 0; key < 128; key++)
+        {
+            check_list(synth, FLUID_SYNTH_NOTE_VOICES(synth, chan, key), FLUID_VOICE_LIST_NOTE, chan, key);
+        }
+    }
+}
+
+int main(void)
+{
+    static float out[2][512];
+    fluid_settings_t *settings;
+    fluid_synth_t *synth;
+    int i, chan;
+
+    settings = new_fluid_settings();
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", 16));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+
+    /* the legato switch makes channels 2 and 3 play mono, channel 3 switches between the legato modes */
+    TEST_SUCCESS(fluid_synth_cc(synth, 2, LEGATO_SWITCH, 127));
+    TEST_SUCCESS(fluid_synth_cc(synth, 3, LEGATO_SWITCH, 127));
+
+    for(i = 0; i < ITERATIONS; i++)
+    {
+        int r = next_random(100);
+        int key = 50 + next_random(12);
+        chan = next_random(CHANNELS);
+
+        if(r < 40)
+        {
+            /* fails if no voice can be allocated, which is fine */
+            fluid_synth_noteon(synth, chan, key, 1 + next_random(127));
+        }
+        else if(r < 65)
+        {
+            /* fails if there is no such note, which is fine */
+            fluid_synth_noteoff(synth, chan, key);
+        }
+        else if(r < 72)
+        {
+            TEST_SUCCESS(fluid_synth_cc(synth, chan, (next_random(2) ? SUSTAIN_SWITCH : SOSTENUTO_SWITCH), next_random(2) * 127));
+        }
+        else if(r < 76)
+        {
+            TEST_SUCCESS(fluid_synth_key_pressure(synth, chan, key, next_random(128)));
+        }
+        else if(r < 78)
+        {
+            TEST_SUCCESS(fluid_synth_set_legato_mode(synth, 3, next_random(FLUID_CHANNEL_LEGATO_MODE_LAST)));
+        }
+        else if(r < 97)
+        {
+            TEST_SUCCESS(fluid_synth_write_float(synth, 64 * (1 + next_random(8)), out[0], 0, 1, out[1], 0, 1));
+        }
+        else if(r < 99)
+        {
+            TEST_SUCCESS(fluid_synth_all_sounds_off(synth, chan));
+        }
+        else
+        {
+            TEST_SUCCESS(fluid_synth_set_polyphony(synth, 8 + next_random(24)));
+        }
+
+        check_lists(synth);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
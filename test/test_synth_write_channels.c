@@ -0,0 +1,113 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+#include <string.h>
+
+// this test makes sure that fluid_synth_write_channels() stores the same samples as the
+// functions writing a single format, whatever the layout of the destination buffers
+
+#define FRAMES 300  /* not a multiple of the internal block size */
+#define CHUNKS 16
+
+static fluid_synth_t *create(fluid_settings_t *settings)
+{
+    fluid_synth_t *synth = new_fluid_synth(settings);
+
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 67, 100));
+    return synth;
+}
+
+/* Renders interleaved stereo with the single format functions and with fluid_synth_write_channels() */
+static void test_format(fluid_settings_t *settings, enum fluid_sample_format format, size_t sample_size)
+{
+    static char expected[2 * FRAMES * sizeof(float)], interleaved[2 * FRAMES * sizeof(float)];
+    static char left[FRAMES * sizeof(float)], right[FRAMES * sizeof(float)];
+    fluid_synth_t *synth1 = create(settings);
+    fluid_synth_t *synth2 = create(settings);
+    fluid_synth_t *synth3 = create(settings);
+    void *out[2];
+    int off[2], incr[2];
+    size_t k;
+    int c, audible = FALSE;
+
+    for(c = 0; c < CHUNKS; c++)
+    {
+        switch(format)
+        {
+        case FLUID_SAMPLE_FORMAT_FLOAT:
+            TEST_SUCCESS(fluid_synth_write_float(synth1, FRAMES, expected, 0, 2, expected, 1, 2));
+            break;
+
+        case FLUID_SAMPLE_FORMAT_S16:
+            TEST_SUCCESS(fluid_synth_write_s16(synth1, FRAMES, expected, 0, 2, expected, 1, 2));
+            break;
+
+        case FLUID_SAMPLE_FORMAT_S24:
+            TEST_SUCCESS(fluid_synth_write_s24(synth1, FRAMES, expected, 0, 2, expected, 1, 2));
+            break;
+
+        case FLUID_SAMPLE_FORMAT_S32:
+            TEST_SUCCESS(fluid_synth_write_s32(synth1, FRAMES, expected, 0, 2, expected, 1, 2));
+            break;
+        }
+
+        for(k = 0; k < 2 * FRAMES * sample_size; k++)
+        {
+            audible |= (expected[k] != 0);
+        }
+
+        /* interleaved in a unique buffer */
+        out[0] = out[1] = interleaved;
+        off[0] = 0;
+        off[1] = 1;
+        incr[0] = incr[1] = 2;
+        TEST_SUCCESS(fluid_synth_write_channels(synth2, FRAMES, format, 2, out, off, incr));
+        TEST_ASSERT(memcmp(expected, interleaved, 2 * FRAMES * sample_size) == 0);
+
+        /* planar, the left channel stored to the right buffer and vice versa */
+        out[0] = right;
+        out[1] = left;
+        off[0] = off[1] = 0;
+        incr[0] = incr[1] = 1;
+        TEST_SUCCESS(fluid_synth_write_channels(synth3, FRAMES, format, 2, out, off, incr));
+
+        for(k = 0; k < FRAMES; k++)
+        {
+            TEST_ASSERT(memcmp(&expected[2 * k * sample_size], &right[k * sample_size], sample_size) == 0);
+            TEST_ASSERT(memcmp(&expected[(2 * k + 1) * sample_size], &left[k * sample_size], sample_size) == 0);
+        }
+    }
+
+    TEST_ASSERT(audible);
+    delete_fluid_synth(synth1);
+    delete_fluid_synth(synth2);
+    delete_fluid_synth(synth3);
+}
+
+int main(void)
+{
+    static float buf[2 * FRAMES];
+    void *out[2] = { buf, buf };
+    int off[2] = { 0, 1 }, incr[2] = { 2, 2 };
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+
+    TEST_ASSERT(settings != NULL);
+
+    test_format(settings, FLUID_SAMPLE_FORMAT_FLOAT, sizeof(float));
+    test_format(settings, FLUID_SAMPLE_FORMAT_S16, sizeof(short));
+    test_format(settings, FLUID_SAMPLE_FORMAT_S24, 4);
+    test_format(settings, FLUID_SAMPLE_FORMAT_S32, 4);
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_write_channels(synth, FRAMES, (enum fluid_sample_format)42, 2, out, off, incr) == FLUID_FAILED);
+    delete_fluid_synth(synth);
+
+    delete_fluid_settings(settings);
+    return EXIT_SUCCESS;
+}
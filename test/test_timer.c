@@ -0,0 +1,61 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "utils/fluid_perf.h"
+
+// this test makes sure that a timer with a sub-millisecond interval calls back
+// at the absolute times of its periods: in order, never early, and as often as asked for.
+// How late it calls back depends on the load of the machine, which isn't checked.
+
+#define INTERVAL_US 500
+#define CALLS 400
+
+typedef struct
+{
+    int calls;
+    unsigned int last_msec;
+    int backwards;
+    int early;
+    double start;
+} timer_data_t;
+
+static int timer_callback(void *data, unsigned int msec)
+{
+    timer_data_t *d = data;
+    double now = fluid_perf_now();
+
+    if(msec < d->last_msec)
+    {
+        d->backwards = TRUE;
+    }
+
+    /* the timer is started after d->start, so the n-th call isn't due before n periods after it */
+    if(now < d->start + d->calls * INTERVAL_US - 100)
+    {
+        d->early = TRUE;
+    }
+
+    d->last_msec = msec;
+
+    return ++d->calls < CALLS;
+}
+
+int main(void)
+{
+    timer_data_t data;
+    fluid_timer_t *timer;
+
+    FLUID_MEMSET(&data, 0, sizeof(data));
+    data.start = fluid_perf_now();
+
+    timer = new_fluid_timer_us(INTERVAL_US, timer_callback, &data, TRUE, FALSE, FALSE);
+    TEST_ASSERT(timer != NULL);
+    TEST_SUCCESS(fluid_timer_join(timer));
+    delete_fluid_timer(timer);
+
+    TEST_ASSERT(data.calls == CALLS);
+    TEST_ASSERT(!data.backwards);
+    TEST_ASSERT(!data.early);
+
+    return EXIT_SUCCESS;
+}
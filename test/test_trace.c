@@ -0,0 +1,106 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+
+// this test makes sure that trace spans are only recorded while tracing is started and
+// that they are written as a Chrome trace event file
+
+#define TRACE_FILE "test_trace.json"
+#define FRAMES 1024
+
+static void render(fluid_synth_t *synth, int calls)
+{
+    static float buf[2 * FRAMES];
+    int i;
+
+    for(i = 0; i < calls; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, buf, 0, 2, buf, 1, 2));
+    }
+}
+
+/* Reads the trace file and counts the spans of the given name */
+static int count_spans(const char *name)
+{
+    static char content[1 << 20];
+    char pattern[64];
+    const char *pos = content;
+    FILE *file = FLUID_FOPEN(TRACE_FILE, "r");
+    size_t len;
+    int count = 0;
+
+    TEST_ASSERT(file != NULL);
+    len = fread(content, 1, sizeof(content) - 1, file);
+    content[len] = '\0';
+    fclose(file);
+
+    TEST_ASSERT(FLUID_STRNCMP(content, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 39) == 0);
+    TEST_ASSERT(strstr(content, "]}") != NULL);
+
+    FLUID_SNPRINTF(pattern, sizeof(pattern), "{\"name\":\"%s\",", name);
+
+    while((pos = strstr(pos, pattern)) != NULL)
+    {
+        count++;
+        pos++;
+    }
+
+    return count;
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_sequencer_t *seq;
+    int renders;
+
+    TEST_ASSERT(settings != NULL);
+
+    /* nothing recorded yet */
+    TEST_ASSERT(fluid_trace_dump(TRACE_FILE) == FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_trace_start(1000));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    seq = new_fluid_sequencer2(0);
+    TEST_ASSERT(seq != NULL);
+    TEST_ASSERT(fluid_sequencer_register_fluidsynth(seq, synth) != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    render(synth, 10);
+
+    /* rendering after stopping isn't recorded */
+    fluid_trace_stop();
+    render(synth, 10);
+
+    TEST_SUCCESS(fluid_trace_dump(TRACE_FILE));
+
+    renders = count_spans("render_blocks");
+    TEST_ASSERT(renders > 0 && renders <= 10 * FRAMES / fluid_synth_get_internal_bufsize(synth));
+    TEST_ASSERT(count_spans("voices") == renders);
+    TEST_ASSERT(count_spans("fx") == renders);
+    TEST_ASSERT(count_spans("defsfont_load") == 1);
+    TEST_ASSERT(count_spans("sequencer_process") > 0);
+    TEST_ASSERT(count_spans("thread_name") == 1);
+
+    /* a new recording discards the spans, spans beyond the buffer size are dropped */
+    TEST_SUCCESS(fluid_trace_start(5));
+    render(synth, 10);
+    TEST_SUCCESS(fluid_trace_dump(TRACE_FILE));
+    TEST_ASSERT(count_spans("defsfont_load") == 0);
+    TEST_ASSERT(count_spans("render_blocks") + count_spans("voices") + count_spans("fx")
+                + count_spans("sequencer_process") == 5);
+
+    remove(TRACE_FILE);
+
+    delete_fluid_sequencer(seq);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_synth.h"
+
+// this test makes sure that MIDI tuning SYSEX messages retune an existing tuning in place,
+// and that bulk tuning dumps are received
+
+#define MAX_VOICES 64
+
+/* builds a bulk tuning dump with bank, the keys tuned up by cents */
+static int make_bulk_dump(char *msg, int bank, int prog, int cents)
+{
+    int frac = cents * 16384 / 100;
+    int i, n = 0;
+
+    msg[n++] = 0x7E;
+    msg[n++] = 0x7F;
+    msg[n++] = 0x08;
+    msg[n++] = 0x04;
+    msg[n++] = bank;
+    msg[n++] = prog;
+    FLUID_MEMCPY(&msg[n], "bulk dump       ", 16);
+    n += 16;
+
+    for(i = 0; i < 128; i++)
+    {
+        /* key 0 keeps its pitch */
+        msg[n++] = (i == 0) ? 0x7F : i;
+        msg[n++] = (i == 0) ? 0x7F : frac >> 7;
+        msg[n++] = (i == 0) ? 0x7F : frac & 0x7F;
+    }
+
+    msg[n++] = 0; /* checksum */
+    return n;
+}
+
+int main(void)
+{
+    static float buf[2 * 64];
+    char msg[512], response[512];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_tuning_t *tuning;
+    fluid_voice_t *voices[MAX_VOICES];
+    double pitch[128];
+    char name[32];
+    int i, n, len, handled;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* a bulk dump creates the tuning */
+    len = make_bulk_dump(msg, 1, 2, 25);
+    TEST_ASSERT(len == 407);
+    TEST_SUCCESS(fluid_synth_sysex(synth, msg, len, NULL, NULL, &handled, FALSE));
+    TEST_ASSERT(handled);
+
+    TEST_SUCCESS(fluid_synth_tuning_dump(synth, 1, 2, name, sizeof(name), pitch));
+    TEST_ASSERT(FLUID_STRCMP(name, "bulk dump       ") == 0);
+    TEST_ASSERT(pitch[0] == 0.0);
+    TEST_ASSERT(fabs(pitch[60] - 6025.0) < 0.01);
+
+    TEST_SUCCESS(fluid_synth_activate_tuning(synth, 0, 1, 2, FALSE));
+    TEST_SUCCESS(fluid_synth_activate_tuning(synth, 1, 1, 2, FALSE));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 1, 60, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, 64, buf, 0, 2, buf, 1, 2));
+
+    /* a realtime single note tuning change is applied in place and retunes the voices of both channels */
+    tuning = synth->tuning[1][2];
+
+    msg[0] = 0x7F;
+    msg[1] = 0x7F;
+    msg[2] = 0x08;
+    msg[3] = 0x07;
+    msg[4] = 1;     /* bank */
+    msg[5] = 2;     /* prog */
+    msg[6] = 1;     /* count */
+    msg[7] = 60;
+    msg[8] = 60;
+    msg[9] = 0x40;  /* +50 cents */
+    msg[10] = 0;
+    TEST_SUCCESS(fluid_synth_sysex(synth, msg, 11, NULL, NULL, &handled, FALSE));
+    TEST_ASSERT(handled);
+    TEST_ASSERT(synth->tuning[1][2] == tuning);
+
+    TEST_SUCCESS(fluid_synth_tuning_dump(synth, 1, 2, NULL, 0, pitch));
+    TEST_ASSERT(fabs(pitch[60] - 6050.0) < 0.01);
+    TEST_ASSERT(fabs(pitch[61] - 6125.0) < 0.01);
+
+    fluid_synth_get_voicelist(synth, voices, MAX_VOICES, -1);
+
+    for(i = 0, n = 0; i < MAX_VOICES && voices[i] != NULL; i++)
+    {
+        if(fluid_voice_get_key(voices[i]) == 60)
+        {
+            TEST_ASSERT(fabs(fluid_voice_gen_get(voices[i], GEN_PITCH) - 6050.0) < 0.01);
+            n++;
+        }
+    }
+
+    TEST_ASSERT(n >= 2);
+
+    /* the dump of the tuning reads back as the same tuning */
+    msg[0] = 0x7E;
+    msg[3] = 0x03;
+    len = sizeof(response);
+    TEST_SUCCESS(fluid_synth_sysex(synth, msg, 6, response, &len, &handled, FALSE));
+    TEST_ASSERT(handled && len == 407);
+
+    response[5] = 3; /* to prog 3 */
+    TEST_SUCCESS(fluid_synth_sysex(synth, response, len, NULL, NULL, &handled, FALSE));
+    TEST_ASSERT(handled);
+
+    TEST_SUCCESS(fluid_synth_tuning_dump(synth, 1, 3, NULL, 0, pitch));
+
+    for(i = 1; i < 128; i++)
+    {
+        TEST_ASSERT(fabs(pitch[i] - (i == 60 ? 6050.0 : i * 100.0 + 25.0)) < 0.01);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_voice.h"
+
+// this test makes sure that applying a changed tuning to the playing notes only updates the
+// voices whose key or root key changed its pitch, and that these get the new pitch
+
+#define MAX_VOICES 64
+
+static int get_voices(fluid_synth_t *synth, fluid_voice_t **voices)
+{
+    int n = 0;
+
+    fluid_synth_get_voicelist(synth, voices, MAX_VOICES, -1);
+
+    while(n < MAX_VOICES && voices[n] != NULL)
+    {
+        n++;
+    }
+
+    return n;
+}
+
+static int get_root_key(const fluid_voice_t *voice)
+{
+    return (int)(voice->root_pitch / 100.0f);
+}
+
+int main(void)
+{
+    static float buf[2 * 64];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_voice_t *voices[MAX_VOICES];
+    int key = 64;
+    double pitch = 6450.0;
+    int i, n, retuned = 0, skipped = 0;
+
+    TEST_ASSERT(settings != NULL);
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_synth_activate_key_tuning(synth, 0, 0, "equal", NULL, FALSE));
+    TEST_SUCCESS(fluid_synth_activate_tuning(synth, 0, 0, 0, FALSE));
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60, 100));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 0, 64, 100));
+    TEST_SUCCESS(fluid_synth_write_float(synth, 64, buf, 0, 2, buf, 1, 2));
+
+    /* mark the voices that must not be recalculated */
+    n = get_voices(synth, voices);
+    TEST_ASSERT(n >= 2);
+
+    for(i = 0; i < n; i++)
+    {
+        if(fluid_voice_get_key(voices[i]) != key && get_root_key(voices[i]) != key)
+        {
+            fluid_voice_gen_set(voices[i], GEN_PITCH, 1234.0f);
+        }
+    }
+
+    TEST_SUCCESS(fluid_synth_tune_notes(synth, 0, 0, 1, &key, &pitch, TRUE));
+
+    for(i = 0; i < n; i++)
+    {
+        if(fluid_voice_get_key(voices[i]) == key && get_root_key(voices[i]) != key)
+        {
+            TEST_ASSERT(fabs(fluid_voice_gen_get(voices[i], GEN_PITCH) - pitch) < 0.01);
+            retuned++;
+        }
+        else if(fluid_voice_get_key(voices[i]) != key && get_root_key(voices[i]) != key)
+        {
+            TEST_ASSERT(fluid_voice_gen_get(voices[i], GEN_PITCH) == 1234.0f);
+            skipped++;
+        }
+    }
+
+    TEST_ASSERT(retuned > 0 && skipped > 0);
+
+    /* removing the tuning from the channel recalculates all voices */
+    TEST_SUCCESS(fluid_synth_deactivate_tuning(synth, 0, TRUE));
+
+    for(i = 0; i < n; i++)
+    {
+        TEST_ASSERT(fluid_voice_gen_get(voices[i], GEN_PITCH) != 1234.0f);
+    }
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include "utils/fluid_sys.h"
+#include "synth/fluid_synth.h"
+
+// this test makes sure that the udp MIDI driver queues the events it receives at the sample
+// they are due at, following the clock of each sender, and plays late events right away
+
+#define UDP_PORT 9875
+#define LATENCY 20
+#define SAMPLE_RATE 44100
+#define LATENCY_SAMPLES (LATENCY * SAMPLE_RATE / 1000)
+
+static fluid_socket_t open_sender(void)
+{
+#ifdef IPV6_SUPPORT
+    return socket(AF_INET6, SOCK_DGRAM, 0);
+#else
+    return socket(AF_INET, SOCK_DGRAM, 0);
+#endif
+}
+
+static void put_uint32(unsigned char *buf, unsigned int value)
+{
+    buf[0] = value >> 24;
+    buf[1] = (value >> 16) & 0xFF;
+    buf[2] = (value >> 8) & 0xFF;
+    buf[3] = value & 0xFF;
+}
+
+static void put_event(unsigned char *buf, unsigned int offset, int status, int data1, int data2, int port)
+{
+    put_uint32(buf, offset);
+    buf[4] = status;
+    buf[5] = data1;
+    buf[6] = data2;
+    buf[7] = port;
+}
+
+static void send_datagram(fluid_socket_t sock, const unsigned char *buf, int len)
+{
+#ifdef IPV6_SUPPORT
+    struct sockaddr_in6 addr;
+
+    FLUID_MEMSET(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(UDP_PORT);
+    addr.sin6_addr = in6addr_loopback;
+#else
+    struct sockaddr_in addr;
+
+    FLUID_MEMSET(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(UDP_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+#endif
+
+    TEST_ASSERT(sendto(sock, (const char *)buf, len, 0, (struct sockaddr *)&addr, sizeof(addr)) == len);
+}
+
+/* waits until the synth has count events queued, or fails after a while */
+static void wait_for_events(fluid_synth_t *synth, int count)
+{
+    int i;
+
+    for(i = 0; i < 2000 && synth->midi_queue_tail - synth->midi_queue_head < count; i++)
+    {
+        fluid_msleep(1);
+    }
+
+    TEST_ASSERT(synth->midi_queue_tail - synth->midi_queue_head == count);
+}
+
+/* returns the sample a note-on of the key is queued at */
+static int find_noteon(fluid_synth_t *synth, int chan, int key)
+{
+    int i;
+
+    for(i = synth->midi_queue_head; i < synth->midi_queue_tail; i++)
+    {
+        fluid_midi_event_t *event = &synth->midi_queue[i];
+
+        if(event->type == NOTE_ON && event->channel == chan && (int)event->param1 == key)
+        {
+            return (int)event->dtime;
+        }
+    }
+
+    TEST_ASSERT(0);
+    return -1;
+}
+
+int main(void)
+{
+    unsigned char buf[4 + 4 * 8];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_midi_driver_t *driver;
+    fluid_socket_t sock, sock2;
+    int first, at;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.midi-channels", 32));
+    TEST_SUCCESS(fluid_settings_setnum(settings, "synth.sample-rate", SAMPLE_RATE));
+    TEST_SUCCESS(fluid_settings_setstr(settings, "midi.driver", "udp"));
+    TEST_SUCCESS(fluid_settings_setint(settings, "midi.udp.port", UDP_PORT));
+    TEST_SUCCESS(fluid_settings_setint(settings, "midi.udp.latency", LATENCY));
+
+    /* nothing is rendered, so that the offsets of the events are their ticks */
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+
+    driver = new_fluid_midi_driver(settings, fluid_synth_handle_midi_event, synth);
+    TEST_ASSERT(driver != NULL);
+
+    /* the driver has set up the socket library already */
+    sock = open_sender();
+    sock2 = open_sender();
+
+    /* the events of the first datagram of a sender are due after the latency, the second
+     * note 5 ms after the first one, which goes to the second port */
+    put_uint32(buf, 1000000);
+    put_event(buf + 4, 0, 0x90, 60, 100, 0);
+    put_event(buf + 12, 5000, 0x91, 62, 100, 1);
+    put_event(buf + 20, 5000, 0xF8, 0, 0, 0);
+    put_event(buf + 28, 10000000, 0x90, 64, 100, 0);
+    send_datagram(sock, buf, sizeof(buf));
+    wait_for_events(synth, 3);
+
+    first = find_noteon(synth, 0, 60);
+    TEST_ASSERT(first > LATENCY_SAMPLES * 3 / 4 && first <= LATENCY_SAMPLES);
+
+    at = find_noteon(synth, 17, 62) - first;
+    TEST_ASSERT(at == 220 || at == 221);
+
+    /* far ahead events are limited to a second beyond the latency */
+    at = find_noteon(synth, 0, 64);
+    TEST_ASSERT(at > SAMPLE_RATE && at <= LATENCY_SAMPLES + SAMPLE_RATE);
+
+    /* datagrams of the wrong size are ignored */
+    send_datagram(sock, buf, 7);
+
+    /* a datagram sent 50 ms before the first one arrived late, it is played right away */
+    put_uint32(buf, 1000000 - 50000);
+    put_event(buf + 4, 0, 0x90, 65, 100, 0);
+    send_datagram(sock, buf, 12);
+    wait_for_events(synth, 4);
+    TEST_ASSERT(find_noteon(synth, 0, 65) == 0);
+
+    /* the clock of another sender wraps around between its datagrams, the second one is sent
+     * 8 ms after the first one, with a note due 20 ms later */
+    put_uint32(buf, 0xFFFFF000);
+    put_event(buf + 4, 0, 0x90, 66, 100, 0);
+    send_datagram(sock2, buf, 12);
+    wait_for_events(synth, 5);
+
+    put_uint32(buf, 0x00001000);
+    put_event(buf + 4, 20000, 0x90, 67, 100, 0);
+    send_datagram(sock2, buf, 12);
+    wait_for_events(synth, 6);
+
+    at = find_noteon(synth, 0, 67);
+    TEST_ASSERT(at > LATENCY_SAMPLES && at <= LATENCY_SAMPLES + 28192 * SAMPLE_RATE / 1000000 + 1);
+
+    fluid_socket_close(sock);
+    fluid_socket_close(sock2);
+    delete_fluid_midi_driver(driver);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+#include "synth/fluid_synth.h"
+#include "rvoice/fluid_rvoice_mixer.h"
+
+// this test makes sure that notes played from the voice cache sound exactly like rendered ones,
+// also when they are released, bent or changed by controllers while they play from the cache
+
+#define FRAMES 64
+#define HITS 24
+
+static fluid_synth_t *create(fluid_settings_t *settings, int entries)
+{
+    fluid_synth_t *synth;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.voice-cache", entries));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    return synth;
+}
+
+/* plays a drum pattern and a melody, returns the number of notes played from the cache */
+static int play(fluid_synth_t *synth, float *out)
+{
+    int hit, block;
+
+    TEST_SUCCESS(fluid_synth_program_change(synth, 0, 0));
+
+    for(hit = 0; hit < HITS; hit++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, 9, 36, 100));
+        TEST_SUCCESS(fluid_synth_noteon(synth, 9, 42, 80 + (hit % 2) * 20));
+        TEST_SUCCESS(fluid_synth_noteon(synth, 0, 60 + (hit % 3), 90));
+
+        for(block = 0; block < 40; block++)
+        {
+            /* changes at different positions relative to the recorded snapshots */
+            if(block == 3 + hit && hit % 4 == 1)
+            {
+                TEST_SUCCESS(fluid_synth_pitch_bend(synth, 0, 9000));
+            }
+
+            if(block == 17 + hit && hit % 4 == 3)
+            {
+                TEST_SUCCESS(fluid_synth_cc(synth, 0, 1, 100));
+            }
+
+            if(block == 25)
+            {
+                TEST_SUCCESS(fluid_synth_noteoff(synth, 9, 42));
+                TEST_SUCCESS(fluid_synth_noteoff(synth, 0, 60 + (hit % 3)));
+            }
+
+            TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, out, 0, 2, out, 1, 2));
+            out += 2 * FRAMES;
+        }
+
+        TEST_SUCCESS(fluid_synth_noteoff(synth, 9, 36));
+        TEST_SUCCESS(fluid_synth_pitch_bend(synth, 0, 8192));
+        TEST_SUCCESS(fluid_synth_cc(synth, 0, 1, 0));
+    }
+
+    return fluid_rvoice_mixer_get_voice_cache_hits(synth->eventhandler->mixer);
+}
+
+int main(void)
+{
+    static float ref[HITS * 40 * 2 * FRAMES], cached[HITS * 40 * 2 * FRAMES];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+
+    synth = create(settings, 0);
+    TEST_ASSERT(play(synth, ref) == 0);
+    delete_fluid_synth(synth);
+
+    /* short enough for some notes to outlast their recording */
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.voice-cache-length", 300));
+    synth = create(settings, 16);
+    TEST_ASSERT(play(synth, cached) >= HITS);
+    delete_fluid_synth(synth);
+
+    for(i = 0; i < HITS * 40 * 2 * FRAMES; i++)
+    {
+        TEST_ASSERT(ref[i] == cached[i]);
+    }
+
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
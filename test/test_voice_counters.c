@@ -0,0 +1,112 @@
+#include "test.h"
+#include "fluidsynth.h"
+
+// this test makes sure that the voices started, stolen, killed by an exclusive class,
+// finished and dropped are counted per channel and for the whole synth
+
+#define FRAMES 64
+#define POLYPHONY 8
+
+static void render(fluid_synth_t *synth, int blocks)
+{
+    static float left[FRAMES], right[FRAMES];
+
+    while(blocks-- > 0)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, left, 0, 1, right, 0, 1));
+    }
+}
+
+static void get_counters(fluid_synth_t *synth, int chan, fluid_voice_counters_t *counters)
+{
+    TEST_SUCCESS(fluid_synth_get_voice_counters(synth, chan, counters));
+
+    /* every voice started is either still active, stolen or finished */
+    TEST_ASSERT(counters->started >= counters->stolen + counters->finished);
+    TEST_ASSERT(counters->peak >= 0);
+}
+
+int main(void)
+{
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    fluid_voice_counters_t all, chan0, chan1, chan2;
+    int i;
+
+    TEST_ASSERT(settings != NULL);
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    get_counters(synth, -1, &all);
+    TEST_ASSERT(all.started == 0 && all.peak == 0);
+    TEST_ASSERT(fluid_synth_get_voice_counters(synth, fluid_synth_count_midi_channels(synth), &all) == FLUID_FAILED);
+    TEST_ASSERT(fluid_synth_get_voice_counters(synth, -2, &all) == FLUID_FAILED);
+
+    /* more notes than the polyphony, one per block so that the older ones can be stolen */
+    for(i = 0; i < 2 * POLYPHONY; i++)
+    {
+        TEST_SUCCESS(fluid_synth_noteon(synth, i % 2, 40 + i, 100));
+        render(synth, 1);
+    }
+
+    get_counters(synth, -1, &all);
+    get_counters(synth, 0, &chan0);
+    get_counters(synth, 1, &chan1);
+    TEST_ASSERT(all.started >= 2 * POLYPHONY);
+    TEST_ASSERT(all.stolen >= POLYPHONY);
+    TEST_ASSERT(all.started == chan0.started + chan1.started);
+    TEST_ASSERT(all.stolen == chan0.stolen + chan1.stolen);
+    TEST_ASSERT(all.peak >= POLYPHONY);
+    TEST_ASSERT(chan0.peak > 0 && chan0.peak <= POLYPHONY);
+
+    /* once all notes have ended, every voice has been counted as stolen or finished */
+    TEST_SUCCESS(fluid_synth_all_sounds_off(synth, -1));
+    render(synth, 16);
+    TEST_ASSERT(fluid_synth_get_active_voice_count(synth) == 0);
+    get_counters(synth, -1, &all);
+    TEST_ASSERT(all.started == all.stolen + all.finished);
+    TEST_ASSERT(all.dropped == 0);
+    TEST_ASSERT(all.killed_exclusive == 0);
+
+    /* a new note of the same exclusive class kills the voices of the previous one */
+    TEST_SUCCESS(fluid_synth_set_gen(synth, 2, GEN_EXCLUSIVECLASS, 1));
+    TEST_SUCCESS(fluid_synth_noteon(synth, 2, 60, 100));
+    render(synth, 1);
+    get_counters(synth, 2, &chan2);
+    TEST_ASSERT(chan2.started > 0);
+    TEST_ASSERT(chan2.killed_exclusive == 0);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 2, 62, 100));
+    render(synth, 1);
+    get_counters(synth, 2, &chan2);
+    TEST_ASSERT(chan2.killed_exclusive == chan2.started / 2);
+    get_counters(synth, -1, &all);
+    TEST_ASSERT(all.killed_exclusive == chan2.killed_exclusive);
+
+    /* a channel limited to one voice drops the second voice of a note, it can't steal the first one */
+    TEST_SUCCESS(fluid_synth_set_channel_polyphony(synth, 3, 1, 0));
+    fluid_synth_noteon(synth, 3, 60, 100);
+    render(synth, 1);
+    get_counters(synth, 3, &chan1);
+    TEST_ASSERT(chan1.started == 1);
+    TEST_ASSERT(chan1.dropped == 1);
+    TEST_ASSERT(chan1.peak == 1);
+    get_counters(synth, -1, &all);
+    TEST_ASSERT(all.dropped == 1);
+
+    /* resetting keeps nothing */
+    fluid_synth_reset_voice_counters(synth);
+    get_counters(synth, -1, &all);
+    TEST_ASSERT(all.started == 0 && all.stolen == 0 && all.killed_exclusive == 0);
+    TEST_ASSERT(all.finished == 0 && all.dropped == 0 && all.peak == 0);
+    get_counters(synth, 2, &chan2);
+    TEST_ASSERT(chan2.started == 0 && chan2.peak == 0);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+#include "test.h"
+#include "fluidsynth.h"
+#include <math.h>
+
+// this test makes sure that ordering the voices by the sample memory they read produces
+// the same audio as rendering them in the order they were started
+
+#define SAMPLES 8192
+#define MAX_ABS_DELTA 1e-6f
+
+static void render(fluid_settings_t *settings, int locality, int interp, float *left, float *right)
+{
+    fluid_synth_t *synth;
+    int chan, key;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.voice-locality", locality));
+
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != -1);
+    TEST_SUCCESS(fluid_synth_set_interp_method(synth, -1, interp));
+
+    /* unison layers: the same notes on several channels, detuned against each other */
+    for(chan = 0; chan < 12; chan++)
+    {
+        TEST_SUCCESS(fluid_synth_program_change(synth, chan, (chan % 3) * 11));
+        TEST_SUCCESS(fluid_synth_pitch_bend(synth, chan, 8192 + (chan - 6) * 700));
+
+        for(key = 36; key < 96; key += 12)
+        {
+            TEST_SUCCESS(fluid_synth_noteon(synth, chan, key, 90));
+        }
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES / 2, left, 0, 1, right, 0, 1));
+
+    /* let some voices finish in the middle of a run of voices playing the same sample */
+    for(chan = 0; chan < 12; chan += 2)
+    {
+        TEST_SUCCESS(fluid_synth_noteoff(synth, chan, 48));
+    }
+
+    TEST_SUCCESS(fluid_synth_write_float(synth, SAMPLES / 2, left + SAMPLES / 2, 0, 1, right + SAMPLES / 2, 0, 1));
+    delete_fluid_synth(synth);
+}
+
+int main(void)
+{
+    static float ref_l[SAMPLES], ref_r[SAMPLES];
+    static float sorted_l[SAMPLES], sorted_r[SAMPLES];
+    static const int methods[] =
+    {
+        FLUID_INTERP_LINEAR, FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER, FLUID_INTERP_AUTO
+    };
+    fluid_settings_t *settings;
+    unsigned int m;
+    int cores, i;
+
+    for(cores = 1; cores <= 3; cores += 2)
+    {
+        settings = new_fluid_settings();
+        TEST_ASSERT(settings != NULL);
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.reverb.active", 0));
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.chorus.active", 0));
+        TEST_SUCCESS(fluid_settings_setint(settings, "synth.cpu-cores", cores));
+
+        for(m = 0; m < sizeof(methods) / sizeof(methods[0]); m++)
+        {
+            render(settings, 0, methods[m], ref_l, ref_r);
+            render(settings, 1, methods[m], sorted_l, sorted_r);
+
+            for(i = 0; i < SAMPLES; i++)
+            {
+                TEST_ASSERT(fabsf(ref_l[i] - sorted_l[i]) < MAX_ABS_DELTA);
+                TEST_ASSERT(fabsf(ref_r[i] - sorted_r[i]) < MAX_ABS_DELTA);
+            }
+        }
+
+        delete_fluid_settings(settings);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+
+#include "test.h"
+#include "fluidsynth.h"
+
+// this test makes sure that the voice snapshot tells the voices and channels that are playing
+
+#define FRAMES 64
+#define POLYPHONY 16
+#define CHANNELS 16
+
+static void render(fluid_synth_t *synth, int blocks)
+{
+    static float out[2 * FRAMES];
+    int i;
+
+    for(i = 0; i < blocks; i++)
+    {
+        TEST_SUCCESS(fluid_synth_write_float(synth, FRAMES, out, 0, 2, out, 1, 2));
+    }
+}
+
+int main(void)
+{
+    fluid_voice_state_t states[POLYPHONY];
+    fluid_channel_activity_t channels[CHANNELS];
+    fluid_settings_t *settings = new_fluid_settings();
+    fluid_synth_t *synth;
+    int i, count;
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.polyphony", POLYPHONY));
+    synth = new_fluid_synth(settings);
+    TEST_ASSERT(synth != NULL);
+    TEST_ASSERT(fluid_synth_sfload(synth, TEST_SOUNDFONT, 1) != FLUID_FAILED);
+
+    /* disabled by default */
+    TEST_ASSERT(fluid_synth_get_voice_states(synth, states, POLYPHONY, channels, CHANNELS) == FLUID_FAILED);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.voice-snapshot", 1));
+
+    /* nothing rendered yet */
+    TEST_ASSERT(fluid_synth_get_voice_states(synth, states, POLYPHONY, channels, CHANNELS) == 0);
+
+    TEST_SUCCESS(fluid_synth_noteon(synth, 3, 60, 100));
+    render(synth, 100);
+
+    /* the test SoundFont plays each note with two voices */
+    count = fluid_synth_get_voice_states(synth, states, POLYPHONY, channels, CHANNELS);
+    TEST_ASSERT(count == 2);
+
+    for(i = 0; i < count; i++)
+    {
+        TEST_ASSERT(states[i].chan == 3);
+        TEST_ASSERT(states[i].key == 60);
+        TEST_ASSERT(states[i].vel == 100);
+        TEST_ASSERT(states[i].stage != FLUID_VOICE_STAGE_RELEASE);
+        TEST_ASSERT(states[i].amp > 0.0f && states[i].amp <= 1.0f);
+    }
+
+    for(i = 0; i < CHANNELS; i++)
+    {
+        TEST_ASSERT(channels[i].voices == (i == 3 ? 2 : 0));
+        TEST_ASSERT((channels[i].amp > 0.0f) == (i == 3));
+    }
+
+    /* a smaller array only receives the first voices, the count is still complete */
+    TEST_ASSERT(fluid_synth_get_voice_states(synth, states, 1, NULL, 0) == 2);
+    TEST_ASSERT(fluid_synth_get_voice_states(synth, NULL, 0, NULL, 0) == 2);
+
+    TEST_SUCCESS(fluid_synth_noteoff(synth, 3, 60));
+    render(synth, 1);
+    count = fluid_synth_get_voice_states(synth, states, POLYPHONY, NULL, 0);
+
+    for(i = 0; i < count; i++)
+    {
+        TEST_ASSERT(states[i].stage == FLUID_VOICE_STAGE_RELEASE);
+    }
+
+    /* the voices are gone once their release ended */
+    render(synth, 2000);
+    TEST_ASSERT(fluid_synth_get_voice_states(synth, states, POLYPHONY, channels, CHANNELS) == 0);
+    TEST_ASSERT(channels[3].voices == 0);
+
+    TEST_SUCCESS(fluid_settings_setint(settings, "synth.voice-snapshot", 0));
+    TEST_ASSERT(fluid_synth_get_voice_states(synth, states, POLYPHONY, channels, CHANNELS) == FLUID_FAILED);
+
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+
+    return EXIT_SUCCESS;
+}